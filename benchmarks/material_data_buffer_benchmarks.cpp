@@ -0,0 +1,79 @@
+/*!
+ * \brief Benchmarks for handing out and freeing material data slots
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+
+#include "renderer/material_data_buffer.hpp"
+
+using namespace nova::renderer;
+
+namespace {
+    struct BigMaterial {
+        glm::vec4 base_color;
+        glm::vec4 emission;
+        glm::vec4 uv_transform;
+        glm::vec4 extra;
+    };
+
+    struct SmallMaterial {
+        glm::vec4 base_color;
+        glm::vec4 uv_transform;
+        glm::vec4 extra;
+    };
+
+    /*!
+     * \brief Allocates slots for two sizes of material, one after the other, like a renderpack with a couple of material layouts does
+     */
+    void BM_MaterialGetNextFreeIndex(benchmark::State& state) {
+        const auto num_materials = static_cast<uint32_t>(state.range(0));
+
+        for(auto _ : state) {
+            state.PauseTiming();
+            MaterialDataBuffer buffer{MaterialDataBuffer::SLAB_SIZE, 3};
+            state.ResumeTiming();
+
+            for(uint32_t i = 0; i < num_materials; i++) {
+                if(i % 2 == 0) {
+                    benchmark::DoNotOptimize(buffer.get_next_free_index<BigMaterial>());
+                } else {
+                    benchmark::DoNotOptimize(buffer.get_next_free_index<SmallMaterial>());
+                }
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * num_materials);
+    }
+
+    /*!
+     * \brief Frees random materials and allocates new ones in their place, like loading and unloading chunks does
+     */
+    void BM_MaterialFreeAndReallocate(benchmark::State& state) {
+        const auto num_materials = static_cast<uint32_t>(state.range(0));
+
+        MaterialDataBuffer buffer{MaterialDataBuffer::SLAB_SIZE, 3};
+        std::vector<uint32_t> indices(num_materials);
+        for(auto& idx : indices) {
+            idx = buffer.get_next_free_index<BigMaterial>();
+        }
+
+        std::mt19937 rng{1};
+        std::uniform_int_distribution<uint32_t> which{0, num_materials - 1};
+
+        for(auto _ : state) {
+            auto& idx = indices[which(rng)];
+            buffer.free_index<BigMaterial>(idx);
+            idx = buffer.get_next_free_index<BigMaterial>();
+            buffer.at<BigMaterial>(idx).base_color = glm::vec4{1};
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+} // namespace
+
+BENCHMARK(BM_MaterialGetNextFreeIndex)->RangeMultiplier(10)->Range(1'000, 100'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MaterialFreeAndReallocate)->Arg(1'000)->Arg(100'000);
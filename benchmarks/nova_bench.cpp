@@ -0,0 +1,574 @@
+/*!
+ * \brief Renders a deterministic scene for a fixed number of frames and writes out how long everything took, as JSON
+ *
+ * The scene is a seeded random field of boxes, seen by a camera that either orbits it or follows a recorded camera path. Everything
+ * about the scene depends on the frame index and the seed, never on the wall clock, so two runs with the same arguments render
+ * exactly the same frames
+ *
+ * Usage: nova-bench --material <material>.<pass> [--renderpack <name>] [--frames <n>] [--warmup-frames <n>] [--seed <n>]
+ *                   [--meshes <n>] [--renderables <n>] [--width <n>] [--height <n>] [--camera-path <file>]
+ *                   [--pipeline-statistics] [--null-device] [--capture <file>] [--frame-output <file>] [--output <file>]
+ *
+ * A camera path file is a JSON array of keyframes like `{"position": [x, y, z], "rotation": [x, y, z]}`. The benchmark spreads the
+ * keyframes evenly over the measured frames and interpolates between them
+ *
+ * `--null-device` runs on the null render device, which measures just the CPU side of each frame. `--capture` also records every
+ * command list it submits, which nova-capture-diff can compare with another run's capture. `--frame-output` reads back the scene
+ * output of the last measured frame and writes it as a PNG, which nova-regress compares with a golden frame
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <nlohmann/json.hpp>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/nova_renderer.hpp"
+#include "nova_renderer/window.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+using namespace nova::renderer;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchOptions {
+        std::string renderpack = "DefaultShaderpack";
+
+        std::optional<FullMaterialPassName> material;
+
+        uint32_t warmup_frames = 120;
+        uint32_t frames = 1000;
+
+        uint32_t seed = 1;
+
+        uint32_t num_meshes = 64;
+        uint32_t num_renderables = 4096;
+
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+
+        std::string camera_path;
+
+        bool pipeline_statistics = false;
+
+        bool null_device = false;
+
+        std::string capture;
+
+        std::string frame_output;
+
+        std::string output = "nova-bench.json";
+    };
+
+    struct CameraKeyframe {
+        glm::vec3 position{};
+        glm::vec3 rotation{};
+    };
+
+    /*!
+     * \brief Half the size of the cube that the synthetic scene fills
+     */
+    constexpr float SCENE_EXTENT = 200.0f;
+
+    /*!
+     * \brief How many frames to keep rendering after the measured ones while we wait for the last one's readback
+     */
+    constexpr uint32_t MAX_READBACK_FRAMES = 16;
+
+    double milliseconds_since(const Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    std::optional<uint32_t> parse_uint(const std::string_view value) {
+        try {
+            return static_cast<uint32_t>(std::stoul(std::string{value}));
+        }
+        catch(const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    std::optional<BenchOptions> parse_options(const int argc, char** argv) {
+        BenchOptions options;
+
+        for(int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+
+            if(arg == "--pipeline-statistics") {
+                options.pipeline_statistics = true;
+                continue;
+            }
+
+            if(arg == "--null-device") {
+                options.null_device = true;
+                continue;
+            }
+
+            if(i + 1 >= argc) {
+                std::fprintf(stderr, "%s needs a value\n", argv[i]);
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[i + 1];
+            i++;
+
+            if(arg == "--renderpack") {
+                options.renderpack = value;
+
+            } else if(arg == "--material") {
+                const auto dot = value.find('.');
+                if(dot == std::string_view::npos) {
+                    std::fprintf(stderr, "--material must look like <material>.<pass>\n");
+                    return std::nullopt;
+                }
+                options.material = FullMaterialPassName{std::string{value.substr(0, dot)}, std::string{value.substr(dot + 1)}};
+
+            } else if(arg == "--camera-path") {
+                options.camera_path = value;
+
+            } else if(arg == "--capture") {
+                options.capture = value;
+                options.null_device = true;
+
+            } else if(arg == "--frame-output") {
+                options.frame_output = value;
+
+            } else if(arg == "--output") {
+                options.output = value;
+
+            } else {
+                const std::map<std::string_view, uint32_t*> numbers{
+                    {"--frames", &options.frames},
+                    {"--warmup-frames", &options.warmup_frames},
+                    {"--seed", &options.seed},
+                    {"--meshes", &options.num_meshes},
+                    {"--renderables", &options.num_renderables},
+                    {"--width", &options.width},
+                    {"--height", &options.height},
+                };
+
+                const auto itr = numbers.find(arg);
+                const auto number = parse_uint(value);
+                if(itr == numbers.end() || !number) {
+                    std::fprintf(stderr, "Unknown argument %s %s\n", argv[i - 1], argv[i]);
+                    return std::nullopt;
+                }
+                *itr->second = *number;
+            }
+        }
+
+        if(!options.material) {
+            std::fprintf(stderr, "--material is required, so the benchmark knows what to draw its scene with\n");
+            return std::nullopt;
+        }
+
+        if(options.frames == 0 || options.num_meshes == 0) {
+            std::fprintf(stderr, "--frames and --meshes must be at least one\n");
+            return std::nullopt;
+        }
+
+        return options;
+    }
+
+    std::optional<std::vector<CameraKeyframe>> load_camera_path(const std::string& path) {
+        std::ifstream file{path};
+        if(!file) {
+            std::fprintf(stderr, "Could not open camera path %s\n", path.c_str());
+            return std::nullopt;
+        }
+
+        const auto json = nlohmann::json::parse(file, nullptr, false);
+        if(!json.is_array() || json.empty()) {
+            std::fprintf(stderr, "Camera path %s must be a non-empty array of keyframes\n", path.c_str());
+            return std::nullopt;
+        }
+
+        std::vector<CameraKeyframe> keyframes;
+        keyframes.reserve(json.size());
+        for(const auto& keyframe : json) {
+            const auto position = keyframe.value("position", std::array<float, 3>{});
+            const auto rotation = keyframe.value("rotation", std::array<float, 3>{});
+            keyframes.push_back({{position[0], position[1], position[2]}, {rotation[0], rotation[1], rotation[2]}});
+        }
+
+        return keyframes;
+    }
+
+    /*!
+     * \brief Makes a box with the provided half extents, centered on the origin
+     */
+    void make_box(const glm::vec3& half_extents, std::vector<FullVertex>& vertices, std::vector<uint32_t>& indices) {
+        vertices.clear();
+        indices.clear();
+
+        for(uint32_t corner = 0; corner < 8; corner++) {
+            FullVertex vertex = {};
+            vertex.position = {corner & 1 ? half_extents.x : -half_extents.x,
+                               corner & 2 ? half_extents.y : -half_extents.y,
+                               corner & 4 ? half_extents.z : -half_extents.z};
+            vertex.normal = glm::normalize(vertex.position);
+            vertex.tangent = {1, 0, 0};
+            vertices.push_back(vertex);
+        }
+
+        constexpr std::array<uint32_t, 36> BOX_INDICES = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                                          2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+        indices.assign(BOX_INDICES.begin(), BOX_INDICES.end());
+    }
+
+    CameraKeyframe get_camera_for_frame(const std::vector<CameraKeyframe>& camera_path, const uint32_t frame, const uint32_t num_frames) {
+        const auto progress = static_cast<float>(frame) / static_cast<float>(num_frames);
+
+        if(camera_path.empty()) {
+            // Orbit the scene once over the measured frames
+            const auto angle = progress * glm::two_pi<float>();
+            const auto radius = SCENE_EXTENT * 1.5f;
+            return {{glm::sin(angle) * radius, SCENE_EXTENT * 0.25f, glm::cos(angle) * radius}, {0, angle + glm::pi<float>(), 0}};
+        }
+
+        if(camera_path.size() == 1) {
+            return camera_path[0];
+        }
+
+        const auto position_in_path = progress * static_cast<float>(camera_path.size() - 1);
+        const auto keyframe_idx = std::min(static_cast<size_t>(position_in_path), camera_path.size() - 2);
+        const auto t = position_in_path - static_cast<float>(keyframe_idx);
+
+        const auto& from = camera_path[keyframe_idx];
+        const auto& to = camera_path[keyframe_idx + 1];
+        return {glm::mix(from.position, to.position, t), glm::mix(from.rotation, to.rotation, t)};
+    }
+
+    /*!
+     * \brief Nearest-rank percentile. `values` must be sorted
+     */
+    double percentile(const std::vector<double>& values, const double percent) {
+        if(values.empty()) {
+            return 0;
+        }
+
+        const auto rank = static_cast<size_t>(std::ceil(percent / 100.0 * static_cast<double>(values.size())));
+        return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+    }
+
+    nlohmann::json summarize(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+
+        const auto total = std::accumulate(values.begin(), values.end(), 0.0);
+        return {
+            {"mean", values.empty() ? 0 : total / static_cast<double>(values.size())},
+            {"min", values.empty() ? 0 : values.front()},
+            {"p50", percentile(values, 50)},
+            {"p90", percentile(values, 90)},
+            {"p95", percentile(values, 95)},
+            {"p99", percentile(values, 99)},
+            {"max", values.empty() ? 0 : values.back()},
+        };
+    }
+
+    nlohmann::json to_json(const rhi::RhiCommandListStats& stats, const uint32_t num_frames) {
+        const auto per_frame = [&](const uint64_t value) { return static_cast<double>(value) / static_cast<double>(num_frames); };
+
+        return {
+            {"draw_calls", per_frame(stats.draw_calls)},
+            {"instances", per_frame(stats.instances)},
+            {"triangles", per_frame(stats.triangles)},
+            {"indirect_draw_calls", per_frame(stats.indirect_draw_calls)},
+            {"dispatches", per_frame(stats.dispatches)},
+            {"pipeline_binds", per_frame(stats.pipeline_binds)},
+            {"descriptor_set_binds", per_frame(stats.descriptor_set_binds)},
+            {"buffer_binds", per_frame(stats.buffer_binds)},
+            {"barriers", per_frame(stats.barriers)},
+            {"bytes_uploaded", per_frame(stats.bytes_uploaded)},
+        };
+    }
+
+    /*!
+     * \brief The memory that the scene ended up using. Peaks cover the whole run, loading included
+     */
+    nlohmann::json to_json(const MemoryReport& report) {
+        nlohmann::json categories = nlohmann::json::object();
+        for(const rhi::RhiMemoryAllocationStats& category : report.device.categories) {
+            categories[rhi::memory_category_to_string(category.category)] = {
+                {"allocations", category.num_allocations},
+                {"bytes", category.bytes},
+                {"peak_bytes", category.peak_bytes},
+            };
+        }
+
+        uint64_t renderpack_bytes = 0;
+        for(const rhi::RhiMemoryAllocationStats& owner : report.renderpack_memory) {
+            renderpack_bytes += owner.bytes;
+        }
+
+        return {
+            {"categories", std::move(categories)},
+            {"renderpack_bytes", renderpack_bytes},
+            {"driver_host_bytes", report.device.driver_host_bytes},
+            {"peak_driver_host_bytes", report.device.peak_driver_host_bytes},
+            {"frame_arena_bytes", report.cpu_arenas.frame_arena_bytes},
+            {"material_data_bytes", report.cpu_arenas.material_data_bytes},
+        };
+    }
+
+    /*!
+     * \brief Writes a frame that was read back as a PNG. Only RGBA8 frames can be written
+     */
+    bool write_frame(const ReadbackData& frame, const std::string& path) {
+        const auto num_bytes = static_cast<size_t>(frame.width) * frame.height * 4;
+        if(frame.format != rhi::PixelFormat::Rgba8 || frame.width == 0 || frame.height == 0 || frame.bytes.size() < num_bytes) {
+            std::fprintf(stderr, "The scene output isn't an RGBA8 image, so it can't be written to %s\n", path.c_str());
+            return false;
+        }
+
+        const auto width = static_cast<int>(frame.width);
+        if(stbi_write_png(path.c_str(), width, static_cast<int>(frame.height), 4, frame.bytes.data(), width * 4) == 0) {
+            std::fprintf(stderr, "Could not write %s\n", path.c_str());
+            return false;
+        }
+
+        return true;
+    }
+} // namespace
+
+int main(const int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if(!options) {
+        return 1;
+    }
+
+    std::vector<CameraKeyframe> camera_path;
+    if(!options->camera_path.empty()) {
+        auto loaded_path = load_camera_path(options->camera_path);
+        if(!loaded_path) {
+            return 1;
+        }
+        camera_path = std::move(*loaded_path);
+    }
+
+    NovaSettings settings;
+    settings.window.title = "Nova Benchmark";
+    settings.window.width = options->width;
+    settings.window.height = options->height;
+    settings.window.visible = false;
+    settings.gpu_profiling.enabled = true;
+    settings.gpu_profiling.pipeline_statistics = options->pipeline_statistics;
+    settings.null_device.enabled = options->null_device;
+    settings.null_device.capture_path = options->capture;
+
+    const auto startup_start = Clock::now();
+    NovaRenderer renderer{settings};
+    const auto startup_ms = milliseconds_since(startup_start);
+
+    const auto renderpack_start = Clock::now();
+    renderer.load_renderpack(options->renderpack).wait();
+    const auto renderpack_ms = milliseconds_since(renderpack_start);
+
+    const auto pass_key = renderer.find_material_pass(*options->material);
+    if(!pass_key) {
+        std::fprintf(stderr,
+                     "Renderpack %s has no material pass %s.%s\n",
+                     options->renderpack.c_str(),
+                     options->material->material_name.c_str(),
+                     options->material->pass_name.c_str());
+        return 1;
+    }
+
+    // Everything random comes from this one seeded generator, so the scene is the same every run
+    std::mt19937 rng{options->seed};
+    std::uniform_real_distribution<float> half_extent_distribution{0.25f, 4.0f};
+    std::uniform_real_distribution<float> position_distribution{-SCENE_EXTENT, SCENE_EXTENT};
+    std::uniform_real_distribution<float> angle_distribution{0.0f, glm::two_pi<float>()};
+
+    const auto meshes_start = Clock::now();
+    std::vector<MeshId> meshes;
+    meshes.reserve(options->num_meshes);
+
+    std::vector<FullVertex> vertices;
+    std::vector<uint32_t> indices;
+    for(uint32_t i = 0; i < options->num_meshes; i++) {
+        const glm::vec3 half_extents{half_extent_distribution(rng), half_extent_distribution(rng), half_extent_distribution(rng)};
+        make_box(half_extents, vertices, indices);
+
+        MeshData mesh_data = {};
+        mesh_data.num_vertex_attributes = vertices.size();
+        mesh_data.num_indices = static_cast<uint32_t>(indices.size());
+        mesh_data.vertex_data_ptr = vertices.data();
+        mesh_data.vertex_data_size = vertices.size() * sizeof(FullVertex);
+        mesh_data.index_data_ptr = indices.data();
+        mesh_data.index_data_size = indices.size() * sizeof(uint32_t);
+        mesh_data.bounding_sphere = glm::vec4{0, 0, 0, glm::length(half_extents)};
+
+        meshes.push_back(renderer.create_mesh(mesh_data));
+    }
+    const auto meshes_ms = milliseconds_since(meshes_start);
+
+    const auto renderables_start = Clock::now();
+    for(uint32_t i = 0; i < options->num_renderables; i++) {
+        StaticMeshRenderableCreateInfo create_info = {};
+        create_info.mesh = meshes[i % meshes.size()];
+        create_info.position = {position_distribution(rng), position_distribution(rng), position_distribution(rng)};
+        create_info.rotation = {angle_distribution(rng), angle_distribution(rng), angle_distribution(rng)};
+
+        (void) renderer.add_renderable_for_material(*pass_key, create_info);
+    }
+    const auto renderables_ms = milliseconds_since(renderables_start);
+
+    CameraCreateInfo camera_info = {};
+    camera_info.name = "BenchmarkCamera";
+    camera_info.aspect_ratio = static_cast<float>(options->width) / static_cast<float>(options->height);
+    camera_info.far_plane = SCENE_EXTENT * 4.0f;
+    auto camera = renderer.create_camera(camera_info);
+
+    // Warmup frames get the pipelines, caches, and upload pools into their steady state. They follow the start of the camera path
+    std::vector<double> cpu_frame_ms;
+    cpu_frame_ms.reserve(options->frames);
+
+    std::map<std::string, std::vector<double>> gpu_pass_ms;
+    std::map<std::string, uint32_t> gpu_pass_depths;
+    rhi::RhiCommandListStats total_stats;
+    uint64_t total_frame_arena_escapes = 0;
+
+    std::optional<std::future<std::optional<ReadbackData>>> frame_readback;
+
+    auto& window = renderer.get_window();
+    const auto num_frames = options->warmup_frames + options->frames;
+    for(uint32_t frame = 0; frame < num_frames && !window.should_close(); frame++) {
+        const auto is_measured = frame >= options->warmup_frames;
+        const auto path_frame = is_measured ? frame - options->warmup_frames : 0;
+
+        const auto camera_keyframe = get_camera_for_frame(camera_path, path_frame, options->frames);
+        camera->position = camera_keyframe.position;
+        camera->rotation = camera_keyframe.rotation;
+
+        window.poll_input();
+
+        if(frame + 1 == num_frames && !options->frame_output.empty()) {
+            frame_readback = renderer.request_readback(SCENE_OUTPUT_RT_NAME);
+        }
+
+        const auto frame_start = Clock::now();
+        renderer.execute_frame();
+        const auto frame_ms = milliseconds_since(frame_start);
+
+        if(!is_measured) {
+            continue;
+        }
+
+        cpu_frame_ms.push_back(frame_ms);
+        total_stats += renderer.get_frame_stats();
+        total_frame_arena_escapes += renderer.get_frame_arena_escapes();
+
+        // These lag a few frames behind, so the first few measured frames report the end of the warmup
+        for(const GpuPassTiming& timing : renderer.get_frame_gpu_timings()) {
+            gpu_pass_ms[timing.name].push_back(timing.milliseconds);
+            gpu_pass_depths[timing.name] = timing.depth;
+        }
+    }
+
+    const auto num_measured_frames = static_cast<uint32_t>(cpu_frame_ms.size());
+    if(num_measured_frames == 0) {
+        std::fprintf(stderr, "The window closed before any frames were measured\n");
+        return 1;
+    }
+
+    // Taken before the readback frames, which the measurements don't include either
+    const auto memory_report = renderer.get_memory_report();
+
+    bool wrote_frame = false;
+    if(frame_readback) {
+        // The readback arrives a frame or two after the GPU finishes the last frame, so keep rendering it until then
+        const auto is_ready = [&] { return frame_readback->wait_for(std::chrono::seconds{0}) == std::future_status::ready; };
+        for(uint32_t i = 0; i < MAX_READBACK_FRAMES && !is_ready(); i++) {
+            renderer.execute_frame();
+        }
+
+        if(!is_ready()) {
+            std::fprintf(stderr, "The last frame's scene output never came back, so %s wasn't written\n", options->frame_output.c_str());
+
+        } else if(const auto frame = frame_readback->get()) {
+            wrote_frame = write_frame(*frame, options->frame_output);
+
+        } else {
+            std::fprintf(stderr, "The scene output can't be read back, so %s wasn't written\n", options->frame_output.c_str());
+        }
+    }
+
+    nlohmann::json gpu_passes = nlohmann::json::array();
+    for(auto& [name, samples] : gpu_pass_ms) {
+        auto pass = summarize(std::move(samples));
+        pass["name"] = name;
+        pass["depth"] = gpu_pass_depths[name];
+        gpu_passes.push_back(std::move(pass));
+    }
+
+    nlohmann::json pipeline_statistics = nlohmann::json::array();
+    for(const GpuPassStatistics& pass : renderer.get_frame_pipeline_statistics()) {
+        pipeline_statistics.push_back({
+            {"name", pass.name},
+            {"input_assembly_primitives", pass.statistics.input_assembly_primitives},
+            {"vertex_shader_invocations", pass.statistics.vertex_shader_invocations},
+            {"fragment_shader_invocations", pass.statistics.fragment_shader_invocations},
+        });
+    }
+
+    const nlohmann::json report = {
+        {"options",
+         {
+             {"renderpack", options->renderpack},
+             {"material", options->material->material_name + "." + options->material->pass_name},
+             {"warmup_frames", options->warmup_frames},
+             {"frames", options->frames},
+             {"seed", options->seed},
+             {"meshes", options->num_meshes},
+             {"renderables", options->num_renderables},
+             {"width", options->width},
+             {"height", options->height},
+             {"camera_path", options->camera_path},
+             {"null_device", options->null_device},
+         }},
+        {"load_ms",
+         {
+             {"startup", startup_ms},
+             {"renderpack", renderpack_ms},
+             {"meshes", meshes_ms},
+             {"renderables", renderables_ms},
+         }},
+        {"measured_frames", num_measured_frames},
+        {"cpu_frame_ms", summarize(std::move(cpu_frame_ms))},
+        {"gpu_pass_ms", std::move(gpu_passes)},
+        {"stats_per_frame", to_json(total_stats, num_measured_frames)},
+        {"frame_arena_escapes", total_frame_arena_escapes},
+        {"memory", to_json(memory_report)},
+        {"pipeline_statistics", std::move(pipeline_statistics)},
+        {"frame_output", wrote_frame ? nlohmann::json(options->frame_output) : nlohmann::json()},
+    };
+
+    std::ofstream output{options->output};
+    if(!output) {
+        std::fprintf(stderr, "Could not write %s\n", options->output.c_str());
+        return 1;
+    }
+    output << report.dump(4) << '\n';
+
+    return 0;
+}
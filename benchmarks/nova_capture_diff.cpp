@@ -0,0 +1,166 @@
+/*!
+ * \brief Compares two command captures from the null render device, and tells you where they start to differ
+ *
+ * Usage: nova-capture-diff <expected capture> <actual capture>
+ *        nova-capture-diff --dump <capture>
+ *
+ * Exits with 0 if the captures match, 1 if they don't, and 2 if either one can't be read. `--dump` prints every submission in a
+ * capture, which is handy when you want to read through a frame yourself
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rhi/null/null_command_stream.hpp"
+
+using namespace nova::renderer::rhi;
+
+namespace {
+    /*!
+     * \brief How many lines to print before and after the first line that differs
+     */
+    constexpr size_t CONTEXT_LINES = 3;
+
+    std::vector<std::string> split_lines(const std::string& text) {
+        std::vector<std::string> lines;
+        std::istringstream stream{text};
+        std::string line;
+        while(std::getline(stream, line)) {
+            lines.push_back(line);
+        }
+
+        return lines;
+    }
+
+    const char* to_string(const QueueType queue) {
+        switch(queue) {
+            case QueueType::Graphics:
+                return "graphics";
+            case QueueType::Transfer:
+                return "transfer";
+            case QueueType::AsyncCompute:
+                return "async compute";
+        }
+
+        return "unknown";
+    }
+
+    void print_context(const char* label, const std::vector<std::string>& lines, const size_t first_line, const size_t differing_line) {
+        std::printf("%s:\n", label);
+
+        const auto last_line = std::min(lines.size(), differing_line + CONTEXT_LINES + 1);
+        for(size_t i = first_line; i < last_line; i++) {
+            std::printf("%c %5zu  %s\n", i == differing_line ? '>' : ' ', i + 1, lines[i].c_str());
+        }
+
+        if(differing_line >= lines.size()) {
+            std::printf("> %5zu  <end of submission>\n", lines.size() + 1);
+        }
+    }
+
+    int dump(const std::string& path) {
+        const auto capture = read_capture(path);
+        if(!capture.has_value) {
+            std::fprintf(stderr, "Could not read %s: %s\n", path.c_str(), capture.error.to_string().c_str());
+            return 2;
+        }
+
+        for(size_t i = 0; i < capture->size(); i++) {
+            const auto& submission = (*capture)[i];
+            std::printf("Submission %zu, frame %llu, %s queue\n",
+                        i,
+                        static_cast<unsigned long long>(submission.frame_idx),
+                        to_string(submission.queue));
+            std::printf("%s\n", disassemble_command_stream(submission.commands).c_str());
+        }
+
+        return 0;
+    }
+
+    int diff(const std::string& expected_path, const std::string& actual_path) {
+        const auto expected = read_capture(expected_path);
+        if(!expected.has_value) {
+            std::fprintf(stderr, "Could not read %s: %s\n", expected_path.c_str(), expected.error.to_string().c_str());
+            return 2;
+        }
+
+        const auto actual = read_capture(actual_path);
+        if(!actual.has_value) {
+            std::fprintf(stderr, "Could not read %s: %s\n", actual_path.c_str(), actual.error.to_string().c_str());
+            return 2;
+        }
+
+        const auto num_submissions = std::min(expected->size(), actual->size());
+        for(size_t i = 0; i < num_submissions; i++) {
+            const auto& expected_submission = (*expected)[i];
+            const auto& actual_submission = (*actual)[i];
+
+            if(expected_submission.frame_idx != actual_submission.frame_idx || expected_submission.queue != actual_submission.queue) {
+                std::printf("Submission %zu is frame %llu on the %s queue in %s, but frame %llu on the %s queue in %s\n",
+                            i,
+                            static_cast<unsigned long long>(expected_submission.frame_idx),
+                            to_string(expected_submission.queue),
+                            expected_path.c_str(),
+                            static_cast<unsigned long long>(actual_submission.frame_idx),
+                            to_string(actual_submission.queue),
+                            actual_path.c_str());
+                return 1;
+            }
+
+            // Equal bytes disassemble to equal text, so only bother with the text when there's a difference to show
+            if(expected_submission.commands == actual_submission.commands) {
+                continue;
+            }
+
+            const auto expected_lines = split_lines(disassemble_command_stream(expected_submission.commands));
+            const auto actual_lines = split_lines(disassemble_command_stream(actual_submission.commands));
+
+            size_t differing_line = 0;
+            while(differing_line < expected_lines.size() && differing_line < actual_lines.size() &&
+                  expected_lines[differing_line] == actual_lines[differing_line]) {
+                differing_line++;
+            }
+
+            std::printf("Submission %zu (frame %llu, %s queue) differs at line %zu\n",
+                        i,
+                        static_cast<unsigned long long>(expected_submission.frame_idx),
+                        to_string(expected_submission.queue),
+                        differing_line + 1);
+
+            const auto first_line = differing_line > CONTEXT_LINES ? differing_line - CONTEXT_LINES : 0;
+            print_context(expected_path.c_str(), expected_lines, first_line, differing_line);
+            print_context(actual_path.c_str(), actual_lines, first_line, differing_line);
+            return 1;
+        }
+
+        if(expected->size() != actual->size()) {
+            std::printf("%s has %zu submissions, but %s has %zu\n",
+                        expected_path.c_str(),
+                        expected->size(),
+                        actual_path.c_str(),
+                        actual->size());
+            return 1;
+        }
+
+        std::printf("The captures match, %zu submissions\n", num_submissions);
+        return 0;
+    }
+} // namespace
+
+int main(const int argc, char** argv) {
+    if(argc == 3 && std::string_view{argv[1]} == "--dump") {
+        return dump(argv[2]);
+    }
+
+    if(argc != 3) {
+        std::fprintf(stderr, "Usage: nova-capture-diff <expected capture> <actual capture>\n       nova-capture-diff --dump <capture>\n");
+        return 2;
+    }
+
+    return diff(argv[1], argv[2]);
+}
@@ -0,0 +1,549 @@
+/*!
+ * \brief Runs a suite of nova-bench scenes and compares their timings, counters, memory, and final frames with stored baselines
+ *
+ * Usage: nova-regress <suite> [--bench <nova-bench>] [--work-dir <directory>] [--output <file>] [--update-baselines]
+ *
+ * A suite is a JSON file like this. Paths in it are relative to the suite file, and `tolerances` in a case override the suite's
+ *
+ *     {
+ *         "frames": 300,
+ *         "warmup_frames": 60,
+ *         "tolerances": {"cpu_frame_ms": 0.1, "gpu_pass_ms": 0.15, "counters": 0.0, "memory": 0.05,
+ *                        "max_channel_difference": 2, "max_differing_pixels": 0.001},
+ *         "cases": [
+ *             {"name": "default", "args": ["--material", "gbuffers_terrain.forward"], "baseline": "baselines/default.json",
+ *              "golden_frame": "golden/default.png"}
+ *         ]
+ *     }
+ *
+ * Time and counter tolerances are how much higher than the baseline a value may go, as a fraction of the baseline. Lower is
+ * never a regression. A frame regresses when more than `max_differing_pixels` of its pixels have a channel that's more than
+ * `max_channel_difference` away from the golden frame
+ *
+ * Exits with 0 if every case matches its baseline, 1 if any regressed, and 2 if the suite can't be run.
+ * `--update-baselines` runs the suite and stores its results as the new baselines and golden frames
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <stb_image.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct Tolerances {
+        double cpu_frame_ms = 0.1;
+
+        double gpu_pass_ms = 0.15;
+
+        /*!
+         * \brief Draw calls, binds, barriers, uploads, and frame arena escapes. The scene is deterministic, so these shouldn't move
+         */
+        double counters = 0.0;
+
+        double memory = 0.05;
+
+        uint32_t max_channel_difference = 2;
+
+        /*!
+         * \brief The fraction of a frame's pixels that may differ by more than `max_channel_difference`
+         */
+        double max_differing_pixels = 0.001;
+    };
+
+    struct RegressCase {
+        std::string name;
+
+        std::vector<std::string> args;
+
+        fs::path baseline;
+
+        /*!
+         * \brief The frame to compare the last frame's scene output with. Empty means the case doesn't compare frames
+         */
+        fs::path golden_frame;
+
+        Tolerances tolerances;
+    };
+
+    struct RegressSuite {
+        uint32_t frames = 300;
+
+        uint32_t warmup_frames = 60;
+
+        std::vector<RegressCase> cases;
+    };
+
+    struct RegressOptions {
+        std::string suite;
+
+        std::string bench = "nova-bench";
+
+        std::string work_dir = "nova-regress";
+
+        std::string output = "nova-regress.json";
+
+        bool update_baselines = false;
+    };
+
+    void read_tolerances(const nlohmann::json& json, Tolerances& tolerances) {
+        tolerances.cpu_frame_ms = json.value("cpu_frame_ms", tolerances.cpu_frame_ms);
+        tolerances.gpu_pass_ms = json.value("gpu_pass_ms", tolerances.gpu_pass_ms);
+        tolerances.counters = json.value("counters", tolerances.counters);
+        tolerances.memory = json.value("memory", tolerances.memory);
+        tolerances.max_channel_difference = json.value("max_channel_difference", tolerances.max_channel_difference);
+        tolerances.max_differing_pixels = json.value("max_differing_pixels", tolerances.max_differing_pixels);
+    }
+
+    std::optional<nlohmann::json> load_json(const fs::path& path) {
+        std::ifstream file{path};
+        if(!file) {
+            std::fprintf(stderr, "Could not open %s\n", path.string().c_str());
+            return std::nullopt;
+        }
+
+        try {
+            return nlohmann::json::parse(file);
+        }
+        catch(const nlohmann::json::exception& e) {
+            std::fprintf(stderr, "Could not parse %s: %s\n", path.string().c_str(), e.what());
+            return std::nullopt;
+        }
+    }
+
+    std::optional<RegressSuite> load_suite(const fs::path& path) {
+        const auto json = load_json(path);
+        if(!json) {
+            return std::nullopt;
+        }
+
+        const auto suite_dir = path.parent_path();
+
+        try {
+            RegressSuite suite;
+            suite.frames = json->value("frames", suite.frames);
+            suite.warmup_frames = json->value("warmup_frames", suite.warmup_frames);
+
+            Tolerances suite_tolerances;
+            if(const auto itr = json->find("tolerances"); itr != json->end()) {
+                read_tolerances(*itr, suite_tolerances);
+            }
+
+            for(const auto& case_json : json->at("cases")) {
+                RegressCase regress_case;
+                regress_case.name = case_json.at("name").get<std::string>();
+                regress_case.args = case_json.value("args", std::vector<std::string>{});
+                regress_case.baseline = suite_dir / case_json.at("baseline").get<std::string>();
+                if(const auto itr = case_json.find("golden_frame"); itr != case_json.end()) {
+                    regress_case.golden_frame = suite_dir / itr->get<std::string>();
+                }
+
+                regress_case.tolerances = suite_tolerances;
+                if(const auto itr = case_json.find("tolerances"); itr != case_json.end()) {
+                    read_tolerances(*itr, regress_case.tolerances);
+                }
+
+                suite.cases.push_back(std::move(regress_case));
+            }
+
+            return suite;
+        }
+        catch(const nlohmann::json::exception& e) {
+            std::fprintf(stderr, "%s isn't a valid suite: %s\n", path.string().c_str(), e.what());
+            return std::nullopt;
+        }
+    }
+
+    std::optional<RegressOptions> parse_options(const int argc, char** argv) {
+        RegressOptions options;
+
+        for(int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+
+            if(arg == "--update-baselines") {
+                options.update_baselines = true;
+                continue;
+            }
+
+            if(arg.substr(0, 2) != "--") {
+                options.suite = arg;
+                continue;
+            }
+
+            if(i + 1 >= argc) {
+                std::fprintf(stderr, "%s needs a value\n", argv[i]);
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[i + 1];
+            i++;
+
+            if(arg == "--bench") {
+                options.bench = value;
+
+            } else if(arg == "--work-dir") {
+                options.work_dir = value;
+
+            } else if(arg == "--output") {
+                options.output = value;
+
+            } else {
+                std::fprintf(stderr, "Unknown argument %s\n", argv[i - 1]);
+                return std::nullopt;
+            }
+        }
+
+        if(options.suite.empty()) {
+            std::fprintf(stderr,
+                         "Usage: nova-regress <suite> [--bench <nova-bench>] [--work-dir <directory>] [--output <file>] "
+                         "[--update-baselines]\n");
+            return std::nullopt;
+        }
+
+        return options;
+    }
+
+    std::string quote(const std::string& arg) {
+        std::string quoted = "\"";
+        for(const char c : arg) {
+            if(c == '"' || c == '\\') {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        quoted += '"';
+
+        return quoted;
+    }
+
+    /*!
+     * \brief Runs nova-bench for one case, and returns whether it succeeded
+     */
+    bool run_bench(const RegressOptions& options,
+                   const RegressSuite& suite,
+                   const RegressCase& regress_case,
+                   const fs::path& results_path,
+                   const fs::path& frame_path) {
+        std::string command = quote(options.bench);
+        for(const std::string& arg : regress_case.args) {
+            command += " " + quote(arg);
+        }
+
+        command += " --frames " + std::to_string(suite.frames);
+        command += " --warmup-frames " + std::to_string(suite.warmup_frames);
+        command += " --output " + quote(results_path.string());
+        if(!regress_case.golden_frame.empty()) {
+            command += " --frame-output " + quote(frame_path.string());
+        }
+
+        std::printf("Running %s\n", regress_case.name.c_str());
+        std::fflush(stdout);
+
+        if(const auto result = std::system(command.c_str()); result != 0) {
+            std::fprintf(stderr, "nova-bench failed for %s with %d\n", regress_case.name.c_str(), result);
+            return false;
+        }
+
+        return true;
+    }
+
+    /*!
+     * \brief Compares every metric that's in both the baseline and the results
+     */
+    struct MetricComparer {
+        nlohmann::json metrics = nlohmann::json::array();
+
+        bool passed = true;
+
+        void compare(const std::string& name, const nlohmann::json* baseline, const nlohmann::json* actual, const double tolerance) {
+            if(baseline == nullptr || actual == nullptr || !baseline->is_number() || !actual->is_number()) {
+                return;
+            }
+
+            const auto baseline_value = baseline->get<double>();
+            const auto actual_value = actual->get<double>();
+            const auto limit = baseline_value * (1.0 + tolerance);
+            const auto metric_passed = actual_value <= limit;
+
+            metrics.push_back({
+                {"name", name},
+                {"baseline", baseline_value},
+                {"actual", actual_value},
+                {"change", baseline_value == 0 ? 0.0 : actual_value / baseline_value - 1.0},
+                {"tolerance", tolerance},
+                {"passed", metric_passed},
+            });
+
+            if(!metric_passed) {
+                std::printf("  %s regressed: %g -> %g\n", name.c_str(), baseline_value, actual_value);
+                passed = false;
+            }
+        }
+
+        void compare_objects(const std::string& prefix,
+                             const nlohmann::json& baseline,
+                             const nlohmann::json& actual,
+                             const std::string& key,
+                             const double tolerance) {
+            const auto baseline_itr = baseline.find(key);
+            const auto actual_itr = actual.find(key);
+            if(baseline_itr == baseline.end() || actual_itr == actual.end() || !baseline_itr->is_object()) {
+                return;
+            }
+
+            for(const auto& [name, value] : baseline_itr->items()) {
+                const auto actual_value = actual_itr->find(name);
+                compare(prefix + name, &value, actual_value == actual_itr->end() ? nullptr : &*actual_value, tolerance);
+            }
+        }
+    };
+
+    const nlohmann::json* find(const nlohmann::json& json, const std::string& key) {
+        const auto itr = json.find(key);
+        return itr == json.end() ? nullptr : &*itr;
+    }
+
+    const nlohmann::json* find_pass(const nlohmann::json& passes, const std::string& name) {
+        const auto itr = std::find_if(passes.begin(), passes.end(), [&](const nlohmann::json& pass) {
+            return pass.value("name", "") == name;
+        });
+        return itr == passes.end() ? nullptr : &*itr;
+    }
+
+    void compare_results(const nlohmann::json& baseline, const nlohmann::json& actual, const Tolerances& tolerances, MetricComparer& comparer) {
+        for(const auto* percentile : {"p50", "p95"}) {
+            const auto* baseline_cpu = find(baseline, "cpu_frame_ms");
+            const auto* actual_cpu = find(actual, "cpu_frame_ms");
+            if(baseline_cpu != nullptr && actual_cpu != nullptr) {
+                comparer.compare(std::string{"cpu_frame_ms."} + percentile,
+                                 find(*baseline_cpu, percentile),
+                                 find(*actual_cpu, percentile),
+                                 tolerances.cpu_frame_ms);
+            }
+        }
+
+        // Passes that the baseline doesn't have are new work, which the counters below catch if it's more than it should be
+        if(const auto* baseline_passes = find(baseline, "gpu_pass_ms"); baseline_passes != nullptr && baseline_passes->is_array()) {
+            const auto* actual_passes = find(actual, "gpu_pass_ms");
+            for(const auto& baseline_pass : *baseline_passes) {
+                const auto name = baseline_pass.value("name", "");
+                const auto* actual_pass = actual_passes != nullptr ? find_pass(*actual_passes, name) : nullptr;
+                if(actual_pass != nullptr) {
+                    comparer.compare("gpu_pass_ms." + name + ".p50", find(baseline_pass, "p50"), find(*actual_pass, "p50"), tolerances.gpu_pass_ms);
+                }
+            }
+        }
+
+        comparer.compare_objects("stats_per_frame.", baseline, actual, "stats_per_frame", tolerances.counters);
+        comparer.compare("frame_arena_escapes", find(baseline, "frame_arena_escapes"), find(actual, "frame_arena_escapes"), tolerances.counters);
+
+        const auto* baseline_memory = find(baseline, "memory");
+        const auto* actual_memory = find(actual, "memory");
+        if(baseline_memory == nullptr || actual_memory == nullptr) {
+            return;
+        }
+
+        if(const auto* baseline_categories = find(*baseline_memory, "categories"); baseline_categories != nullptr) {
+            const auto* actual_categories = find(*actual_memory, "categories");
+            for(const auto& [category, value] : baseline_categories->items()) {
+                const auto* actual_category = actual_categories != nullptr ? find(*actual_categories, category) : nullptr;
+                comparer.compare("memory." + category + ".bytes",
+                                 find(value, "bytes"),
+                                 actual_category != nullptr ? find(*actual_category, "bytes") : nullptr,
+                                 tolerances.memory);
+            }
+        }
+
+        for(const auto* key : {"renderpack_bytes", "driver_host_bytes", "frame_arena_bytes", "material_data_bytes"}) {
+            comparer.compare(std::string{"memory."} + key, find(*baseline_memory, key), find(*actual_memory, key), tolerances.memory);
+        }
+    }
+
+    using StbiPixels = std::unique_ptr<stbi_uc, decltype(&stbi_image_free)>;
+
+    StbiPixels load_rgba(const fs::path& path, int& width, int& height) {
+        int num_channels = 0;
+        return {stbi_load(path.string().c_str(), &width, &height, &num_channels, 4), &stbi_image_free};
+    }
+
+    /*!
+     * \brief Compares a case's final frame with its golden frame, and returns the part of the report that describes it
+     */
+    nlohmann::json compare_frames(const fs::path& golden_path, const fs::path& actual_path, const Tolerances& tolerances, bool& passed) {
+        int golden_width = 0;
+        int golden_height = 0;
+        const auto golden = load_rgba(golden_path, golden_width, golden_height);
+
+        int actual_width = 0;
+        int actual_height = 0;
+        const auto actual = load_rgba(actual_path, actual_width, actual_height);
+
+        if(!golden || !actual) {
+            passed = false;
+            const auto& missing_path = !golden ? golden_path : actual_path;
+            std::printf("  Could not read %s\n", missing_path.string().c_str());
+            return {{"passed", false}, {"error", "Could not read " + missing_path.string()}};
+        }
+
+        if(golden_width != actual_width || golden_height != actual_height) {
+            passed = false;
+            std::printf("  The frame is %dx%d, but the golden frame is %dx%d\n", actual_width, actual_height, golden_width, golden_height);
+            return {{"passed", false}, {"error", "The frame and the golden frame are different sizes"}};
+        }
+
+        const auto num_pixels = static_cast<size_t>(golden_width) * golden_height;
+        size_t differing_pixels = 0;
+        uint32_t max_difference = 0;
+        for(size_t pixel = 0; pixel < num_pixels; pixel++) {
+            uint32_t pixel_difference = 0;
+            for(size_t channel = pixel * 4; channel < pixel * 4 + 4; channel++) {
+                const auto difference = std::abs(static_cast<int>(golden.get()[channel]) - static_cast<int>(actual.get()[channel]));
+                pixel_difference = std::max(pixel_difference, static_cast<uint32_t>(difference));
+            }
+
+            max_difference = std::max(max_difference, pixel_difference);
+            if(pixel_difference > tolerances.max_channel_difference) {
+                differing_pixels++;
+            }
+        }
+
+        const auto differing_fraction = static_cast<double>(differing_pixels) / static_cast<double>(num_pixels);
+        const auto frame_passed = differing_fraction <= tolerances.max_differing_pixels;
+        if(!frame_passed) {
+            std::printf("  %zu of %zu pixels differ from the golden frame\n", differing_pixels, num_pixels);
+            passed = false;
+        }
+
+        return {
+            {"passed", frame_passed},
+            {"differing_pixels", differing_pixels},
+            {"differing_fraction", differing_fraction},
+            {"max_channel_difference", max_difference},
+        };
+    }
+
+    bool update_baseline(const RegressCase& regress_case, const fs::path& results_path, const fs::path& frame_path) {
+        std::error_code error;
+        fs::create_directories(regress_case.baseline.parent_path(), error);
+        fs::copy_file(results_path, regress_case.baseline, fs::copy_options::overwrite_existing, error);
+        if(error) {
+            std::fprintf(stderr, "Could not write %s: %s\n", regress_case.baseline.string().c_str(), error.message().c_str());
+            return false;
+        }
+
+        if(!regress_case.golden_frame.empty()) {
+            fs::create_directories(regress_case.golden_frame.parent_path(), error);
+            fs::copy_file(frame_path, regress_case.golden_frame, fs::copy_options::overwrite_existing, error);
+            if(error) {
+                std::fprintf(stderr, "Could not write %s: %s\n", regress_case.golden_frame.string().c_str(), error.message().c_str());
+                return false;
+            }
+        }
+
+        std::printf("Updated the baseline for %s\n", regress_case.name.c_str());
+        return true;
+    }
+} // namespace
+
+int main(const int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if(!options) {
+        return 2;
+    }
+
+    const auto suite = load_suite(options->suite);
+    if(!suite) {
+        return 2;
+    }
+
+    std::error_code error;
+    fs::create_directories(options->work_dir, error);
+    if(error) {
+        std::fprintf(stderr, "Could not create %s: %s\n", options->work_dir.c_str(), error.message().c_str());
+        return 2;
+    }
+
+    bool ran_everything = true;
+    bool passed = true;
+    nlohmann::json cases = nlohmann::json::array();
+
+    for(const RegressCase& regress_case : suite->cases) {
+        const auto results_path = fs::path{options->work_dir} / (regress_case.name + ".json");
+        const auto frame_path = fs::path{options->work_dir} / (regress_case.name + ".png");
+
+        if(!run_bench(*options, *suite, regress_case, results_path, frame_path)) {
+            ran_everything = false;
+            cases.push_back({{"name", regress_case.name}, {"passed", false}, {"error", "nova-bench failed"}});
+            continue;
+        }
+
+        if(options->update_baselines) {
+            ran_everything &= update_baseline(regress_case, results_path, frame_path);
+            continue;
+        }
+
+        const auto baseline = load_json(regress_case.baseline);
+        const auto actual = load_json(results_path);
+        if(!baseline || !actual) {
+            ran_everything = false;
+            cases.push_back({{"name", regress_case.name}, {"passed", false}, {"error", "Could not read the baseline or the results"}});
+            continue;
+        }
+
+        MetricComparer comparer;
+        compare_results(*baseline, *actual, regress_case.tolerances, comparer);
+
+        nlohmann::json case_report = {
+            {"name", regress_case.name},
+            {"results", results_path.string()},
+            {"metrics", std::move(comparer.metrics)},
+        };
+
+        bool case_passed = comparer.passed;
+        if(!regress_case.golden_frame.empty()) {
+            case_report["frame"] = compare_frames(regress_case.golden_frame, frame_path, regress_case.tolerances, case_passed);
+        }
+
+        case_report["passed"] = case_passed;
+        std::printf("  %s\n", case_passed ? "Passed" : "Regressed");
+
+        passed &= case_passed;
+        cases.push_back(std::move(case_report));
+    }
+
+    if(options->update_baselines) {
+        return ran_everything ? 0 : 2;
+    }
+
+    const nlohmann::json report = {
+        {"suite", options->suite},
+        {"frames", suite->frames},
+        {"warmup_frames", suite->warmup_frames},
+        {"passed", passed && ran_everything},
+        {"cases", std::move(cases)},
+    };
+
+    std::ofstream output{options->output};
+    if(!output) {
+        std::fprintf(stderr, "Could not write %s\n", options->output.c_str());
+        return 2;
+    }
+    output << report.dump(4) << '\n';
+
+    if(!ran_everything) {
+        return 2;
+    }
+
+    return passed ? 0 : 1;
+}
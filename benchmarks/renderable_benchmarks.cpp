@@ -0,0 +1,162 @@
+/*!
+ * \brief Benchmarks for adding and updating static mesh renderables
+ *
+ * `NovaRenderer` can't be made without a window and a Vulkan device, so these do what `add_renderable_for_material` and
+ * `update_renderables` do for each renderable, on the same containers: build the model matrix, append to the batch's
+ * `RenderableColumns`, and keep the id to location map up to date
+ */
+
+#include <memory>
+#include <random>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "nova_renderer/renderables.hpp"
+
+using namespace nova::renderer;
+
+namespace {
+    /*!
+     * \brief Renderables are spread over this many mesh batches, about what a renderpack with a handful of materials ends up with
+     */
+    constexpr uint32_t NUM_BATCHES = 256;
+
+    struct RenderableLocation {
+        uint32_t batch_idx;
+        uint32_t renderable_idx;
+    };
+
+    struct Scene {
+        std::vector<RenderableColumns> batches{NUM_BATCHES};
+
+        std::unordered_map<RenderableId, RenderableLocation> locations;
+
+        RenderableId next_id = 0;
+
+        RenderableId add(const StaticMeshRenderableCreateInfo& create_info, const uint32_t batch_idx) {
+            const auto id = next_id;
+            next_id++;
+
+            const auto renderable_idx = batches[batch_idx].add(id, make_model_matrix(create_info), create_info.visible);
+            locations.emplace(id, RenderableLocation{batch_idx, renderable_idx});
+
+            return id;
+        }
+    };
+
+    std::vector<StaticMeshRenderableUpdate> make_updates(const uint32_t num_renderables, const uint32_t seed) {
+        std::mt19937 rng{seed};
+        std::uniform_real_distribution<float> position{-1000.0f, 1000.0f};
+        std::uniform_real_distribution<float> angle{0.0f, 6.28f};
+
+        std::vector<StaticMeshRenderableUpdate> updates(num_renderables);
+        for(uint32_t i = 0; i < num_renderables; i++) {
+            updates[i].renderable = i;
+            updates[i].data.position = {position(rng), position(rng), position(rng)};
+            updates[i].data.rotation = {angle(rng), angle(rng), angle(rng)};
+        }
+
+        return updates;
+    }
+
+    std::unique_ptr<Scene> make_scene(const std::vector<StaticMeshRenderableUpdate>& renderables) {
+        auto scene = std::make_unique<Scene>();
+        for(const auto& renderable : renderables) {
+            StaticMeshRenderableCreateInfo create_info = {};
+            static_cast<StaticMeshRenderableUpdateData&>(create_info) = renderable.data;
+
+            scene->add(create_info, static_cast<uint32_t>(renderable.renderable % NUM_BATCHES));
+        }
+
+        return scene;
+    }
+
+    void BM_AddRenderables(benchmark::State& state) {
+        const auto num_renderables = static_cast<uint32_t>(state.range(0));
+        const auto renderables = make_updates(num_renderables, 1);
+
+        std::unique_ptr<Scene> scene;
+        for(auto _ : state) {
+            state.PauseTiming();
+            scene = std::make_unique<Scene>();
+            state.ResumeTiming();
+
+            for(const auto& renderable : renderables) {
+                StaticMeshRenderableCreateInfo create_info = {};
+                static_cast<StaticMeshRenderableUpdateData&>(create_info) = renderable.data;
+
+                benchmark::DoNotOptimize(scene->add(create_info, static_cast<uint32_t>(renderable.renderable % NUM_BATCHES)));
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * num_renderables);
+    }
+
+    /*!
+     * \brief Updates every renderable with one call to `update_renderables`, like streaming in a chunk does
+     */
+    void BM_UpdateRenderables(benchmark::State& state) {
+        const auto num_renderables = static_cast<uint32_t>(state.range(0));
+        const auto scene = make_scene(make_updates(num_renderables, 1));
+        const auto updates = make_updates(num_renderables, 2);
+
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> rotations;
+        std::vector<glm::vec3> scales;
+        std::vector<glm::mat4> model_matrices;
+
+        for(auto _ : state) {
+            positions.clear();
+            rotations.clear();
+            scales.clear();
+            for(const auto& update : updates) {
+                positions.push_back(update.data.position);
+                rotations.push_back(update.data.rotation);
+                scales.push_back(update.data.scale);
+            }
+
+            model_matrices.resize(updates.size());
+            make_model_matrices(positions, rotations, scales, model_matrices);
+
+            for(size_t i = 0; i < updates.size(); i++) {
+                const auto& location = scene->locations.at(updates[i].renderable);
+                auto& batch = scene->batches[location.batch_idx];
+                batch.model_matrices[location.renderable_idx] = model_matrices[i];
+                batch.visibilities[location.renderable_idx] = updates[i].data.visible ? 1 : 0;
+            }
+
+            benchmark::ClobberMemory();
+        }
+
+        state.SetItemsProcessed(state.iterations() * num_renderables);
+    }
+
+    /*!
+     * \brief Updates every renderable with its own call, like `update_renderable` does
+     */
+    void BM_UpdateRenderablesOneAtATime(benchmark::State& state) {
+        const auto num_renderables = static_cast<uint32_t>(state.range(0));
+        const auto scene = make_scene(make_updates(num_renderables, 1));
+        const auto updates = make_updates(num_renderables, 2);
+
+        for(auto _ : state) {
+            for(const auto& update : updates) {
+                const auto& location = scene->locations.at(update.renderable);
+                auto& batch = scene->batches[location.batch_idx];
+                batch.model_matrices[location.renderable_idx] = make_model_matrix(update.data);
+                batch.visibilities[location.renderable_idx] = update.data.visible ? 1 : 0;
+            }
+
+            benchmark::ClobberMemory();
+        }
+
+        state.SetItemsProcessed(state.iterations() * num_renderables);
+    }
+} // namespace
+
+BENCHMARK(BM_AddRenderables)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_UpdateRenderables)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_UpdateRenderablesOneAtATime)->RangeMultiplier(10)->Range(10'000, 1'000'000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,105 @@
+/*!
+ * \brief Benchmarks for compiling a render graph: ordering its passes and working out which of its textures can share memory
+ */
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "nova_renderer/constants.hpp"
+
+#include "loading/renderpack/render_graph_builder.hpp"
+
+using namespace nova::renderer;
+using namespace renderpack;
+
+namespace {
+    std::string texture_name(const uint32_t pass_idx) { return "Texture" + std::to_string(pass_idx); }
+
+    /*!
+     * \brief Makes a chain of passes where each pass reads the previous pass's output and the output of the pass halfway back, so the
+     * graph has plenty of long-lived textures next to short-lived ones. The last pass writes the backbuffer
+     *
+     * The passes come back shuffled, so `order_passes` has to do real work
+     */
+    std::vector<RenderPassCreateInfo> make_passes(const uint32_t num_passes) {
+        std::vector<RenderPassCreateInfo> passes(num_passes);
+        for(uint32_t i = 0; i < num_passes; i++) {
+            auto& pass = passes[i];
+            pass.name = "Pass" + std::to_string(i);
+
+            if(i > 0) {
+                pass.texture_inputs.push_back(texture_name(i - 1));
+            }
+            if(i / 2 > 0 && i / 2 != i - 1) {
+                pass.texture_inputs.push_back(texture_name(i / 2));
+            }
+
+            TextureAttachmentInfo output = {};
+            output.name = i == num_passes - 1 ? BACKBUFFER_NAME : texture_name(i);
+            output.pixel_format = rhi::PixelFormat::Rgba8;
+            output.clear = true;
+            pass.texture_outputs.push_back(output);
+
+            pass.pipeline_names.push_back("Pipeline" + std::to_string(i));
+        }
+
+        std::mt19937 rng{1};
+        std::shuffle(passes.begin(), passes.end(), rng);
+
+        return passes;
+    }
+
+    std::unordered_map<std::string, TextureCreateInfo> make_textures(const uint32_t num_passes) {
+        std::unordered_map<std::string, TextureCreateInfo> textures;
+        for(uint32_t i = 0; i + 1 < num_passes; i++) {
+            TextureCreateInfo texture = {};
+            texture.name = texture_name(i);
+            texture.usage = ImageUsage::RenderTarget;
+            texture.format.pixel_format = rhi::PixelFormat::Rgba8;
+            textures.emplace(texture.name, texture);
+        }
+
+        return textures;
+    }
+
+    void BM_OrderPasses(benchmark::State& state) {
+        const auto passes = make_passes(static_cast<uint32_t>(state.range(0)));
+
+        for(auto _ : state) {
+            auto ordered_passes = order_passes(passes);
+            benchmark::DoNotOptimize(ordered_passes);
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void BM_DetermineAliasingOfTextures(benchmark::State& state) {
+        const auto num_passes = static_cast<uint32_t>(state.range(0));
+        const auto ordered_passes = order_passes(make_passes(num_passes));
+        if(!ordered_passes.has_value) {
+            state.SkipWithError(ordered_passes.error.to_string().c_str());
+            return;
+        }
+
+        const auto textures = make_textures(num_passes);
+
+        for(auto _ : state) {
+            std::unordered_map<std::string, Range> resource_used_range;
+            std::vector<std::string> resources_in_order;
+            determine_usage_order_of_textures(*ordered_passes, resource_used_range, resources_in_order);
+
+            auto aliases = determine_aliasing_of_textures(textures, resource_used_range, resources_in_order);
+            benchmark::DoNotOptimize(aliases);
+        }
+
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+} // namespace
+
+BENCHMARK(BM_OrderPasses)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_DetermineAliasingOfTextures)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
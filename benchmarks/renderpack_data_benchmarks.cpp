@@ -0,0 +1,77 @@
+/*!
+ * \brief Benchmarks for parsing a renderpack's render graph and pipelines from JSON
+ *
+ * The JSON text is built once up front, so each iteration times what loading a renderpack does: parse the text, then read the
+ * renderpack structs out of it
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+
+#include "nova_renderer/renderpack_data.hpp"
+
+using namespace nova::renderer::renderpack;
+
+namespace {
+    std::string make_rendergraph_json(const uint32_t num_passes) {
+        auto passes = nlohmann::json::array();
+        for(uint32_t i = 0; i < num_passes; i++) {
+            nlohmann::json pass = {{"name", "Pass" + std::to_string(i)},
+                                   {"textureOutputs", {{{"name", "Texture" + std::to_string(i)}, {"clear", true}}}},
+                                   {"depthTexture", {{"name", "Depth"}, {"clear", i == 0}}}};
+            if(i > 0) {
+                pass["textureInputs"] = {"Texture" + std::to_string(i - 1)};
+            }
+
+            passes.push_back(pass);
+        }
+
+        return nlohmann::json{{"passes", passes}, {"builtinPasses", {"BackbufferOutput"}}}.dump();
+    }
+
+    std::string make_pipelines_json(const uint32_t num_pipelines) {
+        auto pipelines = nlohmann::json::array();
+        for(uint32_t i = 0; i < num_pipelines; i++) {
+            pipelines.push_back({{"name", "Pipeline" + std::to_string(i)},
+                                 {"pass", "Pass" + std::to_string(i % 8)},
+                                 {"defined", {"USE_NORMAL_MAPPING", "USE_SHADOWS"}},
+                                 {"states", {"Blending", "InvertCulling"}},
+                                 {"depthFunc", "Less"},
+                                 {"sourceBlendFactor", "One"},
+                                 {"vertexShader", "shaders/pipeline" + std::to_string(i) + ".vert"},
+                                 {"fragmentShader", "shaders/pipeline" + std::to_string(i) + ".frag"}});
+        }
+
+        return pipelines.dump();
+    }
+
+    void BM_ParseRendergraph(benchmark::State& state) {
+        const auto text = make_rendergraph_json(static_cast<uint32_t>(state.range(0)));
+
+        for(auto _ : state) {
+            auto rendergraph = RendergraphData::from_json(nlohmann::json::parse(text));
+            benchmark::DoNotOptimize(rendergraph);
+        }
+
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+    }
+
+    void BM_ParsePipelines(benchmark::State& state) {
+        const auto text = make_pipelines_json(static_cast<uint32_t>(state.range(0)));
+
+        for(auto _ : state) {
+            const auto json = nlohmann::json::parse(text);
+            for(const auto& pipeline_json : json) {
+                auto pipeline = PipelineData::from_json(pipeline_json);
+                benchmark::DoNotOptimize(pipeline);
+            }
+        }
+
+        state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+    }
+} // namespace
+
+BENCHMARK(BM_ParseRendergraph)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ParsePipelines)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
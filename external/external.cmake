@@ -17,6 +17,7 @@ set(BUILD_ICD OFF CACHE BOOL "Disable ICD" FORCE)
 
 find_package(glfw3 CONFIG REQUIRED)
 find_package(glm CONFIG REQUIRED)
+find_package(meshoptimizer CONFIG REQUIRED)
 find_package(nlohmann_json CONFIG REQUIRED)
 find_package(spdlog CONFIG REQUIRED)
 find_path(STB_INCLUDE_DIRS "stb.h")
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 
 #include "resource_loader.hpp"
@@ -64,6 +65,14 @@ namespace nova::renderer {
         glm::mat4 previous_projection;
     };
 
+    /*!
+     * \brief Finds the planes of the current frame's view frustum, in world space
+     *
+     * Each plane's normal is in xyz and points into the frustum, and its distance from the origin is in w. The normals are normalized, so
+     * `dot(plane.xyz, point) + plane.w` is the signed distance from the plane to a point
+     */
+    [[nodiscard]] std::array<glm::vec4, 6> get_frustum_planes(const CameraUboData& camera);
+
     class Camera {
         friend class NovaRenderer;
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/renderables.hpp"
+
+namespace nova::renderer {
+    using ChunkSectionPoolId = uint32_t;
+
+    using ChunkSectionId = uint64_t;
+
+    /*!
+     * \brief Describes a pool of chunk sections that all have the same vertex format and the same maximum size
+     *
+     * Each section of the pool gets a fixed-size slot in the mesh arenas, big enough for the largest section. Slots are carved out of
+     * the arenas many at a time, so rebuilding a section never has to look for space that fits its exact size
+     */
+    struct ChunkSectionPoolCreateInfo {
+        size_t num_vertex_attributes{};
+
+        /*!
+         * \brief Number of bytes in one vertex. Set it to `sizeof(CompactVertex)` for sections drawn by compact pipelines
+         */
+        uint32_t vertex_size = sizeof(FullVertex);
+
+        uint32_t max_vertices_per_section = 0;
+
+        uint32_t max_indices_per_section = 0;
+
+        /*!
+         * \brief How many slots to take from the mesh arenas at once when the pool runs out of them. The pool takes fewer if that many
+         * don't fit in one arena buffer
+         */
+        uint32_t slots_per_page = 256;
+    };
+
+    /*!
+     * \brief New geometry for one chunk section
+     */
+    struct ChunkSectionGeometry {
+        const void* vertex_data_ptr{};
+
+        /*!
+         * \brief Number of bytes of vertex data. Must be a whole number of the pool's vertices
+         */
+        size_t vertex_data_size{};
+
+        /*!
+         * \brief 32-bit indices into the section's vertices. A section without indices has nothing to draw
+         */
+        const uint32_t* index_data_ptr{};
+
+        uint32_t num_indices{};
+
+        /*!
+         * \brief Model-space bounds of the section, for culling
+         */
+        glm::vec3 aabb_min{};
+        glm::vec3 aabb_max{};
+    };
+} // namespace nova::renderer
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "nova_renderer/renderables.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief The region of space that a mesh's compact vertex positions are relative to
+     *
+     * For chunks this is the chunk's bounding box. The vertex shader gets the position back with `origin + position.xyz * extent`
+     */
+    struct CompactVertexSpace {
+        glm::vec3 origin{};
+
+        /*!
+         * \brief Size of the region along each axis. Anything outside of `[origin, origin + extent]` gets clamped to its edge
+         */
+        glm::vec3 extent{1};
+    };
+
+    /*!
+     * \brief A 28 byte vertex for chunks and other dense geometry
+     *
+     * Positions are 16-bit unorms relative to a CompactVertexSpace, which for a 16 block chunk is about 1/4000th of a block of
+     * precision. Normals and tangents are octahedral-encoded into two snorm16s each. UVs stay as the unorm16 pairs that FullVertex
+     * already uses
+     *
+     * Pipelines that draw compact vertices set `"vertexLayout": "Compact"`, and their vertex shaders take the fields in this order
+     */
+    struct CompactVertex {
+        /*!
+         * \brief Position in the mesh's vertex space. w is always 1.0, because the GPU has no three-component 16-bit formats
+         */
+        glm::u16vec4 position;       // 8 bytes
+        uint32_t normal;             // 4 bytes
+        uint32_t tangent;            // 4 bytes
+        uint32_t main_uv;            // 4 bytes
+        uint32_t secondary_uv;       // 4 bytes
+        uint32_t virtual_texture_id; // 4 bytes
+    };
+
+    static_assert(sizeof(CompactVertex) == 28, "CompactVertex has padding in it!");
+
+    /*!
+     * \brief Maps a unit vector onto the [-1, 1] square, by projecting it onto an octahedron and folding the bottom half over the top
+     */
+    [[nodiscard]] glm::vec2 encode_octahedral(const glm::vec3& unit_vector);
+
+    /*!
+     * \brief Turns a vector from `encode_octahedral` back into a unit vector
+     */
+    [[nodiscard]] glm::vec3 decode_octahedral(const glm::vec2& encoded);
+
+    /*!
+     * \brief Quantizes a FullVertex into a CompactVertex
+     */
+    [[nodiscard]] CompactVertex compact_vertex(const FullVertex& vertex, const CompactVertexSpace& space);
+
+    /*!
+     * \brief Gets the vertex fields that match CompactVertex
+     */
+    [[nodiscard]] std::vector<rhi::RhiVertexField> get_compact_vertex_fields();
+} // namespace nova::renderer
@@ -7,10 +7,14 @@
 using namespace nova::mem::operators;
 
 namespace nova::renderer {
-    constexpr const char* MODEL_MATRIX_BUFFER_NAME = "NovaModelMatrixUBO";
     constexpr const char* PER_FRAME_DATA_NAME = "NovaPerFrameUBO";
     constexpr const char* MATERIAL_DATA_BUFFER_NAME = "NovaMaterialData";
     constexpr const char* CAMERA_MATRIX_BUFFER_NAME = "NovaCameraMatrixBuffer";
+    constexpr const char* LIGHT_CLUSTER_PARAMS_BUFFER_NAME = "NovaLightClusterParams";
+    constexpr const char* LIGHT_BUFFER_NAME = "NovaLights";
+    constexpr const char* LIGHT_CLUSTER_BUFFER_NAME = "NovaLightClusters";
+    constexpr const char* LIGHT_INDEX_BUFFER_NAME = "NovaLightIndices";
+    constexpr const char* VOLUMETRIC_FOG_IMAGE_NAME = "NovaVolumetricFog";
 
     constexpr mem::Bytes MATERIAL_BUFFER_SIZE = 64_kb;
 
@@ -20,11 +24,29 @@ namespace nova::renderer {
 
     constexpr uint32_t MAX_NUM_CAMERAS = 256;
 
+    /*!
+     * \brief The most views that one renderpass can render at once. Every Vulkan device that supports multiview supports at least this
+     * many, which is enough for the faces of a cubemap
+     */
+    constexpr uint32_t MAX_NUM_VIEWS = 6;
+
     /*!
      * \brief Maximum number of textures that Nova can handle
      */
     constexpr uint32_t MAX_NUM_TEXTURES = 1024;
 
+    /*!
+     * \brief Maximum number of vertex arena buffers that shaders which pull their own vertices can read from. Meshes in the buffers past
+     * this can only be drawn by pipelines with an input layout
+     */
+    constexpr uint32_t MAX_NUM_VERTEX_BUFFERS = 16;
+
+    /*!
+     * \brief The vertex layout of draws whose vertices shaders can't pull, such as procedural and skinned meshes, which have buffers of
+     * their own. `fetch_vertex` gives them zeroed vertices
+     */
+    constexpr uint32_t NO_PULLED_VERTICES = 0xFFFFFFFF;
+
     constexpr mem::Bytes PER_FRAME_MEMORY_SIZE = 2_mb;
 
     constexpr const char* RENDERPACK_DIRECTORY = "renderpacks";
@@ -32,7 +54,9 @@ namespace nova::renderer {
     constexpr const char* SHADERS_DIRECTORY = "shaders";
     constexpr const char* RENDERPACK_DESCRIPTOR_FILE = "renderpack.json";
     constexpr const char* RESOURCES_FILE = "resources.json";
+    constexpr const char* RENDERGRAPH_FILE = "rendergraph.json";
     constexpr const char* MATERIAL_FILE_EXTENSION = ".mat";
+    constexpr const char* COOKED_RENDERPACK_FILE = "renderpack.cooked";
 
     /*!
      * \brief Name of Nova's white texture
@@ -84,6 +108,73 @@ namespace nova::renderer {
      */
     constexpr const char* UI_OUTPUT_RT_NAME = "NovaUiOutput";
 
+    /*!
+     * \brief Name of the builtin pass that builds `HI_Z_RT_NAME`. Renderpacks that want the depth pyramid list this in `builtinPasses`
+     */
+    constexpr const char* DEPTH_PYRAMID_PASS_NAME = "NovaDepthPyramid";
+
+    /*!
+     * \brief Name of the depth pyramid render target, which only exists when the renderpack uses `DEPTH_PYRAMID_PASS_NAME`
+     *
+     * Each texel of mip 0 holds the min depth of a 2x2 block of the scene's depth in R, and the max in G. Each mip after that holds the
+     * min and max of a 2x2 block of the mip before it. Mip 0 is half the size of the screen, and there are at most 12 mips. Passes that
+     * read it come after the depth pyramid pass
+     */
+    constexpr const char* HI_Z_RT_NAME = "NovaHiZ";
+
+    /*!
+     * \brief Start of the names of the builtin passes that upsample a pass's `upsampleOutputs`. The rest of the name is the destination
+     * texture's name
+     */
+    constexpr const char* BILATERAL_UPSAMPLE_PASS_PREFIX = "NovaUpsample_";
+
+    /*!
+     * \brief Start of the names of the textures that a pass with `orderIndependentTransparency` renders into, and of the builtin pass that
+     * blends them over the pass's color output. The rest of each name is the pass's name
+     */
+    constexpr const char* OIT_ACCUMULATION_RT_PREFIX = "NovaOitAccumulation_";
+    constexpr const char* OIT_COVERAGE_RT_PREFIX = "NovaOitCoverage_";
+    constexpr const char* OIT_COMPOSITE_PASS_PREFIX = "NovaOitComposite_";
+
+    /*!
+     * \brief Name of the builtin pass that upscales the scene output with a `TemporalUpscaler`. Renderpacks that want the scene rendered
+     * at a lower resolution and upscaled list this in `builtinPasses`
+     */
+    constexpr const char* TEMPORAL_UPSCALE_PASS_NAME = "NovaTemporalUpscale";
+
+    /*!
+     * \brief Name of the render target that the temporal upscale pass writes to, and that the backbuffer output pass shows instead of the
+     * scene output when there's an upscaler
+     */
+    constexpr const char* UPSCALED_OUTPUT_RT_NAME = "NovaUpscaledOutput";
+
+    /*!
+     * \brief Name of the render target with the scene's motion vectors. Each texel holds the UV offset from where its surface is this
+     * frame to where it was last frame, without either frame's jitter
+     *
+     * Renderpacks that use the temporal upscale pass may write it themselves, so that moving renderables get their own motion. Otherwise
+     * Nova fills it in from depth and the main camera's motion with the `CAMERA_MOTION_VECTORS_PASS_NAME` pass
+     */
+    constexpr const char* MOTION_VECTORS_RT_NAME = "NovaMotionVectors";
+
+    /*!
+     * \brief Name of the builtin pass that fills in `MOTION_VECTORS_RT_NAME` when no renderpack pass writes it
+     */
+    constexpr const char* CAMERA_MOTION_VECTORS_PASS_NAME = "NovaCameraMotionVectors";
+
+    /*!
+     * \brief Name of the shading rate image, which only exists when a renderpack pass has an adaptive shading rate
+     *
+     * Each texel holds the fragment size of one `DeviceInfo::shading_rate_image_texel_size`-sized tile of the screen, as
+     * `log2(width) << 2 | log2(height)`. It's filled in at the end of each frame, for the next one
+     */
+    constexpr const char* SHADING_RATE_RT_NAME = "NovaShadingRate";
+
+    /*!
+     * \brief Name of the builtin pass that fills in `SHADING_RATE_RT_NAME`
+     */
+    constexpr const char* SHADING_RATE_PASS_NAME = "NovaAdaptiveShadingRate";
+
     /*!
      * \brief Name of the backbuffer
      *
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace nova::renderer {
+    /*!
+     * \brief How long the CPU spent in one phase of the frame, like acquiring the swapchain image or recording a renderpass, over a
+     * window of recent frames
+     */
+    struct CpuPhaseTiming {
+        /*!
+         * \brief The name of the phase, or the name of the renderpass for the time spent recording it
+         */
+        std::string name;
+
+        /*!
+         * \brief How many times the phase ran in the window. Renderpasses that record on several threads count once per thread
+         */
+        uint32_t num_samples = 0;
+
+        double median_milliseconds = 0;
+
+        double p95_milliseconds = 0;
+
+        double p99_milliseconds = 0;
+
+        double max_milliseconds = 0;
+    };
+} // namespace nova::renderer
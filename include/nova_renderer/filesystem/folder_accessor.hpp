@@ -5,9 +5,57 @@
 #include <unordered_map>
 #include  <optional>
 #include <string>
+#include <string_view>
 #include <cstdint>
+#include <future>
+#include <memory>
+#include <span>
+#include <vector>
 
 namespace nova::filesystem {
+    /*!
+     * \brief The bytes of a file, which stay alive for as long as any copy of the view does
+     *
+     * The bytes may be a mapping of the file itself, part of a mapped archive, or a buffer that the file was inflated into. Copying the
+     * view never copies the bytes
+     */
+    class FileView {
+    public:
+        FileView() = default;
+
+        /*!
+         * \param owner Whatever keeps `bytes` alive. May be nullptr if the bytes live forever, like string literals
+         * \param bytes The file's bytes
+         */
+        FileView(std::shared_ptr<const void> owner, std::span<const uint8_t> bytes) : owner{std::move(owner)}, bytes{bytes} {}
+
+        [[nodiscard]] std::span<const uint8_t> get_bytes() const { return bytes; }
+
+        [[nodiscard]] std::string_view as_string() const { return {reinterpret_cast<const char*>(bytes.data()), bytes.size()}; }
+
+        [[nodiscard]] bool is_empty() const { return bytes.empty(); }
+
+    private:
+        std::shared_ptr<const void> owner;
+
+        std::span<const uint8_t> bytes;
+    };
+
+    /*!
+     * \brief How soon someone needs the bytes of a file that's read asynchronously
+     */
+    enum class IoPriority {
+        /*!
+         * \brief Someone's waiting for the file, like a loading screen. These reads go first
+         */
+        Blocking,
+
+        /*!
+         * \brief The file is streamed in the background, so it can wait behind blocking reads
+         */
+        Streaming,
+    };
+
     /*!
      * \brief A collection of resources on the filesystem
      *
@@ -47,6 +95,46 @@ namespace nova::filesystem {
 
         [[nodiscard]] virtual std::vector<uint8_t> read_file(const std::string& path) = 0;
 
+        /*!
+         * \brief Gets a view of a file's bytes, without copying them if this accessor can help it
+         *
+         * Prefer this to `read_file` when you only need to look at the bytes, like when parsing JSON or compiling a shader. Loading a
+         * huge resourcepack through `read_file` keeps two copies of every file around at once
+         *
+         * The default implementation reads the whole file with `read_file`
+         *
+         * \param path The path to the file, relative to this accessor's root
+         * \return A view of the file's bytes, or an empty view if the file couldn't be read
+         */
+        [[nodiscard]] virtual FileView map_file(const std::string& path);
+
+        /*!
+         * \brief Reads a whole file without blocking the calling thread
+         *
+         * The default implementation reads the file with `read_file` before it returns. Accessors for regular folders queue the read on
+         * the `AsyncFileReader` instead, so many reads can be in flight at once
+         *
+         * \param path The path to the file, relative to this accessor's root
+         * \return The file's bytes, or an empty vector if the file couldn't be read
+         */
+        [[nodiscard]] virtual std::future<std::vector<uint8_t>> read_file_async(const std::string& path,
+                                                                                IoPriority priority = IoPriority::Blocking);
+
+        /*!
+         * \brief Reads part of a file straight into some memory, like a mapped staging buffer, without blocking the calling thread
+         *
+         * The default implementation copies the bytes out of `map_file` before it returns
+         *
+         * \param path The path to the file, relative to this accessor's root
+         * \param file_offset Where in the file to start reading
+         * \param destination Where to put the bytes. Must stay alive until the future is ready. Reads stop at the end of the file
+         * \return How many bytes were read, or nothing if the file couldn't be read
+         */
+        [[nodiscard]] virtual std::future<std::optional<uint64_t>> read_file_into_async(const std::string& path,
+                                                                                        uint64_t file_offset,
+                                                                                        std::span<uint8_t> destination,
+                                                                                        IoPriority priority = IoPriority::Blocking);
+
         /*!
          * \brief Loads the resource with the given path
          * \param resource_path The path to the resource to load, relative to this resourcepack's root
@@ -61,6 +149,16 @@ namespace nova::filesystem {
          */
         [[nodiscard]] virtual std::vector<std::string> get_all_items_in_folder(const std::string& folder) = 0;
 
+        /*!
+         * \brief Gets the path of every file and folder in this accessor, relative to its root, if it knows them all up front
+         *
+         * The virtual filesystem merges these into one index, so it can find which root a path is in without asking every root. The
+         * default implementation returns nothing, so the virtual filesystem asks this accessor with `does_resource_exist` instead
+         *
+         * \return Views of every path, which stay valid for as long as this accessor lives, or nothing if this accessor doesn't know
+         */
+        [[nodiscard]] virtual std::optional<std::vector<std::string_view>> get_indexed_paths() const;
+
         [[nodiscard]] const std::string& get_root() const;
 
         [[nodiscard]] virtual FolderAccessorBase* create_subfolder_accessor(const std::string& path) const = 0;
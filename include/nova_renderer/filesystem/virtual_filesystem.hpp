@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string_view>
+#include <unordered_map>
+
 #include "folder_accessor.hpp"
 
 namespace nova::filesystem {
@@ -9,6 +12,9 @@ namespace nova::filesystem {
      * The virtual filesystem may have one or more filesystem roots. When you request access to a file at a specific path, the virtual
      * filesystem looks for it in all the filesystem roots, in their priority order
      *
+     * Roots that know all their paths up front, like zip archives, are merged into one index that maps each path to the first of those
+     * roots that has it, so finding a path in them is one hash lookup. Only the other roots that come before that one are asked
+     *
      * Resource roots may be either the path to a zip file or the path to a filesystem directory
      */
     class VirtualFilesystem {
@@ -34,5 +40,17 @@ namespace nova::filesystem {
         static VirtualFilesystem* instance;
 
         std::vector<FolderAccessorBase*> resource_roots;
+
+        /*!
+         * \brief Map from path to the index of the first root that has it, for the roots that know all their paths up front
+         *
+         * The keys are views of paths that the roots own. Roots are never removed, so the views stay valid
+         */
+        std::unordered_map<std::string_view, uint32_t> indexed_roots_by_path;
+
+        /*!
+         * \brief The indices of the roots that aren't in `indexed_roots_by_path`, in priority order
+         */
+        std::vector<uint32_t> unindexed_roots;
     };
 } // namespace nova::filesystem
\ No newline at end of file
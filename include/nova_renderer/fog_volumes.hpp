@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace nova::renderer {
+    using FogVolumeId = uint32_t;
+
+    /*!
+     * \brief The fog that fills the whole world, thinning out with height
+     *
+     * Shaders read the fog that's in front of them with the functions in `./nova/volumetric_fog.hlsl`
+     */
+    struct VolumetricMedium {
+        /*!
+         * \brief How much of the light going through one unit of fog it scatters or absorbs, at and below `base_height`. Zero means
+         * there's no fog outside of fog volumes
+         */
+        float density = 0;
+
+        /*!
+         * \brief How quickly the fog thins out above `base_height`. The density falls off by a factor of e every `1 / height_falloff`
+         * units up
+         */
+        float height_falloff = 0;
+
+        float base_height = 0;
+
+        /*!
+         * \brief How much of the light that the fog stops is scattered instead of absorbed, per color channel
+         */
+        glm::vec3 albedo{1};
+
+        /*!
+         * \brief Which way the fog scatters light, from -1 for straight back to the light to 1 for straight ahead. Real fog is around
+         * 0.2 to 0.6
+         */
+        float anisotropy = 0.3f;
+
+        /*!
+         * \brief Light that comes from everywhere at once, like the sky, which fog scatters even where there aren't any lights
+         */
+        glm::vec3 ambient{0};
+    };
+
+    /*!
+     * \brief A box of fog, whose density adds to the medium's
+     */
+    struct FogVolume {
+        glm::vec3 position{};
+
+        /*!
+         * \brief Half the size of the box along each axis
+         */
+        glm::vec3 half_size{1};
+
+        float density = 0.1f;
+
+        glm::vec3 albedo{1};
+
+        /*!
+         * \brief How much of the way from the center of the box to its sides the density fades out over, from 0 for hard edges to 1
+         */
+        float edge_softness = 0.25f;
+    };
+} // namespace nova::renderer
@@ -1,14 +1,22 @@
 #pragma once
 
 #include <stddef.h>
+#include <memory_resource>
 
-#include <rx/core/memory/allocator.h>
+#include <glm/glm.hpp>
 
 #include "nova_renderer/rhi/forward_decls.hpp"
 #include "nova_renderer/resource_loader.hpp"
 
 namespace nova::renderer {
+    class CpuTimeline;
+    class FrameUploadAllocator;
+    class GpuProfiler;
     class NovaRenderer;
+    class OcclusionQueries;
+    class ParticleSystem;
+    class SkinningSystem;
+    class UiBatcher;
 
     /*!
      * \brief All the per-frame data that Nova itself cares about
@@ -44,9 +52,76 @@ namespace nova::renderer {
          */
         rhi::RhiBuffer* camera_matrix_buffer;
 
-        size_t cur_model_matrix_index = 0;
+        /*!
+         * \brief Indirect draw commands that GPU culling wrote for this frame, one per mesh batch
+         */
+        rhi::RhiBuffer* draw_commands_buffer = nullptr;
+
+        /*!
+         * \brief How many of the draws in each `MeshDrawRange` are visible, one `uint32_t` per range. GPU culling packs the visible
+         * draws at the start of their range. nullptr if the draws aren't packed, in which case every draw in a range has to be drawn
+         */
+        rhi::RhiBuffer* draw_counts_buffer = nullptr;
 
-        rx::memory::allocator* allocator = nullptr;
+        /*!
+         * \brief Where renderpasses can allocate uniform and storage data that only this frame uses
+         */
+        FrameUploadAllocator* frame_uploads = nullptr;
+
+        /*!
+         * \brief Times each pass on the GPU. nullptr when profiling is off
+         */
+        GpuProfiler* gpu_profiler = nullptr;
+
+        /*!
+         * \brief Times what the CPU does for each pass. nullptr when `NovaSettings::cpu_timeline` is off
+         */
+        CpuTimeline* cpu_timeline = nullptr;
+
+        /*!
+         * \brief Runs this frame's occlusion queries. nullptr when `NovaSettings::CullingOptions::occlusion_queries` is off
+         */
+        OcclusionQueries* occlusion_queries = nullptr;
+
+        /*!
+         * \brief Draws the particles of the renderpack's particle emitters in the material passes that they name
+         */
+        ParticleSystem* particles = nullptr;
+
+        /*!
+         * \brief Has the vertices that this frame skinned, for drawing skinned renderables
+         */
+        SkinningSystem* skinning = nullptr;
+
+        /*!
+         * \brief Batches 2D UI for `UiRenderpass::render_ui`. Whatever's in it when `render_ui` returns is drawn on top of it
+         */
+        UiBatcher* ui = nullptr;
+
+        /*!
+         * \brief Where to allocate host memory that's only needed until the end of this frame. Freeing it does nothing, the whole arena is
+         * thrown away at once when this frame slot comes around again
+         *
+         * Only use it from the thread that's executing the frame
+         */
+        std::pmr::memory_resource* allocator = nullptr;
+
+        /*!
+         * \brief The fraction of their full size, in each dimension, that renderpasses with `uses_dynamic_resolution` render into this
+         * frame. Always 1 unless `NovaSettings::dynamic_resolution` is on
+         */
+        float resolution_scale = 1.0f;
+
+        /*!
+         * \brief How far the main camera's projection is offset this frame, in render pixels. Zero unless the renderpack uses the
+         * temporal upscale pass
+         */
+        glm::vec2 camera_jitter{};
+
+        /*!
+         * \brief `camera_jitter` of the last frame
+         */
+        glm::vec2 previous_camera_jitter{};
 
         BufferResourceAccessor material_buffer;
     };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief How long the GPU spent on one renderpass or material pass
+     */
+    struct GpuPassTiming {
+        /*!
+         * \brief The name of the renderpass, or `material.pass` for a material pass
+         */
+        std::string name;
+
+        /*!
+         * \brief Zero for renderpasses, one for the material passes they draw
+         */
+        uint32_t depth = 0;
+
+        /*!
+         * \brief Time between the GPU starting the pass and finishing it. Passes on different queues may overlap
+         */
+        double milliseconds = 0;
+    };
+
+    /*!
+     * \brief What the GPU counted while it ran one renderpass
+     */
+    struct GpuPassStatistics {
+        std::string name;
+
+        rhi::RhiPipelineStatistics statistics;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace nova::renderer {
+    using LightId = uint32_t;
+
+    /*!
+     * \brief A light that shines in every direction from a point, and fades out to nothing at its radius
+     *
+     * Shaders read lights with the functions in `./nova/clustered_lighting.hlsl`. Nova doesn't light anything itself, so how the color,
+     * intensity, and radius turn into light is up to the renderpack
+     */
+    struct PointLight {
+        glm::vec3 position{};
+
+        /*!
+         * \brief How far the light reaches. Nova only lists the light in the clusters that its radius touches
+         */
+        float radius = 1.0f;
+
+        glm::vec3 color{1};
+
+        float intensity = 1.0f;
+    };
+} // namespace nova::renderer
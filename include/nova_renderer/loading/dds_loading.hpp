@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "nova_renderer/resource_loader.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Reads the header of a DDS file, and makes a streamed texture that uploads the file's mips as they are
+     *
+     * Supports 2D DDS files that are BC1, BC3, BC5, BC7, or uncompressed RGBA8, RGBA16F, or RGBA32F, with either the legacy header or
+     * the DX10 extension header. Cubemaps, arrays, and sRGB formats aren't supported. A file that only has mip 0 and an uncompressed
+     * format gets the rest of its mips generated on the GPU
+     *
+     * The returned texture's `load_mip` keeps the file's data alive, and copies each mip out of it when it's asked for
+     *
+     * \param name The name of the texture
+     * \param file_data The entire contents of the DDS file
+     * \return The texture, or nothing if the file isn't a DDS file that Nova can use. Check the Nova logs to find out why
+     */
+    [[nodiscard]] std::optional<StreamedTextureCreateInfo> load_dds_texture(const std::string& name, std::vector<uint8_t> file_data);
+} // namespace nova::renderer
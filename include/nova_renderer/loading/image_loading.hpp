@@ -0,0 +1,33 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "nova_renderer/filesystem/folder_accessor.hpp"
+#include "nova_renderer/resource_loader.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Reads the header of a PNG, TGA, or JPEG file, and makes a streamed texture that decodes the file when its mips are loaded
+     *
+     * The file is decoded on the texture streamer's workers, so many textures decode at once. Every pixel becomes RGBA8, whatever the
+     * file stores, and the rest of the mip chain is filtered down from mip 0 on the same worker. A load decodes the file once for every
+     * mip it reads, so streaming in a mip later decodes the file again, but the mips between loads aren't kept around
+     *
+     * \param name The name of the texture
+     * \param file The file's bytes. The texture keeps the view alive until it's removed, so mapped files are read as they're decoded
+     * \return The texture, or nothing if the file isn't an image that Nova can decode. Check the Nova logs to find out why
+     */
+    [[nodiscard]] std::optional<StreamedTextureCreateInfo> load_image_texture(const std::string& name, filesystem::FileView file);
+
+    /*!
+     * \brief Loads a texture file from a folder, picking the loader by the file's extension
+     *
+     * DDS files go to `load_dds_texture`, and everything else goes to `load_image_texture`
+     *
+     * \param folder The folder to read the file from, like a renderpack or a resourcepack
+     * \param path The file's path, relative to the root of `folder`. Also the name of the texture
+     */
+    [[nodiscard]] std::optional<StreamedTextureCreateInfo> load_texture_file(filesystem::FolderAccessorBase& folder,
+                                                                             const std::string& path);
+} // namespace nova::renderer
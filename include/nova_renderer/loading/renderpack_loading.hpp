@@ -1,11 +1,20 @@
 #pragma once
 
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string_view>
 #include <vector>
 
 #include "nova_renderer/filesystem/folder_accessor.hpp"
+#include "nova_renderer/nova_settings.hpp"
 #include "nova_renderer/renderpack_data.hpp"
 #include "nova_renderer/rhi/rhi_enums.hpp"
 
+namespace nova::renderer {
+    class TaskScheduler;
+}
+
 namespace nova::renderer::renderpack {
     /*!
      * \brief Loads all the data for a single renderpack
@@ -17,20 +26,71 @@ namespace nova::renderer::renderpack {
      *
      * If the renderpack can't be loaded, an empty optional is returned
      *
-     * Note: This function is NOT thread-safe. It should only be called for a single thread at a time
+     * The resources file, the rendergraph file, and every pipeline and material file are read, parsed, and validated as separate tasks on
+     * the task scheduler. Pipeline tasks also compile their shaders. This function waits for all of them before it does any validation that
+     * needs the whole renderpack
+     *
+     * Note: This function is NOT thread-safe. It should only be called for a single thread at a time. It also must not be called from one
+     * of the task scheduler's workers, since it blocks until the tasks it adds have finished
      *
      * \param renderpack_name The name of the renderpack to loads
+     * \param task_scheduler The task scheduler to load the renderpack's files on
      * \return The renderpack, if it can be loaded, or an empty optional if it cannot
      */
-    RenderpackData load_renderpack_data(const std::string& renderpack_name);
+    RenderpackData load_renderpack_data(const std::string& renderpack_name, TaskScheduler& task_scheduler);
+
+    /*!
+     * \brief Gives the render targets with a `TextureFormat::precision` hint the smallest format that a precision tier allows, and
+     * updates the passes that use them to match
+     *
+     * Loaded and cooked renderpacks keep the formats that the renderpack asked for, since they don't know what GPU they'll run on, so
+     * call this on every renderpack before making its render targets. A render target keeps its format if the smaller one would be
+     * bigger than it, or if `is_format_supported` says no to the smaller one
+     *
+     * \param data The renderpack to resolve the render target formats of
+     * \param tier How much precision to keep
+     * \param is_format_supported Whether the GPU can render to and sample from a format
+     */
+    void resolve_render_target_precision(RenderpackData& data,
+                                         RenderTargetPrecision tier,
+                                         const std::function<bool(rhi::PixelFormat)>& is_format_supported);
+
+    /*!
+     * \brief Loads a renderpack from its files and cooks it, for renderpack authors who want to ship a `renderpack.cooked`
+     *
+     * This always loads the renderpack's files, even if there's a cooked renderpack that's up to date
+     *
+     * \param renderpack_name The name of the renderpack to cook
+     * \param task_scheduler The task scheduler to load the renderpack's files on
+     * \param output_path Where to write the cooked renderpack
+     * \return True if the renderpack was cooked, false if any of its shaders didn't compile or the file couldn't be written
+     */
+    bool cook_renderpack_to_file(const std::string& renderpack_name,
+                                 TaskScheduler& task_scheduler,
+                                 const std::filesystem::path& output_path);
+
+    /*!
+     * \brief Compiles the shaders for one variant of a pipeline
+     *
+     * This may be called from any thread, including the task scheduler's workers
+     *
+     * \param pipeline The pipeline's data, as it was loaded
+     * \param variant_keywords The variant's keywords, from `get_variant_keywords`
+     * \param folder_access The renderpack that the pipeline's shaders are in
+     * \return A copy of the pipeline's data with the variant's shaders, or nothing if any of them didn't compile
+     */
+    std::optional<PipelineData> load_pipeline_variant(const PipelineData& pipeline,
+                                                      const std::vector<std::string>& variant_keywords,
+                                                      filesystem::FolderAccessorBase* folder_access);
 
     std::vector<uint32_t> load_shader_file(const std::string& filename,
                                           filesystem::FolderAccessorBase* folder_access,
                                           rhi::ShaderStage stage,
                                           const std::vector<std::string>& defines = {});
 
-    std::vector<uint32_t> compile_shader(const std::string& source,
+    std::vector<uint32_t> compile_shader(std::string_view source,
                                         rhi::ShaderStage stage,
                                         rhi::ShaderLanguage source_language,
-                                        filesystem::FolderAccessorBase* folder_accessor = nullptr);
+                                        filesystem::FolderAccessorBase* folder_accessor = nullptr,
+                                        const std::vector<std::string>& defines = {});
 } // namespace nova::renderer::renderpack
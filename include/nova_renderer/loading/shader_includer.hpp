@@ -7,14 +7,10 @@
 
 #include <dxc/dxcapi.h>
 #include <rx/core/concurrency/mutex.h>
-#include <unordered_map>
+#include <optional>
 #include <string>
 
-namespace nova {
-    namespace filesystem {
-        class FolderAccessorBase;
-    }
-} // namespace nova
+#include "nova_renderer/filesystem/folder_accessor.hpp"
 
 namespace rx {
     namespace memory {
@@ -47,6 +43,20 @@ namespace nova::renderer {
 
         HRESULT LoadSource(LPCWSTR wide_filename, IDxcBlob** included_source) override;
 
+        /*!
+         * \brief Reads a file that a shader includes, either from Nova's builtin snippets or from the renderpack
+         *
+         * This is the same lookup that `LoadSource` does, though `LoadSource` goes through the shader include cache so each file is only
+         * read once per renderpack load
+         *
+         * \param filename The name of the included file, as DXC gives it to us
+         * \param folder_accessor The renderpack to look for the file in. May be nullptr, in which case only the builtin snippets are searched
+         *
+         * \return The contents of the included file, or nullopt if it doesn't exist
+         */
+        [[nodiscard]] static std::optional<filesystem::FileView> read_include(const std::string& filename,
+                                                                              filesystem::FolderAccessorBase* folder_accessor);
+
     private:
         rx::memory::allocator& allocator;
 
@@ -54,7 +64,10 @@ namespace nova::renderer {
 
         filesystem::FolderAccessorBase* folder_accessor;
 
-        std::unordered_map<std::string, std::string> builtin_files;
+        /*!
+         * \brief The UTF-8 name of the file that DXC wants, reused between includes
+         */
+        std::string filename_scratch;
 
 #if NOVA_WINDOWS
         std::mutex mtx;
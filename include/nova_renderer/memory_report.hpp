@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nova_renderer/resource_loader.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Host memory that Nova sets aside for itself, rather than allocating as it goes
+     */
+    struct CpuArenaMemory {
+        /*!
+         * \brief Bytes that the frame arenas of every in-flight frame take up
+         */
+        uint64_t frame_arena_bytes = 0;
+
+        /*!
+         * \brief Bytes of temporaries that didn't fit in the current frame's arena, and went to the heap instead
+         */
+        uint64_t escaped_frame_arena_bytes = 0;
+
+        /*!
+         * \brief Bytes in the CPU copy of every material's data
+         */
+        uint64_t material_data_bytes = 0;
+    };
+
+    /*!
+     * \brief Where all of Nova's memory went, for finding who is blowing the memory budget
+     *
+     * Render targets belong to the renderpack that made them, including the render targets of the builtin passes it asked for, so the
+     * owners named after the renderpack are its share of the memory. Every other resource belongs to the subsystem that made it, or to
+     * itself when it has no owner
+     */
+    struct MemoryReport {
+        /*!
+         * \brief The usage and budget of each of the device's memory heaps, as of the start of the current frame
+         */
+        std::vector<rhi::RhiMemoryHeapBudget> heaps;
+
+        /*!
+         * \brief How full each of the device's per-resource-class memory pools is
+         */
+        std::vector<rhi::RhiMemoryPoolStats> pools;
+
+        /*!
+         * \brief The device's memory, by category and by owner, along with the driver's host memory
+         */
+        rhi::RhiMemoryAccounting device;
+
+        /*!
+         * \brief The name of the loaded renderpack, which its resources have as their owner. Empty if there isn't one
+         */
+        std::string renderpack;
+
+        /*!
+         * \brief The loaded renderpack's share of each category that it has memory in
+         */
+        std::vector<rhi::RhiMemoryAllocationStats> renderpack_memory;
+
+        StagingMemoryStats staging;
+
+        CpuArenaMemory cpu_arenas;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/renderables.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief One level of detail of a mesh. LODs share the mesh's vertices and only have their own indices
+     */
+    struct MeshLod {
+        /*!
+         * \brief Index of this LOD's first index in the mesh's index buffer
+         */
+        uint32_t first_index = 0;
+
+        uint32_t num_indices = 0;
+
+        /*!
+         * \brief Renderables use this LOD when their mesh covers less than this fraction of the screen's height. See
+         * `MeshLodData::screen_size`
+         */
+        float screen_size = 0;
+    };
+
+    /*!
+     * \brief Simplifies a mesh into a chain of coarser LODs, each with about half the triangles of the one before
+     *
+     * Stops early if the simplifier can't take out a meaningful number of triangles, so the chain may be shorter than `num_lods`. The
+     * indices of every LOD are appended to `lod_indices`, and each LOD's `first_index` is relative to the start of `lod_indices`
+     *
+     * The mesh's vertices must start with their position as three floats, like FullVertex does
+     *
+     * \param first_screen_size The screen size of the first generated LOD. Every LOD after it gets half the screen size of the one
+     * before it
+     */
+    [[nodiscard]] std::vector<MeshLod> generate_mesh_lods(const MeshData& mesh,
+                                                          uint32_t num_lods,
+                                                          float first_screen_size,
+                                                          std::vector<uint32_t>& lod_indices);
+
+    /*!
+     * \brief Works out how much of the screen's height a bounding sphere covers
+     *
+     * \param tan_half_fov The tangent of half of the camera's vertical field of view
+     *
+     * \return The fraction of the screen's height, which is more than 1 if the camera is inside the sphere
+     */
+    [[nodiscard]] float get_projected_screen_size(const glm::vec4& bounding_sphere,
+                                                  const glm::mat4& model_matrix,
+                                                  const glm::vec3& camera_position,
+                                                  float tan_half_fov);
+
+    /*!
+     * \brief Picks which of a mesh's LODs a renderable should use
+     *
+     * A renderable only moves to a different LOD once its screen size is `hysteresis` past that LOD's threshold, as a fraction of the
+     * threshold. Otherwise a renderable that sits right at a threshold would flicker between two LODs as the camera moves a tiny bit
+     *
+     * \param lods The mesh's LODs, from finest to coarsest. LOD 0 is the full mesh, so its screen size is never used
+     * \param current_lod The LOD that the renderable used last frame
+     */
+    [[nodiscard]] uint32_t select_mesh_lod(const std::vector<MeshLod>& lods, float screen_size, uint32_t current_lod, float hysteresis);
+} // namespace nova::renderer
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/renderables.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief The most vertices a meshlet can use. This matches what mesh shader hardware likes to work on
+     */
+    constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+
+    /*!
+     * \brief The most triangles in a meshlet. 124 instead of 128 so that the primitive indices fit in 496 bytes, with space for a
+     * header in 512
+     */
+    constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+    /*!
+     * \brief A small cluster of a mesh's triangles, with the bounds that GPU culling tests against
+     */
+    struct Meshlet {
+        /*!
+         * \brief Model-space bounding sphere of the meshlet, with the center in xyz and the radius in w
+         */
+        glm::vec4 bounding_sphere{};
+
+        /*!
+         * \brief Cone that contains all the meshlet's triangle normals, with the axis in xyz and the sine of its half-angle in w
+         *
+         * If the camera is inside the cone mirrored through the bounding sphere, every triangle in the meshlet faces away from it. A w of
+         * 1 means the normals are spread too far for that to ever happen
+         */
+        glm::vec4 normal_cone{0, 0, 1, 1};
+
+        /*!
+         * \brief Index, relative to the start of the mesh's indices, of this meshlet's first index
+         */
+        uint32_t first_index = 0;
+
+        uint32_t num_indices = 0;
+    };
+
+    /*!
+     * \brief The output of `build_meshlets`
+     */
+    struct MeshletMesh {
+        std::vector<Meshlet> meshlets;
+
+        /*!
+         * \brief The mesh's indices, reordered so that each meshlet's triangles are next to each other
+         */
+        std::vector<uint32_t> indices;
+    };
+
+    /*!
+     * \brief Splits a mesh into meshlets
+     *
+     * Triangles are added to the current meshlet in index order until it runs out of vertices or triangles, so meshes with a
+     * cache-friendly index order make the tightest meshlets
+     *
+     * The mesh must have 32-bit indices, and each vertex must start with its position as three floats, like FullVertex does
+     */
+    [[nodiscard]] MeshletMesh build_meshlets(const MeshData& mesh);
+} // namespace nova::renderer
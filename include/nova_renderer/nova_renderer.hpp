@@ -1,32 +1,51 @@
 #pragma once
 
 #include <rx/core/log.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory_resource>
+#include <mutex>
 #include <unordered_map>
 #include  <optional>
+#include <span>
+#include <thread>
 #include <rx/core/ptr.h>
 
 #include "nova_renderer/camera.hpp"
+#include "nova_renderer/chunk_geometry.hpp"
 #include "nova_renderer/constants.hpp"
+#include "nova_renderer/cpu_timings.hpp"
 #include "nova_renderer/filesystem/virtual_filesystem.hpp"
+#include "nova_renderer/gpu_timings.hpp"
+#include "nova_renderer/lights.hpp"
+#include "nova_renderer/memory_report.hpp"
+#include "nova_renderer/mesh_lods.hpp"
+#include "nova_renderer/meshlets.hpp"
 #include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/particles.hpp"
+#include "nova_renderer/fog_volumes.hpp"
 #include "nova_renderer/per_frame_device_array.hpp"
 #include "nova_renderer/procedural_mesh.hpp"
+#include "nova_renderer/readback.hpp"
+#include "nova_renderer/render_output.hpp"
 #include "nova_renderer/renderables.hpp"
 #include "nova_renderer/renderdoc_app.h"
 #include "nova_renderer/rendergraph.hpp"
 #include "nova_renderer/resource_loader.hpp"
 #include "nova_renderer/rhi/forward_decls.hpp"
 #include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/temporal_upscaler.hpp"
 #include "nova_renderer/util/container_accessor.hpp"
+#include "nova_renderer/util/task_scheduler.hpp"
 
 #include "../../src/renderer/material_data_buffer.hpp"
 
-namespace rx {
-    namespace memory {
-        struct bump_point_allocator;
-    }
-} // namespace rx
-
 void init_rex();
 void rex_fini();
 
@@ -35,6 +54,10 @@ namespace spirv_cross {
     struct Resource;
 } // namespace spirv_cross
 
+namespace nova::filesystem {
+    class FolderWatcher;
+}
+
 namespace nova::renderer {
     using LogHandles = std::vector<rx::log::queue_event::handle>;
 
@@ -52,18 +75,87 @@ namespace nova::renderer {
     LogHandles& set_logging_handler(LogHandlerFunc&& log_handler);
 
     class UiRenderpass;
+    class UiBatcher;
+    class ChunkSectionPool;
+    class FrameArena;
+    class FramePacer;
+    class DynamicResolutionController;
+    class CpuTimeline;
+    class FrameUploadAllocator;
+    class GpuCulling;
+    class GpuProfiler;
+    class LightClustering;
+    class ParticleSystem;
+    class SkinningSystem;
+    class VolumetricFog;
+    class ReadbackManager;
+    class RenderOutputs;
+    class MeshArena;
+    class OcclusionQueries;
+    class ResidencyManager;
+    class TextureStreamer;
+    class VirtualTextureAtlas;
+    class UploadBatcher;
+    class VisibilityCache;
 
     namespace rhi {
+        class CommandStream;
         class Swapchain;
     }
 
 #pragma region Runtime optimized data
+    /*!
+     * \brief A mesh whose data lives in Nova's mesh arenas
+     *
+     * `vertex_buffer` and `index_buffer` are shared with many other meshes. Draws of this mesh must use `first_index` and
+     * `vertex_offset` to find its data
+     */
     struct Mesh {
         rhi::RhiBuffer* vertex_buffer = nullptr;
         rhi::RhiBuffer* index_buffer = nullptr;
 
+        /*!
+         * \brief Size of this mesh's indices. Optimized meshes with few enough vertices use 16-bit indices
+         */
+        rhi::IndexType index_type = rhi::IndexType::Uint32;
+
+        /*!
+         * \brief Index of this mesh's first index in `index_buffer`, counted in indices of `index_type`
+         */
+        uint32_t first_index = 0;
+
+        /*!
+         * \brief Index of this mesh's first vertex in `vertex_buffer`. This gets added to every index
+         */
+        int32_t vertex_offset = 0;
+
         uint32_t num_indices = 0;
         size_t num_vertex_attributes{};
+
+        /*!
+         * \brief Where vertex shaders that pull their own vertices find this mesh's vertices. See `MeshArena::get_pulled_vertex_layout`
+         */
+        uint32_t pulled_vertex_layout = NO_PULLED_VERTICES;
+
+        glm::vec4 bounding_sphere{0, 0, 0, -1};
+
+        /*!
+         * \brief This mesh's meshlets, if it was created with `MeshData::build_meshlets`
+         */
+        std::shared_ptr<const std::vector<Meshlet>> meshlets;
+
+        /*!
+         * \brief This mesh's LODs, starting with the full mesh. Nullptr if it only has the full mesh
+         */
+        std::shared_ptr<const std::vector<MeshLod>> lods;
+
+        /*!
+         * \brief Where this mesh's data lives in the mesh arenas, so `destroy_mesh` can give the space back
+         */
+        uint64_t vertex_data_offset = 0;
+        uint64_t vertex_data_size = 0;
+        uint64_t index_data_offset = 0;
+        uint64_t index_data_size = 0;
     };
 #pragma endregion
 
@@ -72,13 +164,23 @@ namespace nova::renderer {
     /*!
      * \brief Main class for Nova. Owns all of Nova's resources and provides a way to access them
      * This class exists as a singleton so it's always available
+     *
+     * Most of the API belongs to the thread that constructed the renderer. These may be called from any thread at any time:
+     * `create_mesh`, `add_renderable_for_material`, `update_renderable(s)`, `remove_renderable(s)`, `set_chunk_section_geometry`,
+     * `set_chunk_sections_visible`, `destroy_chunk_section`, and `run_on_render_thread`. When they're called from a thread that doesn't
+     * render, the change is staged and lands at the start of the next frame. Changes from one thread land in the order that it made
+     * them, but there's no order between threads, except that staged meshes always land before staged renderables
      */
     class NovaRenderer {
     public:
         /*!
          * \brief Initializes the Nova Renderer
+         *
+         * \param host_task_scheduler The scheduler to run Nova's background and parallel work on, so Nova and the host application can
+         * share their threads. If it's nullptr, Nova makes a `WorkStealingTaskScheduler` with as many workers as
+         * `NovaSettings::ThreadingOptions` asks for. The thread that calls this must be the scheduler's thread index 0
          */
-        explicit NovaRenderer(const NovaSettings& settings);
+        explicit NovaRenderer(const NovaSettings& settings, std::shared_ptr<TaskScheduler> host_task_scheduler = nullptr);
 
         NovaRenderer(NovaRenderer&& other) noexcept = delete;
         NovaRenderer& operator=(NovaRenderer&& other) noexcept = delete;
@@ -99,9 +201,22 @@ namespace nova::renderer {
          * current renderpack with the new one, then start rendering. Replacing the renderpack might also require reloading all chunks, if
          * the new renderpack has different geometry filters then the current one
          *
+         * The renderpack's pipelines are compiled in the background on Nova's task scheduler. Each pipeline starts rendering at the
+         * beginning of the first frame after it finishes compiling - until then, any material passes that use it are skipped instead of
+         * stalling the frame
+         *
          * \param renderpack_name The name of the renderpack to load
+         *
+         * If this is the renderpack that Nova started loading when it started, as `cache.preload_renderpack` does, this waits for that
+         * load instead of reading the renderpack again
+         *
+         * If `debug.renderpack_hot_reload` is enabled, Nova watches the renderpack's files after this and reloads the parts of it that
+         * change
+         *
+         * \return A future that becomes ready once all the renderpack's pipelines are done compiling. Don't wait on it from the thread that
+         * calls `execute_frame` if you want the old frames to keep coming
          */
-        void load_renderpack(const std::string& renderpack_name);
+        std::shared_future<void> load_renderpack(const std::string& renderpack_name);
 
         /*!
          * \brief Gives Nova a function to use to render UI
@@ -121,15 +236,59 @@ namespace nova::renderer {
         template <typename RenderpassType, typename... Args>
         RenderpassType* create_ui_renderpass(Args&&... args);
 
-        [[nodiscard]] const std::vector<MaterialPass>& get_material_passes_for_pipeline(const std::string& pipeline);
+        [[nodiscard]] const std::vector<MaterialPass>& get_material_passes_for_pipeline(PipelineHandle pipeline) const;
 
         [[nodiscard]] std::optional<RenderpassMetadata> get_renderpass_metadata(const std::string& renderpass_name) const;
 
+        /*!
+         * \brief Turns on or off every renderpack pass that's enabled by the provided option. See `RenderPassCreateInfo::enabled_by`
+         *
+         * Options start out the way `NovaSettings::renderpass_options` has them. Like loading a renderpack, this has to happen on the
+         * thread that renders
+         */
+        void set_renderpass_option(const std::string& option, bool enabled);
+
+        /*!
+         * \brief Whether the passes that the provided option enables are on. Options that were never set are on
+         */
+        [[nodiscard]] bool is_renderpass_option_enabled(const std::string& option) const;
+
+        /*!
+         * \brief Waits until Nova wants the next frame to start
+         *
+         * With `NovaSettings::frame_pacing` on, right after this returns is the best time to sample input and run anything that feeds
+         * into the frame. If you don't call it, `execute_frame` does before it starts recording
+         */
+        void wait_for_frame_start();
+
+        /*!
+         * \brief Sets a function for `wait_for_frame_start` to call when it's done waiting, so you can sample input at the last moment
+         */
+        void set_input_sample_callback(std::function<void()> callback);
+
         /*!
          * \brief Executes a single frame
+         *
+         * With `NovaSettings::ThreadingOptions::render_thread` on, this hands the scene over to the render thread and returns while the
+         * render thread records the frame. It only blocks if the render thread hasn't finished the frame before
          */
         void execute_frame();
 
+        /*!
+         * \brief Blocks until the render thread finishes the frame it's working on. Does nothing if there's no render thread
+         *
+         * Until the next call to `execute_frame`, the game thread may then call anything, even the parts of the API that the render
+         * thread would otherwise be using
+         */
+        void wait_for_render_thread();
+
+        /*!
+         * \brief Runs a function on the render thread before it starts on the next frame. Without a render thread, runs it right away
+         *
+         * Commands run in the order that they were queued, along with the renderable and chunk section changes that Nova queues for you
+         */
+        void run_on_render_thread(std::function<void()> command);
+
         [[nodiscard]] NovaSettingsAccessManager& get_settings();
 
         [[nodiscard]] rx::memory::allocator& get_global_allocator() const;
@@ -147,6 +306,11 @@ namespace nova::renderer {
         /*!
          * \brief Creates a new mesh and uploads its data to the GPU, returning the ID of the newly created mesh
          *
+         * Any thread may call this, all at once. Optimization, meshlets, and LODs are done on the calling thread. A mesh created on a
+         * thread that doesn't render is copied and registered at the start of the next frame, and the ID is valid right away for adding
+         * renderables from any thread. Only the thread that renders gets an error back if the mesh arenas are full - other threads just
+         * see it in the log
+         *
          * \param mesh_data The mesh's initial data
          */
         [[nodiscard]] MeshId create_mesh(const MeshData& mesh_data);
@@ -166,6 +330,249 @@ namespace nova::renderer {
          * \param mesh_to_destroy The handle of the mesh you want to destroy
          */
         void destroy_mesh(MeshId mesh_to_destroy);
+
+        /*!
+         * \brief Lets Nova destroy a mesh when the device is running out of memory
+         *
+         * Nova only evicts meshes that no renderable has used for a while. Meshes with renderables are never evicted
+         *
+         * \param mesh The mesh that may be evicted
+         * \param priority Meshes with a lower priority are evicted first, from 0 to 1
+         * \param on_evicted Called after the mesh is destroyed, so you can stream it back in when you need it again
+         */
+        void make_mesh_evictable(MeshId mesh, float priority, std::function<void(MeshId)> on_evicted);
+
+        /*!
+         * \brief Creates a skinned mesh, whose renderables are posed with `set_skinned_renderable_pose`
+         *
+         * Add renderables for it with `add_renderable_for_material`, the same as any other mesh. Any thread may call this, and the ID is
+         * valid right away
+         */
+        [[nodiscard]] MeshId create_skinned_mesh(const SkinnedMeshData& mesh_data);
+
+        /*!
+         * \brief Destroys a skinned mesh once the frames in flight are done with it. Remove its renderables first
+         */
+        void destroy_skinned_mesh(MeshId mesh);
+
+        /*!
+         * \brief Sets the bone matrices of a skinned renderable. It keeps this pose until the next call
+         *
+         * \param bone_matrices One model space matrix for each of the mesh's bones
+         */
+        void set_skinned_renderable_pose(RenderableId renderable, std::span<const glm::mat4> bone_matrices);
+
+        /*!
+         * \brief Makes a pool for the sections of voxel chunks, or anything else that rebuilds lots of small meshes all the time
+         *
+         * \return The pool's ID, or nothing if the create info doesn't describe any geometry
+         */
+        [[nodiscard]] std::optional<ChunkSectionPoolId> create_chunk_section_pool(const ChunkSectionPoolCreateInfo& create_info);
+
+        /*!
+         * \brief Adds a chunk section to a material pass. It doesn't draw anything until it gets some geometry
+         *
+         * Each section has its own mesh and its own renderable, but they're recycled: a new section takes over the mesh of a destroyed
+         * section from the same pool, so making and destroying sections all day doesn't leave empty mesh batches behind
+         *
+         * \return The section's ID, or nothing if the pool or the material pass doesn't exist
+         */
+        [[nodiscard]] std::optional<ChunkSectionId> create_chunk_section(ChunkSectionPoolId pool,
+                                                                         const MaterialPassKey& pass_key,
+                                                                         const StaticMeshRenderableUpdateData& transform);
+
+        /*!
+         * \brief Replaces a chunk section's geometry
+         *
+         * Safe to call from any thread. The geometry is copied right away, so you can reuse its memory as soon as this returns. Nova
+         * applies the new geometry at the start of a later frame, all at once: no frame ever draws half of the old geometry and half of
+         * the new. If the section gets new geometry again before that, only the newest geometry is uploaded
+         */
+        void set_chunk_section_geometry(ChunkSectionId section, const ChunkSectionGeometry& geometry);
+
+        /*!
+         * \brief Shows or hides lots of chunk sections at once, without touching their transforms
+         */
+        void set_chunk_sections_visible(std::span<const ChunkSectionId> sections, bool visible);
+
+        /*!
+         * \brief Removes a chunk section. Its slot goes back to the pool once in-flight frames are done drawing it
+         */
+        void destroy_chunk_section(ChunkSectionId section);
+
+        /*!
+         * \brief Adds a texture whose mips are read from disk when something draws it large enough to need them
+         *
+         * The texture's smallest mips are read right away. Until they're in, shaders see the default texture in its place
+         *
+         * \return The texture's index in the textures array, or nothing if it couldn't be added
+         */
+        [[nodiscard]] std::optional<uint32_t> add_streamed_texture(StreamedTextureCreateInfo create_info);
+
+        void remove_streamed_texture(uint32_t texture_idx);
+
+        /*!
+         * \brief Tells Nova how large a streamed texture is drawn in the next frame, so it can stream in the mips that size needs
+         *
+         * Call this every frame that draws the texture. Textures that go a while without being asked for are the first to lose their
+         * high-resolution mips when memory runs low
+         *
+         * \param texture_idx The index of the streamed texture
+         * \param screen_size The most pixels that the texture's width or height covers on screen
+         */
+        void request_texture_resolution(uint32_t texture_idx, float screen_size);
+
+        /*!
+         * \brief Adds a texture that's only partly resident. Shaders sample it with `sample_virtual_texture` from
+         * `./nova/virtual_texturing.hlsl`, and only the pages that they sample are loaded
+         *
+         * \return The texture's virtual texture ID, for `FullVertex::virtual_texture_id`, or nothing if it couldn't be added
+         */
+        [[nodiscard]] std::optional<uint32_t> add_virtual_texture(VirtualTextureCreateInfo create_info);
+
+        void remove_virtual_texture(uint32_t virtual_texture_id);
+
+        /*!
+         * \brief Adds a light that shaders can find with `get_light_cluster` from `./nova/clustered_lighting.hlsl`
+         *
+         * \return The light's ID, or nothing if there are already as many lights as `NovaSettings::light_clustering` allows
+         */
+        [[nodiscard]] std::optional<LightId> add_light(const PointLight& light);
+
+        void update_light(LightId light_id, const PointLight& light);
+
+        void remove_light(LightId light_id);
+
+        /*!
+         * \brief Moves one of the renderpack's particle emitters, or changes how much it spawns
+         *
+         * Emitters start at the origin, spawning at the rate their renderpack gave them. The state is kept by the emitter's name, so it
+         * carries over to the next renderpack that has an emitter with that name
+         */
+        void set_particle_emitter(const std::string& emitter_name, const ParticleEmitterState& state);
+
+        /*!
+         * \brief Sets the fog that fills the whole world. Shaders fog what they draw with `apply_volumetric_fog` from
+         * `./nova/volumetric_fog.hlsl`
+         *
+         * The world starts out without any fog
+         */
+        void set_volumetric_medium(const VolumetricMedium& medium);
+
+        /*!
+         * \brief Adds a box of fog on top of the world's fog
+         *
+         * \return The fog volume's ID, or nothing if there are already as many fog volumes as `NovaSettings::volumetric_fog` allows
+         */
+        [[nodiscard]] std::optional<FogVolumeId> add_fog_volume(const FogVolume& volume);
+
+        void update_fog_volume(FogVolumeId volume_id, const FogVolume& volume);
+
+        void remove_fog_volume(FogVolumeId volume_id);
+
+        /*!
+         * \brief Copies some bytes of a buffer to the CPU, as they are at the end of the next frame
+         *
+         * Nothing waits for the GPU. The future gets the bytes during the first frame after the GPU finishes the next frame, so the buffer
+         * must live until then. Any thread may call this
+         *
+         * \return The bytes, or nothing if they aren't all in the buffer
+         */
+        [[nodiscard]] std::future<std::optional<ReadbackData>> request_readback(rhi::RhiBuffer* buffer,
+                                                                              mem::Bytes offset,
+                                                                              mem::Bytes num_bytes);
+
+        /*!
+         * \brief Copies a rectangle of one of the renderpack's render targets to the CPU, as it is at the end of the next frame
+         *
+         * Like the buffer version, this never waits for the GPU. Render targets that share their memory with other render targets, and
+         * transient render targets, are gone by the end of the frame, so they can't be read back
+         *
+         * \return The pixels, or nothing if the render target can't be read back or the region isn't in it
+         */
+        [[nodiscard]] std::future<std::optional<ReadbackData>> request_readback(const std::string& render_target_name,
+                                                                              const ImageReadbackRegion& region = {});
+
+        /*!
+         * \brief Gets the usage and budget of each of the device's memory heaps, as of the start of the current frame
+         */
+        [[nodiscard]] const std::vector<rhi::RhiMemoryHeapBudget>& get_memory_budgets() const;
+
+        /*!
+         * \brief Gets how full each of the device's per-resource-class memory pools is right now
+         */
+        [[nodiscard]] std::vector<rhi::RhiMemoryPoolStats> get_memory_pool_stats() const;
+
+        /*!
+         * \brief Gets where all of Nova's memory went: what every category and owner of device memory has live and at its peak, the
+         * loaded renderpack's share of it, and Nova's own CPU arenas
+         *
+         * Call it from the thread that calls `execute_frame`, since the CPU arenas aren't thread-safe. Fine to call every frame for an
+         * overlay, but it copies every owner's totals, so don't call it more than that
+         */
+        [[nodiscard]] MemoryReport get_memory_report() const;
+
+        /*!
+         * \brief Gets how long the GPU spent on each renderpass and material pass in the most recent frame that it finished
+         *
+         * The timings lag a few frames behind the frame being rendered. Empty if GPU profiling is disabled or the device can't write
+         * timestamps
+         */
+        [[nodiscard]] const std::vector<GpuPassTiming>& get_frame_gpu_timings() const;
+
+        /*!
+         * \brief Gets what the GPU counted in each renderpass of the most recent frame that it finished
+         *
+         * Empty unless `NovaSettings::gpu_profiling.pipeline_statistics` is on and the device can count pipeline statistics
+         */
+        [[nodiscard]] const std::vector<GpuPassStatistics>& get_frame_pipeline_statistics() const;
+
+        /*!
+         * \brief Gets how long the CPU spent in each phase of the frame, and recording each renderpass, over the last few seconds
+         *
+         * Empty if `NovaSettings::cpu_timeline` is off. The percentiles are computed from every scope in the window, so don't call
+         * this every frame
+         *
+         * \param seconds How far back to look
+         */
+        [[nodiscard]] std::vector<CpuPhaseTiming> get_cpu_phase_timings(float seconds = 5.0f) const;
+
+        /*!
+         * \brief Writes the last `NovaSettings::cpu_timeline.trace_seconds` of the CPU timeline to a Chrome trace file, which
+         * chrome://tracing and Perfetto can open
+         *
+         * May be called from any thread. Nova writes these by itself when a frame hitches, see `NovaSettings::cpu_timeline`
+         *
+         * \return True if the file was written, false if the timeline is off or the file couldn't be written
+         */
+        bool write_cpu_trace(const std::filesystem::path& path) const;
+
+        /*!
+         * \brief Gets the draws, binds, barriers, and uploads that the most recent call to `execute_frame` recorded
+         *
+         * With a render thread, this is the frame before the one that the render thread is recording now
+         */
+        [[nodiscard]] const rhi::RhiCommandListStats& get_frame_stats() const;
+
+        /*!
+         * \brief Gets the number of temporaries that the most recent call to `execute_frame` allocated on the general heap because they
+         * didn't fit in its frame arena. Should be zero once the renderer's warmed up
+         */
+        [[nodiscard]] uint64_t get_frame_arena_escapes() const;
+
+        /*!
+         * \brief Gets the fraction of the full resolution, in each dimension, that the scene renders at. Always 1 unless
+         * `NovaSettings::dynamic_resolution` is on or the renderpack uses the temporal upscale pass
+         */
+        [[nodiscard]] float get_resolution_scale() const;
+
+        /*!
+         * \brief Replaces the upscaler that the temporal upscale pass runs. Renderpacks that use the pass get Nova's own accumulating
+         * upscaler until this is called
+         *
+         * Waits for the GPU to finish with the old upscaler, so don't call it every frame. Pass nullptr to go back to Nova's upscaler
+         */
+        void set_temporal_upscaler(std::unique_ptr<TemporalUpscaler> upscaler);
 #pragma endregion
 
 #pragma region Resources
@@ -176,11 +583,33 @@ namespace nova::renderer {
         /*!
          * \brief Creates a new material of the specified type
          *
+         * Nova only uploads material data that changed. If you write to the material through the returned pointer after this frame, call
+         * `mark_material_dirty` so the GPU sees the new values
+         *
+         * The material's index never changes, but the pointer is only valid until the next material is created, since the material buffer
+         * may grow
+         *
          * \return A pointer to the new material, or nullptr if the material can't be created for whatever reason
          */
         template <typename MaterialType>
         [[nodiscard]] std::pair<uint32_t, MaterialType*> create_material();
 
+        /*!
+         * \brief Tells Nova that a material's data changed, so it gets uploaded to every in-flight frame's material buffer
+         *
+         * \param idx The index that `create_material` returned for the material
+         */
+        template <typename MaterialType>
+        void mark_material_dirty(uint32_t idx);
+
+        /*!
+         * \brief Frees a material's space in the material buffer. Its index may be handed to the next material of the same size
+         *
+         * \param idx The index that `create_material` returned for the material
+         */
+        template <typename MaterialType>
+        void destroy_material(uint32_t idx);
+
         /*!
          * \brief Gets the pipeline with the provided name
          *
@@ -190,11 +619,35 @@ namespace nova::renderer {
          */
         [[nodiscard]] Pipeline* find_pipeline(const std::string& pipeline_name);
 
+        /*!
+         * \brief Gets the pipeline with the provided handle
+         *
+         * \return The pipeline if it's done compiling, or nullptr if it isn't
+         */
+        [[nodiscard]] Pipeline* get_pipeline(PipelineHandle pipeline);
+
+        /*!
+         * \brief Finds out where a material pass lives, so that renderables can be added to it without looking it up by name every time
+         */
+        [[nodiscard]] std::optional<MaterialPassKey> find_material_pass(const FullMaterialPassName& material_name) const;
+
 #pragma endregion
 
+        /*!
+         * \brief Adds a renderable to a material pass
+         *
+         * With a render thread, the renderable is added when the render thread starts on the next frame. The ID is valid right away, and
+         * you may update or remove the renderable with it before then
+         */
         [[nodiscard]] RenderableId add_renderable_for_material(const FullMaterialPassName& material_name,
                                                                const StaticMeshRenderableCreateInfo& create_info);
 
+        /*!
+         * \brief Adds a renderable to a material pass that `find_material_pass` already found
+         */
+        [[nodiscard]] RenderableId add_renderable_for_material(const MaterialPassKey& pass_key,
+                                                               const StaticMeshRenderableCreateInfo& create_info);
+
         /*!
          * \brief Updates a renderable's information
          *
@@ -203,17 +656,63 @@ namespace nova::renderer {
          */
         void update_renderable(RenderableId renderable, const StaticMeshRenderableUpdateData& update_data);
 
+        /*!
+         * \brief Updates lots of renderables at once. Their model matrices are built together, several at a time
+         */
+        void update_renderables(std::span<const StaticMeshRenderableUpdate> updates);
+
+        /*!
+         * \brief Removes a renderable, so it isn't drawn anymore
+         *
+         * The last renderable in the same batch moves into the removed renderable's place, so this doesn't have to shift anything
+         */
+        void remove_renderable(RenderableId renderable);
+
+        void remove_renderables(std::span<const RenderableId> renderables_to_remove);
+
         [[nodiscard]] CameraAccessor create_camera(const CameraCreateInfo& create_info);
 
         [[nodiscard]] rhi::RenderDevice& get_device() const;
 
+        /*!
+         * \brief The scheduler that Nova runs its background and parallel work on. Host applications may add their own tasks to it
+         */
+        [[nodiscard]] TaskScheduler& get_task_scheduler() const;
+
         [[nodiscard]] NovaWindow& get_window() const;
 
+        /*!
+         * \brief Shows every frame somewhere else too, either in a window of its own or in a render target that can be read back
+         *
+         * The frame is still only recorded once, and each output gets a filtered copy of its source at its own size. Only call this from
+         * the main thread. It waits for the render thread, if there is one
+         *
+         * \return The output's ID, or nothing if it couldn't be made
+         */
+        [[nodiscard]] std::optional<RenderOutputId> add_render_output(const RenderOutputCreateInfo& create_info);
+
+        /*!
+         * \brief Stops showing frames in an output, and closes its window. Waits for the GPU to be done with it
+         */
+        void remove_render_output(RenderOutputId id);
+
+        /*!
+         * \brief Gets the window of an output from `add_render_output`, or nullptr if the output doesn't have one
+         */
+        [[nodiscard]] NovaWindow* get_render_output_window(RenderOutputId id) const;
+
+        /*!
+         * \brief The batcher that draws 2D UI in the UI renderpass. Add textures and images to it up front, and fill it in `render_ui`
+         */
+        [[nodiscard]] UiBatcher& get_ui_batcher() const;
+
         [[nodiscard]] DeviceResources& get_resource_manager() const;
 
     private:
         NovaSettingsAccessManager settings;
 
+        std::shared_ptr<TaskScheduler> task_scheduler;
+
         std::unique_ptr<rhi::RenderDevice> device;
         std::unique_ptr<NovaWindow> window;
         rhi::Swapchain* swapchain;
@@ -222,8 +721,15 @@ namespace nova::renderer {
 
         rhi::RhiSampler* point_sampler;
 
+        rhi::RhiSampler* bilinear_sampler;
+
         MeshId fullscreen_triangle_id;
 
+        /*!
+         * \brief The quad that every particle is drawn with, with its corners in `main_uv`
+         */
+        MeshId particle_quad_id;
+
         std::unique_ptr<DeviceResources> device_resources;
 
         rhi::RhiDescriptorPool* global_descriptor_pool;
@@ -245,6 +751,15 @@ namespace nova::renderer {
 
         void create_builtin_uniform_buffers();
 
+        /*!
+         * \brief Replaces a frame slot's material device buffer with one that's as large as the material buffer
+         *
+         * The slot's previous frame must be done with the old buffer
+         */
+        void recreate_material_device_buffer(uint32_t frame_idx);
+
+        void create_mesh_arenas();
+
         void create_builtin_meshes();
 
         void create_renderpass_manager();
@@ -268,68 +783,686 @@ namespace nova::renderer {
         std::optional<renderpack::RenderpackData> loaded_renderpack;
 
         std::unique_ptr<Rendergraph> rendergraph;
-#pragma endregion
 
-#pragma region Rendergraph
-        std::unordered_map<std::string, rhi::RhiImage*> builtin_images;
-        std::unordered_map<std::string, renderer::Renderpass*> builtin_renderpasses;
+        /*!
+         * \brief Watches the loaded renderpack's files. Only exists if `debug.renderpack_hot_reload` is enabled
+         */
+        std::unique_ptr<filesystem::FolderWatcher> renderpack_watcher;
 
-        std::unordered_map<std::string, renderpack::TextureCreateInfo> dynamic_texture_infos;
+        std::chrono::steady_clock::time_point last_renderpack_poll_time;
 
-        void create_dynamic_textures(const std::vector<renderpack::TextureCreateInfo>& texture_create_infos);
+        /*!
+         * \brief The renderpack that started loading when Nova did, until `load_renderpack` takes it. See `cache.preload_renderpack`
+         */
+        std::optional<std::future<renderpack::RenderpackData>> preloaded_renderpack;
 
-        void create_render_passes(const std::vector<renderpack::RenderPassCreateInfo>& pass_create_infos,
-                                  const std::vector<renderpack::PipelineData>& pipelines) const;
+        std::string preloaded_renderpack_name;
 
-        void destroy_dynamic_resources();
+        /*!
+         * \brief Starts loading the renderpack in `cache.loaded_renderpack` on the task scheduler, if it exists
+         */
+        void start_renderpack_preload();
 
-        void destroy_renderpasses();
+        /*!
+         * \brief Waits for the preloaded renderpack and hands it over if it's the one asked for
+         *
+         * \return The preloaded renderpack's data, or nothing if there isn't one or it's a different renderpack
+         */
+        [[nodiscard]] std::optional<renderpack::RenderpackData> take_preloaded_renderpack(const std::string& renderpack_name);
+
+        /*!
+         * \brief Destroys the current renderpack's resources, if there is one, and creates the resources for the provided renderpack
+         *
+         * \return A future that becomes ready once all the new renderpack's pipelines are done compiling
+         */
+        std::shared_future<void> replace_renderpack(renderpack::RenderpackData data);
+
+        /*!
+         * \brief Checks if any of the loaded renderpack's files changed, and reloads the parts of the renderpack that they affect
+         *
+         * This must only be called between frames
+         */
+        void reload_changed_renderpack_files();
+
+        /*!
+         * \brief Recompiles the pipelines and recreates the materials that the changed files affect, leaving the renderpack's textures and
+         * renderpasses alone
+         *
+         * A pipeline is recompiled if its pipeline file changed or if any of its shaders compiled to different SPIR-V, which catches edits
+         * to included files. The SPIR-V cache means that only the shaders that actually changed are compiled again
+         *
+         * \param data The freshly loaded renderpack data
+         * \param changed_files The files that changed, relative to the renderpack's root
+         *
+         * \return False if the changes can't be applied without reloading the whole renderpack, like when a pipeline moves to a different
+         * renderpass. Nothing is changed in that case
+         */
+        bool reload_pipelines_and_materials(renderpack::RenderpackData& data, const std::vector<std::string>& changed_files);
+#pragma endregion
+
+#pragma region Rendergraph
+        std::unordered_map<std::string, rhi::RhiImage*> builtin_images;
+        std::unordered_map<std::string, renderer::Renderpass*> builtin_renderpasses;
+
+        std::unordered_map<std::string, renderpack::TextureCreateInfo> dynamic_texture_infos;
+
+        /*!
+         * \brief Creates the renderpack's render targets. Render targets that are never in use at the same time share memory
+         *
+         * \param texture_create_infos The render targets to create
+         * \param pass_create_infos The renderpack's passes, which decide when each render target is in use
+         */
+        void create_dynamic_textures(const std::vector<renderpack::TextureCreateInfo>& texture_create_infos,
+                                     const std::vector<renderpack::RenderPassCreateInfo>& pass_create_infos);
+
+        void create_render_passes(const std::vector<renderpack::RenderPassCreateInfo>& pass_create_infos,
+                                  const std::vector<renderpack::PipelineData>& pipelines);
+
+        /*!
+         * \brief Creates a ComputeRenderpass for a renderpack pass with a compute shader, and binds the textures its shader uses
+         */
+        void create_compute_renderpass(const renderpack::RenderPassCreateInfo& create_info) const;
+
+        /*!
+         * \brief Adds the depth pyramid pass and its render target to a renderpack that asked for it in `builtinPasses`
+         *
+         * The pyramid reads the depth of the first pass with a depth prepass, or of the first pass that writes depth if none have one
+         */
+        void add_depth_pyramid_pass(renderpack::RenderpackData& data);
+
+        void create_depth_pyramid_renderpass(const renderpack::RenderPassCreateInfo& create_info) const;
+
+        /*!
+         * \brief Adds a bilateral upsample pass for each of the `upsampleOutputs` of the renderpack's passes
+         */
+        void add_upsample_passes(renderpack::RenderpackData& data) const;
+
+        void create_upsample_renderpass(const renderpack::RenderPassCreateInfo& create_info) const;
+
+        /*!
+         * \brief Gives each pass with `orderIndependentTransparency` its accumulation and coverage textures, and adds the pass that
+         * blends them over its color output right after it
+         */
+        void add_oit_passes(renderpack::RenderpackData& data) const;
+
+        void create_oit_composite_renderpass(const renderpack::RenderPassCreateInfo& create_info) const;
+
+        /*!
+         * \brief Finds the depth texture of the renderpack's main view of the scene: the first pass with a depth prepass, or the first
+         * pass that writes depth if none have one
+         */
+        [[nodiscard]] static const renderpack::TextureAttachmentInfo* find_scene_depth_texture(const renderpack::RenderpackData& data);
+
+        /*!
+         * \brief Adds the temporal upscale pass and its output to a renderpack that asked for it in `builtinPasses`, along with the
+         * camera motion vectors pass if none of the renderpack's passes write motion vectors
+         *
+         * \return Whether the renderpack will be upscaled
+         */
+        bool add_temporal_upscale_passes(renderpack::RenderpackData& data);
+
+        /*!
+         * \brief Makes the upscaler's resources for the current window size, then the pass that runs it
+         */
+        void create_temporal_upscale_renderpass(const renderpack::RenderPassCreateInfo& create_info) const;
+
+        void create_camera_motion_vectors_renderpass(const renderpack::RenderPassCreateInfo& create_info) const;
+
+        /*!
+         * \brief Adds the pass that fills in the shading rate image and the image itself, if any of the renderpack's passes have an
+         * adaptive shading rate that the device can do
+         */
+        void add_shading_rate_pass(renderpack::RenderpackData& data) const;
+
+        void create_shading_rate_renderpass(const renderpack::RenderPassCreateInfo& create_info) const;
+
+        void destroy_dynamic_resources();
+
+        void destroy_renderpasses();
+
+        /*!
+         * \brief Recreates the swapchain at the window's current size, along with everything that's sized relative to it
+         *
+         * The render targets, their framebuffers, and the builtin and compute renderpasses that bind them are recreated. Renderpasses,
+         * pipelines, and materials from the renderpack stay as they are - pipelines leave their viewport dynamic, so they keep working
+         * at the new size
+         */
+        void recreate_swapchain();
+
+        /*!
+         * \brief Checks if a renderpack pass may render at a lower resolution. Only passes whose outputs are all screen-relative can,
+         * because only those render targets are the size that the backbuffer output pass scales up from
+         */
+        [[nodiscard]] bool can_use_dynamic_resolution(const renderpack::RenderPassCreateInfo& create_info) const;
 #pragma endregion
 
 #pragma region Rendering pipelines
         /*!
-         * \brief Map from pipeline name to all the material passes that use that pipeline
+         * \brief All the material passes that use each pipeline, indexed by pipeline handle
          */
-        std::unordered_map<std::string, std::vector<MaterialPass>> passes_by_pipeline;
+        std::vector<std::vector<MaterialPass>> passes_by_pipeline;
+
+        /*!
+         * \brief How many times the renderables or materials of each pipeline changed, indexed by pipeline handle. Cached renderpasses
+         * render again when one of their pipelines' versions changes
+         */
+        std::vector<uint64_t> pipeline_scene_versions;
+
+        /*!
+         * \brief Each pipeline's material passes by what they bind and which variant they use, indexed by pipeline handle
+         *
+         * Material passes that bind the same resources with the same pipeline variant are one material pass, whatever their material is
+         * called, so their renderables go in the same batches. A material pass keeps its place when the renderpack reloads with different
+         * bindings, since renderables may already be in it
+         */
+        std::vector<std::unordered_map<std::string, uint32_t>> material_passes_by_signature;
+
+        std::unordered_map<std::string, PipelineHandle> pipeline_handles;
+
+        /*!
+         * \brief Returns the handle of the pipeline with the provided name, giving it a new handle if it doesn't have one yet
+         */
+        PipelineHandle get_pipeline_handle(const std::string& pipeline_name);
 
         std::unordered_map<FullMaterialPassName, MaterialPassMetadata> material_metadatas;
 
-        void create_pipelines_and_materials(const std::vector<renderpack::PipelineData>& pipeline_create_infos,
-                                            const std::vector<renderpack::MaterialData>& materials);
+        /*!
+         * \brief Renderpack pipelines that turned out exactly the same as an earlier pipeline once their defaults were filled in, mapped
+         * to that earlier pipeline
+         *
+         * Duplicates are never compiled. Their material passes go in the earlier pipeline, so their renderables can be drawn together
+         */
+        std::unordered_map<std::string, std::string> pipeline_aliases;
+
+        /*!
+         * \brief The current value of every renderpass option that's been set, by name
+         */
+        std::unordered_map<std::string, bool> renderpass_options;
+
+        /*!
+         * \brief Converts a renderpack pipeline to the RHI's pipeline state, with its specialization constants set from the renderpack
+         * and from `NovaSettings::specialization_constants`
+         */
+        [[nodiscard]] std::optional<RhiGraphicsPipelineState> make_pipeline_state(const renderpack::PipelineData& pipeline_data) const;
+
+        /*!
+         * \brief Fills in `pipeline_aliases`, and takes the duplicate pipelines out of their renderpasses
+         */
+        void find_duplicate_pipelines(const std::vector<renderpack::PipelineData>& pipeline_create_infos);
 
-        void create_materials_for_pipeline(const renderer::Pipeline& pipeline,
+        /*!
+         * \brief Creates all the renderpack's pipelines and starts compiling them on the task scheduler. Skips the pipelines in
+         * `pipeline_aliases`
+         *
+         * \return A future that becomes ready when every pipeline is done compiling
+         */
+        std::shared_future<void> compile_pipelines(const std::vector<renderpack::PipelineData>& pipeline_create_infos);
+
+        /*!
+         * \brief Creates the material passes that use a pipeline, and asks the pipeline for the variants they want
+         */
+        void create_materials_for_pipeline(renderer::Pipeline& pipeline,
                                            const std::vector<renderpack::MaterialData>& materials,
                                            const std::string& pipeline_name);
 
         void destroy_pipelines();
 
         void destroy_materials();
+
+        /*!
+         * \brief A pipeline that's compiling on the task scheduler
+         */
+        struct PendingPipeline {
+            Pipeline pipeline;
+
+            /*!
+             * \brief Becomes true if the pipeline compiled successfully, false if it didn't
+             */
+            std::future<bool> compiled;
+        };
+
+        /*!
+         * \brief Pipelines from the current renderpack that haven't been swapped into `pipelines` yet
+         */
+        std::vector<PendingPipeline> pending_pipelines;
+
+        /*!
+         * \brief Creates a pipeline's RHI pipelines and starts compiling them on the task scheduler
+         *
+         * \param rp_pipeline_state The pipeline to compile
+         * \param variant_keywords The keywords of the variant that `rp_pipeline_state`'s shaders are for, or nothing for the default
+         * variant
+         * \param on_compiled Called from the compile task once it's done, whether the pipeline compiled or not. May be empty
+         *
+         * \return The pipeline and its compile task, or nothing if the pipeline can't be created
+         */
+        std::optional<PendingPipeline> start_compiling_pipeline(const renderpack::PipelineData& rp_pipeline_state,
+                                                                const std::vector<std::string>& variant_keywords,
+                                                                std::function<void()> on_compiled);
+
+        /*!
+         * \brief A pipeline variant that a material pass asked for, which is being compiled in the background
+         *
+         * Variants compile in two steps: their shaders compile on the task scheduler, then their RHI pipelines are created between frames
+         * and compile on the task scheduler too
+         */
+        struct PendingPipelineVariant {
+            PipelineHandle pipeline{};
+
+            uint32_t variant_idx{};
+
+            std::vector<std::string> keywords;
+
+            /*!
+             * \brief The pipeline's default variant when the variant was asked for. If the pipeline was recompiled since, the variant is
+             * from the old pipeline and gets thrown away
+             */
+            const rhi::RhiPipeline* base_pipeline = nullptr;
+
+            std::future<std::optional<renderpack::PipelineData>> shaders;
+
+            /*!
+             * \brief The variant's RHI pipelines, once its shaders are done compiling
+             */
+            std::optional<PendingPipeline> compiling;
+        };
+
+        std::vector<PendingPipelineVariant> pending_pipeline_variants;
+
+        /*!
+         * \brief Finds the variant of a pipeline that has the requested keywords, and starts compiling it if nothing's asked for it before
+         *
+         * \return The variant's index in the pipeline's variants, or nothing if the requested keywords pick the default variant
+         */
+        std::optional<uint32_t> get_pipeline_variant(renderer::Pipeline& pipeline,
+                                                     const renderpack::PipelineData& pipeline_data,
+                                                     const std::vector<std::string>& requested_keywords);
+
+        /*!
+         * \brief Moves the pipeline variants that are done compiling into their pipelines, and starts creating the RHI pipelines of the
+         * variants whose shaders are done compiling
+         */
+        void swap_in_compiled_pipeline_variants();
+
+        /*!
+         * \brief Moves every pipeline that's done compiling from `pending_pipelines` into `pipelines`, and creates its materials. Also
+         * moves along the pipeline variants that are compiling
+         *
+         * This must only be called between frames, so a frame never sees a partially-added pipeline
+         */
+        void swap_in_compiled_pipelines();
+
+        /*!
+         * \brief Blocks until all the pipelines in `pending_pipelines`, and whichever step `pending_pipeline_variants` are on, are done
+         * compiling
+         */
+        void wait_for_pending_pipelines() const;
+
+        /*!
+         * \brief A pipeline that was replaced by a recompiled version of itself, but which in-flight frames may still use
+         */
+        struct RetiredPipeline {
+            Pipeline pipeline;
+
+            /*!
+             * \brief The frame that the pipeline was replaced in
+             */
+            uint64_t retired_frame;
+        };
+
+        std::vector<RetiredPipeline> retired_pipelines;
+
+        /*!
+         * \brief Destroys the retired pipelines that no in-flight frame can be using anymore
+         */
+        void destroy_retired_pipelines();
 #pragma endregion
 
 #pragma region Meshes
-        MeshId next_mesh_id = 0;
+        std::atomic<MeshId> next_mesh_id = 0;
 
         std::unordered_map<MeshId, Mesh> meshes;
         std::unordered_map<MeshId, ProceduralMesh> proc_meshes;
+
+        /*!
+         * \brief A destroyed mesh whose arena space in-flight frames may still read
+         */
+        struct RetiredMesh {
+            Mesh mesh;
+
+            uint64_t retired_frame;
+        };
+
+        std::vector<RetiredMesh> retired_meshes;
+
+        /*!
+         * \brief Gives the arena space of the retired meshes that no in-flight frame can be using back to the arenas
+         */
+        void free_retired_meshes();
+
+        struct PreparedMesh;
+
+        /*!
+         * \brief Does all the CPU-side work of making a mesh. Touches nothing that the scene thread owns, so any thread may call it
+         */
+        [[nodiscard]] std::optional<PreparedMesh> prepare_mesh(const MeshData& mesh_data) const;
+
+        /*!
+         * \brief Allocates arena space for a prepared mesh, queues its uploads, and adds it to `meshes`
+         */
+        bool register_mesh(MeshId new_mesh_id, PreparedMesh& prepared);
+
+        std::vector<std::unique_ptr<ChunkSectionPool>> chunk_section_pools;
+
+        struct ChunkSection {
+            ChunkSectionPoolId pool{};
+
+            MeshId mesh{};
+
+            RenderableId renderable{};
+
+            /*!
+             * \brief Whether the section's mesh has a slot in its pool. Sections without any indices don't need one
+             */
+            bool has_slot = false;
+
+            /*!
+             * \brief Whether the host wants the section drawn. It's only actually drawn if it has something to draw, too
+             */
+            bool visible = true;
+        };
+
+        ChunkSectionId next_chunk_section_id = 0;
+
+        std::unordered_map<ChunkSectionId, ChunkSection> chunk_sections;
+
+        /*!
+         * \brief Chunk section geometry that `set_chunk_section_geometry` copied, waiting to be uploaded
+         */
+        struct PendingChunkSectionGeometry {
+            ChunkSectionId section{};
+
+            std::vector<uint8_t> vertex_data;
+
+            std::vector<uint32_t> indices;
+
+            glm::vec3 aabb_min{};
+            glm::vec3 aabb_max{};
+        };
+
+        /*!
+         * \brief Guards `pending_chunk_geometry` and `pending_chunk_geometry_order`, since worker threads add to them
+         */
+        std::mutex pending_chunk_geometry_mutex;
+
+        std::unordered_map<ChunkSectionId, PendingChunkSectionGeometry> pending_chunk_geometry;
+
+        /*!
+         * \brief The sections in `pending_chunk_geometry`, in the order they first got new geometry. Sections that get new geometry
+         * again keep their place in line
+         */
+        std::deque<ChunkSectionId> pending_chunk_geometry_order;
+
+        std::vector<PendingChunkSectionGeometry> chunk_geometry_scratch;
+
+        /*!
+         * \brief Uploads the new geometry of as many chunk sections as `NovaSettings::UploadOptions` allows
+         */
+        void apply_pending_chunk_geometry();
+
+        void apply_chunk_section_geometry(PendingChunkSectionGeometry& geometry);
+
+        /*!
+         * \brief Shows a chunk section's renderable if it has something to draw and the host wants it drawn, and hides it if not
+         */
+        void update_chunk_section_visibility(const ChunkSection& section);
+
+        /*!
+         * \brief Evicts streamed resources when the device is low on memory
+         */
+        std::unique_ptr<ResidencyManager> residency;
+
+        /*!
+         * \brief The residency manager's ID for every mesh that may be evicted
+         */
+        std::unordered_map<MeshId, uint64_t> evictable_meshes;
+
+        std::vector<rhi::RhiMemoryHeapBudget> memory_budgets;
+
+        /*!
+         * \brief Refreshes the memory budgets, and lets the residency manager evict whatever it needs to
+         */
+        void update_residency();
+
+        /*!
+         * \brief Where every mesh's vertex data lives
+         */
+        std::unique_ptr<MeshArena> vertex_arena;
+
+        /*!
+         * \brief Where every mesh's index data lives
+         */
+        std::unique_ptr<MeshArena> index_arena;
+
+        /*!
+         * \brief Sends mesh data to the GPU in one transfer submission per frame
+         */
+        std::unique_ptr<UploadBatcher> upload_batcher;
+
+        std::unique_ptr<TextureStreamer> texture_streamer;
+
+        std::unique_ptr<VirtualTextureAtlas> virtual_textures;
+
+        /*!
+         * \brief Sorts the lights into the main camera's light clusters every frame
+         */
+        std::unique_ptr<LightClustering> light_clustering;
+
+        /*!
+         * \brief Simulates and draws the renderpack's particle emitters
+         */
+        std::unique_ptr<ParticleSystem> particle_system;
+
+        /*!
+         * \brief Batches the host's UI into a few draws at the end of the UI renderpass
+         */
+        std::unique_ptr<UiBatcher> ui_batcher;
+
+        /*!
+         * \brief Skins every skinned renderable's vertices once per frame, before any pass draws them
+         */
+        std::unique_ptr<SkinningSystem> skinning;
+
+        /*!
+         * \brief Builds the fog in front of the main camera every frame, in a froxel grid that lines up with the light clusters
+         */
+        std::unique_ptr<VolumetricFog> volumetric_fog;
+
+        /*!
+         * \brief Copies whatever `request_readback` asked for at the end of each frame
+         */
+        std::unique_ptr<ReadbackManager> readbacks;
+
+        /*!
+         * \brief The windows and render targets from `add_render_output`, which every frame is blitted to
+         */
+        std::unique_ptr<RenderOutputs> render_outputs;
+
+        /*!
+         * \brief Per-frame uniform and storage data that's rewritten every frame
+         */
+        std::unique_ptr<FrameUploadAllocator> frame_uploads;
+
+        /*!
+         * \brief Host memory for each frame's temporaries
+         */
+        std::unique_ptr<FrameArena> frame_arena;
 #pragma endregion
 
 #pragma region Rendering
         uint64_t frame_count = 0;
+
+        /*!
+         * \brief Index of the in-flight frame slot we're recording. Indexes the frame fences, semaphores, and per-frame buffers
+         */
         uint8_t cur_frame_idx = 0;
 
+        /*!
+         * \brief Index of the swapchain image that the current frame renders to. Not necessarily the same as cur_frame_idx
+         */
+        uint8_t cur_swapchain_image_idx = 0;
+
+        std::unique_ptr<FramePacer> frame_pacer;
+
+        /*!
+         * \brief Picks each frame's resolution scale. nullptr unless `NovaSettings::dynamic_resolution` is on
+         */
+        std::unique_ptr<DynamicResolutionController> dynamic_resolution;
+
+        /*!
+         * \brief What the temporal upscale pass runs. nullptr until a renderpack uses the pass or the host sets one
+         */
+        std::unique_ptr<TemporalUpscaler> temporal_upscaler;
+
+        /*!
+         * \brief Whether the loaded renderpack has the temporal upscale pass, so the scene renders at a lower resolution and the main
+         * camera is jittered
+         */
+        bool is_temporal_upscaling = false;
+
+        /*!
+         * \brief The main camera's jitter this frame and last, in render pixels. See `FrameContext::camera_jitter`
+         */
+        glm::vec2 camera_jitter{};
+        glm::vec2 previous_camera_jitter{};
+
+        /*!
+         * \brief Feeds the GPU time of the frame that the profiler just read back to the dynamic resolution controller
+         */
+        void update_resolution_scale();
+
+        /*!
+         * \brief Writes a hitch trace in the background if the last frame took longer than `NovaSettings::cpu_timeline.hitch_threshold_ms`
+         */
+        void check_for_hitch();
+
+        /*!
+         * \brief Whether the host already called `wait_for_frame_start` for the frame we're about to execute
+         */
+        bool waited_for_frame_start = false;
+
+#pragma region Render thread
+        std::thread render_thread;
+
+        std::mutex render_thread_mutex;
+        std::condition_variable render_thread_cv;
+
+        /*!
+         * \brief Set when the game thread hands a frame over, and cleared when the render thread is done with it. Guarded by
+         * `render_thread_mutex`
+         */
+        bool render_thread_has_frame = false;
+
+        bool should_stop_render_thread = false;
+
+        /*!
+         * \brief Commands that the game thread queued for the next frame. Only the game thread touches this, so queueing doesn't lock
+         */
+        std::vector<std::function<void()>> queued_scene_commands;
+
+        /*!
+         * \brief Commands that the render thread runs before the frame it's on. `execute_frame` swaps them with
+         * `queued_scene_commands` while the render thread is idle
+         */
+        std::vector<std::function<void()>> render_thread_commands;
+
+        /*!
+         * \brief The framebuffer size that the game thread saw when it handed over the current frame
+         */
+        glm::uvec2 frame_window_size{};
+
+        /*!
+         * \brief The thread that constructed the renderer and calls `execute_frame`
+         */
+        std::thread::id owner_thread_id;
+
+        /*!
+         * \brief The thread that may change the scene right away: the render thread if there is one, or else the owner thread
+         */
+        std::thread::id scene_thread_id;
+
+        /*!
+         * \brief Scene changes that threads other than the owner and the render thread made. Each thread always lands in the same
+         * shard, so its changes keep their order, and threads only contend when they hash to the same shard
+         */
+        struct StagingShard {
+            std::mutex mutex;
+
+            std::vector<std::pair<MeshId, std::shared_ptr<PreparedMesh>>> meshes;
+
+            std::vector<std::function<void()>> commands;
+        };
+
+        std::array<StagingShard, 16> staging_shards;
+
+        [[nodiscard]] bool is_scene_thread() const;
+
+        /*!
+         * \brief Queues a command for the scene thread to run before its next frame
+         */
+        void queue_scene_command(std::function<void()> command);
+
+        [[nodiscard]] StagingShard& get_staging_shard();
+
+        /*!
+         * \brief Registers the staged meshes, then runs the game thread's commands, then the commands that other threads staged
+         */
+        void apply_staged_scene_changes();
+
+        void render_thread_loop();
+
+        /*!
+         * \brief Records and submits one frame. Runs on the render thread if there is one, and in `execute_frame` if there isn't
+         */
+        void render_frame(glm::uvec2 window_size);
+#pragma endregion
+
+        std::function<void()> input_sample_callback;
+
         std::vector<std::string> builtin_buffer_names;
-        uint32_t cur_model_matrix_index = 0;
 
+        /*!
+         * \brief One fence per in-flight frame, signaled when the GPU finishes that frame
+         */
         std::vector<rhi::RhiFence*> frame_fences;
 
+        /*!
+         * \brief One semaphore per in-flight frame, signaled when that frame's swapchain image is ready to be rendered to
+         */
+        std::vector<rhi::RhiSemaphore*> image_available_semaphores;
+
+        /*!
+         * \brief One semaphore per in-flight frame, signaled when that frame's rendering is done and the image can be presented
+         */
+        std::vector<rhi::RhiSemaphore*> render_finished_semaphores;
+
+        /*!
+         * \brief The frame fence of the frame that most recently rendered to each swapchain image, or nullptr if the image is unused
+         */
+        std::vector<rhi::RhiFence*> swapchain_image_fences;
+
         std::unordered_map<FullMaterialPassName, MaterialPassKey> material_pass_keys;
-        std::unordered_map<std::string, Pipeline> pipelines;
+
+        /*!
+         * \brief Every pipeline, indexed by handle. Pipelines that haven't finished compiling have no RHI pipeline
+         */
+        std::vector<Pipeline> pipelines;
 
         std::unique_ptr<MaterialDataBuffer> material_buffer;
         std::vector<BufferResourceAccessor> material_device_buffers;
 
         struct RenderableKey {
-            std::string pipeline_name{};
+            PipelineHandle pipeline{};
             uint32_t material_pass_idx{};
             RenderableType type{};
             uint32_t batch_idx{};
@@ -338,12 +1471,199 @@ namespace nova::renderer {
 
         std::unordered_map<RenderableId, RenderableKey> renderable_keys;
 
+        /*!
+         * \brief Finds the renderable arrays of the batch that a renderable lives in
+         */
+        RenderableColumns& get_renderable_columns(const RenderableKey& key);
+
+        /*!
+         * \brief Gets the mesh batch that a static mesh renderable lives in
+         */
+        MeshBatch& get_mesh_batch(const RenderableKey& key);
+
+        /*!
+         * \brief Tells the occlusion cache where a renderable is now, or removes it from the cache if its mesh is too cheap to query or
+         * it's hidden
+         */
+        void update_occlusion_bounds(RenderableId renderable, const RenderableKey& key);
+
+        /*!
+         * \brief Adds a renderable with an ID that was handed out already
+         *
+         * \return False if the renderable couldn't be added
+         */
+        bool add_renderable(RenderableId id, const FullMaterialPassName& material_name, const StaticMeshRenderableCreateInfo& create_info);
+
+        bool add_renderable(RenderableId id, const MaterialPassKey& pass_key, const StaticMeshRenderableCreateInfo& create_info);
+
+        /*!
+         * \brief Where `update_renderables` splits the updates into one array per transform component, so `make_model_matrices` can
+         * work on them. Kept around so updating doesn't allocate every time
+         */
+        struct TransformScratch {
+            std::vector<glm::vec3> positions;
+            std::vector<glm::vec3> rotations;
+            std::vector<glm::vec3> scales;
+            std::vector<glm::mat4> model_matrices;
+        };
+
+        TransformScratch transform_scratch;
+
         std::vector<Camera> cameras;
+
+        /*!
+         * \brief The cameras as they were when the current frame started. The game may move `cameras` around while the render thread
+         * records, so everything in the frame reads this copy instead
+         */
+        std::vector<Camera> frame_cameras;
+
+        /*!
+         * \brief What a camera slot's matrices were last built from. Cameras that didn't change since then keep their matrices
+         */
+        struct CameraMatrixState {
+            glm::vec3 position{};
+            glm::vec3 rotation{};
+            float field_of_view = 0;
+            float aspect_ratio = 0;
+            float near_plane = 0;
+            float far_plane = 0;
+
+            /*!
+             * \brief The framebuffer size that a screen-space camera's projection was built for. Zero for perspective cameras
+             */
+            glm::uvec2 framebuffer_size{};
+
+            bool is_built = false;
+
+            /*!
+             * \brief Whether the slot's previous matrices have caught up with its current ones
+             */
+            bool previous_is_current = false;
+
+            /*!
+             * \brief The jitter, in NDC, that was added to a camera's projection. Only the main camera gets any
+             */
+            glm::vec2 jitter{};
+
+            [[nodiscard]] bool matches(const Camera& cam, glm::uvec2 cam_framebuffer_size, glm::vec2 cam_jitter) const;
+        };
+
+        /*!
+         * \brief One per camera slot
+         */
+        std::vector<CameraMatrixState> camera_matrix_states;
+
         std::unique_ptr<PerFrameDeviceArray<CameraUboData>> camera_data;
 
+        /*!
+         * \brief The cameras of a renderpass's views, and the run of camera slots that they're copied into every frame
+         */
+        struct ViewCameras {
+            uint32_t first_slot;
+
+            std::vector<std::string> camera_names;
+        };
+
+        /*!
+         * \brief The view cameras of every renderpack pass that has views
+         */
+        std::vector<ViewCameras> view_cameras;
+
+        std::unique_ptr<GpuCulling> gpu_culling;
+
+        std::unique_ptr<GpuProfiler> gpu_profiler;
+
+        std::unique_ptr<CpuTimeline> cpu_timeline;
+
+        /*!
+         * \brief When the last frame started and when the last hitch trace was written, on `cpu_timeline`'s clock
+         */
+        int64_t last_frame_start_ns = 0;
+        std::optional<int64_t> last_hitch_trace_ns;
+
+        /*!
+         * \brief The renderables that are worth occlusion querying, and what the queries found. Only there when occlusion queries are on
+         */
+        std::unique_ptr<VisibilityCache> occlusion_cache;
+
+        std::unique_ptr<OcclusionQueries> occlusion_queries;
+
+        /*!
+         * \brief The command stream that each renderpass records into when `command_streams` is on. Streams keep their memory from
+         * frame to frame
+         */
+        std::unordered_map<const Renderpass*, std::unique_ptr<rhi::CommandStream>> command_streams;
+
+        /*!
+         * \brief A secondary command list that a renderpass recorded in an earlier frame, and the recording key it was recorded with
+         */
+        struct ReusableContents {
+            rhi::RhiRenderCommandList* cmds = nullptr;
+
+            uint64_t recording_key = 0;
+        };
+
+        /*!
+         * \brief What each renderpass that reuses its commands recorded, indexed by frame slot. Every frame slot has its own per-frame
+         * resources, so each one needs its own commands
+         */
+        std::unordered_map<const Renderpass*, std::vector<ReusableContents>> reusable_contents;
+
+        /*!
+         * \brief The depth pyramid's count of finished thread groups. Made with the first renderpack that uses the pyramid
+         */
+        rhi::RhiBuffer* depth_pyramid_counter = nullptr;
+
+        rhi::RhiCommandListStats frame_stats;
+
+        /*!
+         * \brief What `get_frame_stats` returns. Copied from `frame_stats` once the render thread is done writing it
+         */
+        rhi::RhiCommandListStats published_frame_stats;
+
         void update_camera_matrix_buffer(uint32_t frame_idx);
 
-        std::vector<rhi::RhiImage*> get_all_images();
+        /*!
+         * \brief Sets the cache key of every cached renderpass from its pipelines, procedural meshes, and cameras, and works out which
+         * renderpasses with an update interval render this frame
+         */
+        void update_renderpass_cache_keys(float resolution_scale);
+
+        /*!
+         * \brief Mixes the pipelines and procedural meshes that a renderpass draws into a cache key
+         */
+        void mix_scene_into_cache_key(uint64_t& key, const Renderpass& renderpass);
+
+        /*!
+         * \brief Whether any of a renderpass's material passes draws a particle emitter
+         */
+        [[nodiscard]] bool draws_particles(const Renderpass& renderpass) const;
+
+        /*!
+         * \brief Sums up everything that the commands a renderpass records depend on. Cameras aren't part of it, since the commands only
+         * refer to the cameras' slots
+         */
+        [[nodiscard]] uint64_t get_recording_key(const Renderpass& renderpass, const FrameContext& ctx);
+
+        /*!
+         * \brief Destroys every renderpass's reusable contents, so they all record again next time
+         */
+        void release_reusable_contents();
+
+        /*!
+         * \brief Records the contents of every renderpass on the task scheduler, then executes them all in order in the provided primary
+         * command list
+         *
+         * Contents go in secondary command lists, or in command streams that get translated into `cmds` if `command_streams` is on.
+         * Renderpasses that reuse their commands execute what they recorded for this frame slot, if nothing it depends on has changed
+         *
+         * \param renderpass_order The renderpasses of one graphics submission, in execution order
+         */
+        void record_renderpasses_in_parallel(const std::vector<Renderpass*>& renderpass_order,
+                                             rhi::RhiRenderCommandList& cmds,
+                                             FrameContext& ctx);
+
+        std::pmr::vector<rhi::RhiImage*> get_all_images(std::pmr::memory_resource* allocator);
 #pragma endregion
     };
 
@@ -359,4 +1679,14 @@ namespace nova::renderer {
         const auto idx = material_buffer->get_next_free_index<MaterialType>();
         return {idx, &material_buffer->at<MaterialType>(idx)};
     }
+
+    template <typename MaterialType>
+    void NovaRenderer::mark_material_dirty(const uint32_t idx) {
+        material_buffer->mark_dirty<MaterialType>(idx);
+    }
+
+    template <typename MaterialType>
+    void NovaRenderer::destroy_material(const uint32_t idx) {
+        material_buffer->free_index<MaterialType>(idx);
+    }
 } // namespace nova::renderer
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <cstdint>
 
@@ -12,6 +13,57 @@ namespace nova::renderer {
         uint32_t patch;
     };
 
+    /*!
+     * \brief How finished frames are shown on the display
+     */
+    enum class PresentMode {
+        /*!
+         * \brief Shows the newest finished frame at each vertical blank, and throws away any frames that were never shown. Lowest latency
+         * without tearing, but the GPU renders frames that nobody sees
+         */
+        Mailbox,
+
+        /*!
+         * \brief Shows each frame as soon as it's finished, even if the display is in the middle of scanning out the last one. Lowest
+         * latency, but it tears
+         */
+        Immediate,
+
+        /*!
+         * \brief Shows the frames in order, one per vertical blank. Never tears, and the GPU only renders as many frames as the display can
+         * show, which saves power. Every display can do this
+         */
+        Fifo,
+
+        /*!
+         * \brief Like `Fifo`, except a frame that was late for its vertical blank is shown right away instead of waiting for the next one.
+         * Only late frames tear
+         */
+        FifoRelaxed,
+    };
+
+    /*!
+     * \brief How much precision render targets keep, for the render targets that say what they hold with `TextureFormat::precision`
+     */
+    enum class RenderTargetPrecision {
+        /*!
+         * \brief Every render target gets the format that the renderpack asked for
+         */
+        Full,
+
+        /*!
+         * \brief HDR color, normals, and velocity get 32-bit formats that are about as good as the renderpack's. Packed material values
+         * keep the renderpack's format
+         */
+        Balanced,
+
+        /*!
+         * \brief Like `Balanced`, but packed material values get eight bits each and velocity gets 16-bit fixed point. Least bandwidth,
+         * for high resolutions and slow GPUs
+         */
+        Compact,
+    };
+
     class NovaSettingsAccessManager;
 
     /*!
@@ -60,8 +112,8 @@ namespace nova::renderer {
         /*!
          * \brief Options for configuring the way mesh memory is allocated
          *
-         * Nova tries to be clever and optimize how it draws meshes with indirect rendering. It shoves everything into
-         * a handful of giant buffers, to facilitate indirect rendering. These options are how you configure that
+         * Nova doesn't give each mesh its own buffers. It sub-allocates all meshes from a handful of giant buffers, so that it can draw
+         * many meshes without binding new vertex or index buffers. These options are how you configure those buffers
          */
         struct BlockAllocatorSettings {
             /*!
@@ -75,18 +127,9 @@ namespace nova::renderer {
              * \brief The size of one buffer
              *
              * Nova doesn't allocate `max_total_allocation` memory initially. It only allocates a single buffer of
-             * `new_buffer_size` size, then allocates new buffers as needed
-             *
-             * This number must be a whole-number multiple of `buffer_part_size`
+             * `new_buffer_size` size, then allocates new buffers as needed. No single mesh may be larger than this
              */
             uint32_t new_buffer_size = 16 * 1024 * 1024;
-
-            /*!
-             * \brief The size of one allocation from a buffer
-             *
-             * Nova gives meshes one or more allocations from a given buffer.
-             */
-            uint32_t buffer_part_size = 16 * 1024;
         };
 
         /*!
@@ -140,6 +183,21 @@ namespace nova::renderer {
                 const char* capture_path = "logs/captures";
 
             } renderdoc;
+
+            struct {
+                /*!
+                 * \brief If true, Nova watches the loaded renderpack's files, and when they change it recompiles only the pipelines and
+                 * materials that changed, without stalling the GPU
+                 *
+                 * Changes to the renderpack's resources or rendergraph still reload the whole renderpack
+                 */
+                bool enabled = false;
+
+                /*!
+                 * \brief How often, in milliseconds, to check the renderpack's files for changes
+                 */
+                uint32_t poll_interval_ms = 500;
+            } renderpack_hot_reload;
         } debug;
 
         /*!
@@ -152,6 +210,45 @@ namespace nova::renderer {
              * Nova requires a renderpack to render anything, so we need to know which one to load on application start
              */
             const char* loaded_renderpack = "DefaultShaderpack";
+
+            /*!
+             * \brief If true, Nova starts loading `loaded_renderpack` in the background as soon as it starts, while it creates the window
+             * and the device
+             *
+             * `NovaRenderer::load_renderpack` uses the preloaded renderpack if it's asked for that same one. Turn this off if the
+             * application always picks its own renderpack, or the preload is wasted work
+             */
+            bool preload_renderpack = true;
+
+            /*!
+             * \brief Directory where Nova saves the driver's compiled pipelines between runs
+             *
+             * Each GPU and driver version gets its own file in this directory
+             */
+            const char* pipeline_cache_directory = "cache/pipelines";
+
+            /*!
+             * \brief Directory where Nova saves compiled SPIR-V and the reflections of it, so that loading a renderpack doesn't have to
+             * recompile shaders that haven't changed
+             */
+            const char* shader_cache_directory = "cache/shaders";
+
+            /*!
+             * \brief How many compiled shaders to keep in memory, in addition to saving them to disk
+             */
+            uint32_t max_in_memory_shaders = 256;
+
+            /*!
+             * \brief Directory where Nova saves every renderpack it loads, already parsed and compiled, so the next load of the same
+             * renderpack is a single file read
+             */
+            const char* renderpack_cache_directory = "cache/renderpacks";
+
+            /*!
+             * \brief Directory where Nova saves the list of files in each big zip archive it opens, so opening the same archive again
+             * doesn't have to list them again
+             */
+            const char* path_index_cache_directory = "cache/paths";
         } cache;
 
         /*!
@@ -172,8 +269,60 @@ namespace nova::renderer {
              * \brief The height of the window
              */
             uint32_t height{};
+
+            /*!
+             * \brief If false, the window is never shown. Nova still renders to its swapchain, which is how nova-bench renders offscreen
+             */
+            bool visible = true;
         } window;
 
+        /*!
+         * \brief Options for the swapchain that Nova presents to
+         */
+        struct SwapchainOptions {
+            /*!
+             * \brief How Nova presents finished frames. If the display can't present this way, Nova uses the closest mode that it can do
+             *
+             * `Mailbox` and `Immediate` are for when latency matters most, like on high refresh rate displays. `Fifo` saves power
+             */
+            PresentMode present_mode = PresentMode::Mailbox;
+
+            /*!
+             * \brief The number of images to ask for. The display may need more or allow fewer, in which case Nova uses the nearest
+             * number it can
+             *
+             * More images let the CPU get further ahead of the display, which smooths out uneven frames but adds latency
+             */
+            uint32_t num_images = 3;
+        } swapchain;
+
+        /*!
+         * \brief Options for when Nova starts each frame
+         */
+        struct FramePacingOptions {
+            /*!
+             * \brief The most frames per second that Nova will render. 0 means there's no limit
+             */
+            float max_frame_rate = 0.0f;
+
+            /*!
+             * \brief Starts each frame as late as it can while still making the next vertical blank, instead of as soon as there's room
+             * in the frame queue
+             *
+             * Deep frame queues keep the GPU busy, but every queued frame is another frame between sampling input and seeing the result.
+             * This keeps at most one frame in flight, and if the device can tell when frames reach the display it also waits to start
+             * each frame until just before it has to. Use `NovaRenderer::wait_for_frame_start` or
+             * `NovaRenderer::set_input_sample_callback` to sample input after the wait
+             */
+            bool just_in_time = false;
+
+            /*!
+             * \brief How many milliseconds early to start a just-in-time frame, so a frame that's a little slower than usual still makes
+             * its vertical blank
+             */
+            float safety_margin_ms = 1.0f;
+        } frame_pacing;
+
         /*!
          * \brief Options that are specific to Nova's Vulkan rendering backend
          */
@@ -187,8 +336,52 @@ namespace nova::renderer {
              * \brief The application version to pass to Vulkan
              */
             Semver application_version = {0, 8, 4};
+
+            /*!
+             * \brief Whether to use VK_KHR_dynamic_rendering when the GPU supports it
+             *
+             * Single-subpass passes then begin rendering with their attachments' image views, and don't need a VkRenderPass or
+             * VkFramebuffer. Resizing the window or changing the render resolution only replaces those views. Turn this off to make every
+             * pass use a VkRenderPass, like drivers without the extension do
+             */
+            bool use_dynamic_rendering = true;
+
+            /*!
+             * \brief Whether to give the driver Nova's own host allocator, instead of letting it use its own
+             *
+             * Nova's allocator keeps small allocations in per-thread pools, which helps when pipelines compile on many threads at once and
+             * lets Nova track how much host memory the driver uses. Some drivers are already fast at this, so release builds may want to
+             * turn it off and pass no allocation callbacks at all
+             */
+            bool use_host_allocator = true;
         } vulkan;
 
+        /*!
+         * \brief Options for the null render device, which records commands instead of sending them to a GPU
+         */
+        struct NullDeviceOptions {
+            /*!
+             * \brief Whether to render with the null device instead of Vulkan
+             *
+             * Nothing gets drawn, but Nova still does all of its CPU work, so this is how to profile the CPU side of a frame on its own or
+             * run Nova on a machine without a GPU
+             *
+             * Builds with `NOVA_STATIC_VULKAN_RHI` ignore this and always use Vulkan
+             */
+            bool enabled = false;
+
+            /*!
+             * \brief If not empty, every command list submitted to the null device is written to this file. nova-capture-diff compares
+             * two captures
+             */
+            std::string capture_path;
+
+            /*!
+             * \brief The memory budget that the null device reports, in bytes. Lower it to put Nova under memory pressure
+             */
+            uint64_t memory_budget = 4ULL * 1024 * 1024 * 1024;
+        } null_device;
+
         /*!
          * \brief Information about the system we're running on
          */
@@ -199,8 +392,508 @@ namespace nova::renderer {
             bool is_uma = false;
         } system_info;
 
+        /*!
+         * \brief Options for how Nova spreads its work across threads
+         */
+        struct ThreadingOptions {
+            /*!
+             * \brief The number of worker threads Nova starts, in addition to the thread that calls `execute_frame`
+             *
+             * If this is zero, Nova does everything on the calling thread. If the host application gives Nova its own task scheduler,
+             * Nova uses however many workers that scheduler has instead
+             */
+            uint32_t num_worker_threads = 3;
+
+            /*!
+             * \brief If true, Nova records each renderpass into a secondary command list on a worker thread, then stitches all the
+             * secondary command lists together in the frame's primary command list
+             */
+            bool parallel_command_recording = true;
+
+            /*!
+             * \brief If true, the worker threads record renderpasses into Nova's own command streams instead of secondary command lists,
+             * and the thread that records the primary command list translates them into it
+             *
+             * The streams drop redundant binds before they get anywhere near the driver, and the contents end up inline in the primary
+             * command list. Does nothing unless `parallel_command_recording` is on
+             */
+            bool command_streams = false;
+
+            /*!
+             * \brief If true, Nova records and submits frames on a thread of its own, so the game can simulate the next frame while
+             * Nova records the current one
+             *
+             * The game thread hands each frame over in `execute_frame`. Adding, updating, and removing renderables, showing, hiding, and
+             * destroying chunk sections, and moving cameras are all safe to do from the game thread at any time, since Nova queues them
+             * for the next frame. Chunk section geometry has its own queue. Everything else that touches the scene or the device, such as
+             * creating meshes or loading a renderpack, has to go through `NovaRenderer::run_on_render_thread` or come after
+             * `NovaRenderer::wait_for_render_thread`
+             *
+             * The render thread records with thread index 0, so the game thread shouldn't run tasks from Nova's task scheduler
+             */
+            bool render_thread = false;
+        } threading;
+
+        /*!
+         * \brief Options for how Nova decides what to draw
+         */
+        struct CullingOptions {
+            /*!
+             * \brief If true, Nova's culling shader skips static meshes that are outside the main camera's frustum. If false, it still
+             * builds the indirect draws, but draws every visible renderable whether it's on screen or not
+             */
+            bool frustum_culling = true;
+
+            /*!
+             * \brief If true, the culling shader also skips meshlets whose triangles all face away from the main camera. Only meshes
+             * created with `MeshData::build_meshlets` have meshlets
+             */
+            bool cone_culling = true;
+
+            /*!
+             * \brief How many visible renderables the culling buffers have room for at first
+             *
+             * The buffers double in size whenever a frame has more visible renderables than they fit. Each frame slot grows its own
+             * buffers at the start of its frame, so growing never waits for the GPU. Set this to about how many renderables your scenes
+             * have to skip the first few reallocations
+             */
+            uint32_t initial_renderable_capacity = 0x10000;
+
+            /*!
+             * \brief If true, Nova draws the bounding boxes of big meshes against the depth prepass with hardware occlusion queries, and
+             * stops drawing the ones whose boxes are entirely hidden
+             *
+             * Query results are read back when their frame slot comes around again, so a mesh that comes out from behind something
+             * may pop in a few frames late. The boxes are bigger than the meshes inside them, which hides most of that. Only renderpasses
+             * with a depth prepass and no views run the queries
+             */
+            bool occlusion_queries = false;
+
+            /*!
+             * \brief How many indices a mesh needs before its renderables get occlusion queries. A query costs a draw of its own, so it
+             * only pays off for meshes that are expensive to draw
+             */
+            uint32_t occlusion_query_min_indices = 4096;
+
+            /*!
+             * \brief The most occlusion queries to run in one frame. Renderables past the limit are drawn without asking
+             */
+            uint32_t max_occlusion_queries_per_frame = 1024;
+        } culling;
+
+        /*!
+         * \brief Options for how Nova sorts lights into the clusters of the light cluster grid
+         *
+         * The grid cuts the main camera's frustum into tiles on the screen, and cuts each tile into slices that get thicker further from
+         * the camera. Shaders only loop over the lights that touch their pixel's cluster
+         */
+        struct LightClusteringOptions {
+            /*!
+             * \brief The most lights that may exist at once
+             */
+            uint32_t max_lights = 4096;
+
+            /*!
+             * \brief How many clusters the grid has across the screen, down the screen, and away from the camera
+             */
+            uint32_t grid_width = 16;
+            uint32_t grid_height = 9;
+            uint32_t grid_depth = 24;
+
+            /*!
+             * \brief The most light indices that all clusters together may have. Clusters past the limit lose some of their lights that
+             * frame
+             */
+            uint32_t max_light_indices = 256 * 1024;
+        } light_clustering;
+
+        /*!
+         * \brief Options for the fog that Nova builds in a froxel grid every frame
+         */
+        struct VolumetricFogOptions {
+            /*!
+             * \brief Whether to build the fog at all. Shaders still read the fog grid when this is off, but it never has any fog in it
+             */
+            bool enabled = true;
+
+            /*!
+             * \brief How many froxels each light cluster is cut into, across and down the screen, and away from the camera
+             */
+            uint32_t froxels_per_cluster_xy = 4;
+            uint32_t froxels_per_cluster_z = 2;
+
+            /*!
+             * \brief The most fog volumes that may exist at once
+             */
+            uint32_t max_fog_volumes = 64;
+
+            /*!
+             * \brief How much of each froxel's fog comes from the last frame's fog. Higher is smoother, but lags behind moving lights
+             */
+            float history_weight = 0.9f;
+        } volumetric_fog;
+
+        /*!
+         * \brief Options for skinned meshes, which Nova skins with a compute shader every frame. Their buffers are made once, up front
+         */
+        struct SkinningOptions {
+            /*!
+             * \brief The most bind pose vertices that all skinned meshes together may have
+             */
+            uint32_t max_mesh_vertices = 256 * 1024;
+
+            /*!
+             * \brief The most indices that all skinned meshes together may have
+             */
+            uint32_t max_mesh_indices = 1024 * 1024;
+
+            /*!
+             * \brief The most skinned vertices that all skinned renderables together may have. Every in-flight frame gets a buffer with
+             * room for this many
+             */
+            uint32_t max_renderable_vertices = 1024 * 1024;
+        } skinning;
+
+        /*!
+         * \brief Options for `UiBatcher`, which batches the host's 2D UI into a few draws
+         */
+        struct UiBatchingOptions {
+            /*!
+             * \brief Width and height of the atlas that UI images and glyphs are packed into, in pixels
+             */
+            uint32_t atlas_size = 1024;
+
+            /*!
+             * \brief How many quads each in-flight frame's vertex buffer has room for at first. It grows when a frame has more
+             */
+            uint32_t initial_quad_capacity = 4096;
+        } ui_batching;
+
+        /*!
+         * \brief Options for how Nova picks mesh LODs
+         */
+        struct LodOptions {
+            /*!
+             * \brief Renderables switch to a mesh's first generated LOD when their bounding sphere covers less than this fraction of
+             * the screen's height. Each generated LOD after that kicks in at half the size of the one before it
+             */
+            float first_lod_screen_size = 0.25f;
+
+            /*!
+             * \brief How far past a LOD's screen size a renderable has to go before it switches LODs, as a fraction of the screen size
+             */
+            float hysteresis = 0.1f;
+        } lod;
+
+        /*!
+         * \brief Options for how Nova uploads data to the GPU
+         */
+        struct UploadOptions {
+            /*!
+             * \brief Size, in bytes, of the staging buffer that mesh uploads are copied through
+             *
+             * All the uploads queued between two frames go through this buffer. If it fills up, Nova waits for the GPU to finish the
+             * uploads it already has before queuing more
+             */
+            uint32_t staging_buffer_size = 64 * 1024 * 1024;
+
+            /*!
+             * \brief Size, in bytes, of the memory that each in-flight frame gets for uniform and storage data that's rewritten every frame
+             *
+             * Allocations that don't fit in this fail, so make it large enough for your renderpack's busiest frame
+             */
+            uint32_t per_frame_upload_buffer_size = 4 * 1024 * 1024;
+
+            /*!
+             * \brief Size, in bytes, of the persistent staging buffer that small texture uploads are copied through
+             *
+             * Uploads larger than a quarter of this get their own pooled staging buffer
+             */
+            uint32_t staging_ring_size = 8 * 1024 * 1024;
+
+            /*!
+             * \brief The most memory, in bytes, that idle pooled staging buffers may hold on to
+             *
+             * When returning a staging buffer to the pool takes it over this, Nova destroys the buffers that have been idle the longest
+             */
+            uint32_t max_pooled_staging_memory = 64 * 1024 * 1024;
+
+            /*!
+             * \brief The most chunk sections that get new geometry in one frame. The rest wait for the next frame, so a burst of chunk
+             * rebuilds is spread over a few frames instead of all landing in one
+             */
+            uint32_t max_chunk_section_updates_per_frame = 512;
+        } uploads;
+
+        /*!
+         * \brief Options for how Nova stays within the device's memory budget
+         */
+        struct MemoryBudgetOptions {
+            /*!
+             * \brief When device-local memory usage goes over this fraction of the budget, Nova starts evicting streamed resources
+             */
+            float eviction_threshold = 0.9f;
+
+            /*!
+             * \brief The fraction of the budget that Nova evicts streamed resources down to
+             */
+            float eviction_target = 0.8f;
+        } memory_budget;
+
+        /*!
+         * \brief Options for how Nova moves meshes and textures around in device memory, so that long sessions don't fragment it
+         */
+        struct DefragmentationOptions {
+            bool enabled = true;
+
+            /*!
+             * \brief The most meshes and textures that may be moved in one frame
+             */
+            uint32_t max_moves_per_frame = 16;
+
+            /*!
+             * \brief The most bytes that may be copied in one frame
+             */
+            uint32_t max_bytes_per_frame = 16 * 1024 * 1024;
+
+            /*!
+             * \brief Frames that are expected to take longer than this don't move anything, so defragmentation never makes a slow frame
+             * slower
+             */
+            float max_frame_time_ms = 14.0f;
+        } defragmentation;
+
+        /*!
+         * \brief Options for how Nova streams the mips of streamed textures
+         */
+        struct TextureStreamingOptions {
+            /*!
+             * \brief Mips whose larger side is at most this many pixels are loaded as soon as a texture is added, and never evicted
+             */
+            uint32_t always_resident_size = 64;
+
+            /*!
+             * \brief The most textures that may be loading higher-resolution mips at once
+             */
+            uint32_t max_loads_in_flight = 4;
+        } texture_streaming;
+
+        /*!
+         * \brief Options for packing small textures into shared atlas pages, so that they don't each take up a slot in the textures array
+         */
+        struct TexturePackingOptions {
+            /*!
+             * \brief If false, every packed texture gets an image of its own
+             */
+            bool enabled = true;
+
+            /*!
+             * \brief Textures whose larger side is at most this many pixels are packed. Larger textures get an image of their own
+             */
+            uint32_t max_packed_size = 64;
+
+            /*!
+             * \brief The width and height of an atlas page, in pixels
+             */
+            uint32_t page_size = 1024;
+
+            /*!
+             * \brief How many pixels of the texture's opposite edge are copied around each packed texture, so that filtering near its
+             * edge wraps around instead of reading the next texture over. Bilinear filtering needs one
+             */
+            uint32_t border = 1;
+        } texture_packing;
+
+        /*!
+         * \brief Options for virtual textures, which are split into pages that are loaded into a fixed-size page cache when shaders ask
+         * for them
+         */
+        struct VirtualTexturingOptions {
+            /*!
+             * \brief The width and height of a page, in pixels
+             */
+            uint32_t page_size = 64;
+
+            /*!
+             * \brief The width and height of the page cache, in pages. The cache is always resident, and holds the square of this many
+             * pages
+             */
+            uint32_t cache_size_in_pages = 32;
+
+            /*!
+             * \brief The most virtual textures that may exist at once
+             */
+            uint32_t max_virtual_textures = 1024;
+
+            /*!
+             * \brief The most pages that all virtual textures together may have, including the pages of their mips
+             */
+            uint32_t max_virtual_pages = 256 * 1024;
+
+            /*!
+             * \brief The most pages that shaders may ask for in one frame. Requests past this are dropped, and asked for again next frame
+             */
+            uint32_t max_feedback_requests = 4096;
+
+            /*!
+             * \brief The most pages that may be loading at once
+             */
+            uint32_t max_page_loads_in_flight = 64;
+
+            /*!
+             * \brief The most pages that are copied into the page cache in one frame
+             */
+            uint32_t max_page_uploads_per_frame = 32;
+        } virtual_texturing;
+
+        /*!
+         * \brief Options for measuring how long the GPU spends on each pass
+         */
+        struct GpuProfilingOptions {
+            /*!
+             * \brief If true, Nova writes timestamps around every renderpass and material pass. See `NovaRenderer::get_frame_gpu_timings`
+             */
+            bool enabled = true;
+
+            /*!
+             * \brief The most renderpasses and material passes that Nova times in one frame
+             */
+            uint32_t max_timed_passes_per_frame = 256;
+
+            /*!
+             * \brief If true, Nova also counts the triangles, vertex shader invocations, and fragment shader invocations of every
+             * renderpass. See `NovaRenderer::get_frame_pipeline_statistics`
+             *
+             * Counting these may slow the GPU down a bit, so it's off by default
+             */
+            bool pipeline_statistics = false;
+        } gpu_profiling;
+
+        /*!
+         * \brief Options for the timeline of what the CPU did in the last few seconds, which is cheap enough to leave on for players
+         */
+        struct CpuTimelineOptions {
+            /*!
+             * \brief If true, Nova times each phase of every frame, like acquiring the swapchain image, recording each renderpass, and
+             * submitting. See `NovaRenderer::get_cpu_phase_timings` and `NovaRenderer::write_cpu_trace`
+             */
+            bool enabled = true;
+
+            /*!
+             * \brief How many timed scopes each thread keeps. Each one takes 64 bytes. Older scopes are dropped, so with many
+             * renderpasses at a high frame rate, traces may cover less time than `trace_seconds`
+             */
+            uint32_t events_per_thread = 32 * 1024;
+
+            /*!
+             * \brief How many seconds of the timeline go in a trace file
+             */
+            float trace_seconds = 10.0f;
+
+            /*!
+             * \brief When the time between two frames is longer than this, Nova writes a trace of the last `trace_seconds` to
+             * `hitch_trace_directory`. Zero turns that off
+             */
+            float hitch_threshold_ms = 100.0f;
+
+            /*!
+             * \brief Nova writes at most one hitch trace this often, so a loading screen that hitches every frame doesn't fill the disk
+             */
+            float min_seconds_between_hitch_traces = 60.0f;
+
+            const char* hitch_trace_directory = "logs/hitches";
+        } cpu_timeline;
+
+        /*!
+         * \brief Options for rendering the scene at a lower resolution when the GPU can't keep up
+         */
+        struct DynamicResolutionOptions {
+            /*!
+             * \brief If true, Nova watches how long the GPU takes each frame, and renders screen-relative render targets into a smaller
+             * part of themselves when it's too long. The backbuffer output pass scales the scene back up to fill the window
+             *
+             * The render targets are still allocated at full size, so changing the resolution never allocates anything. Needs GPU
+             * timestamps, so Nova times passes whether or not `gpu_profiling` is enabled
+             */
+            bool enabled = false;
+
+            /*!
+             * \brief How long, in milliseconds, the GPU should take per frame. 16.6 for 60 Hz, 6.9 for 144 Hz
+             */
+            float target_frame_time_ms = 16.6f;
+
+            /*!
+             * \brief The smallest fraction of the full resolution to render at, in each dimension
+             */
+            float min_scale = 0.5f;
+        } dynamic_resolution;
+
+        /*!
+         * \brief Options for renderpacks that use the temporal upscale pass
+         */
+        struct TemporalUpscalingOptions {
+            /*!
+             * \brief The fraction of the full resolution to render the scene at, in each dimension, when dynamic resolution is off.
+             * Between 0.5 and 0.67 is where upscalers still look about as good as full resolution
+             */
+            float render_scale = 0.67f;
+        } temporal_upscaling;
+
+        /*!
+         * \brief Options for renderpasses that shade fewer than one pixel per pixel shader invocation
+         */
+        struct VariableRateShadingOptions {
+            /*!
+             * \brief Whether to use variable rate shading at all. Renderpacks' shading rates are ignored when this is off
+             */
+            bool enabled = true;
+
+            /*!
+             * \brief Tiles whose luminance varies by less than this, as a fraction of their average luminance, shade at 2x2. Tiles with a
+             * quarter of it shade at 4x4
+             */
+            float contrast_threshold = 0.05f;
+
+            /*!
+             * \brief Tiles that moved at least this many pixels since the last frame shade at 2x2, and tiles that moved three times as far
+             * shade at 4x4. Motion blur would smear them anyway
+             */
+            float motion_threshold = 8.0f;
+        } variable_rate_shading;
+
         uint32_t max_in_flight_frames = 3;
 
+        /*!
+         * \brief Values for renderpack shaders' specialization constants, by name. These win over the values in the renderpack's
+         * pipelines
+         *
+         * This is where the host application's quality settings go, like how many shadow samples to take. Changing them only takes
+         * effect when the renderpack is loaded again
+         */
+        std::unordered_map<std::string, double> specialization_constants;
+
+        /*!
+         * \brief The precision tier of renderpack render targets. Like specialization constants, changing this only takes effect when
+         * the renderpack is loaded again
+         */
+        RenderTargetPrecision render_target_precision = RenderTargetPrecision::Full;
+
+        /*!
+         * \brief Which renderpack passes are on, by the name of the option in their `enabledBy`. Options that aren't in here are on
+         *
+         * Unlike specialization constants, these can change while the renderpack is loaded, with `NovaRenderer::set_renderpass_option`.
+         * This is only where they start out
+         */
+        std::unordered_map<std::string, bool> renderpass_options;
+
+        /*!
+         * \brief Size, in bytes, of the host memory that each in-flight frame gets for temporaries that only live until the end of that
+         * frame
+         *
+         * Temporaries that don't fit go to the heap, which is slower but works. Nova warns the first time that happens
+         */
+        uint32_t frame_arena_size = 1024 * 1024;
+
         /*!
          * \brief Settings for how Nova should allocate vertex memory
          */
@@ -210,6 +903,16 @@ namespace nova::renderer {
          * \brief Settings for how Nova should allocate index memory
          */
         BlockAllocatorSettings index_memory_settings;
+
+        /*!
+         * \brief Settings for the memory that sampled textures are allocated from. Render targets get memory of their own
+         */
+        BlockAllocatorSettings texture_memory_settings{1536U * 1024 * 1024, 64 * 1024 * 1024};
+
+        /*!
+         * \brief Settings for the memory that upload buffers are allocated from. Staging buffers get the same amount again
+         */
+        BlockAllocatorSettings upload_memory_settings{256 * 1024 * 1024, 32 * 1024 * 1024};
     };
 
     class NovaSettingsAccessManager { // Classes named Manager are an antipattern so yes
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace nova::renderer {
+    /*!
+     * \brief What the application controls about one of the renderpack's particle emitters
+     *
+     * Everything else about the emitter, like how fast its particles move and how long they live, comes from the renderpack's
+     * `ParticleEmitterCreateInfo`
+     */
+    struct ParticleEmitterState {
+        /*!
+         * \brief Where the emitter is in worldspace. Particles that were already spawned stay where they are when it moves
+         */
+        glm::vec3 position{};
+
+        /*!
+         * \brief How much to scale the renderpack's spawn rate by. Zero stops the emitter, but its particles live out their lives
+         */
+        float spawn_rate_scale = 1.0f;
+
+        /*!
+         * \brief Added to the velocity of new particles, for things like wind
+         */
+        glm::vec3 velocity_offset{};
+    };
+} // namespace nova::renderer
@@ -1,18 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <optional>
 #include <Tracy.hpp>
 #include <vector>
-#include <spdlog/sinks/stdout_color_sinks.h>
 
 
 #include "nova_renderer/constants.hpp"
 #include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/dirty_range_tracker.hpp"
+#include "nova_renderer/util/logging.hpp"
 
 namespace nova::renderer {
-    static auto pfd_logger = spdlog::stdout_color_mt("PerDeviceFrameArray");
+    static auto pfd_logger = make_logger("PerDeviceFrameArray");
 
     /*!
      * \brief Array of data which is unique for each frame of execution
+     *
+     * Getting a mutable reference to an element marks it as changed, and `upload_to_device` only copies the elements that changed since
+     * that frame slot's buffer was last written. Use the const accessors if you only want to read
      */
     template <typename ElementType>
     class PerFrameDeviceArray {
@@ -32,12 +39,26 @@ namespace nova::renderer {
 
         ElementType& operator[](uint32_t idx);
 
+        const ElementType& operator[](uint32_t idx) const;
+
         ElementType& at(uint32_t idx);
 
+        const ElementType& at(uint32_t idx) const;
+
+        /*!
+         * \brief Copies every element that changed since the last upload to this frame slot's buffer
+         */
         void upload_to_device(uint32_t frame_idx);
 
         [[nodiscard]] uint32_t get_next_free_slot();
 
+        /*!
+         * \brief Takes `count` free slots that are right next to each other
+         *
+         * \return The first of the slots, or nothing if there aren't enough free slots in a row
+         */
+        [[nodiscard]] std::optional<uint32_t> get_free_slots(uint32_t count);
+
         void free_slot(uint32_t idx);
 
         [[nodiscard]] size_t size() const;
@@ -50,6 +71,8 @@ namespace nova::renderer {
 
         std::vector<ElementType> data;
 
+        DirtyRangeTracker dirty_elements;
+
         std::vector<uint32_t> free_indices;
     };
 
@@ -58,7 +81,8 @@ namespace nova::renderer {
                                                           const uint32_t num_in_flight_frames,
                                                           rhi::RenderDevice& device)
         : device{device},
-          data{num_elements}{
+          data{num_elements},
+          dirty_elements{num_elements, num_in_flight_frames} {
         rhi::RhiBufferCreateInfo create_info;
         create_info.size = sizeof(ElementType) * data.size();
         create_info.buffer_usage = rhi::BufferUsage::UniformBuffer;
@@ -78,20 +102,35 @@ namespace nova::renderer {
 
     template <typename ElementType>
     ElementType& PerFrameDeviceArray<ElementType>::operator[](const uint32_t idx) {
+        dirty_elements.mark_dirty(idx);
+        return data[idx];
+    }
+
+    template <typename ElementType>
+    const ElementType& PerFrameDeviceArray<ElementType>::operator[](const uint32_t idx) const {
         return data[idx];
     }
 
     template <typename ElementType>
     ElementType& PerFrameDeviceArray<ElementType>::at(uint32_t idx) {
+        dirty_elements.mark_dirty(idx);
+        return data[idx];
+    }
+
+    template <typename ElementType>
+    const ElementType& PerFrameDeviceArray<ElementType>::at(const uint32_t idx) const {
         return data[idx];
     }
 
     template <typename ElementType>
     void PerFrameDeviceArray<ElementType>::upload_to_device(const uint32_t frame_idx) {
         ZoneScoped;
-        const auto num_bytes_to_write = sizeof(ElementType) * data.size();
-
-        device.write_data_to_buffer(data.data(), num_bytes_to_write, per_frame_buffers[frame_idx]);
+        dirty_elements.consume_dirty_ranges(frame_idx, [&](const size_t first_element, const size_t num_elements) {
+            device.write_data_to_buffer(&data[first_element],
+                                        sizeof(ElementType) * num_elements,
+                                        sizeof(ElementType) * first_element,
+                                        per_frame_buffers[frame_idx]);
+        });
     }
 
     template <typename ElementType>
@@ -103,6 +142,31 @@ namespace nova::renderer {
         return val;
     }
 
+    template <typename ElementType>
+    std::optional<uint32_t> PerFrameDeviceArray<ElementType>::get_free_slots(const uint32_t count) {
+        if(count == 0) {
+            return std::nullopt;
+        }
+
+        // Keep the lowest slots at the back, where `get_next_free_slot` takes them from
+        std::sort(free_indices.begin(), free_indices.end(), std::greater<>{});
+
+        uint32_t run_length = 0;
+        for(size_t i = free_indices.size(); i > 0; i--) {
+            const auto is_next_to_previous = run_length > 0 && free_indices[i - 1] == free_indices[i] + 1;
+            run_length = is_next_to_previous ? run_length + 1 : 1;
+
+            if(run_length == count) {
+                const auto first_slot = free_indices[i - 1 + count - 1];
+                free_indices.erase(free_indices.begin() + static_cast<std::ptrdiff_t>(i - 1),
+                                   free_indices.begin() + static_cast<std::ptrdiff_t>(i - 1 + count));
+                return first_slot;
+            }
+        }
+
+        return std::nullopt;
+    }
+
     template <typename ElementType>
     void PerFrameDeviceArray<ElementType>::free_slot(const uint32_t idx) {
         free_indices.emplace_back(idx);
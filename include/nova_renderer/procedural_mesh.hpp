@@ -1,22 +1,35 @@
 #pragma once
 
-#include <array>
-#include <rx/core/concepts/no_copy.h>
-#include <string>
 #include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
 #include "nova_renderer/constants.hpp"
 #include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+#include "nova_renderer/util/dirty_range_tracker.hpp"
 
 namespace nova::renderer {
     /*!
      * \brief ProceduralMesh is a mesh which the user will modify every frame
      *
-     * ProceduralMesh should _not_ be used if you're not going to update the mesh frequently. It stores four copies of the mesh data - once
-     * in host memory, and three times in device memory (one for each in-flight frame)
+     * ProceduralMesh should _not_ be used if you're not going to update the mesh frequently. It keeps a copy of the mesh data in host
+     * memory, and one copy in device memory for each in-flight frame. Each frame's copy only gets the parts of the data that changed since
+     * the last time its frame slot was used
+     *
+     * When the device lets the CPU write to device-local memory, the changes are written straight into each frame's buffers. Otherwise,
+     * every in-flight frame gets its own slice of a staging buffer, so the CPU never writes to staging memory that an earlier frame is
+     * still copying from
      */
-    class ProceduralMesh : rx::concepts::no_copy {
+    class ProceduralMesh {
     public:
+        /*!
+         * \brief Changes are tracked in blocks of this many bytes
+         */
+        static constexpr uint64_t DIRTY_BLOCK_SIZE = 256;
+
         struct Buffers {
             rhi::RhiBuffer* vertex_buffer;
             rhi::RhiBuffer* index_buffer;
@@ -42,10 +55,13 @@ namespace nova::renderer {
         ProceduralMesh(ProceduralMesh&& old) noexcept;
         ProceduralMesh& operator=(ProceduralMesh&& old) noexcept;
 
+        ProceduralMesh(const ProceduralMesh& other) = delete;
+        ProceduralMesh& operator=(const ProceduralMesh& other) = delete;
+
         ~ProceduralMesh() = default;
 
         /*!
-         * \brief Sets the data to upload to the vertex buffer
+         * \brief Replaces the start of the vertex data
          *
          * \param data A pointer to the start of the data
          * \param size The number of bytes to upload
@@ -53,7 +69,17 @@ namespace nova::renderer {
         void set_vertex_data(const void* data, uint64_t size);
 
         /*!
-         * \brief Sets the data to upload to the index buffer
+         * \brief Changes some of the vertex data, leaving the rest as it was
+         *
+         * \param offset Where in the vertex buffer the new data goes, in bytes
+         * \param data The new data
+         */
+        void set_vertex_data(uint64_t offset, std::span<const uint8_t> data);
+
+        /*!
+         * \brief Replaces the index data
+         *
+         * Indices are always 32-bit. The mesh has as many indices as fit in `size`
          *
          * \param data A pointer to the start of the data
          * \param size The number of bytes to upload
@@ -61,21 +87,41 @@ namespace nova::renderer {
         void set_index_data(const void* data, uint64_t size);
 
         /*!
-         * \brief Records commands to copy the staging buffers to the device buffers for the specified frame
+         * \brief Changes some of the index data, leaving the rest as it was
          *
-         * Intent is that you call this method at the beginning or the frame that will use the buffers you're uploading to. It's a method on
-         * this class mostly because writing accessors is hard
+         * The mesh only gains indices if the new data goes past the last index it already had
+         *
+         * \param offset Where in the index buffer the new data goes, in bytes
+         * \param data The new data
+         */
+        void set_index_data(uint64_t offset, std::span<const uint8_t> data);
+
+        /*!
+         * \brief Sends the data that changed since the provided frame slot was last uploaded to that slot's buffers
+         *
+         * Call this at the beginning of the frame that will use the buffers you're uploading to, after its fence has signaled. When the
+         * mesh writes to its device buffers directly, nothing gets recorded into the command list
          *
          * \param cmds The command list to record commands into
          * \param frame_idx The index of the frame to write the data to
          */
-        void record_commands_to_upload_data(rhi::RhiRenderCommandList* cmds, uint8_t frame_idx) const;
+        void record_commands_to_upload_data(rhi::RhiRenderCommandList* cmds, uint8_t frame_idx);
 
         /*!
          * \brief Returns the vertex and index buffer for the provided frame
          */
         [[nodiscard]] Buffers get_buffers_for_frame(uint8_t frame_idx) const;
 
+        /*!
+         * \brief Returns the number of indices in the most recent index data
+         */
+        [[nodiscard]] uint32_t get_num_indices() const;
+
+        /*!
+         * \brief Returns how many times the mesh's data was set. It goes up every time `set_vertex_data` or `set_index_data` is called
+         */
+        [[nodiscard]] uint64_t get_data_version() const;
+
     private:
         rhi::RenderDevice* device = nullptr;
 
@@ -84,17 +130,50 @@ namespace nova::renderer {
         std::vector<rhi::RhiBuffer*> vertex_buffers;
         std::vector<rhi::RhiBuffer*> index_buffers;
 
-        rhi::RhiBuffer* cached_vertex_buffer;
-        rhi::RhiBuffer* cached_index_buffer;
+        /*!
+         * \brief Whether the CPU writes to `vertex_buffers` and `index_buffers` itself, instead of going through `staging_buffer`
+         */
+        bool writes_directly = false;
+
+        /*!
+         * \brief One slice for each in-flight frame, with the vertex data followed by the index data. Nullptr if the mesh writes directly
+         */
+        rhi::RhiBuffer* staging_buffer = nullptr;
+
+        uint64_t staging_slice_size = 0;
 
-        uint64_t num_vertex_bytes_to_upload = 0;
-        uint64_t num_index_bytes_to_upload = 0;
+        std::vector<uint8_t> vertex_data;
+        std::vector<uint8_t> index_data;
 
-        rx::memory::allocator* allocator;
+        DirtyRangeTracker dirty_vertex_blocks{0, 0};
+        DirtyRangeTracker dirty_index_blocks{0, 0};
 
-#ifdef NOVA_DEBUG
-        uint64_t vertex_buffer_size;
-        uint64_t index_buffer_size;
-#endif
+        uint32_t num_indices = 0;
+
+        uint64_t data_version = 0;
+
+        /*!
+         * \brief Copies new data into one of the host copies, and marks the blocks it touched as dirty
+         *
+         * \return The number of bytes that fit
+         */
+        uint64_t write_data(std::vector<uint8_t>& host_data,
+                            DirtyRangeTracker& dirty_blocks,
+                            uint64_t offset,
+                            std::span<const uint8_t> data,
+                            const char* data_kind) const;
+
+        /*!
+         * \brief Sends the dirty blocks of one of the host copies to a frame slot's buffer
+         *
+         * \return A barrier that makes the copied range visible to the vertex input stage, or nullopt if nothing was copied
+         */
+        std::optional<rhi::RhiResourceBarrier> upload_dirty_blocks(rhi::RhiRenderCommandList& cmds,
+                                                                   uint8_t frame_idx,
+                                                                   const std::vector<uint8_t>& host_data,
+                                                                   DirtyRangeTracker& dirty_blocks,
+                                                                   rhi::RhiBuffer* destination,
+                                                                   uint64_t staging_offset,
+                                                                   bool is_index_data);
     };
 } // namespace nova::renderer
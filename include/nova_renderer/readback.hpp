@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "nova_renderer/rhi/rhi_enums.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief A rectangle of one mip of an image to read back
+     */
+    struct ImageReadbackRegion {
+        uint32_t x = 0;
+
+        uint32_t y = 0;
+
+        /*!
+         * \brief How many pixels wide the rectangle is. Zero means everything right of `x`
+         */
+        uint32_t width = 0;
+
+        /*!
+         * \brief How many pixels tall the rectangle is. Zero means everything below `y`
+         */
+        uint32_t height = 0;
+
+        uint32_t mip = 0;
+    };
+
+    /*!
+     * \brief What a readback read from the GPU
+     */
+    struct ReadbackData {
+        /*!
+         * \brief The bytes that were read. Images come back as tightly packed rows of pixels, top row first
+         */
+        std::vector<uint8_t> bytes;
+
+        /*!
+         * \brief The size of the rectangle that was read, in pixels. Zero for buffers
+         */
+        uint32_t width = 0;
+
+        uint32_t height = 0;
+
+        /*!
+         * \brief The format of the image that was read. Depth images come back as four bytes per pixel, whatever their format
+         */
+        rhi::PixelFormat format = rhi::PixelFormat::Rgba8;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/constants.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Identifies one of the outputs from `NovaRenderer::add_render_output`
+     */
+    using RenderOutputId = uint32_t;
+
+    /*!
+     * \brief Somewhere else to show every frame, besides Nova's own window, such as an editor viewport or a spectator window
+     *
+     * Every output shows a render target from the same frame, so the renderpack's passes, their pipelines, and the culling are recorded
+     * once no matter how many outputs there are. To show the scene from another camera, give a renderpack pass a view for that camera,
+     * and show the layer that the view renders to
+     */
+    struct RenderOutputCreateInfo {
+        /*!
+         * \brief The output's name. An output without a window renders to a render target with this name
+         */
+        std::string name;
+
+        /*!
+         * \brief The render target to show. The UI isn't drawn on the scene output, so outputs that show it don't have any UI
+         */
+        std::string source = SCENE_OUTPUT_RT_NAME;
+
+        /*!
+         * \brief Which layer of `source` to show. Passes with views render view N to layer N
+         */
+        uint32_t source_layer = 0;
+
+        /*!
+         * \brief Whether the output opens a window of its own. Outputs without a window render to a render target, which
+         * `NovaRenderer::request_readback` can read every frame, such as to capture video
+         */
+        bool has_window = true;
+
+        /*!
+         * \brief The title of the output's window
+         */
+        std::string title = "Nova Renderer";
+
+        /*!
+         * \brief The size of the output's window or render target, in pixels. The source is scaled to fill all of it
+         */
+        glm::uvec2 size{};
+    };
+} // namespace nova::renderer
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <atomic>
+#include <optional>
+#include <span>
 
 #include <glm/glm.hpp>
 #include <string>
@@ -11,14 +13,32 @@ namespace nova::renderer {
         glm::vec3 position;          // 12 bytes
         glm::vec3 normal;            // 12 bytes
         glm::vec3 tangent;           // 12 bytes
-        uint32_t main_uv;            // 4 bytes
-        uint32_t secondary_uv;       // 4 bytes
+        uint32_t main_uv;            // 4 bytes, two unorm16s
+        uint32_t secondary_uv;       // 4 bytes, two unorm16s
         uint32_t virtual_texture_id; // 4 bytes
         glm::vec4 additional_stuff;  // 12 bytes
     };
 
     static_assert(sizeof(FullVertex) % 16 == 0, "full_vertex struct is not aligned to 16 bytes!");
 
+    /*!
+     * \brief A coarser version of a mesh that the application made itself
+     */
+    struct MeshLodData {
+        /*!
+         * \brief 32-bit indices into the mesh's vertices
+         */
+        const uint32_t* index_data_ptr{};
+
+        uint32_t num_indices{};
+
+        /*!
+         * \brief Renderables of the mesh switch to this LOD when their bounding sphere covers less than this fraction of the screen's
+         * height
+         */
+        float screen_size{};
+    };
+
     /*!
      * \brief All the data needed to make a single mesh
      *
@@ -40,6 +60,14 @@ namespace nova::renderer {
          */
         size_t vertex_data_size{};
 
+        /*!
+         * \brief Number of bytes in one vertex
+         *
+         * Meshes share vertex buffers, so Nova needs this to express where the mesh's vertices start as a number of vertices. Set it
+         * to `sizeof(CompactVertex)` for meshes drawn by compact pipelines
+         */
+        uint32_t vertex_size = sizeof(FullVertex);
+
         /*!
          * \brief Pointer to the index data of this mesh
          */
@@ -49,6 +77,94 @@ namespace nova::renderer {
          * \brief Number of bytes of index data
          */
         size_t index_data_size{};
+
+        /*!
+         * \brief Model-space bounding sphere of the mesh, with the center in xyz and the radius in w
+         *
+         * Nova doesn't know the layout of your vertex data, so it can't calculate this itself. Meshes with a negative radius are never
+         * culled
+         */
+        glm::vec4 bounding_sphere{0, 0, 0, -1};
+
+        /*!
+         * \brief If true, Nova splits this mesh into meshlets when it's created, and culls each meshlet on its own
+         *
+         * This makes creating the mesh slower, and adds a draw per meshlet, so it's only worth it for large meshes that are often
+         * partly off screen or facing away from the camera. See `build_meshlets` for what the vertex data has to look like
+         */
+        bool build_meshlets = false;
+
+        /*!
+         * \brief If true, Nova reorders this mesh's triangles and vertices to be faster to draw when it's created, and gives it 16-bit
+         * indices if it has few enough vertices
+         *
+         * Needs a triangle list with 32-bit indices, and vertices that start with their position as three floats. Vertices that no
+         * triangle uses are dropped. Meshes with their own `lods` keep their vertex order, since the LODs index into it
+         */
+        bool optimize = false;
+
+        /*!
+         * \brief Coarser versions of this mesh, from finest to coarsest. Each one's screen size must be smaller than the one before it,
+         * and there can be at most 255 of them
+         *
+         * Nova needs the mesh's bounding sphere to pick LODs, so meshes without bounds always draw their full detail. Meshlets are only
+         * built for the full-detail mesh
+         */
+        std::vector<MeshLodData> lods;
+
+        /*!
+         * \brief If `lods` is empty, Nova simplifies the mesh into this many LODs itself. See `NovaSettings::LodOptions`
+         */
+        uint32_t num_generated_lods = 0;
+    };
+
+    /*!
+     * \brief Which bones move a vertex of a skinned mesh, and how much
+     */
+    struct VertexSkinWeights {
+        /*!
+         * \brief Indices into the mesh's bones
+         */
+        uint8_t bones[4]{};
+
+        /*!
+         * \brief How much each bone moves the vertex, where 255 is all the way. They should add up to 255
+         */
+        uint8_t weights[4]{};
+    };
+
+    static_assert(sizeof(VertexSkinWeights) == 8, "VertexSkinWeights must match the skinning shader");
+
+    /*!
+     * \brief All the data needed to make a skinned mesh: its vertices in their bind pose, and which bones each vertex follows
+     *
+     * Skinned meshes are always triangle lists made of `FullVertex`es with 32-bit indices. Their renderables are skinned on the GPU
+     * every frame, see `NovaRenderer::set_skinned_renderable_pose`
+     */
+    struct SkinnedMeshData {
+        const FullVertex* vertices{};
+
+        /*!
+         * \brief One for each vertex
+         */
+        const VertexSkinWeights* skin_weights{};
+
+        uint32_t num_vertices{};
+
+        const uint32_t* indices{};
+
+        uint32_t num_indices{};
+
+        /*!
+         * \brief How many bones the mesh's poses have. No more than 256
+         */
+        uint32_t num_bones{};
+
+        /*!
+         * \brief Model-space bounding sphere of every pose the mesh can be in, with the center in xyz and the radius in w. Meshes with
+         * a negative radius are never culled
+         */
+        glm::vec4 bounding_sphere{0, 0, 0, -1};
     };
 
     using MeshId = uint64_t;
@@ -69,9 +185,19 @@ namespace nova::renderer {
 
     using RenderableId = uint64_t;
 
+    /*!
+     * \brief New data for one renderable, for updating lots of renderables at once
+     */
+    struct StaticMeshRenderableUpdate {
+        RenderableId renderable{};
+
+        StaticMeshRenderableUpdateData data{};
+    };
+
     enum class RenderableType {
         StaticMesh,
         ProceduralMesh,
+        SkinnedMesh,
     };
 
     static std::atomic<RenderableId> next_renderable_id;
@@ -82,15 +208,96 @@ namespace nova::renderer {
         std::vector<std::string> passes{};
     };
 
-    struct RenderCommand {
-        RenderableId id{};
+    /*!
+     * \brief The renderables of one mesh batch, with one packed array per field
+     *
+     * GPU culling reads the model matrix and visibility of every renderable every frame, so those live in their own arrays without
+     * anything culling doesn't need in between. The mesh, its bounds, and the material are the same for the whole batch, so the batch
+     * stores them once. Removing a renderable moves the last renderable into its place, so the arrays never have holes
+     */
+    struct RenderableColumns {
+        std::vector<RenderableId> ids;
+
+        std::vector<glm::mat4> model_matrices;
+
+        /*!
+         * \brief Non-zero for visible renderables. Not a `std::vector<bool>`, so visibility can be read without unpacking bits
+         */
+        std::vector<uint8_t> visibilities;
+
+        /*!
+         * \brief Which of the mesh's LODs each renderable used last frame. Zero for meshes without LODs
+         */
+        std::vector<uint8_t> lods;
+
+        [[nodiscard]] uint32_t size() const;
 
-        bool is_visible = true;
+        /*!
+         * \return The index of the new renderable
+         */
+        uint32_t add(RenderableId id, const glm::mat4& model_matrix, bool is_visible);
 
-        glm::mat4 model_matrix{1};
+        /*!
+         * \brief Removes the renderable at `idx` by moving the last renderable into its place
+         *
+         * \return The ID of the renderable that now lives at `idx`, or nullopt if `idx` was the last renderable
+         */
+        std::optional<RenderableId> swap_remove(uint32_t idx);
     };
 
-    struct StaticMeshRenderCommand : RenderCommand {};
+    /*!
+     * \brief Builds the model matrix for a renderable: translation, then rotation around X, Y, and Z, then scale
+     *
+     * The matrix is written out directly instead of being multiplied together one transform at a time, since streaming in a chunk
+     * updates thousands of renderables
+     */
+    [[nodiscard]] glm::mat4 make_model_matrix(const StaticMeshRenderableUpdateData& data);
+
+    /*!
+     * \brief Builds the model matrices of lots of renderables at once, the same way `make_model_matrix` does
+     *
+     * Renderables are done four at a time with SSE2 or NEON, whichever the CPU has. The inputs are one array per transform component,
+     * and they all need as many elements as `model_matrices`
+     *
+     * \param normal_matrices Where to write the inverse transpose of each model matrix, for transforming normals. Leave it empty to skip
+     * them
+     */
+    void make_model_matrices(std::span<const glm::vec3> positions,
+                             std::span<const glm::vec3> rotations,
+                             std::span<const glm::vec3> scales,
+                             std::span<glm::mat4> model_matrices,
+                             std::span<glm::mat4> normal_matrices = {});
+
+    inline uint32_t RenderableColumns::size() const { return static_cast<uint32_t>(ids.size()); }
+
+    inline uint32_t RenderableColumns::add(const RenderableId id, const glm::mat4& model_matrix, const bool is_visible) {
+        const auto idx = size();
+
+        ids.push_back(id);
+        model_matrices.push_back(model_matrix);
+        visibilities.push_back(is_visible ? 1 : 0);
+        lods.push_back(0);
+
+        return idx;
+    }
+
+    inline std::optional<RenderableId> RenderableColumns::swap_remove(const uint32_t idx) {
+        const auto last_idx = size() - 1;
+        std::optional<RenderableId> moved_id;
+        if(idx != last_idx) {
+            ids[idx] = ids[last_idx];
+            model_matrices[idx] = model_matrices[last_idx];
+            visibilities[idx] = visibilities[last_idx];
+            lods[idx] = lods[last_idx];
+
+            moved_id = ids[idx];
+        }
+
+        ids.pop_back();
+        model_matrices.pop_back();
+        visibilities.pop_back();
+        lods.pop_back();
 
-    StaticMeshRenderCommand make_render_command(const StaticMeshRenderableCreateInfo& data, RenderableId id);
+        return moved_id;
+    }
 } // namespace nova::renderer
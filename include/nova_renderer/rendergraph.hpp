@@ -1,10 +1,16 @@
 #pragma once
 
 #include <rx/core/log.h>
+#include <algorithm>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include  <optional>
 
+#include "nova_renderer/constants.hpp"
 #include "nova_renderer/frame_context.hpp"
+#include "nova_renderer/mesh_lods.hpp"
+#include "nova_renderer/meshlets.hpp"
 #include "nova_renderer/procedural_mesh.hpp"
 #include "nova_renderer/renderables.hpp"
 #include "nova_renderer/renderpack_data.hpp"
@@ -21,6 +27,10 @@ namespace nova::renderer {
 
     class DeviceResources;
 
+    namespace rhi {
+        class CommandStream;
+    }
+
     namespace renderpack {
         struct RenderPassCreateInfo;
     }
@@ -35,8 +45,17 @@ namespace nova::renderer {
         size_t hash() const;
     };
 
+    /*!
+     * \brief Index of a pipeline in Nova's pipeline arrays. Nova hands one out the first time it sees a pipeline name, and that name keeps
+     * its handle even when the pipeline is recompiled or its renderpack is replaced
+     */
+    using PipelineHandle = uint32_t;
+
+    /*!
+     * \brief Where a material pass lives: the pipeline that draws it, and its index in that pipeline's list of material passes
+     */
     struct MaterialPassKey {
-        std::string pipeline_name;
+        PipelineHandle pipeline;
         uint32_t material_pass_index;
     };
 
@@ -56,70 +75,336 @@ namespace nova::renderer {
 #pragma endregion
 
 #pragma region Structs for rendering
-    template <typename RenderCommandType>
+    class Renderpass;
+
+    /*!
+     * \brief Index of a renderpass in the rendergraph. Handles of removed renderpasses get reused by the next ones to be added
+     */
+    using RenderpassHandle = uint32_t;
+
+    /*!
+     * \brief A run of renderpasses that are recorded into one command list and submitted to one queue
+     */
+    struct RendergraphSubmission {
+        rhi::QueueType queue = rhi::QueueType::Graphics;
+
+        /*!
+         * \brief The renderpasses in this submission, in execution order
+         */
+        std::vector<Renderpass*> passes;
+
+        /*!
+         * \brief Indices of the earlier submissions, on the other queue, that this submission has to wait for
+         *
+         * Each index needs its own semaphore, signaled by that submission and waited on by this one
+         */
+        std::vector<uint32_t> submissions_to_wait_for;
+    };
+
+    /*!
+     * \brief Resource barriers that are recorded together, with a single pipeline barrier command
+     */
+    struct BarrierBatch {
+        /*!
+         * \brief Every pipeline stage that accesses the resources before the barriers
+         */
+        rhi::PipelineStage stages_before_barrier{};
+
+        /*!
+         * \brief Every pipeline stage that accesses the resources after the barriers
+         */
+        rhi::PipelineStage stages_after_barrier{};
+
+        std::vector<rhi::RhiResourceBarrier> barriers;
+    };
+
+    /*!
+     * \brief Where a renderpass lives in a renderpass that `Rendergraph::compile` merged it into
+     */
+    struct MergedSubpass {
+        rhi::RhiRenderpass* renderpass = nullptr;
+        rhi::RhiFramebuffer* framebuffer = nullptr;
+
+        /*!
+         * \brief Index of this renderpass's subpass. The first subpass begins the merged renderpass
+         */
+        uint32_t index = 0;
+
+        /*!
+         * \brief Whether this is the last subpass, which ends the merged renderpass
+         */
+        bool is_last = false;
+    };
+
+    /*!
+     * \brief All the renderables that use the same mesh in a material pass
+     *
+     * A batch is drawn with a single instanced draw. The model matrices of its visible renderables live in the frame's model matrix
+     * buffer, which GPU culling fills in, and shaders find their model matrix with the instance ID
+     */
     struct MeshBatch {
+        MeshId mesh{};
+
         size_t num_vertex_attributes{};
         uint32_t num_indices{};
 
+        /*!
+         * \brief The mesh arena buffers that this batch's mesh lives in. Many batches share the same buffers
+         */
         rhi::RhiBuffer* vertex_buffer = nullptr;
         rhi::RhiBuffer* index_buffer = nullptr;
 
         /*!
-         * \brief A buffer to hold all the per-draw data
-         *
-         * For example, a non-animated mesh just needs a mat4 for its model matrix
+         * \brief Size of the batch's indices. Batches with different index types can't share a multi-draw, even in the same buffer
+         */
+        rhi::IndexType index_type = rhi::IndexType::Uint32;
+
+        uint32_t first_index = 0;
+        int32_t vertex_offset = 0;
+
+        /*!
+         * \brief The `Mesh::pulled_vertex_layout` of this batch's mesh
+         */
+        uint32_t pulled_vertex_layout = NO_PULLED_VERTICES;
+
+        RenderableColumns renderables;
+
+        /*!
+         * \brief Model-space bounding sphere of this batch's mesh. See `MeshData::bounding_sphere`
+         */
+        glm::vec4 bounding_sphere{0, 0, 0, -1};
+
+        /*!
+         * \brief The meshlets of this batch's mesh, or nullptr if the mesh is culled as a whole
+         */
+        std::shared_ptr<const std::vector<Meshlet>> meshlets;
+
+        /*!
+         * \brief The LODs of this batch's mesh, or nullptr if it only has the full mesh
+         */
+        std::shared_ptr<const std::vector<MeshLod>> lods;
+
+        /*!
+         * \brief Index of this batch's first indirect draw in the current frame's draw command buffer
          *
-         * This buffer gets re-written to every frame, since the number of renderables in this mesh batch might have changed. If there's
-         * more renderables than the buffer can hold, it gets reallocated from the RHI
+         * GPU culling assigns this every frame, before the rendergraph is recorded. It's empty when none of the batch's renderables are
+         * visible
          */
-        rhi::RhiBuffer* per_renderable_data = nullptr;
+        std::optional<uint32_t> draw_command_idx;
 
-        std::vector<RenderCommandType> commands;
+        /*!
+         * \brief How many indirect draws this batch has, starting at `draw_command_idx`. Meshlet batches have one draw per meshlet, and
+         * batches with LODs have one draw for each LOD their renderables use
+         */
+        uint32_t num_draw_commands = 0;
     };
 
-    template <typename RenderCommandType>
+    /*!
+     * \brief Like MeshBatch, but for a procedural mesh. Procedural meshes have no bounds, so their renderables are never frustum culled
+     */
     struct ProceduralMeshBatch {
         MapAccessor<MeshId, ProceduralMesh> mesh;
 
+        RenderableColumns renderables;
+
         /*!
-         * \brief A buffer to hold all the per-draw data
-         *
-         * For example, a non-animated mesh just needs a mat4 for its model matrix
-         *
-         * This buffer gets re-written to every frame, since the number of renderables in this mesh batch might have changed. If there's
-         * more renderables than the buffer can hold, it gets reallocated from the RHI
+         * \brief Index of this batch's indirect draw in the current frame's draw command buffer. See `MeshBatch::draw_command_idx`
          */
-        rhi::RhiBuffer* per_renderable_data = nullptr;
-
-        std::vector<RenderCommandType> commands;
+        std::optional<uint32_t> draw_command_idx;
 
         ProceduralMeshBatch(std::unordered_map<MeshId, ProceduralMesh>* meshes, const MeshId key) : mesh(meshes, key) {}
     };
 
+    /*!
+     * \brief Like MeshBatch, but for a skinned mesh. Every renderable has vertices of its own, so each visible renderable gets its own
+     * draw
+     */
+    struct SkinnedMeshBatch {
+        MeshId mesh = 0;
+
+        uint32_t first_index = 0;
+
+        uint32_t num_indices = 0;
+
+        glm::vec4 bounding_sphere{0, 0, 0, -1};
+
+        RenderableColumns renderables;
+
+        /*!
+         * \brief Where each renderable's vertices start in the skinned vertex buffers, in the same order as `renderables`
+         */
+        std::vector<uint32_t> first_vertices;
+
+        /*!
+         * \brief Index of this batch's first indirect draw in the current frame's draw command buffer. See `MeshBatch::draw_command_idx`
+         */
+        std::optional<uint32_t> draw_command_idx;
+
+        uint32_t num_draw_commands = 0;
+    };
+
+    /*!
+     * \brief Consecutive draw commands of a material pass that share mesh buffers, and so can be drawn with a single multi-draw
+     *
+     * Ranges of passes that pull their own vertices have no vertex buffer, since they don't bind one
+     */
+    struct MeshDrawRange {
+        rhi::RhiBuffer* vertex_buffer = nullptr;
+        rhi::RhiBuffer* index_buffer = nullptr;
+        rhi::IndexType index_type = rhi::IndexType::Uint32;
+        size_t num_vertex_attributes{};
+
+        uint32_t first_draw_command_idx = 0;
+        uint32_t num_draw_commands = 0;
+
+        /*!
+         * \brief Index of this range's draw count in the frame's draw count buffer
+         */
+        uint32_t draw_count_idx = 0;
+    };
+
     struct MaterialPass {
         FullMaterialPassName name;
 
-        std::vector<MeshBatch<StaticMeshRenderCommand>> static_mesh_draws;
-        std::vector<ProceduralMeshBatch<StaticMeshRenderCommand>> static_procedural_mesh_draws;
+        std::vector<MeshBatch> static_mesh_draws;
+        std::vector<ProceduralMeshBatch> static_procedural_mesh_draws;
+        std::vector<SkinnedMeshBatch> skinned_mesh_draws;
+
+        /*!
+         * \brief Index of the batch for each mesh in `static_mesh_draws`, `static_procedural_mesh_draws`, or `skinned_mesh_draws`.
+         * Batches stay where they are when their last renderable is removed, so these never change
+         */
+        std::unordered_map<MeshId, uint32_t> static_mesh_batch_indices;
+        std::unordered_map<MeshId, uint32_t> procedural_mesh_batch_indices;
+        std::unordered_map<MeshId, uint32_t> skinned_mesh_batch_indices;
+
+        /*!
+         * \brief Indices into `static_mesh_draws`, in the order they're drawn this frame. GPU culling sorts them every frame
+         */
+        std::vector<uint32_t> static_mesh_draw_order;
+
+        /*!
+         * \brief This pass's static mesh draws, grouped by the buffers they use. GPU culling fills these in every frame
+         */
+        std::vector<MeshDrawRange> static_mesh_draw_ranges;
+
+        /*!
+         * \brief Whether this pass's pipeline blends with what's already in its render targets, so its batches are drawn back-to-front
+         */
+        bool is_transparent = false;
+
+        /*!
+         * \brief Whether this pass's pipeline has a depth prepass. The main pipeline only shades the nearest surface anyway, so its batches
+         * are sorted front-to-back first and by buffer second, which is what the prepass wants
+         */
+        bool has_depth_prepass = false;
+
+        /*!
+         * \brief Whether this pass's pipeline pulls its own vertices. Its batches don't bind vertex buffers, so batches from different
+         * vertex buffers, with different vertex layouts, can share a multi-draw as long as they share an index buffer
+         */
+        bool pulls_vertices = false;
+
+        /*!
+         * \brief Index of the variant this pass wants in its pipeline's `variants`, or nothing for the pipeline's default variant
+         */
+        std::optional<uint32_t> pipeline_variant_idx;
 
         std::vector<rhi::RhiDescriptorSet*> descriptor_sets;
         const rhi::RhiPipelineInterface* pipeline_interface = nullptr;
 
         void record(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const;
 
-        static void record_rendering_static_mesh_batch(const MeshBatch<StaticMeshRenderCommand>& batch,
-                                                       rhi::RhiRenderCommandList& cmds,
-                                                       FrameContext& ctx);
-        static void record_rendering_static_mesh_batch(const ProceduralMeshBatch<StaticMeshRenderCommand>& batch,
+        /*!
+         * \brief Draws everything in this pass again, with whichever pipeline is bound. The depth prepass uses this. Particles are left
+         * out, since they're almost always blended
+         */
+        void record_depth_prepass(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const;
+
+        /*!
+         * \brief Draws all the static mesh batches
+         *
+         * Every `MeshDrawRange` is one multi-draw, which only draws the range's visible draws when there's a draw count buffer. The CPU
+         * never looks at the batches themselves here
+         */
+        void record_static_mesh_draws(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const;
+
+        static void record_rendering_static_mesh_batch(const ProceduralMeshBatch& batch,
                                                        rhi::RhiRenderCommandList& cmds,
                                                        FrameContext& ctx);
+
+        /*!
+         * \brief Draws all the skinned mesh batches, from the vertices that this frame skinned
+         */
+        void record_skinned_mesh_draws(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const;
+    };
+
+    /*!
+     * \brief One variant of a pipeline's shader permutations, other than its default variant
+     */
+    struct PipelineVariant {
+        /*!
+         * \brief One keyword from each of the pipeline's keyword axes
+         */
+        std::vector<std::string> keywords;
+
+        /*!
+         * \brief The variant's versions of `Pipeline::pipeline` and `Pipeline::depth_prepass_pipeline`. These are null until the variant is
+         * done compiling, or forever if it didn't compile. Material passes draw with the default variant until then
+         */
+        std::unique_ptr<rhi::RhiPipeline> pipeline{};
+        std::unique_ptr<rhi::RhiPipeline> depth_prepass_pipeline{};
     };
 
     struct Pipeline {
+        /*!
+         * \brief The pipeline's default variant, with the first keyword of each of its keyword axes
+         */
         std::unique_ptr<rhi::RhiPipeline> pipeline{};
         rhi::RhiPipelineInterface* pipeline_interface = nullptr;
 
+        PipelineHandle handle = 0;
+
+        /*!
+         * \brief Whether any of this pipeline's render targets have blending enabled. Pipelines in passes with order-independent
+         * transparency blend too, but they can be drawn in any order, so they aren't counted
+         */
+        bool is_transparent = false;
+
+        /*!
+         * \brief Whether this pipeline's vertex shader pulls its own vertices, instead of having them fed to it from vertex buffers
+         */
+        bool pulls_vertices = false;
+
+        /*!
+         * \brief Depth-only copy of this pipeline, if its renderpass has a depth prepass and this pipeline is opaque and writes depth
+         *
+         * When this is set, `pipeline` tests for equal depth and doesn't write depth
+         */
+        std::unique_ptr<rhi::RhiPipeline> depth_prepass_pipeline{};
+
+        /*!
+         * \brief Every variant that a material pass asked for. Variants are only ever added, so material passes can refer to them by index
+         */
+        std::vector<PipelineVariant> variants;
+
+        /*!
+         * \brief Gets the pipeline to draw a material pass with: its variant if that's compiled, or the default variant if it isn't
+         */
+        [[nodiscard]] rhi::RhiPipeline& get_pipeline_for_pass(const MaterialPass& pass) const;
+
+        /*!
+         * \brief Gets the depth prepass pipeline to draw a material pass with. This always matches `get_pipeline_for_pass`, so the depth
+         * prepass and the shading pass run the same vertex shader
+         */
+        [[nodiscard]] rhi::RhiPipeline& get_depth_prepass_pipeline_for_pass(const MaterialPass& pass) const;
+
         void record(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const;
+
+        /*!
+         * \brief Draws all of this pipeline's material passes with `depth_prepass_pipeline`
+         */
+        void record_depth_prepass(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const;
     };
 #pragma endregion
 
@@ -142,7 +427,10 @@ namespace nova::renderer {
 
         virtual ~Renderpass() = default;
 
-        uint32_t id = 0;
+        /*!
+         * \brief This renderpass's handle in the rendergraph
+         */
+        RenderpassHandle id = 0;
         std::string name;
 
         bool is_builtin = false;
@@ -155,10 +443,138 @@ namespace nova::renderer {
          */
         std::vector<std::string> pipeline_names;
 
+        /*!
+         * \brief Handles of the pipelines that this renderpass records, resolved when the renderpass is created so recording doesn't
+         * have to look anything up by name
+         */
+        std::vector<PipelineHandle> pipelines;
+
         bool writes_to_backbuffer = false;
 
-        std::vector<rhi::RhiResourceBarrier> read_texture_barriers;
-        std::vector<rhi::RhiResourceBarrier> write_texture_barriers;
+        /*!
+         * \brief Whether this renderpass only renders to the top-left `FrameContext::resolution_scale` of its framebuffer
+         *
+         * Nova turns this on for renderpack passes whose outputs are all screen-relative, except for the ones that write the UI
+         */
+        bool uses_dynamic_resolution = false;
+
+        /*!
+         * \brief The camera slot of this renderpass's first view, if the renderpack gave it any views
+         *
+         * The other views' cameras are in the slots right after it. Nova copies the views' cameras into those slots every frame. See
+         * `RenderPassCreateInfo::views`
+         */
+        std::optional<uint32_t> first_view_camera;
+
+        /*!
+         * \brief The queue that this renderpass is recorded for
+         *
+         * Renderpasses on the async compute queue have no raster renderpass or framebuffer, so `execute` only records their barriers and
+         * contents
+         */
+        rhi::QueueType queue = rhi::QueueType::Graphics;
+
+        /*!
+         * \brief Barriers to record before this renderpass begins
+         *
+         * The rendergraph generates these from how every pass in the execution order uses its resources, including the ownership
+         * transfers of resources that another queue used last. See `Rendergraph::compile`
+         */
+        BarrierBatch pre_pass_barriers;
+
+        /*!
+         * \brief Barriers to record after this renderpass ends
+         *
+         * These release resources that a pass on another queue uses next. The last renderpass of the frame also puts render targets back
+         * in the layout they were created in
+         */
+        BarrierBatch post_pass_barriers;
+
+        /*!
+         * \brief The pipeline stages that read this renderpass's texture inputs
+         *
+         * Nova fills this in from the reflection data of the renderpass's pipelines
+         */
+        rhi::PipelineStage texture_read_stages = rhi::PipelineStage::FragmentShader;
+
+        /*!
+         * \brief Whether Nova may record this renderpass's contents on a worker thread
+         *
+         * Set this to false if `record_renderpass_contents` touches anything that isn't safe to use off of the main thread
+         */
+        bool supports_parallel_recording = true;
+
+        /*!
+         * \brief Whether the rendergraph may merge this renderpass into the same renderpass as the passes before and after it
+         *
+         * Merged renderpasses call `setup_renderpass` inside of the merged renderpass, so set this to false if `setup_renderpass` records
+         * anything that's not allowed in a renderpass, like copies
+         */
+        bool can_merge_into_subpass = true;
+
+        /*!
+         * \brief The subpass that this renderpass executes in, if `Rendergraph::compile` merged it with other renderpasses
+         */
+        std::optional<MergedSubpass> merged_subpass;
+
+        /*!
+         * \brief Whether this renderpass keeps what it rendered, and only renders again when `cache_key` changes
+         *
+         * Cached renderpasses still record their barriers every frame. See `RenderPassCreateInfo::is_cached`
+         */
+        bool is_cached = false;
+
+        /*!
+         * \brief Whether this renderpass's opaque pipelines get depth-only copies, which draw before any pipeline shades. See
+         * `RenderPassCreateInfo::has_depth_prepass`
+         */
+        bool has_depth_prepass = false;
+
+        /*!
+         * \brief Whether Nova may execute this renderpass's contents from an earlier frame, instead of recording them again. See
+         * `RenderPassCreateInfo::reuses_commands`
+         */
+        bool reuses_recorded_commands = false;
+
+        /*!
+         * \brief Whether this renderpass draws anything. Use `Rendergraph::set_renderpass_enabled` to change it
+         */
+        bool is_enabled = true;
+
+        /*!
+         * \brief How many frames go by between each time this renderpass renders. See `RenderPassCreateInfo::update_interval`
+         */
+        uint32_t update_interval = 1;
+
+        /*!
+         * \brief Whether this renderpass's pipelines draw order-independent transparency. See
+         * `RenderPassCreateInfo::uses_order_independent_transparency`
+         */
+        bool uses_order_independent_transparency = false;
+
+        /*!
+         * \brief Whether this is one of the frames that a renderpass with an update interval renders in. Nova sets it every frame
+         */
+        bool is_update_frame = true;
+
+        /*!
+         * \brief Sums up everything that this renderpass's contents depend on. Nova sets it every frame, before recording
+         */
+        uint64_t cache_key = 0;
+
+        /*!
+         * \brief Whether this renderpass can skip rendering and keep what it rendered in an earlier frame
+         *
+         * Cached renderpasses can when their cache key hasn't changed, and renderpasses with an update interval can outside of their
+         * update frames. Either way, they have to have rendered at least once
+         */
+        [[nodiscard]] bool can_reuse_cached_contents() const;
+
+        /*!
+         * \brief Makes this renderpass render again next time, even if its cache key doesn't change. Call this when its render targets
+         * are recreated
+         */
+        void invalidate_cached_contents();
 
         /*!
          * \brief Performs the rendering work of this renderpass
@@ -176,12 +592,55 @@ namespace nova::renderer {
          */
         virtual void execute(rhi::RhiRenderCommandList& cmds, FrameContext& ctx);
 
+        /*!
+         * \brief Performs the rendering work of this renderpass, using contents that were already recorded with `record_contents`
+         *
+         * This method records the barriers and begins and ends the renderpass in `cmds`, and executes `contents` inside of the renderpass
+         *
+         * \param cmds The primary command list to record the renderpass into
+         * \param ctx The context for the current frame
+         * \param contents A secondary command list that `record_contents` recorded this renderpass's contents into
+         */
+        void execute(rhi::RhiRenderCommandList& cmds, FrameContext& ctx, rhi::RhiRenderCommandList& contents);
+
+        /*!
+         * \brief Performs the rendering work of this renderpass, translating a command stream that `record_contents` recorded into
+         *
+         * Unlike the secondary command list version, the contents end up inline in `cmds`
+         */
+        void execute(rhi::RhiRenderCommandList& cmds, FrameContext& ctx, const rhi::CommandStream& contents);
+
+        /*!
+         * \brief Records the contents of this renderpass into a secondary command list or a command stream
+         *
+         * Nova calls this from worker threads when `supports_parallel_recording` is true. Different renderpasses may be recorded at the
+         * same time, but a single renderpass is only ever recorded by one thread at a time
+         *
+         * Note that `setup_renderpass` is called later, on the thread that records the primary command list
+         */
+        void record_contents(rhi::RhiRenderCommandList& secondary_cmds, FrameContext& ctx);
+
         /*!
          * \brief Returns the framebuffer that this renderpass should render to
          */
         [[nodiscard]] rhi::RhiFramebuffer* get_framebuffer(const FrameContext& ctx) const;
 
+        /*!
+         * \brief Returns the renderpass that this renderpass's contents execute in: the merged renderpass, if there is one
+         */
+        [[nodiscard]] rhi::RhiRenderpass* get_renderpass() const;
+
+        /*!
+         * \brief Returns the subpass of `get_renderpass` that this renderpass's contents execute in
+         */
+        [[nodiscard]] uint32_t get_subpass_index() const;
+
     protected:
+        /*!
+         * \brief The cache key of the last time this renderpass rendered, if it has rendered since it was last invalidated
+         */
+        std::optional<uint64_t> rendered_cache_key;
+
         /*!
          * \brief Records all the resource barriers that need to take place before this renderpass renders anything
          *
@@ -215,6 +674,27 @@ namespace nova::renderer {
          */
         virtual void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx);
 
+        /*!
+         * \brief Begins this renderpass's subpass: begins the renderpass, or moves on to the next subpass if this renderpass was merged
+         * into the renderpass of the passes before it
+         */
+        void begin_subpass(rhi::RhiRenderCommandList& cmds, const FrameContext& ctx, rhi::RenderpassContents contents) const;
+
+        /*!
+         * \brief Ends the renderpass, unless a later subpass of the merged renderpass still has to execute
+         */
+        void end_subpass(rhi::RhiRenderCommandList& cmds) const;
+
+        /*!
+         * \brief Shrinks the viewport to this frame's resolution scale, if this renderpass uses dynamic resolution
+         */
+        void set_dynamic_resolution_viewport(rhi::RhiRenderCommandList& cmds, const FrameContext& ctx) const;
+
+        /*!
+         * \brief Points the camera index at this renderpass's first view, or at the first camera if it doesn't have any views
+         */
+        void set_view_cameras(rhi::RhiRenderCommandList& cmds) const;
+
         /*!
          * \brief Records all the resource barriers that need to take place after this renderpass renders anything
          *
@@ -284,6 +764,45 @@ namespace nova::renderer {
         void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) override;
     };
 
+    /*!
+     * \brief A renderpass that dispatches a single compute pipeline
+     *
+     * Work like post-processing or light culling doesn't need the rasterizer, and it's cheaper as a compute dispatch than as a fullscreen
+     * triangle. Compute renderpasses have no renderpass or framebuffer, so their create info must say that they're a compute pass
+     */
+    class ComputeRenderpass : public Renderpass {
+    public:
+        /*!
+         * \param name The name of this renderpass
+         * \param pipeline The compute pipeline to dispatch
+         * \param num_groups The number of thread groups to dispatch in each direction
+         * \param device The device to create this renderpass's resource binder with
+         * \param is_builtin Whether this render pass is built in to Nova or comes from a renderpack
+         */
+        ComputeRenderpass(const std::string& name,
+                          std::unique_ptr<rhi::RhiPipeline> pipeline,
+                          glm::uvec3 num_groups,
+                          rhi::RenderDevice& device,
+                          bool is_builtin = false);
+
+        /*!
+         * \brief The binder for the resources of this renderpass's pipeline. Bind everything the shader uses before the first frame
+         */
+        [[nodiscard]] RhiResourceBinder& get_resource_binder() const;
+
+    protected:
+        std::unique_ptr<rhi::RhiPipeline> pipeline;
+
+        std::unique_ptr<RhiResourceBinder> resource_binder;
+
+        glm::uvec3 num_groups;
+
+        /*!
+         * \brief Binds the pipeline and its resources, then dispatches `num_groups` thread groups
+         */
+        void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) override;
+    };
+
     /*!
      * \brief Represents Nova's rendergraph
      *
@@ -331,7 +850,86 @@ namespace nova::renderer {
 
         void destroy_renderpass(const std::string& name);
 
-        [[nodiscard]] std::vector<std::string> calculate_renderpass_execution_order();
+        /*!
+         * \brief Turns a renderpass on or off
+         *
+         * A renderpass that's off doesn't draw anything. The passes that only it depended on don't run at all, which is what makes
+         * turning off a pass free. If a pass that's still on reads one of its outputs, it begins and ends its renderpass without drawing
+         * anything, so the outputs that it clears read as their clear color. Its other outputs keep what they last had in them
+         *
+         * The execution order and barriers are worked out again the next time the rendergraph is compiled, but nothing else is made
+         * again, so this is cheap enough to do whenever a setting changes
+         */
+        void set_renderpass_enabled(const std::string& name, bool enabled);
+
+        /*!
+         * \brief Creates new framebuffers for every renderpass that has one, using whatever render targets `resource_storage` has now
+         *
+         * Call this after recreating render targets, e.g. because the window was resized. The renderpasses and their pipelines stay as
+         * they are, only the framebuffers and barriers change
+         *
+         * \pre The device is idle
+         */
+        void recreate_framebuffers(DeviceResources& resource_storage);
+
+        /*!
+         * \brief Returns the renderpasses in the order they execute in
+         *
+         * The order is only worked out again after renderpasses were added or removed, and it only follows the handles in the
+         * rendergraph's index of which passes write each resource, so the rest of the time this just hands back the last order
+         */
+        [[nodiscard]] const std::vector<Renderpass*>& calculate_renderpass_execution_order();
+
+        /*!
+         * \brief Figures out the order that the renderpasses will execute in once `new_passes` are added to the rendergraph
+         *
+         * Useful for planning resources that depend on the execution order before the renderpasses themselves can be created. Passes in
+         * `new_passes` replace any existing passes with the same name
+         *
+         * \return The create infos of every pass in execution order, or an empty vector if the passes can't be ordered
+         */
+        [[nodiscard]] std::vector<renderpack::RenderPassCreateInfo> predict_renderpass_execution_order(
+            const std::vector<renderpack::RenderPassCreateInfo>& new_passes) const;
+
+        /*!
+         * \brief Tells the rendergraph which render targets share their memory with other render targets
+         *
+         * The first pass to use one of these render targets each frame throws away its contents, instead of transitioning it from the
+         * layout it was last used in
+         */
+        void set_aliased_textures(std::unordered_set<std::string> textures);
+
+        /*!
+         * \brief Whether a render target shares its memory with other render targets, so its contents don't last to the end of the frame
+         */
+        [[nodiscard]] bool is_aliased(const std::string& texture_name) const;
+
+        /*!
+         * \brief Regenerates the barriers of every renderpass and splits the execution order into submissions, if the renderpasses
+         * changed since the last call
+         *
+         * This walks the execution order and tracks the layout, access, pipeline stages, and queue of each render target. A render target
+         * only gets a barrier when its layout changes or when one side of the barrier writes to it. All of a pass's barriers are merged
+         * into one pipeline barrier command
+         *
+         * Consecutive passes on the same queue share a submission. When a pass uses a render target that the other queue used last, its
+         * submission waits for the other queue's submission, and the render target gets a release barrier on one queue and an acquire
+         * barrier on the other
+         *
+         * Render targets start each frame in the layout they were created in, owned by the graphics queue, and the last pass of the frame
+         * puts them back there
+         *
+         * Runs of graphics passes that render to the same pixels, one after another in the same submission, get merged into one
+         * renderpass with a subpass for each pass. Passes read what the earlier subpasses wrote with their `input_attachments`, so on
+         * tile-based GPUs it never leaves tile memory. Render targets that only a merged renderpass uses, and that it clears first, are
+         * never stored at all. If the merged renderpasses can't be created, every pass gets its own renderpass again
+         */
+        void compile(DeviceResources& resource_storage);
+
+        /*!
+         * \brief Returns the submissions that `compile` split the execution order into, in the order they must be submitted
+         */
+        [[nodiscard]] const std::vector<RendergraphSubmission>& get_submissions() const;
 
         [[nodiscard]] Renderpass* get_renderpass(const std::string& name) const;
 
@@ -340,12 +938,93 @@ namespace nova::renderer {
     private:
         bool is_dirty = false;
 
+        bool barriers_dirty = false;
+
+        std::unordered_set<std::string> aliased_textures;
+
         rhi::RenderDevice& device;
 
-        std::unordered_map<std::string, Renderpass*> renderpasses;
+        /*!
+         * \brief Every renderpass, indexed by handle. Removed renderpasses leave a `nullptr` behind until their handle is reused
+         */
+        std::vector<Renderpass*> renderpasses;
+
+        /*!
+         * \brief Metadata of every renderpass, indexed by handle
+         */
+        std::vector<RenderpassMetadata> renderpass_metadatas;
+
+        std::vector<RenderpassHandle> free_handles;
+
+        std::unordered_map<std::string, RenderpassHandle> handles_by_name;
+
+        /*!
+         * \brief The handles of the passes that write to each texture or buffer, sorted by pass name
+         *
+         * Sorting by name makes the execution order match what `predict_renderpass_execution_order` said it would be
+         */
+        std::unordered_map<std::string, std::vector<RenderpassHandle>> resource_writers;
+
+        std::vector<Renderpass*> cached_execution_order;
+
+        std::vector<RendergraphSubmission> submissions;
+
+        struct MergedRenderpass {
+            /*!
+             * \brief The names of the merged passes, in subpass order
+             */
+            std::vector<std::string> pass_names;
+
+            std::unordered_set<std::string> transient_attachments;
+
+            rhi::RhiRenderpass* renderpass = nullptr;
+            rhi::RhiFramebuffer* framebuffer = nullptr;
+
+            /*!
+             * \brief Whether the latest `compile_passes` used this renderpass. Pipelines that were compiled for a merged renderpass stay
+             * valid as long as the same passes keep getting merged
+             */
+            bool is_used = false;
+        };
+
+        std::vector<MergedRenderpass> merged_renderpasses;
+
+        /*!
+         * \brief Does the work of `compile`
+         *
+         * \param resource_storage Where to find the render targets
+         * \param merge_passes Whether to merge runs of passes into subpasses
+         *
+         * \return False if a merged renderpass couldn't be created
+         */
+        bool compile_passes(DeviceResources& resource_storage, bool merge_passes);
+
+        /*!
+         * \brief Destroys the merged renderpass that contains `pass_name`, if there is one
+         */
+        void destroy_merged_renderpass(const std::string& pass_name);
+
+        /*!
+         * \brief Gives a renderpass a handle and adds it to the index of resource writers
+         */
+        void register_renderpass(Renderpass* renderpass, RenderpassMetadata metadata);
+
+        /*!
+         * \brief Finds the shading rate image for a pass that uses an adaptive shading rate
+         *
+         * If the device can't read a shading rate image, the framebuffer isn't the size of the screen, or nothing made the shading rate
+         * image, the pass is told it doesn't use one after all, so it shades at its fixed rate
+         */
+        [[nodiscard]] std::optional<rhi::RhiImage*> get_shading_rate_attachment(renderpack::RenderPassCreateInfo& create_info,
+                                                                               const glm::uvec2& framebuffer_size,
+                                                                               DeviceResources& resource_storage) const;
 
-        std::vector<std::string> cached_execution_order;
-        std::unordered_map<std::string, RenderpassMetadata> renderpass_metadatas;
+        /*!
+         * \brief Adds the passes that write to the resources `handle` reads from to `ordered_passes`, then does the same for each of them
+         *
+         * This is the same traversal that `renderpack::order_passes` does, only with handles instead of names
+         */
+        void add_dependent_passes(RenderpassHandle handle, std::vector<RenderpassHandle>& ordered_passes, uint32_t depth) const;
     };
 
     template <typename RenderpassType, typename... Args>
@@ -364,6 +1043,18 @@ namespace nova::renderer {
         RenderpassMetadata metadata;
         metadata.data = create_info;
 
+        // Compute passes write their outputs as storage images, which have to be render targets that the pass can barrier
+        const auto is_compute_pass = create_info.is_compute_pass();
+        const auto writes_to_backbuffer = std::any_of(create_info.texture_outputs.begin(),
+                                                      create_info.texture_outputs.end(),
+                                                      [](const renderpack::TextureAttachmentInfo& output) {
+                                                          return output.name == BACKBUFFER_NAME;
+                                                      });
+        if(is_compute_pass && (writes_to_backbuffer || create_info.depth_texture)) {
+            rg_log->error("Renderpass %s is a compute pass, so it can't have a depth texture or write to the backbuffer", create_info.name);
+            return nullptr;
+        }
+
         std::vector<rhi::RhiImage*> color_attachments;
         color_attachments.reserve(create_info.texture_outputs.size());
 
@@ -445,34 +1136,42 @@ namespace nova::renderer {
             return nullptr;
         }
 
-        ntl::Result<rhi::RhiRenderpass*> renderpass_result = device.create_renderpass(create_info, framebuffer_size, allocator);
-        if(renderpass_result) {
-            renderpass->renderpass = renderpass_result.value;
+        if(is_compute_pass) {
+            // Compute passes don't rasterize anything, so they don't need a renderpass or a framebuffer. Without a separate compute
+            // queue, async compute passes still work, they just run on the graphics queue
+            const auto use_async_compute = create_info.queue == rhi::QueueType::AsyncCompute && device.info.has_async_compute_queue;
+            renderpass->queue = use_async_compute ? rhi::QueueType::AsyncCompute : rhi::QueueType::Graphics;
+            renderpass->texture_read_stages = rhi::PipelineStage::ComputeShader;
 
         } else {
-            rg_log->error("Could not create renderpass %s: %s", create_info.name, renderpass_result.error.to_string());
-            return nullptr;
-        }
+            const auto shading_rate_attachment = get_shading_rate_attachment(metadata.data, framebuffer_size, resource_storage);
 
-        // Backbuffer framebuffers are owned by the swapchain, not the renderpass that writes to them, so if the
-        // renderpass writes to the backbuffer then we don't need to create a framebuffer for it
-        if(!renderpass->writes_to_backbuffer) {
-            renderpass->framebuffer = device.create_framebuffer(renderpass->renderpass,
-                                                                color_attachments,
-                                                                depth_attachment,
-                                                                framebuffer_size,
-                                                                allocator);
+            ntl::Result<rhi::RhiRenderpass*> renderpass_result = device.create_renderpass(metadata.data, framebuffer_size, allocator);
+            if(renderpass_result) {
+                renderpass->renderpass = renderpass_result.value;
+
+            } else {
+                rg_log->error("Could not create renderpass %s: %s", create_info.name, renderpass_result.error.to_string());
+                return nullptr;
+            }
+
+            // Backbuffer framebuffers are owned by the swapchain, not the renderpass that writes to them, so if the
+            // renderpass writes to the backbuffer then we don't need to create a framebuffer for it
+            if(!renderpass->writes_to_backbuffer) {
+                renderpass->framebuffer = device.create_framebuffer(renderpass->renderpass,
+                                                                    color_attachments,
+                                                                    depth_attachment,
+                                                                    shading_rate_attachment,
+                                                                    framebuffer_size,
+                                                                    allocator);
+            }
         }
 
         renderpass->pipeline_names = create_info.pipeline_names;
-        renderpass->id = static_cast<uint32_t>(renderpass_metadatas.size());
 
         destroy_renderpass(create_info.name);
 
-        renderpasses.insert(create_info.name, renderpass);
-        renderpass_metadatas.insert(create_info.name, metadata);
-
-        is_dirty = true;
+        register_renderpass(renderpass, std::move(metadata));
 
         return renderpass;
     }
@@ -103,6 +103,15 @@ namespace nova::renderer::renderpack {
 
     enum class RPPrimitiveTopology { Triangles, Lines };
 
+    /*!
+     * \brief Which layout the vertices drawn by a pipeline have
+     *
+     * Full pipelines get their vertex fields from reflecting on the vertex shader. Compact pipelines always use the fields of
+     * CompactVertex. Pulled pipelines have no vertex fields at all: their vertex shaders read each mesh's vertices themselves, with
+     * `fetch_vertex` from `./nova/vertex_pulling.hlsl`, so one pipeline can draw meshes with any layout
+     */
+    enum class RPVertexLayout { Full, Compact, Pulled };
+
     enum class RPBlendFactor {
         One,
         Zero,
@@ -126,9 +135,51 @@ namespace nova::renderer::renderpack {
 
     enum class TextureDimensionType { ScreenRelative, Absolute };
 
+    /*!
+     * \brief What a render target holds, so Nova can give it a smaller format than the renderpack asked for at lower
+     * `NovaSettings::render_target_precision` tiers
+     *
+     * Each hint is a promise about what the shaders write. Nova never picks a format larger than the one that the renderpack asked for,
+     * and it keeps the renderpack's format on GPUs that can't render to and sample from the smaller one
+     */
+    enum class TexturePrecision {
+        /*!
+         * \brief Always use the renderpack's format
+         */
+        Exact,
+
+        /*!
+         * \brief Color that's never negative, and whose alpha doesn't matter. Becomes R11G11B10F
+         */
+        HdrColor,
+
+        /*!
+         * \brief Normals encoded between zero and one, with no more than two bits of alpha. Becomes RGB10A2
+         */
+        Normals,
+
+        /*!
+         * \brief Material values between zero and one, like roughness and metalness. Becomes RGBA8 at the compact tier
+         */
+        PackedMaterial,
+
+        /*!
+         * \brief Screen-space motion in red and green. Becomes RG16F, or RG16 snorm at the compact tier, so the motion has to be in UV
+         * units for that one
+         */
+        Velocity,
+    };
+
     enum class ImageUsage {
         RenderTarget,
         SampledImage,
+
+        /*!
+         * \brief A render target that's only ever used inside a single merged renderpass, so its contents never have to leave tile memory
+         *
+         * Shaders can only read these as input attachments. On GPUs with lazily allocated memory, they may never get any memory at all
+         */
+        TransientRenderTarget,
     };
 
     /*!
@@ -171,6 +222,23 @@ namespace nova::renderer::renderpack {
         std::vector<uint32_t> source;
     };
 
+    /*!
+     * \brief One axis of a pipeline's shader permutations, like which lighting model to use or whether to alpha test
+     *
+     * Every variant of the pipeline defines exactly one keyword from each of its axes
+     */
+    struct ShaderKeywordAxis {
+        std::string name;
+
+        /*!
+         * \brief All the keywords on this axis. The first one is the default. The keyword `_` doesn't define anything, so a single
+         * toggle can be written as `["_", "ALPHA_TEST"]`
+         */
+        std::vector<std::string> keywords;
+
+        static ShaderKeywordAxis from_json(const nlohmann::json& json);
+    };
+
     /*!
      * \brief All the data that Nova uses to build a pipeline
      */
@@ -180,6 +248,11 @@ namespace nova::renderer::renderpack {
          */
         std::string name;
 
+        /*!
+         * \brief The file that this pipeline was loaded from, relative to the renderpack's root
+         */
+        std::string source_file;
+
         /*!
          * \brief The pipeline that this pipeline inherits from
          */
@@ -195,6 +268,22 @@ namespace nova::renderer::renderpack {
          */
         std::vector<std::string> defines{};
 
+        /*!
+         * \brief The axes of this pipeline's shader permutations
+         *
+         * Only the default variant, with the first keyword of every axis, is compiled when the renderpack loads. The shaders in this
+         * pipeline data are that variant's. Other variants are compiled in the background the first time a material asks for them
+         */
+        std::vector<ShaderKeywordAxis> keyword_axes{};
+
+        /*!
+         * \brief Values for the shaders' specialization constants, by name. `NovaSettings::specialization_constants` overrides these
+         *
+         * Unlike defines, these don't need another compile of the shaders for every value, and the driver still folds them into
+         * branches and loop counts. Bools take 0 or 1
+         */
+        std::unordered_map<std::string, double> specialization_constants{};
+
         /*!
          * \brief Defines the rasterizer state that's active for this pipeline
          */
@@ -250,6 +339,11 @@ namespace nova::renderer::renderpack {
          */
         RPPrimitiveTopology primitive_mode{};
 
+        /*!
+         * \brief The layout of the vertices that this pipeline draws
+         */
+        RPVertexLayout vertex_layout = RPVertexLayout::Full;
+
         /*!
          * \brief Where to get the blending factor for the source
          */
@@ -315,6 +409,33 @@ namespace nova::renderer::renderpack {
          */
         float height = 0;
 
+        /*!
+         * \brief How many array layers the texture has
+         *
+         * Passes that render several views write view N to layer N of their outputs, so their outputs need a layer per view
+         */
+        uint32_t num_layers = 1;
+
+        /*!
+         * \brief How many slices deep the texture is, in pixels. Textures more than one slice deep are 3D textures, which can't have
+         * more than one array layer
+         */
+        uint32_t depth = 1;
+
+        /*!
+         * \brief How many samples each pixel of the texture has, for render targets that passes render to with MSAA
+         *
+         * Passes render to a multisampled copy of the texture that never leaves the renderpass, and resolve it into the texture at the
+         * end. Everything else only ever sees the resolved texture. GPUs that don't support this many samples get the most that they do
+         */
+        uint32_t num_samples = 1;
+
+        /*!
+         * \brief What the texture holds. Nova may swap `pixel_format` for a smaller format with the same precision when the renderpack
+         * is loaded
+         */
+        TexturePrecision precision = TexturePrecision::Exact;
+
         [[nodiscard]] glm::uvec2 get_size_in_pixels(const glm::uvec2& screen_size) const;
 
         bool operator==(const TextureFormat& other) const;
@@ -368,12 +489,100 @@ namespace nova::renderer::renderpack {
 
         TextureFormat format{};
 
+        /*!
+         * \brief How much the texture wants to stay in device memory when the device is short on it, from 0 to 1. Not read from JSON
+         */
+        float residency_priority = 0.5f;
+
+        /*!
+         * \brief How many mips the texture has. Not read from JSON. Render targets from renderpacks only ever have one, but builtin ones
+         * like `HI_Z_RT_NAME` may have more. Render targets get no more than a full mip chain, whatever this says
+         */
+        uint32_t num_mips = 1;
+
+        /*!
+         * \brief Who the texture's memory belongs to in memory reports, like a renderpack. Not read from JSON. Textures without an
+         * owner are their own
+         */
+        std::string owner;
+
         static TextureCreateInfo from_json(const nlohmann::json& json);
     };
 
+    /*!
+     * \brief A source of particles that live entirely on the GPU
+     *
+     * Particles are spawned, moved, and killed by a compute shader every frame, then drawn as camera-facing quads by one of the
+     * material's passes. The application only moves emitters around and turns them up or down, see `NovaRenderer::set_particle_emitter`
+     */
+    struct ParticleEmitterCreateInfo {
+        /*!
+         * \brief The name the application uses for this emitter
+         */
+        std::string name;
+
+        /*!
+         * \brief The material whose pass draws the particles
+         */
+        std::string material;
+
+        /*!
+         * \brief The material pass that draws the particles. Its pipeline has to use the full vertex layout, and its vertex shader should
+         * place the particles with `get_particle_vertex` from `./nova/particles.hlsl`
+         */
+        std::string material_pass;
+
+        /*!
+         * \brief How many particles may be alive at once. New particles aren't spawned while the emitter is full
+         */
+        uint32_t max_particles = 1024;
+
+        /*!
+         * \brief How many particles to spawn every second
+         */
+        float spawn_rate = 64;
+
+        float min_lifetime = 1;
+        float max_lifetime = 1;
+
+        /*!
+         * \brief Half the size of the box around the emitter where particles spawn, in world units
+         */
+        glm::vec3 spawn_extent{0};
+
+        glm::vec3 initial_velocity{0};
+
+        /*!
+         * \brief Up to how much each component of a particle's initial velocity may randomly differ from `initial_velocity`
+         */
+        glm::vec3 velocity_randomness{0};
+
+        /*!
+         * \brief Added to every particle's velocity every second, like gravity
+         */
+        glm::vec3 acceleration{0};
+
+        /*!
+         * \brief How much of its velocity a particle loses every second, from 0 to 1
+         */
+        float drag = 0;
+
+        /*!
+         * \brief The width of a particle's quad when it spawns and when it dies, in world units. It changes linearly in between
+         */
+        float start_size = 0.1f;
+        float end_size = 0.1f;
+
+        glm::vec4 start_color{1};
+        glm::vec4 end_color{1};
+
+        static ParticleEmitterCreateInfo from_json(const nlohmann::json& json);
+    };
+
     struct RenderpackResourcesData {
         std::vector<TextureCreateInfo> render_targets;
         std::vector<SamplerCreateInfo> samplers;
+        std::vector<ParticleEmitterCreateInfo> particle_emitters;
 
         static RenderpackResourcesData from_json(const nlohmann::json& json);
     };
@@ -398,11 +607,49 @@ namespace nova::renderer::renderpack {
          */
         bool clear = false;
 
+        /*!
+         * \brief Whether anything reads what this pass writes to the texture, later this frame or next frame before it's cleared. If
+         * not, the pass doesn't write it out to memory at all
+         *
+         * This isn't in the JSON. Nova works it out from how every pass in the frame uses the texture
+         */
+        bool store = true;
+
+        /*!
+         * \brief How many samples each pixel of the texture has. Like `pixel_format`, this comes from the texture's format
+         */
+        uint32_t num_samples = 1;
+
         bool operator==(const TextureAttachmentInfo& other) const;
 
         static TextureAttachmentInfo from_json(const nlohmann::json& json);
     };
 
+    /*!
+     * \brief A reduced-resolution output of a pass, and the full-resolution texture that Nova upsamples it into
+     *
+     * The upsample weighs each low-resolution texel by how close the full-resolution depth under it is to the depth of the pixel being
+     * filled in, so that edges stay sharp instead of bleeding across silhouettes
+     */
+    struct UpsampledOutput {
+        /*!
+         * \brief The pass's low-resolution output
+         */
+        std::string source;
+
+        /*!
+         * \brief The full-resolution texture to upsample into. Passes that read this instead of `source` run after the upsample
+         */
+        std::string destination;
+
+        /*!
+         * \brief The full-resolution depth texture that guides the upsample
+         */
+        std::string depth;
+
+        static UpsampledOutput from_json(const nlohmann::json& json);
+    };
+
     /*!
      * \brief A pass over the scene
      *
@@ -433,6 +680,15 @@ namespace nova::renderer::renderpack {
          */
         std::vector<std::string> texture_inputs{};
 
+        /*!
+         * \brief The texture inputs that this pass only reads at the pixel it's shading, as a `SubpassInput`
+         *
+         * The rendergraph puts this pass in the same renderpass as the passes that write these textures, so it can read them straight
+         * out of tile memory. That only works when those passes run right before this one and have the same framebuffer size. Every
+         * input attachment must also be in `texture_inputs`
+         */
+        std::vector<std::string> input_attachments{};
+
         /*!
          * \brief The textures that this pass will write to
          */
@@ -458,8 +714,132 @@ namespace nova::renderer::renderpack {
          */
         std::vector<std::string> pipeline_names;
 
+        /*!
+         * \brief The compute shader that this pass dispatches, if it's a compute pass
+         *
+         * Compute passes write to their texture outputs as storage images, with one thread per pixel of the first output. They can't have
+         * a depth texture or write to the backbuffer. The shader's bindings use the names of the textures they're bound to
+         */
+        std::optional<RenderpackShaderSource> compute_shader;
+
+        /*!
+         * \brief The queue that this renderpass runs on
+         *
+         * Passes on the async compute queue are always compute passes. They can overlap with the graphics work around them, and the
+         * rendergraph adds the semaphores and ownership transfers that their resources need. If the device has no separate compute queue,
+         * these passes run on the graphics queue instead
+         */
+        rhi::QueueType queue = rhi::QueueType::Graphics;
+
+        /*!
+         * \brief Names of the cameras that this pass renders with, one per view
+         *
+         * A pass with more than one view renders all of them at once, like the cascades of a shadow map or the faces of a cubemap. Its
+         * draws are recorded once, and view N renders to layer N of every output. Shaders find their view's camera with
+         * `get_view_camera(SV_ViewID)`. Passes without any views render with the first camera. At most `MAX_NUM_VIEWS` views
+         */
+        std::vector<std::string> views;
+
+        /*!
+         * \brief Whether this pass keeps what it rendered last time, and only renders again when something it draws has changed
+         *
+         * Use this for things like shadow maps of static geometry. A cached pass renders again when a renderable with one of its
+         * pipelines is added, moved, or removed, when a procedural mesh it draws gets new data, or when one of its cameras moves. Its
+         * textures have to stay the same for the cache to be worth anything, so its outputs never share memory with other textures.
+         * Compute passes and passes that write to the backbuffer ignore this
+         */
+        bool is_cached = false;
+
+        /*!
+         * \brief Whether this pass draws the depth of all its opaque pipelines before it shades anything
+         *
+         * Nova makes a depth-only copy of each opaque pipeline that writes depth, and draws everything with those copies first, front to
+         * back. The real pipelines then only shade the pixels whose depth is equal to what the prepass wrote, so expensive pixel shaders
+         * run once per pixel no matter how much overdraw there is. Pixel shaders that discard or write depth still run in the prepass,
+         * but without writing color. The pass must have a depth texture
+         */
+        bool has_depth_prepass = false;
+
+        /*!
+         * \brief Whether this pass records its draws once and executes the same commands every frame, until something it records changes
+         *
+         * The pass still renders every frame, so its cameras can move freely. It records again when one of its pipelines gains or loses
+         * renderables, when a procedural mesh it draws gets new data, or when its render targets are resized. Passes that write to the
+         * backbuffer and passes with occlusion queries ignore this, as does everything when `parallel_command_recording` is off
+         */
+        bool reuses_commands = false;
+
+        /*!
+         * \brief The name of the renderpass option that turns this pass on and off, or empty if it's always on
+         *
+         * Options are on unless the host application turns them off. Use these for quality settings, like a pass that draws ambient
+         * occlusion, so that one renderpack works for every preset. See `Rendergraph::set_renderpass_enabled` for what a pass that's off
+         * still does
+         */
+        std::string enabled_by;
+
+        /*!
+         * \brief How many frames go by between each time this pass renders. It keeps what it rendered in the frames in between
+         *
+         * Use this for expensive effects that change slowly, like reflection probes or GI. The passes with the same interval take turns,
+         * so that a renderpack with four passes that render every four frames renders one of them each frame. Like cached passes, these
+         * never share memory with other textures, and passes that write to the backbuffer ignore this
+         */
+        uint32_t update_interval = 1;
+
+        /*!
+         * \brief The outputs of this pass that Nova upsamples to full resolution when the pass is done
+         *
+         * Give the low-resolution outputs a screen-relative size of less than one. Consumers read the upsampled destination, which can be
+         * any format as long as compute shaders can write to it
+         */
+        std::vector<UpsampledOutput> upsampled_outputs;
+
+        /*!
+         * \brief How many pixels each invocation of this pass's pixel shaders covers, or nothing to shade every pixel
+         *
+         * Coarse rates suit passes whose results are smooth anyway, like sky, fog, or volumetrics. Devices without variable rate shading
+         * ignore this, as do compute passes. Passes with a shading rate don't share a renderpass with the passes around them
+         */
+        std::optional<rhi::ShadingRate> shading_rate;
+
+        /*!
+         * \brief Whether this pass picks its shading rate for each tile of the screen, from `SHADING_RATE_RT_NAME`
+         *
+         * Nova fills that image each frame, after everything else. Tiles with little contrast or a lot of motion in the last frame get
+         * coarser rates. When the pass also has a `shading_rate`, each tile uses the coarser of the two. Only passes whose framebuffer is
+         * the size of the screen can use it, and devices that can't read the shading rate from an image ignore this
+         */
+        bool uses_adaptive_shading_rate = false;
+
+        /*!
+         * \brief Whether this pass blends its pipelines with weighted-blended order-independent transparency, so it can draw them in any
+         * order
+         *
+         * The pipelines render into an accumulation and a coverage texture that Nova makes, instead of into the pass's color output, and
+         * write to them with `write_oit` from `./nova/oit.hlsl`. Nova sets their blending and turns off their depth writes. A builtin pass
+         * right after this one blends the result over the pass's color output, which must be its only color output and must not be
+         * cleared. Compute passes ignore this
+         */
+        bool uses_order_independent_transparency = false;
+
         RenderPassCreateInfo() = default;
 
+        /*!
+         * \brief Whether this pass dispatches compute work instead of rasterizing, and so has no renderpass or framebuffer
+         */
+        [[nodiscard]] bool is_compute_pass() const;
+
+        /*!
+         * \brief Whether this pass's outputs have to keep their contents between frames, because the pass doesn't render every frame
+         */
+        [[nodiscard]] bool keeps_outputs() const;
+
+        /*!
+         * \brief Whether this pass renders to multisampled attachments, which have to be resolved before the renderpass ends
+         */
+        [[nodiscard]] bool is_multisampled() const;
+
         static RenderPassCreateInfo from_json(const nlohmann::json& json);
     };
 
@@ -487,6 +867,11 @@ namespace nova::renderer::renderpack {
 
         std::unordered_map<std::string, std::string> bindings;
 
+        /*!
+         * \brief The keywords this pass wants from its pipeline's keyword axes. Axes that none of these are on use their default keyword
+         */
+        std::vector<std::string> keywords;
+
         /*!
          * \brief All the descriptor sets needed to bind everything used by this material to its pipeline
          *
@@ -527,41 +912,74 @@ namespace nova::renderer::renderpack {
 
     [[nodiscard]] rhi::PixelFormat pixel_format_enum_from_string(const std::string& str);
     [[nodiscard]] TextureDimensionType texture_dimension_type_enum_from_string(const std::string& str);
+    [[nodiscard]] TexturePrecision texture_precision_enum_from_string(const std::string& str);
     [[nodiscard]] TextureFilter texture_filter_enum_from_string(const std::string& str);
     [[nodiscard]] WrapMode wrap_mode_enum_from_string(const std::string& str);
     [[nodiscard]] RPStencilOp stencil_op_enum_from_string(const std::string& str);
     [[nodiscard]] RPCompareOp compare_op_enum_from_string(const std::string& str);
     [[nodiscard]] MsaaSupport msaa_support_enum_from_string(const std::string& str);
     [[nodiscard]] RPPrimitiveTopology primitive_topology_enum_from_string(const std::string& str);
+    [[nodiscard]] RPVertexLayout vertex_layout_enum_from_string(const std::string& str);
     [[nodiscard]] RPBlendFactor blend_factor_enum_from_string(const std::string& str);
     [[nodiscard]] RenderQueue render_queue_enum_from_string(const std::string& str);
     [[nodiscard]] ScissorTestMode scissor_test_mode_from_string(const std::string& str);
     [[nodiscard]] RasterizerState state_enum_from_string(const std::string& str);
+    [[nodiscard]] rhi::ShadingRate shading_rate_enum_from_string(const std::string& str);
 
     [[nodiscard]] rhi::PixelFormat pixel_format_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] TextureDimensionType texture_dimension_type_enum_from_json(const nlohmann::json& j);
+    [[nodiscard]] TexturePrecision texture_precision_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] TextureFilter texture_filter_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] WrapMode wrap_mode_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] RPStencilOp stencil_op_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] RPCompareOp compare_op_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] MsaaSupport msaa_support_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] RPPrimitiveTopology primitive_topology_enum_from_json(const nlohmann::json& j);
+    [[nodiscard]] RPVertexLayout vertex_layout_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] RPBlendFactor blend_factor_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] RenderQueue render_queue_enum_from_json(const nlohmann::json& j);
     [[nodiscard]] ScissorTestMode scissor_test_mode_from_json(const nlohmann::json& j);
     [[nodiscard]] RasterizerState state_enum_from_json(const nlohmann::json& j);
+    [[nodiscard]] rhi::ShadingRate shading_rate_enum_from_json(const nlohmann::json& j);
 
     [[nodiscard]] std::string to_string(rhi::PixelFormat val);
     [[nodiscard]] std::string to_string(TextureDimensionType val);
+    [[nodiscard]] std::string to_string(TexturePrecision val);
     [[nodiscard]] std::string to_string(TextureFilter val);
     [[nodiscard]] std::string to_string(WrapMode val);
     [[nodiscard]] std::string to_string(RPStencilOp val);
     [[nodiscard]] std::string to_string(RPCompareOp val);
     [[nodiscard]] std::string to_string(MsaaSupport val);
     [[nodiscard]] std::string to_string(RPPrimitiveTopology val);
+    [[nodiscard]] std::string to_string(RPVertexLayout val);
     [[nodiscard]] std::string to_string(RPBlendFactor val);
     [[nodiscard]] std::string to_string(RenderQueue val);
     [[nodiscard]] std::string to_string(RasterizerState val);
+    [[nodiscard]] std::string to_string(rhi::ShadingRate val);
 
     [[nodiscard]] uint32_t pixel_format_to_pixel_width(rhi::PixelFormat format);
+
+    /*!
+     * \brief Picks the variant of a pipeline that has the requested keywords
+     *
+     * \param pipeline The pipeline to pick a variant of
+     * \param requested_keywords The keywords to enable. Keywords that aren't on any of the pipeline's axes are ignored, and if more than
+     * one keyword on the same axis is requested, the one that comes first on the axis wins
+     *
+     * \return One keyword for each of the pipeline's keyword axes, in the order of the axes. This identifies the variant
+     */
+    [[nodiscard]] std::vector<std::string> get_variant_keywords(const PipelineData& pipeline,
+                                                                const std::vector<std::string>& requested_keywords);
+
+    /*!
+     * \brief Gets the keywords of a pipeline's default variant
+     */
+    [[nodiscard]] std::vector<std::string> get_default_variant_keywords(const PipelineData& pipeline);
+
+    /*!
+     * \brief Gets all the preprocessor defines to compile a variant's shaders with: the pipeline's own defines, then the variant's
+     * keywords
+     */
+    [[nodiscard]] std::vector<std::string> get_variant_defines(const PipelineData& pipeline,
+                                                               const std::vector<std::string>& variant_keywords);
 } // namespace nova::renderer::renderpack
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <deque>
+#include <functional>
+#include <future>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/nova_settings.hpp"
 #include "nova_renderer/rhi/forward_decls.hpp"
 #include "nova_renderer/rhi/rhi_types.hpp"
 #include "nova_renderer/util/container_accessor.hpp"
@@ -25,6 +32,111 @@ namespace nova::renderer {
         size_t height;
 
         rhi::PixelFormat format;
+
+        /*!
+         * \brief Becomes ready when the GPU has finished uploading the texture's initial data. Don't sample the texture before then
+         */
+        std::shared_future<void> upload_done;
+
+        [[nodiscard]] bool is_upload_done() const;
+    };
+
+    /*!
+     * \brief Reads the tightly packed pixels of one mip of a streamed texture
+     *
+     * Block-compressed mips are tightly packed blocks instead, with whole blocks on the right and bottom edges even when the mip isn't a
+     * multiple of the block size. Called on a worker thread, possibly for several mips of several textures at once. Return an empty
+     * vector if the mip can't be read
+     */
+    using TextureMipLoader = std::function<std::vector<uint8_t>(uint32_t mip)>;
+
+    /*!
+     * \brief A texture whose mips are read from disk as the renderer needs them, instead of all at once
+     */
+    struct StreamedTextureCreateInfo {
+        std::string name;
+
+        /*!
+         * \brief The width of mip 0, in pixels
+         */
+        uint32_t width = 0;
+
+        /*!
+         * \brief The height of mip 0, in pixels
+         */
+        uint32_t height = 0;
+
+        rhi::PixelFormat format{};
+
+        /*!
+         * \brief How many mips the texture has on disk. Zero means a full chain down to 1x1
+         */
+        uint32_t num_mips = 0;
+
+        TextureMipLoader load_mip;
+
+        /*!
+         * \brief The texture only has mip 0 on disk, and the GPU filters the rest of the chain down from it
+         *
+         * There aren't any smaller mips to show while mip 0 loads, so the whole texture is loaded at once and never evicted.
+         * Block-compressed textures can't be filtered, so they have to come with their mips
+         */
+        bool generate_mips = false;
+
+        /*!
+         * \brief How much the texture's high-resolution mips want to stay in device memory, from 0 to 1
+         */
+        float residency_priority = 0.5f;
+    };
+
+    /*!
+     * \brief Reads the pixels of one page of one mip of a virtual texture
+     *
+     * Must return `page_size * page_size` tightly packed RGBA8 pixels, where `page_size` is
+     * `NovaSettings::VirtualTexturingOptions::page_size`. Pages on the right or bottom edge of a mip hang over the edge, and the pixels
+     * past the edge are never read. Called on a worker thread, possibly for several pages at once. Return an empty vector if the page
+     * can't be read
+     */
+    using VirtualPageLoader = std::function<std::vector<uint8_t>(uint32_t mip, uint32_t page_x, uint32_t page_y)>;
+
+    /*!
+     * \brief A texture that's too large to keep in device memory, so only the pages that shaders sample are loaded
+     */
+    struct VirtualTextureCreateInfo {
+        std::string name;
+
+        /*!
+         * \brief The width of mip 0, in pixels
+         */
+        uint32_t width = 0;
+
+        /*!
+         * \brief The height of mip 0, in pixels
+         */
+        uint32_t height = 0;
+
+        /*!
+         * \brief How many mips the texture has. Zero means every mip down to the first one that fits in a single page
+         */
+        uint32_t num_mips = 0;
+
+        VirtualPageLoader load_page;
+    };
+
+    /*!
+     * \brief Where a packed texture ended up. Shaders sample it with `sample_packed_texture` from `./nova/packed_textures.hlsl`
+     */
+    struct PackedTextureRegion {
+        /*!
+         * \brief The index of the atlas page that the texture is in, in the textures array. Textures that weren't packed are the only
+         * thing in their texture
+         */
+        uint32_t texture_idx = 0;
+
+        /*!
+         * \brief Multiply the texture's own UVs by xy and add zw to get UVs in the atlas page
+         */
+        glm::vec4 uv_scale_offset{1, 1, 0, 0};
     };
 
     struct BufferResource {
@@ -35,6 +147,55 @@ namespace nova::renderer {
         mem::Bytes size = 0;
     };
 
+    /*!
+     * \brief Some staging memory. It's either a whole pooled staging buffer, or a range of the staging ring
+     */
+    struct StagingAllocation {
+        rhi::RhiBuffer* buffer = nullptr;
+
+        uint64_t offset = 0;
+
+        uint64_t size = 0;
+
+        bool is_from_ring = false;
+    };
+
+    /*!
+     * \brief How much staging memory DeviceResources is holding on to, for keeping an eye on it
+     */
+    struct StagingMemoryStats {
+        /*!
+         * \brief Bytes in pooled staging buffers that are waiting to be reused
+         */
+        uint64_t idle_pooled_bytes = 0;
+
+        /*!
+         * \brief Bytes in pooled staging buffers that someone is uploading through
+         */
+        uint64_t used_pooled_bytes = 0;
+
+        uint64_t ring_size = 0;
+
+        uint64_t used_ring_bytes = 0;
+
+        uint64_t num_buffers_created = 0;
+
+        /*!
+         * \brief How many idle staging buffers were destroyed to stay under `max_pooled_staging_memory`
+         */
+        uint64_t num_buffers_released = 0;
+    };
+
+    /*!
+     * \brief The size, in bytes, of one pixel of the provided format. For block-compressed formats, it's the size of one 4x4 block
+     */
+    [[nodiscard]] size_t size_in_bytes(rhi::PixelFormat pixel_format);
+
+    /*!
+     * \brief The size, in bytes, of a tightly packed image of the provided format and size
+     */
+    [[nodiscard]] uint64_t get_image_size_in_bytes(rhi::PixelFormat pixel_format, uint32_t width, uint32_t height);
+
     using TextureResourceAccessor = VectorAccessor<TextureResource>;
 
     using RenderTargetAccessor = MapAccessor<std::string, TextureResource>;
@@ -50,7 +211,14 @@ namespace nova::renderer {
     public:
         explicit DeviceResources(NovaRenderer& renderer);
 
-        [[nodiscard]] std::optional<BufferResourceAccessor> create_uniform_buffer(const std::string& name, mem::Bytes size);
+        /*!
+         * \brief Creates a CPU-writable buffer for shaders to read from
+         *
+         * \param usage How the buffer is bound. Use `BufferUsage::StorageBuffer` for buffers that shaders declare as structured buffers
+         */
+        [[nodiscard]] std::optional<BufferResourceAccessor> create_uniform_buffer(const std::string& name,
+                                                                                  mem::Bytes size,
+                                                                                  rhi::BufferUsage usage = rhi::BufferUsage::UniformBuffer);
 
         [[nodiscard]] std::optional<BufferResourceAccessor> get_uniform_buffer(const std::string& name);
 
@@ -59,6 +227,9 @@ namespace nova::renderer {
         /*!
          * \brief Creates a new dynamic texture with the provided initial texture data
          *
+         * This method doesn't wait for the GPU to upload the data. It returns as soon as the upload is submitted, and the texture's
+         * `upload_done` future becomes ready once the GPU is done with it. Until then, Nova binds the default texture in its place
+         *
          * \param name The name of the texture. After the texture can been created, you can use this to refer to it
          * \param width The width of the texture
          * \param height The height of the texture
@@ -74,6 +245,54 @@ namespace nova::renderer {
                                                                            const void* data,
                                                                            rx::memory::allocator& allocator);
 
+        /*!
+         * \brief Creates a texture that shares an atlas page with other small textures of the same format, if it's small enough
+         *
+         * Textures are packed into pages with a wrapped border around each one, so the packed texture still repeats and filters like a
+         * texture of its own. Pages are only uploaded by `upload_texture_atlases` or `submit_creation_batch`, so add all the small
+         * textures of a resource pack before either of those. Pages that are uploaded never take more textures. Block-compressed
+         * textures and textures that are larger than `NovaSettings::TexturePackingOptions::max_packed_size` get their own texture, with
+         * a region that covers all of it
+         *
+         * \return Where the texture is, or nothing if it couldn't be created or a packed texture with the same name already exists
+         */
+        [[nodiscard]] std::optional<PackedTextureRegion> create_packed_texture(const std::string& name,
+                                                                               uint32_t width,
+                                                                               uint32_t height,
+                                                                               rhi::PixelFormat pixel_format,
+                                                                               const void* data);
+
+        [[nodiscard]] std::optional<PackedTextureRegion> get_packed_texture(const std::string& name) const;
+
+        /*!
+         * \brief Uploads every atlas page that's taken textures since the last upload. Until a page is uploaded, Nova binds the default
+         * texture in its place
+         */
+        void upload_texture_atlases();
+
+        /*!
+         * \brief Adds a texture that doesn't have an image yet. Nova binds the default texture in its place until it gets one from
+         * `set_texture_image`
+         */
+        [[nodiscard]] std::optional<TextureResourceAccessor> create_empty_texture(const std::string& name,
+                                                                                 size_t width,
+                                                                                 size_t height,
+                                                                                 rhi::PixelFormat pixel_format);
+
+        /*!
+         * \brief Gives a texture a new image, which shaders see from the next frame on. The image's data must already be uploaded, or at
+         * least queued on the upload batcher
+         *
+         * \return The texture's old image. In-flight frames may still sample it, so don't destroy it until they're done
+         */
+        rhi::RhiImage* set_texture_image(uint32_t texture_idx, rhi::RhiImage* image);
+
+        /*!
+         * \brief Forgets about a texture without destroying its image, so its slot can be reused. For textures whose images are owned by
+         * someone else
+         */
+        void remove_texture(uint32_t texture_idx);
+
         [[nodiscard]] std::optional<uint32_t> get_texture_idx_for_name(const std::string& name) const;
 
         /*!
@@ -96,6 +315,11 @@ namespace nova::renderer {
          * \param allocator The allocator to use for any host memory this methods needs to allocate
          * \param can_be_sampled If true, the render target may be sampled by a shader. If false, this render target may only be presented
          * to the screen
+         * \param is_transient If true, the render target is only used inside one merged renderpass and never leaves tile memory. See
+         * `ImageUsage::TransientRenderTarget`
+         * \param num_layers How many array layers the render target has. Passes that render several views need one per view
+         * \param num_mips How many mips the render target has. Clamped to the length of a full mip chain
+         * \param owner Who the render target's memory belongs to in memory reports, like a renderpack. Empty if it's its own
          *
          * \return The new render target if it could be created, or am empty optional if it could not
          */
@@ -104,7 +328,34 @@ namespace nova::renderer {
                                                                               size_t height,
                                                                               rhi::PixelFormat pixel_format,
                                                                               rx::memory::allocator& allocator,
-                                                                              bool can_be_sampled = false);
+                                                                              bool can_be_sampled = false,
+                                                                              bool is_transient = false,
+                                                                              uint32_t num_layers = 1,
+                                                                              uint32_t num_mips = 1,
+                                                                              const std::string& owner = {});
+
+        /*!
+         * \brief Creates render targets that all share the same memory
+         *
+         * The render targets must never be in use at the same time. They start out in the Undefined layout, and whoever uses one of them
+         * must transition it from Undefined before each use, since the others may have clobbered it
+         *
+         * \return True if the render targets were created, false if they can't share memory. Nothing is created in that case
+         */
+        [[nodiscard]] bool create_aliased_render_targets(const std::vector<renderpack::TextureCreateInfo>& create_infos);
+
+        /*!
+         * \brief Makes texture uploads and render targets' first layout transitions go into one command list per queue, instead of each
+         * being submitted on its own, until `submit_creation_batch`
+         *
+         * The textures' uploads aren't done until the batch is submitted, even the ones that would otherwise be waited for
+         */
+        void begin_creation_batch();
+
+        /*!
+         * \brief Submits everything since `begin_creation_batch`, and waits for the GPU to finish it
+         */
+        void submit_creation_batch();
 
         /*!
          * \brief Retrieves the render target with the specified name
@@ -116,14 +367,32 @@ namespace nova::renderer {
         /*!
          * \brief Retrieves a staging buffer at least the specified size
          *
-         * The actual buffer returned may be larger than what you need
+         * Staging buffers come in power-of-two size classes, so the actual buffer returned may be up to twice as large as what you need
          *
          * When you're done with the staging buffer, return it to the pool with `return_staging_buffer`
          */
         rhi::RhiBuffer* get_staging_buffer_with_size(mem::Bytes size);
 
+        /*!
+         * \brief Gives a staging buffer back to the pool. The GPU must be done with it
+         *
+         * If the pool's idle buffers take up more than `max_pooled_staging_memory` afterwards, the ones that have been idle the longest
+         * are destroyed
+         */
         void return_staging_buffer(rhi::RhiBuffer* buffer);
 
+        /*!
+         * \brief Finds space for an upload of the provided size
+         *
+         * Small uploads get a piece of the staging ring, and everything else gets a pooled staging buffer. Free the memory with
+         * `free_staging_memory` once the GPU is done with it
+         */
+        [[nodiscard]] StagingAllocation allocate_staging_memory(mem::Bytes size);
+
+        void free_staging_memory(const StagingAllocation& allocation);
+
+        [[nodiscard]] const StagingMemoryStats& get_staging_memory_stats() const;
+
         [[nodiscard]] const std::vector<TextureResource>& get_all_textures() const;
 
     private:
@@ -133,16 +402,166 @@ namespace nova::renderer {
 
         rx::memory::allocator& internal_allocator;
 
+        /*!
+         * \brief Every texture, at the index that shaders use to find it in the textures array. A texture's index never changes, and
+         * destroyed textures leave an empty slot behind so the textures after them don't move
+         */
         std::vector<TextureResource> textures;
 
+        /*!
+         * \brief Slots in `textures` whose texture was destroyed, which new textures can reuse
+         */
+        std::vector<uint32_t> free_texture_indices;
+
         std::unordered_map<std::string, uint32_t> texture_name_to_idx;
 
         std::unordered_map<std::string, TextureResource> render_targets;
 
-        std::unordered_map<size_t, std::vector<rhi::RhiBuffer*>> staging_buffers;
+        struct IdleStagingBuffer {
+            rhi::RhiBuffer* buffer;
+
+            /*!
+             * \brief Value of `num_staging_buffer_returns` when the buffer was returned, so we know which buffer has been idle the longest
+             */
+            uint64_t return_idx;
+        };
+
+        /*!
+         * \brief Idle staging buffers by size class. Each size class has its buffers in the order they were returned, oldest first
+         */
+        std::unordered_map<size_t, std::deque<IdleStagingBuffer>> staging_buffers;
+
+        uint64_t num_staging_buffer_returns = 0;
+
+        uint64_t max_pooled_staging_memory;
+
+        /*!
+         * \brief A range of the staging ring that's been handed out
+         */
+        struct RingAllocation {
+            uint64_t offset;
+
+            uint64_t size;
+
+            bool is_freed = false;
+        };
+
+        /*!
+         * \brief Persistent staging buffer that small uploads are copied through. It's created the first time it's needed
+         */
+        rhi::RhiBuffer* staging_ring = nullptr;
+
+        uint64_t staging_ring_size;
+
+        /*!
+         * \brief Where the next ring allocation starts, unless it has to wrap around to the start of the ring
+         */
+        uint64_t staging_ring_head = 0;
+
+        /*!
+         * \brief The ring allocations that are still in use, or that were freed while an older allocation is still in use. Oldest first
+         */
+        std::deque<RingAllocation> staging_ring_allocations;
+
+        StagingMemoryStats staging_stats;
 
         std::unordered_map<std::string, BufferResource> uniform_buffers;
 
+        NovaSettings::TexturePackingOptions packing_options;
+
+        /*!
+         * \brief A row of packed textures in an atlas page. Textures go in the first shelf that's tall enough, from left to right
+         */
+        struct AtlasShelf {
+            uint32_t y;
+
+            uint32_t height;
+
+            uint32_t next_x;
+        };
+
+        /*!
+         * \brief An atlas page that still takes textures, because it hasn't been uploaded yet
+         */
+        struct AtlasPage {
+            uint32_t texture_idx;
+
+            rhi::PixelFormat format;
+
+            std::vector<uint8_t> pixels;
+
+            std::vector<AtlasShelf> shelves;
+
+            /*!
+             * \brief Where the next shelf starts
+             */
+            uint32_t next_shelf_y = 0;
+        };
+
+        std::vector<AtlasPage> open_atlas_pages;
+
+        uint32_t num_atlas_pages = 0;
+
+        std::unordered_map<std::string, PackedTextureRegion> packed_textures;
+
+        bool is_batching_creation = false;
+
+        rhi::RhiRenderCommandList* creation_batch_transfer_cmds = nullptr;
+
+        rhi::RhiRenderCommandList* creation_batch_graphics_cmds = nullptr;
+
+        /*!
+         * \brief What to do once the batch is done on the GPU, like freeing the uploads' staging memory
+         */
+        std::vector<std::function<void()>> creation_batch_completions;
+
+        /*!
+         * \brief The batch's command list for the provided queue, or nullptr if there's no batch going
+         */
+        [[nodiscard]] rhi::RhiRenderCommandList* get_creation_batch_commands(rhi::QueueType queue);
+
         void create_default_textures();
+
+        /*!
+         * \brief Puts a texture in the first free slot of the textures array
+         */
+        [[nodiscard]] uint32_t add_texture(const TextureResource& resource);
+
+        [[nodiscard]] std::optional<StagingAllocation> allocate_from_staging_ring(uint64_t size);
+
+        /*!
+         * \brief Finds space for a packed texture and its border in an open atlas page of its format, and copies the texture there
+         */
+        [[nodiscard]] std::optional<PackedTextureRegion> pack_texture(uint32_t width,
+                                                                      uint32_t height,
+                                                                      rhi::PixelFormat pixel_format,
+                                                                      const void* data);
+
+        /*!
+         * \brief Creates an image for a texture, and uploads its initial data into it
+         *
+         * \param wait_for_upload If true, this method blocks until the upload finishes. If false, the texture's staging buffer and
+         * `upload_done` future are taken care of after the GPU is done with them
+         */
+        void create_and_upload_image(TextureResource& resource, const void* data, rx::memory::allocator& allocator, bool wait_for_upload);
+
+        /*!
+         * \brief Destroys the idle staging buffers that were returned the longest ago, until they fit in `max_pooled_staging_memory`
+         */
+        void trim_staging_buffers();
+
+        /*!
+         * \brief Creates a texture and uploads its initial data
+         *
+         * \param wait_for_upload If true, this method blocks until the upload finishes. If false, the texture's staging buffer and
+         * `upload_done` future are taken care of after the GPU is done with them
+         */
+        [[nodiscard]] std::optional<TextureResourceAccessor> create_and_upload_texture(const std::string& name,
+                                                                                      size_t width,
+                                                                                      size_t height,
+                                                                                      rhi::PixelFormat pixel_format,
+                                                                                      const void* data,
+                                                                                      rx::memory::allocator& allocator,
+                                                                                      bool wait_for_upload);
     };
 } // namespace nova::renderer
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint> // needed for uint****
+#include <span>
 
 #include "nova_renderer/rhi/forward_decls.hpp"
 #include "nova_renderer/rhi/rhi_enums.hpp"
@@ -19,6 +20,21 @@ namespace nova::renderer::rhi {
         Uint32,
     };
 
+    /*!
+     * \brief Where the commands for a renderpass come from
+     */
+    enum class RenderpassContents {
+        /*!
+         * \brief Commands are recorded directly into the command list that began the renderpass
+         */
+        Inline,
+
+        /*!
+         * \brief Commands are recorded into secondary command lists, which are executed with `execute_command_lists`
+         */
+        SecondaryCommandLists,
+    };
+
     /*!
      * \brief An API-agnostic command list
      *
@@ -55,20 +71,20 @@ namespace nova::renderer::rhi {
         virtual void set_debug_name(const std::string& name) = 0;
 
         /*!
-         * \brief Bind the buffers of all the resources that Nova needs to render an object
+         * \brief Binds the standard descriptor set of the provided frame slot, which has all the resources that Nova needs to render an
+         * object
+         *
+         * `RenderDevice::update_standard_descriptors` must have been called for the frame slot this frame
          */
-        virtual void bind_material_resources(RhiBuffer* camera_buffer,
-                                             RhiBuffer* material_buffer,
-                                             RhiSampler* point_sampler,
-                                             RhiSampler* bilinear_sampler,
-                                             RhiSampler* trilinear_sampler,
-                                             const std::vector<RhiImage*>& images,
-                                             rx::memory::allocator& allocator) = 0;
+        virtual void bind_material_resources(uint32_t frame_idx) = 0;
 
         /*!
          * \brief Uses the provided resource binder to bind resources to the command list
+         *
+         * \param frame_idx The frame slot that this command list is recorded for. The binder keeps separate descriptors for each frame
+         * slot, so changing what's bound never touches descriptors that an in-flight frame is using
          */
-        virtual void bind_resources(RhiResourceBinder& binder) = 0;
+        virtual void bind_resources(RhiResourceBinder& binder, uint32_t frame_idx) = 0;
 
         /*!
          * \brief Inserts a barrier so that all access to a resource before the barrier is resolved before any access
@@ -76,11 +92,11 @@ namespace nova::renderer::rhi {
          *
          * \param stages_before_barrier The pipeline stages that should be completed before the barriers take effect
          * \param stages_after_barrier The pipeline stages that must wait for the barrier
-         * \param barriers All the resource barriers to use
+         * \param barriers All the resource barriers to use. Takes a span so that barriers can live in a frame's arena, or on the stack
          */
         virtual void resource_barriers(PipelineStage stages_before_barrier,
                                        PipelineStage stages_after_barrier,
-                                       const std::vector<RhiResourceBarrier>& barriers) = 0;
+                                       std::span<const RhiResourceBarrier> barriers) = 0;
 
         /*!
          * \brief Records a command to copy one region of a buffer to another buffer
@@ -116,17 +132,106 @@ namespace nova::renderer::rhi {
          * \param staging_buffer The buffer to use to upload the data to the image. This buffer must be host writable, and must be in the
          * CopySource state
          * \param data A pointer to the data to upload to the image
+         * \param staging_buffer_offset Where in the staging buffer to put the data. Must be a multiple of the pixel size and of four
          *
          * \note The image must be in the Common layout prior to uploading data to it
          */
-        virtual void upload_data_to_image(
-            RhiImage* image, size_t width, size_t height, size_t bytes_per_pixel, RhiBuffer* staging_buffer, const void* data) = 0;
+        virtual void upload_data_to_image(RhiImage* image,
+                                          size_t width,
+                                          size_t height,
+                                          size_t bytes_per_pixel,
+                                          RhiBuffer* staging_buffer,
+                                          const void* data,
+                                          uint64_t staging_buffer_offset = 0) = 0;
+
+        /*!
+         * \brief Records a command to copy tightly packed pixels from a buffer to a rectangle of one mip of an image
+         *
+         * \param image The image to copy to. Must be in the CopyDestination state
+         * \param mip_level The mip of `image` to write
+         * \param x The left edge of the rectangle, in pixels
+         * \param y The top edge of the rectangle, in pixels
+         * \param width The width of the rectangle, in pixels
+         * \param height The height of the rectangle, in pixels
+         * \param source_buffer The buffer to read the pixels from
+         * \param source_offset Where the pixels start in `source_buffer`. Must be a multiple of the pixel size and of four
+         */
+        virtual void copy_buffer_to_image(RhiImage* image,
+                                          uint32_t mip_level,
+                                          uint32_t x,
+                                          uint32_t y,
+                                          uint32_t width,
+                                          uint32_t height,
+                                          RhiBuffer* source_buffer,
+                                          mem::Bytes source_offset) = 0;
+
+        /*!
+         * \brief Records a command to copy a rectangle of one mip of an image to a buffer, tightly packed
+         *
+         * \param destination_buffer The buffer to write the pixels to
+         * \param destination_offset Where the pixels go in `destination_buffer`. Must be a multiple of the pixel size and of four
+         * \param image The image to copy from. Must be in the CopySource state
+         * \param mip_level The mip of `image` to read
+         * \param x The left edge of the rectangle, in pixels
+         * \param y The top edge of the rectangle, in pixels
+         * \param width The width of the rectangle, in pixels
+         * \param height The height of the rectangle, in pixels
+         */
+        virtual void copy_image_to_buffer(RhiBuffer* destination_buffer,
+                                          mem::Bytes destination_offset,
+                                          RhiImage* image,
+                                          uint32_t mip_level,
+                                          uint32_t x,
+                                          uint32_t y,
+                                          uint32_t width,
+                                          uint32_t height) = 0;
+
+        /*!
+         * \brief Records a command to copy a rectangle from the top-left corner of one image to the whole of another, scaling it with
+         * linear filtering and converting it to the other image's format
+         *
+         * \param source The image to copy from. Must be in the CopySource state
+         * \param source_layer The array layer of `source` to read
+         * \param source_width The width of the rectangle to read, in pixels
+         * \param source_height The height of the rectangle to read, in pixels
+         * \param destination The image to copy to. Must be in the CopyDestination state
+         * \param destination_width The width of `destination`, in pixels
+         * \param destination_height The height of `destination`, in pixels
+         */
+        virtual void blit_image(RhiImage* source,
+                                uint32_t source_layer,
+                                uint32_t source_width,
+                                uint32_t source_height,
+                                RhiImage* destination,
+                                uint32_t destination_width,
+                                uint32_t destination_height) = 0;
+
+        /*!
+         * \brief Records commands that fill in some mips of an image by filtering each one down from the mip before it
+         *
+         * Only graphics command lists can generate mips. Block-compressed and depth images can't be filtered like this, so they have to
+         * have their whole mip chain uploaded
+         *
+         * \param image The image to generate mips for. Every mip must be in the ShaderRead state, and stays in it
+         * \param source_mip The mip that already has data in it. The mips after it get generated
+         * \param source_width The width of `source_mip`, in pixels
+         * \param source_height The height of `source_mip`, in pixels
+         * \param num_mips How many mips to generate after `source_mip`
+         */
+        virtual void generate_mips(RhiImage* image,
+                                   uint32_t source_mip,
+                                   uint32_t source_width,
+                                   uint32_t source_height,
+                                   uint32_t num_mips) = 0;
 
         /*!
          * \brief Executed a number of command lists
          *
          * These command lists should be secondary command lists. Nova doesn't validate this because yolo but you need
          * to be nice - the API-specific validation layers _will_ yell at you
+         *
+         * This method finishes recording the provided command lists, so don't record anything else into them afterwards. They're cleaned
+         * up when the GPU finishes executing this command list
          */
         virtual void execute_command_lists(const std::vector<RhiRenderCommandList*>& lists) = 0;
 
@@ -139,18 +244,49 @@ namespace nova::renderer::rhi {
          */
         virtual void set_camera(const Camera& camera) = 0;
 
+        /*!
+         * \brief Sets the index of the camera that subsequent drawcalls will use to render
+         *
+         * Passes that render several views give each view the camera after the previous view's, starting at this index
+         */
+        virtual void set_camera_index(uint32_t index) = 0;
+
         /*!
          * \brief Begins a renderpass
          *
          * \param renderpass The renderpass to begin
          * \param framebuffer The framebuffer to render to
+         * \param contents Whether the renderpass's commands will be recorded inline or executed from secondary command lists. If they're in
+         * secondary command lists, the only command you may record before `end_renderpass` is `execute_command_lists`
          */
-        virtual void begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer) = 0;
+        virtual void begin_renderpass(RhiRenderpass* renderpass,
+                                      RhiFramebuffer* framebuffer,
+                                      RenderpassContents contents = RenderpassContents::Inline) = 0;
+
+        /*!
+         * \brief Moves on to the next subpass of the current renderpass
+         *
+         * Pipelines are compiled for a specific subpass, so you have to set the pipeline again afterwards
+         *
+         * \param contents Whether the next subpass's commands will be recorded inline or executed from secondary command lists
+         */
+        virtual void next_subpass(RenderpassContents contents = RenderpassContents::Inline) = 0;
 
         virtual void end_renderpass() = 0;
 
+        /*!
+         * \brief Sets the index of the material that subsequent drawcalls will use
+         */
         virtual void set_material_index(uint32_t index) = 0;
 
+        /*!
+         * \brief Sets all the per-draw constants at once
+         *
+         * Command lists keep the constants on the CPU and push the whole block right before the next draw, and only if it changed since
+         * the last draw. Setting the camera or material index just changes one field of the block
+         */
+        virtual void set_draw_constants(const RhiDrawConstants& constants) = 0;
+
         virtual void set_pipeline(const RhiPipeline& pipeline) = 0;
 
         virtual void bind_descriptor_sets(const std::vector<RhiDescriptorSet*>& descriptor_sets,
@@ -179,11 +315,108 @@ namespace nova::renderer::rhi {
          * \param num_indices The number of indices to read from the current index buffer
          * \param offset The offset from the beginning of the index buffer to begin reading vertex indices
          * \param num_instances The number of instances to render
+         * \param vertex_offset The value to add to each index before reading from the vertex buffer
+         */
+        virtual void draw_indexed_mesh(uint32_t num_indices,
+                                       uint32_t offset = 0,
+                                       uint32_t num_instances = 1,
+                                       int32_t vertex_offset = 0) = 0;
+
+        /*!
+         * \brief Records indexed draws whose parameters the GPU reads from a buffer
+         *
+         * Each draw is a `RhiDrawIndexedIndirectCommand`. If there's a count buffer, the GPU reads the number of draws from it and never
+         * draws more than `max_draw_count`. Otherwise it draws exactly `max_draw_count` times
+         *
+         * \param draw_commands Buffer with the draw commands. Must have been created with `BufferUsage::DeviceStorageBuffer`
+         * \param draw_commands_offset Offset in bytes of the first draw command
+         * \param max_draw_count The maximum number of draws to record
+         * \param draw_count_buffer Buffer with the actual number of draws as a `uint32_t`, or nullptr to always draw `max_draw_count`
+         * times. Must have been created with `BufferUsage::DeviceStorageBuffer`
+         * \param draw_count_offset Offset of the draw count in `draw_count_buffer`, in bytes
+         */
+        virtual void draw_indexed_indirect(const RhiBuffer* draw_commands,
+                                           uint64_t draw_commands_offset,
+                                           uint32_t max_draw_count,
+                                           const RhiBuffer* draw_count_buffer = nullptr,
+                                           uint64_t draw_count_offset = 0) = 0;
+
+        /*!
+         * \brief Binds a compute pipeline for future dispatches
+         *
+         * Compute pipelines have their own bind point, so this doesn't disturb the current graphics pipeline. It must be called outside a
+         * renderpass
+         */
+        virtual void set_compute_pipeline(const RhiPipeline& pipeline) = 0;
+
+        /*!
+         * \brief Binds the resources in a resource binder for future dispatches
+         *
+         * \param frame_idx The frame slot that this command list is recorded for
+         */
+        virtual void bind_compute_resources(RhiResourceBinder& binder, uint32_t frame_idx) = 0;
+
+        /*!
+         * \brief Records a dispatch of the current compute pipeline
+         *
+         * \param num_groups_x The number of thread groups to dispatch in the X direction
+         * \param num_groups_y The number of thread groups to dispatch in the Y direction
+         * \param num_groups_z The number of thread groups to dispatch in the Z direction
+         */
+        virtual void dispatch(uint32_t num_groups_x, uint32_t num_groups_y = 1, uint32_t num_groups_z = 1) = 0;
+
+        /*!
+         * \brief Records a dispatch of the current compute pipeline, reading the number of thread groups from a buffer
+         *
+         * Lets one compute pass decide how much work the next one does, without a round trip to the CPU
+         *
+         * \param dispatch_buffer A buffer with a `RhiDispatchIndirectCommand` in it. Must have been created with the DeviceStorageBuffer
+         * usage
+         * \param offset Offset of the command in `dispatch_buffer`, in bytes. Must be a multiple of four
          */
-        virtual void draw_indexed_mesh(uint32_t num_indices, uint32_t offset = 0, uint32_t num_instances = 1) = 0;
+        virtual void dispatch_indirect(const RhiBuffer* dispatch_buffer, uint64_t offset = 0) = 0;
 
         virtual void set_scissor_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height) = 0;
 
+        /*!
+         * \brief Renders to only part of the current framebuffer, by setting both the viewport and the scissor rect
+         *
+         * Beginning a renderpass resets both to the whole framebuffer
+         */
+        virtual void set_viewport(uint32_t x, uint32_t y, uint32_t width, uint32_t height) = 0;
+
+        /*!
+         * \brief Records a command to write the GPU's clock to a timestamp once all the previous commands have finished the provided stage
+         *
+         * \param pool The pool the timestamp is in. The timestamp must have been reset since it was last written
+         * \param timestamp_idx Index of the timestamp in `pool`
+         * \param stage The pipeline stage to wait for. Must be a single stage
+         */
+        virtual void write_timestamp(RhiQueryPool* pool, uint32_t timestamp_idx, PipelineStage stage) = 0;
+
+        /*!
+         * \brief Starts counting pipeline statistics or passing samples into a query, depending on the kind of pool it's in
+         *
+         * Only graphics command lists can run queries. Secondary command lists that are executed while a pipeline statistics query is
+         * active count into it too. Occlusion queries only count the draws in the command list that began them, and must begin and end
+         * in the same subpass
+         *
+         * \param pool A pool from `RenderDevice::create_pipeline_statistics_query_pool` or `RenderDevice::create_occlusion_query_pool`.
+         * The query must have been reset since it was last used
+         * \param query_idx Index of the query in `pool`
+         */
+        virtual void begin_query(RhiQueryPool* pool, uint32_t query_idx) = 0;
+
+        /*!
+         * \brief Stops counting into a query that `begin_query` started in this command list
+         */
+        virtual void end_query(RhiQueryPool* pool, uint32_t query_idx) = 0;
+
+        /*!
+         * \brief Gets what's been recorded into this command list since it was begun, including the secondary command lists it executes
+         */
+        [[nodiscard]] virtual const RhiCommandListStats& get_stats() const = 0;
+
         virtual ~RhiRenderCommandList() = default;
     };
 } // namespace nova::renderer::rhi
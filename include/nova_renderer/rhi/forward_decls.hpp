@@ -19,6 +19,7 @@ namespace nova::renderer {
         struct RhiSampler;
         struct RhiPresentSemaphore;
         struct RhiDescriptorPool;
+        struct RhiQueryPool;
 
         class Swapchain;
         class RhiRenderCommandList;
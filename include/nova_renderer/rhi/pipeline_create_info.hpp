@@ -11,6 +11,21 @@
  */
 
 namespace nova::renderer {
+    /*!
+     * \brief The value of one of a shader's specialization constants
+     */
+    struct SpecializationConstant {
+        /*!
+         * \brief The constant's `constant_id` in the shader
+         */
+        uint32_t constant_id = 0;
+
+        /*!
+         * \brief The constant's bits. Bools are 0 or 1, and floats are their IEEE 754 bits
+         */
+        uint32_t value = 0;
+    };
+
     /*!
      * \brief SPIR-V shader source
      */
@@ -24,6 +39,11 @@ namespace nova::renderer {
          * \brief SPIR-V shader code
          */
         std::vector<uint32_t> source{};
+
+        /*!
+         * \brief Values for the shader's specialization constants. Constants that aren't in here keep the default from the shader
+         */
+        std::vector<SpecializationConstant> specialization_constants{};
     };
 
     enum class PrimitiveTopology {
@@ -427,4 +447,21 @@ namespace nova::renderer {
          */
         std::optional<renderpack::TextureAttachmentInfo> depth_texture{};
     };
+
+    /*!
+     * \brief All the information needed to create a compute pipeline
+     *
+     * Compute pipelines don't depend on a renderpass, so unlike graphics pipelines they're compiled as soon as they're created
+     */
+    struct RhiComputePipelineState {
+        /*!
+         * \brief Name of this pipeline state
+         */
+        std::string name{};
+
+        /*!
+         * \brief Compute shader to use
+         */
+        ShaderSource compute_shader{};
+    };
 } // namespace nova::renderer
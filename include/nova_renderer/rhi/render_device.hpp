@@ -1,5 +1,9 @@
 #pragma once
 
+#include <functional>
+#include <span>
+#include <unordered_set>
+
 #include "nova_renderer/nova_settings.hpp"
 #include "nova_renderer/renderpack_data.hpp"
 #include "nova_renderer/rhi/command_list.hpp"
@@ -12,6 +16,7 @@
 namespace nova::renderer {
     struct FrameContext;
     struct RhiGraphicsPipelineState;
+    struct RhiComputePipelineState;
     struct DeviceMemoryResource;
 } // namespace nova::renderer
 
@@ -49,8 +54,88 @@ namespace nova::renderer::rhi {
 
         bool is_uma = false;
 
+        /*!
+         * \brief Whether the CPU can write to a decent amount of device-local memory, either because the device shares memory with the
+         * host or because it exposes all of its memory to the host (resizable BAR)
+         *
+         * When this is true, vertex and index buffers are put in host-visible memory when there's room, so uploads can write to them
+         * directly. Buffers created with `BufferUsage::HostVisibleMeshBuffer` are also fast for the GPU to read
+         */
+        bool has_host_visible_device_memory = false;
+
         bool supports_raytracing = false;
         bool supports_mesh_shaders = false;
+
+        /*!
+         * \brief Whether `QueueType::AsyncCompute` is a separate queue that can run alongside the graphics queue
+         *
+         * When it isn't, submitting to the async compute queue still works, but it's the graphics queue under the hood
+         */
+        bool has_async_compute_queue = false;
+
+        /*!
+         * \brief The offset of a uniform or storage buffer binding must be a multiple of this
+         */
+        mem::Bytes min_buffer_offset_alignment = 256;
+
+        /*!
+         * \brief The number of nanoseconds between two ticks of a GPU timestamp. Zero if the device can't write timestamps on all of its
+         * graphics and compute queues
+         */
+        float timestamp_period = 0;
+
+        /*!
+         * \brief Whether the device can count pipeline statistics, including in secondary command lists that are executed while a query
+         * is active
+         */
+        bool supports_pipeline_statistics = false;
+
+        /*!
+         * \brief Whether compute shaders can use the quad wave intrinsics, like `QuadReadAcrossX`. Compute quads are lanes `4n` through
+         * `4n + 3` of a wave
+         */
+        bool supports_compute_quad_operations = false;
+
+        /*!
+         * \brief Whether renderpasses can shade at a fixed rate coarser than one invocation per pixel
+         */
+        bool supports_variable_rate_shading = false;
+
+        /*!
+         * \brief How many pixels wide and tall each texel of a shading rate image covers, or zero if renderpasses can't read their
+         * shading rate from an image
+         */
+        uint32_t shading_rate_image_texel_size = 0;
+    };
+
+    /*!
+     * \brief One command list in a batch for `RenderDevice::submit_command_lists`
+     */
+    struct RhiSubmission {
+        RhiRenderCommandList* cmds = nullptr;
+
+        QueueType queue = QueueType::Graphics;
+
+        /*!
+         * \brief Semaphores from outside the batch to wait on before the command list starts, such as the swapchain's
+         */
+        std::span<RhiSemaphore* const> wait_semaphores;
+
+        /*!
+         * \brief Semaphores to signal when the command list finishes, for things outside the batch like presenting
+         */
+        std::span<RhiSemaphore* const> signal_semaphores;
+
+        /*!
+         * \brief Indices of earlier submissions in the same batch that have to finish before this one starts. These don't need
+         * semaphores of their own
+         */
+        std::span<const uint32_t> submissions_to_wait_for;
+
+        /*!
+         * \brief Runs during the first `end_frame` after the GPU finishes the command list, like `submit_command_list`'s `on_completion`
+         */
+        std::function<void()> on_completion;
     };
 
 #define NUM_THREADS 1
@@ -92,9 +177,35 @@ namespace nova::renderer::rhi {
         [[nodiscard]] virtual ntl::Result<RhiRenderpass*> create_renderpass(const renderpack::RenderPassCreateInfo& data,
                                                                             const glm::uvec2& framebuffer_size) = 0;
 
+        /*!
+         * \brief Creates one renderpass with a subpass for each of the provided passes, in order
+         *
+         * The renderpass's attachments are the color outputs of all the subpasses, in the order they first show up, then the depth
+         * texture. Subpasses with a depth texture must all use the same one. Each subpass reads its `input_attachments` from what the
+         * earlier subpasses wrote to them, with by-region dependencies instead of barriers, so tile-based GPUs never have to write them
+         * out to memory in between. Render targets are in the layouts they rest in before and after the renderpass
+         *
+         * \param subpasses The passes to merge. Each pass's color outputs are its subpass's color attachments, in the same order
+         * \param transient_attachments The attachments that nothing outside of this renderpass uses, and whose first use clears them.
+         * Their contents are never stored
+         * \param framebuffer_size The size in pixels of the framebuffer that the renderpass will write to
+         */
+        [[nodiscard]] virtual ntl::Result<RhiRenderpass*> create_merged_renderpass(
+            const std::vector<renderpack::RenderPassCreateInfo>& subpasses,
+            const std::unordered_set<std::string>& transient_attachments,
+            const glm::uvec2& framebuffer_size) = 0;
+
+        /*!
+         * \brief Creates a framebuffer for a renderpass
+         *
+         * \param shading_rate_attachment The image that the renderpass reads its shading rate from. Only renderpasses that were created
+         * with `RenderPassCreateInfo::uses_adaptive_shading_rate`, on a device with a `DeviceInfo::shading_rate_image_texel_size`, may
+         * have one
+         */
         [[nodiscard]] virtual RhiFramebuffer* create_framebuffer(const RhiRenderpass* renderpass,
                                                                  const std::vector<RhiImage*>& color_attachments,
                                                                  const std::optional<RhiImage*> depth_attachment,
+                                                                 const std::optional<RhiImage*> shading_rate_attachment,
                                                                  const glm::uvec2& framebuffer_size) = 0;
 
         /*!
@@ -114,6 +225,30 @@ namespace nova::renderer::rhi {
          */
         [[nodiscard]] virtual std::unique_ptr<RhiPipeline> create_global_pipeline(const RhiGraphicsPipelineState& pipeline_state) = 0;
 
+        /*!
+         * \brief Creates and compiles a compute pipeline
+         *
+         * Compute pipelines get a pipeline layout from reflecting over their shader, the same as global pipelines
+         *
+         * \return The new pipeline, or nullptr if it couldn't be compiled
+         */
+        [[nodiscard]] virtual std::unique_ptr<RhiPipeline> create_compute_pipeline(const RhiComputePipelineState& pipeline_state) = 0;
+
+        /*!
+         * \brief Compiles a pipeline for a specific renderpass ahead of time, so that the first command list to use it doesn't have to
+         *
+         * Pipelines that aren't compiled ahead of time get compiled the first time they're bound. That works, but it can take long enough
+         * to cause a hitch
+         *
+         * This may be called from any thread, but each pipeline must only be compiled by one thread at a time, and it must not be bound
+         * until compilation finishes
+         *
+         * \param subpass The subpass of `renderpass` that the pipeline is used in
+         *
+         * \return True if the pipeline compiled, false if it didn't
+         */
+        [[nodiscard]] virtual bool compile_pipeline(RhiPipeline& pipeline, const RhiRenderpass& renderpass, uint32_t subpass) = 0;
+
         [[nodiscard]] virtual std::unique_ptr<RhiResourceBinder> create_resource_binder_for_pipeline(const RhiPipeline& pipeline) = 0;
 
         /*!
@@ -124,8 +259,8 @@ namespace nova::renderer::rhi {
         /*!
          * \brief Writes data to a buffer
          *
-         * This method always writes the data from byte 0 to byte num_bytes. It does not let you use an offset for either reading from
-         * the data or writing to the buffer
+         * This method always writes the data from byte 0 to byte num_bytes. Use the overload that takes an offset to write somewhere else
+         * in the buffer
          *
          * The CPU must be able to write directly to the buffer for this method to work. If the buffer is device local, this method will
          * fail in a horrible way
@@ -136,11 +271,90 @@ namespace nova::renderer::rhi {
          */
         virtual void write_data_to_buffer(const void* data, mem::Bytes num_bytes, const RhiBuffer* buffer) = 0;
 
+        /*!
+         * \brief Writes data to a buffer, starting `offset` bytes into the buffer
+         *
+         * Like the other overload, the CPU must be able to write directly to the buffer
+         *
+         * \param data The data to upload
+         * \param num_bytes The number of bytes to write
+         * \param offset Where in the buffer to start writing
+         * \param buffer The buffer to write to
+         */
+        virtual void write_data_to_buffer(const void* data, mem::Bytes num_bytes, mem::Bytes offset, const RhiBuffer* buffer) = 0;
+
+        /*!
+         * \brief Gets a pointer to a CPU-writable buffer's memory, so you can write to it without copying the data somewhere else first
+         *
+         * The pointer stays valid until the buffer is destroyed. Returns nullptr if the buffer isn't mapped
+         */
+        [[nodiscard]] virtual void* get_mapped_data(const RhiBuffer* buffer) = 0;
+
+        /*!
+         * \brief Makes the CPU's writes to part of a buffer visible to the GPU
+         *
+         * Only needed when the buffer was written through `get_mapped_data` and its memory isn't host-coherent. It's a no-op in that case,
+         * so call it anyway
+         */
+        virtual void flush_buffer(const RhiBuffer* buffer, mem::Bytes offset, mem::Bytes num_bytes) = 0;
+
+        /*!
+         * \brief Makes the GPU's writes to part of a buffer visible to the CPU
+         *
+         * The opposite of `flush_buffer`. Call it before reading a mapped buffer that the GPU wrote to, after the GPU is done writing
+         */
+        virtual void invalidate_buffer(const RhiBuffer* buffer, mem::Bytes offset, mem::Bytes num_bytes) = 0;
+
+        /*!
+         * \brief Gets the usage and budget of each of the device's memory heaps
+         *
+         * The budget is refreshed in `begin_frame`, so there's no point in calling this more than once per frame
+         */
+        [[nodiscard]] virtual std::vector<RhiMemoryHeapBudget> get_memory_budgets() = 0;
+
+        /*!
+         * \brief Gets how full each of the device's memory pools is
+         *
+         * Buffers and sampled textures are allocated from a pool for their class of resource, such as mesh geometry or uploads, so
+         * that churn in one class can't fragment another's memory. Devices without pools return nothing
+         */
+        [[nodiscard]] virtual std::vector<RhiMemoryPoolStats> get_memory_pool_stats() = 0;
+
+        /*!
+         * \brief Gets how much memory the device's live resources take up, by category and by owner, along with the peaks of each
+         *
+         * Every buffer and image that the device makes is counted, by the size of the memory that was actually allocated for it. Images
+         * that alias each other are counted once, under the first of them. Devices that don't allocate real memory return nothing
+         */
+        [[nodiscard]] virtual RhiMemoryAccounting get_memory_accounting() = 0;
+
+        /*!
+         * \brief Records copies that move some buffers and sampled textures closer together in their memory pools
+         *
+         * Moved resources keep their `RhiBuffer` and `RhiImage` handles, and the standard descriptor set picks up the moved textures by
+         * itself. Call this on the frame's first graphics command list, after its uploads and before anything else is recorded that uses
+         * the resources. Devices without memory pools don't move anything
+         *
+         * \param max_moves The most resources to move
+         * \param max_bytes The most bytes to copy
+         *
+         * \return Whether anything will be moved
+         */
+        virtual bool record_defragmentation(RhiRenderCommandList& cmds, uint32_t max_moves, mem::Bytes max_bytes) = 0;
+
         /*!
          * \brief Creates a new Sampler object
          */
         [[nodiscard]] virtual RhiSampler* create_sampler(const RhiSamplerCreateInfo& create_info) = 0;
 
+        /*!
+         * \brief Checks if the device can render to a color format and sample from it, with blending
+         *
+         * Every device supports the formats that renderpacks could always ask for. This is for the compact formats, which not every
+         * GPU can render to
+         */
+        [[nodiscard]] virtual bool supports_render_target_format(PixelFormat format) = 0;
+
         /*!
          * \brief Creates an empty image
          *
@@ -148,6 +362,18 @@ namespace nova::renderer::rhi {
          */
         [[nodiscard]] virtual RhiImage* create_image(const renderpack::TextureCreateInfo& info) = 0;
 
+        /*!
+         * \brief Creates a group of images that all live in the same memory
+         *
+         * Writing to one of the images clobbers the others, so only use this for images that are never in use at the same time. Every
+         * time you switch which image is in use, transition the new one from the Undefined layout - its old contents are gone
+         *
+         * The memory is freed when the last of the images is destroyed with `destroy_texture`
+         *
+         * \return The images, in the same order as `infos`, or an empty vector if the images can't share memory
+         */
+        [[nodiscard]] virtual std::vector<RhiImage*> create_aliased_images(const std::vector<renderpack::TextureCreateInfo>& infos) = 0;
+
         [[nodiscard]] virtual RhiSemaphore* create_semaphore() = 0;
 
         [[nodiscard]] virtual std::vector<RhiSemaphore*> create_semaphores(uint32_t num_semaphores) = 0;
@@ -163,9 +389,64 @@ namespace nova::renderer::rhi {
          *
          * \param fences All the fences to wait for
          */
-        virtual void wait_for_fences(std::vector<RhiFence*> fences) = 0;
+        virtual void wait_for_fences(std::span<RhiFence* const> fences) = 0;
+
+        virtual void reset_fences(std::span<RhiFence* const> fences) = 0;
+
+        /*!
+         * \brief Creates a pool of timestamps that command lists can write to. The timestamps start out reset
+         */
+        [[nodiscard]] virtual RhiQueryPool* create_timestamp_query_pool(uint32_t num_timestamps) = 0;
 
-        virtual void reset_fences(const std::vector<RhiFence*>& fences) = 0;
+        /*!
+         * \brief Creates a pool of queries that count the primitives and shader invocations between `begin_query` and `end_query`. The
+         * queries start out reset
+         *
+         * Only call this if `DeviceInfo::supports_pipeline_statistics` is true
+         */
+        [[nodiscard]] virtual RhiQueryPool* create_pipeline_statistics_query_pool(uint32_t num_queries) = 0;
+
+        /*!
+         * \brief Creates a pool of queries that count the samples which pass the depth test between `begin_query` and `end_query`. The
+         * queries start out reset
+         */
+        [[nodiscard]] virtual RhiQueryPool* create_occlusion_query_pool(uint32_t num_queries) = 0;
+
+        /*!
+         * \brief Resets some of the timestamps or queries in a pool from the CPU, so command lists can write to them again
+         *
+         * The GPU must be done with them
+         */
+        virtual void reset_queries(RhiQueryPool* pool, uint32_t first_query, uint32_t num_queries) = 0;
+
+        /*!
+         * \brief Reads some timestamps back, in ticks of `DeviceInfo::timestamp_period` nanoseconds
+         *
+         * Doesn't wait for the GPU. Returns false, and leaves `timestamps` alone, if the GPU hasn't written all of them yet
+         */
+        [[nodiscard]] virtual bool get_timestamps(RhiQueryPool* pool,
+                                                  uint32_t first_timestamp,
+                                                  uint32_t num_timestamps,
+                                                  std::vector<uint64_t>& timestamps) = 0;
+
+        /*!
+         * \brief Reads some pipeline statistics queries back. Like `get_timestamps`, this doesn't wait for the GPU
+         */
+        [[nodiscard]] virtual bool get_pipeline_statistics(RhiQueryPool* pool,
+                                                           uint32_t first_query,
+                                                           uint32_t num_queries,
+                                                           std::vector<RhiPipelineStatistics>& statistics) = 0;
+
+        /*!
+         * \brief Reads some occlusion queries back, as the number of samples that passed. Like `get_timestamps`, this doesn't wait for
+         * the GPU
+         */
+        [[nodiscard]] virtual bool get_occlusion_query_results(RhiQueryPool* pool,
+                                                               uint32_t first_query,
+                                                               uint32_t num_queries,
+                                                               std::vector<uint64_t>& samples_passed) = 0;
+
+        virtual void destroy_query_pool(RhiQueryPool* pool) = 0;
 
         /*!
          * \brief Clean up any GPU objects a Renderpass may own
@@ -191,6 +472,13 @@ namespace nova::renderer::rhi {
          */
         virtual void destroy_texture(RhiImage* resource) = 0;
 
+        /*!
+         * \brief Destroys a buffer and frees its memory
+         *
+         * The GPU must be done with the buffer. Nothing waits for it to be
+         */
+        virtual void destroy_buffer(RhiBuffer* buffer) = 0;
+
         /*!
          * \brief Clean up any GPU objects a Semaphores may own
          *
@@ -209,6 +497,37 @@ namespace nova::renderer::rhi {
 
         [[nodiscard]] Swapchain* get_swapchain() const;
 
+        /*!
+         * \brief Recreates the swapchain at the window's current framebuffer size
+         *
+         * Waits for the GPU to finish everything it's doing first, so only call this when the swapchain needs it: when the window was
+         * resized, or when `Swapchain::needs_recreation` says so. The swapchain object itself stays the same, but all its images and
+         * framebuffers are new
+         */
+        virtual void recreate_swapchain() = 0;
+
+        /*!
+         * \brief Creates a swapchain that presents to another window, so that one frame can be shown in more than one window
+         *
+         * The swapchain asks for as many images as the device's own swapchain. Destroy it with `destroy_window_swapchain` before its window
+         * is closed
+         *
+         * \return The new swapchain, or nullptr if the device can't present to the window
+         */
+        [[nodiscard]] virtual Swapchain* create_window_swapchain(NovaWindow& output_window) = 0;
+
+        /*!
+         * \brief Recreates a swapchain from `create_window_swapchain` at its window's current framebuffer size
+         *
+         * Like `recreate_swapchain`, this waits for the GPU to finish everything it's doing first
+         */
+        virtual void recreate_window_swapchain(Swapchain& output_swapchain, const NovaWindow& output_window) = 0;
+
+        /*!
+         * \brief Destroys a swapchain from `create_window_swapchain`. The GPU must be done with all its images
+         */
+        virtual void destroy_window_swapchain(Swapchain* output_swapchain) = 0;
+
         /*!
          * \brief Allocates a new command list that can be used from the provided thread and has the desired type
          *
@@ -216,9 +535,9 @@ namespace nova::renderer::rhi {
          * to a queue. Submitting it gives ownership back to the render engine, and recording commands into a
          * submitted command list is not supported
          *
-         * There is one command list pool per swapchain image per thread. All the pools for one swapchain image are
-         * reset at the beginning of a frame that renders to that swapchain image. This means that any command list
-         * allocated in one frame will not be valid in the next frame. DO NOT hold on to command lists
+         * There is one command list pool per frame slot per thread. All the pools for one frame slot are reset in `begin_frame`, once
+         * the GPU has finished every command list that came from them. This means that any command list allocated in one frame will not
+         * be valid in the next frame. DO NOT hold on to command lists
          *
          * Command lists allocated by this method are returned ready to record commands into - the caller doesn't need
          * to begin the command list
@@ -227,17 +546,141 @@ namespace nova::renderer::rhi {
                                                           QueueType needed_queue_type,
                                                           RhiRenderCommandList::Level level) = 0;
 
+        /*!
+         * \brief Allocates a secondary command list that records the contents of a single renderpass
+         *
+         * The returned command list is already begun inside the provided renderpass, so it may bind pipelines and issue draws, but it may
+         * not begin or end renderpasses itself. Execute it with `execute_command_lists` from a primary command list which has begun the
+         * same renderpass with `RenderpassContents::SecondaryCommandLists`
+         *
+         * Like `create_command_list`, you must use the index of the thread you're recording on. Each thread has its own command pools, so
+         * any number of threads may call this method at once as long as they use different thread indices
+         *
+         * \param thread_idx Index of the thread that will record into the command list
+         * \param renderpass The renderpass the commands will execute in
+         * \param framebuffer The framebuffer the renderpass will render to, or nullptr if it isn't known yet
+         * \param subpass The subpass of `renderpass` that the commands will execute in
+         */
+        virtual RhiRenderCommandList* create_secondary_command_list(uint32_t thread_idx,
+                                                                    RhiRenderpass* renderpass,
+                                                                    const RhiFramebuffer* framebuffer,
+                                                                    uint32_t subpass) = 0;
+
+        /*!
+         * \brief Allocates a secondary command list that can be executed in any number of frames, until it's destroyed
+         *
+         * It's begun just like the lists from `create_secondary_command_list`, but it doesn't come from a frame's command pools, so it
+         * isn't recycled when the frame ends. Any thread may call this at any time. End it by executing it with
+         * `execute_command_lists`, then don't record anything more into it
+         *
+         * \param renderpass The renderpass the commands will execute in
+         * \param framebuffer The framebuffer the renderpass will render to. Unlike secondary command lists, it has to be known
+         * \param subpass The subpass of `renderpass` that the commands will execute in
+         */
+        virtual RhiRenderCommandList* create_reusable_command_list(RhiRenderpass* renderpass,
+                                                                   const RhiFramebuffer* framebuffer,
+                                                                   uint32_t subpass) = 0;
+
+        /*!
+         * \brief Destroys a command list from `create_reusable_command_list`, once the GPU has finished every frame that executed it
+         */
+        virtual void destroy_reusable_command_list(RhiRenderCommandList* cmds) = 0;
+
+        /*!
+         * \brief Submits a command list to a queue
+         *
+         * \param cmds The command list to submit. Ownership goes back to the device
+         * \param queue The queue to submit to
+         * \param fence_to_signal A fence to signal when the GPU finishes the command list, or nullptr if you don't need to wait for it
+         * \param wait_semaphores Semaphores that the command list waits on before it starts
+         * \param signal_semaphores Semaphores to signal when the command list finishes
+         * \param on_completion Runs during the first `end_frame` after the GPU finishes the command list. Use this to recycle anything
+         * that the command list used, without waiting for it
+         */
         virtual void submit_command_list(RhiRenderCommandList* cmds,
                                          QueueType queue,
                                          RhiFence* fence_to_signal = nullptr,
-                                         const std::vector<RhiSemaphore*>& wait_semaphores = {},
-                                         const std::vector<RhiSemaphore*>& signal_semaphores = {}) = 0;
+                                         std::span<RhiSemaphore* const> wait_semaphores = {},
+                                         std::span<RhiSemaphore* const> signal_semaphores = {},
+                                         std::function<void()> on_completion = {}) = 0;
+
+        /*!
+         * \brief Submits a whole frame's worth of command lists at once, with one submission call per queue
+         *
+         * The submissions can be on any queues, and each one can wait for any of the ones before it. They're synchronized with the
+         * queues' timeline semaphores, so a batch of any size only needs the semaphores that things outside the batch wait on. Each queue
+         * gets its command lists in the order they're in `submissions`
+         *
+         * \param submissions The command lists to submit. Ownership of each goes back to the device
+         * \param fence_to_signal A fence to signal when the last submission finishes, or nullptr if you don't need to wait for it
+         */
+        virtual void submit_command_lists(std::span<const RhiSubmission> submissions, RhiFence* fence_to_signal = nullptr) = 0;
+
+        /*!
+         * \brief Points a frame slot's standard descriptor set at the resources that the frame renders with
+         *
+         * Every frame slot keeps one standard descriptor set for as long as the device lives. This method only writes the descriptors that
+         * changed since the slot was last updated, so a frame where no textures were added or finished uploading writes nothing. Each
+         * texture's descriptor lives at its index in `textures`, which is how shaders find it
+         *
+         * Call this once per frame, after the frame slot's fence has signaled and before recording anything that calls
+         * `RhiRenderCommandList::bind_material_resources`
+         *
+         * \param model_matrix_buffer Buffer with the model matrices of every instance drawn this frame. Must be a storage buffer
+         * \param vertex_layouts Storage buffer with the pulled vertex layout of every instance drawn this frame, in the same order as the
+         * model matrices
+         * \param virtual_page_table Storage buffer that says where each virtual texture page is in `virtual_texture_cache`
+         * \param virtual_texture_feedback Storage buffer that shaders write the virtual texture pages they wanted to
+         * \param virtual_texture_cache The image that holds the resident virtual texture pages
+         * \param light_cluster_params Storage buffer that describes the light cluster grid
+         * \param lights Storage buffer with every light in the scene
+         * \param light_clusters Storage buffer with where each light cluster's lights are in `light_indices`
+         * \param light_indices Storage buffer with the indices of the lights that touch each light cluster
+         * \param particles Storage buffer with the particles of every particle emitter, as they are after this frame's simulation
+         * \param volumetric_fog 3D image with how much fog there is between the main camera and each froxel
+         * \param vertex_buffers The mesh arena's vertex buffers, which shaders that pull their own vertices read from. Only the first
+         * `MAX_NUM_VERTEX_BUFFERS` are bound
+         */
+        virtual void update_standard_descriptors(uint32_t frame_idx,
+                                                 RhiBuffer* camera_buffer,
+                                                 RhiBuffer* material_buffer,
+                                                 RhiBuffer* model_matrix_buffer,
+                                                 RhiBuffer* vertex_layouts,
+                                                 RhiSampler* point_sampler,
+                                                 RhiSampler* bilinear_sampler,
+                                                 RhiSampler* trilinear_sampler,
+                                                 RhiBuffer* virtual_page_table,
+                                                 RhiBuffer* virtual_texture_feedback,
+                                                 RhiImage* virtual_texture_cache,
+                                                 RhiBuffer* light_cluster_params,
+                                                 RhiBuffer* lights,
+                                                 RhiBuffer* light_clusters,
+                                                 RhiBuffer* light_indices,
+                                                 RhiBuffer* particles,
+                                                 RhiImage* volumetric_fog,
+                                                 std::span<RhiBuffer* const> vertex_buffers,
+                                                 std::span<RhiImage* const> textures) = 0;
+
+        /*!
+         * \brief Recycles everything that the frame slot's previous frame allocated, such as its command lists
+         *
+         * Call this once per frame, after the frame slot's fence has signaled and before creating any command lists for the frame
+         */
+        virtual void begin_frame(uint32_t frame_idx) = 0;
 
         /*!
          * \brief Performs any work that's needed to end the provided frame
          */
         virtual void end_frame(FrameContext& ctx) = 0;
 
+        /*!
+         * \brief Writes the device's pipeline cache to disk, so that the next run doesn't have to recompile the same pipelines
+         *
+         * The device saves its pipeline cache when it's destroyed. You only need to call this if you want to save it sooner, such as right
+         * after loading a renderpack
+         */
+        virtual void save_pipeline_cache() = 0;
+
     protected:
         NovaWindow& window;
 
@@ -261,8 +704,8 @@ namespace nova::renderer::rhi {
     /*!
      * \brief Creates a new API-agnostic render device
      *
-     * Right now we only support creating Vulkan render devices, but in the future we might support devices for different APIs, or different
-     * types of hardware
+     * Right now that's a Vulkan render device, or the null render device if `NovaSettings::null_device` is enabled. In the future we might
+     * support devices for different APIs, or different types of hardware
      */
     std::unique_ptr<RenderDevice> create_render_device(NovaSettingsAccessManager& settings, NovaWindow& window);
 } // namespace nova::renderer::rhi
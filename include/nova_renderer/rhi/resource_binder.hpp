@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -20,6 +21,12 @@ namespace nova::renderer {
 
         virtual void bind_buffer(const std::string& binding_name, rhi::RhiBuffer* buffer) = 0;
 
+        /*!
+         * \brief Binds `num_bytes` of a buffer, starting `offset` bytes in. `offset` must be a multiple of
+         * `DeviceInfo::min_buffer_offset_alignment`
+         */
+        virtual void bind_buffer_range(const std::string& binding_name, rhi::RhiBuffer* buffer, uint64_t offset, uint64_t num_bytes) = 0;
+
         virtual void bind_sampler(const std::string& binding_name, rhi::RhiSampler* sampler) = 0;
 
         virtual void bind_image_array(const std::string& binding_name, const std::vector<rhi::RhiImage*>& images) = 0;
@@ -27,5 +34,13 @@ namespace nova::renderer {
         virtual void bind_buffer_array(const std::string& binding_name, const std::vector<rhi::RhiBuffer*>& buffers) = 0;
 
         virtual void bind_sampler_array(const std::string& binding_name, const std::vector<rhi::RhiSampler*>& samplers) = 0;
+
+        /*!
+         * \brief Binds each mip of an image to its own element of an array binding, starting with `first_mip` at element 0
+         *
+         * This is how one dispatch writes a whole mip chain, like `RWTexture2D<float2> mips[12]`. Elements past the image's last mip get
+         * its last mip, so the shader must not write to them
+         */
+        virtual void bind_image_mips(const std::string& binding_name, rhi::RhiImage* image, uint32_t first_mip = 0) = 0;
     };
 } // namespace nova::renderer
@@ -21,8 +21,46 @@ namespace nova::renderer::rhi {
         Rgba8,
         Rgba16F,
         Rgba32F,
+
+        /*!
+         * \brief Two 32-bit floats, like the min and max depth of each texel of a depth pyramid
+         */
+        Rg32F,
+
+        /*!
+         * \brief One unsigned integer per texel, like the fragment size of each tile of a shading rate image
+         */
+        R8Uint,
+
+        // Compact render target formats, for the precision tiers of `TextureFormat::precision`
+
+        /*!
+         * \brief Unsigned 11-bit floats for red and green and a 10-bit float for blue, and no alpha. Half the size of RGBA16F, for HDR
+         * color that's never negative
+         */
+        Rg11B10F,
+
+        /*!
+         * \brief 10 bits each of red, green, and blue, and two bits of alpha, all between zero and one
+         */
+        Rgb10A2,
+
+        Rg16F,
+
+        /*!
+         * \brief Two 16-bit values between negative one and one
+         */
+        Rg16Snorm,
+
         Depth32,
         Depth24Stencil8,
+
+        // Block-compressed formats. Each 4x4 block of pixels is stored together, so the CPU can't write them one pixel at a time
+        Bc1,
+        Bc3,
+        Bc5,
+        Bc7,
+        Astc4x4,
     };
 
     enum class TextureUsage {
@@ -37,11 +75,31 @@ namespace nova::renderer::rhi {
         Float3,
         Float4,
 
+        // Compact formats. The shader sees all of these as floats
+        Unorm16x2,
+        Unorm16x4,
+        Snorm16x2,
+        Snorm16x4,
+        Half2,
+        Half4,
+
         // MUST always be last
         Invalid,
     };
 
-    enum class DescriptorType { CombinedImageSampler, UniformBuffer, StorageBuffer, Texture, Sampler };
+    enum class DescriptorType {
+        CombinedImageSampler,
+        UniformBuffer,
+        StorageBuffer,
+        Texture,
+        Sampler,
+        StorageImage,
+
+        /*!
+         * \brief A render target that the pixel shader reads at its own pixel, from an earlier subpass of the same renderpass
+         */
+        InputAttachment,
+    };
 
     enum class ResourceAccess {
         IndirectCommandRead,
@@ -91,6 +149,11 @@ namespace nova::renderer::rhi {
         DepthWrite,
         DepthRead,
 
+        /*!
+         * \brief Read by the rasterizer to pick the fragment size of each tile of a renderpass
+         */
+        ShadingRateSource,
+
         PresentSource,
     };
 
@@ -148,6 +211,19 @@ namespace nova::renderer::rhi {
         Mesh = 0x0080,
     };
 
+    /*!
+     * \brief How many pixels each invocation of a pixel shader covers, as width x height
+     */
+    enum class ShadingRate {
+        Rate1x1,
+        Rate1x2,
+        Rate2x1,
+        Rate2x2,
+        Rate2x4,
+        Rate4x2,
+        Rate4x4,
+    };
+
     enum class QueueType {
         Graphics,
         Transfer,
@@ -158,6 +234,42 @@ namespace nova::renderer::rhi {
         IndexBuffer,
         VertexBuffer,
         StagingBuffer,
+
+        /*!
+         * \brief A buffer that the CPU writes to and shaders read from, like a uniform buffer, but which is always bound as a storage
+         * buffer no matter how large it is
+         */
+        StorageBuffer,
+
+        /*!
+         * \brief A storage buffer that lives in device-local memory, for data that only shaders write to. It may also hold the arguments of
+         * indirect draws and dispatches
+         */
+        DeviceStorageBuffer,
+
+        /*!
+         * \brief A persistently mapped buffer that the CPU writes fresh data to every frame. It can back uniform and storage buffer
+         * bindings at any offset that's a multiple of `DeviceInfo::min_buffer_offset_alignment`, and be the source of buffer-to-image
+         * copies
+         */
+        UploadBuffer,
+
+        /*!
+         * \brief A persistently mapped buffer that can be used as a vertex buffer or an index buffer, for meshes that the CPU writes to
+         * directly. Only lives in device-local memory when `DeviceInfo::has_host_visible_device_memory` is true
+         */
+        HostVisibleMeshBuffer,
+
+        /*!
+         * \brief A persistently mapped storage buffer that shaders write to and the CPU reads back, such as feedback about what a frame
+         * needed. Call `RenderDevice::invalidate_buffer` before reading it
+         */
+        ReadbackBuffer,
+
+        /*!
+         * \brief A device-local vertex buffer that compute shaders write the vertices of, such as skinned vertices
+         */
+        ComputeVertexBuffer,
     };
 
     enum class ResourceType {
@@ -179,9 +291,51 @@ namespace nova::renderer::rhi {
         MirrorClampToEdge,
     };
 
+    /*!
+     * \brief What some device memory is for, so that memory reports can say where it all went
+     */
+    enum class MemoryCategory {
+        Mesh,
+        Texture,
+        RenderTarget,
+
+        /*!
+         * \brief Buffers that data goes through on its way to or from the GPU, like staging and readback buffers
+         */
+        Staging,
+
+        /*!
+         * \brief Buffers that the CPU writes for shaders to read, like uniform, storage, and upload buffers
+         */
+        Uniform,
+
+        /*!
+         * \brief Device-local storage buffers that only shaders write to
+         */
+        Compute,
+
+        /*!
+         * \brief Descriptor pools. Vulkan doesn't say how much memory a pool takes, so these only count pools, not bytes
+         */
+        Descriptor,
+
+        Count,
+    };
+
+    constexpr auto NUM_MEMORY_CATEGORIES = static_cast<size_t>(MemoryCategory::Count);
+
     bool is_depth_format(PixelFormat format);
 
+    bool is_block_compressed_format(PixelFormat format);
+
     uint32_t get_byte_size(VertexFieldFormat format);
 
     std::string descriptor_type_to_string(DescriptorType type);
+
+    std::string memory_category_to_string(MemoryCategory category);
+
+    /*!
+     * \brief Gets the category of a buffer's memory from what the buffer is for
+     */
+    MemoryCategory get_memory_category(BufferUsage usage);
 } // namespace nova::renderer::rhi
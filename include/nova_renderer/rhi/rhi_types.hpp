@@ -16,6 +16,19 @@ namespace nova::renderer::rhi {
         mem::Bytes size = 0;
 
         BufferUsage buffer_usage{};
+
+        /*!
+         * \brief How much the buffer wants to stay in device memory when the device is short on it, from 0 to 1
+         *
+         * Only a hint. Drivers that support it move low-priority allocations out of device memory first
+         */
+        float residency_priority = 0.5f;
+
+        /*!
+         * \brief Who the buffer's memory belongs to in memory reports, like a renderpack or a subsystem. Buffers without an owner are
+         * their own
+         */
+        std::string owner;
     };
 
     struct RhiDeviceMemory {};
@@ -46,6 +59,8 @@ namespace nova::renderer::rhi {
 
         float min_lod = 0;
         float max_lod = 0;
+
+        bool operator==(const RhiSamplerCreateInfo& other) const = default;
     };
 
     struct RhiSampler {};
@@ -62,6 +77,210 @@ namespace nova::renderer::rhi {
         mem::Bytes size = 0;
     };
 
+    /*!
+     * \brief How much of one of the device's memory heaps we're using, and how much we can use before things start going wrong
+     */
+    struct RhiMemoryHeapBudget {
+        bool is_device_local = false;
+
+        /*!
+         * \brief Bytes of this heap that are allocated, by us or by anyone else
+         */
+        uint64_t usage = 0;
+
+        /*!
+         * \brief Bytes of this heap that we can allocate without going over the driver's estimate of what's available to us
+         */
+        uint64_t budget = 0;
+    };
+
+    /*!
+     * \brief How full one of the device's memory pools is
+     */
+    struct RhiMemoryPoolStats {
+        std::string name;
+
+        /*!
+         * \brief How many blocks of device memory the pool has allocated
+         */
+        uint32_t num_blocks = 0;
+
+        uint32_t num_allocations = 0;
+
+        /*!
+         * \brief Bytes of device memory that the pool's blocks take up
+         */
+        uint64_t reserved_bytes = 0;
+
+        /*!
+         * \brief Bytes of the pool's blocks that are allocated. The difference from `reserved_bytes` is free space, which may be
+         * fragmented
+         */
+        uint64_t used_bytes = 0;
+    };
+
+    /*!
+     * \brief How much device memory some of the device's resources take up
+     */
+    struct RhiMemoryAllocationStats {
+        MemoryCategory category = MemoryCategory::Mesh;
+
+        /*!
+         * \brief Who the resources belong to, like a renderpack or a subsystem. Empty in the totals of a whole category
+         */
+        std::string owner;
+
+        uint32_t num_allocations = 0;
+
+        uint64_t bytes = 0;
+
+        /*!
+         * \brief The most bytes that were live at once since the device was made
+         */
+        uint64_t peak_bytes = 0;
+    };
+
+    /*!
+     * \brief Where all of the device's memory went
+     */
+    struct RhiMemoryAccounting {
+        /*!
+         * \brief The totals of each category, in `MemoryCategory` order
+         */
+        std::vector<RhiMemoryAllocationStats> categories;
+
+        /*!
+         * \brief Each owner's share of each category that it's ever had memory in, sorted by category and then by owner. Owners whose
+         * resources were all destroyed stay in here with no bytes, so their peaks aren't lost
+         */
+        std::vector<RhiMemoryAllocationStats> owners;
+
+        /*!
+         * \brief Bytes of host memory that the driver allocated through Nova, for its own objects, and the most it ever had at once
+         */
+        uint64_t driver_host_bytes = 0;
+
+        uint64_t peak_driver_host_bytes = 0;
+    };
+
+    /*!
+     * \brief What a command list recorded, counted on the CPU as it was recorded
+     *
+     * Indirect draws are counted separately from direct ones, because the CPU doesn't know how many instances or triangles the GPU
+     * will draw for them. Use pipeline statistics queries to count those
+     */
+    struct RhiCommandListStats {
+        uint64_t draw_calls = 0;
+        uint64_t instances = 0;
+        uint64_t triangles = 0;
+
+        /*!
+         * \brief Indirect draw commands recorded, each of which may draw up to its maximum draw count
+         */
+        uint64_t indirect_draw_calls = 0;
+
+        uint64_t dispatches = 0;
+
+        /*!
+         * \brief Pipelines actually bound. Binding the pipeline that's already bound doesn't count
+         */
+        uint64_t pipeline_binds = 0;
+
+        /*!
+         * \brief Descriptor sets actually bound. Rebinding sets that are already bound doesn't count
+         */
+        uint64_t descriptor_set_binds = 0;
+
+        /*!
+         * \brief Vertex and index buffers actually bound. Rebinding buffers that are already bound doesn't count
+         */
+        uint64_t buffer_binds = 0;
+
+        /*!
+         * \brief Per-draw constant blocks actually pushed. Drawing with the same constants as the last draw doesn't push them again
+         */
+        uint64_t draw_constant_pushes = 0;
+
+        /*!
+         * \brief Buffer and image barriers recorded, not counting the ones that execute secondary command lists
+         */
+        uint64_t barriers = 0;
+
+        /*!
+         * \brief Bytes copied into buffers and images by the command list. Writes to mapped memory don't go through command lists, so
+         * they aren't counted
+         */
+        uint64_t bytes_uploaded = 0;
+
+        RhiCommandListStats& operator+=(const RhiCommandListStats& other);
+    };
+
+    /*!
+     * \brief What one pipeline statistics query counted. Same layout as the results of the queries that `RenderDevice` makes
+     */
+    struct RhiPipelineStatistics {
+        /*!
+         * \brief Primitives that the input assembler sent to the vertex shader. That's the triangles drawn, indirect draws included
+         */
+        uint64_t input_assembly_primitives = 0;
+
+        uint64_t vertex_shader_invocations = 0;
+
+        uint64_t fragment_shader_invocations = 0;
+    };
+
+    /*!
+     * \brief The per-draw data that every shader using the standard pipeline layout gets as push constants
+     *
+     * Matches `StandardPushConstants` in the standard pipeline layout HLSL, so any change here has to go there too
+     */
+    struct RhiDrawConstants {
+        /*!
+         * \brief Index of the first camera that renders the draw. Passes that render several views use the cameras after this one too
+         */
+        uint32_t camera_index = 0;
+
+        /*!
+         * \brief Index of the draw's material in the material buffer
+         */
+        uint32_t material_index = 0;
+
+        /*!
+         * \brief Added to `SV_InstanceID` to find the instance's data. Indirect draws already have their own base instance, so they usually
+         * leave this at 0
+         */
+        uint32_t instance_base = 0;
+
+        /*!
+         * \brief Index of a transform for the whole draw, for things that don't have per-instance model matrices
+         */
+        uint32_t transform_index = 0;
+
+        [[nodiscard]] bool operator==(const RhiDrawConstants& other) const;
+
+        [[nodiscard]] bool operator!=(const RhiDrawConstants& other) const;
+    };
+
+    /*!
+     * \brief Arguments for one indexed indirect draw. Same layout as both VkDrawIndexedIndirectCommand and D3D12_DRAW_INDEXED_ARGUMENTS
+     */
+    struct RhiDrawIndexedIndirectCommand {
+        uint32_t index_count;
+        uint32_t instance_count;
+        uint32_t first_index;
+        int32_t vertex_offset;
+        uint32_t first_instance;
+    };
+
+    /*!
+     * \brief Arguments for one indirect dispatch. Same layout as both VkDispatchIndirectCommand and D3D12_DISPATCH_ARGUMENTS
+     */
+    struct RhiDispatchIndirectCommand {
+        uint32_t num_groups_x;
+        uint32_t num_groups_y;
+        uint32_t num_groups_z;
+    };
+
     struct RhiMaterialResources {
         RhiBuffer* material_data_buffer;
         RhiSampler* point_sampler;
@@ -72,6 +291,9 @@ namespace nova::renderer::rhi {
 
     struct RhiPipeline {
         std::string name;
+
+        // Pipelines are owned through `std::unique_ptr<RhiPipeline>`, and the backends each have more than one kind of pipeline
+        virtual ~RhiPipeline() = default;
     };
 
     struct RhiFramebuffer {
@@ -150,6 +372,11 @@ namespace nova::renderer::rhi {
 
     struct RhiDescriptorPool {};
 
+    /*!
+     * \brief A pool of GPU timestamps or pipeline statistics queries
+     */
+    struct RhiQueryPool {};
+
     struct RhiDescriptorSet {};
 
     // TODO: Resource state tracking in the command list so we don't need all this bullshit
@@ -187,6 +414,13 @@ namespace nova::renderer::rhi {
 
         struct ImageMemoryBarrier {
             ImageAspect aspect;
+
+            uint32_t first_mip;
+
+            /*!
+             * \brief How many mips, starting at `first_mip`, the barrier covers. Zero means all of them
+             */
+            uint32_t num_mips;
         };
 
         struct BufferMemoryBarrier {
@@ -204,5 +438,7 @@ namespace nova::renderer::rhi {
     };
 #pragma endregion
 
-    ShaderStage operator|=(ShaderStage lhs, ShaderStage rhs);
+    ShaderStage& operator|=(ShaderStage& lhs, ShaderStage rhs);
+
+    PipelineStage operator|(PipelineStage lhs, PipelineStage rhs);
 } // namespace nova::renderer::rhi
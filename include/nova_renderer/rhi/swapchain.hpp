@@ -1,8 +1,8 @@
 #pragma once
 #include <glm/glm.hpp>
 
+#include <optional>
 #include <vector>
-#include <rx/core/memory/allocator.h>
 
 namespace nova::renderer::rhi {
     struct RhiFence;
@@ -19,14 +19,49 @@ namespace nova::renderer::rhi {
         /*!
          * \brief Acquires the next image in the swapchain
          *
-         * \return The index of the swapchain image we just acquired
+         * This method does not wait for the image to actually be available. Instead, the provided semaphore is signaled when the
+         * presentation engine is done with the image, and the first submission that touches the image must wait on it
+         *
+         * \param image_available_semaphore Semaphore to signal when the acquired image may be rendered to
+         *
+         * \return The index of the swapchain image we just acquired, or nullopt if the swapchain is out of date. Nothing can be presented
+         * to an out of date swapchain, so recreate it and try again next frame. The semaphore isn't signaled in that case
          */
-        virtual uint8_t acquire_next_swapchain_image(rx::memory::allocator& allocator) = 0;
+        [[nodiscard]] virtual std::optional<uint8_t> acquire_next_swapchain_image(RhiSemaphore* image_available_semaphore) = 0;
 
         /*!
          * \brief Presents the specified swapchain image
+         *
+         * \param image_idx Index of the swapchain image to present
+         * \param render_finished_semaphore Semaphore that's signaled when all rendering to the image is finished. Presentation waits on
+         * it, so the CPU never has to
+         */
+        virtual void present(uint32_t image_idx, RhiSemaphore* render_finished_semaphore) = 0;
+
+        /*!
+         * \brief Waits until the image that was presented most recently is actually on the display
+         *
+         * Only some swapchains can tell when that happens. The rest return false right away
+         *
+         * \param timeout_ns How long to wait, in nanoseconds
+         *
+         * \return True if the image was shown before the timeout, false if it wasn't or if this swapchain can't tell
+         */
+        [[nodiscard]] virtual bool wait_for_last_present(uint64_t timeout_ns) = 0;
+
+        /*!
+         * \brief Replaces the swapchain's images with new ones of the provided size
+         *
+         * The GPU must be done with all the old images. Everything that `get_framebuffer`, `get_image`, and `get_fence` returned before
+         * is destroyed
+         */
+        virtual void recreate(const glm::uvec2& new_size) = 0;
+
+        /*!
+         * \brief Checks if the swapchain no longer matches its surface, because acquiring or presenting said it was out of date or
+         * suboptimal. `recreate` clears this
          */
-        virtual void present(uint32_t image_idx) = 0;
+        [[nodiscard]] bool needs_recreation() const;
 
         [[nodiscard]] RhiFramebuffer* get_framebuffer(uint32_t frame_idx) const;
 
@@ -36,9 +71,16 @@ namespace nova::renderer::rhi {
 
         [[nodiscard]] glm::uvec2 get_size() const;
 
+        /*!
+         * \brief The number of images the swapchain actually has, which may be more than were requested
+         */
+        [[nodiscard]] uint32_t get_num_images() const;
+
     protected:
-        const uint32_t num_images;
-        const glm::uvec2 size;
+        uint32_t num_images;
+        glm::uvec2 size;
+
+        bool is_out_of_date = false;
 
         // Arrays of the per-frame swapchain resources. Each swapchain implementation is responsible for filling these arrays with
         // API-specific objects
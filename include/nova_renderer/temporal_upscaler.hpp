@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+namespace nova::renderer {
+    struct FrameContext;
+
+    /*!
+     * \brief Everything a temporal upscaler gets to work with each frame
+     *
+     * The inputs are render targets at the size of the screen, but with dynamic resolution or a render scale below one, only the top-left
+     * `render_size` of them has anything in it. They're all ready for compute shaders to read, and `output` is ready for them to write
+     */
+    struct TemporalUpscaleInputs {
+        /*!
+         * \brief What the renderpack rendered to `SCENE_OUTPUT_RT_NAME` this frame, with the main camera's jittered projection
+         */
+        rhi::RhiImage* color = nullptr;
+
+        /*!
+         * \brief The depth of the renderpack's main scene pass
+         */
+        rhi::RhiImage* depth = nullptr;
+
+        /*!
+         * \brief `MOTION_VECTORS_RT_NAME`. Each texel holds how far to move in UV space to get to where that texel's surface was last
+         * frame, without either frame's jitter
+         */
+        rhi::RhiImage* motion_vectors = nullptr;
+
+        /*!
+         * \brief Where to write the upscaled scene, which the backbuffer output pass shows in place of the scene output
+         */
+        rhi::RhiImage* output = nullptr;
+
+        /*!
+         * \brief How much of the inputs the scene rendered to this frame
+         */
+        glm::uvec2 render_size{};
+
+        /*!
+         * \brief The size of the input textures
+         */
+        glm::uvec2 input_size{};
+
+        glm::uvec2 output_size{};
+
+        /*!
+         * \brief This frame's jitter, in render pixels. From `TemporalUpscaler::get_jitter`
+         */
+        glm::vec2 jitter{};
+
+        /*!
+         * \brief Whether the upscaler's history has nothing to do with this frame, because this is the first frame since
+         * `create_resources` or since a renderpack was loaded
+         */
+        bool reset_history = false;
+    };
+
+    /*!
+     * \brief Turns the scene, rendered at a lower resolution with a jittered camera, into a full-resolution image using what it rendered
+     * in earlier frames
+     *
+     * Nova calls this from the `TEMPORAL_UPSCALE_PASS_NAME` builtin pass, which runs after everything that writes to the scene output and
+     * before the backbuffer output pass. Nova ships with a simple accumulating upscaler. Hand something better to
+     * `NovaRenderer::set_temporal_upscaler`, like a wrapper around FSR2 or a vendor SDK
+     *
+     * Every method is called on the render thread
+     */
+    class TemporalUpscaler {
+    public:
+        TemporalUpscaler() = default;
+
+        TemporalUpscaler(TemporalUpscaler&& old) noexcept = default;
+        TemporalUpscaler& operator=(TemporalUpscaler&& old) noexcept = default;
+
+        TemporalUpscaler(const TemporalUpscaler& other) = delete;
+        TemporalUpscaler& operator=(const TemporalUpscaler& other) = delete;
+
+        virtual ~TemporalUpscaler() = default;
+
+        /*!
+         * \brief Makes the history textures, pipelines, and whatever else the upscaler needs to write an output of the provided size.
+         * Nova calls this again when the window is resized, after calling `destroy_resources`
+         *
+         * \pre The device is idle
+         *
+         * \return Whether the upscaler is ready to upscale. Nova shows the scene without upscaling it if not
+         */
+        virtual bool create_resources(rhi::RenderDevice& device, glm::uvec2 output_size) = 0;
+
+        /*!
+         * \brief Destroys everything `create_resources` made
+         *
+         * \pre The device is idle
+         */
+        virtual void destroy_resources(rhi::RenderDevice& device) = 0;
+
+        /*!
+         * \brief Picks the offset of the main camera's projection for a frame, in render pixels. Each component should be between -0.5
+         * and 0.5
+         *
+         * The default walks through the Halton (2, 3) sequence, with more phases the more the output is scaled up, so that every output
+         * pixel gets a few samples before the sequence repeats
+         */
+        [[nodiscard]] virtual glm::vec2 get_jitter(uint64_t frame_count, glm::uvec2 render_size, glm::uvec2 output_size) const;
+
+        /*!
+         * \brief Records the upscale
+         *
+         * Anything the upscaler reads or writes besides the inputs, like its history, is up to it to barrier
+         */
+        virtual void record_upscale(rhi::RhiRenderCommandList& cmds, const TemporalUpscaleInputs& inputs, FrameContext& ctx) = 0;
+    };
+} // namespace nova::renderer
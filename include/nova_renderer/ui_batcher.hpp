@@ -0,0 +1,389 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+namespace nova::renderer {
+    class FrameUploadAllocator;
+    class RhiResourceBinder;
+    struct FrameContext;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief A rectangle on screen, in pixels from the top-left corner
+     */
+    struct UiRect {
+        glm::vec2 position{};
+
+        glm::vec2 size{};
+    };
+
+    /*!
+     * \brief Which of the UI batcher's textures a quad samples. Texture 0 is the batcher's atlas
+     */
+    using UiTextureId = uint32_t;
+
+    /*!
+     * \brief Part of one of the UI batcher's textures
+     */
+    struct UiImage {
+        UiTextureId texture = 0;
+
+        /*!
+         * \brief The UVs of the image's top-left and bottom-right corners
+         */
+        glm::vec2 min_uv{0};
+        glm::vec2 max_uv{1};
+
+        /*!
+         * \brief Which atlas upload the image's pixels arrive in. Zero for textures that the host made
+         */
+        uint64_t upload_serial = 0;
+    };
+
+    /*!
+     * \brief A glyph as the host's font rasterizer drew it
+     */
+    struct UiGlyphBitmap {
+        uint32_t width = 0;
+
+        uint32_t height = 0;
+
+        /*!
+         * \brief How much of each pixel the glyph covers, one byte per pixel, top row first
+         */
+        std::vector<uint8_t> coverage;
+
+        /*!
+         * \brief Where the glyph's top-left corner is, relative to the pen on the baseline
+         */
+        glm::vec2 bearing{};
+
+        /*!
+         * \brief How far to move the pen after this glyph
+         */
+        float advance = 0;
+    };
+
+    /*!
+     * \brief Draws a glyph of a font for the UI batcher's glyph cache. Nova doesn't know about fonts, so the host brings its own
+     *
+     * \return The glyph, or nothing if the font doesn't have it
+     */
+    using UiGlyphRasterizer = std::function<std::optional<UiGlyphBitmap>(uint32_t font, char32_t codepoint)>;
+
+    /*!
+     * \brief Batches 2D UI geometry into a handful of draws, for `UiRenderpass::render_ui`
+     *
+     * Quads, glyphs, and rounded rects all go into one list of quads, which is stably sorted by layer and then by clip rect when it's
+     * drawn. Every quad says which texture it samples, and all the textures are bound at once, so only a change of clip rect starts a new
+     * draw. Within a layer, quads with different clip rects may be drawn in any order, so put UI that overlaps something with another
+     * clip rect in a higher layer
+     *
+     * Images and glyphs are packed into one RGBA8 atlas. Glyphs come from the host's rasterizer the first time they're drawn, and their
+     * pixels are copied into the atlas at the start of the next frame, so a glyph that's new this frame shows up a frame late. When the
+     * atlas fills up, every glyph is thrown out at the end of the frame and rasterized again as it's needed
+     *
+     * Each in-flight frame has a host-visible vertex buffer that the quads are written to. It grows when a frame has more quads than
+     * it has room for
+     *
+     * Anything left in the batcher when `render_ui` returns is drawn right after it. Call `record_draws` to draw the UI so far in the
+     * middle of `render_ui`, such as before recording your own commands on top of it. This class is not thread-safe. Only use it from
+     * `render_ui`, or from the thread that calls `NovaRenderer::execute_frame` between frames
+     */
+    class UiBatcher {
+    public:
+        /*!
+         * \brief How many textures the batcher can bind at once, its atlas included. Matches `textures` in the UI shaders
+         */
+        static constexpr uint32_t MAX_TEXTURES = 16;
+
+        UiBatcher(rhi::RenderDevice& device,
+                  rhi::RhiSampler* sampler,
+                  const NovaSettings::UiBatchingOptions& options,
+                  uint32_t num_in_flight_frames);
+
+        UiBatcher(const UiBatcher& other) = delete;
+        UiBatcher& operator=(const UiBatcher& other) = delete;
+
+        UiBatcher(UiBatcher&& old) noexcept = delete;
+        UiBatcher& operator=(UiBatcher&& old) noexcept = delete;
+
+        /*!
+         * \brief Destroys the atlas and the vertex buffers. The GPU must be done with all of them
+         */
+        ~UiBatcher();
+
+        /*!
+         * \brief Lets quads sample an image that the host made, such as a render target or a texture from a renderpack
+         *
+         * \return The image's texture ID, or nothing if there are already `MAX_TEXTURES` textures
+         */
+        [[nodiscard]] std::optional<UiTextureId> add_texture(rhi::RhiImage* image);
+
+        /*!
+         * \brief Stops binding an image that `add_texture` added. Quads that sample it afterwards sample the atlas instead
+         */
+        void remove_texture(UiTextureId texture);
+
+        /*!
+         * \brief Packs an RGBA8 image into the atlas, for small images like icons
+         *
+         * \return Where the image is in the atlas, or nothing if the atlas doesn't have room for it
+         */
+        [[nodiscard]] std::optional<UiImage> add_image(uint32_t width, uint32_t height, const uint8_t* pixels);
+
+        void set_glyph_rasterizer(UiGlyphRasterizer rasterizer);
+
+        /*!
+         * \brief Clips everything that's added until the matching `pop_clip_rect` to a rectangle, and to the clip rect before it
+         */
+        void push_clip_rect(const UiRect& rect);
+
+        void pop_clip_rect();
+
+        /*!
+         * \brief Puts everything that's added after this on a layer. Higher layers are drawn on top of lower layers. Each frame starts on
+         * layer 0
+         */
+        void set_layer(uint32_t layer);
+
+        void add_quad(const UiRect& rect, const glm::vec4& color, const UiImage& image = {});
+
+        /*!
+         * \brief Adds a rectangle with rounded corners
+         *
+         * \param radius The radius of the corners, in pixels
+         * \param border_width How thick the outline is, in pixels. Zero fills the whole rectangle
+         */
+        void add_rounded_rect(const UiRect& rect, const glm::vec4& color, float radius, float border_width = 0);
+
+        /*!
+         * \brief Adds a line of text, glyph by glyph, rasterizing the glyphs that aren't in the glyph cache yet
+         *
+         * \param baseline Where the pen starts on the text's baseline
+         *
+         * \return Where the pen ended up
+         */
+        glm::vec2 add_text(uint32_t font, std::u32string_view text, const glm::vec2& baseline, const glm::vec4& color);
+
+        /*!
+         * \brief Copies the images and glyphs that were added since the last frame into the atlas
+         *
+         * Call this once per frame, in the first graphics command list, before the UI renderpass
+         */
+        void record_atlas_uploads(rhi::RhiRenderCommandList& cmds, FrameUploadAllocator& frame_uploads);
+
+        /*!
+         * \brief Draws every quad that was added since the last draws, and empties the batcher
+         *
+         * This binds the batcher's own pipeline, so rebind yours if you record more draws after it
+         */
+        void record_draws(rhi::RhiRenderCommandList& cmds, FrameContext& ctx);
+
+        /*!
+         * \brief Throws away anything that wasn't drawn this frame, and the glyph cache if the atlas filled up
+         *
+         * Call this once per frame, after the UI renderpass is recorded
+         */
+        void end_frame();
+
+    private:
+        /*!
+         * \brief Matches `VsInput` in the UI vertex shader
+         */
+        struct UiVertex {
+            glm::vec2 position;
+
+            glm::vec2 uv;
+
+            /*!
+             * \brief Where the vertex is relative to the center of its quad, and half the quad's size, for rounded rects
+             */
+            glm::vec4 shape;
+
+            /*!
+             * \brief The radius of the corners and the width of the border. A negative radius means the quad isn't rounded
+             */
+            glm::vec2 corner;
+
+            uint32_t color;
+
+            UiTextureId texture;
+        };
+
+        struct UiQuad {
+            std::array<UiVertex, 4> vertices;
+
+            uint32_t layer;
+
+            uint32_t clip_rect;
+
+            /*!
+             * \brief The atlas upload that the quad's pixels are in. The quad isn't drawn before that upload is recorded
+             */
+            uint64_t upload_serial;
+        };
+
+        struct AtlasShelf {
+            uint32_t y;
+
+            uint32_t height;
+
+            uint32_t next_x;
+
+            /*!
+             * \brief Whether the shelf has glyphs in it, which means it's emptied when the glyph cache is thrown out
+             */
+            bool has_glyphs;
+        };
+
+        struct AtlasUpload {
+            uint32_t x;
+
+            uint32_t y;
+
+            uint32_t width;
+
+            uint32_t height;
+
+            std::vector<uint8_t> pixels;
+
+            uint64_t serial;
+        };
+
+        struct CachedGlyph {
+            UiImage image;
+
+            glm::vec2 size;
+
+            glm::vec2 bearing;
+
+            float advance;
+        };
+
+        struct GlyphKey {
+            uint32_t font;
+
+            char32_t codepoint;
+
+            bool operator==(const GlyphKey& other) const = default;
+        };
+
+        struct GlyphKeyHash {
+            size_t operator()(const GlyphKey& key) const;
+        };
+
+        struct FrameResources {
+            rhi::RhiBuffer* vertices = nullptr;
+
+            uint32_t quad_capacity = 0;
+        };
+
+        rhi::RenderDevice& device;
+
+        NovaSettings::UiBatchingOptions options;
+
+        std::unique_ptr<rhi::RhiPipeline> pipeline;
+
+        std::unique_ptr<RhiResourceBinder> binder;
+
+        rhi::RhiImage* atlas = nullptr;
+
+        bool is_atlas_initialized = false;
+
+        std::array<rhi::RhiImage*, MAX_TEXTURES> textures{};
+
+        /*!
+         * \brief Six indices for each of the most quads that one draw can have
+         */
+        rhi::RhiBuffer* index_buffer = nullptr;
+
+        std::vector<FrameResources> frames;
+
+        std::vector<AtlasShelf> shelves;
+
+        uint32_t next_shelf_y = 0;
+
+        std::vector<AtlasUpload> pending_uploads;
+
+        uint64_t next_upload_serial = 1;
+
+        /*!
+         * \brief The newest atlas upload that's been recorded
+         */
+        uint64_t last_recorded_upload = 0;
+
+        /*!
+         * \brief A white pixel in the atlas, for quads that don't sample an image
+         */
+        UiImage white_image;
+
+        UiGlyphRasterizer glyph_rasterizer;
+
+        /*!
+         * \brief Every glyph that's been rasterized. Glyphs the font doesn't have are in here without a value, so they're only asked for
+         * once
+         */
+        std::unordered_map<GlyphKey, std::optional<CachedGlyph>, GlyphKeyHash> glyphs;
+
+        /*!
+         * \brief Whether a glyph didn't fit in the atlas this frame
+         */
+        bool should_evict_glyphs = false;
+
+        std::vector<UiQuad> quads;
+
+        /*!
+         * \brief The clip rects of this frame. Clip rect 0 is the whole screen
+         */
+        std::vector<UiRect> clip_rects;
+
+        std::vector<uint32_t> clip_rect_stack;
+
+        uint32_t layer = 0;
+
+        /*!
+         * \brief The order that `record_draws` writes the quads in. Kept around so that it doesn't allocate every frame
+         */
+        std::vector<uint32_t> sorted_quads;
+
+        std::vector<UiVertex> vertex_scratch;
+
+        /*!
+         * \brief Finds room for a rectangle in the atlas, one pixel of padding included
+         *
+         * \return The top-left corner of the rectangle's padding, or nothing if the atlas is full
+         */
+        [[nodiscard]] std::optional<glm::uvec2> allocate_atlas_rect(uint32_t width, uint32_t height, bool is_glyph);
+
+        /*!
+         * \brief Queues the upload of some RGBA8 pixels to the atlas, surrounded by one pixel of padding
+         *
+         * \param clamp_padding Whether the padding repeats the image's edge, instead of being transparent
+         */
+        UiImage queue_atlas_upload(const glm::uvec2& corner, uint32_t width, uint32_t height, const uint8_t* pixels, bool clamp_padding);
+
+        [[nodiscard]] const CachedGlyph* get_glyph(uint32_t font, char32_t codepoint);
+
+        void evict_glyphs();
+
+        void add_vertices(const std::array<UiVertex, 4>& vertices, uint64_t upload_serial);
+
+        bool ensure_vertex_capacity(FrameResources& frame, uint32_t num_quads);
+    };
+} // namespace nova::renderer
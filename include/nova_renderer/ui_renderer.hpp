@@ -24,6 +24,8 @@ namespace nova::renderer {
          *
          * Clients of Nova must provide their own implementation of `UiRenderpass`. Nova will then use that implementation to render that
          * application's UI
+         *
+         * Most UI can go through `ctx.ui`, which batches it into a few draws. Nova draws whatever's in the batcher after this returns
          */
         virtual void render_ui(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) = 0;
     };
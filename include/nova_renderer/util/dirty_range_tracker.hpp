@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace nova::renderer {
+    /*!
+     * \brief Remembers which parts of some CPU-side data changed since each in-flight frame's copy of it was last written
+     *
+     * The data is split into units - array elements, fixed-size blocks of bytes, whatever makes sense for the data. Every unit remembers
+     * the generation it was last modified in, and every frame slot remembers the generation it was last uploaded in. Uploading a frame
+     * slot only visits the units that are newer than the slot, and hands them out as runs of adjacent units so each run can be copied
+     * with one memcpy
+     */
+    class DirtyRangeTracker {
+    public:
+        /*!
+         * \param num_units How many units the data is split into
+         * \param num_slots How many copies of the data need to be kept up to date, usually one per in-flight frame
+         */
+        DirtyRangeTracker(size_t num_units, uint32_t num_slots);
+
+        /*!
+         * \brief Marks some units as changed, so every slot uploads them again
+         */
+        void mark_dirty(size_t first_unit, size_t num_units = 1);
+
+        /*!
+         * \brief Changes how many units the data is split into. New units start out dirty
+         */
+        void resize(size_t num_units);
+
+        /*!
+         * \brief Makes the next `consume_dirty_ranges` for this slot visit all the data, such as when the slot's buffer was recreated
+         */
+        void invalidate_slot(uint32_t slot);
+
+        /*!
+         * \brief Calls `func(first_unit, num_units)` for every run of units that changed since the last time this slot was consumed, then
+         * marks the slot as up to date
+         *
+         * Every unit starts out dirty, so the first call for each slot visits all the data
+         */
+        template <typename FuncType>
+        void consume_dirty_ranges(uint32_t slot, FuncType&& func);
+
+    private:
+        std::vector<uint64_t> unit_generations;
+
+        std::vector<uint64_t> slot_generations;
+
+        /*!
+         * \brief The generation that modifications are currently tagged with. Bumped every time a slot is consumed
+         */
+        uint64_t generation = 1;
+
+        /*!
+         * \brief Generation of the most recent modification, so slots can skip the scan when nothing changed
+         */
+        uint64_t newest_modification = 1;
+    };
+
+    inline DirtyRangeTracker::DirtyRangeTracker(const size_t num_units, const uint32_t num_slots)
+        : unit_generations(num_units, 1), slot_generations(num_slots, 0) {}
+
+    inline void DirtyRangeTracker::mark_dirty(const size_t first_unit, const size_t num_units) {
+        const auto end = first_unit + num_units < unit_generations.size() ? first_unit + num_units : unit_generations.size();
+        for(auto i = first_unit; i < end; i++) {
+            unit_generations[i] = generation;
+        }
+
+        newest_modification = generation;
+    }
+
+    inline void DirtyRangeTracker::resize(const size_t num_units) {
+        unit_generations.resize(num_units, generation);
+        newest_modification = generation;
+    }
+
+    inline void DirtyRangeTracker::invalidate_slot(const uint32_t slot) {
+        // Every unit has a generation of at least one
+        slot_generations[slot] = 0;
+    }
+
+    template <typename FuncType>
+    void DirtyRangeTracker::consume_dirty_ranges(const uint32_t slot, FuncType&& func) {
+        const auto slot_generation = slot_generations[slot];
+        slot_generations[slot] = generation;
+        generation++;
+
+        if(newest_modification <= slot_generation) {
+            return;
+        }
+
+        size_t run_start = 0;
+        size_t run_length = 0;
+        for(size_t i = 0; i < unit_generations.size(); i++) {
+            if(unit_generations[i] > slot_generation) {
+                if(run_length == 0) {
+                    run_start = i;
+                }
+                run_length++;
+
+            } else if(run_length > 0) {
+                func(run_start, run_length);
+                run_length = 0;
+            }
+        }
+
+        if(run_length > 0) {
+            func(run_start, run_length);
+        }
+    }
+} // namespace nova::renderer
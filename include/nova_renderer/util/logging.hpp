@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+namespace nova {
+    /*!
+     * \brief Gets the logger with the given name, making it if nobody's asked for it yet
+     *
+     * All of Nova's loggers are asynchronous. Logging a message formats it on the calling thread and pushes it onto a fixed-size queue,
+     * and one background thread writes the queue to the console. If the queue fills up, the oldest message gets dropped, so a thread that
+     * logs never waits on the console
+     *
+     * The console sink collapses bursts of the same message. A message that shows up more than a few times in a second (ignoring any
+     * numbers in it, so "Could not update renderable 12" and "Could not update renderable 13" count as the same message) is only written
+     * the first few times, and then a summary of how many repeats were dropped
+     *
+     * Debug and trace messages that are logged with `SPDLOG_LOGGER_DEBUG` or `SPDLOG_LOGGER_TRACE` are compiled out of non-debug builds.
+     * Use those for anything that might get logged every frame
+     *
+     * Safe to call during static initialization
+     */
+    [[nodiscard]] std::shared_ptr<spdlog::logger> make_logger(const std::string& name);
+
+    /*!
+     * \brief Asks the logging thread to write out every message that was queued up before this call
+     */
+    void flush_logs();
+} // namespace nova
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace nova::renderer {
+    /*!
+     * \brief Runs the work that Nova spreads across threads: loading renderpacks, compiling pipelines, culling, and recording commands
+     *
+     * Every task receives the index of the thread it runs on. Thread index 0 is reserved for the thread that owns the scheduler (usually
+     * the thread that calls `NovaRenderer::execute_frame`), and the workers are numbered 1 through `get_num_worker_threads()`. The RHI
+     * creates one set of command pools per thread index, so a task may allocate command lists with its thread index without any locking
+     *
+     * Nova uses `WorkStealingTaskScheduler` unless the host application gives it a scheduler of its own. A host scheduler must keep the
+     * thread index promise: no two tasks may run at the same time with the same index, and every index is below `get_num_threads()`
+     */
+    class TaskScheduler {
+    public:
+        using Task = std::function<void(uint32_t)>;
+
+        TaskScheduler() = default;
+
+        TaskScheduler(const TaskScheduler& other) = delete;
+        TaskScheduler& operator=(const TaskScheduler& other) = delete;
+
+        TaskScheduler(TaskScheduler&& old) noexcept = delete;
+        TaskScheduler& operator=(TaskScheduler&& old) noexcept = delete;
+
+        virtual ~TaskScheduler() = default;
+
+        /*!
+         * \brief Runs a task on some thread, some time soon
+         */
+        virtual void submit(Task task) = 0;
+
+        /*!
+         * \brief Runs one waiting task on the calling thread, if there is one and the calling thread may run tasks
+         *
+         * Threads that wait on other tasks call this in a loop, so they help out instead of sitting idle. Schedulers that can't do that
+         * may always return false, and waiting threads will block instead
+         *
+         * \return True if a task was run
+         */
+        virtual bool run_pending_task() = 0;
+
+        /*!
+         * \brief The number of worker threads, not counting the thread that owns the scheduler
+         */
+        [[nodiscard]] virtual uint32_t get_num_worker_threads() const = 0;
+
+        /*!
+         * \brief The thread index of the calling thread. Threads that don't belong to the scheduler get 0
+         */
+        [[nodiscard]] virtual uint32_t get_current_thread_idx() const = 0;
+
+        /*!
+         * \brief The total number of threads that may run tasks, including the thread that owns the scheduler. Anything that keeps
+         * per-thread data should allocate this many slots
+         */
+        [[nodiscard]] uint32_t get_num_threads() const;
+
+        /*!
+         * \brief Adds a task to the queue
+         *
+         * \param task Callable that takes the index of the thread it runs on as its first parameter
+         * \param args Any additional arguments to pass to the task
+         *
+         * \return A future for the task's return value
+         */
+        template <typename TaskType, typename... Args>
+        auto add_task(TaskType&& task, Args&&... args) -> std::future<std::invoke_result_t<TaskType, uint32_t, Args...>>;
+
+        /*!
+         * \brief Splits `[begin, end)` into ranges of `grain_size` elements and calls `func` on each range, in parallel. Returns once
+         * every range is done
+         *
+         * The calling thread works on ranges too, so this is safe to call from inside a task
+         *
+         * \param func Called with the thread index, then the first and one-past-the-last element of its range
+         */
+        void parallel_for(uint32_t begin,
+                          uint32_t end,
+                          uint32_t grain_size,
+                          const std::function<void(uint32_t thread_idx, uint32_t range_begin, uint32_t range_end)>& func);
+
+        /*!
+         * \brief Waits for a future, running other tasks on the calling thread until it's ready
+         *
+         * A task that waits on tasks it submitted must wait with this. Those tasks are in its worker's own queue, and with no other
+         * workers free to steal them, a worker that just blocks would wait forever
+         */
+        template <typename FutureType>
+        void wait_for(const FutureType& future);
+    };
+
+    /*!
+     * \brief Nova's own task scheduler. Each worker has a queue of its own, and steals from the others when its queue runs dry
+     *
+     * Tasks that workers submit go on the back of the worker's own queue, and the worker takes its next task from the back too, so a task
+     * that splits its work up usually runs the pieces while their data is still in cache. Thieves take from the front, where the oldest
+     * tasks are. Tasks submitted from any other thread go in a shared queue that every worker checks
+     */
+    class WorkStealingTaskScheduler final : public TaskScheduler {
+    public:
+        /*!
+         * \brief Starts the provided number of worker threads. The thread that calls this owns the scheduler and gets thread index 0
+         *
+         * \param num_worker_threads The number of worker threads to start. If this is zero, all tasks are executed inline on the calling
+         * thread
+         */
+        explicit WorkStealingTaskScheduler(uint32_t num_worker_threads);
+
+        /*!
+         * \brief Finishes all queued tasks, then joins all the worker threads
+         */
+        ~WorkStealingTaskScheduler() override;
+
+        void submit(Task task) override;
+
+        bool run_pending_task() override;
+
+        [[nodiscard]] uint32_t get_num_worker_threads() const override;
+
+        [[nodiscard]] uint32_t get_current_thread_idx() const override;
+
+    private:
+        struct TaskQueue {
+            std::mutex mutex;
+
+            std::deque<Task> tasks;
+        };
+
+        /*!
+         * \brief One queue per thread index. The owner's queue, at index 0, is also where threads that don't belong to the scheduler put
+         * their tasks
+         */
+        std::vector<std::unique_ptr<TaskQueue>> queues;
+
+        std::vector<std::thread> workers;
+
+        std::thread::id owner_thread;
+
+        std::atomic<uint64_t> num_queued_tasks = 0;
+
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;
+
+        bool should_stop = false;
+
+        /*!
+         * \brief Takes a task from the back of the thread's own queue, or from the front of another thread's queue if its own is empty
+         */
+        bool pop_task(uint32_t thread_idx, Task& task);
+
+        void worker_loop(uint32_t thread_idx);
+    };
+
+    /*!
+     * \brief Tasks with dependencies between them. Each task starts as soon as every task it depends on has finished
+     *
+     * Running a graph copies it, so the same graph may be run many times, even at once, and needn't outlive its runs
+     */
+    class TaskGraph {
+    public:
+        using NodeId = uint32_t;
+
+        NodeId add_task(TaskScheduler::Task task);
+
+        /*!
+         * \brief Makes `after` wait for `before` to finish
+         */
+        void add_dependency(NodeId before, NodeId after);
+
+        /*!
+         * \brief Submits the tasks that don't depend on anything, and the rest as their dependencies finish
+         *
+         * \return A future that becomes ready when every task has finished. Graphs with a cycle in them don't run at all, and their
+         * future is ready right away
+         */
+        std::future<void> run(TaskScheduler& scheduler) const;
+
+    private:
+        struct Node {
+            TaskScheduler::Task task;
+
+            std::vector<NodeId> successors;
+
+            uint32_t num_dependencies = 0;
+        };
+
+        std::vector<Node> nodes;
+
+        [[nodiscard]] bool has_cycle() const;
+    };
+
+    template <typename TaskType, typename... Args>
+    auto TaskScheduler::add_task(TaskType&& task, Args&&... args) -> std::future<std::invoke_result_t<TaskType, uint32_t, Args...>> {
+        using ReturnType = std::invoke_result_t<TaskType, uint32_t, Args...>;
+
+        // std::function must be copyable, so the packaged task has to live on the heap
+        auto packaged = std::make_shared<std::packaged_task<ReturnType(uint32_t)>>(
+            [task = std::forward<TaskType>(task), ... args = std::forward<Args>(args)](const uint32_t thread_idx) mutable {
+                return task(thread_idx, std::forward<Args>(args)...);
+            });
+
+        auto future = packaged->get_future();
+
+        submit([packaged](const uint32_t thread_idx) { (*packaged)(thread_idx); });
+
+        return future;
+    }
+
+    template <typename FutureType>
+    void TaskScheduler::wait_for(const FutureType& future) {
+        // Nothing tells us when a task gets queued, so a thread that runs out of tasks checks back every so often
+        constexpr auto POLL_INTERVAL = std::chrono::microseconds{100};
+
+        while(future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+            if(!run_pending_task()) {
+                future.wait_for(POLL_INTERVAL);
+            }
+        }
+    }
+} // namespace nova::renderer
@@ -19,6 +19,12 @@ namespace nova::renderer {
      */
     class NovaWindow {
     public:
+        /*!
+         * \brief Opens a window with the size and title in `options`
+         *
+         * When the null render device is enabled, no OS window is opened at all. The window then never closes, never gets any input, and
+         * reports the size from `options`
+         */
         explicit NovaWindow(const NovaSettings& options);
         ~NovaWindow();
         NovaWindow(NovaWindow&& other) noexcept = delete;
@@ -82,6 +88,13 @@ namespace nova::renderer {
     private:
         GLFWwindow* window = nullptr;
 
+        bool glfw_initialized = false;
+
+        /*!
+         * \brief The size to report when there's no OS window
+         */
+        glm::uvec2 headless_size;
+
         std::vector<std::function<void(uint32_t, bool, bool, bool)>> key_callbacks;
 
         std::vector<std::function<void(double, double)>> mouse_callbacks;
@@ -0,0 +1,610 @@
+#include "async_file_reader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <tuple>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+#include "nova_renderer/util/platform.hpp"
+
+#ifdef NOVA_WINDOWS
+#include "nova_renderer/util/windows.hpp"
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(NOVA_LINUX) && __has_include(<linux/io_uring.h>)
+#define NOVA_HAS_IO_URING 1
+#include <atomic>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace nova::filesystem {
+    static auto logger = make_logger("AsyncFileReader");
+
+#ifdef NOVA_WINDOWS
+    /*!
+     * \brief Reads through an I/O completion port. Every file is opened for overlapped reads and associated with the port, so the
+     * kernel queues all the reads at once and the I/O thread picks up whichever finish
+     */
+    class IocpBackend final : public AsyncIoBackend {
+    public:
+        explicit IocpBackend(const uint32_t queue_depth) : slot_overlapped(queue_depth) {
+            port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+            if(port == nullptr) {
+                logger->error("Could not create an I/O completion port. Error code {}", GetLastError());
+            }
+        }
+
+        ~IocpBackend() override {
+            if(port != nullptr) {
+                CloseHandle(port);
+            }
+        }
+
+        [[nodiscard]] bool is_valid() const { return port != nullptr; }
+
+        std::optional<AsyncFileHandle> open_file(const std::string& path) override {
+            auto* file = CreateFileA(path.c_str(),
+                                     GENERIC_READ,
+                                     FILE_SHARE_READ,
+                                     nullptr,
+                                     OPEN_EXISTING,
+                                     FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                                     nullptr);
+            if(file == INVALID_HANDLE_VALUE) {
+                return std::nullopt;
+            }
+
+            LARGE_INTEGER file_size;
+            if(GetFileSizeEx(file, &file_size) == 0 || CreateIoCompletionPort(file, port, 0, 0) == nullptr) {
+                CloseHandle(file);
+                return std::nullopt;
+            }
+
+            return AsyncFileHandle{reinterpret_cast<intptr_t>(file), static_cast<uint64_t>(file_size.QuadPart)};
+        }
+
+        void close_file(const AsyncFileHandle& file) override { CloseHandle(reinterpret_cast<HANDLE>(file.handle)); }
+
+        void submit_read(const AsyncFileHandle& file,
+                         const uint64_t offset,
+                         uint8_t* destination,
+                         const uint32_t num_bytes,
+                         const uint32_t slot) override {
+            auto& entry = slot_overlapped[slot];
+            entry.overlapped = {};
+            entry.overlapped.Offset = static_cast<DWORD>(offset);
+            entry.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            entry.slot = slot;
+
+            if(ReadFile(reinterpret_cast<HANDLE>(file.handle), destination, num_bytes, nullptr, &entry.overlapped) == 0) {
+                // Reads that fail right away never reach the completion port
+                if(const auto error = GetLastError(); error == ERROR_HANDLE_EOF) {
+                    immediate_completions.emplace_back(slot, 0);
+                } else if(error != ERROR_IO_PENDING) {
+                    immediate_completions.emplace_back(slot, -1);
+                }
+            }
+        }
+
+        void wait_for_completions(const std::function<void(uint32_t, int64_t)>& on_complete) override {
+            ZoneScoped;
+            if(!immediate_completions.empty()) {
+                for(const auto& [slot, result] : immediate_completions) {
+                    on_complete(slot, result);
+                }
+                immediate_completions.clear();
+                return;
+            }
+
+            std::array<OVERLAPPED_ENTRY, 64> entries;
+            ULONG num_entries = 0;
+            if(GetQueuedCompletionStatusEx(port, entries.data(), static_cast<ULONG>(entries.size()), &num_entries, INFINITE, FALSE) == 0) {
+                logger->error("Could not wait for file reads to finish. Error code {}", GetLastError());
+                return;
+            }
+
+            for(ULONG i = 0; i < num_entries; i++) {
+                const auto& entry = entries[i];
+                const auto* overlapped = CONTAINING_RECORD(entry.lpOverlapped, SlotOverlapped, overlapped);
+
+                // `Internal` is the read's NTSTATUS
+                constexpr ULONG_PTR STATUS_END_OF_FILE_CODE = 0xC0000011;
+                if(entry.Internal == 0) {
+                    on_complete(overlapped->slot, entry.dwNumberOfBytesTransferred);
+                } else if(entry.Internal == STATUS_END_OF_FILE_CODE) {
+                    on_complete(overlapped->slot, 0);
+                } else {
+                    on_complete(overlapped->slot, -1);
+                }
+            }
+        }
+
+    private:
+        struct SlotOverlapped {
+            OVERLAPPED overlapped;
+
+            uint32_t slot;
+        };
+
+        HANDLE port = nullptr;
+
+        std::vector<SlotOverlapped> slot_overlapped;
+
+        std::vector<std::pair<uint32_t, int64_t>> immediate_completions;
+    };
+
+#else
+    static std::optional<AsyncFileHandle> open_posix_file(const std::string& path) {
+        const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd == -1) {
+            return std::nullopt;
+        }
+
+        struct stat file_stat = {};
+        if(fstat(fd, &file_stat) == -1) {
+            close(fd);
+            return std::nullopt;
+        }
+
+        return AsyncFileHandle{fd, static_cast<uint64_t>(file_stat.st_size)};
+    }
+
+    /*!
+     * \brief Reads one chunk at a time with `pread`, for when there's no way to queue reads in the kernel
+     */
+    class BlockingIoBackend final : public AsyncIoBackend {
+    public:
+        std::optional<AsyncFileHandle> open_file(const std::string& path) override { return open_posix_file(path); }
+
+        void close_file(const AsyncFileHandle& file) override { close(static_cast<int>(file.handle)); }
+
+        void submit_read(const AsyncFileHandle& file,
+                         const uint64_t offset,
+                         uint8_t* destination,
+                         const uint32_t num_bytes,
+                         const uint32_t slot) override {
+            queued_reads.push_back({static_cast<int>(file.handle), offset, destination, num_bytes, slot});
+        }
+
+        void wait_for_completions(const std::function<void(uint32_t, int64_t)>& on_complete) override {
+            ZoneScoped;
+            for(const QueuedRead& read : queued_reads) {
+                ssize_t result;
+                do {
+                    result = pread(read.fd, read.destination, read.num_bytes, static_cast<off_t>(read.offset));
+                } while(result == -1 && errno == EINTR);
+
+                on_complete(read.slot, result);
+            }
+
+            queued_reads.clear();
+        }
+
+    private:
+        struct QueuedRead {
+            int fd;
+
+            uint64_t offset;
+
+            uint8_t* destination;
+
+            uint32_t num_bytes;
+
+            uint32_t slot;
+        };
+
+        std::vector<QueuedRead> queued_reads;
+    };
+#endif
+
+#ifdef NOVA_HAS_IO_URING
+    /*!
+     * \brief Reads through an io_uring, which takes every queued read in one syscall and hands back whichever finished in the same one
+     *
+     * We talk to the rings ourselves instead of through liburing. All we need is vectored reads, which every kernel with io_uring has
+     */
+    class IoUringBackend final : public AsyncIoBackend {
+    public:
+        explicit IoUringBackend(const uint32_t queue_depth) : iovecs(queue_depth) {
+            io_uring_params params = {};
+            ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &params));
+            if(ring_fd < 0) {
+                logger->info("Could not create an io_uring, so files are read one chunk at a time. Error code {}", errno);
+                return;
+            }
+
+            sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+            cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool is_single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if(is_single_mapping) {
+                sq_ring_size = std::max(sq_ring_size, cq_ring_size);
+                cq_ring_size = sq_ring_size;
+            }
+
+            sq_ring = map_ring(sq_ring_size, IORING_OFF_SQ_RING);
+            cq_ring = is_single_mapping ? sq_ring : map_ring(cq_ring_size, IORING_OFF_CQ_RING);
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(map_ring(sqes_size, IORING_OFF_SQES));
+            if(sq_ring == nullptr || cq_ring == nullptr || sqes == nullptr) {
+                logger->error("Could not map the io_uring's rings, so files are read one chunk at a time");
+                unmap();
+                return;
+            }
+
+            auto* sq = static_cast<uint8_t*>(sq_ring);
+            sq_tail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+            sq_mask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+            sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+            auto* cq = static_cast<uint8_t*>(cq_ring);
+            cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+            cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+            cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        }
+
+        ~IoUringBackend() override { unmap(); }
+
+        [[nodiscard]] bool is_valid() const { return ring_fd >= 0; }
+
+        std::optional<AsyncFileHandle> open_file(const std::string& path) override { return open_posix_file(path); }
+
+        void close_file(const AsyncFileHandle& file) override { close(static_cast<int>(file.handle)); }
+
+        void submit_read(const AsyncFileHandle& file,
+                         const uint64_t offset,
+                         uint8_t* destination,
+                         const uint32_t num_bytes,
+                         const uint32_t slot) override {
+            // The reader never has more reads in flight than the ring has entries, so there's always room
+            const auto tail = *sq_tail;
+            const auto idx = tail & sq_mask;
+
+            iovecs[slot] = {destination, num_bytes};
+
+            auto& sqe = sqes[idx];
+            sqe = {};
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = static_cast<int>(file.handle);
+            sqe.addr = reinterpret_cast<uint64_t>(&iovecs[slot]);
+            sqe.len = 1;
+            sqe.off = offset;
+            sqe.user_data = slot;
+            sq_array[idx] = idx;
+
+            std::atomic_ref{*sq_tail}.store(tail + 1, std::memory_order_release);
+            num_unsubmitted_reads++;
+        }
+
+        void wait_for_completions(const std::function<void(uint32_t, int64_t)>& on_complete) override {
+            ZoneScoped;
+            while(true) {
+                const auto result =
+                    syscall(__NR_io_uring_enter, ring_fd, num_unsubmitted_reads, 1U, IORING_ENTER_GETEVENTS, nullptr, size_t{0});
+                if(result >= 0) {
+                    num_unsubmitted_reads -= static_cast<uint32_t>(result);
+                    break;
+                }
+
+                if(errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    logger->error("Could not submit file reads to the io_uring. Error code {}", errno);
+                    return;
+                }
+            }
+
+            auto head = *cq_head;
+            const auto tail = std::atomic_ref{*cq_tail}.load(std::memory_order_acquire);
+            for(; head != tail; head++) {
+                const auto& cqe = cqes[head & cq_mask];
+                on_complete(static_cast<uint32_t>(cqe.user_data), cqe.res);
+            }
+
+            std::atomic_ref{*cq_head}.store(head, std::memory_order_release);
+        }
+
+    private:
+        int ring_fd = -1;
+
+        void* sq_ring = nullptr;
+        size_t sq_ring_size = 0;
+
+        void* cq_ring = nullptr;
+        size_t cq_ring_size = 0;
+
+        io_uring_sqe* sqes = nullptr;
+        size_t sqes_size = 0;
+
+        uint32_t* sq_tail = nullptr;
+        uint32_t sq_mask = 0;
+        uint32_t* sq_array = nullptr;
+
+        uint32_t* cq_head = nullptr;
+        uint32_t* cq_tail = nullptr;
+        uint32_t cq_mask = 0;
+        io_uring_cqe* cqes = nullptr;
+
+        uint32_t num_unsubmitted_reads = 0;
+
+        /*!
+         * \brief Each slot's read, which the kernel reads when the read is submitted
+         */
+        std::vector<iovec> iovecs;
+
+        [[nodiscard]] void* map_ring(const size_t size, const off_t offset) const {
+            auto* ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+            return ring == MAP_FAILED ? nullptr : ring;
+        }
+
+        void unmap() {
+            if(sqes != nullptr) {
+                munmap(sqes, sqes_size);
+            }
+            if(cq_ring != nullptr && cq_ring != sq_ring) {
+                munmap(cq_ring, cq_ring_size);
+            }
+            if(sq_ring != nullptr) {
+                munmap(sq_ring, sq_ring_size);
+            }
+            if(ring_fd >= 0) {
+                close(ring_fd);
+            }
+
+            sqes = nullptr;
+            cq_ring = nullptr;
+            sq_ring = nullptr;
+            ring_fd = -1;
+        }
+    };
+#endif
+
+    static std::unique_ptr<AsyncIoBackend> create_backend(const uint32_t queue_depth) {
+#ifdef NOVA_WINDOWS
+        return std::make_unique<IocpBackend>(queue_depth);
+#else
+#ifdef NOVA_HAS_IO_URING
+        // Old kernels and some sandboxes don't have io_uring
+        if(auto io_uring = std::make_unique<IoUringBackend>(queue_depth); io_uring->is_valid()) {
+            return io_uring;
+        }
+#endif
+
+        return std::make_unique<BlockingIoBackend>();
+#endif
+    }
+
+    AsyncFileReader& AsyncFileReader::get_instance() {
+        static AsyncFileReader reader;
+        return reader;
+    }
+
+    AsyncFileReader::AsyncFileReader() : backend{create_backend(MAX_READS_IN_FLIGHT)}, slots(MAX_READS_IN_FLIGHT) {
+        free_slots.reserve(MAX_READS_IN_FLIGHT);
+        for(uint32_t i = MAX_READS_IN_FLIGHT; i > 0; i--) {
+            free_slots.push_back(i - 1);
+        }
+
+        io_thread = std::thread{[this] { io_thread_loop(); }};
+    }
+
+    AsyncFileReader::~AsyncFileReader() {
+        {
+            std::lock_guard lock{queue_mutex};
+            should_stop = true;
+        }
+
+        queue_cv.notify_one();
+        io_thread.join();
+    }
+
+    std::future<std::vector<uint8_t>> AsyncFileReader::read_file(std::string path, const IoPriority priority) {
+        auto request = std::make_unique<Request>();
+        request->path = std::move(path);
+        request->priority = priority;
+        request->is_whole_file = true;
+
+        auto future = std::get<std::promise<std::vector<uint8_t>>>(request->promise).get_future();
+        enqueue(std::move(request));
+
+        return future;
+    }
+
+    std::future<std::optional<uint64_t>> AsyncFileReader::read_file_into(std::string path,
+                                                                         const uint64_t file_offset,
+                                                                         const std::span<uint8_t> destination,
+                                                                         const IoPriority priority) {
+        auto request = std::make_unique<Request>();
+        request->path = std::move(path);
+        request->priority = priority;
+        request->file_offset = file_offset;
+        request->destination = destination;
+        request->promise = std::promise<std::optional<uint64_t>>{};
+
+        auto future = std::get<std::promise<std::optional<uint64_t>>>(request->promise).get_future();
+        enqueue(std::move(request));
+
+        return future;
+    }
+
+    void AsyncFileReader::enqueue(std::unique_ptr<Request> request) {
+        {
+            std::lock_guard lock{queue_mutex};
+            queued_requests.push_back(std::move(request));
+        }
+
+        queue_cv.notify_one();
+    }
+
+    void AsyncFileReader::io_thread_loop() {
+        while(true) {
+            const bool has_reads_in_flight = free_slots.size() < slots.size();
+            bool is_stopping;
+            {
+                std::unique_lock lock{queue_mutex};
+                if(!has_reads_in_flight) {
+                    queue_cv.wait(lock, [&] { return should_stop || !queued_requests.empty() || !active_requests.empty(); });
+                }
+
+                is_stopping = should_stop;
+                if(!is_stopping) {
+                    while(!queued_requests.empty()) {
+                        active_requests.push_back(std::move(queued_requests.front()));
+                        queued_requests.pop_front();
+                    }
+                }
+            }
+
+            // The kernel may still be writing into the reads in flight, so they have to finish before their requests go away
+            if(is_stopping && !has_reads_in_flight) {
+                break;
+            }
+
+            if(!is_stopping) {
+                submit_reads();
+            }
+
+            if(free_slots.size() < slots.size()) {
+                backend->wait_for_completions([this](const uint32_t slot, const int64_t result) { complete_read(slot, result); });
+            }
+
+            finish_requests();
+        }
+
+        for(const auto& request : active_requests) {
+            if(request->file) {
+                backend->close_file(*request->file);
+            }
+        }
+        active_requests.clear();
+    }
+
+    void AsyncFileReader::open_request_file(Request& request) {
+        request.file = backend->open_file(request.path);
+        if(!request.file) {
+            logger->error("Could not open file {}", request.path);
+            request.failed = true;
+            return;
+        }
+
+        if(request.is_whole_file) {
+            request.file_data.resize(request.file->size);
+            request.destination = request.file_data;
+
+        } else {
+            const auto bytes_after_offset = request.file_offset < request.file->size ? request.file->size - request.file_offset : 0;
+            request.destination = request.destination.first(std::min<uint64_t>(request.destination.size(), bytes_after_offset));
+        }
+    }
+
+    void AsyncFileReader::submit_reads() {
+        ZoneScoped;
+        for(const auto priority : {IoPriority::Blocking, IoPriority::Streaming}) {
+            for(const auto& request : active_requests) {
+                if(request->priority != priority) {
+                    continue;
+                }
+
+                // Files are opened when they get their first slot, so a long queue doesn't run out of file handles
+                while(!free_slots.empty() && !request->failed) {
+                    if(!request->file) {
+                        open_request_file(*request);
+                        continue;
+                    }
+
+                    uint64_t destination_offset;
+                    uint32_t num_bytes;
+                    if(!request->ranges_to_retry.empty()) {
+                        std::tie(destination_offset, num_bytes) = request->ranges_to_retry.back();
+                        request->ranges_to_retry.pop_back();
+
+                    } else if(request->num_bytes_submitted < request->destination.size()) {
+                        destination_offset = request->num_bytes_submitted;
+                        num_bytes = static_cast<uint32_t>(
+                            std::min<uint64_t>(CHUNK_SIZE, request->destination.size() - request->num_bytes_submitted));
+                        request->num_bytes_submitted += num_bytes;
+
+                    } else {
+                        break;
+                    }
+
+                    const auto slot_idx = free_slots.back();
+                    free_slots.pop_back();
+                    slots[slot_idx] = {request.get(), destination_offset, num_bytes};
+                    request->num_reads_in_flight++;
+
+                    backend->submit_read(*request->file,
+                                         request->file_offset + destination_offset,
+                                         request->destination.data() + destination_offset,
+                                         num_bytes,
+                                         slot_idx);
+                }
+
+                if(free_slots.empty()) {
+                    return;
+                }
+            }
+        }
+    }
+
+    void AsyncFileReader::complete_read(const uint32_t slot_idx, const int64_t result) {
+        auto& slot = slots[slot_idx];
+        auto& request = *slot.request;
+        request.num_reads_in_flight--;
+
+        if(result <= 0) {
+            // Reading nothing means the file got shorter since we opened it
+            if(!request.failed) {
+                logger->error("Could not read {} bytes at offset {} of file {}",
+                              slot.num_bytes,
+                              request.file_offset + slot.destination_offset,
+                              request.path);
+            }
+            request.failed = true;
+
+        } else if(result < slot.num_bytes) {
+            const auto num_bytes_read = static_cast<uint32_t>(result);
+            request.ranges_to_retry.emplace_back(slot.destination_offset + num_bytes_read, slot.num_bytes - num_bytes_read);
+        }
+
+        slot = {};
+        free_slots.push_back(slot_idx);
+    }
+
+    void AsyncFileReader::finish_requests() {
+        for(auto& request : active_requests) {
+            const bool is_done = request->num_reads_in_flight == 0 &&
+                                 (request->failed || (request->file && request->ranges_to_retry.empty() &&
+                                                      request->num_bytes_submitted == request->destination.size()));
+            if(!is_done) {
+                continue;
+            }
+
+            if(request->file) {
+                backend->close_file(*request->file);
+            }
+
+            if(auto* file_promise = std::get_if<std::promise<std::vector<uint8_t>>>(&request->promise)) {
+                file_promise->set_value(request->failed ? std::vector<uint8_t>{} : std::move(request->file_data));
+
+            } else {
+                std::get<std::promise<std::optional<uint64_t>>>(request->promise)
+                    .set_value(request->failed ? std::nullopt : std::optional<uint64_t>{request->destination.size()});
+            }
+
+            request.reset();
+        }
+
+        std::erase(active_requests, nullptr);
+    }
+} // namespace nova::filesystem
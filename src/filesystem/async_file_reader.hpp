@@ -0,0 +1,215 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "nova_renderer/filesystem/folder_accessor.hpp"
+
+namespace nova::filesystem {
+    /*!
+     * \brief An open file, as the I/O backend sees it
+     */
+    struct AsyncFileHandle {
+        /*!
+         * \brief A file descriptor, or a Windows `HANDLE`
+         */
+        intptr_t handle = 0;
+
+        uint64_t size = 0;
+    };
+
+    /*!
+     * \brief What actually talks to the OS. Only the reader's I/O thread uses it
+     */
+    class AsyncIoBackend {
+    public:
+        AsyncIoBackend() = default;
+
+        AsyncIoBackend(const AsyncIoBackend& other) = delete;
+        AsyncIoBackend& operator=(const AsyncIoBackend& other) = delete;
+
+        AsyncIoBackend(AsyncIoBackend&& old) noexcept = delete;
+        AsyncIoBackend& operator=(AsyncIoBackend&& old) noexcept = delete;
+
+        virtual ~AsyncIoBackend() = default;
+
+        [[nodiscard]] virtual std::optional<AsyncFileHandle> open_file(const std::string& path) = 0;
+
+        virtual void close_file(const AsyncFileHandle& file) = 0;
+
+        /*!
+         * \brief Queues a read into a slot. Reads aren't necessarily started until `wait_for_completions`
+         *
+         * \param slot Which of the reader's slots the read belongs to. No slot has more than one read in flight
+         */
+        virtual void submit_read(const AsyncFileHandle& file, uint64_t offset, uint8_t* destination, uint32_t num_bytes, uint32_t slot) = 0;
+
+        /*!
+         * \brief Starts every queued read, waits for at least one read to finish, and calls `on_complete` for each read that did
+         *
+         * `on_complete` gets the read's slot and how many bytes it read, or a negative number if it failed
+         */
+        virtual void wait_for_completions(const std::function<void(uint32_t slot, int64_t result)>& on_complete) = 0;
+    };
+
+    /*!
+     * \brief Reads files on a dedicated I/O thread, keeping many reads in flight at once so that fast drives stay busy
+     *
+     * Files are read in chunks of `CHUNK_SIZE` bytes, with up to `MAX_READS_IN_FLIGHT` chunks in flight across all files. Linux reads
+     * through io_uring and Windows through an I/O completion port, so one thread keeps the whole queue full. If io_uring isn't available,
+     * the I/O thread reads one chunk at a time instead, which still gets the waiting off of the threads that asked for the files
+     *
+     * Blocking reads get the free slots before streaming reads do, so a loading screen doesn't wait behind background streaming
+     *
+     * This class is thread-safe
+     */
+    class AsyncFileReader {
+    public:
+        static constexpr uint32_t CHUNK_SIZE = 256 * 1024;
+
+        static constexpr uint32_t MAX_READS_IN_FLIGHT = 64;
+
+        /*!
+         * \brief The reader that every folder accessor shares, so all their reads go in the same queue
+         */
+        [[nodiscard]] static AsyncFileReader& get_instance();
+
+        AsyncFileReader();
+
+        AsyncFileReader(const AsyncFileReader& other) = delete;
+        AsyncFileReader& operator=(const AsyncFileReader& other) = delete;
+
+        AsyncFileReader(AsyncFileReader&& old) noexcept = delete;
+        AsyncFileReader& operator=(AsyncFileReader&& old) noexcept = delete;
+
+        /*!
+         * \brief Waits for the reads that are in flight. Reads that haven't started get broken promises
+         */
+        ~AsyncFileReader();
+
+        /*!
+         * \brief Reads a whole file
+         *
+         * \param path The path to the file, relative to Nova's working directory
+         * \return The file's bytes, or an empty vector if it couldn't be read
+         */
+        [[nodiscard]] std::future<std::vector<uint8_t>> read_file(std::string path, IoPriority priority);
+
+        /*!
+         * \brief Reads part of a file straight into some memory, like a mapped staging buffer
+         *
+         * \param path The path to the file, relative to Nova's working directory
+         * \param file_offset Where in the file to start reading
+         * \param destination Where to put the bytes. Must stay alive until the future is ready. Reads stop at the end of the file
+         * \return How many bytes were read, or nothing if the file couldn't be read
+         */
+        [[nodiscard]] std::future<std::optional<uint64_t>> read_file_into(std::string path,
+                                                                          uint64_t file_offset,
+                                                                          std::span<uint8_t> destination,
+                                                                          IoPriority priority);
+
+    private:
+        struct Request {
+            std::string path;
+
+            IoPriority priority = IoPriority::Blocking;
+
+            uint64_t file_offset = 0;
+
+            /*!
+             * \brief Where the bytes go. Empty for whole-file reads until the file is open, when it becomes `file_data`
+             */
+            std::span<uint8_t> destination;
+
+            bool is_whole_file = false;
+
+            std::vector<uint8_t> file_data;
+
+            std::variant<std::promise<std::vector<uint8_t>>, std::promise<std::optional<uint64_t>>> promise;
+
+            std::optional<AsyncFileHandle> file;
+
+            /*!
+             * \brief How many bytes of `destination` have been asked for
+             */
+            uint64_t num_bytes_submitted = 0;
+
+            /*!
+             * \brief Ranges of `destination` that a short read left unread, as offset and size. They're asked for again before anything
+             * new
+             */
+            std::vector<std::pair<uint64_t, uint32_t>> ranges_to_retry;
+
+            uint32_t num_reads_in_flight = 0;
+
+            bool failed = false;
+        };
+
+        /*!
+         * \brief One read in flight
+         */
+        struct Slot {
+            Request* request = nullptr;
+
+            /*!
+             * \brief Where the read starts in the request's destination
+             */
+            uint64_t destination_offset = 0;
+
+            uint32_t num_bytes = 0;
+        };
+
+        std::unique_ptr<AsyncIoBackend> backend;
+
+        std::mutex queue_mutex;
+
+        std::condition_variable queue_cv;
+
+        std::deque<std::unique_ptr<Request>> queued_requests;
+
+        bool should_stop = false;
+
+        /*!
+         * \brief The requests that the I/O thread is working on, oldest first. Only the I/O thread touches these
+         */
+        std::vector<std::unique_ptr<Request>> active_requests;
+
+        std::vector<Slot> slots;
+
+        std::vector<uint32_t> free_slots;
+
+        std::thread io_thread;
+
+        void enqueue(std::unique_ptr<Request> request);
+
+        void io_thread_loop();
+
+        /*!
+         * \brief Opens a request's file if it isn't open yet. Fails the request if the file can't be opened
+         */
+        void open_request_file(Request& request);
+
+        /*!
+         * \brief Fills free slots with reads, blocking requests first
+         */
+        void submit_reads();
+
+        void complete_read(uint32_t slot_idx, int64_t result);
+
+        /*!
+         * \brief Hands the requests that are done to their futures
+         */
+        void finish_requests();
+    };
+} // namespace nova::filesystem
@@ -1,5 +1,7 @@
 #include "nova_renderer/filesystem/folder_accessor.hpp"
 
+#include <algorithm>
+
 #include <rx/core/concurrency/scope_lock.h>
 #include <rx/core/log.h>
 
@@ -39,6 +41,40 @@ namespace nova::filesystem {
         return does_resource_exist_on_filesystem(full_path);
     }
 
+    FileView FolderAccessorBase::map_file(const rx::string& path) {
+        auto bytes = std::make_shared<const rx::vector<uint8_t>>(read_file(path));
+        const std::span<const uint8_t> view{bytes->data(), bytes->size()};
+
+        return {std::move(bytes), view};
+    }
+
+    std::future<rx::vector<uint8_t>> FolderAccessorBase::read_file_async(const rx::string& path, IoPriority /* priority */) {
+        std::promise<rx::vector<uint8_t>> bytes;
+        bytes.set_value(read_file(path));
+
+        return bytes.get_future();
+    }
+
+    std::future<rx::optional<uint64_t>> FolderAccessorBase::read_file_into_async(const rx::string& path,
+                                                                                 const uint64_t file_offset,
+                                                                                 const std::span<uint8_t> destination,
+                                                                                 IoPriority /* priority */) {
+        std::promise<rx::optional<uint64_t>> num_bytes_read;
+
+        const auto file = map_file(path);
+        if(file.is_empty()) {
+            num_bytes_read.set_value(rx::nullopt);
+
+        } else {
+            const auto bytes = file.get_bytes();
+            const auto num_bytes = file_offset < bytes.size() ? std::min<uint64_t>(destination.size(), bytes.size() - file_offset) : 0;
+            std::copy_n(bytes.data() + file_offset, num_bytes, destination.data());
+            num_bytes_read.set_value(num_bytes);
+        }
+
+        return num_bytes_read.get_future();
+    }
+
     rx::string FolderAccessorBase::read_text_file(const rx::string& resource_path) {
         auto buf = read_file(resource_path);
         return buf.disown();
@@ -52,6 +88,8 @@ namespace nova::filesystem {
         return rx::nullopt;
     }
 
+    rx::optional<std::vector<std::string_view>> FolderAccessorBase::get_indexed_paths() const { return rx::nullopt; }
+
     const rx::string& FolderAccessorBase::get_root() const { return root_folder; }
 
     bool has_root(const rx::string& path, const rx::string& root) { return path.begins_with(root); }
@@ -0,0 +1,78 @@
+#include "folder_watcher.hpp"
+
+#include <Tracy.hpp>
+#include <rx/core/log.h>
+
+namespace nova::filesystem {
+    RX_LOG("FolderWatcher", logger);
+
+    FolderWatcher::FolderWatcher(const std::string& root) : root{root} {
+        std::error_code err;
+        root_is_archive = std::filesystem::is_regular_file(this->root, err);
+        if(err) {
+            logger->error("Could not watch %s: %s", root, err.message());
+        }
+
+        write_times = get_write_times();
+    }
+
+    std::vector<std::string> FolderWatcher::poll() {
+        ZoneScoped;
+        auto new_write_times = get_write_times();
+
+        std::vector<std::string> changed_files;
+        for(const auto& [path, write_time] : new_write_times) {
+            if(const auto itr = write_times.find(path); itr == write_times.end() || itr->second != write_time) {
+                changed_files.push_back(path);
+            }
+        }
+
+        for(const auto& [path, write_time] : write_times) {
+            if(new_write_times.find(path) == new_write_times.end()) {
+                changed_files.push_back(path);
+            }
+        }
+
+        write_times = std::move(new_write_times);
+
+        return changed_files;
+    }
+
+    bool FolderWatcher::is_watching_archive() const { return root_is_archive; }
+
+    std::unordered_map<std::string, std::filesystem::file_time_type> FolderWatcher::get_write_times() const {
+        std::unordered_map<std::string, std::filesystem::file_time_type> times;
+
+        // This runs while the user is saving files, so files may disappear halfway through. Skip anything we can't read instead of
+        // failing the whole poll
+        if(root_is_archive) {
+            std::error_code err;
+            if(const auto write_time = std::filesystem::last_write_time(root, err); !err) {
+                times.emplace("", write_time);
+            }
+
+            return times;
+        }
+
+        std::error_code iteration_err;
+        auto itr = std::filesystem::recursive_directory_iterator(root, iteration_err);
+        for(; !iteration_err && itr != std::filesystem::recursive_directory_iterator{}; itr.increment(iteration_err)) {
+            std::error_code file_err;
+            if(!itr->is_regular_file(file_err)) {
+                continue;
+            }
+
+            const auto write_time = itr->last_write_time(file_err);
+            if(file_err) {
+                continue;
+            }
+
+            const auto relative_path = std::filesystem::relative(itr->path(), root, file_err);
+            if(!file_err) {
+                times.emplace(relative_path.generic_string(), write_time);
+            }
+        }
+
+        return times;
+    }
+} // namespace nova::filesystem
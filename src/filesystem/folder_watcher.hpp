@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nova::filesystem {
+    /*!
+     * \brief Finds out which files in a folder changed, by polling their modification times
+     *
+     * Polling walks the whole folder, so don't do it every frame. Twice a second is plenty for someone saving a shader in their editor
+     *
+     * Zip archives are watched as a single file, since the only way to change a file inside one is to write the whole archive again
+     */
+    class FolderWatcher {
+    public:
+        /*!
+         * \brief Starts watching a folder or zip archive. Files that exist now don't count as changed
+         *
+         * \param root The folder or zip archive to watch, relative to Nova's working directory
+         */
+        explicit FolderWatcher(const std::string& root);
+
+        /*!
+         * \brief Gets every file that was added, removed, or written since the last poll
+         *
+         * \return The paths of the changed files, relative to the watched folder. If the watched root is a zip archive, the only path that
+         * may be returned is the empty string, which means that the archive changed
+         */
+        [[nodiscard]] std::vector<std::string> poll();
+
+        [[nodiscard]] bool is_watching_archive() const;
+
+    private:
+        std::filesystem::path root;
+
+        bool root_is_archive;
+
+        std::unordered_map<std::string, std::filesystem::file_time_type> write_times;
+
+        [[nodiscard]] std::unordered_map<std::string, std::filesystem::file_time_type> get_write_times() const;
+    };
+} // namespace nova::filesystem
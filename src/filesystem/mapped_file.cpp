@@ -0,0 +1,138 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#include <rx/core/log.h>
+
+#ifdef NOVA_WINDOWS
+#include "nova_renderer/util/windows.hpp"
+#elif defined(NOVA_LINUX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nova::filesystem {
+    RX_LOG("MappedFile", logger);
+
+#ifdef NOVA_WINDOWS
+    MappedFile::MappedFile(const char* path) {
+        file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file_handle == INVALID_HANDLE_VALUE) {
+            logger->error("Could not open file %s", path);
+            file_handle = nullptr;
+            return;
+        }
+
+        LARGE_INTEGER file_size;
+        if(GetFileSizeEx(file_handle, &file_size) == 0 || file_size.QuadPart == 0) {
+            logger->error("Could not get the size of file %s, or it's empty", path);
+            unmap();
+            return;
+        }
+
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping_handle == nullptr) {
+            logger->error("Could not create a mapping of file %s", path);
+            unmap();
+            return;
+        }
+
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        if(data == nullptr) {
+            logger->error("Could not map file %s", path);
+            unmap();
+            return;
+        }
+
+        size = static_cast<uint64_t>(file_size.QuadPart);
+    }
+
+    void MappedFile::unmap() {
+        if(data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if(mapping_handle != nullptr) {
+            CloseHandle(mapping_handle);
+        }
+        if(file_handle != nullptr) {
+            CloseHandle(file_handle);
+        }
+
+        data = nullptr;
+        size = 0;
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+    }
+
+#elif defined(NOVA_LINUX)
+    MappedFile::MappedFile(const char* path) {
+        const auto fd = open(path, O_RDONLY);
+        if(fd == -1) {
+            logger->error("Could not open file %s", path);
+            return;
+        }
+
+        struct stat file_stat = {};
+        if(fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+            logger->error("Could not get the size of file %s, or it's empty", path);
+            close(fd);
+            return;
+        }
+
+        // The mapping keeps the file alive, so we don't need the descriptor after this
+        auto* mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if(mapping == MAP_FAILED) {
+            logger->error("Could not map file %s", path);
+            return;
+        }
+
+        data = static_cast<const uint8_t*>(mapping);
+        size = static_cast<uint64_t>(file_stat.st_size);
+    }
+
+    void MappedFile::unmap() {
+        if(data != nullptr) {
+            munmap(const_cast<uint8_t*>(data), static_cast<size_t>(size));
+        }
+
+        data = nullptr;
+        size = 0;
+    }
+#endif
+
+    MappedFile::MappedFile(MappedFile&& old) noexcept
+        : data{std::exchange(old.data, nullptr)},
+          size{std::exchange(old.size, 0)}
+#ifdef NOVA_WINDOWS
+          ,
+          file_handle{std::exchange(old.file_handle, nullptr)},
+          mapping_handle{std::exchange(old.mapping_handle, nullptr)}
+#endif
+    {
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& old) noexcept {
+        if(this != &old) {
+            unmap();
+
+            data = std::exchange(old.data, nullptr);
+            size = std::exchange(old.size, 0);
+#ifdef NOVA_WINDOWS
+            file_handle = std::exchange(old.file_handle, nullptr);
+            mapping_handle = std::exchange(old.mapping_handle, nullptr);
+#endif
+        }
+
+        return *this;
+    }
+
+    MappedFile::~MappedFile() { unmap(); }
+
+    bool MappedFile::is_valid() const { return data != nullptr; }
+
+    std::span<const uint8_t> MappedFile::get_data() const { return {data, static_cast<size_t>(size)}; }
+} // namespace nova::filesystem
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "nova_renderer/util/platform.hpp"
+
+namespace nova::filesystem {
+    /*!
+     * \brief A read-only view of a whole file, mapped into our address space
+     *
+     * The OS pages the file in as we touch it, so opening even a huge archive is cheap and the bytes we never read never leave the disk
+     */
+    class MappedFile {
+    public:
+        /*!
+         * \brief Maps the file at the provided path. Check `is_valid` to see if that worked
+         */
+        explicit MappedFile(const char* path);
+
+        MappedFile(MappedFile&& old) noexcept;
+        MappedFile& operator=(MappedFile&& old) noexcept;
+
+        MappedFile(const MappedFile& other) = delete;
+        MappedFile& operator=(const MappedFile& other) = delete;
+
+        ~MappedFile();
+
+        [[nodiscard]] bool is_valid() const;
+
+        [[nodiscard]] std::span<const uint8_t> get_data() const;
+
+    private:
+        const uint8_t* data = nullptr;
+
+        uint64_t size = 0;
+
+#ifdef NOVA_WINDOWS
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+
+        void unmap();
+    };
+} // namespace nova::filesystem
@@ -0,0 +1,300 @@
+#include "path_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+#include "../loading/renderpack/spirv_cache.hpp"
+
+namespace nova::filesystem {
+    static auto logger = make_logger("PathIndex");
+
+    constexpr uint32_t INDEX_FILE_MAGIC = 0x5849504E; // "NPIX"
+
+    /*!
+     * \brief Version of the index file's layout. Bump this whenever `save` writes something different
+     */
+    constexpr uint32_t INDEX_FILE_VERSION = 1;
+
+    static std::string_view trim_trailing_slashes(std::string_view path) {
+        while(!path.empty() && path.back() == '/') {
+            path.remove_suffix(1);
+        }
+
+        return path;
+    }
+
+    static bool is_before(const std::string& path, const std::string_view other) { return std::string_view{path} < other; }
+
+    template <typename ValueType>
+    static void append_value(std::string& bytes, const ValueType value) {
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(ValueType));
+    }
+
+    template <typename ValueType>
+    static bool read_value(std::span<const char>& bytes, ValueType& value) {
+        if(bytes.size() < sizeof(ValueType)) {
+            return false;
+        }
+
+        memcpy(&value, bytes.data(), sizeof(ValueType));
+        bytes = bytes.subspan(sizeof(ValueType));
+        return true;
+    }
+
+    PathIndex::PathIndex(std::vector<std::pair<std::string, uint32_t>> entries) {
+        ZoneScoped;
+        // The views point into `entries`, which doesn't change until we're done with them
+        std::unordered_map<std::string_view, uint32_t> values_by_path;
+        values_by_path.reserve(entries.size() * 2);
+
+        for(const auto& [path, value] : entries) {
+            const auto trimmed_path = trim_trailing_slashes(path);
+            if(!trimmed_path.empty()) {
+                // Zip archives may have the same path twice. Miniz finds the first one, so that's the one we keep
+                values_by_path.try_emplace(trimmed_path, trimmed_path.size() == path.size() ? value : FOLDER);
+            }
+        }
+
+        // Add the folders that every path is in. Once we find a folder that's already there, its parents are there too - either some
+        // other path added them on its way up, or that folder is an entry itself and adds its own parents
+        for(const auto& [path, value] : entries) {
+            const auto trimmed_path = trim_trailing_slashes(path);
+            for(auto slash = trimmed_path.rfind('/'); slash != std::string_view::npos && slash > 0;
+                slash = trimmed_path.rfind('/', slash - 1)) {
+                if(!values_by_path.try_emplace(trimmed_path.substr(0, slash), FOLDER).second) {
+                    break;
+                }
+            }
+        }
+
+        std::vector<std::pair<std::string_view, uint32_t>> sorted_entries(values_by_path.begin(), values_by_path.end());
+        std::sort(sorted_entries.begin(), sorted_entries.end());
+
+        sorted_paths.reserve(sorted_entries.size());
+        values.reserve(sorted_entries.size());
+        for(const auto& [path, value] : sorted_entries) {
+            sorted_paths.emplace_back(path);
+            values.push_back(value);
+        }
+
+        build_lookup();
+    }
+
+    std::optional<uint32_t> PathIndex::find(const std::string_view path) const {
+        const auto trimmed_path = trim_trailing_slashes(path);
+        if(trimmed_path.empty()) {
+            return FOLDER;
+        }
+
+        if(const auto itr = indices_by_path.find(trimmed_path); itr != indices_by_path.end()) {
+            return values[itr->second];
+        }
+
+        return std::nullopt;
+    }
+
+    std::vector<std::string> PathIndex::list_folder(const std::string_view folder) const {
+        const auto trimmed_folder = trim_trailing_slashes(folder);
+        const auto paths = get_paths_in(trimmed_folder);
+        const auto prefix_size = trimmed_folder.empty() ? 0 : trimmed_folder.size() + 1;
+
+        std::vector<std::string> names;
+        for(auto itr = paths.begin(); itr != paths.end();) {
+            const auto name = std::string_view{*itr}.substr(prefix_size);
+            const auto slash = name.find('/');
+            if(slash == std::string_view::npos) {
+                names.emplace_back(name);
+                ++itr;
+                continue;
+            }
+
+            // This is in a subfolder, which we already listed. Skip past everything else in it. '0' comes right after '/'
+            auto subfolder_end = std::string{std::string_view{*itr}.substr(0, prefix_size + slash)};
+            subfolder_end += '0';
+            itr = std::lower_bound(itr, paths.end(), subfolder_end, is_before);
+        }
+
+        return names;
+    }
+
+    std::span<const std::string> PathIndex::get_paths_in(const std::string_view folder) const {
+        const auto trimmed_folder = trim_trailing_slashes(folder);
+        if(trimmed_folder.empty()) {
+            return sorted_paths;
+        }
+
+        // Everything in the folder starts with "folder/", and sorts before "folder0"
+        auto prefix = std::string{trimmed_folder};
+        prefix += '/';
+        const auto begin = std::lower_bound(sorted_paths.begin(), sorted_paths.end(), prefix, is_before);
+
+        prefix.back() = '0';
+        const auto end = std::lower_bound(begin, sorted_paths.end(), prefix, is_before);
+
+        return {begin, end};
+    }
+
+    size_t PathIndex::size() const { return sorted_paths.size(); }
+
+    bool PathIndex::save(const std::filesystem::path& path, const uint64_t key) const {
+        ZoneScoped;
+        std::string bytes;
+        append_value(bytes, INDEX_FILE_MAGIC);
+        append_value(bytes, INDEX_FILE_VERSION);
+        append_value(bytes, key);
+        append_value(bytes, static_cast<uint64_t>(sorted_paths.size()));
+
+        for(size_t i = 0; i < sorted_paths.size(); i++) {
+            append_value(bytes, values[i]);
+            append_value(bytes, static_cast<uint32_t>(sorted_paths[i].size()));
+            bytes += sorted_paths[i];
+        }
+
+        std::error_code err;
+        std::filesystem::create_directories(path.parent_path(), err);
+
+        auto temp_path = path;
+        temp_path += ".tmp";
+
+        {
+            std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+            if(!file) {
+                logger->warn("Could not open {} to save a path index", temp_path.string());
+                return false;
+            }
+
+            file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+
+        std::filesystem::rename(temp_path, path, err);
+        if(err) {
+            logger->warn("Could not save path index to {}: {}", path.string(), err.message());
+            return false;
+        }
+
+        return true;
+    }
+
+    std::optional<PathIndex> PathIndex::load(const std::filesystem::path& path, const uint64_t key) {
+        ZoneScoped;
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if(!file) {
+            return std::nullopt;
+        }
+
+        std::vector<char> file_bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(file_bytes.data(), static_cast<std::streamsize>(file_bytes.size()));
+        if(!file) {
+            return std::nullopt;
+        }
+
+        std::span<const char> bytes = file_bytes;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint64_t saved_key = 0;
+        uint64_t num_paths = 0;
+        if(!read_value(bytes, magic) || !read_value(bytes, version) || !read_value(bytes, saved_key) || !read_value(bytes, num_paths) ||
+           magic != INDEX_FILE_MAGIC) {
+            logger->warn("Path index {} is corrupt, ignoring it", path.string());
+            return std::nullopt;
+        }
+
+        if(version != INDEX_FILE_VERSION || saved_key != key) {
+            return std::nullopt;
+        }
+
+        // Every path takes at least eight bytes, so a count bigger than that is corrupt and we shouldn't reserve for it
+        if(num_paths > bytes.size() / 8) {
+            logger->warn("Path index {} is corrupt, ignoring it", path.string());
+            return std::nullopt;
+        }
+
+        std::vector<std::string> sorted_paths;
+        std::vector<uint32_t> values;
+        sorted_paths.reserve(num_paths);
+        values.reserve(num_paths);
+
+        for(uint64_t i = 0; i < num_paths; i++) {
+            uint32_t value = 0;
+            uint32_t path_size = 0;
+            if(!read_value(bytes, value) || !read_value(bytes, path_size) || bytes.size() < path_size) {
+                logger->warn("Path index {} is corrupt, ignoring it", path.string());
+                return std::nullopt;
+            }
+
+            std::string_view indexed_path{bytes.data(), path_size};
+            bytes = bytes.subspan(path_size);
+
+            // Lookups and listings both need the paths to be sorted and unique
+            if(!sorted_paths.empty() && !is_before(sorted_paths.back(), indexed_path)) {
+                logger->warn("Path index {} is corrupt, ignoring it", path.string());
+                return std::nullopt;
+            }
+
+            sorted_paths.emplace_back(indexed_path);
+            values.push_back(value);
+        }
+
+        return PathIndex{std::move(sorted_paths), std::move(values)};
+    }
+
+    PathIndex::PathIndex(std::vector<std::string> sorted_paths, std::vector<uint32_t> values)
+        : sorted_paths{std::move(sorted_paths)}, values{std::move(values)} {
+        build_lookup();
+    }
+
+    void PathIndex::build_lookup() {
+        indices_by_path.reserve(sorted_paths.size());
+        for(uint32_t i = 0; i < sorted_paths.size(); i++) {
+            indices_by_path.emplace(sorted_paths[i], i);
+        }
+    }
+
+    PathIndexCache& PathIndexCache::get_instance() {
+        static PathIndexCache instance;
+
+        return instance;
+    }
+
+    void PathIndexCache::configure(std::filesystem::path directory) {
+        std::lock_guard lock{cache_mutex};
+
+        cache_directory = std::move(directory);
+    }
+
+    std::optional<PathIndex> PathIndexCache::find(const std::string_view archive_path, const uint64_t key) const {
+        const auto path = get_path_for_archive(archive_path);
+        if(path.empty()) {
+            return std::nullopt;
+        }
+
+        return PathIndex::load(path, key);
+    }
+
+    void PathIndexCache::store(const std::string_view archive_path, const uint64_t key, const PathIndex& index) const {
+        const auto path = get_path_for_archive(archive_path);
+        if(!path.empty()) {
+            index.save(path, key);
+        }
+    }
+
+    std::filesystem::path PathIndexCache::get_path_for_archive(const std::string_view archive_path) const {
+        std::lock_guard lock{cache_mutex};
+        if(cache_directory.empty()) {
+            return {};
+        }
+
+        renderer::renderpack::Fnv1aHasher hasher;
+        hasher.add(archive_path);
+
+        return cache_directory / fmt::format("{:016x}.paths", hasher.get());
+    }
+} // namespace nova::filesystem
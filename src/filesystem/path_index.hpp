@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nova::filesystem {
+    /*!
+     * \brief Every file and folder under a root, so finding one is a hash lookup instead of a walk through a tree or a question for the OS
+     *
+     * Paths are relative to the root, separated by `/`, and don't end with a slash. Each path has a value that the accessor picks, like
+     * the file's index in a zip archive. Folders that only exist because there's something in them are in the index too
+     *
+     * A sorted copy of the paths serves folder listings, since everything in a folder is one contiguous range of it
+     */
+    class PathIndex {
+    public:
+        /*!
+         * \brief The value of every folder
+         */
+        static constexpr uint32_t FOLDER = 0xFFFFFFFF;
+
+        PathIndex() = default;
+
+        /*!
+         * \brief Indexes the provided paths, and all the folders they're in
+         *
+         * \param entries Every path and its value. Paths that end with a slash are folders, no matter what their value is
+         */
+        explicit PathIndex(std::vector<std::pair<std::string, uint32_t>> entries);
+
+        PathIndex(PathIndex&& old) noexcept = default;
+        PathIndex& operator=(PathIndex&& old) noexcept = default;
+
+        // The lookup map has views of the sorted paths, so copies would point into the original
+        PathIndex(const PathIndex& other) = delete;
+        PathIndex& operator=(const PathIndex& other) = delete;
+
+        ~PathIndex() = default;
+
+        /*!
+         * \brief Gets the value of a path, or nothing if the path isn't in the index
+         */
+        [[nodiscard]] std::optional<uint32_t> find(std::string_view path) const;
+
+        /*!
+         * \brief Gets the names of everything directly in a folder. The root folder is the empty string
+         */
+        [[nodiscard]] std::vector<std::string> list_folder(std::string_view folder) const;
+
+        /*!
+         * \brief Gets every path under a folder, in sorted order. The root folder is the empty string, which gets every path
+         */
+        [[nodiscard]] std::span<const std::string> get_paths_in(std::string_view folder) const;
+
+        [[nodiscard]] size_t size() const;
+
+        /*!
+         * \brief Writes the index to a file, along with a key that says what it indexed
+         *
+         * The file is written somewhere else first, and then moved to `path`, so nobody ever loads half of an index
+         */
+        bool save(const std::filesystem::path& path, uint64_t key) const;
+
+        /*!
+         * \brief Reads an index that `save` wrote
+         *
+         * \return The index, or nothing if the file doesn't exist, is corrupt, or was saved with a different key
+         */
+        [[nodiscard]] static std::optional<PathIndex> load(const std::filesystem::path& path, uint64_t key);
+
+    private:
+        std::vector<std::string> sorted_paths;
+
+        /*!
+         * \brief The value of each path in `sorted_paths`
+         */
+        std::vector<uint32_t> values;
+
+        /*!
+         * \brief Map from path to its index in `sorted_paths`. The keys are views of the strings in `sorted_paths`
+         */
+        std::unordered_map<std::string_view, uint32_t> indices_by_path;
+
+        PathIndex(std::vector<std::string> sorted_paths, std::vector<uint32_t> values);
+
+        void build_lookup();
+    };
+
+    /*!
+     * \brief Keeps the path indices of big archives on disk, so opening the same archive again doesn't have to index it again
+     *
+     * This class is thread-safe
+     */
+    class PathIndexCache {
+    public:
+        [[nodiscard]] static PathIndexCache& get_instance();
+
+        /*!
+         * \brief Sets the directory to save indices in. Nothing is saved until this is called
+         */
+        void configure(std::filesystem::path directory);
+
+        /*!
+         * \brief Loads the saved index of an archive, if there is one and it was saved with the same key
+         *
+         * \param archive_path The path to the archive, relative to Nova's working directory
+         * \param key Something that changes whenever the archive's list of files does
+         */
+        [[nodiscard]] std::optional<PathIndex> find(std::string_view archive_path, uint64_t key) const;
+
+        void store(std::string_view archive_path, uint64_t key, const PathIndex& index) const;
+
+    private:
+        mutable std::mutex cache_mutex;
+
+        std::filesystem::path cache_directory;
+
+        [[nodiscard]] std::filesystem::path get_path_for_archive(std::string_view archive_path) const;
+    };
+} // namespace nova::filesystem
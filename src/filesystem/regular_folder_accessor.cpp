@@ -5,34 +5,67 @@
 #include <rx/core/filesystem/file.h>
 #include <rx/core/log.h>
 
+#include "async_file_reader.hpp"
+#include "mapped_file.hpp"
+
 namespace nova::filesystem {
     RX_LOG("RegularFilesystem", logger);
 
     RegularFolderAccessor::RegularFolderAccessor(const rx::string& folder) : FolderAccessorBase(folder) {}
 
     rx::vector<uint8_t> RegularFolderAccessor::read_file(const rx::string& path) {
-        rx::concurrency::scope_lock l(*resource_existence_mutex);
-
-        const auto full_path = [&] {
-            if(has_root(path, root_folder)) {
-                return path;
-            } else {
-                return rx::string::format("%s/%s", root_folder, path);
-            }
-        }();
-
-        if(!does_resource_exist_on_filesystem(full_path)) {
-            logger->error("Resource at path %s doesn't exist", full_path);
+        const auto full_path = get_existing_file_path(path);
+        if(!full_path) {
             return {};
         }
 
-        if(const auto bytes = rx::filesystem::read_binary_file(full_path)) {
+        if(const auto bytes = rx::filesystem::read_binary_file(*full_path)) {
             return *bytes;
         }
 
         return {};
     }
 
+    FileView RegularFolderAccessor::map_file(const rx::string& path) {
+        const auto full_path = get_existing_file_path(path);
+        if(!full_path) {
+            return {};
+        }
+
+        auto file = std::make_shared<const MappedFile>(full_path->data());
+        if(!file->is_valid()) {
+            return {};
+        }
+
+        const auto bytes = file->get_data();
+        return {std::move(file), bytes};
+    }
+
+    std::future<rx::vector<uint8_t>> RegularFolderAccessor::read_file_async(const rx::string& path, const IoPriority priority) {
+        auto full_path = get_existing_file_path(path);
+        if(!full_path) {
+            std::promise<rx::vector<uint8_t>> nothing;
+            nothing.set_value({});
+            return nothing.get_future();
+        }
+
+        return AsyncFileReader::get_instance().read_file(rx::utility::move(*full_path), priority);
+    }
+
+    std::future<rx::optional<uint64_t>> RegularFolderAccessor::read_file_into_async(const rx::string& path,
+                                                                                    const uint64_t file_offset,
+                                                                                    const std::span<uint8_t> destination,
+                                                                                    const IoPriority priority) {
+        auto full_path = get_existing_file_path(path);
+        if(!full_path) {
+            std::promise<rx::optional<uint64_t>> nothing;
+            nothing.set_value(rx::nullopt);
+            return nothing.get_future();
+        }
+
+        return AsyncFileReader::get_instance().read_file_into(rx::utility::move(*full_path), file_offset, destination, priority);
+    }
+
     rx::vector<rx::string> RegularFolderAccessor::get_all_items_in_folder(const rx::string& folder) {
         const auto full_path = rx::string::format("%s/%s", root_folder, folder);
         rx::vector<rx::string> paths = {};
@@ -66,6 +99,25 @@ namespace nova::filesystem {
         return false;
     }
 
+    rx::optional<rx::string> RegularFolderAccessor::get_existing_file_path(const rx::string& path) {
+        auto full_path = [&] {
+            if(has_root(path, root_folder)) {
+                return path;
+            } else {
+                return rx::string::format("%s/%s", root_folder, path);
+            }
+        }();
+
+        // Only the existence map needs the lock. Reading the file itself is safe from any number of threads
+        rx::concurrency::scope_lock l(*resource_existence_mutex);
+        if(!does_resource_exist_on_filesystem(full_path)) {
+            logger->error("Resource at path %s doesn't exist", full_path);
+            return rx::nullopt;
+        }
+
+        return full_path;
+    }
+
     FolderAccessorBase* RegularFolderAccessor::create_subfolder_accessor(const rx::string& path) const {
         return create(rx::string::format("%s/%s", root_folder, path));
     }
@@ -14,11 +14,29 @@ namespace nova::filesystem {
 
         rx::vector<uint8_t> read_file(const rx::string& path) override;
 
+        /*!
+         * \brief Maps the file into memory, so the OS only pages in the parts of it that get read
+         */
+        FileView map_file(const rx::string& path) override;
+
+        std::future<rx::vector<uint8_t>> read_file_async(const rx::string& path, IoPriority priority) override;
+
+        std::future<rx::optional<uint64_t>> read_file_into_async(const rx::string& path,
+                                                                 uint64_t file_offset,
+                                                                 std::span<uint8_t> destination,
+                                                                 IoPriority priority) override;
+
         rx::vector<rx::string> get_all_items_in_folder(const rx::string& folder) override;
 
         bool does_resource_exist_on_filesystem(const rx::string& resource_path) override;
 
     protected:
         FolderAccessorBase* create_subfolder_accessor(const rx::string& path) const override;
+
+    private:
+        /*!
+         * \brief Gets the path of a file relative to Nova's working directory, if it exists
+         */
+        [[nodiscard]] rx::optional<rx::string> get_existing_file_path(const rx::string& path);
     };
 } // namespace nova::filesystem
\ No newline at end of file
@@ -18,9 +18,27 @@ namespace nova::filesystem {
         return instance;
     }
 
-    void VirtualFilesystem::add_resource_root(const rx::string& root) { resource_roots.emplace_back(FolderAccessorBase::create(root)); }
+    void VirtualFilesystem::add_resource_root(const rx::string& root) { add_resource_root(FolderAccessorBase::create(root)); }
 
-    void VirtualFilesystem::add_resource_root(FolderAccessorBase* root_accessor) { resource_roots.push_back(root_accessor); }
+    void VirtualFilesystem::add_resource_root(FolderAccessorBase* root_accessor) {
+        const auto root_idx = static_cast<uint32_t>(resource_roots.size());
+        resource_roots.push_back(root_accessor);
+
+        if(root_accessor == nullptr) {
+            return;
+        }
+
+        if(const auto paths = root_accessor->get_indexed_paths()) {
+            // Roots that were added earlier win, so don't replace their paths
+            indexed_roots_by_path.reserve(indexed_roots_by_path.size() + paths->size());
+            for(const auto path : *paths) {
+                indexed_roots_by_path.try_emplace(path, root_idx);
+            }
+
+        } else {
+            unindexed_roots.push_back(root_idx);
+        }
+    }
 
     FolderAccessorBase* VirtualFilesystem::get_folder_accessor(const rx::string& path) const {
         if(resource_roots.is_empty()) {
@@ -29,16 +47,32 @@ namespace nova::filesystem {
             return nullptr;
         }
 
-        FolderAccessorBase* ret_val = nullptr;
+        std::string_view trimmed_path{path.data(), path.size()};
+        while(!trimmed_path.empty() && trimmed_path.back() == '/') {
+            trimmed_path.remove_suffix(1);
+        }
+
+        auto winning_root_idx = static_cast<uint32_t>(resource_roots.size());
+        if(const auto itr = indexed_roots_by_path.find(trimmed_path); itr != indexed_roots_by_path.end()) {
+            winning_root_idx = itr->second;
+        }
+
+        // The roots without an index still have to be asked, but only the ones that come before the indexed root that has the path
+        for(const auto root_idx : unindexed_roots) {
+            if(root_idx >= winning_root_idx) {
+                break;
+            }
 
-        resource_roots.each_fwd([&](FolderAccessorBase* root) {
-            if(root && root->does_resource_exist(path)) {
-                ret_val = root->create_subfolder_accessor(path);
-                return false;
+            if(resource_roots[root_idx]->does_resource_exist(path)) {
+                winning_root_idx = root_idx;
+                break;
             }
+        }
 
-            return true;
-        });
+        FolderAccessorBase* ret_val = nullptr;
+        if(winning_root_idx < resource_roots.size()) {
+            ret_val = resource_roots[winning_root_idx]->create_subfolder_accessor(path);
+        }
 
         if(ret_val == nullptr) {
             logger->error("Could not find folder %s", path);
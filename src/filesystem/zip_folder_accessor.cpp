@@ -1,211 +1,389 @@
 #include "zip_folder_accessor.hpp"
 
-#include <array>
+#include <cstring>
+#include <list>
 #include <memory>
-#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
 
+#include <Tracy.hpp>
 #include <rx/core/array.h>
+#include <rx/core/concurrency/scope_lock.h>
 #include <rx/core/log.h>
 
 #include "nova_renderer/util/utils.hpp"
 
+#include "../loading/renderpack/spirv_cache.hpp"
+
 namespace nova::filesystem {
     RX_LOG("ZipFilesystem", logger);
 
-    ZipFolderAccessor::ZipFolderAccessor(const rx::string& folder) : FolderAccessorBase(folder) {
-        if(mz_zip_reader_init_file(&zip_archive, folder.data(), 0) == 0) {
-            logger->error("Could not open zip archive %s", folder);
-        }
+    /*!
+     * \brief How many bytes of inflated files to keep around
+     */
+    constexpr uint64_t MAX_INFLATED_CACHE_SIZE = 64 * 1024 * 1024;
+
+    /*!
+     * \brief How many entries an archive needs before its path index is worth saving. Smaller archives index faster than we could load
+     * the index back
+     */
+    constexpr uint32_t MIN_ENTRIES_TO_SAVE_PATH_INDEX = 4096;
+
+    /*!
+     * \brief Least-recently-used cache of inflated zip entries
+     *
+     * Entries are keyed by their CRC and size instead of their path, so the cache is still valid after the archive is closed and opened
+     * again, and identical files in different archives share one blob
+     */
+    class InflatedFileCache {
+    public:
+        [[nodiscard]] std::shared_ptr<const rx::vector<uint8_t>> find(uint32_t crc, uint64_t size);
+
+        void add(uint32_t crc, std::shared_ptr<const rx::vector<uint8_t>> data);
+
+    private:
+        struct Entry {
+            uint64_t key;
+            std::shared_ptr<const rx::vector<uint8_t>> data;
+        };
+
+        rx::concurrency::mutex mutex;
 
-        build_file_tree();
+        /*!
+         * \brief All the cached blobs, most recently used first
+         */
+        std::list<Entry> entries;
+
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> entries_by_key;
+
+        uint64_t cached_bytes = 0;
+
+        [[nodiscard]] static uint64_t make_key(uint32_t crc, uint64_t size);
+    };
+
+    static InflatedFileCache& get_inflated_file_cache() {
+        static InflatedFileCache cache;
+        return cache;
     }
 
-    ZipFolderAccessor::~ZipFolderAccessor() { mz_zip_reader_end(&zip_archive); }
+    static void log_zip_error(mz_zip_archive& reader, const char* action, const rx::string& path) {
+        const mz_zip_error err_code = mz_zip_get_last_error(&reader);
+        const rx::string err = mz_zip_get_error_string(err_code);
 
-    rx::vector<uint8_t> ZipFolderAccessor::read_file(const rx::string& path) {
-        const auto full_path = rx::string::format("%s/%s", root_folder, path);
+        logger->error("Could not %s %s:%s", action, path, err);
+    }
 
-        if(!does_resource_exist_on_filesystem(full_path)) {
-            logger->error("Resource at path %s does not exist", full_path);
+    std::shared_ptr<const rx::vector<uint8_t>> InflatedFileCache::find(const uint32_t crc, const uint64_t size) {
+        rx::concurrency::scope_lock l(mutex);
+
+        const auto itr = entries_by_key.find(make_key(crc, size));
+        if(itr == entries_by_key.end()) {
             return {};
         }
 
-        const auto file_idx = resource_indexes.find(full_path);
+        entries.splice(entries.begin(), entries, itr->second);
 
-        mz_zip_archive_file_stat file_stat = {};
-        const mz_bool has_file_stat = mz_zip_reader_file_stat(&zip_archive, *file_idx, &file_stat);
-        if(has_file_stat == 0) {
-            const mz_zip_error err_code = mz_zip_get_last_error(&zip_archive);
-            const rx::string err = mz_zip_get_error_string(err_code);
+        return itr->second->data;
+    }
 
-            logger->error("Could not get information for file %s:%s", full_path, err);
+    void InflatedFileCache::add(const uint32_t crc, std::shared_ptr<const rx::vector<uint8_t>> data) {
+        const auto size = data->size();
+        if(size > MAX_INFLATED_CACHE_SIZE) {
+            return;
         }
 
-        rx::vector<uint8_t> resource_buffer;
-        resource_buffer.reserve(static_cast<uint64_t>(file_stat.m_uncomp_size));
+        rx::concurrency::scope_lock l(mutex);
 
-        const mz_bool file_extracted = mz_zip_reader_extract_to_mem(&zip_archive,
-                                                                    *file_idx,
-                                                                    resource_buffer.data(),
-                                                                    resource_buffer.size(),
-                                                                    0);
-        if(file_extracted == 0) {
-            const mz_zip_error err_code = mz_zip_get_last_error(&zip_archive);
-            const rx::string err = mz_zip_get_error_string(err_code);
+        const auto key = make_key(crc, size);
+        if(entries_by_key.find(key) != entries_by_key.end()) {
+            // Another thread inflated the same file at the same time
+            return;
+        }
 
-            logger->error("Could not extract file %s:%s", full_path, err);
+        while(cached_bytes + size > MAX_INFLATED_CACHE_SIZE) {
+            const auto& oldest = entries.back();
+            cached_bytes -= oldest.data->size();
+            entries_by_key.erase(oldest.key);
+            entries.pop_back();
         }
 
-        return resource_buffer;
+        entries.push_front(Entry{key, std::move(data)});
+        entries_by_key.emplace(key, entries.begin());
+        cached_bytes += size;
     }
 
-    rx::vector<rx::string> ZipFolderAccessor::get_all_items_in_folder(const rx::string& folder) {
-        const rx::vector<rx::string> folder_path_parts = folder.split('/');
+    uint64_t InflatedFileCache::make_key(const uint32_t crc, const uint64_t size) {
+        // Zip entries only have 32-bit sizes without Zip64, and nobody puts 4 GB shaders in a renderpack
+        return (static_cast<uint64_t>(crc) << 32) | (size & 0xFFFFFFFF);
+    }
 
-        FileTreeNode* cur_node = &files;
-        // Get the node at this path
-        folder_path_parts.each_fwd([&](const rx::string& part) {
-            bool found_node = false;
-            cur_node->children.each_fwd([&](FileTreeNode& child) {
-                if(child.name == part) {
-                    cur_node = &child;
-                    found_node = true;
+    ZipArchive::Reader::Reader(ZipArchive& archive) : archive{archive} {
+        if(!archive.file.is_valid()) {
+            return;
+        }
 
-                    return false;
-                }
+        {
+            rx::concurrency::scope_lock l(archive.readers_mutex);
+            if(!archive.idle_readers.empty()) {
+                reader = std::move(archive.idle_readers.back());
+                archive.idle_readers.pop_back();
+                return;
+            }
+        }
 
-                return true;
-            });
+        // Parsing the central directory doesn't touch any shared state, so it can happen outside the lock
+        const auto data = archive.file.get_data();
 
-            if(!found_node) {
-                logger->error("Couldn't find node %s", folder);
-            }
-        });
+        reader = std::make_unique<mz_zip_archive>();
+        if(mz_zip_reader_init_mem(reader.get(), data.data(), data.size(), 0) == 0) {
+            logger->error("Could not read the central directory of a zip archive");
+            reader.reset();
+        }
+    }
+
+    ZipArchive::Reader::~Reader() {
+        if(reader) {
+            rx::concurrency::scope_lock l(archive.readers_mutex);
+            archive.idle_readers.push_back(std::move(reader));
+        }
+    }
+
+    mz_zip_archive* ZipArchive::Reader::get() const { return reader.get(); }
 
-        rx::vector<rx::string> children_paths;
-        children_paths.reserve(cur_node->children.size());
-        cur_node->children.each_fwd([&](const FileTreeNode& child) {
-            rx::string s = child.get_full_path();
-            children_paths.emplace_back(s);
-        });
+    ZipArchive::ZipArchive(const rx::string& path) : path{path}, file{path.data()} {
+        if(!file.is_valid()) {
+            logger->error("Could not open zip archive %s", path);
+            return;
+        }
 
-        return children_paths;
+        build_path_index();
     }
 
-    FolderAccessorBase* ZipFolderAccessor::create_subfolder_accessor(const rx::string& path) const {
-        rx::memory::allocator* allocator = &rx::memory::g_system_allocator;
-        return allocator->create<ZipFolderAccessor>(rx::string::format("%s/%s", root_folder, path), zip_archive);
+    ZipArchive::~ZipArchive() {
+        for(auto& reader : idle_readers) {
+            mz_zip_reader_end(reader.get());
+        }
     }
 
-    ZipFolderAccessor::ZipFolderAccessor(const rx::string& folder, const mz_zip_archive archive)
-        : FolderAccessorBase(folder), zip_archive(archive) {
-        build_file_tree();
+    rx::optional<std::span<const uint8_t>> ZipArchive::get_stored_entry(const mz_zip_archive_file_stat& file_stat) const {
+        if(file_stat.m_method != 0 || file_stat.m_comp_size != file_stat.m_uncomp_size) {
+            return rx::nullopt;
+        }
+
+        // The central directory only tells us where the local header is. The data itself starts after the local header's filename and
+        // extra field, whose lengths may differ from the central directory's
+        constexpr uint64_t LOCAL_HEADER_SIZE = 30;
+        constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+
+        const auto data = file.get_data();
+        const auto header_offset = static_cast<uint64_t>(file_stat.m_local_header_ofs);
+        if(header_offset + LOCAL_HEADER_SIZE > data.size()) {
+            return rx::nullopt;
+        }
+
+        const auto* header = data.data() + header_offset;
+        const auto read_u16 = [&](const uint64_t offset) { return static_cast<uint32_t>(header[offset] | header[offset + 1] << 8); };
+
+        const auto signature = read_u16(0) | read_u16(2) << 16;
+        if(signature != LOCAL_HEADER_SIGNATURE) {
+            return rx::nullopt;
+        }
+
+        const auto data_offset = header_offset + LOCAL_HEADER_SIZE + read_u16(26) + read_u16(28);
+        const auto size = static_cast<uint64_t>(file_stat.m_uncomp_size);
+        if(data_offset + size > data.size()) {
+            return rx::nullopt;
+        }
+
+        return data.subspan(static_cast<size_t>(data_offset), static_cast<size_t>(size));
     }
 
-    void ZipFolderAccessor::build_file_tree() {
-        const uint32_t num_files = mz_zip_reader_get_num_files(&zip_archive);
+    const PathIndex& ZipArchive::get_path_index() const { return path_index; }
 
-        rx::vector<rx::string> all_file_names;
-        all_file_names.resize(num_files);
-        char filename_buffer[1024];
+    std::string_view ZipArchive::get_path_in_archive(const std::string_view full_path) const {
+        const std::string_view archive_path{path.data(), path.size()};
+        if(!full_path.starts_with(archive_path)) {
+            return full_path;
+        }
 
-        for(uint32_t i = 0; i < num_files; i++) {
-            const uint32_t num_bytes_in_filename = mz_zip_reader_get_filename(&zip_archive, i, filename_buffer, 1024);
-            filename_buffer[num_bytes_in_filename] = '\0';
-            all_file_names.emplace_back(filename_buffer);
+        if(full_path.size() == archive_path.size()) {
+            return {};
         }
 
-        // Build a tree from all the files
-        all_file_names.each_fwd([&](const rx::string& filename) {
-            const rx::vector<rx::string> filename_parts = filename.split('/');
-            FileTreeNode* cur_node = &files;
+        if(full_path[archive_path.size()] != '/') {
+            return full_path;
+        }
 
-            filename_parts.each_fwd([&](const rx::string& part) {
-                bool node_found = false;
-                cur_node->children.each_fwd([&](FileTreeNode& child) {
-                    if(child.name == part) {
-                        // We already have a node for the current folder. Set this node as the current one and go to the
-                        // next iteration of the loop
-                        cur_node = &child;
+        return full_path.substr(archive_path.size() + 1);
+    }
 
-                        node_found = true;
+    void ZipArchive::build_path_index() {
+        ZoneScoped;
+        const Reader reader{*this};
+        if(reader.get() == nullptr) {
+            return;
+        }
 
-                        return false;
-                    }
+        // The central directory lists every entry's path, so the index is stale exactly when the central directory changes
+        const auto data = file.get_data();
+        const auto central_directory_offset = static_cast<uint64_t>(reader.get()->m_central_directory_file_ofs);
 
-                    return true;
-                });
+        renderer::renderpack::Fnv1aHasher hasher;
+        hasher.add_value(static_cast<uint64_t>(data.size()));
+        if(central_directory_offset < data.size()) {
+            hasher.add(std::string_view{reinterpret_cast<const char*>(data.data()) + central_directory_offset,
+                                        static_cast<size_t>(data.size() - central_directory_offset)});
+        }
+        const auto key = hasher.get();
+
+        auto& cache = PathIndexCache::get_instance();
+        const std::string_view archive_path{path.data(), path.size()};
+        if(auto cached_index = cache.find(archive_path, key)) {
+            path_index = std::move(*cached_index);
+            return;
+        }
+
+        const uint32_t num_files = mz_zip_reader_get_num_files(reader.get());
+
+        std::vector<std::pair<std::string, uint32_t>> entries;
+        entries.reserve(num_files);
+
+        for(uint32_t i = 0; i < num_files; i++) {
+            // Miniz counts the null terminator
+            const uint32_t filename_size = mz_zip_reader_get_filename(reader.get(), i, nullptr, 0);
+            if(filename_size <= 1) {
+                continue;
+            }
+
+            std::string filename(filename_size, '\0');
+            mz_zip_reader_get_filename(reader.get(), i, filename.data(), filename_size);
+            filename.pop_back();
 
-                if(!node_found) {
-                    // We didn't find a node for the current part of the path, so let's add one
-                    FileTreeNode new_node;
-                    new_node.name = part;
-                    new_node.parent = cur_node;
+            entries.emplace_back(std::move(filename), i);
+        }
 
-                    cur_node->children.push_back(new_node);
+        path_index = PathIndex{std::move(entries)};
 
-                    cur_node = &cur_node->children.last();
-                }
-            });
-        });
+        if(num_files >= MIN_ENTRIES_TO_SAVE_PATH_INDEX) {
+            cache.store(archive_path, key, path_index);
+        }
     }
 
-    bool ZipFolderAccessor::does_resource_exist_on_filesystem(const rx::string& resource_path) {
-        const auto existence_maybe = does_resource_exist_in_map(resource_path);
-        if(existence_maybe) {
-            return *existence_maybe;
+    ZipFolderAccessor::ZipFolderAccessor(const rx::string& folder)
+        : FolderAccessorBase(folder), archive{std::make_shared<ZipArchive>(folder)} {}
+
+    ZipFolderAccessor::ZipFolderAccessor(const rx::string& folder, std::shared_ptr<ZipArchive> archive)
+        : FolderAccessorBase(folder), archive{std::move(archive)} {}
+
+    rx::vector<uint8_t> ZipFolderAccessor::read_file(const rx::string& path) {
+        const auto file = map_file(path);
+        const auto bytes = file.get_bytes();
+
+        rx::vector<uint8_t> resource_buffer;
+        resource_buffer.resize(bytes.size());
+        memcpy(resource_buffer.data(), bytes.data(), bytes.size());
+
+        return resource_buffer;
+    }
+
+    FileView ZipFolderAccessor::map_file(const rx::string& path) {
+        ZoneScoped;
+        const auto full_path = rx::string::format("%s/%s", root_folder, path);
+
+        // Each thread gets its own reader, so many threads can inflate different files at once
+        const ZipArchive::Reader reader{*archive};
+        if(reader.get() == nullptr) {
+            return {};
+        }
+
+        mz_zip_archive_file_stat file_stat = {};
+        if(!get_file_stat(full_path, *reader.get(), file_stat)) {
+            return {};
+        }
+
+        // The archive's mapping lives as long as the archive does, so the view keeps the archive alive
+        if(const auto stored_data = archive->get_stored_entry(file_stat)) {
+            return {archive, *stored_data};
         }
 
-        const int32_t ret_val = mz_zip_reader_locate_file(&zip_archive, resource_path.data(), "", 0);
-        if(ret_val != -1) {
-            // resource found!
-            resource_indexes.insert(resource_path, ret_val);
-            resource_existence.insert(resource_path, true);
-            return true;
+        auto& cache = get_inflated_file_cache();
+        if(auto cached_data = cache.find(file_stat.m_crc32, file_stat.m_uncomp_size)) {
+            const std::span<const uint8_t> bytes{cached_data->data(), cached_data->size()};
+            return {std::move(cached_data), bytes};
+        }
+
+        auto resource_buffer = std::make_shared<rx::vector<uint8_t>>();
+        resource_buffer->resize(static_cast<uint64_t>(file_stat.m_uncomp_size));
+
+        const mz_bool file_extracted = mz_zip_reader_extract_to_mem(reader.get(),
+                                                                    file_stat.m_file_index,
+                                                                    resource_buffer->data(),
+                                                                    resource_buffer->size(),
+                                                                    0);
+        if(file_extracted == 0) {
+            log_zip_error(*reader.get(), "extract file", full_path);
+            return {};
         }
 
-        // resource not found
-        resource_existence.insert(resource_path, false);
-        return false;
+        cache.add(file_stat.m_crc32, resource_buffer);
+
+        const std::span<const uint8_t> bytes{resource_buffer->data(), resource_buffer->size()};
+        return {std::move(resource_buffer), bytes};
     }
 
-    void print_file_tree(const FileTreeNode& folder, const uint32_t depth) {
-        std::stringstream ss;
-        for(uint32_t i = 0; i < depth; i++) {
-            ss << "    ";
+    rx::vector<rx::string> ZipFolderAccessor::get_all_items_in_folder(const rx::string& folder) {
+        const auto full_path = rx::string::format("%s/%s", root_folder, folder);
+        const auto& path_index = archive->get_path_index();
+        const auto path_in_archive = archive->get_path_in_archive({full_path.data(), full_path.size()});
+
+        const auto value = path_index.find(path_in_archive);
+        if(!value || *value != PathIndex::FOLDER) {
+            logger->error("Couldn't find folder %s", full_path);
+            return {};
         }
 
-        ss << folder.name.data();
-        logger->info(ss.str().c_str());
+        return path_index.list_folder(path_in_archive);
+    }
 
-        folder.children.each_fwd([&](const FileTreeNode& child) { print_file_tree(child, depth + 1); });
+    rx::optional<std::vector<std::string_view>> ZipFolderAccessor::get_indexed_paths() const {
+        const auto folder = archive->get_path_in_archive({root_folder.data(), root_folder.size()});
+        const auto paths = archive->get_path_index().get_paths_in(folder);
+        const auto prefix_size = folder.empty() ? 0 : folder.size() + 1;
+
+        // The index lives as long as the archive, and we keep the archive alive
+        std::vector<std::string_view> root_relative_paths;
+        root_relative_paths.reserve(paths.size());
+        for(const auto& path : paths) {
+            root_relative_paths.push_back(std::string_view{path}.substr(prefix_size));
+        }
+
+        return root_relative_paths;
+    }
+
+    FolderAccessorBase* ZipFolderAccessor::create_subfolder_accessor(const rx::string& path) const {
+        rx::memory::allocator* allocator = &rx::memory::g_system_allocator;
+        return allocator->create<ZipFolderAccessor>(rx::string::format("%s/%s", root_folder, path), archive);
     }
 
-    rx::string FileTreeNode::get_full_path() const {
-        rx::vector<rx::string> names;
-        const FileTreeNode* cur_node = this;
-        while(cur_node != nullptr) {
-            names.push_back(cur_node->name);
-            cur_node = cur_node->parent;
+    bool ZipFolderAccessor::get_file_stat(const rx::string& full_path, mz_zip_archive& reader, mz_zip_archive_file_stat& file_stat) {
+        // The index never changes after the archive is opened, so any number of threads may look in it at once
+        const auto file_idx = archive->get_path_index().find(archive->get_path_in_archive({full_path.data(), full_path.size()}));
+        if(!file_idx || *file_idx == PathIndex::FOLDER) {
+            logger->error("Resource at path %s does not exist", full_path);
+            return false;
         }
 
-        // Skip the last string in the vector, since it's the resourcepack root node
-        bool is_first = false;
-        const uint32_t num_path_parts = static_cast<uint32_t>(names.size() - 1);
-        uint32_t cur_path_part = 0;
-        rx::string joined;
-        names.each_rev([&](rx::string& str) {
-            if(!is_first && cur_path_part > 0 && cur_path_part < num_path_parts - 1) {
-                joined = rx::string::format("%s/%s", joined, str);
-            }
-            if(!is_first) {
-                cur_path_part++;
-            }
-            is_first = false;
+        if(mz_zip_reader_file_stat(&reader, static_cast<mz_uint>(*file_idx), &file_stat) == 0) {
+            log_zip_error(reader, "get information for file", full_path);
+            return false;
+        }
 
-            return true;
-        });
+        return true;
+    }
 
-        return joined;
+    bool ZipFolderAccessor::does_resource_exist_on_filesystem(const rx::string& resource_path) {
+        const auto path_in_archive = archive->get_path_in_archive({resource_path.data(), resource_path.size()});
+        return archive->get_path_index().find(path_in_archive).has_value();
     }
 } // namespace nova::filesystem
\ No newline at end of file
@@ -1,26 +1,114 @@
 #pragma once
 
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
 #include <miniz.h>
+#include <rx/core/concurrency/mutex.h>
 
 #include "nova_renderer/filesystem/folder_accessor.hpp"
 
+#include "mapped_file.hpp"
+#include "path_index.hpp"
+
 namespace nova::filesystem {
-    struct FileTreeNode {
-        rx::string name;
-        rx::vector<FileTreeNode> children;
-        FileTreeNode* parent = nullptr;
+    /*!
+     * \brief A memory-mapped zip archive that any number of threads can read from at once
+     *
+     * Miniz keeps its decompression state in the `mz_zip_archive`, so every thread that's reading needs a reader of its own. Readers are
+     * cheap to make from the mapped bytes, so the archive keeps a pool of them and hands one to each concurrent read
+     *
+     * The archive indexes its paths once, when it's opened, and every accessor into it shares that index. Big archives save their index
+     * in the `PathIndexCache`, keyed by their central directory, so opening them again doesn't index them again
+     */
+    class ZipArchive {
+    public:
+        /*!
+         * \brief A reader that's borrowed from the archive for as long as this object lives
+         */
+        class Reader {
+        public:
+            explicit Reader(ZipArchive& archive);
+
+            Reader(const Reader& other) = delete;
+            Reader& operator=(const Reader& other) = delete;
+
+            Reader(Reader&& old) noexcept = delete;
+            Reader& operator=(Reader&& old) noexcept = delete;
+
+            ~Reader();
+
+            /*!
+             * \brief The borrowed reader, or nullptr if the archive couldn't be opened
+             */
+            [[nodiscard]] mz_zip_archive* get() const;
+
+        private:
+            ZipArchive& archive;
+
+            std::unique_ptr<mz_zip_archive> reader;
+        };
+
+        explicit ZipArchive(const rx::string& path);
+
+        ZipArchive(const ZipArchive& other) = delete;
+        ZipArchive& operator=(const ZipArchive& other) = delete;
+
+        ZipArchive(ZipArchive&& old) noexcept = delete;
+        ZipArchive& operator=(ZipArchive&& old) noexcept = delete;
+
+        ~ZipArchive();
+
+        /*!
+         * \brief Gets the bytes of an entry that's stored without compression, straight from the mapping
+         *
+         * \return A view of the entry's data, or nullopt if the entry is compressed. The view is valid for as long as the archive lives
+         */
+        [[nodiscard]] rx::optional<std::span<const uint8_t>> get_stored_entry(const mz_zip_archive_file_stat& file_stat) const;
+
+        /*!
+         * \brief Every file and folder in the archive. File values are the file's index in the archive
+         */
+        [[nodiscard]] const PathIndex& get_path_index() const;
 
-        [[nodiscard]] rx::string get_full_path() const;
+        /*!
+         * \brief Turns a path that starts with the archive's path into a path inside the archive, like `pack.zip/a/b` into `a/b`
+         *
+         * Paths that don't start with the archive's path are already inside the archive
+         */
+        [[nodiscard]] std::string_view get_path_in_archive(std::string_view path) const;
+
+    private:
+        rx::string path;
+
+        MappedFile file;
+
+        PathIndex path_index;
+
+        rx::concurrency::mutex readers_mutex;
+
+        /*!
+         * \brief Readers that no thread is using right now
+         */
+        std::vector<std::unique_ptr<mz_zip_archive>> idle_readers;
+
+        void build_path_index();
     };
 
     /*!
      * \brief Allows access to a zip folder
+     *
+     * The archive is memory-mapped once and shared with every subfolder accessor, and any number of threads may read files at once.
+     * Entries that are stored without compression are read straight out of the mapping. Inflated entries go in a process-wide cache,
+     * keyed by the entry's CRC and size, so reloading a renderpack or resourcepack doesn't inflate its files again
      */
     class ZipFolderAccessor : public FolderAccessorBase {
     public:
         explicit ZipFolderAccessor(const rx::string& folder);
 
-        ZipFolderAccessor(const rx::string& folder, mz_zip_archive archive);
+        ZipFolderAccessor(const rx::string& folder, std::shared_ptr<ZipArchive> archive);
 
         ZipFolderAccessor(ZipFolderAccessor&& other) noexcept = default;
         ZipFolderAccessor& operator=(ZipFolderAccessor&& other) noexcept = default;
@@ -28,31 +116,34 @@ namespace nova::filesystem {
         ZipFolderAccessor(const ZipFolderAccessor& other) = delete;
         ZipFolderAccessor& operator=(const ZipFolderAccessor& other) = delete;
 
-        ~ZipFolderAccessor() override;
+        ~ZipFolderAccessor() override = default;
 
         rx::vector<uint8_t> read_file(const rx::string& path) override final;
 
+        /*!
+         * \brief Gets a view of a file in the archive
+         *
+         * Files that are stored without compression are viewed straight from the archive's mapping. Compressed files are viewed from
+         * the inflated file cache, so they're only inflated the first time anyone reads them
+         */
+        FileView map_file(const rx::string& path) override final;
+
         rx::vector<rx::string> get_all_items_in_folder(const rx::string& folder) override final;
 
+        [[nodiscard]] rx::optional<std::vector<std::string_view>> get_indexed_paths() const override final;
+
         [[nodiscard]] FolderAccessorBase* create_subfolder_accessor(const rx::string& path) const override;
 
     private:
+        std::shared_ptr<ZipArchive> archive;
+
         /*!
-         * \brief Map from filename to its index in the zip folder. Miniz seems to like indexes
+         * \brief Finds the index of a file in the archive and gets its information
+         *
+         * \return True if the file exists and its information was read, false otherwise
          */
-        rx::map<rx::string, int32_t> resource_indexes;
-
-        mz_zip_archive zip_archive = {};
-
-        FileTreeNode files;
-
-        void build_file_tree();
+        bool get_file_stat(const rx::string& full_path, mz_zip_archive& reader, mz_zip_archive_file_stat& file_stat);
 
         bool does_resource_exist_on_filesystem(const rx::string& resource_path) override final;
     };
-
-    /*!
-     * \brief Prints out the nodes in a depth-first fashion
-     */
-    void print_file_tree(const FileTreeNode& folder, uint32_t depth);
 } // namespace nova::filesystem
@@ -0,0 +1,215 @@
+#include "nova_renderer/loading/dds_loading.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("DdsLoading");
+
+    constexpr uint32_t make_four_cc(const char a, const char b, const char c, const char d) {
+        return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) |
+               (static_cast<uint32_t>(d) << 24);
+    }
+
+    constexpr uint32_t DDS_MAGIC = make_four_cc('D', 'D', 'S', ' ');
+
+    constexpr uint64_t DDS_HEADER_OFFSET = 4;
+    constexpr uint32_t DDS_HEADER_SIZE = 124;
+    constexpr uint64_t DX10_HEADER_OFFSET = DDS_HEADER_OFFSET + DDS_HEADER_SIZE;
+    constexpr uint64_t DX10_HEADER_SIZE = 20;
+
+    constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    constexpr uint32_t DDPF_FOURCC = 0x4;
+    constexpr uint32_t DDPF_RGB = 0x40;
+    constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    constexpr uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+    constexpr uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+    constexpr uint32_t D3D10_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+    /*!
+     * \brief D3DFMT values that legacy DDS headers put in their FourCC for floating-point formats
+     */
+    constexpr uint32_t D3DFMT_A16B16G16R16F = 113;
+    constexpr uint32_t D3DFMT_A32B32G32R32F = 116;
+
+    static uint32_t read_u32(const std::vector<uint8_t>& data, const uint64_t offset) {
+        uint32_t value;
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        return value;
+    }
+
+    static std::optional<rhi::PixelFormat> get_legacy_format(const std::vector<uint8_t>& data) {
+        const auto pixel_format_offset = DDS_HEADER_OFFSET + 72;
+        const auto flags = read_u32(data, pixel_format_offset + 4);
+        const auto four_cc = read_u32(data, pixel_format_offset + 8);
+
+        if((flags & DDPF_FOURCC) != 0) {
+            switch(four_cc) {
+                case make_four_cc('D', 'X', 'T', '1'):
+                    return rhi::PixelFormat::Bc1;
+
+                case make_four_cc('D', 'X', 'T', '5'):
+                    return rhi::PixelFormat::Bc3;
+
+                case make_four_cc('A', 'T', 'I', '2'):
+                    [[fallthrough]];
+                case make_four_cc('B', 'C', '5', 'U'):
+                    return rhi::PixelFormat::Bc5;
+
+                case D3DFMT_A16B16G16R16F:
+                    return rhi::PixelFormat::Rgba16F;
+
+                case D3DFMT_A32B32G32R32F:
+                    return rhi::PixelFormat::Rgba32F;
+
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        // Only RGBA8 in memory order. Anything else would need swizzling on the way in
+        const auto bit_count = read_u32(data, pixel_format_offset + 12);
+        const auto red_mask = read_u32(data, pixel_format_offset + 16);
+        const auto green_mask = read_u32(data, pixel_format_offset + 20);
+        const auto blue_mask = read_u32(data, pixel_format_offset + 24);
+        if((flags & DDPF_RGB) != 0 && bit_count == 32 && red_mask == 0x000000FF && green_mask == 0x0000FF00 && blue_mask == 0x00FF0000) {
+            return rhi::PixelFormat::Rgba8;
+        }
+
+        return std::nullopt;
+    }
+
+    static std::optional<rhi::PixelFormat> get_dxgi_format(const uint32_t dxgi_format) {
+        switch(dxgi_format) {
+            case 2: // DXGI_FORMAT_R32G32B32A32_FLOAT
+                return rhi::PixelFormat::Rgba32F;
+
+            case 10: // DXGI_FORMAT_R16G16B16A16_FLOAT
+                return rhi::PixelFormat::Rgba16F;
+
+            case 28: // DXGI_FORMAT_R8G8B8A8_UNORM
+                return rhi::PixelFormat::Rgba8;
+
+            case 71: // DXGI_FORMAT_BC1_UNORM
+                return rhi::PixelFormat::Bc1;
+
+            case 77: // DXGI_FORMAT_BC3_UNORM
+                return rhi::PixelFormat::Bc3;
+
+            case 83: // DXGI_FORMAT_BC5_UNORM
+                return rhi::PixelFormat::Bc5;
+
+            case 98: // DXGI_FORMAT_BC7_UNORM
+                return rhi::PixelFormat::Bc7;
+
+            default:
+                return std::nullopt;
+        }
+    }
+
+    std::optional<StreamedTextureCreateInfo> load_dds_texture(const std::string& name, std::vector<uint8_t> file_data) {
+        if(file_data.size() < DX10_HEADER_OFFSET || read_u32(file_data, 0) != DDS_MAGIC ||
+           read_u32(file_data, DDS_HEADER_OFFSET) != DDS_HEADER_SIZE) {
+            logger->error("Texture {} isn't a DDS file", name);
+            return std::nullopt;
+        }
+
+        const auto flags = read_u32(file_data, DDS_HEADER_OFFSET + 4);
+        const auto height = read_u32(file_data, DDS_HEADER_OFFSET + 8);
+        const auto width = read_u32(file_data, DDS_HEADER_OFFSET + 12);
+        const auto num_mips = (flags & DDSD_MIPMAPCOUNT) != 0 ? std::max(read_u32(file_data, DDS_HEADER_OFFSET + 24), 1U) : 1U;
+        const auto four_cc = read_u32(file_data, DDS_HEADER_OFFSET + 80);
+        const auto caps2 = read_u32(file_data, DDS_HEADER_OFFSET + 108);
+
+        if((caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0) {
+            logger->error("Texture {} is a cubemap or a volume texture, but Nova only loads 2D DDS files", name);
+            return std::nullopt;
+        }
+
+        std::optional<rhi::PixelFormat> format;
+        auto data_offset = DX10_HEADER_OFFSET;
+        if(four_cc == make_four_cc('D', 'X', '1', '0')) {
+            if(file_data.size() < DX10_HEADER_OFFSET + DX10_HEADER_SIZE) {
+                logger->error("Texture {} ends in the middle of its DX10 header", name);
+                return std::nullopt;
+            }
+
+            const auto dxgi_format = read_u32(file_data, DX10_HEADER_OFFSET);
+            const auto dimension = read_u32(file_data, DX10_HEADER_OFFSET + 4);
+            const auto misc_flags = read_u32(file_data, DX10_HEADER_OFFSET + 8);
+            const auto array_size = read_u32(file_data, DX10_HEADER_OFFSET + 12);
+            if(dimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || (misc_flags & D3D10_RESOURCE_MISC_TEXTURECUBE) != 0 || array_size > 1) {
+                logger->error("Texture {} isn't a single 2D texture, but Nova only loads those from DDS files", name);
+                return std::nullopt;
+            }
+
+            format = get_dxgi_format(dxgi_format);
+            if(!format) {
+                logger->error("Texture {} has DXGI format {}, which Nova doesn't support", name, dxgi_format);
+                return std::nullopt;
+            }
+
+            data_offset += DX10_HEADER_SIZE;
+
+        } else {
+            format = get_legacy_format(file_data);
+            if(!format) {
+                logger->error("Texture {} has a pixel format that Nova doesn't support", name);
+                return std::nullopt;
+            }
+        }
+
+        if(width == 0 || height == 0) {
+            logger->error("Texture {} has no pixels", name);
+            return std::nullopt;
+        }
+
+        // Mips are stored one after another, largest first
+        const auto full_chain_length = static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+        std::vector<uint64_t> mip_offsets;
+        mip_offsets.reserve(std::min(num_mips, full_chain_length) + 1);
+        mip_offsets.push_back(data_offset);
+
+        for(uint32_t mip = 0; mip < std::min(num_mips, full_chain_length); mip++) {
+            const auto mip_size = get_image_size_in_bytes(*format, std::max(width >> mip, 1U), std::max(height >> mip, 1U));
+            mip_offsets.push_back(mip_offsets.back() + mip_size);
+        }
+
+        if(mip_offsets.back() > file_data.size()) {
+            logger->error("Texture {} is {} bytes, but its mips need {}", name, file_data.size(), mip_offsets.back());
+            return std::nullopt;
+        }
+
+        StreamedTextureCreateInfo create_info = {};
+        create_info.name = name;
+        create_info.width = width;
+        create_info.height = height;
+        create_info.format = *format;
+        create_info.num_mips = static_cast<uint32_t>(mip_offsets.size() - 1);
+
+        if(create_info.num_mips == 1 && !rhi::is_block_compressed_format(*format)) {
+            create_info.num_mips = 0;
+            create_info.generate_mips = true;
+        }
+
+        // Loaders run on worker threads, possibly after the caller forgot about the texture, so they share the file's data
+        create_info.load_mip = [data = std::make_shared<const std::vector<uint8_t>>(std::move(file_data)),
+                                mip_offsets = std::move(mip_offsets)](const uint32_t mip) -> std::vector<uint8_t> {
+            if(mip + 1 >= mip_offsets.size()) {
+                return {};
+            }
+
+            return {data->begin() + static_cast<std::ptrdiff_t>(mip_offsets[mip]),
+                    data->begin() + static_cast<std::ptrdiff_t>(mip_offsets[mip + 1])};
+        };
+
+        return create_info;
+    }
+} // namespace nova::renderer
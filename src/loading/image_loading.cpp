@@ -0,0 +1,272 @@
+#include "nova_renderer/loading/image_loading.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <memory>
+#include <mutex>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/loading/dds_loading.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../util/simd.hpp"
+
+// stb_image uses SSE2 for JPEG's IDCT and color conversion by itself, but it only uses NEON when it's asked to
+#ifdef NOVA_SIMD_NEON
+#define STBI_NEON
+#endif
+#define STBI_NO_STDIO
+#define STBI_ONLY_PNG
+#define STBI_ONLY_TGA
+#define STBI_ONLY_JPEG
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace nova::renderer {
+    static auto logger = make_logger("ImageLoading");
+
+    constexpr uint32_t BYTES_PER_PIXEL = 4;
+
+    /*!
+     * \brief Filters an RGBA8 mip down to the next one, averaging each 2x2 block of pixels
+     *
+     * The last row or column of an odd-sized mip is dropped, the same as when the GPU generates mips. Sides that are one pixel wide stay
+     * that way, and their pixels are averaged with themselves
+     */
+    static std::vector<uint8_t> filter_down(const uint8_t* source, const uint32_t source_width, const uint32_t source_height) {
+        ZoneScoped;
+        const auto width = std::max(source_width / 2, 1U);
+        const auto height = std::max(source_height / 2, 1U);
+        std::vector<uint8_t> mip(static_cast<size_t>(width) * height * BYTES_PER_PIXEL);
+
+        const auto source_stride = static_cast<size_t>(source_width) * BYTES_PER_PIXEL;
+        const auto next_column = source_width > 1 ? BYTES_PER_PIXEL : 0;
+        const auto next_row = source_height > 1 ? source_stride : 0;
+
+        for(uint32_t y = 0; y < height; y++) {
+            const auto* row_0 = source + static_cast<size_t>(y) * 2 * source_stride;
+            const auto* row_1 = row_0 + next_row;
+            auto* dest = mip.data() + static_cast<size_t>(y) * width * BYTES_PER_PIXEL;
+
+            uint32_t x = 0;
+
+            // Two pixels of the mip at once, from four pixels of each source row. `width` is half the source's width, rounded down, so
+            // the four pixels are always there
+#if defined(NOVA_SIMD_SSE2)
+            const auto zero = _mm_setzero_si128();
+            const auto rounding = _mm_set1_epi16(2);
+            for(; x + 2 <= width; x += 2) {
+                const auto top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_0 + x * 2 * BYTES_PER_PIXEL));
+                const auto bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_1 + x * 2 * BYTES_PER_PIXEL));
+
+                // Source pixels 0 and 1, and 2 and 3, with the top and bottom rows already added together
+                const auto left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                const auto right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+                auto sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + x * BYTES_PER_PIXEL), _mm_packus_epi16(sum, sum));
+            }
+#elif defined(NOVA_SIMD_NEON)
+            for(; x + 2 <= width; x += 2) {
+                const auto top = vld1q_u8(row_0 + x * 2 * BYTES_PER_PIXEL);
+                const auto bottom = vld1q_u8(row_1 + x * 2 * BYTES_PER_PIXEL);
+
+                const auto left = vaddl_u8(vget_low_u8(top), vget_low_u8(bottom));
+                const auto right = vaddl_u8(vget_high_u8(top), vget_high_u8(bottom));
+
+                const auto sum = vcombine_u16(vadd_u16(vget_low_u16(left), vget_high_u16(left)),
+                                              vadd_u16(vget_low_u16(right), vget_high_u16(right)));
+                vst1_u8(dest + x * BYTES_PER_PIXEL, vrshrn_n_u16(sum, 2));
+            }
+#endif
+
+            for(; x < width; x++) {
+                const auto* top = row_0 + static_cast<size_t>(x) * 2 * BYTES_PER_PIXEL;
+                const auto* bottom = row_1 + static_cast<size_t>(x) * 2 * BYTES_PER_PIXEL;
+                for(uint32_t channel = 0; channel < BYTES_PER_PIXEL; channel++) {
+                    const auto sum = top[channel] + top[channel + next_column] + bottom[channel] + bottom[channel + next_column];
+                    dest[x * BYTES_PER_PIXEL + channel] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+
+        return mip;
+    }
+
+    /*!
+     * \brief An image file, and the mips of its most recent decode
+     *
+     * The texture streamer asks for a run of mips that ends with the smallest one, one mip at a time. The first mip of the run decodes the
+     * file and filters down the whole rest of the chain, and the others take their mip from that. The decoded mips are thrown away once
+     * someone takes the smallest one
+     */
+    class ImageMipChain {
+    public:
+        ImageMipChain(std::string name, filesystem::FileView file, const uint32_t width, const uint32_t height)
+            : name{std::move(name)},
+              file{std::move(file)},
+              width{width},
+              height{height},
+              num_mips{static_cast<uint32_t>(std::bit_width(std::max(width, height)))} {}
+
+        [[nodiscard]] std::vector<uint8_t> load_mip(const uint32_t mip) {
+            if(mip >= num_mips) {
+                return {};
+            }
+
+            std::lock_guard lock{mutex};
+
+            // Mips that were already taken are empty, so asking for one of them again decodes the file again
+            if(mip < first_decoded_mip || mip - first_decoded_mip >= decoded_mips.size() || decoded_mips[mip - first_decoded_mip].empty()) {
+                decode(mip);
+            }
+
+            if(decoded_mips.empty()) {
+                return {};
+            }
+
+            auto pixels = std::move(decoded_mips[mip - first_decoded_mip]);
+            if(mip + 1 == num_mips) {
+                decoded_mips.clear();
+            }
+
+            return pixels;
+        }
+
+    private:
+        std::string name;
+
+        filesystem::FileView file;
+
+        uint32_t width;
+
+        uint32_t height;
+
+        uint32_t num_mips;
+
+        std::mutex mutex;
+
+        uint32_t first_decoded_mip = 0;
+
+        /*!
+         * \brief Every mip from `first_decoded_mip` to the end of the chain
+         */
+        std::vector<std::vector<uint8_t>> decoded_mips;
+
+        void decode(const uint32_t first_mip) {
+            ZoneScoped;
+            decoded_mips.clear();
+            first_decoded_mip = first_mip;
+
+            const auto bytes = file.get_bytes();
+            int decoded_width;
+            int decoded_height;
+            int num_channels;
+            std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels{stbi_load_from_memory(bytes.data(),
+                                                                                               static_cast<int>(bytes.size()),
+                                                                                               &decoded_width,
+                                                                                               &decoded_height,
+                                                                                               &num_channels,
+                                                                                               BYTES_PER_PIXEL),
+                                                                         &stbi_image_free};
+            if(!pixels) {
+                logger->error("Could not decode texture {}: {}", name, stbi_failure_reason());
+                return;
+            }
+
+            if(static_cast<uint32_t>(decoded_width) != width || static_cast<uint32_t>(decoded_height) != height) {
+                logger->error("Texture {} decoded to {}x{}, but its header says it's {}x{}",
+                              name,
+                              decoded_width,
+                              decoded_height,
+                              width,
+                              height);
+                return;
+            }
+
+            decoded_mips.reserve(num_mips - first_mip);
+            if(first_mip == 0) {
+                decoded_mips.emplace_back(pixels.get(), pixels.get() + static_cast<size_t>(width) * height * BYTES_PER_PIXEL);
+            }
+
+            // Each mip is filtered down from the one before it, so we make every mip, but we only keep the ones that we were asked for
+            std::vector<uint8_t> skipped_mip;
+            const uint8_t* source = pixels.get();
+            auto source_width = width;
+            auto source_height = height;
+            for(uint32_t mip = 1; mip < num_mips; mip++) {
+                auto pixels_of_mip = filter_down(source, source_width, source_height);
+                source_width = std::max(source_width / 2, 1U);
+                source_height = std::max(source_height / 2, 1U);
+
+                if(mip >= first_mip) {
+                    decoded_mips.push_back(std::move(pixels_of_mip));
+                    source = decoded_mips.back().data();
+
+                } else {
+                    skipped_mip = std::move(pixels_of_mip);
+                    source = skipped_mip.data();
+                }
+            }
+        }
+    };
+
+    std::optional<StreamedTextureCreateInfo> load_image_texture(const std::string& name, filesystem::FileView file) {
+        const auto bytes = file.get_bytes();
+        if(bytes.empty() || bytes.size() > INT_MAX) {
+            logger->error("Texture {} is {} bytes, which stb_image can't decode", name, bytes.size());
+            return std::nullopt;
+        }
+
+        // Only the header is read here. The pixels are decoded on a worker, when the streamer loads the texture's mips
+        int width;
+        int height;
+        int num_channels;
+        if(stbi_info_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &num_channels) == 0) {
+            logger->error("Texture {} isn't a PNG, TGA, or JPEG file that Nova can decode: {}", name, stbi_failure_reason());
+            return std::nullopt;
+        }
+
+        if(width <= 0 || height <= 0) {
+            logger->error("Texture {} has no pixels", name);
+            return std::nullopt;
+        }
+
+        StreamedTextureCreateInfo create_info = {};
+        create_info.name = name;
+        create_info.width = static_cast<uint32_t>(width);
+        create_info.height = static_cast<uint32_t>(height);
+        create_info.format = rhi::PixelFormat::Rgba8;
+
+        // Loaders run on worker threads, possibly after the caller forgot about the texture, so they share the file and its decoded mips
+        auto chain = std::make_shared<ImageMipChain>(name, std::move(file), create_info.width, create_info.height);
+        create_info.load_mip = [chain = std::move(chain)](const uint32_t mip) { return chain->load_mip(mip); };
+
+        return create_info;
+    }
+
+    std::optional<StreamedTextureCreateInfo> load_texture_file(filesystem::FolderAccessorBase& folder, const std::string& path) {
+        ZoneScoped;
+        if(path.ends_with(".dds")) {
+            auto file_data = folder.read_file(path);
+            if(file_data.empty()) {
+                logger->error("Could not read texture {}", path);
+                return std::nullopt;
+            }
+
+            return load_dds_texture(path, std::move(file_data));
+        }
+
+        auto file = folder.map_file(path);
+        if(file.is_empty()) {
+            logger->error("Could not read texture {}", path);
+            return std::nullopt;
+        }
+
+        return load_image_texture(path, std::move(file));
+    }
+} // namespace nova::renderer
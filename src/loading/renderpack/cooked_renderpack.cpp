@@ -0,0 +1,743 @@
+#include "cooked_renderpack.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unordered_set>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/filesystem/folder_accessor.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "spirv_cache.hpp"
+
+namespace nova::renderer::renderpack {
+    static auto logger = make_logger("CookedRenderpack");
+
+    constexpr uint32_t COOKED_RENDERPACK_MAGIC = 0x4B4F4F43; // "COOK"
+
+    /*!
+     * \brief Version of the cooked format. Bump this whenever a field is added to or removed from anything in `RenderpackData`, or the
+     * loader starts making different data from the same files
+     */
+    constexpr uint32_t COOKED_RENDERPACK_VERSION = 14;
+
+    /*!
+     * \brief A file that a cooked renderpack was made from
+     */
+    struct CookedDependency {
+        /*!
+         * \brief The file's path in the renderpack. Paths that end in a slash are folders, which are hashed by the names of their items
+         */
+        std::string path;
+
+        /*!
+         * \brief Set for shaders, which are hashed by their SPIR-V cache key instead of their bytes
+         */
+        std::optional<rhi::ShaderStage> shader_stage;
+
+        uint64_t hash = 0;
+    };
+
+    /*!
+     * \brief Whether a (possibly const) type is the provided struct. `visit` is written once for each struct, and both reads and writes it
+     */
+    template <typename Value, typename Type>
+    concept CookedStruct = std::same_as<std::remove_const_t<Value>, Type>;
+
+    class CookedWriter {
+    public:
+        std::vector<uint8_t> bytes;
+
+        template <typename ValueType>
+        void value(const ValueType& item) {
+            if constexpr(std::is_arithmetic_v<ValueType> || std::is_enum_v<ValueType>) {
+                write_bytes(&item, sizeof(ValueType));
+
+            } else {
+                visit(*this, item);
+            }
+        }
+
+        void value(const std::string& str) {
+            value(static_cast<uint64_t>(str.size()));
+            write_bytes(str.data(), str.size());
+        }
+
+        template <typename ElementType>
+        void value(const std::vector<ElementType>& vector) {
+            value(static_cast<uint64_t>(vector.size()));
+
+            if constexpr(std::is_arithmetic_v<ElementType>) {
+                write_bytes(vector.data(), vector.size() * sizeof(ElementType));
+
+            } else {
+                for(const auto& element : vector) {
+                    value(element);
+                }
+            }
+        }
+
+        template <typename ValueType>
+        void value(const std::optional<ValueType>& optional) {
+            value(optional.has_value());
+            if(optional) {
+                value(*optional);
+            }
+        }
+
+        template <typename MapValueType>
+        void value(const std::unordered_map<std::string, MapValueType>& map) {
+            // Sorted, so the same renderpack always cooks to the same bytes
+            std::vector<std::pair<std::string, MapValueType>> entries{map.begin(), map.end()};
+            std::sort(entries.begin(), entries.end());
+
+            value(static_cast<uint64_t>(entries.size()));
+            for(const auto& [key, map_value] : entries) {
+                value(key);
+                value(map_value);
+            }
+        }
+
+    private:
+        void write_bytes(const void* data, const size_t num_bytes) {
+            const auto* data_bytes = static_cast<const uint8_t*>(data);
+            bytes.insert(bytes.end(), data_bytes, data_bytes + num_bytes);
+        }
+    };
+
+    class CookedReader {
+    public:
+        /*!
+         * \brief Set when the reader tried to read past the end of its bytes. Everything read after that is default-initialized
+         */
+        bool failed = false;
+
+        explicit CookedReader(const std::span<const uint8_t> bytes) : bytes{bytes} {}
+
+        [[nodiscard]] bool is_at_end() const { return position == bytes.size(); }
+
+        template <typename ValueType>
+        void value(ValueType& item) {
+            if constexpr(std::is_arithmetic_v<ValueType> || std::is_enum_v<ValueType>) {
+                read_bytes(&item, sizeof(ValueType));
+
+            } else {
+                visit(*this, item);
+            }
+        }
+
+        void value(std::string& str) {
+            uint64_t size = 0;
+            value(size);
+            if(!can_read(size)) {
+                return;
+            }
+
+            str.assign(reinterpret_cast<const char*>(bytes.data() + position), size);
+            position += size;
+        }
+
+        template <typename ElementType>
+        void value(std::vector<ElementType>& vector) {
+            uint64_t size = 0;
+            value(size);
+
+            // Every element takes at least a byte, so a corrupt size can't make us allocate more than the file is big
+            if(!can_read(size)) {
+                return;
+            }
+
+            if constexpr(std::is_arithmetic_v<ElementType>) {
+                if(!can_read(size * sizeof(ElementType))) {
+                    return;
+                }
+
+                vector.resize(size);
+                read_bytes(vector.data(), size * sizeof(ElementType));
+
+            } else {
+                vector.resize(size);
+                for(auto& element : vector) {
+                    value(element);
+                }
+            }
+        }
+
+        template <typename ValueType>
+        void value(std::optional<ValueType>& optional) {
+            bool has_value = false;
+            value(has_value);
+
+            optional.reset();
+            if(has_value) {
+                value(optional.emplace());
+            }
+        }
+
+        template <typename MapValueType>
+        void value(std::unordered_map<std::string, MapValueType>& map) {
+            uint64_t size = 0;
+            value(size);
+            if(!can_read(size)) {
+                return;
+            }
+
+            map.clear();
+            map.reserve(size);
+            for(uint64_t i = 0; i < size; i++) {
+                std::string key;
+                value(key);
+                value(map[std::move(key)]);
+            }
+        }
+
+    private:
+        std::span<const uint8_t> bytes;
+
+        uint64_t position = 0;
+
+        [[nodiscard]] bool can_read(const uint64_t num_bytes) {
+            if(failed || num_bytes > bytes.size() - position) {
+                failed = true;
+            }
+
+            return !failed;
+        }
+
+        void read_bytes(void* data, const uint64_t num_bytes) {
+            if(!can_read(num_bytes)) {
+                return;
+            }
+
+            std::memcpy(data, bytes.data() + position, num_bytes);
+            position += num_bytes;
+        }
+    };
+
+    /*!
+     * \brief The reflection of one of a cooked renderpack's shaders, so loading the renderpack doesn't have to run SPIRV-Cross on it
+     */
+    struct CookedShaderReflection {
+        ShaderReflectionCache::Key key = 0;
+
+        ShaderReflection reflection;
+    };
+
+    template <typename Archive, CookedStruct<CookedDependency> Dependency>
+    void visit(Archive& archive, Dependency& dependency) {
+        archive.value(dependency.path);
+        archive.value(dependency.shader_stage);
+        archive.value(dependency.hash);
+    }
+
+    template <typename Archive, CookedStruct<SamplerCreateInfo> Sampler>
+    void visit(Archive& archive, Sampler& sampler) {
+        archive.value(sampler.name);
+        archive.value(sampler.filter);
+        archive.value(sampler.wrap_mode);
+    }
+
+    template <typename Archive, CookedStruct<StencilOpState> Stencil>
+    void visit(Archive& archive, Stencil& stencil) {
+        archive.value(stencil.fail_op);
+        archive.value(stencil.pass_op);
+        archive.value(stencil.depth_fail_op);
+        archive.value(stencil.compare_op);
+        archive.value(stencil.compare_mask);
+        archive.value(stencil.write_mask);
+    }
+
+    template <typename Archive, CookedStruct<RenderpackShaderSource> Shader>
+    void visit(Archive& archive, Shader& shader) {
+        archive.value(shader.filename);
+        archive.value(shader.source);
+    }
+
+    template <typename Archive, CookedStruct<ShaderKeywordAxis> Axis>
+    void visit(Archive& archive, Axis& axis) {
+        archive.value(axis.name);
+        archive.value(axis.keywords);
+    }
+
+    template <typename Archive, CookedStruct<PipelineData> Pipeline>
+    void visit(Archive& archive, Pipeline& pipeline) {
+        archive.value(pipeline.name);
+        archive.value(pipeline.source_file);
+        archive.value(pipeline.parent_name);
+        archive.value(pipeline.pass);
+        archive.value(pipeline.defines);
+        archive.value(pipeline.keyword_axes);
+        archive.value(pipeline.specialization_constants);
+        archive.value(pipeline.states);
+        archive.value(pipeline.front_face);
+        archive.value(pipeline.back_face);
+        archive.value(pipeline.fallback);
+        archive.value(pipeline.depth_bias);
+        archive.value(pipeline.slope_scaled_depth_bias);
+        archive.value(pipeline.stencil_ref);
+        archive.value(pipeline.stencil_read_mask);
+        archive.value(pipeline.stencil_write_mask);
+        archive.value(pipeline.msaa_support);
+        archive.value(pipeline.primitive_mode);
+        archive.value(pipeline.vertex_layout);
+        archive.value(pipeline.source_color_blend_factor);
+        archive.value(pipeline.destination_color_blend_factor);
+        archive.value(pipeline.source_alpha_blend_factor);
+        archive.value(pipeline.destination_alpha_blend_factor);
+        archive.value(pipeline.depth_func);
+        archive.value(pipeline.render_queue);
+        archive.value(pipeline.scissor_mode);
+        archive.value(pipeline.vertex_shader);
+        archive.value(pipeline.geometry_shader);
+        archive.value(pipeline.tessellation_control_shader);
+        archive.value(pipeline.tessellation_evaluation_shader);
+        archive.value(pipeline.fragment_shader);
+    }
+
+    template <typename Archive, CookedStruct<TextureFormat> Format>
+    void visit(Archive& archive, Format& format) {
+        archive.value(format.pixel_format);
+        archive.value(format.dimension_type);
+        archive.value(format.width);
+        archive.value(format.height);
+        archive.value(format.num_layers);
+        archive.value(format.depth);
+        archive.value(format.num_samples);
+        archive.value(format.precision);
+    }
+
+    template <typename Archive, CookedStruct<TextureCreateInfo> Texture>
+    void visit(Archive& archive, Texture& texture) {
+        archive.value(texture.name);
+        archive.value(texture.usage);
+        archive.value(texture.format);
+        archive.value(texture.residency_priority);
+        archive.value(texture.num_mips);
+    }
+
+    /*!
+     * \brief Archives each component of a vector. This isn't a `visit` overload because argument-dependent lookup wouldn't find it for
+     * GLM's types
+     */
+    template <typename Archive, typename Vec>
+    void visit_components(Archive& archive, Vec& vec) {
+        for(glm::length_t i = 0; i < vec.length(); i++) {
+            archive.value(vec[i]);
+        }
+    }
+
+    template <typename Archive, CookedStruct<ParticleEmitterCreateInfo> Emitter>
+    void visit(Archive& archive, Emitter& emitter) {
+        archive.value(emitter.name);
+        archive.value(emitter.material);
+        archive.value(emitter.material_pass);
+        archive.value(emitter.max_particles);
+        archive.value(emitter.spawn_rate);
+        archive.value(emitter.min_lifetime);
+        archive.value(emitter.max_lifetime);
+        visit_components(archive, emitter.spawn_extent);
+        visit_components(archive, emitter.initial_velocity);
+        visit_components(archive, emitter.velocity_randomness);
+        visit_components(archive, emitter.acceleration);
+        archive.value(emitter.drag);
+        archive.value(emitter.start_size);
+        archive.value(emitter.end_size);
+        visit_components(archive, emitter.start_color);
+        visit_components(archive, emitter.end_color);
+    }
+
+    template <typename Archive, CookedStruct<RenderpackResourcesData> Resources>
+    void visit(Archive& archive, Resources& resources) {
+        archive.value(resources.render_targets);
+        archive.value(resources.samplers);
+        archive.value(resources.particle_emitters);
+    }
+
+    template <typename Archive, CookedStruct<TextureAttachmentInfo> Attachment>
+    void visit(Archive& archive, Attachment& attachment) {
+        archive.value(attachment.name);
+        archive.value(attachment.pixel_format);
+        archive.value(attachment.clear);
+        archive.value(attachment.store);
+        archive.value(attachment.num_samples);
+    }
+
+    template <typename Archive, CookedStruct<UpsampledOutput> Output>
+    void visit(Archive& archive, Output& output) {
+        archive.value(output.source);
+        archive.value(output.destination);
+        archive.value(output.depth);
+    }
+
+    template <typename Archive, CookedStruct<RenderPassCreateInfo> Pass>
+    void visit(Archive& archive, Pass& pass) {
+        archive.value(pass.name);
+        archive.value(pass.texture_inputs);
+        archive.value(pass.input_attachments);
+        archive.value(pass.texture_outputs);
+        archive.value(pass.depth_texture);
+        archive.value(pass.input_buffers);
+        archive.value(pass.output_buffers);
+        archive.value(pass.pipeline_names);
+        archive.value(pass.compute_shader);
+        archive.value(pass.queue);
+        archive.value(pass.views);
+        archive.value(pass.is_cached);
+        archive.value(pass.has_depth_prepass);
+        archive.value(pass.reuses_commands);
+        archive.value(pass.enabled_by);
+        archive.value(pass.update_interval);
+        archive.value(pass.upsampled_outputs);
+        archive.value(pass.shading_rate);
+        archive.value(pass.uses_adaptive_shading_rate);
+        archive.value(pass.uses_order_independent_transparency);
+    }
+
+    template <typename Archive, CookedStruct<RendergraphData> Graph>
+    void visit(Archive& archive, Graph& graph) {
+        archive.value(graph.passes);
+        archive.value(graph.builtin_passes);
+    }
+
+    template <typename Archive, CookedStruct<MaterialPass> Pass>
+    void visit(Archive& archive, Pass& pass) {
+        // The descriptor sets are made when the material is, so they aren't cooked
+        archive.value(pass.name);
+        archive.value(pass.material_name);
+        archive.value(pass.pipeline);
+        archive.value(pass.bindings);
+        archive.value(pass.keywords);
+    }
+
+    template <typename Archive, CookedStruct<MaterialData> Material>
+    void visit(Archive& archive, Material& material) {
+        archive.value(material.name);
+        archive.value(material.passes);
+        archive.value(material.geometry_filter);
+    }
+
+    template <typename Archive, CookedStruct<rhi::RhiResourceBindingDescription> Description>
+    void visit(Archive& archive, Description& description) {
+        archive.value(description.set);
+        archive.value(description.binding);
+        archive.value(description.count);
+        archive.value(description.is_unbounded);
+        archive.value(description.type);
+        archive.value(description.stages);
+    }
+
+    template <typename Archive, CookedStruct<ShaderReflection::Binding> Binding>
+    void visit(Archive& archive, Binding& binding) {
+        archive.value(binding.name);
+        archive.value(binding.description);
+    }
+
+    template <typename Archive, CookedStruct<ShaderReflection::SpecializationConstant> Constant>
+    void visit(Archive& archive, Constant& constant) {
+        archive.value(constant.name);
+        archive.value(constant.constant_id);
+        archive.value(constant.type);
+    }
+
+    template <typename Archive, CookedStruct<ShaderReflection> Reflection>
+    void visit(Archive& archive, Reflection& reflection) {
+        archive.value(reflection.bindings);
+        archive.value(reflection.specialization_constants);
+        archive.value(reflection.workgroup_size.x);
+        archive.value(reflection.workgroup_size.y);
+        archive.value(reflection.workgroup_size.z);
+        archive.value(reflection.affects_depth);
+    }
+
+    template <typename Archive, CookedStruct<CookedShaderReflection> Reflection>
+    void visit(Archive& archive, Reflection& reflection) {
+        archive.value(reflection.key);
+        archive.value(reflection.reflection);
+    }
+
+    template <typename Archive, CookedStruct<RenderpackData> Renderpack>
+    void visit(Archive& archive, Renderpack& renderpack) {
+        archive.value(renderpack.pipelines);
+        archive.value(renderpack.graph_data);
+        archive.value(renderpack.materials);
+        archive.value(renderpack.resources);
+        archive.value(renderpack.name);
+    }
+
+    static uint64_t hash_dependency(const CookedDependency& dependency, filesystem::FolderAccessorBase* folder_access) {
+        Fnv1aHasher hasher;
+
+        if(dependency.path.ends_with('/')) {
+            // A new pipeline or material file changes the renderpack even though none of the files we know about changed
+            auto items = folder_access->get_all_items_in_folder(dependency.path.substr(0, dependency.path.size() - 1));
+            std::sort(items.begin(), items.end());
+            for(const std::string& item : items) {
+                hasher.add(item);
+            }
+
+            return hasher.get();
+        }
+
+        const auto file = folder_access->map_file(dependency.path);
+        if(dependency.shader_stage && !dependency.path.ends_with(".spirv")) {
+            const auto language = dependency.path.ends_with(".hlsl") ? rhi::ShaderLanguage::Hlsl : rhi::ShaderLanguage::Glsl;
+            return SpirvCache::make_key(file.as_string(), *dependency.shader_stage, language, folder_access);
+        }
+
+        hasher.add(file.as_string());
+        return hasher.get();
+    }
+
+    static std::vector<CookedDependency> find_dependencies(const RenderpackData& data, filesystem::FolderAccessorBase* folder_access) {
+        std::vector<CookedDependency> dependencies;
+        dependencies.push_back({RESOURCES_FILE});
+        dependencies.push_back({RENDERGRAPH_FILE});
+        dependencies.push_back({fmt::format("{}/", MATERIALS_DIRECTORY)});
+
+        // Hash every pipeline and material file, even the ones that didn't load, so fixing one of them makes the renderpack stale
+        for(const std::string& item : folder_access->get_all_items_in_folder(MATERIALS_DIRECTORY)) {
+            if(item.ends_with(".pipeline") || item.ends_with(MATERIAL_FILE_EXTENSION)) {
+                dependencies.push_back({fmt::format("{}/{}", MATERIALS_DIRECTORY, item)});
+            }
+        }
+
+        const auto add_shader = [&](const std::optional<RenderpackShaderSource>& shader, const rhi::ShaderStage stage) {
+            if(shader) {
+                dependencies.push_back({shader->filename, stage});
+            }
+        };
+
+        for(const PipelineData& pipeline : data.pipelines) {
+            dependencies.push_back({pipeline.vertex_shader.filename, rhi::ShaderStage::Vertex});
+            add_shader(pipeline.geometry_shader, rhi::ShaderStage::Geometry);
+            add_shader(pipeline.tessellation_control_shader, rhi::ShaderStage::TessellationControl);
+            add_shader(pipeline.tessellation_evaluation_shader, rhi::ShaderStage::TessellationEvaluation);
+            add_shader(pipeline.fragment_shader, rhi::ShaderStage::Pixel);
+        }
+
+        for(const RenderPassCreateInfo& pass : data.graph_data.passes) {
+            add_shader(pass.compute_shader, rhi::ShaderStage::Compute);
+        }
+
+        for(CookedDependency& dependency : dependencies) {
+            dependency.hash = hash_dependency(dependency, folder_access);
+        }
+
+        return dependencies;
+    }
+
+    static std::vector<CookedShaderReflection> reflect_shaders(const RenderpackData& data) {
+        auto& reflection_cache = ShaderReflectionCache::get_instance();
+
+        std::vector<CookedShaderReflection> reflections;
+        std::unordered_set<ShaderReflectionCache::Key> found_keys;
+        const auto add_shader = [&](const std::optional<RenderpackShaderSource>& shader) {
+            if(!shader || shader->source.empty()) {
+                return;
+            }
+
+            if(const auto key = ShaderReflectionCache::make_key(shader->source); found_keys.emplace(key).second) {
+                reflections.push_back({key, *reflection_cache.get(shader->source)});
+            }
+        };
+
+        for(const PipelineData& pipeline : data.pipelines) {
+            add_shader(pipeline.vertex_shader);
+            add_shader(pipeline.geometry_shader);
+            add_shader(pipeline.tessellation_control_shader);
+            add_shader(pipeline.tessellation_evaluation_shader);
+            add_shader(pipeline.fragment_shader);
+        }
+
+        for(const RenderPassCreateInfo& pass : data.graph_data.passes) {
+            add_shader(pass.compute_shader);
+        }
+
+        return reflections;
+    }
+
+    std::vector<uint8_t> cook_renderpack(const RenderpackData& data, filesystem::FolderAccessorBase* folder_access) {
+        ZoneScoped;
+        CookedWriter writer;
+        writer.value(COOKED_RENDERPACK_MAGIC);
+        writer.value(COOKED_RENDERPACK_VERSION);
+        writer.value(find_dependencies(data, folder_access));
+        writer.value(data);
+        writer.value(reflect_shaders(data));
+
+        return std::move(writer.bytes);
+    }
+
+    std::optional<RenderpackData> uncook_renderpack(const std::span<const uint8_t> cooked, filesystem::FolderAccessorBase* folder_access) {
+        ZoneScoped;
+        CookedReader reader{cooked};
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        reader.value(magic);
+        reader.value(version);
+        if(reader.failed || magic != COOKED_RENDERPACK_MAGIC) {
+            logger->warn("Cooked renderpack is corrupt, ignoring it");
+            return std::nullopt;
+        }
+
+        if(version != COOKED_RENDERPACK_VERSION) {
+            logger->info("Cooked renderpack is from version {} of the cooked format, but this is version {}. Ignoring it",
+                         version,
+                         COOKED_RENDERPACK_VERSION);
+            return std::nullopt;
+        }
+
+        std::vector<CookedDependency> dependencies;
+        reader.value(dependencies);
+
+        if(folder_access != nullptr) {
+            for(const CookedDependency& dependency : dependencies) {
+                if(hash_dependency(dependency, folder_access) != dependency.hash) {
+                    logger->debug("{} changed since the renderpack was cooked", dependency.path);
+                    return std::nullopt;
+                }
+            }
+        }
+
+        RenderpackData data;
+        std::vector<CookedShaderReflection> reflections;
+        reader.value(data);
+        reader.value(reflections);
+        if(reader.failed || !reader.is_at_end()) {
+            logger->warn("Cooked renderpack is corrupt, ignoring it");
+            return std::nullopt;
+        }
+
+        auto& reflection_cache = ShaderReflectionCache::get_instance();
+        for(CookedShaderReflection& reflection : reflections) {
+            reflection_cache.add(reflection.key, std::move(reflection.reflection));
+        }
+
+        return data;
+    }
+
+    std::vector<uint8_t> cook_shader_reflection(const ShaderReflection& reflection) {
+        CookedWriter writer;
+        writer.value(COOKED_RENDERPACK_MAGIC);
+        writer.value(COOKED_RENDERPACK_VERSION);
+        writer.value(reflection);
+
+        return std::move(writer.bytes);
+    }
+
+    std::optional<ShaderReflection> uncook_shader_reflection(const std::span<const uint8_t> cooked) {
+        CookedReader reader{cooked};
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        reader.value(magic);
+        reader.value(version);
+        if(reader.failed || magic != COOKED_RENDERPACK_MAGIC || version != COOKED_RENDERPACK_VERSION) {
+            return std::nullopt;
+        }
+
+        ShaderReflection reflection;
+        reader.value(reflection);
+        if(reader.failed || !reader.is_at_end()) {
+            return std::nullopt;
+        }
+
+        return reflection;
+    }
+
+    CookedRenderpackCache& CookedRenderpackCache::get_instance() {
+        static CookedRenderpackCache instance;
+
+        return instance;
+    }
+
+    void CookedRenderpackCache::configure(std::filesystem::path directory) {
+        std::lock_guard lock{cache_mutex};
+
+        cache_directory = std::move(directory);
+    }
+
+    std::optional<RenderpackData> CookedRenderpackCache::find(const std::string& renderpack_name,
+                                                              filesystem::FolderAccessorBase* folder_access) {
+        ZoneScoped;
+        if(folder_access->does_resource_exist(COOKED_RENDERPACK_FILE)) {
+            // A renderpack that ships without its sources has nothing to check its cooked data against
+            auto* sources = folder_access->does_resource_exist(RESOURCES_FILE) ? folder_access : nullptr;
+
+            const auto cooked_file = folder_access->map_file(COOKED_RENDERPACK_FILE);
+            if(auto data = uncook_renderpack(cooked_file.get_bytes(), sources)) {
+                data->name = renderpack_name;
+                return data;
+            }
+        }
+
+        std::vector<uint8_t> cooked;
+        {
+            std::lock_guard lock{cache_mutex};
+
+            std::ifstream file{get_path_for_renderpack(renderpack_name), std::ios::binary | std::ios::ate};
+            if(!file) {
+                return std::nullopt;
+            }
+
+            cooked.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(cooked.data()), static_cast<std::streamsize>(cooked.size()));
+            if(!file) {
+                return std::nullopt;
+            }
+        }
+
+        auto data = uncook_renderpack(cooked, folder_access);
+        if(data) {
+            data->name = renderpack_name;
+        }
+
+        return data;
+    }
+
+    void CookedRenderpackCache::store(const RenderpackData& data, filesystem::FolderAccessorBase* folder_access) {
+        ZoneScoped;
+        const auto cooked = cook_renderpack(data, folder_access);
+
+        std::lock_guard lock{cache_mutex};
+
+        std::error_code err;
+        std::filesystem::create_directories(cache_directory, err);
+
+        // Write to a temporary file first, so another process loading the same renderpack never sees half of it
+        const auto path = get_path_for_renderpack(data.name);
+        auto temp_path = path;
+        temp_path += ".tmp";
+
+        {
+            std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+            if(!file) {
+                logger->warn("Could not open {} to cook renderpack {}", temp_path.string(), data.name);
+                return;
+            }
+
+            file.write(reinterpret_cast<const char*>(cooked.data()), static_cast<std::streamsize>(cooked.size()));
+        }
+
+        std::filesystem::rename(temp_path, path, err);
+        if(err) {
+            logger->warn("Could not cook renderpack {} to {}: {}", data.name, path.string(), err.message());
+        }
+    }
+
+    std::filesystem::path CookedRenderpackCache::get_path_for_renderpack(const std::string& renderpack_name) const {
+        // Renderpack names may be paths to zip files, which don't make good file names
+        Fnv1aHasher hasher;
+        hasher.add(renderpack_name);
+
+        return cache_directory / fmt::format("{:016x}.cooked", hasher.get());
+    }
+} // namespace nova::renderer::renderpack
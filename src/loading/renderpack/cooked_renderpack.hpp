@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "nova_renderer/renderpack_data.hpp"
+
+#include "renderer/pipeline_reflection.hpp"
+
+namespace nova::filesystem {
+    class FolderAccessorBase;
+}
+
+namespace nova::renderer::renderpack {
+    /*!
+     * \brief A renderpack that's already been parsed, validated, and compiled, flattened into one binary blob
+     *
+     * A cooked renderpack has everything that `load_renderpack_data` would make from the renderpack's files, SPIR-V included, so loading
+     * one is a straight read of its bytes. It also lists the files it was cooked from along with a hash of each of them. Shaders are
+     * hashed with their SPIR-V cache key, which covers their includes and the compiler version. If any of those hashes don't match the
+     * files anymore, the cooked renderpack is stale and gets thrown away
+     *
+     * A renderpack can ship a cooked `renderpack.cooked` file in its root. If the renderpack doesn't have its source files at all, that
+     * file is used without checking it against them. Otherwise, Nova cooks every renderpack it loads into its own cache directory, so the
+     * next load of the same files is fast
+     */
+    class CookedRenderpackCache {
+    public:
+        static CookedRenderpackCache& get_instance();
+
+        /*!
+         * \brief Sets where Nova keeps the renderpacks it cooked
+         */
+        void configure(std::filesystem::path directory);
+
+        /*!
+         * \brief Looks for an up-to-date cooked version of the renderpack, first in the renderpack itself, then in the cache directory
+         *
+         * \return The renderpack's data, or nothing if there isn't a cooked renderpack that matches the renderpack's files
+         */
+        [[nodiscard]] std::optional<RenderpackData> find(const std::string& renderpack_name, filesystem::FolderAccessorBase* folder_access);
+
+        /*!
+         * \brief Cooks a freshly loaded renderpack into the cache directory
+         */
+        void store(const RenderpackData& data, filesystem::FolderAccessorBase* folder_access);
+
+    private:
+        std::mutex cache_mutex;
+
+        std::filesystem::path cache_directory = "cache/renderpacks";
+
+        [[nodiscard]] std::filesystem::path get_path_for_renderpack(const std::string& renderpack_name) const;
+    };
+
+    /*!
+     * \brief Flattens renderpack data into a cooked renderpack, along with hashes of the files in the renderpack that it came from
+     */
+    [[nodiscard]] std::vector<uint8_t> cook_renderpack(const RenderpackData& data, filesystem::FolderAccessorBase* folder_access);
+
+    /*!
+     * \brief Reads a cooked renderpack
+     *
+     * \param cooked The cooked renderpack's bytes
+     * \param folder_access The renderpack to check the cooked data against, or nullptr to use it without checking
+     *
+     * \return The renderpack's data, or nothing if it's from a different version of Nova, is corrupt, or is stale
+     */
+    [[nodiscard]] std::optional<RenderpackData> uncook_renderpack(std::span<const uint8_t> cooked,
+                                                                  filesystem::FolderAccessorBase* folder_access);
+
+    /*!
+     * \brief Flattens a shader's reflection, in the same format that cooked renderpacks keep their shaders' reflections in
+     */
+    [[nodiscard]] std::vector<uint8_t> cook_shader_reflection(const ShaderReflection& reflection);
+
+    /*!
+     * \brief Reads a shader reflection from `cook_shader_reflection`
+     *
+     * \return The reflection, or nothing if it's corrupt or from a different version of Nova
+     */
+    [[nodiscard]] std::optional<ShaderReflection> uncook_shader_reflection(std::span<const uint8_t> cooked);
+} // namespace nova::renderer::renderpack
@@ -1,5 +1,7 @@
 #include "render_graph_builder.hpp"
 
+#include <algorithm>
+
 #include <Tracy.hpp>
 #include <rx/core/algorithm/max.h>
 #include <rx/core/algorithm/min.h>
@@ -23,7 +25,7 @@ namespace nova::renderer::renderpack {
      * \param resource_to_write_pass A map from resource name to list of passes that write to that resource. Useful for
      * resolving the implicit dependencies of a pass
      * \param depth The depth in the tree that we're at. If this number ever grows bigger than the total number of
-     * passes, there's a circular dependency somewhere in the render graph. This is Bad and we hate it
+     * passes, there's a circular dependency somewhere in the render graph. This is Bad and we hate it, so we stop looking
      */
     void add_dependent_passes(const std::string& pass_name,
                               const std::unordered_map<std::string, RenderPassCreateInfo>& passes,
@@ -105,6 +107,14 @@ namespace nova::renderer::renderpack {
                 write_pass_list->push_back(pass.name);
             });
 
+            if(pass.depth_texture) {
+                auto* write_pass_list = resource_to_write_pass.find(pass.depth_texture->name);
+                if(!write_pass_list) {
+                    write_pass_list = resource_to_write_pass.insert(pass.depth_texture->name, {});
+                }
+                write_pass_list->push_back(pass.name);
+            }
+
             pass.output_buffers.each_fwd([&](const std::string& buffer_name) {
                 auto* write_pass_list = resource_to_write_pass.find(buffer_name);
                 if(!write_pass_list) {
@@ -170,10 +180,35 @@ namespace nova::renderer::renderpack {
                               const uint32_t depth) {
         if(depth > passes.size()) {
             logger->error("Circular render graph detected! Please fix your render graph to not have circular dependencies");
+            return;
         }
 
         const auto& pass = *passes.find(pass_name);
 
+        // Passes that write the same texture go in the order they're listed in, so that a pass which loads a texture draws over what
+        // the passes before it drew instead of under it
+        const auto add_previous_writer = [&](const std::string& texture_name) {
+            const auto* write_passes = resource_to_write_pass.find(texture_name);
+            if(write_passes == nullptr) {
+                return;
+            }
+
+            const auto pass_idx = write_passes->find(pass_name);
+            if(pass_idx == std::vector<std::string>::k_npos || pass_idx == 0) {
+                return;
+            }
+
+            const auto& previous_writer = (*write_passes)[pass_idx - 1];
+            ordered_passes.push_back(previous_writer);
+            add_dependent_passes(previous_writer, passes, ordered_passes, resource_to_write_pass, depth + 1);
+        };
+
+        pass.texture_outputs.each_fwd([&](const TextureAttachmentInfo& output) { add_previous_writer(output.name); });
+
+        if(pass.depth_texture) {
+            add_previous_writer(pass.depth_texture->name);
+        }
+
         pass.texture_inputs.each_fwd([&](const std::string& texture_name) {
             if(const auto write_passes = resource_to_write_pass.find(texture_name); write_passes == nullptr) {
                 // TODO: Ignore the implicitly defined resources
@@ -203,74 +238,164 @@ namespace nova::renderer::renderpack {
     void determine_usage_order_of_textures(const std::vector<RenderPassCreateInfo>& passes,
                                            std::unordered_map<std::string, Range>& resource_used_range,
                                            std::vector<std::string>& resources_in_order) {
-        uint32_t pass_idx = 0;
-        passes.each_fwd([&](const RenderPassCreateInfo& pass) {
-            // color attachments
-            pass.texture_inputs.each_fwd([&](const std::string& input) {
-                const auto tex_range = resource_used_range.find(input);
-
-                if(pass_idx < tex_range->first_write_pass) {
-                    tex_range->first_write_pass = pass_idx;
-                } else if(pass_idx > tex_range->last_write_pass) {
-                    tex_range->last_write_pass = pass_idx;
-                }
+        const auto use_texture = [&](const std::string& name, const uint32_t pass_idx, const bool is_read, const bool is_write) {
+            auto& tex_range = resource_used_range[name];
 
-                if(resources_in_order.find(input) == std::vector<std::string>::k_npos) {
-                    resources_in_order.push_back(input);
-                }
-            });
+            if(is_read) {
+                tex_range.first_read_pass = std::min(tex_range.first_read_pass, pass_idx);
+                tex_range.last_read_pass = std::max(tex_range.last_read_pass, pass_idx);
+            }
 
-            pass.texture_outputs.each_fwd([&](const TextureAttachmentInfo& output) {
-                const auto tex_range = resource_used_range.find(output.name);
+            if(is_write) {
+                tex_range.first_write_pass = std::min(tex_range.first_write_pass, pass_idx);
+                tex_range.last_write_pass = std::max(tex_range.last_write_pass, pass_idx);
+            }
 
-                if(pass_idx < tex_range->first_write_pass) {
-                    tex_range->first_write_pass = pass_idx;
-                } else if(pass_idx > tex_range->last_write_pass) {
-                    tex_range->last_write_pass = pass_idx;
-                }
+            if(std::find(resources_in_order.begin(), resources_in_order.end(), name) == resources_in_order.end()) {
+                resources_in_order.push_back(name);
+            }
+        };
 
-                if(resources_in_order.find(output.name) == std::vector<std::string>::k_npos) {
-                    resources_in_order.push_back(output.name);
-                }
-            });
+        for(uint32_t pass_idx = 0; pass_idx < passes.size(); pass_idx++) {
+            const auto& pass = passes[pass_idx];
 
-            pass_idx++;
-        });
+            for(const std::string& input : pass.texture_inputs) {
+                use_texture(input, pass_idx, true, false);
+            }
+
+            // An attachment that isn't cleared gets loaded, so the pass reads whatever was in it before
+            for(const TextureAttachmentInfo& output : pass.texture_outputs) {
+                use_texture(output.name, pass_idx, !output.clear, true);
+            }
+
+            if(pass.depth_texture) {
+                use_texture(pass.depth_texture->name, pass_idx, !pass.depth_texture->clear, true);
+            }
+        }
     }
 
-    std::unordered_map<std::string, std::string> determine_aliasing_of_textures(const std::unordered_map<std::string, TextureCreateInfo>& textures,
-                                                                   const std::unordered_map<std::string, Range>& resource_used_range,
-                                                                   const std::vector<std::string>& resources_in_order) {
+    std::unordered_map<std::string, std::string> determine_aliasing_of_textures(
+        const std::unordered_map<std::string, TextureCreateInfo>& textures,
+        const std::unordered_map<std::string, Range>& resource_used_range,
+        const std::vector<std::string>& resources_in_order) {
         std::unordered_map<std::string, std::string> aliases;
 
-        for(size_t i = 0; i < resources_in_order.size(); i++) {
-            const auto& to_alias_name = resources_in_order[i];
-            logger->debug("Determining if we can alias `%s`. Does it exist? %d",
-                            to_alias_name,
-                            (textures.find(to_alias_name) != nullptr));
+        // Each group is a list of textures whose ranges are all disjoint with each other. The first texture in a group names the group
+        std::vector<std::vector<std::string>> alias_groups;
 
+        for(const std::string& to_alias_name : resources_in_order) {
             if(to_alias_name == BACKBUFFER_NAME || to_alias_name == SCENE_OUTPUT_RT_NAME) {
                 // Yay special cases!
                 continue;
             }
 
-            const auto& to_alias_format = textures.find(to_alias_name)->format;
-
-            // Only try to alias with lower-indexed resources
-            for(size_t j = 0; j < i; j++) {
-                logger->debug("Trying to alias it with resource at index %zu out of %zu", j, resources_in_order.size());
-                const std::string& try_alias_name = resources_in_order[j];
-                if(resource_used_range.find(to_alias_name)->is_disjoint_with(*resource_used_range.find(try_alias_name))) {
-                    // They can be aliased if they have the same format
-                    const auto& try_alias_format = textures.find(try_alias_name)->format;
-                    if(to_alias_format == try_alias_format) {
-                        aliases.insert(to_alias_name, try_alias_name);
-                    }
-                }
+            if(textures.find(to_alias_name) == textures.end()) {
+                // Not a dynamic texture, so the renderpack doesn't own its memory
+                continue;
+            }
+
+            const auto& to_alias_range = resource_used_range.at(to_alias_name);
+
+            auto group_itr = std::find_if(alias_groups.begin(), alias_groups.end(), [&](const std::vector<std::string>& group) {
+                return std::all_of(group.begin(), group.end(), [&](const std::string& member) {
+                    return to_alias_range.is_disjoint_with(resource_used_range.at(member));
+                });
+            });
+
+            if(group_itr != alias_groups.end()) {
+                logger->debug("Aliasing `%s` with `%s`", to_alias_name, group_itr->front());
+                aliases.emplace(to_alias_name, group_itr->front());
+                group_itr->push_back(to_alias_name);
+
+            } else {
+                alias_groups.push_back({to_alias_name});
             }
         }
 
         return aliases;
     }
 
+    void determine_attachment_stores(std::vector<RenderPassCreateInfo>& passes,
+                                     const std::unordered_map<std::string, Range>& resource_used_range) {
+        const auto needs_store = [&](const std::string& name, const uint32_t pass_idx) {
+            const auto range_itr = resource_used_range.find(name);
+            if(name == BACKBUFFER_NAME || range_itr == resource_used_range.end()) {
+                return true;
+            }
+
+            // Textures that can't alias get read before they're written, so next frame wants whatever this frame left in them
+            const auto& range = range_itr->second;
+            return !range.can_alias() || (range.has_reader() && range.last_read_pass > pass_idx);
+        };
+
+        for(uint32_t pass_idx = 0; pass_idx < passes.size(); pass_idx++) {
+            auto& pass = passes[pass_idx];
+
+            // Later frames read what cached and intermittent passes rendered, even when nothing reads it this frame
+            for(TextureAttachmentInfo& output : pass.texture_outputs) {
+                output.store = pass.keeps_outputs() || needs_store(output.name, pass_idx);
+            }
+
+            if(pass.depth_texture) {
+                pass.depth_texture->store = pass.keeps_outputs() || needs_store(pass.depth_texture->name, pass_idx);
+            }
+        }
+    }
+
+    std::unordered_set<std::string> determine_transient_textures(const std::vector<RenderPassCreateInfo>& passes,
+                                                                 const std::unordered_map<std::string, TextureCreateInfo>& textures) {
+        std::unordered_set<std::string> candidates;
+        std::unordered_set<std::string> seen_textures;
+        std::unordered_set<std::string> disqualified;
+        std::unordered_set<std::string> read_as_input_attachment;
+
+        // Whatever was in a texture before its first use gets thrown away, so only that use has to clear it
+        const auto write_texture = [&](const std::string& name, const bool clears, const bool keeps_memory) {
+            if(seen_textures.insert(name).second && clears) {
+                candidates.insert(name);
+            }
+
+            if(keeps_memory) {
+                disqualified.insert(name);
+            }
+        };
+
+        for(const RenderPassCreateInfo& pass : passes) {
+            // Compute passes use their textures as storage images, which can't be transient. Cached and intermittent passes'
+            // outputs have to last until the next time they render
+            const auto is_compute_pass = pass.is_compute_pass();
+            const auto keeps_memory = is_compute_pass || pass.keeps_outputs();
+
+            for(const std::string& input : pass.texture_inputs) {
+                const auto is_input_attachment = std::find(pass.input_attachments.begin(), pass.input_attachments.end(), input) !=
+                                                 pass.input_attachments.end();
+                if(is_input_attachment && !is_compute_pass && seen_textures.find(input) != seen_textures.end()) {
+                    read_as_input_attachment.insert(input);
+
+                } else {
+                    disqualified.insert(input);
+                }
+            }
+
+            for(const TextureAttachmentInfo& output : pass.texture_outputs) {
+                write_texture(output.name, output.clear, keeps_memory);
+            }
+
+            if(pass.depth_texture) {
+                write_texture(pass.depth_texture->name, pass.depth_texture->clear, keeps_memory);
+            }
+        }
+
+        // Multisampled textures are already resolved out of a transient image, and passes that render to them are never merged
+        std::unordered_set<std::string> transient_textures;
+        for(const std::string& name : candidates) {
+            const auto texture_itr = textures.find(name);
+            if(texture_itr != textures.end() && texture_itr->second.format.num_samples <= 1 &&
+               disqualified.find(name) == disqualified.end() && read_as_input_attachment.find(name) != read_as_input_attachment.end()) {
+                transient_textures.insert(name);
+            }
+        }
+
+        return transient_textures;
+    }
 } // namespace nova::renderer::renderpack
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unordered_set>
+
 #include "nova_renderer/renderpack_data.hpp"
 #include "nova_renderer/util/result.hpp"
 
@@ -47,15 +49,43 @@ namespace nova::renderer::renderpack {
                                            std::vector<std::string>& resources_in_order);
 
     /*!
-     * \brief Determines which textures can be aliased to which other textures
+     * \brief Determines which textures can share memory with which other textures
+     *
+     * Textures are greedily put into groups where no two textures are used at the same time. Any two textures in a group can live in the
+     * same memory, no matter their formats. Only textures in `textures` are considered
      *
      * \param textures All the dynamic textures that this frame graph needs
      * \param resource_used_range The range of passes where each texture is used
      * \param resources_in_order The dynamic textures in usage order
      *
-     * \return A map from texture name to the name of the texture the first texture can be aliased with
+     * \return A map from texture name to the name of the first texture in its group. The first texture of each group isn't in the map
+     */
+    std::unordered_map<std::string, std::string> determine_aliasing_of_textures(
+        const std::unordered_map<std::string, TextureCreateInfo>& textures,
+        const std::unordered_map<std::string, Range>& resource_used_range,
+        const std::vector<std::string>& resources_in_order);
+
+    /*!
+     * \brief Figures out which attachments each pass has to store, and sets their `store` flag
+     *
+     * A pass only has to store an attachment if a later pass reads it, or loads it instead of clearing it. That includes next frame's
+     * passes that read it before it's cleared again, which is every pass for textures that can't alias. Cached passes store everything
+     *
+     * \param passes All the passes in the current frame graph, in execution order
+     * \param resource_used_range The range of passes where each texture is used, from `determine_usage_order_of_textures`
+     */
+    void determine_attachment_stores(std::vector<RenderPassCreateInfo>& passes,
+                                     const std::unordered_map<std::string, Range>& resource_used_range);
+
+    /*!
+     * \brief Finds the textures that can be transient render targets
+     *
+     * A texture can be transient if the first pass to use it each frame clears it, and every pass that reads it reads it as an input
+     * attachment. The rendergraph keeps those in tile memory, inside the renderpass that it merges their writers and readers into
+     *
+     * \param passes All the passes in the current frame graph, in execution order
+     * \param textures All the dynamic textures that this frame graph needs. Only these are considered
      */
-    std::unordered_map<std::string, std::string> determine_aliasing_of_textures(const std::unordered_map<std::string, TextureCreateInfo>& textures,
-                                                                   const std::unordered_map<std::string, Range>& resource_used_range,
-                                                                   const std::vector<std::string>& resources_in_order);
+    std::unordered_set<std::string> determine_transient_textures(const std::vector<RenderPassCreateInfo>& passes,
+                                                                 const std::unordered_map<std::string, TextureCreateInfo>& textures);
 } // namespace nova::renderer::renderpack
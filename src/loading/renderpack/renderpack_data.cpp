@@ -1,5 +1,7 @@
 #include "nova_renderer/renderpack_data.hpp"
 
+#include <algorithm>
+
 #include <rx/core/log.h>
 
 #include "nova_renderer/rhi/rhi_enums.hpp"
@@ -19,7 +21,8 @@ namespace nova::renderer::renderpack {
 
     bool TextureFormat::operator==(const TextureFormat& other) const {
         return pixel_format == other.pixel_format && dimension_type == other.dimension_type && width == other.width &&
-               height == other.height;
+               height == other.height && num_layers == other.num_layers && depth == other.depth &&
+               num_samples == other.num_samples && precision == other.precision;
     }
 
     bool TextureFormat::operator!=(const TextureFormat& other) const { return !(*this == other); }
@@ -34,6 +37,10 @@ namespace nova::renderer::renderpack {
                                                                      texture_dimension_type_enum_from_json);
         format.width = get_json_value<float>(json, "width", 0);
         format.height = get_json_value<float>(json, "height", 0);
+        format.num_layers = get_json_value<uint32_t>(json, "layers", 1);
+        format.depth = get_json_value<uint32_t>(json, "depth", 1);
+        format.num_samples = get_json_value<uint32_t>(json, "samples", 1);
+        format.precision = get_json_value(json, "precision", TexturePrecision::Exact, texture_precision_enum_from_json);
 
         return format;
     }
@@ -51,6 +58,7 @@ namespace nova::renderer::renderpack {
         RenderpackResourcesData data;
         data.render_targets = get_json_array<TextureCreateInfo>(json, "textures");
         data.samplers = get_json_array<SamplerCreateInfo>(json, "samplers");
+        data.particle_emitters = get_json_array<ParticleEmitterCreateInfo>(json, "particleEmitters");
 
         // TODO: buffers
         // TODO: arbitrary images
@@ -69,10 +77,21 @@ namespace nova::renderer::renderpack {
         return info;
     }
 
+    UpsampledOutput UpsampledOutput::from_json(const nlohmann::json& json) {
+        UpsampledOutput output = {};
+
+        FILL_REQUIRED_FIELD(output.source, get_json_opt<std::string>(json, "source"));
+        FILL_REQUIRED_FIELD(output.destination, get_json_opt<std::string>(json, "destination"));
+        FILL_REQUIRED_FIELD(output.depth, get_json_opt<std::string>(json, "depth"));
+
+        return output;
+    }
+
     RenderPassCreateInfo RenderPassCreateInfo::from_json(const nlohmann::json& json) {
         RenderPassCreateInfo info = {};
 
         info.texture_inputs = get_json_array<std::string>(json, "textureInputs");
+        info.input_attachments = get_json_array<std::string>(json, "inputAttachments");
         info.texture_outputs = get_json_array<TextureAttachmentInfo>(json, "textureOutputs");
         info.depth_texture = get_json_opt<TextureAttachmentInfo>(json, "depthTexture");
 
@@ -81,9 +100,47 @@ namespace nova::renderer::renderpack {
 
         info.name = get_json_value<std::string>(json, "name", "<NAME_MISSING>");
 
+        if(const auto compute_shader_name = get_json_opt<std::string>(json, "computeShader"); compute_shader_name) {
+            info.compute_shader = RenderpackShaderSource{};
+            info.compute_shader->filename = *compute_shader_name;
+        }
+
+        info.queue = get_json_value<bool>(json, "asyncCompute", false) ? rhi::QueueType::AsyncCompute : rhi::QueueType::Graphics;
+
+        info.views = get_json_array<std::string>(json, "views");
+
+        info.is_cached = get_json_value<bool>(json, "cached", false);
+
+        info.has_depth_prepass = get_json_value<bool>(json, "depthPrepass", false);
+
+        info.reuses_commands = get_json_value<bool>(json, "reuseCommands", false);
+
+        info.enabled_by = get_json_value<std::string>(json, "enabledBy", "");
+
+        info.update_interval = std::max(get_json_value<uint32_t>(json, "updateInterval", 1), 1u);
+
+        info.upsampled_outputs = get_json_array<UpsampledOutput>(json, "upsampleOutputs");
+
+        info.shading_rate = get_json_opt<rhi::ShadingRate>(json, "shadingRate", shading_rate_enum_from_json);
+
+        info.uses_adaptive_shading_rate = get_json_value<bool>(json, "adaptiveShadingRate", false);
+
+        info.uses_order_independent_transparency = get_json_value<bool>(json, "orderIndependentTransparency", false);
+
         return info;
     }
 
+    bool RenderPassCreateInfo::is_compute_pass() const { return compute_shader || queue == rhi::QueueType::AsyncCompute; }
+
+    bool RenderPassCreateInfo::keeps_outputs() const { return is_cached || update_interval > 1; }
+
+    bool RenderPassCreateInfo::is_multisampled() const {
+        return std::any_of(texture_outputs.begin(),
+                           texture_outputs.end(),
+                           [](const TextureAttachmentInfo& output) { return output.num_samples > 1; }) ||
+               (depth_texture && depth_texture->num_samples > 1);
+    }
+
     RendergraphData RendergraphData::from_json(const nlohmann::json& json) {
         RendergraphData data;
 
@@ -102,6 +159,47 @@ namespace nova::renderer::renderpack {
         return info;
     }
 
+    /*!
+     * \brief Reads a vector that's written as an array of numbers. Missing components keep their default
+     */
+    template <glm::length_t Length>
+    static glm::vec<Length, float> get_json_vec(const nlohmann::json& json, const char* key, const glm::vec<Length, float> default_value) {
+        const auto components = get_json_array<float>(json, key);
+
+        auto vec = default_value;
+        for(glm::length_t i = 0; i < std::min(static_cast<glm::length_t>(components.size()), Length); i++) {
+            vec[i] = components[i];
+        }
+
+        return vec;
+    }
+
+    ParticleEmitterCreateInfo ParticleEmitterCreateInfo::from_json(const nlohmann::json& json) {
+        ParticleEmitterCreateInfo info = {};
+
+        FILL_REQUIRED_FIELD(info.name, get_json_opt<std::string>(json, "name"));
+        FILL_REQUIRED_FIELD(info.material, get_json_opt<std::string>(json, "material"));
+        FILL_REQUIRED_FIELD(info.material_pass, get_json_opt<std::string>(json, "materialPass"));
+
+        info.max_particles = std::max(get_json_value<uint32_t>(json, "maxParticles", info.max_particles), 1u);
+        info.spawn_rate = std::max(get_json_value<float>(json, "spawnRate", info.spawn_rate), 0.0f);
+        info.min_lifetime = std::max(get_json_value<float>(json, "minLifetime", info.min_lifetime), 0.0f);
+        info.max_lifetime = std::max(get_json_value<float>(json, "maxLifetime", info.min_lifetime), info.min_lifetime);
+
+        info.spawn_extent = get_json_vec(json, "spawnExtent", info.spawn_extent);
+        info.initial_velocity = get_json_vec(json, "initialVelocity", info.initial_velocity);
+        info.velocity_randomness = get_json_vec(json, "velocityRandomness", info.velocity_randomness);
+        info.acceleration = get_json_vec(json, "acceleration", info.acceleration);
+        info.drag = std::clamp(get_json_value<float>(json, "drag", info.drag), 0.0f, 1.0f);
+
+        info.start_size = get_json_value<float>(json, "startSize", info.start_size);
+        info.end_size = get_json_value<float>(json, "endSize", info.start_size);
+        info.start_color = get_json_vec(json, "startColor", info.start_color);
+        info.end_color = get_json_vec(json, "endColor", info.start_color);
+
+        return info;
+    }
+
     StencilOpState StencilOpState::from_json(const nlohmann::json& json) {
         StencilOpState state = {};
 
@@ -115,6 +213,31 @@ namespace nova::renderer::renderpack {
         return state;
     }
 
+    ShaderKeywordAxis ShaderKeywordAxis::from_json(const nlohmann::json& json) {
+        ShaderKeywordAxis axis = {};
+
+        FILL_REQUIRED_FIELD(axis.name, get_json_opt<std::string>(json, "name"));
+        axis.keywords = get_json_array<std::string>(json, "keywords");
+
+        return axis;
+    }
+
+    static std::optional<std::unordered_map<std::string, double>> specialization_constants_from_json(const nlohmann::json& json) {
+        std::unordered_map<std::string, double> constants;
+
+        json.each([&](const nlohmann::json& elem) {
+            std::string name;
+            FILL_REQUIRED_FIELD(name, get_json_opt<std::string>(elem, "name"));
+
+            double value = 0;
+            FILL_REQUIRED_FIELD(value, get_json_opt<double>(elem, "value"));
+
+            constants.insert_or_assign(std::move(name), value);
+        });
+
+        return constants;
+    }
+
     PipelineData PipelineData::from_json(const nlohmann::json& json) {
         PipelineData pipeline = {};
 
@@ -122,7 +245,12 @@ namespace nova::renderer::renderpack {
         FILL_REQUIRED_FIELD(pipeline.pass, get_json_opt<std::string>(json, "pass"));
         pipeline.parent_name = get_json_value(json, "parent", "");
 
-        pipeline.defines = get_json_array<std::string>(json, "defined");
+        pipeline.defines = get_json_array<std::string>(json, "defines");
+        pipeline.keyword_axes = get_json_array<ShaderKeywordAxis>(json, "keywords");
+        FILL_REQUIRED_FIELD(pipeline.specialization_constants,
+                            get_json_opt<std::unordered_map<std::string, double>>(json,
+                                                                                  "specializationConstants",
+                                                                                  specialization_constants_from_json));
 
         pipeline.states = get_json_array<RasterizerState>(json, "states", state_enum_from_json);
         pipeline.front_face = get_json_opt<StencilOpState>(json, "frontFace");
@@ -138,6 +266,7 @@ namespace nova::renderer::renderpack {
                                                                       "primitiveMode",
                                                                       RPPrimitiveTopology::Triangles,
                                                                       primitive_topology_enum_from_json);
+        pipeline.vertex_layout = get_json_value<RPVertexLayout>(json, "vertexLayout", RPVertexLayout::Full, vertex_layout_enum_from_json);
         pipeline.source_color_blend_factor = get_json_value<RPBlendFactor>(json,
                                                                            "sourceBlendFactor",
                                                                            RPBlendFactor::One,
@@ -227,6 +356,8 @@ namespace nova::renderer::renderpack {
             pass.bindings = *val;
         }
 
+        pass.keywords = get_json_array<std::string>(json, "keywords");
+
         // FILL_REQUIRED_FIELD(pass.bindings, get_json_opt<std::unordered_map<std::string, std::string>>(json, "bindings", map_from_json_object));
 
         return pass;
@@ -252,12 +383,45 @@ namespace nova::renderer::renderpack {
         if(str == "RGBA32F") {
             return rhi::PixelFormat::Rgba32F;
         }
+        if(str == "RG32F") {
+            return rhi::PixelFormat::Rg32F;
+        }
+        if(str == "R8UI") {
+            return rhi::PixelFormat::R8Uint;
+        }
+        if(str == "R11G11B10F") {
+            return rhi::PixelFormat::Rg11B10F;
+        }
+        if(str == "RGB10A2") {
+            return rhi::PixelFormat::Rgb10A2;
+        }
+        if(str == "RG16F") {
+            return rhi::PixelFormat::Rg16F;
+        }
+        if(str == "RG16S") {
+            return rhi::PixelFormat::Rg16Snorm;
+        }
         if(str == "Depth") {
             return rhi::PixelFormat::Depth32;
         }
         if(str == "DepthStencil") {
             return rhi::PixelFormat::Depth24Stencil8;
         }
+        if(str == "BC1") {
+            return rhi::PixelFormat::Bc1;
+        }
+        if(str == "BC3") {
+            return rhi::PixelFormat::Bc3;
+        }
+        if(str == "BC5") {
+            return rhi::PixelFormat::Bc5;
+        }
+        if(str == "BC7") {
+            return rhi::PixelFormat::Bc7;
+        }
+        if(str == "ASTC4x4") {
+            return rhi::PixelFormat::Astc4x4;
+        }
 
         logger->error("Unsupported pixel format %s", str);
         return {};
@@ -275,6 +439,27 @@ namespace nova::renderer::renderpack {
         return {};
     }
 
+    TexturePrecision texture_precision_enum_from_string(const std::string& str) {
+        if(str == "Exact") {
+            return TexturePrecision::Exact;
+        }
+        if(str == "HdrColor") {
+            return TexturePrecision::HdrColor;
+        }
+        if(str == "Normals") {
+            return TexturePrecision::Normals;
+        }
+        if(str == "PackedMaterial") {
+            return TexturePrecision::PackedMaterial;
+        }
+        if(str == "Velocity") {
+            return TexturePrecision::Velocity;
+        }
+
+        logger->error("Unsupported texture precision %s", str);
+        return TexturePrecision::Exact;
+    }
+
     TextureFilter texture_filter_enum_from_string(const std::string& str) {
         if(str == "TexelAA") {
             return TextureFilter::TexelAA;
@@ -389,6 +574,21 @@ namespace nova::renderer::renderpack {
         return {};
     }
 
+    RPVertexLayout vertex_layout_enum_from_string(const std::string& str) {
+        if(str == "Full") {
+            return RPVertexLayout::Full;
+        }
+        if(str == "Compact") {
+            return RPVertexLayout::Compact;
+        }
+        if(str == "Pulled") {
+            return RPVertexLayout::Pulled;
+        }
+
+        logger->error("Unsupported vertex layout %s", str);
+        return {};
+    }
+
     RPBlendFactor blend_factor_enum_from_string(const std::string& str) {
         if(str == "One") {
             return RPBlendFactor::One;
@@ -491,12 +691,41 @@ namespace nova::renderer::renderpack {
         return {};
     }
 
+    rhi::ShadingRate shading_rate_enum_from_string(const std::string& str) {
+        if(str == "1x1") {
+            return rhi::ShadingRate::Rate1x1;
+        }
+        if(str == "1x2") {
+            return rhi::ShadingRate::Rate1x2;
+        }
+        if(str == "2x1") {
+            return rhi::ShadingRate::Rate2x1;
+        }
+        if(str == "2x2") {
+            return rhi::ShadingRate::Rate2x2;
+        }
+        if(str == "2x4") {
+            return rhi::ShadingRate::Rate2x4;
+        }
+        if(str == "4x2") {
+            return rhi::ShadingRate::Rate4x2;
+        }
+        if(str == "4x4") {
+            return rhi::ShadingRate::Rate4x4;
+        }
+
+        logger->error("Unsupported shading rate %s", str);
+        return {};
+    }
+
     rhi::PixelFormat pixel_format_enum_from_json(const nlohmann::json& j) { return pixel_format_enum_from_string(j.as_string()); }
 
     TextureDimensionType texture_dimension_type_enum_from_json(const nlohmann::json& j) {
         return texture_dimension_type_enum_from_string(j.as_string());
     }
 
+    TexturePrecision texture_precision_enum_from_json(const nlohmann::json& j) { return texture_precision_enum_from_string(j.as_string()); }
+
     TextureFilter texture_filter_enum_from_json(const nlohmann::json& j) { return texture_filter_enum_from_string(j.as_string()); }
 
     WrapMode wrap_mode_enum_from_json(const nlohmann::json& j) { return wrap_mode_enum_from_string(j.as_string()); }
@@ -509,6 +738,8 @@ namespace nova::renderer::renderpack {
 
     RPPrimitiveTopology primitive_topology_enum_from_json(const nlohmann::json& j) { return primitive_topology_enum_from_string(j.as_string()); }
 
+    RPVertexLayout vertex_layout_enum_from_json(const nlohmann::json& j) { return vertex_layout_enum_from_string(j.as_string()); }
+
     RPBlendFactor blend_factor_enum_from_json(const nlohmann::json& j) { return blend_factor_enum_from_string(j.as_string()); }
 
     RenderQueue render_queue_enum_from_json(const nlohmann::json& j) { return render_queue_enum_from_string(j.as_string()); }
@@ -517,6 +748,8 @@ namespace nova::renderer::renderpack {
 
     RasterizerState state_enum_from_json(const nlohmann::json& j) { return state_enum_from_string(j.as_string()); }
 
+    rhi::ShadingRate shading_rate_enum_from_json(const nlohmann::json& j) { return shading_rate_enum_from_string(j.as_string()); }
+
     std::string to_string(const rhi::PixelFormat val) {
         switch(val) {
             case rhi::PixelFormat::Rgba8:
@@ -528,11 +761,44 @@ namespace nova::renderer::renderpack {
             case rhi::PixelFormat::Rgba32F:
                 return "RGBA32F";
 
+            case rhi::PixelFormat::Rg32F:
+                return "RG32F";
+
+            case rhi::PixelFormat::R8Uint:
+                return "R8UI";
+
+            case rhi::PixelFormat::Rg11B10F:
+                return "R11G11B10F";
+
+            case rhi::PixelFormat::Rgb10A2:
+                return "RGB10A2";
+
+            case rhi::PixelFormat::Rg16F:
+                return "RG16F";
+
+            case rhi::PixelFormat::Rg16Snorm:
+                return "RG16S";
+
             case rhi::PixelFormat::Depth32:
                 return "Depth";
 
             case rhi::PixelFormat::Depth24Stencil8:
                 return "DepthStencil";
+
+            case rhi::PixelFormat::Bc1:
+                return "BC1";
+
+            case rhi::PixelFormat::Bc3:
+                return "BC3";
+
+            case rhi::PixelFormat::Bc5:
+                return "BC5";
+
+            case rhi::PixelFormat::Bc7:
+                return "BC7";
+
+            case rhi::PixelFormat::Astc4x4:
+                return "ASTC4x4";
         }
 
         return "Unknown value";
@@ -550,6 +816,27 @@ namespace nova::renderer::renderpack {
         return "Unknown value";
     }
 
+    std::string to_string(const TexturePrecision val) {
+        switch(val) {
+            case TexturePrecision::Exact:
+                return "Exact";
+
+            case TexturePrecision::HdrColor:
+                return "HdrColor";
+
+            case TexturePrecision::Normals:
+                return "Normals";
+
+            case TexturePrecision::PackedMaterial:
+                return "PackedMaterial";
+
+            case TexturePrecision::Velocity:
+                return "Velocity";
+        }
+
+        return "Unknown value";
+    }
+
     std::string to_string(const TextureFilter val) {
         switch(val) {
             case TextureFilter::TexelAA:
@@ -664,6 +951,21 @@ namespace nova::renderer::renderpack {
         return "Unknown value";
     }
 
+    std::string to_string(const RPVertexLayout val) {
+        switch(val) {
+            case RPVertexLayout::Full:
+                return "Full";
+
+            case RPVertexLayout::Compact:
+                return "Compact";
+
+            case RPVertexLayout::Pulled:
+                return "Pulled";
+        }
+
+        return "Unknown value";
+    }
+
     std::string to_string(const RPBlendFactor val) {
         switch(val) {
             case RPBlendFactor::One:
@@ -751,6 +1053,33 @@ namespace nova::renderer::renderpack {
         return "Unknown value";
     }
 
+    std::string to_string(const rhi::ShadingRate val) {
+        switch(val) {
+            case rhi::ShadingRate::Rate1x1:
+                return "1x1";
+
+            case rhi::ShadingRate::Rate1x2:
+                return "1x2";
+
+            case rhi::ShadingRate::Rate2x1:
+                return "2x1";
+
+            case rhi::ShadingRate::Rate2x2:
+                return "2x2";
+
+            case rhi::ShadingRate::Rate2x4:
+                return "2x4";
+
+            case rhi::ShadingRate::Rate4x2:
+                return "4x2";
+
+            case rhi::ShadingRate::Rate4x4:
+                return "4x4";
+        }
+
+        return "Unknown value";
+    }
+
     uint32_t pixel_format_to_pixel_width(const rhi::PixelFormat format) {
         switch(format) {
             case rhi::PixelFormat::Rgba8:
@@ -762,14 +1091,79 @@ namespace nova::renderer::renderpack {
             case rhi::PixelFormat::Rgba32F:
                 return 4 * 32;
 
+            case rhi::PixelFormat::Rg32F:
+                return 2 * 32;
+
+            case rhi::PixelFormat::R8Uint:
+                return 8;
+
+            case rhi::PixelFormat::Rg11B10F:
+                [[fallthrough]];
+            case rhi::PixelFormat::Rgb10A2:
+                [[fallthrough]];
+            case rhi::PixelFormat::Rg16F:
+                [[fallthrough]];
+            case rhi::PixelFormat::Rg16Snorm:
+                return 32;
+
             case rhi::PixelFormat::Depth32:
                 return 32;
 
             case rhi::PixelFormat::Depth24Stencil8:
                 return 32;
 
+            case rhi::PixelFormat::Bc1:
+                return 4;
+
+            case rhi::PixelFormat::Bc3:
+                [[fallthrough]];
+            case rhi::PixelFormat::Bc5:
+                [[fallthrough]];
+            case rhi::PixelFormat::Bc7:
+                [[fallthrough]];
+            case rhi::PixelFormat::Astc4x4:
+                return 8;
+
             default:
                 return 32;
         }
     }
+
+    std::vector<std::string> get_variant_keywords(const PipelineData& pipeline, const std::vector<std::string>& requested_keywords) {
+        std::vector<std::string> variant_keywords;
+        variant_keywords.reserve(pipeline.keyword_axes.size());
+
+        for(const ShaderKeywordAxis& axis : pipeline.keyword_axes) {
+            const auto keyword = std::find_if(axis.keywords.begin(), axis.keywords.end(), [&](const std::string& axis_keyword) {
+                return std::find(requested_keywords.begin(), requested_keywords.end(), axis_keyword) != requested_keywords.end();
+            });
+
+            if(keyword != axis.keywords.end()) {
+                variant_keywords.push_back(*keyword);
+
+            } else if(!axis.keywords.empty()) {
+                variant_keywords.push_back(axis.keywords.front());
+
+            } else {
+                variant_keywords.emplace_back("_");
+            }
+        }
+
+        return variant_keywords;
+    }
+
+    std::vector<std::string> get_default_variant_keywords(const PipelineData& pipeline) { return get_variant_keywords(pipeline, {}); }
+
+    std::vector<std::string> get_variant_defines(const PipelineData& pipeline, const std::vector<std::string>& variant_keywords) {
+        std::vector<std::string> defines = pipeline.defines;
+        defines.reserve(defines.size() + variant_keywords.size());
+
+        for(const std::string& keyword : variant_keywords) {
+            if(keyword != "_") {
+                defines.push_back(keyword);
+            }
+        }
+
+        return defines;
+    }
 } // namespace nova::renderer::renderpack
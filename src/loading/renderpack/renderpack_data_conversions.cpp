@@ -1,5 +1,6 @@
 #include "nova_renderer/renderpack_data_conversions.hpp"
 
+#include "nova_renderer/compact_vertex.hpp"
 #include "nova_renderer/rendergraph.hpp"
 #include "nova_renderer/renderpack_data.hpp"
 #include "nova_renderer/rhi/rhi_enums.hpp"
@@ -238,7 +239,13 @@ namespace nova::renderer::renderpack {
             info.pixel_shader = to_shader_source(*data.fragment_shader);
         }
 
-        info.vertex_fields = get_vertex_fields(info.vertex_shader);
+        // Pulled pipelines fetch their own vertices, so they have an empty input layout
+        if(data.vertex_layout == RPVertexLayout::Compact) {
+            info.vertex_fields = get_compact_vertex_fields();
+
+        } else if(data.vertex_layout == RPVertexLayout::Full) {
+            info.vertex_fields = get_vertex_fields(info.vertex_shader);
+        }
 
         // Viewport and scissor test
         const auto* pass = rendergraph.get_renderpass(data.pass);
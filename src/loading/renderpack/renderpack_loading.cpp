@@ -1,5 +1,7 @@
 #include "nova_renderer/loading/renderpack_loading.hpp"
 
+#include <fstream>
+
 #include <rx/core/json.h>
 #include <rx/core/log.h>
 
@@ -10,26 +12,86 @@
 #include "nova_renderer/filesystem/folder_accessor.hpp"
 #include "nova_renderer/filesystem/virtual_filesystem.hpp"
 #include "nova_renderer/loading/shader_includer.hpp"
+#include "nova_renderer/util/task_scheduler.hpp"
 
 #include "../json_utils.hpp"
 #include "Tracy.hpp"
+#include "cooked_renderpack.hpp"
 #include "render_graph_builder.hpp"
 #include "renderpack_validator.hpp"
+#include "shader_include_cache.hpp"
+#include "spirv_cache.hpp"
 
 namespace nova::renderer::renderpack {
     RX_LOG("RenderpackLoading", logger);
 
     using namespace filesystem;
 
-    std::optional<RenderpackResourcesData> load_dynamic_resources_file(FolderAccessorBase* folder_access);
+    /*!
+     * \brief Something loaded from a renderpack file, along with the report from validating that file
+     *
+     * Each file's task validates into its own report. The reports are merged in the order the files were found and printed once every
+     * task is done, so the log doesn't depend on which thread finished first
+     */
+    template <typename DataType>
+    struct ValidatedFile {
+        DataType data;
+        ValidationReport report;
+    };
+
+    ValidatedFile<std::optional<RenderpackResourcesData>> load_dynamic_resources_file(FolderAccessorBase* folder_access);
 
     ntl::Result<RendergraphData> load_rendergraph_file(FolderAccessorBase* folder_access);
 
-    std::vector<PipelineData> load_pipeline_files(FolderAccessorBase* folder_access);
-    std::optional<PipelineData> load_single_pipeline(FolderAccessorBase* folder_access, const std::string& pipeline_path);
+    std::vector<std::future<ValidatedFile<std::optional<PipelineData>>>> load_pipeline_files(FolderAccessorBase* folder_access,
+                                                                                             TaskScheduler& task_scheduler);
+    std::optional<PipelineData> load_single_pipeline(FolderAccessorBase* folder_access,
+                                                     const std::string& pipeline_path,
+                                                     ValidationReport& report);
+
+    std::vector<std::future<ValidatedFile<MaterialData>>> load_material_files(FolderAccessorBase* folder_access,
+                                                                              TaskScheduler& task_scheduler);
+    MaterialData load_single_material(FolderAccessorBase* folder_access, const std::string& material_path, ValidationReport& report);
+
+    /*!
+     * \brief Validates a file's JSON into the report, unless a file with exactly the same contents has passed validation before
+     *
+     * \return True if the file has no errors
+     */
+    template <typename ValidateFunc>
+    static bool validate_file(const std::string_view kind,
+                              const std::string_view contents,
+                              ValidationReport& report,
+                              ValidateFunc&& validate) {
+        auto& validated_files = ValidatedFileCache::get_instance();
+        const auto file_hash = ValidatedFileCache::hash_file(kind, contents);
+        if(validated_files.contains(file_hash)) {
+            return true;
+        }
+
+        auto file_report = validate();
+        const auto passed = file_report.errors.is_empty();
+        report.merge_in(std::move(file_report));
 
-    std::vector<MaterialData> load_material_files(FolderAccessorBase* folder_access);
-    MaterialData load_single_material(FolderAccessorBase* folder_access, const std::string& material_path);
+        if(passed) {
+            validated_files.add(file_hash);
+        }
+
+        return passed;
+    }
+
+    /*!
+     * \brief Multisampled attachments are thrown away at the end of every renderpass, so a pass that doesn't clear one renders on top
+     * of garbage
+     */
+    static void warn_if_loading_multisampled(const RenderPassCreateInfo& pass, const TextureAttachmentInfo& attachment) {
+        if(attachment.num_samples > 1 && !attachment.clear) {
+            logger->warn("Pass %s renders to multisampled texture %s without clearing it. Multisampled textures don't keep their samples "
+                         "between passes, so whatever the pass doesn't draw over is undefined",
+                         pass.name,
+                         attachment.name);
+        }
+    }
 
     void fill_in_render_target_formats(RenderpackData& data) {
         const auto& textures = data.resources.render_targets;
@@ -46,18 +108,20 @@ namespace nova::renderer::renderpack {
                     // TODO: Figure out how to tell the loader about all the builtin resources
                 }
 
-                std::optional<rhi::PixelFormat> pixel_format;
+                const TextureFormat* format = nullptr;
                 textures.each_fwd([&](const TextureCreateInfo& texture_info) {
                     if(texture_info.name == output.name) {
-                        pixel_format = texture_info.format.pixel_format;
+                        format = &texture_info.format;
                         return false;
                     }
 
                     return true;
                 });
 
-                if(pixel_format) {
-                    output.pixel_format = *pixel_format;
+                if(format != nullptr) {
+                    output.pixel_format = format->pixel_format;
+                    output.num_samples = format->num_samples;
+                    warn_if_loading_multisampled(pass, output);
                 } else {
                     logger->error("Render pass %s is trying to use texture %s, but it's not in the render graph's dynamic texture list",
                                   pass.name,
@@ -68,29 +132,178 @@ namespace nova::renderer::renderpack {
             });
 
             if(pass.depth_texture) {
-                std::optional<rhi::PixelFormat> pixel_format;
+                const TextureFormat* format = nullptr;
                 textures.each_fwd([&](const TextureCreateInfo& texture_info) {
                     if(texture_info.name == pass.depth_texture->name) {
-                        pixel_format = texture_info.format.pixel_format;
+                        format = &texture_info.format;
                         return false;
                     }
 
                     return true;
                 });
 
-                if(pixel_format) {
-                    pass.depth_texture->pixel_format = *pixel_format;
+                if(format != nullptr) {
+                    pass.depth_texture->pixel_format = format->pixel_format;
+                    pass.depth_texture->num_samples = format->num_samples;
+                    warn_if_loading_multisampled(pass, *pass.depth_texture);
+                }
+            }
+        });
+    }
+
+    /*!
+     * \brief Gets the format that a precision hint becomes at a precision tier, or nothing if it keeps the renderpack's format
+     */
+    static std::optional<rhi::PixelFormat> get_compact_format(const TexturePrecision precision, const RenderTargetPrecision tier) {
+        if(tier == RenderTargetPrecision::Full) {
+            return std::nullopt;
+        }
+
+        switch(precision) {
+            case TexturePrecision::HdrColor:
+                return rhi::PixelFormat::Rg11B10F;
+
+            case TexturePrecision::Normals:
+                return rhi::PixelFormat::Rgb10A2;
+
+            case TexturePrecision::PackedMaterial:
+                if(tier == RenderTargetPrecision::Compact) {
+                    return rhi::PixelFormat::Rgba8;
                 }
+                return std::nullopt;
+
+            case TexturePrecision::Velocity:
+                return tier == RenderTargetPrecision::Compact ? rhi::PixelFormat::Rg16Snorm : rhi::PixelFormat::Rg16F;
+
+            default:
+                return std::nullopt;
+        }
+    }
+
+    void resolve_render_target_precision(RenderpackData& data,
+                                         const RenderTargetPrecision tier,
+                                         const std::function<bool(rhi::PixelFormat)>& is_format_supported) {
+        bool changed_any_format = false;
+        data.resources.render_targets.each_fwd([&](TextureCreateInfo& texture) {
+            const auto compact_format = get_compact_format(texture.format.precision, tier);
+            if(!compact_format || rhi::is_depth_format(texture.format.pixel_format) ||
+               pixel_format_to_pixel_width(*compact_format) >= pixel_format_to_pixel_width(texture.format.pixel_format)) {
+                return true;
             }
+
+            if(!is_format_supported(*compact_format)) {
+                logger->debug("Render target %s keeps format %s, because this GPU can't render to %s",
+                              texture.name,
+                              to_string(texture.format.pixel_format),
+                              to_string(*compact_format));
+                return true;
+            }
+
+            logger->debug("Render target %s uses format %s instead of %s",
+                          texture.name,
+                          to_string(*compact_format),
+                          to_string(texture.format.pixel_format));
+            texture.format.pixel_format = *compact_format;
+            changed_any_format = true;
+
+            return true;
         });
+
+        // The passes copied the old formats when the renderpack was loaded
+        if(changed_any_format) {
+            fill_in_render_target_formats(data);
+        }
     }
 
     void cache_pipelines_by_renderpass(RenderpackData& data);
 
-    RenderpackData load_renderpack_data(const std::string& renderpack_name) {
+    RenderpackData load_renderpack_sources(const std::string& renderpack_name,
+                                           FolderAccessorBase* folder_access,
+                                           TaskScheduler& task_scheduler);
+
+    bool is_missing_shaders(const RenderpackData& data);
+
+    RenderpackData load_renderpack_data(const std::string& renderpack_name, TaskScheduler& task_scheduler) {
+        ZoneScoped;
+        FolderAccessorBase* folder_access = VirtualFilesystem::get_instance()->get_folder_accessor(renderpack_name);
+
+        // Included files are only cached for one load, so edits to them show up in the next one
+        auto& include_cache = ShaderIncludeCache::get_instance();
+        include_cache.clear();
+
+        auto& cooked_cache = CookedRenderpackCache::get_instance();
+        if(auto cooked_data = cooked_cache.find(renderpack_name, folder_access)) {
+            logger->debug("Loaded cooked renderpack %s", renderpack_name);
+            include_cache.clear();
+            return std::move(*cooked_data);
+        }
+
+        auto data = load_renderpack_sources(renderpack_name, folder_access, task_scheduler);
+
+        // Shaders that didn't compile should fail again next time, with their errors in the log, instead of being cooked into nothing
+        if(!is_missing_shaders(data)) {
+            cooked_cache.store(data, folder_access);
+        }
+
+        include_cache.clear();
+
+        return data;
+    }
+
+    bool cook_renderpack_to_file(const std::string& renderpack_name,
+                                 TaskScheduler& task_scheduler,
+                                 const std::filesystem::path& output_path) {
         ZoneScoped;
         FolderAccessorBase* folder_access = VirtualFilesystem::get_instance()->get_folder_accessor(renderpack_name);
 
+        ShaderIncludeCache::get_instance().clear();
+        const auto data = load_renderpack_sources(renderpack_name, folder_access, task_scheduler);
+        const auto cooked = cook_renderpack(data, folder_access);
+        ShaderIncludeCache::get_instance().clear();
+
+        if(is_missing_shaders(data)) {
+            logger->error("Renderpack %s has shaders that didn't compile, so it can't be cooked", renderpack_name);
+            return false;
+        }
+
+        std::ofstream file{output_path, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char*>(cooked.data()), static_cast<std::streamsize>(cooked.size()));
+        if(!file) {
+            logger->error("Could not write cooked renderpack %s to %s", renderpack_name, output_path.string());
+            return false;
+        }
+
+        return true;
+    }
+
+    static bool is_missing(const std::optional<RenderpackShaderSource>& shader) { return shader && shader->source.empty(); }
+
+    static bool is_missing_shaders(const PipelineData& pipeline) {
+        return pipeline.vertex_shader.source.empty() || is_missing(pipeline.geometry_shader) ||
+               is_missing(pipeline.tessellation_control_shader) || is_missing(pipeline.tessellation_evaluation_shader) ||
+               is_missing(pipeline.fragment_shader);
+    }
+
+    bool is_missing_shaders(const RenderpackData& data) {
+        for(const PipelineData& pipeline : data.pipelines) {
+            if(is_missing_shaders(pipeline)) {
+                return true;
+            }
+        }
+
+        for(const RenderPassCreateInfo& pass : data.graph_data.passes) {
+            if(is_missing(pass.compute_shader)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    RenderpackData load_renderpack_sources(const std::string& renderpack_name,
+                                           FolderAccessorBase* folder_access,
+                                           TaskScheduler& task_scheduler) {
+        ZoneScoped;
         // The renderpack has a number of items: There's the shaders themselves, of course, but there's so, so much more
         // What else is there?
         // - resources.json, to describe the dynamic resources that a renderpack needs
@@ -98,18 +311,56 @@ namespace nova::renderer::renderpack {
         // - All the pipeline descriptions
         // - All the material descriptions
         //
-        // All these things are loaded from the filesystem
+        // All these things are loaded from the filesystem. None of them depend on each other until we fill in the render target formats,
+        // so we kick off a task for every file and wait for them all at the end
+
+        auto resources_future = task_scheduler.add_task(
+            [folder_access](uint32_t /* thread_idx */) { return load_dynamic_resources_file(folder_access); });
+        auto graph_future = task_scheduler.add_task(
+            [folder_access](uint32_t /* thread_idx */) { return load_rendergraph_file(folder_access); });
+        auto pipeline_futures = load_pipeline_files(folder_access, task_scheduler);
+        auto material_futures = load_material_files(folder_access, task_scheduler);
 
         RenderpackData data{};
-        data.resources = *load_dynamic_resources_file(folder_access);
-        const auto& graph_data = load_rendergraph_file(folder_access);
+        data.name = renderpack_name;
+
+        // Nova may load a renderpack from inside a task, which mustn't just block on the tasks it submitted
+        ValidationReport report;
+        task_scheduler.wait_for(resources_future);
+        auto resources = resources_future.get();
+        report.merge_in(std::move(resources.report));
+        if(resources.data) {
+            data.resources = std::move(*resources.data);
+        }
+
+        task_scheduler.wait_for(graph_future);
+        const auto& graph_data = graph_future.get();
         if(graph_data) {
             data.graph_data = *graph_data;
         } else {
             logger->error("Could not load render graph file. Error: %s", graph_data.error.to_string());
         }
-        data.pipelines = load_pipeline_files(folder_access);
-        data.materials = load_material_files(folder_access);
+
+        // Join in the same order the files were found, so the renderpack data doesn't depend on which thread finished first
+        data.pipelines.reserve(pipeline_futures.size());
+        for(auto& pipeline_future : pipeline_futures) {
+            task_scheduler.wait_for(pipeline_future);
+            auto pipeline = pipeline_future.get();
+            report.merge_in(std::move(pipeline.report));
+            if(pipeline.data) {
+                data.pipelines.push_back(std::move(*pipeline.data));
+            }
+        }
+
+        data.materials.reserve(material_futures.size());
+        for(auto& material_future : material_futures) {
+            task_scheduler.wait_for(material_future);
+            auto material = material_future.get();
+            report.merge_in(std::move(material.report));
+            data.materials.push_back(std::move(material.data));
+        }
+
+        print(report);
 
         fill_in_render_target_formats(data);
 
@@ -118,28 +369,34 @@ namespace nova::renderer::renderpack {
         return data;
     }
 
-    std::optional<RenderpackResourcesData> load_dynamic_resources_file(FolderAccessorBase* folder_access) {
+    ValidatedFile<std::optional<RenderpackResourcesData>> load_dynamic_resources_file(FolderAccessorBase* folder_access) {
         ZoneScoped;
-        const std::string resources_string = folder_access->read_text_file(RESOURCES_FILE);
+        const auto resources_file = folder_access->map_file(RESOURCES_FILE);
+        const auto contents = resources_file.as_string();
 
-        auto json_resources = nlohmann::json(resources_string);
-        const ValidationReport report = validate_renderpack_resources_data(json_resources);
-        print(report);
-        if(!report.errors.is_empty()) {
-            return rx::nullopt;
+        ValidatedFile<std::optional<RenderpackResourcesData>> resources;
+        auto json_resources = nlohmann::json::parse(contents);
+        if(validate_file("resources", contents, resources.report, [&] { return validate_renderpack_resources_data(json_resources); })) {
+            resources.data = RenderpackResourcesData::from_json(json_resources);
         }
 
-        return RenderpackResourcesData::from_json(json_resources);
+        return resources;
     }
 
     ntl::Result<RendergraphData> load_rendergraph_file(FolderAccessorBase* folder_access) {
         ZoneScoped;
-        const auto passes_bytes = folder_access->read_text_file("rendergraph.json");
+        const auto passes_file = folder_access->map_file(RENDERGRAPH_FILE);
 
-        const auto json_passes = nlohmann::json(passes_bytes);
+        const auto json_passes = nlohmann::json::parse(passes_file.as_string());
 
         auto rendergraph_file = json_passes.decode<RendergraphData>({});
 
+        for(RenderPassCreateInfo& pass : rendergraph_file.passes) {
+            if(pass.compute_shader) {
+                pass.compute_shader->source = load_shader_file(pass.compute_shader->filename, folder_access, rhi::ShaderStage::Compute, {});
+            }
+        }
+
         bool writes_to_scene_output_rt = false;
         rendergraph_file.passes.each_fwd([&](const RenderPassCreateInfo& pass) {
             // Check if this pass writes to the scene output RT
@@ -169,11 +426,12 @@ namespace nova::renderer::renderpack {
         }
     }
 
-    std::vector<PipelineData> load_pipeline_files(FolderAccessorBase* folder_access) {
+    std::vector<std::future<ValidatedFile<std::optional<PipelineData>>>> load_pipeline_files(FolderAccessorBase* folder_access,
+                                                                                             TaskScheduler& task_scheduler) {
         ZoneScoped;
         std::vector<std::string> potential_pipeline_files = folder_access->get_all_items_in_folder("materials");
 
-        std::vector<PipelineData> output;
+        std::vector<std::future<ValidatedFile<std::optional<PipelineData>>>> output;
 
         // The resize will make this vector about twice as big as it should be, but there won't be any reallocating
         // so I'm into it
@@ -181,69 +439,94 @@ namespace nova::renderer::renderpack {
 
         potential_pipeline_files.each_fwd([&](const std::string& potential_file) {
             if(potential_file.ends_with(".pipeline")) {
-                // Pipeline file!
-                const auto pipeline_relative_path = std::string::format("%s/%s", "materials", potential_file);
-                const auto& pipeline = load_single_pipeline(folder_access, pipeline_relative_path);
-                if(pipeline) {
-                    output.push_back(*pipeline);
-                }
+                // Pipeline file! Compiling its shaders is the slowest part of loading a renderpack, so each pipeline gets its own task
+                auto pipeline_relative_path = std::string::format("%s/%s", "materials", potential_file);
+                output.push_back(task_scheduler.add_task(
+                    [folder_access, pipeline_relative_path = std::move(pipeline_relative_path)](uint32_t /* thread_idx */) {
+                        ValidatedFile<std::optional<PipelineData>> pipeline;
+                        pipeline.data = load_single_pipeline(folder_access, pipeline_relative_path, pipeline.report);
+                        return pipeline;
+                    }));
             }
         });
 
         return output;
     }
 
-    std::optional<PipelineData> load_single_pipeline(FolderAccessorBase* folder_access, const std::string& pipeline_path) {
-        ZoneScoped;
-        const auto pipeline_bytes = folder_access->read_text_file(pipeline_path);
-
-        auto json_pipeline = nlohmann::json{pipeline_bytes};
-        const ValidationReport report = validate_graphics_pipeline(json_pipeline);
-        print(report);
-        if(!report.errors.is_empty()) {
-            logger->error("Loading pipeline file %s failed", pipeline_path);
-            return rx::nullopt;
+    /*!
+     * \brief Compiles all of a pipeline's shaders with the same defines. Shaders that don't compile are left empty
+     */
+    static void load_pipeline_shaders(PipelineData& pipeline, FolderAccessorBase* folder_access, const std::vector<std::string>& defines) {
+        pipeline.vertex_shader.source = load_shader_file(pipeline.vertex_shader.filename, folder_access, rhi::ShaderStage::Vertex, defines);
+
+        if(pipeline.geometry_shader) {
+            pipeline.geometry_shader->source = load_shader_file(pipeline.geometry_shader->filename,
+                                                                folder_access,
+                                                                rhi::ShaderStage::Geometry,
+                                                                defines);
         }
 
-        auto new_pipeline = json_pipeline.decode<PipelineData>({});
-        new_pipeline.vertex_shader.source = load_shader_file(new_pipeline.vertex_shader.filename,
-                                                             folder_access,
-                                                             rhi::ShaderStage::Vertex,
-                                                             new_pipeline.defines);
-
-        if(new_pipeline.geometry_shader) {
-            (*new_pipeline.geometry_shader).source = load_shader_file((*new_pipeline.geometry_shader).filename,
-                                                                      folder_access,
-                                                                      rhi::ShaderStage::Geometry,
-                                                                      new_pipeline.defines);
+        if(pipeline.tessellation_control_shader) {
+            pipeline.tessellation_control_shader->source = load_shader_file(pipeline.tessellation_control_shader->filename,
+                                                                            folder_access,
+                                                                            rhi::ShaderStage::TessellationControl,
+                                                                            defines);
         }
 
-        if(new_pipeline.tessellation_control_shader) {
-            (*new_pipeline.tessellation_control_shader).source = load_shader_file((*new_pipeline.tessellation_control_shader).filename,
-                                                                                  folder_access,
-                                                                                  rhi::ShaderStage::TessellationControl,
-                                                                                  new_pipeline.defines);
+        if(pipeline.tessellation_evaluation_shader) {
+            pipeline.tessellation_evaluation_shader->source = load_shader_file(pipeline.tessellation_evaluation_shader->filename,
+                                                                               folder_access,
+                                                                               rhi::ShaderStage::TessellationEvaluation,
+                                                                               defines);
         }
-        if(new_pipeline.tessellation_evaluation_shader) {
-            (*new_pipeline.tessellation_evaluation_shader)
-                .source = load_shader_file((*new_pipeline.tessellation_evaluation_shader).filename,
-                                           folder_access,
-                                           rhi::ShaderStage::TessellationEvaluation,
-                                           new_pipeline.defines);
+
+        if(pipeline.fragment_shader) {
+            pipeline.fragment_shader->source = load_shader_file(pipeline.fragment_shader->filename,
+                                                                folder_access,
+                                                                rhi::ShaderStage::Pixel,
+                                                                defines);
         }
+    }
+
+    std::optional<PipelineData> load_single_pipeline(FolderAccessorBase* folder_access,
+                                                     const std::string& pipeline_path,
+                                                     ValidationReport& report) {
+        ZoneScoped;
+        const auto pipeline_file = folder_access->map_file(pipeline_path);
+        const auto contents = pipeline_file.as_string();
 
-        if(new_pipeline.fragment_shader) {
-            (*new_pipeline.fragment_shader).source = load_shader_file((*new_pipeline.fragment_shader).filename,
-                                                                      folder_access,
-                                                                      rhi::ShaderStage::Pixel,
-                                                                      new_pipeline.defines);
+        auto json_pipeline = nlohmann::json::parse(contents);
+        if(!validate_file("pipeline", contents, report, [&] { return validate_graphics_pipeline(json_pipeline); })) {
+            report.errors.emplace_back(std::string::format("Loading pipeline file %s failed", pipeline_path));
+            return rx::nullopt;
         }
 
+        auto new_pipeline = json_pipeline.decode<PipelineData>({});
+        new_pipeline.source_file = pipeline_path;
+
+        // Other variants are compiled when something asks for them
+        load_pipeline_shaders(new_pipeline, folder_access, get_variant_defines(new_pipeline, get_default_variant_keywords(new_pipeline)));
+
         logger->debug("Load of pipeline %s succeeded", pipeline_path);
 
         return new_pipeline;
     }
 
+    std::optional<PipelineData> load_pipeline_variant(const PipelineData& pipeline,
+                                                      const std::vector<std::string>& variant_keywords,
+                                                      FolderAccessorBase* folder_access) {
+        ZoneScoped;
+        auto variant = pipeline;
+        load_pipeline_shaders(variant, folder_access, get_variant_defines(pipeline, variant_keywords));
+
+        if(is_missing_shaders(variant)) {
+            logger->error("Could not compile the shaders for a variant of pipeline %s", pipeline.name);
+            return rx::nullopt;
+        }
+
+        return variant;
+    }
+
     std::vector<uint32_t> load_shader_file(const std::string& filename,
                                           FolderAccessorBase* folder_access,
                                           const rhi::ShaderStage stage,
@@ -252,19 +535,25 @@ namespace nova::renderer::renderpack {
         if(filename.ends_with(".spirv")) {
             // SPIR-V file!
 
-            std::vector<uint8_t> bytes = folder_access->read_file(filename);
-            const auto view = bytes.disown();
-            return std::vector<uint32_t>{view};
+            const auto file = folder_access->map_file(filename);
+            const auto bytes = file.get_bytes();
+
+            std::vector<uint32_t> spirv(bytes.size() / sizeof(uint32_t));
+            memcpy(spirv.data(), bytes.data(), spirv.size() * sizeof(uint32_t));
+
+            return spirv;
         }
 
-        std::string shader_source = folder_access->read_text_file(filename);
+        // DXC reads the source straight from the file's view, so the source is never copied
+        const auto shader_file = folder_access->map_file(filename);
+        const auto shader_source = shader_file.as_string();
 
         const auto& compiled_shader = [&] {
             if(filename.ends_with(".hlsl")) {
-                return compile_shader(shader_source, stage, rhi::ShaderLanguage::Hlsl, folder_access);
+                return compile_shader(shader_source, stage, rhi::ShaderLanguage::Hlsl, folder_access, defines);
 
             } else {
-                return compile_shader(shader_source, stage, rhi::ShaderLanguage::Glsl, folder_access);
+                return compile_shader(shader_source, stage, rhi::ShaderLanguage::Glsl, folder_access, defines);
             }
         }();
 
@@ -275,36 +564,40 @@ namespace nova::renderer::renderpack {
         return compiled_shader;
     }
 
-    std::vector<MaterialData> load_material_files(FolderAccessorBase* folder_access) {
+    std::vector<std::future<ValidatedFile<MaterialData>>> load_material_files(FolderAccessorBase* folder_access,
+                                                                              TaskScheduler& task_scheduler) {
         ZoneScoped;
         std::vector<std::string> potential_material_files = folder_access->get_all_items_in_folder("materials");
 
         // The resize will make this vector about twice as big as it should be, but there won't be any reallocating
         // so I'm into it
-        std::vector<MaterialData> output;
+        std::vector<std::future<ValidatedFile<MaterialData>>> output;
         output.reserve(potential_material_files.size());
 
         potential_material_files.each_fwd([&](const std::string& potential_file) {
             if(potential_file.ends_with(".mat")) {
-                const auto material_filename = std::string::format("%s/%s", MATERIALS_DIRECTORY, potential_file);
-                const MaterialData& material = load_single_material(folder_access, material_filename);
-                output.push_back(material);
+                auto material_filename = std::string::format("%s/%s", MATERIALS_DIRECTORY, potential_file);
+                output.push_back(task_scheduler.add_task(
+                    [folder_access, material_filename = std::move(material_filename)](uint32_t /* thread_idx */) {
+                        ValidatedFile<MaterialData> material;
+                        material.data = load_single_material(folder_access, material_filename, material.report);
+                        return material;
+                    }));
             }
         });
 
         return output;
     }
 
-    MaterialData load_single_material(FolderAccessorBase* folder_access, const std::string& material_path) {
+    MaterialData load_single_material(FolderAccessorBase* folder_access, const std::string& material_path, ValidationReport& report) {
         ZoneScoped;
-        const std::string material_text = folder_access->read_text_file(material_path);
+        const auto material_file = folder_access->map_file(material_path);
+        const auto contents = material_file.as_string();
 
-        const auto json_material = nlohmann::json{material_text};
-        const auto report = validate_material(json_material);
-        print(report);
-        if(!report.errors.is_empty()) {
+        const auto json_material = nlohmann::json::parse(contents);
+        if(!validate_file("material", contents, report, [&] { return validate_material(json_material); })) {
             // There were errors, this material can't be loaded
-            logger->error("Load of material %s failed", material_path);
+            report.errors.emplace_back(std::string::format("Load of material %s failed", material_path));
             return {};
         }
 
@@ -372,10 +665,11 @@ namespace nova::renderer::renderpack {
         }
     }
 
-    std::vector<uint32_t> compile_shader(const std::string& source,
+    std::vector<uint32_t> compile_shader(const std::string_view source,
                                         const rhi::ShaderStage stage,
                                         const rhi::ShaderLanguage source_language,
-                                        FolderAccessorBase* folder_accessor) {
+                                        FolderAccessorBase* folder_accessor,
+                                        const std::vector<std::string>& defines) {
         /*
          * Compile HLSL -> SPIR-V, using delicious DXC
          *
@@ -383,6 +677,13 @@ namespace nova::renderer::renderpack {
          * has a result, then it won't give me that result. I asked on the DirectX server and many other places, but apparently not even
          * Microsoft knows how to the new API for their compiler. Thus, I'm using the old and deprecated API - because it actually works
          */
+        ZoneScoped;
+
+        auto& spirv_cache = SpirvCache::get_instance();
+        const auto cache_key = SpirvCache::make_key(source, stage, source_language, folder_accessor, defines);
+        if(auto cached_spirv = spirv_cache.find(cache_key)) {
+            return *cached_spirv;
+        }
 
         IDxcLibrary* lib;
         auto hr = DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&lib));
@@ -407,8 +708,31 @@ namespace nova::renderer::renderpack {
 
         const auto profile = to_hlsl_profile(stage);
 
+        // If you change these, bump the SPIR-V cache's version so it doesn't return shaders that were compiled with the old arguments,
+        // and change them in EmbedBuiltinShaders.cmake too
         std::vector<LPCWSTR> args = std::array{L"-spirv", L"-fspv-target-env=vulkan1.1", L"-fspv-reflect"};
 
+        // Defines are preprocessor identifiers, so they're ASCII and can be widened one character at a time. `NAME=VALUE` defines NAME to
+        // VALUE, and a plain `NAME` defines it to 1
+        std::vector<std::wstring> define_strings;
+        define_strings.reserve(defines.size() * 2);
+        std::vector<DxcDefine> dxc_defines;
+        dxc_defines.reserve(defines.size());
+        for(const std::string& define : defines) {
+            const auto equals_pos = define.find('=');
+            const auto name = std::string_view{define}.substr(0, equals_pos);
+
+            const auto& wide_name = define_strings.emplace_back(name.begin(), name.end());
+            if(equals_pos == std::string::npos) {
+                dxc_defines.push_back(DxcDefine{wide_name.c_str(), nullptr});
+
+            } else {
+                const auto& wide_value = define_strings.emplace_back(define.begin() + static_cast<std::ptrdiff_t>(equals_pos) + 1,
+                                                                     define.end());
+                dxc_defines.push_back(DxcDefine{wide_name.c_str(), wide_value.c_str()});
+            }
+        }
+
         auto* includer = new NovaDxcIncludeHandler{*(&rx::memory::g_system_allocator), *lib, folder_accessor};
 
         IDxcOperationResult* compile_result;
@@ -418,8 +742,8 @@ namespace nova::renderer::renderpack {
                                profile,
                                args.data(),
                                static_cast<UINT32>(args.size()),
-                               nullptr,
-                               0,
+                               dxc_defines.data(),
+                               static_cast<UINT32>(dxc_defines.size()),
                                includer,
                                &compile_result);
         if(FAILED(hr)) {
@@ -433,6 +757,9 @@ namespace nova::renderer::renderpack {
             hr = compile_result->GetResult(&result_blob);
             std::vector<uint32_t> spirv{result_blob->GetBufferSize() / sizeof(uint32_t)};
             memcpy(spirv.data(), result_blob->GetBufferPointer(), result_blob->GetBufferSize());
+
+            spirv_cache.store(cache_key, spirv);
+
             return spirv;
 
         } else {
@@ -1,13 +1,14 @@
 #include "renderpack_validator.hpp"
 
 #include <array>
+#include <iterator>
 
-#include <array>
 #include <rx/core/log.h>
 
 #include "nova_renderer/util/utils.hpp"
 
 #include "../json_utils.hpp"
+#include "spirv_cache.hpp"
 
 namespace nova::renderer::renderpack {
     RX_LOG("RenderpackValidator", logger);
@@ -63,13 +64,21 @@ namespace nova::renderer::renderpack {
         // Don't need to check for the name's existence here, it'll be checked with the rest of the required fields
 
         const std::string pipeline_context = std::string::format("Pipeline %s", name);
-        // Check non-required fields first
+        // Check non-required fields first. Most pipelines leave most of them out, so they all go in one warning instead of one each
+        std::string missing_optional_fields;
         for(uint32_t i = 0; i < NUM_REQUIRED_FIELDS; i++) {
             if(!pipeline_json[required_fields[i]]) {
-                report.warnings.emplace_back(std::string::format("%s: Missing optional field %s", pipeline_context, required_fields[i]));
+                if(!missing_optional_fields.is_empty()) {
+                    missing_optional_fields += ", ";
+                }
+                missing_optional_fields += required_fields[i];
             }
         }
 
+        if(!missing_optional_fields.is_empty()) {
+            report.warnings.emplace_back(std::string::format("%s: Missing optional fields %s", pipeline_context, missing_optional_fields));
+        }
+
         // Check required items
         report.errors.reserve(required_graphics_pipeline_fields.size());
         for(uint32_t i = 0; i < required_graphics_pipeline_fields.size(); i++) {
@@ -79,6 +88,37 @@ namespace nova::renderer::renderpack {
             }
         }
 
+        if(const auto keywords_json = pipeline_json["keywords"]; keywords_json) {
+            if(!keywords_json.is_array()) {
+                report.errors.emplace_back(std::string::format("%s: Field keywords must be an array of keyword axes", pipeline_context));
+            } else {
+                keywords_json.each([&](const nlohmann::json& axis_json) {
+                    if(!axis_json["name"]) {
+                        report.errors.emplace_back(std::string::format("%s: Keyword axis is missing field name", pipeline_context));
+                    }
+
+                    const auto axis_keywords = axis_json["keywords"];
+                    if(!axis_keywords || !axis_keywords.is_array() || axis_keywords.is_empty()) {
+                        report.errors.emplace_back(
+                            std::string::format("%s: Keyword axis must have an array of at least one keyword", pipeline_context));
+                    }
+                });
+            }
+        }
+
+        if(const auto constants_json = pipeline_json["specializationConstants"]; constants_json) {
+            if(!constants_json.is_array()) {
+                report.errors.emplace_back(std::string::format("%s: Field specializationConstants must be an array", pipeline_context));
+            } else {
+                constants_json.each([&](const nlohmann::json& constant_json) {
+                    if(!constant_json["name"] || !constant_json["value"]) {
+                        report.errors.emplace_back(
+                            std::string::format("%s: Specialization constants must have a name and a value", pipeline_context));
+                    }
+                });
+            }
+        }
+
         return report;
     }
 
@@ -96,8 +136,7 @@ namespace nova::renderer::renderpack {
                 missing_textures = true;
             } else {
                 textures_itr.each([&](const nlohmann::json& tex) {
-                    const ValidationReport texture_report = validate_texture_data(tex);
-                    report.merge_in(texture_report);
+                    report.merge_in(validate_texture_data(tex));
                 });
             }
         }
@@ -113,8 +152,7 @@ namespace nova::renderer::renderpack {
                 report.errors.emplace_back(resources_msg("Samplers array must be an array, but like it isn't"));
             } else {
                 samplers_itr.each([&](const nlohmann::json& sampler) {
-                    const ValidationReport sampler_report = validate_sampler_data(sampler);
-                    report.merge_in(sampler_report);
+                    report.merge_in(validate_sampler_data(sampler));
                 });
             }
         }
@@ -140,8 +178,7 @@ namespace nova::renderer::renderpack {
         if(!format) {
             report.errors.emplace_back(texture_msg(name, "Missing field format"));
         } else {
-            const ValidationReport format_report = validate_texture_format(format, name);
-            report.merge_in(format_report);
+            report.merge_in(validate_texture_format(format, name));
         }
 
         return report;
@@ -171,6 +208,20 @@ namespace nova::renderer::renderpack {
             report.errors.emplace_back(format_msg(texture_name, "Missing field height"));
         }
 
+        const auto num_samples = get_json_value<uint32_t>(format_json, "samples", 1);
+        if(num_samples == 0 || num_samples > 64 || (num_samples & (num_samples - 1)) != 0) {
+            report.errors.emplace_back(format_msg(texture_name, "Field samples must be a power of two, no larger than 64"));
+        }
+
+        const auto precision = get_json_value<std::string>(format_json, "precision", "Exact");
+        if(precision != "Exact" && precision != "HdrColor" && precision != "Normals" && precision != "PackedMaterial" &&
+           precision != "Velocity") {
+            report.errors.emplace_back(format_msg(texture_name,
+                                                  std::string::format("Field precision must be Exact, HdrColor, Normals, PackedMaterial, "
+                                                                      "or Velocity, but it's %s",
+                                                                      precision)));
+        }
+
         return report;
     }
 
@@ -280,4 +331,35 @@ namespace nova::renderer::renderpack {
         errors += other.errors;
         warnings += other.warnings;
     }
+
+    void ValidationReport::merge_in(ValidationReport&& other) {
+        errors.insert(errors.end(), std::make_move_iterator(other.errors.begin()), std::make_move_iterator(other.errors.end()));
+        warnings.insert(warnings.end(), std::make_move_iterator(other.warnings.begin()), std::make_move_iterator(other.warnings.end()));
+    }
+
+    ValidatedFileCache& ValidatedFileCache::get_instance() {
+        static ValidatedFileCache instance;
+
+        return instance;
+    }
+
+    uint64_t ValidatedFileCache::hash_file(const std::string_view kind, const std::string_view contents) {
+        Fnv1aHasher hasher;
+        hasher.add(kind);
+        hasher.add(contents);
+
+        return hasher.get();
+    }
+
+    bool ValidatedFileCache::contains(const uint64_t file_hash) {
+        std::lock_guard lock{cache_mutex};
+
+        return validated_files.contains(file_hash);
+    }
+
+    void ValidatedFileCache::add(const uint64_t file_hash) {
+        std::lock_guard lock{cache_mutex};
+
+        validated_files.emplace(file_hash);
+    }
 } // namespace nova::renderer::renderpack
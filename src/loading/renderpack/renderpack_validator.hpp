@@ -1,7 +1,11 @@
 #pragma once
 
 #include <rx/core/json.h>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 namespace nova::renderer::renderpack {
@@ -10,6 +14,40 @@ namespace nova::renderer::renderpack {
         std::vector<std::string> errors;
 
         void merge_in(const ValidationReport& other);
+
+        /*!
+         * \brief Moves the other report's messages into this one, instead of copying all their strings
+         */
+        void merge_in(ValidationReport&& other);
+    };
+
+    /*!
+     * \brief Remembers which renderpack files passed validation, by a hash of their contents
+     *
+     * Validation only looks at a file's JSON, so a file with exactly the same contents as one that passed before passes again. Loading
+     * a file that's in here skips validating it, which mostly helps reloads - every pipeline and material that wasn't edited is skipped.
+     * Files with errors are never added, so their errors show up on every load until they're fixed
+     *
+     * All methods are thread-safe
+     */
+    class ValidatedFileCache {
+    public:
+        static ValidatedFileCache& get_instance();
+
+        /*!
+         * \brief Hashes a file's contents, along with what kind of file it is so that a pipeline and a material with the same text
+         * don't share a hash
+         */
+        [[nodiscard]] static uint64_t hash_file(std::string_view kind, std::string_view contents);
+
+        [[nodiscard]] bool contains(uint64_t file_hash);
+
+        void add(uint64_t file_hash);
+
+    private:
+        std::mutex cache_mutex;
+
+        std::unordered_set<uint64_t> validated_files;
     };
 
     void print(const ValidationReport& report);
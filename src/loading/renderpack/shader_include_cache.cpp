@@ -0,0 +1,91 @@
+#include "shader_include_cache.hpp"
+
+#include <Tracy.hpp>
+
+#include "nova_renderer/loading/shader_includer.hpp"
+
+#include "spirv_cache.hpp"
+
+namespace nova::renderer::renderpack {
+    std::vector<std::string> find_includes(const std::string_view source) {
+        std::vector<std::string> includes;
+
+        size_t line_begin = 0;
+        while(line_begin < source.size()) {
+            auto line_end = source.find('\n', line_begin);
+            if(line_end == std::string_view::npos) {
+                line_end = source.size();
+            }
+
+            auto line = source.substr(line_begin, line_end - line_begin);
+            line_begin = line_end + 1;
+
+            const auto directive_begin = line.find_first_not_of(" \t");
+            if(directive_begin == std::string_view::npos || line[directive_begin] != '#') {
+                continue;
+            }
+
+            line = line.substr(directive_begin + 1);
+            const auto keyword_begin = line.find_first_not_of(" \t");
+            if(keyword_begin == std::string_view::npos || line.substr(keyword_begin, 7) != "include") {
+                continue;
+            }
+
+            line = line.substr(keyword_begin + 7);
+            const auto name_begin = line.find_first_of("\"<");
+            if(name_begin == std::string_view::npos) {
+                continue;
+            }
+
+            const auto closing_char = line[name_begin] == '"' ? '"' : '>';
+            const auto name_end = line.find(closing_char, name_begin + 1);
+            if(name_end == std::string_view::npos) {
+                continue;
+            }
+
+            includes.emplace_back(line.substr(name_begin + 1, name_end - name_begin - 1));
+        }
+
+        return includes;
+    }
+
+    ShaderIncludeCache& ShaderIncludeCache::get_instance() {
+        static ShaderIncludeCache instance;
+
+        return instance;
+    }
+
+    const ShaderIncludeFile* ShaderIncludeCache::find(const std::string& filename, filesystem::FolderAccessorBase* folder_accessor) {
+        {
+            std::lock_guard lock{cache_mutex};
+            const auto& folder_files = files[folder_accessor];
+            if(const auto file_itr = folder_files.find(filename); file_itr != folder_files.end()) {
+                return file_itr->second.get();
+            }
+        }
+
+        // Read the file without the lock, so threads that include different files don't wait on each other's disk reads
+        ZoneScoped;
+        std::unique_ptr<ShaderIncludeFile> file;
+        if(const auto view = NovaDxcIncludeHandler::read_include(filename, folder_accessor)) {
+            file = std::make_unique<ShaderIncludeFile>();
+            file->contents = view->as_string();
+
+            Fnv1aHasher hasher;
+            hasher.add(file->contents);
+            file->content_hash = hasher.get();
+
+            file->includes = find_includes(file->contents);
+        }
+
+        // If another thread read the same file in the meantime, keep its copy. Someone may already be using it
+        std::lock_guard lock{cache_mutex};
+        return files[folder_accessor].try_emplace(filename, std::move(file)).first->second.get();
+    }
+
+    void ShaderIncludeCache::clear() {
+        std::lock_guard lock{cache_mutex};
+
+        files.clear();
+    }
+} // namespace nova::renderer::renderpack
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace nova::filesystem {
+    class FolderAccessorBase;
+}
+
+namespace nova::renderer::renderpack {
+    /*!
+     * \brief A file that shaders include, read once along with everything we need to know about it
+     */
+    struct ShaderIncludeFile {
+        std::string contents;
+
+        /*!
+         * \brief FNV-1a hash of `contents`. The SPIR-V cache uses this instead of hashing the whole file for every shader that includes it
+         */
+        uint64_t content_hash = 0;
+
+        /*!
+         * \brief The file names of the file's own `#include` directives
+         */
+        std::vector<std::string> includes;
+    };
+
+    /*!
+     * \brief Finds the file names of all the `#include` directives in the source
+     */
+    [[nodiscard]] std::vector<std::string> find_includes(std::string_view source);
+
+    /*!
+     * \brief Every file that shaders have included since the cache was last cleared
+     *
+     * Large renderpacks include the same few headers from hundreds of shaders, so each one is only read, hashed, and scanned for includes
+     * the first time it's asked for. Files that don't exist are remembered too
+     *
+     * Entries stay where they are until `clear`, so DXC can read included files straight out of the cache. `load_renderpack_data` clears
+     * it before and after each renderpack load, so edited headers are picked up by the next one. Nothing may be compiling while it does
+     *
+     * All methods are thread-safe
+     */
+    class ShaderIncludeCache {
+    public:
+        static ShaderIncludeCache& get_instance();
+
+        /*!
+         * \brief Gets a file that a shader includes, reading it if nobody has asked for it yet. See `NovaDxcIncludeHandler::read_include`
+         *
+         * \return The file, or nullptr if it doesn't exist. Valid until the next `clear`
+         */
+        [[nodiscard]] const ShaderIncludeFile* find(const std::string& filename, filesystem::FolderAccessorBase* folder_accessor);
+
+        void clear();
+
+    private:
+        std::mutex cache_mutex;
+
+        /*!
+         * \brief Files by the renderpack they're in, then by name. Builtin files are looked up before the renderpack, so they're in every
+         * renderpack's map. Null entries are files that don't exist
+         */
+        std::unordered_map<filesystem::FolderAccessorBase*, std::unordered_map<std::string, std::unique_ptr<const ShaderIncludeFile>>>
+            files;
+    };
+} // namespace nova::renderer::renderpack
@@ -1,19 +1,26 @@
 #include "nova_renderer/loading/shader_includer.hpp"
 
+#include <unordered_map>
+
 #include <rx/core/log.h>
 
 #include "nova_renderer/filesystem/folder_accessor.hpp"
 
+#include "shader_include_cache.hpp"
+
 namespace nova::renderer {
     RX_LOG("NovaDxcIncludeHandler", logger);
 
     constexpr const char* STANDARD_PIPELINE_LAYOUT_FILE_NAME = "./nova/standard_pipeline_layout.hlsl";
-
-    NovaDxcIncludeHandler::NovaDxcIncludeHandler(rx::memory::allocator& allocator,
-                                                 IDxcLibrary& library,
-                                                 filesystem::FolderAccessorBase* folder_accessor)
-        : allocator{allocator}, library{library}, folder_accessor{folder_accessor}, builtin_files{&allocator} {
-        const auto standard_pipeline_layout_hlsl = R"(
+    constexpr const char* VIRTUAL_TEXTURING_FILE_NAME = "./nova/virtual_texturing.hlsl";
+    constexpr const char* CLUSTERED_LIGHTING_FILE_NAME = "./nova/clustered_lighting.hlsl";
+    constexpr const char* PARTICLES_FILE_NAME = "./nova/particles.hlsl";
+    constexpr const char* VOLUMETRIC_FOG_FILE_NAME = "./nova/volumetric_fog.hlsl";
+    constexpr const char* OIT_FILE_NAME = "./nova/oit.hlsl";
+    constexpr const char* PACKED_TEXTURES_FILE_NAME = "./nova/packed_textures.hlsl";
+    constexpr const char* VERTEX_PULLING_FILE_NAME = "./nova/vertex_pulling.hlsl";
+
+    constexpr const char* STANDARD_PIPELINE_LAYOUT_HLSL = R"(
 struct Camera {
     float4x4 view;
     float4x4 projection;
@@ -21,6 +28,32 @@ struct Camera {
     float4x4 previous_projection;
 };
 
+struct Light {
+    float4 position_and_radius;
+    float4 color_and_intensity;
+};
+
+struct LightClusterParams {
+    float4x4 view;
+    float4x4 inverse_projection;
+    uint4 grid_size;
+    float near_plane;
+    float far_plane;
+    float slices_per_log_depth;
+    uint max_light_indices;
+};
+
+struct Particle {
+    float3 position;
+    float age;
+    float3 velocity;
+    float lifetime;
+    float4 color;
+    float size;
+    uint emitter;
+    uint2 padding;
+};
+
 /*!
  * \brief All the push constants that are available to a shader that uses the standard pipeline layout
  */
@@ -35,6 +68,16 @@ struct StandardPushConstants {
      * \brief Index of the material data for the current draw
      */
     uint material_index;
+
+    /*!
+     * \brief Add this to SV_InstanceID to get the index of the current instance's data
+     */
+    uint instance_base;
+
+    /*!
+     * \brief Index of a transform shared by the whole draw
+     */
+    uint transform_index;
 } constants;
 
 /*!
@@ -68,13 +111,519 @@ SamplerState bilinear_filter : register(s1);
 SamplerState trilinear_filter : register(s3);
 
 /*!
- * \brief Array of all the textures that are available for a shader to sample from
+ * \brief Model matrices of everything that's drawn this frame
+ *
+ * Nova draws every mesh instanced, and sets each draw's base instance to the draw's first model matrix, so index this array with
+ * SV_InstanceID to get the current object's model matrix
  */
 [[vk::binding(5, 0)]]
-Texture2D textures[] : register(t3);
-        )";
+StructuredBuffer<float4x4> model_matrices : register(t2);
+
+/*!
+ * \brief Where the pages of every virtual texture are in the page cache. Use `sample_virtual_texture` from
+ * `./nova/virtual_texturing.hlsl` instead of reading it yourself
+ *
+ * Elements 0 to 2 are the page size in pixels, the page cache's width in pages, and how many requests fit in the feedback buffer. Every
+ * virtual texture ID has four elements at four times the ID: width, height, number of mips, and the index of its first page entry. Page
+ * entries hold the page's slot in the cache
+ */
+[[vk::binding(6, 0)]]
+StructuredBuffer<uint> virtual_page_table : register(t3);
+
+/*!
+ * \brief The page entries that shaders wanted this frame. Element 0 is how many there are, and the entries come after it
+ */
+[[vk::binding(7, 0)]]
+RWStructuredBuffer<uint> virtual_texture_feedback : register(u0);
+
+/*!
+ * \brief The resident pages of all virtual textures
+ */
+[[vk::binding(8, 0)]]
+Texture2D virtual_texture_cache : register(t4);
+
+/*!
+ * \brief How the main camera's frustum is cut into light clusters. Use the functions in `./nova/clustered_lighting.hlsl` instead of
+ * reading this yourself
+ */
+[[vk::binding(9, 0)]]
+StructuredBuffer<LightClusterParams> light_cluster_params : register(t5);
+
+/*!
+ * \brief Every light in the scene. The number of lights is in `light_cluster_params[0].grid_size.w`
+ */
+[[vk::binding(10, 0)]]
+StructuredBuffer<Light> lights : register(t6);
+
+/*!
+ * \brief Where each cluster's lights start in `light_indices`, and how many there are
+ */
+[[vk::binding(11, 0)]]
+StructuredBuffer<uint2> light_clusters : register(t7);
+
+/*!
+ * \brief The indices of the lights in each cluster, packed one cluster after another
+ */
+[[vk::binding(12, 0)]]
+StructuredBuffer<uint> light_indices : register(t8);
+
+/*!
+ * \brief The live particles of every particle emitter. Use `get_particle_vertex` from `./nova/particles.hlsl` instead of reading this
+ * yourself
+ */
+[[vk::binding(13, 0)]]
+StructuredBuffer<Particle> particles : register(t9);
+
+/*!
+ * \brief How much fog the main camera sees up to each froxel. Use the functions in `./nova/volumetric_fog.hlsl` instead of sampling this
+ * yourself
+ */
+[[vk::binding(14, 0)]]
+Texture3D<float4> volumetric_fog : register(t10);
+
+/*!
+ * \brief Where the vertices of each instance drawn this frame are, in the same order as `model_matrices`. Use `fetch_vertex` from
+ * `./nova/vertex_pulling.hlsl` instead of reading it yourself
+ */
+[[vk::binding(15, 0)]]
+StructuredBuffer<uint> instance_vertex_layouts : register(t11);
+
+/*!
+ * \brief Every vertex buffer that meshes live in, for pipelines that pull their own vertices. Only the buffers that Nova has made so far
+ * are bound
+ */
+[[vk::binding(16, 0)]]
+ByteAddressBuffer vertex_buffers[16] : register(t12);
+
+/*!
+ * \brief Array of all the textures that are available for a shader to sample from
+ */
+[[vk::binding(17, 0)]]
+Texture2D textures[] : register(t28);
+
+/*!
+ * \brief The camera that renders the current view
+ *
+ * Passes with several views render all of them at once, and each view has its own camera. Pass SV_ViewID in those passes, and 0 in
+ * passes that only have one view
+ */
+Camera get_view_camera(uint view_id) {
+    return cameras[constants.camera_index + view_id];
+}
+)";
+
+    /*!
+     * \brief Include this after the standard pipeline layout
+     */
+    constexpr const char* VIRTUAL_TEXTURING_HLSL = R"(
+/*!
+ * \brief What the page table says about pages that aren't in the page cache
+ */
+static const uint VIRTUAL_PAGE_NOT_RESIDENT = 0xFFFFFFFF;
+
+/*!
+ * \brief One in this many pixels tells Nova which page it wanted. Neighboring pixels almost always want the same page, so asking for
+ * every pixel would only fill the feedback buffer with duplicates
+ */
+static const uint VIRTUAL_TEXTURE_FEEDBACK_RATE = 16;
+
+/*!
+ * \brief Reads a virtual texture
+ *
+ * The mip is picked from the UV derivatives, so this only works in pixel shaders. If the mip's page isn't resident, the closest coarser
+ * mip that is gets used instead, and Nova loads the page for later frames. Texels are read without filtering
+ *
+ * \param virtual_texture_id The ID that `NovaRenderer::add_virtual_texture` returned
+ * \param uv Where to read the texture. The texture repeats outside of 0 to 1
+ * \param pixel_position The pixel's SV_Position
+ */
+float4 sample_virtual_texture(uint virtual_texture_id, float2 uv, float4 pixel_position) {
+    const uint page_size = virtual_page_table[0];
+    const uint cache_size_in_pages = virtual_page_table[1];
+    const uint max_feedback_requests = virtual_page_table[2];
+
+    const uint description = virtual_texture_id * 4;
+    const uint2 texture_size = uint2(virtual_page_table[description], virtual_page_table[description + 1]);
+    const uint num_mips = virtual_page_table[description + 2];
+    uint mip_first_entry = virtual_page_table[description + 3];
+    if(num_mips == 0) {
+        return float4(1, 1, 1, 1);
+    }
+
+    const float2 texel_dx = ddx(uv) * texture_size;
+    const float2 texel_dy = ddy(uv) * texture_size;
+    const float footprint = max(dot(texel_dx, texel_dx), dot(texel_dy, texel_dy));
+    const uint wanted_mip = min(uint(max(0.5 * log2(max(footprint, 1.0)), 0.0)), num_mips - 1);
+
+    const uint2 pixel = uint2(pixel_position.xy);
+    const bool report_page = (pixel.x + pixel.y * 7) % VIRTUAL_TEXTURE_FEEDBACK_RATE == 0;
+
+    const uint2 texel = uint2(frac(uv) * texture_size);
+    for(uint mip = 0; mip < num_mips; mip++) {
+        const uint2 mip_size = max(texture_size >> mip, uint2(1, 1));
+        const uint2 mip_pages = (mip_size + page_size - 1) / page_size;
+
+        if(mip >= wanted_mip) {
+            const uint2 mip_texel = min(texel >> mip, mip_size - 1);
+            const uint2 page = mip_texel / page_size;
+            const uint entry = mip_first_entry + page.y * mip_pages.x + page.x;
+            const uint slot = virtual_page_table[entry];
+
+            // Resident pages are reported too, so Nova knows not to evict them
+            if(mip == wanted_mip && report_page) {
+                uint request_idx;
+                InterlockedAdd(virtual_texture_feedback[0], 1, request_idx);
+                if(request_idx < max_feedback_requests) {
+                    virtual_texture_feedback[request_idx + 1] = entry;
+                }
+            }
+
+            if(slot != VIRTUAL_PAGE_NOT_RESIDENT) {
+                const uint2 slot_origin = uint2(slot % cache_size_in_pages, slot / cache_size_in_pages) * page_size;
+                return virtual_texture_cache.Load(int3(slot_origin + mip_texel % page_size, 0));
+            }
+        }
+
+        mip_first_entry += mip_pages.x * mip_pages.y;
+    }
+
+    // Only before the smallest mip has loaded
+    return float4(1, 1, 1, 1);
+}
+)";
+
+    /*!
+     * \brief Include this after the standard pipeline layout
+     */
+    constexpr const char* CLUSTERED_LIGHTING_HLSL = R"(
+/*!
+ * \brief The lights that might touch a pixel
+ */
+struct LightCluster {
+    /*!
+     * \brief Index of the cluster's first light in `light_indices`
+     */
+    uint first_light;
+
+    uint num_lights;
+};
+
+/*!
+ * \brief Finds the cluster that a point is in
+ *
+ * Only the main camera has light clusters, so views from other cameras get clusters that don't match what they see
+ *
+ * \param screen_uv Where the point is on the main camera's screen, from 0 to 1, with 0 at the top
+ * \param world_position Where the point is in worldspace
+ */
+LightCluster get_light_cluster(float2 screen_uv, float3 world_position) {
+    const LightClusterParams params = light_cluster_params[0];
+
+    LightCluster cluster;
+    cluster.first_light = 0;
+    cluster.num_lights = 0;
+    if(params.grid_size.w == 0) {
+        return cluster;
+    }
+
+    const float depth = -mul(params.view, float4(world_position, 1)).z;
+    const float slice = log(max(depth, params.near_plane) / params.near_plane) * params.slices_per_log_depth;
+
+    // Vulkan's NDC has -1 at the top of the screen, so tiles line up with the UV without flipping it
+    const uint3 grid_size = params.grid_size.xyz;
+    const uint3 cluster_position = min(uint3(uint2(screen_uv * grid_size.xy), uint(slice)), grid_size - 1);
+    const uint2 cluster_data = light_clusters[cluster_position.x + cluster_position.y * grid_size.x +
+                                              cluster_position.z * grid_size.x * grid_size.y];
+
+    cluster.first_light = cluster_data.x;
+    cluster.num_lights = cluster_data.y;
+    return cluster;
+}
+
+/*!
+ * \brief Gets one of a cluster's lights. `i` must be less than the cluster's `num_lights`
+ */
+Light get_cluster_light(LightCluster cluster, uint i) {
+    return lights[light_indices[cluster.first_light + i]];
+}
+)";
+
+    /*!
+     * \brief Include this after the standard pipeline layout
+     */
+    constexpr const char* PARTICLES_HLSL = R"(
+/*!
+ * \brief A corner of a particle's quad
+ */
+struct ParticleVertex {
+    /*!
+     * \brief Where the corner is on the view's screen. Write this to SV_Position
+     */
+    float4 position;
+
+    float3 world_position;
+
+    /*!
+     * \brief The particle's color at its current age
+     */
+    float4 color;
 
-        builtin_files.insert(STANDARD_PIPELINE_LAYOUT_FILE_NAME, standard_pipeline_layout_hlsl);
+    /*!
+     * \brief Where the corner is on the quad, from 0 to 1
+     */
+    float2 uv;
+
+    /*!
+     * \brief How far into its life the particle is, from 0 to 1
+     */
+    float age;
+};
+
+/*!
+ * \brief Places a corner of a particle's quad so that the quad faces the view's camera
+ *
+ * Nova draws each emitter's particles as one instanced draw of a quad, with the SV_InstanceID of each instance being its particle's
+ * index in `particles`. The quad's vertices have their corner in `main_uv`
+ *
+ * \param instance_id SV_InstanceID
+ * \param corner_uv The vertex's `main_uv`
+ * \param view_id SV_ViewID in passes with several views, and 0 everywhere else
+ */
+ParticleVertex get_particle_vertex(uint instance_id, float2 corner_uv, uint view_id) {
+    const Particle particle = particles[instance_id];
+    const Camera camera = get_view_camera(view_id);
+
+    // The rows of the view matrix are the camera's axes in worldspace
+    const float3 camera_right = camera.view[0].xyz;
+    const float3 camera_up = camera.view[1].xyz;
+    const float2 offset = (corner_uv - 0.5) * float2(1, -1) * particle.size;
+
+    ParticleVertex vertex;
+    vertex.world_position = particle.position + camera_right * offset.x + camera_up * offset.y;
+    vertex.position = mul(camera.projection, mul(camera.view, float4(vertex.world_position, 1)));
+    vertex.color = particle.color;
+    vertex.uv = corner_uv;
+    vertex.age = particle.lifetime > 0 ? saturate(particle.age / particle.lifetime) : 1;
+    return vertex;
+}
+)";
+
+    /*!
+     * \brief Include this after the standard pipeline layout
+     */
+    constexpr const char* VOLUMETRIC_FOG_HLSL = R"(
+/*!
+ * \brief How much fog there is between the main camera and a point
+ *
+ * The fog grid has the same tiles and depth slices as the light clusters, just cut into more froxels, so it has the same limits: views
+ * from other cameras get fog that doesn't match what they see
+ *
+ * \param screen_uv Where the point is on the main camera's screen, from 0 to 1, with 0 at the top
+ * \param world_position Where the point is in worldspace
+ *
+ * \return The light that the fog scatters toward the camera in rgb, and how much of the point's own light makes it through in a
+ */
+float4 sample_volumetric_fog(float2 screen_uv, float3 world_position) {
+    const LightClusterParams params = light_cluster_params[0];
+    if(params.near_plane <= 0) {
+        return float4(0, 0, 0, 1);
+    }
+
+    uint3 froxel_grid_size;
+    volumetric_fog.GetDimensions(froxel_grid_size.x, froxel_grid_size.y, froxel_grid_size.z);
+
+    const float depth = -mul(params.view, float4(world_position, 1)).z;
+    const float slice = log(max(depth, params.near_plane) / params.near_plane) * params.slices_per_log_depth;
+
+    // Each froxel holds the fog up to its far side, which is half a froxel past its center
+    const float froxel_slice = slice * float(froxel_grid_size.z) / float(params.grid_size.z);
+    const float3 uvw = float3(screen_uv, (froxel_slice - 0.5) / float(froxel_grid_size.z));
+
+    return volumetric_fog.SampleLevel(bilinear_filter, saturate(uvw), 0);
+}
+
+/*!
+ * \brief Fogs a color that was lit at a point
+ */
+float3 apply_volumetric_fog(float3 color, float2 screen_uv, float3 world_position) {
+    const float4 fog = sample_volumetric_fog(screen_uv, world_position);
+    return color * fog.a + fog.rgb;
+}
+)";
+
+    constexpr const char* OIT_HLSL = R"(
+/*!
+ * \brief What a pixel shader in a pass with order-independent transparency writes
+ */
+struct OitOutput {
+    float4 accumulation : SV_Target0;
+    float4 coverage : SV_Target1;
+};
+
+/*!
+ * \brief Weighs a transparent surface's color by how opaque and how close it is, so that it counts for more in the blended result
+ *
+ * \param color The surface's color, with its opacity in a. Not premultiplied
+ * \param depth The surface's depth, from 0 at the near plane to 1 at the far plane. SV_Position.z works
+ */
+OitOutput write_oit(float4 color, float depth) {
+    const float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - depth * 0.9, 3.0), 1e-2, 3e3);
+
+    OitOutput output;
+    output.accumulation = float4(color.rgb * color.a, color.a) * weight;
+    output.coverage = color.aaaa;
+    return output;
+}
+)";
+
+    /*!
+     * \brief Include this after the standard pipeline layout
+     */
+    constexpr const char* PACKED_TEXTURES_HLSL = R"(
+/*!
+ * \brief Reads a texture that `DeviceResources::create_packed_texture` may have put in an atlas page
+ *
+ * The UVs are wrapped into the texture's region before they're scaled into the page, so the texture repeats outside of 0 to 1 like a
+ * texture of its own. Atlas pages only have one mip, so this reads mip 0 and works in any shader stage
+ *
+ * \param texture_sampler The sampler to read with. `point_sampler` and `bilinear_filter` both stay inside the texture's border
+ * \param texture_idx The `texture_idx` of the texture's `PackedTextureRegion`
+ * \param uv_scale_offset The `uv_scale_offset` of the texture's `PackedTextureRegion`
+ * \param uv Where to read the texture, in the texture's own UVs
+ */
+float4 sample_packed_texture(SamplerState texture_sampler, uint texture_idx, float4 uv_scale_offset, float2 uv) {
+    const float2 page_uv = frac(uv) * uv_scale_offset.xy + uv_scale_offset.zw;
+    return textures[NonUniformResourceIndex(texture_idx)].SampleLevel(texture_sampler, page_uv, 0);
+}
+)";
+
+    /*!
+     * \brief Include this after the standard pipeline layout
+     */
+    constexpr const char* VERTEX_PULLING_HLSL = R"(
+/*!
+ * \brief The vertex layout of draws that don't have vertices in Nova's vertex buffers, such as procedural and skinned meshes
+ */
+static const uint NO_PULLED_VERTICES = 0xFFFFFFFF;
+
+/*!
+ * \brief Size of CompactVertex. Meshes with vertices of this size are read as compact vertices, and all others are read as FullVertex
+ */
+static const uint COMPACT_VERTEX_SIZE = 28;
+
+/*!
+ * \brief A vertex that `fetch_vertex` read, with every field unpacked into floats
+ */
+struct PulledVertex {
+    /*!
+     * \brief Position in model space. Compact vertices are in their mesh's vertex space instead, from 0 to 1 on each axis, so the shader
+     * still has to scale them by the mesh's extent and add its origin
+     */
+    float3 position;
+    float3 normal;
+    float3 tangent;
+    float2 main_uv;
+    float2 secondary_uv;
+    uint virtual_texture_id;
+};
+
+float2 unpack_unorm16x2(uint packed) {
+    return float2(packed & 0xFFFF, packed >> 16) / 65535.0;
+}
+
+float2 unpack_snorm16x2(uint packed) {
+    const int2 components = int2(packed << 16, packed) >> 16;
+    return max(float2(components) / 32767.0, -1.0);
+}
+
+float3 decode_octahedral(float2 encoded) {
+    float3 vector = float3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    const float fold = max(-vector.z, 0.0);
+    vector.x += vector.x >= 0 ? -fold : fold;
+    vector.y += vector.y >= 0 ? -fold : fold;
+    return normalize(vector);
+}
+
+/*!
+ * \brief Reads one of the current draw's vertices, whatever layout its mesh has
+ *
+ * Only works in pipelines with `"vertexLayout": "Pulled"`, since other pipelines may draw meshes from vertex buffers that Nova doesn't
+ * know about. Draws whose vertices can't be pulled get a zeroed vertex
+ *
+ * \param vertex_id SV_VertexID. Nova's draws start at their mesh's first vertex, so this is already where the vertex is in its buffer
+ * \param instance_id SV_InstanceID, the same index you read `model_matrices` with
+ */
+PulledVertex fetch_vertex(uint vertex_id, uint instance_id) {
+    PulledVertex vertex = (PulledVertex)0;
+
+    const uint layout = instance_vertex_layouts[instance_id];
+    if(layout == NO_PULLED_VERTICES) {
+        return vertex;
+    }
+
+    // Different draws of one multi-draw can use different buffers
+    const uint buffer_idx = NonUniformResourceIndex(layout & 0xFF);
+    const uint vertex_size = layout >> 8;
+    const uint address = vertex_id * vertex_size;
+
+    if(vertex_size == COMPACT_VERTEX_SIZE) {
+        const uint2 position = vertex_buffers[buffer_idx].Load2(address);
+        const uint4 fields = vertex_buffers[buffer_idx].Load4(address + 8);
+        vertex.position = float3(unpack_unorm16x2(position.x), (position.y & 0xFFFF) / 65535.0);
+        vertex.normal = decode_octahedral(unpack_snorm16x2(fields.x));
+        vertex.tangent = decode_octahedral(unpack_snorm16x2(fields.y));
+        vertex.main_uv = unpack_unorm16x2(fields.z);
+        vertex.secondary_uv = unpack_unorm16x2(fields.w);
+        vertex.virtual_texture_id = vertex_buffers[buffer_idx].Load(address + 24);
+
+    } else {
+        vertex.position = asfloat(vertex_buffers[buffer_idx].Load3(address));
+        vertex.normal = asfloat(vertex_buffers[buffer_idx].Load3(address + 12));
+        vertex.tangent = asfloat(vertex_buffers[buffer_idx].Load3(address + 24));
+
+        const uint3 fields = vertex_buffers[buffer_idx].Load3(address + 36);
+        vertex.main_uv = unpack_unorm16x2(fields.x);
+        vertex.secondary_uv = unpack_unorm16x2(fields.y);
+        vertex.virtual_texture_id = fields.z;
+    }
+
+    return vertex;
+}
+)";
+
+    static const std::unordered_map<std::string, std::string>& get_builtin_files() {
+        static const std::unordered_map<std::string, std::string> builtin_files{
+            {STANDARD_PIPELINE_LAYOUT_FILE_NAME, STANDARD_PIPELINE_LAYOUT_HLSL},
+            {VIRTUAL_TEXTURING_FILE_NAME, VIRTUAL_TEXTURING_HLSL},
+            {CLUSTERED_LIGHTING_FILE_NAME, CLUSTERED_LIGHTING_HLSL},
+            {PARTICLES_FILE_NAME, PARTICLES_HLSL},
+            {VOLUMETRIC_FOG_FILE_NAME, VOLUMETRIC_FOG_HLSL},
+            {OIT_FILE_NAME, OIT_HLSL},
+            {PACKED_TEXTURES_FILE_NAME, PACKED_TEXTURES_HLSL},
+            {VERTEX_PULLING_FILE_NAME, VERTEX_PULLING_HLSL},
+        };
+
+        return builtin_files;
+    }
+
+    NovaDxcIncludeHandler::NovaDxcIncludeHandler(rx::memory::allocator& allocator,
+                                                 IDxcLibrary& library,
+                                                 filesystem::FolderAccessorBase* folder_accessor)
+        : allocator{allocator}, library{library}, folder_accessor{folder_accessor} {}
+
+    std::optional<filesystem::FileView> NovaDxcIncludeHandler::read_include(const std::string& filename,
+                                                                            filesystem::FolderAccessorBase* folder_accessor) {
+        const auto& builtin_files = get_builtin_files();
+        if(const auto file_itr = builtin_files.find(filename); file_itr != builtin_files.end()) {
+            // The builtin files live forever, so nothing needs to own them
+            const auto& contents = file_itr->second;
+            return filesystem::FileView{nullptr, {reinterpret_cast<const uint8_t*>(contents.data()), contents.size()}};
+
+        } else if(folder_accessor != nullptr && folder_accessor->does_resource_exist(filename)) {
+            return folder_accessor->map_file(filename);
+        }
+
+        return std::nullopt;
     }
 
     HRESULT NovaDxcIncludeHandler::QueryInterface(const REFIID class_id, void** output_object) {
@@ -115,29 +664,59 @@ Texture2D textures[] : register(t3);
     }
 #endif
 
-    HRESULT NovaDxcIncludeHandler::LoadSource(const LPCWSTR wide_filename, IDxcBlob** included_source) {
-        const rx::wide_string wide_filename_str{&allocator, reinterpret_cast<const rx_u16*>(wide_filename)};
-        const auto filename = wide_filename_str.to_utf8();
-
-        logger->debug("Trying to include file (%s)", filename);
-
-        if(const auto* file = builtin_files.find(filename)) {
-            IDxcBlobEncoding* encoding;
-            library.CreateBlobWithEncodingFromPinned(file->data(), static_cast<uint32_t>(file->size()), CP_UTF8, &encoding);
-            *included_source = encoding;
-
-            logger->debug("Included %s from builtin snippets", filename);
+    /*!
+     * \brief Converts a wide string from DXC to UTF-8, reusing the output's memory
+     *
+     * wchar_t is UTF-16 on Windows and UTF-32 everywhere else
+     */
+    static void wide_to_utf8(const LPCWSTR wide, std::string& utf8) {
+        utf8.clear();
+
+        for(const auto* c = wide; *c != 0; c++) {
+            auto code_point = static_cast<uint32_t>(*c);
+            if constexpr(sizeof(wchar_t) == 2) {
+                if(code_point >= 0xD800 && code_point < 0xDC00 && c[1] >= 0xDC00 && c[1] < 0xE000) {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (static_cast<uint32_t>(c[1]) - 0xDC00);
+                    c++;
+                }
+            }
+
+            if(code_point < 0x80) {
+                utf8.push_back(static_cast<char>(code_point));
+
+            } else if(code_point < 0x800) {
+                utf8.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+                utf8.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+
+            } else if(code_point < 0x10000) {
+                utf8.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+                utf8.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                utf8.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+
+            } else {
+                utf8.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+                utf8.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+                utf8.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                utf8.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+        }
+    }
 
-            return 0;
+    HRESULT NovaDxcIncludeHandler::LoadSource(const LPCWSTR wide_filename, IDxcBlob** included_source) {
+        wide_to_utf8(wide_filename, filename_scratch);
 
-        } else if(folder_accessor != nullptr && folder_accessor->does_resource_exist(filename)) {
-            const auto included_shader = folder_accessor->read_text_file(filename);
+        logger->debug("Trying to include file (%s)", filename_scratch);
 
+        if(const auto* file = renderpack::ShaderIncludeCache::get_instance().find(filename_scratch, folder_accessor)) {
+            // The include cache keeps the file until the renderpack is done loading, which is long after DXC is done with it
             IDxcBlobEncoding* encoding;
-            library.CreateBlobWithEncodingFromPinned(filename.data(), static_cast<uint32_t>(filename.size()), CP_UTF8, &encoding);
+            library.CreateBlobWithEncodingFromPinned(file->contents.data(),
+                                                     static_cast<uint32_t>(file->contents.size()),
+                                                     CP_UTF8,
+                                                     &encoding);
             *included_source = encoding;
 
-            logger->debug("Included %s from renderpack", filename);
+            logger->debug("Included %s", filename_scratch);
 
             return 0;
         }
@@ -0,0 +1,215 @@
+#include "spirv_cache.hpp"
+
+#include <fstream>
+#include <string_view>
+#include <unordered_set>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/loading/shader_includer.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "shader_include_cache.hpp"
+
+namespace nova::renderer::renderpack {
+    static auto logger = make_logger("SpirvCache");
+
+    /*!
+     * \brief Version of the cache itself. Bump this whenever `compile_shader` starts passing different arguments to DXC, since those change
+     * the output without changing the inputs we hash
+     */
+    constexpr uint32_t CACHE_VERSION = 2;
+
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+    static void hash_includes(Fnv1aHasher& hasher,
+                              const std::vector<std::string>& includes,
+                              filesystem::FolderAccessorBase* folder_accessor,
+                              std::unordered_set<std::string>& visited_files) {
+        auto& include_cache = ShaderIncludeCache::get_instance();
+
+        for(const auto& include_name : includes) {
+            if(!visited_files.emplace(include_name).second) {
+                continue;
+            }
+
+            hasher.add(include_name);
+
+            // DXC prefixes relative include paths with ./ before asking the include handler for them
+            const auto* file = include_cache.find(include_name, folder_accessor);
+            if(file == nullptr) {
+                file = include_cache.find(fmt::format("./{}", include_name), folder_accessor);
+            }
+
+            if(file != nullptr) {
+                hasher.add_value(file->content_hash);
+                hash_includes(hasher, file->includes, folder_accessor, visited_files);
+
+            } else {
+                // DXC will fail to compile this shader and we won't cache it, but hash the missing file anyway so the key is stable
+                hasher.add_value(false);
+            }
+        }
+    }
+
+    /*!
+     * \brief Asks DXC what version it is. This only creates the compiler instance, which is much cheaper than compiling anything
+     */
+    static std::string get_compiler_version() {
+        IDxcCompiler* compiler;
+        auto hr = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
+        if(FAILED(hr)) {
+            logger->warn("Could not create DXC instance to get its version");
+            return "unknown";
+        }
+
+        std::string version = "unknown";
+
+        IDxcVersionInfo* version_info;
+        hr = compiler->QueryInterface(IID_PPV_ARGS(&version_info));
+        if(SUCCEEDED(hr)) {
+            uint32_t major = 0;
+            uint32_t minor = 0;
+            version_info->GetVersion(&major, &minor);
+            version = fmt::format("{}.{}", major, minor);
+
+            version_info->Release();
+        }
+
+        compiler->Release();
+
+        return version;
+    }
+
+    SpirvCache& SpirvCache::get_instance() {
+        static SpirvCache instance;
+
+        return instance;
+    }
+
+    void SpirvCache::configure(std::filesystem::path directory, const uint32_t max_in_memory_shaders) {
+        std::lock_guard lock{cache_mutex};
+
+        cache_directory = std::move(directory);
+        this->max_in_memory_shaders = max_in_memory_shaders;
+
+        while(lru_shaders.size() > max_in_memory_shaders) {
+            shaders_by_key.erase(lru_shaders.back().first);
+            lru_shaders.pop_back();
+        }
+    }
+
+    SpirvCache::Key SpirvCache::make_key(const std::string_view source,
+                                         const rhi::ShaderStage stage,
+                                         const rhi::ShaderLanguage source_language,
+                                         filesystem::FolderAccessorBase* folder_accessor,
+                                         const std::vector<std::string>& defines) {
+        ZoneScoped;
+        static const std::string compiler_version = get_compiler_version();
+
+        Fnv1aHasher hasher;
+        hasher.add_value(CACHE_VERSION);
+        hasher.add(compiler_version);
+        hasher.add_value(stage);
+        hasher.add_value(source_language);
+        hasher.add(source);
+
+        hasher.add_value(defines.size());
+        for(const std::string& define : defines) {
+            hasher.add(define);
+        }
+
+        std::unordered_set<std::string> visited_files;
+        hash_includes(hasher, find_includes(source), folder_accessor, visited_files);
+
+        return hasher.get();
+    }
+
+    std::optional<std::vector<uint32_t>> SpirvCache::find(const Key key) {
+        ZoneScoped;
+        std::lock_guard lock{cache_mutex};
+
+        if(const auto shader_itr = shaders_by_key.find(key); shader_itr != shaders_by_key.end()) {
+            lru_shaders.splice(lru_shaders.begin(), lru_shaders, shader_itr->second);
+            return shader_itr->second->second;
+        }
+
+        const auto path = get_path_for_key(key);
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if(!file) {
+            return std::nullopt;
+        }
+
+        const auto file_size = static_cast<size_t>(file.tellg());
+        if(file_size == 0 || file_size % sizeof(uint32_t) != 0) {
+            logger->warn("Cached shader {} is corrupt, ignoring it", path.string());
+            return std::nullopt;
+        }
+
+        std::vector<uint32_t> spirv(file_size / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(spirv.data()), static_cast<std::streamsize>(file_size));
+
+        if(!file || spirv[0] != SPIRV_MAGIC) {
+            logger->warn("Cached shader {} is corrupt, ignoring it", path.string());
+            return std::nullopt;
+        }
+
+        add_to_memory(key, spirv);
+
+        return spirv;
+    }
+
+    void SpirvCache::store(const Key key, const std::vector<uint32_t>& spirv) {
+        ZoneScoped;
+        std::lock_guard lock{cache_mutex};
+
+        add_to_memory(key, spirv);
+
+        std::error_code err;
+        std::filesystem::create_directories(cache_directory, err);
+
+        // Write to a temporary file first, so another process loading the same renderpack never sees half a shader
+        const auto path = get_path_for_key(key);
+        auto temp_path = path;
+        temp_path += ".tmp";
+
+        {
+            std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+            if(!file) {
+                logger->warn("Could not open {} to cache a shader", temp_path.string());
+                return;
+            }
+
+            file.write(reinterpret_cast<const char*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+        }
+
+        std::filesystem::rename(temp_path, path, err);
+        if(err) {
+            logger->warn("Could not cache shader to {}: {}", path.string(), err.message());
+        }
+    }
+
+    std::filesystem::path SpirvCache::get_path_for_key(const Key key) const { return cache_directory / fmt::format("{:016x}.spv", key); }
+
+    void SpirvCache::add_to_memory(const Key key, std::vector<uint32_t> spirv) {
+        if(max_in_memory_shaders == 0) {
+            return;
+        }
+
+        if(const auto shader_itr = shaders_by_key.find(key); shader_itr != shaders_by_key.end()) {
+            shader_itr->second->second = std::move(spirv);
+            lru_shaders.splice(lru_shaders.begin(), lru_shaders, shader_itr->second);
+            return;
+        }
+
+        lru_shaders.emplace_front(key, std::move(spirv));
+        shaders_by_key.emplace(key, lru_shaders.begin());
+
+        while(lru_shaders.size() > max_in_memory_shaders) {
+            shaders_by_key.erase(lru_shaders.back().first);
+            lru_shaders.pop_back();
+        }
+    }
+} // namespace nova::renderer::renderpack
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "nova_renderer/rhi/rhi_enums.hpp"
+
+namespace nova::filesystem {
+    class FolderAccessorBase;
+}
+
+namespace nova::renderer::renderpack {
+    /*!
+     * \brief 64-bit FNV-1a. It's not cryptographic, but it's stable across runs and platforms, which std::hash isn't
+     */
+    class Fnv1aHasher {
+    public:
+        void add(const std::string_view data) {
+            add_bytes(data);
+
+            // Hash the length too, so that moving bytes between two adjacent strings changes the hash
+            add_value(data.size());
+        }
+
+        template <typename ValueType>
+        void add_value(const ValueType value) {
+            add_bytes(std::string_view{reinterpret_cast<const char*>(&value), sizeof(ValueType)});
+        }
+
+        [[nodiscard]] uint64_t get() const { return hash; }
+
+    private:
+        uint64_t hash = 0xcbf29ce484222325;
+
+        void add_bytes(const std::string_view data) {
+            for(const char c : data) {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 0x100000001b3;
+            }
+        }
+    };
+
+    /*!
+     * \brief Content-addressed cache of compiled SPIR-V
+     *
+     * Shaders are keyed by a hash of everything that can change the compiled output: the source, the contents of every file it includes
+     * (transitively), the preprocessor defines, the stage, the source language, and the compiler version and arguments. A key that's in
+     * the cache always maps to the right SPIR-V, so there's nothing to invalidate - an edited shader just gets a new key
+     *
+     * Compiled shaders are stored on disk, one file per key, and the most recently used ones are also kept in memory so reloading a
+     * renderpack doesn't even have to hit the disk
+     *
+     * All methods are thread-safe
+     */
+    class SpirvCache {
+    public:
+        using Key = uint64_t;
+
+        static SpirvCache& get_instance();
+
+        /*!
+         * \brief Sets where the cache lives on disk and how many shaders it keeps in memory
+         *
+         * Shaders that are already in memory stay there, even if the directory changes
+         */
+        void configure(std::filesystem::path directory, uint32_t max_in_memory_shaders);
+
+        /*!
+         * \brief Calculates the cache key for a shader
+         *
+         * \param source The source code of the shader
+         * \param stage The stage the shader will be compiled for
+         * \param source_language The language that the source is written in
+         * \param folder_accessor The renderpack to resolve `#include`s in. May be nullptr if the shader only includes Nova's builtin files
+         * \param defines The preprocessor defines that the shader is compiled with
+         */
+        [[nodiscard]] static Key make_key(std::string_view source,
+                                          rhi::ShaderStage stage,
+                                          rhi::ShaderLanguage source_language,
+                                          filesystem::FolderAccessorBase* folder_accessor,
+                                          const std::vector<std::string>& defines = {});
+
+        /*!
+         * \brief Looks for a compiled shader in memory, then on disk
+         *
+         * \return The SPIR-V for the key, or nullopt if the shader has never been compiled
+         */
+        [[nodiscard]] std::optional<std::vector<uint32_t>> find(Key key);
+
+        /*!
+         * \brief Adds a freshly compiled shader to the cache
+         */
+        void store(Key key, const std::vector<uint32_t>& spirv);
+
+    private:
+        std::mutex cache_mutex;
+
+        std::filesystem::path cache_directory = "cache/shaders";
+
+        uint32_t max_in_memory_shaders = 256;
+
+        /*!
+         * \brief In-memory shaders, with the most recently used at the front
+         */
+        std::list<std::pair<Key, std::vector<uint32_t>>> lru_shaders;
+
+        std::unordered_map<Key, std::list<std::pair<Key, std::vector<uint32_t>>>::iterator> shaders_by_key;
+
+        [[nodiscard]] std::filesystem::path get_path_for_key(Key key) const;
+
+        /*!
+         * \brief Adds a shader to the front of the in-memory LRU, evicting the least recently used shaders if we're over the limit
+         *
+         * The cache mutex must be held when calling this method
+         */
+        void add_to_memory(Key key, std::vector<uint32_t> spirv);
+    };
+} // namespace nova::renderer::renderpack
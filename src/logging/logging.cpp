@@ -0,0 +1,172 @@
+#include "nova_renderer/util/logging.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+namespace nova {
+    /*!
+     * \brief Number of messages that can wait for the logging thread before the oldest ones get dropped
+     */
+    constexpr size_t LOG_QUEUE_SIZE = 8192;
+
+    /*!
+     * \brief How many times the same message gets written in one rate limiting window before its repeats are dropped
+     */
+    constexpr uint32_t MAX_REPEATS_PER_WINDOW = 5;
+
+    constexpr std::chrono::milliseconds RATE_LIMIT_WINDOW{1000};
+
+    /*!
+     * \brief Sink that drops a message once it's been seen too many times in a short time, then says how many it dropped
+     *
+     * Only the logging thread writes to this sink, so the mutex is never contended
+     */
+    class RateLimitedSink final : public spdlog::sinks::base_sink<std::mutex> {
+    public:
+        explicit RateLimitedSink(std::shared_ptr<spdlog::sinks::sink> sink_in) : sink{std::move(sink_in)} {}
+
+    protected:
+        void sink_it_(const spdlog::details::log_msg& msg) override {
+            if(msg.time - last_sweep_time > RATE_LIMIT_WINDOW) {
+                sweep_expired_messages(msg.time);
+            }
+
+            auto& repeats = repeated_messages[get_message_key(msg)];
+            if(repeats.count_in_window == 0) {
+                repeats.window_start = msg.time;
+            }
+
+            if(repeats.count_in_window < MAX_REPEATS_PER_WINDOW) {
+                repeats.count_in_window++;
+                sink->log(msg);
+
+            } else {
+                if(repeats.num_suppressed == 0) {
+                    // Keep a copy so we can say what we dropped. The message's payload points into the queue's storage
+                    repeats.logger_name = std::string{msg.logger_name.data(), msg.logger_name.size()};
+                    repeats.payload = std::string{msg.payload.data(), msg.payload.size()};
+                    repeats.level = msg.level;
+                }
+                repeats.num_suppressed++;
+            }
+        }
+
+        void flush_() override {
+            sweep_expired_messages(spdlog::log_clock::now());
+            sink->flush();
+        }
+
+        void set_pattern_(const std::string& pattern) override { sink->set_pattern(pattern); }
+
+        void set_formatter_(std::unique_ptr<spdlog::formatter> sink_formatter) override { sink->set_formatter(std::move(sink_formatter)); }
+
+    private:
+        struct RepeatedMessage {
+            spdlog::log_clock::time_point window_start;
+
+            uint32_t count_in_window = 0;
+
+            uint32_t num_suppressed = 0;
+
+            std::string logger_name;
+
+            std::string payload;
+
+            spdlog::level::level_enum level = spdlog::level::info;
+        };
+
+        std::shared_ptr<spdlog::sinks::sink> sink;
+
+        std::unordered_map<uint64_t, RepeatedMessage> repeated_messages;
+
+        spdlog::log_clock::time_point last_sweep_time;
+
+        /*!
+         * \brief Hashes the message's logger, level, and text, skipping any digits so that messages about different objects match
+         */
+        [[nodiscard]] static uint64_t get_message_key(const spdlog::details::log_msg& msg) {
+            constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+            uint64_t hash = 14695981039346656037ULL;
+
+            const auto add_char = [&](const char c) {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= FNV_PRIME;
+            };
+
+            for(const char c : std::string_view{msg.logger_name.data(), msg.logger_name.size()}) {
+                add_char(c);
+            }
+            add_char(static_cast<char>(msg.level));
+            for(const char c : std::string_view{msg.payload.data(), msg.payload.size()}) {
+                if(c < '0' || c > '9') {
+                    add_char(c);
+                }
+            }
+
+            return hash;
+        }
+
+        /*!
+         * \brief Reports how many messages were dropped from every window that's over, and forgets about those messages
+         */
+        void sweep_expired_messages(const spdlog::log_clock::time_point now) {
+            last_sweep_time = now;
+
+            for(auto itr = repeated_messages.begin(); itr != repeated_messages.end();) {
+                auto& repeats = itr->second;
+                if(now - repeats.window_start <= RATE_LIMIT_WINDOW) {
+                    ++itr;
+                    continue;
+                }
+
+                if(repeats.num_suppressed > 0) {
+                    const auto summary = fmt::format("{} (repeated {} more times)", repeats.payload, repeats.num_suppressed);
+                    sink->log(spdlog::details::log_msg{now, {}, repeats.logger_name, repeats.level, summary});
+                }
+
+                itr = repeated_messages.erase(itr);
+            }
+        }
+    };
+
+    static std::shared_ptr<spdlog::sinks::sink> get_console_sink() {
+        static auto console_sink = std::make_shared<RateLimitedSink>(std::make_shared<spdlog::sinks::stdout_color_sink_st>());
+
+        return console_sink;
+    }
+
+    static std::shared_ptr<spdlog::details::thread_pool> get_log_thread_pool() {
+        // The thread pool's destructor drains the queue before joining the logging thread, so nothing logged before exit gets lost
+        static auto thread_pool = std::make_shared<spdlog::details::thread_pool>(LOG_QUEUE_SIZE, 1);
+
+        return thread_pool;
+    }
+
+    std::shared_ptr<spdlog::logger> make_logger(const std::string& name) {
+        static std::mutex logger_creation_mutex;
+        std::lock_guard lock{logger_creation_mutex};
+
+        // Headers with a static logger make one per translation unit, so they all share the first one
+        if(auto logger = spdlog::get(name)) {
+            return logger;
+        }
+
+        auto logger = std::make_shared<spdlog::async_logger>(name,
+                                                             get_console_sink(),
+                                                             get_log_thread_pool(),
+                                                             spdlog::async_overflow_policy::overrun_oldest);
+        // Errors are usually followed by a crash, so make sure they get out
+        logger->flush_on(spdlog::level::err);
+        spdlog::register_logger(logger);
+
+        return logger;
+    }
+
+    void flush_logs() { spdlog::apply_all([](const std::shared_ptr<spdlog::logger>& logger) { logger->flush(); }); }
+} // namespace nova
@@ -1,14 +1,25 @@
 #include "nova_renderer/nova_renderer.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <future>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include <Tracy.hpp>
 #include <TracyVulkan.hpp>
 #include <glm/ext.hpp>
 #include <glm/glm.hpp>
-#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
 #include "nova_renderer/constants.hpp"
@@ -18,20 +29,57 @@
 #include "nova_renderer/renderpack_data_conversions.hpp"
 #include "nova_renderer/rhi/command_list.hpp"
 #include "nova_renderer/rhi/swapchain.hpp"
+#include "nova_renderer/ui_batcher.hpp"
 #include "nova_renderer/ui_renderer.hpp"
+#include "nova_renderer/util/logging.hpp"
 #include "nova_renderer/util/platform.hpp"
 
 #include "debugging/renderdoc.hpp"
+#include "filesystem/folder_watcher.hpp"
+#include "filesystem/path_index.hpp"
+#include "loading/renderpack/cooked_renderpack.hpp"
 #include "loading/renderpack/render_graph_builder.hpp"
+#include "loading/renderpack/spirv_cache.hpp"
 #include "logging/console_log_stream.hpp"
 #include "render_objects/uniform_structs.hpp"
 #include "renderer/builtin/backbuffer_output_pass.hpp"
+#include "renderer/builtin/bilateral_upsample_pass.hpp"
+#include "renderer/builtin/oit_composite_pass.hpp"
+#include "renderer/builtin/depth_pyramid_pass.hpp"
+#include "renderer/builtin/motion_vectors_pass.hpp"
+#include "renderer/builtin/shading_rate_pass.hpp"
+#include "renderer/builtin/temporal_upscale_pass.hpp"
+#include "renderer/builtin_shaders.hpp"
+#include "renderer/chunk_section_pool.hpp"
+#include "renderer/cpu_timeline.hpp"
+#include "renderer/dynamic_resolution.hpp"
+#include "renderer/frame_arena.hpp"
+#include "renderer/frame_pacer.hpp"
+#include "renderer/frame_upload_allocator.hpp"
+#include "renderer/gpu_culling.hpp"
+#include "renderer/gpu_profiler.hpp"
+#include "renderer/occlusion_queries.hpp"
+#include "renderer/light_clustering.hpp"
+#include "renderer/particle_system.hpp"
+#include "renderer/volumetric_fog.hpp"
+#include "renderer/mesh_arena.hpp"
+#include "renderer/mesh_optimization.hpp"
+#include "renderer/pipeline_reflection.hpp"
+#include "renderer/readback_manager.hpp"
+#include "renderer/render_outputs.hpp"
+#include "renderer/residency_manager.hpp"
+#include "renderer/skinning_system.hpp"
+#include "renderer/temporal_accumulation_upscaler.hpp"
+#include "renderer/texture_streamer.hpp"
+#include "renderer/virtual_texture_atlas.hpp"
+#include "renderer/upload_batcher.hpp"
+#include "rhi/command_stream.hpp"
 
 using namespace nova::mem;
 using namespace operators;
 
 namespace nova::renderer {
-    static auto logger = spdlog::stdout_color_mt("NovaRenderer");
+    static auto logger = make_logger("NovaRenderer");
 
     struct BackbufferOutputPipelineCreateInfo : RhiGraphicsPipelineState {
         BackbufferOutputPipelineCreateInfo();
@@ -40,53 +88,13 @@ namespace nova::renderer {
     BackbufferOutputPipelineCreateInfo::BackbufferOutputPipelineCreateInfo() {
         name = BACKBUFFER_OUTPUT_PIPELINE_NAME;
 
-        const std::string vertex_source{R"(
-            struct VsInput {
-                float2 position : POSITION;
-            };
-
-            struct VsOutput {
-                float4 position : SV_POSITION;
-                float2 uv : TEXCOORD;
-            };
-
-            VsOutput main(VsInput input) {
-                VsOutput output;
-                output.position = float4(input.position * 2.0 - 1.0, 0, 1);
-                output.uv = input.position;
-
-                return output;
-            })"};
-        const auto& vertex_spirv = renderpack::compile_shader(vertex_source, rhi::ShaderStage::Vertex, rhi::ShaderLanguage::Hlsl);
+        const auto vertex_spirv = load_builtin_shader("backbuffer_output.vertex.hlsl", rhi::ShaderStage::Vertex);
         if(vertex_spirv.empty()) {
             logger->error("Could not compile builtin backbuffer output vertex shader");
         }
         vertex_shader = {"/nova/shaders/backbuffer_output.vertex.hlsl", vertex_spirv};
 
-        const std::string pixel_source{R"(
-            [[vk::binding(0, 0)]]
-            Texture2D ui_output : register(t0);
-
-            [[vk::binding(1, 0)]]
-            Texture2D scene_output : register(t1);
-
-            [[vk::binding(2, 0)]]
-            SamplerState tex_sampler : register(s0);
-
-            struct VsOutput {
-                float4 position : SV_POSITION;
-                float2 uv : TEXCOORD;
-            };
-
-            float3 main(VsOutput input) : SV_Target {
-                float4 ui_color = ui_output.Sample(tex_sampler, input.uv);
-                float4 scene_color = scene_output.Sample(tex_sampler, input.uv);
-
-                float3 combined_color = lerp(scene_color.rgb, ui_color.rgb, ui_color.a);
-
-                return combined_color;
-            })"};
-        const auto& pixel_spirv = renderpack::compile_shader(pixel_source, rhi::ShaderStage::Pixel, rhi::ShaderLanguage::Hlsl);
+        const auto pixel_spirv = load_builtin_shader("backbuffer_output.pixel.hlsl", rhi::ShaderStage::Pixel);
         if(pixel_spirv.empty()) {
             logger->error("Could not compile builtin backbuffer output pixel shader");
         }
@@ -98,20 +106,38 @@ namespace nova::renderer {
         color_attachments.emplace_back(BACKBUFFER_NAME, rhi::PixelFormat::Rgba8, false);
     }
 
-    static BackbufferOutputPipelineCreateInfo backbuffer_output_pipeline_create_info{};
-
     bool FullMaterialPassName::operator==(const FullMaterialPassName& other) const {
         return material_name == other.material_name && pass_name == other.pass_name;
     }
 
-    NovaRenderer::NovaRenderer(const NovaSettings& settings) : settings{settings} {
+    NovaRenderer::NovaRenderer(const NovaSettings& settings, std::shared_ptr<TaskScheduler> host_task_scheduler)
+        : settings{settings}, task_scheduler{std::move(host_task_scheduler)} {
         spdlog::flush_on(spdlog::level::err);
 
         ZoneScoped;
         create_global_allocators();
 
+        if(!task_scheduler) {
+            task_scheduler = std::make_shared<WorkStealingTaskScheduler>(settings.threading.num_worker_threads);
+
+        } else {
+            // The RHI makes command pools for as many threads as the settings say, so they have to match the scheduler
+            this->settings.settings.threading.num_worker_threads = task_scheduler->get_num_worker_threads();
+        }
+
+        renderpack::SpirvCache::get_instance().configure(settings.cache.shader_cache_directory, settings.cache.max_in_memory_shaders);
+        renderpack::CookedRenderpackCache::get_instance().configure(settings.cache.renderpack_cache_directory);
+        ShaderReflectionCache::get_instance().configure(settings.cache.shader_cache_directory);
+        filesystem::PathIndexCache::get_instance().configure(settings.cache.path_index_cache_directory);
+
         initialize_virtual_filesystem();
 
+        // Loading a renderpack only needs the filesystem and the caches, so it can read files and compile shaders while we set up the
+        // window and the device
+        if(settings.cache.preload_renderpack) {
+            start_renderpack_preload();
+        }
+
         window = std::make_unique<NovaWindow>(settings);
 
         if(settings.debug.renderdoc.enabled) {
@@ -145,6 +171,8 @@ namespace nova::renderer {
             device = rhi::create_render_device(this->settings, *window);
         }
 
+        this->settings.settings.system_info.is_uma = device->info.is_uma;
+
         swapchain = device->get_swapchain();
 
         create_global_sync_objects();
@@ -155,8 +183,20 @@ namespace nova::renderer {
 
         create_builtin_render_targets();
 
+        // The default textures' uploads and the builtin render targets' transitions, all at once
+        device_resources->submit_creation_batch();
+
         create_builtin_uniform_buffers();
 
+        upload_batcher = std::make_unique<UploadBatcher>(*device, settings.max_in_flight_frames, settings.uploads.staging_buffer_size);
+        frame_uploads = std::make_unique<FrameUploadAllocator>(*device,
+                                                               settings.max_in_flight_frames,
+                                                               settings.uploads.per_frame_upload_buffer_size);
+        frame_arena = std::make_unique<FrameArena>(settings.max_in_flight_frames, settings.frame_arena_size);
+        frame_pacer = std::make_unique<FramePacer>(settings.frame_pacing);
+
+        create_mesh_arenas();
+
         create_builtin_meshes();
 
         create_renderpass_manager();
@@ -164,66 +204,706 @@ namespace nova::renderer {
         create_builtin_renderpasses();
 
         cameras.reserve(MAX_NUM_CAMERAS);
+        frame_cameras.reserve(MAX_NUM_CAMERAS);
+        camera_matrix_states.resize(MAX_NUM_CAMERAS);
         camera_data = std::make_unique<PerFrameDeviceArray<CameraUboData>>(MAX_NUM_CAMERAS, settings.max_in_flight_frames, *device);
+
+        gpu_culling = std::make_unique<GpuCulling>(*device,
+                                                   settings.max_in_flight_frames,
+                                                   settings.culling.initial_renderable_capacity,
+                                                   settings.culling.frustum_culling,
+                                                   settings.culling.cone_culling,
+                                                   settings.lod.hysteresis);
+
+        // Dynamic resolution steers by the GPU's frame time, so it needs the timestamps even if nobody asked for them
+        if(settings.gpu_profiling.enabled || settings.dynamic_resolution.enabled) {
+            gpu_profiler = std::make_unique<GpuProfiler>(*device,
+                                                         settings.max_in_flight_frames,
+                                                         settings.gpu_profiling.max_timed_passes_per_frame,
+                                                         settings.gpu_profiling.pipeline_statistics);
+        }
+
+        if(settings.dynamic_resolution.enabled) {
+            dynamic_resolution = std::make_unique<DynamicResolutionController>(settings.dynamic_resolution);
+        }
+
+        if(settings.cpu_timeline.enabled) {
+            cpu_timeline = std::make_unique<CpuTimeline>(settings.cpu_timeline.events_per_thread);
+        }
+
+        if(settings.culling.occlusion_queries) {
+            occlusion_cache = std::make_unique<VisibilityCache>(*task_scheduler);
+            occlusion_queries = std::make_unique<OcclusionQueries>(*device,
+                                                                   settings.max_in_flight_frames,
+                                                                   settings.culling.max_occlusion_queries_per_frame);
+        }
+
+        residency = std::make_unique<ResidencyManager>(settings.max_in_flight_frames,
+                                                       settings.memory_budget.eviction_threshold,
+                                                       settings.memory_budget.eviction_target);
+
+        texture_streamer = std::make_unique<TextureStreamer>(*device,
+                                                             *device_resources,
+                                                             *upload_batcher,
+                                                             *residency,
+                                                             *task_scheduler,
+                                                             settings.texture_streaming,
+                                                             settings.max_in_flight_frames,
+                                                             settings.memory_budget.eviction_threshold);
+
+        virtual_textures = std::make_unique<VirtualTextureAtlas>(*device,
+                                                                 *task_scheduler,
+                                                                 settings.virtual_texturing,
+                                                                 settings.max_in_flight_frames);
+
+        light_clustering = std::make_unique<LightClustering>(*device, settings.light_clustering, settings.max_in_flight_frames);
+
+        particle_system = std::make_unique<ParticleSystem>(*device, settings.max_in_flight_frames);
+
+        ui_batcher = std::make_unique<UiBatcher>(*device, bilinear_sampler, settings.ui_batching, settings.max_in_flight_frames);
+
+        skinning = std::make_unique<SkinningSystem>(*device, settings.max_in_flight_frames, settings.skinning);
+
+        volumetric_fog = std::make_unique<VolumetricFog>(*device,
+                                                         settings.volumetric_fog,
+                                                         settings.light_clustering,
+                                                         *light_clustering,
+                                                         settings.max_in_flight_frames);
+
+        readbacks = std::make_unique<ReadbackManager>(*device);
+
+        render_outputs = std::make_unique<RenderOutputs>(*device, *device_resources, settings);
+
+        owner_thread_id = std::this_thread::get_id();
+        scene_thread_id = owner_thread_id;
+        if(settings.threading.render_thread) {
+            render_thread = std::thread{[this] { render_thread_loop(); }};
+            scene_thread_id = render_thread.get_id();
+        }
     }
 
-    NovaRenderer::~NovaRenderer() {}
+    NovaRenderer::~NovaRenderer() {
+        if(render_thread.joinable()) {
+            {
+                std::lock_guard lock{render_thread_mutex};
+                should_stop_render_thread = true;
+            }
+            render_thread_cv.notify_all();
+            render_thread.join();
+        }
+
+        // The compile tasks use the device, which is destroyed before the task scheduler
+        wait_for_pending_pipelines();
+
+        if(preloaded_renderpack) {
+            task_scheduler->wait_for(*preloaded_renderpack);
+        }
+
+        if(temporal_upscaler) {
+            device->wait_for_fences(frame_fences);
+            temporal_upscaler->destroy_resources(*device);
+        }
+
+        // The outputs' swapchains and render targets have to go before the device does
+        device->wait_for_fences(frame_fences);
+        render_outputs.reset();
+
+        flush_logs();
+    }
 
     NovaSettingsAccessManager& NovaRenderer::get_settings() { return settings; }
 
+    void NovaRenderer::wait_for_frame_start() {
+        ZoneScoped;
+        // The render thread may still be presenting, and the pacing below has to see when it's done
+        wait_for_render_thread();
+
+        if(settings->frame_pacing.just_in_time) {
+            // Nothing queues up behind the previous frame, so input we sample now shows up on the very next frame the display shows
+            const auto previous_frame_idx = frame_count % settings->max_in_flight_frames;
+            device->wait_for_fences(std::array{frame_fences[previous_frame_idx]});
+            frame_pacer->on_previous_frame_finished(FramePacer::Clock::now());
+
+            // If the previous frame takes longer than a second to present, frame pacing is the least of our problems
+            constexpr uint64_t PRESENT_TIMEOUT_NS = 1'000'000'000;
+            if(swapchain->wait_for_last_present(PRESENT_TIMEOUT_NS)) {
+                frame_pacer->on_previous_frame_presented(FramePacer::Clock::now());
+            }
+        }
+
+        if(const auto start_time = frame_pacer->get_next_frame_start(); start_time > FramePacer::Clock::now()) {
+            TracyPlot("Frame pacing sleep (ms)",
+                      std::chrono::duration<double, std::milli>{start_time - FramePacer::Clock::now()}.count());
+            FramePacer::sleep_until(start_time);
+        }
+
+        frame_pacer->on_frame_started(FramePacer::Clock::now());
+        waited_for_frame_start = true;
+
+        if(input_sample_callback) {
+            input_sample_callback();
+        }
+    }
+
+    void NovaRenderer::set_input_sample_callback(std::function<void()> callback) { input_sample_callback = std::move(callback); }
+
     void NovaRenderer::execute_frame() {
+        if(!render_thread.joinable()) {
+            if(!waited_for_frame_start) {
+                wait_for_frame_start();
+            }
+            waited_for_frame_start = false;
+
+            frame_cameras.assign(cameras.begin(), cameras.end());
+            render_outputs->update_window_sizes();
+            render_frame(window->get_framebuffer_size());
+            published_frame_stats = frame_stats;
+            return;
+        }
+
+        wait_for_render_thread();
+        published_frame_stats = frame_stats;
+
+        if(!waited_for_frame_start) {
+            wait_for_frame_start();
+        }
+        waited_for_frame_start = false;
+
+        // The render thread is idle, so this is the one moment where the game's side of the scene can be handed over. GLFW only lets
+        // the main thread query the window, so its size goes over with everything else
+        frame_cameras.assign(cameras.begin(), cameras.end());
+        frame_window_size = window->get_framebuffer_size();
+        render_outputs->update_window_sizes();
+        std::swap(queued_scene_commands, render_thread_commands);
+
+        {
+            std::lock_guard lock{render_thread_mutex};
+            render_thread_has_frame = true;
+        }
+        render_thread_cv.notify_all();
+    }
+
+    void NovaRenderer::wait_for_render_thread() {
+        if(!render_thread.joinable() || std::this_thread::get_id() == render_thread.get_id()) {
+            return;
+        }
+
+        ZoneScoped;
+        std::unique_lock lock{render_thread_mutex};
+        render_thread_cv.wait(lock, [&] { return !render_thread_has_frame; });
+    }
+
+    void NovaRenderer::run_on_render_thread(std::function<void()> command) {
+        if(!is_scene_thread()) {
+            queue_scene_command(std::move(command));
+        } else {
+            command();
+        }
+    }
+
+    bool NovaRenderer::is_scene_thread() const { return std::this_thread::get_id() == scene_thread_id; }
+
+    void NovaRenderer::queue_scene_command(std::function<void()> command) {
+        // The game thread has a queue all to itself. Everyone else shares the staging shards
+        if(std::this_thread::get_id() == owner_thread_id) {
+            queued_scene_commands.emplace_back(std::move(command));
+            return;
+        }
+
+        auto& shard = get_staging_shard();
+        std::lock_guard lock{shard.mutex};
+        shard.commands.emplace_back(std::move(command));
+    }
+
+    NovaRenderer::StagingShard& NovaRenderer::get_staging_shard() {
+        return staging_shards[std::hash<std::thread::id>{}(std::this_thread::get_id()) % staging_shards.size()];
+    }
+
+    void NovaRenderer::apply_staged_scene_changes() {
+        ZoneScoped;
+        std::vector<std::pair<MeshId, std::shared_ptr<PreparedMesh>>> staged_meshes;
+        std::vector<std::function<void()>> staged_commands;
+        for(auto& shard : staging_shards) {
+            std::lock_guard lock{shard.mutex};
+            std::move(shard.meshes.begin(), shard.meshes.end(), std::back_inserter(staged_meshes));
+            std::move(shard.commands.begin(), shard.commands.end(), std::back_inserter(staged_commands));
+            shard.meshes.clear();
+            shard.commands.clear();
+        }
+
+        // Meshes go first, so a renderable that one thread staged can use a mesh that another thread staged before the same frame
+        for(auto& [mesh_id, prepared] : staged_meshes) {
+            register_mesh(mesh_id, *prepared);
+        }
+
+        for(auto& command : render_thread_commands) {
+            command();
+        }
+        render_thread_commands.clear();
+
+        for(auto& command : staged_commands) {
+            command();
+        }
+    }
+
+    void NovaRenderer::render_thread_loop() {
+        while(true) {
+            {
+                std::unique_lock lock{render_thread_mutex};
+                render_thread_cv.wait(lock, [&] { return render_thread_has_frame || should_stop_render_thread; });
+
+                // A frame that was handed over before the renderer started shutting down still gets rendered
+                if(!render_thread_has_frame) {
+                    return;
+                }
+            }
+
+            render_frame(frame_window_size);
+
+            {
+                std::lock_guard lock{render_thread_mutex};
+                render_thread_has_frame = false;
+            }
+            render_thread_cv.notify_all();
+        }
+    }
+
+    void NovaRenderer::render_frame(const glm::uvec2 window_size) {
+        if(cpu_timeline) {
+            check_for_hitch();
+        }
+        const CpuTimelineScope frame_scope{cpu_timeline.get(), "Frame"};
+
+        apply_staged_scene_changes();
+
+        if(renderpack_watcher) {
+            reload_changed_renderpack_files();
+        }
+
         {
             ZoneScoped;
+            if(window_size.x == 0 || window_size.y == 0) {
+                // The window is minimized. There's nothing to present to, and Vulkan won't make a swapchain with no pixels
+                return;
+            }
+
+            // Some platforms never tell the swapchain that it's out of date, so we check the window's size ourselves
+            if(swapchain->needs_recreation() || window_size != swapchain->get_size()) {
+                recreate_swapchain();
+            }
+            render_outputs->recreate_swapchains();
+
             frame_count++;
 
-            cur_frame_idx = device->get_swapchain()->acquire_next_swapchain_image();
+            // Each in-flight frame gets its own slot of sync objects and per-frame buffers. We only have to wait on the GPU when we come
+            // back around to a slot whose previous frame hasn't finished yet
+            cur_frame_idx = static_cast<uint8_t>(frame_count % settings->max_in_flight_frames);
+            if(cpu_timeline) {
+                cpu_timeline->set_frame(frame_count);
+            }
+
+            const std::array cur_frame_fences{frame_fences[cur_frame_idx]};
+            {
+                const CpuTimelineScope wait_scope{cpu_timeline.get(), "WaitForFrameSlot"};
+                device->wait_for_fences(cur_frame_fences);
+            }
+            device->begin_frame(cur_frame_idx);
+            frame_arena->begin_frame(cur_frame_idx);
+
+            if(gpu_profiler) {
+                gpu_profiler->begin_frame(cur_frame_idx);
+
+                if(dynamic_resolution) {
+                    update_resolution_scale();
+                }
+            }
+
+            if(occlusion_queries) {
+                occlusion_queries->begin_frame(cur_frame_idx, *occlusion_cache, frame_cameras.empty() ? nullptr : &frame_cameras[0]);
+            }
+
+            if(!retired_pipelines.empty()) {
+                destroy_retired_pipelines();
+            }
+
+            if(!retired_meshes.empty()) {
+                free_retired_meshes();
+            }
+
+            for(const auto& pool : chunk_section_pools) {
+                pool->free_retired_slots(frame_count, settings->max_in_flight_frames);
+            }
+
+            {
+                const CpuTimelineScope streaming_scope{cpu_timeline.get(), "Streaming"};
+                update_residency();
+
+                upload_batcher->begin_frame(cur_frame_idx);
+                if(!chunk_sections.empty()) {
+                    apply_pending_chunk_geometry();
+                }
+                frame_uploads->begin_frame(cur_frame_idx);
+                texture_streamer->update(frame_count, memory_budgets);
+                virtual_textures->begin_frame(frame_count, cur_frame_idx);
+            }
+
+            std::optional<uint8_t> acquired_image_idx;
+            {
+                const CpuTimelineScope acquire_scope{cpu_timeline.get(), "Acquire"};
+                acquired_image_idx = swapchain->acquire_next_swapchain_image(image_available_semaphores[cur_frame_idx]);
+            }
+            if(!acquired_image_idx) {
+                // The frame's fence is still signaled, so this frame slot is ready to go again next frame
+                recreate_swapchain();
+                return;
+            }
+            cur_swapchain_image_idx = *acquired_image_idx;
+
+            // The swapchain may hand out images in a different order than our frame slots, so make sure no other in-flight frame is still
+            // rendering to the image we just got
+            if(auto* image_fence = swapchain_image_fences[cur_swapchain_image_idx];
+               image_fence != nullptr && image_fence != frame_fences[cur_frame_idx]) {
+                device->wait_for_fences(std::array{image_fence});
+            }
+            swapchain_image_fences[cur_swapchain_image_idx] = frame_fences[cur_frame_idx];
 
-            std::vector<rhi::RhiFence*> cur_frame_fences{frame_fences[cur_frame_idx]};
+            if(!pending_pipelines.empty() || !pending_pipeline_variants.empty()) {
+                swap_in_compiled_pipelines();
+            }
 
-            device->wait_for_fences(cur_frame_fences);
             device->reset_fences(cur_frame_fences);
 
+            // New materials may have grown the material buffer since this frame slot last used its device buffer
+            if(material_device_buffers[cur_frame_idx]->size.b_count() < material_buffer->size()) {
+                recreate_material_device_buffer(cur_frame_idx);
+            }
+
             FrameContext ctx = {};
             ctx.frame_count = frame_count;
             ctx.frame_idx = cur_frame_idx;
             ctx.nova = this;
-            ctx.swapchain_framebuffer = swapchain->get_framebuffer(cur_frame_idx);
-            ctx.swapchain_image = swapchain->get_image(cur_frame_idx);
+            ctx.swapchain_framebuffer = swapchain->get_framebuffer(cur_swapchain_image_idx);
+            ctx.swapchain_image = swapchain->get_image(cur_swapchain_image_idx);
             ctx.camera_matrix_buffer = camera_data->get_buffer_for_frame(cur_frame_idx);
             ctx.material_buffer = material_device_buffers[cur_frame_idx];
+            ctx.frame_uploads = frame_uploads.get();
+            ctx.gpu_profiler = gpu_profiler.get();
+            ctx.cpu_timeline = cpu_timeline.get();
+            ctx.occlusion_queries = occlusion_queries.get();
+            ctx.particles = particle_system.get();
+            ctx.skinning = skinning.get();
+            ctx.ui = ui_batcher.get();
+            ctx.allocator = frame_arena->get_resource();
+            ctx.resolution_scale = get_resolution_scale();
+
+            // The motion vectors and the upscaler need the jitter while recording. The projection itself is jittered when the camera
+            // buffer is written, after everything is recorded
+            previous_camera_jitter = camera_jitter;
+            if(is_temporal_upscaling && temporal_upscaler) {
+                const auto output_size = swapchain->get_size();
+                camera_jitter = temporal_upscaler->get_jitter(frame_count,
+                                                              scale_resolution(output_size, ctx.resolution_scale),
+                                                              output_size);
+            } else {
+                camera_jitter = {};
+            }
+            ctx.camera_jitter = camera_jitter;
+            ctx.previous_camera_jitter = previous_camera_jitter;
+
+            // Ends once every submission's commands are recorded
+            std::optional<CpuTimelineScope> record_scope{std::in_place, cpu_timeline.get(), "Record"};
+
+            gpu_culling->gather_renderables(cur_frame_idx,
+                                            passes_by_pipeline,
+                                            frame_cameras.empty() ? nullptr : &frame_cameras[0],
+                                            occlusion_cache.get());
+
+            // Gathering the renderables may have grown the culling buffers
+            ctx.draw_commands_buffer = gpu_culling->get_draw_command_buffer(cur_frame_idx);
+            ctx.draw_counts_buffer = gpu_culling->get_draw_count_buffer(cur_frame_idx);
+
+            update_renderpass_cache_keys(ctx.resolution_scale);
+
+            rendergraph->compile(*device_resources);
+
+            // A frame without any renderpasses still has to signal its fence
+            static const std::vector<RendergraphSubmission> no_submissions{RendergraphSubmission{}};
+            const auto& submissions = rendergraph->get_submissions().empty() ? no_submissions : rendergraph->get_submissions();
+
+            light_clustering->upload_lights(cur_frame_idx);
+
+            volumetric_fog->upload_volumes(cur_frame_idx);
+
+            if(const auto particle_quad = get_mesh(particle_quad_id)) {
+                particle_system->begin_frame(cur_frame_idx, *particle_quad);
+            }
 
-            rhi::RhiRenderCommandList* cmds = device->create_command_list(0,
-                                                                          rhi::QueueType::Graphics,
-                                                                          rhi::RhiRenderCommandList::Level::Primary);
-            cmds->set_debug_name("RendergraphCommands");
+            skinning->begin_frame();
+
+            // Only the textures that were added or finished uploading since this frame slot's last frame get new descriptors
+            device->update_standard_descriptors(cur_frame_idx,
+                                                ctx.camera_matrix_buffer,
+                                                ctx.material_buffer->buffer,
+                                                gpu_culling->get_model_matrix_buffer(cur_frame_idx),
+                                                gpu_culling->get_vertex_layout_buffer(cur_frame_idx),
+                                                point_sampler,
+                                                bilinear_sampler,
+                                                point_sampler,
+                                                virtual_textures->get_page_table_buffer(cur_frame_idx),
+                                                virtual_textures->get_feedback_buffer(cur_frame_idx),
+                                                virtual_textures->get_page_cache(),
+                                                light_clustering->get_params_buffer(cur_frame_idx),
+                                                light_clustering->get_light_buffer(cur_frame_idx),
+                                                light_clustering->get_cluster_buffer(cur_frame_idx),
+                                                light_clustering->get_light_index_buffer(cur_frame_idx),
+                                                particle_system->get_particle_buffer(),
+                                                volumetric_fog->get_integrated_volume(),
+                                                vertex_arena->get_buffers(),
+                                                get_all_images(ctx.allocator));
+
+            std::pmr::vector<rhi::RhiRenderCommandList*> submission_cmds{ctx.allocator};
+            submission_cmds.reserve(submissions.size());
+
+            std::pmr::vector<rhi::RhiSemaphore*> wait_semaphores{ctx.allocator};
+            rhi::RhiRenderCommandList* upload_cmds = nullptr;
+            rhi::RhiRenderCommandList* last_graphics_cmds = nullptr;
+            for(const RendergraphSubmission& submission : submissions) {
+                auto* cmds = device->create_command_list(0, submission.queue, rhi::RhiRenderCommandList::Level::Primary);
+
+                if(submission.queue == rhi::QueueType::Graphics) {
+                    const auto is_first_graphics_submission = last_graphics_cmds == nullptr;
+                    last_graphics_cmds = cmds;
+
+                    if(is_first_graphics_submission) {
+                        cmds->set_debug_name("RendergraphCommands");
+
+                        // Send everything that was uploaded since the last frame before anything can draw it
+                        const auto uploads = upload_batcher->flush(*cmds, cur_frame_idx);
+                        upload_cmds = uploads.transfer_cmds;
+                        wait_semaphores.assign(uploads.semaphores.begin(), uploads.semaphores.end());
+                        wait_semaphores.push_back(image_available_semaphores[cur_frame_idx]);
+
+                        for(auto& [id, proc_mesh] : proc_meshes) {
+                            proc_mesh.record_commands_to_upload_data(cmds, static_cast<uint8_t>(cur_frame_idx));
+                        }
+
+                        virtual_textures->record_page_uploads(*cmds, cur_frame_idx, *frame_uploads);
+
+                        ui_batcher->record_atlas_uploads(*cmds, *frame_uploads);
+
+                        // Moving memory around is the first thing to go when the frame is already running long
+                        const auto& defragmentation = settings->defragmentation;
+                        const auto predicted_frame_time_ms = std::chrono::duration<float, std::milli>(
+                                                                 frame_pacer->get_predicted_frame_time())
+                                                                 .count();
+                        if(defragmentation.enabled && predicted_frame_time_ms < defragmentation.max_frame_time_ms) {
+                            device->record_defragmentation(*cmds, defragmentation.max_moves_per_frame, defragmentation.max_bytes_per_frame);
+                        }
+                    }
+
+                    cmds->bind_material_resources(cur_frame_idx);
+
+                    if(is_first_graphics_submission) {
+                        gpu_culling->record_culling(*cmds, cur_frame_idx, *frame_uploads);
+
+                        // The clusters only depend on the camera, so they don't have to wait for a depth prepass
+                        light_clustering->record_clustering(*cmds, cur_frame_idx);
+
+                        volumetric_fog->record_fog(*cmds, cur_frame_idx);
+
+                        skinning->record_skinning(*cmds, cur_frame_idx, *frame_uploads);
+
+                        particle_system->record_simulation(*cmds, cur_frame_idx);
+                    }
+
+                    if(settings->threading.parallel_command_recording) {
+                        record_renderpasses_in_parallel(submission.passes, *cmds, ctx);
+
+                    } else {
+                        for(Renderpass* renderpass : submission.passes) {
+                            renderpass->execute(*cmds, ctx);
+                        }
+                    }
+
+                } else {
+                    cmds->set_debug_name("RendergraphAsyncComputeCommands");
+
+                    for(Renderpass* renderpass : submission.passes) {
+                        renderpass->execute(*cmds, ctx);
+                    }
+                }
 
-            const auto images = get_all_images();
+                submission_cmds.push_back(cmds);
+            }
+            record_scope.reset();
+
+            ui_batcher->end_frame();
+
+            // Virtual textures are only sampled by pixel shaders, so their feedback is complete at the end of the last graphics submission
+            std::function<void()> finish_readbacks;
+            if(last_graphics_cmds != nullptr) {
+                virtual_textures->record_feedback_readback(*last_graphics_cmds, cur_frame_idx);
+
+                // The outputs' blits go first, so that readbacks of offscreen outputs get this frame
+                render_outputs->record_blits(*last_graphics_cmds,
+                                             cur_frame_idx,
+                                             frame_fences[cur_frame_idx],
+                                             [&](const std::string& name) -> std::optional<RenderOutputSource> {
+                                                 const auto info_itr = dynamic_texture_infos.find(name);
+                                                 const auto render_target = device_resources->get_render_target(name);
+                                                 if(info_itr == dynamic_texture_infos.end() || !render_target ||
+                                                    (*render_target)->image->is_depth_tex ||
+                                                    info_itr->second.usage == renderpack::ImageUsage::TransientRenderTarget ||
+                                                    rendergraph->is_aliased(name)) {
+                                                     return std::nullopt;
+                                                 }
+
+                                                 // Only the top-left corner of scaled render targets has anything in it
+                                                 const glm::uvec2 size{static_cast<uint32_t>((*render_target)->width),
+                                                                       static_cast<uint32_t>((*render_target)->height)};
+                                                 const auto is_scaled = (dynamic_resolution || is_temporal_upscaling) &&
+                                                                        info_itr->second.format.dimension_type ==
+                                                                            renderpack::TextureDimensionType::ScreenRelative &&
+                                                                        name != UI_OUTPUT_RT_NAME && name != UPSCALED_OUTPUT_RT_NAME;
+
+                                                 return RenderOutputSource{(*render_target)->image,
+                                                                           rhi::ResourceState::RenderTarget,
+                                                                           is_scaled ? scale_resolution(size, ctx.resolution_scale) : size,
+                                                                           info_itr->second.format.num_layers};
+                                             });
+
+                // The last pass put every render target back in its resting state. Aliased and transient ones don't have anything left
+                finish_readbacks = readbacks->record_readbacks(*last_graphics_cmds, [&](const std::string& name) {
+                    if(auto offscreen_output = render_outputs->get_offscreen_target(name)) {
+                        return offscreen_output;
+                    }
+
+                    const auto info_itr = dynamic_texture_infos.find(name);
+                    const auto render_target = device_resources->get_render_target(name);
+                    if(info_itr == dynamic_texture_infos.end() || !render_target ||
+                       info_itr->second.usage == renderpack::ImageUsage::TransientRenderTarget || rendergraph->is_aliased(name)) {
+                        return std::optional<ReadableRenderTarget>{};
+                    }
+
+                    auto* image = (*render_target)->image;
+                    return std::optional{ReadableRenderTarget{
+                        image,
+                        image->is_depth_tex ? rhi::ResourceState::DepthWrite : rhi::ResourceState::RenderTarget,
+                        (*render_target)->format,
+                        static_cast<uint32_t>((*render_target)->width),
+                        static_cast<uint32_t>((*render_target)->height),
+                        std::max(info_itr->second.num_mips, 1U),
+                    }};
+                });
+            }
+
+            frame_stats = {};
+            for(const auto* cmds : submission_cmds) {
+                frame_stats += cmds->get_stats();
+            }
 
-            cmds->bind_material_resources(ctx.camera_matrix_buffer,
-                                          ctx.material_buffer->buffer,
-                                          point_sampler,
-                                          point_sampler,
-                                          point_sampler,
-                                          images);
+            TracyPlot("DrawCalls", static_cast<int64_t>(frame_stats.draw_calls + frame_stats.indirect_draw_calls));
+            TracyPlot("BytesUploaded", static_cast<int64_t>(frame_stats.bytes_uploaded));
+
+            {
+                const CpuTimelineScope uploads_scope{cpu_timeline.get(), "Uploads"};
+
+                // The rendergraph may update the camera and material data, so we upload the data once everything is recorded, and
+                // before anything is submitted. This frame slot's fence has signaled, so the GPU isn't reading these buffers anymore
+                update_camera_matrix_buffer(cur_frame_idx);
+                material_buffer->upload_to_device(cur_frame_idx, *device, ctx.material_buffer->buffer);
+
+                // Passes without views render with camera 0, and everything is culled against it. Passes with views share its culling
+                // results
+                gpu_culling->upload_frustum(cur_frame_idx, frame_cameras.empty() ? nullptr : &std::as_const(*camera_data).at(0));
+                light_clustering->upload_params(cur_frame_idx,
+                                                frame_cameras.empty() ? nullptr : &frame_cameras[0],
+                                                frame_cameras.empty() ? nullptr : &std::as_const(*camera_data).at(0));
+                volumetric_fog->upload_params(cur_frame_idx,
+                                              frame_cameras.empty() ? nullptr : &frame_cameras[0],
+                                              frame_cameras.empty() ? nullptr : &std::as_const(*camera_data).at(0));
+
+                if(occlusion_queries && !frame_cameras.empty()) {
+                    occlusion_queries->pick_candidates(*occlusion_cache, frame_cameras[0], std::as_const(*camera_data).at(0));
+                }
 
-            const auto& renderpass_order = rendergraph->calculate_renderpass_execution_order();
+                frame_uploads->flush();
+            }
 
-            for(const std::string& renderpass_name : renderpass_order) {
-                auto* renderpass = rendergraph->get_renderpass(renderpass_name);
-                renderpass->execute(*cmds, ctx);
+            // The whole frame goes to the GPU in one batch, with the uploads first. The queues' timeline semaphores order the rendergraph's
+            // submissions, so only the swapchain needs semaphores of its own
+            const uint32_t first_rendergraph_submission = upload_cmds != nullptr ? 1 : 0;
+            std::pmr::vector<rhi::RhiSubmission> frame_submissions{ctx.allocator};
+            frame_submissions.reserve(submissions.size() + first_rendergraph_submission);
+            if(upload_cmds != nullptr) {
+                frame_submissions.push_back({upload_cmds, rhi::QueueType::Transfer});
             }
 
-            // The rendergraph may update the camera and material data, so we upload the data at the end of the frame
-            update_camera_matrix_buffer(cur_frame_idx);
-            device->write_data_to_buffer(material_buffer->data(), ctx.material_buffer->size, ctx.material_buffer->buffer);
+            // The inner vectors get the arena too, since pmr containers hand their allocator down to their elements
+            std::pmr::vector<std::pmr::vector<uint32_t>> submissions_to_wait_for(submissions.size(), ctx.allocator);
+
+            std::pmr::vector<rhi::RhiSemaphore*> last_graphics_wait_semaphores{ctx.allocator};
+            std::pmr::vector<rhi::RhiSemaphore*> last_graphics_signal_semaphores{ctx.allocator};
+
+            bool waited_for_frame_start = false;
+            for(uint32_t submission_idx = 0; submission_idx < submissions.size(); submission_idx++) {
+                const auto& submission = submissions[submission_idx];
+
+                auto& waits = submissions_to_wait_for[submission_idx];
+                for(const uint32_t waited_submission_idx : submission.submissions_to_wait_for) {
+                    waits.push_back(waited_submission_idx + first_rendergraph_submission);
+                }
+
+                rhi::RhiSubmission frame_submission{submission_cmds[submission_idx], submission.queue};
+                if(submission_cmds[submission_idx] == last_graphics_cmds) {
+                    frame_submission.on_completion = std::move(finish_readbacks);
+                }
+                if(submission.queue == rhi::QueueType::Graphics && !waited_for_frame_start) {
+                    if(upload_cmds != nullptr) {
+                        waits.push_back(0);
+                    }
+                    frame_submission.wait_semaphores = wait_semaphores;
+                    waited_for_frame_start = true;
+                }
+
+                if(submission_idx == submissions.size() - 1) {
+                    frame_submission.signal_semaphores = std::span{&render_finished_semaphores[cur_frame_idx], 1};
+                }
+
+                // The other outputs' swapchain images are blitted to at the end of the last graphics command list
+                if(submission_cmds[submission_idx] == last_graphics_cmds && !render_outputs->get_wait_semaphores().empty()) {
+                    last_graphics_wait_semaphores.assign(frame_submission.wait_semaphores.begin(), frame_submission.wait_semaphores.end());
+                    last_graphics_wait_semaphores.insert(last_graphics_wait_semaphores.end(),
+                                                         render_outputs->get_wait_semaphores().begin(),
+                                                         render_outputs->get_wait_semaphores().end());
+                    frame_submission.wait_semaphores = last_graphics_wait_semaphores;
+
+                    last_graphics_signal_semaphores.assign(frame_submission.signal_semaphores.begin(),
+                                                           frame_submission.signal_semaphores.end());
+                    last_graphics_signal_semaphores.insert(last_graphics_signal_semaphores.end(),
+                                                           render_outputs->get_signal_semaphores().begin(),
+                                                           render_outputs->get_signal_semaphores().end());
+                    frame_submission.signal_semaphores = last_graphics_signal_semaphores;
+                }
+
+                frame_submission.submissions_to_wait_for = waits;
+                frame_submissions.push_back(frame_submission);
+            }
 
-            device->submit_command_list(cmds, rhi::QueueType::Graphics, frame_fences[cur_frame_idx]);
+            {
+                const CpuTimelineScope submit_scope{cpu_timeline.get(), "Submit"};
+                device->submit_command_lists(frame_submissions, frame_fences[cur_frame_idx]);
+            }
 
-            // Wait for the GPU to finish before presenting. This destroys pipelining and throughput, however at this time I'm not sure how
-            // best to say "when GPU finishes this task, CPU should do something"
-            device->wait_for_fences(cur_frame_fences);
+            {
+                const CpuTimelineScope present_scope{cpu_timeline.get(), "Present"};
+                swapchain->present(cur_swapchain_image_idx, render_finished_semaphores[cur_frame_idx]);
+                render_outputs->present(cur_frame_idx);
+            }
 
-            device->get_swapchain()->present(cur_frame_idx);
+            // Runs the cleanup for any earlier submissions that the GPU has finished with
+            const CpuTimelineScope end_frame_scope{cpu_timeline.get(), "EndFrame"};
+            device->end_frame(ctx);
         }
 
         FrameMark;
@@ -233,315 +913,2995 @@ namespace nova::renderer {
 #endif
     }
 
-    void NovaRenderer::set_num_meshes(const uint32_t /* num_meshes */) { /* TODO? */
-    }
+    void NovaRenderer::record_renderpasses_in_parallel(const std::vector<Renderpass*>& renderpass_order,
+                                                       rhi::RhiRenderCommandList& cmds,
+                                                       FrameContext& ctx) {
+        ZoneScoped;
+        std::pmr::vector<std::future<rhi::RhiRenderCommandList*>> recorded_contents{ctx.allocator};
+        recorded_contents.reserve(renderpass_order.size());
+
+        const auto use_command_streams = settings->threading.command_streams;
+
+        // Commands that renderpasses recorded in an earlier frame and can execute again, or nullptr for renderpasses that record now
+        std::pmr::vector<rhi::RhiRenderCommandList*> reused_contents{renderpass_order.size(), nullptr, ctx.allocator};
+
+        // Where the renderpasses that reuse their commands, but have to record them again this frame, keep what they record
+        std::pmr::vector<ReusableContents*> contents_to_reuse{renderpass_order.size(), nullptr, ctx.allocator};
+
+        for(size_t i = 0; i < renderpass_order.size(); i++) {
+            auto* renderpass = renderpass_order[i];
+            // Secondary command lists inherit a renderpass, so compute passes that ended up on the graphics queue are recorded inline.
+            // Passes that are off or cached only record their barriers, so they're recorded inline too, since there's nothing to hand
+            // off
+            if(renderpass->renderpass == nullptr || !renderpass->supports_parallel_recording || !renderpass->is_enabled ||
+               renderpass->can_reuse_cached_contents()) {
+                // Leave an empty future in this slot so the indices still line up with renderpass_order
+                recorded_contents.emplace_back();
+                continue;
+            }
 
-    MeshId NovaRenderer::create_mesh(const MeshData& mesh_data) {
-        if(mesh_data.num_vertex_attributes == 0) {
-            logger->error("Can not add a mesh with zero vertex attributes");
+            // Occlusion queries test different renderables every frame
+            const auto has_occlusion_queries = renderpass->has_depth_prepass && ctx.occlusion_queries != nullptr;
+            if(renderpass->reuses_recorded_commands && !has_occlusion_queries) {
+                auto& frame_contents = reusable_contents[renderpass];
+                frame_contents.resize(settings->max_in_flight_frames);
+
+                auto& contents = frame_contents[ctx.frame_idx];
+                const auto recording_key = get_recording_key(*renderpass, ctx);
+                if(contents.cmds != nullptr && contents.recording_key == recording_key) {
+                    reused_contents[i] = contents.cmds;
+                    recorded_contents.emplace_back();
+                    continue;
+                }
+
+                // This frame slot's last frame is done, so nothing's still executing the old commands
+                if(contents.cmds != nullptr) {
+                    device->destroy_reusable_command_list(contents.cmds);
+                }
+                contents = {nullptr, recording_key};
+                contents_to_reuse[i] = &contents;
+
+                recorded_contents.emplace_back(task_scheduler->add_task([&, renderpass](uint32_t /* thread_idx */) {
+                    const CpuTimelineScope cpu_scope{ctx.cpu_timeline, renderpass->name};
+                    FrameContext thread_ctx = ctx;
+                    thread_ctx.allocator = std::pmr::get_default_resource();
+
+                    // Timestamps go in different queries every frame, so commands that get executed again can't write any
+                    thread_ctx.gpu_profiler = nullptr;
+
+                    auto* reusable_cmds = device->create_reusable_command_list(renderpass->get_renderpass(),
+                                                                               renderpass->get_framebuffer(ctx),
+                                                                               renderpass->get_subpass_index());
+                    reusable_cmds->bind_material_resources(static_cast<uint32_t>(ctx.frame_idx));
+
+                    renderpass->record_contents(*reusable_cmds, thread_ctx);
+
+                    return reusable_cmds;
+                }));
+                continue;
+            }
+
+            if(use_command_streams) {
+                // The map only changes on this thread, before the task that uses the stream starts
+                auto& stream = command_streams[renderpass];
+                if(!stream) {
+                    stream = std::make_unique<rhi::CommandStream>();
+                }
+
+                recorded_contents.emplace_back(task_scheduler->add_task([&, renderpass, stream = stream.get()](uint32_t /* thread_idx */) {
+                    const CpuTimelineScope cpu_scope{ctx.cpu_timeline, renderpass->name};
+                    FrameContext thread_ctx = ctx;
+                    thread_ctx.allocator = std::pmr::get_default_resource();
+
+                    // Streams are translated into the primary command list, so they already have its descriptor bindings
+                    stream->reset();
+                    renderpass->record_contents(*stream, thread_ctx);
+
+                    return static_cast<rhi::RhiRenderCommandList*>(stream);
+                }));
+                continue;
+            }
+
+            recorded_contents.emplace_back(task_scheduler->add_task([&, renderpass](const uint32_t thread_idx) {
+                const CpuTimelineScope cpu_scope{ctx.cpu_timeline, renderpass->name};
+
+                // Recording bumps some counters in the frame context, so each task gets its own copy. The frame arena isn't thread-safe,
+                // so workers allocate their temporaries from the heap
+                FrameContext thread_ctx = ctx;
+                thread_ctx.allocator = std::pmr::get_default_resource();
+
+                auto* contents = device->create_secondary_command_list(thread_idx,
+                                                                       renderpass->get_renderpass(),
+                                                                       renderpass->get_framebuffer(ctx),
+                                                                       renderpass->get_subpass_index());
+
+                // Secondary command lists don't inherit any descriptor bindings from the primary command list
+                contents->bind_material_resources(static_cast<uint32_t>(ctx.frame_idx));
+
+                renderpass->record_contents(*contents, thread_ctx);
+
+                return contents;
+            }));
         }
 
-        if(mesh_data.num_indices == 0) {
-            logger->error("Can not add a mesh with zero indices");
+        // Stitch everything together in execution order. Renderpasses that have to be recorded on this thread get recorded inline while
+        // the workers finish up the rest
+        for(size_t i = 0; i < renderpass_order.size(); i++) {
+            auto* renderpass = renderpass_order[i];
+            if(reused_contents[i] != nullptr) {
+                renderpass->execute(cmds, ctx, *reused_contents[i]);
+
+            } else if(contents_to_reuse[i] != nullptr) {
+                contents_to_reuse[i]->cmds = recorded_contents[i].get();
+                renderpass->execute(cmds, ctx, *contents_to_reuse[i]->cmds);
+
+            } else if(recorded_contents[i].valid() && use_command_streams) {
+                renderpass->execute(cmds, ctx, static_cast<const rhi::CommandStream&>(*recorded_contents[i].get()));
+
+            } else if(recorded_contents[i].valid()) {
+                renderpass->execute(cmds, ctx, *recorded_contents[i].get());
+
+            } else {
+                renderpass->execute(cmds, ctx);
+            }
         }
+    }
+
+    void NovaRenderer::set_num_meshes(const uint32_t /* num_meshes */) { /* TODO? */
+    }
 
-        rhi::RhiBufferCreateInfo vertex_buffer_create_info;
-        vertex_buffer_create_info.buffer_usage = rhi::BufferUsage::VertexBuffer;
-        vertex_buffer_create_info.size = mesh_data.vertex_data_size;
+    /*!
+     * \brief A mesh that's done with everything `create_mesh` does on the CPU, and only needs a home in the mesh arenas
+     *
+     * `source` points either at the caller's data or at the storage in here. Moving the struct keeps the storage where it is, since
+     * moved vectors keep their buffers
+     */
+    struct NovaRenderer::PreparedMesh {
+        MeshData source;
 
-        rhi::RhiBuffer* vertex_buffer = device->create_buffer(vertex_buffer_create_info);
+        std::optional<OptimizedMesh> optimized_mesh;
 
-        // TODO: Try to get staging buffers from a pool
+        std::optional<MeshletMesh> meshlet_mesh;
 
-        {
-            rhi::RhiBufferCreateInfo staging_vertex_buffer_create_info = vertex_buffer_create_info;
-            staging_vertex_buffer_create_info.buffer_usage = rhi::BufferUsage::StagingBuffer;
+        std::vector<MeshLod> lods;
 
-            rhi::RhiBuffer* staging_vertex_buffer = device->create_buffer(staging_vertex_buffer_create_info);
-            device->write_data_to_buffer(mesh_data.vertex_data_ptr, vertex_buffer_create_info.size, staging_vertex_buffer);
+        std::vector<uint32_t> lod_indices;
 
-            rhi::RhiRenderCommandList* vertex_upload_cmds = device->create_command_list(0,
-                                                                                        rhi::QueueType::Transfer,
-                                                                                        rhi::RhiRenderCommandList::Level::Primary);
-            vertex_upload_cmds->set_debug_name("VertexDataUpload");
-            vertex_upload_cmds->copy_buffer(vertex_buffer, 0, staging_vertex_buffer, 0, vertex_buffer_create_info.size);
+        std::vector<uint16_t> narrow_index_data;
 
-            rhi::RhiResourceBarrier vertex_barrier = {};
-            vertex_barrier.resource_to_barrier = vertex_buffer;
-            vertex_barrier.old_state = rhi::ResourceState::CopyDestination;
-            vertex_barrier.new_state = rhi::ResourceState::Common;
-            vertex_barrier.access_before_barrier = rhi::ResourceAccess::CopyWrite;
-            vertex_barrier.access_after_barrier = rhi::ResourceAccess::VertexAttributeRead;
-            vertex_barrier.source_queue = rhi::QueueType::Transfer;
-            vertex_barrier.destination_queue = rhi::QueueType::Graphics;
-            vertex_barrier.buffer_memory_barrier.offset = 0;
-            vertex_barrier.buffer_memory_barrier.size = vertex_buffer->size;
+        rhi::IndexType index_type = rhi::IndexType::Uint32;
 
-            vertex_upload_cmds->resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::VertexInput, {vertex_barrier});
+        /*!
+         * \brief Copies of the caller's data, for meshes that are registered after `create_mesh` returns
+         */
+        std::vector<std::byte> owned_vertex_data;
+        std::vector<std::byte> owned_index_data;
 
-            device->submit_command_list(vertex_upload_cmds, rhi::QueueType::Transfer);
+        /*!
+         * \brief Copies whatever `source` still points at in the caller's data
+         */
+        void take_ownership() {
+            if(!optimized_mesh) {
+                const auto* vertices = static_cast<const std::byte*>(source.vertex_data_ptr);
+                owned_vertex_data.assign(vertices, vertices + source.vertex_data_size);
+                source.vertex_data_ptr = owned_vertex_data.data();
+            }
 
-            // TODO: Barrier on the mesh's first usage
+            if(index_type == rhi::IndexType::Uint32 && !optimized_mesh && !meshlet_mesh) {
+                const auto* indices = static_cast<const std::byte*>(source.index_data_ptr);
+                owned_index_data.assign(indices, indices + source.index_data_size);
+                source.index_data_ptr = owned_index_data.data();
+            }
         }
+    };
 
-        rhi::RhiBufferCreateInfo index_buffer_create_info;
-        index_buffer_create_info.buffer_usage = rhi::BufferUsage::IndexBuffer;
-        index_buffer_create_info.size = mesh_data.index_data_size;
+    MeshId NovaRenderer::create_mesh(const MeshData& mesh_data) {
+        ZoneScoped;
+        auto prepared = prepare_mesh(mesh_data);
+        if(!prepared) {
+            return std::numeric_limits<MeshId>::max();
+        }
 
-        rhi::RhiBuffer* index_buffer = device->create_buffer(index_buffer_create_info);
+        const MeshId new_mesh_id = next_mesh_id.fetch_add(1);
+        if(!is_scene_thread()) {
+            prepared->take_ownership();
 
-        {
-            rhi::RhiBufferCreateInfo staging_index_buffer_create_info = index_buffer_create_info;
-            staging_index_buffer_create_info.buffer_usage = rhi::BufferUsage::StagingBuffer;
-            rhi::RhiBuffer* staging_index_buffer = device->create_buffer(staging_index_buffer_create_info);
-            device->write_data_to_buffer(mesh_data.index_data_ptr, index_buffer_create_info.size, staging_index_buffer);
+            auto& shard = get_staging_shard();
+            std::lock_guard lock{shard.mutex};
+            shard.meshes.emplace_back(new_mesh_id, std::make_shared<PreparedMesh>(std::move(*prepared)));
 
-            rhi::RhiRenderCommandList* indices_upload_cmds = device->create_command_list(0,
-                                                                                         rhi::QueueType::Transfer,
-                                                                                         rhi::RhiRenderCommandList::Level::Primary);
-            indices_upload_cmds->set_debug_name("IndexDataUpload");
-            indices_upload_cmds->copy_buffer(index_buffer, 0, staging_index_buffer, 0, index_buffer_create_info.size);
+            return new_mesh_id;
+        }
 
-            rhi::RhiResourceBarrier index_barrier = {};
-            index_barrier.resource_to_barrier = index_buffer;
-            index_barrier.old_state = rhi::ResourceState::CopyDestination;
-            index_barrier.new_state = rhi::ResourceState::Common;
-            index_barrier.access_before_barrier = rhi::ResourceAccess::CopyWrite;
-            index_barrier.access_after_barrier = rhi::ResourceAccess::IndexRead;
-            index_barrier.source_queue = rhi::QueueType::Transfer;
-            index_barrier.destination_queue = rhi::QueueType::Graphics;
-            index_barrier.buffer_memory_barrier.offset = 0;
-            index_barrier.buffer_memory_barrier.size = index_buffer->size;
+        return register_mesh(new_mesh_id, *prepared) ? new_mesh_id : std::numeric_limits<MeshId>::max();
+    }
 
-            indices_upload_cmds->resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::VertexInput, {index_barrier});
+    std::optional<NovaRenderer::PreparedMesh> NovaRenderer::prepare_mesh(const MeshData& mesh_data) const {
+        ZoneScoped;
+        if(mesh_data.num_vertex_attributes == 0) {
+            logger->error("Can not add a mesh with zero vertex attributes");
+        }
+
+        if(mesh_data.num_indices == 0) {
+            logger->error("Can not add a mesh with zero indices");
+        }
+
+        if(mesh_data.vertex_size == 0 || mesh_data.vertex_data_size % mesh_data.vertex_size != 0) {
+            logger->error("Mesh has {} bytes of vertex data, which isn't a whole number of {}-byte vertices",
+                          mesh_data.vertex_data_size,
+                          mesh_data.vertex_size);
+            return std::nullopt;
+        }
+
+        // Everything past here reads the mesh through `source`, so optimization can swap in its own copy of the data
+        PreparedMesh prepared;
+        auto& source = prepared.source;
+        source = mesh_data;
+        const bool is_triangle_list = mesh_data.num_indices % 3 == 0 &&
+                                      mesh_data.index_data_size == mesh_data.num_indices * sizeof(uint32_t);
+
+        if(mesh_data.optimize) {
+            if(!is_triangle_list) {
+                logger->error("Mesh optimization needs a triangle list with 32-bit indices. This mesh will be uploaded as-is");
+
+            } else {
+                prepared.optimized_mesh = optimize_mesh(mesh_data, mesh_data.lods.empty());
+                source.vertex_data_ptr = prepared.optimized_mesh->vertices.data();
+                source.vertex_data_size = prepared.optimized_mesh->vertices.size();
+                source.index_data_ptr = prepared.optimized_mesh->indices.data();
+            }
+        }
+
+        // Meshlets reorder the mesh's triangles, so their indices are what gets uploaded
+        if(mesh_data.build_meshlets) {
+            if(!is_triangle_list) {
+                logger->error("Meshlets need a triangle list with 32-bit indices. This mesh will be culled as a whole");
+
+            } else {
+                prepared.meshlet_mesh = build_meshlets(source);
+                source.index_data_ptr = prepared.meshlet_mesh->indices.data();
+            }
+        }
+
+        // The LODs' indices go right after the full mesh's indices, in the same allocation
+        auto& lods = prepared.lods;
+        auto& lod_indices = prepared.lod_indices;
+        const bool wants_lods = !mesh_data.lods.empty() || mesh_data.num_generated_lods > 0;
+        if(wants_lods && mesh_data.bounding_sphere.w < 0) {
+            logger->warn("Mesh has LODs but no bounding sphere, so it will always be drawn at full detail");
+
+        } else if(wants_lods && mesh_data.index_data_size != mesh_data.num_indices * sizeof(uint32_t)) {
+            logger->error("LODs need 32-bit indices. This mesh will always be drawn at full detail");
+
+        } else if(!mesh_data.lods.empty()) {
+            for(const MeshLodData& lod : mesh_data.lods) {
+                lods.push_back({static_cast<uint32_t>(lod_indices.size()), lod.num_indices, lod.screen_size});
+                lod_indices.insert(lod_indices.end(), lod.index_data_ptr, lod.index_data_ptr + lod.num_indices);
+            }
+
+        } else if(mesh_data.num_generated_lods > 0) {
+            lods = generate_mesh_lods(source, mesh_data.num_generated_lods, settings->lod.first_lod_screen_size, lod_indices);
+        }
+
+        // Optimized meshes with few enough vertices get 16-bit indices. Draws add the mesh's vertex offset to every index, so only the
+        // mesh's own vertex count matters
+        const auto num_vertices = source.vertex_data_size / source.vertex_size;
+        if(prepared.optimized_mesh && num_vertices <= std::numeric_limits<uint16_t>::max() + 1) {
+            const auto* indices = static_cast<const uint32_t*>(source.index_data_ptr);
+            std::vector<uint32_t> all_indices{indices, indices + source.num_indices};
+            all_indices.insert(all_indices.end(), lod_indices.begin(), lod_indices.end());
+
+            prepared.narrow_index_data = narrow_indices(all_indices);
+            prepared.index_type = rhi::IndexType::Uint16;
+        }
+
+        return prepared;
+    }
+
+    bool NovaRenderer::register_mesh(const MeshId new_mesh_id, PreparedMesh& prepared) {
+        ZoneScoped;
+        const auto& source = prepared.source;
+        const auto index_type = prepared.index_type;
+        auto& lods = prepared.lods;
+        const auto& lod_indices = prepared.lod_indices;
+
+        const auto index_size = index_type == rhi::IndexType::Uint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        const auto main_index_data_size = index_type == rhi::IndexType::Uint16 ? source.num_indices * index_size : source.index_data_size;
+        const auto lod_data_size = lod_indices.size() * index_size;
+
+        // Aligning to the vertex size lets us express the mesh's offset in vertices, which is what the draw commands want
+        const auto vertex_allocation = vertex_arena->allocate(source.vertex_data_size, source.vertex_size);
+        if(!vertex_allocation) {
+            logger->error("Could not allocate {} bytes of vertex data", source.vertex_data_size);
+            return false;
+        }
+
+        // 32-bit alignment even for 16-bit indices, so the index arena's buffers can hold both
+        const auto index_allocation = index_arena->allocate(main_index_data_size + lod_data_size, sizeof(uint32_t));
+        if(!index_allocation) {
+            logger->error("Could not allocate {} bytes of index data", main_index_data_size + lod_data_size);
+            vertex_arena->free(*vertex_allocation);
+            return false;
+        }
+
+        // The upload batcher copies the data right away, so the caller can free it as soon as we return
+        upload_batcher->upload_to_buffer(vertex_allocation->buffer,
+                                         vertex_allocation->offset,
+                                         source.vertex_data_ptr,
+                                         source.vertex_data_size,
+                                         rhi::ResourceAccess::VertexAttributeRead,
+                                         rhi::PipelineStage::VertexInput);
+        if(index_type == rhi::IndexType::Uint16) {
+            upload_batcher->upload_to_buffer(index_allocation->buffer,
+                                             index_allocation->offset,
+                                             prepared.narrow_index_data.data(),
+                                             main_index_data_size + lod_data_size,
+                                             rhi::ResourceAccess::IndexRead,
+                                             rhi::PipelineStage::VertexInput);
+
+        } else {
+            upload_batcher->upload_to_buffer(index_allocation->buffer,
+                                             index_allocation->offset,
+                                             source.index_data_ptr,
+                                             main_index_data_size,
+                                             rhi::ResourceAccess::IndexRead,
+                                             rhi::PipelineStage::VertexInput);
+            if(!lod_indices.empty()) {
+                upload_batcher->upload_to_buffer(index_allocation->buffer,
+                                                 index_allocation->offset + main_index_data_size,
+                                                 lod_indices.data(),
+                                                 lod_data_size,
+                                                 rhi::ResourceAccess::IndexRead,
+                                                 rhi::PipelineStage::VertexInput);
+            }
+        }
+
+        Mesh mesh;
+        mesh.num_vertex_attributes = source.num_vertex_attributes;
+        mesh.vertex_buffer = vertex_allocation->buffer;
+        mesh.index_buffer = index_allocation->buffer;
+        mesh.index_type = index_type;
+        mesh.first_index = static_cast<uint32_t>(index_allocation->offset / index_size);
+        mesh.vertex_offset = static_cast<int32_t>(vertex_allocation->offset / source.vertex_size);
+        mesh.pulled_vertex_layout = vertex_arena->get_pulled_vertex_layout(mesh.vertex_buffer, source.vertex_size);
+        mesh.num_indices = source.num_indices;
+        mesh.bounding_sphere = source.bounding_sphere;
+        if(prepared.meshlet_mesh) {
+            mesh.meshlets = std::make_shared<const std::vector<Meshlet>>(std::move(prepared.meshlet_mesh->meshlets));
+        }
+        if(!lods.empty()) {
+            const auto first_lod_index = mesh.first_index + mesh.num_indices;
+            for(MeshLod& lod : lods) {
+                lod.first_index += first_lod_index;
+            }
+            lods.insert(lods.begin(), MeshLod{mesh.first_index, mesh.num_indices, std::numeric_limits<float>::max()});
+
+            mesh.lods = std::make_shared<const std::vector<MeshLod>>(std::move(lods));
+        }
+        mesh.vertex_data_offset = vertex_allocation->offset;
+        mesh.vertex_data_size = vertex_allocation->size;
+        mesh.index_data_offset = index_allocation->offset;
+        mesh.index_data_size = index_allocation->size;
+
+        meshes.emplace(new_mesh_id, mesh);
+
+        return true;
+    }
+
+    ProceduralMeshAccessor NovaRenderer::create_procedural_mesh(const uint64_t vertex_size, const uint64_t index_size) {
+        const MeshId our_id = next_mesh_id.fetch_add(1);
+
+        proc_meshes.emplace(our_id, ProceduralMesh{vertex_size, index_size, settings->max_in_flight_frames, device.get()});
+
+        return ProceduralMeshAccessor{&proc_meshes, our_id};
+    }
+
+    std::optional<Mesh> NovaRenderer::get_mesh(const MeshId mesh_id) {
+        if(const auto mesh_itr = meshes.find(mesh_id); mesh_itr != meshes.end()) {
+            return mesh_itr->second;
+
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    void NovaRenderer::destroy_mesh(const MeshId mesh_to_destroy) {
+        ZoneScoped;
+        const auto mesh_itr = meshes.find(mesh_to_destroy);
+        if(mesh_itr == meshes.end()) {
+            logger->error("Could not find a mesh with ID {}", mesh_to_destroy);
+            return;
+        }
+
+#ifdef NOVA_DEBUG
+        for(const auto& passes : passes_by_pipeline) {
+            for(const auto& pass : passes) {
+                const auto batch_itr = pass.static_mesh_batch_indices.find(mesh_to_destroy);
+                if(batch_itr != pass.static_mesh_batch_indices.end() && pass.static_mesh_draws[batch_itr->second].renderables.size() > 0) {
+                    logger->error("Destroying mesh {}, but material pass {}.{} still has renderables that use it",
+                                  mesh_to_destroy,
+                                  pass.name.material_name,
+                                  pass.name.pass_name);
+                }
+            }
+        }
+#endif
+
+        if(const auto evictable_itr = evictable_meshes.find(mesh_to_destroy); evictable_itr != evictable_meshes.end()) {
+            residency->remove_resource(evictable_itr->second);
+            evictable_meshes.erase(evictable_itr);
+        }
+
+        retired_meshes.push_back({mesh_itr->second, frame_count});
+        meshes.erase(mesh_itr);
+    }
+
+    void NovaRenderer::make_mesh_evictable(const MeshId mesh, const float priority, std::function<void(MeshId)> on_evicted) {
+        const auto mesh_itr = meshes.find(mesh);
+        if(mesh_itr == meshes.end()) {
+            logger->error("Could not find a mesh with ID {}", mesh);
+            return;
+        }
+
+        if(evictable_meshes.find(mesh) != evictable_meshes.end()) {
+            return;
+        }
+
+        const auto size = mesh_itr->second.vertex_data_size + mesh_itr->second.index_data_size;
+        const auto resource_id = residency->add_resource(size, priority, [this, mesh, on_evicted = std::move(on_evicted)] {
+            // The residency manager has already forgotten about the mesh
+            evictable_meshes.erase(mesh);
+            destroy_mesh(mesh);
+
+            if(on_evicted) {
+                on_evicted(mesh);
+            }
+        });
+
+        evictable_meshes.emplace(mesh, resource_id);
+    }
+
+    MeshId NovaRenderer::create_skinned_mesh(const SkinnedMeshData& mesh_data) {
+        ZoneScoped;
+        const MeshId new_mesh_id = next_mesh_id.fetch_add(1);
+        if(!is_scene_thread()) {
+            if(mesh_data.vertices == nullptr || mesh_data.skin_weights == nullptr || mesh_data.indices == nullptr) {
+                logger->error("Skinned meshes need vertices, skin weights, and indices");
+                return std::numeric_limits<MeshId>::max();
+            }
+
+            // The caller's arrays don't have to outlive this call, so the scene thread gets its own copy
+            queue_scene_command([this,
+                                 new_mesh_id,
+                                 mesh_data,
+                                 vertices = std::vector(mesh_data.vertices, mesh_data.vertices + mesh_data.num_vertices),
+                                 skin_weights = std::vector(mesh_data.skin_weights, mesh_data.skin_weights + mesh_data.num_vertices),
+                                 indices = std::vector(mesh_data.indices, mesh_data.indices + mesh_data.num_indices)] {
+                auto copied_data = mesh_data;
+                copied_data.vertices = vertices.data();
+                copied_data.skin_weights = skin_weights.data();
+                copied_data.indices = indices.data();
+                skinning->add_mesh(new_mesh_id, copied_data, *upload_batcher);
+            });
+
+            return new_mesh_id;
+        }
+
+        return skinning->add_mesh(new_mesh_id, mesh_data, *upload_batcher) ? new_mesh_id : std::numeric_limits<MeshId>::max();
+    }
+
+    void NovaRenderer::destroy_skinned_mesh(const MeshId mesh) {
+        if(!is_scene_thread()) {
+            queue_scene_command([this, mesh] { destroy_skinned_mesh(mesh); });
+            return;
+        }
+
+        skinning->remove_mesh(mesh);
+    }
+
+    void NovaRenderer::set_skinned_renderable_pose(const RenderableId renderable, const std::span<const glm::mat4> bone_matrices) {
+        if(!is_scene_thread()) {
+            queue_scene_command([this, renderable, bone_matrices = std::vector(bone_matrices.begin(), bone_matrices.end())] {
+                set_skinned_renderable_pose(renderable, bone_matrices);
+            });
+            return;
+        }
+
+        // The skinning dispatch reads the pose every frame, so the culling inputs don't need rebuilding
+        if(!skinning->set_pose(renderable, bone_matrices)) {
+            logger->error("Could not set the pose of skinned renderable {}", renderable);
+        }
+    }
+
+    std::optional<ChunkSectionPoolId> NovaRenderer::create_chunk_section_pool(const ChunkSectionPoolCreateInfo& create_info) {
+        if(create_info.num_vertex_attributes == 0 || create_info.vertex_size == 0) {
+            logger->error("Chunk section pools need vertices with at least one attribute");
+            return std::nullopt;
+        }
+
+        if(create_info.max_vertices_per_section == 0 || create_info.max_indices_per_section == 0) {
+            logger->error("Chunk section pools need room for at least one vertex and one index per section");
+            return std::nullopt;
+        }
+
+        const auto pool_id = static_cast<ChunkSectionPoolId>(chunk_section_pools.size());
+        chunk_section_pools.push_back(std::make_unique<ChunkSectionPool>(*vertex_arena, *index_arena, create_info));
+
+        return pool_id;
+    }
+
+    std::optional<ChunkSectionId> NovaRenderer::create_chunk_section(const ChunkSectionPoolId pool_id,
+                                                                     const MaterialPassKey& pass_key,
+                                                                     const StaticMeshRenderableUpdateData& transform) {
+        ZoneScoped;
+        if(pool_id >= chunk_section_pools.size()) {
+            logger->error("Could not find chunk section pool {}", pool_id);
+            return std::nullopt;
+        }
+
+        auto& pool = *chunk_section_pools[pool_id];
+
+        ChunkSection section;
+        section.pool = pool_id;
+        section.visible = transform.visible;
+
+        if(const auto recycled_mesh = pool.take_recycled_mesh()) {
+            section.mesh = *recycled_mesh;
+
+        } else {
+            section.mesh = next_mesh_id.fetch_add(1);
+
+            Mesh mesh;
+            mesh.num_vertex_attributes = pool.get_create_info().num_vertex_attributes;
+            meshes.emplace(section.mesh, mesh);
+        }
+
+        // The section is hidden until it has geometry
+        StaticMeshRenderableCreateInfo create_info;
+        static_cast<StaticMeshRenderableUpdateData&>(create_info) = transform;
+        create_info.visible = false;
+        create_info.mesh = section.mesh;
+
+        section.renderable = add_renderable_for_material(pass_key, create_info);
+        if(section.renderable == std::numeric_limits<RenderableId>::max()) {
+            logger->error("Could not add a chunk section to material pass {}.{}", pass_key.pipeline, pass_key.material_pass_index);
+            pool.recycle_mesh(section.mesh);
+            return std::nullopt;
+        }
+
+        const auto section_id = next_chunk_section_id;
+        next_chunk_section_id++;
+        chunk_sections.emplace(section_id, section);
+
+        return section_id;
+    }
+
+    void NovaRenderer::set_chunk_section_geometry(const ChunkSectionId section, const ChunkSectionGeometry& geometry) {
+        ZoneScoped;
+        const auto* vertices = static_cast<const uint8_t*>(geometry.vertex_data_ptr);
+
+        std::lock_guard lock{pending_chunk_geometry_mutex};
+
+        auto [pending_itr, is_new] = pending_chunk_geometry.try_emplace(section);
+        if(is_new) {
+            pending_chunk_geometry_order.push_back(section);
+        }
+
+        // Newer geometry replaces older geometry that hasn't been uploaded yet. Assigning reuses the old geometry's memory
+        auto& pending = pending_itr->second;
+        pending.section = section;
+        pending.vertex_data.assign(vertices, vertices + geometry.vertex_data_size);
+        pending.indices.assign(geometry.index_data_ptr, geometry.index_data_ptr + geometry.num_indices);
+        pending.aabb_min = geometry.aabb_min;
+        pending.aabb_max = geometry.aabb_max;
+    }
+
+    void NovaRenderer::set_chunk_sections_visible(const std::span<const ChunkSectionId> sections, const bool visible) {
+        ZoneScoped;
+        if(!is_scene_thread()) {
+            queue_scene_command([this, sections = std::vector(sections.begin(), sections.end()), visible] {
+                set_chunk_sections_visible(sections, visible);
+            });
+            return;
+        }
+
+        for(const ChunkSectionId section_id : sections) {
+            const auto section_itr = chunk_sections.find(section_id);
+            if(section_itr == chunk_sections.end()) {
+                logger->error("Could not find chunk section {}", section_id);
+                continue;
+            }
+
+            if(section_itr->second.visible != visible) {
+                section_itr->second.visible = visible;
+                update_chunk_section_visibility(section_itr->second);
+            }
+        }
+    }
+
+    void NovaRenderer::destroy_chunk_section(const ChunkSectionId section_id) {
+        ZoneScoped;
+        if(!is_scene_thread()) {
+            queue_scene_command([this, section_id] { destroy_chunk_section(section_id); });
+            return;
+        }
+
+        const auto section_itr = chunk_sections.find(section_id);
+        if(section_itr == chunk_sections.end()) {
+            logger->error("Could not find chunk section {}", section_id);
+            return;
+        }
+
+        const auto& section = section_itr->second;
+        auto& pool = *chunk_section_pools[section.pool];
+
+        remove_renderable(section.renderable);
+
+        // In-flight frames may still draw the old geometry, so its slot has to wait before another section can use it
+        auto& mesh = meshes.at(section.mesh);
+        if(section.has_slot) {
+            pool.retire_slot({mesh.vertex_buffer, mesh.vertex_data_offset, mesh.index_buffer, mesh.index_data_offset}, frame_count);
+        }
+
+        Mesh empty_mesh;
+        empty_mesh.num_vertex_attributes = mesh.num_vertex_attributes;
+        mesh = empty_mesh;
+
+        pool.recycle_mesh(section.mesh);
+        chunk_sections.erase(section_itr);
+
+        // Don't let geometry that's still waiting land on whichever section gets this mesh next
+        std::lock_guard lock{pending_chunk_geometry_mutex};
+        pending_chunk_geometry.erase(section_id);
+    }
+
+    std::optional<uint32_t> NovaRenderer::add_streamed_texture(StreamedTextureCreateInfo create_info) {
+        return texture_streamer->add_texture(std::move(create_info));
+    }
+
+    void NovaRenderer::remove_streamed_texture(const uint32_t texture_idx) { texture_streamer->remove_texture(texture_idx); }
+
+    void NovaRenderer::request_texture_resolution(const uint32_t texture_idx, const float screen_size) {
+        texture_streamer->request_resolution(texture_idx, screen_size);
+    }
+
+    std::optional<uint32_t> NovaRenderer::add_virtual_texture(VirtualTextureCreateInfo create_info) {
+        return virtual_textures->add_texture(std::move(create_info));
+    }
+
+    void NovaRenderer::remove_virtual_texture(const uint32_t virtual_texture_id) { virtual_textures->remove_texture(virtual_texture_id); }
+
+    std::optional<LightId> NovaRenderer::add_light(const PointLight& light) { return light_clustering->add_light(light); }
+
+    void NovaRenderer::update_light(const LightId light_id, const PointLight& light) { light_clustering->update_light(light_id, light); }
+
+    void NovaRenderer::remove_light(const LightId light_id) { light_clustering->remove_light(light_id); }
+
+    void NovaRenderer::set_particle_emitter(const std::string& emitter_name, const ParticleEmitterState& state) {
+        if(!is_scene_thread()) {
+            queue_scene_command([this, emitter_name, state] { set_particle_emitter(emitter_name, state); });
+            return;
+        }
+
+        particle_system->set_emitter_state(emitter_name, state);
+    }
+
+    void NovaRenderer::set_volumetric_medium(const VolumetricMedium& medium) {
+        if(!is_scene_thread()) {
+            queue_scene_command([this, medium] { set_volumetric_medium(medium); });
+            return;
+        }
+
+        volumetric_fog->set_medium(medium);
+    }
+
+    std::optional<FogVolumeId> NovaRenderer::add_fog_volume(const FogVolume& volume) { return volumetric_fog->add_fog_volume(volume); }
+
+    void NovaRenderer::update_fog_volume(const FogVolumeId volume_id, const FogVolume& volume) {
+        volumetric_fog->update_fog_volume(volume_id, volume);
+    }
+
+    void NovaRenderer::remove_fog_volume(const FogVolumeId volume_id) { volumetric_fog->remove_fog_volume(volume_id); }
+
+    std::future<std::optional<ReadbackData>> NovaRenderer::request_readback(rhi::RhiBuffer* buffer,
+                                                                             const mem::Bytes offset,
+                                                                             const mem::Bytes num_bytes) {
+        return readbacks->request_buffer_readback(buffer, offset, num_bytes);
+    }
+
+    std::future<std::optional<ReadbackData>> NovaRenderer::request_readback(const std::string& render_target_name,
+                                                                             const ImageReadbackRegion& region) {
+        return readbacks->request_render_target_readback(render_target_name, region);
+    }
+
+    const std::vector<rhi::RhiMemoryHeapBudget>& NovaRenderer::get_memory_budgets() const { return memory_budgets; }
+
+    std::vector<rhi::RhiMemoryPoolStats> NovaRenderer::get_memory_pool_stats() const { return device->get_memory_pool_stats(); }
+
+    MemoryReport NovaRenderer::get_memory_report() const {
+        ZoneScoped;
+        MemoryReport report;
+        report.heaps = memory_budgets;
+        report.pools = device->get_memory_pool_stats();
+        report.device = device->get_memory_accounting();
+
+        if(loaded_renderpack) {
+            report.renderpack = loaded_renderpack->name;
+            for(const rhi::RhiMemoryAllocationStats& owner : report.device.owners) {
+                if(owner.owner == report.renderpack) {
+                    report.renderpack_memory.push_back(owner);
+                }
+            }
+        }
+
+        if(device_resources) {
+            report.staging = device_resources->get_staging_memory_stats();
+        }
+
+        report.cpu_arenas.frame_arena_bytes = frame_arena->get_reserved_bytes();
+        report.cpu_arenas.escaped_frame_arena_bytes = frame_arena->get_num_escaped_bytes();
+        if(material_buffer) {
+            report.cpu_arenas.material_data_bytes = material_buffer->size();
+        }
+
+        return report;
+    }
+
+    const std::vector<GpuPassTiming>& NovaRenderer::get_frame_gpu_timings() const {
+        if(!gpu_profiler) {
+            static const std::vector<GpuPassTiming> no_timings;
+            return no_timings;
+        }
+
+        return gpu_profiler->get_latest_timings();
+    }
+
+    const std::vector<GpuPassStatistics>& NovaRenderer::get_frame_pipeline_statistics() const {
+        if(!gpu_profiler) {
+            static const std::vector<GpuPassStatistics> no_statistics;
+            return no_statistics;
+        }
+
+        return gpu_profiler->get_latest_pipeline_statistics();
+    }
+
+    std::vector<CpuPhaseTiming> NovaRenderer::get_cpu_phase_timings(const float seconds) const {
+        if(!cpu_timeline) {
+            return {};
+        }
+
+        return cpu_timeline->get_phase_timings(seconds);
+    }
+
+    bool NovaRenderer::write_cpu_trace(const std::filesystem::path& path) const {
+        if(!cpu_timeline) {
+            return false;
+        }
+
+        return CpuTimeline::write_chrome_trace(cpu_timeline->take_snapshot(settings->cpu_timeline.trace_seconds), path);
+    }
+
+    const rhi::RhiCommandListStats& NovaRenderer::get_frame_stats() const { return published_frame_stats; }
+
+    uint64_t NovaRenderer::get_frame_arena_escapes() const { return frame_arena->get_num_escaped_allocations(); }
+
+    float NovaRenderer::get_resolution_scale() const {
+        if(dynamic_resolution) {
+            return dynamic_resolution->get_scale();
+        }
+
+        return is_temporal_upscaling ? settings->temporal_upscaling.render_scale : 1.0f;
+    }
+
+    void NovaRenderer::set_temporal_upscaler(std::unique_ptr<TemporalUpscaler> upscaler) {
+        ZoneScoped;
+        wait_for_render_thread();
+        device->wait_for_fences(frame_fences);
+
+        if(temporal_upscaler) {
+            temporal_upscaler->destroy_resources(*device);
+        }
+        temporal_upscaler = upscaler ? std::move(upscaler) : std::make_unique<TemporalAccumulationUpscaler>();
+
+        // The pass refers to the old upscaler, so it has to be made again with the new one
+        if(is_temporal_upscaling && loaded_renderpack) {
+            const auto& passes = loaded_renderpack->graph_data.passes;
+            const auto pass_itr = std::find_if(passes.begin(), passes.end(), [](const renderpack::RenderPassCreateInfo& pass) {
+                return pass.name == TEMPORAL_UPSCALE_PASS_NAME;
+            });
+            if(pass_itr != passes.end()) {
+                create_temporal_upscale_renderpass(*pass_itr);
+            }
+        }
+    }
+
+    std::shared_future<void> NovaRenderer::load_renderpack(const std::string& renderpack_name) {
+        ZoneScoped;
+        auto data = take_preloaded_renderpack(renderpack_name);
+        if(!data) {
+            data = renderpack::load_renderpack_data(renderpack_name, *task_scheduler);
+        }
+        auto pipelines_compiled = replace_renderpack(std::move(*data));
+
+        if(settings->debug.enabled && settings->debug.renderpack_hot_reload.enabled) {
+            // Start watching after the renderpack is loaded, so the files we just read don't count as changed
+            if(const auto* folder_access = filesystem::VirtualFilesystem::get_instance()->get_folder_accessor(renderpack_name)) {
+                renderpack_watcher = std::make_unique<filesystem::FolderWatcher>(folder_access->get_root());
+                last_renderpack_poll_time = std::chrono::steady_clock::now();
+            }
+        }
+
+        logger->debug("Renderpack {} loaded successfully", renderpack_name);
+
+        return pipelines_compiled;
+    }
+
+    void NovaRenderer::start_renderpack_preload() {
+        ZoneScoped;
+        const std::string renderpack_name = settings->cache.loaded_renderpack;
+        if(filesystem::VirtualFilesystem::get_instance()->get_folder_accessor(renderpack_name) == nullptr) {
+            logger->debug("Renderpack {} doesn't exist, so it can't be preloaded", renderpack_name);
+            return;
+        }
+
+        preloaded_renderpack_name = renderpack_name;
+        // Not the shared pointer. If the task held the last reference, the scheduler would be destroyed on one of its own workers
+        preloaded_renderpack = task_scheduler->add_task([renderpack_name, scheduler = task_scheduler.get()](uint32_t /* thread_idx */) {
+            return renderpack::load_renderpack_data(renderpack_name, *scheduler);
+        });
+    }
+
+    std::optional<renderpack::RenderpackData> NovaRenderer::take_preloaded_renderpack(const std::string& renderpack_name) {
+        if(!preloaded_renderpack) {
+            return std::nullopt;
+        }
+
+        // Even if it's not the renderpack we want, it has to finish first. Loads share the shader include cache
+        ZoneScoped;
+        task_scheduler->wait_for(*preloaded_renderpack);
+        auto data = preloaded_renderpack->get();
+        preloaded_renderpack.reset();
+
+        if(preloaded_renderpack_name != renderpack_name) {
+            logger->debug("Preloaded renderpack {}, but renderpack {} was asked for", preloaded_renderpack_name, renderpack_name);
+            return std::nullopt;
+        }
+
+        return data;
+    }
+
+    std::shared_future<void> NovaRenderer::replace_renderpack(renderpack::RenderpackData data) {
+        ZoneScoped;
+        if(renderpacks_loaded) {
+            // The old renderpack's pipelines may still be compiling against its renderpasses
+            wait_for_pending_pipelines();
+
+            // Frames are pipelined, so the GPU may still be using the old renderpack's resources
+            device->wait_for_fences(frame_fences);
+
+            destroy_pipelines();
+
+            destroy_dynamic_resources();
+
+            destroy_renderpasses();
+            pipeline_aliases.clear();
+            command_streams.clear();
+            release_reusable_contents();
+            logger->debug("Resources from old renderpack destroyed");
+        }
+
+        // Before the builtin passes, which only use the formats they ask for
+        renderpack::resolve_render_target_precision(data, settings->render_target_precision, [&](const rhi::PixelFormat format) {
+            return device->supports_render_target_format(format);
+        });
+
+        const auto& builtin_passes = data.graph_data.builtin_passes;
+        if(std::find(builtin_passes.begin(), builtin_passes.end(), DEPTH_PYRAMID_PASS_NAME) != builtin_passes.end()) {
+            add_depth_pyramid_pass(data);
+        }
+
+        add_upsample_passes(data);
+        add_oit_passes(data);
+
+        const auto was_temporal_upscaling = is_temporal_upscaling;
+        is_temporal_upscaling = std::find(builtin_passes.begin(), builtin_passes.end(), TEMPORAL_UPSCALE_PASS_NAME) !=
+                                    builtin_passes.end() &&
+                                add_temporal_upscale_passes(data);
+        if(was_temporal_upscaling && !is_temporal_upscaling && temporal_upscaler) {
+            temporal_upscaler->destroy_resources(*device);
+        }
+
+        // After the temporal upscale passes, so that it can see their motion vectors
+        add_shading_rate_pass(data);
+
+        // Memory reports put the render targets of the builtin passes that the renderpack asked for on its tab too
+        for(renderpack::TextureCreateInfo& render_target : data.resources.render_targets) {
+            render_target.owner = data.name;
+        }
+
+        create_dynamic_textures(data.resources.render_targets, data.graph_data.passes);
+        logger->debug("Dynamic textures created");
+
+        create_render_passes(data.graph_data.passes, data.pipelines);
+
+        logger->debug("Created render passes");
+
+        // The backbuffer output pass shows the upscaled output instead of the scene output, or the other way around
+        if(is_temporal_upscaling != was_temporal_upscaling) {
+            create_builtin_renderpasses();
+        }
+
+        find_duplicate_pipelines(data.pipelines);
+
+        for(const renderpack::ParticleEmitterCreateInfo& emitter : data.resources.particle_emitters) {
+            const auto has_pass = std::any_of(data.materials.begin(), data.materials.end(), [&](const renderpack::MaterialData& material) {
+                return material.name == emitter.material &&
+                       std::any_of(material.passes.begin(), material.passes.end(), [&](const renderpack::MaterialPass& pass) {
+                           return pass.name == emitter.material_pass;
+                       });
+            });
+            if(!has_pass) {
+                logger->warn("Particle emitter {} wants to be drawn by pass {} of material {}, which the renderpack doesn't have",
+                             emitter.name,
+                             emitter.material_pass,
+                             emitter.material);
+            }
+        }
+
+        // The first renderpack may be loaded while frames are in flight, and they use the particle buffers even without any emitters
+        device->wait_for_fences(frame_fences);
+        particle_system->set_emitters(data.resources.particle_emitters);
+
+        auto pipelines_compiled = compile_pipelines(data.pipelines);
+
+        logger->debug("Started compiling pipelines");
+
+        loaded_renderpack = std::move(data);
+
+        renderpacks_loaded = true;
+
+        return pipelines_compiled;
+    }
+
+    static bool has_same_shader(const std::optional<renderpack::RenderpackShaderSource>& old_shader,
+                                const std::optional<renderpack::RenderpackShaderSource>& new_shader) {
+        if(old_shader.has_value() != new_shader.has_value()) {
+            return false;
+        }
+
+        return !old_shader || old_shader->source == new_shader->source;
+    }
+
+    static bool has_same_shaders(const renderpack::PipelineData& old_pipeline, const renderpack::PipelineData& new_pipeline) {
+        return old_pipeline.vertex_shader.source == new_pipeline.vertex_shader.source &&
+               has_same_shader(old_pipeline.geometry_shader, new_pipeline.geometry_shader) &&
+               has_same_shader(old_pipeline.tessellation_control_shader, new_pipeline.tessellation_control_shader) &&
+               has_same_shader(old_pipeline.tessellation_evaluation_shader, new_pipeline.tessellation_evaluation_shader) &&
+               has_same_shader(old_pipeline.fragment_shader, new_pipeline.fragment_shader);
+    }
+
+    void NovaRenderer::reload_changed_renderpack_files() {
+        const auto now = std::chrono::steady_clock::now();
+        if(!loaded_renderpack ||
+           now - last_renderpack_poll_time < std::chrono::milliseconds{settings->debug.renderpack_hot_reload.poll_interval_ms}) {
+            return;
+        }
+        last_renderpack_poll_time = now;
+
+        ZoneScoped;
+        const auto changed_files = renderpack_watcher->poll();
+        if(changed_files.empty()) {
+            return;
+        }
+
+        const auto renderpack_name = loaded_renderpack->name;
+        logger->info("{} files in renderpack {} changed, reloading it", changed_files.size(), renderpack_name);
+
+        auto data = renderpack::load_renderpack_data(renderpack_name, *task_scheduler);
+
+        // Zip archives are only ever rewritten whole, so we can't tell what inside them changed
+        const auto changes_structure = renderpack_watcher->is_watching_archive() ||
+                                       std::any_of(changed_files.begin(), changed_files.end(), [](const std::string& file) {
+                                           return file == RESOURCES_FILE || file == RENDERGRAPH_FILE;
+                                       });
+        if(changes_structure || !reload_pipelines_and_materials(data, changed_files)) {
+            logger->info("The structure of renderpack {} changed, so the whole renderpack has to be replaced", renderpack_name);
+            replace_renderpack(std::move(data));
+        }
+    }
+
+    bool NovaRenderer::reload_pipelines_and_materials(renderpack::RenderpackData& data, const std::vector<std::string>& changed_files) {
+        ZoneScoped;
+        const auto is_changed = [&](const std::string& file) {
+            return std::find(changed_files.begin(), changed_files.end(), file) != changed_files.end();
+        };
+
+        // Renderpasses know their pipelines by name, so adding, removing, or moving a pipeline means creating the renderpasses again
+        const auto& old_pipelines = loaded_renderpack->pipelines;
+        if(data.pipelines.size() != old_pipelines.size()) {
+            return false;
+        }
+
+        std::vector<renderpack::PipelineData> changed_pipelines;
+        for(const renderpack::PipelineData& new_pipeline : data.pipelines) {
+            const auto old_pipeline = std::find_if(old_pipelines.begin(),
+                                                   old_pipelines.end(),
+                                                   [&](const renderpack::PipelineData& pipeline) { return pipeline.name == new_pipeline.name; });
+            if(old_pipeline == old_pipelines.end() || old_pipeline->pass != new_pipeline.pass) {
+                return false;
+            }
+
+            if(is_changed(new_pipeline.source_file) || !has_same_shaders(*old_pipeline, new_pipeline)) {
+                // A changed pipeline may not be a duplicate anymore, or may have become one
+                if(!pipeline_aliases.empty()) {
+                    return false;
+                }
+
+                changed_pipelines.push_back(new_pipeline);
+            }
+        }
+
+        // Renderables live in their material passes, so we only add and update material passes, never remove them
+        const auto& old_materials = loaded_renderpack->materials;
+        for(const renderpack::MaterialData& old_material : old_materials) {
+            if(std::none_of(data.materials.begin(), data.materials.end(), [&](const renderpack::MaterialData& material) {
+                   return material.name == old_material.name;
+               })) {
+                return false;
+            }
+        }
+
+        std::unordered_set<std::string> pipelines_with_changed_materials;
+        for(const renderpack::MaterialData& new_material : data.materials) {
+            if(is_changed(fmt::format("{}/{}{}", MATERIALS_DIRECTORY, new_material.name, MATERIAL_FILE_EXTENSION))) {
+                for(const renderpack::MaterialPass& pass : new_material.passes) {
+                    pipelines_with_changed_materials.emplace(pass.pipeline);
+                }
+            }
+        }
+
+        // If an older compile of one of these pipelines finished after ours, it would replace our pipeline with a stale one
+        wait_for_pending_pipelines();
+        swap_in_compiled_pipelines();
+
+        loaded_renderpack->pipelines = std::move(data.pipelines);
+        loaded_renderpack->materials = std::move(data.materials);
+
+        // Recompiled pipelines get their materials when they're swapped in
+        for(const renderpack::PipelineData& pipeline : changed_pipelines) {
+            pipelines_with_changed_materials.erase(pipeline.name);
+        }
+
+        for(const std::string& pipeline_name : pipelines_with_changed_materials) {
+            const auto alias_itr = pipeline_aliases.find(pipeline_name);
+            if(auto* pipeline = find_pipeline(alias_itr != pipeline_aliases.end() ? alias_itr->second : pipeline_name)) {
+                create_materials_for_pipeline(*pipeline, loaded_renderpack->materials, pipeline_name);
+            }
+        }
+
+        if(!changed_pipelines.empty()) {
+            compile_pipelines(changed_pipelines);
+        }
+
+        logger->info("Recompiling {} pipelines and updated the materials of {} more",
+                     changed_pipelines.size(),
+                     pipelines_with_changed_materials.size());
+
+        return true;
+    }
+
+    const std::vector<MaterialPass>& NovaRenderer::get_material_passes_for_pipeline(const PipelineHandle pipeline) const {
+        return passes_by_pipeline[pipeline];
+    }
+
+    void NovaRenderer::set_renderpass_option(const std::string& option, const bool enabled) {
+        renderpass_options[option] = enabled;
+
+        if(!loaded_renderpack) {
+            return;
+        }
+
+        for(const renderpack::RenderPassCreateInfo& create_info : loaded_renderpack->graph_data.passes) {
+            if(create_info.enabled_by == option) {
+                rendergraph->set_renderpass_enabled(create_info.name, enabled);
+            }
+        }
+    }
+
+    bool NovaRenderer::is_renderpass_option_enabled(const std::string& option) const {
+        if(const auto itr = renderpass_options.find(option); itr != renderpass_options.end()) {
+            return itr->second;
+        }
+
+        if(const auto itr = settings->renderpass_options.find(option); itr != settings->renderpass_options.end()) {
+            return itr->second;
+        }
+
+        return true;
+    }
+
+    std::optional<RenderpassMetadata> NovaRenderer::get_renderpass_metadata(const std::string& renderpass_name) const {
+        return rendergraph->get_metadata_for_renderpass(renderpass_name);
+    }
+
+    void NovaRenderer::create_dynamic_textures(const std::vector<renderpack::TextureCreateInfo>& texture_create_infos,
+                                               const std::vector<renderpack::RenderPassCreateInfo>& pass_create_infos) {
+        ZoneScoped;
+        std::unordered_map<std::string, renderpack::TextureCreateInfo> textures_by_name;
+        for(const renderpack::TextureCreateInfo& create_info : texture_create_infos) {
+            textures_by_name.emplace(create_info.name, create_info);
+        }
+
+        // Figure out which render targets can share memory, based on when the passes will use them
+        const auto passes_in_order = rendergraph->predict_renderpass_execution_order(pass_create_infos);
+
+        std::unordered_map<std::string, renderpack::Range> texture_ranges;
+        std::vector<std::string> textures_in_order;
+        renderpack::determine_usage_order_of_textures(passes_in_order, texture_ranges, textures_in_order);
+
+        // Aliasing relies on the passes running one after another, but async compute passes overlap with the graphics passes around
+        // them. Their render targets get their own memory
+        auto aliasable_textures = textures_by_name;
+
+        // The backbuffer output pass reads the upscaled output after every renderpack pass, but it isn't in the list
+        aliasable_textures.erase(UPSCALED_OUTPUT_RT_NAME);
+        for(const renderpack::RenderPassCreateInfo& pass : pass_create_infos) {
+            // The shading rate pass runs after everything that the prediction knows about, and its output is for the next frame
+            if(pass.queue == rhi::QueueType::AsyncCompute || pass.name == SHADING_RATE_PASS_NAME) {
+                for(const std::string& input : pass.texture_inputs) {
+                    aliasable_textures.erase(input);
+                }
+                for(const renderpack::TextureAttachmentInfo& output : pass.texture_outputs) {
+                    aliasable_textures.erase(output.name);
+                }
+            }
+
+            // Cached and intermittent passes don't render every frame, so nothing else may write to their outputs in between
+            if(pass.keeps_outputs()) {
+                for(const renderpack::TextureAttachmentInfo& output : pass.texture_outputs) {
+                    aliasable_textures.erase(output.name);
+                }
+                if(pass.depth_texture) {
+                    aliasable_textures.erase(pass.depth_texture->name);
+                }
+            }
+        }
+
+        // Transient render targets never get real memory on tilers, so there's nothing to share
+        const auto transient_textures = renderpack::determine_transient_textures(passes_in_order, textures_by_name);
+        for(const std::string& texture_name : transient_textures) {
+            aliasable_textures.erase(texture_name);
+        }
+
+        const auto aliases = renderpack::determine_aliasing_of_textures(aliasable_textures, texture_ranges, textures_in_order);
+
+        std::unordered_map<std::string, std::vector<renderpack::TextureCreateInfo>> alias_groups;
+        for(const auto& [texture_name, group_name] : aliases) {
+            auto& group = alias_groups[group_name];
+            if(group.empty()) {
+                group.push_back(textures_by_name.at(group_name));
+            }
+            group.push_back(textures_by_name.at(texture_name));
+        }
+
+        std::unordered_set<std::string> aliased_textures;
+        for(const auto& [group_name, group] : alias_groups) {
+            ZoneScoped;
+            if(!device_resources->create_aliased_render_targets(group)) {
+                logger->warn("Could not alias the memory of render target {} and the render targets that share it. They'll each get "
+                             "their own memory",
+                             group_name);
+                continue;
+            }
+
+            for(const renderpack::TextureCreateInfo& create_info : group) {
+                aliased_textures.insert(create_info.name);
+                dynamic_texture_infos.emplace(create_info.name, create_info);
+            }
+
+            logger->debug("Render target {} shares its memory with {} other render targets", group_name, group.size() - 1);
+        }
+
+        // One submission for every render target's first layout transition, rather than one each
+        device_resources->begin_creation_batch();
+        for(const renderpack::TextureCreateInfo& create_info : texture_create_infos) {
+            ZoneScoped;
+            if(device_resources->get_render_target(create_info.name)) {
+                // Already created as part of an alias group
+                continue;
+            }
+
+            const auto size = create_info.format.get_size_in_pixels(device->get_swapchain()->get_size());
+            const auto is_transient = transient_textures.find(create_info.name) != transient_textures.end();
+
+            const auto render_target = device_resources->create_render_target(create_info.name,
+                                                                              size.x,
+                                                                              size.y,
+                                                                              create_info.format.pixel_format,
+                                                                              false,
+                                                                              is_transient,
+                                                                              create_info.format.num_layers,
+                                                                              create_info.num_mips,
+                                                                              create_info.owner);
+
+            auto& dynamic_info = dynamic_texture_infos.emplace(create_info.name, create_info).first->second;
+            if(is_transient) {
+                dynamic_info.usage = renderpack::ImageUsage::TransientRenderTarget;
+            }
+        }
+        device_resources->submit_creation_batch();
+
+        rendergraph->set_aliased_textures(std::move(aliased_textures));
+    }
+
+    void NovaRenderer::create_render_passes(const std::vector<renderpack::RenderPassCreateInfo>& pass_create_infos,
+                                            const std::vector<renderpack::PipelineData>& pipelines) {
+        ZoneScoped;
+        device->set_num_renderpasses(static_cast<uint32_t>(pass_create_infos.size()));
+
+        // Attachments that nothing reads afterwards don't have to be written out to memory, which tilers especially like
+        auto passes_in_order = rendergraph->predict_renderpass_execution_order(pass_create_infos);
+
+        std::unordered_map<std::string, renderpack::Range> texture_ranges;
+        std::vector<std::string> textures_in_order;
+        renderpack::determine_usage_order_of_textures(passes_in_order, texture_ranges, textures_in_order);
+        renderpack::determine_attachment_stores(passes_in_order, texture_ranges);
+
+        std::unordered_map<std::string, const renderpack::RenderPassCreateInfo*> inferred_create_infos;
+        for(const renderpack::RenderPassCreateInfo& create_info : passes_in_order) {
+            inferred_create_infos.emplace(create_info.name, &create_info);
+        }
+
+        for(const renderpack::RenderPassCreateInfo& pass_create_info : pass_create_infos) {
+            ZoneScoped;
+            // The execution order can't be predicted if the passes have a cycle, so they keep storing everything
+            const auto inferred_itr = inferred_create_infos.find(pass_create_info.name);
+            const auto& create_info = inferred_itr != inferred_create_infos.end() ? *inferred_itr->second : pass_create_info;
+
+            if(create_info.compute_shader) {
+                create_compute_renderpass(create_info);
+                continue;
+            }
+
+            auto* renderpass = new Renderpass(create_info.name);
+            if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) != nullptr) {
+                renderpass->uses_dynamic_resolution = can_use_dynamic_resolution(create_info);
+
+                if(!create_info.views.empty()) {
+                    // Shaders find view N's camera N slots after the first view's, so the views get their own run of slots
+                    if(const auto first_slot = camera_data->get_free_slots(static_cast<uint32_t>(create_info.views.size())); first_slot) {
+                        renderpass->first_view_camera = *first_slot;
+                        view_cameras.push_back({*first_slot, create_info.views});
+
+                    } else {
+                        logger->error("There aren't enough free camera slots for the {} views of renderpass {}",
+                                      create_info.views.size(),
+                                      create_info.name);
+                    }
+
+                    // Merged renderpasses don't know about views
+                    renderpass->can_merge_into_subpass = create_info.views.size() == 1;
+                }
+
+                // The swapchain image changes every frame, so there's nothing to keep
+                if(create_info.is_cached && !renderpass->writes_to_backbuffer) {
+                    renderpass->is_cached = true;
+
+                    // Skipping one subpass of a merged renderpass would skip them all
+                    renderpass->can_merge_into_subpass = false;
+                }
+
+                // The backbuffer's framebuffer is different every frame too
+                if(create_info.update_interval > 1 && !renderpass->writes_to_backbuffer) {
+                    renderpass->update_interval = create_info.update_interval;
+                    renderpass->can_merge_into_subpass = false;
+                }
+
+                // The shading rate is part of the renderpass, so passes with one can't share a renderpass with others
+                if(create_info.shading_rate || create_info.uses_adaptive_shading_rate) {
+                    renderpass->can_merge_into_subpass = false;
+                }
+
+                renderpass->uses_order_independent_transparency = create_info.uses_order_independent_transparency;
+
+                if(create_info.reuses_commands && !renderpass->writes_to_backbuffer) {
+                    renderpass->reuses_recorded_commands = true;
+                }
+
+                renderpass->is_enabled = create_info.enabled_by.empty() || is_renderpass_option_enabled(create_info.enabled_by);
+
+                if(create_info.has_depth_prepass) {
+                    if(create_info.depth_texture) {
+                        renderpass->has_depth_prepass = true;
+
+                    } else {
+                        logger->warn("Renderpass {} wants a depth prepass, but it doesn't have a depth texture", create_info.name);
+                    }
+                }
+
+                rhi::PipelineStage texture_read_stages{};
+                for(const renderpack::PipelineData& pipeline : pipelines) {
+                    if(pipeline.pass == create_info.name) {
+                        renderpass->pipeline_names.emplace_back(pipeline.name);
+                        renderpass->pipelines.push_back(get_pipeline_handle(pipeline.name));
+
+                        if(const auto pipeline_state = to_pipeline_state_create_info(pipeline, *rendergraph); pipeline_state) {
+                            texture_read_stages = texture_read_stages | get_texture_read_stages(*pipeline_state);
+                        }
+                    }
+                }
+
+                // Without any reflection data, assume that the pixel shader samples the textures
+                if(texture_read_stages != rhi::PipelineStage{}) {
+                    renderpass->texture_read_stages = texture_read_stages;
+                }
+            } else {
+                logger->error("Could not create renderpass %s", create_info.name);
+            }
+        }
+    }
+
+    void NovaRenderer::create_compute_renderpass(const renderpack::RenderPassCreateInfo& create_info) const {
+        ZoneScoped;
+        if(create_info.name == DEPTH_PYRAMID_PASS_NAME) {
+            create_depth_pyramid_renderpass(create_info);
+            return;
+        }
+
+        if(create_info.name.starts_with(BILATERAL_UPSAMPLE_PASS_PREFIX)) {
+            create_upsample_renderpass(create_info);
+            return;
+        }
+
+        if(create_info.name.starts_with(OIT_COMPOSITE_PASS_PREFIX)) {
+            create_oit_composite_renderpass(create_info);
+            return;
+        }
+
+        if(create_info.name == TEMPORAL_UPSCALE_PASS_NAME) {
+            create_temporal_upscale_renderpass(create_info);
+            return;
+        }
+
+        if(create_info.name == CAMERA_MOTION_VECTORS_PASS_NAME) {
+            create_camera_motion_vectors_renderpass(create_info);
+            return;
+        }
+
+        if(create_info.name == SHADING_RATE_PASS_NAME) {
+            create_shading_rate_renderpass(create_info);
+            return;
+        }
+
+        if(create_info.compute_shader->source.empty()) {
+            logger->error("Could not create compute renderpass {} because its shader {} didn't compile",
+                          create_info.name,
+                          create_info.compute_shader->filename);
+            return;
+        }
+
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = create_info.name;
+        pipeline_state.compute_shader = {create_info.compute_shader->filename, create_info.compute_shader->source};
+        specialize_shader(pipeline_state.compute_shader, settings->specialization_constants);
+
+        auto pipeline = device->create_compute_pipeline(pipeline_state);
+        if(!pipeline) {
+            logger->error("Could not create the pipeline for compute renderpass {}", create_info.name);
+            return;
+        }
+
+        // One thread per pixel of the first output. Passes that only read get one thread per pixel of their first input
+        glm::uvec2 dispatch_size{1};
+        const auto& sized_texture_name = !create_info.texture_outputs.empty() ? create_info.texture_outputs.front().name :
+                                         !create_info.texture_inputs.empty()  ? create_info.texture_inputs.front() :
+                                                                                std::string{};
+        if(const auto render_target = device_resources->get_render_target(sized_texture_name); render_target) {
+            dispatch_size = {static_cast<uint32_t>((*render_target)->width), static_cast<uint32_t>((*render_target)->height)};
+        }
+
+        const auto workgroup_size = get_workgroup_size(pipeline_state.compute_shader.source);
+        const glm::uvec3 num_groups{(dispatch_size.x + workgroup_size.x - 1) / workgroup_size.x,
+                                    (dispatch_size.y + workgroup_size.y - 1) / workgroup_size.y,
+                                    1};
+
+        auto* renderpass = new ComputeRenderpass(create_info.name, std::move(pipeline), num_groups, *device);
+        renderpass->is_enabled = create_info.enabled_by.empty() || is_renderpass_option_enabled(create_info.enabled_by);
+        renderpass->update_interval = create_info.update_interval;
+
+        // The shader's bindings are named after the textures they use
+        auto& binder = renderpass->get_resource_binder();
+        for(const auto& [binding_name, binding] : get_all_descriptors(pipeline_state)) {
+            if(binding.type == rhi::DescriptorType::Sampler) {
+                binder.bind_sampler(binding_name, point_sampler);
+
+            } else if(const auto render_target = device_resources->get_render_target(binding_name); render_target) {
+                binder.bind_image(binding_name, (*render_target)->image);
+
+            } else if(const auto texture = device_resources->get_texture(binding_name); texture) {
+                binder.bind_image(binding_name, (*texture)->image);
+
+            } else {
+                logger->warn("Compute renderpass {} uses resource {}, but there's no texture with that name",
+                             create_info.name,
+                             binding_name);
+            }
+        }
+
+        if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) == nullptr) {
+            logger->error("Could not create renderpass {}", create_info.name);
+        }
+    }
+
+    const renderpack::TextureAttachmentInfo* NovaRenderer::find_scene_depth_texture(const renderpack::RenderpackData& data) {
+        const auto& passes = data.graph_data.passes;
+        auto depth_pass = std::find_if(passes.begin(), passes.end(), [](const renderpack::RenderPassCreateInfo& pass) {
+            return pass.has_depth_prepass && pass.depth_texture;
+        });
+        if(depth_pass == passes.end()) {
+            depth_pass = std::find_if(passes.begin(), passes.end(), [](const renderpack::RenderPassCreateInfo& pass) {
+                return !pass.is_compute_pass() && pass.depth_texture && pass.views.empty();
+            });
+        }
+
+        return depth_pass != passes.end() ? &*depth_pass->depth_texture : nullptr;
+    }
+
+    void NovaRenderer::add_depth_pyramid_pass(renderpack::RenderpackData& data) {
+        ZoneScoped;
+        const auto* depth_texture = find_scene_depth_texture(data);
+        if(depth_texture == nullptr) {
+            logger->warn("Renderpack {} wants a depth pyramid, but none of its passes write depth", data.name);
+            return;
+        }
+
+        auto create_info = DepthPyramidRenderpass::get_create_info(depth_texture->name, device->info);
+        if(!create_info) {
+            return;
+        }
+
+        data.resources.render_targets.emplace_back(DepthPyramidRenderpass::get_pyramid_create_info());
+        data.graph_data.passes.emplace_back(std::move(*create_info));
+
+        if(depth_pyramid_counter == nullptr) {
+            depth_pyramid_counter = device->create_buffer(
+                {"NovaDepthPyramidCounter", sizeof(uint32_t), rhi::BufferUsage::StorageBuffer});
+
+            constexpr uint32_t ZERO = 0;
+            device->write_data_to_buffer(&ZERO, sizeof(ZERO), depth_pyramid_counter);
+        }
+    }
+
+    void NovaRenderer::create_depth_pyramid_renderpass(const renderpack::RenderPassCreateInfo& create_info) const {
+        ZoneScoped;
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = create_info.name;
+        pipeline_state.compute_shader = {create_info.compute_shader->filename, create_info.compute_shader->source};
+
+        auto pipeline = device->create_compute_pipeline(pipeline_state);
+        if(!pipeline) {
+            logger->error("Could not create the depth pyramid's pipeline");
+            return;
+        }
+
+        const auto depth = device_resources->get_render_target(create_info.texture_inputs.front());
+        const auto pyramid = device_resources->get_render_target(HI_Z_RT_NAME);
+        if(!depth || !pyramid) {
+            logger->error("Could not find the textures of the depth pyramid");
+            return;
+        }
+
+        auto* renderpass = new DepthPyramidRenderpass(std::move(pipeline),
+                                                      (*depth)->image,
+                                                      (*pyramid)->image,
+                                                      {static_cast<uint32_t>((*pyramid)->width), static_cast<uint32_t>((*pyramid)->height)},
+                                                      depth_pyramid_counter,
+                                                      *device);
+        if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) == nullptr) {
+            logger->error("Could not create renderpass {}", create_info.name);
+        }
+    }
+
+    void NovaRenderer::add_upsample_passes(renderpack::RenderpackData& data) const {
+        ZoneScoped;
+        std::vector<renderpack::RenderPassCreateInfo> upsample_passes;
+        for(const renderpack::RenderPassCreateInfo& pass : data.graph_data.passes) {
+            for(const renderpack::UpsampledOutput& output : pass.upsampled_outputs) {
+                const auto& render_targets = data.resources.render_targets;
+                const auto destination = std::find_if(render_targets.begin(), render_targets.end(), [&](const auto& texture) {
+                    return texture.name == output.destination;
+                });
+                if(destination == render_targets.end()) {
+                    logger->error("Renderpass {} upsamples {} into {}, but renderpack {} doesn't have a render target named {}",
+                                  pass.name,
+                                  output.source,
+                                  output.destination,
+                                  data.name,
+                                  output.destination);
+                    continue;
+                }
+
+                if(auto create_info = BilateralUpsampleRenderpass::get_create_info(output, destination->format.pixel_format); create_info) {
+                    upsample_passes.emplace_back(std::move(*create_info));
+                }
+            }
+        }
+
+        // The rendergraph puts them after the passes that write their sources, wherever they are in the list
+        data.graph_data.passes.insert(data.graph_data.passes.end(),
+                                      std::make_move_iterator(upsample_passes.begin()),
+                                      std::make_move_iterator(upsample_passes.end()));
+    }
+
+    void NovaRenderer::create_upsample_renderpass(const renderpack::RenderPassCreateInfo& create_info) const {
+        ZoneScoped;
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = create_info.name;
+        pipeline_state.compute_shader = {create_info.compute_shader->filename, create_info.compute_shader->source};
+
+        auto pipeline = device->create_compute_pipeline(pipeline_state);
+        if(!pipeline) {
+            logger->error("Could not create the pipeline of upsample pass {}", create_info.name);
+            return;
+        }
+
+        const auto source = device_resources->get_render_target(create_info.texture_inputs[0]);
+        const auto depth = device_resources->get_render_target(create_info.texture_inputs[1]);
+        const auto destination = device_resources->get_render_target(create_info.texture_outputs.front().name);
+        if(!source || !depth || !destination) {
+            logger->error("Could not find the textures of upsample pass {}", create_info.name);
+            return;
+        }
+
+        auto* renderpass = new BilateralUpsampleRenderpass(
+            create_info.name,
+            std::move(pipeline),
+            (*source)->image,
+            (*depth)->image,
+            (*destination)->image,
+            {static_cast<uint32_t>((*destination)->width), static_cast<uint32_t>((*destination)->height)},
+            *device);
+        if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) == nullptr) {
+            logger->error("Could not create renderpass {}", create_info.name);
+        }
+    }
+
+    void NovaRenderer::add_oit_passes(renderpack::RenderpackData& data) const {
+        ZoneScoped;
+        auto& render_targets = data.resources.render_targets;
+
+        std::vector<renderpack::RenderPassCreateInfo> passes;
+        passes.reserve(data.graph_data.passes.size());
+        for(renderpack::RenderPassCreateInfo& pass : data.graph_data.passes) {
+            if(!pass.uses_order_independent_transparency || pass.compute_shader) {
+                passes.emplace_back(std::move(pass));
+                continue;
+            }
+
+            if(pass.texture_outputs.size() != 1 || pass.texture_outputs.front().clear ||
+               pass.texture_outputs.front().name == BACKBUFFER_NAME) {
+                logger->error("Renderpass {} wants order-independent transparency, so it needs exactly one color output, which it doesn't "
+                              "clear and which isn't the backbuffer. Drawing it without",
+                              pass.name);
+                pass.uses_order_independent_transparency = false;
+                passes.emplace_back(std::move(pass));
+                continue;
+            }
+
+            const auto destination_name = pass.texture_outputs.front().name;
+            renderpack::TextureFormat format{.pixel_format = rhi::PixelFormat::Rgba8,
+                                             .dimension_type = renderpack::TextureDimensionType::ScreenRelative,
+                                             .width = 1,
+                                             .height = 1};
+            if(destination_name != SCENE_OUTPUT_RT_NAME) {
+                const auto destination = std::find_if(render_targets.begin(), render_targets.end(), [&](const auto& texture) {
+                    return texture.name == destination_name;
+                });
+                if(destination == render_targets.end()) {
+                    logger->error("Renderpass {} writes to {}, but renderpack {} doesn't have a render target named {}",
+                                  pass.name,
+                                  destination_name,
+                                  data.name,
+                                  destination_name);
+                    passes.emplace_back(std::move(pass));
+                    continue;
+                }
+
+                format = destination->format;
+            }
+
+            auto composite_create_info = OitCompositeRenderpass::get_create_info(pass.name, destination_name, format.pixel_format);
+            if(!composite_create_info) {
+                pass.uses_order_independent_transparency = false;
+                passes.emplace_back(std::move(pass));
+                continue;
+            }
+
+            // Weighted colors add up past one, so the accumulation texture needs the range of a float
+            const auto accumulation_name = std::string{OIT_ACCUMULATION_RT_PREFIX} + pass.name;
+            const auto coverage_name = std::string{OIT_COVERAGE_RT_PREFIX} + pass.name;
+            auto accumulation_format = format;
+            accumulation_format.pixel_format = rhi::PixelFormat::Rgba16F;
+            auto coverage_format = format;
+            coverage_format.pixel_format = rhi::PixelFormat::Rgba8;
+            render_targets.push_back(
+                {.name = accumulation_name, .usage = renderpack::ImageUsage::RenderTarget, .format = accumulation_format});
+            render_targets.push_back({.name = coverage_name, .usage = renderpack::ImageUsage::RenderTarget, .format = coverage_format});
+
+            pass.texture_outputs.clear();
+            pass.texture_outputs.emplace_back(accumulation_name, rhi::PixelFormat::Rgba16F, true);
+            pass.texture_outputs.emplace_back(coverage_name, rhi::PixelFormat::Rgba8, true);
+
+            // Right after the pass, so that passes listed after it that load the destination see the transparency
+            passes.emplace_back(std::move(pass));
+            passes.emplace_back(std::move(*composite_create_info));
+        }
+
+        data.graph_data.passes = std::move(passes);
+    }
+
+    void NovaRenderer::create_oit_composite_renderpass(const renderpack::RenderPassCreateInfo& create_info) const {
+        ZoneScoped;
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = create_info.name;
+        pipeline_state.compute_shader = {create_info.compute_shader->filename, create_info.compute_shader->source};
+
+        auto pipeline = device->create_compute_pipeline(pipeline_state);
+        if(!pipeline) {
+            logger->error("Could not create the pipeline of order-independent transparency composite pass {}", create_info.name);
+            return;
+        }
+
+        const auto accumulation = device_resources->get_render_target(create_info.texture_inputs[0]);
+        const auto coverage = device_resources->get_render_target(create_info.texture_inputs[1]);
+        const auto destination = device_resources->get_render_target(create_info.texture_outputs.front().name);
+        if(!accumulation || !coverage || !destination) {
+            logger->error("Could not find the textures of order-independent transparency composite pass {}", create_info.name);
+            return;
+        }
+
+        auto* renderpass = new OitCompositeRenderpass(
+            create_info.name,
+            std::move(pipeline),
+            (*accumulation)->image,
+            (*coverage)->image,
+            (*destination)->image,
+            {static_cast<uint32_t>((*destination)->width), static_cast<uint32_t>((*destination)->height)},
+            *device);
+        if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) == nullptr) {
+            logger->error("Could not create renderpass {}", create_info.name);
+        }
+    }
+
+    bool NovaRenderer::add_temporal_upscale_passes(renderpack::RenderpackData& data) {
+        ZoneScoped;
+        const auto* depth_texture = find_scene_depth_texture(data);
+        if(depth_texture == nullptr) {
+            logger->warn("Renderpack {} wants the temporal upscaler, but none of its passes write depth", data.name);
+            return false;
+        }
+        const auto depth_texture_name = depth_texture->name;
+
+        auto& passes = data.graph_data.passes;
+        const auto writes_motion_vectors = std::any_of(passes.begin(), passes.end(), [](const renderpack::RenderPassCreateInfo& pass) {
+            return std::find_if(pass.texture_outputs.begin(), pass.texture_outputs.end(), [](const auto& output) {
+                       return output.name == MOTION_VECTORS_RT_NAME;
+                   }) != pass.texture_outputs.end();
+        });
+        if(!writes_motion_vectors) {
+            auto motion_vectors_create_info = CameraMotionVectorsRenderpass::get_create_info(depth_texture_name);
+            if(!motion_vectors_create_info) {
+                return false;
+            }
+
+            passes.emplace_back(std::move(*motion_vectors_create_info));
+        }
+
+        auto& render_targets = data.resources.render_targets;
+        const auto declares_motion_vectors = std::any_of(render_targets.begin(), render_targets.end(), [](const auto& texture) {
+            return texture.name == MOTION_VECTORS_RT_NAME;
+        });
+        if(!declares_motion_vectors) {
+            render_targets.emplace_back(CameraMotionVectorsRenderpass::get_motion_vectors_create_info());
+        }
+
+        render_targets.emplace_back(TemporalUpscaleRenderpass::get_output_create_info());
+        passes.emplace_back(TemporalUpscaleRenderpass::get_create_info(depth_texture_name));
+
+        if(!temporal_upscaler) {
+            temporal_upscaler = std::make_unique<TemporalAccumulationUpscaler>();
+        }
+
+        return true;
+    }
+
+    void NovaRenderer::create_temporal_upscale_renderpass(const renderpack::RenderPassCreateInfo& create_info) const {
+        ZoneScoped;
+        const auto color = device_resources->get_render_target(SCENE_OUTPUT_RT_NAME);
+        const auto depth = device_resources->get_render_target(create_info.texture_inputs[1]);
+        const auto motion_vectors = device_resources->get_render_target(MOTION_VECTORS_RT_NAME);
+        const auto output = device_resources->get_render_target(UPSCALED_OUTPUT_RT_NAME);
+        if(!color || !depth || !motion_vectors || !output) {
+            logger->error("Could not find the textures of the temporal upscale pass");
+            return;
+        }
+
+        const glm::uvec2 input_size{static_cast<uint32_t>((*color)->width), static_cast<uint32_t>((*color)->height)};
+        const glm::uvec2 output_size{static_cast<uint32_t>((*output)->width), static_cast<uint32_t>((*output)->height)};
+
+        // This runs again when the window is resized, and the upscaler's history has to match the new size
+        temporal_upscaler->destroy_resources(*device);
+        if(!temporal_upscaler->create_resources(*device, output_size)) {
+            logger->error("Could not create the temporal upscaler's resources");
+            return;
+        }
+
+        TemporalUpscaleInputs inputs{};
+        inputs.color = (*color)->image;
+        inputs.depth = (*depth)->image;
+        inputs.motion_vectors = (*motion_vectors)->image;
+        inputs.output = (*output)->image;
+        inputs.input_size = input_size;
+        inputs.output_size = output_size;
+
+        auto* renderpass = new TemporalUpscaleRenderpass(*temporal_upscaler, inputs);
+        if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) == nullptr) {
+            logger->error("Could not create renderpass {}", create_info.name);
+        }
+    }
+
+    void NovaRenderer::create_camera_motion_vectors_renderpass(const renderpack::RenderPassCreateInfo& create_info) const {
+        ZoneScoped;
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = create_info.name;
+        pipeline_state.compute_shader = {create_info.compute_shader->filename, create_info.compute_shader->source};
+
+        auto pipeline = device->create_compute_pipeline(pipeline_state);
+        if(!pipeline) {
+            logger->error("Could not create the camera motion vectors' pipeline");
+            return;
+        }
+
+        const auto depth = device_resources->get_render_target(create_info.texture_inputs.front());
+        const auto motion_vectors = device_resources->get_render_target(MOTION_VECTORS_RT_NAME);
+        if(!depth || !motion_vectors) {
+            logger->error("Could not find the textures of the camera motion vectors pass");
+            return;
+        }
+
+        auto* renderpass = new CameraMotionVectorsRenderpass(
+            std::move(pipeline),
+            (*depth)->image,
+            (*motion_vectors)->image,
+            {static_cast<uint32_t>((*motion_vectors)->width), static_cast<uint32_t>((*motion_vectors)->height)},
+            *device);
+        if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) == nullptr) {
+            logger->error("Could not create renderpass {}", create_info.name);
+        }
+    }
+
+    void NovaRenderer::add_shading_rate_pass(renderpack::RenderpackData& data) const {
+        ZoneScoped;
+        auto& passes = data.graph_data.passes;
+        const auto uses_adaptive_shading_rate = std::any_of(passes.begin(), passes.end(), [](const renderpack::RenderPassCreateInfo& pass) {
+            return pass.uses_adaptive_shading_rate;
+        });
+        if(!uses_adaptive_shading_rate || !settings->variable_rate_shading.enabled) {
+            return;
+        }
+
+        const auto texel_size = device->info.shading_rate_image_texel_size;
+        if(texel_size == 0) {
+            logger->info("Renderpack {} has passes with an adaptive shading rate, but the device can't read a shading rate image",
+                         data.name);
+            return;
+        }
+
+        const auto reads_motion_vectors = std::any_of(passes.begin(), passes.end(), [](const renderpack::RenderPassCreateInfo& pass) {
+            return std::find_if(pass.texture_outputs.begin(), pass.texture_outputs.end(), [](const auto& output) {
+                       return output.name == MOTION_VECTORS_RT_NAME;
+                   }) != pass.texture_outputs.end();
+        });
+        auto create_info = ShadingRateRenderpass::get_create_info(reads_motion_vectors);
+        if(!create_info) {
+            return;
+        }
+
+        passes.emplace_back(std::move(*create_info));
+        data.resources.render_targets.emplace_back(
+            ShadingRateRenderpass::get_shading_rate_image_create_info(swapchain->get_size(), texel_size));
+    }
+
+    void NovaRenderer::create_shading_rate_renderpass(const renderpack::RenderPassCreateInfo& create_info) const {
+        ZoneScoped;
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = create_info.name;
+        pipeline_state.compute_shader = {create_info.compute_shader->filename, create_info.compute_shader->source};
+
+        auto pipeline = device->create_compute_pipeline(pipeline_state);
+        if(!pipeline) {
+            logger->error("Could not create the shading rate pass' pipeline");
+            return;
+        }
+
+        const auto scene_output = device_resources->get_render_target(SCENE_OUTPUT_RT_NAME);
+        const auto shading_rate_image = device_resources->get_render_target(SHADING_RATE_RT_NAME);
+        if(!scene_output || !shading_rate_image) {
+            logger->error("Could not find the textures of the shading rate pass");
+            return;
+        }
+
+        std::optional<rhi::RhiImage*> motion_vectors;
+        if(create_info.texture_inputs.size() > 1) {
+            if(const auto motion_vectors_texture = device_resources->get_render_target(MOTION_VECTORS_RT_NAME); motion_vectors_texture) {
+                motion_vectors = (*motion_vectors_texture)->image;
+            }
+        }
+
+        auto* renderpass = new ShadingRateRenderpass(
+            std::move(pipeline),
+            (*scene_output)->image,
+            motion_vectors,
+            (*shading_rate_image)->image,
+            {static_cast<uint32_t>((*scene_output)->width), static_cast<uint32_t>((*scene_output)->height)},
+            device->info.shading_rate_image_texel_size,
+            settings->variable_rate_shading,
+            *device);
+        if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) == nullptr) {
+            logger->error("Could not create renderpass {}", create_info.name);
+        }
+    }
+
+    std::optional<RhiGraphicsPipelineState> NovaRenderer::make_pipeline_state(const renderpack::PipelineData& pipeline_data) const {
+        auto pipeline_state = to_pipeline_state_create_info(pipeline_data, *rendergraph);
+        if(!pipeline_state) {
+            return std::nullopt;
+        }
+
+        // Weighted-blended transparency adds into the accumulation texture and covers the coverage texture, which come out the same in
+        // any order. Transparent surfaces can't hide each other, so they mustn't write depth either
+        if(const auto* renderpass = rendergraph->get_renderpass(pipeline_data.pass);
+           renderpass != nullptr && renderpass->uses_order_independent_transparency) {
+            const RenderTargetBlendState accumulation_blend{.enable = true,
+                                                            .src_color_factor = BlendFactor::One,
+                                                            .dst_color_factor = BlendFactor::One,
+                                                            .src_alpha_factor = BlendFactor::One,
+                                                            .dst_alpha_factor = BlendFactor::One};
+            const RenderTargetBlendState coverage_blend{.enable = true,
+                                                        .src_color_factor = BlendFactor::One,
+                                                        .dst_color_factor = BlendFactor::OneMinusSrcAlpha,
+                                                        .src_alpha_factor = BlendFactor::One,
+                                                        .dst_alpha_factor = BlendFactor::OneMinusSrcAlpha};
+            pipeline_state->blend_state = BlendState{.render_target_states = {accumulation_blend, coverage_blend}};
+
+            if(pipeline_state->depth_state) {
+                pipeline_state->depth_state->enable_depth_write = false;
+            }
+        }
+
+        const auto& overrides = settings->specialization_constants;
+        if(overrides.empty()) {
+            specialize_shaders(*pipeline_state, pipeline_data.specialization_constants);
+
+        } else {
+            auto values = pipeline_data.specialization_constants;
+            for(const auto& [name, value] : overrides) {
+                values.insert_or_assign(name, value);
+            }
+            specialize_shaders(*pipeline_state, values);
+        }
+
+        return pipeline_state;
+    }
+
+    /*!
+     * \brief Makes a key that two pipelines only share if they'd compile to the same pipeline and draw the same way. Names and source
+     * files don't count
+     */
+    static std::string make_pipeline_state_key(const renderpack::PipelineData& data, const RhiGraphicsPipelineState& state) {
+        std::string key;
+        const auto add = [&]<typename ValueType>(const ValueType& value) {
+            if constexpr(std::is_same_v<ValueType, std::string>) {
+                key += value;
+                key.push_back('\0');
+
+            } else {
+                static_assert(std::is_trivially_copyable_v<ValueType>);
+                key.append(reinterpret_cast<const char*>(&value), sizeof(ValueType));
+            }
+        };
+        const auto add_shader = [&](const ShaderSource* shader) {
+            add(shader != nullptr);
+            if(shader != nullptr) {
+                add(ShaderReflectionCache::make_key(shader->source));
+                add(shader->specialization_constants.size());
+                for(const SpecializationConstant& constant : shader->specialization_constants) {
+                    add(constant.constant_id);
+                    add(constant.value);
+                }
+            }
+        };
+        const auto add_attachment = [&](const renderpack::TextureAttachmentInfo& attachment) {
+            add(attachment.name);
+            add(attachment.pixel_format);
+            add(attachment.clear);
+            add(attachment.store);
+        };
+        const auto add_stencil_op = [&](const StencilOpState& op) {
+            add(op.fail_op);
+            add(op.pass_op);
+            add(op.depth_fail_op);
+            add(op.compare_op);
+            add(op.compare_mask);
+            add(op.write_mask);
+            add(op.reference_value);
+        };
+
+        // Variants are compiled from the renderpack's data, and the render queue decides the draw order
+        add(data.pass);
+        add(data.render_queue);
+        add(data.keyword_axes.size());
+        for(const renderpack::ShaderKeywordAxis& axis : data.keyword_axes) {
+            add(axis.name);
+            add(axis.keywords.size());
+            for(const std::string& keyword : axis.keywords) {
+                add(keyword);
+            }
+        }
+
+        add_shader(&state.vertex_shader);
+        add_shader(state.geometry_shader ? &*state.geometry_shader : nullptr);
+        add_shader(state.pixel_shader ? &*state.pixel_shader : nullptr);
+
+        add(state.vertex_fields.size());
+        for(const rhi::RhiVertexField& field : state.vertex_fields) {
+            add(field.name);
+            add(field.format);
+        }
+
+        add(state.viewport_size);
+        add(state.enable_scissor_test);
+        add(state.topology);
+
+        const auto& rasterizer = state.rasterizer_state;
+        add(rasterizer.enable_depth_clamping);
+        add(rasterizer.fill_mode);
+        add(rasterizer.cull_mode);
+        add(rasterizer.depth_bias);
+        add(rasterizer.slope_scaled_depth_bias);
+        add(rasterizer.maximum_depth_bias);
+
+        add(state.multisampling_state.has_value());
+
+        add(state.depth_state.has_value());
+        if(state.depth_state) {
+            add(state.depth_state->enable_depth_write);
+            add(state.depth_state->compare_op);
+            add(state.depth_state->bounds_test_state.has_value());
+            if(const auto& bounds = state.depth_state->bounds_test_state) {
+                add(bounds->mode);
+                if(bounds->mode == DepthBoundsTestMode::Static) {
+                    add(bounds->static_state.min_bound);
+                    add(bounds->static_state.max_bound);
+                }
+            }
+        }
+
+        add(state.stencil_state.has_value());
+        if(state.stencil_state) {
+            add_stencil_op(state.stencil_state->front_face_op);
+            add_stencil_op(state.stencil_state->back_face_op);
+        }
+
+        add(state.blend_state.has_value());
+        if(state.blend_state) {
+            add(state.blend_state->blend_constants);
+            add(state.blend_state->render_target_states.size());
+            for(const RenderTargetBlendState& target : state.blend_state->render_target_states) {
+                add(target.enable);
+                add(target.src_color_factor);
+                add(target.dst_color_factor);
+                add(target.color_op);
+                add(target.src_alpha_factor);
+                add(target.dst_alpha_factor);
+                add(target.alpha_op);
+            }
+        }
+
+        add(state.enable_color_write);
+        add(state.enable_alpha_write);
+
+        add(state.color_attachments.size());
+        for(const renderpack::TextureAttachmentInfo& attachment : state.color_attachments) {
+            add_attachment(attachment);
+        }
+
+        add(state.depth_texture.has_value());
+        if(state.depth_texture) {
+            add_attachment(*state.depth_texture);
+        }
+
+        return key;
+    }
+
+    void NovaRenderer::find_duplicate_pipelines(const std::vector<renderpack::PipelineData>& pipeline_create_infos) {
+        ZoneScoped;
+        std::unordered_map<std::string, std::string> pipelines_by_key;
+        for(const renderpack::PipelineData& pipeline_data : pipeline_create_infos) {
+            const auto pipeline_state = make_pipeline_state(pipeline_data);
+            if(!pipeline_state) {
+                continue;
+            }
+
+            const auto [itr, is_new] = pipelines_by_key.try_emplace(make_pipeline_state_key(pipeline_data, *pipeline_state),
+                                                                     pipeline_data.name);
+            if(is_new) {
+                continue;
+            }
+
+            logger->debug("Pipeline {} is the same as pipeline {}, so it won't be compiled separately", pipeline_data.name, itr->second);
+            pipeline_aliases.emplace(pipeline_data.name, itr->second);
+
+            if(auto* renderpass = rendergraph->get_renderpass(pipeline_data.pass)) {
+                std::erase(renderpass->pipelines, get_pipeline_handle(pipeline_data.name));
+                std::erase(renderpass->pipeline_names, pipeline_data.name);
+            }
+        }
+
+        if(!pipeline_aliases.empty()) {
+            logger->info("{} of the renderpack's {} pipelines are duplicates", pipeline_aliases.size(), pipeline_create_infos.size());
+        }
+    }
+
+    std::shared_future<void> NovaRenderer::compile_pipelines(const std::vector<renderpack::PipelineData>& pipeline_create_infos) {
+        ZoneScoped;
+        pending_pipelines.reserve(pipeline_create_infos.size());
+
+        // Whichever compile task finishes last fulfills the promise
+        auto all_compiled = std::make_shared<std::promise<void>>();
+        auto num_remaining = std::make_shared<std::atomic<uint32_t>>(static_cast<uint32_t>(pipeline_create_infos.size()) + 1);
+
+        const auto finish_one = [all_compiled, num_remaining] {
+            if(num_remaining->fetch_sub(1) == 1) {
+                all_compiled->set_value();
+            }
+        };
+
+        // Merging renderpasses changes which renderpass and subpass the pipelines are used in
+        rendergraph->compile(*device_resources);
+
+        for(const renderpack::PipelineData& rp_pipeline_state : pipeline_create_infos) {
+            if(pipeline_aliases.contains(rp_pipeline_state.name)) {
+                finish_one();
+
+            } else if(auto pending = start_compiling_pipeline(rp_pipeline_state, {}, finish_one)) {
+                pending_pipelines.emplace_back(std::move(*pending));
+
+            } else {
+                finish_one();
+            }
+        }
+
+        // The extra count keeps the promise from being fulfilled before all the tasks are queued
+        finish_one();
+
+        return all_compiled->get_future().share();
+    }
+
+    std::optional<NovaRenderer::PendingPipeline> NovaRenderer::start_compiling_pipeline(const renderpack::PipelineData& rp_pipeline_state,
+                                                                                        const std::vector<std::string>& variant_keywords,
+                                                                                        std::function<void()> on_compiled) {
+        ZoneScoped;
+        auto pipeline_state = make_pipeline_state(rp_pipeline_state);
+        const auto* renderpass = rendergraph->get_renderpass(rp_pipeline_state.pass);
+        if(!pipeline_state || renderpass == nullptr) {
+            logger->error("Could not create pipeline {}", rp_pipeline_state.name);
+            return std::nullopt;
+        }
+
+        if(!variant_keywords.empty()) {
+            // Name variants after their keywords, so the logs and graphics debuggers can tell them apart
+            pipeline_state->name += "[";
+            for(uint32_t i = 0; i < variant_keywords.size(); i++) {
+                pipeline_state->name += i == 0 ? variant_keywords[i] : fmt::format(",{}", variant_keywords[i]);
+            }
+            pipeline_state->name += "]";
+        }
+
+        // TODO: A way for renderpack pipelines to say if they're global or surface pipelines
+        Pipeline pipeline;
+        std::unique_ptr<rhi::RhiPipeline> occlusion_box_pipeline;
+        pipeline.pipeline = device->create_surface_pipeline(*pipeline_state);
+        pipeline.handle = get_pipeline_handle(rp_pipeline_state.name);
+        pipeline.pulls_vertices = rp_pipeline_state.vertex_layout == renderpack::RPVertexLayout::Pulled;
+        if(pipeline_state->blend_state && !renderpass->uses_order_independent_transparency) {
+            const auto& targets = pipeline_state->blend_state->render_target_states;
+            pipeline.is_transparent = std::any_of(targets.begin(), targets.end(), [](const RenderTargetBlendState& target) {
+                return target.enable;
+            });
+        }
+
+        if(renderpass->has_depth_prepass && !pipeline.is_transparent && pipeline_state->depth_state &&
+           pipeline_state->depth_state->enable_depth_write) {
+            auto prepass_state = *pipeline_state;
+            prepass_state.name = fmt::format("{}_DepthPrepass", pipeline_state->name);
+            prepass_state.enable_color_write = false;
+            prepass_state.enable_alpha_write = false;
+            if(prepass_state.pixel_shader && !pixel_shader_affects_depth(prepass_state.pixel_shader->source)) {
+                prepass_state.pixel_shader.reset();
+            }
+            pipeline.depth_prepass_pipeline = device->create_surface_pipeline(prepass_state);
+
+            // Both pipelines run the same vertex shader on the same vertices, so they come up with exactly the same depth
+            auto shading_state = *pipeline_state;
+            shading_state.depth_state->compare_op = rhi::CompareOp::Equal;
+            shading_state.depth_state->enable_depth_write = false;
+            pipeline.pipeline = device->create_surface_pipeline(shading_state);
+
+            // The first pipeline of a renderpass to get here builds the renderpass's occlusion query boxes, since it knows what the
+            // renderpass's attachments look like
+            if(occlusion_queries) {
+                if(const auto box_state = occlusion_queries->claim_pipeline(*renderpass, prepass_state)) {
+                    occlusion_box_pipeline = device->create_surface_pipeline(*box_state);
+                }
+            }
+        }
+
+        // The pipeline objects live on the heap, so they stay put when the PendingPipeline is moved
+        auto compiled = task_scheduler->add_task(
+            [this,
+             rhi_pipeline = pipeline.pipeline.get(),
+             rhi_prepass_pipeline = pipeline.depth_prepass_pipeline.get(),
+             occlusion_box_pipeline = std::move(occlusion_box_pipeline),
+             renderpass,
+             rhi_renderpass = renderpass->get_renderpass(),
+             subpass = renderpass->get_subpass_index(),
+             on_compiled = std::move(on_compiled)](uint32_t /* thread_idx */) mutable {
+                auto success = device->compile_pipeline(*rhi_pipeline, *rhi_renderpass, subpass);
+                if(success && rhi_prepass_pipeline != nullptr) {
+                    success = device->compile_pipeline(*rhi_prepass_pipeline, *rhi_renderpass, subpass);
+                }
+                if(occlusion_box_pipeline) {
+                    // The renderpass draws fine without its boxes, so failing to compile them doesn't fail the pipeline
+                    if(!device->compile_pipeline(*occlusion_box_pipeline, *rhi_renderpass, subpass)) {
+                        occlusion_box_pipeline.reset();
+                    }
+                    occlusion_queries->set_pipeline(*renderpass, std::move(occlusion_box_pipeline), rhi_renderpass, subpass);
+                }
+                if(on_compiled) {
+                    on_compiled();
+                }
+                return success;
+            });
+
+        return PendingPipeline{std::move(pipeline), std::move(compiled)};
+    }
+
+    void NovaRenderer::swap_in_compiled_pipelines() {
+        ZoneScoped;
+        const auto first_pending = std::partition(pending_pipelines.begin(), pending_pipelines.end(), [](const PendingPipeline& pending) {
+            return pending.compiled.wait_for(std::chrono::seconds{0}) != std::future_status::ready;
+        });
+
+        std::for_each(first_pending, pending_pipelines.end(), [&](PendingPipeline& pending) {
+            const auto& pipeline_name = pending.pipeline.pipeline->name;
+            if(!pending.compiled.get()) {
+                // compile_pipeline already logged the details
+                return;
+            }
+
+            auto& current_pipeline = pipelines[pending.pipeline.handle];
+            if(current_pipeline.pipeline) {
+                // This is a recompiled pipeline. Frames that are still in flight may have recorded the old one
+                retired_pipelines.push_back(RetiredPipeline{std::move(current_pipeline), frame_count});
+            }
+
+            current_pipeline = std::move(pending.pipeline);
+            pipeline_scene_versions[current_pipeline.handle]++;
+
+            // Materials are only created once their pipeline is ready, so a material pass never refers to a pipeline that isn't
+            create_materials_for_pipeline(current_pipeline, loaded_renderpack->materials, pipeline_name);
+            for(const auto& [alias, canonical_name] : pipeline_aliases) {
+                if(canonical_name == pipeline_name) {
+                    create_materials_for_pipeline(current_pipeline, loaded_renderpack->materials, alias);
+                }
+            }
+
+            logger->debug("Pipeline {} is ready", pipeline_name);
+        });
+
+        pending_pipelines.erase(first_pending, pending_pipelines.end());
+
+        swap_in_compiled_pipeline_variants();
+    }
+
+    std::optional<uint32_t> NovaRenderer::get_pipeline_variant(Pipeline& pipeline,
+                                                              const renderpack::PipelineData& pipeline_data,
+                                                              const std::vector<std::string>& requested_keywords) {
+        for(const std::string& keyword : requested_keywords) {
+            const auto is_on_axis = std::any_of(pipeline_data.keyword_axes.begin(),
+                                                pipeline_data.keyword_axes.end(),
+                                                [&](const renderpack::ShaderKeywordAxis& axis) {
+                                                    return std::find(axis.keywords.begin(), axis.keywords.end(), keyword) !=
+                                                           axis.keywords.end();
+                                                });
+            if(!is_on_axis) {
+                logger->warn("Pipeline {} doesn't have a keyword {}, ignoring it", pipeline_data.name, keyword);
+            }
+        }
+
+        auto variant_keywords = renderpack::get_variant_keywords(pipeline_data, requested_keywords);
+        if(variant_keywords == renderpack::get_default_variant_keywords(pipeline_data)) {
+            return std::nullopt;
+        }
+
+        const auto variant_itr = std::find_if(pipeline.variants.begin(), pipeline.variants.end(), [&](const PipelineVariant& variant) {
+            return variant.keywords == variant_keywords;
+        });
+        if(variant_itr != pipeline.variants.end()) {
+            return static_cast<uint32_t>(variant_itr - pipeline.variants.begin());
+        }
+
+        const auto variant_idx = static_cast<uint32_t>(pipeline.variants.size());
+        pipeline.variants.emplace_back().keywords = variant_keywords;
+
+        auto* folder_access = filesystem::VirtualFilesystem::get_instance()->get_folder_accessor(loaded_renderpack->name);
+        if(folder_access == nullptr) {
+            logger->error("Can't compile a variant of pipeline {} without renderpack {}'s shaders. Using its default variant instead",
+                          pipeline_data.name,
+                          loaded_renderpack->name);
+            return variant_idx;
+        }
+
+        PendingPipelineVariant pending;
+        pending.pipeline = pipeline.handle;
+        pending.variant_idx = variant_idx;
+        pending.base_pipeline = pipeline.pipeline.get();
+        pending.shaders = task_scheduler->add_task(
+            [pipeline_data, variant_keywords, folder_access](uint32_t /* thread_idx */) {
+                return renderpack::load_pipeline_variant(pipeline_data, variant_keywords, folder_access);
+            });
+        pending.keywords = std::move(variant_keywords);
+
+        pending_pipeline_variants.push_back(std::move(pending));
+
+        return variant_idx;
+    }
+
+    void NovaRenderer::swap_in_compiled_pipeline_variants() {
+        ZoneScoped;
+        std::erase_if(pending_pipeline_variants, [&](PendingPipelineVariant& pending) {
+            // A recompiled pipeline starts over with no variants, and its material passes ask for them again
+            const auto& pipeline = pipelines[pending.pipeline];
+            const auto is_stale = pipeline.pipeline.get() != pending.base_pipeline || pending.variant_idx >= pipeline.variants.size();
+
+            if(!pending.compiling) {
+                if(pending.shaders.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                    return false;
+                }
+
+                // load_pipeline_variant already logged why the shaders didn't compile
+                const auto variant_data = pending.shaders.get();
+                if(!variant_data || is_stale) {
+                    return true;
+                }
+
+                // Creating the RHI pipelines needs the rendergraph, so it has to happen here, between frames
+                pending.compiling = start_compiling_pipeline(*variant_data, pending.keywords, {});
+                return !pending.compiling;
+            }
+
+            if(pending.compiling->compiled.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                return false;
+            }
+
+            if(!pending.compiling->compiled.get() || is_stale) {
+                return true;
+            }
+
+            auto& variant = pipelines[pending.pipeline].variants[pending.variant_idx];
+            variant.pipeline = std::move(pending.compiling->pipeline.pipeline);
+            variant.depth_prepass_pipeline = std::move(pending.compiling->pipeline.depth_prepass_pipeline);
+            pipeline_scene_versions[pending.pipeline]++;
+
+            logger->debug("Pipeline variant {} is ready", variant.pipeline->name);
+
+            return true;
+        });
+    }
+
+    void NovaRenderer::wait_for_pending_pipelines() const {
+        for(const PendingPipeline& pending : pending_pipelines) {
+            pending.compiled.wait();
+        }
+
+        for(const PendingPipelineVariant& pending : pending_pipeline_variants) {
+            if(pending.compiling) {
+                pending.compiling->compiled.wait();
+
+            } else {
+                pending.shaders.wait();
+            }
+        }
+    }
+
+    void NovaRenderer::free_retired_meshes() {
+        // Same reasoning as the retired pipelines
+        std::erase_if(retired_meshes, [&](const RetiredMesh& retired) {
+            if(frame_count - retired.retired_frame < settings->max_in_flight_frames) {
+                return false;
+            }
+
+            const auto& mesh = retired.mesh;
+            vertex_arena->free({mesh.vertex_buffer, mesh.vertex_data_offset, mesh.vertex_data_size});
+            index_arena->free({mesh.index_buffer, mesh.index_data_offset, mesh.index_data_size});
+
+            return true;
+        });
+    }
+
+    /*!
+     * \brief Copies everything a mesh batch needs to know about its mesh into the batch, leaving its renderables alone
+     */
+    static void set_mesh_batch_mesh(MeshBatch& batch, const MeshId mesh_id, const Mesh& mesh) {
+        batch.mesh = mesh_id;
+        batch.num_vertex_attributes = mesh.num_vertex_attributes;
+        batch.num_indices = mesh.num_indices;
+        batch.vertex_buffer = mesh.vertex_buffer;
+        batch.index_buffer = mesh.index_buffer;
+        batch.index_type = mesh.index_type;
+        batch.first_index = mesh.first_index;
+        batch.vertex_offset = mesh.vertex_offset;
+        batch.pulled_vertex_layout = mesh.pulled_vertex_layout;
+        batch.bounding_sphere = mesh.bounding_sphere;
+        batch.meshlets = mesh.meshlets;
+        batch.lods = mesh.lods;
+    }
+
+    void NovaRenderer::apply_pending_chunk_geometry() {
+        ZoneScoped;
+        {
+            std::lock_guard lock{pending_chunk_geometry_mutex};
+
+            const auto max_updates = settings->uploads.max_chunk_section_updates_per_frame;
+            while(!pending_chunk_geometry_order.empty() && chunk_geometry_scratch.size() < max_updates) {
+                // Sections that were destroyed while their geometry was waiting are still in line, but not in the map
+                auto pending_node = pending_chunk_geometry.extract(pending_chunk_geometry_order.front());
+                pending_chunk_geometry_order.pop_front();
+                if(pending_node) {
+                    chunk_geometry_scratch.push_back(std::move(pending_node.mapped()));
+                }
+            }
+        }
+
+        // Uploading doesn't need the lock, so worker threads can keep handing us geometry in the meantime
+        for(PendingChunkSectionGeometry& geometry : chunk_geometry_scratch) {
+            apply_chunk_section_geometry(geometry);
+        }
+
+        chunk_geometry_scratch.clear();
+    }
+
+    void NovaRenderer::apply_chunk_section_geometry(PendingChunkSectionGeometry& geometry) {
+        const auto section_itr = chunk_sections.find(geometry.section);
+        if(section_itr == chunk_sections.end()) {
+            return;
+        }
+
+        auto& section = section_itr->second;
+        auto& pool = *chunk_section_pools[section.pool];
+        const auto& pool_info = pool.get_create_info();
+
+        const auto num_vertices = geometry.vertex_data.size() / pool_info.vertex_size;
+        if(geometry.vertex_data.size() % pool_info.vertex_size != 0 || num_vertices > pool_info.max_vertices_per_section ||
+           geometry.indices.size() > pool_info.max_indices_per_section) {
+            logger->error("Chunk section {} has {} bytes of vertex data and {} indices, which don't fit in a slot of pool {}",
+                          geometry.section,
+                          geometry.vertex_data.size(),
+                          geometry.indices.size(),
+                          section.pool);
+            return;
+        }
+
+        // Sections with nothing to draw don't need a slot
+        std::optional<ChunkSectionPool::Slot> slot;
+        if(!geometry.indices.empty()) {
+            slot = pool.allocate_slot();
+            if(!slot) {
+                logger->error("Chunk section pool {} is out of slots, chunk section {} keeps its old geometry",
+                              section.pool,
+                              geometry.section);
+                return;
+            }
+
+            upload_batcher->upload_to_buffer(slot->vertex_buffer,
+                                             slot->vertex_offset,
+                                             geometry.vertex_data.data(),
+                                             geometry.vertex_data.size(),
+                                             rhi::ResourceAccess::VertexAttributeRead,
+                                             rhi::PipelineStage::VertexInput);
+            upload_batcher->upload_to_buffer(slot->index_buffer,
+                                             slot->index_offset,
+                                             geometry.indices.data(),
+                                             geometry.indices.size() * sizeof(uint32_t),
+                                             rhi::ResourceAccess::IndexRead,
+                                             rhi::PipelineStage::VertexInput);
+        }
+
+        // The new geometry goes in a different slot, so frames that are still in flight keep drawing the old geometry from the old one
+        auto& mesh = meshes.at(section.mesh);
+        if(section.has_slot) {
+            pool.retire_slot({mesh.vertex_buffer, mesh.vertex_data_offset, mesh.index_buffer, mesh.index_data_offset}, frame_count);
+        }
+
+        Mesh new_mesh;
+        new_mesh.num_vertex_attributes = pool_info.num_vertex_attributes;
+        if(slot) {
+            // Culling wants a sphere, so the box becomes the sphere around it
+            const auto center = (geometry.aabb_min + geometry.aabb_max) * 0.5f;
+            const auto radius = glm::length(geometry.aabb_max - geometry.aabb_min) * 0.5f;
+
+            new_mesh.vertex_buffer = slot->vertex_buffer;
+            new_mesh.index_buffer = slot->index_buffer;
+            new_mesh.first_index = static_cast<uint32_t>(slot->index_offset / sizeof(uint32_t));
+            new_mesh.vertex_offset = static_cast<int32_t>(slot->vertex_offset / pool_info.vertex_size);
+            new_mesh.pulled_vertex_layout = vertex_arena->get_pulled_vertex_layout(new_mesh.vertex_buffer, pool_info.vertex_size);
+            new_mesh.num_indices = static_cast<uint32_t>(geometry.indices.size());
+            new_mesh.bounding_sphere = glm::vec4{center, radius};
+            new_mesh.vertex_data_offset = slot->vertex_offset;
+            new_mesh.vertex_data_size = pool.get_slot_vertex_size();
+            new_mesh.index_data_offset = slot->index_offset;
+            new_mesh.index_data_size = pool.get_slot_index_size();
+        }
+
+        mesh = new_mesh;
+        section.has_slot = slot.has_value();
+
+        // Batches copy their mesh's data when they're made, so the section's batch needs the new data too
+        const auto& key = renderable_keys.at(section.renderable);
+        set_mesh_batch_mesh(get_mesh_batch(key), section.mesh, mesh);
+
+        update_chunk_section_visibility(section);
+    }
+
+    void NovaRenderer::update_chunk_section_visibility(const ChunkSection& section) {
+        const auto& key = renderable_keys.at(section.renderable);
+        const bool has_geometry = meshes.at(section.mesh).num_indices > 0;
+
+        get_renderable_columns(key).visibilities[key.renderable_idx] = section.visible && has_geometry ? 1 : 0;
+        pipeline_scene_versions[key.pipeline]++;
+
+        // New geometry comes with new bounds, so this covers both
+        update_occlusion_bounds(section.renderable, key);
+    }
+
+    void NovaRenderer::update_residency() {
+        ZoneScoped;
+        memory_budgets = device->get_memory_budgets();
+
+        // A mesh with renderables may be drawn at any moment, so it counts as used even when it's culled
+        if(!evictable_meshes.empty()) {
+            for(const auto& passes : passes_by_pipeline) {
+                for(const auto& pass : passes) {
+                    for(const MeshBatch& batch : pass.static_mesh_draws) {
+                        if(batch.renderables.size() == 0) {
+                            continue;
+                        }
+
+                        if(const auto itr = evictable_meshes.find(batch.mesh); itr != evictable_meshes.end()) {
+                            residency->mark_used(itr->second);
+                        }
+                    }
+                }
+            }
+        }
+
+        residency->begin_frame(memory_budgets);
+    }
+
+    void NovaRenderer::destroy_retired_pipelines() {
+        // We just waited for the frame that used this slot last, so every frame that started before the retired frame is done
+        std::erase_if(retired_pipelines, [&](const RetiredPipeline& retired) {
+            return frame_count - retired.retired_frame >= settings->max_in_flight_frames;
+        });
+    }
+
+    /*!
+     * \brief Everything that makes a material pass draw differently from other material passes of the same pipeline
+     */
+    static std::string make_material_pass_signature(const renderpack::MaterialPass& pass_data, const std::optional<uint32_t> variant_idx) {
+        std::string signature = variant_idx ? std::to_string(*variant_idx) : std::string{};
+        signature.push_back('\0');
+
+        // The bindings are in a hash map, so they're sorted to come out the same for every material that has them
+        std::vector<std::pair<std::string, std::string>> bindings{pass_data.bindings.begin(), pass_data.bindings.end()};
+        std::sort(bindings.begin(), bindings.end());
+        for(const auto& [descriptor, resource] : bindings) {
+            signature += descriptor;
+            signature.push_back('\0');
+            signature += resource;
+            signature.push_back('\0');
+        }
+
+        return signature;
+    }
+
+    void NovaRenderer::create_materials_for_pipeline(Pipeline& pipeline,
+                                                     const std::vector<renderpack::MaterialData>& materials,
+                                                     const std::string& pipeline_name) {
+        ZoneScoped; // Determine the pipeline layout so the material can create descriptors for the pipeline
+
+        const auto& rp_pipelines = loaded_renderpack->pipelines;
+        const auto pipeline_data = std::find_if(rp_pipelines.begin(), rp_pipelines.end(), [&](const renderpack::PipelineData& data) {
+            return data.name == pipeline_name;
+        });
+
+        MaterialPassKey template_key = {};
+        template_key.pipeline = pipeline.handle;
+
+        auto& passes = passes_by_pipeline[pipeline.handle];
+        auto& passes_by_signature = material_passes_by_signature[pipeline.handle];
+        pipeline_scene_versions[pipeline.handle]++;
+
+        uint32_t num_duplicates = 0;
+
+        for(const renderpack::MaterialData& material_data : materials) {
+            for(const renderpack::MaterialPass& pass_data : material_data.passes) {
+                if(pass_data.pipeline == pipeline_name) {
+                    const auto& event_name = fmt::format("{}.{}", material_data.name, pass_data.name);
+                    ZoneScoped;
+                    const FullMaterialPassName full_pass_name{pass_data.material_name, pass_data.name};
+
+                    MaterialPassMetadata pass_metadata{};
+                    pass_metadata.data = pass_data;
+                    material_metadatas.insert_or_assign(full_pass_name, pass_metadata);
+
+                    const auto variant_idx = pipeline_data != rp_pipelines.end() ?
+                                                 get_pipeline_variant(pipeline, *pipeline_data, pass_data.keywords) :
+                                                 std::nullopt;
+
+                    // A reloaded pipeline keeps its material passes, along with all the renderables that were added to them
+                    if(const auto key_itr = material_pass_keys.find(full_pass_name);
+                       key_itr != material_pass_keys.end() && key_itr->second.pipeline == pipeline.handle &&
+                       key_itr->second.material_pass_index < passes.size()) {
+                        auto& existing_pass = passes[key_itr->second.material_pass_index];
+                        existing_pass.pipeline_interface = pipeline.pipeline_interface;
+                        existing_pass.is_transparent = pipeline.is_transparent;
+                        existing_pass.has_depth_prepass = pipeline.depth_prepass_pipeline != nullptr;
+                        existing_pass.pulls_vertices = pipeline.pulls_vertices;
+                        existing_pass.pipeline_variant_idx = variant_idx;
+                        continue;
+                    }
+
+                    // Materials that only differ by name share a material pass
+                    const auto [signature_itr, is_new_signature] = passes_by_signature.try_emplace(
+                        make_material_pass_signature(pass_data, variant_idx),
+                        static_cast<uint32_t>(passes.size()));
+                    if(!is_new_signature) {
+                        material_pass_keys.insert_or_assign(full_pass_name, MaterialPassKey{pipeline.handle, signature_itr->second});
+                        num_duplicates++;
+                        continue;
+                    }
+
+                    MaterialPass pass = {};
+                    pass.pipeline_interface = pipeline.pipeline_interface;
+                    pass.is_transparent = pipeline.is_transparent;
+                    pass.has_depth_prepass = pipeline.depth_prepass_pipeline != nullptr;
+                    pass.pulls_vertices = pipeline.pulls_vertices;
+                    pass.pipeline_variant_idx = variant_idx;
+                    pass.name = full_pass_name;
+
+                    MaterialPassKey key = template_key;
+                    key.material_pass_index = static_cast<uint32_t>(passes.size());
+
+                    material_pass_keys.insert_or_assign(full_pass_name, key);
+
+                    passes.push_back(pass);
+                }
+            }
+        }
+
+        if(num_duplicates > 0) {
+            logger->info("{} material passes of pipeline {} are duplicates, so they share material passes", num_duplicates, pipeline_name);
+        }
+    }
+
+    static void mix_into_cache_key(uint64_t& key, const uint64_t value) {
+        key ^= value + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2);
+    }
+
+    static void mix_camera_into_cache_key(uint64_t& key, const Camera& cam) {
+        for(const float value : {cam.position.x,
+                                 cam.position.y,
+                                 cam.position.z,
+                                 cam.rotation.x,
+                                 cam.rotation.y,
+                                 cam.rotation.z,
+                                 cam.field_of_view,
+                                 cam.aspect_ratio,
+                                 cam.near_plane,
+                                 cam.far_plane}) {
+            mix_into_cache_key(key, std::bit_cast<uint32_t>(value));
+        }
+    }
+
+    void NovaRenderer::update_renderpass_cache_keys(const float resolution_scale) {
+        ZoneScoped;
+        if(!loaded_renderpack) {
+            return;
+        }
+
+        for(const renderpack::RenderPassCreateInfo& create_info : loaded_renderpack->graph_data.passes) {
+            auto* renderpass = rendergraph->get_renderpass(create_info.name);
+            if(renderpass == nullptr) {
+                continue;
+            }
+
+            // Each pass starts its interval on a different frame, so passes with the same interval spread out instead of all rendering
+            // on the same frame
+            const auto interval = renderpass->update_interval;
+            renderpass->is_update_frame = interval <= 1 || (frame_count + renderpass->id) % interval == 0;
+
+            if(!renderpass->is_cached) {
+                continue;
+            }
+
+            uint64_t key = 0;
+            mix_scene_into_cache_key(key, *renderpass);
+
+            // Everything is culled against the first camera, and it picks the LODs, so it changes what gets drawn even in passes that
+            // render with other cameras
+            if(!frame_cameras.empty()) {
+                mix_camera_into_cache_key(key, frame_cameras[0]);
+            }
+
+            for(const std::string& view : create_info.views) {
+                const auto camera_itr = std::find_if(frame_cameras.begin(), frame_cameras.end(), [&](const Camera& cam) {
+                    return cam.get_name() == view;
+                });
+                if(camera_itr != frame_cameras.end()) {
+                    mix_camera_into_cache_key(key, *camera_itr);
+                }
+            }
+
+            if(renderpass->uses_dynamic_resolution) {
+                mix_into_cache_key(key, std::bit_cast<uint32_t>(resolution_scale));
+            }
+
+            // Any shader may read the lights and the fog
+            mix_into_cache_key(key, light_clustering->get_lights_version());
+            mix_into_cache_key(key, volumetric_fog->get_version());
+
+            // Particles move every frame, so passes that draw them are never the same twice
+            if(draws_particles(*renderpass)) {
+                mix_into_cache_key(key, frame_count);
+            }
+
+            renderpass->cache_key = key;
+        }
+    }
+
+    bool NovaRenderer::draws_particles(const Renderpass& renderpass) const {
+        return std::any_of(renderpass.pipelines.begin(), renderpass.pipelines.end(), [&](const PipelineHandle handle) {
+            const auto& passes = passes_by_pipeline[handle];
+            return std::any_of(passes.begin(), passes.end(), [&](const MaterialPass& pass) {
+                return particle_system->draws_into(pass.name);
+            });
+        });
+    }
+
+    void NovaRenderer::mix_scene_into_cache_key(uint64_t& key, const Renderpass& renderpass) {
+        for(const PipelineHandle handle : renderpass.pipelines) {
+            mix_into_cache_key(key, pipeline_scene_versions[handle]);
+
+            for(const MaterialPass& pass : passes_by_pipeline[handle]) {
+                for(const ProceduralMeshBatch& batch : pass.static_procedural_mesh_draws) {
+                    if(const auto proc_mesh_itr = proc_meshes.find(batch.mesh.get_key()); proc_mesh_itr != proc_meshes.end()) {
+                        mix_into_cache_key(key, proc_mesh_itr->second.get_data_version());
+                    }
+                }
+            }
+        }
+    }
 
-            device->submit_command_list(indices_upload_cmds, rhi::QueueType::Transfer);
+    uint64_t NovaRenderer::get_recording_key(const Renderpass& renderpass, const FrameContext& ctx) {
+        uint64_t key = 0;
+        mix_scene_into_cache_key(key, renderpass);
 
-            // TODO: Barrier on the mesh's first usage
+        // Pipelines that are still compiling don't record anything
+        for(const PipelineHandle handle : renderpass.pipelines) {
+            mix_into_cache_key(key, get_pipeline(handle) != nullptr ? 1 : 0);
         }
 
-        // TODO: Clean up staging buffers
-
-        Mesh mesh;
-        mesh.num_vertex_attributes = mesh_data.num_vertex_attributes;
-        mesh.vertex_buffer = vertex_buffer;
-        mesh.index_buffer = index_buffer;
-        mesh.num_indices = mesh_data.num_indices;
+        if(renderpass.uses_dynamic_resolution) {
+            mix_into_cache_key(key, std::bit_cast<uint32_t>(ctx.resolution_scale));
+        }
 
-        const MeshId new_mesh_id = next_mesh_id;
-        next_mesh_id++;
-        meshes.emplace(new_mesh_id, mesh);
+        // The commands refer to these directly
+        mix_into_cache_key(key, reinterpret_cast<uintptr_t>(renderpass.get_framebuffer(ctx)));
+        mix_into_cache_key(key, reinterpret_cast<uintptr_t>(ctx.draw_commands_buffer));
+        mix_into_cache_key(key, reinterpret_cast<uintptr_t>(ctx.draw_counts_buffer));
 
-        return new_mesh_id;
+        return key;
     }
 
-    ProceduralMeshAccessor NovaRenderer::create_procedural_mesh(const uint64_t vertex_size, const uint64_t index_size) {
-        const MeshId our_id = next_mesh_id;
-        next_mesh_id++;
-
-        proc_meshes.emplace(our_id, ProceduralMesh{vertex_size, index_size, settings->max_in_flight_frames, device.get()});
+    void NovaRenderer::release_reusable_contents() {
+        for(const auto& [renderpass, frame_contents] : reusable_contents) {
+            for(const ReusableContents& contents : frame_contents) {
+                if(contents.cmds != nullptr) {
+                    device->destroy_reusable_command_list(contents.cmds);
+                }
+            }
+        }
 
-        return ProceduralMeshAccessor{&proc_meshes, our_id};
+        reusable_contents.clear();
     }
 
-    std::optional<Mesh> NovaRenderer::get_mesh(const MeshId mesh_id) {
-        if(const auto mesh_itr = meshes.find(mesh_id); mesh_itr != meshes.end()) {
-            return mesh_itr->second;
-
-        } else {
-            return std::nullopt;
-        }
+    bool NovaRenderer::CameraMatrixState::matches(const Camera& cam,
+                                                  const glm::uvec2 cam_framebuffer_size,
+                                                  const glm::vec2 cam_jitter) const {
+        return is_built && position == cam.position && rotation == cam.rotation && field_of_view == cam.field_of_view &&
+               aspect_ratio == cam.aspect_ratio && near_plane == cam.near_plane && far_plane == cam.far_plane &&
+               framebuffer_size == cam_framebuffer_size && jitter == cam_jitter;
     }
 
-    void NovaRenderer::load_renderpack(const std::string& renderpack_name) {
+    void NovaRenderer::update_camera_matrix_buffer(const uint32_t frame_idx) {
         ZoneScoped;
-        const renderpack::RenderpackData data = renderpack::load_renderpack_data(renderpack_name);
-
-        if(renderpacks_loaded) {
-            destroy_dynamic_resources();
-
-            destroy_renderpasses();
-            logger->debug("Resources from old renderpack destroyed");
-        }
+        const auto swapchain_size = device->get_swapchain()->get_size();
+        const auto jitter_ndc = camera_jitter * 2.0f / glm::vec2{scale_resolution(swapchain_size, get_resolution_scale())};
+        for(const Camera& cam : frame_cameras) {
+            if(!cam.is_active) {
+                continue;
+            }
 
-        create_dynamic_textures(data.resources.render_targets);
-        logger->debug("Dynamic textures created");
+            // Only screen-space cameras care about the framebuffer's size
+            const auto framebuffer_size = cam.field_of_view > 0 ? glm::uvec2{} : swapchain_size;
 
-        create_render_passes(data.graph_data.passes, data.pipelines);
+            // Only the main camera's view of the scene gets upscaled. Views for shadow maps and the like would only flicker
+            const auto cam_jitter = &cam == &frame_cameras[0] && cam.field_of_view > 0 ? jitter_ndc : glm::vec2{};
 
-        logger->debug("Created render passes");
+            auto& state = camera_matrix_states[cam.index];
+            if(state.matches(cam, framebuffer_size, cam_jitter)) {
+                // A camera that stopped moving still needs one more write, so that last frame's matrices catch up with this frame's
+                if(!state.previous_is_current) {
+                    auto& data = camera_data->at(cam.index);
+                    data.previous_view = data.view;
+                    data.previous_projection = data.projection;
+                    state.previous_is_current = true;
+                }
 
-        create_pipelines_and_materials(data.pipelines, data.materials);
+                continue;
+            }
 
-        logger->debug("Created pipelines and materials");
+            auto& data = camera_data->at(cam.index);
+            data.previous_view = data.view;
+            data.previous_projection = data.projection;
 
-        renderpacks_loaded = true;
+            data.view = translate({}, cam.position);
+            data.view = rotate(data.view, cam.rotation.x, {1, 0, 0});
+            data.view = rotate(data.view, cam.rotation.y, {0, 1, 0});
+            data.view = rotate(data.view, cam.rotation.z, {0, 0, 1});
 
-        logger->debug("Renderpack %s loaded successfully", renderpack_name);
-    }
+            if(cam.field_of_view > 0) {
+                data.projection = glm::perspective(cam.field_of_view, cam.aspect_ratio, cam.near_plane, cam.far_plane);
 
-    const std::vector<MaterialPass>& NovaRenderer::get_material_passes_for_pipeline(const std::string& pipeline) {
-        return passes_by_pipeline.find(pipeline)->second;
-    }
+                // Moves everything on screen by the jitter, no matter how far away it is
+                data.projection[2][0] -= cam_jitter.x;
+                data.projection[2][1] -= cam_jitter.y;
 
-    std::optional<RenderpassMetadata> NovaRenderer::get_renderpass_metadata(const std::string& renderpass_name) const {
-        return rendergraph->get_metadata_for_renderpass(renderpass_name);
-    }
+            } else {
+                glm::mat4 ui_matrix{
+                    {2.0f, 0.0f, 0.0f, -1.0f},
+                    {0.0f, 2.0f, 0.0f, -1.0f},
+                    {0.0f, 0.0f, -1.0f, 0.0f},
+                    {0.0f, 0.0f, 0.0f, 1.0f},
+                };
+                ui_matrix[0][0] /= framebuffer_size.x;
+                ui_matrix[1][1] /= framebuffer_size.y;
+                data.projection = ui_matrix;
+            }
 
-    void NovaRenderer::create_dynamic_textures(const std::vector<renderpack::TextureCreateInfo>& texture_create_infos) {
-        ZoneScoped;
-        for(const renderpack::TextureCreateInfo& create_info : texture_create_infos) {
-            ZoneScoped;
-            const auto size = create_info.format.get_size_in_pixels(device->get_swapchain()->get_size());
+            state = {cam.position,
+                     cam.rotation,
+                     cam.field_of_view,
+                     cam.aspect_ratio,
+                     cam.near_plane,
+                     cam.far_plane,
+                     framebuffer_size,
+                     true,
+                     data.previous_view == data.view && data.previous_projection == data.projection,
+                     cam_jitter};
+        }
 
-            const auto render_target = device_resources->create_render_target(create_info.name,
-                                                                              size.x,
-                                                                              size.y,
-                                                                              create_info.format.pixel_format);
+        for(const ViewCameras& views : view_cameras) {
+            for(uint32_t i = 0; i < views.camera_names.size(); i++) {
+                const auto camera_itr = std::find_if(frame_cameras.begin(), frame_cameras.end(), [&](const Camera& cam) {
+                    return cam.get_name() == views.camera_names[i];
+                });
+                if(camera_itr == frame_cameras.end() || !camera_itr->is_active) {
+                    continue;
+                }
 
-            dynamic_texture_infos.emplace(create_info.name, create_info);
+                // Writing marks the slot for upload, so only write the views whose camera changed
+                const auto& source = std::as_const(*camera_data).at(camera_itr->index);
+                if(std::memcmp(&std::as_const(*camera_data).at(views.first_slot + i), &source, sizeof(CameraUboData)) != 0) {
+                    camera_data->at(views.first_slot + i) = source;
+                }
+            }
         }
+
+        // Only the slots that were written since this frame slot's buffer was last uploaded get copied
+        camera_data->upload_to_device(frame_idx);
     }
 
-    void NovaRenderer::create_render_passes(const std::vector<renderpack::RenderPassCreateInfo>& pass_create_infos,
-                                            const std::vector<renderpack::PipelineData>& pipelines) const {
-        ZoneScoped;
-        device->set_num_renderpasses(static_cast<uint32_t>(pass_create_infos.size()));
+    std::pmr::vector<rhi::RhiImage*> NovaRenderer::get_all_images(std::pmr::memory_resource* allocator) {
+        std::pmr::vector<rhi::RhiImage*> images{allocator};
+
+        const auto& textures = device_resources->get_all_textures();
+        images.reserve(textures.size());
+
+        for(const TextureResource& texture : textures) {
+            // Keep the array indices stable by putting the default texture in the slot of any texture that's still uploading
+            if(texture.is_upload_done()) {
+                images.emplace_back(texture.image);
 
-        for(const renderpack::RenderPassCreateInfo& create_info : pass_create_infos) {
-            ZoneScoped;
-            auto* renderpass = new Renderpass(create_info.name);
-            if(rendergraph->add_renderpass(renderpass, create_info, *device_resources) != nullptr) {
-                for(const renderpack::PipelineData& pipeline : pipelines) {
-                    if(pipeline.pass == create_info.name) {
-                        renderpass->pipeline_names.emplace_back(pipeline.name);
-                    }
-                }
             } else {
-                logger->error("Could not create renderpass %s", create_info.name);
+                images.emplace_back(textures[0].image);
             }
         }
+
+        return images;
     }
 
-    void NovaRenderer::create_pipelines_and_materials(const std::vector<renderpack::PipelineData>& pipeline_create_infos,
-                                                      const std::vector<renderpack::MaterialData>& materials) {
+    void NovaRenderer::destroy_dynamic_resources() {
         ZoneScoped;
-        for(const renderpack::PipelineData& rp_pipeline_state : pipeline_create_infos) {
-            ZoneScoped;
-            const auto pipeline_state = to_pipeline_state_create_info(rp_pipeline_state, *rendergraph);
-            if(!pipeline_state) {
-                logger->error("Could not create pipeline %s", rp_pipeline_state.name);
-                continue;
+        if(loaded_renderpack) {
+            for(const renderpack::TextureCreateInfo& tex_data : loaded_renderpack->resources.render_targets) {
+                device_resources->destroy_render_target(tex_data.name);
             }
 
-            // TODO: A way for renderpack pipelines to say if they're global or surface pipelines
-            Pipeline pipeline;
-            pipeline.pipeline = device->create_surface_pipeline(*pipeline_state);
-
-            create_materials_for_pipeline(pipeline, materials, rp_pipeline_state.name);
+            logger->debug("Deleted all dynamic textures from renderpack %s", loaded_renderpack->name);
+        }
+    }
 
-            pipelines.emplace(rp_pipeline_state.name, std::move(pipeline));
+    void NovaRenderer::check_for_hitch() {
+        const auto frame_start_ns = cpu_timeline->now();
+        const auto frame_time_ms = static_cast<double>(frame_start_ns - last_frame_start_ns) / 1e6;
+        const auto is_first_frame = last_frame_start_ns == 0;
+        last_frame_start_ns = frame_start_ns;
 
+        const auto& options = settings->cpu_timeline;
+        if(is_first_frame || options.hitch_threshold_ms <= 0 || frame_time_ms < options.hitch_threshold_ms) {
             return;
         }
-    }
-
-    void NovaRenderer::create_materials_for_pipeline(const Pipeline& pipeline,
-                                                     const std::vector<renderpack::MaterialData>& materials,
-                                                     const std::string& pipeline_name) {
-        ZoneScoped; // Determine the pipeline layout so the material can create descriptors for the pipeline
 
-        MaterialPassKey template_key = {};
-        template_key.pipeline_name = pipeline_name;
+        const auto min_ns_between_traces = static_cast<int64_t>(options.min_seconds_between_hitch_traces * 1e9);
+        if(last_hitch_trace_ns && frame_start_ns - *last_hitch_trace_ns < min_ns_between_traces) {
+            return;
+        }
+        last_hitch_trace_ns = frame_start_ns;
 
-        // Large overestimate, but that's fine
-        std::vector<MaterialPass> passes;
-        passes.reserve(materials.size());
+        ZoneScoped;
+        const auto path = std::filesystem::path{options.hitch_trace_directory} / fmt::format("hitch_frame_{}.json", frame_count);
+        logger->warn("Frame {} took {:.1f} ms, writing what the CPU did before it to {}", frame_count, frame_time_ms, path.string());
+
+        // Copying the rings is quick, but writing them out isn't, and this frame is already late
+        auto snapshot = cpu_timeline->take_snapshot(options.trace_seconds);
+        task_scheduler->add_task([snapshot = std::move(snapshot), path](uint32_t /* thread_idx */) {
+            CpuTimeline::write_chrome_trace(snapshot, path);
+        });
+    }
 
-        for(const renderpack::MaterialData& material_data : materials) {
-            for(const renderpack::MaterialPass& pass_data : material_data.passes) {
-                if(pass_data.pipeline == pipeline_name) {
-                    const auto& event_name = fmt::format("{}.{}", material_data.name, pass_data.name);
-                    ZoneScoped;
-                    MaterialPass pass = {};
-                    pass.pipeline_interface = pipeline.pipeline_interface;
+    void NovaRenderer::update_resolution_scale() {
+        // Passes on the async compute queue may overlap with the graphics passes, so this overestimates a bit when there are any
+        double gpu_frame_time_ms = 0;
+        for(const GpuPassTiming& timing : gpu_profiler->get_latest_timings()) {
+            if(timing.depth == 0) {
+                gpu_frame_time_ms += timing.milliseconds;
+            }
+        }
 
-                    const FullMaterialPassName full_pass_name{pass_data.material_name, pass_data.name};
+        dynamic_resolution->update(gpu_frame_time_ms);
 
-                    pass.name = full_pass_name;
+        TracyPlot("Resolution scale", static_cast<double>(dynamic_resolution->get_scale()));
+    }
 
-                    MaterialPassMetadata pass_metadata{};
-                    pass_metadata.data = pass_data;
-                    material_metadatas.emplace(full_pass_name, pass_metadata);
+    bool NovaRenderer::can_use_dynamic_resolution(const renderpack::RenderPassCreateInfo& create_info) const {
+        if((!dynamic_resolution && !is_temporal_upscaling) || create_info.texture_outputs.empty()) {
+            return false;
+        }
 
-                    MaterialPassKey key = template_key;
-                    key.material_pass_index = static_cast<uint32_t>(passes.size());
+        // The backbuffer output pass doesn't scale the UI up, so the UI has to be drawn at full resolution
+        const auto is_scaled_render_target = [&](const std::string& name) {
+            if(name == UI_OUTPUT_RT_NAME) {
+                return false;
+            }
 
-                    material_pass_keys.emplace(full_pass_name, key);
+            const auto info_itr = dynamic_texture_infos.find(name);
+            return info_itr != dynamic_texture_infos.end() &&
+                   info_itr->second.format.dimension_type == renderpack::TextureDimensionType::ScreenRelative;
+        };
 
-                    passes.push_back(pass);
-                }
-            }
-        }
+        const auto all_outputs_scaled = std::all_of(create_info.texture_outputs.begin(),
+                                                    create_info.texture_outputs.end(),
+                                                    [&](const renderpack::TextureAttachmentInfo& output) {
+                                                        return is_scaled_render_target(output.name);
+                                                    });
 
-        passes_by_pipeline.emplace(pipeline.pipeline->name, passes);
+        return all_outputs_scaled && (!create_info.depth_texture || is_scaled_render_target(create_info.depth_texture->name));
     }
 
-    void NovaRenderer::update_camera_matrix_buffer(const uint32_t frame_idx) {
+    void NovaRenderer::recreate_swapchain() {
         ZoneScoped;
-        for(const Camera& cam : cameras) {
-            if(cam.is_active) {
-                auto& data = camera_data->at(cam.index);
-                data.previous_view = data.view;
-                data.previous_projection = data.projection;
+        device->wait_for_fences(frame_fences);
 
-                data.view = translate({}, cam.position);
-                data.view = rotate(data.view, cam.rotation.x, {1, 0, 0});
-                data.view = rotate(data.view, cam.rotation.y, {0, 1, 0});
-                data.view = rotate(data.view, cam.rotation.z, {0, 0, 1});
+        device->recreate_swapchain();
+        logger->debug("Recreated the swapchain at {}x{}", swapchain->get_size().x, swapchain->get_size().y);
 
-                if(cam.field_of_view > 0) {
-                    data.projection = glm::perspective(cam.field_of_view, cam.aspect_ratio, cam.near_plane, cam.far_plane);
+        // The new swapchain may have a different number of images, and none of them are in use
+        swapchain_image_fences.assign(swapchain->get_num_images(), nullptr);
 
-                } else {
-                    const auto framebuffer_size = device->get_swapchain()->get_size();
-                    glm::mat4 ui_matrix{
-                        {2.0f, 0.0f, 0.0f, -1.0f},
-                        {0.0f, 2.0f, 0.0f, -1.0f},
-                        {0.0f, 0.0f, -1.0f, 0.0f},
-                        {0.0f, 0.0f, 0.0f, 1.0f},
-                    };
-                    ui_matrix[0][0] /= framebuffer_size.x;
-                    ui_matrix[1][1] /= framebuffer_size.y;
-                    data.projection = ui_matrix;
-                }
+        device_resources->destroy_render_target(SCENE_OUTPUT_RT_NAME);
+        device_resources->destroy_render_target(UI_OUTPUT_RT_NAME);
+        create_builtin_render_targets();
+
+        if(loaded_renderpack) {
+            destroy_dynamic_resources();
+
+            // The shading rate image has a texel per tile of the screen, so it's sized in texels
+            auto& render_targets = loaded_renderpack->resources.render_targets;
+            const auto shading_rate_itr = std::find_if(render_targets.begin(), render_targets.end(), [](const auto& texture) {
+                return texture.name == SHADING_RATE_RT_NAME;
+            });
+            if(shading_rate_itr != render_targets.end()) {
+                *shading_rate_itr = ShadingRateRenderpass::get_shading_rate_image_create_info(swapchain->get_size(),
+                                                                                            device->info.shading_rate_image_texel_size);
             }
+
+            create_dynamic_textures(loaded_renderpack->resources.render_targets, loaded_renderpack->graph_data.passes);
         }
 
-        camera_data->upload_to_device(frame_idx);
-    }
+        rendergraph->recreate_framebuffers(*device_resources);
 
-    std::vector<rhi::RhiImage*> NovaRenderer::get_all_images() {
-        std::vector<rhi::RhiImage*> images{};
+        if(loaded_renderpack) {
+            // The cached passes' render targets are new, and empty
+            for(const renderpack::RenderPassCreateInfo& create_info : loaded_renderpack->graph_data.passes) {
+                if(auto* renderpass = rendergraph->get_renderpass(create_info.name); renderpass != nullptr) {
+                    renderpass->invalidate_cached_contents();
+                }
+            }
+        }
 
-        const auto& textures = device_resources->get_all_textures();
-        images.reserve(textures.size());
+        // The framebuffers and everything that's sized from the screen are new
+        release_reusable_contents();
 
-        for(const TextureResource& texture : textures) {
-            images.emplace_back(texture.image);
+        // These bind render targets directly, so they need new binders. Compute passes also size their dispatches from their render
+        // targets
+        if(loaded_renderpack) {
+            for(const renderpack::RenderPassCreateInfo& create_info : loaded_renderpack->graph_data.passes) {
+                if(create_info.compute_shader) {
+                    create_compute_renderpass(create_info);
+                }
+            }
         }
 
-        return images;
+        create_builtin_renderpasses();
     }
 
-    void NovaRenderer::destroy_dynamic_resources() {
+    void NovaRenderer::destroy_pipelines() {
         ZoneScoped;
-        if(loaded_renderpack) {
-            for(const renderpack::TextureCreateInfo& tex_data : loaded_renderpack->resources.render_targets) {
-                device_resources->destroy_render_target(tex_data.name);
-            }
+        // Renderpasses and renderables refer to pipelines by handle, so the handles have to stay valid
+        for(Pipeline& pipeline : pipelines) {
+            pipeline.pipeline.reset();
+            pipeline.depth_prepass_pipeline.reset();
+            pipeline.variants.clear();
+            pipeline.pipeline_interface = nullptr;
+        }
+        retired_pipelines.clear();
+        pending_pipeline_variants.clear();
 
-            logger->debug("Deleted all dynamic textures from renderpack %s", loaded_renderpack->name);
+        if(occlusion_queries) {
+            occlusion_queries->destroy_pipelines();
         }
     }
 
@@ -550,162 +3910,302 @@ namespace nova::renderer {
         for(const renderpack::RenderPassCreateInfo& renderpass : loaded_renderpack->graph_data.passes) {
             rendergraph->destroy_renderpass(renderpass.name);
         }
+
+        for(const ViewCameras& views : view_cameras) {
+            for(uint32_t i = 0; i < views.camera_names.size(); i++) {
+                camera_data->free_slot(views.first_slot + i);
+            }
+        }
+        view_cameras.clear();
     }
 
     rhi::RhiSampler* NovaRenderer::get_point_sampler() const { return point_sampler; }
 
     Pipeline* NovaRenderer::find_pipeline(const std::string& pipeline_name) {
-        if(const auto pipeline_itr = pipelines.find(pipeline_name); pipeline_itr != pipelines.end()) {
-            return &pipeline_itr->second;
+        if(const auto handle_itr = pipeline_handles.find(pipeline_name); handle_itr != pipeline_handles.end()) {
+            return get_pipeline(handle_itr->second);
         }
 
         return nullptr;
     }
 
-    RenderableId NovaRenderer::add_renderable_for_material(const FullMaterialPassName& material_name,
-                                                           const StaticMeshRenderableCreateInfo& create_info) {
-        ZoneScoped;
-        const RenderableId id = next_renderable_id.load();
-        next_renderable_id.fetch_add(1);
+    Pipeline* NovaRenderer::get_pipeline(const PipelineHandle pipeline) {
+        auto& found_pipeline = pipelines[pipeline];
+        return found_pipeline.pipeline ? &found_pipeline : nullptr;
+    }
 
-        const auto pass_key_itr = material_pass_keys.find(material_name);
-        if(pass_key_itr == material_pass_keys.end()) {
-            logger->error("No material named %s for pass %s", material_name.material_name, material_name.pass_name);
-            return std::numeric_limits<uint64_t>::max();
+    PipelineHandle NovaRenderer::get_pipeline_handle(const std::string& pipeline_name) {
+        if(const auto handle_itr = pipeline_handles.find(pipeline_name); handle_itr != pipeline_handles.end()) {
+            return handle_itr->second;
         }
 
-        const auto& pass_key = pass_key_itr->second;
+        const auto handle = static_cast<PipelineHandle>(pipelines.size());
+        pipelines.emplace_back().handle = handle;
+        passes_by_pipeline.emplace_back();
+        material_passes_by_signature.emplace_back();
+        pipeline_scene_versions.emplace_back();
+        pipeline_handles.emplace(pipeline_name, handle);
 
-        RenderableKey key;
-        key.pipeline_name = pass_key.pipeline_name;
-        key.material_pass_idx = pass_key.material_pass_index;
+        return handle;
+    }
 
-        // Figure out where to put the renderable
-        auto materials_itr = passes_by_pipeline.find(pass_key.pipeline_name);
+    std::optional<MaterialPassKey> NovaRenderer::find_material_pass(const FullMaterialPassName& material_name) const {
+        if(const auto pass_key_itr = material_pass_keys.find(material_name); pass_key_itr != material_pass_keys.end()) {
+            return pass_key_itr->second;
+        }
+
+        return std::nullopt;
+    }
 
-        if(materials_itr == passes_by_pipeline.end()) {
-            return std::numeric_limits<uint64_t>::max();
+    RenderableId NovaRenderer::add_renderable_for_material(const FullMaterialPassName& material_name,
+                                                           const StaticMeshRenderableCreateInfo& create_info) {
+        // The ID is handed out right away so the game can refer to the renderable before the render thread has added it
+        const RenderableId id = next_renderable_id.fetch_add(1);
+        if(!is_scene_thread()) {
+            queue_scene_command([this, id, material_name, create_info] { add_renderable(id, material_name, create_info); });
+            return id;
         }
 
-        auto& material = materials_itr->second[pass_key.material_pass_index];
+        return add_renderable(id, material_name, create_info) ? id : std::numeric_limits<uint64_t>::max();
+    }
 
-        StaticMeshRenderCommand command = make_render_command(create_info, id);
+    RenderableId NovaRenderer::add_renderable_for_material(const MaterialPassKey& pass_key,
+                                                           const StaticMeshRenderableCreateInfo& create_info) {
+        const RenderableId id = next_renderable_id.fetch_add(1);
+        if(!is_scene_thread()) {
+            queue_scene_command([this, id, pass_key, create_info] { add_renderable(id, pass_key, create_info); });
+            return id;
+        }
 
-        if(const auto& mesh_itr = meshes.find(create_info.mesh); mesh_itr != meshes.end()) {
-            const auto& mesh = mesh_itr->second;
-            if(create_info.is_static) {
-                key.type = RenderableType::StaticMesh;
-                bool need_to_add_batch = true;
+        return add_renderable(id, pass_key, create_info) ? id : std::numeric_limits<uint64_t>::max();
+    }
 
-                uint32_t batch_idx = 0;
-                for(MeshBatch<StaticMeshRenderCommand>& batch : material.static_mesh_draws) {
-                    if(batch.vertex_buffer == mesh.vertex_buffer) {
-                        key.batch_idx = batch_idx;
-                        key.renderable_idx = static_cast<uint32_t>(batch.commands.size());
+    bool NovaRenderer::add_renderable(const RenderableId id,
+                                      const FullMaterialPassName& material_name,
+                                      const StaticMeshRenderableCreateInfo& create_info) {
+        const auto pass_key = find_material_pass(material_name);
+        if(!pass_key) {
+            logger->error("No material named {} for pass {}", material_name.material_name, material_name.pass_name);
+            return false;
+        }
 
-                        batch.commands.emplace_back(command);
+        return add_renderable(id, *pass_key, create_info);
+    }
 
-                        need_to_add_batch = false;
-                        break;
-                    }
+    bool NovaRenderer::add_renderable(const RenderableId id,
+                                      const MaterialPassKey& pass_key,
+                                      const StaticMeshRenderableCreateInfo& create_info) {
+        ZoneScoped;
+        if(pass_key.pipeline >= passes_by_pipeline.size() ||
+           pass_key.material_pass_index >= passes_by_pipeline[pass_key.pipeline].size()) {
+            return false;
+        }
 
-                    batch_idx++;
-                }
+        if(!create_info.is_static) {
+            logger->error("Only static renderables are supported");
+            return false;
+        }
 
-                if(need_to_add_batch) {
-                    MeshBatch<StaticMeshRenderCommand> batch;
-                    batch.num_vertex_attributes = mesh.num_vertex_attributes;
-                    batch.num_indices = mesh.num_indices;
-                    batch.vertex_buffer = mesh.vertex_buffer;
-                    batch.index_buffer = mesh.index_buffer;
-                    batch.commands.emplace_back(command);
+        auto& material = passes_by_pipeline[pass_key.pipeline][pass_key.material_pass_index];
 
-                    key.batch_idx = static_cast<uint32_t>(material.static_mesh_draws.size());
-                    key.renderable_idx = 0;
+        RenderableKey key;
+        key.pipeline = pass_key.pipeline;
+        key.material_pass_idx = pass_key.material_pass_index;
 
-                    material.static_mesh_draws.emplace_back(batch);
-                }
-            }
+        // Figure out where to put the renderable
+        RenderableColumns* renderables;
+        if(const auto& mesh_itr = meshes.find(create_info.mesh); mesh_itr != meshes.end()) {
+            key.type = RenderableType::StaticMesh;
 
-        } else if(const auto& proc_mesh_itr = proc_meshes.find(create_info.mesh); proc_mesh_itr != proc_meshes.end()) {
-            if(create_info.is_static) {
-                key.type = RenderableType::ProceduralMesh;
-                bool need_to_add_batch = false;
+            auto [batch_itr, need_to_add_batch] = material.static_mesh_batch_indices.try_emplace(
+                create_info.mesh,
+                static_cast<uint32_t>(material.static_mesh_draws.size()));
+            if(need_to_add_batch) {
+                MeshBatch batch;
+                set_mesh_batch_mesh(batch, create_info.mesh, mesh_itr->second);
 
-                uint32_t batch_idx = 0;
-                for(ProceduralMeshBatch<StaticMeshRenderCommand>& batch : material.static_procedural_mesh_draws) {
-                    if(batch.mesh.get_key() == create_info.mesh) {
-                        key.batch_idx = batch_idx;
-                        key.renderable_idx = static_cast<uint32_t>(batch.commands.size());
+                material.static_mesh_draws.emplace_back(std::move(batch));
+            }
 
-                        batch.commands.emplace_back(command);
+            key.batch_idx = batch_itr->second;
+            renderables = &material.static_mesh_draws[key.batch_idx].renderables;
 
-                        need_to_add_batch = false;
-                        break;
-                    }
+        } else if(proc_meshes.find(create_info.mesh) != proc_meshes.end()) {
+            key.type = RenderableType::ProceduralMesh;
 
-                    batch_idx++;
-                }
+            auto [batch_itr, need_to_add_batch] = material.procedural_mesh_batch_indices.try_emplace(
+                create_info.mesh,
+                static_cast<uint32_t>(material.static_procedural_mesh_draws.size()));
+            if(need_to_add_batch) {
+                material.static_procedural_mesh_draws.emplace_back(&proc_meshes, create_info.mesh);
+            }
 
-                if(need_to_add_batch) {
-                    ProceduralMeshBatch<StaticMeshRenderCommand> batch{&proc_meshes, create_info.mesh};
-                    batch.commands.emplace_back(command);
+            key.batch_idx = batch_itr->second;
+            renderables = &material.static_procedural_mesh_draws[key.batch_idx].renderables;
 
-                    key.batch_idx = static_cast<uint32_t>(material.static_mesh_draws.size());
-                    key.renderable_idx = 0;
+        } else if(const auto* skinned_mesh = skinning->get_mesh(create_info.mesh); skinned_mesh != nullptr) {
+            key.type = RenderableType::SkinnedMesh;
 
-                    material.static_procedural_mesh_draws.emplace_back(batch);
-                }
+            const auto first_vertex = skinning->add_renderable(id, create_info.mesh);
+            if(!first_vertex) {
+                return false;
+            }
+
+            auto [batch_itr, need_to_add_batch] = material.skinned_mesh_batch_indices.try_emplace(
+                create_info.mesh,
+                static_cast<uint32_t>(material.skinned_mesh_draws.size()));
+            if(need_to_add_batch) {
+                SkinnedMeshBatch batch;
+                batch.mesh = create_info.mesh;
+                batch.first_index = skinned_mesh->first_index;
+                batch.num_indices = skinned_mesh->num_indices;
+                batch.bounding_sphere = skinned_mesh->bounding_sphere;
+
+                material.skinned_mesh_draws.emplace_back(std::move(batch));
             }
+
+            key.batch_idx = batch_itr->second;
+            auto& batch = material.skinned_mesh_draws[key.batch_idx];
+            batch.first_vertices.push_back(*first_vertex);
+            renderables = &batch.renderables;
+
         } else {
-            logger->error("Could not find a mesh with ID %u", create_info.mesh);
-            return std::numeric_limits<uint64_t>::max();
+            logger->error("Could not find a mesh with ID {}", create_info.mesh);
+            return false;
         }
 
+        key.renderable_idx = renderables->add(id, make_model_matrix(create_info), create_info.visible);
+
         renderable_keys.emplace(id, key);
+        pipeline_scene_versions[key.pipeline]++;
+
+        update_occlusion_bounds(id, key);
+
+        return true;
+    }
 
-        return id;
+    void NovaRenderer::update_renderable(const RenderableId renderable, const StaticMeshRenderableUpdateData& update_data) {
+        const StaticMeshRenderableUpdate update{renderable, update_data};
+        update_renderables({&update, 1});
     }
 
-    void NovaRenderer::update_renderable(RenderableId renderable, const StaticMeshRenderableUpdateData& update_data) {
+    void NovaRenderer::update_renderables(const std::span<const StaticMeshRenderableUpdate> updates) {
         ZoneScoped;
-        const auto& key_itr = renderable_keys.find(renderable);
-        if(key_itr == renderable_keys.end()) {
-            logger->error("Could not update renderable %u", renderable);
+        if(!is_scene_thread()) {
+            queue_scene_command(
+                [this, updates = std::vector(updates.begin(), updates.end())] { update_renderables(updates); });
             return;
         }
 
-        auto passes_itr = passes_by_pipeline.find(key_itr->second.pipeline_name);
-        if(passes_itr == passes_by_pipeline.end()) {
-            logger->error("Could not find draws for pipeline %s, as requested by renderable %u", key_itr->second.pipeline_name, renderable);
+        auto& scratch = transform_scratch;
+        scratch.positions.clear();
+        scratch.rotations.clear();
+        scratch.scales.clear();
+        for(const StaticMeshRenderableUpdate& update : updates) {
+            scratch.positions.push_back(update.data.position);
+            scratch.rotations.push_back(update.data.rotation);
+            scratch.scales.push_back(update.data.scale);
+        }
+
+        scratch.model_matrices.resize(updates.size());
+        make_model_matrices(scratch.positions, scratch.rotations, scratch.scales, scratch.model_matrices);
+
+        for(size_t i = 0; i < updates.size(); i++) {
+            const auto& update = updates[i];
+            const auto key_itr = renderable_keys.find(update.renderable);
+            if(key_itr == renderable_keys.end()) {
+                logger->error("Could not update renderable {}", update.renderable);
+                continue;
+            }
+
+            const auto& key = key_itr->second;
+            auto& renderables = get_renderable_columns(key);
+            renderables.model_matrices[key.renderable_idx] = scratch.model_matrices[i];
+            renderables.visibilities[key.renderable_idx] = update.data.visible ? 1 : 0;
+            pipeline_scene_versions[key.pipeline]++;
+
+            update_occlusion_bounds(update.renderable, key);
+        }
+    }
+
+    void NovaRenderer::remove_renderable(const RenderableId renderable) { remove_renderables({&renderable, 1}); }
+
+    void NovaRenderer::remove_renderables(const std::span<const RenderableId> renderables_to_remove) {
+        ZoneScoped;
+        if(!is_scene_thread()) {
+            queue_scene_command(
+                [this, renderables = std::vector(renderables_to_remove.begin(), renderables_to_remove.end())] {
+                    remove_renderables(renderables);
+                });
             return;
         }
 
-        const auto& key = key_itr->second;
-        auto& material_pass = passes_itr->second[key.material_pass_idx];
+        for(const RenderableId renderable : renderables_to_remove) {
+            const auto key_itr = renderable_keys.find(renderable);
+            if(key_itr == renderable_keys.end()) {
+                logger->error("Could not remove renderable {}", renderable);
+                continue;
+            }
 
-        auto command = [&] {
-            switch(key.type) {
-                case RenderableType::StaticMesh: {
-                    auto& batch = material_pass.static_mesh_draws[key.batch_idx];
-                    return batch.commands[key.renderable_idx];
-                }
+            const auto& key = key_itr->second;
+            if(key.type == RenderableType::SkinnedMesh) {
+                // The skinned vertex offsets move the same way the renderables do
+                auto& batch = passes_by_pipeline[key.pipeline][key.material_pass_idx].skinned_mesh_draws[key.batch_idx];
+                auto& first_vertices = batch.first_vertices;
+                first_vertices[key.renderable_idx] = first_vertices.back();
+                first_vertices.pop_back();
 
-                case RenderableType::ProceduralMesh: {
-                    auto& batch = material_pass.static_procedural_mesh_draws[key.batch_idx];
-                    return batch.commands[key.renderable_idx];
-                }
+                skinning->remove_renderable(renderable);
+            }
+
+            if(const auto moved_renderable = get_renderable_columns(key).swap_remove(key.renderable_idx); moved_renderable) {
+                renderable_keys.at(*moved_renderable).renderable_idx = key.renderable_idx;
+            }
+
+            pipeline_scene_versions[key.pipeline]++;
+            renderable_keys.erase(key_itr);
+
+            if(occlusion_cache) {
+                occlusion_cache->remove_renderable(renderable);
             }
-        }();
+        }
+    }
+
+    RenderableColumns& NovaRenderer::get_renderable_columns(const RenderableKey& key) {
+        auto& material_pass = passes_by_pipeline[key.pipeline][key.material_pass_idx];
+        switch(key.type) {
+            case RenderableType::ProceduralMesh:
+                return material_pass.static_procedural_mesh_draws[key.batch_idx].renderables;
+
+            case RenderableType::SkinnedMesh:
+                return material_pass.skinned_mesh_draws[key.batch_idx].renderables;
+
+            case RenderableType::StaticMesh:
+            default:
+                return material_pass.static_mesh_draws[key.batch_idx].renderables;
+        }
+    }
+
+    MeshBatch& NovaRenderer::get_mesh_batch(const RenderableKey& key) {
+        return passes_by_pipeline[key.pipeline][key.material_pass_idx].static_mesh_draws[key.batch_idx];
+    }
+
+    void NovaRenderer::update_occlusion_bounds(const RenderableId renderable, const RenderableKey& key) {
+        if(!occlusion_cache) {
+            return;
+        }
 
-        command.is_visible = update_data.visible;
+        // Procedural meshes change their geometry whenever they like, so their bounds can't be trusted
+        if(key.type == RenderableType::StaticMesh) {
+            const auto& batch = get_mesh_batch(key);
+            const auto& renderables = batch.renderables;
+            if(batch.num_indices >= settings->culling.occlusion_query_min_indices && renderables.visibilities[key.renderable_idx] != 0) {
+                occlusion_cache->set_renderable_bounds(renderable, renderables.model_matrices[key.renderable_idx], batch.bounding_sphere);
+                return;
+            }
+        }
 
-        // TODO: Make sure my matrix math is correct
-        command.model_matrix = glm::translate(glm::mat4{1}, update_data.position);
-        command.model_matrix = glm::scale(command.model_matrix, update_data.scale);
-        command.model_matrix = glm::rotate(command.model_matrix, update_data.rotation.x, {1, 0, 0});
-        command.model_matrix = glm::rotate(command.model_matrix, update_data.rotation.y, {0, 1, 0});
-        command.model_matrix = glm::rotate(command.model_matrix, update_data.rotation.z, {0, 0, 1});
+        occlusion_cache->remove_renderable(renderable);
     }
 
     CameraAccessor NovaRenderer::create_camera(const CameraCreateInfo& create_info) {
@@ -721,8 +4221,29 @@ namespace nova::renderer {
 
     rhi::RenderDevice& NovaRenderer::get_device() const { return *device; }
 
+    TaskScheduler& NovaRenderer::get_task_scheduler() const { return *task_scheduler; }
+
     NovaWindow& NovaRenderer::get_window() const { return *window; }
 
+    std::optional<RenderOutputId> NovaRenderer::add_render_output(const RenderOutputCreateInfo& create_info) {
+        ZoneScoped;
+        wait_for_render_thread();
+
+        return render_outputs->add_output(create_info);
+    }
+
+    void NovaRenderer::remove_render_output(const RenderOutputId id) {
+        ZoneScoped;
+        wait_for_render_thread();
+        device->wait_for_fences(frame_fences);
+
+        render_outputs->remove_output(id);
+    }
+
+    NovaWindow* NovaRenderer::get_render_output_window(const RenderOutputId id) const { return render_outputs->get_window(id); }
+
+    UiBatcher& NovaRenderer::get_ui_batcher() const { return *ui_batcher; }
+
     DeviceResources& NovaRenderer::get_resource_manager() const { return *device_resources; }
 
     void NovaRenderer::initialize_virtual_filesystem() {
@@ -735,13 +4256,27 @@ namespace nova::renderer {
         vfs->add_resource_root(renderpacks_directory);
     }
 
-    void NovaRenderer::create_global_sync_objects() { frame_fences = device->create_fences(settings->max_in_flight_frames, true); }
+    void NovaRenderer::create_global_sync_objects() {
+        // Fences start signaled so that the first use of each frame slot doesn't wait forever
+        frame_fences = device->create_fences(settings->max_in_flight_frames, true);
+
+        image_available_semaphores = device->create_semaphores(settings->max_in_flight_frames);
+        render_finished_semaphores = device->create_semaphores(settings->max_in_flight_frames);
+
+        swapchain_image_fences.resize(swapchain->get_num_images(), nullptr);
+    }
 
     void NovaRenderer::create_global_samplers() {
         {
             // Default sampler create info will give us a delicious point sampler
             point_sampler = device->create_sampler({});
         }
+
+        {
+            // Upscales the scene when dynamic resolution is on
+            bilinear_sampler = device->create_sampler({.min_filter = rhi::TextureFilter::Bilinear,
+                                                       .mag_filter = rhi::TextureFilter::Bilinear});
+        }
     }
 
     void NovaRenderer::create_resource_storage() { device_resources = std::make_unique<DeviceResources>(*this); }
@@ -795,10 +4330,11 @@ namespace nova::renderer {
     }
 
     void NovaRenderer::create_builtin_uniform_buffers() {
-        material_buffer = std::make_unique<MaterialDataBuffer>();
+        material_buffer = std::make_unique<MaterialDataBuffer>(MATERIAL_BUFFER_SIZE.b_count(), settings->max_in_flight_frames);
         for(uint32_t i = 0; i < settings->max_in_flight_frames; i++) {
             const auto buffer_name = fmt::format("{}_{}", MATERIAL_DATA_BUFFER_NAME, i);
-            if(auto buffer = device_resources->create_uniform_buffer(buffer_name, MATERIAL_BUFFER_SIZE); buffer) {
+            if(auto buffer = device_resources->create_uniform_buffer(buffer_name, material_buffer->size(), rhi::BufferUsage::StorageBuffer);
+               buffer) {
                 builtin_buffer_names.emplace_back(buffer_name);
                 material_device_buffers.emplace_back(*buffer);
 
@@ -813,15 +4349,33 @@ namespace nova::renderer {
         } else {
             logger->error("Could not create builtin buffer %s", PER_FRAME_DATA_NAME);
         }
+    }
+
+    void NovaRenderer::recreate_material_device_buffer(const uint32_t frame_idx) {
+        ZoneScoped;
+        const auto buffer_name = fmt::format("{}_{}", MATERIAL_DATA_BUFFER_NAME, frame_idx);
+        device_resources->destroy_uniform_buffer(buffer_name);
 
-        if(device_resources->create_uniform_buffer(MODEL_MATRIX_BUFFER_NAME, sizeof(glm::mat4) * 0xFFFF)) {
-            builtin_buffer_names.emplace_back(MODEL_MATRIX_BUFFER_NAME);
+        if(auto buffer = device_resources->create_uniform_buffer(buffer_name, material_buffer->size(), rhi::BufferUsage::StorageBuffer);
+           buffer) {
+            material_device_buffers[frame_idx] = *buffer;
+
+            // The new buffer starts out empty
+            material_buffer->invalidate_frame(frame_idx);
 
         } else {
-            logger->error("Could not create builtin buffer %s", MODEL_MATRIX_BUFFER_NAME);
+            logger->error("Could not grow material buffer {} to {} bytes", buffer_name, material_buffer->size());
         }
     }
 
+    void NovaRenderer::create_mesh_arenas() {
+        vertex_arena = std::make_unique<MeshArena>(*device,
+                                                   rhi::BufferUsage::VertexBuffer,
+                                                   settings->vertex_memory_settings,
+                                                   "NovaVertices");
+        index_arena = std::make_unique<MeshArena>(*device, rhi::BufferUsage::IndexBuffer, settings->index_memory_settings, "NovaIndices");
+    }
+
     void NovaRenderer::create_builtin_meshes() {
         const static std::array TRIANGLE_VERTICES{0.0f, 0.0f, 2.0f, 0.0f, 0.0f, 2.0f};
         const static std::array TRIANGLE_INDICES{0, 1, 2};
@@ -830,10 +4384,28 @@ namespace nova::renderer {
                                                 3,
                                                 TRIANGLE_VERTICES.data(),
                                                 TRIANGLE_VERTICES.size() * sizeof(float),
+                                                2 * sizeof(float),
                                                 TRIANGLE_INDICES.data(),
                                                 TRIANGLE_INDICES.size() * sizeof(uint32_t)};
 
         fullscreen_triangle_id = create_mesh(fullscreen_triangle_data);
+
+        // Particle shaders only look at the UVs, they put the corners wherever the particle is
+        static const std::array QUAD_VERTICES{FullVertex{.main_uv = glm::packUnorm2x16(glm::vec2{0, 0})},
+                                              FullVertex{.main_uv = glm::packUnorm2x16(glm::vec2{1, 0})},
+                                              FullVertex{.main_uv = glm::packUnorm2x16(glm::vec2{0, 1})},
+                                              FullVertex{.main_uv = glm::packUnorm2x16(glm::vec2{1, 1})}};
+        static const std::array QUAD_INDICES{0U, 2U, 1U, 1U, 2U, 3U};
+
+        const MeshData particle_quad_data{7,
+                                          static_cast<uint32_t>(QUAD_INDICES.size()),
+                                          QUAD_VERTICES.data(),
+                                          QUAD_VERTICES.size() * sizeof(FullVertex),
+                                          sizeof(FullVertex),
+                                          QUAD_INDICES.data(),
+                                          QUAD_INDICES.size() * sizeof(uint32_t)};
+
+        particle_quad_id = create_mesh(particle_quad_data);
     }
 
     void NovaRenderer::create_renderpass_manager() { rendergraph = std::make_unique<Rendergraph>(*device); }
@@ -841,17 +4413,25 @@ namespace nova::renderer {
     // ReSharper disable once CppMemberFunctionMayBeConst
     void NovaRenderer::create_builtin_renderpasses() {
         const auto& ui_output = *device_resources->get_render_target(UI_OUTPUT_RT_NAME);
-        const auto& scene_output = *device_resources->get_render_target(SCENE_OUTPUT_RT_NAME);
+        const auto upscaled_output = is_temporal_upscaling ? device_resources->get_render_target(UPSCALED_OUTPUT_RT_NAME) : std::nullopt;
+        const auto& scene_output = upscaled_output ? *upscaled_output : *device_resources->get_render_target(SCENE_OUTPUT_RT_NAME);
 
+        // This used to be a static, which meant we compiled its shaders before main even ran - and before the shader cache knew where
+        // it lived
+        BackbufferOutputPipelineCreateInfo backbuffer_output_pipeline_create_info{};
         backbuffer_output_pipeline_create_info.viewport_size = device->get_swapchain()->get_size();
-        auto backbuffer_pipeline = device->create_global_pipeline(*backbuffer_output_pipeline_create_info);
-        if(rendergraph->create_renderpass<BackbufferOutputRenderpass>(*device_resources,
-                                                                      ui_output->image,
-                                                                      scene_output->image,
-                                                                      point_sampler,
-                                                                      std::move(backbuffer_pipeline),
-                                                                      fullscreen_triangle_id,
-                                                                      *device) == nullptr) {
+        auto backbuffer_pipeline = device->create_global_pipeline(backbuffer_output_pipeline_create_info);
+        auto* backbuffer_output = new BackbufferOutputRenderpass(ui_output->image,
+                                                                 scene_output->image,
+                                                                 glm::uvec2{scene_output->width, scene_output->height},
+                                                                 bilinear_sampler,
+                                                                 std::move(backbuffer_pipeline),
+                                                                 fullscreen_triangle_id,
+                                                                 *device,
+                                                                 upscaled_output.has_value());
+        if(rendergraph->add_renderpass(backbuffer_output,
+                                       BackbufferOutputRenderpass::get_create_info(upscaled_output.has_value()),
+                                       *device_resources) == nullptr) {
 
             logger->error("Could not create the backbuffer output renderpass");
         }
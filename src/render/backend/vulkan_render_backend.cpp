@@ -3,13 +3,14 @@
 #include <stdexcept>
 
 #include <Tracy.hpp>
-#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include "nova_renderer/util/logging.hpp"
+
 #include "VkBootstrap.h"
 
 namespace nova::renderer {
-    static auto logger = spdlog::stdout_color_mt("VulkanBackend");
+    static auto logger = make_logger("VulkanBackend");
 
 #pragma region Options
     constexpr bool ENABLE_DEBUG_LAYER = true;
@@ -1,227 +1,241 @@
 #include "nova_renderer/procedural_mesh.hpp"
 
-#include <rx/core/log.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
 
-#include "nova_renderer/rhi/render_device.hpp"
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
 
-#include "../util/memory_utils.hpp"
-using namespace nova::mem;
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
 
 namespace nova::renderer {
-    RX_LOG("ProceduralMesh", logger);
+    static auto logger = make_logger("ProceduralMesh");
 
     using namespace rhi;
 
+    static uint64_t num_dirty_blocks(const uint64_t num_bytes) {
+        return (num_bytes + ProceduralMesh::DIRTY_BLOCK_SIZE - 1) / ProceduralMesh::DIRTY_BLOCK_SIZE;
+    }
+
     ProceduralMesh::ProceduralMesh(const uint64_t vertex_buffer_size,
                                    const uint64_t index_buffer_size,
                                    const uint32_t num_in_flight_frames,
                                    RenderDevice* device,
                                    const std::string& name)
         : device(device),
-          name(name)
-#ifdef NOVA_DEBUG
-          ,
-          vertex_buffer_size(vertex_buffer_size),
-          index_buffer_size(index_buffer_size)
-#endif
-    {
-        const auto aligned_vertex_buffer_size = align(vertex_buffer_size, 256);
-        const auto aligned_index_buffer_size = align(index_buffer_size, 256);
-        const auto host_memory_size = aligned_vertex_buffer_size + aligned_index_buffer_size;
-        const auto device_memory_size = host_memory_size * 3;
-
-        allocator = &rx::memory::g_system_allocator;
+          name(name),
+          writes_directly(device->info.has_host_visible_device_memory),
+          vertex_data(vertex_buffer_size),
+          index_data(index_buffer_size),
+          dirty_vertex_blocks{num_dirty_blocks(vertex_buffer_size), num_in_flight_frames},
+          dirty_index_blocks{num_dirty_blocks(index_buffer_size), num_in_flight_frames} {
+        const auto vertex_usage = writes_directly ? BufferUsage::HostVisibleMeshBuffer : BufferUsage::VertexBuffer;
+        const auto index_usage = writes_directly ? BufferUsage::HostVisibleMeshBuffer : BufferUsage::IndexBuffer;
 
         vertex_buffers.resize(num_in_flight_frames);
         index_buffers.resize(num_in_flight_frames);
         for(uint32_t i = 0; i < num_in_flight_frames; i++) {
-            vertex_buffers[i] = device->create_buffer({std::string::format("%sVertices%d", name, i),
-                                                       vertex_buffer_size,
-                                                       BufferUsage::VertexBuffer},
-                                                      *allocator);
-            index_buffers[i] = device->create_buffer({std::string::format("%sIndices%d", name, i),
-                                                      index_buffer_size,
-                                                      BufferUsage::IndexBuffer},
-                                                     *allocator);
+            // Every buffer of the mesh belongs to it in memory reports
+            vertex_buffers[i] = device->create_buffer(
+                {.name = fmt::format("{}Vertices{}", name, i), .size = vertex_buffer_size, .buffer_usage = vertex_usage, .owner = name});
+            index_buffers[i] = device->create_buffer(
+                {.name = fmt::format("{}Indices{}", name, i), .size = index_buffer_size, .buffer_usage = index_usage, .owner = name});
         }
 
-        cached_vertex_buffer = device->create_buffer({std::string::format("%sStagingVertices", name),
-                                                      vertex_buffer_size,
-                                                      BufferUsage::StagingBuffer},
-                                                     *allocator);
-        cached_index_buffer = device->create_buffer({std::string::format("%sStagingIndices", name),
-                                                     index_buffer_size,
-                                                     BufferUsage::StagingBuffer},
-                                                    *allocator);
+        if(!writes_directly) {
+            // Each slice keeps the index data at a block boundary, so a dirty block never straddles the vertex and index data
+            staging_slice_size = (num_dirty_blocks(vertex_buffer_size) + num_dirty_blocks(index_buffer_size)) * DIRTY_BLOCK_SIZE;
+            staging_buffer = device->create_buffer(
+                {.name = fmt::format("{}Staging", name),
+                 .size = staging_slice_size * num_in_flight_frames,
+                 .buffer_usage = BufferUsage::StagingBuffer,
+                 .owner = name});
+        }
     }
 
     ProceduralMesh::ProceduralMesh(ProceduralMesh&& old) noexcept
-        : device{old.device},
+        : device{std::exchange(old.device, nullptr)},
+          name{std::move(old.name)},
           vertex_buffers{std::move(old.vertex_buffers)},
           index_buffers{std::move(old.index_buffers)},
-          cached_vertex_buffer{old.cached_vertex_buffer},
-          cached_index_buffer{old.cached_index_buffer},
-          num_vertex_bytes_to_upload{old.num_vertex_bytes_to_upload},
-          num_index_bytes_to_upload{old.num_index_bytes_to_upload},
-          allocator {
-        old.allocator
-    }
-#if NOVA_DEBUG
-    , vertex_buffer_size{old.vertex_buffer_size}, index_buffer_size { old.index_buffer_size }
-#endif
-    { old.device = nullptr; }
+          writes_directly{old.writes_directly},
+          staging_buffer{std::exchange(old.staging_buffer, nullptr)},
+          staging_slice_size{old.staging_slice_size},
+          vertex_data{std::move(old.vertex_data)},
+          index_data{std::move(old.index_data)},
+          dirty_vertex_blocks{std::move(old.dirty_vertex_blocks)},
+          dirty_index_blocks{std::move(old.dirty_index_blocks)},
+          num_indices{std::exchange(old.num_indices, 0)},
+          data_version{old.data_version} {}
 
     ProceduralMesh& ProceduralMesh::operator=(ProceduralMesh&& old) noexcept {
-        device = old.device;
-        vertex_buffers = std::move(old.vertex_buffers);
-        index_buffers = std::move(old.index_buffers);
-        cached_vertex_buffer = old.cached_vertex_buffer;
-        cached_index_buffer = old.cached_index_buffer;
-        num_vertex_bytes_to_upload = old.num_vertex_bytes_to_upload;
-        num_index_bytes_to_upload = old.num_index_bytes_to_upload;
-        allocator = old.allocator;
-
-#if NOVA_DEBUG
-        vertex_buffer_size = old.vertex_buffer_size;
-        index_buffer_size = old.index_buffer_size;
-#endif
-
-        old.device = nullptr;
+        if(this != &old) {
+            device = std::exchange(old.device, nullptr);
+            name = std::move(old.name);
+            vertex_buffers = std::move(old.vertex_buffers);
+            index_buffers = std::move(old.index_buffers);
+            writes_directly = old.writes_directly;
+            staging_buffer = std::exchange(old.staging_buffer, nullptr);
+            staging_slice_size = old.staging_slice_size;
+            vertex_data = std::move(old.vertex_data);
+            index_data = std::move(old.index_data);
+            dirty_vertex_blocks = std::move(old.dirty_vertex_blocks);
+            dirty_index_blocks = std::move(old.dirty_index_blocks);
+            num_indices = std::exchange(old.num_indices, 0);
+            data_version = old.data_version;
+        }
 
         return *this;
     }
 
     void ProceduralMesh::set_vertex_data(const void* data, const uint64_t size) {
-#ifdef NOVA_DEBUG
-        if(size > vertex_buffer_size) {
-            logger->error(
-                "Cannot upload vertex data. There's only space for %uz bytes, you tried to upload %uz. Truncating vertex data to fit",
-                vertex_buffer_size,
-                size);
+        set_vertex_data(0, {static_cast<const uint8_t*>(data), static_cast<size_t>(size)});
+    }
 
-            device->write_data_to_buffer(data, vertex_buffer_size, cached_vertex_buffer);
-            num_vertex_bytes_to_upload = vertex_buffer_size;
+    void ProceduralMesh::set_vertex_data(const uint64_t offset, const std::span<const uint8_t> data) {
+        write_data(vertex_data, dirty_vertex_blocks, offset, data, "vertex");
+        data_version++;
+    }
 
-        } else {
-#endif
+    void ProceduralMesh::set_index_data(const void* data, const uint64_t size) {
+        const auto num_bytes_written = write_data(index_data,
+                                                  dirty_index_blocks,
+                                                  0,
+                                                  {static_cast<const uint8_t*>(data), static_cast<size_t>(size)},
+                                                  "index");
+        num_indices = static_cast<uint32_t>(num_bytes_written / sizeof(uint32_t));
+        data_version++;
+    }
 
-            device->write_data_to_buffer(data, size, cached_vertex_buffer);
-            num_vertex_bytes_to_upload = size;
+    void ProceduralMesh::set_index_data(const uint64_t offset, const std::span<const uint8_t> data) {
+        const auto num_bytes_written = write_data(index_data, dirty_index_blocks, offset, data, "index");
+        num_indices = std::max(num_indices, static_cast<uint32_t>((offset + num_bytes_written) / sizeof(uint32_t)));
+        data_version++;
+    }
 
-#ifdef NOVA_DEBUG
+    uint64_t ProceduralMesh::write_data(std::vector<uint8_t>& host_data,
+                                        DirtyRangeTracker& dirty_blocks,
+                                        const uint64_t offset,
+                                        const std::span<const uint8_t> data,
+                                        const char* data_kind) const {
+        if(offset >= host_data.size()) {
+            if(!data.empty()) {
+                logger->error("Cannot write {} data to {} at offset {}, the buffer only has {} bytes",
+                              data_kind,
+                              name,
+                              offset,
+                              host_data.size());
+            }
+            return 0;
         }
-#endif
-    }
 
-    void ProceduralMesh::set_index_data(const void* data, const uint64_t size) {
-#ifdef NOVA_DEBUG
-        if(size > index_buffer_size) {
-            logger->error(
-                "Cannot upload index data. There's only space for %uz bytes, you tried to upload %uz. Truncating vertex data to fit",
-                index_buffer_size,
-                size);
-
-            device->write_data_to_buffer(data, index_buffer_size, cached_index_buffer);
-            num_index_bytes_to_upload = index_buffer_size;
-
-        } else {
-#endif
-            device->write_data_to_buffer(data, size, cached_index_buffer);
-            num_index_bytes_to_upload = size;
-
-#ifdef NOVA_DEBUG
+        auto num_bytes = static_cast<uint64_t>(data.size());
+        if(offset + num_bytes > host_data.size()) {
+            logger->error("There's only space for {} bytes of {} data in {}, you tried to write {} bytes at offset {}. Truncating it",
+                          host_data.size(),
+                          data_kind,
+                          name,
+                          num_bytes,
+                          offset);
+            num_bytes = host_data.size() - offset;
         }
-#endif
-    }
 
-    void ProceduralMesh::record_commands_to_upload_data(RhiRenderCommandList* cmds, const uint8_t frame_idx) const {
-        const bool should_upload_vertex_buffer = num_vertex_bytes_to_upload > 0;
-        const bool should_upload_index_buffer = num_index_bytes_to_upload > 0;
+        if(num_bytes == 0) {
+            return 0;
+        }
 
-        auto* cur_vertex_buffer = vertex_buffers[frame_idx];
-        auto* cur_index_buffer = index_buffers[frame_idx];
+        memcpy(host_data.data() + offset, data.data(), num_bytes);
 
-        std::vector<RhiResourceBarrier> barriers_before_upload;
+        const auto first_block = offset / DIRTY_BLOCK_SIZE;
+        const auto last_block = (offset + num_bytes - 1) / DIRTY_BLOCK_SIZE;
+        dirty_blocks.mark_dirty(first_block, last_block - first_block + 1);
 
-        if(should_upload_vertex_buffer) {
-            RhiResourceBarrier barrier_before_vertex_upload = {};
-            barrier_before_vertex_upload.resource_to_barrier = cur_vertex_buffer;
-            barrier_before_vertex_upload.access_before_barrier = ResourceAccess::VertexAttributeRead;
-            barrier_before_vertex_upload.access_after_barrier = ResourceAccess::MemoryWrite;
-            barrier_before_vertex_upload.old_state = ResourceState::VertexBuffer;
-            barrier_before_vertex_upload.new_state = ResourceState::CopyDestination;
-            barrier_before_vertex_upload.source_queue = QueueType::Graphics;
-            barrier_before_vertex_upload.destination_queue = QueueType::Graphics;
-            barrier_before_vertex_upload.buffer_memory_barrier.offset = 0;
-            barrier_before_vertex_upload.buffer_memory_barrier.size = num_vertex_bytes_to_upload;
+        return num_bytes;
+    }
 
-            barriers_before_upload.push_back(barrier_before_vertex_upload);
+    void ProceduralMesh::record_commands_to_upload_data(RhiRenderCommandList* cmds, const uint8_t frame_idx) {
+        ZoneScoped;
+        const auto vertex_barrier = upload_dirty_blocks(*cmds,
+                                                        frame_idx,
+                                                        vertex_data,
+                                                        dirty_vertex_blocks,
+                                                        vertex_buffers[frame_idx],
+                                                        0,
+                                                        false);
+        const auto index_barrier = upload_dirty_blocks(*cmds,
+                                                       frame_idx,
+                                                       index_data,
+                                                       dirty_index_blocks,
+                                                       index_buffers[frame_idx],
+                                                       num_dirty_blocks(vertex_data.size()) * DIRTY_BLOCK_SIZE,
+                                                       true);
+
+        // No barrier before the copies: this frame slot's previous frame finished reading its buffers before the slot's fence signaled
+        std::vector<RhiResourceBarrier> barriers_after_upload;
+        if(vertex_barrier) {
+            barriers_after_upload.push_back(*vertex_barrier);
         }
-
-        if(should_upload_index_buffer) {
-            RhiResourceBarrier barrier_before_index_upload = {};
-            barrier_before_index_upload.resource_to_barrier = cur_index_buffer;
-            barrier_before_index_upload.access_before_barrier = ResourceAccess::IndexRead;
-            barrier_before_index_upload.access_after_barrier = ResourceAccess::MemoryWrite;
-            barrier_before_index_upload.old_state = ResourceState::IndexBuffer;
-            barrier_before_index_upload.new_state = ResourceState::CopyDestination;
-            barrier_before_index_upload.source_queue = QueueType::Graphics;
-            barrier_before_index_upload.destination_queue = QueueType::Graphics;
-            barrier_before_index_upload.buffer_memory_barrier.offset = 0;
-            barrier_before_index_upload.buffer_memory_barrier.size = num_index_bytes_to_upload;
-
-            barriers_before_upload.push_back(barrier_before_index_upload);
+        if(index_barrier) {
+            barriers_after_upload.push_back(*index_barrier);
         }
 
-        if(barriers_before_upload.is_empty()) {
-            return;
+        if(!barriers_after_upload.empty()) {
+            cmds->resource_barriers(PipelineStage::Transfer, PipelineStage::VertexInput, barriers_after_upload);
         }
+    }
 
-        cmds->resource_barriers(PipelineStage::VertexInput, PipelineStage::Transfer, barriers_before_upload);
+    std::optional<RhiResourceBarrier> ProceduralMesh::upload_dirty_blocks(RhiRenderCommandList& cmds,
+                                                                          const uint8_t frame_idx,
+                                                                          const std::vector<uint8_t>& host_data,
+                                                                          DirtyRangeTracker& dirty_blocks,
+                                                                          RhiBuffer* destination,
+                                                                          const uint64_t staging_offset,
+                                                                          const bool is_index_data) {
+        auto first_copied_byte = std::numeric_limits<uint64_t>::max();
+        uint64_t last_copied_byte = 0;
 
-        if(should_upload_vertex_buffer) {
-            cmds->copy_buffer(cur_vertex_buffer, 0, cached_vertex_buffer, 0, num_vertex_bytes_to_upload);
-        }
+        const auto slice_offset = frame_idx * staging_slice_size + staging_offset;
 
-        if(should_upload_index_buffer) {
-            cmds->copy_buffer(cur_index_buffer, 0, cached_index_buffer, 0, num_index_bytes_to_upload);
-        }
+        dirty_blocks.consume_dirty_ranges(frame_idx, [&](const size_t first_block, const size_t num_blocks) {
+            const auto offset = first_block * DIRTY_BLOCK_SIZE;
 
-        std::vector<RhiResourceBarrier> barriers_after_upload;
+            // The last block may be cut short by the end of the data
+            const auto num_bytes = std::min<uint64_t>(num_blocks * DIRTY_BLOCK_SIZE, host_data.size() - offset);
 
-        if(should_upload_vertex_buffer) {
-            RhiResourceBarrier barrier_after_vertex_upload = {};
-            barrier_after_vertex_upload.resource_to_barrier = cur_vertex_buffer;
-            barrier_after_vertex_upload.access_before_barrier = ResourceAccess::MemoryWrite;
-            barrier_after_vertex_upload.access_after_barrier = ResourceAccess::VertexAttributeRead;
-            barrier_after_vertex_upload.old_state = ResourceState::CopyDestination;
-            barrier_after_vertex_upload.new_state = ResourceState::VertexBuffer;
-            barrier_after_vertex_upload.source_queue = QueueType::Graphics;
-            barrier_after_vertex_upload.destination_queue = QueueType::Graphics;
-            barrier_after_vertex_upload.buffer_memory_barrier.offset = 0;
-            barrier_after_vertex_upload.buffer_memory_barrier.size = num_vertex_bytes_to_upload;
-            barriers_after_upload.push_back(barrier_after_vertex_upload);
-        }
+            if(writes_directly) {
+                device->write_data_to_buffer(host_data.data() + offset, num_bytes, offset, destination);
+                device->flush_buffer(destination, offset, num_bytes);
 
-        if(should_upload_index_buffer) {
-            RhiResourceBarrier barrier_after_index_upload = {};
-            barrier_after_index_upload.resource_to_barrier = cur_index_buffer;
-            barrier_after_index_upload.access_before_barrier = ResourceAccess::MemoryWrite;
-            barrier_after_index_upload.access_after_barrier = ResourceAccess::IndexRead;
-            barrier_after_index_upload.old_state = ResourceState::CopyDestination;
-            barrier_after_index_upload.new_state = ResourceState::IndexBuffer;
-            barrier_after_index_upload.source_queue = QueueType::Graphics;
-            barrier_after_index_upload.destination_queue = QueueType::Graphics;
-            barrier_after_index_upload.buffer_memory_barrier.offset = 0;
-            barrier_after_index_upload.buffer_memory_barrier.size = num_index_bytes_to_upload;
-            barriers_after_upload.push_back(barrier_after_index_upload);
-        }
+            } else {
+                device->write_data_to_buffer(host_data.data() + offset, num_bytes, slice_offset + offset, staging_buffer);
+                device->flush_buffer(staging_buffer, slice_offset + offset, num_bytes);
+                cmds.copy_buffer(destination, offset, staging_buffer, slice_offset + offset, num_bytes);
+            }
 
-        if(barriers_after_upload.is_empty()) {
-            return;
+            first_copied_byte = std::min(first_copied_byte, offset);
+            last_copied_byte = std::max(last_copied_byte, offset + num_bytes);
+        });
+
+        if(writes_directly || last_copied_byte == 0) {
+            return std::nullopt;
         }
 
-        cmds->resource_barriers(PipelineStage::Transfer, PipelineStage::VertexInput, barriers_after_upload);
+        RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = destination;
+        barrier.access_before_barrier = ResourceAccess::MemoryWrite;
+        barrier.access_after_barrier = is_index_data ? ResourceAccess::IndexRead : ResourceAccess::VertexAttributeRead;
+        barrier.old_state = ResourceState::CopyDestination;
+        barrier.new_state = is_index_data ? ResourceState::IndexBuffer : ResourceState::VertexBuffer;
+        barrier.source_queue = QueueType::Graphics;
+        barrier.destination_queue = QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = first_copied_byte;
+        barrier.buffer_memory_barrier.size = last_copied_byte - first_copied_byte;
+
+        return barrier;
     }
 
     ProceduralMesh::Buffers ProceduralMesh::get_buffers_for_frame(const uint8_t frame_idx) const {
@@ -230,4 +244,8 @@ namespace nova::renderer {
 
         return {vertex_buffer, index_buffer};
     }
+
+    uint32_t ProceduralMesh::get_num_indices() const { return num_indices; }
+
+    uint64_t ProceduralMesh::get_data_version() const { return data_version; }
 } // namespace nova::renderer
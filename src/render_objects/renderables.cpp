@@ -1,19 +1,136 @@
 #include "nova_renderer/renderables.hpp"
 
-#include <glm/ext/matrix_transform.inl>
+#include <cmath>
+
+#include "../util/simd.hpp"
 
 namespace nova::renderer {
-    StaticMeshRenderCommand make_render_command(const StaticMeshRenderableCreateInfo& data, const RenderableId id) {
-        StaticMeshRenderCommand command = {};
-        command.id = id;
-        command.is_visible = true;
-        // TODO: Make sure this is accurate
-        command.model_matrix = glm::translate(command.model_matrix, data.position);
-        command.model_matrix = glm::rotate(command.model_matrix, data.rotation.x, {1, 0, 0});
-        command.model_matrix = glm::rotate(command.model_matrix, data.rotation.y, {0, 1, 0});
-        command.model_matrix = glm::rotate(command.model_matrix, data.rotation.z, {0, 0, 1});
-        command.model_matrix = glm::scale(command.model_matrix, data.scale); // Uniform scaling only
-
-        return command;
+    /*!
+     * \brief The columns of Rx * Ry * Rz
+     */
+    struct RotationColumns {
+        glm::vec3 x;
+        glm::vec3 y;
+        glm::vec3 z;
+    };
+
+    static RotationColumns make_rotation_columns(const glm::vec3& rotation) {
+        const auto sx = std::sin(rotation.x);
+        const auto cx = std::cos(rotation.x);
+        const auto sy = std::sin(rotation.y);
+        const auto cy = std::cos(rotation.y);
+        const auto sz = std::sin(rotation.z);
+        const auto cz = std::cos(rotation.z);
+
+        return {{cy * cz, sx * sy * cz + cx * sz, sx * sz - cx * sy * cz},
+                {-cy * sz, cx * cz - sx * sy * sz, cx * sy * sz + sx * cz},
+                {sy, -sx * cy, cx * cy}};
+    }
+
+    static void make_model_matrix(const glm::vec3& position,
+                                  const glm::vec3& rotation,
+                                  const glm::vec3& scale,
+                                  glm::mat4& model_matrix,
+                                  glm::mat4* normal_matrix) {
+        const auto columns = make_rotation_columns(rotation);
+
+        model_matrix[0] = glm::vec4{columns.x * scale.x, 0};
+        model_matrix[1] = glm::vec4{columns.y * scale.y, 0};
+        model_matrix[2] = glm::vec4{columns.z * scale.z, 0};
+        model_matrix[3] = glm::vec4{position, 1};
+
+        if(normal_matrix != nullptr) {
+            // The inverse transpose of rotation * scale is rotation / scale
+            (*normal_matrix)[0] = glm::vec4{columns.x / scale.x, 0};
+            (*normal_matrix)[1] = glm::vec4{columns.y / scale.y, 0};
+            (*normal_matrix)[2] = glm::vec4{columns.z / scale.z, 0};
+            (*normal_matrix)[3] = glm::vec4{0, 0, 0, 1};
+        }
+    }
+
+    glm::mat4 make_model_matrix(const StaticMeshRenderableUpdateData& data) {
+        glm::mat4 model_matrix;
+        make_model_matrix(data.position, data.rotation, data.scale, model_matrix, nullptr);
+
+        return model_matrix;
+    }
+
+#ifdef NOVA_SIMD
+    using namespace simd;
+
+    /*!
+     * \brief Writes one column of four matrices. `x`, `y`, `z`, and `w` hold that column's components for each of the four
+     */
+    static void store_column(Float4 x, Float4 y, Float4 z, Float4 w, glm::mat4* matrices, const int column) {
+        transpose(x, y, z, w);
+        store(x, &matrices[0][column].x);
+        store(y, &matrices[1][column].x);
+        store(z, &matrices[2][column].x);
+        store(w, &matrices[3][column].x);
+    }
+#endif
+
+    void make_model_matrices(const std::span<const glm::vec3> positions,
+                             const std::span<const glm::vec3> rotations,
+                             const std::span<const glm::vec3> scales,
+                             const std::span<glm::mat4> model_matrices,
+                             const std::span<glm::mat4> normal_matrices) {
+        const auto with_normals = !normal_matrices.empty();
+        size_t i = 0;
+
+#ifdef NOVA_SIMD
+        for(; i + 4 <= model_matrices.size(); i += 4) {
+            const auto* p = &positions[i];
+            const auto* r = &rotations[i];
+            const auto* s = &scales[i];
+
+            const auto rx = set(r[0].x, r[1].x, r[2].x, r[3].x);
+            const auto ry = set(r[0].y, r[1].y, r[2].y, r[3].y);
+            const auto rz = set(r[0].z, r[1].z, r[2].z, r[3].z);
+            const auto sx = sin(rx);
+            const auto cx = cos(rx);
+            const auto sy = sin(ry);
+            const auto cy = cos(ry);
+            const auto sz = sin(rz);
+            const auto cz = cos(rz);
+
+            // Same columns as make_rotation_columns
+            const auto sx_sy = sx * sy;
+            const auto cx_sy = cx * sy;
+            const Float4 column_x[3] = {cy * cz, sx_sy * cz + cx * sz, sx * sz - cx_sy * cz};
+            const Float4 column_y[3] = {splat(0) - cy * sz, cx * cz - sx_sy * sz, cx_sy * sz + sx * cz};
+            const Float4 column_z[3] = {sy, splat(0) - sx * cy, cx * cy};
+
+            const auto scale_x = set(s[0].x, s[1].x, s[2].x, s[3].x);
+            const auto scale_y = set(s[0].y, s[1].y, s[2].y, s[3].y);
+            const auto scale_z = set(s[0].z, s[1].z, s[2].z, s[3].z);
+
+            const auto zero = splat(0);
+            const auto one = splat(1);
+
+            auto* model = &model_matrices[i];
+            store_column(column_x[0] * scale_x, column_x[1] * scale_x, column_x[2] * scale_x, zero, model, 0);
+            store_column(column_y[0] * scale_y, column_y[1] * scale_y, column_y[2] * scale_y, zero, model, 1);
+            store_column(column_z[0] * scale_z, column_z[1] * scale_z, column_z[2] * scale_z, zero, model, 2);
+            store_column(set(p[0].x, p[1].x, p[2].x, p[3].x),
+                         set(p[0].y, p[1].y, p[2].y, p[3].y),
+                         set(p[0].z, p[1].z, p[2].z, p[3].z),
+                         one,
+                         model,
+                         3);
+
+            if(with_normals) {
+                auto* normal = &normal_matrices[i];
+                store_column(column_x[0] / scale_x, column_x[1] / scale_x, column_x[2] / scale_x, zero, normal, 0);
+                store_column(column_y[0] / scale_y, column_y[1] / scale_y, column_y[2] / scale_y, zero, normal, 1);
+                store_column(column_z[0] / scale_z, column_z[1] / scale_z, column_z[2] / scale_z, zero, normal, 2);
+                store_column(zero, zero, zero, one, normal, 3);
+            }
+        }
+#endif
+
+        for(; i < model_matrices.size(); i++) {
+            make_model_matrix(positions[i], rotations[i], scales[i], model_matrices[i], with_normals ? &normal_matrices[i] : nullptr);
+        }
     }
 } // namespace nova::renderer
@@ -2,19 +2,23 @@
 
 #include "nova_renderer/loading/renderpack_loading.hpp"
 #include "nova_renderer/nova_renderer.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+
+#include "../dynamic_resolution.hpp"
+#include "../frame_upload_allocator.hpp"
 
 namespace nova::renderer {
     RX_LOG("BackbufferOut", logger);
 
     struct RX_HINT_EMPTY_BASES BackbufferOutputRenderpassCreateInfo : renderpack::RenderPassCreateInfo {
-        BackbufferOutputRenderpassCreateInfo();
+        explicit BackbufferOutputRenderpassCreateInfo(const char* scene_output_name = SCENE_OUTPUT_RT_NAME);
     };
 
-    BackbufferOutputRenderpassCreateInfo::BackbufferOutputRenderpassCreateInfo() {
+    BackbufferOutputRenderpassCreateInfo::BackbufferOutputRenderpassCreateInfo(const char* scene_output_name) {
         name = BACKBUFFER_OUTPUT_RENDER_PASS_NAME;
         texture_inputs.reserve(2);
         texture_inputs.emplace_back(UI_OUTPUT_RT_NAME);
-        texture_inputs.emplace_back(SCENE_OUTPUT_RT_NAME);
+        texture_inputs.emplace_back(scene_output_name);
 
         texture_outputs.reserve(1);
         texture_outputs.emplace_back(BACKBUFFER_NAME, rhi::PixelFormat::Rgba8, false);
@@ -23,62 +27,53 @@ namespace nova::renderer {
         pipeline_names.emplace_back(BACKBUFFER_OUTPUT_PIPELINE_NAME);
     }
 
+    /*!
+     * \brief Matches `BackbufferOutputParams` in the backbuffer output shader
+     */
+    struct BackbufferOutputParams {
+        glm::vec2 scene_uv_scale;
+        glm::vec2 max_scene_uv;
+    };
+
     rx::global<BackbufferOutputRenderpassCreateInfo> backbuffer_output_create_info{"Nova", "BackbufferOutputCreateInfo"};
+    rx::global<BackbufferOutputRenderpassCreateInfo> upscaled_backbuffer_output_create_info{"Nova",
+                                                                                            "UpscaledBackbufferOutputCreateInfo",
+                                                                                            UPSCALED_OUTPUT_RT_NAME};
 
     BackbufferOutputRenderpass::BackbufferOutputRenderpass(rhi::RhiImage* ui_output,
                                                            rhi::RhiImage* scene_output,
-                                                           rhi::RhiSampler* point_sampler,
+                                                           const glm::uvec2& scene_output_size,
+                                                           rhi::RhiSampler* sampler,
                                                            std::unique_ptr<rhi::RhiPipeline> pipeline,
                                                            MeshId mesh,
-                                                           rhi::RenderDevice& device)
-        : GlobalRenderpass(BACKBUFFER_OUTPUT_RENDER_PASS_NAME, std::move(pipeline), mesh, true) {
+                                                           rhi::RenderDevice& device,
+                                                           const bool is_upscaled)
+        : GlobalRenderpass(BACKBUFFER_OUTPUT_RENDER_PASS_NAME, std::move(pipeline), mesh, true),
+          scene_output_size{scene_output_size},
+          is_upscaled{is_upscaled} {
+        // The parameters come from the frame upload allocator, which only the main thread may use
+        supports_parallel_recording = false;
+
         resource_binder = device.create_resource_binder_for_pipeline(*(this->pipeline), device.get_allocator());
 
         resource_binder->bind_image("ui_output", ui_output);
         resource_binder->bind_image("scene_output", scene_output);
-        resource_binder->bind_sampler("tex_sampler", point_sampler);
-
-        rhi::RhiResourceBarrier pre_pass_barrier;
-        pre_pass_barrier.access_before_barrier = rhi::ResourceAccess::ColorAttachmentWrite;
-        pre_pass_barrier.access_after_barrier = rhi::ResourceAccess::ShaderRead;
-        pre_pass_barrier.old_state = rhi::ResourceState::RenderTarget;
-        pre_pass_barrier.new_state = rhi::ResourceState::ShaderRead;
-        pre_pass_barrier.source_queue = rhi::QueueType::Graphics;
-        pre_pass_barrier.destination_queue = rhi::QueueType::Graphics;
-        pre_pass_barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
-
-        read_texture_barriers.reserve(2);
-
-        pre_pass_barrier.resource_to_barrier = ui_output;
-        read_texture_barriers.push_back(pre_pass_barrier);
-
-        pre_pass_barrier.resource_to_barrier = scene_output;
-        read_texture_barriers.push_back(pre_pass_barrier);
-
-        rhi::RhiResourceBarrier post_pass_barrier;
-        post_pass_barrier.access_before_barrier = rhi::ResourceAccess::ShaderRead;
-        post_pass_barrier.access_after_barrier = rhi::ResourceAccess::ColorAttachmentWrite;
-        post_pass_barrier.old_state = rhi::ResourceState::ShaderRead;
-        post_pass_barrier.new_state = rhi::ResourceState::RenderTarget;
-        post_pass_barrier.source_queue = rhi::QueueType::Graphics;
-        post_pass_barrier.destination_queue = rhi::QueueType::Graphics;
-        post_pass_barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
+        resource_binder->bind_sampler("tex_sampler", sampler);
+    }
 
-        post_pass_barriers.reserve(2);
+    void BackbufferOutputRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        const glm::vec2 full_size{scene_output_size};
+        const glm::vec2 scaled_size{scale_resolution(scene_output_size, is_upscaled ? 1.0f : ctx.resolution_scale)};
 
-        post_pass_barrier.resource_to_barrier = ui_output;
-        post_pass_barriers.push_back(post_pass_barrier);
+        const BackbufferOutputParams params{.scene_uv_scale = scaled_size / full_size, .max_scene_uv = (scaled_size - 0.5f) / full_size};
+        if(const auto upload = ctx.frame_uploads->upload(&params, sizeof(params)); upload) {
+            resource_binder->bind_buffer_range("params", upload->buffer, upload->offset, upload->size);
+        }
 
-        post_pass_barrier.resource_to_barrier = scene_output;
-        post_pass_barriers.push_back(post_pass_barrier);
+        GlobalRenderpass::record_renderpass_contents(cmds, ctx);
     }
 
-    const renderpack::RenderPassCreateInfo& BackbufferOutputRenderpass::get_create_info() { return *backbuffer_output_create_info; }
-
-    void BackbufferOutputRenderpass::record_post_renderpass_barriers(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
-        Renderpass::record_post_renderpass_barriers(cmds, ctx);
-
-        // TODO: Figure out how to make the backend deal with the barriers
-        cmds.resource_barriers(rhi::PipelineStage::FragmentShader, rhi::PipelineStage::ColorAttachmentOutput, post_pass_barriers);
+    const renderpack::RenderPassCreateInfo& BackbufferOutputRenderpass::get_create_info(const bool is_upscaled) {
+        return is_upscaled ? *upscaled_backbuffer_output_create_info : *backbuffer_output_create_info;
     }
 } // namespace nova::renderer
@@ -6,17 +6,30 @@ namespace nova::renderer {
     public:
         explicit BackbufferOutputRenderpass(rhi::RhiImage* ui_output,
                                             rhi::RhiImage* scene_output,
-                                            rhi::RhiSampler* point_sampler,
+                                            const glm::uvec2& scene_output_size,
+                                            rhi::RhiSampler* sampler,
                                             std::unique_ptr<rhi::RhiPipeline> pipeline,
                                             MeshId mesh,
-                                            rhi::RenderDevice& device);
+                                            rhi::RenderDevice& device,
+                                            bool is_upscaled = false);
 
-        static const renderpack::RenderPassCreateInfo& get_create_info();
+        /*!
+         * \brief The create info for showing the scene output, or for showing the temporal upscaler's output instead
+         */
+        static const renderpack::RenderPassCreateInfo& get_create_info(bool is_upscaled = false);
 
     protected:
-        void record_post_renderpass_barriers(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const override;
+        /*!
+         * \brief Tells the shader how much of the scene output the scene rendered to this frame, then draws the fullscreen triangle
+         */
+        void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) override;
 
     private:
-        std::vector<rhi::RhiResourceBarrier> post_pass_barriers;
+        glm::uvec2 scene_output_size;
+
+        /*!
+         * \brief Whether the scene output is the temporal upscaler's output, which is always full of upscaled scene
+         */
+        bool is_upscaled;
     };
 } // namespace nova::renderer
@@ -0,0 +1,57 @@
+#include "bilateral_upsample_pass.hpp"
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../builtin_shaders.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("BilateralUpsample");
+
+    /*!
+     * \brief Each group fills in an 8x8 block of the destination
+     */
+    constexpr uint32_t GROUP_SIZE = 8;
+
+    BilateralUpsampleRenderpass::BilateralUpsampleRenderpass(const std::string& name,
+                                                             std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                                             rhi::RhiImage* source,
+                                                             rhi::RhiImage* depth,
+                                                             rhi::RhiImage* destination,
+                                                             const glm::uvec2 destination_size,
+                                                             rhi::RenderDevice& device)
+        : ComputeRenderpass{name,
+                            std::move(pipeline),
+                            {(destination_size.x + GROUP_SIZE - 1) / GROUP_SIZE, (destination_size.y + GROUP_SIZE - 1) / GROUP_SIZE, 1},
+                            device,
+                            true} {
+        auto& binder = get_resource_binder();
+        binder.bind_image("source", source);
+        binder.bind_image("depth", depth);
+        binder.bind_image("destination", destination);
+    }
+
+    std::optional<renderpack::RenderPassCreateInfo> BilateralUpsampleRenderpass::get_create_info(
+        const renderpack::UpsampledOutput& output, const rhi::PixelFormat destination_format) {
+        ZoneScoped;
+        auto spirv = load_builtin_shader("bilateral_upsample.compute.hlsl", rhi::ShaderStage::Compute);
+        if(spirv.empty()) {
+            logger->error("Could not compile the bilateral upsample shader");
+            return std::nullopt;
+        }
+
+        renderpack::RenderPassCreateInfo create_info;
+        create_info.name = std::string{BILATERAL_UPSAMPLE_PASS_PREFIX} + output.destination;
+        create_info.texture_inputs.emplace_back(output.source);
+        create_info.texture_inputs.emplace_back(output.depth);
+        create_info.texture_outputs.emplace_back(output.destination, destination_format, false);
+        create_info.compute_shader = renderpack::RenderpackShaderSource{"/nova/shaders/bilateral_upsample.compute.hlsl", std::move(spirv)};
+
+        return create_info;
+    }
+} // namespace nova::renderer
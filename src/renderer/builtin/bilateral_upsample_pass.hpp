@@ -0,0 +1,43 @@
+#pragma once
+
+#include "nova_renderer/rendergraph.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Upsamples one reduced-resolution output of a renderpack pass into a full-resolution texture, guided by depth
+     *
+     * Each pixel blends the four low-resolution texels that a bilinear filter would, but weighs each of them down by how far the depth
+     * under it is from the pixel's own depth. Texels from the other side of a silhouette barely count, so things like ambient occlusion
+     * and volumetrics don't smear across edges. Nova adds one of these after a pass for each of its `upsampleOutputs`
+     */
+    class BilateralUpsampleRenderpass final : public ComputeRenderpass {
+    public:
+        /*!
+         * \param name The name of this pass, from `get_create_info`
+         * \param pipeline The pipeline from `get_create_info`'s compute shader
+         * \param source The low-resolution texture to upsample
+         * \param depth The full-resolution depth texture
+         * \param destination The full-resolution texture to write to
+         * \param destination_size The size of `destination`
+         * \param device The device to create this renderpass's resource binder with
+         */
+        BilateralUpsampleRenderpass(const std::string& name,
+                                    std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                    rhi::RhiImage* source,
+                                    rhi::RhiImage* depth,
+                                    rhi::RhiImage* destination,
+                                    glm::uvec2 destination_size,
+                                    rhi::RenderDevice& device);
+
+        /*!
+         * \brief Makes the create info of a pass that upsamples the provided output
+         *
+         * \param output The output to upsample
+         * \param destination_format The pixel format of the output's destination texture
+         *
+         * \return The create info, or nothing if the shader didn't compile
+         */
+        [[nodiscard]] static std::optional<renderpack::RenderPassCreateInfo> get_create_info(const renderpack::UpsampledOutput& output,
+                                                                                             rhi::PixelFormat destination_format);
+    };
+} // namespace nova::renderer
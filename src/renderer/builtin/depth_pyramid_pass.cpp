@@ -0,0 +1,92 @@
+#include "depth_pyramid_pass.hpp"
+
+#include <array>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../builtin_shaders.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("DepthPyramid");
+
+    /*!
+     * \brief Each group reduces a 32x32 block of the first mip it writes, and 256 threads do four texels of that each
+     */
+    constexpr uint32_t TILE_SIZE = 32;
+
+    DepthPyramidRenderpass::DepthPyramidRenderpass(std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                                   rhi::RhiImage* depth,
+                                                   rhi::RhiImage* pyramid,
+                                                   const glm::uvec2 pyramid_size,
+                                                   rhi::RhiBuffer* counter,
+                                                   rhi::RenderDevice& device)
+        : ComputeRenderpass{DEPTH_PYRAMID_PASS_NAME,
+                            std::move(pipeline),
+                            {(pyramid_size.x + TILE_SIZE - 1) / TILE_SIZE, (pyramid_size.y + TILE_SIZE - 1) / TILE_SIZE, 1},
+                            device,
+                            true},
+          counter{counter} {
+        auto& binder = get_resource_binder();
+        binder.bind_image("depth", depth);
+        binder.bind_image_mips("pyramid", pyramid);
+        binder.bind_image_mips("shared_mip", pyramid, 5);
+        binder.bind_buffer("num_finished_groups", counter);
+    }
+
+    std::optional<renderpack::RenderPassCreateInfo> DepthPyramidRenderpass::get_create_info(const std::string& depth_texture_name,
+                                                                                            const rhi::DeviceInfo& device_info) {
+        ZoneScoped;
+        std::vector<std::string> defines;
+        if(device_info.supports_compute_quad_operations) {
+            defines.emplace_back("USE_QUAD_OPERATIONS");
+        }
+
+        auto spirv = load_builtin_shader("depth_pyramid.compute.hlsl", rhi::ShaderStage::Compute, defines);
+        if(spirv.empty()) {
+            logger->error("Could not compile the depth pyramid shader");
+            return std::nullopt;
+        }
+
+        renderpack::RenderPassCreateInfo create_info;
+        create_info.name = DEPTH_PYRAMID_PASS_NAME;
+        create_info.texture_inputs.emplace_back(depth_texture_name);
+        create_info.texture_outputs.emplace_back(HI_Z_RT_NAME, rhi::PixelFormat::Rg32F, false);
+        create_info.compute_shader = renderpack::RenderpackShaderSource{"/nova/shaders/depth_pyramid.compute.hlsl", std::move(spirv)};
+
+        return create_info;
+    }
+
+    renderpack::TextureCreateInfo DepthPyramidRenderpass::get_pyramid_create_info() {
+        return {.name = HI_Z_RT_NAME,
+                .usage = renderpack::ImageUsage::RenderTarget,
+                .format = {.pixel_format = rhi::PixelFormat::Rg32F,
+                           .dimension_type = renderpack::TextureDimensionType::ScreenRelative,
+                           .width = 0.5f,
+                           .height = 0.5f},
+                .num_mips = MAX_NUM_MIPS};
+    }
+
+    void DepthPyramidRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        rhi::RhiResourceBarrier counter_barrier = {};
+        counter_barrier.resource_to_barrier = counter;
+        counter_barrier.old_state = rhi::ResourceState::Common;
+        counter_barrier.new_state = rhi::ResourceState::Common;
+        counter_barrier.access_before_barrier = rhi::ResourceAccess::ShaderWrite;
+        counter_barrier.access_after_barrier = rhi::ResourceAccess::ShaderWrite;
+        counter_barrier.source_queue = rhi::QueueType::Graphics;
+        counter_barrier.destination_queue = rhi::QueueType::Graphics;
+        counter_barrier.buffer_memory_barrier.offset = 0;
+        counter_barrier.buffer_memory_barrier.size = counter->size;
+
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader, rhi::PipelineStage::ComputeShader, std::array{counter_barrier});
+
+        ComputeRenderpass::record_renderpass_contents(cmds, ctx);
+    }
+} // namespace nova::renderer
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "nova_renderer/rendergraph.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Builds `HI_Z_RT_NAME` from the scene's depth, every mip of it in one dispatch
+     *
+     * Each thread group reduces a 64x64 block of depth to mips 0 through 5, without leaving group shared memory. The last group to finish
+     * finds out with an atomic counter, and reduces mip 5 to the rest of the mips. That's one dispatch and no barriers, where a pass per
+     * mip would need a dozen of each. On devices with compute quad operations, mip 1 comes straight from the lanes of each quad
+     *
+     * The pyramid covers the whole depth texture, so with dynamic resolution its edges hold whatever was there before
+     */
+    class DepthPyramidRenderpass final : public ComputeRenderpass {
+    public:
+        static constexpr uint32_t MAX_NUM_MIPS = 12;
+
+        /*!
+         * \param pipeline The pipeline from `get_create_info`'s compute shader
+         * \param depth The depth texture to build the pyramid from
+         * \param pyramid The depth pyramid, from `get_pyramid_create_info`
+         * \param pyramid_size The size of the pyramid's mip 0
+         * \param counter A buffer of one uint, which must start out as zero. The shader sets it back to zero when it's done
+         * \param device The device to create this renderpass's resource binder with
+         */
+        DepthPyramidRenderpass(std::unique_ptr<rhi::RhiPipeline> pipeline,
+                               rhi::RhiImage* depth,
+                               rhi::RhiImage* pyramid,
+                               glm::uvec2 pyramid_size,
+                               rhi::RhiBuffer* counter,
+                               rhi::RenderDevice& device);
+
+        /*!
+         * \brief Makes the create info of a depth pyramid pass that reads the provided depth texture
+         *
+         * \return The create info, or nothing if the shader didn't compile
+         */
+        [[nodiscard]] static std::optional<renderpack::RenderPassCreateInfo> get_create_info(const std::string& depth_texture_name,
+                                                                                             const rhi::DeviceInfo& device_info);
+
+        /*!
+         * \brief The create info of `HI_Z_RT_NAME`, for renderpacks that use the depth pyramid pass
+         */
+        [[nodiscard]] static renderpack::TextureCreateInfo get_pyramid_create_info();
+
+    protected:
+        /*!
+         * \brief Waits for last frame's dispatch to reset the counter, then dispatches
+         */
+        void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) override;
+
+    private:
+        rhi::RhiBuffer* counter;
+    };
+} // namespace nova::renderer
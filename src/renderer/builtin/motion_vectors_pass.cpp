@@ -0,0 +1,96 @@
+#include "motion_vectors_pass.hpp"
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../builtin_shaders.hpp"
+#include "../dynamic_resolution.hpp"
+#include "../frame_upload_allocator.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("MotionVectors");
+
+    /*!
+     * \brief Each group fills in an 8x8 block of the motion vectors
+     */
+    constexpr uint32_t GROUP_SIZE = 8;
+
+    /*!
+     * \brief Matches `MotionVectorParams` in the shader. The jitter is in NDC
+     */
+    struct MotionVectorParams {
+        glm::uvec2 render_size;
+        glm::vec2 jitter;
+        glm::vec2 previous_jitter;
+        glm::uvec2 padding;
+    };
+
+    CameraMotionVectorsRenderpass::CameraMotionVectorsRenderpass(std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                                                 rhi::RhiImage* depth,
+                                                                 rhi::RhiImage* motion_vectors,
+                                                                 const glm::uvec2 size,
+                                                                 rhi::RenderDevice& device)
+        : ComputeRenderpass{CAMERA_MOTION_VECTORS_PASS_NAME,
+                            std::move(pipeline),
+                            {(size.x + GROUP_SIZE - 1) / GROUP_SIZE, (size.y + GROUP_SIZE - 1) / GROUP_SIZE, 1},
+                            device,
+                            true},
+          size{size} {
+        // The parameters come from the frame upload allocator, which only the main thread may use
+        supports_parallel_recording = false;
+
+        auto& binder = get_resource_binder();
+        binder.bind_image("depth", depth);
+        binder.bind_image("motion_vectors", motion_vectors);
+    }
+
+    std::optional<renderpack::RenderPassCreateInfo> CameraMotionVectorsRenderpass::get_create_info(const std::string& depth_texture_name) {
+        ZoneScoped;
+        auto spirv = load_builtin_shader("camera_motion_vectors.compute.hlsl", rhi::ShaderStage::Compute);
+        if(spirv.empty()) {
+            logger->error("Could not compile the camera motion vectors shader");
+            return std::nullopt;
+        }
+
+        renderpack::RenderPassCreateInfo create_info;
+        create_info.name = CAMERA_MOTION_VECTORS_PASS_NAME;
+        create_info.texture_inputs.emplace_back(depth_texture_name);
+        create_info.texture_outputs.emplace_back(MOTION_VECTORS_RT_NAME, rhi::PixelFormat::Rg32F, false);
+        create_info.compute_shader = renderpack::RenderpackShaderSource{"/nova/shaders/camera_motion_vectors.compute.hlsl",
+                                                                        std::move(spirv)};
+
+        return create_info;
+    }
+
+    renderpack::TextureCreateInfo CameraMotionVectorsRenderpass::get_motion_vectors_create_info() {
+        return {.name = MOTION_VECTORS_RT_NAME,
+                .usage = renderpack::ImageUsage::RenderTarget,
+                .format = {.pixel_format = rhi::PixelFormat::Rg32F,
+                           .dimension_type = renderpack::TextureDimensionType::ScreenRelative,
+                           .width = 1,
+                           .height = 1}};
+    }
+
+    void CameraMotionVectorsRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        const auto render_size = scale_resolution(size, ctx.resolution_scale);
+        const glm::vec2 ndc_per_pixel = 2.0f / glm::vec2{render_size};
+
+        const MotionVectorParams params{.render_size = render_size,
+                                        .jitter = ctx.camera_jitter * ndc_per_pixel,
+                                        .previous_jitter = ctx.previous_camera_jitter * ndc_per_pixel,
+                                        .padding = {}};
+        if(const auto upload = ctx.frame_uploads->upload(&params, sizeof(params)); upload) {
+            resource_binder->bind_buffer_range("params", upload->buffer, upload->offset, upload->size);
+        }
+
+        // Every frame slot has its own camera buffer
+        resource_binder->bind_buffer("cameras", ctx.camera_matrix_buffer);
+
+        ComputeRenderpass::record_renderpass_contents(cmds, ctx);
+    }
+} // namespace nova::renderer
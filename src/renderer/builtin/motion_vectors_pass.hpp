@@ -0,0 +1,48 @@
+#pragma once
+
+#include "nova_renderer/rendergraph.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Fills `MOTION_VECTORS_RT_NAME` with how the main camera moved since last frame, worked out from the scene's depth
+     *
+     * Every pixel is treated as if its surface stayed still, so moving renderables get the camera's motion instead of their own. Nova only
+     * adds this pass when no renderpack pass writes the motion vectors itself
+     */
+    class CameraMotionVectorsRenderpass final : public ComputeRenderpass {
+    public:
+        /*!
+         * \param pipeline The pipeline from `get_create_info`'s compute shader
+         * \param depth The depth texture to reproject
+         * \param motion_vectors `MOTION_VECTORS_RT_NAME`
+         * \param size The size of both textures
+         * \param device The device to create this renderpass's resource binder with
+         */
+        CameraMotionVectorsRenderpass(std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                      rhi::RhiImage* depth,
+                                      rhi::RhiImage* motion_vectors,
+                                      glm::uvec2 size,
+                                      rhi::RenderDevice& device);
+
+        /*!
+         * \brief Makes the create info of a camera motion vectors pass that reads the provided depth texture
+         *
+         * \return The create info, or nothing if the shader didn't compile
+         */
+        [[nodiscard]] static std::optional<renderpack::RenderPassCreateInfo> get_create_info(const std::string& depth_texture_name);
+
+        /*!
+         * \brief The create info of `MOTION_VECTORS_RT_NAME`, for renderpacks that don't declare it themselves
+         */
+        [[nodiscard]] static renderpack::TextureCreateInfo get_motion_vectors_create_info();
+
+    protected:
+        /*!
+         * \brief Tells the shader how much of the screen the scene covers, and how the camera was jittered this frame and last
+         */
+        void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) override;
+
+    private:
+        glm::uvec2 size;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,58 @@
+#include "oit_composite_pass.hpp"
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../builtin_shaders.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("OitComposite");
+
+    /*!
+     * \brief Each group composites an 8x8 block of the destination
+     */
+    constexpr uint32_t GROUP_SIZE = 8;
+
+    OitCompositeRenderpass::OitCompositeRenderpass(const std::string& name,
+                                                   std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                                   rhi::RhiImage* accumulation,
+                                                   rhi::RhiImage* coverage,
+                                                   rhi::RhiImage* destination,
+                                                   const glm::uvec2 destination_size,
+                                                   rhi::RenderDevice& device)
+        : ComputeRenderpass{name,
+                            std::move(pipeline),
+                            {(destination_size.x + GROUP_SIZE - 1) / GROUP_SIZE, (destination_size.y + GROUP_SIZE - 1) / GROUP_SIZE, 1},
+                            device,
+                            true} {
+        auto& binder = get_resource_binder();
+        binder.bind_image("accumulation", accumulation);
+        binder.bind_image("coverage", coverage);
+        binder.bind_image("destination", destination);
+    }
+
+    std::optional<renderpack::RenderPassCreateInfo> OitCompositeRenderpass::get_create_info(const std::string& pass_name,
+                                                                                            const std::string& destination,
+                                                                                            const rhi::PixelFormat destination_format) {
+        ZoneScoped;
+        auto spirv = load_builtin_shader("oit_composite.compute.hlsl", rhi::ShaderStage::Compute);
+        if(spirv.empty()) {
+            logger->error("Could not compile the order-independent transparency composite shader");
+            return std::nullopt;
+        }
+
+        renderpack::RenderPassCreateInfo create_info;
+        create_info.name = std::string{OIT_COMPOSITE_PASS_PREFIX} + pass_name;
+        create_info.texture_inputs.emplace_back(std::string{OIT_ACCUMULATION_RT_PREFIX} + pass_name);
+        create_info.texture_inputs.emplace_back(std::string{OIT_COVERAGE_RT_PREFIX} + pass_name);
+        create_info.texture_outputs.emplace_back(destination, destination_format, false);
+        create_info.compute_shader = renderpack::RenderpackShaderSource{"/nova/shaders/oit_composite.compute.hlsl", std::move(spirv)};
+
+        return create_info;
+    }
+} // namespace nova::renderer
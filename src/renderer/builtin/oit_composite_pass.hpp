@@ -0,0 +1,45 @@
+#pragma once
+
+#include "nova_renderer/rendergraph.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Blends what a pass with `orderIndependentTransparency` drew over that pass's color output
+     *
+     * The pass's pipelines add their weighted colors into an accumulation texture, and blend how much of the background they cover
+     * into a coverage texture. This pass turns the sum of the weighted colors into their average, then blends that over the destination
+     * by the total coverage
+     */
+    class OitCompositeRenderpass final : public ComputeRenderpass {
+    public:
+        /*!
+         * \param name The name of this pass, from `get_create_info`
+         * \param pipeline The pipeline from `get_create_info`'s compute shader
+         * \param accumulation The texture that the transparent pass added its weighted colors into
+         * \param coverage The texture that the transparent pass wrote its coverage into
+         * \param destination The transparent pass's real color output
+         * \param destination_size The size of `destination`
+         * \param device The device to create this renderpass's resource binder with
+         */
+        OitCompositeRenderpass(const std::string& name,
+                               std::unique_ptr<rhi::RhiPipeline> pipeline,
+                               rhi::RhiImage* accumulation,
+                               rhi::RhiImage* coverage,
+                               rhi::RhiImage* destination,
+                               glm::uvec2 destination_size,
+                               rhi::RenderDevice& device);
+
+        /*!
+         * \brief Makes the create info of a pass that composites the transparency of the provided pass
+         *
+         * \param pass_name The name of the pass with order-independent transparency
+         * \param destination The name of the texture that the pass's transparency goes over
+         * \param destination_format The pixel format of `destination`
+         *
+         * \return The create info, or nothing if the shader didn't compile
+         */
+        [[nodiscard]] static std::optional<renderpack::RenderPassCreateInfo> get_create_info(const std::string& pass_name,
+                                                                                             const std::string& destination,
+                                                                                             rhi::PixelFormat destination_format);
+    };
+} // namespace nova::renderer
@@ -0,0 +1,110 @@
+#include "shading_rate_pass.hpp"
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../builtin_shaders.hpp"
+#include "../dynamic_resolution.hpp"
+#include "../frame_upload_allocator.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("ShadingRate");
+
+    /*!
+     * \brief Matches `ShadingRateParams` in the shader
+     */
+    struct ShadingRateParams {
+        glm::uvec2 render_size;
+        uint32_t texel_size;
+        uint32_t has_motion_vectors;
+        float contrast_threshold;
+        float motion_threshold;
+        glm::uvec2 padding;
+    };
+
+    /*!
+     * \brief How many tiles of `texel_size` it takes to cover `size`
+     */
+    static glm::uvec2 get_num_tiles(const glm::uvec2 size, const uint32_t texel_size) {
+        return (size + texel_size - 1U) / texel_size;
+    }
+
+    ShadingRateRenderpass::ShadingRateRenderpass(std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                                 rhi::RhiImage* scene_output,
+                                                 const std::optional<rhi::RhiImage*> motion_vectors,
+                                                 rhi::RhiImage* shading_rate_image,
+                                                 const glm::uvec2 screen_size,
+                                                 const uint32_t texel_size,
+                                                 const NovaSettings::VariableRateShadingOptions& options,
+                                                 rhi::RenderDevice& device)
+        : ComputeRenderpass{SHADING_RATE_PASS_NAME,
+                            std::move(pipeline),
+                            {get_num_tiles(screen_size, texel_size), 1U},
+                            device,
+                            true},
+          screen_size{screen_size},
+          texel_size{texel_size},
+          has_motion_vectors{motion_vectors.has_value()},
+          options{options} {
+        // The parameters come from the frame upload allocator, which only the main thread may use
+        supports_parallel_recording = false;
+
+        auto& binder = get_resource_binder();
+        binder.bind_image("scene_output", scene_output);
+
+        // The shader doesn't read the motion vectors without any, but something still has to be bound there
+        binder.bind_image("motion_vectors", motion_vectors.value_or(scene_output));
+        binder.bind_image("shading_rate", shading_rate_image);
+    }
+
+    std::optional<renderpack::RenderPassCreateInfo> ShadingRateRenderpass::get_create_info(const bool reads_motion_vectors) {
+        ZoneScoped;
+        auto spirv = load_builtin_shader("adaptive_shading_rate.compute.hlsl", rhi::ShaderStage::Compute);
+        if(spirv.empty()) {
+            logger->error("Could not compile the shading rate shader");
+            return std::nullopt;
+        }
+
+        renderpack::RenderPassCreateInfo create_info;
+        create_info.name = SHADING_RATE_PASS_NAME;
+        create_info.texture_inputs.emplace_back(SCENE_OUTPUT_RT_NAME);
+        if(reads_motion_vectors) {
+            create_info.texture_inputs.emplace_back(MOTION_VECTORS_RT_NAME);
+        }
+        create_info.texture_outputs.emplace_back(SHADING_RATE_RT_NAME, rhi::PixelFormat::R8Uint, false);
+        create_info.compute_shader = renderpack::RenderpackShaderSource{"/nova/shaders/adaptive_shading_rate.compute.hlsl",
+                                                                        std::move(spirv)};
+
+        return create_info;
+    }
+
+    renderpack::TextureCreateInfo ShadingRateRenderpass::get_shading_rate_image_create_info(const glm::uvec2 screen_size,
+                                                                                            const uint32_t texel_size) {
+        const auto num_tiles = get_num_tiles(screen_size, texel_size);
+        return {.name = SHADING_RATE_RT_NAME,
+                .usage = renderpack::ImageUsage::RenderTarget,
+                .format = {.pixel_format = rhi::PixelFormat::R8Uint,
+                           .dimension_type = renderpack::TextureDimensionType::Absolute,
+                           .width = static_cast<float>(num_tiles.x),
+                           .height = static_cast<float>(num_tiles.y)}};
+    }
+
+    void ShadingRateRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        const ShadingRateParams params{.render_size = scale_resolution(screen_size, ctx.resolution_scale),
+                                       .texel_size = texel_size,
+                                       .has_motion_vectors = has_motion_vectors ? 1U : 0U,
+                                       .contrast_threshold = options.contrast_threshold,
+                                       .motion_threshold = options.motion_threshold,
+                                       .padding = {}};
+        if(const auto upload = ctx.frame_uploads->upload(&params, sizeof(params)); upload) {
+            resource_binder->bind_buffer_range("params", upload->buffer, upload->offset, upload->size);
+        }
+
+        ComputeRenderpass::record_renderpass_contents(cmds, ctx);
+    }
+} // namespace nova::renderer
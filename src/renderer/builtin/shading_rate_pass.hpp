@@ -0,0 +1,66 @@
+#pragma once
+
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/rendergraph.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Fills in `SHADING_RATE_RT_NAME` from how much detail and motion each tile of the scene had this frame
+     *
+     * Tiles with barely any contrast, or that moved a long way, get a coarser rate than tiles full of detail. The image is used by the
+     * next frame's passes, so this runs after everything else, and a tile that suddenly gets busy shades coarsely for one frame. Nova only
+     * adds this pass when a renderpack pass has an adaptive shading rate and the device can read a shading rate image
+     */
+    class ShadingRateRenderpass final : public ComputeRenderpass {
+    public:
+        /*!
+         * \param pipeline The pipeline from `get_create_info`'s compute shader
+         * \param scene_output `SCENE_OUTPUT_RT_NAME`
+         * \param motion_vectors `MOTION_VECTORS_RT_NAME`, if something writes it
+         * \param shading_rate_image `SHADING_RATE_RT_NAME`
+         * \param screen_size The size of the scene output
+         * \param texel_size How many pixels wide and tall the tile under each texel of the shading rate image is
+         * \param options The thresholds to pick rates with
+         * \param device The device to create this renderpass's resource binder with
+         */
+        ShadingRateRenderpass(std::unique_ptr<rhi::RhiPipeline> pipeline,
+                              rhi::RhiImage* scene_output,
+                              std::optional<rhi::RhiImage*> motion_vectors,
+                              rhi::RhiImage* shading_rate_image,
+                              glm::uvec2 screen_size,
+                              uint32_t texel_size,
+                              const NovaSettings::VariableRateShadingOptions& options,
+                              rhi::RenderDevice& device);
+
+        /*!
+         * \brief Makes the create info of the shading rate pass
+         *
+         * \param reads_motion_vectors Whether the pass should look at `MOTION_VECTORS_RT_NAME`
+         *
+         * \return The create info, or nothing if the shader didn't compile
+         */
+        [[nodiscard]] static std::optional<renderpack::RenderPassCreateInfo> get_create_info(bool reads_motion_vectors);
+
+        /*!
+         * \brief The create info of `SHADING_RATE_RT_NAME`, with one texel for every tile of the screen
+         *
+         * The image is sized in texels, not as a fraction of the screen, so it has to be made again when the screen changes size
+         */
+        [[nodiscard]] static renderpack::TextureCreateInfo get_shading_rate_image_create_info(glm::uvec2 screen_size, uint32_t texel_size);
+
+    protected:
+        /*!
+         * \brief Tells the shader how much of the scene output was rendered to, and which thresholds to use
+         */
+        void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) override;
+
+    private:
+        glm::uvec2 screen_size;
+
+        uint32_t texel_size;
+
+        bool has_motion_vectors;
+
+        NovaSettings::VariableRateShadingOptions options;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,53 @@
+#include "temporal_upscale_pass.hpp"
+
+#include <Tracy.hpp>
+
+#include "nova_renderer/constants.hpp"
+
+#include "../dynamic_resolution.hpp"
+
+namespace nova::renderer {
+    TemporalUpscaleRenderpass::TemporalUpscaleRenderpass(TemporalUpscaler& upscaler, const TemporalUpscaleInputs& inputs)
+        : Renderpass{TEMPORAL_UPSCALE_PASS_NAME, true}, upscaler{upscaler}, inputs{inputs} {
+        // Upscalers may upload their parameters through the frame upload allocator, which only the main thread may use
+        supports_parallel_recording = false;
+
+        texture_read_stages = rhi::PipelineStage::ComputeShader;
+
+        // The pass is made again whenever a renderpack is loaded or the window is resized, and neither leaves any useful history
+        this->inputs.reset_history = true;
+    }
+
+    renderpack::RenderPassCreateInfo TemporalUpscaleRenderpass::get_create_info(const std::string& depth_texture_name) {
+        renderpack::RenderPassCreateInfo create_info;
+        create_info.name = TEMPORAL_UPSCALE_PASS_NAME;
+        create_info.texture_inputs.emplace_back(SCENE_OUTPUT_RT_NAME);
+        create_info.texture_inputs.emplace_back(depth_texture_name);
+        create_info.texture_inputs.emplace_back(MOTION_VECTORS_RT_NAME);
+        create_info.texture_outputs.emplace_back(UPSCALED_OUTPUT_RT_NAME, rhi::PixelFormat::Rgba8, false);
+
+        // The upscaler brings its own pipelines, so there's no shader. This only makes the rendergraph treat the pass as a compute pass
+        create_info.compute_shader = renderpack::RenderpackShaderSource{"/nova/shaders/temporal_upscale.compute.hlsl", {}};
+
+        return create_info;
+    }
+
+    renderpack::TextureCreateInfo TemporalUpscaleRenderpass::get_output_create_info() {
+        return {.name = UPSCALED_OUTPUT_RT_NAME,
+                .usage = renderpack::ImageUsage::RenderTarget,
+                .format = {.pixel_format = rhi::PixelFormat::Rgba8,
+                           .dimension_type = renderpack::TextureDimensionType::ScreenRelative,
+                           .width = 1,
+                           .height = 1}};
+    }
+
+    void TemporalUpscaleRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        ZoneScoped;
+        inputs.render_size = scale_resolution(inputs.input_size, ctx.resolution_scale);
+        inputs.jitter = ctx.camera_jitter;
+
+        upscaler.record_upscale(cmds, inputs, ctx);
+
+        inputs.reset_history = false;
+    }
+} // namespace nova::renderer
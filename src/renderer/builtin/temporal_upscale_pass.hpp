@@ -0,0 +1,40 @@
+#pragma once
+
+#include "nova_renderer/rendergraph.hpp"
+#include "nova_renderer/temporal_upscaler.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Hands the scene output, depth, and motion vectors to a `TemporalUpscaler`, which writes `UPSCALED_OUTPUT_RT_NAME`
+     *
+     * The pass only knows about the inputs and the output, so the rendergraph can barrier them like any other compute pass. The upscaler
+     * records whatever dispatches it wants
+     */
+    class TemporalUpscaleRenderpass final : public Renderpass {
+    public:
+        /*!
+         * \param upscaler The upscaler to run. Must outlive the pass
+         * \param inputs The textures to upscale and the texture to write to, with their sizes. The render size and jitter get filled in
+         * every frame
+         */
+        TemporalUpscaleRenderpass(TemporalUpscaler& upscaler, const TemporalUpscaleInputs& inputs);
+
+        /*!
+         * \brief Makes the create info of the temporal upscale pass, which reads the provided depth texture
+         */
+        [[nodiscard]] static renderpack::RenderPassCreateInfo get_create_info(const std::string& depth_texture_name);
+
+        /*!
+         * \brief The create info of `UPSCALED_OUTPUT_RT_NAME`, for renderpacks that use the temporal upscale pass
+         */
+        [[nodiscard]] static renderpack::TextureCreateInfo get_output_create_info();
+
+    protected:
+        void record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) override;
+
+    private:
+        TemporalUpscaler& upscaler;
+
+        TemporalUpscaleInputs inputs;
+    };
+} // namespace nova::renderer
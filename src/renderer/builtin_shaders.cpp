@@ -0,0 +1,40 @@
+#include "builtin_shaders.hpp"
+
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("BuiltinShaders");
+
+    std::vector<uint32_t> load_builtin_shader(const std::string_view name,
+                                              const rhi::ShaderStage stage,
+                                              const std::vector<std::string>& defines) {
+        ZoneScoped;
+        std::string joined_defines;
+        for(const std::string& define : defines) {
+            if(!joined_defines.empty()) {
+                joined_defines += ',';
+            }
+            joined_defines += define;
+        }
+
+        const auto shader_itr = std::find_if(EMBEDDED_SHADERS.begin(), EMBEDDED_SHADERS.end(), [&](const EmbeddedShader& shader) {
+            return shader.name == name && shader.defines == joined_defines;
+        });
+        if(shader_itr == EMBEDDED_SHADERS.end()) {
+            logger->error("Builtin shader {} with defines '{}' wasn't embedded. Add it to NOVA_BUILTIN_SHADERS", name, joined_defines);
+            return {};
+        }
+
+        if(!shader_itr->spirv.empty()) {
+            return {shader_itr->spirv.begin(), shader_itr->spirv.end()};
+        }
+
+        return renderpack::compile_shader(shader_itr->source, stage, rhi::ShaderLanguage::Hlsl, nullptr, defines);
+    }
+} // namespace nova::renderer
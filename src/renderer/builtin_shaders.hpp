@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nova_renderer/rhi/rhi_enums.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief One of Nova's own shaders, as the build embedded it into the library
+     */
+    struct EmbeddedShader {
+        /*!
+         * \brief The shader's file name in `src/shaders/builtin`, like `gpu_culling.compute.hlsl`
+         */
+        std::string_view name;
+
+        /*!
+         * \brief The defines that this variant was compiled with, separated by commas
+         */
+        std::string_view defines;
+
+        std::string_view source;
+
+        /*!
+         * \brief The SPIR-V that DXC compiled at build time. Empty if the build didn't have DXC, in which case `source` gets compiled the
+         * first time the shader is loaded
+         */
+        std::span<const uint32_t> spirv;
+    };
+
+    /*!
+     * \brief Every shader variant that the build embedded. `tools/cmake/EmbedBuiltinShaders.cmake` generates its definition
+     */
+    extern const std::span<const EmbeddedShader> EMBEDDED_SHADERS;
+
+    /*!
+     * \brief Loads the SPIR-V of one of Nova's own shaders
+     *
+     * Builds with DXC compile every variant in `NOVA_BUILTIN_SHADERS` ahead of time, so this is just a copy. Otherwise the embedded
+     * source gets compiled, and the SPIR-V cache keeps that from happening more than once per machine
+     *
+     * \param name The shader's file name in `src/shaders/builtin`
+     * \param stage The stage in the shader's file name
+     * \param defines The variant's defines, in the same order as in `NOVA_BUILTIN_SHADERS`
+     *
+     * \return The shader's SPIR-V, or nothing if the shader or that variant of it wasn't embedded or doesn't compile
+     */
+    [[nodiscard]] std::vector<uint32_t> load_builtin_shader(std::string_view name,
+                                                           rhi::ShaderStage stage,
+                                                           const std::vector<std::string>& defines = {});
+} // namespace nova::renderer
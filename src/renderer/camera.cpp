@@ -1,6 +1,28 @@
 #include "nova_renderer/camera.hpp"
 
+#include <glm/glm.hpp>
+
 namespace nova::renderer {
+    std::array<glm::vec4, 6> get_frustum_planes(const CameraUboData& camera) {
+        // Gribb and Hartmann's method. glm is column-major, so the rows of the view-projection matrix are strided through its columns
+        const auto view_projection = camera.projection * camera.view;
+        const auto row = [&](const uint32_t i) {
+            return glm::vec4{view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]};
+        };
+
+        std::array<glm::vec4, 6> planes{row(3) + row(0),
+                                        row(3) - row(0),
+                                        row(3) + row(1),
+                                        row(3) - row(1),
+                                        row(3) + row(2),
+                                        row(3) - row(2)};
+        for(auto& plane : planes) {
+            plane /= glm::length(glm::vec3{plane});
+        }
+
+        return planes;
+    }
+
     const std::string& Camera::get_name() const { return name; }
 
     Camera::Camera(const CameraCreateInfo& create_info)
@@ -0,0 +1,92 @@
+#include "chunk_section_pool.hpp"
+
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("ChunkSectionPool");
+
+    ChunkSectionPool::ChunkSectionPool(MeshArena& vertex_arena, MeshArena& index_arena, const ChunkSectionPoolCreateInfo& create_info)
+        : vertex_arena{vertex_arena},
+          index_arena{index_arena},
+          create_info{create_info},
+          slot_vertex_size{static_cast<uint64_t>(create_info.max_vertices_per_section) * create_info.vertex_size},
+          slot_index_size{static_cast<uint64_t>(create_info.max_indices_per_section) * sizeof(uint32_t)} {}
+
+    const ChunkSectionPoolCreateInfo& ChunkSectionPool::get_create_info() const { return create_info; }
+
+    uint64_t ChunkSectionPool::get_slot_vertex_size() const { return slot_vertex_size; }
+
+    uint64_t ChunkSectionPool::get_slot_index_size() const { return slot_index_size; }
+
+    std::optional<ChunkSectionPool::Slot> ChunkSectionPool::allocate_slot() {
+        if(free_slots.empty() && !add_page()) {
+            return std::nullopt;
+        }
+
+        const auto slot = free_slots.back();
+        free_slots.pop_back();
+
+        return slot;
+    }
+
+    void ChunkSectionPool::retire_slot(const Slot& slot, const uint64_t frame) { retired_slots.push_back({slot, frame}); }
+
+    void ChunkSectionPool::free_retired_slots(const uint64_t frame_count, const uint32_t num_in_flight_frames) {
+        std::erase_if(retired_slots, [&](const RetiredSlot& retired) {
+            if(frame_count - retired.retired_frame < num_in_flight_frames) {
+                return false;
+            }
+
+            free_slots.push_back(retired.slot);
+            return true;
+        });
+    }
+
+    void ChunkSectionPool::recycle_mesh(const MeshId mesh) { recycled_meshes.push_back(mesh); }
+
+    std::optional<MeshId> ChunkSectionPool::take_recycled_mesh() {
+        if(recycled_meshes.empty()) {
+            return std::nullopt;
+        }
+
+        const auto mesh = recycled_meshes.back();
+        recycled_meshes.pop_back();
+
+        return mesh;
+    }
+
+    bool ChunkSectionPool::add_page() {
+        ZoneScoped;
+        for(auto num_slots = std::max(create_info.slots_per_page, 1u); num_slots > 0; num_slots /= 2) {
+            // Aligning to the vertex size keeps every slot's offset a whole number of vertices
+            const auto vertices = vertex_arena.allocate(slot_vertex_size * num_slots, create_info.vertex_size);
+            if(!vertices) {
+                continue;
+            }
+
+            const auto indices = index_arena.allocate(slot_index_size * num_slots, sizeof(uint32_t));
+            if(!indices) {
+                vertex_arena.free(*vertices);
+                continue;
+            }
+
+            // Hand out the slots from the front of the page first, so sections that are made together sit together
+            for(auto slot_idx = num_slots; slot_idx > 0; slot_idx--) {
+                free_slots.push_back({vertices->buffer,
+                                      vertices->offset + slot_vertex_size * (slot_idx - 1),
+                                      indices->buffer,
+                                      indices->offset + slot_index_size * (slot_idx - 1)});
+            }
+
+            return true;
+        }
+
+        logger->error("The mesh arenas don't have room for even one more chunk section of {} bytes", slot_vertex_size + slot_index_size);
+        return false;
+    }
+} // namespace nova::renderer
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "nova_renderer/chunk_geometry.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+#include "mesh_arena.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Hands out the fixed-size mesh arena slots that the sections of one chunk section pool keep their geometry in
+     *
+     * A section that gets new geometry moves into a fresh slot, and its old slot is retired until no in-flight frame can be drawing from
+     * it anymore. That way the new geometry can be uploaded while earlier frames still draw the old geometry, and a frame sees either
+     * all of the old geometry or all of the new
+     *
+     * The pool never gives its pages back to the mesh arenas, since a world that loaded this many sections once will probably do it
+     * again
+     */
+    class ChunkSectionPool {
+    public:
+        struct Slot {
+            rhi::RhiBuffer* vertex_buffer = nullptr;
+
+            /*!
+             * \brief Offset of the slot's vertices in `vertex_buffer`, in bytes. Always a multiple of the vertex size
+             */
+            uint64_t vertex_offset = 0;
+
+            rhi::RhiBuffer* index_buffer = nullptr;
+
+            /*!
+             * \brief Offset of the slot's indices in `index_buffer`, in bytes
+             */
+            uint64_t index_offset = 0;
+        };
+
+        ChunkSectionPool(MeshArena& vertex_arena, MeshArena& index_arena, const ChunkSectionPoolCreateInfo& create_info);
+
+        [[nodiscard]] const ChunkSectionPoolCreateInfo& get_create_info() const;
+
+        [[nodiscard]] uint64_t get_slot_vertex_size() const;
+
+        [[nodiscard]] uint64_t get_slot_index_size() const;
+
+        /*!
+         * \return A free slot, or nothing if the mesh arenas don't have room for another page of slots
+         */
+        [[nodiscard]] std::optional<Slot> allocate_slot();
+
+        /*!
+         * \brief Frees a slot once every frame that may still draw from it has finished
+         *
+         * \param frame The frame that stopped using the slot
+         */
+        void retire_slot(const Slot& slot, uint64_t frame);
+
+        /*!
+         * \brief Puts the retired slots that no in-flight frame can be using back on the free list
+         */
+        void free_retired_slots(uint64_t frame_count, uint32_t num_in_flight_frames);
+
+        /*!
+         * \brief Gives the pool a mesh that a destroyed section left behind, so the next section can reuse its mesh and mesh batches
+         */
+        void recycle_mesh(MeshId mesh);
+
+        /*!
+         * \return A mesh that a destroyed section left behind, or nothing if there aren't any
+         */
+        [[nodiscard]] std::optional<MeshId> take_recycled_mesh();
+
+    private:
+        MeshArena& vertex_arena;
+
+        MeshArena& index_arena;
+
+        ChunkSectionPoolCreateInfo create_info;
+
+        uint64_t slot_vertex_size;
+
+        uint64_t slot_index_size;
+
+        std::vector<Slot> free_slots;
+
+        struct RetiredSlot {
+            Slot slot;
+
+            uint64_t retired_frame;
+        };
+
+        std::vector<RetiredSlot> retired_slots;
+
+        std::vector<MeshId> recycled_meshes;
+
+        /*!
+         * \brief Takes a new page of slots from the mesh arenas, halving the page size until one fits
+         */
+        bool add_page();
+    };
+} // namespace nova::renderer
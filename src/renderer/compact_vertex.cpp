@@ -0,0 +1,56 @@
+#include "nova_renderer/compact_vertex.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+namespace nova::renderer {
+    glm::vec2 encode_octahedral(const glm::vec3& unit_vector) {
+        const auto octahedron = unit_vector / (glm::abs(unit_vector.x) + glm::abs(unit_vector.y) + glm::abs(unit_vector.z));
+        const auto top = glm::vec2{octahedron.x, octahedron.y};
+
+        if(octahedron.z >= 0) {
+            return top;
+        }
+
+        // glm::sign returns 0 for 0, but 0 has to fold onto the positive side like everything else
+        const auto sign = glm::vec2{top.x >= 0 ? 1.0f : -1.0f, top.y >= 0 ? 1.0f : -1.0f};
+        return (1.0f - glm::abs(glm::vec2{top.y, top.x})) * sign;
+    }
+
+    glm::vec3 decode_octahedral(const glm::vec2& encoded) {
+        auto vector = glm::vec3{encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y)};
+
+        const auto fold = glm::max(-vector.z, 0.0f);
+        vector.x += vector.x >= 0 ? -fold : fold;
+        vector.y += vector.y >= 0 ? -fold : fold;
+
+        return glm::normalize(vector);
+    }
+
+    CompactVertex compact_vertex(const FullVertex& vertex, const CompactVertexSpace& space) {
+        const auto relative_position = glm::clamp((vertex.position - space.origin) / space.extent, glm::vec3{0}, glm::vec3{1});
+
+        CompactVertex compact{};
+        compact.position = glm::packUnorm<uint16_t>(glm::vec4{relative_position, 1.0f});
+        compact.normal = glm::packSnorm2x16(encode_octahedral(glm::normalize(vertex.normal)));
+        compact.tangent = glm::packSnorm2x16(encode_octahedral(glm::normalize(vertex.tangent)));
+        compact.main_uv = vertex.main_uv;
+        compact.secondary_uv = vertex.secondary_uv;
+        compact.virtual_texture_id = vertex.virtual_texture_id;
+
+        return compact;
+    }
+
+    std::vector<rhi::RhiVertexField> get_compact_vertex_fields() {
+        std::vector<rhi::RhiVertexField> fields;
+        fields.reserve(6);
+
+        fields.emplace_back("position", rhi::VertexFieldFormat::Unorm16x4);
+        fields.emplace_back("normal", rhi::VertexFieldFormat::Snorm16x2);
+        fields.emplace_back("tangent", rhi::VertexFieldFormat::Snorm16x2);
+        fields.emplace_back("main_uv", rhi::VertexFieldFormat::Unorm16x2);
+        fields.emplace_back("secondary_uv", rhi::VertexFieldFormat::Unorm16x2);
+        fields.emplace_back("virtual_texture_id", rhi::VertexFieldFormat::Uint);
+
+        return fields;
+    }
+} // namespace nova::renderer
@@ -0,0 +1,223 @@
+#include "cpu_timeline.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("CpuTimeline");
+
+    static std::atomic<uint64_t> next_timeline_id{1};
+
+    /*!
+     * \brief The ring that the calling thread used last, so most events don't have to look their ring up
+     */
+    struct CachedThreadEvents {
+        uint64_t timeline_id = 0;
+
+        void* events = nullptr;
+    };
+
+    static thread_local CachedThreadEvents cached_thread_events;
+
+    static void append_json_string(std::string& json, const std::string_view str) {
+        json += '"';
+        for(const char c : str) {
+            if(c == '"' || c == '\\') {
+                json += '\\';
+                json += c;
+
+            } else if(static_cast<unsigned char>(c) < 0x20) {
+                json += fmt::format("\\u{:04x}", static_cast<uint32_t>(c));
+
+            } else {
+                json += c;
+            }
+        }
+        json += '"';
+    }
+
+    static double get_percentile(const std::vector<double>& sorted_values, const double percentile) {
+        const auto idx = static_cast<size_t>(percentile * static_cast<double>(sorted_values.size()));
+        return sorted_values[std::min(idx, sorted_values.size() - 1)];
+    }
+
+    CpuTimeline::CpuTimeline(const uint32_t events_per_thread)
+        : id{next_timeline_id.fetch_add(1)},
+          events_per_thread{std::bit_ceil(std::max(events_per_thread, 2U))},
+          event_index_mask{this->events_per_thread - 1},
+          start_time{std::chrono::steady_clock::now()} {}
+
+    int64_t CpuTimeline::now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    void CpuTimeline::set_frame(const uint64_t frame) { cur_frame.store(frame, std::memory_order_relaxed); }
+
+    void CpuTimeline::add_event(const std::string_view name, const int64_t start_ns, const int64_t end_ns) {
+        auto& thread_events = get_thread_events();
+
+        // Only this thread writes the count, so nobody else can have moved it since we read it
+        const auto idx = thread_events.num_added.load(std::memory_order_relaxed);
+        auto& event = thread_events.events[idx & event_index_mask];
+
+        const auto name_size = std::min(name.size(), event.name.size() - 1);
+        memcpy(event.name.data(), name.data(), name_size);
+        event.name[name_size] = '\0';
+        event.frame = cur_frame.load(std::memory_order_relaxed);
+        event.start_ns = start_ns;
+        event.end_ns = end_ns;
+
+        thread_events.num_added.store(idx + 1, std::memory_order_release);
+    }
+
+    CpuTimelineSnapshot CpuTimeline::take_snapshot(const double seconds) const {
+        ZoneScoped;
+        const auto oldest_end_ns = now() - static_cast<int64_t>(seconds * 1e9);
+
+        std::lock_guard lock{threads_mutex};
+
+        CpuTimelineSnapshot snapshot;
+        snapshot.reserve(threads.size());
+        for(const auto& thread_events : threads) {
+            const auto num_added = thread_events->num_added.load(std::memory_order_acquire);
+            const auto first = num_added > events_per_thread ? num_added - events_per_thread : 0;
+
+            auto& events = snapshot.emplace_back();
+            events.reserve(num_added - first);
+            for(auto i = first; i < num_added; i++) {
+                events.push_back(thread_events->events[i & event_index_mask]);
+            }
+
+            // The thread may have lapped us while we copied. Adding event N + capacity overwrites event N, and the thread may be halfway
+            // through adding the event after the last one that it finished
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const auto num_added_after = thread_events->num_added.load(std::memory_order_relaxed);
+            const auto first_intact = num_added_after + 1 > events_per_thread ? num_added_after + 1 - events_per_thread : 0;
+            if(first_intact > first) {
+                events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(std::min(first_intact - first, events.size())));
+            }
+
+            // Each thread adds its events as they end, so they're already in order of when they ended
+            const auto first_recent = std::partition_point(events.begin(), events.end(), [&](const CpuTimelineEvent& event) {
+                return event.end_ns < oldest_end_ns;
+            });
+            events.erase(events.begin(), first_recent);
+        }
+
+        return snapshot;
+    }
+
+    std::vector<CpuPhaseTiming> CpuTimeline::get_phase_timings(const double seconds) const {
+        ZoneScoped;
+        const auto snapshot = take_snapshot(seconds);
+
+        std::unordered_map<std::string, std::vector<double>> milliseconds_by_name;
+        for(const auto& events : snapshot) {
+            for(const CpuTimelineEvent& event : events) {
+                milliseconds_by_name[event.name.data()].push_back(static_cast<double>(event.end_ns - event.start_ns) / 1e6);
+            }
+        }
+
+        std::vector<CpuPhaseTiming> timings;
+        timings.reserve(milliseconds_by_name.size());
+        for(auto& [name, milliseconds] : milliseconds_by_name) {
+            std::sort(milliseconds.begin(), milliseconds.end());
+
+            auto& timing = timings.emplace_back();
+            timing.name = name;
+            timing.num_samples = static_cast<uint32_t>(milliseconds.size());
+            timing.median_milliseconds = get_percentile(milliseconds, 0.5);
+            timing.p95_milliseconds = get_percentile(milliseconds, 0.95);
+            timing.p99_milliseconds = get_percentile(milliseconds, 0.99);
+            timing.max_milliseconds = milliseconds.back();
+        }
+
+        std::sort(timings.begin(), timings.end(), [](const CpuPhaseTiming& a, const CpuPhaseTiming& b) { return a.name < b.name; });
+
+        return timings;
+    }
+
+    bool CpuTimeline::write_chrome_trace(const CpuTimelineSnapshot& snapshot, const std::filesystem::path& path) {
+        ZoneScoped;
+        std::string json = R"({"displayTimeUnit":"ms","traceEvents":[)";
+        bool is_first_event = true;
+        const auto start_event = [&] {
+            if(!is_first_event) {
+                json += ',';
+            }
+            is_first_event = false;
+        };
+
+        for(uint32_t thread_idx = 0; thread_idx < snapshot.size(); thread_idx++) {
+            start_event();
+            json += fmt::format(R"({{"ph":"M","name":"thread_name","pid":1,"tid":{},"args":{{"name":"Nova thread {}"}}}})",
+                                thread_idx,
+                                thread_idx);
+
+            for(const CpuTimelineEvent& event : snapshot[thread_idx]) {
+                start_event();
+                json += R"({"ph":"X","name":)";
+                append_json_string(json, event.name.data());
+                json += fmt::format(R"(,"pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f},"args":{{"frame":{}}}}})",
+                                    thread_idx,
+                                    static_cast<double>(event.start_ns) / 1000.0,
+                                    static_cast<double>(event.end_ns - event.start_ns) / 1000.0,
+                                    event.frame);
+            }
+        }
+        json += "]}";
+
+        std::error_code err;
+        if(path.has_parent_path()) {
+            std::filesystem::create_directories(path.parent_path(), err);
+        }
+
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        if(!file) {
+            logger->error("Could not open {} to write a CPU trace", path.string());
+            return false;
+        }
+
+        file.write(json.data(), static_cast<std::streamsize>(json.size()));
+
+        return static_cast<bool>(file);
+    }
+
+    CpuTimeline::ThreadEvents& CpuTimeline::get_thread_events() {
+        if(cached_thread_events.timeline_id == id) {
+            return *static_cast<ThreadEvents*>(cached_thread_events.events);
+        }
+
+        // This thread last used some other timeline, or none at all
+        std::lock_guard lock{threads_mutex};
+        auto& thread_events = threads_by_id[std::this_thread::get_id()];
+        if(thread_events == nullptr) {
+            auto& new_events = threads.emplace_back(std::make_unique<ThreadEvents>());
+            new_events->events = std::make_unique<CpuTimelineEvent[]>(events_per_thread);
+            thread_events = new_events.get();
+        }
+
+        cached_thread_events = {id, thread_events};
+
+        return *thread_events;
+    }
+
+    CpuTimelineScope::CpuTimelineScope(CpuTimeline* timeline, const std::string_view name) : timeline{timeline}, name{name} {
+        if(timeline != nullptr) {
+            start_ns = timeline->now();
+        }
+    }
+
+    CpuTimelineScope::~CpuTimelineScope() {
+        if(timeline != nullptr) {
+            timeline->add_event(name, start_ns, timeline->now());
+        }
+    }
+} // namespace nova::renderer
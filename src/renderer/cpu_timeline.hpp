@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "nova_renderer/cpu_timings.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief One scope that a thread timed
+     */
+    struct CpuTimelineEvent {
+        /*!
+         * \brief The name of the scope, cut off if it doesn't fit. Always ends with a null
+         */
+        std::array<char, 40> name{};
+
+        /*!
+         * \brief The frame that was being rendered when the scope ended
+         */
+        uint64_t frame = 0;
+
+        /*!
+         * \brief When the scope started and ended, in nanoseconds since the timeline was made
+         */
+        int64_t start_ns = 0;
+        int64_t end_ns = 0;
+    };
+
+    static_assert(sizeof(CpuTimelineEvent) == 64, "Events should be one cache line each");
+
+    /*!
+     * \brief The events of every thread that added any, oldest first. Index N is the Nth thread to add an event
+     */
+    using CpuTimelineSnapshot = std::vector<std::vector<CpuTimelineEvent>>;
+
+    /*!
+     * \brief Keeps the last few seconds of timed scopes on every thread, cheaply enough to stay on in shipping builds
+     *
+     * Unlike Tracy, nobody has to be connected to see what happened. Each thread writes into a ring of events of its own, without
+     * locks, and the oldest events fall off the end of it. Readers copy the rings and throw away whatever was overwritten while they
+     * copied, so they never block the threads that are timing things
+     *
+     * The first event that a thread adds takes a lock, to make the thread's ring. Every event after that is a few stores
+     */
+    class CpuTimeline {
+    public:
+        /*!
+         * \param events_per_thread How many events each thread keeps. Rounded up to a power of two
+         */
+        explicit CpuTimeline(uint32_t events_per_thread);
+
+        CpuTimeline(const CpuTimeline& other) = delete;
+        CpuTimeline& operator=(const CpuTimeline& other) = delete;
+
+        CpuTimeline(CpuTimeline&& old) noexcept = delete;
+        CpuTimeline& operator=(CpuTimeline&& old) noexcept = delete;
+
+        ~CpuTimeline() = default;
+
+        /*!
+         * \brief Gets the current time, in nanoseconds since the timeline was made
+         */
+        [[nodiscard]] int64_t now() const;
+
+        /*!
+         * \brief Sets the frame that events which end from now on belong to
+         */
+        void set_frame(uint64_t frame);
+
+        /*!
+         * \brief Adds an event to the calling thread's ring. May be called from any thread
+         */
+        void add_event(std::string_view name, int64_t start_ns, int64_t end_ns);
+
+        /*!
+         * \brief Copies the events of every thread that ended in the last `seconds` seconds
+         */
+        [[nodiscard]] CpuTimelineSnapshot take_snapshot(double seconds) const;
+
+        /*!
+         * \brief Gets the percentiles of how long each scope took over the last `seconds` seconds, sorted by name
+         */
+        [[nodiscard]] std::vector<CpuPhaseTiming> get_phase_timings(double seconds) const;
+
+        /*!
+         * \brief Writes a snapshot as a Chrome trace file, which chrome://tracing and Perfetto can open
+         *
+         * \return True if the file was written, false if it couldn't be opened
+         */
+        static bool write_chrome_trace(const CpuTimelineSnapshot& snapshot, const std::filesystem::path& path);
+
+    private:
+        /*!
+         * \brief One thread's ring of events. Only that thread writes to it
+         */
+        struct ThreadEvents {
+            std::unique_ptr<CpuTimelineEvent[]> events;
+
+            /*!
+             * \brief How many events the thread has ever added. Event N is at `N & event_index_mask` until event N + capacity
+             * overwrites it
+             */
+            std::atomic<uint64_t> num_added{0};
+        };
+
+        /*!
+         * \brief Tells timelines apart in the threads' caches of their rings, even if a new timeline gets an old one's address
+         */
+        uint64_t id;
+
+        uint64_t events_per_thread;
+
+        uint64_t event_index_mask;
+
+        std::chrono::steady_clock::time_point start_time;
+
+        std::atomic<uint64_t> cur_frame{0};
+
+        mutable std::mutex threads_mutex;
+
+        std::vector<std::unique_ptr<ThreadEvents>> threads;
+
+        std::unordered_map<std::thread::id, ThreadEvents*> threads_by_id;
+
+        [[nodiscard]] ThreadEvents& get_thread_events();
+    };
+
+    /*!
+     * \brief Times a scope for as long as it's alive. Does nothing if the timeline is nullptr
+     */
+    class CpuTimelineScope {
+    public:
+        /*!
+         * \param name The name of the scope. Must stay alive until the scope ends
+         */
+        CpuTimelineScope(CpuTimeline* timeline, std::string_view name);
+
+        CpuTimelineScope(const CpuTimelineScope& other) = delete;
+        CpuTimelineScope& operator=(const CpuTimelineScope& other) = delete;
+
+        CpuTimelineScope(CpuTimelineScope&& old) noexcept = delete;
+        CpuTimelineScope& operator=(CpuTimelineScope&& old) noexcept = delete;
+
+        ~CpuTimelineScope();
+
+    private:
+        CpuTimeline* timeline;
+
+        std::string_view name;
+
+        int64_t start_ns = 0;
+    };
+} // namespace nova::renderer
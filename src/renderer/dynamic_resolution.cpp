@@ -0,0 +1,40 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nova::renderer {
+    /*!
+     * \brief Frame times within this fraction of the target are close enough, and don't change the scale
+     */
+    constexpr double DEADBAND = 0.05;
+
+    /*!
+     * \brief How much of the way to the ideal scale we move each frame, when scaling down and up
+     */
+    constexpr double DECREASE_RATE = 0.5;
+    constexpr double INCREASE_RATE = 0.1;
+
+    glm::uvec2 scale_resolution(const glm::uvec2& full_size, const float scale) {
+        return glm::max(glm::uvec2{glm::ceil(glm::vec2{full_size} * scale)}, glm::uvec2{1});
+    }
+
+    DynamicResolutionController::DynamicResolutionController(const NovaSettings::DynamicResolutionOptions& options)
+        : options{options} {}
+
+    void DynamicResolutionController::update(const double gpu_frame_time_ms) {
+        const double target_ms = options.target_frame_time_ms;
+        if(gpu_frame_time_ms <= 0 || std::abs(gpu_frame_time_ms - target_ms) < target_ms * DEADBAND) {
+            return;
+        }
+
+        // The frame time is proportional to the pixel count, which is proportional to the square of the scale
+        const auto ideal_scale = scale * std::sqrt(target_ms / gpu_frame_time_ms);
+        const auto rate = ideal_scale < scale ? DECREASE_RATE : INCREASE_RATE;
+
+        const auto new_scale = static_cast<float>(scale + (ideal_scale - scale) * rate);
+        scale = std::clamp(new_scale, std::min(options.min_scale, 1.0f), 1.0f);
+    }
+
+    float DynamicResolutionController::get_scale() const { return scale; }
+} // namespace nova::renderer
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/nova_settings.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Scales a full-resolution size, rounding up so nothing ends up zero pixels wide
+     */
+    [[nodiscard]] glm::uvec2 scale_resolution(const glm::uvec2& full_size, float scale);
+
+    /*!
+     * \brief Picks the resolution scale of the next frame from how long the GPU took on the last one
+     *
+     * GPU time grows with the number of pixels, so the controller works out which scale would have hit the target frame time and moves
+     * part of the way there. It scales down quickly when frames are too slow, and back up slowly so it doesn't overshoot and bounce
+     * between the two
+     */
+    class DynamicResolutionController {
+    public:
+        explicit DynamicResolutionController(const NovaSettings::DynamicResolutionOptions& options);
+
+        /*!
+         * \brief Adjusts the scale based on how long a frame that rendered at the current scale took on the GPU
+         */
+        void update(double gpu_frame_time_ms);
+
+        /*!
+         * \brief Gets the fraction of the full resolution to render at, in each dimension
+         */
+        [[nodiscard]] float get_scale() const;
+
+    private:
+        NovaSettings::DynamicResolutionOptions options;
+
+        float scale = 1.0f;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,60 @@
+#include "frame_arena.hpp"
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("FrameArena");
+
+    FrameArena::FrameArena(const uint32_t num_in_flight_frames, const size_t bytes_per_frame)
+        : slots(num_in_flight_frames), bytes_per_frame{bytes_per_frame} {
+        // The slots never move after this, so their resources can point at their escape counters
+        for(auto& slot : slots) {
+            slot.memory = std::make_unique<std::byte[]>(bytes_per_frame);
+            slot.resource = std::make_unique<std::pmr::monotonic_buffer_resource>(slot.memory.get(), bytes_per_frame, &slot.escapes);
+        }
+
+        cur_slot = &slots[0];
+    }
+
+    void FrameArena::begin_frame(const uint32_t frame_idx) {
+        auto& slot = slots[frame_idx];
+
+        TracyPlot("Frame arena escaped allocations", static_cast<int64_t>(slot.escapes.num_allocations));
+        if(slot.escapes.num_allocations > 0 && !warned_about_escapes) {
+            logger->warn("A frame made {} allocations that didn't fit in its {} byte arena. Increase `frame_arena_size`",
+                         slot.escapes.num_allocations,
+                         bytes_per_frame);
+            warned_about_escapes = true;
+        }
+
+        // Hands the escaped allocations back to the heap and rewinds to the start of the slot's block
+        slot.resource->release();
+        slot.escapes.num_allocations = 0;
+        slot.escapes.num_allocated_bytes = 0;
+
+        cur_slot = &slot;
+    }
+
+    std::pmr::memory_resource* FrameArena::get_resource() const { return cur_slot->resource.get(); }
+
+    uint64_t FrameArena::get_num_escaped_allocations() const { return cur_slot->escapes.num_allocations; }
+
+    uint64_t FrameArena::get_num_escaped_bytes() const { return cur_slot->escapes.num_allocated_bytes; }
+
+    uint64_t FrameArena::get_reserved_bytes() const { return slots.size() * bytes_per_frame; }
+
+    void* FrameArena::EscapeCounter::do_allocate(const size_t num_bytes, const size_t alignment) {
+        num_allocations++;
+        num_allocated_bytes += num_bytes;
+        return std::pmr::new_delete_resource()->allocate(num_bytes, alignment);
+    }
+
+    void FrameArena::EscapeCounter::do_deallocate(void* ptr, const size_t num_bytes, const size_t alignment) {
+        std::pmr::new_delete_resource()->deallocate(ptr, num_bytes, alignment);
+    }
+
+    bool FrameArena::EscapeCounter::do_is_equal(const memory_resource& other) const noexcept { return this == &other; }
+} // namespace nova::renderer
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace nova::renderer {
+    /*!
+     * \brief Host memory for temporaries that only live until the end of the frame that made them
+     *
+     * Each in-flight frame slot gets a fixed block of memory. Allocating bumps a pointer through the current slot's block, freeing does
+     * nothing, and `begin_frame` throws the whole block away at once when the slot comes back around. Containers use it through
+     * `get_resource`, e.g. `std::pmr::vector<rhi::RhiResourceBarrier> barriers{ctx.allocator}`
+     *
+     * Anything that doesn't fit in the block escapes to the general heap. That still works, but it's the kind of allocation we're trying to
+     * get rid of, so the arena counts them. If the count isn't zero in a steady-state frame, increase `frame_arena_size`
+     *
+     * This class is not thread-safe. Use it from the thread that calls `NovaRenderer::execute_frame`
+     */
+    class FrameArena {
+    public:
+        /*!
+         * \param num_in_flight_frames The number of frames that may be in flight at once
+         * \param bytes_per_frame How many bytes each frame may allocate before allocations escape to the heap
+         */
+        FrameArena(uint32_t num_in_flight_frames, size_t bytes_per_frame);
+
+        FrameArena(const FrameArena& other) = delete;
+        FrameArena& operator=(const FrameArena& other) = delete;
+
+        FrameArena(FrameArena&& old) noexcept = delete;
+        FrameArena& operator=(FrameArena&& old) noexcept = delete;
+
+        ~FrameArena() = default;
+
+        /*!
+         * \brief Makes the provided frame slot's block the one that allocations come from, throwing away everything allocated the last
+         * time that slot was used
+         *
+         * Call this after the frame slot's fence has signaled
+         */
+        void begin_frame(uint32_t frame_idx);
+
+        /*!
+         * \brief Gets the memory resource that allocates from the current frame slot
+         */
+        [[nodiscard]] std::pmr::memory_resource* get_resource() const;
+
+        /*!
+         * \brief Gets the number of allocations that didn't fit in the current frame slot's block, and went to the heap instead
+         */
+        [[nodiscard]] uint64_t get_num_escaped_allocations() const;
+
+        /*!
+         * \brief Gets the number of bytes that the current frame slot's escaped allocations asked the heap for
+         */
+        [[nodiscard]] uint64_t get_num_escaped_bytes() const;
+
+        /*!
+         * \brief Gets the bytes of host memory that the blocks of every frame slot take up, used or not
+         */
+        [[nodiscard]] uint64_t get_reserved_bytes() const;
+
+    private:
+        /*!
+         * \brief Passes allocations through to the heap and counts them
+         */
+        class EscapeCounter final : public std::pmr::memory_resource {
+        public:
+            uint64_t num_allocations = 0;
+
+            uint64_t num_allocated_bytes = 0;
+
+        private:
+            void* do_allocate(size_t num_bytes, size_t alignment) override;
+
+            void do_deallocate(void* ptr, size_t num_bytes, size_t alignment) override;
+
+            [[nodiscard]] bool do_is_equal(const memory_resource& other) const noexcept override;
+        };
+
+        struct FrameSlot {
+            std::unique_ptr<std::byte[]> memory;
+
+            EscapeCounter escapes;
+
+            std::unique_ptr<std::pmr::monotonic_buffer_resource> resource;
+        };
+
+        std::vector<FrameSlot> slots;
+
+        FrameSlot* cur_slot = nullptr;
+
+        size_t bytes_per_frame;
+
+        bool warned_about_escapes = false;
+    };
+} // namespace nova::renderer
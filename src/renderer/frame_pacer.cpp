@@ -0,0 +1,87 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace nova::renderer {
+    /*!
+     * \brief How much of the difference between a new sample and our estimate the estimate moves by, as 1 / n
+     */
+    constexpr int SMOOTHING_DIVISOR = 16;
+
+    /*!
+     * \brief How long before the wake time `sleep_until` stops sleeping and starts yielding
+     */
+    constexpr auto SPIN_TIME = std::chrono::milliseconds{1};
+
+    FramePacer::FramePacer(const NovaSettings::FramePacingOptions& options) : options{options} {}
+
+    void FramePacer::on_previous_frame_finished(const Clock::time_point finish_time) {
+        if(!last_frame_start) {
+            return;
+        }
+
+        const auto frame_time = finish_time - *last_frame_start;
+
+        // Slow frames raise the estimate right away, fast frames only lower it bit by bit. Guessing low makes us miss a vertical blank,
+        // guessing high only costs a little latency
+        if(!smoothed_frame_time || frame_time > *smoothed_frame_time) {
+            smoothed_frame_time = frame_time;
+
+        } else {
+            *smoothed_frame_time += (frame_time - *smoothed_frame_time) / SMOOTHING_DIVISOR;
+        }
+    }
+
+    void FramePacer::on_previous_frame_presented(const Clock::time_point present_time) {
+        if(last_present) {
+            const auto interval = present_time - *last_present;
+
+            if(!refresh_interval || interval < *refresh_interval * 2 / 3) {
+                // Our first sample, or the last one spanned a missed vertical blank
+                refresh_interval = interval;
+
+            } else if(interval < *refresh_interval * 3 / 2) {
+                *refresh_interval += (interval - *refresh_interval) / SMOOTHING_DIVISOR;
+            }
+            // Anything longer is a missed vertical blank, and tells us nothing about the display
+        }
+
+        last_present = present_time;
+    }
+
+    FramePacer::Clock::time_point FramePacer::get_next_frame_start() const {
+        Clock::time_point start_time{};
+
+        if(options.max_frame_rate > 0 && last_frame_start) {
+            const auto min_frame_interval = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>{1.0 / options.max_frame_rate});
+            start_time = std::max(start_time, *last_frame_start + min_frame_interval);
+        }
+
+        if(options.just_in_time && last_present && refresh_interval && smoothed_frame_time) {
+            const auto safety_margin = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::milli>{options.safety_margin_ms});
+            const auto next_vblank = *last_present + *refresh_interval;
+            start_time = std::max(start_time, next_vblank - *smoothed_frame_time - safety_margin);
+        }
+
+        return start_time;
+    }
+
+    void FramePacer::on_frame_started(const Clock::time_point start_time) { last_frame_start = start_time; }
+
+    FramePacer::Clock::duration FramePacer::get_predicted_frame_time() const { return smoothed_frame_time.value_or(Clock::duration{}); }
+
+    std::optional<FramePacer::Clock::duration> FramePacer::get_refresh_interval() const { return refresh_interval; }
+
+    void FramePacer::sleep_until(const Clock::time_point wake_time) {
+        if(wake_time - Clock::now() > SPIN_TIME) {
+            std::this_thread::sleep_until(wake_time - SPIN_TIME);
+        }
+
+        while(Clock::now() < wake_time) {
+            std::this_thread::yield();
+        }
+    }
+} // namespace nova::renderer
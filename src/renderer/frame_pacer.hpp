@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+
+#include "nova_renderer/nova_settings.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Works out when the next frame should start
+     *
+     * The pacer only does the math. NovaRenderer waits on the previous frame and tells the pacer when that frame finished on the GPU
+     * and, if the swapchain can tell, when it reached the display. From those the pacer learns how long a frame takes and how far apart
+     * vertical blanks are, and picks a start time that's as late as possible without missing the next vertical blank
+     */
+    class FramePacer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit FramePacer(const NovaSettings::FramePacingOptions& options);
+
+        /*!
+         * \brief Tells the pacer that the GPU finished the previous frame at the provided time
+         */
+        void on_previous_frame_finished(Clock::time_point finish_time);
+
+        /*!
+         * \brief Tells the pacer that the previous frame reached the display at the provided time
+         */
+        void on_previous_frame_presented(Clock::time_point present_time);
+
+        /*!
+         * \brief Gets the time that the next frame should start at. If it's in the past, start right away
+         */
+        [[nodiscard]] Clock::time_point get_next_frame_start() const;
+
+        /*!
+         * \brief Tells the pacer that a frame started at the provided time
+         */
+        void on_frame_started(Clock::time_point start_time);
+
+        /*!
+         * \brief Gets how long the pacer expects a frame to take from its start until the GPU finishes it
+         */
+        [[nodiscard]] Clock::duration get_predicted_frame_time() const;
+
+        /*!
+         * \brief Gets how far apart the pacer thinks vertical blanks are, if it's seen enough presents to know
+         */
+        [[nodiscard]] std::optional<Clock::duration> get_refresh_interval() const;
+
+        /*!
+         * \brief Sleeps until the provided time
+         *
+         * The OS scheduler can easily oversleep by a millisecond, which is a lot of the budget of a high refresh rate frame. This sleeps
+         * for most of the time and yields in a loop for the rest
+         */
+        static void sleep_until(Clock::time_point wake_time);
+
+    private:
+        NovaSettings::FramePacingOptions options;
+
+        std::optional<Clock::time_point> last_frame_start;
+
+        std::optional<Clock::time_point> last_present;
+
+        /*!
+         * \brief Smoothed time from a frame's start until its GPU work finishes
+         */
+        std::optional<Clock::duration> smoothed_frame_time;
+
+        std::optional<Clock::duration> refresh_interval;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,82 @@
+#include "frame_upload_allocator.hpp"
+
+#include <cstring>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("FrameUploadAllocator");
+
+    static uint64_t align_up(const uint64_t value, const uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+    FrameUploadAllocator::FrameUploadAllocator(rhi::RenderDevice& device,
+                                               const uint32_t num_in_flight_frames,
+                                               const uint64_t bytes_per_frame)
+        : device{device}, alignment{device.info.min_buffer_offset_alignment.b_count()} {
+        // Every region has to start at a valid binding offset
+        this->bytes_per_frame = align_up(bytes_per_frame, alignment);
+
+        rhi::RhiBufferCreateInfo create_info{};
+        create_info.name = "FrameUploadBuffer";
+        create_info.size = this->bytes_per_frame * num_in_flight_frames;
+        create_info.buffer_usage = rhi::BufferUsage::UploadBuffer;
+
+        buffer = device.create_buffer(create_info);
+        if(buffer == nullptr) {
+            logger->error("Could not create the per-frame upload buffer. Nothing will be able to allocate from it");
+            return;
+        }
+
+        mapped_data = static_cast<uint8_t*>(device.get_mapped_data(buffer));
+    }
+
+    void FrameUploadAllocator::begin_frame(const uint32_t frame_idx) {
+        region_start = bytes_per_frame * frame_idx;
+        region_used = 0;
+        warned_about_overflow = false;
+    }
+
+    std::optional<FrameUploadAllocator::Allocation> FrameUploadAllocator::allocate(const uint64_t num_bytes) {
+        if(mapped_data == nullptr || num_bytes == 0) {
+            return std::nullopt;
+        }
+
+        const auto offset = align_up(region_used, alignment);
+        if(offset + num_bytes > bytes_per_frame) {
+            if(!warned_about_overflow) {
+                logger->error("This frame allocated more than {} bytes of per-frame upload memory. Increase "
+                              "`uploads.per_frame_upload_buffer_size`",
+                              bytes_per_frame);
+                warned_about_overflow = true;
+            }
+            return std::nullopt;
+        }
+
+        region_used = offset + num_bytes;
+
+        return Allocation{buffer, region_start + offset, num_bytes, mapped_data + region_start + offset};
+    }
+
+    std::optional<FrameUploadAllocator::Allocation> FrameUploadAllocator::upload(const void* data, const uint64_t num_bytes) {
+        auto allocation = allocate(num_bytes);
+        if(allocation) {
+            memcpy(allocation->data, data, num_bytes);
+        }
+
+        return allocation;
+    }
+
+    void FrameUploadAllocator::flush() {
+        ZoneScoped;
+        if(buffer == nullptr || region_used == 0) {
+            return;
+        }
+
+        device.flush_buffer(buffer, region_start, region_used);
+    }
+} // namespace nova::renderer
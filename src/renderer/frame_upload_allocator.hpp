@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+namespace nova::renderer {
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Hands out ranges of one persistently mapped buffer for uniform and storage data that's rewritten every frame
+     *
+     * The buffer is split into one region per in-flight frame. Allocating just bumps an offset into the current frame's region, and
+     * `begin_frame` resets the region once its previous frame is done with it, so per-frame data doesn't need buffers of its own. Callers
+     * write straight into the mapped memory, then bind their range of the buffer with `RhiResourceBinder::bind_buffer_range`
+     *
+     * `flush` only tells the GPU about the bytes that were actually allocated this frame, instead of the whole region
+     *
+     * This class is not thread-safe. Use it from the thread that calls `NovaRenderer::execute_frame`
+     */
+    class FrameUploadAllocator {
+    public:
+        struct Allocation {
+            rhi::RhiBuffer* buffer = nullptr;
+
+            /*!
+             * \brief Offset, in bytes, of this allocation in `buffer`. Always a multiple of `DeviceInfo::min_buffer_offset_alignment`
+             */
+            uint64_t offset = 0;
+
+            uint64_t size = 0;
+
+            /*!
+             * \brief Where to write the allocation's data. Only valid until the frame that allocated it is submitted
+             */
+            void* data = nullptr;
+        };
+
+        /*!
+         * \param device The device to create the buffer on
+         * \param num_in_flight_frames The number of frames that may be in flight at once
+         * \param bytes_per_frame How many bytes each frame may allocate
+         */
+        FrameUploadAllocator(rhi::RenderDevice& device, uint32_t num_in_flight_frames, uint64_t bytes_per_frame);
+
+        FrameUploadAllocator(const FrameUploadAllocator& other) = delete;
+        FrameUploadAllocator& operator=(const FrameUploadAllocator& other) = delete;
+
+        FrameUploadAllocator(FrameUploadAllocator&& old) noexcept = delete;
+        FrameUploadAllocator& operator=(FrameUploadAllocator&& old) noexcept = delete;
+
+        ~FrameUploadAllocator() = default;
+
+        /*!
+         * \brief Makes the provided frame slot's region the one that allocations come from, throwing away everything allocated the last
+         * time that slot was used
+         *
+         * Call this after the frame slot's fence has signaled
+         */
+        void begin_frame(uint32_t frame_idx);
+
+        /*!
+         * \brief Allocates `num_bytes` of this frame's region
+         *
+         * \return The new allocation, or nullopt if this frame's region is full
+         */
+        [[nodiscard]] std::optional<Allocation> allocate(uint64_t num_bytes);
+
+        /*!
+         * \brief Allocates space for some data and copies the data into it
+         */
+        [[nodiscard]] std::optional<Allocation> upload(const void* data, uint64_t num_bytes);
+
+        /*!
+         * \brief Makes everything that was written to this frame's allocations visible to the GPU. Call it after the last write and before
+         * the frame is submitted
+         */
+        void flush();
+
+    private:
+        rhi::RenderDevice& device;
+
+        rhi::RhiBuffer* buffer = nullptr;
+
+        uint8_t* mapped_data = nullptr;
+
+        uint64_t bytes_per_frame;
+
+        uint64_t alignment;
+
+        /*!
+         * \brief Offset of the current frame's region in `buffer`
+         */
+        uint64_t region_start = 0;
+
+        /*!
+         * \brief Number of bytes of the current frame's region that have been allocated
+         */
+        uint64_t region_used = 0;
+
+        bool warned_about_overflow = false;
+    };
+} // namespace nova::renderer
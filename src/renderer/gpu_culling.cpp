@@ -0,0 +1,599 @@
+#include "gpu_culling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/camera.hpp"
+#include "nova_renderer/mesh_lods.hpp"
+#include "nova_renderer/rendergraph.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "builtin_shaders.hpp"
+#include "visibility_cache.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("GpuCulling");
+
+    constexpr const char* CULLING_PIPELINE_NAME = "NovaGpuCulling";
+
+    constexpr const char* COMPACTION_PIPELINE_NAME = "NovaDrawCompaction";
+
+    constexpr uint32_t CULLING_GROUP_SIZE = 64;
+
+    /*!
+     * \brief Normal cone for things that can't be cone culled
+     */
+    constexpr glm::vec4 NO_NORMAL_CONE{0, 0, 1, 1};
+
+    static rhi::RhiResourceBarrier make_buffer_barrier(rhi::RhiBuffer* buffer,
+                                                       const rhi::ResourceAccess access_before,
+                                                       const rhi::ResourceAccess access_after) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = buffer;
+        barrier.old_state = rhi::ResourceState::Common;
+        barrier.new_state = rhi::ResourceState::Common;
+        barrier.access_before_barrier = access_before;
+        barrier.access_after_barrier = access_after;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = 0;
+        barrier.buffer_memory_barrier.size = buffer->size;
+
+        return barrier;
+    }
+
+    GpuCulling::GpuCulling(rhi::RenderDevice& device,
+                           const uint32_t num_in_flight_frames,
+                           const uint32_t initial_capacity,
+                           const bool frustum_culling,
+                           const bool cone_culling,
+                           const float lod_hysteresis)
+        : device{device},
+          frustum_culling{frustum_culling},
+          cone_culling{cone_culling},
+          lod_hysteresis{lod_hysteresis} {
+        ZoneScoped;
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = CULLING_PIPELINE_NAME;
+
+        const auto spirv = load_builtin_shader("gpu_culling.compute.hlsl", rhi::ShaderStage::Compute);
+        if(spirv.empty()) {
+            logger->error("Could not compile the GPU culling shader");
+
+        } else {
+            pipeline_state.compute_shader = {"/nova/shaders/gpu_culling.compute.hlsl", spirv};
+            culling_pipeline = device.create_compute_pipeline(pipeline_state);
+        }
+
+        // Without compaction, MaterialPass draws every draw in a range, and the culled ones just have no instances
+        const auto compaction_spirv = load_builtin_shader("draw_compaction.compute.hlsl", rhi::ShaderStage::Compute);
+        if(compaction_spirv.empty()) {
+            logger->error("Could not compile the draw compaction shader");
+
+        } else {
+            RhiComputePipelineState compaction_state{};
+            compaction_state.name = COMPACTION_PIPELINE_NAME;
+            compaction_state.compute_shader = {"/nova/shaders/draw_compaction.compute.hlsl", compaction_spirv};
+            compaction_pipeline = device.create_compute_pipeline(compaction_state);
+        }
+
+        frames.resize(num_in_flight_frames);
+        for(uint32_t i = 0; i < num_in_flight_frames; i++) {
+            auto& frame = frames[i];
+            if(culling_pipeline) {
+                frame.binder = device.create_resource_binder_for_pipeline(*culling_pipeline);
+            }
+            if(compaction_pipeline) {
+                frame.compaction_binder = device.create_resource_binder_for_pipeline(*compaction_pipeline);
+            }
+
+            create_frame_buffers(frame, i, std::max(initial_capacity, 1U));
+        }
+
+        inputs_scratch.reserve(initial_capacity);
+        vertex_layouts_scratch.reserve(initial_capacity);
+        draws_scratch.reserve(initial_capacity);
+    }
+
+    GpuCulling::~GpuCulling() {
+        for(const FrameResources& frame : frames) {
+            device.destroy_buffer(frame.inputs);
+            device.destroy_buffer(frame.draw_templates);
+            device.destroy_buffer(frame.draw_commands);
+            device.destroy_buffer(frame.visible_model_matrices);
+            device.destroy_buffer(frame.vertex_layouts);
+            device.destroy_buffer(frame.draw_ranges);
+            device.destroy_buffer(frame.draw_counts);
+        }
+    }
+
+    void GpuCulling::create_frame_buffers(FrameResources& frame, const uint32_t frame_idx, const uint32_t capacity) {
+        ZoneScoped;
+        if(frame.capacity > 0) {
+            logger->debug("Growing frame slot {}'s culling buffers from {} to {} renderables", frame_idx, frame.capacity, capacity);
+
+            device.destroy_buffer(frame.inputs);
+            device.destroy_buffer(frame.draw_templates);
+            device.destroy_buffer(frame.draw_commands);
+            device.destroy_buffer(frame.visible_model_matrices);
+            device.destroy_buffer(frame.vertex_layouts);
+            device.destroy_buffer(frame.draw_ranges);
+            device.destroy_buffer(frame.draw_counts);
+        }
+
+        // Every culling input might end up in its own draw, so we need as many draws as inputs
+        const auto draws_size = sizeof(rhi::RhiDrawIndexedIndirectCommand) * capacity;
+
+        rhi::RhiBufferCreateInfo create_info{};
+        create_info.buffer_usage = rhi::BufferUsage::StorageBuffer;
+
+        create_info.name = fmt::format("GpuCullingInputs{}", frame_idx);
+        create_info.size = sizeof(CullingInput) * capacity;
+        frame.inputs = device.create_buffer(create_info);
+
+        create_info.name = fmt::format("GpuCullingDrawTemplates{}", frame_idx);
+        create_info.size = draws_size;
+        frame.draw_templates = device.create_buffer(create_info);
+
+        // Every range has at least one draw
+        create_info.name = fmt::format("GpuCullingDrawRanges{}", frame_idx);
+        create_info.size = sizeof(DrawRange) * capacity;
+        frame.draw_ranges = device.create_buffer(create_info);
+
+        create_info.name = fmt::format("GpuCullingVertexLayouts{}", frame_idx);
+        create_info.size = sizeof(uint32_t) * capacity;
+        frame.vertex_layouts = device.create_buffer(create_info);
+
+        create_info.buffer_usage = rhi::BufferUsage::DeviceStorageBuffer;
+
+        create_info.name = fmt::format("GpuCullingDrawCommands{}", frame_idx);
+        create_info.size = draws_size;
+        frame.draw_commands = device.create_buffer(create_info);
+
+        create_info.name = fmt::format("GpuCullingVisibleModelMatrices{}", frame_idx);
+        create_info.size = sizeof(glm::mat4) * capacity;
+        frame.visible_model_matrices = device.create_buffer(create_info);
+
+        create_info.name = fmt::format("GpuCullingDrawCounts{}", frame_idx);
+        create_info.size = sizeof(uint32_t) * capacity;
+        frame.draw_counts = device.create_buffer(create_info);
+
+        // The binder writes its descriptors when the dispatch is recorded, so rebinding it here is enough
+        if(frame.binder) {
+            frame.binder->bind_buffer("renderables", frame.inputs);
+            frame.binder->bind_buffer("draw_commands", frame.draw_commands);
+            frame.binder->bind_buffer("visible_model_matrices", frame.visible_model_matrices);
+        }
+        if(frame.compaction_binder) {
+            frame.compaction_binder->bind_buffer("draw_ranges", frame.draw_ranges);
+            frame.compaction_binder->bind_buffer("draw_commands", frame.draw_commands);
+            frame.compaction_binder->bind_buffer("draw_counts", frame.draw_counts);
+        }
+
+        frame.capacity = capacity;
+    }
+
+    void GpuCulling::gather_renderables(const uint32_t frame_idx,
+                                        std::vector<std::vector<MaterialPass>>& passes_by_pipeline,
+                                        const Camera* camera,
+                                        const VisibilityCache* occlusion_cache) {
+        ZoneScoped;
+        const auto camera_position = camera != nullptr ? std::optional<glm::vec3>{camera->position} : std::nullopt;
+        occlusion = camera != nullptr ? occlusion_cache : nullptr;
+        occlusion_camera = camera;
+
+        inputs_scratch.clear();
+        vertex_layouts_scratch.clear();
+        draws_scratch.clear();
+        draw_ranges_scratch.clear();
+
+        for(std::vector<MaterialPass>& passes : passes_by_pipeline) {
+            for(MaterialPass& pass : passes) {
+                sort_static_mesh_draws(pass, camera_position);
+                pass.static_mesh_draw_ranges.clear();
+
+                // Batches get their draw commands in sorted order, so neighbors that share mesh buffers can be drawn with one multi-draw
+                for(const uint32_t batch_idx : pass.static_mesh_draw_order) {
+                    MeshBatch& batch = pass.static_mesh_draws[batch_idx];
+
+                    // Orthographic cameras draw everything at the same size no matter how far away it is, so they always get full detail
+                    if(batch.lods && camera != nullptr && camera->field_of_view > 0) {
+                        select_lods(batch, *camera);
+                    }
+
+                    add_mesh_batch(batch);
+                    add_to_draw_ranges(pass, batch);
+                }
+
+                for(MeshDrawRange& range : pass.static_mesh_draw_ranges) {
+                    range.draw_count_idx = static_cast<uint32_t>(draw_ranges_scratch.size());
+                    draw_ranges_scratch.push_back({range.first_draw_command_idx, range.num_draw_commands});
+                }
+
+                for(ProceduralMeshBatch& batch : pass.static_procedural_mesh_draws) {
+                    batch.draw_command_idx = add_batch(batch.renderables,
+                                                       glm::vec4{0, 0, 0, -1},
+                                                       NO_NORMAL_CONE,
+                                                       NO_PULLED_VERTICES,
+                                                       {batch.mesh->get_num_indices(), 0, 0, 0, 0});
+                }
+
+                for(SkinnedMeshBatch& batch : pass.skinned_mesh_draws) {
+                    add_skinned_batch(batch);
+                }
+            }
+        }
+
+        occlusion = nullptr;
+        occlusion_camera = nullptr;
+
+        auto& frame = frames[frame_idx];
+        frame.num_renderables = static_cast<uint32_t>(inputs_scratch.size());
+        frame.num_draws = static_cast<uint32_t>(draws_scratch.size());
+        frame.num_draw_ranges = static_cast<uint32_t>(draw_ranges_scratch.size());
+
+        // This frame slot's fence has signaled, so the GPU is done with its old buffers. Batches never have more draws than renderables
+        if(frame.num_renderables > frame.capacity) {
+            auto new_capacity = frame.capacity;
+            while(new_capacity < frame.num_renderables) {
+                new_capacity *= 2;
+            }
+            create_frame_buffers(frame, frame_idx, new_capacity);
+        }
+
+        if(frame.num_renderables > 0) {
+            device.write_data_to_buffer(inputs_scratch.data(), sizeof(CullingInput) * inputs_scratch.size(), frame.inputs);
+            device.write_data_to_buffer(vertex_layouts_scratch.data(),
+                                        sizeof(uint32_t) * vertex_layouts_scratch.size(),
+                                        frame.vertex_layouts);
+            device.write_data_to_buffer(draws_scratch.data(),
+                                        sizeof(rhi::RhiDrawIndexedIndirectCommand) * draws_scratch.size(),
+                                        frame.draw_templates);
+            device.write_data_to_buffer(draw_ranges_scratch.data(), sizeof(DrawRange) * draw_ranges_scratch.size(), frame.draw_ranges);
+        }
+    }
+
+    void GpuCulling::sort_static_mesh_draws(MaterialPass& pass, const std::optional<glm::vec3>& camera_position) {
+        ZoneScoped;
+        sort_keys_scratch.clear();
+        buffer_groups_scratch.clear();
+
+        for(uint32_t batch_idx = 0; batch_idx < pass.static_mesh_draws.size(); batch_idx++) {
+            const MeshBatch& batch = pass.static_mesh_draws[batch_idx];
+
+            // There's only a handful of mesh arena buffers, so a linear search is plenty
+            const BufferGroup buffers{pass.pulls_vertices ? nullptr : batch.vertex_buffer, batch.index_buffer, batch.index_type};
+            auto group_itr = std::find(buffer_groups_scratch.begin(), buffer_groups_scratch.end(), buffers);
+            if(group_itr == buffer_groups_scratch.end()) {
+                group_itr = buffer_groups_scratch.insert(buffer_groups_scratch.end(), buffers);
+            }
+            const auto group = static_cast<uint64_t>(group_itr - buffer_groups_scratch.begin());
+
+            // The instances in a batch are drawn with one draw, so the batch can only be as near as its nearest visible renderable
+            float nearest_distance_squared = 0;
+            if(camera_position) {
+                nearest_distance_squared = std::numeric_limits<float>::max();
+                for(uint32_t i = 0; i < batch.renderables.size(); i++) {
+                    if(batch.renderables.visibilities[i] != 0) {
+                        const auto offset = glm::vec3{batch.renderables.model_matrices[i][3]} - *camera_position;
+                        nearest_distance_squared = std::min(nearest_distance_squared, glm::dot(offset, offset));
+                    }
+                }
+            }
+
+            // Non-negative floats sort the same way as their bits do
+            uint32_t depth;
+            memcpy(&depth, &nearest_distance_squared, sizeof(depth));
+
+            // Opaque passes normally keep their buffers bound for as long as they can, but a depth prepass rejects the most pixels when
+            // it's drawn strictly front-to-back
+            uint64_t key;
+            if(pass.is_transparent) {
+                key = static_cast<uint64_t>(~depth) << 32 | group;
+
+            } else if(pass.has_depth_prepass) {
+                key = static_cast<uint64_t>(depth) << 32 | group;
+
+            } else {
+                key = group << 32 | depth;
+            }
+            sort_keys_scratch.push_back({key, batch_idx});
+        }
+
+        radix_sort(sort_keys_scratch, sort_scratch);
+
+        pass.static_mesh_draw_order.clear();
+        pass.static_mesh_draw_order.reserve(sort_keys_scratch.size());
+        for(const SortKey& key : sort_keys_scratch) {
+            pass.static_mesh_draw_order.push_back(key.value);
+        }
+    }
+
+    void GpuCulling::select_lods(MeshBatch& batch, const Camera& camera) const {
+        const auto tan_half_fov = std::tan(camera.field_of_view * 0.5f);
+        auto& renderables = batch.renderables;
+
+        for(uint32_t i = 0; i < renderables.size(); i++) {
+            if(renderables.visibilities[i] == 0) {
+                continue;
+            }
+
+            const auto screen_size = get_projected_screen_size(batch.bounding_sphere,
+                                                               renderables.model_matrices[i],
+                                                               camera.position,
+                                                               tan_half_fov);
+            renderables.lods[i] = static_cast<uint8_t>(select_mesh_lod(*batch.lods, screen_size, renderables.lods[i], lod_hysteresis));
+        }
+    }
+
+    void GpuCulling::add_mesh_batch(MeshBatch& batch) {
+        batch.draw_command_idx = std::nullopt;
+        batch.num_draw_commands = 0;
+
+        // All of the batch's draws go right after each other, so MaterialPass can still issue them with one multi-draw
+        const auto add_draw = [&](const std::optional<uint32_t>& draw_idx) {
+            if(!draw_idx) {
+                return false;
+            }
+
+            if(!batch.draw_command_idx) {
+                batch.draw_command_idx = draw_idx;
+            }
+            batch.num_draw_commands++;
+
+            return true;
+        };
+
+        if(!batch.meshlets) {
+            add_draw(add_batch(batch.renderables,
+                               batch.bounding_sphere,
+                               NO_NORMAL_CONE,
+                               batch.pulled_vertex_layout,
+                               {batch.num_indices, 0, batch.first_index, batch.vertex_offset, 0}));
+
+        } else {
+            // Each meshlet is culled and drawn on its own
+            for(const Meshlet& meshlet : *batch.meshlets) {
+                const rhi::RhiDrawIndexedIndirectCommand draw{meshlet.num_indices,
+                                                              0,
+                                                              batch.first_index + meshlet.first_index,
+                                                              batch.vertex_offset,
+                                                              0};
+                const auto meshlet_draw_idx = add_batch(batch.renderables,
+                                                        meshlet.bounding_sphere,
+                                                        meshlet.normal_cone,
+                                                        batch.pulled_vertex_layout,
+                                                        draw);
+                if(!add_draw(meshlet_draw_idx)) {
+                    // Every meshlet has the same renderables, so if one has nothing to draw then none of them use full detail
+                    break;
+                }
+            }
+        }
+
+        if(batch.lods) {
+            for(uint32_t lod_idx = 1; lod_idx < batch.lods->size(); lod_idx++) {
+                const MeshLod& lod = (*batch.lods)[lod_idx];
+                add_draw(add_batch(batch.renderables,
+                                   batch.bounding_sphere,
+                                   NO_NORMAL_CONE,
+                                   batch.pulled_vertex_layout,
+                                   {lod.num_indices, 0, lod.first_index, batch.vertex_offset, 0},
+                                   static_cast<uint8_t>(lod_idx)));
+            }
+        }
+    }
+
+    void GpuCulling::add_to_draw_ranges(MaterialPass& pass, const MeshBatch& batch) {
+        if(!batch.draw_command_idx) {
+            return;
+        }
+
+        // Shaders that pull their own vertices find each draw's vertex buffer themselves
+        auto* vertex_buffer = pass.pulls_vertices ? nullptr : batch.vertex_buffer;
+        const auto num_vertex_attributes = pass.pulls_vertices ? 0 : batch.num_vertex_attributes;
+
+        auto& ranges = pass.static_mesh_draw_ranges;
+        if(!ranges.empty()) {
+            MeshDrawRange& last_range = ranges.back();
+            if(last_range.vertex_buffer == vertex_buffer && last_range.index_buffer == batch.index_buffer &&
+               last_range.index_type == batch.index_type && last_range.num_vertex_attributes == num_vertex_attributes &&
+               last_range.first_draw_command_idx + last_range.num_draw_commands == *batch.draw_command_idx) {
+                last_range.num_draw_commands += batch.num_draw_commands;
+                return;
+            }
+        }
+
+        ranges.push_back(
+            {vertex_buffer, batch.index_buffer, batch.index_type, num_vertex_attributes, *batch.draw_command_idx, batch.num_draw_commands});
+    }
+
+    void GpuCulling::add_skinned_batch(SkinnedMeshBatch& batch) {
+        batch.draw_command_idx = std::nullopt;
+        batch.num_draw_commands = 0;
+        if(batch.num_indices == 0) {
+            return;
+        }
+
+        const auto& renderables = batch.renderables;
+        for(uint32_t i = 0; i < renderables.size(); i++) {
+            if(renderables.visibilities[i] == 0) {
+                continue;
+            }
+
+            if(occlusion != nullptr && occlusion->is_renderable_occluded(*occlusion_camera, renderables.ids[i])) {
+                continue;
+            }
+
+            const auto draw_idx = static_cast<uint32_t>(draws_scratch.size());
+            const auto first_instance = static_cast<uint32_t>(inputs_scratch.size());
+
+            const auto model = glm::transpose(renderables.model_matrices[i]);
+            inputs_scratch.push_back({{model[0], model[1], model[2]}, batch.bounding_sphere, NO_NORMAL_CONE, draw_idx, {}});
+            vertex_layouts_scratch.push_back(NO_PULLED_VERTICES);
+
+            // The culling shader fills in the instance count
+            draws_scratch.push_back(
+                {batch.num_indices, 0, batch.first_index, static_cast<int32_t>(batch.first_vertices[i]), first_instance});
+
+            if(!batch.draw_command_idx) {
+                batch.draw_command_idx = draw_idx;
+            }
+            batch.num_draw_commands++;
+        }
+    }
+
+    std::optional<uint32_t> GpuCulling::add_batch(const RenderableColumns& renderables,
+                                                  const glm::vec4& bounding_sphere,
+                                                  const glm::vec4& normal_cone,
+                                                  const uint32_t pulled_vertex_layout,
+                                                  rhi::RhiDrawIndexedIndirectCommand draw,
+                                                  const uint8_t lod) {
+        if(draw.index_count == 0) {
+            return std::nullopt;
+        }
+
+        const auto draw_idx = static_cast<uint32_t>(draws_scratch.size());
+        const auto first_instance = static_cast<uint32_t>(inputs_scratch.size());
+
+        for(uint32_t i = 0; i < renderables.size(); i++) {
+            if(renderables.visibilities[i] == 0 || renderables.lods[i] != lod) {
+                continue;
+            }
+
+            if(occlusion != nullptr && occlusion->is_renderable_occluded(*occlusion_camera, renderables.ids[i])) {
+                continue;
+            }
+
+            const auto model = glm::transpose(renderables.model_matrices[i]);
+            inputs_scratch.push_back({{model[0], model[1], model[2]}, bounding_sphere, normal_cone, draw_idx, {}});
+        }
+
+        if(inputs_scratch.size() == first_instance) {
+            return std::nullopt;
+        }
+
+        vertex_layouts_scratch.resize(inputs_scratch.size(), pulled_vertex_layout);
+
+        // The culling shader fills in the instance count
+        draw.instance_count = 0;
+        draw.first_instance = first_instance;
+        draws_scratch.push_back(draw);
+
+        return draw_idx;
+    }
+
+    void GpuCulling::record_culling(rhi::RhiRenderCommandList& cmds, const uint32_t frame_idx, FrameUploadAllocator& uploads) {
+        ZoneScoped;
+        auto& frame = frames[frame_idx];
+        frame.params = {};
+        if(frame.num_renderables == 0 || !culling_pipeline) {
+            return;
+        }
+
+        // The binder's descriptors are written when the dispatch is recorded, so the parameters need their spot in the upload buffer
+        // now, even though the camera isn't final until the whole frame is recorded
+        const auto params = uploads.allocate(sizeof(CullingParams));
+        if(!params) {
+            return;
+        }
+        frame.params = *params;
+        frame.binder->bind_buffer_range("params", frame.params.buffer, frame.params.offset, frame.params.size);
+
+        const auto draws_size = sizeof(rhi::RhiDrawIndexedIndirectCommand) * frame.num_draws;
+        cmds.copy_buffer(frame.draw_commands, 0, frame.draw_templates, 0, draws_size);
+
+        // The culling shader increments the instance counts that we just copied in, which is both a read and a write
+        const auto copy_to_read = make_buffer_barrier(frame.draw_commands, rhi::ResourceAccess::CopyWrite, rhi::ResourceAccess::ShaderRead);
+        const auto copy_to_write = make_buffer_barrier(frame.draw_commands, rhi::ResourceAccess::CopyWrite, rhi::ResourceAccess::ShaderWrite);
+        cmds.resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::ComputeShader, std::array{copy_to_read, copy_to_write});
+
+        cmds.set_compute_pipeline(*culling_pipeline);
+        cmds.bind_compute_resources(*frame.binder, frame_idx);
+        cmds.dispatch((frame.num_renderables + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE);
+
+        if(compaction_pipeline && frame.num_draw_ranges > 0) {
+            // Compaction needs the final instance counts, so it has to wait for every culling thread
+            const auto cull_to_read = make_buffer_barrier(frame.draw_commands,
+                                                          rhi::ResourceAccess::ShaderWrite,
+                                                          rhi::ResourceAccess::ShaderRead);
+            const auto cull_to_write = make_buffer_barrier(frame.draw_commands,
+                                                           rhi::ResourceAccess::ShaderWrite,
+                                                           rhi::ResourceAccess::ShaderWrite);
+            cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                                   rhi::PipelineStage::ComputeShader,
+                                   std::array{cull_to_read, cull_to_write});
+
+            cmds.set_compute_pipeline(*compaction_pipeline);
+            cmds.bind_compute_resources(*frame.compaction_binder, frame_idx);
+            cmds.dispatch(frame.num_draw_ranges);
+
+            cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                                   rhi::PipelineStage::DrawIndirect,
+                                   std::array{make_buffer_barrier(frame.draw_counts,
+                                                                  rhi::ResourceAccess::ShaderWrite,
+                                                                  rhi::ResourceAccess::IndirectCommandRead)});
+        }
+
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                               rhi::PipelineStage::DrawIndirect,
+                               std::array{make_buffer_barrier(frame.draw_commands,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::IndirectCommandRead)});
+
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                               rhi::PipelineStage::VertexShader,
+                               std::array{make_buffer_barrier(frame.visible_model_matrices,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::ShaderRead)});
+    }
+
+    void GpuCulling::upload_frustum(const uint32_t frame_idx, const CameraUboData* camera) {
+        ZoneScoped;
+        auto& frame = frames[frame_idx];
+        if(frame.params.data == nullptr) {
+            return;
+        }
+
+        CullingParams params{};
+        params.num_renderables = frame.num_renderables;
+        params.frustum_culling_enabled = frustum_culling && camera != nullptr ? 1 : 0;
+        params.cone_culling_enabled = cone_culling && camera != nullptr ? 1 : 0;
+
+        if(camera != nullptr) {
+            const auto planes = get_frustum_planes(*camera);
+            std::copy(planes.begin(), planes.end(), params.frustum_planes);
+
+            params.camera_position = glm::inverse(camera->view)[3];
+        }
+
+        memcpy(frame.params.data, &params, sizeof(CullingParams));
+    }
+
+    rhi::RhiBuffer* GpuCulling::get_model_matrix_buffer(const uint32_t frame_idx) const { return frames[frame_idx].visible_model_matrices; }
+
+    rhi::RhiBuffer* GpuCulling::get_vertex_layout_buffer(const uint32_t frame_idx) const { return frames[frame_idx].vertex_layouts; }
+
+    rhi::RhiBuffer* GpuCulling::get_draw_command_buffer(const uint32_t frame_idx) const { return frames[frame_idx].draw_commands; }
+
+    rhi::RhiBuffer* GpuCulling::get_draw_count_buffer(const uint32_t frame_idx) const {
+        const auto& frame = frames[frame_idx];
+
+        // The counts are only written when the culling dispatch is. Without it the draws keep the instance counts of their templates
+        if(!compaction_pipeline || !culling_pipeline || frame.num_renderables == 0) {
+            return nullptr;
+        }
+
+        return frame.draw_counts;
+    }
+} // namespace nova::renderer
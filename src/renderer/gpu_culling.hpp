@@ -0,0 +1,343 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+#include "../util/radix_sort.hpp"
+
+#include "frame_upload_allocator.hpp"
+
+namespace nova::renderer {
+    class RhiResourceBinder;
+    struct RenderableColumns;
+    struct CameraUboData;
+    class Camera;
+    struct MaterialPass;
+    struct MeshBatch;
+    struct SkinnedMeshBatch;
+    class VisibilityCache;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Culls static meshes on the GPU, and writes the indirect draws that MaterialPass uses to render them
+     *
+     * Every frame, the CPU writes each visible renderable's model matrix and bounding sphere into a buffer. A compute shader then tests
+     * each renderable against the main camera's frustum, copies the model matrices of the renderables that survive into a tightly packed
+     * buffer, and bumps the instance count of their batch's indirect draw. A second compute shader then packs the draws that ended up with
+     * any instances at the start of their `MeshDrawRange`, and writes how many there are. MaterialPass issues one count-based multi-draw
+     * per range, so neither the CPU nor the GPU's command processor has to touch culled batches
+     *
+     * All the buffers are per frame slot, so the CPU can fill in one frame's data while the GPU culls and draws another. A frame slot's
+     * buffers grow when it has more renderables than they fit
+     */
+    class GpuCulling {
+    public:
+        /*!
+         * \brief Compiles the culling shader and creates the buffers for every in-flight frame
+         *
+         * \param device The device to create everything on
+         * \param num_in_flight_frames How many frame slots to make buffers for
+         * \param initial_capacity How many renderables each frame slot's buffers fit at first
+         * \param frustum_culling If false, the culling shader treats every renderable as on screen
+         * \param cone_culling If true, the culling shader skips meshlets that face away from the camera. Only does anything when
+         * `frustum_culling` is also true
+         * \param lod_hysteresis How far past a LOD's screen size renderables have to go to switch LODs. See `select_mesh_lod`
+         */
+        GpuCulling(rhi::RenderDevice& device,
+                   uint32_t num_in_flight_frames,
+                   uint32_t initial_capacity,
+                   bool frustum_culling,
+                   bool cone_culling,
+                   float lod_hysteresis);
+
+        GpuCulling(const GpuCulling& other) = delete;
+        GpuCulling& operator=(const GpuCulling& other) = delete;
+
+        GpuCulling(GpuCulling&& old) noexcept = delete;
+        GpuCulling& operator=(GpuCulling&& old) noexcept = delete;
+
+        ~GpuCulling();
+
+        /*!
+         * \brief Writes the culling inputs for every visible renderable in the provided material passes, and assigns each mesh batch its
+         * draw command
+         *
+         * Each material pass's mesh batches are sorted first, and get their draw commands in that order. See
+         * `MaterialPass::static_mesh_draw_order`. Renderables of meshes with LODs pick their LOD here too
+         *
+         * Must be called after the frame slot's fence has signaled, and before the rendergraph is recorded. This may recreate the frame
+         * slot's buffers, so get them after calling this
+         *
+         * \param camera The main camera, for sorting batches by depth and picking LODs. Nullptr if there's no camera
+         * \param occlusion_cache What occlusion queries found hidden from the main camera. Renderables it has marked as occluded are left
+         * out. Nullptr if occlusion queries are off
+         */
+        void gather_renderables(uint32_t frame_idx,
+                                std::vector<std::vector<MaterialPass>>& passes_by_pipeline,
+                                const Camera* camera,
+                                const VisibilityCache* occlusion_cache = nullptr);
+
+        /*!
+         * \brief Records the culling dispatch into the provided command list
+         *
+         * This must be recorded outside of any renderpass, and before any renderpass that draws meshes
+         *
+         * \param uploads Where to allocate this frame's culling parameters. `upload_frustum` fills them in later
+         */
+        void record_culling(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx, FrameUploadAllocator& uploads);
+
+        /*!
+         * \brief Uploads the frustum for the culling shader to test against
+         *
+         * Writes to the parameters that `record_culling` allocated, so call it after that and before the frame upload allocator is flushed
+         *
+         * \param frame_idx The frame slot to upload the frustum to
+         * \param camera The camera whose frustum to cull against, or nullptr to not cull anything this frame. Its matrices must already be
+         * up-to-date for this frame
+         */
+        void upload_frustum(uint32_t frame_idx, const CameraUboData* camera);
+
+        [[nodiscard]] rhi::RhiBuffer* get_model_matrix_buffer(uint32_t frame_idx) const;
+
+        /*!
+         * \brief Gets the buffer with the pulled vertex layout of every instance, which shaders index the same way as the model matrices
+         */
+        [[nodiscard]] rhi::RhiBuffer* get_vertex_layout_buffer(uint32_t frame_idx) const;
+
+        [[nodiscard]] rhi::RhiBuffer* get_draw_command_buffer(uint32_t frame_idx) const;
+
+        /*!
+         * \brief Gets the buffer with the number of visible draws in each `MeshDrawRange`, or nullptr if the draws aren't packed
+         */
+        [[nodiscard]] rhi::RhiBuffer* get_draw_count_buffer(uint32_t frame_idx) const;
+
+    private:
+        /*!
+         * \brief Per-renderable input to the culling shader. Matches `CullingInput` in the shader
+         */
+        struct CullingInput {
+            /*!
+             * \brief The first three rows of the model matrix. Model matrices are always affine, so the last row is always 0, 0, 0, 1
+             * and doesn't have to be uploaded
+             */
+            glm::vec4 model_rows[3];
+
+            glm::vec4 bounding_sphere;
+
+            /*!
+             * \brief See `Meshlet::normal_cone`
+             */
+            glm::vec4 normal_cone;
+
+            uint32_t draw_command_idx;
+
+            uint32_t padding[3];
+        };
+
+        /*!
+         * \brief Matches `CullingParams` in the shader
+         */
+        struct CullingParams {
+            /*!
+             * \brief Left, right, bottom, top, near, and far planes, with the normal in xyz and the distance in w
+             */
+            glm::vec4 frustum_planes[6];
+
+            glm::vec4 camera_position;
+
+            uint32_t num_renderables;
+
+            uint32_t frustum_culling_enabled;
+
+            uint32_t cone_culling_enabled;
+
+            uint32_t padding;
+        };
+
+        /*!
+         * \brief The draw commands of one `MeshDrawRange`. Matches `DrawRange` in the compaction shader
+         */
+        struct DrawRange {
+            uint32_t first_draw;
+
+            uint32_t num_draws;
+        };
+
+        struct FrameResources {
+            /*!
+             * \brief One CullingParams, in this frame's per-frame upload memory
+             */
+            FrameUploadAllocator::Allocation params;
+
+            /*!
+             * \brief One CullingInput for every renderable that the CPU thinks might be visible
+             */
+            rhi::RhiBuffer* inputs = nullptr;
+
+            /*!
+             * \brief Draw commands with an instance count of zero, which get copied into `draw_commands` before culling
+             */
+            rhi::RhiBuffer* draw_templates = nullptr;
+
+            /*!
+             * \brief The draw commands that the culling shader fills in
+             */
+            rhi::RhiBuffer* draw_commands = nullptr;
+
+            /*!
+             * \brief The model matrices of all the renderables that passed culling, ordered by batch
+             */
+            rhi::RhiBuffer* visible_model_matrices = nullptr;
+
+            /*!
+             * \brief The `Mesh::pulled_vertex_layout` of each culling input's draw
+             *
+             * The culling shader packs each draw's visible instances at the start of the draw's instances, and every instance of a draw
+             * has the same layout, so the CPU can write this up front and it still lines up with `visible_model_matrices`
+             */
+            rhi::RhiBuffer* vertex_layouts = nullptr;
+
+            /*!
+             * \brief One DrawRange for every `MeshDrawRange` in every material pass
+             */
+            rhi::RhiBuffer* draw_ranges = nullptr;
+
+            /*!
+             * \brief How many visible draws each range has, which the compaction shader fills in
+             */
+            rhi::RhiBuffer* draw_counts = nullptr;
+
+            std::unique_ptr<RhiResourceBinder> binder;
+
+            std::unique_ptr<RhiResourceBinder> compaction_binder;
+
+            /*!
+             * \brief How many renderables and draws the buffers fit
+             */
+            uint32_t capacity = 0;
+
+            uint32_t num_renderables = 0;
+
+            uint32_t num_draws = 0;
+
+            uint32_t num_draw_ranges = 0;
+        };
+
+        rhi::RenderDevice& device;
+
+        bool frustum_culling;
+
+        bool cone_culling;
+
+        float lod_hysteresis;
+
+        std::unique_ptr<rhi::RhiPipeline> culling_pipeline;
+
+        std::unique_ptr<rhi::RhiPipeline> compaction_pipeline;
+
+        std::vector<FrameResources> frames;
+
+        std::vector<CullingInput> inputs_scratch;
+
+        /*!
+         * \brief The pulled vertex layout of each element of `inputs_scratch`
+         */
+        std::vector<uint32_t> vertex_layouts_scratch;
+
+        std::vector<rhi::RhiDrawIndexedIndirectCommand> draws_scratch;
+
+        std::vector<DrawRange> draw_ranges_scratch;
+
+        std::vector<SortKey> sort_keys_scratch;
+
+        std::vector<SortKey> sort_scratch;
+
+        /*!
+         * \brief Vertex buffer, index buffer, and index type. Batches with the same ones can be drawn with one multi-draw. The vertex
+         * buffer is null in passes that pull their own vertices
+         */
+        using BufferGroup = std::tuple<const rhi::RhiBuffer*, const rhi::RhiBuffer*, rhi::IndexType>;
+
+        /*!
+         * \brief The buffer groups that the current material pass's batches use, in the order we first saw them
+         */
+        std::vector<BufferGroup> buffer_groups_scratch;
+
+        /*!
+         * \brief The occlusion results and camera that `gather_renderables` was given, for `add_batch` to check. Only set while
+         * renderables are being gathered
+         */
+        const VisibilityCache* occlusion = nullptr;
+        const Camera* occlusion_camera = nullptr;
+
+        /*!
+         * \brief Creates a frame slot's buffers with room for `capacity` renderables, and destroys the ones they replace
+         */
+        void create_frame_buffers(FrameResources& frame, uint32_t frame_idx, uint32_t capacity);
+
+        /*!
+         * \brief Fills in the pass's `static_mesh_draw_order`
+         *
+         * Opaque passes are sorted by mesh buffers and then front-to-back, so batches that can share a multi-draw end up next to each
+         * other and the depth test rejects as many pixels as possible. Transparent passes are sorted back-to-front, and only use the
+         * mesh buffers to break ties
+         */
+        void sort_static_mesh_draws(MaterialPass& pass, const std::optional<glm::vec3>& camera_position);
+
+        /*!
+         * \brief Picks the LOD of every visible renderable in a batch whose mesh has LODs
+         */
+        void select_lods(MeshBatch& batch, const Camera& camera) const;
+
+        /*!
+         * \brief Adds a mesh batch's draws and fills in the batch's draw commands
+         *
+         * The full-detail mesh gets one draw, or one for each of its meshlets if it has them. Each coarser LOD that any renderable uses
+         * gets one more
+         */
+        void add_mesh_batch(MeshBatch& batch);
+
+        /*!
+         * \brief Adds one draw for each visible renderable of a skinned mesh batch, since each of them has its own vertices
+         */
+        void add_skinned_batch(SkinnedMeshBatch& batch);
+
+        /*!
+         * \brief Adds a batch's draws to the pass's last draw range, or starts a new range if the batch uses different buffers
+         *
+         * Passes that pull their own vertices only care about the index buffer
+         */
+        static void add_to_draw_ranges(MaterialPass& pass, const MeshBatch& batch);
+
+        /*!
+         * \brief Adds the visible renderables of a batch that use the provided LOD to the culling inputs, and a draw for them to the draw
+         * templates
+         *
+         * \param pulled_vertex_layout Where shaders that pull their own vertices find the batch's vertices. See
+         * `MeshArena::get_pulled_vertex_layout`
+         * \param draw The draw for the batch's mesh. Its instance count and first instance get filled in here
+         *
+         * \return The index of the batch's draw command, or nullopt if the batch has nothing to draw
+         */
+        std::optional<uint32_t> add_batch(const RenderableColumns& renderables,
+                                          const glm::vec4& bounding_sphere,
+                                          const glm::vec4& normal_cone,
+                                          uint32_t pulled_vertex_layout,
+                                          rhi::RhiDrawIndexedIndirectCommand draw,
+                                          uint8_t lod = 0);
+    };
+} // namespace nova::renderer
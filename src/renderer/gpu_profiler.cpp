@@ -0,0 +1,204 @@
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("GpuProfiler");
+
+    GpuProfiler::GpuProfiler(rhi::RenderDevice& device,
+                             const uint32_t num_in_flight_frames,
+                             const uint32_t max_scopes_per_frame,
+                             const bool collect_pipeline_statistics)
+        : device{device}, max_scopes_per_frame{max_scopes_per_frame}, timestamp_period{device.info.timestamp_period} {
+        if(timestamp_period == 0 || max_scopes_per_frame == 0) {
+            logger->info("GPU timestamps aren't available, so passes won't be timed");
+            return;
+        }
+
+        const auto use_pipeline_statistics = collect_pipeline_statistics && device.info.supports_pipeline_statistics;
+        if(collect_pipeline_statistics && !use_pipeline_statistics) {
+            logger->warn("The device can't count pipeline statistics, so they won't be collected");
+        }
+
+        frames.resize(num_in_flight_frames);
+        for(Frame& frame : frames) {
+            frame.timestamps = device.create_timestamp_query_pool(max_scopes_per_frame * 2);
+            frame.scopes.resize(max_scopes_per_frame);
+
+            if(use_pipeline_statistics) {
+                frame.statistics = device.create_pipeline_statistics_query_pool(max_scopes_per_frame);
+                frame.statistics_names.resize(max_scopes_per_frame);
+            }
+        }
+
+        timestamps_scratch.reserve(max_scopes_per_frame * 2);
+        latest_timings.reserve(max_scopes_per_frame);
+    }
+
+    GpuProfiler::~GpuProfiler() {
+        for(Frame& frame : frames) {
+            device.destroy_query_pool(frame.timestamps);
+
+            if(frame.statistics != nullptr) {
+                device.destroy_query_pool(frame.statistics);
+            }
+        }
+    }
+
+    void GpuProfiler::begin_frame(const uint32_t frame_idx) {
+        ZoneScoped;
+        if(frames.empty()) {
+            return;
+        }
+
+        frames[cur_frame_idx].num_scopes = std::min(num_scopes_this_frame.load(), max_scopes_per_frame);
+        frames[cur_frame_idx].num_statistics = std::min(num_statistics_this_frame.load(), max_scopes_per_frame);
+
+        auto& frame = frames[frame_idx];
+        if(frame.num_scopes > 0) {
+            read_timings(frame);
+        }
+
+        if(frame.num_statistics > 0) {
+            read_pipeline_statistics(frame);
+        }
+
+        cur_frame_idx = frame_idx;
+        num_scopes_this_frame = 0;
+        num_statistics_this_frame = 0;
+    }
+
+    std::optional<uint32_t> GpuProfiler::begin_scope(rhi::RhiRenderCommandList& cmds,
+                                                     const uint32_t depth,
+                                                     const std::string_view name,
+                                                     const std::string_view name_suffix) {
+        if(frames.empty()) {
+            return std::nullopt;
+        }
+
+        const auto scope_idx = num_scopes_this_frame.fetch_add(1);
+        if(scope_idx >= max_scopes_per_frame) {
+            if(!warned_about_overflow.exchange(true)) {
+                logger->warn("More than {} passes in one frame, the extra passes won't be timed", max_scopes_per_frame);
+            }
+            return std::nullopt;
+        }
+
+        // Every thread gets its own scope, and the name strings keep their memory from frame to frame
+        auto& scope = frames[cur_frame_idx].scopes[scope_idx];
+        scope.name.assign(name);
+        if(!name_suffix.empty()) {
+            scope.name += '.';
+            scope.name += name_suffix;
+        }
+        scope.depth = depth;
+
+        cmds.write_timestamp(frames[cur_frame_idx].timestamps, scope_idx * 2, rhi::PipelineStage::TopOfPipe);
+
+        return scope_idx;
+    }
+
+    void GpuProfiler::end_scope(rhi::RhiRenderCommandList& cmds, const std::optional<uint32_t> scope) {
+        if(scope) {
+            cmds.write_timestamp(frames[cur_frame_idx].timestamps, *scope * 2 + 1, rhi::PipelineStage::BottomOfPipe);
+        }
+    }
+
+    std::optional<uint32_t> GpuProfiler::begin_pipeline_statistics(rhi::RhiRenderCommandList& cmds, const std::string_view name) {
+        if(frames.empty() || frames[cur_frame_idx].statistics == nullptr) {
+            return std::nullopt;
+        }
+
+        const auto query_idx = num_statistics_this_frame.fetch_add(1);
+        if(query_idx >= max_scopes_per_frame) {
+            return std::nullopt;
+        }
+
+        auto& frame = frames[cur_frame_idx];
+        frame.statistics_names[query_idx].assign(name);
+        cmds.begin_query(frame.statistics, query_idx);
+
+        return query_idx;
+    }
+
+    void GpuProfiler::end_pipeline_statistics(rhi::RhiRenderCommandList& cmds, const std::optional<uint32_t> query) {
+        if(query) {
+            cmds.end_query(frames[cur_frame_idx].statistics, *query);
+        }
+    }
+
+    const std::vector<GpuPassTiming>& GpuProfiler::get_latest_timings() const { return latest_timings; }
+
+    const std::vector<GpuPassStatistics>& GpuProfiler::get_latest_pipeline_statistics() const { return latest_statistics; }
+
+    void GpuProfiler::read_timings(Frame& frame) {
+        timestamps_scratch.clear();
+
+        // A submission that nothing waits on could still be running on another queue. If it is, we just keep the older timings
+        if(device.get_timestamps(frame.timestamps, 0, frame.num_scopes * 2, timestamps_scratch)) {
+            latest_timings.clear();
+            for(uint32_t i = 0; i < frame.num_scopes; i++) {
+                const auto begin = timestamps_scratch[i * 2];
+                const auto end = timestamps_scratch[i * 2 + 1];
+                const auto ticks = end > begin ? end - begin : 0;
+                const auto milliseconds = static_cast<double>(ticks) * timestamp_period / 1e6;
+
+                latest_timings.push_back({frame.scopes[i].name, frame.scopes[i].depth, milliseconds});
+            }
+        }
+
+        device.reset_queries(frame.timestamps, 0, frame.num_scopes * 2);
+        frame.num_scopes = 0;
+    }
+
+    void GpuProfiler::read_pipeline_statistics(Frame& frame) {
+        statistics_scratch.clear();
+
+        if(device.get_pipeline_statistics(frame.statistics, 0, frame.num_statistics, statistics_scratch)) {
+            latest_statistics.clear();
+            for(uint32_t i = 0; i < frame.num_statistics; i++) {
+                latest_statistics.push_back({frame.statistics_names[i], statistics_scratch[i]});
+            }
+        }
+
+        device.reset_queries(frame.statistics, 0, frame.num_statistics);
+        frame.num_statistics = 0;
+    }
+
+    GpuProfileScope::GpuProfileScope(GpuProfiler* profiler,
+                                     rhi::RhiRenderCommandList& cmds,
+                                     const uint32_t depth,
+                                     const std::string_view name,
+                                     const std::string_view name_suffix)
+        : profiler{profiler}, cmds{cmds} {
+        if(profiler != nullptr) {
+            scope = profiler->begin_scope(cmds, depth, name, name_suffix);
+        }
+    }
+
+    GpuProfileScope::~GpuProfileScope() {
+        if(profiler != nullptr) {
+            profiler->end_scope(cmds, scope);
+        }
+    }
+
+    PipelineStatisticsScope::PipelineStatisticsScope(GpuProfiler* profiler, rhi::RhiRenderCommandList& cmds, const std::string_view name)
+        : profiler{profiler}, cmds{cmds} {
+        if(profiler != nullptr) {
+            query = profiler->begin_pipeline_statistics(cmds, name);
+        }
+    }
+
+    PipelineStatisticsScope::~PipelineStatisticsScope() {
+        if(profiler != nullptr) {
+            profiler->end_pipeline_statistics(cmds, query);
+        }
+    }
+} // namespace nova::renderer
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "nova_renderer/gpu_timings.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Measures how long the GPU spends on each renderpass and material pass, with timestamps that the command lists write
+     *
+     * Every in-flight frame has its own pool of timestamps. A frame's timestamps are read back when its slot comes around again, after
+     * its fence has signaled, so reading them never waits on the GPU
+     *
+     * `begin_scope` and `end_scope` may be called from any thread, as long as they're called between two calls of `begin_frame`
+     *
+     * The profiler can also count the primitives and shader invocations of each renderpass with pipeline statistics queries. Those can't
+     * overlap, so only renderpasses are counted, not the material passes inside them
+     */
+    class GpuProfiler {
+    public:
+        /*!
+         * \param device The device to create timestamp pools on. If it can't write timestamps, the profiler does nothing
+         * \param num_in_flight_frames The number of frames that may be in flight at once
+         * \param max_scopes_per_frame The most passes that can be measured in one frame. Passes past this aren't measured
+         * \param collect_pipeline_statistics Whether to count pipeline statistics. Ignored if the device can't
+         */
+        GpuProfiler(rhi::RenderDevice& device,
+                    uint32_t num_in_flight_frames,
+                    uint32_t max_scopes_per_frame,
+                    bool collect_pipeline_statistics);
+
+        GpuProfiler(const GpuProfiler& other) = delete;
+        GpuProfiler& operator=(const GpuProfiler& other) = delete;
+
+        GpuProfiler(GpuProfiler&& old) noexcept = delete;
+        GpuProfiler& operator=(GpuProfiler&& old) noexcept = delete;
+
+        /*!
+         * \brief Destroys the timestamp pools. The GPU must be done with every frame that was measured
+         */
+        ~GpuProfiler();
+
+        /*!
+         * \brief Reads back the timings of the provided frame slot's previous frame, and gets its timestamps ready to be written again
+         *
+         * Call this after the frame slot's fence has signaled
+         */
+        void begin_frame(uint32_t frame_idx);
+
+        /*!
+         * \brief Records a timestamp at the start of a pass
+         *
+         * \param cmds The command list that records the pass
+         * \param depth See `GpuPassTiming::depth`
+         * \param name The name of the pass
+         * \param name_suffix Appended to `name` after a dot, if it isn't empty
+         *
+         * \return The scope to pass to `end_scope`, or nullopt if the pass isn't measured
+         */
+        [[nodiscard]] std::optional<uint32_t> begin_scope(rhi::RhiRenderCommandList& cmds,
+                                                          uint32_t depth,
+                                                          std::string_view name,
+                                                          std::string_view name_suffix = {});
+
+        /*!
+         * \brief Records a timestamp at the end of a pass. Must be recorded into the same command list as the matching `begin_scope`
+         */
+        void end_scope(rhi::RhiRenderCommandList& cmds, std::optional<uint32_t> scope);
+
+        /*!
+         * \brief Starts counting pipeline statistics for a renderpass. Only one renderpass can be counted at a time
+         *
+         * \param cmds A graphics command list. Must not be in a renderpass
+         *
+         * \return The query to pass to `end_pipeline_statistics`, or nullopt if the renderpass isn't counted
+         */
+        [[nodiscard]] std::optional<uint32_t> begin_pipeline_statistics(rhi::RhiRenderCommandList& cmds, std::string_view name);
+
+        void end_pipeline_statistics(rhi::RhiRenderCommandList& cmds, std::optional<uint32_t> query);
+
+        /*!
+         * \brief Gets the timings of the most recent frame that the GPU has finished
+         */
+        [[nodiscard]] const std::vector<GpuPassTiming>& get_latest_timings() const;
+
+        /*!
+         * \brief Gets the pipeline statistics of the most recent frame that the GPU has finished. Empty if they aren't being counted
+         */
+        [[nodiscard]] const std::vector<GpuPassStatistics>& get_latest_pipeline_statistics() const;
+
+    private:
+        struct Scope {
+            std::string name;
+
+            uint32_t depth = 0;
+        };
+
+        struct Frame {
+            /*!
+             * \brief Two timestamps per scope, one at the start and one at the end
+             */
+            rhi::RhiQueryPool* timestamps = nullptr;
+
+            std::vector<Scope> scopes;
+
+            uint32_t num_scopes = 0;
+
+            /*!
+             * \brief One query per counted renderpass. nullptr if pipeline statistics aren't being counted
+             */
+            rhi::RhiQueryPool* statistics = nullptr;
+
+            std::vector<std::string> statistics_names;
+
+            uint32_t num_statistics = 0;
+        };
+
+        rhi::RenderDevice& device;
+
+        uint32_t max_scopes_per_frame;
+
+        /*!
+         * \brief Nanoseconds per timestamp tick
+         */
+        double timestamp_period;
+
+        std::vector<Frame> frames;
+
+        uint32_t cur_frame_idx = 0;
+
+        std::atomic<uint32_t> num_scopes_this_frame{0};
+
+        std::atomic<bool> warned_about_overflow{false};
+
+        std::atomic<uint32_t> num_statistics_this_frame{0};
+
+        std::vector<uint64_t> timestamps_scratch;
+
+        std::vector<rhi::RhiPipelineStatistics> statistics_scratch;
+
+        std::vector<GpuPassTiming> latest_timings;
+
+        std::vector<GpuPassStatistics> latest_statistics;
+
+        void read_timings(Frame& frame);
+
+        void read_pipeline_statistics(Frame& frame);
+    };
+
+    /*!
+     * \brief Measures a pass for as long as it's alive. Does nothing if the profiler is nullptr
+     */
+    class GpuProfileScope {
+    public:
+        GpuProfileScope(GpuProfiler* profiler,
+                        rhi::RhiRenderCommandList& cmds,
+                        uint32_t depth,
+                        std::string_view name,
+                        std::string_view name_suffix = {});
+
+        GpuProfileScope(const GpuProfileScope& other) = delete;
+        GpuProfileScope& operator=(const GpuProfileScope& other) = delete;
+
+        GpuProfileScope(GpuProfileScope&& old) noexcept = delete;
+        GpuProfileScope& operator=(GpuProfileScope&& old) noexcept = delete;
+
+        ~GpuProfileScope();
+
+    private:
+        GpuProfiler* profiler;
+
+        rhi::RhiRenderCommandList& cmds;
+
+        std::optional<uint32_t> scope;
+    };
+
+    /*!
+     * \brief Counts a renderpass's pipeline statistics for as long as it's alive. Does nothing if the profiler is nullptr
+     */
+    class PipelineStatisticsScope {
+    public:
+        PipelineStatisticsScope(GpuProfiler* profiler, rhi::RhiRenderCommandList& cmds, std::string_view name);
+
+        PipelineStatisticsScope(const PipelineStatisticsScope& other) = delete;
+        PipelineStatisticsScope& operator=(const PipelineStatisticsScope& other) = delete;
+
+        PipelineStatisticsScope(PipelineStatisticsScope&& old) noexcept = delete;
+        PipelineStatisticsScope& operator=(PipelineStatisticsScope&& old) noexcept = delete;
+
+        ~PipelineStatisticsScope();
+
+    private:
+        GpuProfiler* profiler;
+
+        rhi::RhiRenderCommandList& cmds;
+
+        std::optional<uint32_t> query;
+    };
+} // namespace nova::renderer
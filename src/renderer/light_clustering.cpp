@@ -0,0 +1,250 @@
+#include "light_clustering.hpp"
+
+#include <array>
+#include <cmath>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/camera.hpp"
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "builtin_shaders.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("LightClustering");
+
+    constexpr const char* CLUSTERING_PIPELINE_NAME = "NovaLightClustering";
+
+    constexpr uint32_t CLUSTERING_GROUP_SIZE = 64;
+
+    static rhi::RhiResourceBarrier make_buffer_barrier(rhi::RhiBuffer* buffer,
+                                                       const rhi::ResourceAccess access_before,
+                                                       const rhi::ResourceAccess access_after) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = buffer;
+        barrier.old_state = rhi::ResourceState::Common;
+        barrier.new_state = rhi::ResourceState::Common;
+        barrier.access_before_barrier = access_before;
+        barrier.access_after_barrier = access_after;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = 0;
+        barrier.buffer_memory_barrier.size = buffer->size;
+
+        return barrier;
+    }
+
+    LightClustering::LightClustering(rhi::RenderDevice& device,
+                                     const NovaSettings::LightClusteringOptions& options,
+                                     const uint32_t num_in_flight_frames)
+        : device{device}, options{options} {
+        ZoneScoped;
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = CLUSTERING_PIPELINE_NAME;
+
+        const auto spirv = load_builtin_shader("light_clustering.compute.hlsl", rhi::ShaderStage::Compute);
+        if(spirv.empty()) {
+            logger->error("Could not compile the light clustering shader");
+
+        } else {
+            pipeline_state.compute_shader = {"/nova/shaders/light_clustering.compute.hlsl", spirv};
+            clustering_pipeline = device.create_compute_pipeline(pipeline_state);
+        }
+
+        rhi::RhiBufferCreateInfo zero_create_info{};
+        zero_create_info.name = "LightClusteringZero";
+        zero_create_info.buffer_usage = rhi::BufferUsage::StorageBuffer;
+        zero_create_info.size = sizeof(uint32_t);
+        zero_buffer = device.create_buffer(zero_create_info);
+
+        constexpr uint32_t zero = 0;
+        device.write_data_to_buffer(&zero, sizeof(zero), zero_buffer);
+
+        frames.resize(num_in_flight_frames);
+        for(uint32_t i = 0; i < num_in_flight_frames; i++) {
+            auto& frame = frames[i];
+
+            rhi::RhiBufferCreateInfo create_info{};
+            create_info.buffer_usage = rhi::BufferUsage::StorageBuffer;
+
+            create_info.name = fmt::format("{}{}", LIGHT_CLUSTER_PARAMS_BUFFER_NAME, i);
+            create_info.size = sizeof(ClusterParams);
+            frame.params = device.create_buffer(create_info);
+
+            create_info.name = fmt::format("{}{}", LIGHT_BUFFER_NAME, i);
+            create_info.size = sizeof(GpuLight) * std::max(options.max_lights, 1U);
+            frame.lights = device.create_buffer(create_info);
+
+            create_info.buffer_usage = rhi::BufferUsage::DeviceStorageBuffer;
+
+            create_info.name = fmt::format("{}{}", LIGHT_CLUSTER_BUFFER_NAME, i);
+            create_info.size = sizeof(glm::uvec2) * get_num_clusters();
+            frame.clusters = device.create_buffer(create_info);
+
+            create_info.name = fmt::format("{}{}", LIGHT_INDEX_BUFFER_NAME, i);
+            create_info.size = sizeof(uint32_t) * (options.max_light_indices + 1);
+            frame.light_indices = device.create_buffer(create_info);
+
+            if(clustering_pipeline) {
+                frame.binder = device.create_resource_binder_for_pipeline(*clustering_pipeline);
+                frame.binder->bind_buffer("params", frame.params);
+                frame.binder->bind_buffer("lights", frame.lights);
+                frame.binder->bind_buffer("light_clusters", frame.clusters);
+                frame.binder->bind_buffer("light_indices", frame.light_indices);
+            }
+
+            // Shaders read the params before the first frame writes them, so they have to say that there's nothing to read
+            const ClusterParams empty_params{};
+            device.write_data_to_buffer(&empty_params, sizeof(ClusterParams), frame.params);
+        }
+
+        lights.reserve(options.max_lights);
+        light_ids.reserve(options.max_lights);
+    }
+
+    LightClustering::~LightClustering() {
+        for(const FrameResources& frame : frames) {
+            device.destroy_buffer(frame.params);
+            device.destroy_buffer(frame.lights);
+            device.destroy_buffer(frame.clusters);
+            device.destroy_buffer(frame.light_indices);
+        }
+
+        device.destroy_buffer(zero_buffer);
+    }
+
+    std::optional<LightId> LightClustering::add_light(const PointLight& light) {
+        if(lights.size() >= options.max_lights) {
+            logger->error("There are already {} lights, which is as many as there can be", options.max_lights);
+            return std::nullopt;
+        }
+
+        const auto light_id = next_light_id++;
+        light_indices_by_id.emplace(light_id, static_cast<uint32_t>(lights.size()));
+        lights.push_back({glm::vec4{light.position, light.radius}, glm::vec4{light.color, light.intensity}});
+        light_ids.push_back(light_id);
+        lights_version++;
+
+        return light_id;
+    }
+
+    void LightClustering::update_light(const LightId light_id, const PointLight& light) {
+        const auto itr = light_indices_by_id.find(light_id);
+        if(itr == light_indices_by_id.end()) {
+            logger->error("Could not update light {}", light_id);
+            return;
+        }
+
+        lights[itr->second] = {glm::vec4{light.position, light.radius}, glm::vec4{light.color, light.intensity}};
+        lights_version++;
+    }
+
+    void LightClustering::remove_light(const LightId light_id) {
+        const auto itr = light_indices_by_id.find(light_id);
+        if(itr == light_indices_by_id.end()) {
+            logger->error("Could not remove light {}", light_id);
+            return;
+        }
+
+        const auto light_idx = itr->second;
+        light_indices_by_id.erase(itr);
+
+        if(light_idx != lights.size() - 1) {
+            lights[light_idx] = lights.back();
+            light_ids[light_idx] = light_ids.back();
+            light_indices_by_id.at(light_ids[light_idx]) = light_idx;
+        }
+
+        lights.pop_back();
+        light_ids.pop_back();
+        lights_version++;
+    }
+
+    void LightClustering::upload_lights(const uint32_t frame_idx) {
+        ZoneScoped;
+        auto& frame = frames[frame_idx];
+        if(frame.lights_version == lights_version) {
+            return;
+        }
+
+        if(!lights.empty()) {
+            device.write_data_to_buffer(lights.data(), sizeof(GpuLight) * lights.size(), frame.lights);
+        }
+
+        frame.lights_version = lights_version;
+        frame.num_lights = static_cast<uint32_t>(lights.size());
+    }
+
+    void LightClustering::record_clustering(rhi::RhiRenderCommandList& cmds, const uint32_t frame_idx) const {
+        ZoneScoped;
+        const auto& frame = frames[frame_idx];
+        if(!clustering_pipeline) {
+            return;
+        }
+
+        // The clustering shader counts the light indices up from zero, which is both a read and a write
+        cmds.copy_buffer(frame.light_indices, 0, zero_buffer, 0, sizeof(uint32_t));
+
+        const auto copy_to_read = make_buffer_barrier(frame.light_indices, rhi::ResourceAccess::CopyWrite, rhi::ResourceAccess::ShaderRead);
+        const auto copy_to_write = make_buffer_barrier(frame.light_indices,
+                                                       rhi::ResourceAccess::CopyWrite,
+                                                       rhi::ResourceAccess::ShaderWrite);
+        cmds.resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::ComputeShader, std::array{copy_to_read, copy_to_write});
+
+        cmds.set_compute_pipeline(*clustering_pipeline);
+        cmds.bind_compute_resources(*frame.binder, frame_idx);
+        cmds.dispatch((get_num_clusters() + CLUSTERING_GROUP_SIZE - 1) / CLUSTERING_GROUP_SIZE);
+
+        // Any shader may read the clusters, including the shaders of renderpack compute passes
+        const auto reading_stages = rhi::PipelineStage::VertexShader | rhi::PipelineStage::FragmentShader |
+                                    rhi::PipelineStage::ComputeShader;
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                               reading_stages,
+                               std::array{make_buffer_barrier(frame.clusters,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::ShaderRead),
+                                          make_buffer_barrier(frame.light_indices,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::ShaderRead)});
+    }
+
+    void LightClustering::upload_params(const uint32_t frame_idx, const Camera* camera, const CameraUboData* camera_data) const {
+        ZoneScoped;
+        const auto& frame = frames[frame_idx];
+
+        ClusterParams params{};
+        params.grid_size = {options.grid_width, options.grid_height, options.grid_depth, 0};
+        params.max_light_indices = options.max_light_indices;
+
+        // Orthographic cameras have no depth to slice by log depth. They're only used for the UI anyway
+        if(camera != nullptr && camera_data != nullptr && camera->field_of_view > 0 && camera->far_plane > camera->near_plane &&
+           camera->near_plane > 0) {
+            params.view = camera_data->view;
+            params.inverse_projection = glm::inverse(camera_data->projection);
+            params.grid_size.w = frame.num_lights;
+            params.near_plane = camera->near_plane;
+            params.far_plane = camera->far_plane;
+            params.slices_per_log_depth = static_cast<float>(options.grid_depth) / std::log(camera->far_plane / camera->near_plane);
+        }
+
+        device.write_data_to_buffer(&params, sizeof(ClusterParams), frame.params);
+    }
+
+    uint64_t LightClustering::get_lights_version() const { return lights_version; }
+
+    rhi::RhiBuffer* LightClustering::get_params_buffer(const uint32_t frame_idx) const { return frames[frame_idx].params; }
+
+    rhi::RhiBuffer* LightClustering::get_light_buffer(const uint32_t frame_idx) const { return frames[frame_idx].lights; }
+
+    rhi::RhiBuffer* LightClustering::get_cluster_buffer(const uint32_t frame_idx) const { return frames[frame_idx].clusters; }
+
+    rhi::RhiBuffer* LightClustering::get_light_index_buffer(const uint32_t frame_idx) const { return frames[frame_idx].light_indices; }
+
+    uint32_t LightClustering::get_num_clusters() const { return options.grid_width * options.grid_height * options.grid_depth; }
+} // namespace nova::renderer
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/lights.hpp"
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+namespace nova::renderer {
+    class RhiResourceBinder;
+    class Camera;
+    struct CameraUboData;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Keeps every light in a GPU buffer, and sorts them into the clusters of a froxel grid on the GPU every frame
+     *
+     * The grid cuts the main camera's frustum into tiles on the screen, and each tile into depth slices. A compute shader lists the lights
+     * that touch each cluster in one tightly packed index buffer, so pixel shaders only loop over the lights near them. Shaders read the
+     * results through the standard pipeline layout, with the functions in `./nova/clustered_lighting.hlsl`
+     *
+     * The grid is built from the camera alone, not from the depth buffer, so it doesn't have to wait for any renderpass. Every buffer is
+     * per frame slot, like GpuCulling's
+     */
+    class LightClustering {
+    public:
+        LightClustering(rhi::RenderDevice& device, const NovaSettings::LightClusteringOptions& options, uint32_t num_in_flight_frames);
+
+        LightClustering(const LightClustering& other) = delete;
+        LightClustering& operator=(const LightClustering& other) = delete;
+
+        LightClustering(LightClustering&& old) noexcept = delete;
+        LightClustering& operator=(LightClustering&& old) noexcept = delete;
+
+        ~LightClustering();
+
+        /*!
+         * \return The light's ID, or nothing if there are already `LightClusteringOptions::max_lights` lights
+         */
+        [[nodiscard]] std::optional<LightId> add_light(const PointLight& light);
+
+        void update_light(LightId light_id, const PointLight& light);
+
+        void remove_light(LightId light_id);
+
+        /*!
+         * \brief Writes the lights to the frame slot's light buffer, if they changed since that frame slot last got them
+         *
+         * Call this after the frame slot's fence has signaled, and before `record_clustering`
+         */
+        void upload_lights(uint32_t frame_idx);
+
+        /*!
+         * \brief Records the dispatch that sorts the lights into clusters
+         *
+         * This must be recorded outside of any renderpass, and before anything reads the light clusters
+         */
+        void record_clustering(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx) const;
+
+        /*!
+         * \brief Tells the clustering shader which camera to build the grid for
+         *
+         * \param camera The main camera, or nullptr if there isn't one. The grid only has lights for perspective cameras
+         * \param camera_data The main camera's matrices, which must already be up-to-date for this frame
+         */
+        void upload_params(uint32_t frame_idx, const Camera* camera, const CameraUboData* camera_data) const;
+
+        /*!
+         * \brief Goes up every time a light is added, changed, or removed
+         */
+        [[nodiscard]] uint64_t get_lights_version() const;
+
+        [[nodiscard]] rhi::RhiBuffer* get_params_buffer(uint32_t frame_idx) const;
+
+        [[nodiscard]] rhi::RhiBuffer* get_light_buffer(uint32_t frame_idx) const;
+
+        [[nodiscard]] rhi::RhiBuffer* get_cluster_buffer(uint32_t frame_idx) const;
+
+        [[nodiscard]] rhi::RhiBuffer* get_light_index_buffer(uint32_t frame_idx) const;
+
+    private:
+        /*!
+         * \brief Matches `Light` in the standard pipeline layout
+         */
+        struct GpuLight {
+            glm::vec4 position_and_radius;
+
+            glm::vec4 color_and_intensity;
+        };
+
+        /*!
+         * \brief Matches `LightClusterParams` in the standard pipeline layout
+         */
+        struct ClusterParams {
+            glm::mat4 view;
+
+            glm::mat4 inverse_projection;
+
+            /*!
+             * \brief The grid's size in clusters in xyz, and the number of lights in w
+             */
+            glm::uvec4 grid_size;
+
+            float near_plane;
+
+            float far_plane;
+
+            /*!
+             * \brief The number of depth slices divided by the log of the far plane over the near plane. A point's slice is the log of
+             * its depth over the near plane times this
+             */
+            float slices_per_log_depth;
+
+            uint32_t max_light_indices;
+        };
+
+        struct FrameResources {
+            rhi::RhiBuffer* params = nullptr;
+
+            rhi::RhiBuffer* lights = nullptr;
+
+            /*!
+             * \brief Where each cluster's light indices start in `light_indices`, and how many there are
+             */
+            rhi::RhiBuffer* clusters = nullptr;
+
+            /*!
+             * \brief How many light indices the clusters used, followed by the light indices of every cluster
+             */
+            rhi::RhiBuffer* light_indices = nullptr;
+
+            std::unique_ptr<RhiResourceBinder> binder;
+
+            /*!
+             * \brief `lights_version` when this frame slot's light buffer was last written
+             */
+            uint64_t lights_version = 0;
+
+            uint32_t num_lights = 0;
+        };
+
+        rhi::RenderDevice& device;
+
+        NovaSettings::LightClusteringOptions options;
+
+        std::unique_ptr<rhi::RhiPipeline> clustering_pipeline;
+
+        /*!
+         * \brief A single zero, which resets the light index count before the clustering shader runs
+         */
+        rhi::RhiBuffer* zero_buffer = nullptr;
+
+        std::vector<FrameResources> frames;
+
+        /*!
+         * \brief Every light, tightly packed. Removing a light moves the last light into its spot
+         */
+        std::vector<GpuLight> lights;
+
+        /*!
+         * \brief The ID of each light in `lights`
+         */
+        std::vector<LightId> light_ids;
+
+        std::unordered_map<LightId, uint32_t> light_indices_by_id;
+
+        LightId next_light_id = 0;
+
+        /*!
+         * \brief Goes up every time a light is added, changed, or removed. Starts at one, so every frame slot gets the lights once
+         */
+        uint64_t lights_version = 1;
+
+        [[nodiscard]] uint32_t get_num_clusters() const;
+    };
+} // namespace nova::renderer
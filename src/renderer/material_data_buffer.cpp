@@ -1,9 +1,73 @@
 #include "material_data_buffer.hpp"
 
-#include <rx/core/utility/move.h>
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
 
 namespace nova::renderer {
-    MaterialDataBuffer::MaterialDataBuffer(size_t num_bytes) : buffer(std::move(buffer)) {}
+    static auto logger = make_logger("MaterialDataBuffer");
+
+    static size_t num_dirty_blocks(const size_t num_bytes) {
+        return (num_bytes + MaterialDataBuffer::DIRTY_BLOCK_SIZE - 1) / MaterialDataBuffer::DIRTY_BLOCK_SIZE;
+    }
+
+    MaterialDataBuffer::MaterialDataBuffer(const size_t num_bytes, const uint32_t num_in_flight_frames)
+        : buffer(num_bytes), slab_allocator{num_bytes}, dirty_blocks{num_dirty_blocks(num_bytes), num_in_flight_frames} {}
+
+    void MaterialDataBuffer::upload_to_device(const uint32_t frame_idx, rhi::RenderDevice& device, const rhi::RhiBuffer* destination) {
+        ZoneScoped;
+        const auto destination_size = std::min<size_t>(buffer.size(), destination->size.b_count());
+
+        dirty_blocks.consume_dirty_ranges(frame_idx, [&](const size_t first_block, const size_t num_blocks) {
+            const auto offset = first_block * DIRTY_BLOCK_SIZE;
+            if(offset >= destination_size) {
+                return;
+            }
+
+            // The last block may be cut short by the end of the buffer
+            const auto num_bytes = std::min(num_blocks * DIRTY_BLOCK_SIZE, destination_size - offset);
+
+            device.write_data_to_buffer(buffer.data() + offset, num_bytes, offset, destination);
+        });
+    }
+
+    void MaterialDataBuffer::invalidate_frame(const uint32_t frame_idx) { dirty_blocks.invalidate_slot(frame_idx); }
+
+    uint8_t* MaterialDataBuffer::data() { return buffer.data(); }
+
+    size_t MaterialDataBuffer::size() const { return buffer.size(); }
+
+    void MaterialDataBuffer::add_slab(const size_t element_size, std::vector<uint32_t>& free_indices) {
+        const auto num_elements = std::max<size_t>(1, SLAB_SIZE / element_size);
+        const auto slab_size = num_elements * element_size;
+
+        auto offset = slab_allocator.allocate(slab_size, element_size);
+        if(!offset) {
+            // Lining the slab up with its element size may skip up to one element's worth of the new space
+            grow(buffer.size() + slab_size + element_size);
+            offset = slab_allocator.allocate(slab_size, element_size);
+        }
+
+        const auto first_idx = static_cast<uint32_t>(*offset / element_size);
+        free_indices.reserve(free_indices.size() + num_elements);
+        for(auto i = static_cast<uint32_t>(num_elements); i > 0; i--) {
+            free_indices.push_back(first_idx + i - 1);
+        }
+    }
+
+    void MaterialDataBuffer::grow(const size_t min_size) {
+        ZoneScoped;
+        auto new_size = std::max(buffer.size() * 2, min_size);
+        new_size = num_dirty_blocks(new_size) * DIRTY_BLOCK_SIZE;
+
+        logger->info("Growing the material buffer from {} to {} bytes", buffer.size(), new_size);
 
-    uint8_t* MaterialDataBuffer::data() const { return buffer.data; }
+        buffer.resize(new_size);
+        slab_allocator.grow(new_size);
+        dirty_blocks.resize(num_dirty_blocks(new_size));
+    }
 } // namespace nova::renderer
@@ -1,17 +1,42 @@
 #pragma once
 
 #include <cstdint>
+#include <unordered_map>
 #include <vector>
 
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/util/dirty_range_tracker.hpp"
+
+#include "../util/offset_allocator.hpp"
+
 namespace nova::renderer {
+    namespace rhi {
+        class RenderDevice;
+    }
+
     /*!
      * \brief Array that can hold data of multiple types of multiple sizes
      *
-     * This array uses a linear allocator internally
+     * Every element gets an index as if the buffer was an array of the element's type, because that's how shaders find their material
+     * data. That means an element of type T has to live at a multiple of `sizeof(T)`. Elements of the same size are carved out of slabs
+     * of `SLAB_SIZE` bytes, and each size keeps a free list of the slots in its slabs. Freed indices go back on their size's free list, so
+     * indices never move and mixed material types don't pad each other out. When no slab fits, the buffer grows
+     *
+     * Changes are tracked in blocks of `DIRTY_BLOCK_SIZE` bytes, so each frame only uploads the blocks that changed since its buffer was
+     * last written. The mutable `at` marks its element as changed. If you hold on to a pointer and write through it later, call
+     * `mark_dirty` yourself
      */
     class MaterialDataBuffer {
     public:
-        explicit MaterialDataBuffer(size_t num_bytes);
+        static constexpr uint32_t DIRTY_BLOCK_SIZE = 256;
+
+        static constexpr uint32_t SLAB_SIZE = 4096;
+
+        /*!
+         * \param num_bytes The initial size of the buffer
+         * \param num_in_flight_frames How many per-frame device buffers this buffer gets uploaded to
+         */
+        MaterialDataBuffer(size_t num_bytes, uint32_t num_in_flight_frames);
 
         MaterialDataBuffer(const MaterialDataBuffer& other) = delete;
         MaterialDataBuffer& operator=(const MaterialDataBuffer& other) = delete;
@@ -26,6 +51,8 @@ namespace nova::renderer {
          *
          * This operator performs no checks that the requested element is of the requested type. I recommend that you only use indices you
          * get from `get_next_free_index` with the same type as what you're requesting
+         *
+         * The reference is invalidated when the buffer grows. Indices stay valid forever
          */
         template <typename MaterialDataStruct>
         [[nodiscard]] MaterialDataStruct& at(uint32_t idx);
@@ -40,49 +67,99 @@ namespace nova::renderer {
         [[nodiscard]] const MaterialDataStruct& at(uint32_t idx) const;
 
         /*!
-         * \brief Gets the index of the next free element of the requested type
+         * \brief Gets the index of the next free element of the requested type, growing the buffer if there's no room for it
          */
         template <typename MaterialDataStruct>
         [[nodiscard]] uint32_t get_next_free_index();
 
-        [[nodiscard]] uint8_t* data() const;
+        /*!
+         * \brief Makes an element's index available to the next element of the same size
+         */
+        template <typename MaterialDataStruct>
+        void free_index(uint32_t idx);
+
+        /*!
+         * \brief Marks an element as changed, so the next uploads to each frame's buffer include it
+         */
+        template <typename MaterialDataStruct>
+        void mark_dirty(uint32_t idx);
+
+        /*!
+         * \brief Copies every block that changed since the last upload to this frame slot's buffer
+         *
+         * \param frame_idx The frame slot that `destination` belongs to
+         * \param device The device that owns `destination`
+         * \param destination The frame slot's material buffer. Must be CPU-writable. Anything past its end is skipped, so recreate it and
+         * call `invalidate_frame` when it's smaller than this buffer
+         */
+        void upload_to_device(uint32_t frame_idx, rhi::RenderDevice& device, const rhi::RhiBuffer* destination);
+
+        /*!
+         * \brief Makes the next upload to a frame slot copy the whole buffer. Call this when you replace the slot's device buffer
+         */
+        void invalidate_frame(uint32_t frame_idx);
+
+        [[nodiscard]] uint8_t* data();
+
+        [[nodiscard]] size_t size() const;
 
     private:
         std::vector<uint8_t> buffer;
 
-        uint32_t num_allocated_bytes = 0;
+        mem::OffsetAllocator slab_allocator;
+
+        /*!
+         * \brief Free indices of each element size. The back of each list is handed out next
+         */
+        std::unordered_map<size_t, std::vector<uint32_t>> free_indices_by_size;
+
+        DirtyRangeTracker dirty_blocks;
+
+        /*!
+         * \brief Carves a new slab for elements of the provided size out of the buffer, and puts its indices on `free_indices`
+         */
+        void add_slab(size_t element_size, std::vector<uint32_t>& free_indices);
+
+        void grow(size_t min_size);
     };
-    
+
     template <typename MaterialDataStruct>
     MaterialDataStruct& MaterialDataBuffer::at(uint32_t idx) {
-        return reinterpret_cast<MaterialDataStruct*>(buffer.data)[idx];
+        mark_dirty<MaterialDataStruct>(idx);
+        return reinterpret_cast<MaterialDataStruct*>(buffer.data())[idx];
     }
 
     template <typename MaterialDataStruct>
     const MaterialDataStruct& MaterialDataBuffer::at(uint32_t idx) const {
-        return reinterpret_cast<MaterialDataStruct*>(buffer.data)[idx];
+        return reinterpret_cast<const MaterialDataStruct*>(buffer.data())[idx];
     }
 
     template <typename MaterialDataStruct>
     uint32_t MaterialDataBuffer::get_next_free_index() {
-        constexpr uint32_t struct_size = sizeof(MaterialDataStruct);
+        // Every multiple of the size is a multiple of the alignment, so slots at multiples of the size are always correctly aligned
+        static_assert(sizeof(MaterialDataStruct) % alignof(MaterialDataStruct) == 0);
 
-        // Here's a Al Gore rhythm for your soul
+        auto& free_indices = free_indices_by_size[sizeof(MaterialDataStruct)];
+        if(free_indices.empty()) {
+            add_slab(sizeof(MaterialDataStruct), free_indices);
+        }
 
-        // This class is a party. The idea is that it's an array of any type you want. You reinterpret the buffer pointer to the type you
-        // want at runtime
-        //
-        // So like if you want to store five floats, one float3, and a float4x4 all in the same buffer... you can do that, and they each get
-        // an index. They get an index as if the buffer was an array of their type? So when we find a place to put them in the buffer - aka
-        // in this method - we have to align the number of already-allocated bytes to the size of the struct of the new material, rounding
-        // up. This means that we end up with a lot of empty bytes here any there. Ideally we can find a way to force alignment on material
-        // structs and avoid wasting _too_ much data, but who knows
+        const auto idx = free_indices.back();
+        free_indices.pop_back();
 
-        // Intentionally using integer division
-        const auto new_idx = (num_allocated_bytes / struct_size) + 1;
+        return idx;
+    }
 
-        num_allocated_bytes = struct_size * new_idx;
+    template <typename MaterialDataStruct>
+    void MaterialDataBuffer::free_index(const uint32_t idx) {
+        free_indices_by_size[sizeof(MaterialDataStruct)].push_back(idx);
+    }
+
+    template <typename MaterialDataStruct>
+    void MaterialDataBuffer::mark_dirty(const uint32_t idx) {
+        const auto first_byte = static_cast<size_t>(idx) * sizeof(MaterialDataStruct);
+        const auto last_byte = first_byte + sizeof(MaterialDataStruct) - 1;
 
-        return new_idx;
+        dirty_blocks.mark_dirty(first_byte / DIRTY_BLOCK_SIZE, last_byte / DIRTY_BLOCK_SIZE - first_byte / DIRTY_BLOCK_SIZE + 1);
     }
 } // namespace nova::renderer
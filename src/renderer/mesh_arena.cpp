@@ -0,0 +1,93 @@
+#include "mesh_arena.hpp"
+
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("MeshArena");
+
+    MeshArena::MeshArena(rhi::RenderDevice& device,
+                         const rhi::BufferUsage usage,
+                         const NovaSettings::BlockAllocatorSettings& settings,
+                         std::string name)
+        : device{device}, usage{usage}, settings{settings}, name{std::move(name)} {
+        // Almost every renderpack has at least one mesh, so we may as well make the first buffer now
+        create_page();
+    }
+
+    std::optional<MeshArena::Allocation> MeshArena::allocate(const uint64_t size, const uint64_t alignment) {
+        ZoneScoped;
+        if(size > settings.new_buffer_size) {
+            logger->error("Can't allocate {} bytes from {}, its buffers are only {} bytes", size, name, settings.new_buffer_size);
+            return std::nullopt;
+        }
+
+        for(auto& page : pages) {
+            if(const auto offset = page.allocator.allocate(size, alignment)) {
+                return Allocation{page.buffer, *offset, size};
+            }
+        }
+
+        auto* page = create_page();
+        if(page == nullptr) {
+            return std::nullopt;
+        }
+
+        if(const auto offset = page->allocator.allocate(size, alignment)) {
+            return Allocation{page->buffer, *offset, size};
+        }
+
+        return std::nullopt;
+    }
+
+    void MeshArena::free(const Allocation& allocation) {
+        for(auto& page : pages) {
+            if(page.buffer == allocation.buffer) {
+                page.allocator.free(allocation.offset, allocation.size);
+                return;
+            }
+        }
+
+        logger->error("Tried to free an allocation that didn't come from {}", name);
+    }
+
+    std::span<rhi::RhiBuffer* const> MeshArena::get_buffers() const { return buffers; }
+
+    uint32_t MeshArena::get_pulled_vertex_layout(const rhi::RhiBuffer* buffer, const uint32_t vertex_size) const {
+        const auto itr = std::find(buffers.begin(), buffers.end(), buffer);
+        const auto buffer_idx = static_cast<uint32_t>(itr - buffers.begin());
+        if(itr == buffers.end() || buffer_idx >= MAX_NUM_VERTEX_BUFFERS || vertex_size >= 1U << 24) {
+            return NO_PULLED_VERTICES;
+        }
+
+        return vertex_size << 8 | buffer_idx;
+    }
+
+    MeshArena::Page* MeshArena::create_page() {
+        const uint64_t total_size = static_cast<uint64_t>(settings.new_buffer_size) * (pages.size() + 1);
+        if(total_size > settings.max_total_allocation) {
+            logger->error("{} is out of memory. It has already allocated {} bytes", name, settings.new_buffer_size * pages.size());
+            return nullptr;
+        }
+
+        rhi::RhiBufferCreateInfo create_info{};
+        create_info.name = fmt::format("{}{}", name, pages.size());
+        create_info.size = settings.new_buffer_size;
+        create_info.buffer_usage = usage;
+
+        auto* buffer = device.create_buffer(create_info);
+        if(buffer == nullptr) {
+            logger->error("Could not create buffer {}", create_info.name);
+            return nullptr;
+        }
+
+        buffers.push_back(buffer);
+        return &pages.emplace_back(Page{buffer, mem::OffsetAllocator{settings.new_buffer_size}});
+    }
+} // namespace nova::renderer
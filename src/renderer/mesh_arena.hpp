@@ -0,0 +1,111 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_enums.hpp"
+
+#include "../util/offset_allocator.hpp"
+
+namespace nova::renderer {
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief A pool of large GPU buffers that meshes sub-allocate their vertex or index data from
+     *
+     * Meshes that share a buffer can be drawn one after another without rebinding anything, and eventually with a single multi-draw. The
+     * arena starts with one buffer, and adds more when the existing buffers are too full for a new mesh
+     */
+    class MeshArena {
+    public:
+        struct Allocation {
+            rhi::RhiBuffer* buffer = nullptr;
+
+            /*!
+             * \brief Offset, in bytes, of this allocation in `buffer`
+             */
+            uint64_t offset = 0;
+
+            uint64_t size = 0;
+        };
+
+        /*!
+         * \param device The device to create buffers on
+         * \param usage How the arena's buffers will be used. Should be VertexBuffer or IndexBuffer
+         * \param settings How large to make each buffer, and how much memory the arena may use in total
+         * \param name Name of the arena. Its buffers are named after it
+         */
+        MeshArena(rhi::RenderDevice& device, rhi::BufferUsage usage, const NovaSettings::BlockAllocatorSettings& settings, std::string name);
+
+        MeshArena(const MeshArena& other) = delete;
+        MeshArena& operator=(const MeshArena& other) = delete;
+
+        MeshArena(MeshArena&& old) noexcept = default;
+        MeshArena& operator=(MeshArena&& old) noexcept = delete;
+
+        ~MeshArena() = default;
+
+        /*!
+         * \brief Finds space for `size` bytes in one of the arena's buffers, creating a new buffer if none of the existing ones have room
+         *
+         * \param size The number of bytes to allocate
+         * \param alignment The offset of the allocation will be a multiple of this. Vertex allocations should use the size of one vertex,
+         * so that the offset can be expressed in vertices
+         *
+         * \return The new allocation, or nullopt if the arena is out of memory
+         */
+        [[nodiscard]] std::optional<Allocation> allocate(uint64_t size, uint64_t alignment);
+
+        /*!
+         * \brief Makes an allocation's space available to future allocations
+         */
+        void free(const Allocation& allocation);
+
+        /*!
+         * \brief All of the arena's buffers, in the order they were created. Buffers are never destroyed, so a buffer's index never
+         * changes
+         */
+        [[nodiscard]] std::span<rhi::RhiBuffer* const> get_buffers() const;
+
+        /*!
+         * \brief Describes where a mesh's vertices are, for vertex shaders that pull their own vertices
+         *
+         * The low eight bits are the index of the mesh's buffer in `get_buffers`, and the rest are the size of one vertex in bytes.
+         * Shaders read vertex N of the draw at byte N times the vertex size, which works because vertex allocations are aligned to the
+         * vertex size and draws start at the mesh's vertex offset
+         *
+         * \return The layout, or `NO_PULLED_VERTICES` if the buffer isn't in the first `MAX_NUM_VERTEX_BUFFERS` buffers of this arena
+         */
+        [[nodiscard]] uint32_t get_pulled_vertex_layout(const rhi::RhiBuffer* buffer, uint32_t vertex_size) const;
+
+    private:
+        struct Page {
+            rhi::RhiBuffer* buffer = nullptr;
+
+            mem::OffsetAllocator allocator;
+        };
+
+        rhi::RenderDevice& device;
+
+        rhi::BufferUsage usage;
+
+        NovaSettings::BlockAllocatorSettings settings;
+
+        std::string name;
+
+        std::vector<Page> pages;
+
+        /*!
+         * \brief The buffer of each page in `pages`
+         */
+        std::vector<rhi::RhiBuffer*> buffers;
+
+        Page* create_page();
+    };
+} // namespace nova::renderer
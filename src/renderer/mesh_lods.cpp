@@ -0,0 +1,110 @@
+#include "nova_renderer/mesh_lods.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Tracy.hpp>
+#include <meshoptimizer.h>
+
+namespace nova::renderer {
+    /*!
+     * \brief If a LOD has more than this fraction of the indices of the LOD before it, the simplifier has run out of things to take
+     * out, and more LODs would just waste memory
+     */
+    constexpr float MIN_LOD_REDUCTION = 0.9f;
+
+    /*!
+     * \brief How far the simplifier may move the surface, as a fraction of the mesh's size
+     *
+     * LODs are only seen from far away, so this can be pretty lax. The target index count is what usually stops simplification
+     */
+    constexpr float MAX_SIMPLIFICATION_ERROR = 0.05f;
+
+    std::vector<MeshLod> generate_mesh_lods(const MeshData& mesh,
+                                            const uint32_t num_lods,
+                                            const float first_screen_size,
+                                            std::vector<uint32_t>& lod_indices) {
+        ZoneScoped;
+        const auto* positions = static_cast<const float*>(mesh.vertex_data_ptr);
+        const auto num_vertices = mesh.vertex_data_size / mesh.vertex_size;
+
+        std::vector<MeshLod> lods;
+        lods.reserve(num_lods);
+
+        std::vector<uint32_t> source_indices(static_cast<const uint32_t*>(mesh.index_data_ptr),
+                                             static_cast<const uint32_t*>(mesh.index_data_ptr) + mesh.num_indices);
+        std::vector<uint32_t> simplified_indices(source_indices.size());
+
+        auto screen_size = first_screen_size;
+        for(uint32_t i = 0; i < num_lods; i++) {
+            // Every LOD is simplified from the one before, so each step only has half the work of the last
+            const auto target_num_indices = source_indices.size() / 6 * 3;
+            const auto num_indices = meshopt_simplify(simplified_indices.data(),
+                                                      source_indices.data(),
+                                                      source_indices.size(),
+                                                      positions,
+                                                      num_vertices,
+                                                      mesh.vertex_size,
+                                                      target_num_indices,
+                                                      MAX_SIMPLIFICATION_ERROR,
+                                                      0,
+                                                      nullptr);
+
+            if(num_indices == 0 || static_cast<float>(num_indices) > static_cast<float>(source_indices.size()) * MIN_LOD_REDUCTION) {
+                break;
+            }
+
+            lods.push_back({static_cast<uint32_t>(lod_indices.size()), static_cast<uint32_t>(num_indices), screen_size});
+            lod_indices.insert(lod_indices.end(), simplified_indices.begin(), simplified_indices.begin() + num_indices);
+
+            source_indices.assign(simplified_indices.begin(), simplified_indices.begin() + num_indices);
+            screen_size *= 0.5f;
+        }
+
+        return lods;
+    }
+
+    float get_projected_screen_size(const glm::vec4& bounding_sphere,
+                                    const glm::mat4& model_matrix,
+                                    const glm::vec3& camera_position,
+                                    const float tan_half_fov) {
+        const auto center = glm::vec3{model_matrix * glm::vec4{glm::vec3{bounding_sphere}, 1}};
+        const auto max_scale = std::sqrt(std::max({glm::dot(glm::vec3{model_matrix[0]}, glm::vec3{model_matrix[0]}),
+                                                   glm::dot(glm::vec3{model_matrix[1]}, glm::vec3{model_matrix[1]}),
+                                                   glm::dot(glm::vec3{model_matrix[2]}, glm::vec3{model_matrix[2]})}));
+        const auto radius = bounding_sphere.w * max_scale;
+
+        const auto distance = glm::distance(center, camera_position);
+        if(distance <= radius) {
+            return std::numeric_limits<float>::max();
+        }
+
+        // The sphere's diameter over the height of the view frustum at the sphere's distance
+        return radius / (distance * tan_half_fov);
+    }
+
+    uint32_t select_mesh_lod(const std::vector<MeshLod>& lods,
+                             const float screen_size,
+                             const uint32_t current_lod,
+                             const float hysteresis) {
+        uint32_t lod = 0;
+        for(uint32_t i = 1; i < lods.size(); i++) {
+            if(screen_size < lods[i].screen_size) {
+                lod = i;
+            }
+        }
+
+        // Coarser LODs have to be passed by the margin before we switch to them, and so do finer ones
+        const auto cur_lod = std::min(current_lod, static_cast<uint32_t>(lods.size() - 1));
+        while(lod > cur_lod && screen_size >= lods[lod].screen_size * (1 - hysteresis)) {
+            lod--;
+        }
+
+        while(lod < cur_lod && screen_size <= lods[lod + 1].screen_size * (1 + hysteresis)) {
+            lod++;
+        }
+
+        return lod;
+    }
+} // namespace nova::renderer
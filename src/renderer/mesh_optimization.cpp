@@ -0,0 +1,54 @@
+#include "mesh_optimization.hpp"
+
+#include <Tracy.hpp>
+#include <meshoptimizer.h>
+
+namespace nova::renderer {
+    /*!
+     * \brief How much worse the vertex cache hit rate may get so the overdraw optimizer can draw occluders first. meshoptimizer's docs
+     * recommend 1.05
+     */
+    constexpr float OVERDRAW_CACHE_THRESHOLD = 1.05f;
+
+    OptimizedMesh optimize_mesh(const MeshData& mesh, const bool remap_vertices) {
+        ZoneScoped;
+        const auto* source_indices = static_cast<const uint32_t*>(mesh.index_data_ptr);
+        const auto num_vertices = mesh.vertex_data_size / mesh.vertex_size;
+
+        OptimizedMesh optimized;
+        optimized.indices.resize(mesh.num_indices);
+        optimized.vertices.assign(static_cast<const std::byte*>(mesh.vertex_data_ptr),
+                                  static_cast<const std::byte*>(mesh.vertex_data_ptr) + mesh.vertex_data_size);
+
+        meshopt_optimizeVertexCache(optimized.indices.data(), source_indices, mesh.num_indices, num_vertices);
+
+        meshopt_optimizeOverdraw(optimized.indices.data(),
+                                 optimized.indices.data(),
+                                 optimized.indices.size(),
+                                 reinterpret_cast<const float*>(optimized.vertices.data()),
+                                 num_vertices,
+                                 mesh.vertex_size,
+                                 OVERDRAW_CACHE_THRESHOLD);
+
+        if(remap_vertices) {
+            const auto num_used_vertices = meshopt_optimizeVertexFetch(optimized.vertices.data(),
+                                                                       optimized.indices.data(),
+                                                                       optimized.indices.size(),
+                                                                       optimized.vertices.data(),
+                                                                       num_vertices,
+                                                                       mesh.vertex_size);
+            optimized.vertices.resize(num_used_vertices * mesh.vertex_size);
+        }
+
+        return optimized;
+    }
+
+    std::vector<uint16_t> narrow_indices(const std::vector<uint32_t>& indices) {
+        std::vector<uint16_t> narrow_indices(indices.size());
+        for(size_t i = 0; i < indices.size(); i++) {
+            narrow_indices[i] = static_cast<uint16_t>(indices[i]);
+        }
+
+        return narrow_indices;
+    }
+} // namespace nova::renderer
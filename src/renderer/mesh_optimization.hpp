@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "nova_renderer/renderables.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief A copy of a mesh's vertices and indices, reordered to be faster to draw
+     */
+    struct OptimizedMesh {
+        std::vector<std::byte> vertices;
+
+        std::vector<uint32_t> indices;
+    };
+
+    /*!
+     * \brief Reorders a mesh's triangles and vertices so the GPU spends less time on them
+     *
+     * Triangles are reordered for the post-transform vertex cache first, then clusters of them are reordered so the ones likely to
+     * cover the others are drawn first. Last, vertices are reordered into the order the triangles first use them, so vertex fetches
+     * stream through memory instead of jumping around. Vertices that no triangle uses are dropped
+     *
+     * The mesh must have 32-bit indices, and each vertex must start with its position as three floats
+     *
+     * \param remap_vertices If false, the vertices are left where they are. Application-provided LODs index into the original vertices,
+     * so meshes with them can't have their vertices moved
+     */
+    [[nodiscard]] OptimizedMesh optimize_mesh(const MeshData& mesh, bool remap_vertices);
+
+    /*!
+     * \brief Copies 32-bit indices into 16-bit ones. Every index must be less than 65536
+     */
+    [[nodiscard]] std::vector<uint16_t> narrow_indices(const std::vector<uint32_t>& indices);
+} // namespace nova::renderer
@@ -0,0 +1,142 @@
+#include "nova_renderer/meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <Tracy.hpp>
+
+namespace nova::renderer {
+    /*!
+     * \brief If the normals in a meshlet are closer together than this, measured as the cosine of the cone's half-angle, the meshlet
+     * isn't worth cone culling. Its cone would be so wide that the camera would hardly ever be inside it
+     */
+    constexpr float MIN_CONE_COSINE = 0.1f;
+
+    static glm::vec3 read_position(const MeshData& mesh, const uint32_t vertex_idx) {
+        const auto* vertex = static_cast<const std::byte*>(mesh.vertex_data_ptr) + static_cast<size_t>(vertex_idx) * mesh.vertex_size;
+
+        glm::vec3 position;
+        memcpy(&position, vertex, sizeof(position));
+
+        return position;
+    }
+
+    static void calculate_bounds(const MeshData& mesh, const std::vector<uint32_t>& indices, Meshlet& meshlet) {
+        auto min = glm::vec3{std::numeric_limits<float>::max()};
+        auto max = glm::vec3{std::numeric_limits<float>::lowest()};
+        for(uint32_t i = meshlet.first_index; i < meshlet.first_index + meshlet.num_indices; i++) {
+            const auto position = read_position(mesh, indices[i]);
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+
+        const auto center = (min + max) * 0.5f;
+        float radius = 0;
+        for(uint32_t i = meshlet.first_index; i < meshlet.first_index + meshlet.num_indices; i++) {
+            radius = std::max(radius, glm::distance(center, read_position(mesh, indices[i])));
+        }
+        meshlet.bounding_sphere = glm::vec4{center, radius};
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.num_indices / 3);
+
+        auto axis = glm::vec3{0};
+        for(uint32_t i = meshlet.first_index; i < meshlet.first_index + meshlet.num_indices; i += 3) {
+            const auto a = read_position(mesh, indices[i]);
+            const auto b = read_position(mesh, indices[i + 1]);
+            const auto c = read_position(mesh, indices[i + 2]);
+
+            const auto normal = glm::cross(b - a, c - a);
+            const auto length = glm::length(normal);
+            if(length == 0) {
+                // Degenerate triangles are never drawn, so they can face wherever they like
+                continue;
+            }
+
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+
+        if(normals.empty() || glm::length(axis) == 0) {
+            return;
+        }
+        axis = glm::normalize(axis);
+
+        float min_cosine = 1;
+        for(const auto& normal : normals) {
+            min_cosine = std::min(min_cosine, glm::dot(axis, normal));
+        }
+
+        if(min_cosine <= MIN_CONE_COSINE) {
+            return;
+        }
+
+        // The camera's view of the meshlet has to be within 90 degrees minus the cone's half-angle of the axis, so the culling test
+        // compares against the cosine of that, which is the sine of the half-angle
+        meshlet.normal_cone = glm::vec4{axis, std::sqrt(1 - min_cosine * min_cosine)};
+    }
+
+    MeshletMesh build_meshlets(const MeshData& mesh) {
+        ZoneScoped;
+        const auto* indices = static_cast<const uint32_t*>(mesh.index_data_ptr);
+        const auto num_vertices = static_cast<uint32_t>(mesh.vertex_data_size / mesh.vertex_size);
+
+        MeshletMesh meshlet_mesh;
+        meshlet_mesh.indices.reserve(mesh.num_indices);
+
+        // Which meshlet last used each vertex, so checking if a triangle adds any new vertices to the meshlet is a lookup
+        std::vector<uint32_t> vertex_meshlets(num_vertices, std::numeric_limits<uint32_t>::max());
+
+        Meshlet cur_meshlet;
+        uint32_t cur_num_vertices = 0;
+
+        const auto finish_meshlet = [&] {
+            if(cur_meshlet.num_indices == 0) {
+                return;
+            }
+
+            calculate_bounds(mesh, meshlet_mesh.indices, cur_meshlet);
+            meshlet_mesh.meshlets.push_back(cur_meshlet);
+
+            cur_meshlet = {};
+            cur_meshlet.first_index = static_cast<uint32_t>(meshlet_mesh.indices.size());
+            cur_num_vertices = 0;
+        };
+
+        for(uint32_t i = 0; i + 2 < mesh.num_indices; i += 3) {
+            const auto meshlet_idx = static_cast<uint32_t>(meshlet_mesh.meshlets.size());
+
+            uint32_t num_new_vertices = 0;
+            for(uint32_t corner = 0; corner < 3; corner++) {
+                // The same vertex can show up twice in one degenerate triangle, but counting it twice is harmless
+                if(vertex_meshlets[indices[i + corner]] != meshlet_idx) {
+                    num_new_vertices++;
+                }
+            }
+
+            if(cur_num_vertices + num_new_vertices > MAX_MESHLET_VERTICES || cur_meshlet.num_indices / 3 == MAX_MESHLET_TRIANGLES) {
+                finish_meshlet();
+            }
+
+            // finish_meshlet may have moved us to a new meshlet, which has none of the triangle's vertices yet
+            const auto new_meshlet_idx = static_cast<uint32_t>(meshlet_mesh.meshlets.size());
+            for(uint32_t corner = 0; corner < 3; corner++) {
+                auto& vertex_meshlet = vertex_meshlets[indices[i + corner]];
+                if(vertex_meshlet != new_meshlet_idx) {
+                    vertex_meshlet = new_meshlet_idx;
+                    cur_num_vertices++;
+                }
+
+                meshlet_mesh.indices.push_back(indices[i + corner]);
+            }
+
+            cur_meshlet.num_indices += 3;
+        }
+
+        finish_meshlet();
+
+        return meshlet_mesh;
+    }
+} // namespace nova::renderer
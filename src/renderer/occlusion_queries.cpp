@@ -0,0 +1,218 @@
+#include "occlusion_queries.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rendergraph.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "builtin_shaders.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("OcclusionQueries");
+
+    /*!
+     * \brief The 12 triangles of a box whose corner `n` has the sign of bit 0, 1, and 2 of `n` along the x, y, and z axes
+     */
+    constexpr std::array<uint32_t, 36> BOX_INDICES{0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                                   2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+
+    static_assert(sizeof(BOX_INDICES) == sizeof(glm::vec3) * 12);
+
+    OcclusionQueries::OcclusionQueries(rhi::RenderDevice& device, const uint32_t num_in_flight_frames, const uint32_t max_queries_per_frame)
+        : device{device}, max_queries_per_frame{max_queries_per_frame} {
+        const auto spirv = load_builtin_shader("occlusion_query_box.vertex.hlsl", rhi::ShaderStage::Vertex);
+        if(spirv.empty()) {
+            logger->error("Could not compile the occlusion query box shader, so nothing will be occlusion culled");
+
+        } else {
+            box_vertex_shader = ShaderSource{"/nova/shaders/occlusion_query_box.vertex.hlsl", spirv};
+        }
+
+        const auto boxes_size = sizeof(BOX_INDICES) + sizeof(glm::vec3) * 8 * static_cast<uint64_t>(max_queries_per_frame);
+
+        frames.reserve(num_in_flight_frames);
+        for(uint32_t i = 0; i < num_in_flight_frames; i++) {
+            auto& frame = *frames.emplace_back(std::make_unique<Frame>());
+            frame.queries = device.create_occlusion_query_pool(max_queries_per_frame);
+            frame.boxes = device.create_buffer(
+                {fmt::format("OcclusionQueryBoxes{}", i), boxes_size, rhi::BufferUsage::HostVisibleMeshBuffer});
+            frame.candidates.reserve(max_queries_per_frame);
+
+            // Every box has the same triangles, so the indices never change
+            device.write_data_to_buffer(BOX_INDICES.data(), sizeof(BOX_INDICES), frame.boxes);
+        }
+
+        next_candidates.reserve(max_queries_per_frame);
+        corners_scratch.reserve(8 * static_cast<size_t>(max_queries_per_frame));
+    }
+
+    OcclusionQueries::~OcclusionQueries() {
+        for(const auto& frame : frames) {
+            device.destroy_query_pool(frame->queries);
+            device.destroy_buffer(frame->boxes);
+        }
+    }
+
+    void OcclusionQueries::begin_frame(const uint32_t frame_idx, VisibilityCache& cache, const Camera* camera) {
+        ZoneScoped;
+        auto& frame = *frames[frame_idx];
+        const auto num_queries = static_cast<uint32_t>(frame.candidates.size());
+        if(frame.has_results && num_queries > 0) {
+            results_scratch.clear();
+            if(device.get_occlusion_query_results(frame.queries, 0, num_queries, results_scratch)) {
+                for(uint32_t i = 0; i < num_queries; i++) {
+                    const auto& candidate = frame.candidates[i];
+                    if(cache.get_renderable_bounds(candidate.renderable) == candidate.sphere) {
+                        cache.set_renderable_occluded(*frame.camera, candidate.renderable, results_scratch[i] == 0);
+                    }
+                }
+            }
+        }
+
+        if(num_queries > 0) {
+            device.reset_queries(frame.queries, 0, num_queries);
+        }
+
+        frame.candidates.clear();
+        frame.is_recorded = false;
+        frame.has_results = false;
+
+        if(camera == nullptr || !box_vertex_shader) {
+            next_candidates.clear();
+            return;
+        }
+
+        frame.candidates.swap(next_candidates);
+        frame.camera = *camera;
+
+        // The near plane cuts open boxes that the camera is in or right next to, and their backs may well be hidden. Those renderables
+        // are visible anyway
+        std::erase_if(frame.candidates, [&](const VisibilityCache::RenderableBounds& candidate) {
+            const auto half_diagonal = candidate.sphere.w * std::sqrt(3.0f);
+            const auto touches_camera = glm::length(glm::vec3{candidate.sphere} - camera->position) <= half_diagonal + camera->near_plane;
+            if(touches_camera) {
+                cache.set_renderable_occluded(*camera, candidate.renderable, false);
+            }
+
+            return touches_camera;
+        });
+
+        if(frame.candidates.empty()) {
+            return;
+        }
+
+        corners_scratch.clear();
+        for(const VisibilityCache::RenderableBounds& candidate : frame.candidates) {
+            const auto center = glm::vec3{candidate.sphere};
+            const auto radius = candidate.sphere.w;
+            for(uint32_t corner = 0; corner < 8; corner++) {
+                corners_scratch.emplace_back(center.x + ((corner & 1) != 0 ? radius : -radius),
+                                             center.y + ((corner & 2) != 0 ? radius : -radius),
+                                             center.z + ((corner & 4) != 0 ? radius : -radius));
+            }
+        }
+
+        const auto corners_size = sizeof(glm::vec3) * corners_scratch.size();
+        device.write_data_to_buffer(corners_scratch.data(), corners_size, sizeof(BOX_INDICES), frame.boxes);
+        device.flush_buffer(frame.boxes, 0, sizeof(BOX_INDICES) + corners_size);
+    }
+
+    void OcclusionQueries::pick_candidates(VisibilityCache& cache, const Camera& camera, const CameraUboData& camera_data) {
+        ZoneScoped;
+        next_candidates.clear();
+        if(box_vertex_shader) {
+            cache.get_occlusion_candidates(camera, camera_data, max_queries_per_frame, next_candidates);
+        }
+    }
+
+    bool OcclusionQueries::record_queries(rhi::RhiRenderCommandList& cmds, const Renderpass& renderpass, const uint32_t frame_idx) {
+        auto& frame = *frames[frame_idx];
+        if(frame.candidates.empty() || frame.is_recorded.load()) {
+            return false;
+        }
+
+        const rhi::RhiPipeline* pipeline = nullptr;
+        {
+            std::lock_guard lock{pipelines_mutex};
+            if(const auto itr = pipelines.find(&renderpass); itr != pipelines.end()) {
+                const auto& box_pipeline = itr->second;
+                if(box_pipeline.rhi_renderpass == renderpass.get_renderpass() && box_pipeline.subpass == renderpass.get_subpass_index()) {
+                    pipeline = box_pipeline.pipeline.get();
+                }
+            }
+        }
+
+        if(pipeline == nullptr || frame.is_recorded.exchange(true)) {
+            return false;
+        }
+
+        ZoneScoped;
+        cmds.set_pipeline(*pipeline);
+        cmds.bind_vertex_buffers({frame.boxes});
+        cmds.bind_index_buffer(frame.boxes, rhi::IndexType::Uint32);
+
+        for(uint32_t i = 0; i < frame.candidates.size(); i++) {
+            cmds.begin_query(frame.queries, i);
+            cmds.draw_indexed_mesh(static_cast<uint32_t>(BOX_INDICES.size()), 0, 1, static_cast<int32_t>(FIRST_BOX_VERTEX + i * 8));
+            cmds.end_query(frame.queries, i);
+        }
+
+        frame.has_results = true;
+
+        return true;
+    }
+
+    std::optional<RhiGraphicsPipelineState> OcclusionQueries::claim_pipeline(const Renderpass& renderpass,
+                                                                             const RhiGraphicsPipelineState& prepass_state) {
+        if(!box_vertex_shader || !prepass_state.depth_state) {
+            return std::nullopt;
+        }
+
+        {
+            std::lock_guard lock{pipelines_mutex};
+            if(!pipelines.try_emplace(&renderpass).second) {
+                return std::nullopt;
+            }
+        }
+
+        // Everything about the attachments stays the same, so the box pipeline is compatible with the renderpass
+        auto box_state = prepass_state;
+        box_state.name = fmt::format("{}_OcclusionQueries", renderpass.name);
+        box_state.vertex_shader = *box_vertex_shader;
+        box_state.geometry_shader.reset();
+        box_state.pixel_shader.reset();
+        box_state.vertex_fields = {{"position", rhi::VertexFieldFormat::Float3}};
+        box_state.topology = PrimitiveTopology::TriangleList;
+        box_state.rasterizer_state.cull_mode = PrimitiveCullingMode::None;
+        box_state.rasterizer_state.depth_bias = 0;
+        box_state.stencil_state.reset();
+        box_state.enable_color_write = false;
+        box_state.enable_alpha_write = false;
+
+        // Depth is reversed, so a sample in front of the depth prepass has a greater depth
+        box_state.depth_state->enable_depth_write = false;
+        box_state.depth_state->compare_op = CompareOp::GreaterEqual;
+
+        return box_state;
+    }
+
+    void OcclusionQueries::set_pipeline(const Renderpass& renderpass,
+                                        std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                        const rhi::RhiRenderpass* rhi_renderpass,
+                                        const uint32_t subpass) {
+        std::lock_guard lock{pipelines_mutex};
+        pipelines[&renderpass] = {std::move(pipeline), rhi_renderpass, subpass};
+    }
+
+    void OcclusionQueries::destroy_pipelines() {
+        std::lock_guard lock{pipelines_mutex};
+        pipelines.clear();
+    }
+} // namespace nova::renderer
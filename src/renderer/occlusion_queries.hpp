@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+
+#include "visibility_cache.hpp"
+
+namespace nova::renderer {
+    class Renderpass;
+
+    /*!
+     * \brief Finds out which big meshes are hidden behind other geometry, by drawing their bounding boxes against the depth prepass with
+     * hardware occlusion queries
+     *
+     * Each frame queries the renderables that `VisibilityCache::get_occlusion_candidates` picks, so the renderables themselves live in
+     * the cache. Every in-flight frame has its own query pool and its own buffer of boxes. A frame's results are read back when its slot
+     * comes around again, after its fence has signaled, so reading them never waits on the GPU. That means the cache learns what a frame
+     * could see a few frames after the fact
+     *
+     * The boxes enclose each renderable's bounding sphere, so they're a good bit bigger than the mesh inside them. A mesh that's about to
+     * come out from behind something usually pokes its box out first, which hides most of the lag
+     *
+     * The queries run once per frame, in the first renderpass with a depth prepass and no views. Each such renderpass gets its own box
+     * pipeline, built from the depth prepass of one of its pipelines so it fits the renderpass's attachments
+     */
+    class OcclusionQueries {
+    public:
+        /*!
+         * \param device The device to create query pools and box buffers on
+         * \param num_in_flight_frames The number of frames that may be in flight at once
+         * \param max_queries_per_frame The most renderables to query in one frame
+         */
+        OcclusionQueries(rhi::RenderDevice& device, uint32_t num_in_flight_frames, uint32_t max_queries_per_frame);
+
+        OcclusionQueries(const OcclusionQueries& other) = delete;
+        OcclusionQueries& operator=(const OcclusionQueries& other) = delete;
+
+        OcclusionQueries(OcclusionQueries&& old) noexcept = delete;
+        OcclusionQueries& operator=(OcclusionQueries&& old) noexcept = delete;
+
+        /*!
+         * \brief Destroys the query pools and box buffers. The GPU must be done with every frame that ran queries
+         */
+        ~OcclusionQueries();
+
+        /*!
+         * \brief Reads back the provided frame slot's previous queries into the cache, then writes the boxes of the renderables that
+         * `pick_candidates` picked last frame
+         *
+         * Renderables that moved since they were queried keep whatever the cache thinks of them now. Call this after the frame slot's
+         * fence has signaled
+         *
+         * \param camera The camera that this frame's queries are drawn with, or nullptr if there's no camera to query for
+         */
+        void begin_frame(uint32_t frame_idx, VisibilityCache& cache, const Camera* camera);
+
+        /*!
+         * \brief Picks the renderables that the next frame queries
+         *
+         * The camera's matrices aren't final until the current frame is recorded, and by then it's too late to add draws to it. The next
+         * frame's slot may still be in use by the GPU, so its boxes get written in its `begin_frame`. A renderable that comes into the
+         * frustum is queried a frame late, but it's never occluded while it's outside, so that only costs a few draws
+         *
+         * \param camera The camera that the queries are drawn with. Camera 0, since only passes without views run queries
+         * \param camera_data The camera's matrices, which the frustum comes from
+         */
+        void pick_candidates(VisibilityCache& cache, const Camera& camera, const CameraUboData& camera_data);
+
+        /*!
+         * \brief Draws this frame's boxes, with one query each, unless another renderpass already did this frame
+         *
+         * Call this after the renderpass's depth prepass, inside the renderpass. Does nothing if the renderpass's box pipeline isn't
+         * ready, or if it was built for a different RHI renderpass than the one the pass records into now
+         *
+         * \return True if the queries were recorded
+         */
+        bool record_queries(rhi::RhiRenderCommandList& cmds, const Renderpass& renderpass, uint32_t frame_idx);
+
+        /*!
+         * \brief Claims the provided renderpass's box pipeline, so that only one of its pipelines builds it
+         *
+         * \return The state to create the box pipeline with, made from `prepass_state`. Nothing if the renderpass already has its pipeline
+         * or another thread is building it, or if the box shader didn't compile
+         */
+        [[nodiscard]] std::optional<RhiGraphicsPipelineState> claim_pipeline(const Renderpass& renderpass,
+                                                                             const RhiGraphicsPipelineState& prepass_state);
+
+        /*!
+         * \brief Hands over the box pipeline for a renderpass that `claim_pipeline` returned a state for
+         *
+         * \param pipeline The compiled pipeline, or nullptr if it didn't compile
+         * \param rhi_renderpass The RHI renderpass and subpass that the pipeline was compiled against
+         */
+        void set_pipeline(const Renderpass& renderpass,
+                          std::unique_ptr<rhi::RhiPipeline> pipeline,
+                          const rhi::RhiRenderpass* rhi_renderpass,
+                          uint32_t subpass);
+
+        /*!
+         * \brief Destroys every box pipeline, so the renderpasses can be destroyed. The GPU must be done with them
+         */
+        void destroy_pipelines();
+
+    private:
+        /*!
+         * \brief 36 indices of a box's 12 triangles, then 8 corners for each box
+         *
+         * The indices take up exactly 12 vertices' worth of bytes, so box `n` starts at vertex `12 + 8 * n`
+         */
+        static constexpr uint32_t FIRST_BOX_VERTEX = 12;
+
+        rhi::RenderDevice& device;
+
+        uint32_t max_queries_per_frame;
+
+        std::optional<ShaderSource> box_vertex_shader;
+
+        struct Frame {
+            rhi::RhiQueryPool* queries = nullptr;
+
+            rhi::RhiBuffer* boxes = nullptr;
+
+            /*!
+             * \brief The renderables that this frame queried, with the bounds they had at the time. Query `n` belongs to candidate `n`
+             */
+            std::vector<VisibilityCache::RenderableBounds> candidates;
+
+            /*!
+             * \brief The camera that the candidates were picked for
+             */
+            std::optional<Camera> camera;
+
+            /*!
+             * \brief True once this frame's queries are recorded. Renderpasses that record in parallel race for it
+             */
+            std::atomic<bool> is_recorded = false;
+
+            /*!
+             * \brief Whether the GPU has run this frame's queries, so they're worth reading back
+             */
+            bool has_results = false;
+        };
+
+        std::vector<std::unique_ptr<Frame>> frames;
+
+        struct BoxPipeline {
+            std::unique_ptr<rhi::RhiPipeline> pipeline;
+
+            const rhi::RhiRenderpass* rhi_renderpass = nullptr;
+
+            uint32_t subpass = 0;
+        };
+
+        /*!
+         * \brief Every renderpass that has, or is building, a box pipeline. Pipelines compile on worker threads, so this needs a lock
+         */
+        std::unordered_map<const Renderpass*, BoxPipeline> pipelines;
+
+        std::mutex pipelines_mutex;
+
+        /*!
+         * \brief What `pick_candidates` picked for the next frame
+         */
+        std::vector<VisibilityCache::RenderableBounds> next_candidates;
+
+        std::vector<uint64_t> results_scratch;
+
+        std::vector<glm::vec3> corners_scratch;
+    };
+} // namespace nova::renderer
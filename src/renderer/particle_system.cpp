@@ -0,0 +1,508 @@
+#include "particle_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/rendergraph.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../rhi/draw_command_list.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("ParticleSystem");
+
+    constexpr const char* SIMULATION_PIPELINE_NAME = "NovaParticleSimulation";
+    constexpr const char* DRAW_ARGS_PIPELINE_NAME = "NovaParticleDrawArgs";
+
+    constexpr uint32_t PARTICLE_GROUP_SIZE = 64;
+
+    /*!
+     * \brief Matches `Particle` in the standard pipeline layout
+     */
+    constexpr uint32_t PARTICLE_SIZE = 64;
+
+    /*!
+     * \brief Frames that take longer than this are simulated as if they didn't, so a hitch doesn't fling every particle across the world
+     */
+    constexpr float MAX_DELTA_TIME = 0.1f;
+
+    constexpr const char* PARTICLE_TYPES_SOURCE = R"(
+struct Particle {
+    float3 position;
+    float age;
+    float3 velocity;
+    float lifetime;
+    float4 color;
+    float size;
+    uint emitter;
+    uint2 padding;
+};
+
+struct Emitter {
+    float3 position;
+    uint spawn_count;
+    float3 initial_velocity;
+    uint first_particle;
+    float3 velocity_randomness;
+    uint max_particles;
+    float3 spawn_extent;
+    float drag;
+    float3 acceleration;
+    float min_lifetime;
+    float4 start_color;
+    float4 end_color;
+    float max_lifetime;
+    float start_size;
+    float end_size;
+    uint seed;
+};
+
+struct SimulationParams {
+    float delta_time;
+    uint num_emitters;
+    uint source_counts_offset;
+    uint destination_counts_offset;
+    uint quad_first_index;
+    int quad_vertex_offset;
+    uint quad_num_indices;
+    uint padding;
+};
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<SimulationParams> params : register(t0);
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<Emitter> emitters : register(t1);
+)";
+
+    /*!
+     * \brief One thread per particle slot of each emitter. Threads under the emitter's live count update a particle, the ones right
+     * after it spawn new particles, and the rest do nothing. Every particle that's alive at the end is appended to the destination
+     * buffer, which packs the live particles at the start of the emitter's slots without sorting anything
+     */
+    constexpr const char* SIMULATION_SHADER_SOURCE = R"(
+[[vk::binding(2, 0)]]
+StructuredBuffer<Particle> source_particles : register(t2);
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<Particle> destination_particles : register(u0);
+
+[[vk::binding(4, 0)]]
+RWStructuredBuffer<uint> particle_counts : register(u1);
+
+uint pcg_hash(uint value) {
+    const uint state = value * 747796405u + 2891336453u;
+    const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float next_random(inout uint rng) {
+    rng = pcg_hash(rng);
+    return float(rng) / 4294967295.0;
+}
+
+float3 next_signed_random3(inout uint rng) {
+    const float x = next_random(rng);
+    const float y = next_random(rng);
+    const float z = next_random(rng);
+    return float3(x, y, z) * 2 - 1;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    const SimulationParams sim = params[0];
+    const uint emitter_idx = thread_id.y;
+    const Emitter emitter = emitters[emitter_idx];
+
+    const uint slot = thread_id.x;
+    if(slot >= emitter.max_particles) {
+        return;
+    }
+
+    const uint num_alive = min(particle_counts[sim.source_counts_offset + emitter_idx], emitter.max_particles);
+
+    Particle particle;
+    if(slot < num_alive) {
+        particle = source_particles[emitter.first_particle + slot];
+        particle.age += sim.delta_time;
+        if(particle.age >= particle.lifetime) {
+            return;
+        }
+
+        particle.velocity += emitter.acceleration * sim.delta_time;
+        particle.velocity *= pow(1 - emitter.drag, sim.delta_time);
+        particle.position += particle.velocity * sim.delta_time;
+
+    } else if(slot < num_alive + emitter.spawn_count) {
+        uint rng = pcg_hash(emitter.seed ^ (slot * 2654435769u));
+
+        particle.position = emitter.position + next_signed_random3(rng) * emitter.spawn_extent;
+        particle.velocity = emitter.initial_velocity + next_signed_random3(rng) * emitter.velocity_randomness;
+        particle.lifetime = lerp(emitter.min_lifetime, emitter.max_lifetime, next_random(rng));
+        particle.age = 0;
+        particle.emitter = emitter_idx;
+        particle.padding = uint2(0, 0);
+
+    } else {
+        return;
+    }
+
+    const float t = particle.lifetime > 0 ? saturate(particle.age / particle.lifetime) : 1;
+    particle.color = lerp(emitter.start_color, emitter.end_color, t);
+    particle.size = lerp(emitter.start_size, emitter.end_size, t);
+
+    uint destination_slot;
+    InterlockedAdd(particle_counts[sim.destination_counts_offset + emitter_idx], 1, destination_slot);
+    destination_particles[emitter.first_particle + destination_slot] = particle;
+})";
+
+    constexpr const char* DRAW_ARGS_SHADER_SOURCE = R"(
+[[vk::binding(2, 0)]]
+StructuredBuffer<uint> particle_counts : register(t2);
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<uint> draw_args : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    const SimulationParams sim = params[0];
+    const uint emitter_idx = thread_id.x;
+    if(emitter_idx >= sim.num_emitters) {
+        return;
+    }
+
+    // One quad per particle, whose SV_InstanceID is the particle's index in the particle buffer
+    const uint args = emitter_idx * 5;
+    draw_args[args] = sim.quad_num_indices;
+    draw_args[args + 1] = particle_counts[sim.destination_counts_offset + emitter_idx];
+    draw_args[args + 2] = sim.quad_first_index;
+    draw_args[args + 3] = asuint(sim.quad_vertex_offset);
+    draw_args[args + 4] = emitters[emitter_idx].first_particle;
+})";
+
+    static rhi::RhiResourceBarrier make_buffer_barrier(rhi::RhiBuffer* buffer,
+                                                       const rhi::ResourceAccess access_before,
+                                                       const rhi::ResourceAccess access_after) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = buffer;
+        barrier.old_state = rhi::ResourceState::Common;
+        barrier.new_state = rhi::ResourceState::Common;
+        barrier.access_before_barrier = access_before;
+        barrier.access_after_barrier = access_after;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = 0;
+        barrier.buffer_memory_barrier.size = buffer->size;
+
+        return barrier;
+    }
+
+    static std::unique_ptr<rhi::RhiPipeline> create_particle_pipeline(rhi::RenderDevice& device,
+                                                                      const char* name,
+                                                                      const char* filename,
+                                                                      const char* source) {
+        const auto full_source = std::string{PARTICLE_TYPES_SOURCE} + source;
+        const auto spirv = renderpack::compile_shader(full_source, rhi::ShaderStage::Compute, rhi::ShaderLanguage::Hlsl);
+        if(spirv.empty()) {
+            logger->error("Could not compile the {} shader", name);
+            return {};
+        }
+
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = name;
+        pipeline_state.compute_shader = {filename, spirv};
+
+        return device.create_compute_pipeline(pipeline_state);
+    }
+
+    ParticleSystem::ParticleSystem(rhi::RenderDevice& device, const uint32_t num_in_flight_frames) : device{device} {
+        ZoneScoped;
+        simulation_pipeline = create_particle_pipeline(device,
+                                                       SIMULATION_PIPELINE_NAME,
+                                                       "/nova/shaders/particle_simulation.compute.hlsl",
+                                                       SIMULATION_SHADER_SOURCE);
+        draw_args_pipeline = create_particle_pipeline(device,
+                                                      DRAW_ARGS_PIPELINE_NAME,
+                                                      "/nova/shaders/particle_draw_args.compute.hlsl",
+                                                      DRAW_ARGS_SHADER_SOURCE);
+
+        frames.resize(num_in_flight_frames);
+
+        // The standard pipeline layout always has a particle buffer, even when there are no emitters to fill it
+        create_buffers(1, 1);
+    }
+
+    ParticleSystem::~ParticleSystem() { destroy_buffers(); }
+
+    void ParticleSystem::set_emitters(const std::vector<renderpack::ParticleEmitterCreateInfo>& new_emitters) {
+        ZoneScoped;
+        emitters.clear();
+        emitters.reserve(new_emitters.size());
+        max_emitter_particles = 0;
+
+        // Slots are handed out in whole thread groups, so no group straddles two emitters
+        uint32_t num_particles = 0;
+        for(const auto& create_info : new_emitters) {
+            Emitter& emitter = emitters.emplace_back();
+            emitter.create_info = create_info;
+            emitter.first_particle = num_particles;
+
+            num_particles += (create_info.max_particles + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE * PARTICLE_GROUP_SIZE;
+            max_emitter_particles = std::max(max_emitter_particles, create_info.max_particles);
+        }
+
+        destroy_buffers();
+        create_buffers(std::max(num_particles, 1U), std::max(static_cast<uint32_t>(emitters.size()), 1U));
+
+        should_reset_counts = true;
+        last_frame_time = std::chrono::steady_clock::now();
+
+        logger->debug("Made {} particle emitters with {} particle slots", emitters.size(), num_particles);
+    }
+
+    void ParticleSystem::set_emitter_state(const std::string& name, const ParticleEmitterState& state) {
+        states_by_name.insert_or_assign(name, state);
+    }
+
+    void ParticleSystem::begin_frame(const uint32_t frame_idx, const Mesh& quad_mesh) {
+        ZoneScoped;
+        quad = quad_mesh;
+
+        const auto now = std::chrono::steady_clock::now();
+        const auto delta_time = std::min(std::chrono::duration<float>{now - last_frame_time}.count(), MAX_DELTA_TIME);
+        last_frame_time = now;
+
+        destination_buffer = 1 - destination_buffer;
+
+        if(emitters.empty()) {
+            return;
+        }
+
+        const auto& frame = frames[frame_idx];
+        const auto num_emitters = static_cast<uint32_t>(emitters.size());
+
+        const SimulationParams params{.delta_time = delta_time,
+                                      .num_emitters = num_emitters,
+                                      .source_counts_offset = (1 - destination_buffer) * num_emitters,
+                                      .destination_counts_offset = destination_buffer * num_emitters,
+                                      .quad_first_index = quad.first_index,
+                                      .quad_vertex_offset = quad.vertex_offset,
+                                      .quad_num_indices = quad.num_indices,
+                                      .padding = 0};
+        device.write_data_to_buffer(&params, sizeof(SimulationParams), frame.params);
+
+        std::vector<GpuEmitter> gpu_emitters;
+        gpu_emitters.reserve(emitters.size());
+        for(Emitter& emitter : emitters) {
+            const auto& info = emitter.create_info;
+
+            ParticleEmitterState state{};
+            if(const auto state_itr = states_by_name.find(info.name); state_itr != states_by_name.end()) {
+                state = state_itr->second;
+            }
+
+            // The shader doesn't spawn past the emitter's capacity, so there's no need to clamp the count here
+            const auto to_spawn = info.spawn_rate * std::max(state.spawn_rate_scale, 0.0f) * delta_time + emitter.spawn_remainder;
+            const auto spawn_count = std::floor(to_spawn);
+            emitter.spawn_remainder = to_spawn - spawn_count;
+
+            gpu_emitters.push_back({.position = state.position,
+                                    .spawn_count = static_cast<uint32_t>(std::min(spawn_count, static_cast<float>(info.max_particles))),
+                                    .initial_velocity = info.initial_velocity + state.velocity_offset,
+                                    .first_particle = emitter.first_particle,
+                                    .velocity_randomness = info.velocity_randomness,
+                                    .max_particles = info.max_particles,
+                                    .spawn_extent = info.spawn_extent,
+                                    .drag = info.drag,
+                                    .acceleration = info.acceleration,
+                                    .min_lifetime = info.min_lifetime,
+                                    .start_color = info.start_color,
+                                    .end_color = info.end_color,
+                                    .max_lifetime = info.max_lifetime,
+                                    .start_size = info.start_size,
+                                    .end_size = info.end_size,
+                                    .seed = next_seed++});
+        }
+
+        device.write_data_to_buffer(gpu_emitters.data(), sizeof(GpuEmitter) * gpu_emitters.size(), frame.emitters);
+    }
+
+    void ParticleSystem::record_simulation(rhi::RhiRenderCommandList& cmds, const uint32_t frame_idx) {
+        ZoneScoped;
+        const auto& frame = frames[frame_idx];
+        if(emitters.empty() || !simulation_pipeline || !draw_args_pipeline) {
+            return;
+        }
+
+        const auto num_emitters = static_cast<uint32_t>(emitters.size());
+        auto* destination_particles = particle_buffers[destination_buffer];
+
+        // Earlier frames drew the particles and read the draw arguments that this frame is about to overwrite
+        cmds.resource_barriers(rhi::PipelineStage::DrawIndirect | rhi::PipelineStage::VertexShader | rhi::PipelineStage::ComputeShader,
+                               rhi::PipelineStage::Transfer | rhi::PipelineStage::ComputeShader,
+                               std::array{make_buffer_barrier(destination_particles,
+                                                              rhi::ResourceAccess::ShaderRead,
+                                                              rhi::ResourceAccess::ShaderWrite),
+                                          make_buffer_barrier(draw_args_buffer,
+                                                              rhi::ResourceAccess::IndirectCommandRead,
+                                                              rhi::ResourceAccess::ShaderWrite),
+                                          make_buffer_barrier(count_buffer,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::CopyWrite)});
+
+        // The simulation counts the destination's particles up from zero. New emitters don't have any particles in the source either
+        const auto count_size = sizeof(uint32_t) * num_emitters;
+        cmds.copy_buffer(count_buffer, destination_buffer * count_size, zero_buffer, 0, count_size);
+        if(should_reset_counts) {
+            cmds.copy_buffer(count_buffer, (1 - destination_buffer) * count_size, zero_buffer, 0, count_size);
+            should_reset_counts = false;
+        }
+
+        const auto copy_to_read = make_buffer_barrier(count_buffer, rhi::ResourceAccess::CopyWrite, rhi::ResourceAccess::ShaderRead);
+        const auto copy_to_write = make_buffer_barrier(count_buffer, rhi::ResourceAccess::CopyWrite, rhi::ResourceAccess::ShaderWrite);
+        cmds.resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::ComputeShader, std::array{copy_to_read, copy_to_write});
+
+        // Binder 0 reads particle buffer 0, so it's the one to use when writing particle buffer 1
+        cmds.set_compute_pipeline(*simulation_pipeline);
+        cmds.bind_compute_resources(*frame.simulation_binders[1 - destination_buffer], frame_idx);
+        cmds.dispatch((max_emitter_particles + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, num_emitters);
+
+        const auto counts_written = make_buffer_barrier(count_buffer, rhi::ResourceAccess::ShaderWrite, rhi::ResourceAccess::ShaderRead);
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader, rhi::PipelineStage::ComputeShader, std::array{counts_written});
+
+        cmds.set_compute_pipeline(*draw_args_pipeline);
+        cmds.bind_compute_resources(*frame.draw_args_binder, frame_idx);
+        cmds.dispatch((num_emitters + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE);
+
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                               rhi::PipelineStage::DrawIndirect | rhi::PipelineStage::VertexShader |
+                                   rhi::PipelineStage::FragmentShader,
+                               std::array{make_buffer_barrier(destination_particles,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::ShaderRead),
+                                          make_buffer_barrier(draw_args_buffer,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::IndirectCommandRead)});
+    }
+
+    void ParticleSystem::record_draws(const FullMaterialPassName& material_pass, rhi::RhiRenderCommandList& rhi_cmds) const {
+        auto& cmds = rhi::get_draw_command_list(rhi_cmds);
+
+        bool is_quad_bound = false;
+        for(uint32_t i = 0; i < emitters.size(); i++) {
+            const auto& info = emitters[i].create_info;
+            if(info.material != material_pass.material_name || info.material_pass != material_pass.pass_name) {
+                continue;
+            }
+
+            if(!is_quad_bound) {
+                // Particle pipelines use the full vertex layout, which has seven attributes
+                const std::vector<rhi::RhiBuffer*> vertex_buffers(7, quad.vertex_buffer);
+                cmds.bind_vertex_buffers(vertex_buffers);
+                cmds.bind_index_buffer(quad.index_buffer, quad.index_type);
+                is_quad_bound = true;
+            }
+
+            cmds.draw_indexed_indirect(draw_args_buffer, i * sizeof(rhi::RhiDrawIndexedIndirectCommand), 1);
+        }
+    }
+
+    bool ParticleSystem::draws_into(const FullMaterialPassName& material_pass) const {
+        return std::any_of(emitters.begin(), emitters.end(), [&](const Emitter& emitter) {
+            return emitter.create_info.material == material_pass.material_name &&
+                   emitter.create_info.material_pass == material_pass.pass_name;
+        });
+    }
+
+    rhi::RhiBuffer* ParticleSystem::get_particle_buffer() const { return particle_buffers[destination_buffer]; }
+
+    void ParticleSystem::create_buffers(const uint32_t num_particles, const uint32_t num_emitters) {
+        rhi::RhiBufferCreateInfo create_info{};
+        create_info.buffer_usage = rhi::BufferUsage::DeviceStorageBuffer;
+
+        for(uint32_t i = 0; i < particle_buffers.size(); i++) {
+            create_info.name = fmt::format("NovaParticles{}", i);
+            create_info.size = PARTICLE_SIZE * num_particles;
+            particle_buffers[i] = device.create_buffer(create_info);
+        }
+
+        create_info.name = "NovaParticleCounts";
+        create_info.size = sizeof(uint32_t) * num_emitters * 2;
+        count_buffer = device.create_buffer(create_info);
+
+        create_info.name = "NovaParticleDrawArgs";
+        create_info.size = sizeof(rhi::RhiDrawIndexedIndirectCommand) * num_emitters;
+        draw_args_buffer = device.create_buffer(create_info);
+
+        create_info.buffer_usage = rhi::BufferUsage::StorageBuffer;
+
+        create_info.name = "NovaParticleCountsZero";
+        create_info.size = sizeof(uint32_t) * num_emitters;
+        zero_buffer = device.create_buffer(create_info);
+
+        const std::vector<uint32_t> zeros(num_emitters, 0);
+        device.write_data_to_buffer(zeros.data(), sizeof(uint32_t) * zeros.size(), zero_buffer);
+
+        for(uint32_t i = 0; i < frames.size(); i++) {
+            auto& frame = frames[i];
+
+            create_info.name = fmt::format("NovaParticleSimulationParams{}", i);
+            create_info.size = sizeof(SimulationParams);
+            frame.params = device.create_buffer(create_info);
+
+            create_info.name = fmt::format("NovaParticleEmitters{}", i);
+            create_info.size = sizeof(GpuEmitter) * num_emitters;
+            frame.emitters = device.create_buffer(create_info);
+
+            bind_frame_resources(frame);
+        }
+    }
+
+    void ParticleSystem::destroy_buffers() {
+        for(FrameResources& frame : frames) {
+            frame.simulation_binders = {};
+            frame.draw_args_binder = {};
+
+            device.destroy_buffer(frame.params);
+            device.destroy_buffer(frame.emitters);
+        }
+
+        for(auto* buffer : particle_buffers) {
+            device.destroy_buffer(buffer);
+        }
+
+        device.destroy_buffer(count_buffer);
+        device.destroy_buffer(draw_args_buffer);
+        device.destroy_buffer(zero_buffer);
+    }
+
+    void ParticleSystem::bind_frame_resources(FrameResources& frame) const {
+        if(simulation_pipeline) {
+            for(uint32_t source = 0; source < frame.simulation_binders.size(); source++) {
+                auto& binder = frame.simulation_binders[source];
+                binder = device.create_resource_binder_for_pipeline(*simulation_pipeline);
+                binder->bind_buffer("params", frame.params);
+                binder->bind_buffer("emitters", frame.emitters);
+                binder->bind_buffer("source_particles", particle_buffers[source]);
+                binder->bind_buffer("destination_particles", particle_buffers[1 - source]);
+                binder->bind_buffer("particle_counts", count_buffer);
+            }
+        }
+
+        if(draw_args_pipeline) {
+            frame.draw_args_binder = device.create_resource_binder_for_pipeline(*draw_args_pipeline);
+            frame.draw_args_binder->bind_buffer("params", frame.params);
+            frame.draw_args_binder->bind_buffer("emitters", frame.emitters);
+            frame.draw_args_binder->bind_buffer("particle_counts", count_buffer);
+            frame.draw_args_binder->bind_buffer("draw_args", draw_args_buffer);
+        }
+    }
+} // namespace nova::renderer
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/nova_renderer.hpp"
+#include "nova_renderer/particles.hpp"
+#include "nova_renderer/renderpack_data.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+namespace nova::renderer {
+    class RhiResourceBinder;
+    struct FullMaterialPassName;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Simulates the renderpack's particle emitters on the GPU, and draws their particles in the material passes they name
+     *
+     * Every emitter gets its own run of slots in two particle buffers. Each frame, a compute shader reads the live particles from one
+     * buffer, ages and moves them, and packs the ones that are still alive into the other buffer along with the particles it spawns. A
+     * second dispatch turns how many particles each emitter ended up with into an indirect draw of that many quads. The particles never
+     * come back to the CPU, which only writes how many particles to spawn and the state from `NovaRenderer::set_particle_emitter`
+     *
+     * Shaders read the particles through the standard pipeline layout, with `get_particle_vertex` from `./nova/particles.hlsl`
+     */
+    class ParticleSystem {
+    public:
+        ParticleSystem(rhi::RenderDevice& device, uint32_t num_in_flight_frames);
+
+        ParticleSystem(const ParticleSystem& other) = delete;
+        ParticleSystem& operator=(const ParticleSystem& other) = delete;
+
+        ParticleSystem(ParticleSystem&& old) noexcept = delete;
+        ParticleSystem& operator=(ParticleSystem&& old) noexcept = delete;
+
+        ~ParticleSystem();
+
+        /*!
+         * \brief Replaces every emitter with the renderpack's emitters. The new emitters start without any particles
+         *
+         * \pre No frame that the GPU hasn't finished uses the particle buffers
+         */
+        void set_emitters(const std::vector<renderpack::ParticleEmitterCreateInfo>& emitters);
+
+        /*!
+         * \brief Sets where an emitter is and how much it spawns. The state is kept by name, so it also applies to emitters with that
+         * name in renderpacks that are loaded later
+         */
+        void set_emitter_state(const std::string& name, const ParticleEmitterState& state);
+
+        /*!
+         * \brief Works out how many particles each emitter spawns this frame and writes it to the frame slot's emitter buffer, then
+         * switches which particle buffer is the one being written
+         *
+         * Call this once per frame, after the frame slot's fence has signaled and before `get_particle_buffer`
+         *
+         * \param quad The mesh that every particle is drawn with
+         */
+        void begin_frame(uint32_t frame_idx, const Mesh& quad);
+
+        /*!
+         * \brief Records the dispatches that simulate this frame's particles and write their draws
+         *
+         * This must be recorded outside of any renderpass, and before anything draws the particles
+         */
+        void record_simulation(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx);
+
+        /*!
+         * \brief Draws the particles of every emitter that's drawn by the provided material pass
+         *
+         * The material pass's descriptor sets and pipeline must already be bound
+         */
+        void record_draws(const FullMaterialPassName& material_pass, rhi::RhiRenderCommandList& cmds) const;
+
+        /*!
+         * \brief Whether any emitter is drawn by the provided material pass
+         */
+        [[nodiscard]] bool draws_into(const FullMaterialPassName& material_pass) const;
+
+        /*!
+         * \brief The particle buffer that this frame's simulation writes to and this frame's draws read from
+         */
+        [[nodiscard]] rhi::RhiBuffer* get_particle_buffer() const;
+
+    private:
+        /*!
+         * \brief Matches `Emitter` in the simulation shader
+         */
+        struct GpuEmitter {
+            glm::vec3 position;
+            uint32_t spawn_count;
+
+            glm::vec3 initial_velocity;
+            uint32_t first_particle;
+
+            glm::vec3 velocity_randomness;
+            uint32_t max_particles;
+
+            glm::vec3 spawn_extent;
+            float drag;
+
+            glm::vec3 acceleration;
+            float min_lifetime;
+
+            glm::vec4 start_color;
+
+            glm::vec4 end_color;
+
+            float max_lifetime;
+            float start_size;
+            float end_size;
+            uint32_t seed;
+        };
+
+        /*!
+         * \brief Matches `SimulationParams` in the simulation shader
+         */
+        struct SimulationParams {
+            float delta_time;
+            uint32_t num_emitters;
+
+            /*!
+             * \brief Where the counts of the particle buffer being read and the one being written start in the count buffer
+             */
+            uint32_t source_counts_offset;
+            uint32_t destination_counts_offset;
+
+            /*!
+             * \brief Where the quad is in the mesh buffers, for the draw arguments
+             */
+            uint32_t quad_first_index;
+            int32_t quad_vertex_offset;
+            uint32_t quad_num_indices;
+
+            uint32_t padding;
+        };
+
+        struct Emitter {
+            renderpack::ParticleEmitterCreateInfo create_info;
+
+            /*!
+             * \brief Index of the emitter's first slot in the particle buffers
+             */
+            uint32_t first_particle = 0;
+
+            /*!
+             * \brief The part of a particle that hasn't been spawned yet, so that slow emitters still spawn at the right rate
+             */
+            float spawn_remainder = 0;
+        };
+
+        struct FrameResources {
+            rhi::RhiBuffer* params = nullptr;
+
+            rhi::RhiBuffer* emitters = nullptr;
+
+            /*!
+             * \brief Binders of the simulation shader. Element 0 reads particle buffer 0 and writes particle buffer 1, element 1 the other
+             * way around
+             */
+            std::array<std::unique_ptr<RhiResourceBinder>, 2> simulation_binders;
+
+            std::unique_ptr<RhiResourceBinder> draw_args_binder;
+        };
+
+        rhi::RenderDevice& device;
+
+        std::unique_ptr<rhi::RhiPipeline> simulation_pipeline;
+
+        std::unique_ptr<rhi::RhiPipeline> draw_args_pipeline;
+
+        std::vector<FrameResources> frames;
+
+        std::vector<Emitter> emitters;
+
+        /*!
+         * \brief The most particles that any one emitter may have, which is how wide the simulation dispatch is
+         */
+        uint32_t max_emitter_particles = 0;
+
+        std::unordered_map<std::string, ParticleEmitterState> states_by_name;
+
+        /*!
+         * \brief Two buffers with a slot for every particle of every emitter, which take turns being simulated from and to
+         */
+        std::array<rhi::RhiBuffer*, 2> particle_buffers{};
+
+        /*!
+         * \brief How many live particles each emitter has in each particle buffer. The counts of particle buffer 1 come after those of
+         * particle buffer 0
+         */
+        rhi::RhiBuffer* count_buffer = nullptr;
+
+        /*!
+         * \brief Zeros for as many counts as there are emitters, which reset the counts of the buffer being written
+         */
+        rhi::RhiBuffer* zero_buffer = nullptr;
+
+        /*!
+         * \brief One `RhiDrawIndexedIndirectCommand` per emitter. There's only one, so draws that were recorded in an earlier frame still
+         * read the right arguments
+         */
+        rhi::RhiBuffer* draw_args_buffer = nullptr;
+
+        Mesh quad;
+
+        /*!
+         * \brief Which particle buffer the current frame writes
+         */
+        uint32_t destination_buffer = 1;
+
+        uint32_t next_seed = 0;
+
+        std::chrono::steady_clock::time_point last_frame_time;
+
+        /*!
+         * \brief Whether the current frame has to zero the counts of both particle buffers first, because the emitters were just made
+         */
+        bool should_reset_counts = true;
+
+        void create_buffers(uint32_t num_particles, uint32_t num_emitters);
+
+        void destroy_buffers();
+
+        void bind_frame_resources(FrameResources& frame) const;
+    };
+} // namespace nova::renderer
@@ -1,12 +1,231 @@
 #include "pipeline_reflection.hpp"
 
-#include <rx/core/log.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <fstream>
+#include <optional>
+#include <utility>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
 #include <spirv_cross.hpp>
 
+#include "nova_renderer/util/logging.hpp"
+
+#include "loading/renderpack/cooked_renderpack.hpp"
+#include "loading/renderpack/spirv_cache.hpp"
+
 namespace nova::renderer {
     using namespace rhi;
 
-    RX_LOG("PipelineReflection", logger);
+    static auto logger = make_logger("PipelineReflection");
+
+    /*!
+     * \brief Version of the reflection data. Bump this whenever `reflect_shader` starts finding different things in the same SPIR-V
+     */
+    constexpr uint32_t REFLECTION_VERSION = 2;
+
+    template <typename ResourceList>
+    static void add_resources(ShaderReflection& reflection,
+                              const spirv_cross::Compiler& shader_compiler,
+                              const ResourceList& resources,
+                              const DescriptorType type) {
+        for(const auto& resource : resources) {
+            RhiResourceBindingDescription description = {};
+            description.set = shader_compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+            description.binding = shader_compiler.get_decoration(resource.id, spv::DecorationBinding);
+            description.type = type;
+            description.count = 1;
+
+            const spirv_cross::SPIRType& type_information = shader_compiler.get_type(resource.type_id);
+            if(!type_information.array.empty()) {
+                description.count = type_information.array[0];
+                // All arrays are unbounded until I figure out how to use SPIRV-Cross to detect unbounded arrays
+                description.is_unbounded = true;
+            }
+
+            logger->debug("Pipeline reflection found resource {} of type {} in binding {}.{}",
+                          resource.name,
+                          descriptor_type_to_string(type),
+                          description.set,
+                          description.binding);
+
+            reflection.bindings.push_back({resource.name, description});
+        }
+    }
+
+    static bool has_depth_affecting_instructions(const std::vector<uint32_t>& spirv) {
+        // SPIRV-Cross doesn't say if a shader discards, so look for the instructions ourselves. The first five words are the header, and
+        // every instruction starts with its word count in the high half-word and its opcode in the low one
+        for(size_t i = 5; i < spirv.size();) {
+            const auto opcode = static_cast<spv::Op>(spirv[i] & spv::OpCodeMask);
+            if(opcode == spv::OpKill || opcode == spv::OpDemoteToHelperInvocationEXT) {
+                return true;
+            }
+
+            const auto word_count = spirv[i] >> spv::WordCountShift;
+            if(word_count == 0) {
+                break;
+            }
+            i += word_count;
+        }
+
+        return false;
+    }
+
+    static ShaderReflection reflect_shader(const std::vector<uint32_t>& spirv) {
+        ZoneScoped;
+        const spirv_cross::Compiler shader_compiler{spirv.data(), spirv.size()};
+        const spirv_cross::ShaderResources& resources = shader_compiler.get_shader_resources();
+
+        ShaderReflection reflection;
+        add_resources(reflection, shader_compiler, resources.separate_images, DescriptorType::Texture);
+        add_resources(reflection, shader_compiler, resources.separate_samplers, DescriptorType::Sampler);
+        add_resources(reflection, shader_compiler, resources.uniform_buffers, DescriptorType::UniformBuffer);
+        add_resources(reflection, shader_compiler, resources.storage_buffers, DescriptorType::StorageBuffer);
+        add_resources(reflection, shader_compiler, resources.storage_images, DescriptorType::StorageImage);
+        add_resources(reflection, shader_compiler, resources.subpass_inputs, DescriptorType::InputAttachment);
+
+        std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.name < rhs.name;
+        });
+
+        for(const spirv_cross::SpecializationConstant& constant : shader_compiler.get_specialization_constants()) {
+            const auto& type = shader_compiler.get_type(shader_compiler.get_constant(constant.id).constant_type);
+            const auto& name = shader_compiler.get_name(constant.id);
+
+            std::optional<ShaderReflection::ScalarType> scalar_type;
+            if(type.vecsize == 1 && type.columns == 1) {
+                switch(type.basetype) {
+                    case spirv_cross::SPIRType::Boolean:
+                        scalar_type = ShaderReflection::ScalarType::Bool;
+                        break;
+                    case spirv_cross::SPIRType::Int:
+                        scalar_type = ShaderReflection::ScalarType::Int;
+                        break;
+                    case spirv_cross::SPIRType::UInt:
+                        scalar_type = ShaderReflection::ScalarType::Uint;
+                        break;
+                    case spirv_cross::SPIRType::Float:
+                        scalar_type = ShaderReflection::ScalarType::Float;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            if(!scalar_type || name.empty()) {
+                logger->debug("Specialization constant {} ({}) isn't a named 32-bit scalar, so it can't be set by name",
+                              name,
+                              constant.constant_id);
+                continue;
+            }
+
+            reflection.specialization_constants.push_back({name, constant.constant_id, *scalar_type});
+        }
+
+        std::sort(reflection.specialization_constants.begin(),
+                  reflection.specialization_constants.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs.name < rhs.name; });
+
+        reflection.workgroup_size = {shader_compiler.get_execution_mode_argument(spv::ExecutionModeLocalSize, 0),
+                                     shader_compiler.get_execution_mode_argument(spv::ExecutionModeLocalSize, 1),
+                                     shader_compiler.get_execution_mode_argument(spv::ExecutionModeLocalSize, 2)};
+
+        reflection.affects_depth = shader_compiler.get_execution_mode_bitset().get(spv::ExecutionModeDepthReplacing) ||
+                                   has_depth_affecting_instructions(spirv);
+
+        return reflection;
+    }
+
+    ShaderReflectionCache& ShaderReflectionCache::get_instance() {
+        static ShaderReflectionCache instance;
+
+        return instance;
+    }
+
+    void ShaderReflectionCache::configure(std::filesystem::path directory) {
+        std::lock_guard lock{cache_mutex};
+
+        cache_directory = std::move(directory);
+    }
+
+    ShaderReflectionCache::Key ShaderReflectionCache::make_key(const std::vector<uint32_t>& spirv) {
+        renderpack::Fnv1aHasher hasher;
+        hasher.add_value(REFLECTION_VERSION);
+        hasher.add({reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t)});
+
+        return hasher.get();
+    }
+
+    std::shared_ptr<const ShaderReflection> ShaderReflectionCache::get(const std::vector<uint32_t>& spirv) {
+        const auto key = make_key(spirv);
+
+        std::filesystem::path path;
+        {
+            std::lock_guard lock{cache_mutex};
+            if(const auto itr = reflections.find(key); itr != reflections.end()) {
+                return itr->second;
+            }
+
+            path = get_path_for_key(key);
+        }
+
+        ZoneScoped;
+        std::optional<ShaderReflection> reflection;
+        if(std::ifstream file{path, std::ios::binary | std::ios::ate}; file) {
+            std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            if(file) {
+                reflection = renderpack::uncook_shader_reflection(bytes);
+            }
+
+            // Reflections from an older version of Nova don't load either, and just get reflected again
+            if(!reflection) {
+                logger->debug("Cached shader reflection {} is corrupt or out of date, ignoring it", path.string());
+            }
+        }
+
+        if(!reflection) {
+            reflection = reflect_shader(spirv);
+
+            const auto bytes = renderpack::cook_shader_reflection(*reflection);
+
+            std::error_code err;
+            std::filesystem::create_directories(path.parent_path(), err);
+
+            // Write to a temporary file first, so another process reflecting the same shader never sees half of it
+            auto temp_path = path;
+            temp_path += ".tmp";
+            if(std::ofstream file{temp_path, std::ios::binary | std::ios::trunc}; file) {
+                file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+                file.close();
+
+                std::filesystem::rename(temp_path, path, err);
+                if(err) {
+                    logger->warn("Could not cache shader reflection to {}: {}", path.string(), err.message());
+                }
+
+            } else {
+                logger->warn("Could not open {} to cache a shader reflection", temp_path.string());
+            }
+        }
+
+        // Two threads may have reflected the same shader at once. They found the same thing, so whichever got here first wins
+        std::lock_guard lock{cache_mutex};
+        return reflections.try_emplace(key, std::make_shared<const ShaderReflection>(std::move(*reflection))).first->second;
+    }
+
+    void ShaderReflectionCache::add(const Key key, ShaderReflection reflection) {
+        std::lock_guard lock{cache_mutex};
+        reflections.try_emplace(key, std::make_shared<const ShaderReflection>(std::move(reflection)));
+    }
+
+    std::filesystem::path ShaderReflectionCache::get_path_for_key(const Key key) const {
+        return cache_directory / fmt::format("{:016x}.reflection", key);
+    }
 
     std::unordered_map<std::string, RhiResourceBindingDescription> get_all_descriptors(const RhiGraphicsPipelineState& pipeline_state) {
         std::unordered_map<std::string, RhiResourceBindingDescription> bindings;
@@ -23,75 +242,109 @@ namespace nova::renderer {
         return bindings;
     }
 
+    std::unordered_map<std::string, RhiResourceBindingDescription> get_all_descriptors(const RhiComputePipelineState& pipeline_state) {
+        std::unordered_map<std::string, RhiResourceBindingDescription> bindings;
+
+        get_shader_module_descriptors(pipeline_state.compute_shader.source, ShaderStage::Compute, bindings);
+
+        return bindings;
+    }
+
+    PipelineStage get_texture_read_stages(const RhiGraphicsPipelineState& pipeline_state) {
+        constexpr std::array stage_mapping{std::pair{ShaderStage::Vertex, PipelineStage::VertexShader},
+                                           std::pair{ShaderStage::TessellationControl, PipelineStage::TessellationControlShader},
+                                           std::pair{ShaderStage::TessellationEvaluation, PipelineStage::TessellationEvaluationShader},
+                                           std::pair{ShaderStage::Geometry, PipelineStage::GeometryShader},
+                                           std::pair{ShaderStage::Pixel, PipelineStage::FragmentShader}};
+
+        PipelineStage read_stages{};
+
+        for(const auto& [name, binding] : get_all_descriptors(pipeline_state)) {
+            if(binding.type != DescriptorType::Texture && binding.type != DescriptorType::CombinedImageSampler) {
+                continue;
+            }
+
+            for(const auto& [shader_stage, pipeline_stage] : stage_mapping) {
+                if((static_cast<uint32_t>(binding.stages) & static_cast<uint32_t>(shader_stage)) != 0) {
+                    read_stages = read_stages | pipeline_stage;
+                }
+            }
+        }
+
+        return read_stages;
+    }
+
     void get_shader_module_descriptors(const std::vector<uint32_t>& spirv,
                                        const ShaderStage shader_stage,
                                        std::unordered_map<std::string, RhiResourceBindingDescription>& bindings) {
-        const spirv_cross::Compiler shader_compiler{spirv.data(), spirv.size()};
-        const spirv_cross::ShaderResources& resources = shader_compiler.get_shader_resources();
-
-        for(const auto& resource : resources.separate_images) {
-            add_resource_to_bindings(bindings, shader_stage, shader_compiler, resource, DescriptorType::Texture);
-        }
+        const auto reflection = ShaderReflectionCache::get_instance().get(spirv);
 
-        for(const auto& resource : resources.separate_samplers) {
-            add_resource_to_bindings(bindings, shader_stage, shader_compiler, resource, DescriptorType::Sampler);
-        }
+        for(const auto& [name, description] : reflection->bindings) {
+            auto new_binding = description;
+            new_binding.stages = shader_stage;
 
-        for(const auto& resource : resources.uniform_buffers) {
-            add_resource_to_bindings(bindings, shader_stage, shader_compiler, resource, DescriptorType::UniformBuffer);
-        }
+            if(const auto [itr, is_new] = bindings.try_emplace(name, new_binding); !is_new) {
+                // Existing binding. Is it the same as our binding?
+                RhiResourceBindingDescription& existing_binding = itr->second;
+                if(existing_binding != new_binding) {
+                    // They have two different bindings with the same name. Not allowed
+                    logger->error("You have two different uniforms named {} in different shader stages. This is not allowed. Use unique "
+                                  "names",
+                                  name);
 
-        for(const auto& resource : resources.storage_buffers) {
-            add_resource_to_bindings(bindings, shader_stage, shader_compiler, resource, DescriptorType::StorageBuffer);
+                } else {
+                    // Same binding, probably at different stages - let's fix that
+                    existing_binding.stages |= shader_stage;
+                }
+            }
         }
     }
 
-    void add_resource_to_bindings(std::unordered_map<std::string, RhiResourceBindingDescription>& bindings,
-                                  const ShaderStage shader_stage,
-                                  const spirv_cross::Compiler& shader_compiler,
-                                  const spirv_cross::Resource& resource,
-                                  const DescriptorType type) {
-        const uint32_t set_idx = shader_compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
-        const uint32_t binding_idx = shader_compiler.get_decoration(resource.id, spv::DecorationBinding);
-
-        RhiResourceBindingDescription new_binding = {};
-        new_binding.set = set_idx;
-        new_binding.binding = binding_idx;
-        new_binding.type = type;
-        new_binding.count = 1;
-        new_binding.stages = shader_stage;
-
-        logger->debug("Pipeline reflection found resource %s of type %s in binding %u.%u",
-                        resource.name.c_str(),
-                        descriptor_type_to_string(type),
-                        set_idx,
-                        binding_idx);
-
-        const spirv_cross::SPIRType& type_information = shader_compiler.get_type(resource.type_id);
-        if(!type_information.array.empty()) {
-            new_binding.count = type_information.array[0];
-            // All arrays are unbounded until I figure out how to use SPIRV-Cross to detect unbounded arrays
-            new_binding.is_unbounded = true;
+    static uint32_t to_specialization_constant_bits(const double value, const ShaderReflection::ScalarType type) {
+        switch(type) {
+            case ShaderReflection::ScalarType::Bool:
+                return value != 0 ? 1 : 0;
+            case ShaderReflection::ScalarType::Int:
+                return std::bit_cast<uint32_t>(static_cast<int32_t>(value));
+            case ShaderReflection::ScalarType::Uint:
+                return static_cast<uint32_t>(value);
+            case ShaderReflection::ScalarType::Float:
+                return std::bit_cast<uint32_t>(static_cast<float>(value));
         }
 
-        const std::string& resource_name = resource.name.c_str();
+        return 0;
+    }
 
-        if(auto* binding = bindings.find(resource_name)) {
-            // Existing binding. Is it the same as our binding?
-            RhiResourceBindingDescription& existing_binding = *binding;
-            if(existing_binding != new_binding) {
-                // They have two different bindings with the same name. Not allowed
-                logger->error("You have two different uniforms named %s in different shader stages. This is not allowed. Use unique names",
-                              resource.name);
+    void specialize_shader(ShaderSource& shader, const std::unordered_map<std::string, double>& values) {
+        shader.specialization_constants.clear();
+        if(values.empty() || shader.source.empty()) {
+            return;
+        }
 
-            } else {
-                // Same binding, probably at different stages - let's fix that
-                existing_binding.stages |= shader_stage;
+        const auto reflection = ShaderReflectionCache::get_instance().get(shader.source);
+        for(const auto& [name, constant_id, type] : reflection->specialization_constants) {
+            if(const auto itr = values.find(name); itr != values.end()) {
+                shader.specialization_constants.push_back({constant_id, to_specialization_constant_bits(itr->second, type)});
             }
+        }
+    }
+
+    void specialize_shaders(RhiGraphicsPipelineState& pipeline_state, const std::unordered_map<std::string, double>& values) {
+        specialize_shader(pipeline_state.vertex_shader, values);
 
-        } else {
-            // Totally new binding!
-            bindings.insert(resource_name, new_binding);
+        if(pipeline_state.geometry_shader) {
+            specialize_shader(*pipeline_state.geometry_shader, values);
         }
+        if(pipeline_state.pixel_shader) {
+            specialize_shader(*pipeline_state.pixel_shader, values);
+        }
+    }
+
+    glm::uvec3 get_workgroup_size(const std::vector<uint32_t>& spirv) {
+        return ShaderReflectionCache::get_instance().get(spirv)->workgroup_size;
+    }
+
+    bool pixel_shader_affects_depth(const std::vector<uint32_t>& spirv) {
+        return ShaderReflectionCache::get_instance().get(spirv)->affects_depth;
     }
 } // namespace nova::renderer
@@ -1,26 +1,140 @@
 #pragma once
+#include <filesystem>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <string>
+#include <vector>
+
+#include <glm/vec3.hpp>
 
 #include "nova_renderer/rhi/pipeline_create_info.hpp"
 #include "nova_renderer/rhi/rhi_enums.hpp"
 #include "nova_renderer/rhi/rhi_types.hpp"
 
-namespace spirv_cross {
-    struct Resource;
-    class Compiler;
-} // namespace spirv_cross
-
 namespace nova::renderer {
+    /*!
+     * \brief Everything that Nova wants to know about one SPIR-V blob
+     */
+    struct ShaderReflection {
+        struct Binding {
+            std::string name;
+
+            /*!
+             * \brief Where the resource is bound. `stages` is left empty, since the stage comes from whoever uses the shader
+             */
+            rhi::RhiResourceBindingDescription description;
+        };
+
+        enum class ScalarType : uint32_t {
+            Bool,
+            Int,
+            Uint,
+            Float,
+        };
+
+        struct SpecializationConstant {
+            std::string name;
+            uint32_t constant_id = 0;
+            ScalarType type = ScalarType::Bool;
+        };
+
+        /*!
+         * \brief The shader's resources, sorted by name
+         */
+        std::vector<Binding> bindings;
+
+        /*!
+         * \brief The shader's 32-bit scalar specialization constants, sorted by name. Constants of other types can't be set by name
+         */
+        std::vector<SpecializationConstant> specialization_constants;
+
+        glm::uvec3 workgroup_size{0};
+
+        /*!
+         * \brief Whether the shader discards or writes its own depth. Only pixel shaders do either
+         */
+        bool affects_depth = false;
+    };
+
+    /*!
+     * \brief Reflects each SPIR-V blob once, keyed by a hash of its words
+     *
+     * SPIRV-Cross takes a while to parse a shader, and pipelines and resource binders want to know the same shaders' bindings over and
+     * over. Reflections are kept in memory for as long as Nova runs, since they're tiny, and saved next to the SPIR-V cache so the next
+     * run doesn't parse them either. Cooked renderpacks bring their shaders' reflections along too
+     *
+     * All methods are thread-safe
+     */
+    class ShaderReflectionCache {
+    public:
+        using Key = uint64_t;
+
+        static ShaderReflectionCache& get_instance();
+
+        /*!
+         * \brief Sets where reflections are saved on disk
+         */
+        void configure(std::filesystem::path directory);
+
+        [[nodiscard]] static Key make_key(const std::vector<uint32_t>& spirv);
+
+        /*!
+         * \brief Gets the shader's reflection from memory, then from disk, and runs SPIRV-Cross on it if neither has it
+         */
+        [[nodiscard]] std::shared_ptr<const ShaderReflection> get(const std::vector<uint32_t>& spirv);
+
+        /*!
+         * \brief Adds a reflection that someone else already made, like a cooked renderpack
+         */
+        void add(Key key, ShaderReflection reflection);
+
+    private:
+        std::mutex cache_mutex;
+
+        std::filesystem::path cache_directory = "cache/shaders";
+
+        std::unordered_map<Key, std::shared_ptr<const ShaderReflection>> reflections;
+
+        [[nodiscard]] std::filesystem::path get_path_for_key(Key key) const;
+    };
+
     std::unordered_map<std::string, rhi::RhiResourceBindingDescription> get_all_descriptors(const RhiGraphicsPipelineState& pipeline_state);
 
+    std::unordered_map<std::string, rhi::RhiResourceBindingDescription> get_all_descriptors(const RhiComputePipelineState& pipeline_state);
+
+    /*!
+     * \brief Finds every pipeline stage where the pipeline's shaders read from a texture
+     *
+     * The rendergraph uses this to wait on exactly the stages that read a render target, instead of all of them
+     */
+    rhi::PipelineStage get_texture_read_stages(const RhiGraphicsPipelineState& pipeline_state);
+
+    /*!
+     * \brief Reads the number of threads in each of a compute shader's thread groups
+     */
+    glm::uvec3 get_workgroup_size(const std::vector<uint32_t>& spirv);
+
+    /*!
+     * \brief Checks if a pixel shader discards pixels or writes its own depth, so depth-only pipelines still need it
+     */
+    bool pixel_shader_affects_depth(const std::vector<uint32_t>& spirv);
+
+    /*!
+     * \brief Sets the shader's specialization constants to the values with the same names. Values for constants that the shader doesn't
+     * have are ignored, since one set of values goes to every stage
+     */
+    void specialize_shader(ShaderSource& shader, const std::unordered_map<std::string, double>& values);
+
+    /*!
+     * \brief Specializes all of the pipeline's shaders
+     */
+    void specialize_shaders(RhiGraphicsPipelineState& pipeline_state, const std::unordered_map<std::string, double>& values);
+
+    /*!
+     * \brief Adds the shader's resources to the bindings, or adds the stage to bindings that other stages already use
+     */
     void get_shader_module_descriptors(const std::vector<uint32_t>& spirv,
                                        rhi::ShaderStage shader_stage,
                                        std::unordered_map<std::string, rhi::RhiResourceBindingDescription>& bindings);
-
-    void add_resource_to_bindings(std::unordered_map<std::string, rhi::RhiResourceBindingDescription>& bindings,
-                                  rhi::ShaderStage shader_stage,
-                                  const spirv_cross::Compiler& shader_compiler,
-                                  const spirv_cross::Resource& resource,
-                                  rhi::DescriptorType type);
 } // namespace nova::renderer
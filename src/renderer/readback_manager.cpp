@@ -0,0 +1,294 @@
+#include "readback_manager.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/resource_loader.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("Readback");
+
+    /*!
+     * \brief Where each readback starts in the readback buffer is a multiple of this, which is a multiple of every pixel size
+     */
+    constexpr size_t READBACK_ALIGNMENT = 16;
+
+    constexpr size_t MIN_READBACK_BUFFER_SIZE = 64 * 1024;
+
+    static size_t align_readback_offset(const size_t offset) {
+        return (offset + READBACK_ALIGNMENT - 1) / READBACK_ALIGNMENT * READBACK_ALIGNMENT;
+    }
+
+    static rhi::ResourceAccess get_attachment_access(const rhi::ResourceState state) {
+        return state == rhi::ResourceState::DepthWrite ? rhi::ResourceAccess::DepthStencilAttachmentWrite :
+                                                         rhi::ResourceAccess::ColorAttachmentWrite;
+    }
+
+    static rhi::RhiResourceBarrier make_image_barrier(rhi::RhiImage* image,
+                                                      const rhi::ResourceState old_state,
+                                                      const rhi::ResourceAccess old_access,
+                                                      const rhi::ResourceState new_state,
+                                                      const rhi::ResourceAccess new_access) {
+        rhi::RhiResourceBarrier barrier{};
+        barrier.resource_to_barrier = image;
+        barrier.old_state = old_state;
+        barrier.new_state = new_state;
+        barrier.access_before_barrier = old_access;
+        barrier.access_after_barrier = new_access;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.image_memory_barrier.aspect = image->is_depth_tex ? rhi::ImageAspect::Depth : rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    static rhi::RhiResourceBarrier make_buffer_barrier(rhi::RhiBuffer* buffer,
+                                                       const mem::Bytes offset,
+                                                       const mem::Bytes num_bytes,
+                                                       const rhi::ResourceAccess old_access,
+                                                       const rhi::ResourceAccess new_access) {
+        rhi::RhiResourceBarrier barrier{};
+        barrier.resource_to_barrier = buffer;
+        barrier.old_state = rhi::ResourceState::Common;
+        barrier.new_state = rhi::ResourceState::Common;
+        barrier.access_before_barrier = old_access;
+        barrier.access_after_barrier = new_access;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = offset;
+        barrier.buffer_memory_barrier.size = num_bytes;
+
+        return barrier;
+    }
+
+    ReadbackManager::ReadbackManager(rhi::RenderDevice& device) : device{device} {}
+
+    ReadbackManager::~ReadbackManager() {
+        // Readbacks that the GPU never finished get broken promises when their batches are thrown away
+        for(auto* buffer : all_buffers) {
+            device.destroy_buffer(buffer);
+        }
+    }
+
+    std::future<std::optional<ReadbackData>> ReadbackManager::request_buffer_readback(rhi::RhiBuffer* buffer,
+                                                                                     const mem::Bytes offset,
+                                                                                     const mem::Bytes num_bytes) {
+        Request request{BufferSource{buffer, offset, num_bytes}};
+        auto future = request.promise.get_future();
+
+        std::lock_guard lock{requests_mutex};
+        pending_requests.push_back(std::move(request));
+
+        return future;
+    }
+
+    std::future<std::optional<ReadbackData>> ReadbackManager::request_render_target_readback(const std::string& render_target_name,
+                                                                                            const ImageReadbackRegion& region) {
+        Request request{RenderTargetSource{render_target_name, region}};
+        auto future = request.promise.get_future();
+
+        std::lock_guard lock{requests_mutex};
+        pending_requests.push_back(std::move(request));
+
+        return future;
+    }
+
+    std::function<void()> ReadbackManager::record_readbacks(rhi::RhiRenderCommandList& cmds, const RenderTargetLookup& find_render_target) {
+        ZoneScoped;
+        std::vector<Request> requests;
+        {
+            std::lock_guard lock{requests_mutex};
+            requests.swap(pending_requests);
+        }
+
+        if(requests.empty()) {
+            return {};
+        }
+
+        auto batch = std::make_shared<Batch>();
+        batch->requests.reserve(requests.size());
+
+        // Work out where everything goes in the readback buffer first, so the whole frame only needs one
+        size_t num_bytes = 0;
+        for(Request& request : requests) {
+            if(const auto* buffer_source = std::get_if<BufferSource>(&request.source)) {
+                if(buffer_source->buffer == nullptr || buffer_source->num_bytes == 0 ||
+                   buffer_source->offset + buffer_source->num_bytes > buffer_source->buffer->size) {
+                    logger->error("Can't read back {} bytes at offset {} of a buffer, they aren't all in it",
+                                  buffer_source->num_bytes.b_count(),
+                                  buffer_source->offset.b_count());
+                    request.promise.set_value(std::nullopt);
+                    continue;
+                }
+
+                request.num_bytes = buffer_source->num_bytes;
+
+            } else {
+                auto& image_source = std::get<RenderTargetSource>(request.source);
+                const auto render_target = find_render_target(image_source.name);
+                if(!render_target) {
+                    logger->error("Can't read back render target {}. Either it doesn't exist, or it shares its memory with other render "
+                                  "targets or is transient, so it's gone by the end of the frame",
+                                  image_source.name);
+                    request.promise.set_value(std::nullopt);
+                    continue;
+                }
+
+                auto& region = image_source.region;
+                const auto mip_width = std::max(render_target->width >> region.mip, 1U);
+                const auto mip_height = std::max(render_target->height >> region.mip, 1U);
+                if(region.mip >= render_target->num_mips || region.x >= mip_width || region.y >= mip_height) {
+                    logger->error("Can't read back pixel {},{} of mip {} of render target {}, it isn't in the render target",
+                                  region.x,
+                                  region.y,
+                                  region.mip,
+                                  image_source.name);
+                    request.promise.set_value(std::nullopt);
+                    continue;
+                }
+
+                const auto width = region.width == 0 ? mip_width - region.x : region.width;
+                const auto height = region.height == 0 ? mip_height - region.y : region.height;
+                if(region.x + width > mip_width || region.y + height > mip_height) {
+                    logger->error("Can't read back a {}x{} rectangle at {},{} of render target {}, it hangs off the edge",
+                                  width,
+                                  height,
+                                  region.x,
+                                  region.y,
+                                  image_source.name);
+                    request.promise.set_value(std::nullopt);
+                    continue;
+                }
+
+                region.width = width;
+                region.height = height;
+
+                request.render_target = *render_target;
+                request.data.width = width;
+                request.data.height = height;
+                request.data.format = render_target->format;
+                request.num_bytes = get_image_size_in_bytes(render_target->format, width, height);
+            }
+
+            request.readback_offset = num_bytes;
+            num_bytes = align_readback_offset(num_bytes + request.num_bytes.b_count());
+            batch->requests.push_back(std::move(request));
+        }
+
+        if(batch->requests.empty()) {
+            return {};
+        }
+
+        batch->buffer = get_free_buffer(num_bytes);
+
+        // Render targets are in their resting states, and buffers could have been written by anything
+        std::vector<rhi::RhiResourceBarrier> barriers_before;
+        std::vector<rhi::RhiResourceBarrier> barriers_after;
+        std::vector<rhi::RhiImage*> barriered_images;
+        for(const Request& request : batch->requests) {
+            if(const auto* buffer_source = std::get_if<BufferSource>(&request.source)) {
+                barriers_before.push_back(make_buffer_barrier(buffer_source->buffer,
+                                                              buffer_source->offset,
+                                                              buffer_source->num_bytes,
+                                                              rhi::ResourceAccess::MemoryWrite,
+                                                              rhi::ResourceAccess::CopyRead));
+
+            } else if(std::find(barriered_images.begin(), barriered_images.end(), request.render_target.image) == barriered_images.end()) {
+                const auto& render_target = request.render_target;
+                barriered_images.push_back(render_target.image);
+
+                const auto access = get_attachment_access(render_target.state);
+                barriers_before.push_back(make_image_barrier(render_target.image,
+                                                             render_target.state,
+                                                             access,
+                                                             rhi::ResourceState::CopySource,
+                                                             rhi::ResourceAccess::CopyRead));
+                barriers_after.push_back(make_image_barrier(render_target.image,
+                                                            rhi::ResourceState::CopySource,
+                                                            rhi::ResourceAccess::CopyRead,
+                                                            render_target.state,
+                                                            access));
+            }
+        }
+
+        cmds.resource_barriers(rhi::PipelineStage::AllCommands, rhi::PipelineStage::Transfer, barriers_before);
+
+        for(const Request& request : batch->requests) {
+            if(const auto* buffer_source = std::get_if<BufferSource>(&request.source)) {
+                cmds.copy_buffer(batch->buffer, request.readback_offset, buffer_source->buffer, buffer_source->offset, request.num_bytes);
+
+            } else {
+                const auto& region = std::get<RenderTargetSource>(request.source).region;
+                cmds.copy_image_to_buffer(batch->buffer,
+                                          request.readback_offset,
+                                          request.render_target.image,
+                                          region.mip,
+                                          region.x,
+                                          region.y,
+                                          region.width,
+                                          region.height);
+            }
+        }
+
+        barriers_after.push_back(
+            make_buffer_barrier(batch->buffer, 0, num_bytes, rhi::ResourceAccess::CopyWrite, rhi::ResourceAccess::HostRead));
+        cmds.resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::AllCommands | rhi::PipelineStage::Host, barriers_after);
+
+        return [this, batch] { finish_batch(*batch); };
+    }
+
+    rhi::RhiBuffer* ReadbackManager::get_free_buffer(const mem::Bytes min_size) {
+        // The smallest buffer that's big enough, so that big readbacks don't tie up the big buffers
+        auto best_itr = free_buffers.end();
+        for(auto itr = free_buffers.begin(); itr != free_buffers.end(); ++itr) {
+            if((*itr)->size >= min_size && (best_itr == free_buffers.end() || (*itr)->size < (*best_itr)->size)) {
+                best_itr = itr;
+            }
+        }
+
+        if(best_itr != free_buffers.end()) {
+            auto* buffer = *best_itr;
+            free_buffers.erase(best_itr);
+            return buffer;
+        }
+
+        // None of the free buffers are big enough. Replace one of them, so the pool doesn't keep growing
+        if(!free_buffers.empty()) {
+            auto* too_small_buffer = free_buffers.back();
+            free_buffers.pop_back();
+            all_buffers.erase(std::find(all_buffers.begin(), all_buffers.end(), too_small_buffer));
+            device.destroy_buffer(too_small_buffer);
+        }
+
+        rhi::RhiBufferCreateInfo create_info{};
+        create_info.name = fmt::format("NovaReadback{}", next_buffer_idx++);
+        create_info.size = std::bit_ceil(std::max(min_size.b_count(), MIN_READBACK_BUFFER_SIZE));
+        create_info.buffer_usage = rhi::BufferUsage::ReadbackBuffer;
+        auto* buffer = device.create_buffer(create_info);
+
+        all_buffers.push_back(buffer);
+
+        return buffer;
+    }
+
+    void ReadbackManager::finish_batch(Batch& batch) {
+        ZoneScoped;
+        device.invalidate_buffer(batch.buffer, 0, batch.buffer->size);
+
+        const auto* mapped_data = static_cast<const uint8_t*>(device.get_mapped_data(batch.buffer));
+        for(Request& request : batch.requests) {
+            const auto* data = mapped_data + request.readback_offset.b_count();
+            request.data.bytes.assign(data, data + request.num_bytes.b_count());
+            request.promise.set_value(std::move(request.data));
+        }
+
+        free_buffers.push_back(batch.buffer);
+    }
+} // namespace nova::renderer
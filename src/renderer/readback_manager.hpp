@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "nova_renderer/readback.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_enums.hpp"
+#include "nova_renderer/util/bytes.hpp"
+
+namespace nova::renderer {
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief A render target that can be read back, and what state it's in at the end of the frame
+     */
+    struct ReadableRenderTarget {
+        rhi::RhiImage* image = nullptr;
+
+        rhi::ResourceState state = rhi::ResourceState::RenderTarget;
+
+        rhi::PixelFormat format = rhi::PixelFormat::Rgba8;
+
+        uint32_t width = 0;
+
+        uint32_t height = 0;
+
+        uint32_t num_mips = 1;
+    };
+
+    /*!
+     * \brief Finds the render target with the provided name, or nothing if it doesn't exist or its contents don't last until the end of
+     * the frame
+     */
+    using RenderTargetLookup = std::function<std::optional<ReadableRenderTarget>(const std::string& name)>;
+
+    /*!
+     * \brief Copies buffers and render targets to the CPU without waiting for the GPU
+     *
+     * Any thread may ask for a readback. The frame thread then records copies of everything that was asked for into one readback
+     * buffer at the end of the frame, and the readbacks' futures get their data during the first `RenderDevice::end_frame` after the
+     * GPU finishes that frame. The readback buffers go back into a pool once their data has been copied out, so in the steady state
+     * there's one buffer per frame in flight
+     */
+    class ReadbackManager {
+    public:
+        explicit ReadbackManager(rhi::RenderDevice& device);
+
+        ReadbackManager(const ReadbackManager& other) = delete;
+        ReadbackManager& operator=(const ReadbackManager& other) = delete;
+
+        ReadbackManager(ReadbackManager&& old) noexcept = delete;
+        ReadbackManager& operator=(ReadbackManager&& old) noexcept = delete;
+
+        ~ReadbackManager();
+
+        /*!
+         * \brief Asks for some bytes of a buffer. The buffer must live until the end of the next frame
+         */
+        [[nodiscard]] std::future<std::optional<ReadbackData>> request_buffer_readback(rhi::RhiBuffer* buffer,
+                                                                                     mem::Bytes offset,
+                                                                                     mem::Bytes num_bytes);
+
+        /*!
+         * \brief Asks for a rectangle of a render target, as it is at the end of the next frame
+         */
+        [[nodiscard]] std::future<std::optional<ReadbackData>> request_render_target_readback(const std::string& render_target_name,
+                                                                                            const ImageReadbackRegion& region);
+
+        /*!
+         * \brief Records copies of everything that was asked for since the last call into a readback buffer
+         *
+         * Call it at the end of the frame's last graphics command list, after every render target is back in its resting state
+         *
+         * \return The work that hands the data to the readbacks' futures, which must run once the GPU has finished the command list. Empty
+         * if nothing was asked for
+         */
+        [[nodiscard]] std::function<void()> record_readbacks(rhi::RhiRenderCommandList& cmds, const RenderTargetLookup& find_render_target);
+
+    private:
+        struct BufferSource {
+            rhi::RhiBuffer* buffer = nullptr;
+
+            mem::Bytes offset = 0;
+
+            mem::Bytes num_bytes = 0;
+        };
+
+        struct RenderTargetSource {
+            std::string name;
+
+            ImageReadbackRegion region;
+        };
+
+        struct Request {
+            std::variant<BufferSource, RenderTargetSource> source;
+
+            std::promise<std::optional<ReadbackData>> promise;
+
+            /*!
+             * \brief The render target that `source` names, once the copy is recorded
+             */
+            ReadableRenderTarget render_target;
+
+            /*!
+             * \brief Everything about the data except the bytes, filled in when the copy is recorded
+             */
+            ReadbackData data;
+
+            /*!
+             * \brief Where the data is in the readback buffer
+             */
+            mem::Bytes readback_offset = 0;
+
+            mem::Bytes num_bytes = 0;
+        };
+
+        /*!
+         * \brief One frame's readbacks, which all share a readback buffer
+         */
+        struct Batch {
+            rhi::RhiBuffer* buffer = nullptr;
+
+            std::vector<Request> requests;
+        };
+
+        rhi::RenderDevice& device;
+
+        std::mutex requests_mutex;
+
+        std::vector<Request> pending_requests;
+
+        /*!
+         * \brief Readback buffers that no frame is copying to. Only the frame thread touches these
+         */
+        std::vector<rhi::RhiBuffer*> free_buffers;
+
+        std::vector<rhi::RhiBuffer*> all_buffers;
+
+        uint32_t next_buffer_idx = 0;
+
+        [[nodiscard]] rhi::RhiBuffer* get_free_buffer(mem::Bytes min_size);
+
+        void finish_batch(Batch& batch);
+    };
+} // namespace nova::renderer
@@ -0,0 +1,320 @@
+#include "render_outputs.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include <Tracy.hpp>
+
+#include "nova_renderer/resource_loader.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/swapchain.hpp"
+#include "nova_renderer/util/logging.hpp"
+#include "nova_renderer/window.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("RenderOutputs");
+
+    static rhi::RhiResourceBarrier make_image_barrier(rhi::RhiImage* image,
+                                                      const rhi::ResourceState old_state,
+                                                      const rhi::ResourceAccess old_access,
+                                                      const rhi::ResourceState new_state,
+                                                      const rhi::ResourceAccess new_access) {
+        rhi::RhiResourceBarrier barrier{};
+        barrier.resource_to_barrier = image;
+        barrier.old_state = old_state;
+        barrier.new_state = new_state;
+        barrier.access_before_barrier = old_access;
+        barrier.access_after_barrier = new_access;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    RenderOutputs::RenderOutputs(rhi::RenderDevice& device, DeviceResources& device_resources, const NovaSettings& settings)
+        : device{device}, device_resources{device_resources}, settings{settings} {}
+
+    RenderOutputs::~RenderOutputs() {
+        for(Output& output : outputs) {
+            destroy_output(output);
+        }
+    }
+
+    std::optional<RenderOutputId> RenderOutputs::add_output(const RenderOutputCreateInfo& create_info) {
+        ZoneScoped;
+        if(create_info.size.x == 0 || create_info.size.y == 0) {
+            logger->error("Render output {} has no pixels", create_info.name);
+            return std::nullopt;
+        }
+
+        Output output{.id = next_output_id, .create_info = create_info};
+
+        if(create_info.has_window) {
+            auto window_settings = settings;
+            window_settings.window.title = output.create_info.title.c_str();
+            window_settings.window.width = create_info.size.x;
+            window_settings.window.height = create_info.size.y;
+            window_settings.window.visible = true;
+            output.window = std::make_unique<NovaWindow>(window_settings);
+
+            output.swapchain = device.create_window_swapchain(*output.window);
+            if(output.swapchain == nullptr) {
+                logger->error("Could not create a swapchain for render output {}", create_info.name);
+                return std::nullopt;
+            }
+
+            output.window_size = output.window->get_framebuffer_size();
+            output.image_available_semaphores = device.create_semaphores(settings.max_in_flight_frames);
+            output.render_finished_semaphores = device.create_semaphores(settings.max_in_flight_frames);
+            output.swapchain_image_fences.resize(output.swapchain->get_num_images(), nullptr);
+
+        } else {
+            if(device_resources.get_render_target(create_info.name)) {
+                logger->error("There's already a render target named {}, so render output {} can't render to it",
+                              create_info.name,
+                              create_info.name);
+                return std::nullopt;
+            }
+
+            const auto render_target = device_resources.create_render_target(create_info.name,
+                                                                              create_info.size.x,
+                                                                              create_info.size.y,
+                                                                              rhi::PixelFormat::Rgba8,
+                                                                              true);
+            if(!render_target) {
+                logger->error("Could not create the render target of render output {}", create_info.name);
+                return std::nullopt;
+            }
+
+            output.render_target = (*render_target)->image;
+        }
+
+        next_output_id++;
+        outputs.push_back(std::move(output));
+
+        logger->info("Added render output {} at {}x{}", create_info.name, create_info.size.x, create_info.size.y);
+
+        return outputs.back().id;
+    }
+
+    void RenderOutputs::remove_output(const RenderOutputId id) {
+        ZoneScoped;
+        const auto output_itr = std::find_if(outputs.begin(), outputs.end(), [&](const Output& output) { return output.id == id; });
+        if(output_itr == outputs.end()) {
+            logger->error("There's no render output with ID {}", id);
+            return;
+        }
+
+        destroy_output(*output_itr);
+        outputs.erase(output_itr);
+    }
+
+    NovaWindow* RenderOutputs::get_window(const RenderOutputId id) const {
+        const auto output_itr = std::find_if(outputs.begin(), outputs.end(), [&](const Output& output) { return output.id == id; });
+        return output_itr != outputs.end() ? output_itr->window.get() : nullptr;
+    }
+
+    void RenderOutputs::update_window_sizes() {
+        for(Output& output : outputs) {
+            if(output.window) {
+                output.window_size = output.window->get_framebuffer_size();
+            }
+        }
+    }
+
+    void RenderOutputs::recreate_swapchains() {
+        ZoneScoped;
+        for(Output& output : outputs) {
+            // Vulkan won't make a swapchain with no pixels, so minimized windows keep their old one until they come back
+            if(output.swapchain == nullptr || output.window_size.x == 0 || output.window_size.y == 0) {
+                continue;
+            }
+
+            if(output.swapchain->needs_recreation() || output.window_size != output.swapchain->get_size()) {
+                device.recreate_window_swapchain(*output.swapchain, *output.window);
+                logger->debug("Recreated the swapchain of render output {} at {}x{}",
+                              output.create_info.name,
+                              output.swapchain->get_size().x,
+                              output.swapchain->get_size().y);
+
+                // The new swapchain may have a different number of images, and none of them are in use
+                output.swapchain_image_fences.assign(output.swapchain->get_num_images(), nullptr);
+            }
+        }
+    }
+
+    void RenderOutputs::record_blits(rhi::RhiRenderCommandList& cmds,
+                                     const uint32_t frame_idx,
+                                     rhi::RhiFence* frame_fence,
+                                     const RenderOutputSourceLookup& find_source) {
+        ZoneScoped;
+        frame_wait_semaphores.clear();
+        frame_signal_semaphores.clear();
+
+        struct Blit {
+            const Output* output;
+
+            RenderOutputSource source;
+
+            rhi::RhiImage* destination;
+
+            glm::uvec2 destination_size;
+
+            rhi::ResourceState destination_state;
+        };
+        std::vector<Blit> blits;
+        blits.reserve(outputs.size());
+
+        for(Output& output : outputs) {
+            output.acquired_image_idx.reset();
+
+            const auto source = find_source(output.create_info.source);
+            if(!source) {
+                logger->error("Render output {} can't show render target {}. Either it doesn't exist, or it shares its memory with other "
+                              "render targets or is transient, so it's gone by the end of the frame",
+                              output.create_info.name,
+                              output.create_info.source);
+                continue;
+            }
+
+            if(output.create_info.source_layer >= source->num_layers) {
+                logger->error("Render output {} can't show layer {} of render target {}, which only has {} layers",
+                              output.create_info.name,
+                              output.create_info.source_layer,
+                              output.create_info.source,
+                              source->num_layers);
+                continue;
+            }
+
+            if(output.swapchain == nullptr) {
+                blits.push_back({&output, *source, output.render_target, output.create_info.size, rhi::ResourceState::RenderTarget});
+                continue;
+            }
+
+            if(output.window_size.x == 0 || output.window_size.y == 0 || output.swapchain->needs_recreation()) {
+                continue;
+            }
+
+            output.acquired_image_idx = output.swapchain->acquire_next_swapchain_image(output.image_available_semaphores[frame_idx]);
+            if(!output.acquired_image_idx) {
+                // The swapchain went out of date. It gets recreated at the start of the next frame
+                continue;
+            }
+
+            // Like Nova's own swapchain, the image may still be in use by another frame in flight
+            auto& image_fence = output.swapchain_image_fences[*output.acquired_image_idx];
+            if(image_fence != nullptr && image_fence != frame_fence) {
+                device.wait_for_fences(std::array{image_fence});
+            }
+            image_fence = frame_fence;
+
+            frame_wait_semaphores.push_back(output.image_available_semaphores[frame_idx]);
+            frame_signal_semaphores.push_back(output.render_finished_semaphores[frame_idx]);
+
+            blits.push_back({&output,
+                             *source,
+                             output.swapchain->get_image(*output.acquired_image_idx),
+                             output.swapchain->get_size(),
+                             rhi::ResourceState::PresentSource});
+        }
+
+        if(blits.empty()) {
+            return;
+        }
+
+        // Several outputs may show the same source, and a barrier that's in the list twice would transition it twice
+        std::vector<rhi::RhiResourceBarrier> barriers_before;
+        std::vector<rhi::RhiResourceBarrier> barriers_after;
+        std::vector<rhi::RhiImage*> barriered_sources;
+        for(const Blit& blit : blits) {
+            if(std::find(barriered_sources.begin(), barriered_sources.end(), blit.source.image) == barriered_sources.end()) {
+                barriered_sources.push_back(blit.source.image);
+                barriers_before.push_back(make_image_barrier(blit.source.image,
+                                                             blit.source.state,
+                                                             rhi::ResourceAccess::ColorAttachmentWrite,
+                                                             rhi::ResourceState::CopySource,
+                                                             rhi::ResourceAccess::CopyRead));
+                barriers_after.push_back(make_image_barrier(blit.source.image,
+                                                            rhi::ResourceState::CopySource,
+                                                            rhi::ResourceAccess::CopyRead,
+                                                            blit.source.state,
+                                                            rhi::ResourceAccess::ColorAttachmentWrite));
+            }
+
+            // The blit covers the whole destination, so whatever was in it before doesn't matter
+            barriers_before.push_back(make_image_barrier(blit.destination,
+                                                         rhi::ResourceState::Undefined,
+                                                         rhi::ResourceAccess::MemoryRead,
+                                                         rhi::ResourceState::CopyDestination,
+                                                         rhi::ResourceAccess::CopyWrite));
+            barriers_after.push_back(make_image_barrier(blit.destination,
+                                                        rhi::ResourceState::CopyDestination,
+                                                        rhi::ResourceAccess::CopyWrite,
+                                                        blit.destination_state,
+                                                        rhi::ResourceAccess::MemoryRead));
+        }
+
+        cmds.resource_barriers(rhi::PipelineStage::AllCommands, rhi::PipelineStage::Transfer, barriers_before);
+
+        for(const Blit& blit : blits) {
+            cmds.blit_image(blit.source.image,
+                            blit.output->create_info.source_layer,
+                            blit.source.rendered_size.x,
+                            blit.source.rendered_size.y,
+                            blit.destination,
+                            blit.destination_size.x,
+                            blit.destination_size.y);
+        }
+
+        cmds.resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::AllCommands, barriers_after);
+    }
+
+    std::span<rhi::RhiSemaphore* const> RenderOutputs::get_wait_semaphores() const { return frame_wait_semaphores; }
+
+    std::span<rhi::RhiSemaphore* const> RenderOutputs::get_signal_semaphores() const { return frame_signal_semaphores; }
+
+    void RenderOutputs::present(const uint32_t frame_idx) {
+        ZoneScoped;
+        for(Output& output : outputs) {
+            if(output.acquired_image_idx) {
+                output.swapchain->present(*output.acquired_image_idx, output.render_finished_semaphores[frame_idx]);
+                output.acquired_image_idx.reset();
+            }
+        }
+    }
+
+    std::optional<ReadableRenderTarget> RenderOutputs::get_offscreen_target(const std::string& name) const {
+        const auto output_itr = std::find_if(outputs.begin(), outputs.end(), [&](const Output& output) {
+            return output.render_target != nullptr && output.create_info.name == name;
+        });
+        if(output_itr == outputs.end()) {
+            return std::nullopt;
+        }
+
+        return ReadableRenderTarget{output_itr->render_target,
+                                    rhi::ResourceState::RenderTarget,
+                                    rhi::PixelFormat::Rgba8,
+                                    output_itr->create_info.size.x,
+                                    output_itr->create_info.size.y,
+                                    1};
+    }
+
+    void RenderOutputs::destroy_output(Output& output) {
+        if(output.swapchain != nullptr) {
+            device.destroy_window_swapchain(output.swapchain);
+            output.swapchain = nullptr;
+
+            device.destroy_semaphores(output.image_available_semaphores);
+            device.destroy_semaphores(output.render_finished_semaphores);
+        }
+
+        if(output.render_target != nullptr) {
+            device_resources.destroy_render_target(output.create_info.name);
+            output.render_target = nullptr;
+        }
+
+        output.window.reset();
+    }
+} // namespace nova::renderer
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/render_output.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_enums.hpp"
+
+#include "readback_manager.hpp"
+
+namespace nova::renderer {
+    class DeviceResources;
+    class NovaWindow;
+
+    namespace rhi {
+        class RenderDevice;
+        class Swapchain;
+    } // namespace rhi
+
+    /*!
+     * \brief A render target that an output can show, and what state it's in at the end of the frame
+     */
+    struct RenderOutputSource {
+        rhi::RhiImage* image = nullptr;
+
+        rhi::ResourceState state = rhi::ResourceState::RenderTarget;
+
+        /*!
+         * \brief How much of the render target the frame rendered to, from its top-left corner. Less than all of it with dynamic
+         * resolution
+         */
+        glm::uvec2 rendered_size{};
+
+        uint32_t num_layers = 1;
+    };
+
+    /*!
+     * \brief Finds the render target with the provided name, or nothing if it doesn't exist or its contents don't last until the end of
+     * the frame
+     */
+    using RenderOutputSourceLookup = std::function<std::optional<RenderOutputSource>(const std::string& name)>;
+
+    /*!
+     * \brief The outputs that every frame is shown in, besides Nova's own window
+     *
+     * Nothing about the frame is recorded more than once. At the end of the frame's last graphics command list, each output's source is
+     * blitted into the output's next swapchain image, or into its render target if it doesn't have a window. The blits are filtered, so
+     * an output may be any size. Each windowed output has its own semaphores in every frame slot, which the last graphics submission
+     * waits on and signals, and it's presented right after Nova's own swapchain
+     *
+     * Add and remove outputs on the main thread, between frames. GLFW only lets the main thread make windows and ask for their sizes
+     */
+    class RenderOutputs {
+    public:
+        RenderOutputs(rhi::RenderDevice& device, DeviceResources& device_resources, const NovaSettings& settings);
+
+        RenderOutputs(const RenderOutputs& other) = delete;
+        RenderOutputs& operator=(const RenderOutputs& other) = delete;
+
+        RenderOutputs(RenderOutputs&& old) noexcept = delete;
+        RenderOutputs& operator=(RenderOutputs&& old) noexcept = delete;
+
+        /*!
+         * \brief Destroys every output. The GPU must be done with all of them
+         */
+        ~RenderOutputs();
+
+        /*!
+         * \return The output's ID, or nothing if its window, swapchain, or render target couldn't be made
+         */
+        [[nodiscard]] std::optional<RenderOutputId> add_output(const RenderOutputCreateInfo& create_info);
+
+        /*!
+         * \brief Destroys an output and closes its window. The GPU must be done with it
+         */
+        void remove_output(RenderOutputId id);
+
+        /*!
+         * \brief Gets an output's window, or nullptr if the output doesn't exist or doesn't have a window
+         */
+        [[nodiscard]] NovaWindow* get_window(RenderOutputId id) const;
+
+        /*!
+         * \brief Saves the size of every output's window, for the frame that's about to start. Only call this from the main thread
+         */
+        void update_window_sizes();
+
+        /*!
+         * \brief Recreates the swapchains whose windows changed size, or that went out of date. Waits for the GPU if there are any
+         */
+        void recreate_swapchains();
+
+        /*!
+         * \brief Acquires the next image of every windowed output's swapchain, and records blits of the outputs' sources
+         *
+         * Call it at the end of the frame's last graphics command list, after every render target is back in its resting state, and before
+         * the readbacks, so that readbacks of offscreen outputs get this frame
+         *
+         * \param frame_fence The fence that the frame signals when the GPU is done with it. Swapchain images that another frame in flight
+         * still uses are waited for before they're reused
+         */
+        void record_blits(rhi::RhiRenderCommandList& cmds,
+                          uint32_t frame_idx,
+                          rhi::RhiFence* frame_fence,
+                          const RenderOutputSourceLookup& find_source);
+
+        /*!
+         * \brief The semaphores that the command list with the blits has to wait on before it starts. Empty if nothing was acquired
+         */
+        [[nodiscard]] std::span<rhi::RhiSemaphore* const> get_wait_semaphores() const;
+
+        /*!
+         * \brief The semaphores that the command list with the blits has to signal when it's done, so the outputs can be presented
+         */
+        [[nodiscard]] std::span<rhi::RhiSemaphore* const> get_signal_semaphores() const;
+
+        /*!
+         * \brief Presents every swapchain image that `record_blits` blitted to. Call it after the frame is submitted
+         */
+        void present(uint32_t frame_idx);
+
+        /*!
+         * \brief Finds an output without a window whose render target has the provided name, for readbacks
+         */
+        [[nodiscard]] std::optional<ReadableRenderTarget> get_offscreen_target(const std::string& name) const;
+
+    private:
+        struct Output {
+            RenderOutputId id;
+
+            RenderOutputCreateInfo create_info;
+
+            std::unique_ptr<NovaWindow> window;
+
+            rhi::Swapchain* swapchain = nullptr;
+
+            /*!
+             * \brief The size of the window when the current frame started. Zero when the window is minimized
+             */
+            glm::uvec2 window_size{};
+
+            /*!
+             * \brief One semaphore per in-flight frame, signaled when that frame's swapchain image is ready to be blitted to
+             */
+            std::vector<rhi::RhiSemaphore*> image_available_semaphores;
+
+            /*!
+             * \brief One semaphore per in-flight frame, signaled when the blit to that frame's swapchain image is done
+             */
+            std::vector<rhi::RhiSemaphore*> render_finished_semaphores;
+
+            /*!
+             * \brief The frame fence of the frame that most recently blitted to each swapchain image, or nullptr if the image is unused
+             */
+            std::vector<rhi::RhiFence*> swapchain_image_fences;
+
+            /*!
+             * \brief The swapchain image that the current frame blits to, or nothing if the output isn't presented this frame
+             */
+            std::optional<uint8_t> acquired_image_idx;
+
+            /*!
+             * \brief The render target that an output without a window renders to
+             */
+            rhi::RhiImage* render_target = nullptr;
+        };
+
+        rhi::RenderDevice& device;
+
+        DeviceResources& device_resources;
+
+        /*!
+         * \brief The settings that the outputs' windows are opened with, other than their title and size
+         */
+        NovaSettings settings;
+
+        std::vector<Output> outputs;
+
+        RenderOutputId next_output_id = 1;
+
+        std::vector<rhi::RhiSemaphore*> frame_wait_semaphores;
+
+        std::vector<rhi::RhiSemaphore*> frame_signal_semaphores;
+
+        void destroy_output(Output& output);
+    };
+} // namespace nova::renderer
@@ -1,5 +1,8 @@
 #include "nova_renderer/rendergraph.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <tuple>
 #include <utility>
 
 #include <Tracy.hpp>
@@ -8,6 +11,14 @@
 #include "nova_renderer/rhi/command_list.hpp"
 
 #include "../loading/renderpack/render_graph_builder.hpp"
+#include "../rhi/command_stream.hpp"
+#include "../rhi/draw_command_list.hpp"
+#include "cpu_timeline.hpp"
+#include "dynamic_resolution.hpp"
+#include "gpu_profiler.hpp"
+#include "occlusion_queries.hpp"
+#include "particle_system.hpp"
+#include "skinning_system.hpp"
 #include "pipeline_reflection.hpp"
 
 namespace nova::renderer {
@@ -18,37 +29,168 @@ namespace nova::renderer {
     Renderpass::Renderpass(std::string name, const bool is_builtin) : name(std::move(name)), is_builtin(is_builtin) {}
 
     void Renderpass::execute(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
-        const auto& profiling_event_name = std::string::format("Execute %s", name);
-        ZoneScoped;        // TODO: Figure if any of these barriers are implicit
-        // TODO: Use shader reflection to figure our the stage that the pipelines in this renderpass need access to this resource instead of
-        // using a robust default
+        ZoneScoped;
+        const CpuTimelineScope cpu_scope{ctx.cpu_timeline, name};
+        const GpuProfileScope gpu_scope{ctx.gpu_profiler, cmds, 0, name};
+
+        // Compute-only queues can't count pipeline statistics, and a query can't span more than one subpass
+        const auto counts_statistics = queue == rhi::QueueType::Graphics && !merged_subpass;
+        const PipelineStatisticsScope statistics_scope{counts_statistics ? ctx.gpu_profiler : nullptr, cmds, name};
 
         record_pre_renderpass_barriers(cmds, ctx);
 
+        // Something that's on reads this pass's outputs, so it still has to clear them
+        if(!is_enabled) {
+            if(renderpass != nullptr) {
+                begin_subpass(cmds, ctx, rhi::RenderpassContents::Inline);
+                end_subpass(cmds);
+            }
+
+            record_post_renderpass_barriers(cmds, ctx);
+            return;
+        }
+
+        // The barriers still have to happen, so the passes after this one find the cached contents where they expect them
+        if(can_reuse_cached_contents()) {
+            record_post_renderpass_barriers(cmds, ctx);
+            return;
+        }
+
         setup_renderpass(cmds, ctx);
 
-        const auto framebuffer = get_framebuffer(ctx);
+        // Compute passes have nothing to begin or end
+        if(renderpass == nullptr) {
+            record_renderpass_contents(cmds, ctx);
+
+        } else {
+            begin_subpass(cmds, ctx, rhi::RenderpassContents::Inline);
+
+            set_dynamic_resolution_viewport(cmds, ctx);
 
-        cmds.begin_renderpass(renderpass, framebuffer);
+            set_view_cameras(cmds);
 
-        record_renderpass_contents(cmds, ctx);
+            record_renderpass_contents(cmds, ctx);
 
-        cmds.end_renderpass();
+            end_subpass(cmds);
+        }
 
         record_post_renderpass_barriers(cmds, ctx);
+
+        if(is_cached || update_interval > 1) {
+            rendered_cache_key = cache_key;
+        }
     }
 
-    void Renderpass::record_pre_renderpass_barriers(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
-        ZoneScoped;        if(read_texture_barriers.size() > 0) {
-            // TODO: Use shader reflection to figure our the stage that the pipelines in this renderpass need access to this resource
-            // instead of using a robust default
-            cmds.resource_barriers(rhi::PipelineStage::ColorAttachmentOutput, rhi::PipelineStage::FragmentShader, read_texture_barriers);
+    void Renderpass::execute(rhi::RhiRenderCommandList& cmds, FrameContext& ctx, rhi::RhiRenderCommandList& contents) {
+        ZoneScoped;
+        const CpuTimelineScope cpu_scope{ctx.cpu_timeline, name};
+        const GpuProfileScope gpu_scope{ctx.gpu_profiler, cmds, 0, name};
+
+        // Compute-only queues can't count pipeline statistics, and a query can't span more than one subpass
+        const auto counts_statistics = queue == rhi::QueueType::Graphics && !merged_subpass;
+        const PipelineStatisticsScope statistics_scope{counts_statistics ? ctx.gpu_profiler : nullptr, cmds, name};
+
+        record_pre_renderpass_barriers(cmds, ctx);
+
+        setup_renderpass(cmds, ctx);
+
+        begin_subpass(cmds, ctx, rhi::RenderpassContents::SecondaryCommandLists);
+
+        cmds.execute_command_lists({&contents});
+
+        end_subpass(cmds);
+
+        record_post_renderpass_barriers(cmds, ctx);
+
+        if(is_cached || update_interval > 1) {
+            rendered_cache_key = cache_key;
         }
+    }
 
-        if(write_texture_barriers.size() > 0) {
-            // TODO: Use shader reflection to figure our the stage that the pipelines in this renderpass need access to this resource
-            // instead of using a robust default
-            cmds.resource_barriers(rhi::PipelineStage::ColorAttachmentOutput, rhi::PipelineStage::FragmentShader, write_texture_barriers);
+    void Renderpass::execute(rhi::RhiRenderCommandList& cmds, FrameContext& ctx, const rhi::CommandStream& contents) {
+        ZoneScoped;
+        const CpuTimelineScope cpu_scope{ctx.cpu_timeline, name};
+        const GpuProfileScope gpu_scope{ctx.gpu_profiler, cmds, 0, name};
+
+        const auto counts_statistics = queue == rhi::QueueType::Graphics && !merged_subpass;
+        const PipelineStatisticsScope statistics_scope{counts_statistics ? ctx.gpu_profiler : nullptr, cmds, name};
+
+        record_pre_renderpass_barriers(cmds, ctx);
+
+        setup_renderpass(cmds, ctx);
+
+        begin_subpass(cmds, ctx, rhi::RenderpassContents::Inline);
+
+        contents.translate(cmds);
+
+        end_subpass(cmds);
+
+        record_post_renderpass_barriers(cmds, ctx);
+
+        if(is_cached || update_interval > 1) {
+            rendered_cache_key = cache_key;
+        }
+    }
+
+    bool Renderpass::can_reuse_cached_contents() const {
+        if(!rendered_cache_key || (is_cached && *rendered_cache_key != cache_key)) {
+            return false;
+        }
+
+        return is_cached || (update_interval > 1 && !is_update_frame);
+    }
+
+    void Renderpass::invalidate_cached_contents() { rendered_cache_key.reset(); }
+
+    void Renderpass::begin_subpass(rhi::RhiRenderCommandList& cmds, const FrameContext& ctx, const rhi::RenderpassContents contents) const {
+        if(merged_subpass && merged_subpass->index > 0) {
+            cmds.next_subpass(contents);
+
+        } else {
+            cmds.begin_renderpass(get_renderpass(), get_framebuffer(ctx), contents);
+        }
+    }
+
+    void Renderpass::end_subpass(rhi::RhiRenderCommandList& cmds) const {
+        if(!merged_subpass || merged_subpass->is_last) {
+            cmds.end_renderpass();
+        }
+    }
+
+    void Renderpass::record_contents(rhi::RhiRenderCommandList& secondary_cmds, FrameContext& ctx) {
+        ZoneScoped;
+        set_dynamic_resolution_viewport(secondary_cmds, ctx);
+
+        // Secondary command lists don't inherit push constants
+        if(renderpass != nullptr) {
+            set_view_cameras(secondary_cmds);
+        }
+
+        record_renderpass_contents(secondary_cmds, ctx);
+    }
+
+    void Renderpass::set_dynamic_resolution_viewport(rhi::RhiRenderCommandList& cmds, const FrameContext& ctx) const {
+        if(!uses_dynamic_resolution || ctx.resolution_scale >= 1.0f) {
+            return;
+        }
+
+        if(const auto* cur_framebuffer = get_framebuffer(ctx); cur_framebuffer != nullptr) {
+            const auto scaled_size = scale_resolution(cur_framebuffer->size, ctx.resolution_scale);
+            cmds.set_viewport(0, 0, scaled_size.x, scaled_size.y);
+        }
+    }
+
+    void Renderpass::set_view_cameras(rhi::RhiRenderCommandList& cmds) const {
+        // The camera index lasts past the end of the renderpass, so passes without views have to put it back
+        cmds.set_camera_index(first_view_camera.value_or(0));
+    }
+
+    void Renderpass::record_pre_renderpass_barriers(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
+        ZoneScoped;
+        if(!pre_pass_barriers.barriers.empty()) {
+            cmds.resource_barriers(pre_pass_barriers.stages_before_barrier,
+                                   pre_pass_barriers.stages_after_barrier,
+                                   pre_pass_barriers.barriers);
         }
 
         if(writes_to_backbuffer) {
@@ -64,24 +206,43 @@ namespace nova::renderer {
 
             // TODO: Use shader reflection to figure our the stage that the pipelines in this renderpass need access to this resource
             // instead of using a robust default
-            std::vector<rhi::RhiResourceBarrier> barriers{&rx::memory::g_system_allocator};
-            barriers.push_back(backbuffer_barrier);
-            cmds.resource_barriers(rhi::PipelineStage::TopOfPipe, rhi::PipelineStage::ColorAttachmentOutput, barriers);
+            cmds.resource_barriers(rhi::PipelineStage::TopOfPipe, rhi::PipelineStage::ColorAttachmentOutput, {&backbuffer_barrier, 1});
         }
     }
 
     void Renderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
         ZoneScoped;
-        pipeline_names.each_fwd([&](const std::string& pipeline_name) {
-            const auto* pipeline = ctx.nova->find_pipeline(pipeline_name);
-            if(pipeline) {
+        if(has_depth_prepass) {
+            const GpuProfileScope prepass_scope{ctx.gpu_profiler, cmds, 1, "DepthPrepass"};
+            for(const PipelineHandle handle : pipelines) {
+                if(const auto* pipeline = ctx.nova->get_pipeline(handle); pipeline != nullptr && pipeline->depth_prepass_pipeline) {
+                    pipeline->record_depth_prepass(cmds, ctx);
+                }
+            }
+
+            // The boxes are tested against the depth prepass, and only camera 0 has occlusion results
+            if(ctx.occlusion_queries != nullptr && !first_view_camera) {
+                ctx.occlusion_queries->record_queries(cmds, *this, static_cast<uint32_t>(ctx.frame_idx));
+            }
+        }
+
+        for(const PipelineHandle handle : pipelines) {
+            // Pipelines that are still compiling don't draw anything yet
+            if(const auto* pipeline = ctx.nova->get_pipeline(handle)) {
                 pipeline->record(cmds, ctx);
             }
-        });
+        }
     }
 
     void Renderpass::record_post_renderpass_barriers(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
-        ZoneScoped;        if(writes_to_backbuffer) {
+        ZoneScoped;
+        if(!post_pass_barriers.barriers.empty()) {
+            cmds.resource_barriers(post_pass_barriers.stages_before_barrier,
+                                   post_pass_barriers.stages_after_barrier,
+                                   post_pass_barriers.barriers);
+        }
+
+        if(writes_to_backbuffer) {
             rhi::RhiResourceBarrier backbuffer_barrier{};
             backbuffer_barrier.resource_to_barrier = ctx.swapchain_image;
             backbuffer_barrier.access_before_barrier = rhi::ResourceAccess::ColorAttachmentWrite;
@@ -92,9 +253,7 @@ namespace nova::renderer {
             backbuffer_barrier.destination_queue = rhi::QueueType::Graphics;
             backbuffer_barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
 
-            std::vector<rhi::RhiResourceBarrier> barriers{&rx::memory::g_system_allocator};
-            barriers.push_back(backbuffer_barrier);
-            cmds.resource_barriers(rhi::PipelineStage::ColorAttachmentOutput, rhi::PipelineStage::BottomOfPipe, barriers);
+            cmds.resource_barriers(rhi::PipelineStage::ColorAttachmentOutput, rhi::PipelineStage::BottomOfPipe, {&backbuffer_barrier, 1});
         }
     }
 
@@ -106,162 +265,1232 @@ namespace nova::renderer {
     void GlobalRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
         cmds.set_pipeline(*pipeline);
 
-        cmds.bind_resources(*resource_binder);
+        cmds.bind_resources(*resource_binder, static_cast<uint32_t>(ctx.frame_idx));
 
         const auto mesh_data = ctx.nova->get_mesh(mesh);
-        cmds.bind_index_buffer(mesh_data->index_buffer, rhi::IndexType::Uint32);
+        cmds.bind_index_buffer(mesh_data->index_buffer, mesh_data->index_type);
         cmds.bind_vertex_buffers(std::array{mesh_data->vertex_buffer});
 
-        cmds.draw_indexed_mesh(3);
+        cmds.draw_indexed_mesh(mesh_data->num_indices, mesh_data->first_index, 1, mesh_data->vertex_offset);
+    }
+
+    ComputeRenderpass::ComputeRenderpass(const std::string& name,
+                                         std::unique_ptr<rhi::RhiPipeline> pipeline,
+                                         const glm::uvec3 num_groups,
+                                         rhi::RenderDevice& device,
+                                         const bool is_builtin)
+        : Renderpass{name, is_builtin}, pipeline{std::move(pipeline)}, num_groups{num_groups} {
+        resource_binder = device.create_resource_binder_for_pipeline(*this->pipeline);
+    }
+
+    RhiResourceBinder& ComputeRenderpass::get_resource_binder() const { return *resource_binder; }
+
+    void ComputeRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        ZoneScoped;
+        cmds.set_compute_pipeline(*pipeline);
+
+        cmds.bind_compute_resources(*resource_binder, static_cast<uint32_t>(ctx.frame_idx));
+
+        cmds.dispatch(num_groups.x, num_groups.y, num_groups.z);
     }
 
     Rendergraph::Rendergraph(rhi::RenderDevice& device) : device(device) {}
 
+    /*!
+     * \brief Calls `func` with the name of every texture and buffer that the pass writes to
+     */
+    template <typename FuncType>
+    static void for_each_written_resource(const RenderPassCreateInfo& create_info, FuncType&& func) {
+        for(const TextureAttachmentInfo& output : create_info.texture_outputs) {
+            func(output.name);
+        }
+
+        for(const std::string& buffer_name : create_info.output_buffers) {
+            func(buffer_name);
+        }
+    }
+
     void Rendergraph::destroy_renderpass(const std::string& name) {
-        if(Renderpass** renderpass = renderpasses.find(name)) {
-            if((*renderpass)->framebuffer) {
-                device.destroy_framebuffer((*renderpass)->framebuffer, allocator);
+        const auto handle_itr = handles_by_name.find(name);
+        if(handle_itr == handles_by_name.end()) {
+            return;
+        }
+
+        destroy_merged_renderpass(name);
+
+        const auto handle = handle_itr->second;
+        auto* renderpass = renderpasses[handle];
+        if(renderpass->framebuffer) {
+            device.destroy_framebuffer(renderpass->framebuffer, allocator);
+        }
+
+        if(renderpass->renderpass) {
+            device.destroy_renderpass(renderpass->renderpass, allocator);
+        }
+
+        for_each_written_resource(renderpass_metadatas[handle].data, [&](const std::string& resource_name) {
+            if(const auto writers_itr = resource_writers.find(resource_name); writers_itr != resource_writers.end()) {
+                std::erase(writers_itr->second, handle);
+                if(writers_itr->second.empty()) {
+                    resource_writers.erase(writers_itr);
+                }
+            }
+        });
+
+        renderpasses[handle] = nullptr;
+        renderpass_metadatas[handle] = {};
+        free_handles.push_back(handle);
+        handles_by_name.erase(handle_itr);
+
+        is_dirty = true;
+        barriers_dirty = true;
+    }
+
+    void Rendergraph::set_renderpass_enabled(const std::string& name, const bool enabled) {
+        auto* renderpass = get_renderpass(name);
+        if(renderpass == nullptr || renderpass->is_enabled == enabled) {
+            return;
+        }
+
+        renderpass->is_enabled = enabled;
+
+        // Whatever a cached pass kept is from before it was turned off
+        renderpass->invalidate_cached_contents();
+
+        is_dirty = true;
+        barriers_dirty = true;
+    }
+
+    void Rendergraph::recreate_framebuffers(DeviceResources& resource_storage) {
+        ZoneScoped;
+        for(RenderpassHandle handle = 0; handle < renderpasses.size(); handle++) {
+            auto* renderpass = renderpasses[handle];
+            if(renderpass == nullptr || renderpass->framebuffer == nullptr) {
+                continue;
+            }
+
+            auto& create_info = renderpass_metadatas[handle].data;
+
+            std::vector<rhi::RhiImage*> color_attachments;
+            color_attachments.reserve(create_info.texture_outputs.size());
+
+            // add_renderpass already made sure that every attachment is the same size, so the first one tells us the framebuffer's size
+            glm::uvec2 framebuffer_size(0);
+            bool missing_render_targets = false;
+            for(const TextureAttachmentInfo& attachment_info : create_info.texture_outputs) {
+                if(const auto render_target = resource_storage.get_render_target(attachment_info.name); render_target) {
+                    color_attachments.push_back((*render_target)->image);
+                    framebuffer_size = {(*render_target)->width, (*render_target)->height};
+
+                } else {
+                    rg_log->error("No render target named %s", attachment_info.name);
+                    missing_render_targets = true;
+                }
+            }
+
+            std::optional<rhi::RhiImage*> depth_attachment;
+            if(create_info.depth_texture) {
+                if(const auto depth_tex = resource_storage.get_render_target(create_info.depth_texture->name); depth_tex) {
+                    depth_attachment = (*depth_tex)->image;
+                    framebuffer_size = {(*depth_tex)->width, (*depth_tex)->height};
+
+                } else {
+                    rg_log->error("No render target named %s", create_info.depth_texture->name);
+                    missing_render_targets = true;
+                }
+            }
+
+            device.destroy_framebuffer(renderpass->framebuffer);
+            renderpass->framebuffer = nullptr;
+
+            if(missing_render_targets) {
+                rg_log->error("Could not recreate the framebuffer for renderpass %s", create_info.name);
+                continue;
+            }
+
+            const auto shading_rate_attachment = get_shading_rate_attachment(create_info, framebuffer_size, resource_storage);
+
+            renderpass->framebuffer = device.create_framebuffer(renderpass->renderpass,
+                                                                color_attachments,
+                                                                depth_attachment,
+                                                                shading_rate_attachment,
+                                                                framebuffer_size);
+        }
+
+        // The barriers point at the old images
+        barriers_dirty = true;
+    }
+
+    std::optional<rhi::RhiImage*> Rendergraph::get_shading_rate_attachment(renderpack::RenderPassCreateInfo& create_info,
+                                                                           const glm::uvec2& framebuffer_size,
+                                                                           DeviceResources& resource_storage) const {
+        if(!create_info.uses_adaptive_shading_rate) {
+            return std::nullopt;
+        }
+
+        if(device.info.shading_rate_image_texel_size > 0 && framebuffer_size == device.get_swapchain()->get_size()) {
+            if(const auto shading_rate_image = resource_storage.get_render_target(SHADING_RATE_RT_NAME); shading_rate_image) {
+                return (*shading_rate_image)->image;
+            }
+        }
+
+        rg_log->warning("Renderpass %s can't use an adaptive shading rate, so it will shade at its fixed rate", create_info.name);
+        create_info.uses_adaptive_shading_rate = false;
+
+        return std::nullopt;
+    }
+
+    void Rendergraph::register_renderpass(Renderpass* renderpass, RenderpassMetadata metadata) {
+        RenderpassHandle handle;
+        if(!free_handles.empty()) {
+            handle = free_handles.back();
+            free_handles.pop_back();
+
+            renderpasses[handle] = renderpass;
+            renderpass_metadatas[handle] = std::move(metadata);
+
+        } else {
+            handle = static_cast<RenderpassHandle>(renderpasses.size());
+
+            renderpasses.push_back(renderpass);
+            renderpass_metadatas.push_back(std::move(metadata));
+        }
+
+        renderpass->id = handle;
+
+        const auto& create_info = renderpass_metadatas[handle].data;
+        handles_by_name.emplace(create_info.name, handle);
+
+        for_each_written_resource(create_info, [&](const std::string& resource_name) {
+            auto& writers = resource_writers[resource_name];
+            if(std::find(writers.begin(), writers.end(), handle) != writers.end()) {
+                return;
             }
 
-            device.destroy_renderpass((*renderpass)->renderpass, allocator);
+            const auto insert_pos = std::upper_bound(writers.begin(),
+                                                     writers.end(),
+                                                     create_info.name,
+                                                     [&](const std::string& pass_name, const RenderpassHandle writer) {
+                                                         return pass_name < renderpass_metadatas[writer].data.name;
+                                                     });
+            writers.insert(insert_pos, handle);
+        });
 
-            renderpasses.erase(name);
-            renderpass_metadatas.erase(name);
+        is_dirty = true;
+        barriers_dirty = true;
+    }
+
+    /*!
+     * \brief Orders the passes the same way no matter what order they're provided in
+     *
+     * `order_passes` breaks ties by input order. Sorting by name first breaks them the same way the rendergraph's own index of resource
+     * writers does, so an order predicted before the renderpasses are added matches the order they actually execute in
+     */
+    static std::optional<std::vector<RenderPassCreateInfo>> order_passes_by_name(std::vector<RenderPassCreateInfo> create_infos) {
+        std::sort(create_infos.begin(), create_infos.end(), [](const RenderPassCreateInfo& lhs, const RenderPassCreateInfo& rhs) {
+            return lhs.name < rhs.name;
+        });
 
-            is_dirty = true;
+        auto order = order_passes(create_infos);
+        if(!order) {
+            rg_log->error("Could not determine renderpass execution order: %s", order.error.to_string());
+            return std::nullopt;
         }
+
+        return order.value;
     }
 
-    std::vector<std::string> Rendergraph::calculate_renderpass_execution_order() {
-        ZoneScoped;        if(is_dirty) {
-            const auto create_infos = [&]() {
-                std::vector<RenderPassCreateInfo> create_info_temp{&allocator};
-                create_info_temp.reserve(renderpass_metadatas.size());
+    const std::vector<Renderpass*>& Rendergraph::calculate_renderpass_execution_order() {
+        ZoneScoped;
+        if(!is_dirty) {
+            return cached_execution_order;
+        }
 
-                renderpass_metadatas.each_value([&](const RenderpassMetadata& metadata) { create_info_temp.emplace_back(metadata.data); });
+        cached_execution_order.clear();
+        is_dirty = false;
 
-                return create_info_temp;
-            }();
+        const auto backbuffer_writers = resource_writers.find(BACKBUFFER_NAME);
+        if(backbuffer_writers == resource_writers.end()) {
+            if(!handles_by_name.empty()) {
+                rg_log->error("Could not determine renderpass execution order: no pass writes to the backbuffer");
+            }
+            return cached_execution_order;
+        }
 
-            order_passes(create_infos)
-                .map([&](const std::vector<RenderPassCreateInfo>& order) {
-                    cached_execution_order.clear();
-                    cached_execution_order.reserve(order.size());
-                    order.each_fwd([&](const RenderPassCreateInfo& create_info) { cached_execution_order.emplace_back(create_info.name); });
+        std::vector<RenderpassHandle> ordered_passes = backbuffer_writers->second;
+        for(const RenderpassHandle handle : backbuffer_writers->second) {
+            add_dependent_passes(handle, ordered_passes, 1);
+        }
 
-                    return true;
-                })
-                .on_error([&](const auto& err) { rg_log->error("Could not determine renderpass execution order: %s", err.to_string()); });
+        // A pass has to run before every pass that depends on it, and the last time it shows up is after the last of those
+        std::vector<bool> is_ordered(renderpasses.size(), false);
+        cached_execution_order.reserve(handles_by_name.size());
+        for(auto itr = ordered_passes.rbegin(); itr != ordered_passes.rend(); ++itr) {
+            if(!is_ordered[*itr]) {
+                is_ordered[*itr] = true;
+                cached_execution_order.push_back(renderpasses[*itr]);
+            }
+        }
+
+        // Passes read the shading rate image that the frame before them made, so the passes that make it run after everything else
+        const auto uses_adaptive_shading_rate = std::any_of(ordered_passes.begin(),
+                                                            ordered_passes.end(),
+                                                            [&](const RenderpassHandle handle) {
+                                                                return renderpass_metadatas[handle].data.uses_adaptive_shading_rate;
+                                                            });
+        const auto shading_rate_writers = resource_writers.find(SHADING_RATE_RT_NAME);
+        if(uses_adaptive_shading_rate && shading_rate_writers != resource_writers.end()) {
+            std::vector<RenderpassHandle> shading_rate_passes = shading_rate_writers->second;
+            for(const RenderpassHandle handle : shading_rate_writers->second) {
+                add_dependent_passes(handle, shading_rate_passes, 1);
+            }
 
-            is_dirty = false;
+            for(auto itr = shading_rate_passes.rbegin(); itr != shading_rate_passes.rend(); ++itr) {
+                if(!is_ordered[*itr]) {
+                    is_ordered[*itr] = true;
+                    cached_execution_order.push_back(renderpasses[*itr]);
+                }
+            }
         }
 
         return cached_execution_order;
     }
 
+    void Rendergraph::add_dependent_passes(const RenderpassHandle handle,
+                                           std::vector<RenderpassHandle>& ordered_passes,
+                                           const uint32_t depth) const {
+        if(depth > handles_by_name.size()) {
+            rg_log->error("Circular render graph detected! Please fix your render graph to not have circular dependencies");
+            return;
+        }
+
+        // Passes that are off don't draw, so they don't need anything
+        if(!renderpasses[handle]->is_enabled) {
+            return;
+        }
+
+        const auto& create_info = renderpass_metadatas[handle].data;
+        const auto add_writers_of = [&](const std::string& resource_name) {
+            const auto writers_itr = resource_writers.find(resource_name);
+            if(writers_itr == resource_writers.end()) {
+                rg_log->error("Pass %s reads from %s, but nothing writes to it", create_info.name, resource_name);
+                return;
+            }
+
+            const auto& writers = writers_itr->second;
+            ordered_passes.insert(ordered_passes.end(), writers.begin(), writers.end());
+            for(const RenderpassHandle writer : writers) {
+                add_dependent_passes(writer, ordered_passes, depth + 1);
+            }
+        };
+
+        for(const std::string& texture_name : create_info.texture_inputs) {
+            add_writers_of(texture_name);
+        }
+
+        for(const std::string& buffer_name : create_info.input_buffers) {
+            add_writers_of(buffer_name);
+        }
+    }
+
+    std::vector<RenderPassCreateInfo> Rendergraph::predict_renderpass_execution_order(
+        const std::vector<RenderPassCreateInfo>& new_passes) const {
+        ZoneScoped;
+        std::vector<RenderPassCreateInfo> create_infos = new_passes;
+        create_infos.reserve(new_passes.size() + handles_by_name.size());
+
+        for(const auto& [name, handle] : handles_by_name) {
+            const auto is_replaced = std::any_of(new_passes.begin(), new_passes.end(), [&](const RenderPassCreateInfo& new_pass) {
+                return new_pass.name == name;
+            });
+            if(!is_replaced) {
+                create_infos.push_back(renderpass_metadatas[handle].data);
+            }
+        }
+
+        return order_passes_by_name(std::move(create_infos)).value_or(std::vector<RenderPassCreateInfo>{});
+    }
+
+    void Rendergraph::set_aliased_textures(std::unordered_set<std::string> textures) {
+        aliased_textures = std::move(textures);
+        barriers_dirty = true;
+    }
+
+    bool Rendergraph::is_aliased(const std::string& texture_name) const {
+        return aliased_textures.find(texture_name) != aliased_textures.end();
+    }
+
+    /*!
+     * \brief How a pass uses a render target
+     */
+    struct RenderTargetUsage {
+        rhi::ResourceState state;
+        rhi::ResourceAccess access;
+        rhi::PipelineStage stages;
+        bool is_write;
+    };
+
+    static const RenderTargetUsage COLOR_ATTACHMENT_USAGE{rhi::ResourceState::RenderTarget,
+                                                          rhi::ResourceAccess::ColorAttachmentWrite,
+                                                          rhi::PipelineStage::ColorAttachmentOutput,
+                                                          true};
+
+    static const RenderTargetUsage DEPTH_ATTACHMENT_USAGE{rhi::ResourceState::DepthWrite,
+                                                          rhi::ResourceAccess::DepthStencilAttachmentWrite,
+                                                          rhi::PipelineStage::EarlyFragmentTests | rhi::PipelineStage::LateFragmentTests,
+                                                          true};
+
+    /*!
+     * \brief How compute passes use their outputs
+     */
+    static const RenderTargetUsage STORAGE_IMAGE_USAGE{rhi::ResourceState::ShaderWrite,
+                                                       rhi::ResourceAccess::ShaderWrite,
+                                                       rhi::PipelineStage::ComputeShader,
+                                                       true};
+
+    /*!
+     * \brief How passes with an adaptive shading rate use the shading rate image
+     */
+    static const RenderTargetUsage SHADING_RATE_IMAGE_USAGE{rhi::ResourceState::ShadingRateSource,
+                                                            rhi::ResourceAccess::ShadingRateImageRead,
+                                                            rhi::PipelineStage::ShadingRateImage,
+                                                            false};
+
+    /*!
+     * \brief Every stage that some other render target might have been using an aliased render target's memory in
+     */
+    static const rhi::PipelineStage ALIASED_MEMORY_STAGES = rhi::PipelineStage::ColorAttachmentOutput |
+                                                            rhi::PipelineStage::LateFragmentTests | rhi::PipelineStage::FragmentShader;
+
+    /*!
+     * \brief The usage that matches the layout `DeviceResources::create_render_target` leaves render targets in
+     */
+    static const RenderTargetUsage& get_resting_usage(const rhi::RhiImage& image) {
+        return image.is_depth_tex ? DEPTH_ATTACHMENT_USAGE : COLOR_ATTACHMENT_USAGE;
+    }
+
+    static rhi::RhiResourceBarrier make_barrier(rhi::RhiImage* image,
+                                                const RenderTargetUsage& usage_before,
+                                                const RenderTargetUsage& usage_after) {
+        rhi::RhiResourceBarrier barrier{};
+        barrier.resource_to_barrier = image;
+        barrier.old_state = usage_before.state;
+        barrier.new_state = usage_after.state;
+        barrier.access_before_barrier = usage_before.access;
+        barrier.access_after_barrier = usage_after.access;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.image_memory_barrier.aspect = image->is_depth_tex ? rhi::ImageAspect::Depth : rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    static void add_barrier(BarrierBatch& batch,
+                            rhi::RhiImage* image,
+                            const RenderTargetUsage& usage_before,
+                            const rhi::PipelineStage stages_before,
+                            const RenderTargetUsage& usage_after) {
+        batch.barriers.push_back(make_barrier(image, usage_before, usage_after));
+        batch.stages_before_barrier = batch.stages_before_barrier | stages_before;
+        batch.stages_after_barrier = batch.stages_after_barrier | usage_after.stages;
+    }
+
+    /*!
+     * \brief Moves a render target from one queue to another
+     *
+     * Vulkan wants the same barrier on both queues: the release on the queue that used the render target last, and the acquire on the
+     * queue that uses it next. The semaphore between the two submissions does the actual synchronization, so each half only waits on
+     * its own side
+     */
+    static void add_ownership_transfer(BarrierBatch& release_batch,
+                                       BarrierBatch& acquire_batch,
+                                       rhi::RhiImage* image,
+                                       const RenderTargetUsage& usage_before,
+                                       const rhi::QueueType queue_before,
+                                       const RenderTargetUsage& usage_after,
+                                       const rhi::QueueType queue_after) {
+        auto barrier = make_barrier(image, usage_before, usage_after);
+        barrier.source_queue = queue_before;
+        barrier.destination_queue = queue_after;
+
+        release_batch.barriers.push_back(barrier);
+        release_batch.stages_before_barrier = release_batch.stages_before_barrier | usage_before.stages;
+        release_batch.stages_after_barrier = release_batch.stages_after_barrier | rhi::PipelineStage::BottomOfPipe;
+
+        acquire_batch.barriers.push_back(barrier);
+        acquire_batch.stages_before_barrier = acquire_batch.stages_before_barrier | rhi::PipelineStage::TopOfPipe;
+        acquire_batch.stages_after_barrier = acquire_batch.stages_after_barrier | usage_after.stages;
+    }
+
+    void Rendergraph::compile(DeviceResources& resource_storage) {
+        ZoneScoped;
+        if(!barriers_dirty) {
+            return;
+        }
+
+        if(!compile_passes(resource_storage, true)) {
+            // Passes with input attachments can't read them anymore, but everything else still renders
+            rg_log->error("Could not create the merged renderpasses, so every pass gets a renderpass of its own");
+            compile_passes(resource_storage, false);
+        }
+
+        barriers_dirty = false;
+    }
+
+    bool Rendergraph::compile_passes(DeviceResources& resource_storage, const bool merge_passes) {
+        ZoneScoped;
+        struct TrackedRenderTarget {
+            rhi::RhiImage* image;
+
+            /*!
+             * \brief The most recent usage of the render target. If it was read by several passes in a row, the stages of all of them
+             */
+            RenderTargetUsage last_usage;
+
+            bool is_aliased = false;
+
+            bool used_this_frame = false;
+
+            /*!
+             * \brief The queue that currently owns the render target
+             */
+            rhi::QueueType queue = rhi::QueueType::Graphics;
+
+            /*!
+             * \brief The most recent pass to use the render target this frame, and the index of the submission it's in
+             */
+            Renderpass* last_pass = nullptr;
+            uint32_t last_submission = 0;
+        };
+
+        /*!
+         * \brief Graphics passes that run one after another in the same submission, and that may share a merged renderpass
+         */
+        struct SubpassChain {
+            std::vector<Renderpass*> passes;
+
+            uint32_t submission_idx = 0;
+
+            /*!
+             * \brief The color attachments of all the passes, in the order they first show up. The merged renderpass's attachments are in
+             * the same order
+             */
+            std::vector<std::string> color_attachments;
+
+            std::optional<std::string> depth_attachment;
+
+            /*!
+             * \brief How many of the passes use each render target, as an attachment or otherwise
+             */
+            std::unordered_map<std::string, uint32_t> num_users;
+
+            [[nodiscard]] bool is_attachment(const std::string& name) const {
+                return std::find(color_attachments.begin(), color_attachments.end(), name) != color_attachments.end() ||
+                       depth_attachment == name;
+            }
+        };
+
+        std::unordered_map<std::string, TrackedRenderTarget> render_targets;
+
+        // How many passes use each render target this frame
+        std::unordered_map<std::string, uint32_t> num_users;
+
+        std::vector<SubpassChain> chains;
+        std::optional<size_t> open_chain;
+
+        submissions.clear();
+
+        for(Renderpass* renderpass : renderpasses) {
+            if(renderpass != nullptr) {
+                renderpass->merged_subpass.reset();
+            }
+        }
+
+        // The framebuffers point at the render targets, which may have been recreated since last time
+        for(MergedRenderpass& merged : merged_renderpasses) {
+            if(merged.framebuffer != nullptr) {
+                device.destroy_framebuffer(merged.framebuffer);
+                merged.framebuffer = nullptr;
+            }
+            merged.is_used = false;
+        }
+
+        // The submissions that each queue is currently adding passes to
+        std::optional<uint32_t> open_graphics_submission;
+        std::optional<uint32_t> open_compute_submission;
+
+        // Render targets start the frame owned by the graphics queue, so a compute pass that's the first to use one this frame has to
+        // wait for a graphics submission to release it
+        Renderpass* first_graphics_pass = nullptr;
+        std::optional<uint32_t> first_graphics_submission;
+
+        const auto& execution_order = calculate_renderpass_execution_order();
+
+        // The frame can't be presented until the graphics queue has waited on every compute pass, so compute passes after the last
+        // graphics pass wouldn't overlap with anything
+        const auto last_graphics_pass_itr = std::find_if(execution_order.rbegin(), execution_order.rend(), [](const Renderpass* pass) {
+            return pass->queue == rhi::QueueType::Graphics;
+        });
+        const auto num_passes_with_async_compute = static_cast<size_t>(std::distance(last_graphics_pass_itr, execution_order.rend()));
+
+        for(size_t pass_idx = 0; pass_idx < execution_order.size(); pass_idx++) {
+            auto* renderpass = execution_order[pass_idx];
+            const auto& create_info = renderpass_metadatas[renderpass->id].data;
+
+            renderpass->pre_pass_barriers = {};
+            renderpass->post_pass_barriers = {};
+
+            // The backbuffer is a different image every frame, so renderpasses handle it themselves
+            std::vector<std::pair<std::string, RenderTargetUsage>> usages;
+            const auto& output_usage = create_info.is_compute_pass() ? STORAGE_IMAGE_USAGE : COLOR_ATTACHMENT_USAGE;
+            for(const TextureAttachmentInfo& output : create_info.texture_outputs) {
+                if(output.name != BACKBUFFER_NAME) {
+                    usages.emplace_back(output.name, output_usage);
+                }
+            }
+
+            if(create_info.depth_texture) {
+                usages.emplace_back(create_info.depth_texture->name, DEPTH_ATTACHMENT_USAGE);
+            }
+
+            for(const std::string& input : create_info.texture_inputs) {
+                const auto is_attachment = std::any_of(usages.begin(), usages.end(), [&](const auto& attachment_usage) {
+                    return attachment_usage.first == input;
+                });
+                if(!is_attachment) {
+                    usages.emplace_back(input,
+                                        RenderTargetUsage{rhi::ResourceState::ShaderRead,
+                                                          rhi::ResourceAccess::ShaderRead,
+                                                          renderpass->texture_read_stages,
+                                                          false});
+                }
+            }
+
+            if(create_info.uses_adaptive_shading_rate) {
+                usages.emplace_back(SHADING_RATE_RT_NAME, SHADING_RATE_IMAGE_USAGE);
+            }
+
+            std::vector<std::tuple<const std::string*, TrackedRenderTarget*, RenderTargetUsage>> tracked_usages;
+            tracked_usages.reserve(usages.size());
+            for(const auto& [name, usage] : usages) {
+                auto tracked_itr = render_targets.find(name);
+                if(tracked_itr == render_targets.end()) {
+                    const auto render_target = resource_storage.get_render_target(name);
+                    if(!render_target) {
+                        // Regular textures never leave the ShaderRead layout
+                        continue;
+                    }
+
+                    auto* image = (*render_target)->image;
+                    const auto is_aliased = aliased_textures.find(name) != aliased_textures.end();
+                    tracked_itr = render_targets.emplace(name, TrackedRenderTarget{image, get_resting_usage(*image), is_aliased}).first;
+                }
+
+                tracked_usages.emplace_back(&tracked_itr->first, &tracked_itr->second, usage);
+                num_users[name]++;
+            }
+
+            auto queue = pass_idx < num_passes_with_async_compute ? renderpass->queue : rhi::QueueType::Graphics;
+            if(queue == rhi::QueueType::AsyncCompute) {
+                for(const auto& [name, tracked, usage] : tracked_usages) {
+                    if(tracked->is_aliased || (!tracked->used_this_frame && first_graphics_pass == nullptr)) {
+                        // Aliased memory and render targets that nothing has released yet are the graphics queue's problem
+                        queue = rhi::QueueType::Graphics;
+                        break;
+                    }
+                }
+            }
+
+            // Every submission on the other queue that last used one of this pass's render targets
+            std::vector<uint32_t> submissions_to_wait_for;
+            for(const auto& [name, tracked, usage] : tracked_usages) {
+                if(tracked->queue != queue) {
+                    submissions_to_wait_for.push_back(tracked->used_this_frame ? tracked->last_submission : *first_graphics_submission);
+                }
+            }
+
+            auto& open_submission = queue == rhi::QueueType::AsyncCompute ? open_compute_submission : open_graphics_submission;
+            auto& other_open_submission = queue == rhi::QueueType::AsyncCompute ? open_graphics_submission : open_compute_submission;
+
+            // Submissions go to the GPU in order, so a submission can only wait on the ones before it
+            const auto can_use_open_submission = open_submission &&
+                                                 std::all_of(submissions_to_wait_for.begin(),
+                                                             submissions_to_wait_for.end(),
+                                                             [&](const uint32_t idx) { return idx < *open_submission; });
+            if(!can_use_open_submission) {
+                open_submission = static_cast<uint32_t>(submissions.size());
+                submissions.push_back(RendergraphSubmission{queue});
+
+                // Graphics passes after this one may depend on it, and they can't wait on a submission that comes after theirs
+                if(queue == rhi::QueueType::AsyncCompute) {
+                    open_graphics_submission.reset();
+                }
+            }
+
+            const auto submission_idx = *open_submission;
+            auto& submission = submissions[submission_idx];
+            submission.passes.push_back(renderpass);
+
+            for(const uint32_t idx : submissions_to_wait_for) {
+                if(std::find(submission.submissions_to_wait_for.begin(), submission.submissions_to_wait_for.end(), idx) ==
+                   submission.submissions_to_wait_for.end()) {
+                    submission.submissions_to_wait_for.push_back(idx);
+                }
+
+                // The semaphore only signals when the whole submission is done, so anything else we added to it would delay this pass
+                if(other_open_submission == idx) {
+                    other_open_submission.reset();
+                }
+            }
+
+            if(queue == rhi::QueueType::Graphics && first_graphics_pass == nullptr) {
+                first_graphics_pass = renderpass;
+                first_graphics_submission = submission_idx;
+            }
+
+            // Multisampled passes resolve their attachments at the end of their own renderpass, which merged renderpasses don't do
+            const auto can_be_subpass = merge_passes && queue == rhi::QueueType::Graphics && renderpass->renderpass != nullptr &&
+                                        renderpass->framebuffer != nullptr && !renderpass->writes_to_backbuffer &&
+                                        renderpass->can_merge_into_subpass && !create_info.is_multisampled();
+
+            const auto writes_to = [&](const std::string& name) {
+                return std::any_of(create_info.texture_outputs.begin(),
+                                   create_info.texture_outputs.end(),
+                                   [&](const TextureAttachmentInfo& output) { return output.name == name; }) ||
+                       (create_info.depth_texture && create_info.depth_texture->name == name);
+            };
+
+            const auto can_join_chain = [&](const SubpassChain& chain) {
+                const auto* last_pass = chain.passes.back();
+                const auto follows_chain = chain.submission_idx == submission_idx && submission.passes.size() > 1 &&
+                                           submission.passes[submission.passes.size() - 2] == last_pass;
+                if(!follows_chain || last_pass->framebuffer->size != renderpass->framebuffer->size ||
+                   last_pass->uses_dynamic_resolution != renderpass->uses_dynamic_resolution) {
+                    return false;
+                }
+
+                if(create_info.depth_texture && chain.depth_attachment && *chain.depth_attachment != create_info.depth_texture->name) {
+                    return false;
+                }
+
+                // The subpass dependencies only cover input attachments, so the pass can't sample anything that the chain renders to
+                bool reads_from_chain = false;
+                for(const std::string& input : create_info.texture_inputs) {
+                    const auto is_input_attachment = std::find(create_info.input_attachments.begin(),
+                                                               create_info.input_attachments.end(),
+                                                               input) != create_info.input_attachments.end();
+                    if(is_input_attachment) {
+                        if(writes_to(input) || std::find(chain.color_attachments.begin(), chain.color_attachments.end(), input) ==
+                                                   chain.color_attachments.end()) {
+                            return false;
+                        }
+                        reads_from_chain = true;
+
+                    } else if(!writes_to(input) && chain.is_attachment(input)) {
+                        return false;
+                    }
+                }
+
+                // New attachments get their barriers before the merged renderpass begins, so the chain can't have used them yet. Aliased
+                // render targets share their memory with render targets that the chain may still store to
+                bool shares_attachments = false;
+                const auto can_add_attachment = [&](const std::string& name) {
+                    if(chain.is_attachment(name)) {
+                        shares_attachments = true;
+                        return true;
+                    }
+
+                    return chain.num_users.find(name) == chain.num_users.end() && aliased_textures.find(name) == aliased_textures.end();
+                };
+
+                for(const TextureAttachmentInfo& output : create_info.texture_outputs) {
+                    if(!can_add_attachment(output.name)) {
+                        return false;
+                    }
+                }
+                if(create_info.depth_texture && !can_add_attachment(create_info.depth_texture->name)) {
+                    return false;
+                }
+
+                // Ownership transfers can't happen inside of a renderpass
+                const auto needs_ownership_transfer = std::any_of(tracked_usages.begin(),
+                                                                  tracked_usages.end(),
+                                                                  [&](const auto& tracked_usage) {
+                                                                      return std::get<1>(tracked_usage)->queue != queue;
+                                                                  });
+
+                return !needs_ownership_transfer && (reads_from_chain || shares_attachments);
+            };
+
+            SubpassChain* joined_chain = nullptr;
+            if(can_be_subpass && open_chain && can_join_chain(chains[*open_chain])) {
+                joined_chain = &chains[*open_chain];
+
+            } else if(can_be_subpass) {
+                open_chain = chains.size();
+                chains.push_back(SubpassChain{{}, submission_idx});
+
+            } else {
+                open_chain.reset();
+            }
+
+            if(joined_chain == nullptr && !create_info.input_attachments.empty()) {
+                rg_log->error("Pass %s can't be merged with the passes that write its input attachments, so it can't read them",
+                              create_info.name);
+            }
+
+            // Nothing can be recorded between two subpasses, so the barriers of merged passes go before the merged renderpass begins
+            auto& pre_pass_barriers = joined_chain != nullptr ? joined_chain->passes.front()->pre_pass_barriers :
+                                                                renderpass->pre_pass_barriers;
+
+            for(auto& [name, tracked, usage] : tracked_usages) {
+                if(tracked->queue != queue) {
+                    auto& release_batch = tracked->used_this_frame ? tracked->last_pass->post_pass_barriers :
+                                                                     first_graphics_pass->pre_pass_barriers;
+                    add_ownership_transfer(release_batch,
+                                           renderpass->pre_pass_barriers,
+                                           tracked->image,
+                                           tracked->last_usage,
+                                           tracked->queue,
+                                           usage,
+                                           queue);
+                    tracked->last_usage = usage;
+
+                } else if(joined_chain != nullptr && joined_chain->is_attachment(*name)) {
+                    // The merged renderpass's subpass dependencies take care of these. It stays an attachment until the renderpass ends
+                    tracked->last_usage.stages = tracked->last_usage.stages | usage.stages;
+
+                } else if(!tracked->used_this_frame && tracked->is_aliased) {
+                    // Some other render target had this memory last, so there's nothing here worth keeping
+                    const RenderTargetUsage discarded{rhi::ResourceState::Undefined,
+                                                      rhi::ResourceAccess::MemoryWrite,
+                                                      ALIASED_MEMORY_STAGES,
+                                                      true};
+                    add_barrier(pre_pass_barriers, tracked->image, discarded, ALIASED_MEMORY_STAGES, usage);
+                    tracked->last_usage = usage;
+
+                } else if(tracked->last_usage.state != usage.state || tracked->last_usage.is_write || usage.is_write) {
+                    add_barrier(pre_pass_barriers, tracked->image, tracked->last_usage, tracked->last_usage.stages, usage);
+                    tracked->last_usage = usage;
+
+                } else {
+                    // Reading after a read in the same layout needs no barrier, but the next write has to wait for both reads
+                    tracked->last_usage.stages = tracked->last_usage.stages | usage.stages;
+                }
+
+                tracked->used_this_frame = true;
+                tracked->queue = queue;
+                tracked->last_pass = renderpass;
+                tracked->last_submission = submission_idx;
+            }
+
+            if(can_be_subpass) {
+                auto& chain = chains[*open_chain];
+                chain.passes.push_back(renderpass);
+
+                for(const TextureAttachmentInfo& output : create_info.texture_outputs) {
+                    if(!chain.is_attachment(output.name)) {
+                        chain.color_attachments.push_back(output.name);
+                    }
+                }
+                if(create_info.depth_texture && !chain.depth_attachment) {
+                    chain.depth_attachment = create_info.depth_texture->name;
+                }
+
+                for(const auto& [name, tracked, usage] : tracked_usages) {
+                    chain.num_users[*name]++;
+                }
+            }
+        }
+
+        // Leave everything how the first passes of the next frame expect to find it. The last pass is always on the graphics queue
+        if(!execution_order.empty()) {
+            auto& end_of_frame_barriers = execution_order.back()->post_pass_barriers;
+
+            for(const auto& [name, tracked] : render_targets) {
+                if(tracked.is_aliased) {
+                    // The next frame throws their contents away anyway
+                    continue;
+                }
+
+                const auto& resting_usage = get_resting_usage(*tracked.image);
+                if(tracked.queue != rhi::QueueType::Graphics) {
+                    add_ownership_transfer(tracked.last_pass->post_pass_barriers,
+                                           end_of_frame_barriers,
+                                           tracked.image,
+                                           tracked.last_usage,
+                                           tracked.queue,
+                                           resting_usage,
+                                           rhi::QueueType::Graphics);
+
+                } else if(tracked.last_usage.state != resting_usage.state) {
+                    add_barrier(end_of_frame_barriers, tracked.image, tracked.last_usage, tracked.last_usage.stages, resting_usage);
+                }
+            }
+
+            // The last submission signals the frame's fence, so it has to wait for any compute work that nothing else waited for
+            auto& last_submission = submissions.back();
+            for(uint32_t idx = 0; idx < submissions.size() - 1; idx++) {
+                if(submissions[idx].queue != rhi::QueueType::AsyncCompute) {
+                    continue;
+                }
+
+                const auto is_waited_for = std::any_of(submissions.begin(), submissions.end(), [&](const RendergraphSubmission& other) {
+                    return std::find(other.submissions_to_wait_for.begin(), other.submissions_to_wait_for.end(), idx) !=
+                           other.submissions_to_wait_for.end();
+                });
+                if(!is_waited_for) {
+                    last_submission.submissions_to_wait_for.push_back(idx);
+                }
+            }
+        }
+
+        for(const SubpassChain& chain : chains) {
+            if(chain.passes.size() < 2) {
+                continue;
+            }
+
+            std::vector<RenderPassCreateInfo> subpass_infos;
+            std::vector<std::string> pass_names;
+            subpass_infos.reserve(chain.passes.size());
+            pass_names.reserve(chain.passes.size());
+            for(const Renderpass* pass : chain.passes) {
+                subpass_infos.push_back(renderpass_metadatas[pass->id].data);
+                pass_names.push_back(pass->name);
+            }
+
+            std::vector<std::string> attachment_names = chain.color_attachments;
+            if(chain.depth_attachment) {
+                attachment_names.push_back(*chain.depth_attachment);
+            }
+
+            // Attachments that nothing else uses don't need their contents once the renderpass is done, as long as nothing needs what
+            // was there before it either
+            std::unordered_set<std::string> transient_attachments;
+            for(const std::string& name : attachment_names) {
+                if(chain.num_users.at(name) != num_users.at(name)) {
+                    continue;
+                }
+
+                const auto& first_writer = *std::find_if(subpass_infos.begin(), subpass_infos.end(), [&](const RenderPassCreateInfo& info) {
+                    return std::any_of(info.texture_outputs.begin(),
+                                       info.texture_outputs.end(),
+                                       [&](const TextureAttachmentInfo& output) { return output.name == name; }) ||
+                           (info.depth_texture && info.depth_texture->name == name);
+                });
+                const auto& first_write = first_writer.depth_texture && first_writer.depth_texture->name == name ?
+                                              *first_writer.depth_texture :
+                                              *std::find_if(first_writer.texture_outputs.begin(),
+                                                            first_writer.texture_outputs.end(),
+                                                            [&](const TextureAttachmentInfo& output) { return output.name == name; });
+                if(first_write.clear || aliased_textures.find(name) != aliased_textures.end()) {
+                    transient_attachments.insert(name);
+                }
+            }
+
+            const auto framebuffer_size = chain.passes.front()->framebuffer->size;
+
+            // Reusing the renderpass from last time keeps the pipelines that were compiled for it
+            auto merged_itr = std::find_if(merged_renderpasses.begin(), merged_renderpasses.end(), [&](const MergedRenderpass& merged) {
+                return !merged.is_used && merged.pass_names == pass_names && merged.transient_attachments == transient_attachments;
+            });
+            if(merged_itr == merged_renderpasses.end()) {
+                const auto renderpass_result = device.create_merged_renderpass(subpass_infos, transient_attachments, framebuffer_size);
+                if(!renderpass_result) {
+                    rg_log->error("Could not merge pass %s with the passes after it: %s",
+                                  pass_names.front(),
+                                  renderpass_result.error.to_string());
+                    return false;
+                }
+
+                merged_renderpasses.push_back(MergedRenderpass{pass_names, transient_attachments, renderpass_result.value});
+                merged_itr = std::prev(merged_renderpasses.end());
+            }
+            merged_itr->is_used = true;
+
+            std::vector<rhi::RhiImage*> color_attachments;
+            color_attachments.reserve(chain.color_attachments.size());
+            for(const std::string& name : chain.color_attachments) {
+                color_attachments.push_back(render_targets.at(name).image);
+            }
+
+            std::optional<rhi::RhiImage*> depth_attachment;
+            if(chain.depth_attachment) {
+                depth_attachment = render_targets.at(*chain.depth_attachment).image;
+            }
+
+            merged_itr->framebuffer = device.create_framebuffer(merged_itr->renderpass,
+                                                                color_attachments,
+                                                                depth_attachment,
+                                                                std::nullopt,
+                                                                framebuffer_size);
+            if(merged_itr->framebuffer == nullptr) {
+                rg_log->error("Could not create the framebuffer for the merged renderpass of pass %s", pass_names.front());
+                return false;
+            }
+
+            auto* last_pass = chain.passes.back();
+            for(uint32_t subpass_idx = 0; subpass_idx < chain.passes.size(); subpass_idx++) {
+                auto* pass = chain.passes[subpass_idx];
+                pass->merged_subpass = MergedSubpass{merged_itr->renderpass, merged_itr->framebuffer, subpass_idx, pass == last_pass};
+
+                // Barriers after the earlier subpasses have to wait until the merged renderpass is over
+                if(pass != last_pass) {
+                    auto& end_of_renderpass_barriers = last_pass->post_pass_barriers;
+                    end_of_renderpass_barriers.barriers.insert(end_of_renderpass_barriers.barriers.end(),
+                                                               pass->post_pass_barriers.barriers.begin(),
+                                                               pass->post_pass_barriers.barriers.end());
+                    end_of_renderpass_barriers.stages_before_barrier = end_of_renderpass_barriers.stages_before_barrier |
+                                                                       pass->post_pass_barriers.stages_before_barrier;
+                    end_of_renderpass_barriers.stages_after_barrier = end_of_renderpass_barriers.stages_after_barrier |
+                                                                      pass->post_pass_barriers.stages_after_barrier;
+                    pass->post_pass_barriers = {};
+                }
+            }
+        }
+
+        // These passes aren't merged anymore. Nothing can be using them, since the renderpasses only change while the GPU is idle
+        std::erase_if(merged_renderpasses, [&](const MergedRenderpass& merged) {
+            if(merged.is_used) {
+                return false;
+            }
+
+            device.destroy_renderpass(merged.renderpass);
+            return true;
+        });
+
+        return true;
+    }
+
+    void Rendergraph::destroy_merged_renderpass(const std::string& pass_name) {
+        std::erase_if(merged_renderpasses, [&](const MergedRenderpass& merged) {
+            if(std::find(merged.pass_names.begin(), merged.pass_names.end(), pass_name) == merged.pass_names.end()) {
+                return false;
+            }
+
+            // The other passes go back to their own renderpasses until the next `compile`
+            for(const std::string& name : merged.pass_names) {
+                if(auto* pass = get_renderpass(name); pass != nullptr) {
+                    pass->merged_subpass.reset();
+                }
+            }
+
+            if(merged.framebuffer != nullptr) {
+                device.destroy_framebuffer(merged.framebuffer);
+            }
+            device.destroy_renderpass(merged.renderpass);
+            return true;
+        });
+    }
+
+    const std::vector<RendergraphSubmission>& Rendergraph::get_submissions() const { return submissions; }
+
     Renderpass* Rendergraph::get_renderpass(const std::string& name) const {
-        if(Renderpass* const* renderpass = renderpasses.find(name)) {
-            return *renderpass;
+        if(const auto handle_itr = handles_by_name.find(name); handle_itr != handles_by_name.end()) {
+            return renderpasses[handle_itr->second];
         }
 
         return nullptr;
     }
 
     std::optional<RenderpassMetadata> Rendergraph::get_metadata_for_renderpass(const std::string& name) const {
-        if(const auto* metadata = renderpass_metadatas.find(name)) {
-            return *metadata;
+        if(const auto handle_itr = handles_by_name.find(name); handle_itr != handles_by_name.end()) {
+            return renderpass_metadatas[handle_itr->second];
         }
 
         return rx::nullopt;
     }
 
     rhi::RhiFramebuffer* Renderpass::get_framebuffer(const FrameContext& ctx) const {
-        if(!writes_to_backbuffer) {
+        if(merged_subpass) {
+            return merged_subpass->framebuffer;
+
+        } else if(!writes_to_backbuffer) {
             return framebuffer;
         } else {
             return ctx.swapchain_framebuffer;
         }
     }
 
+    rhi::RhiRenderpass* Renderpass::get_renderpass() const { return merged_subpass ? merged_subpass->renderpass : renderpass; }
+
+    uint32_t Renderpass::get_subpass_index() const { return merged_subpass ? merged_subpass->index : 0; }
+
     void Renderpass::setup_renderpass(rhi::RhiRenderCommandList& /* cmds */, FrameContext& /* ctx */) {}
 
     void renderer::MaterialPass::record(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
         ZoneScoped;
-        cmds.bind_descriptor_sets(descriptor_sets, pipeline_interface);
+        const GpuProfileScope gpu_scope{ctx.gpu_profiler, cmds, 1, name.material_name, name.pass_name};
+
+        rhi::get_draw_command_list(cmds).bind_descriptor_sets(descriptor_sets, pipeline_interface);
 
-        static_mesh_draws.each_fwd(
-            [&](const MeshBatch<StaticMeshRenderCommand>& batch) { record_rendering_static_mesh_batch(batch, cmds, ctx); });
+        record_static_mesh_draws(cmds, ctx);
 
         static_procedural_mesh_draws.each_fwd(
-            [&](const ProceduralMeshBatch<StaticMeshRenderCommand>& batch) { record_rendering_static_mesh_batch(batch, cmds, ctx); });
+            [&](const ProceduralMeshBatch& batch) { record_rendering_static_mesh_batch(batch, cmds, ctx); });
+
+        record_skinned_mesh_draws(cmds, ctx);
+
+        if(ctx.particles != nullptr) {
+            ctx.particles->record_draws(name, cmds);
+        }
     }
 
-    void renderer::MaterialPass::record_rendering_static_mesh_batch(const MeshBatch<StaticMeshRenderCommand>& batch,
-                                                                    rhi::RhiRenderCommandList& cmds,
-                                                                    FrameContext& ctx) {
-        ZoneScoped;        const uint64_t start_index = ctx.cur_model_matrix_index;
+    void renderer::MaterialPass::record_depth_prepass(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
+        ZoneScoped;
+        rhi::get_draw_command_list(cmds).bind_descriptor_sets(descriptor_sets, pipeline_interface);
 
-        auto model_matrix_buffer = ctx.nova->get_resource_manager().get_uniform_buffer(MODEL_MATRIX_BUFFER_NAME);
+        record_static_mesh_draws(cmds, ctx);
 
-        batch.commands.each_fwd([&](const StaticMeshRenderCommand& command) {
-            if(command.is_visible) {
-                /* ctx.nova->get_device().write_data_to_buffer(&command.model_matrix,
-                                                             sizeof(glm::mat4),
-                                                             ctx.cur_model_matrix_index * sizeof(glm::mat4),
-                                                             (*model_matrix_buffer)->buffer);*/
-                ctx.cur_model_matrix_index++;
-            }
-        });
+        static_procedural_mesh_draws.each_fwd(
+            [&](const ProceduralMeshBatch& batch) { record_rendering_static_mesh_batch(batch, cmds, ctx); });
 
-        if(start_index != ctx.cur_model_matrix_index) {
-            // TODO: There's probably a better way to do this
-            std::vector<rhi::RhiBuffer*> vertex_buffers{ctx.allocator};
-            vertex_buffers.reserve(batch.num_vertex_attributes);
-            for(uint32_t i = 0; i < batch.num_vertex_attributes; i++) {
-                vertex_buffers.push_back(batch.vertex_buffer);
+        record_skinned_mesh_draws(cmds, ctx);
+    }
+
+    void renderer::MaterialPass::record_static_mesh_draws(rhi::RhiRenderCommandList& rhi_cmds, FrameContext& ctx) const {
+        ZoneScoped;
+        auto& cmds = rhi::get_draw_command_list(rhi_cmds);
+        const rhi::RhiBuffer* bound_vertex_buffer = nullptr;
+        const rhi::RhiBuffer* bound_index_buffer = nullptr;
+        auto bound_index_type = rhi::IndexType::Uint32;
+
+        for(const MeshDrawRange& range : static_mesh_draw_ranges) {
+            if(range.vertex_buffer != bound_vertex_buffer || range.index_buffer != bound_index_buffer ||
+               range.index_type != bound_index_type) {
+                // Pipelines that pull their own vertices have no vertex input bindings to bind anything to
+                if(!pulls_vertices) {
+                    // TODO: There's probably a better way to do this
+                    std::vector<rhi::RhiBuffer*> vertex_buffers;
+                    vertex_buffers.reserve(range.num_vertex_attributes);
+                    for(uint32_t i = 0; i < range.num_vertex_attributes; i++) {
+                        vertex_buffers.push_back(range.vertex_buffer);
+                    }
+                    cmds.bind_vertex_buffers(vertex_buffers);
+                }
+                cmds.bind_index_buffer(range.index_buffer, range.index_type);
+
+                bound_vertex_buffer = range.vertex_buffer;
+                bound_index_buffer = range.index_buffer;
+                bound_index_type = range.index_type;
             }
-            cmds.bind_vertex_buffers(vertex_buffers);
-            cmds.bind_index_buffer(batch.index_buffer, rhi::IndexType::Uint32);
 
-            cmds.draw_indexed_mesh(batch.num_indices);
+            const auto offset = range.first_draw_command_idx * sizeof(rhi::RhiDrawIndexedIndirectCommand);
+            if(ctx.draw_counts_buffer != nullptr) {
+                cmds.draw_indexed_indirect(ctx.draw_commands_buffer,
+                                           offset,
+                                           range.num_draw_commands,
+                                           ctx.draw_counts_buffer,
+                                           range.draw_count_idx * sizeof(uint32_t));
+
+            } else {
+                cmds.draw_indexed_indirect(ctx.draw_commands_buffer, offset, range.num_draw_commands);
+            }
         }
     }
 
-    void renderer::MaterialPass::record_rendering_static_mesh_batch(const ProceduralMeshBatch<StaticMeshRenderCommand>& batch,
-                                                                    rhi::RhiRenderCommandList& cmds,
+    void renderer::MaterialPass::record_rendering_static_mesh_batch(const ProceduralMeshBatch& batch,
+                                                                    rhi::RhiRenderCommandList& rhi_cmds,
                                                                     FrameContext& ctx) {
-        ZoneScoped;        const uint64_t start_index = ctx.cur_model_matrix_index;
+        ZoneScoped;
+        if(!batch.draw_command_idx) {
+            return;
+        }
+
+        auto& cmds = rhi::get_draw_command_list(rhi_cmds);
+
+        const auto& [vertex_buffer, index_buffer] = batch.mesh->get_buffers_for_frame(ctx.frame_idx);
+        // TODO: There's probably a better way to do this
+        std::vector<rhi::RhiBuffer*> vertex_buffers;
+        vertex_buffers.reserve(7);
+        for(uint32_t i = 0; i < 7; i++) {
+            vertex_buffers.push_back(vertex_buffer);
+        }
+        cmds.bind_vertex_buffers(vertex_buffers);
+        cmds.bind_index_buffer(index_buffer, rhi::IndexType::Uint32);
+
+        cmds.draw_indexed_indirect(ctx.draw_commands_buffer, *batch.draw_command_idx * sizeof(rhi::RhiDrawIndexedIndirectCommand), 1);
+    }
 
-        auto model_matrix_buffer = ctx.nova->get_resource_manager().get_uniform_buffer(MODEL_MATRIX_BUFFER_NAME);
+    void renderer::MaterialPass::record_skinned_mesh_draws(rhi::RhiRenderCommandList& rhi_cmds, FrameContext& ctx) const {
+        ZoneScoped;
+        if(ctx.skinning == nullptr) {
+            return;
+        }
 
-        batch.commands.each_fwd([&](const StaticMeshRenderCommand& command) {
-            if(command.is_visible) {
-                /*ctx.nova->get_device().write_data_to_buffer(&command.model_matrix,
-                                                            sizeof(glm::mat4),
-                                                            ctx.cur_model_matrix_index * sizeof(glm::mat4),
-                                                            (*model_matrix_buffer)->buffer);*/
-                ctx.cur_model_matrix_index++;
+        auto& cmds = rhi::get_draw_command_list(rhi_cmds);
+        bool are_buffers_bound = false;
+        for(const SkinnedMeshBatch& batch : skinned_mesh_draws) {
+            if(!batch.draw_command_idx) {
+                continue;
             }
-        });
 
-        if(start_index != ctx.cur_model_matrix_index) {
-            const auto& [vertex_buffer, index_buffer] = batch.mesh->get_buffers_for_frame(ctx.frame_idx);
-            // TODO: There's probably a better way to do this
-            std::vector<rhi::RhiBuffer*> vertex_buffers;
-            vertex_buffers.reserve(7);
-            for(uint32_t i = 0; i < 7; i++) {
-                vertex_buffers.push_back(vertex_buffer);
+            // Every skinned renderable's vertices are in the same buffer, so they're only bound once
+            if(!are_buffers_bound) {
+                const std::vector<rhi::RhiBuffer*> vertex_buffers(7, ctx.skinning->get_output_buffer(ctx.frame_idx));
+                cmds.bind_vertex_buffers(vertex_buffers);
+                cmds.bind_index_buffer(ctx.skinning->get_index_buffer(), rhi::IndexType::Uint32);
+                are_buffers_bound = true;
             }
-            cmds.bind_vertex_buffers(vertex_buffers);
-            cmds.bind_index_buffer(index_buffer, rhi::IndexType::Uint32);
+
+            cmds.draw_indexed_indirect(ctx.draw_commands_buffer,
+                                       *batch.draw_command_idx * sizeof(rhi::RhiDrawIndexedIndirectCommand),
+                                       batch.num_draw_commands);
         }
     }
 
+    rhi::RhiPipeline& Pipeline::get_pipeline_for_pass(const MaterialPass& pass) const {
+        if(pass.pipeline_variant_idx && *pass.pipeline_variant_idx < variants.size()) {
+            if(const auto& variant = variants[*pass.pipeline_variant_idx]; variant.pipeline) {
+                return *variant.pipeline;
+            }
+        }
+
+        return *pipeline;
+    }
+
+    rhi::RhiPipeline& Pipeline::get_depth_prepass_pipeline_for_pass(const MaterialPass& pass) const {
+        if(pass.pipeline_variant_idx && *pass.pipeline_variant_idx < variants.size()) {
+            if(const auto& variant = variants[*pass.pipeline_variant_idx]; variant.pipeline && variant.depth_prepass_pipeline) {
+                return *variant.depth_prepass_pipeline;
+            }
+        }
+
+        return *depth_prepass_pipeline;
+    }
+
     void Pipeline::record(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
-        ZoneScoped;        cmds.set_pipeline(*pipeline);
+        ZoneScoped;
+        const auto& passes = ctx.nova->get_material_passes_for_pipeline(handle);
+        auto& draw_cmds = rhi::get_draw_command_list(cmds);
+
+        // Most passes use the default variant, so only switch pipelines when a pass wants a different one than the pass before it
+        const rhi::RhiPipeline* bound_pipeline = nullptr;
+        passes.each_fwd([&](const renderer::MaterialPass& pass) {
+            auto& pass_pipeline = get_pipeline_for_pass(pass);
+            if(&pass_pipeline != bound_pipeline) {
+                draw_cmds.set_pipeline(pass_pipeline);
+                bound_pipeline = &pass_pipeline;
+            }
+
+            pass.record(cmds, ctx);
+        });
+    }
+
+    void Pipeline::record_depth_prepass(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) const {
+        ZoneScoped;
+        const auto& passes = ctx.nova->get_material_passes_for_pipeline(handle);
+        auto& draw_cmds = rhi::get_draw_command_list(cmds);
 
-        const auto& passes = ctx.nova->get_material_passes_for_pipeline(pipeline->name);
+        const rhi::RhiPipeline* bound_pipeline = nullptr;
+        passes.each_fwd([&](const renderer::MaterialPass& pass) {
+            auto& pass_pipeline = get_depth_prepass_pipeline_for_pass(pass);
+            if(&pass_pipeline != bound_pipeline) {
+                draw_cmds.set_pipeline(pass_pipeline);
+                bound_pipeline = &pass_pipeline;
+            }
 
-        passes.each_fwd([&](const renderer::MaterialPass& pass) { pass.record(cmds, ctx); });
+            pass.record_depth_prepass(cmds, ctx);
+        });
     }
 } // namespace nova::renderer
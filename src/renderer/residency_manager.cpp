@@ -0,0 +1,113 @@
+#include "residency_manager.hpp"
+
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("ResidencyManager");
+
+    ResidencyManager::ResidencyManager(const uint32_t num_in_flight_frames, const float eviction_threshold, const float eviction_target)
+        : num_in_flight_frames{num_in_flight_frames},
+          eviction_threshold{eviction_threshold},
+          eviction_target{std::min(eviction_target, eviction_threshold)} {}
+
+    ResidencyManager::ResourceId ResidencyManager::add_resource(const uint64_t size, const float priority, std::function<void()> evict) {
+        const auto id = next_resource_id;
+        next_resource_id++;
+
+        resources.emplace(id, Resource{size, priority, frame_count, std::move(evict)});
+
+        return id;
+    }
+
+    void ResidencyManager::remove_resource(const ResourceId id) { resources.erase(id); }
+
+    void ResidencyManager::mark_used(const ResourceId id) {
+        if(const auto itr = resources.find(id); itr != resources.end()) {
+            itr->second.last_used_frame = frame_count;
+        }
+    }
+
+    bool ResidencyManager::is_empty() const { return resources.empty(); }
+
+    void ResidencyManager::begin_frame(const std::vector<rhi::RhiMemoryHeapBudget>& budgets) {
+        ZoneScoped;
+        frame_count++;
+
+        uint64_t usage = 0;
+        uint64_t budget = 0;
+        for(const rhi::RhiMemoryHeapBudget& heap : budgets) {
+            if(heap.is_device_local) {
+                usage += heap.usage;
+                budget += heap.budget;
+            }
+        }
+
+        TracyPlot("DeviceLocalUsage", static_cast<int64_t>(usage));
+        TracyPlot("DeviceLocalBudget", static_cast<int64_t>(budget));
+
+        if(frame_count < next_frame_to_check || resources.empty()) {
+            return;
+        }
+
+        if(static_cast<double>(usage) <= static_cast<double>(budget) * eviction_threshold) {
+            warned_about_budget = false;
+            return;
+        }
+
+        const auto target = static_cast<uint64_t>(static_cast<double>(budget) * eviction_target);
+        const auto bytes_to_evict = usage - std::min(usage, target);
+
+        candidates_scratch.clear();
+        for(const auto& [id, resource] : resources) {
+            if(frame_count - resource.last_used_frame >= num_in_flight_frames) {
+                candidates_scratch.emplace_back(id, &resource);
+            }
+        }
+
+        std::sort(candidates_scratch.begin(), candidates_scratch.end(), [](const auto& a, const auto& b) {
+            if(a.second->priority != b.second->priority) {
+                return a.second->priority < b.second->priority;
+            }
+            return a.second->last_used_frame < b.second->last_used_frame;
+        });
+
+        uint64_t bytes_evicted = 0;
+        size_t num_evicted = 0;
+        for(; num_evicted < candidates_scratch.size() && bytes_evicted < bytes_to_evict; num_evicted++) {
+            bytes_evicted += candidates_scratch[num_evicted].second->size;
+        }
+
+        // Evicting may free other resources, so take the resources out of the map before running any of their eviction functions
+        std::vector<std::function<void()>> evictions;
+        evictions.reserve(num_evicted);
+        for(size_t i = 0; i < num_evicted; i++) {
+            const auto itr = resources.find(candidates_scratch[i].first);
+            evictions.push_back(std::move(itr->second.evict));
+            resources.erase(itr);
+        }
+        candidates_scratch.clear();
+
+        for(const auto& evict : evictions) {
+            evict();
+        }
+
+        if(num_evicted > 0) {
+            logger->info("Device-local memory is at {} of {} bytes. Evicted {} resources to free {} bytes",
+                         usage,
+                         budget,
+                         num_evicted,
+                         bytes_evicted);
+            next_frame_to_check = frame_count + num_in_flight_frames + 1;
+        }
+
+        if(bytes_evicted < bytes_to_evict && !warned_about_budget) {
+            logger->warn("Device-local memory is at {} of {} bytes, and nothing else can be evicted", usage, budget);
+            warned_about_budget = true;
+        }
+    }
+} // namespace nova::renderer
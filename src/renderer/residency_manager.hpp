@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief Keeps Nova under the device's memory budget by evicting the streamed resources that went unused for the longest time
+     *
+     * Whoever streams a resource in registers it here, along with a function that evicts it, and marks it as used in every frame that
+     * needs it. When device-local memory gets close to the budget, the manager evicts the lowest-priority resources that no in-flight frame
+     * used, oldest first, until usage is back down to the eviction target. The owner of an evicted resource can stream it back in later
+     *
+     * This class is not thread-safe. Use it from the thread that calls `NovaRenderer::execute_frame`
+     */
+    class ResidencyManager {
+    public:
+        using ResourceId = uint64_t;
+
+        /*!
+         * \param num_in_flight_frames Resources that were used this many frames ago or later are never evicted
+         * \param eviction_threshold Fraction of the device-local budget that usage has to go over before anything is evicted
+         * \param eviction_target Fraction of the device-local budget to evict down to
+         */
+        ResidencyManager(uint32_t num_in_flight_frames, float eviction_threshold, float eviction_target);
+
+        /*!
+         * \brief Starts tracking a resource. It counts as used in the current frame
+         *
+         * \param size The number of bytes of device memory that evicting the resource gives back
+         * \param priority Resources with a lower priority are evicted first. Same range as `RhiBufferCreateInfo::residency_priority`
+         * \param evict Evicts the resource. The manager stops tracking the resource before calling this
+         */
+        [[nodiscard]] ResourceId add_resource(uint64_t size, float priority, std::function<void()> evict);
+
+        /*!
+         * \brief Stops tracking a resource without evicting it. Does nothing if the resource was already evicted
+         */
+        void remove_resource(ResourceId id);
+
+        /*!
+         * \brief Marks a resource as used in the current frame, so it won't be evicted until every frame that used it is done
+         */
+        void mark_used(ResourceId id);
+
+        [[nodiscard]] bool is_empty() const;
+
+        /*!
+         * \brief Moves on to the next frame, evicting resources if the device-local heaps are getting too full
+         *
+         * Call this once per frame, after the frame's fence has been waited on
+         *
+         * \param budgets The device's current memory budgets, from `RenderDevice::get_memory_budgets`
+         */
+        void begin_frame(const std::vector<rhi::RhiMemoryHeapBudget>& budgets);
+
+    private:
+        struct Resource {
+            uint64_t size = 0;
+
+            float priority = 0.5f;
+
+            uint64_t last_used_frame = 0;
+
+            std::function<void()> evict;
+        };
+
+        uint32_t num_in_flight_frames;
+
+        float eviction_threshold;
+
+        float eviction_target;
+
+        std::unordered_map<ResourceId, Resource> resources;
+
+        ResourceId next_resource_id = 0;
+
+        uint64_t frame_count = 0;
+
+        /*!
+         * \brief Memory that we evicted isn't freed until the frames that used it are done, so we don't look at the budget again until
+         * this frame
+         */
+        uint64_t next_frame_to_check = 0;
+
+        /*!
+         * \brief Whether we've already warned that evicting everything we can didn't get us back under budget
+         */
+        bool warned_about_budget = false;
+
+        std::vector<std::pair<ResourceId, const Resource*>> candidates_scratch;
+    };
+} // namespace nova::renderer
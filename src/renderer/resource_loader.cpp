@@ -1,6 +1,12 @@
 #include "nova_renderer/resource_loader.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+
 #include "nova_renderer/nova_renderer.hpp"
+#include "nova_renderer/rhi/swapchain.hpp"
 
 using namespace nova::mem;
 
@@ -10,31 +16,45 @@ namespace nova::renderer {
     using namespace rhi;
     using namespace renderpack;
 
-    constexpr size_t STAGING_BUFFER_ALIGNMENT = 2048;
-    constexpr size_t STAGING_BUFFER_TOTAL_MEMORY_SIZE = 8388608;
+    /*!
+     * \brief Size of the smallest staging buffer size class. Every larger class is twice as large as the one before it
+     */
+    constexpr size_t MIN_STAGING_BUFFER_SIZE = 64 * 1024;
+
+    /*!
+     * \brief Alignment of ring allocations. Buffer-to-image copies need offsets that are multiples of the texel size and of four
+     */
+    constexpr uint64_t STAGING_RING_ALIGNMENT = 256;
 
     constexpr size_t UNIFORM_BUFFER_ALIGNMENT = 64;           // TODO: Get a real value
     constexpr size_t UNIFORM_BUFFER_TOTAL_MEMORY_SIZE = 8096; // TODO: Get a real value
 
-    size_t size_in_bytes(PixelFormat pixel_format);
-
     DeviceResources::DeviceResources(NovaRenderer& renderer)
         : renderer{renderer},
           device{renderer.get_device()},
           internal_allocator{renderer.get_global_allocator()},
           textures{&internal_allocator},
           staging_buffers{&internal_allocator},
-          uniform_buffers{&internal_allocator} {
+          max_pooled_staging_memory{renderer.get_settings()->uploads.max_pooled_staging_memory},
+          staging_ring_size{renderer.get_settings()->uploads.staging_ring_size},
+          uniform_buffers{&internal_allocator},
+          packing_options{renderer.get_settings()->texture_packing} {
+        staging_stats.ring_size = staging_ring_size;
+
+        // NovaRenderer submits this once the builtin render targets are in it too
+        begin_creation_batch();
         create_default_textures();
     }
 
-    std::optional<BufferResourceAccessor> DeviceResources::create_uniform_buffer(const std::string& name, const Bytes size) {
+    std::optional<BufferResourceAccessor> DeviceResources::create_uniform_buffer(const std::string& name,
+                                                                                 const Bytes size,
+                                                                                 const BufferUsage usage) {
         const auto event_name = std::string::format("create_uniform_buffer(%s)", name);
         ZoneScoped;        BufferResource resource = {};
         resource.name = name;
         resource.size = size;
 
-        const RhiBufferCreateInfo create_info = {std::string::format("UniformBuffer%s", name), size.b_count(), BufferUsage::UniformBuffer};
+        const RhiBufferCreateInfo create_info = {std::string::format("UniformBuffer%s", name), size.b_count(), usage};
         resource.buffer = device.create_buffer(create_info, internal_allocator);
         if(resource.buffer == nullptr) {
             logger->error("Could not create uniform buffer %s", name);
@@ -56,17 +76,31 @@ namespace nova::renderer {
 
     void DeviceResources::destroy_uniform_buffer(const std::string& name) {
         if(const BufferResource* res = uniform_buffers.find(name)) {
-            // TODO device.destroy_buffer(res->buffer);
+            device.destroy_buffer(res->buffer);
         }
         uniform_buffers.erase(name);
     }
 
+    bool TextureResource::is_upload_done() const {
+        return upload_done.valid() && upload_done.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+    }
+
     std::optional<TextureResourceAccessor> DeviceResources::create_texture(const std::string& name,
                                                                           const std::size_t width,
                                                                           const std::size_t height,
                                                                           const PixelFormat pixel_format,
                                                                           const void* data,
                                                                           rx::memory::allocator& allocator) {
+        return create_and_upload_texture(name, width, height, pixel_format, data, allocator, false);
+    }
+
+    std::optional<TextureResourceAccessor> DeviceResources::create_and_upload_texture(const std::string& name,
+                                                                                     const std::size_t width,
+                                                                                     const std::size_t height,
+                                                                                     const PixelFormat pixel_format,
+                                                                                     const void* data,
+                                                                                     rx::memory::allocator& allocator,
+                                                                                     const bool wait_for_upload) {
         const auto event_name = std::string::format("create_texture(%s)", name);
         ZoneScoped;
         TextureResource resource = {};
@@ -76,12 +110,29 @@ namespace nova::renderer {
         resource.height = height;
         resource.format = pixel_format;
 
-        const size_t pixel_size = size_in_bytes(pixel_format);
+        if(is_block_compressed_format(pixel_format)) {
+            logger->error("Texture %s is block-compressed, which only streamed textures support", name);
+            return rx::nullopt;
+        }
+
+        create_and_upload_image(resource, data, allocator, wait_for_upload);
+
+        return TextureResourceAccessor{&textures, add_texture(resource)};
+    }
+
+    void DeviceResources::create_and_upload_image(TextureResource& resource,
+                                                  const void* data,
+                                                  rx::memory::allocator& allocator,
+                                                  const bool wait_for_upload) {
+        const auto& name = resource.name;
+        const auto width = resource.width;
+        const auto height = resource.height;
+        const size_t pixel_size = size_in_bytes(resource.format);
 
         renderpack::TextureCreateInfo info = {};
         info.name = name;
         info.usage = ImageUsage::SampledImage;
-        info.format.pixel_format = pixel_format;
+        info.format.pixel_format = resource.format;
         info.format.dimension_type = TextureDimensionType::Absolute;
         info.format.width = static_cast<float>(width);
         info.format.height = static_cast<float>(height);
@@ -90,13 +141,13 @@ namespace nova::renderer {
         resource.image->is_dynamic = false;
 
         if(data != nullptr) {
-            ZoneScoped;            RhiBuffer* staging_buffer = get_staging_buffer_with_size(width * height * pixel_size);
+            ZoneScoped;            const auto staging_memory = allocate_staging_memory(width * height * pixel_size);
 
-            RhiRenderCommandList* cmds = device.create_command_list(0,
-                                                                    QueueType::Transfer,
-                                                                    RhiRenderCommandList::Level::Primary,
-                                                                    allocator);
-            cmds->set_debug_name(std::string::format("UploadTo%s", name));
+            RhiRenderCommandList* cmds = get_creation_batch_commands(QueueType::Transfer);
+            if(cmds == nullptr) {
+                cmds = device.create_command_list(0, QueueType::Transfer, RhiRenderCommandList::Level::Primary, allocator);
+                cmds->set_debug_name(std::string::format("UploadTo%s", name));
+            }
 
             RhiResourceBarrier initial_texture_barrier = {};
             initial_texture_barrier.resource_to_barrier = resource.image;
@@ -111,7 +162,7 @@ namespace nova::renderer {
             std::vector<RhiResourceBarrier> initial_barriers{&allocator};
             initial_barriers.push_back(initial_texture_barrier);
             cmds->resource_barriers(PipelineStage::Transfer, PipelineStage::Transfer, initial_barriers);
-            cmds->upload_data_to_image(resource.image, width, height, pixel_size, staging_buffer, data);
+            cmds->upload_data_to_image(resource.image, width, height, pixel_size, staging_memory.buffer, data, staging_memory.offset);
 
             RhiResourceBarrier final_texture_barrier = {};
             final_texture_barrier.resource_to_barrier = resource.image;
@@ -127,28 +178,223 @@ namespace nova::renderer {
             final_barriers.push_back(final_texture_barrier);
             cmds->resource_barriers(PipelineStage::Transfer, PipelineStage::VertexShader, final_barriers);
 
-            RhiFence* upload_done_fence = device.create_fence(false, allocator);
-            device.submit_command_list(cmds, QueueType::Transfer, upload_done_fence);
+            auto upload_done = std::make_shared<std::promise<void>>();
+            resource.upload_done = upload_done->get_future().share();
+
+            if(is_batching_creation) {
+                creation_batch_completions.emplace_back([this, staging_memory, upload_done] {
+                    free_staging_memory(staging_memory);
+                    upload_done->set_value();
+                });
+
+            } else if(wait_for_upload) {
+                RhiFence* upload_done_fence = device.create_fence(false, allocator);
+                device.submit_command_list(cmds, QueueType::Transfer, upload_done_fence);
+
+                std::vector<RhiFence*> upload_done_fences{&allocator};
+                upload_done_fences.push_back(upload_done_fence);
+                device.wait_for_fences(upload_done_fences);
+                device.destroy_fences(upload_done_fences, allocator);
+
+                free_staging_memory(staging_memory);
+                upload_done->set_value();
 
-            // Be sure that the data copy is complete, so that this method doesn't return before the GPU is done with the staging buffer
-            std::vector<RhiFence*> upload_done_fences{&allocator};
-            upload_done_fences.push_back(upload_done_fence);
-            device.wait_for_fences(upload_done_fences);
-            device.destroy_fences(upload_done_fences, allocator);
+            } else {
+                // The device recycles the staging memory for us once the GPU is done with it, so we don't have to wait here
+                device.submit_command_list(cmds, QueueType::Transfer, nullptr, {}, {}, [this, staging_memory, upload_done] {
+                    free_staging_memory(staging_memory);
+                    upload_done->set_value();
+                });
+            }
+
+            logger->debug("Submitted the upload of texture %s", name);
+
+        } else {
+            std::promise<void> nothing_to_upload;
+            nothing_to_upload.set_value();
+            resource.upload_done = nothing_to_upload.get_future().share();
+        }
+    }
+
+    std::optional<PackedTextureRegion> DeviceResources::create_packed_texture(const std::string& name,
+                                                                              const uint32_t width,
+                                                                              const uint32_t height,
+                                                                              const PixelFormat pixel_format,
+                                                                              const void* data) {
+        ZoneScoped;
+        if(packed_textures.find(name) != packed_textures.end()) {
+            logger->error("There's already a packed texture named %s", name);
+            return rx::nullopt;
+        }
+
+        if(width == 0 || height == 0 || data == nullptr) {
+            logger->error("Packed texture %s has no pixels", name);
+            return rx::nullopt;
+        }
+
+        const auto padded_size = std::max(width, height) + packing_options.border * 2;
+        const bool can_pack = packing_options.enabled && !is_block_compressed_format(pixel_format) &&
+                              std::max(width, height) <= packing_options.max_packed_size && padded_size <= packing_options.page_size;
 
-            return_staging_buffer(staging_buffer);
+        std::optional<PackedTextureRegion> region;
+        if(can_pack) {
+            region = pack_texture(width, height, pixel_format, data);
 
-            logger->debug("Uploaded texture data to texture %s", name);
+        } else if(const auto texture = create_texture(name, width, height, pixel_format, data, internal_allocator)) {
+            region = PackedTextureRegion{static_cast<uint32_t>(texture->get_idx())};
         }
 
-        auto idx = textures.size();
+        if(region) {
+            packed_textures.emplace(name, *region);
+        }
 
-        textures.push_back(resource);
-        texture_name_to_idx.insert(name, static_cast<uint32_t>(idx));
+        return region;
+    }
 
-        logger->debug("Added texture %s to the textures array, there's now %u textures total", name, textures.size());
+    std::optional<PackedTextureRegion> DeviceResources::get_packed_texture(const std::string& name) const {
+        if(const auto itr = packed_textures.find(name); itr != packed_textures.end()) {
+            return itr->second;
+        }
 
-        return TextureResourceAccessor{&textures, idx};
+        return rx::nullopt;
+    }
+
+    std::optional<PackedTextureRegion> DeviceResources::pack_texture(const uint32_t width,
+                                                                     const uint32_t height,
+                                                                     const PixelFormat pixel_format,
+                                                                     const void* data) {
+        const auto border = packing_options.border;
+        const auto page_size = packing_options.page_size;
+        const auto padded_width = width + border * 2;
+        const auto padded_height = height + border * 2;
+
+        // Best fit: the shortest shelf that the texture fits in, so that small textures don't fill up the tall shelves
+        AtlasPage* page = nullptr;
+        AtlasShelf* shelf = nullptr;
+        for(auto& open_page : open_atlas_pages) {
+            if(open_page.format != pixel_format) {
+                continue;
+            }
+
+            for(auto& open_shelf : open_page.shelves) {
+                if(open_shelf.height >= padded_height && open_shelf.next_x + padded_width <= page_size &&
+                   (shelf == nullptr || open_shelf.height < shelf->height)) {
+                    page = &open_page;
+                    shelf = &open_shelf;
+                }
+            }
+        }
+
+        if(shelf == nullptr) {
+            for(auto& open_page : open_atlas_pages) {
+                if(open_page.format == pixel_format && open_page.next_shelf_y + padded_height <= page_size) {
+                    page = &open_page;
+                    break;
+                }
+            }
+
+            if(page == nullptr) {
+                const auto page_name = std::string::format("NovaTextureAtlas%u", num_atlas_pages++);
+                const auto page_texture = create_empty_texture(page_name, page_size, page_size, pixel_format);
+                if(!page_texture) {
+                    return rx::nullopt;
+                }
+
+                AtlasPage new_page{static_cast<uint32_t>(page_texture->get_idx()), pixel_format};
+                new_page.pixels.resize(get_image_size_in_bytes(pixel_format, page_size, page_size));
+                page = &open_atlas_pages.emplace_back(std::move(new_page));
+            }
+
+            shelf = &page->shelves.emplace_back(AtlasShelf{page->next_shelf_y, padded_height, 0});
+            page->next_shelf_y += padded_height;
+        }
+
+        const auto x = shelf->next_x;
+        const auto y = shelf->y;
+        shelf->next_x += padded_width;
+
+        // The border comes from the opposite edge, so the texture repeats seamlessly when shaders wrap its UVs
+        const size_t pixel_size = size_in_bytes(pixel_format);
+        const auto* source = static_cast<const uint8_t*>(data);
+        for(uint32_t row = 0; row < padded_height; row++) {
+            const auto source_row = (row + height - border % height) % height;
+            auto* destination = page->pixels.data() + ((y + row) * size_t{page_size} + x) * pixel_size;
+            for(uint32_t column = 0; column < padded_width; column++) {
+                const auto source_column = (column + width - border % width) % width;
+                const auto* source_pixel = source + (source_row * size_t{width} + source_column) * pixel_size;
+                std::memcpy(destination + column * pixel_size, source_pixel, pixel_size);
+            }
+        }
+
+        const auto page_size_f = static_cast<float>(page_size);
+        return PackedTextureRegion{page->texture_idx,
+                                   {static_cast<float>(width) / page_size_f,
+                                    static_cast<float>(height) / page_size_f,
+                                    static_cast<float>(x + border) / page_size_f,
+                                    static_cast<float>(y + border) / page_size_f}};
+    }
+
+    void DeviceResources::upload_texture_atlases() {
+        ZoneScoped;
+        for(auto& page : open_atlas_pages) {
+            create_and_upload_image(textures[page.texture_idx], page.pixels.data(), internal_allocator, false);
+            logger->debug("Submitted the upload of texture atlas %s", textures[page.texture_idx].name);
+        }
+
+        open_atlas_pages.clear();
+    }
+
+    std::optional<TextureResourceAccessor> DeviceResources::create_empty_texture(const std::string& name,
+                                                                                const size_t width,
+                                                                                const size_t height,
+                                                                                const PixelFormat pixel_format) {
+        // An invalid `upload_done` keeps the default texture in the slot
+        TextureResource resource = {};
+        resource.name = name;
+        resource.width = width;
+        resource.height = height;
+        resource.format = pixel_format;
+
+        return TextureResourceAccessor{&textures, add_texture(resource)};
+    }
+
+    RhiImage* DeviceResources::set_texture_image(const uint32_t texture_idx, RhiImage* image) {
+        auto& texture = textures[texture_idx];
+        auto* old_image = texture.image;
+        texture.image = image;
+
+        // The frame that next samples the texture waits for the upload batcher, so the texture counts as uploaded right away
+        if(!texture.is_upload_done()) {
+            std::promise<void> upload_done;
+            upload_done.set_value();
+            texture.upload_done = upload_done.get_future().share();
+        }
+
+        return old_image;
+    }
+
+    void DeviceResources::remove_texture(const uint32_t texture_idx) {
+        texture_name_to_idx.erase(textures[texture_idx].name);
+        textures[texture_idx] = {};
+        free_texture_indices.push_back(texture_idx);
+    }
+
+    uint32_t DeviceResources::add_texture(const TextureResource& resource) {
+        uint32_t idx;
+        if(!free_texture_indices.empty()) {
+            idx = free_texture_indices.back();
+            free_texture_indices.pop_back();
+            textures[idx] = resource;
+
+        } else {
+            idx = static_cast<uint32_t>(textures.size());
+            textures.push_back(resource);
+        }
+        texture_name_to_idx.insert(resource.name, idx);
+
+        logger->debug("Added texture %s to the textures array, there's now %u textures total", resource.name, textures.size());
+
+        return idx;
     }
 
     std::optional<uint32_t> DeviceResources::get_texture_idx_for_name(const std::string& name) const {
@@ -180,16 +426,23 @@ namespace nova::renderer {
                                                                              const size_t height,
                                                                              const PixelFormat pixel_format,
                                                                              rx::memory::allocator& allocator,
-                                                                             const bool /* can_be_sampled // Not yet supported */) {
+                                                                             const bool /* can_be_sampled // Not yet supported */,
+                                                                             const bool is_transient,
+                                                                             const uint32_t num_layers,
+                                                                             const uint32_t num_mips,
+                                                                             const std::string& owner) {
         const auto event_name = std::string::format("create_render_target(%s)", name);
         ZoneScoped;
         renderpack::TextureCreateInfo create_info;
         create_info.name = name;
-        create_info.usage = ImageUsage::RenderTarget;
+        create_info.usage = is_transient ? ImageUsage::TransientRenderTarget : ImageUsage::RenderTarget;
         create_info.format.pixel_format = pixel_format;
         create_info.format.dimension_type = TextureDimensionType::Absolute;
         create_info.format.width = static_cast<float>(width);
         create_info.format.height = static_cast<float>(height);
+        create_info.format.num_layers = num_layers;
+        create_info.num_mips = std::clamp(num_mips, 1U, static_cast<uint32_t>(std::bit_width(std::max(width, height))));
+        create_info.owner = owner;
 
         auto* image = device.create_image(create_info, allocator);
         if(image) {
@@ -206,11 +459,11 @@ namespace nova::renderer {
 
             {
                 ZoneScoped;
-                RhiRenderCommandList* cmds = device.create_command_list(0,
-                                                                        QueueType::Graphics,
-                                                                        RhiRenderCommandList::Level::Primary,
-                                                                        allocator);
-                cmds->set_debug_name(std::string::format("ChangeFormatOf%s", name));
+                RhiRenderCommandList* cmds = get_creation_batch_commands(QueueType::Graphics);
+                if(cmds == nullptr) {
+                    cmds = device.create_command_list(0, QueueType::Graphics, RhiRenderCommandList::Level::Primary, allocator);
+                    cmds->set_debug_name(std::string::format("ChangeFormatOf%s", name));
+                }
 
                 RhiResourceBarrier initial_texture_barrier = {};
                 initial_texture_barrier.resource_to_barrier = resource.image;
@@ -241,14 +494,17 @@ namespace nova::renderer {
                 initial_barriers.push_back(initial_texture_barrier);
                 cmds->resource_barriers(PipelineStage::TopOfPipe, stage_after_barrier, initial_barriers);
 
-                RhiFence* upload_done_fence = device.create_fence(false, allocator);
-                device.submit_command_list(cmds, QueueType::Graphics, upload_done_fence);
+                if(!is_batching_creation) {
+                    RhiFence* upload_done_fence = device.create_fence(false, allocator);
+                    device.submit_command_list(cmds, QueueType::Graphics, upload_done_fence);
 
-                // Be sure that the data copy is complete, so that this method doesn't return before the GPU is done with the staging buffer
-                std::vector<RhiFence*> upload_done_fences{&allocator};
-                upload_done_fences.push_back(upload_done_fence);
-                device.wait_for_fences(upload_done_fences);
-                device.destroy_fences(upload_done_fences, allocator);
+                    // Be sure that the data copy is complete, so that this method doesn't return before the GPU is done with the staging
+                    // buffer
+                    std::vector<RhiFence*> upload_done_fences{&allocator};
+                    upload_done_fences.push_back(upload_done_fence);
+                    device.wait_for_fences(upload_done_fences);
+                    device.destroy_fences(upload_done_fences, allocator);
+                }
             }
 
             render_targets.insert(name, resource);
@@ -261,6 +517,45 @@ namespace nova::renderer {
         }
     }
 
+    bool DeviceResources::create_aliased_render_targets(const std::vector<renderpack::TextureCreateInfo>& create_infos) {
+        ZoneScoped;
+        const auto swapchain_size = device.get_swapchain()->get_size();
+
+        // Give the device absolute sizes, like `create_render_target` does
+        std::vector<renderpack::TextureCreateInfo> absolute_create_infos;
+        absolute_create_infos.reserve(create_infos.size());
+        for(const renderpack::TextureCreateInfo& info : create_infos) {
+            const auto size = info.format.get_size_in_pixels(swapchain_size);
+
+            auto& absolute_info = absolute_create_infos.emplace_back(info);
+            absolute_info.usage = ImageUsage::RenderTarget;
+            absolute_info.format.dimension_type = TextureDimensionType::Absolute;
+            absolute_info.format.width = static_cast<float>(size.x);
+            absolute_info.format.height = static_cast<float>(size.y);
+            absolute_info.num_mips = std::clamp(info.num_mips, 1U, static_cast<uint32_t>(std::bit_width(std::max(size.x, size.y))));
+        }
+
+        const auto images = device.create_aliased_images(absolute_create_infos);
+        if(images.empty()) {
+            return false;
+        }
+
+        for(size_t i = 0; i < images.size(); i++) {
+            const auto& info = absolute_create_infos[i];
+
+            TextureResource resource = {};
+            resource.name = info.name;
+            resource.format = info.format.pixel_format;
+            resource.width = static_cast<size_t>(info.format.width);
+            resource.height = static_cast<size_t>(info.format.height);
+            resource.image = images[i];
+
+            render_targets.emplace(info.name, resource);
+        }
+
+        return true;
+    }
+
     std::optional<RenderTargetAccessor> DeviceResources::get_render_target(const std::string& name) {
         if(render_targets.find(name) != nullptr) {
             return RenderTargetAccessor{&render_targets, name};
@@ -271,10 +566,19 @@ namespace nova::renderer {
     }
 
     void DeviceResources::destroy_render_target(const std::string& texture_name, rx::memory::allocator& allocator) {
-        if(const auto idx = get_texture_idx_for_name(texture_name); idx) {
-            const auto texture = textures[*idx];
-            device.destroy_texture(texture.image, allocator);
-            textures.erase(*idx, *idx);
+        // Render targets live in their own map, not in the textures array
+        if(const auto rt_itr = render_targets.find(texture_name); rt_itr != render_targets.end()) {
+            device.destroy_texture(rt_itr->second.image, allocator);
+            render_targets.erase(rt_itr);
+
+        } else if(const auto* idx = texture_name_to_idx.find(texture_name); idx != nullptr && *idx != 0) {
+            // Shaders refer to textures by index, so the slot stays where it is. Slots without an image get the default texture
+            const auto texture_idx = *idx;
+            device.destroy_texture(textures[texture_idx].image, allocator);
+            textures[texture_idx] = {};
+
+            texture_name_to_idx.erase(texture_name);
+            free_texture_indices.push_back(texture_idx);
         }
 #if NOVA_DEBUG
         else {
@@ -284,40 +588,211 @@ namespace nova::renderer {
     }
 
     RhiBuffer* DeviceResources::get_staging_buffer_with_size(const Bytes size) {
-        // Align the size so we can bin the staging buffers
-        // TODO: Experiment and find a good alignment
-        const auto a = size.b_count() % STAGING_BUFFER_ALIGNMENT;
-        const auto needed_size = STAGING_BUFFER_ALIGNMENT + a;
-        const auto actual_size = size.b_count() + needed_size;
-
-        if(auto* staging_buffer = staging_buffers.find(actual_size); staging_buffer != nullptr) {
-            auto& buffer_list = *staging_buffer;
-            if(buffer_list.size() > 0) {
-                auto* buffer = buffer_list.last();
-                buffer_list.erase(buffer_list.size() - 1, buffer_list.size() - 1);
-
-                return buffer;
-            }
+        // Round up to the size class, so buffers of similar sizes can stand in for each other
+        size_t size_class = MIN_STAGING_BUFFER_SIZE;
+        while(size_class < size.b_count()) {
+            size_class *= 2;
+        }
+
+        if(const auto buffers_itr = staging_buffers.find(size_class);
+           buffers_itr != staging_buffers.end() && !buffers_itr->second.empty()) {
+            // The most recently returned buffer is the most likely to still be in the cache
+            auto* buffer = buffers_itr->second.back().buffer;
+            buffers_itr->second.pop_back();
+
+            staging_stats.idle_pooled_bytes -= size_class;
+            staging_stats.used_pooled_bytes += size_class;
+
+            return buffer;
         }
 
-        const RhiBufferCreateInfo info = {"GenericStagingBuffer", actual_size, BufferUsage::StagingBuffer};
+        const RhiBufferCreateInfo info = {"GenericStagingBuffer", size_class, BufferUsage::StagingBuffer};
 
         RhiBuffer* buffer = device.create_buffer(info, internal_allocator);
+        if(buffer != nullptr) {
+            staging_stats.used_pooled_bytes += size_class;
+            staging_stats.num_buffers_created++;
+        }
+
         return buffer;
     }
 
     void DeviceResources::return_staging_buffer(RhiBuffer* buffer) {
         const auto size = buffer->size.b_count();
-        auto* buffers = staging_buffers.find(size);
-        if(!buffers) {
-            buffers = staging_buffers.insert(size, {});
+        staging_buffers[size].push_back({buffer, num_staging_buffer_returns});
+        num_staging_buffer_returns++;
+
+        staging_stats.used_pooled_bytes -= size;
+        staging_stats.idle_pooled_bytes += size;
+
+        if(staging_stats.idle_pooled_bytes > max_pooled_staging_memory) {
+            trim_staging_buffers();
         }
+    }
+
+    StagingAllocation DeviceResources::allocate_staging_memory(const Bytes size) {
+        if(size.b_count() <= staging_ring_size / 4) {
+            if(const auto ring_allocation = allocate_from_staging_ring(size.b_count())) {
+                return *ring_allocation;
+            }
+        }
+
+        // The ring is full of uploads that are still in flight, or this upload is too big for it
+        auto* buffer = get_staging_buffer_with_size(size);
+        return {buffer, 0, size.b_count(), false};
+    }
+
+    void DeviceResources::free_staging_memory(const StagingAllocation& allocation) {
+        if(!allocation.is_from_ring) {
+            if(allocation.buffer != nullptr) {
+                return_staging_buffer(allocation.buffer);
+            }
+            return;
+        }
+
+        // Uploads usually finish in the order they were submitted, so this is almost always the oldest allocation
+        const auto ring_allocation = std::find_if(staging_ring_allocations.begin(),
+                                                  staging_ring_allocations.end(),
+                                                  [&](const RingAllocation& ring_allocation) {
+                                                      return ring_allocation.offset == allocation.offset && !ring_allocation.is_freed;
+                                                  });
+        if(ring_allocation == staging_ring_allocations.end()) {
+            logger->error("Tried to free staging ring memory at offset %u that wasn't allocated", allocation.offset);
+            return;
+        }
+
+        ring_allocation->is_freed = true;
+        staging_stats.used_ring_bytes -= ring_allocation->size;
 
-        buffers->push_back(buffer);
+        // Space only goes back to the ring once everything before it is free too
+        while(!staging_ring_allocations.empty() && staging_ring_allocations.front().is_freed) {
+            staging_ring_allocations.pop_front();
+        }
+
+        if(staging_ring_allocations.empty()) {
+            staging_ring_head = 0;
+        }
+    }
+
+    const StagingMemoryStats& DeviceResources::get_staging_memory_stats() const { return staging_stats; }
+
+    std::optional<StagingAllocation> DeviceResources::allocate_from_staging_ring(const uint64_t size) {
+        if(staging_ring == nullptr) {
+            const RhiBufferCreateInfo info = {"StagingRing", staging_ring_size, BufferUsage::StagingBuffer};
+            staging_ring = device.create_buffer(info, internal_allocator);
+            if(staging_ring == nullptr) {
+                logger->error("Could not create the staging ring. Every upload will get its own staging buffer");
+                staging_ring_size = 0;
+                staging_stats.ring_size = 0;
+                return rx::nullopt;
+            }
+        }
+
+        const auto aligned_size = (size + STAGING_RING_ALIGNMENT - 1) / STAGING_RING_ALIGNMENT * STAGING_RING_ALIGNMENT;
+
+        // The used part of the ring runs from the oldest allocation to the head. It has wrapped around when the head is before the oldest
+        // allocation
+        uint64_t offset = staging_ring_head;
+        if(!staging_ring_allocations.empty()) {
+            const auto tail = staging_ring_allocations.front().offset;
+            if(staging_ring_head <= tail) {
+                if(staging_ring_head + aligned_size > tail) {
+                    return rx::nullopt;
+                }
+
+            } else if(staging_ring_head + aligned_size > staging_ring_size) {
+                if(aligned_size > tail) {
+                    return rx::nullopt;
+                }
+                offset = 0;
+            }
+
+        } else if(aligned_size > staging_ring_size) {
+            return rx::nullopt;
+        }
+
+        staging_ring_allocations.push_back({offset, aligned_size});
+        staging_ring_head = offset + aligned_size;
+        staging_stats.used_ring_bytes += aligned_size;
+
+        return StagingAllocation{staging_ring, offset, size, true};
+    }
+
+    void DeviceResources::trim_staging_buffers() {
+        ZoneScoped;
+        while(staging_stats.idle_pooled_bytes > max_pooled_staging_memory) {
+            // There's only a handful of size classes, so look at the oldest buffer of each
+            auto oldest = staging_buffers.end();
+            for(auto itr = staging_buffers.begin(); itr != staging_buffers.end(); ++itr) {
+                if(!itr->second.empty() &&
+                   (oldest == staging_buffers.end() || itr->second.front().return_idx < oldest->second.front().return_idx)) {
+                    oldest = itr;
+                }
+            }
+
+            if(oldest == staging_buffers.end()) {
+                return;
+            }
+
+            auto* buffer = oldest->second.front().buffer;
+            oldest->second.pop_front();
+
+            staging_stats.idle_pooled_bytes -= oldest->first;
+            staging_stats.num_buffers_released++;
+
+            device.destroy_buffer(buffer);
+        }
     }
 
     const std::vector<TextureResource>& DeviceResources::get_all_textures() const { return textures; }
 
+    void DeviceResources::begin_creation_batch() { is_batching_creation = true; }
+
+    void DeviceResources::submit_creation_batch() {
+        ZoneScoped;
+        upload_texture_atlases();
+        is_batching_creation = false;
+
+        std::vector<RhiFence*> batch_fences;
+        if(creation_batch_transfer_cmds != nullptr) {
+            auto* fence = device.create_fence(false, internal_allocator);
+            device.submit_command_list(creation_batch_transfer_cmds, QueueType::Transfer, fence);
+            batch_fences.push_back(fence);
+            creation_batch_transfer_cmds = nullptr;
+        }
+
+        if(creation_batch_graphics_cmds != nullptr) {
+            auto* fence = device.create_fence(false, internal_allocator);
+            device.submit_command_list(creation_batch_graphics_cmds, QueueType::Graphics, fence);
+            batch_fences.push_back(fence);
+            creation_batch_graphics_cmds = nullptr;
+        }
+
+        if(!batch_fences.empty()) {
+            device.wait_for_fences(batch_fences);
+            device.destroy_fences(batch_fences, internal_allocator);
+        }
+
+        for(const auto& completion : creation_batch_completions) {
+            completion();
+        }
+        creation_batch_completions.clear();
+    }
+
+    RhiRenderCommandList* DeviceResources::get_creation_batch_commands(const QueueType queue) {
+        if(!is_batching_creation) {
+            return nullptr;
+        }
+
+        auto*& cmds = queue == QueueType::Transfer ? creation_batch_transfer_cmds : creation_batch_graphics_cmds;
+        if(cmds == nullptr) {
+            cmds = device.create_command_list(0, queue, RhiRenderCommandList::Level::Primary, internal_allocator);
+            cmds->set_debug_name(queue == QueueType::Transfer ? "NovaCreationBatchUploads" : "NovaCreationBatchTransitions");
+        }
+
+        return cmds;
+    }
+
     void DeviceResources::create_default_textures() {
         ZoneScoped;
         const auto make_color_tex = [&](const std::string& name, const uint32_t color) {
@@ -325,7 +800,9 @@ namespace nova::renderer {
             for(uint32_t i = 0; i < tex_data.size(); i++) {
                 tex_data[i] = color;
             }
-            if(!create_texture(name, 8, 8, PixelFormat::Rgba8, tex_data.data(), internal_allocator)) {
+            // Other textures stand in for themselves with the default texture while they're uploading, so the default textures have to
+            // be ready right away
+            if(!create_and_upload_texture(name, 8, 8, PixelFormat::Rgba8, tex_data.data(), internal_allocator, true)) {
                 logger->error("Could not create texture %s", name);
             }
         };
@@ -346,14 +823,50 @@ namespace nova::renderer {
             case PixelFormat::Rgba32F:
                 return 16;
 
+            case PixelFormat::Rg32F:
+                return 8;
+
+            case PixelFormat::R8Uint:
+                return 1;
+
+            case PixelFormat::Rg11B10F:
+                [[fallthrough]];
+            case PixelFormat::Rgb10A2:
+                [[fallthrough]];
+            case PixelFormat::Rg16F:
+                [[fallthrough]];
+            case PixelFormat::Rg16Snorm:
+                return 4;
+
             case PixelFormat::Depth32:
                 return 4;
 
             case PixelFormat::Depth24Stencil8:
                 return 4;
 
+            case PixelFormat::Bc1:
+                return 8;
+
+            case PixelFormat::Bc3:
+                [[fallthrough]];
+            case PixelFormat::Bc5:
+                [[fallthrough]];
+            case PixelFormat::Bc7:
+                [[fallthrough]];
+            case PixelFormat::Astc4x4:
+                return 16;
+
             default:
                 return 4;
         }
     }
+
+    uint64_t get_image_size_in_bytes(const PixelFormat pixel_format, const uint32_t width, const uint32_t height) {
+        if(is_block_compressed_format(pixel_format)) {
+            // Blocks on the right and bottom edges hang over the edge of the image, but they're stored whole
+            return uint64_t{(width + 3) / 4} * ((height + 3) / 4) * size_in_bytes(pixel_format);
+        }
+
+        return uint64_t{width} * height * size_in_bytes(pixel_format);
+    }
 } // namespace nova::renderer
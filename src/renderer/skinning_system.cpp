@@ -0,0 +1,336 @@
+#include "skinning_system.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "builtin_shaders.hpp"
+#include "frame_upload_allocator.hpp"
+#include "upload_batcher.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("SkinningSystem");
+
+    constexpr uint32_t SKINNING_GROUP_SIZE = 64;
+
+    /*!
+     * \brief The most bones a skinned mesh may have, since skin weights only have eight bits for the bone index
+     */
+    constexpr uint32_t MAX_BONES = 256;
+
+    static rhi::RhiResourceBarrier make_buffer_barrier(rhi::RhiBuffer* buffer,
+                                                       const rhi::ResourceAccess access_before,
+                                                       const rhi::ResourceAccess access_after) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = buffer;
+        barrier.old_state = rhi::ResourceState::Common;
+        barrier.new_state = rhi::ResourceState::Common;
+        barrier.access_before_barrier = access_before;
+        barrier.access_after_barrier = access_after;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = 0;
+        barrier.buffer_memory_barrier.size = buffer->size;
+
+        return barrier;
+    }
+
+    /*!
+     * \brief The bind pose, which is every bone at the mesh's origin
+     */
+    static std::vector<glm::vec4> make_bind_pose(const uint32_t num_bones) {
+        std::vector<glm::vec4> bone_rows;
+        bone_rows.reserve(num_bones * 3);
+        for(uint32_t i = 0; i < num_bones; i++) {
+            bone_rows.emplace_back(1, 0, 0, 0);
+            bone_rows.emplace_back(0, 1, 0, 0);
+            bone_rows.emplace_back(0, 0, 1, 0);
+        }
+
+        return bone_rows;
+    }
+
+    SkinningSystem::SkinningSystem(rhi::RenderDevice& device,
+                                   const uint32_t num_in_flight_frames,
+                                   const NovaSettings::SkinningOptions& options)
+        : device{device},
+          num_in_flight_frames{num_in_flight_frames},
+          source_vertex_allocator{std::max(options.max_mesh_vertices, 1U)},
+          index_allocator{std::max(options.max_mesh_indices, 1U)},
+          output_vertex_allocator{std::max(options.max_renderable_vertices, 1U)} {
+        ZoneScoped;
+        const auto spirv = load_builtin_shader("skinning.compute.hlsl", rhi::ShaderStage::Compute);
+        if(spirv.empty()) {
+            logger->error("Could not compile the skinning shader. Skinned renderables will not be drawn");
+
+        } else {
+            RhiComputePipelineState pipeline_state{};
+            pipeline_state.name = "NovaSkinning";
+            pipeline_state.compute_shader = {"/nova/shaders/skinning.compute.hlsl", spirv};
+            pipeline = device.create_compute_pipeline(pipeline_state);
+        }
+
+        rhi::RhiBufferCreateInfo create_info{};
+        create_info.buffer_usage = rhi::BufferUsage::DeviceStorageBuffer;
+
+        create_info.name = "NovaSkinnedMeshVertices";
+        create_info.size = sizeof(FullVertex) * source_vertex_allocator.get_size();
+        source_vertices = device.create_buffer(create_info);
+
+        create_info.name = "NovaSkinWeights";
+        create_info.size = sizeof(VertexSkinWeights) * source_vertex_allocator.get_size();
+        skin_weights = device.create_buffer(create_info);
+
+        create_info.name = "NovaSkinnedMeshIndices";
+        create_info.buffer_usage = rhi::BufferUsage::IndexBuffer;
+        create_info.size = sizeof(uint32_t) * index_allocator.get_size();
+        indices = device.create_buffer(create_info);
+
+        frames.resize(num_in_flight_frames);
+        create_info.buffer_usage = rhi::BufferUsage::ComputeVertexBuffer;
+        create_info.size = sizeof(FullVertex) * output_vertex_allocator.get_size();
+        for(uint32_t i = 0; i < frames.size(); i++) {
+            auto& frame = frames[i];
+
+            create_info.name = fmt::format("NovaSkinnedVertices{}", i);
+            frame.output_vertices = device.create_buffer(create_info);
+
+            if(pipeline) {
+                frame.binder = device.create_resource_binder_for_pipeline(*pipeline);
+                frame.binder->bind_buffer("source_vertices", source_vertices);
+                frame.binder->bind_buffer("skin_weights", skin_weights);
+                frame.binder->bind_buffer("output_vertices", frame.output_vertices);
+            }
+        }
+    }
+
+    SkinningSystem::~SkinningSystem() {
+        for(FrameResources& frame : frames) {
+            frame.binder = {};
+            device.destroy_buffer(frame.output_vertices);
+        }
+
+        device.destroy_buffer(source_vertices);
+        device.destroy_buffer(skin_weights);
+        device.destroy_buffer(indices);
+    }
+
+    bool SkinningSystem::add_mesh(const MeshId id, const SkinnedMeshData& data, UploadBatcher& uploads) {
+        ZoneScoped;
+        if(data.vertices == nullptr || data.skin_weights == nullptr || data.num_vertices == 0 || data.indices == nullptr ||
+           data.num_indices == 0) {
+            logger->error("Skinned meshes need vertices, skin weights, and indices");
+            return false;
+        }
+
+        if(data.num_bones == 0 || data.num_bones > MAX_BONES) {
+            logger->error("Skinned meshes need between 1 and {} bones, but this one has {}", MAX_BONES, data.num_bones);
+            return false;
+        }
+
+        const auto first_vertex = source_vertex_allocator.allocate(data.num_vertices);
+        if(!first_vertex) {
+            logger->error("There's no room for {} more skinned mesh vertices. Raise `NovaSettings::SkinningOptions::max_mesh_vertices`",
+                          data.num_vertices);
+            return false;
+        }
+
+        const auto first_index = index_allocator.allocate(data.num_indices);
+        if(!first_index) {
+            logger->error("There's no room for {} more skinned mesh indices. Raise `NovaSettings::SkinningOptions::max_mesh_indices`",
+                          data.num_indices);
+            source_vertex_allocator.free(*first_vertex, data.num_vertices);
+            return false;
+        }
+
+        uploads.upload_to_buffer(source_vertices,
+                                 sizeof(FullVertex) * *first_vertex,
+                                 data.vertices,
+                                 sizeof(FullVertex) * data.num_vertices,
+                                 rhi::ResourceAccess::ShaderRead,
+                                 rhi::PipelineStage::ComputeShader);
+        uploads.upload_to_buffer(skin_weights,
+                                 sizeof(VertexSkinWeights) * *first_vertex,
+                                 data.skin_weights,
+                                 sizeof(VertexSkinWeights) * data.num_vertices,
+                                 rhi::ResourceAccess::ShaderRead,
+                                 rhi::PipelineStage::ComputeShader);
+        uploads.upload_to_buffer(indices,
+                                 sizeof(uint32_t) * *first_index,
+                                 data.indices,
+                                 sizeof(uint32_t) * data.num_indices,
+                                 rhi::ResourceAccess::IndexRead,
+                                 rhi::PipelineStage::VertexInput);
+
+        meshes.insert_or_assign(id,
+                                SkinnedMesh{.first_vertex = static_cast<uint32_t>(*first_vertex),
+                                            .num_vertices = data.num_vertices,
+                                            .first_index = static_cast<uint32_t>(*first_index),
+                                            .num_indices = data.num_indices,
+                                            .num_bones = data.num_bones,
+                                            .bounding_sphere = data.bounding_sphere});
+
+        return true;
+    }
+
+    void SkinningSystem::remove_mesh(const MeshId id) {
+        const auto mesh_itr = meshes.find(id);
+        if(mesh_itr == meshes.end()) {
+            return;
+        }
+
+        retired_meshes.push_back({mesh_itr->second, num_in_flight_frames});
+        meshes.erase(mesh_itr);
+    }
+
+    const SkinningSystem::SkinnedMesh* SkinningSystem::get_mesh(const MeshId id) const {
+        const auto mesh_itr = meshes.find(id);
+        return mesh_itr != meshes.end() ? &mesh_itr->second : nullptr;
+    }
+
+    std::optional<uint32_t> SkinningSystem::add_renderable(const RenderableId id, const MeshId mesh_id) {
+        const auto* mesh = get_mesh(mesh_id);
+        if(mesh == nullptr) {
+            return std::nullopt;
+        }
+
+        // Each frame slot only writes its own output buffer, and nothing else reads it until that frame draws, so freed runs can be
+        // handed out again right away
+        const auto first_output_vertex = output_vertex_allocator.allocate(mesh->num_vertices);
+        if(!first_output_vertex) {
+            logger->error("There's no room for {} more skinned vertices. Raise `NovaSettings::SkinningOptions::max_renderable_vertices`",
+                          mesh->num_vertices);
+            return std::nullopt;
+        }
+
+        renderables.insert_or_assign(id,
+                                     Renderable{.mesh = mesh_id,
+                                                .first_output_vertex = static_cast<uint32_t>(*first_output_vertex),
+                                                .num_vertices = mesh->num_vertices,
+                                                .bone_rows = make_bind_pose(mesh->num_bones)});
+
+        return static_cast<uint32_t>(*first_output_vertex);
+    }
+
+    void SkinningSystem::remove_renderable(const RenderableId id) {
+        const auto renderable_itr = renderables.find(id);
+        if(renderable_itr == renderables.end()) {
+            return;
+        }
+
+        output_vertex_allocator.free(renderable_itr->second.first_output_vertex, renderable_itr->second.num_vertices);
+        renderables.erase(renderable_itr);
+    }
+
+    bool SkinningSystem::set_pose(const RenderableId id, const std::span<const glm::mat4> bone_matrices) {
+        const auto renderable_itr = renderables.find(id);
+        if(renderable_itr == renderables.end()) {
+            return false;
+        }
+
+        auto& bone_rows = renderable_itr->second.bone_rows;
+        if(bone_matrices.size() * 3 != bone_rows.size()) {
+            logger->error("Skinned renderable {} has {} bones, but its new pose has {}", id, bone_rows.size() / 3, bone_matrices.size());
+            return false;
+        }
+
+        for(size_t i = 0; i < bone_matrices.size(); i++) {
+            const auto rows = glm::transpose(bone_matrices[i]);
+            bone_rows[i * 3] = rows[0];
+            bone_rows[i * 3 + 1] = rows[1];
+            bone_rows[i * 3 + 2] = rows[2];
+        }
+
+        return true;
+    }
+
+    void SkinningSystem::begin_frame() {
+        for(auto itr = retired_meshes.begin(); itr != retired_meshes.end();) {
+            if(itr->frames_left > 0) {
+                itr->frames_left--;
+                ++itr;
+                continue;
+            }
+
+            source_vertex_allocator.free(itr->mesh.first_vertex, itr->mesh.num_vertices);
+            index_allocator.free(itr->mesh.first_index, itr->mesh.num_indices);
+            itr = retired_meshes.erase(itr);
+        }
+    }
+
+    void SkinningSystem::record_skinning(rhi::RhiRenderCommandList& cmds, const uint32_t frame_idx, FrameUploadAllocator& uploads) {
+        ZoneScoped;
+        const auto& frame = frames[frame_idx];
+        if(renderables.empty() || !pipeline) {
+            return;
+        }
+
+        jobs_scratch.clear();
+        uint32_t num_bones = 0;
+        uint32_t max_vertices = 0;
+        for(const auto& [id, renderable] : renderables) {
+            const auto* mesh = get_mesh(renderable.mesh);
+            if(mesh == nullptr) {
+                continue;
+            }
+
+            jobs_scratch.push_back({mesh->first_vertex, renderable.first_output_vertex, mesh->num_vertices, num_bones});
+            num_bones += mesh->num_bones;
+            max_vertices = std::max(max_vertices, mesh->num_vertices);
+        }
+
+        if(jobs_scratch.empty()) {
+            return;
+        }
+
+        const auto jobs = uploads.allocate(sizeof(SkinningJob) * jobs_scratch.size());
+        const auto bones = uploads.allocate(sizeof(glm::vec4) * 3 * num_bones);
+        if(!jobs || !bones) {
+            logger->error("The frame upload buffer is out of room for the bone palettes of {} skinned renderables", jobs_scratch.size());
+            return;
+        }
+
+        std::memcpy(jobs->data, jobs_scratch.data(), sizeof(SkinningJob) * jobs_scratch.size());
+
+        // Same order as the jobs, so each job's first bone is where its renderable's bones are
+        auto* bone_data = static_cast<glm::vec4*>(bones->data);
+        for(const auto& [id, renderable] : renderables) {
+            if(get_mesh(renderable.mesh) != nullptr) {
+                bone_data = std::copy(renderable.bone_rows.begin(), renderable.bone_rows.end(), bone_data);
+            }
+        }
+
+        frame.binder->bind_buffer_range("jobs", jobs->buffer, jobs->offset, jobs->size);
+        frame.binder->bind_buffer_range("bones", bones->buffer, bones->offset, bones->size);
+
+        // This frame slot's last frame drew from the output buffer
+        cmds.resource_barriers(rhi::PipelineStage::VertexInput,
+                               rhi::PipelineStage::ComputeShader,
+                               std::array{make_buffer_barrier(frame.output_vertices,
+                                                              rhi::ResourceAccess::VertexAttributeRead,
+                                                              rhi::ResourceAccess::ShaderWrite)});
+
+        cmds.set_compute_pipeline(*pipeline);
+        cmds.bind_compute_resources(*frame.binder, frame_idx);
+        cmds.dispatch((max_vertices + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, static_cast<uint32_t>(jobs_scratch.size()));
+
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                               rhi::PipelineStage::VertexInput,
+                               std::array{make_buffer_barrier(frame.output_vertices,
+                                                              rhi::ResourceAccess::ShaderWrite,
+                                                              rhi::ResourceAccess::VertexAttributeRead)});
+    }
+
+    rhi::RhiBuffer* SkinningSystem::get_output_buffer(const uint32_t frame_idx) const { return frames[frame_idx].output_vertices; }
+
+    rhi::RhiBuffer* SkinningSystem::get_index_buffer() const { return indices; }
+} // namespace nova::renderer
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/renderables.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+
+#include "../util/offset_allocator.hpp"
+
+namespace nova::renderer {
+    class FrameUploadAllocator;
+    class RhiResourceBinder;
+    class UploadBatcher;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Skins the vertices of every skinned renderable with a compute shader, once per frame
+     *
+     * Skinned meshes upload their bind pose vertices, skin weights, and indices once, into buffers that all skinned meshes share. Each
+     * skinned renderable gets its own run of vertices in a per-frame output buffer. Every frame, the renderables' bone palettes go
+     * through the frame upload allocator, and one dispatch skins every renderable from its mesh's bind pose into its run of the output
+     * buffer. Every pass and camera that draws the renderable reads those vertices, so shadows don't skin anything again
+     */
+    class SkinningSystem {
+    public:
+        /*!
+         * \brief A skinned mesh's place in the shared buffers
+         */
+        struct SkinnedMesh {
+            uint32_t first_vertex = 0;
+
+            uint32_t num_vertices = 0;
+
+            uint32_t first_index = 0;
+
+            uint32_t num_indices = 0;
+
+            uint32_t num_bones = 0;
+
+            glm::vec4 bounding_sphere{0, 0, 0, -1};
+        };
+
+        SkinningSystem(rhi::RenderDevice& device, uint32_t num_in_flight_frames, const NovaSettings::SkinningOptions& options);
+
+        SkinningSystem(const SkinningSystem& other) = delete;
+        SkinningSystem& operator=(const SkinningSystem& other) = delete;
+
+        SkinningSystem(SkinningSystem&& old) noexcept = delete;
+        SkinningSystem& operator=(SkinningSystem&& old) noexcept = delete;
+
+        ~SkinningSystem();
+
+        /*!
+         * \brief Finds space for a skinned mesh and queues the upload of its data
+         *
+         * \return Whether the mesh fit
+         */
+        bool add_mesh(MeshId id, const SkinnedMeshData& data, UploadBatcher& uploads);
+
+        /*!
+         * \brief Frees the space of a skinned mesh once the frames in flight are done with it. The mesh mustn't have any renderables
+         */
+        void remove_mesh(MeshId id);
+
+        [[nodiscard]] const SkinnedMesh* get_mesh(MeshId id) const;
+
+        /*!
+         * \brief Gives a skinned renderable its own run of output vertices. It starts out in the mesh's bind pose
+         *
+         * \return Where the renderable's vertices start in the output buffers, or nothing if they're full
+         */
+        [[nodiscard]] std::optional<uint32_t> add_renderable(RenderableId id, MeshId mesh);
+
+        void remove_renderable(RenderableId id);
+
+        /*!
+         * \brief Sets the bone matrices that a skinned renderable is skinned with from now on
+         *
+         * \return Whether the renderable exists and got as many bones as its mesh has
+         */
+        bool set_pose(RenderableId id, std::span<const glm::mat4> bone_matrices);
+
+        /*!
+         * \brief Frees the space of meshes that no frame in flight reads anymore
+         *
+         * Call this once per frame, after the frame slot's fence has signaled
+         */
+        void begin_frame();
+
+        /*!
+         * \brief Records the dispatch that skins every skinned renderable into the frame slot's output buffer
+         *
+         * This must be recorded outside of any renderpass, and before anything draws the skinned renderables
+         */
+        void record_skinning(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx, FrameUploadAllocator& uploads);
+
+        /*!
+         * \brief The buffer that the provided frame slot's skinned vertices are in
+         */
+        [[nodiscard]] rhi::RhiBuffer* get_output_buffer(uint32_t frame_idx) const;
+
+        /*!
+         * \brief The buffer that every skinned mesh's indices are in. They're always 32-bit
+         */
+        [[nodiscard]] rhi::RhiBuffer* get_index_buffer() const;
+
+    private:
+        /*!
+         * \brief Matches `SkinningJob` in the skinning shader
+         */
+        struct SkinningJob {
+            uint32_t first_source_vertex;
+            uint32_t first_output_vertex;
+            uint32_t num_vertices;
+            uint32_t first_bone;
+        };
+
+        struct Renderable {
+            MeshId mesh = 0;
+
+            uint32_t first_output_vertex = 0;
+
+            uint32_t num_vertices = 0;
+
+            /*!
+             * \brief The first three rows of each bone's matrix. Bone matrices are always affine, so the last row is always 0, 0, 0, 1
+             */
+            std::vector<glm::vec4> bone_rows;
+        };
+
+        /*!
+         * \brief A mesh's space in the shared buffers, which in-flight frames may still be skinning from
+         */
+        struct RetiredMesh {
+            SkinnedMesh mesh;
+
+            uint32_t frames_left = 0;
+        };
+
+        struct FrameResources {
+            rhi::RhiBuffer* output_vertices = nullptr;
+
+            std::unique_ptr<RhiResourceBinder> binder;
+        };
+
+        rhi::RenderDevice& device;
+
+        uint32_t num_in_flight_frames;
+
+        std::unique_ptr<rhi::RhiPipeline> pipeline;
+
+        std::vector<FrameResources> frames;
+
+        rhi::RhiBuffer* source_vertices = nullptr;
+
+        rhi::RhiBuffer* skin_weights = nullptr;
+
+        rhi::RhiBuffer* indices = nullptr;
+
+        /*!
+         * \brief Hand out runs of vertices or indices, not bytes
+         */
+        mem::OffsetAllocator source_vertex_allocator;
+        mem::OffsetAllocator index_allocator;
+        mem::OffsetAllocator output_vertex_allocator;
+
+        std::unordered_map<MeshId, SkinnedMesh> meshes;
+
+        std::vector<RetiredMesh> retired_meshes;
+
+        std::unordered_map<RenderableId, Renderable> renderables;
+
+        std::vector<SkinningJob> jobs_scratch;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,156 @@
+#include "temporal_accumulation_upscaler.hpp"
+
+#include <array>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/frame_context.hpp"
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/renderpack_data.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "builtin_shaders.hpp"
+#include "frame_upload_allocator.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("TemporalUpscaler");
+
+    /*!
+     * \brief Each group fills in an 8x8 block of the output
+     */
+    constexpr uint32_t GROUP_SIZE = 8;
+
+    /*!
+     * \brief Matches `UpscaleParams` in the shader
+     */
+    struct UpscaleParams {
+        glm::uvec2 render_size;
+        glm::uvec2 output_size;
+        glm::vec2 jitter;
+        uint32_t reset_history;
+        uint32_t padding;
+    };
+
+    static rhi::RhiResourceBarrier make_history_barrier(rhi::RhiImage* image,
+                                                        const rhi::ResourceState old_state,
+                                                        const rhi::ResourceState new_state) {
+        rhi::RhiResourceBarrier barrier{};
+        barrier.resource_to_barrier = image;
+        barrier.old_state = old_state;
+        barrier.new_state = new_state;
+        barrier.access_before_barrier = old_state == rhi::ResourceState::ShaderWrite ? rhi::ResourceAccess::ShaderWrite :
+                                                                                       rhi::ResourceAccess::ShaderRead;
+        barrier.access_after_barrier = new_state == rhi::ResourceState::ShaderWrite ? rhi::ResourceAccess::ShaderWrite :
+                                                                                      rhi::ResourceAccess::ShaderRead;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    bool TemporalAccumulationUpscaler::create_resources(rhi::RenderDevice& device, const glm::uvec2 output_size) {
+        ZoneScoped;
+        if(!pipeline) {
+            const auto spirv = load_builtin_shader("temporal_accumulation.compute.hlsl", rhi::ShaderStage::Compute);
+            if(spirv.empty()) {
+                logger->error("Could not compile the temporal upscale shader");
+                return false;
+            }
+
+            RhiComputePipelineState pipeline_state{};
+            pipeline_state.name = "NovaTemporalAccumulation";
+            pipeline_state.compute_shader = {"/nova/shaders/temporal_accumulation.compute.hlsl", spirv};
+            pipeline = device.create_compute_pipeline(pipeline_state);
+            if(!pipeline) {
+                logger->error("Could not create the temporal upscale pipeline");
+                return false;
+            }
+
+            binder = device.create_resource_binder_for_pipeline(*pipeline);
+
+            rhi::RhiSamplerCreateInfo sampler_create_info{};
+            sampler_create_info.min_filter = rhi::TextureFilter::Bilinear;
+            sampler_create_info.mag_filter = rhi::TextureFilter::Bilinear;
+            history_sampler = device.create_sampler(sampler_create_info);
+            binder->bind_sampler("history_sampler", history_sampler);
+        }
+
+        for(uint32_t i = 0; i < history.size(); i++) {
+            renderpack::TextureCreateInfo history_create_info{};
+            history_create_info.name = i == 0 ? "NovaTemporalHistory0" : "NovaTemporalHistory1";
+            history_create_info.usage = renderpack::ImageUsage::RenderTarget;
+            history_create_info.format.pixel_format = rhi::PixelFormat::Rgba16F;
+            history_create_info.format.dimension_type = renderpack::TextureDimensionType::Absolute;
+            history_create_info.format.width = static_cast<float>(output_size.x);
+            history_create_info.format.height = static_cast<float>(output_size.y);
+
+            history[i] = device.create_image(history_create_info);
+            if(history[i] == nullptr) {
+                logger->error("Could not create the temporal upscaler's history");
+                destroy_resources(device);
+                return false;
+            }
+
+            history[i]->is_dynamic = false;
+            history_states[i] = rhi::ResourceState::Undefined;
+        }
+
+        return true;
+    }
+
+    void TemporalAccumulationUpscaler::destroy_resources(rhi::RenderDevice& device) {
+        for(auto*& image : history) {
+            if(image != nullptr) {
+                device.destroy_texture(image);
+                image = nullptr;
+            }
+        }
+    }
+
+    void TemporalAccumulationUpscaler::record_upscale(rhi::RhiRenderCommandList& cmds,
+                                                      const TemporalUpscaleInputs& inputs,
+                                                      FrameContext& ctx) {
+        ZoneScoped;
+        const auto prev_history = 1 - cur_history;
+        if(!pipeline || history[cur_history] == nullptr) {
+            return;
+        }
+
+        // Whatever's in a history texture that's never been written is garbage
+        const auto has_history = history_states[prev_history] == rhi::ResourceState::ShaderWrite;
+
+        const UpscaleParams params{.render_size = inputs.render_size,
+                                   .output_size = inputs.output_size,
+                                   .jitter = inputs.jitter,
+                                   .reset_history = inputs.reset_history || !has_history ? 1u : 0u,
+                                   .padding = 0};
+        const auto upload = ctx.frame_uploads->upload(&params, sizeof(params));
+        if(!upload) {
+            return;
+        }
+
+        const std::array barriers{make_history_barrier(history[prev_history], history_states[prev_history], rhi::ResourceState::ShaderRead),
+                                  make_history_barrier(history[cur_history], history_states[cur_history], rhi::ResourceState::ShaderWrite)};
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader, rhi::PipelineStage::ComputeShader, barriers);
+        history_states[prev_history] = rhi::ResourceState::ShaderRead;
+        history_states[cur_history] = rhi::ResourceState::ShaderWrite;
+
+        binder->bind_image("color", inputs.color);
+        binder->bind_image("motion_vectors", inputs.motion_vectors);
+        binder->bind_image("history", history[prev_history]);
+        binder->bind_image("output", inputs.output);
+        binder->bind_image("history_output", history[cur_history]);
+        binder->bind_buffer_range("params", upload->buffer, upload->offset, upload->size);
+
+        cmds.set_compute_pipeline(*pipeline);
+        cmds.bind_compute_resources(*binder, static_cast<uint32_t>(ctx.frame_idx));
+        cmds.dispatch((inputs.output_size.x + GROUP_SIZE - 1) / GROUP_SIZE, (inputs.output_size.y + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+        cur_history = prev_history;
+    }
+} // namespace nova::renderer
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+#include "nova_renderer/temporal_upscaler.hpp"
+
+namespace nova::renderer {
+    /*!
+     * \brief The temporal upscaler that Nova uses when the host application doesn't provide one
+     *
+     * Each output pixel blends the render pixel whose jittered sample landed closest to it into the history, reprojected with the motion
+     * vectors. The history is clamped to the colors around the new sample first, which is what keeps disocclusions and moving objects
+     * from ghosting. It's one dispatch with no sharpening or lock tracking, so it's softer than FSR2, but it works everywhere
+     */
+    class TemporalAccumulationUpscaler final : public TemporalUpscaler {
+    public:
+        bool create_resources(rhi::RenderDevice& device, glm::uvec2 output_size) override;
+
+        void destroy_resources(rhi::RenderDevice& device) override;
+
+        void record_upscale(rhi::RhiRenderCommandList& cmds, const TemporalUpscaleInputs& inputs, FrameContext& ctx) override;
+
+    private:
+        std::unique_ptr<rhi::RhiPipeline> pipeline;
+
+        std::unique_ptr<RhiResourceBinder> binder;
+
+        rhi::RhiSampler* history_sampler = nullptr;
+
+        /*!
+         * \brief Last frame's result and this frame's. Which is which flips every frame
+         */
+        std::array<rhi::RhiImage*, 2> history{};
+
+        std::array<rhi::ResourceState, 2> history_states{rhi::ResourceState::Undefined, rhi::ResourceState::Undefined};
+
+        uint32_t cur_history = 0;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,27 @@
+#include "nova_renderer/temporal_upscaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nova::renderer {
+    static float halton(uint32_t index, const uint32_t base) {
+        float fraction = 1;
+        float result = 0;
+        while(index > 0) {
+            fraction /= static_cast<float>(base);
+            result += fraction * static_cast<float>(index % base);
+            index /= base;
+        }
+
+        return result;
+    }
+
+    glm::vec2 TemporalUpscaler::get_jitter(const uint64_t frame_count, const glm::uvec2 render_size, const glm::uvec2 output_size) const {
+        const auto scale = render_size.x > 0 ? static_cast<float>(output_size.x) / static_cast<float>(render_size.x) : 1.0f;
+        const auto num_phases = std::max(static_cast<uint32_t>(std::ceil(8.0f * scale * scale)), 1u);
+
+        // Index zero of the sequence is the middle of the pixel on both axes, which would be the same sample from two phases
+        const auto index = static_cast<uint32_t>(frame_count % num_phases) + 1;
+        return {halton(index, 2) - 0.5f, halton(index, 3) - 0.5f};
+    }
+} // namespace nova::renderer
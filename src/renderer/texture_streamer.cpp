@@ -0,0 +1,325 @@
+#include "texture_streamer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+#include "nova_renderer/util/task_scheduler.hpp"
+
+#include "upload_batcher.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("TextureStreamer");
+
+    static uint32_t get_mip_size(const uint32_t size, const uint32_t mip) { return std::max(size >> mip, 1U); }
+
+    static uint64_t get_mip_chain_size(const StreamedTextureCreateInfo& info, const uint32_t first_mip) {
+        uint64_t num_bytes = 0;
+        for(uint32_t mip = first_mip; mip < info.num_mips; mip++) {
+            num_bytes += get_image_size_in_bytes(info.format, get_mip_size(info.width, mip), get_mip_size(info.height, mip));
+        }
+
+        return num_bytes;
+    }
+
+    TextureStreamer::TextureStreamer(rhi::RenderDevice& device,
+                                     DeviceResources& device_resources,
+                                     UploadBatcher& upload_batcher,
+                                     ResidencyManager& residency,
+                                     TaskScheduler& task_scheduler,
+                                     const NovaSettings::TextureStreamingOptions& options,
+                                     const uint32_t num_in_flight_frames,
+                                     const float eviction_threshold)
+        : device{device},
+          device_resources{device_resources},
+          upload_batcher{upload_batcher},
+          residency{residency},
+          task_scheduler{task_scheduler},
+          options{options},
+          num_in_flight_frames{num_in_flight_frames},
+          eviction_threshold{eviction_threshold} {}
+
+    TextureStreamer::~TextureStreamer() {
+        for(auto& [texture_idx, texture] : textures) {
+            if(texture.tail_image != nullptr) {
+                device.destroy_texture(texture.tail_image);
+            }
+            if(texture.streamed_image != nullptr) {
+                device.destroy_texture(texture.streamed_image);
+            }
+        }
+
+        for(const RetiredImage& retired : retired_images) {
+            device.destroy_texture(retired.image);
+        }
+    }
+
+    std::optional<uint32_t> TextureStreamer::add_texture(StreamedTextureCreateInfo create_info) {
+        ZoneScoped;
+        if(create_info.width == 0 || create_info.height == 0 || !create_info.load_mip) {
+            logger->error("Streamed texture {} needs a size and a function to load its mips", create_info.name);
+            return std::nullopt;
+        }
+
+        if(create_info.generate_mips && (rhi::is_block_compressed_format(create_info.format) || rhi::is_depth_format(create_info.format))) {
+            logger->error("Streamed texture {} can't generate its mips on the GPU, its format can't be filtered", create_info.name);
+            return std::nullopt;
+        }
+
+        const auto full_chain_length = static_cast<uint32_t>(std::bit_width(std::max(create_info.width, create_info.height)));
+        if(create_info.num_mips == 0 || create_info.num_mips > full_chain_length) {
+            create_info.num_mips = full_chain_length;
+        }
+
+        const auto texture = device_resources.create_empty_texture(create_info.name,
+                                                                   create_info.width,
+                                                                   create_info.height,
+                                                                   create_info.format);
+        if(!texture) {
+            return std::nullopt;
+        }
+        const auto texture_idx = static_cast<uint32_t>(texture->get_idx());
+
+        StreamedTexture streamed_texture = {};
+        streamed_texture.create_info = std::move(create_info);
+
+        const auto& info = streamed_texture.create_info;
+        while(!info.generate_mips && streamed_texture.tail_mip + 1 < info.num_mips &&
+              std::max(get_mip_size(info.width, streamed_texture.tail_mip), get_mip_size(info.height, streamed_texture.tail_mip)) >
+                  options.always_resident_size) {
+            streamed_texture.tail_mip++;
+        }
+
+        streamed_texture.resident_mip = info.num_mips;
+        streamed_texture.requested_mip = streamed_texture.tail_mip;
+
+        // The tail doesn't count against `max_loads_in_flight`. It's small, and the texture is useless without it
+        start_load(streamed_texture, streamed_texture.tail_mip);
+
+        textures.emplace(texture_idx, std::move(streamed_texture));
+
+        return texture_idx;
+    }
+
+    void TextureStreamer::remove_texture(const uint32_t texture_idx) {
+        const auto itr = textures.find(texture_idx);
+        if(itr == textures.end()) {
+            logger->error("Texture {} isn't a streamed texture", texture_idx);
+            return;
+        }
+
+        auto& texture = itr->second;
+        if(texture.residency_id) {
+            residency.remove_resource(*texture.residency_id);
+        }
+
+        if(texture.load) {
+            // The loader keeps running on its worker, and its data gets thrown away when it's done
+            num_loads_in_flight--;
+        }
+
+        retire_image(texture.tail_image);
+        retire_image(texture.streamed_image);
+
+        device_resources.remove_texture(texture_idx);
+        textures.erase(itr);
+    }
+
+    void TextureStreamer::request_resolution(const uint32_t texture_idx, const float screen_size) {
+        const auto itr = textures.find(texture_idx);
+        if(itr == textures.end()) {
+            return;
+        }
+
+        auto& texture = itr->second;
+        const auto texture_size = static_cast<float>(std::max(texture.create_info.width, texture.create_info.height));
+
+        // Every mip is half the size of the one before it, so the mip whose size matches the screen size is the log of their ratio
+        uint32_t wanted_mip = texture.tail_mip;
+        if(screen_size > 0) {
+            const auto mip = std::floor(std::log2(texture_size / screen_size));
+            wanted_mip = static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(texture.tail_mip)));
+        }
+
+        texture.requested_mip = std::min(texture.requested_mip, wanted_mip);
+
+        if(texture.residency_id) {
+            residency.mark_used(*texture.residency_id);
+        }
+    }
+
+    void TextureStreamer::update(const uint64_t frame_count, const std::vector<rhi::RhiMemoryHeapBudget>& budgets) {
+        ZoneScoped;
+        this->frame_count = frame_count;
+
+        std::erase_if(retired_images, [&](const RetiredImage& retired) {
+            if(frame_count - retired.retired_frame < num_in_flight_frames) {
+                return false;
+            }
+
+            device.destroy_texture(retired.image);
+            return true;
+        });
+
+        for(auto& [texture_idx, texture] : textures) {
+            if(texture.load && texture.load->wait_for(std::chrono::seconds{0}) == std::future_status::ready) {
+                auto loaded = texture.load->get();
+                texture.load.reset();
+                num_loads_in_flight--;
+
+                finish_load(texture_idx, texture, std::move(loaded));
+            }
+        }
+
+        // Streaming more in when we're about to evict would only make the residency manager throw out something else
+        const auto is_over_budget = std::any_of(budgets.begin(), budgets.end(), [&](const rhi::RhiMemoryHeapBudget& budget) {
+            return budget.is_device_local && static_cast<double>(budget.usage) > static_cast<double>(budget.budget) * eviction_threshold;
+        });
+
+        candidates_scratch.clear();
+        for(auto& [texture_idx, texture] : textures) {
+            // Loads build on the tail, so nothing else is loaded until the tail is in
+            if(!is_over_budget && !texture.load && !texture.load_failed && texture.tail_image != nullptr &&
+               texture.requested_mip < texture.resident_mip) {
+                candidates_scratch.push_back(
+                    {texture_idx, texture.resident_mip - texture.requested_mip, texture.create_info.residency_priority});
+            }
+
+            texture.requested_mip = texture.tail_mip;
+        }
+
+        // The textures that are the furthest from the resolution they're drawn at look the worst, so they go first
+        std::sort(candidates_scratch.begin(), candidates_scratch.end(), [](const LoadCandidate& lhs, const LoadCandidate& rhs) {
+            if(lhs.num_missing_mips != rhs.num_missing_mips) {
+                return lhs.num_missing_mips > rhs.num_missing_mips;
+            }
+
+            return lhs.priority > rhs.priority;
+        });
+
+        for(const LoadCandidate& candidate : candidates_scratch) {
+            if(num_loads_in_flight >= options.max_loads_in_flight) {
+                break;
+            }
+
+            auto& texture = textures.at(candidate.texture_idx);
+            start_load(texture, texture.resident_mip - candidate.num_missing_mips);
+        }
+
+        TracyPlot("Streamed texture loads in flight", static_cast<int64_t>(num_loads_in_flight));
+    }
+
+    void TextureStreamer::start_load(StreamedTexture& texture, const uint32_t first_mip) {
+        num_loads_in_flight++;
+
+        // When the GPU makes the smaller mips, only mip 0 comes from disk
+        const auto last_loaded_mip = texture.create_info.generate_mips ? first_mip + 1 : texture.create_info.num_mips;
+
+        texture.load = task_scheduler.add_task(
+            [load_mip = texture.create_info.load_mip, first_mip, last_loaded_mip](uint32_t /* thread_idx */) {
+                ZoneScoped;
+                LoadedMips loaded;
+                loaded.first_mip = first_mip;
+                loaded.mips.reserve(last_loaded_mip - first_mip);
+
+                for(uint32_t mip = first_mip; mip < last_loaded_mip; mip++) {
+                    loaded.mips.push_back(load_mip(mip));
+                }
+
+                return loaded;
+            });
+    }
+
+    void TextureStreamer::finish_load(const uint32_t texture_idx, StreamedTexture& texture, LoadedMips loaded) {
+        ZoneScoped;
+        const auto& info = texture.create_info;
+        const auto first_mip = loaded.first_mip;
+
+        std::vector<UploadBatcher::ImageMipData> mip_data;
+        mip_data.reserve(loaded.mips.size());
+
+        for(uint32_t i = 0; i < loaded.mips.size(); i++) {
+            const auto width = get_mip_size(info.width, first_mip + i);
+            const auto height = get_mip_size(info.height, first_mip + i);
+            const auto expected_size = get_image_size_in_bytes(info.format, width, height);
+
+            if(loaded.mips[i].size() != expected_size) {
+                logger->error("Mip {} of streamed texture {} is {} bytes, but it should be {}",
+                              first_mip + i,
+                              info.name,
+                              loaded.mips[i].size(),
+                              expected_size);
+                texture.load_failed = true;
+                return;
+            }
+
+            mip_data.push_back({width, height, loaded.mips[i].data(), expected_size});
+        }
+
+        renderpack::TextureCreateInfo create_info = {};
+        create_info.name = fmt::format("{}Mip{}", info.name, first_mip);
+        create_info.usage = renderpack::ImageUsage::SampledImage;
+        create_info.format.pixel_format = info.format;
+        create_info.format.dimension_type = renderpack::TextureDimensionType::Absolute;
+        create_info.format.width = static_cast<float>(get_mip_size(info.width, first_mip));
+        create_info.format.height = static_cast<float>(get_mip_size(info.height, first_mip));
+        create_info.residency_priority = info.residency_priority;
+        create_info.num_mips = info.num_mips - first_mip;
+
+        auto* image = device.create_image(create_info);
+        if(image == nullptr) {
+            logger->error("Could not create an image for mip {} and up of streamed texture {}", first_mip, info.name);
+            return;
+        }
+        image->is_dynamic = false;
+
+        upload_batcher.upload_to_image(image,
+                                       mip_data,
+                                       rhi::PipelineStage::VertexShader,
+                                       create_info.num_mips - static_cast<uint32_t>(mip_data.size()));
+
+        if(texture.tail_image == nullptr) {
+            texture.tail_image = image;
+
+        } else {
+            if(texture.residency_id) {
+                residency.remove_resource(*texture.residency_id);
+            }
+
+            texture.residency_id = residency.add_resource(get_mip_chain_size(info, first_mip),
+                                                          info.residency_priority,
+                                                          [this, texture_idx] { evict(texture_idx); });
+
+            retire_image(texture.streamed_image);
+            texture.streamed_image = image;
+        }
+
+        // The old image is either the tail, which we keep, or the streamed image we just retired
+        device_resources.set_texture_image(texture_idx, image);
+        texture.resident_mip = first_mip;
+    }
+
+    void TextureStreamer::evict(const uint32_t texture_idx) {
+        auto& texture = textures.at(texture_idx);
+
+        // The residency manager has already forgotten about the image
+        texture.residency_id.reset();
+
+        device_resources.set_texture_image(texture_idx, texture.tail_image);
+        retire_image(texture.streamed_image);
+        texture.streamed_image = nullptr;
+        texture.resident_mip = texture.tail_mip;
+    }
+
+    void TextureStreamer::retire_image(rhi::RhiImage* image) {
+        if(image != nullptr) {
+            retired_images.push_back({image, frame_count});
+        }
+    }
+} // namespace nova::renderer
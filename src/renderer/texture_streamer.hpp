@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/resource_loader.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+#include "residency_manager.hpp"
+
+namespace nova::renderer {
+    class TaskScheduler;
+    class UploadBatcher;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Keeps the mips of streamed textures in device memory when something draws them large enough to need them
+     *
+     * Every streamed texture has a tail of small mips that's loaded when the texture is added, and stays until the texture is removed.
+     * The mips above the tail are loaded on demand. Whoever draws a texture says how many pixels it covers on screen, and the streamer
+     * loads the mips that many pixels need, starting with the textures that are the most mips short of what they need
+     *
+     * Mips can't be added to an image that the GPU may be sampling, so a load creates a new image with every mip from the new largest one
+     * down, uploads all of them through the upload batcher, and swaps the new image into the texture's slot. The slot never moves, so
+     * shaders don't notice. Streamed-in images are registered with the residency manager, which throws them out when nobody asked for them
+     * recently and memory runs low. That puts the texture back to its tail
+     *
+     * This class is not thread-safe. Use it from the thread that calls `NovaRenderer::execute_frame`
+     */
+    class TextureStreamer {
+    public:
+        /*!
+         * \param eviction_threshold Nothing new is streamed in while device-local memory usage is over this fraction of the budget
+         */
+        TextureStreamer(rhi::RenderDevice& device,
+                        DeviceResources& device_resources,
+                        UploadBatcher& upload_batcher,
+                        ResidencyManager& residency,
+                        TaskScheduler& task_scheduler,
+                        const NovaSettings::TextureStreamingOptions& options,
+                        uint32_t num_in_flight_frames,
+                        float eviction_threshold);
+
+        TextureStreamer(const TextureStreamer& other) = delete;
+        TextureStreamer& operator=(const TextureStreamer& other) = delete;
+
+        TextureStreamer(TextureStreamer&& old) noexcept = delete;
+        TextureStreamer& operator=(TextureStreamer&& old) noexcept = delete;
+
+        /*!
+         * \brief Destroys every image the streamer made. The GPU must be done with all of them
+         */
+        ~TextureStreamer();
+
+        /*!
+         * \brief Adds a texture, and starts loading its tail mips
+         *
+         * \return The texture's index in the textures array, or nothing if the create info doesn't make sense
+         */
+        [[nodiscard]] std::optional<uint32_t> add_texture(StreamedTextureCreateInfo create_info);
+
+        void remove_texture(uint32_t texture_idx);
+
+        /*!
+         * \brief Tells the streamer how large a texture is drawn in the current frame
+         *
+         * \param texture_idx The texture's index in the textures array
+         * \param screen_size The most pixels that the texture's width or height covers on screen
+         */
+        void request_resolution(uint32_t texture_idx, float screen_size);
+
+        /*!
+         * \brief Swaps in the textures whose mips finished loading, then starts loading the mips that were requested since the last update
+         *
+         * Call this once per frame, after the residency manager's `begin_frame` and before the upload batcher is flushed
+         */
+        void update(uint64_t frame_count, const std::vector<rhi::RhiMemoryHeapBudget>& budgets);
+
+    private:
+        /*!
+         * \brief The data of every mip from `first_mip` to the end of the chain
+         */
+        struct LoadedMips {
+            uint32_t first_mip = 0;
+
+            std::vector<std::vector<uint8_t>> mips;
+        };
+
+        struct StreamedTexture {
+            StreamedTextureCreateInfo create_info;
+
+            /*!
+             * \brief The largest mip of the tail
+             */
+            uint32_t tail_mip = 0;
+
+            rhi::RhiImage* tail_image = nullptr;
+
+            /*!
+             * \brief The image with mips above the tail, if any are resident
+             */
+            rhi::RhiImage* streamed_image = nullptr;
+
+            /*!
+             * \brief The largest mip that shaders can sample. `create_info.num_mips` while the tail is still loading
+             */
+            uint32_t resident_mip = 0;
+
+            /*!
+             * \brief The largest mip that was asked for since the last update
+             */
+            uint32_t requested_mip = 0;
+
+            std::optional<std::future<LoadedMips>> load;
+
+            std::optional<ResidencyManager::ResourceId> residency_id;
+
+            /*!
+             * \brief Set when the loader gave us data we can't use. We don't try to stream such a texture in again
+             */
+            bool load_failed = false;
+        };
+
+        struct RetiredImage {
+            rhi::RhiImage* image;
+
+            uint64_t retired_frame;
+        };
+
+        rhi::RenderDevice& device;
+
+        DeviceResources& device_resources;
+
+        UploadBatcher& upload_batcher;
+
+        ResidencyManager& residency;
+
+        TaskScheduler& task_scheduler;
+
+        NovaSettings::TextureStreamingOptions options;
+
+        uint32_t num_in_flight_frames;
+
+        float eviction_threshold;
+
+        /*!
+         * \brief Every streamed texture, by its index in the textures array
+         */
+        std::unordered_map<uint32_t, StreamedTexture> textures;
+
+        /*!
+         * \brief Images that were swapped out, and the frame they were swapped out in. They're destroyed once every frame that might have
+         * sampled them is done
+         */
+        std::vector<RetiredImage> retired_images;
+
+        uint32_t num_loads_in_flight = 0;
+
+        uint64_t frame_count = 0;
+
+        struct LoadCandidate {
+            uint32_t texture_idx;
+
+            uint32_t num_missing_mips;
+
+            float priority;
+        };
+
+        std::vector<LoadCandidate> candidates_scratch;
+
+        void start_load(StreamedTexture& texture, uint32_t first_mip);
+
+        void finish_load(uint32_t texture_idx, StreamedTexture& texture, LoadedMips loaded);
+
+        /*!
+         * \brief Puts a texture back to its tail mips
+         */
+        void evict(uint32_t texture_idx);
+
+        void retire_image(rhi::RhiImage* image);
+    };
+} // namespace nova::renderer
@@ -0,0 +1,600 @@
+#include "nova_renderer/ui_batcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <Tracy.hpp>
+#include <glm/gtc/packing.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/frame_context.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/rhi/swapchain.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "../builtin_shaders.hpp"
+#include "../frame_upload_allocator.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("UiBatcher");
+
+    constexpr const char* UI_BATCH_PIPELINE_NAME = "NovaUiBatch";
+
+    /*!
+     * \brief The most quads that one draw can have, which is as many as 16-bit indices can reach
+     */
+    constexpr uint32_t MAX_QUADS_PER_DRAW = 65536 / 4;
+
+    /*!
+     * \brief Every image in the atlas has this many pixels of padding around it, so the bilinear filter never blends in its neighbors
+     */
+    constexpr uint32_t ATLAS_PADDING = 1;
+
+    /*!
+     * \brief Matches `UiParams` in the UI vertex shader
+     */
+    struct UiParams {
+        glm::vec2 inverse_screen_size;
+    };
+
+    static rhi::RhiResourceBarrier make_atlas_barrier(rhi::RhiImage* atlas,
+                                                      const rhi::ResourceState old_state,
+                                                      const rhi::ResourceState new_state,
+                                                      const rhi::ResourceAccess access_before,
+                                                      const rhi::ResourceAccess access_after) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = atlas;
+        barrier.old_state = old_state;
+        barrier.new_state = new_state;
+        barrier.access_before_barrier = access_before;
+        barrier.access_after_barrier = access_after;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    static UiRect intersect(const UiRect& a, const UiRect& b) {
+        const auto min = glm::max(a.position, b.position);
+        const auto max = glm::min(a.position + a.size, b.position + b.size);
+        return {min, glm::max(max - min, glm::vec2{0})};
+    }
+
+    size_t UiBatcher::GlyphKeyHash::operator()(const GlyphKey& key) const {
+        return std::hash<uint64_t>{}(uint64_t{key.font} << 32 | key.codepoint);
+    }
+
+    UiBatcher::UiBatcher(rhi::RenderDevice& device,
+                         rhi::RhiSampler* sampler,
+                         const NovaSettings::UiBatchingOptions& options,
+                         const uint32_t num_in_flight_frames)
+        : device{device}, options{options} {
+        ZoneScoped;
+        const auto vertex_spirv = load_builtin_shader("ui_batch.vertex.hlsl", rhi::ShaderStage::Vertex);
+        const auto pixel_spirv = load_builtin_shader("ui_batch.pixel.hlsl", rhi::ShaderStage::Pixel);
+        if(vertex_spirv.empty() || pixel_spirv.empty()) {
+            logger->error("Could not compile the UI batch shaders, so batched UI won't be drawn");
+
+        } else {
+            RhiGraphicsPipelineState state = {};
+            state.name = UI_BATCH_PIPELINE_NAME;
+            state.vertex_shader = ShaderSource{"/nova/shaders/ui_batch.vertex.hlsl", vertex_spirv};
+            state.pixel_shader = ShaderSource{"/nova/shaders/ui_batch.pixel.hlsl", pixel_spirv};
+            state.vertex_fields = {{"position", rhi::VertexFieldFormat::Float2},
+                                   {"uv", rhi::VertexFieldFormat::Float2},
+                                   {"shape", rhi::VertexFieldFormat::Float4},
+                                   {"corner", rhi::VertexFieldFormat::Float2},
+                                   {"color", rhi::VertexFieldFormat::Uint},
+                                   {"texture_id", rhi::VertexFieldFormat::Uint}};
+            state.viewport_size = device.get_swapchain()->get_size();
+            state.enable_scissor_test = true;
+            state.rasterizer_state.cull_mode = PrimitiveCullingMode::None;
+            state.depth_state.reset();
+
+            // The backbuffer output blends the UI over the scene by the UI's alpha, so alpha has to add up like coverage does
+            RenderTargetBlendState blend = {};
+            blend.enable = true;
+            blend.src_alpha_factor = BlendFactor::One;
+            state.blend_state = BlendState{{blend}};
+
+            state.color_attachments.emplace_back(UI_OUTPUT_RT_NAME, rhi::PixelFormat::Rgba8, false);
+
+            pipeline = device.create_global_pipeline(state);
+        }
+
+        renderpack::TextureCreateInfo atlas_create_info = {};
+        atlas_create_info.name = "NovaUiAtlas";
+        atlas_create_info.usage = renderpack::ImageUsage::SampledImage;
+        atlas_create_info.format.pixel_format = rhi::PixelFormat::Rgba8;
+        atlas_create_info.format.dimension_type = renderpack::TextureDimensionType::Absolute;
+        atlas_create_info.format.width = static_cast<float>(options.atlas_size);
+        atlas_create_info.format.height = static_cast<float>(options.atlas_size);
+
+        atlas = device.create_image(atlas_create_info);
+        if(atlas != nullptr) {
+            atlas->is_dynamic = false;
+        } else {
+            logger->error("Could not create the UI atlas");
+        }
+
+        // Textures that nobody added sample the atlas, so that every element of the array is something
+        textures.fill(atlas);
+
+        if(pipeline && atlas != nullptr) {
+            binder = device.create_resource_binder_for_pipeline(*pipeline);
+            binder->bind_image_array("textures", {textures.begin(), textures.end()});
+            binder->bind_sampler("tex_sampler", sampler);
+        }
+
+        // Every quad uses the same six indices, so one index buffer covers every draw
+        std::vector<uint16_t> indices;
+        indices.reserve(size_t{MAX_QUADS_PER_DRAW} * 6);
+        for(uint32_t quad = 0; quad < MAX_QUADS_PER_DRAW; quad++) {
+            const auto first_vertex = static_cast<uint16_t>(quad * 4);
+            for(const uint16_t corner : {0, 1, 2, 2, 1, 3}) {
+                indices.push_back(static_cast<uint16_t>(first_vertex + corner));
+            }
+        }
+
+        const auto indices_size = indices.size() * sizeof(uint16_t);
+        index_buffer = device.create_buffer({"NovaUiIndices", indices_size, rhi::BufferUsage::HostVisibleMeshBuffer});
+        device.write_data_to_buffer(indices.data(), indices_size, index_buffer);
+        device.flush_buffer(index_buffer, 0, indices_size);
+
+        frames.resize(num_in_flight_frames);
+        for(uint32_t i = 0; i < num_in_flight_frames; i++) {
+            ensure_vertex_capacity(frames[i], std::max(options.initial_quad_capacity, 1U));
+        }
+
+        const std::array<uint8_t, 4> white_pixel{255, 255, 255, 255};
+        if(const auto white_corner = allocate_atlas_rect(1, 1, false)) {
+            white_image = queue_atlas_upload(*white_corner, 1, 1, white_pixel.data(), true);
+
+            // Sampling the middle of the pixel keeps the filter from reaching the padding
+            white_image.min_uv = white_image.max_uv = (white_image.min_uv + white_image.max_uv) * 0.5f;
+        }
+
+        clip_rects.push_back({{0, 0}, {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()}});
+    }
+
+    UiBatcher::~UiBatcher() {
+        for(const FrameResources& frame : frames) {
+            if(frame.vertices != nullptr) {
+                device.destroy_buffer(frame.vertices);
+            }
+        }
+
+        device.destroy_buffer(index_buffer);
+
+        if(atlas != nullptr) {
+            device.destroy_texture(atlas);
+        }
+    }
+
+    std::optional<UiTextureId> UiBatcher::add_texture(rhi::RhiImage* image) {
+        for(UiTextureId texture = 1; texture < MAX_TEXTURES; texture++) {
+            if(textures[texture] == atlas) {
+                textures[texture] = image;
+                if(binder) {
+                    binder->bind_image_array("textures", {textures.begin(), textures.end()});
+                }
+
+                return texture;
+            }
+        }
+
+        logger->error("The UI batcher already has {} textures, which is as many as it can bind", MAX_TEXTURES);
+        return std::nullopt;
+    }
+
+    void UiBatcher::remove_texture(const UiTextureId texture) {
+        if(texture == 0 || texture >= MAX_TEXTURES) {
+            return;
+        }
+
+        textures[texture] = atlas;
+        if(binder) {
+            binder->bind_image_array("textures", {textures.begin(), textures.end()});
+        }
+    }
+
+    std::optional<UiImage> UiBatcher::add_image(const uint32_t width, const uint32_t height, const uint8_t* pixels) {
+        if(width == 0 || height == 0) {
+            return std::nullopt;
+        }
+
+        const auto corner = allocate_atlas_rect(width, height, false);
+        if(!corner) {
+            logger->error("The UI atlas has no room for a {}x{} image. Raise `NovaSettings::UiBatchingOptions::atlas_size`", width, height);
+            return std::nullopt;
+        }
+
+        return queue_atlas_upload(*corner, width, height, pixels, true);
+    }
+
+    void UiBatcher::set_glyph_rasterizer(UiGlyphRasterizer rasterizer) {
+        glyph_rasterizer = std::move(rasterizer);
+        evict_glyphs();
+    }
+
+    void UiBatcher::push_clip_rect(const UiRect& rect) {
+        const auto& parent = clip_rects[clip_rect_stack.empty() ? 0 : clip_rect_stack.back()];
+        const auto clipped = intersect(parent, rect);
+
+        // Widgets in a list tend to share their clip rect, and sharing its index lets them share draws
+        const auto itr = std::find_if(clip_rects.begin(), clip_rects.end(), [&](const UiRect& existing) {
+            return existing.position == clipped.position && existing.size == clipped.size;
+        });
+        if(itr != clip_rects.end()) {
+            clip_rect_stack.push_back(static_cast<uint32_t>(itr - clip_rects.begin()));
+
+        } else {
+            clip_rect_stack.push_back(static_cast<uint32_t>(clip_rects.size()));
+            clip_rects.push_back(clipped);
+        }
+    }
+
+    void UiBatcher::pop_clip_rect() {
+        if(!clip_rect_stack.empty()) {
+            clip_rect_stack.pop_back();
+        }
+    }
+
+    void UiBatcher::set_layer(const uint32_t new_layer) { layer = new_layer; }
+
+    void UiBatcher::add_quad(const UiRect& rect, const glm::vec4& color, const UiImage& image) {
+        const auto packed_color = glm::packUnorm4x8(color);
+        const auto texture = image.texture < MAX_TEXTURES ? image.texture : 0;
+
+        // Untextured quads are the white pixel, tinted
+        const auto& source = image.texture == 0 && image.upload_serial == 0 ? white_image : image;
+
+        const auto min = rect.position;
+        const auto max = rect.position + rect.size;
+        const glm::vec4 no_shape{0};
+        const glm::vec2 not_rounded{-1, 0};
+
+        add_vertices({UiVertex{min, source.min_uv, no_shape, not_rounded, packed_color, texture},
+                      UiVertex{{max.x, min.y}, {source.max_uv.x, source.min_uv.y}, no_shape, not_rounded, packed_color, texture},
+                      UiVertex{{min.x, max.y}, {source.min_uv.x, source.max_uv.y}, no_shape, not_rounded, packed_color, texture},
+                      UiVertex{max, source.max_uv, no_shape, not_rounded, packed_color, texture}},
+                     source.upload_serial);
+    }
+
+    void UiBatcher::add_rounded_rect(const UiRect& rect, const glm::vec4& color, const float radius, const float border_width) {
+        const auto packed_color = glm::packUnorm4x8(color);
+        const auto half_size = rect.size * 0.5f;
+        const glm::vec2 corner{glm::clamp(radius, 0.0f, std::min(half_size.x, half_size.y)), border_width};
+        const auto uv = white_image.min_uv;
+
+        const auto min = rect.position;
+        const auto max = rect.position + rect.size;
+
+        add_vertices({UiVertex{min, uv, {-half_size.x, -half_size.y, half_size}, corner, packed_color, 0},
+                      UiVertex{{max.x, min.y}, uv, {half_size.x, -half_size.y, half_size}, corner, packed_color, 0},
+                      UiVertex{{min.x, max.y}, uv, {-half_size.x, half_size.y, half_size}, corner, packed_color, 0},
+                      UiVertex{max, uv, {half_size.x, half_size.y, half_size}, corner, packed_color, 0}},
+                     white_image.upload_serial);
+    }
+
+    glm::vec2 UiBatcher::add_text(const uint32_t font, const std::u32string_view text, const glm::vec2& baseline, const glm::vec4& color) {
+        auto pen = baseline;
+        for(const char32_t codepoint : text) {
+            const auto* glyph = get_glyph(font, codepoint);
+            if(glyph == nullptr) {
+                continue;
+            }
+
+            if(glyph->size.x > 0 && glyph->size.y > 0) {
+                add_quad({glm::round(pen + glyph->bearing), glyph->size}, color, glyph->image);
+            }
+
+            pen.x += glyph->advance;
+        }
+
+        return pen;
+    }
+
+    void UiBatcher::record_atlas_uploads(rhi::RhiRenderCommandList& cmds, FrameUploadAllocator& frame_uploads) {
+        // The atlas is transitioned on the first frame even if nothing's queued, so its layout matches its descriptor
+        if(atlas == nullptr || (pending_uploads.empty() && is_atlas_initialized)) {
+            return;
+        }
+
+        ZoneScoped;
+        const auto old_state = is_atlas_initialized ? rhi::ResourceState::ShaderRead : rhi::ResourceState::Undefined;
+        const auto stages_before_copies = is_atlas_initialized ? rhi::PipelineStage::FragmentShader : rhi::PipelineStage::TopOfPipe;
+        cmds.resource_barriers(stages_before_copies,
+                               rhi::PipelineStage::Transfer,
+                               std::array{make_atlas_barrier(atlas,
+                                                             old_state,
+                                                             rhi::ResourceState::CopyDestination,
+                                                             rhi::ResourceAccess::ShaderRead,
+                                                             rhi::ResourceAccess::CopyWrite)});
+
+        size_t num_uploaded = 0;
+        for(; num_uploaded < pending_uploads.size(); num_uploaded++) {
+            const auto& upload = pending_uploads[num_uploaded];
+
+            // The rest wait for next frame's region. They stay in order, so `last_recorded_upload` still covers everything before it
+            const auto staging = frame_uploads.upload(upload.pixels.data(), upload.pixels.size());
+            if(!staging) {
+                break;
+            }
+
+            cmds.copy_buffer_to_image(atlas, 0, upload.x, upload.y, upload.width, upload.height, staging->buffer, staging->offset);
+            last_recorded_upload = upload.serial;
+        }
+        pending_uploads.erase(pending_uploads.begin(), pending_uploads.begin() + static_cast<ptrdiff_t>(num_uploaded));
+
+        cmds.resource_barriers(rhi::PipelineStage::Transfer,
+                               rhi::PipelineStage::FragmentShader,
+                               std::array{make_atlas_barrier(atlas,
+                                                             rhi::ResourceState::CopyDestination,
+                                                             rhi::ResourceState::ShaderRead,
+                                                             rhi::ResourceAccess::CopyWrite,
+                                                             rhi::ResourceAccess::ShaderRead)});
+
+        is_atlas_initialized = true;
+    }
+
+    void UiBatcher::record_draws(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        if(quads.empty()) {
+            return;
+        }
+
+        if(!binder || !is_atlas_initialized) {
+            quads.clear();
+            return;
+        }
+
+        ZoneScoped;
+
+        // Quads whose pixels aren't in the atlas yet would draw whatever was there before
+        sorted_quads.clear();
+        for(uint32_t i = 0; i < quads.size(); i++) {
+            if(quads[i].upload_serial <= last_recorded_upload) {
+                sorted_quads.push_back(i);
+            }
+        }
+
+        std::stable_sort(sorted_quads.begin(), sorted_quads.end(), [&](const uint32_t a, const uint32_t b) {
+            const auto& quad_a = quads[a];
+            const auto& quad_b = quads[b];
+            return quad_a.layer != quad_b.layer ? quad_a.layer < quad_b.layer : quad_a.clip_rect < quad_b.clip_rect;
+        });
+
+        const auto num_quads = static_cast<uint32_t>(sorted_quads.size());
+        auto& frame = frames[ctx.frame_idx];
+        if(num_quads == 0 || !ensure_vertex_capacity(frame, num_quads)) {
+            quads.clear();
+            return;
+        }
+
+        vertex_scratch.clear();
+        vertex_scratch.reserve(size_t{num_quads} * 4);
+        for(const uint32_t quad : sorted_quads) {
+            vertex_scratch.insert(vertex_scratch.end(), quads[quad].vertices.begin(), quads[quad].vertices.end());
+        }
+
+        const auto vertices_size = vertex_scratch.size() * sizeof(UiVertex);
+        device.write_data_to_buffer(vertex_scratch.data(), vertices_size, frame.vertices);
+        device.flush_buffer(frame.vertices, 0, vertices_size);
+
+        const auto screen_size = device.get_swapchain()->get_size();
+        const UiParams params{1.0f / glm::vec2{glm::max(screen_size, glm::uvec2{1})}};
+        if(const auto upload = ctx.frame_uploads->upload(&params, sizeof(params)); upload) {
+            binder->bind_buffer_range("params", upload->buffer, upload->offset, upload->size);
+        }
+
+        cmds.set_pipeline(*pipeline);
+        cmds.bind_resources(*binder, static_cast<uint32_t>(ctx.frame_idx));
+        cmds.bind_vertex_buffers({frame.vertices});
+        cmds.bind_index_buffer(index_buffer, rhi::IndexType::Uint16);
+
+        const UiRect screen{{0, 0}, glm::vec2{screen_size}};
+        uint32_t first_quad = 0;
+        while(first_quad < num_quads) {
+            const auto& first = quads[sorted_quads[first_quad]];
+
+            // A draw ends where the clip rect changes, or where the indices run out
+            auto last_quad = first_quad + 1;
+            while(last_quad < num_quads && last_quad - first_quad < MAX_QUADS_PER_DRAW &&
+                  quads[sorted_quads[last_quad]].clip_rect == first.clip_rect) {
+                last_quad++;
+            }
+
+            const auto clip = intersect(screen, clip_rects[first.clip_rect]);
+            const auto clip_min = glm::uvec2{glm::floor(clip.position)};
+            const auto clip_size = glm::uvec2{glm::ceil(clip.position + clip.size)} - clip_min;
+            if(clip_size.x > 0 && clip_size.y > 0) {
+                cmds.set_scissor_rect(clip_min.x, clip_min.y, clip_size.x, clip_size.y);
+                cmds.draw_indexed_mesh((last_quad - first_quad) * 6, 0, 1, static_cast<int32_t>(first_quad * 4));
+            }
+
+            first_quad = last_quad;
+        }
+
+        // Whatever the host records after this gets the whole framebuffer back
+        cmds.set_scissor_rect(0, 0, screen_size.x, screen_size.y);
+
+        quads.clear();
+    }
+
+    void UiBatcher::end_frame() {
+        quads.clear();
+        clip_rects.resize(1);
+        clip_rect_stack.clear();
+        layer = 0;
+
+        if(should_evict_glyphs) {
+            evict_glyphs();
+        }
+    }
+
+    std::optional<glm::uvec2> UiBatcher::allocate_atlas_rect(const uint32_t width, const uint32_t height, const bool is_glyph) {
+        const auto atlas_size = options.atlas_size;
+        const auto padded_width = width + ATLAS_PADDING * 2;
+        const auto padded_height = height + ATLAS_PADDING * 2;
+        if(atlas == nullptr || padded_width > atlas_size || padded_height > atlas_size) {
+            return std::nullopt;
+        }
+
+        // Best fit: the shortest shelf of the same kind that the rect fits in, so that glyphs and images don't share shelves and small
+        // rects don't fill up the tall shelves
+        AtlasShelf* shelf = nullptr;
+        for(auto& open_shelf : shelves) {
+            if(open_shelf.has_glyphs == is_glyph && open_shelf.height >= padded_height && open_shelf.next_x + padded_width <= atlas_size &&
+               (shelf == nullptr || open_shelf.height < shelf->height)) {
+                shelf = &open_shelf;
+            }
+        }
+
+        if(shelf == nullptr) {
+            if(next_shelf_y + padded_height > atlas_size) {
+                return std::nullopt;
+            }
+
+            shelf = &shelves.emplace_back(AtlasShelf{next_shelf_y, padded_height, 0, is_glyph});
+            next_shelf_y += padded_height;
+        }
+
+        const glm::uvec2 corner{shelf->next_x, shelf->y};
+        shelf->next_x += padded_width;
+
+        return corner;
+    }
+
+    UiImage UiBatcher::queue_atlas_upload(const glm::uvec2& corner,
+                                          const uint32_t width,
+                                          const uint32_t height,
+                                          const uint8_t* pixels,
+                                          const bool clamp_padding) {
+        const auto padded_width = width + ATLAS_PADDING * 2;
+        const auto padded_height = height + ATLAS_PADDING * 2;
+
+        AtlasUpload upload{corner.x, corner.y, padded_width, padded_height, {}, next_upload_serial++};
+        upload.pixels.resize(size_t{padded_width} * padded_height * 4);
+        for(uint32_t row = 0; row < padded_height; row++) {
+            const auto is_padding_row = row < ATLAS_PADDING || row >= height + ATLAS_PADDING;
+            const auto source_row = std::min(row - std::min(row, ATLAS_PADDING), height - 1);
+            for(uint32_t column = 0; column < padded_width; column++) {
+                const auto is_padding = is_padding_row || column < ATLAS_PADDING || column >= width + ATLAS_PADDING;
+                if(is_padding && !clamp_padding) {
+                    continue;
+                }
+
+                const auto source_column = std::min(column - std::min(column, ATLAS_PADDING), width - 1);
+                std::memcpy(upload.pixels.data() + (size_t{row} * padded_width + column) * 4,
+                            pixels + (size_t{source_row} * width + source_column) * 4,
+                            4);
+            }
+        }
+
+        const auto atlas_size = static_cast<float>(options.atlas_size);
+        const glm::vec2 min{corner + ATLAS_PADDING};
+
+        UiImage image;
+        image.texture = 0;
+        image.min_uv = min / atlas_size;
+        image.max_uv = (min + glm::vec2{width, height}) / atlas_size;
+        image.upload_serial = upload.serial;
+
+        pending_uploads.push_back(std::move(upload));
+
+        return image;
+    }
+
+    const UiBatcher::CachedGlyph* UiBatcher::get_glyph(const uint32_t font, const char32_t codepoint) {
+        const GlyphKey key{font, codepoint};
+        if(const auto itr = glyphs.find(key); itr != glyphs.end()) {
+            return itr->second ? &*itr->second : nullptr;
+        }
+
+        if(!glyph_rasterizer || should_evict_glyphs) {
+            return nullptr;
+        }
+
+        const auto bitmap = glyph_rasterizer(font, codepoint);
+        if(!bitmap || bitmap->coverage.size() < size_t{bitmap->width} * bitmap->height) {
+            glyphs.emplace(key, std::nullopt);
+            return nullptr;
+        }
+
+        CachedGlyph glyph{{}, {bitmap->width, bitmap->height}, bitmap->bearing, bitmap->advance};
+
+        // Whitespace has an advance, but nothing to put in the atlas
+        if(bitmap->width > 0 && bitmap->height > 0) {
+            const auto corner = allocate_atlas_rect(bitmap->width, bitmap->height, true);
+            if(!corner) {
+                should_evict_glyphs = true;
+                return nullptr;
+            }
+
+            // The glyph's coverage is its alpha, so it tints like any other white image
+            std::vector<uint8_t> pixels(bitmap->coverage.size() * 4, 255);
+            for(size_t i = 0; i < bitmap->coverage.size(); i++) {
+                pixels[i * 4 + 3] = bitmap->coverage[i];
+            }
+
+            glyph.image = queue_atlas_upload(*corner, bitmap->width, bitmap->height, pixels.data(), false);
+        }
+
+        return &*glyphs.emplace(key, glyph).first->second;
+    }
+
+    void UiBatcher::evict_glyphs() {
+        logger->debug("Evicting {} glyphs from the UI atlas", glyphs.size());
+        glyphs.clear();
+        should_evict_glyphs = false;
+
+        // The shelves keep their place in the atlas, so the images between them stay where they are
+        for(auto& shelf : shelves) {
+            if(shelf.has_glyphs) {
+                shelf.next_x = 0;
+            }
+        }
+
+        std::erase_if(pending_uploads, [&](const AtlasUpload& upload) {
+            return std::any_of(shelves.begin(), shelves.end(), [&](const AtlasShelf& shelf) {
+                return shelf.has_glyphs && shelf.y == upload.y;
+            });
+        });
+    }
+
+    void UiBatcher::add_vertices(const std::array<UiVertex, 4>& vertices, const uint64_t upload_serial) {
+        const auto clip_rect = clip_rect_stack.empty() ? 0 : clip_rect_stack.back();
+        quads.push_back(UiQuad{vertices, layer, clip_rect, upload_serial});
+    }
+
+    bool UiBatcher::ensure_vertex_capacity(FrameResources& frame, const uint32_t num_quads) {
+        if(frame.vertices != nullptr && frame.quad_capacity >= num_quads) {
+            return true;
+        }
+
+        // This frame slot's fence has signaled, so the GPU is done with its old buffer
+        if(frame.vertices != nullptr) {
+            device.destroy_buffer(frame.vertices);
+        }
+
+        const auto capacity = std::max(num_quads, frame.quad_capacity * 2);
+        const auto frame_number = static_cast<size_t>(&frame - frames.data());
+        frame.vertices = device.create_buffer({fmt::format("NovaUiVertices{}", frame_number),
+                                               size_t{capacity} * 4 * sizeof(UiVertex),
+                                               rhi::BufferUsage::HostVisibleMeshBuffer});
+        frame.quad_capacity = frame.vertices != nullptr ? capacity : 0;
+
+        if(frame.vertices == nullptr) {
+            logger->error("Could not make room for {} UI quads", num_quads);
+            return false;
+        }
+
+        return true;
+    }
+} // namespace nova::renderer
@@ -1,6 +1,8 @@
 #include "nova_renderer/ui_renderer.hpp"
 
+#include "nova_renderer/frame_context.hpp"
 #include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/ui_batcher.hpp"
 
 namespace nova::renderer {
     struct RX_HINT_EMPTY_BASES UiRenderpassCreateInfo : renderpack::RenderPassCreateInfo {
@@ -14,9 +16,18 @@ namespace nova::renderer {
 
     rx::global<UiRenderpassCreateInfo> ui_create_info{"Nova", "UiRenderpassCreateInfo"};
 
-    UiRenderpass::UiRenderpass() : Renderpass(UI_RENDER_PASS_NAME, true) {}
+    UiRenderpass::UiRenderpass() : Renderpass(UI_RENDER_PASS_NAME, true) {
+        // We have no idea what the host application does in render_ui, so keep it on the thread that calls execute_frame
+        supports_parallel_recording = false;
+    }
+
+    void UiRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) {
+        render_ui(cmds, ctx);
 
-    void UiRenderpass::record_renderpass_contents(rhi::RhiRenderCommandList& cmds, FrameContext& ctx) { render_ui(cmds, ctx); }
+        if(ctx.ui != nullptr) {
+            ctx.ui->record_draws(cmds, ctx);
+        }
+    }
 
     const renderpack::RenderPassCreateInfo& UiRenderpass::get_create_info() {
         return *ui_create_info;
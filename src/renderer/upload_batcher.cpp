@@ -0,0 +1,354 @@
+#include "upload_batcher.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("UploadBatcher");
+
+    /*!
+     * \brief Alignment of every staging allocation. Buffer copies don't care, but it keeps each upload's data on its own cache lines.
+     * Image copies need offsets that are multiples of four and of the texel or block size, which this is for every color format we have
+     */
+    constexpr uint64_t STAGING_ALIGNMENT = 16;
+
+    static rhi::RhiResourceBarrier make_ownership_barrier(rhi::RhiBuffer* buffer,
+                                                          const uint64_t offset,
+                                                          const uint64_t size,
+                                                          const rhi::ResourceAccess access_after_upload) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = buffer;
+        barrier.old_state = rhi::ResourceState::CopyDestination;
+        barrier.new_state = rhi::ResourceState::Common;
+        barrier.access_before_barrier = rhi::ResourceAccess::CopyWrite;
+        barrier.access_after_barrier = access_after_upload;
+        barrier.source_queue = rhi::QueueType::Transfer;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = offset;
+        barrier.buffer_memory_barrier.size = size;
+
+        return barrier;
+    }
+
+    static rhi::RhiResourceBarrier make_image_barrier(rhi::RhiImage* image,
+                                                      const rhi::ResourceState old_state,
+                                                      const rhi::ResourceState new_state,
+                                                      const rhi::ResourceAccess access_after_barrier,
+                                                      const rhi::QueueType destination_queue) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = image;
+        barrier.old_state = old_state;
+        barrier.new_state = new_state;
+        barrier.access_before_barrier = old_state == rhi::ResourceState::Undefined ? rhi::ResourceAccess::CopyRead :
+                                                                                     rhi::ResourceAccess::CopyWrite;
+        barrier.access_after_barrier = access_after_barrier;
+        barrier.source_queue = rhi::QueueType::Transfer;
+        barrier.destination_queue = destination_queue;
+        barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    UploadBatcher::UploadBatcher(rhi::RenderDevice& device, const uint32_t num_in_flight_frames, const uint64_t staging_buffer_size)
+        : device{device}, staging_buffer_size{staging_buffer_size} {
+        rhi::RhiBufferCreateInfo create_info{};
+        create_info.name = "UploadBatcherStaging";
+        create_info.size = staging_buffer_size;
+        create_info.buffer_usage = rhi::BufferUsage::StagingBuffer;
+
+        staging_buffer = device.create_buffer(create_info);
+        if(staging_buffer == nullptr) {
+            logger->error("Could not create the staging buffer. Nothing will be uploaded");
+        }
+
+        frames.resize(num_in_flight_frames);
+    }
+
+    void UploadBatcher::upload_to_buffer(rhi::RhiBuffer* destination,
+                                         uint64_t destination_offset,
+                                         const void* data,
+                                         uint64_t num_bytes,
+                                         const rhi::ResourceAccess access_after_upload,
+                                         const rhi::PipelineStage stage_after_upload) {
+        ZoneScoped;
+        // On UMA and resizable BAR devices, device-local buffers may be mapped. Writing to them directly skips the staging copy and the
+        // transfer submission entirely, and the graphics queue sees the data because it's written before the frame is submitted
+        if(device.get_mapped_data(destination) != nullptr) {
+            device.write_data_to_buffer(data, num_bytes, destination_offset, destination);
+            device.flush_buffer(destination, destination_offset, num_bytes);
+            return;
+        }
+
+        if(staging_buffer == nullptr) {
+            return;
+        }
+
+        pending_stages_after_upload = pending_stages_after_upload | stage_after_upload;
+
+        const auto* bytes = static_cast<const uint8_t*>(data);
+
+        // Uploads that don't fit in the free part of the ring get split into as many copies as it takes
+        while(num_bytes > 0) {
+            const auto num_used_bytes = staging_head - staging_tail;
+            const auto padding = (STAGING_ALIGNMENT - staging_head % STAGING_ALIGNMENT) % STAGING_ALIGNMENT;
+            const auto position = (staging_head + padding) % staging_buffer_size;
+
+            uint64_t chunk_size = 0;
+            if(num_used_bytes + padding < staging_buffer_size) {
+                chunk_size = std::min({num_bytes, staging_buffer_size - position, staging_buffer_size - num_used_bytes - padding});
+            }
+
+            if(chunk_size == 0) {
+                submit_and_wait();
+                continue;
+            }
+
+            device.write_data_to_buffer(bytes, chunk_size, position, staging_buffer);
+            pending_copies.push_back({destination, destination_offset, position, chunk_size, access_after_upload});
+
+            staging_head += padding + chunk_size;
+            bytes += chunk_size;
+            destination_offset += chunk_size;
+            num_bytes -= chunk_size;
+        }
+    }
+
+    void UploadBatcher::upload_to_image(rhi::RhiImage* destination,
+                                        const std::span<const ImageMipData> mips,
+                                        const rhi::PipelineStage stage_after_upload,
+                                        const uint32_t num_generated_mips) {
+        ZoneScoped;
+        if(staging_buffer == nullptr || mips.empty()) {
+            return;
+        }
+
+        uint64_t total_size = 0;
+        uint64_t largest_mip_size = 0;
+        for(const ImageMipData& mip : mips) {
+            total_size += mip.num_bytes + STAGING_ALIGNMENT;
+            largest_mip_size = std::max(largest_mip_size, mip.num_bytes);
+        }
+
+        if(total_size > staging_buffer_size) {
+            logger->error("Can't upload an image of {} bytes through a {} byte staging ring. Increase `staging_buffer_size`",
+                          total_size,
+                          staging_buffer_size);
+            return;
+        }
+
+        // Each submission starts the image over from the undefined state, so all of its mips have to go in the same one. Make sure
+        // they fit before writing any of them. The mip that wraps around may leave up to its own size unused at the end of the ring
+        if(staging_head - staging_tail + total_size + largest_mip_size > staging_buffer_size) {
+            submit_and_wait();
+
+            // Nothing's in the ring anymore, so start over at its beginning where nothing has to wrap around
+            staging_head += (staging_buffer_size - staging_head % staging_buffer_size) % staging_buffer_size;
+            staging_tail = staging_head;
+        }
+
+        pending_stages_after_upload = pending_stages_after_upload | stage_after_upload;
+
+        for(uint32_t mip_level = 0; mip_level < mips.size(); mip_level++) {
+            const auto& mip = mips[mip_level];
+            const auto position = allocate_contiguous_staging(mip.num_bytes);
+            if(!position) {
+                logger->error("Ran out of staging memory in the middle of an image upload");
+                return;
+            }
+
+            device.write_data_to_buffer(mip.data, mip.num_bytes, *position, staging_buffer);
+            pending_image_copies.push_back({destination, mip_level, mip.width, mip.height, *position});
+        }
+
+        if(num_generated_mips > 0) {
+            const auto last_mip = static_cast<uint32_t>(mips.size() - 1);
+            pending_mip_generations.push_back({destination, last_mip, mips.back().width, mips.back().height, num_generated_mips});
+        }
+    }
+
+    void UploadBatcher::begin_frame(const uint32_t frame_idx) {
+        auto& frame = frames[frame_idx];
+
+        staging_tail = std::max(staging_tail, frame.staging_release_position);
+
+        available_semaphores.insert(available_semaphores.end(), frame.semaphores.begin(), frame.semaphores.end());
+        frame.semaphores.clear();
+    }
+
+    UploadBatcher::FlushedUploads UploadBatcher::flush(rhi::RhiRenderCommandList& cmds, const uint32_t frame_idx) {
+        ZoneScoped;
+        auto* transfer_cmds = record_pending_copies();
+
+        auto& frame = frames[frame_idx];
+        frame.staging_release_position = staging_head;
+
+        if(!barriers_to_acquire.empty()) {
+            // The source access and stages of an acquire barrier are ignored, the semaphore wait already orders it after the copies
+            cmds.resource_barriers(rhi::PipelineStage::TopOfPipe, stages_to_acquire_for, barriers_to_acquire);
+            barriers_to_acquire.clear();
+            stages_to_acquire_for = {};
+        }
+
+        // Transfer queues can't blit, so the mips that weren't uploaded get made here, after the graphics queue owns their images
+        for(const PendingMipGeneration& generation : mips_to_generate) {
+            cmds.generate_mips(generation.image,
+                               generation.source_mip,
+                               generation.source_width,
+                               generation.source_height,
+                               generation.num_mips);
+        }
+        mips_to_generate.clear();
+
+        const auto first_new_semaphore = frame.semaphores.size();
+        frame.semaphores.insert(frame.semaphores.end(), semaphores_to_wait_on.begin(), semaphores_to_wait_on.end());
+        semaphores_to_wait_on.clear();
+
+        return {transfer_cmds, std::span{frame.semaphores}.subspan(first_new_semaphore)};
+    }
+
+    void UploadBatcher::submit_pending_copies(rhi::RhiFence* fence) {
+        ZoneScoped;
+        auto* cmds = record_pending_copies();
+        if(cmds == nullptr) {
+            if(fence != nullptr) {
+                // Someone's waiting for the fence. An empty submission still signals it after everything before it on the queue
+                cmds = device.create_command_list(0, rhi::QueueType::Transfer, rhi::RhiRenderCommandList::Level::Primary);
+                device.submit_command_list(cmds, rhi::QueueType::Transfer, fence);
+            }
+            return;
+        }
+
+        rhi::RhiSemaphore* semaphore;
+        if(!available_semaphores.empty()) {
+            semaphore = available_semaphores.back();
+            available_semaphores.pop_back();
+
+        } else {
+            semaphore = device.create_semaphore();
+        }
+
+        device.submit_command_list(cmds, rhi::QueueType::Transfer, fence, {}, std::array{semaphore});
+
+        semaphores_to_wait_on.push_back(semaphore);
+    }
+
+    rhi::RhiRenderCommandList* UploadBatcher::record_pending_copies() {
+        ZoneScoped;
+        if(pending_copies.empty() && pending_image_copies.empty()) {
+            return nullptr;
+        }
+
+        auto* cmds = device.create_command_list(0, rhi::QueueType::Transfer, rhi::RhiRenderCommandList::Level::Primary);
+        cmds->set_debug_name("BatchedUploads");
+
+        // Chunk streaming uploads meshes to consecutive arena space, so merge copies and barriers that continue where the last one
+        // left off
+        std::vector<rhi::RhiResourceBarrier> release_barriers;
+        release_barriers.reserve(pending_copies.size());
+
+        for(size_t i = 0; i < pending_copies.size();) {
+            auto copy = pending_copies[i];
+            i++;
+
+            while(i < pending_copies.size()) {
+                const auto& next = pending_copies[i];
+                if(next.destination != copy.destination || next.destination_offset != copy.destination_offset + copy.num_bytes ||
+                   next.staging_offset != copy.staging_offset + copy.num_bytes || next.access_after_upload != copy.access_after_upload) {
+                    break;
+                }
+
+                copy.num_bytes += next.num_bytes;
+                i++;
+            }
+
+            cmds->copy_buffer(copy.destination, copy.destination_offset, staging_buffer, copy.staging_offset, copy.num_bytes);
+            release_barriers.push_back(
+                make_ownership_barrier(copy.destination, copy.destination_offset, copy.num_bytes, copy.access_after_upload));
+        }
+
+        if(!pending_image_copies.empty()) {
+            // The copies of each image are next to each other, so every image gets one barrier on either side of its copies
+            std::vector<rhi::RhiResourceBarrier> copy_destination_barriers;
+            for(const PendingImageCopy& copy : pending_image_copies) {
+                if(copy_destination_barriers.empty() || copy_destination_barriers.back().resource_to_barrier != copy.destination) {
+                    copy_destination_barriers.push_back(make_image_barrier(copy.destination,
+                                                                           rhi::ResourceState::Undefined,
+                                                                           rhi::ResourceState::CopyDestination,
+                                                                           rhi::ResourceAccess::CopyWrite,
+                                                                           rhi::QueueType::Transfer));
+                    release_barriers.push_back(make_image_barrier(copy.destination,
+                                                                  rhi::ResourceState::CopyDestination,
+                                                                  rhi::ResourceState::ShaderRead,
+                                                                  rhi::ResourceAccess::ShaderRead,
+                                                                  rhi::QueueType::Graphics));
+                }
+            }
+
+            cmds->resource_barriers(rhi::PipelineStage::TopOfPipe, rhi::PipelineStage::Transfer, copy_destination_barriers);
+
+            for(const PendingImageCopy& copy : pending_image_copies) {
+                cmds->copy_buffer_to_image(copy.destination,
+                                           copy.mip_level,
+                                           0,
+                                           0,
+                                           copy.width,
+                                           copy.height,
+                                           staging_buffer,
+                                           copy.staging_offset);
+            }
+        }
+
+        cmds->resource_barriers(rhi::PipelineStage::Transfer, rhi::PipelineStage::BottomOfPipe, release_barriers);
+
+        barriers_to_acquire.insert(barriers_to_acquire.end(), release_barriers.begin(), release_barriers.end());
+        stages_to_acquire_for = stages_to_acquire_for | pending_stages_after_upload;
+        mips_to_generate.insert(mips_to_generate.end(), pending_mip_generations.begin(), pending_mip_generations.end());
+
+        pending_copies.clear();
+        pending_image_copies.clear();
+        pending_mip_generations.clear();
+        pending_stages_after_upload = {};
+
+        return cmds;
+    }
+
+    std::optional<uint64_t> UploadBatcher::allocate_contiguous_staging(const uint64_t num_bytes) {
+        const auto padding = (STAGING_ALIGNMENT - staging_head % STAGING_ALIGNMENT) % STAGING_ALIGNMENT;
+        auto position = (staging_head + padding) % staging_buffer_size;
+        auto num_skipped_bytes = padding;
+
+        if(position + num_bytes > staging_buffer_size) {
+            num_skipped_bytes += staging_buffer_size - position;
+            position = 0;
+        }
+
+        if(staging_head - staging_tail + num_skipped_bytes + num_bytes > staging_buffer_size) {
+            return std::nullopt;
+        }
+
+        staging_head += num_skipped_bytes + num_bytes;
+
+        return position;
+    }
+
+    void UploadBatcher::submit_and_wait() {
+        ZoneScoped;
+        SPDLOG_LOGGER_DEBUG(logger, "The staging ring is full, waiting for the transfer queue to catch up");
+
+        auto* fence = device.create_fence(false);
+        submit_pending_copies(fence);
+
+        // A fence covers everything submitted to its queue before it, so every copy out of the ring is done
+        device.wait_for_fences(std::array{fence});
+        device.destroy_fences({fence});
+
+        staging_tail = staging_head;
+    }
+} // namespace nova::renderer
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_enums.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+namespace nova::renderer {
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Collects uploads to device-local buffers and images, and sends them to the GPU in one transfer submission per frame
+     *
+     * Uploaded data is copied into a ring buffer of persistently mapped staging memory as soon as it's queued, so callers can free their
+     * data right away. `flush` records every queued copy into a single transfer command list, along with one batch of queue ownership
+     * release barriers. The frame submits that command list in the same batch as its own, and its graphics work waits for it and records
+     * the matching acquire barriers
+     *
+     * Staging memory is reclaimed when the frame that waited on it finishes. If the ring fills up before that, the batcher flushes and
+     * waits for the transfer queue, so a burst of uploads can stall but never fail
+     *
+     * This class is not thread-safe. Use it from the thread that calls `NovaRenderer::execute_frame`
+     */
+    class UploadBatcher {
+    public:
+        /*!
+         * \param device The device to upload to
+         * \param num_in_flight_frames The number of frames that may be in flight at once
+         * \param staging_buffer_size The size, in bytes, of the staging ring buffer
+         */
+        UploadBatcher(rhi::RenderDevice& device, uint32_t num_in_flight_frames, uint64_t staging_buffer_size);
+
+        UploadBatcher(const UploadBatcher& other) = delete;
+        UploadBatcher& operator=(const UploadBatcher& other) = delete;
+
+        UploadBatcher(UploadBatcher&& old) noexcept = delete;
+        UploadBatcher& operator=(UploadBatcher&& old) noexcept = delete;
+
+        ~UploadBatcher() = default;
+
+        /*!
+         * \brief Queues an upload of some data to a device-local buffer
+         *
+         * If the CPU can write to `destination` itself, the data is written right away instead. Either way, don't upload to parts of the
+         * buffer that an in-flight frame may still be reading
+         *
+         * \param destination The buffer to upload to
+         * \param destination_offset The offset in `destination` to write the data to
+         * \param data The data to upload. It's copied before this method returns
+         * \param num_bytes The number of bytes to upload
+         * \param access_after_upload How the graphics queue will access the uploaded data
+         * \param stage_after_upload The first pipeline stage that will access the uploaded data
+         */
+        void upload_to_buffer(rhi::RhiBuffer* destination,
+                              uint64_t destination_offset,
+                              const void* data,
+                              uint64_t num_bytes,
+                              rhi::ResourceAccess access_after_upload,
+                              rhi::PipelineStage stage_after_upload);
+
+        /*!
+         * \brief The tightly packed pixels of one mip of an image upload
+         */
+        struct ImageMipData {
+            uint32_t width;
+
+            uint32_t height;
+
+            const void* data;
+
+            uint64_t num_bytes;
+        };
+
+        /*!
+         * \brief Queues an upload of every mip of a sampled image
+         *
+         * The image's previous contents are thrown away, so this is for filling in images that were just created. All the mips go to the
+         * GPU in the same transfer submission, so together they have to fit in the staging ring
+         *
+         * \param destination The image to upload to. Nothing may have used it yet
+         * \param mips The data for each of the image's mips, starting at mip 0. It's copied before this method returns. Block-compressed
+         * mips are measured in pixels, like any other
+         * \param stage_after_upload The first pipeline stage that will sample the image
+         * \param num_generated_mips How many mips after the last uploaded one the GPU should filter down from it. They're generated on
+         * the graphics queue, right after the image's acquire barrier. Only for uncompressed color images
+         */
+        void upload_to_image(rhi::RhiImage* destination,
+                             std::span<const ImageMipData> mips,
+                             rhi::PipelineStage stage_after_upload,
+                             uint32_t num_generated_mips = 0);
+
+        /*!
+         * \brief Reclaims the staging memory that the provided frame slot's previous frame used
+         *
+         * Call this after the frame slot's fence has signaled
+         */
+        void begin_frame(uint32_t frame_idx);
+
+        /*!
+         * \brief What the frame has to submit and wait for to use the uploads
+         */
+        struct FlushedUploads {
+            /*!
+             * \brief Transfer command list with every upload that was queued since the last flush, or nullptr if there weren't any. The
+             * caller submits it to the transfer queue in the same batch as `cmds`, and makes `cmds` wait for it
+             */
+            rhi::RhiRenderCommandList* transfer_cmds = nullptr;
+
+            /*!
+             * \brief Semaphores of uploads that had to be submitted early, because the staging ring filled up. The frame's graphics
+             * submission must wait on these too. Valid until the next `begin_frame` for this frame slot
+             */
+            std::span<rhi::RhiSemaphore* const> semaphores;
+        };
+
+        /*!
+         * \brief Records all the queued uploads into a transfer command list, then records the barriers that give the uploaded resources
+         * to the graphics queue
+         *
+         * \param cmds The frame's graphics command list. Records the acquire barriers into it, so it must be recorded before anything
+         * that reads the uploaded data
+         * \param frame_idx The frame slot that `cmds` belongs to
+         */
+        [[nodiscard]] FlushedUploads flush(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx);
+
+    private:
+        struct PendingCopy {
+            rhi::RhiBuffer* destination;
+            uint64_t destination_offset;
+            uint64_t staging_offset;
+            uint64_t num_bytes;
+            rhi::ResourceAccess access_after_upload;
+        };
+
+        struct PendingImageCopy {
+            rhi::RhiImage* destination;
+            uint32_t mip_level;
+            uint32_t width;
+            uint32_t height;
+            uint64_t staging_offset;
+        };
+
+        struct PendingMipGeneration {
+            rhi::RhiImage* image;
+            uint32_t source_mip;
+            uint32_t source_width;
+            uint32_t source_height;
+            uint32_t num_mips;
+        };
+
+        struct FrameResources {
+            /*!
+             * \brief Semaphores that this frame slot's most recent frame waited on
+             */
+            std::vector<rhi::RhiSemaphore*> semaphores;
+
+            /*!
+             * \brief How far `staging_tail` can move once this frame slot's most recent frame has finished
+             */
+            uint64_t staging_release_position = 0;
+        };
+
+        rhi::RenderDevice& device;
+
+        rhi::RhiBuffer* staging_buffer = nullptr;
+
+        uint64_t staging_buffer_size;
+
+        /*!
+         * \brief The total number of bytes that have ever been allocated from the staging ring. The write position is this modulo the
+         * size of the staging buffer
+         */
+        uint64_t staging_head = 0;
+
+        /*!
+         * \brief The total number of bytes of the staging ring that the GPU is done with
+         */
+        uint64_t staging_tail = 0;
+
+        std::vector<PendingCopy> pending_copies;
+
+        std::vector<PendingImageCopy> pending_image_copies;
+
+        std::vector<PendingMipGeneration> pending_mip_generations;
+
+        rhi::PipelineStage pending_stages_after_upload{};
+
+        /*!
+         * \brief Release barriers of the transfers that were submitted since the last flush. The graphics queue needs matching acquire
+         * barriers
+         */
+        std::vector<rhi::RhiResourceBarrier> barriers_to_acquire;
+
+        rhi::PipelineStage stages_to_acquire_for{};
+
+        /*!
+         * \brief Mips of images that were submitted since the last flush, which the graphics queue generates after acquiring the images
+         */
+        std::vector<PendingMipGeneration> mips_to_generate;
+
+        /*!
+         * \brief Semaphores signaled by transfers submitted since the last flush
+         */
+        std::vector<rhi::RhiSemaphore*> semaphores_to_wait_on;
+
+        std::vector<rhi::RhiSemaphore*> available_semaphores;
+
+        std::vector<FrameResources> frames;
+
+        /*!
+         * \brief Records every pending copy into a transfer command list, and queues the barriers that the graphics queue needs to acquire
+         * what they copied
+         *
+         * \return The command list, or nullptr if nothing was pending
+         */
+        rhi::RhiRenderCommandList* record_pending_copies();
+
+        /*!
+         * \brief Records every pending copy into a transfer command list and submits it on its own
+         *
+         * \param fence The fence for the submission to signal. May be nullptr
+         */
+        void submit_pending_copies(rhi::RhiFence* fence = nullptr);
+
+        /*!
+         * \brief Takes a contiguous, aligned range of the staging ring, wrapping around to the start of the ring if the range doesn't fit
+         * before its end
+         *
+         * \return The range's offset in the staging buffer, or nothing if the ring doesn't have enough free space
+         */
+        [[nodiscard]] std::optional<uint64_t> allocate_contiguous_staging(uint64_t num_bytes);
+
+        /*!
+         * \brief Submits all the pending copies, then waits for the transfer queue to finish them so the whole staging ring is free
+         */
+        void submit_and_wait();
+    };
+} // namespace nova::renderer
@@ -0,0 +1,511 @@
+#include "virtual_texture_atlas.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/util/logging.hpp"
+#include "nova_renderer/util/task_scheduler.hpp"
+
+#include "frame_upload_allocator.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("VirtualTextureAtlas");
+
+    /*!
+     * \brief What the page table says about pages that aren't in the cache. Must match `VIRTUAL_PAGE_NOT_RESIDENT` in the shader include
+     */
+    constexpr uint32_t NOT_RESIDENT = 0xFFFFFFFF;
+
+    constexpr uint32_t ELEMENTS_PER_TEXTURE = 4;
+
+    /*!
+     * \brief How many page table elements are uploaded together. Pages come and go a few at a time, so small blocks keep the uploads
+     * close to what actually changed
+     */
+    constexpr size_t DIRTY_BLOCK_SIZE = 64;
+
+    static size_t get_num_blocks(const size_t num_elements) { return (num_elements + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE; }
+
+    static uint32_t get_mip_size(const uint32_t size, const uint32_t mip) { return std::max(size >> mip, 1U); }
+
+    static uint32_t get_num_pages(const uint32_t size, const uint32_t page_size) { return (size + page_size - 1) / page_size; }
+
+    static rhi::RhiResourceBarrier make_cache_barrier(rhi::RhiImage* page_cache,
+                                                      const rhi::ResourceState old_state,
+                                                      const rhi::ResourceState new_state,
+                                                      const rhi::ResourceAccess access_before,
+                                                      const rhi::ResourceAccess access_after) {
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = page_cache;
+        barrier.old_state = old_state;
+        barrier.new_state = new_state;
+        barrier.access_before_barrier = access_before;
+        barrier.access_after_barrier = access_after;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    VirtualTextureAtlas::VirtualTextureAtlas(rhi::RenderDevice& device,
+                                             TaskScheduler& task_scheduler,
+                                             const NovaSettings::VirtualTexturingOptions& options,
+                                             const uint32_t num_in_flight_frames)
+        : device{device},
+          task_scheduler{task_scheduler},
+          options{options},
+          num_in_flight_frames{num_in_flight_frames},
+          page_table(size_t{options.max_virtual_textures} * ELEMENTS_PER_TEXTURE + options.max_virtual_pages, NOT_RESIDENT),
+          dirty_blocks{get_num_blocks(page_table.size()), num_in_flight_frames},
+          entry_allocator{options.max_virtual_pages} {
+        ZoneScoped;
+        // Textures that don't exist have zero mips, which shaders take to mean there's nothing to sample
+        std::fill_n(page_table.begin(), size_t{options.max_virtual_textures} * ELEMENTS_PER_TEXTURE, 0);
+
+        // ID 0 describes the atlas, which is also what vertices without a virtual texture point at
+        page_table[0] = options.page_size;
+        page_table[1] = options.cache_size_in_pages;
+        page_table[2] = options.max_feedback_requests;
+
+        free_texture_ids.reserve(options.max_virtual_textures - 1);
+        for(uint32_t id = options.max_virtual_textures - 1; id > 0; id--) {
+            free_texture_ids.push_back(id);
+        }
+
+        page_table_buffers.reserve(num_in_flight_frames);
+        feedback_buffers.reserve(num_in_flight_frames);
+        for(uint32_t i = 0; i < num_in_flight_frames; i++) {
+            rhi::RhiBufferCreateInfo create_info{};
+
+            create_info.name = fmt::format("VirtualPageTable{}", i);
+            create_info.size = page_table.size() * sizeof(uint32_t);
+            create_info.buffer_usage = rhi::BufferUsage::StorageBuffer;
+            page_table_buffers.push_back(device.create_buffer(create_info));
+
+            // Element 0 counts the requests, the requests come after it
+            create_info.name = fmt::format("VirtualTextureFeedback{}", i);
+            create_info.size = (size_t{options.max_feedback_requests} + 1) * sizeof(uint32_t);
+            create_info.buffer_usage = rhi::BufferUsage::ReadbackBuffer;
+            auto* feedback_buffer = device.create_buffer(create_info);
+
+            *static_cast<uint32_t*>(device.get_mapped_data(feedback_buffer)) = 0;
+            device.flush_buffer(feedback_buffer, 0, sizeof(uint32_t));
+
+            feedback_buffers.push_back(feedback_buffer);
+        }
+
+        renderpack::TextureCreateInfo cache_create_info = {};
+        cache_create_info.name = "NovaVirtualTexturePageCache";
+        cache_create_info.usage = renderpack::ImageUsage::SampledImage;
+        cache_create_info.format.pixel_format = rhi::PixelFormat::Rgba8;
+        cache_create_info.format.dimension_type = renderpack::TextureDimensionType::Absolute;
+        cache_create_info.format.width = static_cast<float>(options.page_size * options.cache_size_in_pages);
+        cache_create_info.format.height = static_cast<float>(options.page_size * options.cache_size_in_pages);
+
+        page_cache = device.create_image(cache_create_info);
+        if(page_cache != nullptr) {
+            page_cache->is_dynamic = false;
+        } else {
+            logger->error("Could not create the virtual texture page cache");
+        }
+
+        const auto num_slots = options.cache_size_in_pages * options.cache_size_in_pages;
+        cache_slots.resize(num_slots, CacheSlot{NOT_RESIDENT, 0, false});
+
+        // Handed out from the back, so the first pages go in the top-left of the cache
+        free_slots.reserve(num_slots);
+        for(uint32_t slot = num_slots; slot > 0; slot--) {
+            free_slots.push_back(slot - 1);
+        }
+    }
+
+    VirtualTextureAtlas::~VirtualTextureAtlas() {
+        for(auto* buffer : page_table_buffers) {
+            device.destroy_buffer(buffer);
+        }
+
+        for(auto* buffer : feedback_buffers) {
+            device.destroy_buffer(buffer);
+        }
+
+        if(page_cache != nullptr) {
+            device.destroy_texture(page_cache);
+        }
+    }
+
+    std::optional<uint32_t> VirtualTextureAtlas::add_texture(VirtualTextureCreateInfo create_info) {
+        ZoneScoped;
+        if(create_info.width == 0 || create_info.height == 0 || !create_info.load_page) {
+            logger->error("Virtual texture {} needs a size and a function to load its pages", create_info.name);
+            return std::nullopt;
+        }
+
+        if(free_texture_ids.empty()) {
+            logger->error("Can't add virtual texture {}, there are already {} virtual textures",
+                          create_info.name,
+                          options.max_virtual_textures - 1);
+            return std::nullopt;
+        }
+
+        // Mips smaller than a page would waste most of their page, so the chain stops at the first mip that fits in one
+        const auto page_size = options.page_size;
+        uint32_t chain_length = 1;
+        while(std::max(get_mip_size(create_info.width, chain_length - 1), get_mip_size(create_info.height, chain_length - 1)) > page_size) {
+            chain_length++;
+        }
+        if(create_info.num_mips == 0 || create_info.num_mips > chain_length) {
+            create_info.num_mips = chain_length;
+        }
+
+        uint32_t num_entries = 0;
+        uint32_t last_mip_first_entry = 0;
+        for(uint32_t mip = 0; mip < create_info.num_mips; mip++) {
+            last_mip_first_entry = num_entries;
+            num_entries += get_num_pages(get_mip_size(create_info.width, mip), page_size) *
+                           get_num_pages(get_mip_size(create_info.height, mip), page_size);
+        }
+
+        const auto entries = entry_allocator.allocate(num_entries);
+        if(!entries) {
+            logger->error("Virtual texture {} needs {} pages, but there's no room for them in the page table",
+                          create_info.name,
+                          num_entries);
+            return std::nullopt;
+        }
+
+        const auto id = free_texture_ids.back();
+        free_texture_ids.pop_back();
+
+        VirtualTexture texture = {};
+        texture.first_entry = static_cast<uint32_t>(options.max_virtual_textures * ELEMENTS_PER_TEXTURE + *entries);
+        texture.num_entries = num_entries;
+        texture.serial = next_serial++;
+
+        const auto description = id * ELEMENTS_PER_TEXTURE;
+        set_table_element(description, create_info.width);
+        set_table_element(description + 1, create_info.height);
+        set_table_element(description + 2, create_info.num_mips);
+        set_table_element(description + 3, texture.first_entry);
+
+        texture.create_info = std::move(create_info);
+
+        textures_by_first_entry.emplace(texture.first_entry, id);
+        const auto first_entry = texture.first_entry;
+        textures.emplace(id, std::move(texture));
+
+        // Shaders fall back to coarser mips when the one they want isn't resident, so the smallest mip has to always be there
+        for(uint32_t entry = first_entry + last_mip_first_entry; entry < first_entry + num_entries; entry++) {
+            request_page(entry, true);
+        }
+
+        return id;
+    }
+
+    void VirtualTextureAtlas::remove_texture(const uint32_t virtual_texture_id) {
+        const auto itr = textures.find(virtual_texture_id);
+        if(itr == textures.end()) {
+            logger->error("There's no virtual texture with ID {}", virtual_texture_id);
+            return;
+        }
+
+        const auto& texture = itr->second;
+        const auto first_entry = texture.first_entry;
+        const auto last_entry = texture.first_entry + texture.num_entries;
+
+        for(uint32_t entry = first_entry; entry < last_entry; entry++) {
+            if(page_table[entry] != NOT_RESIDENT) {
+                retire_slot(page_table[entry]);
+            }
+
+            requested_entries.erase(entry);
+        }
+
+        // Loads that are still running get thrown away when they finish, since the texture's serial is gone
+        std::erase_if(loaded_pages, [&](const LoadedPage& page) { return page.entry >= first_entry && page.entry < last_entry; });
+
+        entry_allocator.free(first_entry - options.max_virtual_textures * ELEMENTS_PER_TEXTURE, texture.num_entries);
+
+        const auto description = virtual_texture_id * ELEMENTS_PER_TEXTURE;
+        for(uint32_t i = 0; i < ELEMENTS_PER_TEXTURE; i++) {
+            set_table_element(description + i, 0);
+        }
+
+        textures_by_first_entry.erase(first_entry);
+        free_texture_ids.push_back(virtual_texture_id);
+        textures.erase(itr);
+    }
+
+    void VirtualTextureAtlas::begin_frame(const uint64_t frame_count, const uint32_t frame_idx) {
+        ZoneScoped;
+        this->frame_count = frame_count;
+
+        std::erase_if(retired_slots, [&](const RetiredSlot& retired) {
+            if(frame_count - retired.retired_frame < num_in_flight_frames) {
+                return false;
+            }
+
+            free_slots.push_back(retired.slot);
+            return true;
+        });
+
+        collect_finished_loads();
+
+        // This frame slot's fence has signaled, so the GPU is done writing the slot's feedback
+        auto* feedback_buffer = feedback_buffers[frame_idx];
+        device.invalidate_buffer(feedback_buffer, 0, feedback_buffer->size);
+
+        auto* feedback = static_cast<uint32_t*>(device.get_mapped_data(feedback_buffer));
+        const auto num_requests = std::min(feedback[0], options.max_feedback_requests);
+
+        const auto first_page_entry = options.max_virtual_textures * ELEMENTS_PER_TEXTURE;
+        for(uint32_t i = 0; i < num_requests; i++) {
+            const auto entry = feedback[i + 1];
+            if(entry >= first_page_entry && entry < page_table.size()) {
+                request_page(entry);
+            }
+        }
+
+        feedback[0] = 0;
+        device.flush_buffer(feedback_buffer, 0, sizeof(uint32_t));
+
+        evict_pages();
+
+        TracyPlot("Virtual texture pages loading", static_cast<int64_t>(page_loads.size()));
+        TracyPlot("Virtual texture feedback requests", static_cast<int64_t>(num_requests));
+    }
+
+    void VirtualTextureAtlas::record_page_uploads(rhi::RhiRenderCommandList& cmds,
+                                                  const uint32_t frame_idx,
+                                                  FrameUploadAllocator& frame_uploads) {
+        ZoneScoped;
+        const auto num_uploads = std::min({loaded_pages.size(), free_slots.size(), size_t{options.max_page_uploads_per_frame}});
+
+        // The cache is transitioned on the first frame even if nothing's ready, so its layout matches its descriptor
+        if(page_cache != nullptr && (num_uploads > 0 || !is_cache_initialized)) {
+            const auto page_size = options.page_size;
+            const auto page_bytes = get_page_bytes();
+
+            // Only the first transition may throw the cache's contents away
+            const auto old_state = is_cache_initialized ? rhi::ResourceState::ShaderRead : rhi::ResourceState::Undefined;
+            const auto stages_before_copies = is_cache_initialized ? rhi::PipelineStage::FragmentShader : rhi::PipelineStage::TopOfPipe;
+            cmds.resource_barriers(stages_before_copies,
+                                   rhi::PipelineStage::Transfer,
+                                   std::array{make_cache_barrier(page_cache,
+                                                                 old_state,
+                                                                 rhi::ResourceState::CopyDestination,
+                                                                 rhi::ResourceAccess::ShaderRead,
+                                                                 rhi::ResourceAccess::CopyWrite)});
+
+            size_t num_uploaded = 0;
+            for(; num_uploaded < num_uploads; num_uploaded++) {
+                const auto& page = loaded_pages[num_uploaded];
+
+                // The rest wait for next frame's region
+                const auto staging = frame_uploads.upload(page.data.data(), page_bytes);
+                if(!staging) {
+                    break;
+                }
+
+                const auto slot = free_slots.back();
+                free_slots.pop_back();
+
+                cmds.copy_buffer_to_image(page_cache,
+                                          0,
+                                          slot % options.cache_size_in_pages * page_size,
+                                          slot / options.cache_size_in_pages * page_size,
+                                          page_size,
+                                          page_size,
+                                          staging->buffer,
+                                          staging->offset);
+
+                cache_slots[slot] = CacheSlot{page.entry, frame_count, page.is_pinned};
+                set_table_element(page.entry, slot);
+                requested_entries.erase(page.entry);
+            }
+            loaded_pages.erase(loaded_pages.begin(), loaded_pages.begin() + static_cast<ptrdiff_t>(num_uploaded));
+
+            cmds.resource_barriers(rhi::PipelineStage::Transfer,
+                                   rhi::PipelineStage::FragmentShader,
+                                   std::array{make_cache_barrier(page_cache,
+                                                                 rhi::ResourceState::CopyDestination,
+                                                                 rhi::ResourceState::ShaderRead,
+                                                                 rhi::ResourceAccess::CopyWrite,
+                                                                 rhi::ResourceAccess::ShaderRead)});
+
+            is_cache_initialized = true;
+        }
+
+        // This frame slot's fence has signaled, so nothing reads its page table
+        auto* page_table_buffer = page_table_buffers[frame_idx];
+        dirty_blocks.consume_dirty_ranges(frame_idx, [&](const size_t first_block, const size_t num_blocks) {
+            const auto first_element = first_block * DIRTY_BLOCK_SIZE;
+            const auto num_elements = std::min(num_blocks * DIRTY_BLOCK_SIZE, page_table.size() - first_element);
+
+            device.write_data_to_buffer(page_table.data() + first_element,
+                                        num_elements * sizeof(uint32_t),
+                                        first_element * sizeof(uint32_t),
+                                        page_table_buffer);
+        });
+    }
+
+    void VirtualTextureAtlas::record_feedback_readback(rhi::RhiRenderCommandList& cmds, const uint32_t frame_idx) const {
+        auto* feedback_buffer = feedback_buffers[frame_idx];
+
+        rhi::RhiResourceBarrier barrier = {};
+        barrier.resource_to_barrier = feedback_buffer;
+        barrier.old_state = rhi::ResourceState::Common;
+        barrier.new_state = rhi::ResourceState::Common;
+        barrier.access_before_barrier = rhi::ResourceAccess::ShaderWrite;
+        barrier.access_after_barrier = rhi::ResourceAccess::HostRead;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.buffer_memory_barrier.offset = 0;
+        barrier.buffer_memory_barrier.size = feedback_buffer->size;
+
+        cmds.resource_barriers(rhi::PipelineStage::FragmentShader | rhi::PipelineStage::ComputeShader,
+                               rhi::PipelineStage::Host,
+                               std::array{barrier});
+    }
+
+    rhi::RhiBuffer* VirtualTextureAtlas::get_page_table_buffer(const uint32_t frame_idx) const { return page_table_buffers[frame_idx]; }
+
+    rhi::RhiBuffer* VirtualTextureAtlas::get_feedback_buffer(const uint32_t frame_idx) const { return feedback_buffers[frame_idx]; }
+
+    rhi::RhiImage* VirtualTextureAtlas::get_page_cache() const { return page_cache; }
+
+    uint32_t VirtualTextureAtlas::get_page_bytes() const { return options.page_size * options.page_size * 4; }
+
+    void VirtualTextureAtlas::request_page(const uint32_t entry, const bool ignore_load_limit) {
+        if(const auto slot = page_table[entry]; slot != NOT_RESIDENT) {
+            cache_slots[slot].last_used_frame = frame_count;
+            return;
+        }
+
+        if(requested_entries.contains(entry) || (!ignore_load_limit && page_loads.size() >= options.max_page_loads_in_flight)) {
+            return;
+        }
+
+        // Feedback may point at the pages of a texture that was removed since the frame that wrote it
+        auto texture_itr = textures_by_first_entry.upper_bound(entry);
+        if(texture_itr == textures_by_first_entry.begin()) {
+            return;
+        }
+        --texture_itr;
+
+        const auto virtual_texture_id = texture_itr->second;
+        const auto& texture = textures.at(virtual_texture_id);
+        if(entry >= texture.first_entry + texture.num_entries) {
+            return;
+        }
+
+        const auto& info = texture.create_info;
+        const auto page_size = options.page_size;
+
+        uint32_t mip = 0;
+        uint32_t mip_first_entry = texture.first_entry;
+        uint32_t pages_per_row = get_num_pages(info.width, page_size);
+        uint32_t num_mip_pages = pages_per_row * get_num_pages(info.height, page_size);
+        while(entry >= mip_first_entry + num_mip_pages) {
+            mip++;
+            mip_first_entry += num_mip_pages;
+            pages_per_row = get_num_pages(get_mip_size(info.width, mip), page_size);
+            num_mip_pages = pages_per_row * get_num_pages(get_mip_size(info.height, mip), page_size);
+        }
+
+        const auto page_x = (entry - mip_first_entry) % pages_per_row;
+        const auto page_y = (entry - mip_first_entry) / pages_per_row;
+
+        requested_entries.insert(entry);
+
+        PageLoad load = {};
+        load.virtual_texture_id = virtual_texture_id;
+        load.serial = texture.serial;
+        load.entry = entry;
+        load.is_pinned = mip + 1 == info.num_mips;
+        load.data = task_scheduler.add_task([load_page = info.load_page, mip, page_x, page_y](uint32_t /* thread_idx */) {
+            ZoneScoped;
+            return load_page(mip, page_x, page_y);
+        });
+
+        page_loads.push_back(std::move(load));
+    }
+
+    void VirtualTextureAtlas::collect_finished_loads() {
+        ZoneScoped;
+        const auto page_bytes = get_page_bytes();
+
+        std::erase_if(page_loads, [&](PageLoad& load) {
+            if(load.data.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                return false;
+            }
+
+            auto data = load.data.get();
+
+            const auto texture_itr = textures.find(load.virtual_texture_id);
+            if(texture_itr == textures.end() || texture_itr->second.serial != load.serial) {
+                return true;
+            }
+
+            if(data.size() != page_bytes) {
+                // The entry stays requested, so we don't keep asking the loader for a page that it can't give us
+                logger->error("A page of virtual texture {} is {} bytes, but it should be {}",
+                              texture_itr->second.create_info.name,
+                              data.size(),
+                              page_bytes);
+                return true;
+            }
+
+            loaded_pages.push_back({load.entry, load.is_pinned, std::move(data)});
+            return true;
+        });
+    }
+
+    void VirtualTextureAtlas::evict_pages() {
+        ZoneScoped;
+        // Slots that are still retired come back in a frame or two, so they count as free
+        const auto num_wanted = std::min(size_t{options.max_page_uploads_per_frame}, loaded_pages.size() + page_loads.size());
+        const auto num_available = free_slots.size() + retired_slots.size();
+        if(num_available >= num_wanted) {
+            return;
+        }
+
+        // Pages that the last frame asked for are in use. Evicting them would only make us load them again
+        eviction_candidates_scratch.clear();
+        for(uint32_t slot = 0; slot < cache_slots.size(); slot++) {
+            const auto& cache_slot = cache_slots[slot];
+            if(cache_slot.entry != NOT_RESIDENT && !cache_slot.is_pinned && cache_slot.last_used_frame < frame_count) {
+                eviction_candidates_scratch.push_back(slot);
+            }
+        }
+
+        const auto num_to_evict = std::min(num_wanted - num_available, eviction_candidates_scratch.size());
+        const auto last_evicted = eviction_candidates_scratch.begin() + static_cast<ptrdiff_t>(num_to_evict);
+        std::partial_sort(eviction_candidates_scratch.begin(),
+                          last_evicted,
+                          eviction_candidates_scratch.end(),
+                          [&](const uint32_t lhs, const uint32_t rhs) {
+                              return cache_slots[lhs].last_used_frame < cache_slots[rhs].last_used_frame;
+                          });
+
+        std::for_each(eviction_candidates_scratch.begin(), last_evicted, [&](const uint32_t slot) { retire_slot(slot); });
+    }
+
+    void VirtualTextureAtlas::retire_slot(const uint32_t slot) {
+        set_table_element(cache_slots[slot].entry, NOT_RESIDENT);
+        cache_slots[slot] = CacheSlot{NOT_RESIDENT, 0, false};
+
+        retired_slots.push_back({slot, frame_count});
+    }
+
+    void VirtualTextureAtlas::set_table_element(const uint32_t element, const uint32_t value) {
+        page_table[element] = value;
+        dirty_blocks.mark_dirty(element / DIRTY_BLOCK_SIZE);
+    }
+} // namespace nova::renderer
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/resource_loader.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/util/dirty_range_tracker.hpp"
+
+#include "../util/offset_allocator.hpp"
+
+namespace nova::renderer {
+    class FrameUploadAllocator;
+    class TaskScheduler;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Keeps the pages of virtual textures that shaders sampled recently in one fixed-size page cache image
+     *
+     * Every virtual texture is cut into square pages, mip by mip. The page table says which cache slot holds each page, if any, and
+     * shaders look their page up in it with `sample_virtual_texture` from `./nova/virtual_texturing.hlsl`. Some pixels also write the page
+     * they wanted to a feedback buffer. Once the frame is done, the atlas reads the feedback back, loads the missing pages on the task
+     * scheduler, and copies a few of them into the cache every frame. When the cache is full, the least recently wanted pages make room
+     *
+     * The page table and the feedback buffer have one copy per in-flight frame, so the CPU only touches the copies of frames that are done.
+     * A slot whose page was evicted keeps its old pixels until every frame that might still sample them is done
+     *
+     * This class is not thread-safe. Use it from the thread that calls `NovaRenderer::execute_frame`
+     */
+    class VirtualTextureAtlas {
+    public:
+        VirtualTextureAtlas(rhi::RenderDevice& device,
+                            TaskScheduler& task_scheduler,
+                            const NovaSettings::VirtualTexturingOptions& options,
+                            uint32_t num_in_flight_frames);
+
+        VirtualTextureAtlas(const VirtualTextureAtlas& other) = delete;
+        VirtualTextureAtlas& operator=(const VirtualTextureAtlas& other) = delete;
+
+        VirtualTextureAtlas(VirtualTextureAtlas&& old) noexcept = delete;
+        VirtualTextureAtlas& operator=(VirtualTextureAtlas&& old) noexcept = delete;
+
+        /*!
+         * \brief Destroys the page cache and the per-frame buffers. The GPU must be done with all of them
+         */
+        ~VirtualTextureAtlas();
+
+        /*!
+         * \brief Adds a virtual texture, and starts loading its smallest mip, which stays resident as a fallback for every other mip
+         *
+         * \return The texture's virtual texture ID, for `FullVertex::virtual_texture_id` and `sample_virtual_texture`. Nothing if the
+         * create info doesn't make sense, or if there's no room left in the page table
+         */
+        [[nodiscard]] std::optional<uint32_t> add_texture(VirtualTextureCreateInfo create_info);
+
+        void remove_texture(uint32_t virtual_texture_id);
+
+        /*!
+         * \brief Reads what the frame slot's previous frame asked for, and starts loading the pages that weren't resident
+         *
+         * Call this once per frame, after the frame slot's fence has signaled
+         */
+        void begin_frame(uint64_t frame_count, uint32_t frame_idx);
+
+        /*!
+         * \brief Records copies of the pages that finished loading into the page cache, and updates the frame's page table to match
+         *
+         * Call this once per frame, in the first graphics command list, before anything samples a virtual texture
+         */
+        void record_page_uploads(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx, FrameUploadAllocator& frame_uploads);
+
+        /*!
+         * \brief Records a barrier that makes the shaders' feedback writes visible to the CPU. Call it at the end of the frame's last
+         * graphics command list
+         */
+        void record_feedback_readback(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx) const;
+
+        [[nodiscard]] rhi::RhiBuffer* get_page_table_buffer(uint32_t frame_idx) const;
+
+        [[nodiscard]] rhi::RhiBuffer* get_feedback_buffer(uint32_t frame_idx) const;
+
+        [[nodiscard]] rhi::RhiImage* get_page_cache() const;
+
+    private:
+        struct VirtualTexture {
+            VirtualTextureCreateInfo create_info;
+
+            /*!
+             * \brief Where the texture's page entries start in the page table. Each mip's entries follow the previous mip's, row by row
+             */
+            uint32_t first_entry = 0;
+
+            uint32_t num_entries = 0;
+
+            /*!
+             * \brief Tells this texture apart from textures that got the same ID after it was removed, so their late page loads are dropped
+             */
+            uint64_t serial = 0;
+        };
+
+        struct PageLoad {
+            uint32_t virtual_texture_id;
+
+            uint64_t serial;
+
+            uint32_t entry;
+
+            /*!
+             * \brief True for the pages of each texture's smallest mip, which are never evicted
+             */
+            bool is_pinned;
+
+            std::future<std::vector<uint8_t>> data;
+        };
+
+        struct LoadedPage {
+            uint32_t entry;
+
+            bool is_pinned;
+
+            std::vector<uint8_t> data;
+        };
+
+        struct CacheSlot {
+            /*!
+             * \brief The page table entry of the page in this slot, or `NOT_RESIDENT` if the slot is empty
+             */
+            uint32_t entry;
+
+            uint64_t last_used_frame;
+
+            bool is_pinned;
+        };
+
+        struct RetiredSlot {
+            uint32_t slot;
+
+            uint64_t retired_frame;
+        };
+
+        rhi::RenderDevice& device;
+
+        TaskScheduler& task_scheduler;
+
+        NovaSettings::VirtualTexturingOptions options;
+
+        uint32_t num_in_flight_frames;
+
+        /*!
+         * \brief The page table, as shaders see it. Element 0 to 3 describe the atlas, then every virtual texture ID has four elements that
+         * describe its texture, then come the page entries
+         */
+        std::vector<uint32_t> page_table;
+
+        DirtyRangeTracker dirty_blocks;
+
+        /*!
+         * \brief Hands out the page entries. Offsets are in entries, counting from the first entry after the texture descriptions
+         */
+        mem::OffsetAllocator entry_allocator;
+
+        std::vector<rhi::RhiBuffer*> page_table_buffers;
+
+        std::vector<rhi::RhiBuffer*> feedback_buffers;
+
+        rhi::RhiImage* page_cache = nullptr;
+
+        /*!
+         * \brief False until the first pages are copied into the cache. The cache's contents are undefined until then
+         */
+        bool is_cache_initialized = false;
+
+        std::unordered_map<uint32_t, VirtualTexture> textures;
+
+        /*!
+         * \brief Every texture by the first of its page entries, so a page entry can find the texture that it belongs to
+         */
+        std::map<uint32_t, uint32_t> textures_by_first_entry;
+
+        std::vector<uint32_t> free_texture_ids;
+
+        uint64_t next_serial = 1;
+
+        std::vector<CacheSlot> cache_slots;
+
+        std::vector<uint32_t> free_slots;
+
+        std::vector<RetiredSlot> retired_slots;
+
+        /*!
+         * \brief Entries whose pages are loading or waiting to be copied into the cache, so they aren't loaded twice
+         */
+        std::unordered_set<uint32_t> requested_entries;
+
+        std::vector<PageLoad> page_loads;
+
+        std::vector<LoadedPage> loaded_pages;
+
+        uint64_t frame_count = 0;
+
+        std::vector<uint32_t> eviction_candidates_scratch;
+
+        [[nodiscard]] uint32_t get_page_bytes() const;
+
+        /*!
+         * \brief Starts loading the page at the provided entry, unless it's already loading or there are too many loads in flight
+         */
+        void request_page(uint32_t entry, bool ignore_load_limit = false);
+
+        void collect_finished_loads();
+
+        /*!
+         * \brief Evicts the least recently used pages until enough slots will be free for next frame's uploads
+         */
+        void evict_pages();
+
+        void retire_slot(uint32_t slot);
+
+        void set_table_element(uint32_t element, uint32_t value);
+    };
+} // namespace nova::renderer
@@ -1,5 +1,279 @@
 #include "visibility_cache.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+#include <Tracy.hpp>
+
+#include "nova_renderer/util/task_scheduler.hpp"
+
+#include "../util/simd.hpp"
+
 namespace nova::renderer {
-    VisibilityCache::VisibilityCache(rx::memory::allocator& allocator) : cached_cameras{&allocator}, visibility_cache{&allocator} {}
+    static bool has_same_parameters(const Camera& lhs, const Camera& rhs) {
+        return lhs.aspect_ratio == rhs.aspect_ratio && lhs.field_of_view == rhs.field_of_view && lhs.near_plane == rhs.near_plane &&
+               lhs.far_plane == rhs.far_plane && lhs.position == rhs.position && lhs.rotation == rhs.rotation;
+    }
+
+    VisibilityCache::VisibilityCache(TaskScheduler& task_scheduler) : task_scheduler{&task_scheduler} {}
+
+    void VisibilityCache::set_renderable_bounds(const RenderableId renderable,
+                                                const glm::mat4& model_matrix,
+                                                const glm::vec4& bounding_sphere) {
+        const auto [slot_itr, is_new] = slots.try_emplace(renderable, static_cast<uint32_t>(slot_renderables.size()));
+        if(is_new) {
+            slot_renderables.push_back(renderable);
+            centers_x.push_back(0);
+            centers_y.push_back(0);
+            centers_z.push_back(0);
+            radii.push_back(0);
+        }
+
+        const auto slot = slot_itr->second;
+        const auto center = model_matrix * glm::vec4{glm::vec3{bounding_sphere}, 1};
+        auto radius = std::numeric_limits<float>::infinity();
+        if(bounding_sphere.w >= 0) {
+            // Scale the radius by the largest axis scale, so non-uniformly scaled meshes stay inside their sphere
+            const auto max_scale = std::sqrt(std::max({glm::dot(glm::vec3{model_matrix[0]}, glm::vec3{model_matrix[0]}),
+                                                       glm::dot(glm::vec3{model_matrix[1]}, glm::vec3{model_matrix[1]}),
+                                                       glm::dot(glm::vec3{model_matrix[2]}, glm::vec3{model_matrix[2]})}));
+            radius = bounding_sphere.w * max_scale;
+        }
+
+        // What hid the renderable at its old spot may not hide it at its new one
+        const auto has_moved = centers_x[slot] != center.x || centers_y[slot] != center.y || centers_z[slot] != center.z ||
+                               radii[slot] != radius;
+        if(!is_new && has_moved) {
+            for(CameraVisibility& camera_visibility : cameras) {
+                set_slot_occluded(camera_visibility, slot, false);
+            }
+        }
+
+        centers_x[slot] = center.x;
+        centers_y[slot] = center.y;
+        centers_z[slot] = center.z;
+        radii[slot] = radius;
+
+        bounds_generation++;
+    }
+
+    void VisibilityCache::remove_renderable(const RenderableId renderable) {
+        const auto slot_itr = slots.find(renderable);
+        if(slot_itr == slots.end()) {
+            return;
+        }
+
+        const auto slot = slot_itr->second;
+        const auto last_slot = static_cast<uint32_t>(slot_renderables.size() - 1);
+        if(slot != last_slot) {
+            slot_renderables[slot] = slot_renderables[last_slot];
+            centers_x[slot] = centers_x[last_slot];
+            centers_y[slot] = centers_y[last_slot];
+            centers_z[slot] = centers_z[last_slot];
+            radii[slot] = radii[last_slot];
+
+            slots[slot_renderables[slot]] = slot;
+        }
+
+        for(CameraVisibility& camera_visibility : cameras) {
+            set_slot_occluded(camera_visibility, slot, is_slot_occluded(camera_visibility, last_slot));
+            set_slot_occluded(camera_visibility, last_slot, false);
+        }
+
+        slot_renderables.pop_back();
+        centers_x.pop_back();
+        centers_y.pop_back();
+        centers_z.pop_back();
+        radii.pop_back();
+
+        slots.erase(slot_itr);
+
+        bounds_generation++;
+    }
+
+    void VisibilityCache::set_renderable_visibility(const Camera& camera, const RenderableId renderable, const bool visibility) {
+        const auto slot_itr = slots.find(renderable);
+        if(slot_itr == slots.end() || camera.index >= cameras.size()) {
+            return;
+        }
+
+        // A stale cache is recalculated from scratch the next time it's used, so there's no point in writing to it
+        auto& camera_visibility = cameras[camera.index];
+        if(!camera_visibility.is_valid || camera_visibility.bounds_generation != bounds_generation ||
+           !has_same_parameters(camera_visibility.camera, camera)) {
+            return;
+        }
+
+        const auto slot = slot_itr->second;
+        const auto bit = uint64_t{1} << (slot % 64);
+        if(visibility) {
+            camera_visibility.visible_slots[slot / 64] |= bit;
+
+        } else {
+            camera_visibility.visible_slots[slot / 64] &= ~bit;
+        }
+    }
+
+    bool VisibilityCache::is_renderable_visible_to_camera(const RenderableId renderable,
+                                                          const Camera& camera,
+                                                          const CameraUboData& camera_data) {
+        const auto slot_itr = slots.find(renderable);
+        if(slot_itr == slots.end()) {
+            return false;
+        }
+
+        const auto& camera_visibility = get_camera_visibility(camera, camera_data);
+
+        const auto slot = slot_itr->second;
+        return (camera_visibility.visible_slots[slot / 64] & (uint64_t{1} << (slot % 64))) != 0 &&
+               !is_slot_occluded(camera_visibility, slot);
+    }
+
+    void VisibilityCache::update_camera(const Camera& camera, const CameraUboData& camera_data) {
+        [[maybe_unused]] const auto& camera_visibility = get_camera_visibility(camera, camera_data);
+    }
+
+    void VisibilityCache::set_renderable_occluded(const Camera& camera, const RenderableId renderable, const bool occluded) {
+        const auto slot_itr = slots.find(renderable);
+        if(slot_itr == slots.end()) {
+            return;
+        }
+
+        if(camera.index >= cameras.size()) {
+            cameras.resize(camera.index + 1);
+        }
+
+        set_slot_occluded(cameras[camera.index], slot_itr->second, occluded);
+    }
+
+    bool VisibilityCache::is_renderable_occluded(const Camera& camera, const RenderableId renderable) const {
+        const auto slot_itr = slots.find(renderable);
+        if(slot_itr == slots.end() || camera.index >= cameras.size()) {
+            return false;
+        }
+
+        return is_slot_occluded(cameras[camera.index], slot_itr->second);
+    }
+
+    void VisibilityCache::get_occlusion_candidates(const Camera& camera,
+                                                   const CameraUboData& camera_data,
+                                                   const uint32_t max_renderables,
+                                                   std::vector<RenderableBounds>& candidates) {
+        ZoneScoped;
+        auto& camera_visibility = get_camera_visibility(camera, camera_data);
+
+        uint32_t num_candidates = 0;
+        for(uint32_t slot = 0; slot < slot_renderables.size(); slot++) {
+            const auto is_in_frustum = (camera_visibility.visible_slots[slot / 64] & (uint64_t{1} << (slot % 64))) != 0;
+            if(!is_in_frustum || std::isinf(radii[slot]) || num_candidates >= max_renderables) {
+                set_slot_occluded(camera_visibility, slot, false);
+                continue;
+            }
+
+            candidates.push_back({slot_renderables[slot], glm::vec4{centers_x[slot], centers_y[slot], centers_z[slot], radii[slot]}});
+            num_candidates++;
+        }
+    }
+
+    std::optional<glm::vec4> VisibilityCache::get_renderable_bounds(const RenderableId renderable) const {
+        const auto slot_itr = slots.find(renderable);
+        if(slot_itr == slots.end()) {
+            return std::nullopt;
+        }
+
+        const auto slot = slot_itr->second;
+        return glm::vec4{centers_x[slot], centers_y[slot], centers_z[slot], radii[slot]};
+    }
+
+    VisibilityCache::CameraVisibility& VisibilityCache::get_camera_visibility(const Camera& camera, const CameraUboData& camera_data) {
+        if(camera.index >= cameras.size()) {
+            cameras.resize(camera.index + 1);
+        }
+
+        auto& camera_visibility = cameras[camera.index];
+        if(camera_visibility.is_valid && camera_visibility.bounds_generation == bounds_generation &&
+           has_same_parameters(camera_visibility.camera, camera)) {
+            return camera_visibility;
+        }
+
+        ZoneScoped;
+        const auto planes = get_frustum_planes(camera_data);
+        const auto num_slots = static_cast<uint32_t>(slot_renderables.size());
+        camera_visibility.visible_slots.assign((num_slots + 63) / 64, 0);
+
+        task_scheduler->parallel_for(0,
+                                     num_slots,
+                                     RENDERABLES_PER_TASK,
+                                     [&](uint32_t /* thread_idx */, const uint32_t first_slot, const uint32_t last_slot) {
+                                         cull_slots(planes, first_slot, last_slot, camera_visibility.visible_slots);
+                                     });
+
+        camera_visibility.is_valid = true;
+        camera_visibility.camera = camera;
+        camera_visibility.bounds_generation = bounds_generation;
+
+        return camera_visibility;
+    }
+
+    void VisibilityCache::set_slot_occluded(CameraVisibility& camera_visibility, const uint32_t slot, const bool occluded) {
+        auto& occluded_slots = camera_visibility.occluded_slots;
+        if(slot / 64 >= occluded_slots.size()) {
+            if(!occluded) {
+                return;
+            }
+
+            occluded_slots.resize(slot / 64 + 1, 0);
+        }
+
+        const auto bit = uint64_t{1} << (slot % 64);
+        if(occluded) {
+            occluded_slots[slot / 64] |= bit;
+
+        } else {
+            occluded_slots[slot / 64] &= ~bit;
+        }
+    }
+
+    bool VisibilityCache::is_slot_occluded(const CameraVisibility& camera_visibility, const uint32_t slot) {
+        const auto& occluded_slots = camera_visibility.occluded_slots;
+        return slot / 64 < occluded_slots.size() && (occluded_slots[slot / 64] & (uint64_t{1} << (slot % 64))) != 0;
+    }
+
+    void VisibilityCache::cull_slots(const std::array<glm::vec4, 6>& planes,
+                                     const uint32_t first_slot,
+                                     const uint32_t last_slot,
+                                     std::vector<uint64_t>& visible_slots) const {
+        uint32_t slot = first_slot;
+
+#ifdef NOVA_SIMD
+        // Groups of four never straddle two words, because the first slot is a multiple of 64
+        for(; slot + 4 <= last_slot; slot += 4) {
+            const auto x = simd::load(&centers_x[slot]);
+            const auto y = simd::load(&centers_y[slot]);
+            const auto z = simd::load(&centers_z[slot]);
+            const auto negative_radius = simd::splat(0) - simd::load(&radii[slot]);
+
+            auto outside = simd::splat(0);
+            for(const glm::vec4& plane : planes) {
+                const auto distance = simd::splat(plane.x) * x + simd::splat(plane.y) * y + simd::splat(plane.z) * z +
+                                      simd::splat(plane.w);
+                outside = outside | simd::less_than(distance, negative_radius);
+            }
+
+            const auto visible_bits = ~simd::to_bits(outside) & 0xF;
+            visible_slots[slot / 64] |= static_cast<uint64_t>(visible_bits) << (slot % 64);
+        }
+#endif
+
+        for(; slot < last_slot; slot++) {
+            const auto is_visible = std::all_of(planes.begin(), planes.end(), [&](const glm::vec4& plane) {
+                return plane.x * centers_x[slot] + plane.y * centers_y[slot] + plane.z * centers_z[slot] + plane.w >= -radii[slot];
+            });
+            if(is_visible) {
+                visible_slots[slot / 64] |= uint64_t{1} << (slot % 64);
+            }
+        }
+    }
 } // namespace nova::renderer
@@ -1,22 +1,43 @@
 #pragma once
 
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include "nova_renderer/camera.hpp"
 #include "nova_renderer/renderables.hpp"
 
 namespace nova::renderer {
+    class TaskScheduler;
+
     /*!
      * \brief Cache of cache of which objects are visible to which cameras
      *
-     * Implements frustum culling. Will eventually use hardware occlusion queries
+     * Implements frustum culling on the CPU, for when GPU culling isn't an option, and remembers what hardware occlusion queries found
+     *
+     * Every renderable gets a dense slot, and its world-space bounding sphere lives in one array per component so we can test four
+     * renderables against a plane at a time. Each camera remembers which slots are visible to it in a bitset. When camera parameters
+     * change for a camera at a given index, or when any renderable's bounds change, the camera's bitset is recalculated the next time
+     * anyone asks it something
      *
-     * This class caches visibility per camera. When camera parameters change for a camera at a given index, the cache for that camera is
-     * invalidated. Future occlusion queries will have to re-calculate themselves
+     * Occlusion can't be recalculated like that, since query results come back frames after they were asked for. Each camera keeps a
+     * second bitset of the slots that queries found hidden, which only changes when new results come in, when a renderable moves, or when
+     * a renderable leaves the frustum
+     *
+     * Not thread-safe. Culling splits itself across the task scheduler, but only one thread may use the cache at a time
      */
     class VisibilityCache {
     public:
-        explicit VisibilityCache(rx::memory::allocator& allocator);
+        struct RenderableBounds {
+            RenderableId renderable;
+
+            /*!
+             * \brief World-space center in xyz, radius in w
+             */
+            glm::vec4 sphere;
+        };
+
+        explicit VisibilityCache(TaskScheduler& task_scheduler);
 
         VisibilityCache(const VisibilityCache& other) = delete;
         VisibilityCache& operator=(const VisibilityCache& other) = delete;
@@ -26,9 +47,25 @@ namespace nova::renderer {
 
         ~VisibilityCache() = default;
 
+        /*!
+         * \brief Adds a renderable to the cache, or moves one that's already in it
+         *
+         * \param renderable The renderable to add or move
+         * \param model_matrix The renderable's model matrix
+         * \param bounding_sphere Model-space bounding sphere of the renderable's mesh. See `MeshData::bounding_sphere`
+         */
+        void set_renderable_bounds(RenderableId renderable, const glm::mat4& model_matrix, const glm::vec4& bounding_sphere);
+
+        /*!
+         * \brief Removes a renderable from the cache. The last renderable moves into its slot
+         */
+        void remove_renderable(RenderableId renderable);
+
         /*!
          * \brief Sets the visibility of a renderable in the visibility cache
          *
+         * The visibility sticks until the camera or some renderable's bounds change
+         *
          * \param camera The camera to set visibility for
          * \param renderable The renderable to set visibility for
          * \param visibility Whether or not the renderable is visible
@@ -38,27 +75,132 @@ namespace nova::renderer {
         /*!
          * \brief Checks if a given renderable is visible to a given camera
          *
-         * This method first checks if the visibility cache for this camera is up-to-date. If so, it fetches the visibility result for the
-         * renderable and returns is directly. However, if the visibility cache is _not_ up-to-date, this method invalidates the cache and
-         * recalculates visibility for this renderable
+         * This method first checks if the visibility cache for this camera is up-to-date. If so, it reads the renderable's bit and returns
+         * it directly. However, if the visibility cache is _not_ up-to-date, this method culls every renderable against the camera's
+         * frustum first
+         *
+         * Renderables that aren't in the cache are never visible, and neither are renderables that occlusion queries found hidden
          *
-         * If the cache is up-to-date but doesn't have this renderable in it, this method will calculate visibility and save it to the
-         * cache, then return the result
+         * \param renderable The renderable to check
+         * \param camera The camera to check against
+         * \param camera_data The camera's matrices, which the frustum comes from
          */
-        [[nodiscard]] bool is_renderable_visible_to_camera(RenderableId renderable, const Camera& camera);
+        [[nodiscard]] bool is_renderable_visible_to_camera(RenderableId renderable, const Camera& camera, const CameraUboData& camera_data);
 
-    private:
         /*!
-         * \brief A map of the camera parameters that were most recently seen for a given camera
+         * \brief Makes sure that the camera's visibility is up-to-date, culling every renderable against its frustum if it isn't
+         */
+        void update_camera(const Camera& camera, const CameraUboData& camera_data);
+
+        /*!
+         * \brief Marks a renderable as hidden behind other geometry from a camera's point of view, or as not hidden
+         *
+         * Unlike `set_renderable_visibility`, this survives the camera moving
+         */
+        void set_renderable_occluded(const Camera& camera, RenderableId renderable, bool occluded);
+
+        /*!
+         * \brief Checks if an occlusion query found the renderable hidden from the camera. Renderables that aren't in the cache are never
+         * occluded
          *
-         * If we see see a camera that has different parameters than what's in this cache, the visibility results for that camera are
-         * invalidated
+         * Doesn't look at the frustum, so this never has to recalculate anything
+         */
+        [[nodiscard]] bool is_renderable_occluded(const Camera& camera, RenderableId renderable) const;
+
+        /*!
+         * \brief Appends the bounds of up to `max_renderables` renderables that are in the camera's frustum, for occlusion queries to
+         * test
+         *
+         * Every other renderable stops being occluded. A renderable outside the frustum, or one that didn't fit, won't get a query that
+         * could tell us when it comes into view, so it has to be assumed visible. Renderables that can't be culled are never candidates
+         */
+        void get_occlusion_candidates(const Camera& camera,
+                                      const CameraUboData& camera_data,
+                                      uint32_t max_renderables,
+                                      std::vector<RenderableBounds>& candidates);
+
+        /*!
+         * \return The renderable's world-space bounding sphere, or nothing if it isn't in the cache
+         */
+        [[nodiscard]] std::optional<glm::vec4> get_renderable_bounds(RenderableId renderable) const;
+
+    private:
+        /*!
+         * \brief How many renderables one culling task tests. A multiple of 64, so no two tasks write to the same word of a bitset
+         */
+        static constexpr uint32_t RENDERABLES_PER_TASK = 4096;
+
+        TaskScheduler* task_scheduler;
+
+        std::unordered_map<RenderableId, uint32_t> slots;
+
+        /*!
+         * \brief The renderable in each slot
+         */
+        std::vector<RenderableId> slot_renderables;
+
+        /*!
+         * \brief World-space bounding spheres of each slot. Renderables that can't be culled have an infinite radius
+         */
+        std::vector<float> centers_x;
+        std::vector<float> centers_y;
+        std::vector<float> centers_z;
+        std::vector<float> radii;
+
+        /*!
+         * \brief Bumped every time a renderable's bounds change, to invalidate every camera at once
+         */
+        uint64_t bounds_generation = 0;
+
+        struct CameraVisibility {
+            bool is_valid = false;
+
+            /*!
+             * \brief The camera parameters that were most recently seen for this camera
+             *
+             * If we see see a camera that has different parameters than these, the visibility results for that camera are invalidated
+             */
+            Camera camera{CameraCreateInfo{}};
+
+            uint64_t bounds_generation = 0;
+
+            /*!
+             * \brief One bit per slot, set if the renderable in that slot is visible
+             */
+            std::vector<uint64_t> visible_slots;
+
+            /*!
+             * \brief One bit per slot, set if an occlusion query found the renderable in that slot hidden. May be shorter than the slot
+             * list, in which case the missing slots aren't occluded
+             */
+            std::vector<uint64_t> occluded_slots;
+        };
+
+        /*!
+         * \brief Cache of which renderables are visible, indexed by camera index
          */
-        std::unordered_map<CameraIndex, Camera> cached_cameras;
+        std::vector<CameraVisibility> cameras;
 
         /*!
-         * \brief Cache of which renderables are visible for a given camera
+         * \brief Returns `camera`'s cached visibility, recalculating it first if it's stale
+         */
+        CameraVisibility& get_camera_visibility(const Camera& camera, const CameraUboData& camera_data);
+
+        /*!
+         * \brief Sets or clears a slot's occluded bit for one camera
+         */
+        static void set_slot_occluded(CameraVisibility& camera_visibility, uint32_t slot, bool occluded);
+
+        [[nodiscard]] static bool is_slot_occluded(const CameraVisibility& camera_visibility, uint32_t slot);
+
+        /*!
+         * \brief Culls the slots in [first_slot, last_slot) against the frustum, writing the results to `visible_slots`
+         *
+         * `first_slot` must be a multiple of 64
          */
-        std::unordered_map<CameraIndex, std::unordered_map<RenderableId, bool>> visibility_cache;
+        void cull_slots(const std::array<glm::vec4, 6>& planes,
+                        uint32_t first_slot,
+                        uint32_t last_slot,
+                        std::vector<uint64_t>& visible_slots) const;
     };
 } // namespace nova::renderer
@@ -0,0 +1,606 @@
+#include "volumetric_fog.hpp"
+
+#include <array>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/camera.hpp"
+#include "nova_renderer/constants.hpp"
+#include "nova_renderer/loading/renderpack_loading.hpp"
+#include "nova_renderer/renderpack_data.hpp"
+#include "nova_renderer/rhi/command_list.hpp"
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/rhi/render_device.hpp"
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+#include "light_clustering.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("VolumetricFog");
+
+    constexpr const char* INJECTION_PIPELINE_NAME = "NovaVolumetricFogInjection";
+    constexpr const char* INTEGRATION_PIPELINE_NAME = "NovaVolumetricFogIntegration";
+
+    /*!
+     * \brief The injection shader's groups are 4x4x4 froxels, and the integration shader's are 8x8 columns of froxels
+     */
+    constexpr uint32_t INJECTION_GROUP_SIZE = 4;
+    constexpr uint32_t INTEGRATION_GROUP_SIZE = 8;
+
+    /*!
+     * \brief How many frames the jitter takes to come back around
+     */
+    constexpr uint32_t JITTER_PERIOD = 16;
+
+    constexpr const char* FOG_STRUCTS_HLSL = R"(
+struct LightClusterParams {
+    float4x4 view;
+    float4x4 inverse_projection;
+    uint4 grid_size;
+    float near_plane;
+    float far_plane;
+    float slices_per_log_depth;
+    uint max_light_indices;
+};
+
+struct FogParams {
+    float4x4 inverse_view;
+    float4x4 previous_view_projection;
+    uint4 grid_size;
+    uint4 froxels_per_cluster;
+    float3 albedo;
+    float density;
+    float3 ambient;
+    float height_falloff;
+    float base_height;
+    float anisotropy;
+    float history_weight;
+    float jitter_x;
+    float jitter_y;
+    float jitter_z;
+    uint enabled;
+    uint padding;
+};
+
+// Froxel slices are light cluster slices cut into pieces, so they're spaced evenly in log depth too
+float froxel_slice_to_depth(LightClusterParams cluster_params, FogParams fog_params, float froxel_slice) {
+    return cluster_params.near_plane * exp(froxel_slice / (fog_params.froxels_per_cluster.z * cluster_params.slices_per_log_depth));
+}
+
+// The view-space direction to the middle of a froxel column, scaled to go one unit into the screen
+float3 get_view_ray(LightClusterParams cluster_params, float2 ndc) {
+    const float4 unprojected = mul(cluster_params.inverse_projection, float4(ndc, 0, 1));
+    const float3 ray = unprojected.xyz / unprojected.w;
+    return ray / -ray.z;
+}
+)";
+
+    constexpr const char* INJECTION_SHADER_SOURCE = R"(
+struct Light {
+    float4 position_and_radius;
+    float4 color_and_intensity;
+};
+
+struct FogVolume {
+    float3 position;
+    float density;
+    float3 half_size;
+    float edge_softness;
+    float3 albedo;
+    float padding;
+};
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<FogParams> params : register(t0);
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<LightClusterParams> cluster_params : register(t1);
+
+[[vk::binding(2, 0)]]
+StructuredBuffer<Light> lights : register(t2);
+
+[[vk::binding(3, 0)]]
+StructuredBuffer<uint2> light_clusters : register(t3);
+
+[[vk::binding(4, 0)]]
+StructuredBuffer<uint> light_indices : register(t4);
+
+[[vk::binding(5, 0)]]
+StructuredBuffer<FogVolume> volumes : register(t5);
+
+[[vk::binding(6, 0)]]
+Texture3D<float4> history : register(t6);
+
+[[vk::binding(7, 0)]]
+SamplerState history_sampler : register(s0);
+
+[[vk::binding(8, 0)]]
+RWTexture3D<float4> scattering : register(u0);
+
+static const float PI = 3.14159265;
+
+// Henyey-Greenstein, with the angle between where the light was going and where it goes after it scatters
+float phase(float cos_theta, float g) {
+    const float g2 = g * g;
+    return (1 - g2) / (4 * PI * pow(max(1 + g2 - 2 * g * cos_theta, 0.0001), 1.5));
+}
+
+[numthreads(4, 4, 4)]
+void main(uint3 froxel : SV_DispatchThreadID) {
+    const FogParams fog_params = params[0];
+    const uint3 grid_size = fog_params.grid_size.xyz;
+    if(any(froxel >= grid_size)) {
+        return;
+    }
+
+    if(fog_params.enabled == 0) {
+        scattering[froxel] = float4(0, 0, 0, 0);
+        return;
+    }
+
+    const LightClusterParams light_params = cluster_params[0];
+    const float3 froxels_per_cluster = float3(fog_params.froxels_per_cluster.xyz);
+
+    // Every frame samples a different spot in the froxel, and the history blends them together
+    const float3 jitter = float3(fog_params.jitter_x, fog_params.jitter_y, fog_params.jitter_z);
+    const float3 sample_position = float3(froxel) + 0.5 + jitter;
+    const float2 ndc = sample_position.xy / float2(grid_size.xy) * 2 - 1;
+    const float depth = froxel_slice_to_depth(light_params, fog_params, sample_position.z);
+
+    const float3 view_position = get_view_ray(light_params, ndc) * depth;
+    const float3 world_position = mul(fog_params.inverse_view, float4(view_position, 1)).xyz;
+    const float3 camera_position = mul(fog_params.inverse_view, float4(0, 0, 0, 1)).xyz;
+
+    float density = fog_params.density * exp(-fog_params.height_falloff * max(world_position.y - fog_params.base_height, 0));
+    float3 weighted_albedo = fog_params.albedo * density;
+    for(uint i = 0; i < fog_params.grid_size.w; i++) {
+        const FogVolume volume = volumes[i];
+        const float3 local_position = abs(world_position - volume.position) / max(volume.half_size, 0.0001);
+        const float distance_to_side = 1 - max(local_position.x, max(local_position.y, local_position.z));
+        if(distance_to_side > 0) {
+            const float volume_density = volume.density * saturate(distance_to_side / max(volume.edge_softness, 0.0001));
+            density += volume_density;
+            weighted_albedo += volume.albedo * volume_density;
+        }
+    }
+
+    float4 result = float4(0, 0, 0, density);
+    if(density > 0) {
+        const float3 albedo = weighted_albedo / density;
+        const float3 to_camera = normalize(camera_position - world_position);
+
+        // The froxel is inside its cluster, so the cluster has every light that can reach it
+        const uint3 cluster_grid_size = light_params.grid_size.xyz;
+        const uint3 cluster = min(uint3(float3(froxel) / froxels_per_cluster), cluster_grid_size - 1);
+        const uint2 cluster_data = light_clusters[cluster.x + cluster.y * cluster_grid_size.x +
+                                                  cluster.z * cluster_grid_size.x * cluster_grid_size.y];
+
+        float3 light = fog_params.ambient;
+        for(uint i = 0; i < cluster_data.y; i++) {
+            const Light cluster_light = lights[light_indices[cluster_data.x + i]];
+            const float3 to_light = cluster_light.position_and_radius.xyz - world_position;
+            const float distance_squared = max(dot(to_light, to_light), 0.0001);
+            const float radius = cluster_light.position_and_radius.w;
+
+            // Inverse square falloff, faded out so it reaches zero at the light's radius like the clusters assume
+            const float window = saturate(1 - pow(distance_squared / (radius * radius), 2));
+            const float attenuation = window * window / distance_squared;
+            const float cos_theta = dot(-to_light * rsqrt(distance_squared), to_camera);
+
+            light += cluster_light.color_and_intensity.rgb * cluster_light.color_and_intensity.a * attenuation *
+                     phase(cos_theta, fog_params.anisotropy);
+        }
+
+        result.rgb = light * albedo * density;
+    }
+
+    // Where this spot was in last frame's grid. Perspective projections put the view depth in w
+    if(fog_params.froxels_per_cluster.w != 0) {
+        const float4 previous_clip = mul(fog_params.previous_view_projection, float4(world_position, 1));
+        if(previous_clip.w > 0) {
+            const float previous_depth = max(previous_clip.w, light_params.near_plane);
+            const float previous_slice = log(previous_depth / light_params.near_plane) * light_params.slices_per_log_depth *
+                                         froxels_per_cluster.z;
+            const float3 previous_uvw = float3(previous_clip.xy / previous_clip.w * 0.5 + 0.5, previous_slice / float(grid_size.z));
+
+            if(all(previous_uvw >= 0) && all(previous_uvw <= 1)) {
+                const float4 previous = history.SampleLevel(history_sampler, previous_uvw, 0);
+                result = lerp(result, previous, fog_params.history_weight);
+            }
+        }
+    }
+
+    scattering[froxel] = result;
+})";
+
+    constexpr const char* INTEGRATION_SHADER_SOURCE = R"(
+[[vk::binding(0, 0)]]
+StructuredBuffer<FogParams> params : register(t0);
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<LightClusterParams> cluster_params : register(t1);
+
+[[vk::binding(2, 0)]]
+Texture3D<float4> scattering : register(t2);
+
+[[vk::binding(3, 0)]]
+RWTexture3D<float4> integrated : register(u0);
+
+[numthreads(8, 8, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    const FogParams fog_params = params[0];
+    const uint3 grid_size = fog_params.grid_size.xyz;
+    if(any(thread_id.xy >= grid_size.xy)) {
+        return;
+    }
+
+    if(fog_params.enabled == 0) {
+        for(uint z = 0; z < grid_size.z; z++) {
+            integrated[uint3(thread_id.xy, z)] = float4(0, 0, 0, 1);
+        }
+        return;
+    }
+
+    const LightClusterParams light_params = cluster_params[0];
+
+    // Slices are spaced in view depth, but rays toward the sides of the screen go through more fog to cross them
+    const float2 ndc = (float2(thread_id.xy) + 0.5) / float2(grid_size.xy) * 2 - 1;
+    const float distance_per_depth = length(get_view_ray(light_params, ndc));
+
+    float3 scattered = 0;
+    float transmittance = 1;
+    float slice_start = light_params.near_plane;
+    for(uint z = 0; z < grid_size.z; z++) {
+        const float slice_end = froxel_slice_to_depth(light_params, fog_params, float(z + 1));
+        const float thickness = (slice_end - slice_start) * distance_per_depth;
+        slice_start = slice_end;
+
+        const float4 froxel = scattering.Load(int4(thread_id.xy, z, 0));
+        const float extinction = max(froxel.a, 0.000001);
+        const float slice_transmittance = exp(-extinction * thickness);
+
+        // The froxel's light is scattered all through it, and the back of it is dimmed by the front, so thick froxels don't glow
+        scattered += transmittance * froxel.rgb * (1 - slice_transmittance) / extinction;
+        transmittance *= slice_transmittance;
+
+        integrated[uint3(thread_id.xy, z)] = float4(scattered, transmittance);
+    }
+})";
+
+    static rhi::RhiResourceBarrier make_image_barrier(rhi::RhiImage* image,
+                                                      const rhi::ResourceState old_state,
+                                                      const rhi::ResourceState new_state) {
+        rhi::RhiResourceBarrier barrier{};
+        barrier.resource_to_barrier = image;
+        barrier.old_state = old_state;
+        barrier.new_state = new_state;
+        barrier.access_before_barrier = old_state == rhi::ResourceState::ShaderWrite ? rhi::ResourceAccess::ShaderWrite :
+                                                                                       rhi::ResourceAccess::ShaderRead;
+        barrier.access_after_barrier = new_state == rhi::ResourceState::ShaderWrite ? rhi::ResourceAccess::ShaderWrite :
+                                                                                      rhi::ResourceAccess::ShaderRead;
+        barrier.source_queue = rhi::QueueType::Graphics;
+        barrier.destination_queue = rhi::QueueType::Graphics;
+        barrier.image_memory_barrier.aspect = rhi::ImageAspect::Color;
+
+        return barrier;
+    }
+
+    static std::unique_ptr<rhi::RhiPipeline> create_fog_pipeline(rhi::RenderDevice& device,
+                                                                 const char* pipeline_name,
+                                                                 const char* shader_source,
+                                                                 const char* shader_filename) {
+        const auto full_source = std::string{FOG_STRUCTS_HLSL} + shader_source;
+        const auto spirv = renderpack::compile_shader(full_source, rhi::ShaderStage::Compute, rhi::ShaderLanguage::Hlsl);
+        if(spirv.empty()) {
+            logger->error("Could not compile {}", shader_filename);
+            return {};
+        }
+
+        RhiComputePipelineState pipeline_state{};
+        pipeline_state.name = pipeline_name;
+        pipeline_state.compute_shader = {shader_filename, spirv};
+        return device.create_compute_pipeline(pipeline_state);
+    }
+
+    /*!
+     * \brief The `index`th number of the Halton sequence with the provided base, from 0 to 1
+     */
+    static float halton(uint32_t index, const uint32_t base) {
+        float result = 0;
+        float fraction = 1;
+        while(index > 0) {
+            fraction /= static_cast<float>(base);
+            result += fraction * static_cast<float>(index % base);
+            index /= base;
+        }
+
+        return result;
+    }
+
+    VolumetricFog::VolumetricFog(rhi::RenderDevice& device,
+                                 const NovaSettings::VolumetricFogOptions& options,
+                                 const NovaSettings::LightClusteringOptions& cluster_options,
+                                 const LightClustering& light_clustering,
+                                 const uint32_t num_in_flight_frames)
+        : device{device}, options{options}, grid_size{1} {
+        ZoneScoped;
+        if(options.enabled) {
+            grid_size = glm::uvec3{cluster_options.grid_width * options.froxels_per_cluster_xy,
+                                   cluster_options.grid_height * options.froxels_per_cluster_xy,
+                                   cluster_options.grid_depth * options.froxels_per_cluster_z};
+        }
+
+        injection_pipeline = create_fog_pipeline(device,
+                                                 INJECTION_PIPELINE_NAME,
+                                                 INJECTION_SHADER_SOURCE,
+                                                 "/nova/shaders/volumetric_fog_injection.compute.hlsl");
+        integration_pipeline = create_fog_pipeline(device,
+                                                   INTEGRATION_PIPELINE_NAME,
+                                                   INTEGRATION_SHADER_SOURCE,
+                                                   "/nova/shaders/volumetric_fog_integration.compute.hlsl");
+
+        rhi::RhiSamplerCreateInfo sampler_create_info{};
+        sampler_create_info.min_filter = rhi::TextureFilter::Bilinear;
+        sampler_create_info.mag_filter = rhi::TextureFilter::Bilinear;
+        history_sampler = device.create_sampler(sampler_create_info);
+
+        renderpack::TextureCreateInfo volume_create_info{};
+        volume_create_info.usage = renderpack::ImageUsage::RenderTarget;
+        volume_create_info.format.pixel_format = rhi::PixelFormat::Rgba16F;
+        volume_create_info.format.dimension_type = renderpack::TextureDimensionType::Absolute;
+        volume_create_info.format.width = static_cast<float>(grid_size.x);
+        volume_create_info.format.height = static_cast<float>(grid_size.y);
+        volume_create_info.format.depth = grid_size.z;
+
+        for(uint32_t i = 0; i < scattering_volumes.size(); i++) {
+            volume_create_info.name = fmt::format("NovaFogScattering{}", i);
+            scattering_volumes[i] = device.create_image(volume_create_info);
+            scattering_volumes[i]->is_dynamic = false;
+        }
+
+        volume_create_info.name = VOLUMETRIC_FOG_IMAGE_NAME;
+        integrated_volume = device.create_image(volume_create_info);
+        integrated_volume->is_dynamic = false;
+
+        frames.resize(num_in_flight_frames);
+        for(uint32_t i = 0; i < num_in_flight_frames; i++) {
+            auto& frame = frames[i];
+
+            rhi::RhiBufferCreateInfo create_info{};
+            create_info.buffer_usage = rhi::BufferUsage::StorageBuffer;
+
+            create_info.name = fmt::format("NovaFogParams{}", i);
+            create_info.size = sizeof(FogParams);
+            frame.params = device.create_buffer(create_info);
+
+            create_info.name = fmt::format("NovaFogVolumes{}", i);
+            create_info.size = sizeof(GpuFogVolume) * std::max(options.max_fog_volumes, 1U);
+            frame.volumes = device.create_buffer(create_info);
+
+            if(injection_pipeline) {
+                for(uint32_t history_idx = 0; history_idx < frame.injection_binders.size(); history_idx++) {
+                    auto& binder = frame.injection_binders[history_idx];
+                    binder = device.create_resource_binder_for_pipeline(*injection_pipeline);
+                    binder->bind_buffer("params", frame.params);
+                    binder->bind_buffer("cluster_params", light_clustering.get_params_buffer(i));
+                    binder->bind_buffer("lights", light_clustering.get_light_buffer(i));
+                    binder->bind_buffer("light_clusters", light_clustering.get_cluster_buffer(i));
+                    binder->bind_buffer("light_indices", light_clustering.get_light_index_buffer(i));
+                    binder->bind_buffer("volumes", frame.volumes);
+                    binder->bind_image("history", scattering_volumes[history_idx]);
+                    binder->bind_sampler("history_sampler", history_sampler);
+                    binder->bind_image("scattering", scattering_volumes[1 - history_idx]);
+                }
+            }
+
+            if(integration_pipeline) {
+                for(uint32_t scattering_idx = 0; scattering_idx < frame.integration_binders.size(); scattering_idx++) {
+                    auto& binder = frame.integration_binders[scattering_idx];
+                    binder = device.create_resource_binder_for_pipeline(*integration_pipeline);
+                    binder->bind_buffer("params", frame.params);
+                    binder->bind_buffer("cluster_params", light_clustering.get_params_buffer(i));
+                    binder->bind_image("scattering", scattering_volumes[scattering_idx]);
+                    binder->bind_image("integrated", integrated_volume);
+                }
+            }
+
+            // The shaders may run before the first frame's params are written, so they have to say that there's no fog
+            const FogParams empty_params{};
+            device.write_data_to_buffer(&empty_params, sizeof(FogParams), frame.params);
+        }
+
+        volumes.reserve(options.max_fog_volumes);
+        volume_ids.reserve(options.max_fog_volumes);
+    }
+
+    VolumetricFog::~VolumetricFog() {
+        for(const FrameResources& frame : frames) {
+            device.destroy_buffer(frame.params);
+            device.destroy_buffer(frame.volumes);
+        }
+
+        for(auto* volume : scattering_volumes) {
+            device.destroy_texture(volume);
+        }
+
+        device.destroy_texture(integrated_volume);
+    }
+
+    void VolumetricFog::set_medium(const VolumetricMedium& new_medium) {
+        medium = new_medium;
+        medium_version++;
+    }
+
+    std::optional<FogVolumeId> VolumetricFog::add_fog_volume(const FogVolume& volume) {
+        if(volumes.size() >= options.max_fog_volumes) {
+            logger->error("There are already {} fog volumes, which is as many as there can be", options.max_fog_volumes);
+            return std::nullopt;
+        }
+
+        const auto volume_id = next_volume_id++;
+        volume_indices_by_id.emplace(volume_id, static_cast<uint32_t>(volumes.size()));
+        volumes.push_back({volume.position, volume.density, volume.half_size, volume.edge_softness, volume.albedo, 0});
+        volume_ids.push_back(volume_id);
+        volumes_version++;
+
+        return volume_id;
+    }
+
+    void VolumetricFog::update_fog_volume(const FogVolumeId volume_id, const FogVolume& volume) {
+        const auto itr = volume_indices_by_id.find(volume_id);
+        if(itr == volume_indices_by_id.end()) {
+            logger->error("Could not update fog volume {}", volume_id);
+            return;
+        }
+
+        volumes[itr->second] = {volume.position, volume.density, volume.half_size, volume.edge_softness, volume.albedo, 0};
+        volumes_version++;
+    }
+
+    void VolumetricFog::remove_fog_volume(const FogVolumeId volume_id) {
+        const auto itr = volume_indices_by_id.find(volume_id);
+        if(itr == volume_indices_by_id.end()) {
+            logger->error("Could not remove fog volume {}", volume_id);
+            return;
+        }
+
+        const auto volume_idx = itr->second;
+        volume_indices_by_id.erase(itr);
+
+        if(volume_idx != volumes.size() - 1) {
+            volumes[volume_idx] = volumes.back();
+            volume_ids[volume_idx] = volume_ids.back();
+            volume_indices_by_id.at(volume_ids[volume_idx]) = volume_idx;
+        }
+
+        volumes.pop_back();
+        volume_ids.pop_back();
+        volumes_version++;
+    }
+
+    void VolumetricFog::upload_volumes(const uint32_t frame_idx) {
+        ZoneScoped;
+        auto& frame = frames[frame_idx];
+        if(frame.volumes_version == volumes_version) {
+            return;
+        }
+
+        if(!volumes.empty()) {
+            device.write_data_to_buffer(volumes.data(), sizeof(GpuFogVolume) * volumes.size(), frame.volumes);
+        }
+
+        frame.volumes_version = volumes_version;
+        frame.num_volumes = static_cast<uint32_t>(volumes.size());
+    }
+
+    void VolumetricFog::record_fog(rhi::RhiRenderCommandList& cmds, const uint32_t frame_idx) {
+        ZoneScoped;
+        const auto& frame = frames[frame_idx];
+
+        // Any shader may read the fog, including the shaders of renderpack compute passes
+        const auto reading_stages = rhi::PipelineStage::VertexShader | rhi::PipelineStage::FragmentShader |
+                                    rhi::PipelineStage::ComputeShader;
+
+        // The standard descriptor set points at the integrated volume no matter what, so it has to be readable even without any fog
+        if(!injection_pipeline || !integration_pipeline) {
+            if(integrated_state == rhi::ResourceState::Undefined) {
+                cmds.resource_barriers(rhi::PipelineStage::TopOfPipe,
+                                       reading_stages,
+                                       std::array{make_image_barrier(integrated_volume,
+                                                                     rhi::ResourceState::Undefined,
+                                                                     rhi::ResourceState::ShaderRead)});
+                integrated_state = rhi::ResourceState::ShaderRead;
+            }
+            return;
+        }
+
+        const auto prev_scattering = 1 - cur_scattering;
+
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                               rhi::PipelineStage::ComputeShader,
+                               std::array{make_image_barrier(scattering_volumes[prev_scattering],
+                                                             scattering_states[prev_scattering],
+                                                             rhi::ResourceState::ShaderRead),
+                                          make_image_barrier(scattering_volumes[cur_scattering],
+                                                             scattering_states[cur_scattering],
+                                                             rhi::ResourceState::ShaderWrite)});
+
+        cmds.set_compute_pipeline(*injection_pipeline);
+        cmds.bind_compute_resources(*frame.injection_binders[prev_scattering], frame_idx);
+        cmds.dispatch((grid_size.x + INJECTION_GROUP_SIZE - 1) / INJECTION_GROUP_SIZE,
+                      (grid_size.y + INJECTION_GROUP_SIZE - 1) / INJECTION_GROUP_SIZE,
+                      (grid_size.z + INJECTION_GROUP_SIZE - 1) / INJECTION_GROUP_SIZE);
+
+        // Last frame's renderpasses may still be reading the integrated volume
+        cmds.resource_barriers(reading_stages,
+                               rhi::PipelineStage::ComputeShader,
+                               std::array{make_image_barrier(scattering_volumes[cur_scattering],
+                                                             rhi::ResourceState::ShaderWrite,
+                                                             rhi::ResourceState::ShaderRead),
+                                          make_image_barrier(integrated_volume, integrated_state, rhi::ResourceState::ShaderWrite)});
+
+        cmds.set_compute_pipeline(*integration_pipeline);
+        cmds.bind_compute_resources(*frame.integration_binders[cur_scattering], frame_idx);
+        cmds.dispatch((grid_size.x + INTEGRATION_GROUP_SIZE - 1) / INTEGRATION_GROUP_SIZE,
+                      (grid_size.y + INTEGRATION_GROUP_SIZE - 1) / INTEGRATION_GROUP_SIZE);
+
+        cmds.resource_barriers(rhi::PipelineStage::ComputeShader,
+                               reading_stages,
+                               std::array{make_image_barrier(integrated_volume,
+                                                             rhi::ResourceState::ShaderWrite,
+                                                             rhi::ResourceState::ShaderRead)});
+
+        scattering_states[prev_scattering] = rhi::ResourceState::ShaderRead;
+        scattering_states[cur_scattering] = rhi::ResourceState::ShaderRead;
+        integrated_state = rhi::ResourceState::ShaderRead;
+
+        cur_scattering = prev_scattering;
+    }
+
+    void VolumetricFog::upload_params(const uint32_t frame_idx, const Camera* camera, const CameraUboData* camera_data) {
+        ZoneScoped;
+        const auto& frame = frames[frame_idx];
+
+        const auto jitter_idx = frame_count % JITTER_PERIOD + 1;
+        frame_count++;
+
+        FogParams params{};
+        params.grid_size = {grid_size, frame.num_volumes};
+        params.froxels_per_cluster = {options.froxels_per_cluster_xy, options.froxels_per_cluster_xy, options.froxels_per_cluster_z, 0};
+        params.albedo = medium.albedo;
+        params.density = medium.density;
+        params.ambient = medium.ambient;
+        params.height_falloff = medium.height_falloff;
+        params.base_height = medium.base_height;
+        params.anisotropy = glm::clamp(medium.anisotropy, -0.99f, 0.99f);
+        params.history_weight = glm::clamp(options.history_weight, 0.0f, 1.0f);
+        params.jitter_x = halton(jitter_idx, 2) - 0.5f;
+        params.jitter_y = halton(jitter_idx, 3) - 0.5f;
+        params.jitter_z = halton(jitter_idx, 5) - 0.5f;
+
+        // The froxels are light clusters cut into pieces, so the fog only works where the light clusters do
+        if(options.enabled && camera != nullptr && camera_data != nullptr && camera->field_of_view > 0 &&
+           camera->far_plane > camera->near_plane && camera->near_plane > 0) {
+            params.inverse_view = glm::inverse(camera_data->view);
+            params.enabled = 1;
+
+            if(previous_view_projection) {
+                params.previous_view_projection = *previous_view_projection;
+                params.froxels_per_cluster.w = 1;
+            }
+
+            previous_view_projection = camera_data->projection * camera_data->view;
+
+        } else {
+            previous_view_projection.reset();
+        }
+
+        device.write_data_to_buffer(&params, sizeof(FogParams), frame.params);
+    }
+
+    uint64_t VolumetricFog::get_version() const { return volumes_version + medium_version; }
+
+    rhi::RhiImage* VolumetricFog::get_integrated_volume() const { return integrated_volume; }
+} // namespace nova::renderer
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nova_renderer/fog_volumes.hpp"
+#include "nova_renderer/nova_settings.hpp"
+#include "nova_renderer/rhi/forward_decls.hpp"
+#include "nova_renderer/rhi/rhi_enums.hpp"
+
+namespace nova::renderer {
+    class RhiResourceBinder;
+    class Camera;
+    class LightClustering;
+    struct CameraUboData;
+
+    namespace rhi {
+        class RenderDevice;
+    }
+
+    /*!
+     * \brief Fills a low resolution froxel grid in front of the main camera with fog, and works out how much of it the camera sees up to
+     * each froxel
+     *
+     * The froxels are the light clusters cut into smaller pieces, so each froxel only lights its fog with its cluster's lights. The first
+     * dispatch works out each froxel's density and the light it scatters at a jittered spot in the froxel, and blends that with where the
+     * froxel was last frame. The second walks every column of froxels away from the camera and adds them up. Shaders get the result with
+     * one lookup into a 3D texture, through `sample_volumetric_fog` in `./nova/volumetric_fog.hlsl`, instead of raymarching every pixel
+     *
+     * The fog is built from the camera and the lights alone, so it runs right after the light clustering and doesn't wait for any
+     * renderpass
+     */
+    class VolumetricFog {
+    public:
+        VolumetricFog(rhi::RenderDevice& device,
+                      const NovaSettings::VolumetricFogOptions& options,
+                      const NovaSettings::LightClusteringOptions& cluster_options,
+                      const LightClustering& light_clustering,
+                      uint32_t num_in_flight_frames);
+
+        VolumetricFog(const VolumetricFog& other) = delete;
+        VolumetricFog& operator=(const VolumetricFog& other) = delete;
+
+        VolumetricFog(VolumetricFog&& old) noexcept = delete;
+        VolumetricFog& operator=(VolumetricFog&& old) noexcept = delete;
+
+        ~VolumetricFog();
+
+        void set_medium(const VolumetricMedium& new_medium);
+
+        /*!
+         * \return The fog volume's ID, or nothing if there are already `VolumetricFogOptions::max_fog_volumes` fog volumes
+         */
+        [[nodiscard]] std::optional<FogVolumeId> add_fog_volume(const FogVolume& volume);
+
+        void update_fog_volume(FogVolumeId volume_id, const FogVolume& volume);
+
+        void remove_fog_volume(FogVolumeId volume_id);
+
+        /*!
+         * \brief Writes the fog volumes to the frame slot's fog volume buffer, if they changed since that frame slot last got them
+         *
+         * Call this after the frame slot's fence has signaled, and before `record_fog`
+         */
+        void upload_volumes(uint32_t frame_idx);
+
+        /*!
+         * \brief Records the dispatches that fill the froxel grid and add it up
+         *
+         * This must be recorded outside of any renderpass, after the light clustering, and before anything reads the fog
+         */
+        void record_fog(rhi::RhiRenderCommandList& cmds, uint32_t frame_idx);
+
+        /*!
+         * \brief Tells the fog shaders which camera to build the fog for, and where it was last frame
+         *
+         * \param camera The main camera, or nullptr if there isn't one. There's only fog for perspective cameras
+         * \param camera_data The main camera's matrices, which must already be up-to-date for this frame
+         */
+        void upload_params(uint32_t frame_idx, const Camera* camera, const CameraUboData* camera_data);
+
+        /*!
+         * \brief Goes up every time the medium or a fog volume changes
+         */
+        [[nodiscard]] uint64_t get_version() const;
+
+        /*!
+         * \brief The 3D image with the light that the fog scatters toward the camera up to each froxel in rgb, and how much light makes
+         * it through in a
+         */
+        [[nodiscard]] rhi::RhiImage* get_integrated_volume() const;
+
+    private:
+        /*!
+         * \brief Matches `FogVolume` in the injection shader
+         */
+        struct GpuFogVolume {
+            glm::vec3 position;
+            float density;
+
+            glm::vec3 half_size;
+            float edge_softness;
+
+            glm::vec3 albedo;
+            float padding;
+        };
+
+        /*!
+         * \brief Matches `FogParams` in the fog shaders
+         */
+        struct FogParams {
+            glm::mat4 inverse_view;
+
+            glm::mat4 previous_view_projection;
+
+            /*!
+             * \brief The froxel grid's size in xyz, and the number of fog volumes in w
+             */
+            glm::uvec4 grid_size;
+
+            /*!
+             * \brief How many froxels each light cluster has in xyz, and whether last frame's fog can be blended in in w
+             */
+            glm::uvec4 froxels_per_cluster;
+
+            glm::vec3 albedo;
+            float density;
+
+            glm::vec3 ambient;
+            float height_falloff;
+
+            float base_height;
+            float anisotropy;
+            float history_weight;
+
+            /*!
+             * \brief Where in its froxel this frame samples the fog, from -0.5 to 0.5 in each axis
+             */
+            float jitter_x;
+
+            float jitter_y;
+            float jitter_z;
+
+            /*!
+             * \brief Zero when there's no camera to build the fog for, or the fog is turned off
+             */
+            uint32_t enabled;
+
+            uint32_t padding;
+        };
+
+        struct FrameResources {
+            rhi::RhiBuffer* params = nullptr;
+
+            rhi::RhiBuffer* volumes = nullptr;
+
+            /*!
+             * \brief Binders of the injection shader. Element 0 reads scattering volume 0 and writes scattering volume 1, element 1 the
+             * other way around
+             */
+            std::array<std::unique_ptr<RhiResourceBinder>, 2> injection_binders;
+
+            /*!
+             * \brief Binders of the integration shader. Element N reads scattering volume N
+             */
+            std::array<std::unique_ptr<RhiResourceBinder>, 2> integration_binders;
+
+            /*!
+             * \brief `volumes_version` when this frame slot's fog volume buffer was last written
+             */
+            uint64_t volumes_version = 0;
+
+            uint32_t num_volumes = 0;
+        };
+
+        rhi::RenderDevice& device;
+
+        NovaSettings::VolumetricFogOptions options;
+
+        /*!
+         * \brief How many froxels the grid has in each direction. Just one when the fog is off, so there's still something to bind
+         */
+        glm::uvec3 grid_size;
+
+        std::unique_ptr<rhi::RhiPipeline> injection_pipeline;
+
+        std::unique_ptr<rhi::RhiPipeline> integration_pipeline;
+
+        rhi::RhiSampler* history_sampler = nullptr;
+
+        std::vector<FrameResources> frames;
+
+        /*!
+         * \brief The fog and light that each froxel has this frame and had last frame, in camera space. Which is which flips every frame
+         */
+        std::array<rhi::RhiImage*, 2> scattering_volumes{};
+
+        std::array<rhi::ResourceState, 2> scattering_states{rhi::ResourceState::Undefined, rhi::ResourceState::Undefined};
+
+        rhi::RhiImage* integrated_volume = nullptr;
+
+        rhi::ResourceState integrated_state = rhi::ResourceState::Undefined;
+
+        /*!
+         * \brief Which scattering volume the current frame writes
+         */
+        uint32_t cur_scattering = 1;
+
+        /*!
+         * \brief How many frames have been recorded, which picks each frame's jitter
+         */
+        uint32_t frame_count = 0;
+
+        /*!
+         * \brief The view-projection matrix of the last frame that had fog, if the last frame had any
+         */
+        std::optional<glm::mat4> previous_view_projection;
+
+        VolumetricMedium medium;
+
+        /*!
+         * \brief Every fog volume, tightly packed. Removing a fog volume moves the last fog volume into its spot
+         */
+        std::vector<GpuFogVolume> volumes;
+
+        /*!
+         * \brief The ID of each fog volume in `volumes`
+         */
+        std::vector<FogVolumeId> volume_ids;
+
+        std::unordered_map<FogVolumeId, uint32_t> volume_indices_by_id;
+
+        FogVolumeId next_volume_id = 0;
+
+        /*!
+         * \brief Goes up every time a fog volume is added, changed, or removed. Starts at one, so every frame slot gets the fog volumes
+         * once
+         */
+        uint64_t volumes_version = 1;
+
+        /*!
+         * \brief Goes up every time the medium changes
+         */
+        uint64_t medium_version = 0;
+    };
+} // namespace nova::renderer
@@ -0,0 +1,672 @@
+#include "command_stream.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+#include <Tracy.hpp>
+
+#include "nova_renderer/camera.hpp"
+
+namespace nova::renderer::rhi {
+    enum StreamCommand : uint32_t {
+        SetDebugName,
+        BindMaterialResources,
+        BindResources,
+        ResourceBarriers,
+        CopyBuffer,
+        UploadDataToImage,
+        CopyBufferToImage,
+        CopyImageToBuffer,
+        BlitImage,
+        GenerateMips,
+        ExecuteCommandLists,
+        BeginRenderpass,
+        NextSubpass,
+        EndRenderpass,
+        SetDrawConstants,
+        SetPipeline,
+        BindDescriptorSets,
+        BindVertexBuffers,
+        BindIndexBuffer,
+        DrawIndexedMesh,
+        DrawIndexedIndirect,
+        SetComputePipeline,
+        BindComputeResources,
+        Dispatch,
+        DispatchIndirect,
+        SetScissorRect,
+        SetViewport,
+        WriteTimestamp,
+        BeginQuery,
+        EndQuery,
+    };
+
+    struct PacketHeader {
+        uint32_t command;
+
+        /*!
+         * \brief Size of the whole packet in words, including this header
+         */
+        uint32_t num_words;
+    };
+
+    struct EmptyPayload {};
+
+    struct CountPayload {
+        uint32_t count;
+    };
+
+    struct BinderPayload {
+        RhiResourceBinder* binder;
+        uint32_t frame_idx;
+    };
+
+    struct BarriersPayload {
+        PipelineStage stages_before_barrier;
+        PipelineStage stages_after_barrier;
+        uint32_t num_barriers;
+    };
+
+    struct CopyBufferPayload {
+        RhiBuffer* destination_buffer;
+        uint64_t destination_offset;
+        RhiBuffer* source_buffer;
+        uint64_t source_offset;
+        uint64_t num_bytes;
+    };
+
+    struct UploadDataToImagePayload {
+        RhiImage* image;
+        uint64_t width;
+        uint64_t height;
+        uint64_t bytes_per_pixel;
+        RhiBuffer* staging_buffer;
+        uint64_t staging_buffer_offset;
+    };
+
+    struct CopyBufferToImagePayload {
+        RhiImage* image;
+        uint32_t mip_level;
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+        RhiBuffer* source_buffer;
+        uint64_t source_offset;
+    };
+
+    struct CopyImageToBufferPayload {
+        RhiBuffer* destination_buffer;
+        uint64_t destination_offset;
+        RhiImage* image;
+        uint32_t mip_level;
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct BlitImagePayload {
+        RhiImage* source;
+        uint32_t source_layer;
+        uint32_t source_width;
+        uint32_t source_height;
+        RhiImage* destination;
+        uint32_t destination_width;
+        uint32_t destination_height;
+    };
+
+    struct GenerateMipsPayload {
+        RhiImage* image;
+        uint32_t source_mip;
+        uint32_t source_width;
+        uint32_t source_height;
+        uint32_t num_mips;
+    };
+
+    struct BeginRenderpassPayload {
+        RhiRenderpass* renderpass;
+        RhiFramebuffer* framebuffer;
+        RenderpassContents contents;
+    };
+
+    struct PipelinePayload {
+        const RhiPipeline* pipeline;
+    };
+
+    struct DescriptorSetsPayload {
+        const RhiPipelineInterface* pipeline_interface;
+        uint32_t num_sets;
+    };
+
+    struct IndexBufferPayload {
+        const RhiBuffer* buffer;
+        IndexType index_type;
+    };
+
+    struct DrawIndexedMeshPayload {
+        uint32_t num_indices;
+        uint32_t offset;
+        uint32_t num_instances;
+        int32_t vertex_offset;
+    };
+
+    struct DrawIndexedIndirectPayload {
+        const RhiBuffer* draw_commands;
+        uint64_t draw_commands_offset;
+        const RhiBuffer* draw_count_buffer;
+        uint64_t draw_count_offset;
+        uint32_t max_draw_count;
+    };
+
+    struct DispatchPayload {
+        uint32_t num_groups_x;
+        uint32_t num_groups_y;
+        uint32_t num_groups_z;
+    };
+
+    struct DispatchIndirectPayload {
+        const RhiBuffer* dispatch_buffer;
+        uint64_t offset;
+    };
+
+    struct RectPayload {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct TimestampPayload {
+        RhiQueryPool* pool;
+        uint32_t timestamp_idx;
+        PipelineStage stage;
+    };
+
+    struct QueryPayload {
+        RhiQueryPool* pool;
+        uint32_t query_idx;
+    };
+
+    constexpr size_t to_num_words(const size_t num_bytes) { return (num_bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t); }
+
+    template <typename PayloadType>
+    void CommandStream::append(const uint32_t command, const PayloadType& payload, const void* extra_data, const size_t extra_size) {
+        static_assert(std::is_trivially_copyable_v<PayloadType>);
+        static_assert(alignof(PayloadType) <= alignof(uint64_t));
+
+        const auto payload_words = to_num_words(sizeof(PayloadType));
+        const auto num_words = 1 + payload_words + to_num_words(extra_size);
+
+        const auto offset = packets.size();
+        packets.resize(offset + num_words);
+
+        auto* packet = reinterpret_cast<uint8_t*>(packets.data() + offset);
+        const PacketHeader header{command, static_cast<uint32_t>(num_words)};
+        std::memcpy(packet, &header, sizeof(PacketHeader));
+        std::memcpy(packet + sizeof(uint64_t), &payload, sizeof(PayloadType));
+        if(extra_size > 0) {
+            std::memcpy(packet + (1 + payload_words) * sizeof(uint64_t), extra_data, extra_size);
+        }
+    }
+
+    void CommandStream::reset() {
+        packets.clear();
+        forget_bound_state();
+        draw_constants = {};
+    }
+
+    /*!
+     * \brief Reads one packet's payload, and finds the variable-length data after it
+     */
+    template <typename PayloadType>
+    static PayloadType read_payload(const uint64_t* packet, const void** extra_data = nullptr) {
+        PayloadType payload;
+        std::memcpy(&payload, packet + 1, sizeof(PayloadType));
+        if(extra_data != nullptr) {
+            *extra_data = packet + 1 + to_num_words(sizeof(PayloadType));
+        }
+
+        return payload;
+    }
+
+    void CommandStream::translate(RhiRenderCommandList& cmds) const {
+        ZoneScoped;
+        // The command list wants vectors, so the arrays are copied into these. They keep their memory between packets
+        std::vector<RhiDescriptorSet*> descriptor_sets;
+        std::vector<RhiBuffer*> buffers;
+
+        for(size_t offset = 0; offset < packets.size();) {
+            const auto* packet = packets.data() + offset;
+
+            PacketHeader header;
+            std::memcpy(&header, packet, sizeof(PacketHeader));
+            offset += header.num_words;
+
+            const void* extra = nullptr;
+            switch(header.command) {
+                case SetDebugName: {
+                    const auto [length] = read_payload<CountPayload>(packet, &extra);
+                    cmds.set_debug_name(std::string{static_cast<const char*>(extra), length});
+                } break;
+
+                case BindMaterialResources:
+                    cmds.bind_material_resources(read_payload<CountPayload>(packet).count);
+                    break;
+
+                case BindResources: {
+                    const auto [binder, frame_idx] = read_payload<BinderPayload>(packet);
+                    cmds.bind_resources(*binder, frame_idx);
+                } break;
+
+                case ResourceBarriers: {
+                    const auto [before, after, num_barriers] = read_payload<BarriersPayload>(packet, &extra);
+                    cmds.resource_barriers(before, after, {static_cast<const RhiResourceBarrier*>(extra), num_barriers});
+                } break;
+
+                case CopyBuffer: {
+                    const auto copy = read_payload<CopyBufferPayload>(packet);
+                    cmds.copy_buffer(copy.destination_buffer,
+                                     copy.destination_offset,
+                                     copy.source_buffer,
+                                     copy.source_offset,
+                                     copy.num_bytes);
+                } break;
+
+                case UploadDataToImage: {
+                    const auto upload = read_payload<UploadDataToImagePayload>(packet, &extra);
+                    cmds.upload_data_to_image(upload.image,
+                                              upload.width,
+                                              upload.height,
+                                              upload.bytes_per_pixel,
+                                              upload.staging_buffer,
+                                              extra,
+                                              upload.staging_buffer_offset);
+                } break;
+
+                case CopyBufferToImage: {
+                    const auto copy = read_payload<CopyBufferToImagePayload>(packet);
+                    cmds.copy_buffer_to_image(copy.image,
+                                              copy.mip_level,
+                                              copy.x,
+                                              copy.y,
+                                              copy.width,
+                                              copy.height,
+                                              copy.source_buffer,
+                                              copy.source_offset);
+                } break;
+
+                case CopyImageToBuffer: {
+                    const auto copy = read_payload<CopyImageToBufferPayload>(packet);
+                    cmds.copy_image_to_buffer(copy.destination_buffer,
+                                              copy.destination_offset,
+                                              copy.image,
+                                              copy.mip_level,
+                                              copy.x,
+                                              copy.y,
+                                              copy.width,
+                                              copy.height);
+                } break;
+
+                case BlitImage: {
+                    const auto blit = read_payload<BlitImagePayload>(packet);
+                    cmds.blit_image(blit.source,
+                                    blit.source_layer,
+                                    blit.source_width,
+                                    blit.source_height,
+                                    blit.destination,
+                                    blit.destination_width,
+                                    blit.destination_height);
+                } break;
+
+                case GenerateMips: {
+                    const auto mips = read_payload<GenerateMipsPayload>(packet);
+                    cmds.generate_mips(mips.image, mips.source_mip, mips.source_width, mips.source_height, mips.num_mips);
+                } break;
+
+                case ExecuteCommandLists: {
+                    const auto [num_lists] = read_payload<CountPayload>(packet, &extra);
+                    const auto* lists = static_cast<RhiRenderCommandList* const*>(extra);
+                    cmds.execute_command_lists({lists, lists + num_lists});
+                } break;
+
+                case BeginRenderpass: {
+                    const auto [renderpass, framebuffer, contents] = read_payload<BeginRenderpassPayload>(packet);
+                    cmds.begin_renderpass(renderpass, framebuffer, contents);
+                } break;
+
+                case NextSubpass:
+                    cmds.next_subpass(static_cast<RenderpassContents>(read_payload<CountPayload>(packet).count));
+                    break;
+
+                case EndRenderpass:
+                    cmds.end_renderpass();
+                    break;
+
+                case SetDrawConstants:
+                    cmds.set_draw_constants(read_payload<RhiDrawConstants>(packet));
+                    break;
+
+                case SetPipeline:
+                    cmds.set_pipeline(*read_payload<PipelinePayload>(packet).pipeline);
+                    break;
+
+                case BindDescriptorSets: {
+                    const auto [pipeline_interface, num_sets] = read_payload<DescriptorSetsPayload>(packet, &extra);
+                    const auto* sets = static_cast<RhiDescriptorSet* const*>(extra);
+                    descriptor_sets.assign(sets, sets + num_sets);
+                    cmds.bind_descriptor_sets(descriptor_sets, pipeline_interface);
+                } break;
+
+                case BindVertexBuffers: {
+                    const auto [num_buffers] = read_payload<CountPayload>(packet, &extra);
+                    const auto* vertex_buffers = static_cast<RhiBuffer* const*>(extra);
+                    buffers.assign(vertex_buffers, vertex_buffers + num_buffers);
+                    cmds.bind_vertex_buffers(buffers);
+                } break;
+
+                case BindIndexBuffer: {
+                    const auto [buffer, index_type] = read_payload<IndexBufferPayload>(packet);
+                    cmds.bind_index_buffer(buffer, index_type);
+                } break;
+
+                case DrawIndexedMesh: {
+                    const auto [num_indices, first_index, num_instances, vertex_offset] = read_payload<DrawIndexedMeshPayload>(packet);
+                    cmds.draw_indexed_mesh(num_indices, first_index, num_instances, vertex_offset);
+                } break;
+
+                case DrawIndexedIndirect: {
+                    const auto draw = read_payload<DrawIndexedIndirectPayload>(packet);
+                    cmds.draw_indexed_indirect(draw.draw_commands,
+                                               draw.draw_commands_offset,
+                                               draw.max_draw_count,
+                                               draw.draw_count_buffer,
+                                               draw.draw_count_offset);
+                } break;
+
+                case SetComputePipeline:
+                    cmds.set_compute_pipeline(*read_payload<PipelinePayload>(packet).pipeline);
+                    break;
+
+                case BindComputeResources: {
+                    const auto [binder, frame_idx] = read_payload<BinderPayload>(packet);
+                    cmds.bind_compute_resources(*binder, frame_idx);
+                } break;
+
+                case Dispatch: {
+                    const auto [x, y, z] = read_payload<DispatchPayload>(packet);
+                    cmds.dispatch(x, y, z);
+                } break;
+
+                case DispatchIndirect: {
+                    const auto [dispatch_buffer, dispatch_offset] = read_payload<DispatchIndirectPayload>(packet);
+                    cmds.dispatch_indirect(dispatch_buffer, dispatch_offset);
+                } break;
+
+                case SetScissorRect: {
+                    const auto [x, y, width, height] = read_payload<RectPayload>(packet);
+                    cmds.set_scissor_rect(x, y, width, height);
+                } break;
+
+                case SetViewport: {
+                    const auto [x, y, width, height] = read_payload<RectPayload>(packet);
+                    cmds.set_viewport(x, y, width, height);
+                } break;
+
+                case WriteTimestamp: {
+                    const auto [pool, timestamp_idx, stage] = read_payload<TimestampPayload>(packet);
+                    cmds.write_timestamp(pool, timestamp_idx, stage);
+                } break;
+
+                case BeginQuery: {
+                    const auto [pool, query_idx] = read_payload<QueryPayload>(packet);
+                    cmds.begin_query(pool, query_idx);
+                } break;
+
+                case EndQuery: {
+                    const auto [pool, query_idx] = read_payload<QueryPayload>(packet);
+                    cmds.end_query(pool, query_idx);
+                } break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    size_t CommandStream::get_size() const { return packets.size() * sizeof(uint64_t); }
+
+    void CommandStream::set_debug_name(const std::string& name) {
+        append(SetDebugName, CountPayload{static_cast<uint32_t>(name.size())}, name.data(), name.size());
+    }
+
+    void CommandStream::bind_material_resources(const uint32_t frame_idx) {
+        append(BindMaterialResources, CountPayload{frame_idx});
+        bound_descriptor_sets.clear();
+    }
+
+    void CommandStream::bind_resources(RhiResourceBinder& binder, const uint32_t frame_idx) {
+        append(BindResources, BinderPayload{&binder, frame_idx});
+        bound_descriptor_sets.clear();
+    }
+
+    void CommandStream::resource_barriers(const PipelineStage stages_before_barrier,
+                                          const PipelineStage stages_after_barrier,
+                                          const std::span<const RhiResourceBarrier> barriers) {
+        static_assert(std::is_trivially_copyable_v<RhiResourceBarrier>);
+        append(ResourceBarriers,
+               BarriersPayload{stages_before_barrier, stages_after_barrier, static_cast<uint32_t>(barriers.size())},
+               barriers.data(),
+               barriers.size_bytes());
+    }
+
+    void CommandStream::copy_buffer(RhiBuffer* destination_buffer,
+                                    const mem::Bytes destination_offset,
+                                    RhiBuffer* source_buffer,
+                                    const mem::Bytes source_offset,
+                                    const mem::Bytes num_bytes) {
+        append(CopyBuffer,
+               CopyBufferPayload{destination_buffer,
+                                 destination_offset.b_count(),
+                                 source_buffer,
+                                 source_offset.b_count(),
+                                 num_bytes.b_count()});
+    }
+
+    void CommandStream::upload_data_to_image(RhiImage* image,
+                                             const size_t width,
+                                             const size_t height,
+                                             const size_t bytes_per_pixel,
+                                             RhiBuffer* staging_buffer,
+                                             const void* data,
+                                             const uint64_t staging_buffer_offset) {
+        append(UploadDataToImage,
+               UploadDataToImagePayload{image, width, height, bytes_per_pixel, staging_buffer, staging_buffer_offset},
+               data,
+               width * height * bytes_per_pixel);
+    }
+
+    void CommandStream::copy_buffer_to_image(RhiImage* image,
+                                             const uint32_t mip_level,
+                                             const uint32_t x,
+                                             const uint32_t y,
+                                             const uint32_t width,
+                                             const uint32_t height,
+                                             RhiBuffer* source_buffer,
+                                             const mem::Bytes source_offset) {
+        append(CopyBufferToImage, CopyBufferToImagePayload{image, mip_level, x, y, width, height, source_buffer, source_offset.b_count()});
+    }
+
+    void CommandStream::copy_image_to_buffer(RhiBuffer* destination_buffer,
+                                             const mem::Bytes destination_offset,
+                                             RhiImage* image,
+                                             const uint32_t mip_level,
+                                             const uint32_t x,
+                                             const uint32_t y,
+                                             const uint32_t width,
+                                             const uint32_t height) {
+        append(CopyImageToBuffer,
+               CopyImageToBufferPayload{destination_buffer, destination_offset.b_count(), image, mip_level, x, y, width, height});
+    }
+
+    void CommandStream::blit_image(RhiImage* source,
+                                   const uint32_t source_layer,
+                                   const uint32_t source_width,
+                                   const uint32_t source_height,
+                                   RhiImage* destination,
+                                   const uint32_t destination_width,
+                                   const uint32_t destination_height) {
+        append(BlitImage,
+               BlitImagePayload{source, source_layer, source_width, source_height, destination, destination_width, destination_height});
+    }
+
+    void CommandStream::generate_mips(RhiImage* image,
+                                      const uint32_t source_mip,
+                                      const uint32_t source_width,
+                                      const uint32_t source_height,
+                                      const uint32_t num_mips) {
+        append(GenerateMips, GenerateMipsPayload{image, source_mip, source_width, source_height, num_mips});
+    }
+
+    void CommandStream::execute_command_lists(const std::vector<RhiRenderCommandList*>& lists) {
+        append(ExecuteCommandLists, CountPayload{static_cast<uint32_t>(lists.size())}, lists.data(), lists.size() * sizeof(lists[0]));
+        forget_bound_state();
+    }
+
+    void CommandStream::set_camera(const Camera& camera) { set_camera_index(camera.index); }
+
+    void CommandStream::set_camera_index(const uint32_t index) { draw_constants.camera_index = index; }
+
+    void CommandStream::begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer, const RenderpassContents contents) {
+        append(BeginRenderpass, BeginRenderpassPayload{renderpass, framebuffer, contents});
+        forget_bound_state();
+    }
+
+    void CommandStream::next_subpass(const RenderpassContents contents) {
+        append(NextSubpass, CountPayload{static_cast<uint32_t>(contents)});
+        forget_bound_state();
+    }
+
+    void CommandStream::end_renderpass() {
+        append(EndRenderpass, EmptyPayload{});
+        forget_bound_state();
+    }
+
+    void CommandStream::set_material_index(const uint32_t index) { draw_constants.material_index = index; }
+
+    void CommandStream::set_draw_constants(const RhiDrawConstants& constants) { draw_constants = constants; }
+
+    void CommandStream::set_pipeline(const RhiPipeline& pipeline) {
+        if(&pipeline == bound_pipeline) {
+            return;
+        }
+
+        append(SetPipeline, PipelinePayload{&pipeline});
+        bound_pipeline = &pipeline;
+
+        // A pipeline with a different layout may disturb the descriptor sets, so they get bound again next time
+        bound_descriptor_sets.clear();
+    }
+
+    void CommandStream::bind_descriptor_sets(const std::vector<RhiDescriptorSet*>& descriptor_sets,
+                                             const RhiPipelineInterface* pipeline_interface) {
+        if(pipeline_interface == bound_pipeline_interface && !bound_descriptor_sets.empty() && descriptor_sets == bound_descriptor_sets) {
+            return;
+        }
+
+        append(BindDescriptorSets,
+               DescriptorSetsPayload{pipeline_interface, static_cast<uint32_t>(descriptor_sets.size())},
+               descriptor_sets.data(),
+               descriptor_sets.size() * sizeof(descriptor_sets[0]));
+        bound_pipeline_interface = pipeline_interface;
+        bound_descriptor_sets = descriptor_sets;
+    }
+
+    void CommandStream::bind_vertex_buffers(const std::vector<RhiBuffer*>& buffers) {
+        if(!bound_vertex_buffers.empty() && buffers == bound_vertex_buffers) {
+            return;
+        }
+
+        append(BindVertexBuffers, CountPayload{static_cast<uint32_t>(buffers.size())}, buffers.data(), buffers.size() * sizeof(buffers[0]));
+        bound_vertex_buffers = buffers;
+    }
+
+    void CommandStream::bind_index_buffer(const RhiBuffer* buffer, const IndexType index_type) {
+        if(buffer == bound_index_buffer && index_type == bound_index_type) {
+            return;
+        }
+
+        append(BindIndexBuffer, IndexBufferPayload{buffer, index_type});
+        bound_index_buffer = buffer;
+        bound_index_type = index_type;
+    }
+
+    void CommandStream::draw_indexed_mesh(const uint32_t num_indices,
+                                          const uint32_t offset,
+                                          const uint32_t num_instances,
+                                          const int32_t vertex_offset) {
+        record_draw_constants();
+        append(DrawIndexedMesh, DrawIndexedMeshPayload{num_indices, offset, num_instances, vertex_offset});
+    }
+
+    void CommandStream::draw_indexed_indirect(const RhiBuffer* draw_commands,
+                                              const uint64_t draw_commands_offset,
+                                              const uint32_t max_draw_count,
+                                              const RhiBuffer* draw_count_buffer,
+                                              const uint64_t draw_count_offset) {
+        record_draw_constants();
+        append(DrawIndexedIndirect,
+               DrawIndexedIndirectPayload{draw_commands, draw_commands_offset, draw_count_buffer, draw_count_offset, max_draw_count});
+    }
+
+    void CommandStream::set_compute_pipeline(const RhiPipeline& pipeline) { append(SetComputePipeline, PipelinePayload{&pipeline}); }
+
+    void CommandStream::bind_compute_resources(RhiResourceBinder& binder, const uint32_t frame_idx) {
+        append(BindComputeResources, BinderPayload{&binder, frame_idx});
+    }
+
+    void CommandStream::dispatch(const uint32_t num_groups_x, const uint32_t num_groups_y, const uint32_t num_groups_z) {
+        append(Dispatch, DispatchPayload{num_groups_x, num_groups_y, num_groups_z});
+    }
+
+    void CommandStream::dispatch_indirect(const RhiBuffer* dispatch_buffer, const uint64_t offset) {
+        append(DispatchIndirect, DispatchIndirectPayload{dispatch_buffer, offset});
+    }
+
+    void CommandStream::set_scissor_rect(const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height) {
+        append(SetScissorRect, RectPayload{x, y, width, height});
+    }
+
+    void CommandStream::set_viewport(const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height) {
+        append(SetViewport, RectPayload{x, y, width, height});
+    }
+
+    void CommandStream::write_timestamp(RhiQueryPool* pool, const uint32_t timestamp_idx, const PipelineStage stage) {
+        append(WriteTimestamp, TimestampPayload{pool, timestamp_idx, stage});
+    }
+
+    void CommandStream::begin_query(RhiQueryPool* pool, const uint32_t query_idx) { append(BeginQuery, QueryPayload{pool, query_idx}); }
+
+    void CommandStream::end_query(RhiQueryPool* pool, const uint32_t query_idx) { append(EndQuery, QueryPayload{pool, query_idx}); }
+
+    const RhiCommandListStats& CommandStream::get_stats() const { return stats; }
+
+    void CommandStream::record_draw_constants() {
+        if(recorded_draw_constants && *recorded_draw_constants == draw_constants) {
+            return;
+        }
+
+        append(SetDrawConstants, draw_constants);
+        recorded_draw_constants = draw_constants;
+    }
+
+    void CommandStream::forget_bound_state() {
+        bound_pipeline = nullptr;
+        bound_pipeline_interface = nullptr;
+        bound_descriptor_sets.clear();
+        bound_vertex_buffers.clear();
+        bound_index_buffer = nullptr;
+        bound_index_type = IndexType::Uint32;
+        recorded_draw_constants.reset();
+    }
+} // namespace nova::renderer::rhi
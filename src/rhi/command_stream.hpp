@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "nova_renderer/rhi/command_list.hpp"
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief A command list that records compact packets into one linear buffer, to be translated into a real command list later
+     *
+     * Passes record into these on worker threads, without touching the backend at all. The thread that records the frame's primary
+     * command list then translates each stream into it in order, so the passes' contents end up inline instead of in secondary command
+     * lists
+     *
+     * Binding something that's already bound and setting draw constants that haven't changed are dropped while recording, so translating
+     * a stream is a tight loop over only the commands that matter. Every packet is a trivially copyable struct, and objects are recorded
+     * as pointers, so everything a stream refers to has to stay alive until it's translated
+     *
+     * A stream can be recorded and translated over and over. `reset` keeps its buffer, so a stream that's reused every frame stops
+     * allocating once it's seen its biggest frame
+     */
+    class CommandStream final : public RhiRenderCommandList {
+    public:
+        /*!
+         * \brief Forgets everything that was recorded, but keeps the memory it was recorded into
+         */
+        void reset();
+
+        /*!
+         * \brief Records every command in this stream into the provided command list, in the order they were recorded
+         */
+        void translate(RhiRenderCommandList& cmds) const;
+
+        /*!
+         * \brief How many bytes of packets are in the stream
+         */
+        [[nodiscard]] size_t get_size() const;
+
+        void set_debug_name(const std::string& name) override;
+
+        void bind_material_resources(uint32_t frame_idx) override;
+
+        void bind_resources(RhiResourceBinder& binder, uint32_t frame_idx) override;
+
+        void resource_barriers(PipelineStage stages_before_barrier,
+                               PipelineStage stages_after_barrier,
+                               std::span<const RhiResourceBarrier> barriers) override;
+
+        void copy_buffer(RhiBuffer* destination_buffer,
+                         mem::Bytes destination_offset,
+                         RhiBuffer* source_buffer,
+                         mem::Bytes source_offset,
+                         mem::Bytes num_bytes) override;
+
+        /*!
+         * \brief Copies `data` into the stream, so it doesn't have to outlive the call
+         */
+        void upload_data_to_image(RhiImage* image,
+                                  size_t width,
+                                  size_t height,
+                                  size_t bytes_per_pixel,
+                                  RhiBuffer* staging_buffer,
+                                  const void* data,
+                                  uint64_t staging_buffer_offset) override;
+
+        void copy_buffer_to_image(RhiImage* image,
+                                  uint32_t mip_level,
+                                  uint32_t x,
+                                  uint32_t y,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  RhiBuffer* source_buffer,
+                                  mem::Bytes source_offset) override;
+
+        void copy_image_to_buffer(RhiBuffer* destination_buffer,
+                                  mem::Bytes destination_offset,
+                                  RhiImage* image,
+                                  uint32_t mip_level,
+                                  uint32_t x,
+                                  uint32_t y,
+                                  uint32_t width,
+                                  uint32_t height) override;
+
+        void blit_image(RhiImage* source,
+                        uint32_t source_layer,
+                        uint32_t source_width,
+                        uint32_t source_height,
+                        RhiImage* destination,
+                        uint32_t destination_width,
+                        uint32_t destination_height) override;
+
+        void generate_mips(RhiImage* image, uint32_t source_mip, uint32_t source_width, uint32_t source_height, uint32_t num_mips) override;
+
+        void execute_command_lists(const std::vector<RhiRenderCommandList*>& lists) override;
+
+        void set_camera(const Camera& camera) override;
+
+        void set_camera_index(uint32_t index) override;
+
+        void begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer, RenderpassContents contents) override;
+
+        void next_subpass(RenderpassContents contents) override;
+
+        void end_renderpass() override;
+
+        void set_material_index(uint32_t index) override;
+
+        void set_draw_constants(const RhiDrawConstants& constants) override;
+
+        void set_pipeline(const RhiPipeline& pipeline) override;
+
+        void bind_descriptor_sets(const std::vector<RhiDescriptorSet*>& descriptor_sets,
+                                  const RhiPipelineInterface* pipeline_interface) override;
+
+        void bind_vertex_buffers(const std::vector<RhiBuffer*>& buffers) override;
+
+        void bind_index_buffer(const RhiBuffer* buffer, IndexType index_type) override;
+
+        void draw_indexed_mesh(uint32_t num_indices, uint32_t offset, uint32_t num_instances, int32_t vertex_offset) override;
+
+        void draw_indexed_indirect(const RhiBuffer* draw_commands,
+                                   uint64_t draw_commands_offset,
+                                   uint32_t max_draw_count,
+                                   const RhiBuffer* draw_count_buffer,
+                                   uint64_t draw_count_offset) override;
+
+        void set_compute_pipeline(const RhiPipeline& pipeline) override;
+
+        void bind_compute_resources(RhiResourceBinder& binder, uint32_t frame_idx) override;
+
+        void dispatch(uint32_t num_groups_x, uint32_t num_groups_y, uint32_t num_groups_z) override;
+
+        void dispatch_indirect(const RhiBuffer* dispatch_buffer, uint64_t offset) override;
+
+        void set_scissor_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height) override;
+
+        void set_viewport(uint32_t x, uint32_t y, uint32_t width, uint32_t height) override;
+
+        void write_timestamp(RhiQueryPool* pool, uint32_t timestamp_idx, PipelineStage stage) override;
+
+        void begin_query(RhiQueryPool* pool, uint32_t query_idx) override;
+
+        void end_query(RhiQueryPool* pool, uint32_t query_idx) override;
+
+        /*!
+         * \brief Streams don't count anything. The command list they're translated into counts what actually gets recorded
+         */
+        [[nodiscard]] const RhiCommandListStats& get_stats() const override;
+
+    private:
+        std::vector<uint64_t> packets;
+
+        RhiCommandListStats stats;
+
+        const RhiPipeline* bound_pipeline = nullptr;
+
+        const RhiPipelineInterface* bound_pipeline_interface = nullptr;
+        std::vector<RhiDescriptorSet*> bound_descriptor_sets;
+
+        std::vector<RhiBuffer*> bound_vertex_buffers;
+
+        const RhiBuffer* bound_index_buffer = nullptr;
+        IndexType bound_index_type = IndexType::Uint32;
+
+        RhiDrawConstants draw_constants;
+
+        /*!
+         * \brief The draw constants that the last draw used, or nothing if no draw has set them since the translated command list last
+         * forgot them
+         */
+        std::optional<RhiDrawConstants> recorded_draw_constants;
+
+        /*!
+         * \brief Appends a packet. Packets are eight-byte aligned, so every payload can be read back in place
+         */
+        template <typename PayloadType>
+        void append(uint32_t command, const PayloadType& payload, const void* extra_data = nullptr, size_t extra_size = 0);
+
+        /*!
+         * \brief Records the draw constants, if the next draw would use different ones than the last
+         */
+        void record_draw_constants();
+
+        /*!
+         * \brief Forgets what's bound, for commands that make the translated command list forget too
+         */
+        void forget_bound_state();
+    };
+} // namespace nova::renderer::rhi
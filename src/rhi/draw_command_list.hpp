@@ -0,0 +1,31 @@
+#pragma once
+
+#include <type_traits>
+
+#include "nova_renderer/rhi/command_list.hpp"
+
+#ifdef NOVA_STATIC_VULKAN_RHI
+#include "vulkan/vulkan_command_list.hpp"
+#endif
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief The command list type that the draw loops record into
+     *
+     * When Nova's built with `NOVA_STATIC_VULKAN_RHI`, Vulkan is the only backend, so this is `VulkanRenderCommandList`. It's final, so
+     * calls through it go straight to the Vulkan implementation instead of through the vtable, and link-time optimization can inline
+     * them into the loop. Otherwise it's `RhiRenderCommandList` and every call is virtual, like everywhere else
+     */
+#ifdef NOVA_STATIC_VULKAN_RHI
+    using DrawCommandList = VulkanRenderCommandList;
+
+    static_assert(std::is_final_v<DrawCommandList>, "Calls through a command list type that isn't final are still virtual");
+#else
+    using DrawCommandList = RhiRenderCommandList;
+#endif
+
+    /*!
+     * \brief Gets the command list as the type that the draw loops use. All command lists come from the one backend, so this can't fail
+     */
+    [[nodiscard]] inline DrawCommandList& get_draw_command_list(RhiRenderCommandList& cmds) { return static_cast<DrawCommandList&>(cmds); }
+} // namespace nova::renderer::rhi
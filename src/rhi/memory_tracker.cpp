@@ -0,0 +1,62 @@
+#include "memory_tracker.hpp"
+
+#include <algorithm>
+
+namespace nova::renderer::rhi {
+    static void add_bytes(RhiMemoryAllocationStats& stats, const uint64_t bytes) {
+        stats.num_allocations++;
+        stats.bytes += bytes;
+        stats.peak_bytes = std::max(stats.peak_bytes, stats.bytes);
+    }
+
+    static void remove_bytes(RhiMemoryAllocationStats& stats, const uint64_t bytes) {
+        stats.num_allocations--;
+        stats.bytes -= bytes;
+    }
+
+    void MemoryTracker::add(const void* key, const MemoryCategory category, const std::string& owner, const uint64_t bytes) {
+        std::lock_guard lock{mutex};
+        if(!allocations.emplace(key, Allocation{category, owner, bytes}).second) {
+            return;
+        }
+
+        add_bytes(categories[static_cast<size_t>(category)], bytes);
+
+        auto& owner_stats = owners[{category, owner}];
+        owner_stats.category = category;
+        owner_stats.owner = owner;
+        add_bytes(owner_stats, bytes);
+    }
+
+    void MemoryTracker::remove(const void* key) {
+        std::lock_guard lock{mutex};
+        const auto itr = allocations.find(key);
+        if(itr == allocations.end()) {
+            return;
+        }
+
+        const auto& [category, owner, bytes] = itr->second;
+        remove_bytes(categories[static_cast<size_t>(category)], bytes);
+        remove_bytes(owners.at({category, owner}), bytes);
+
+        allocations.erase(itr);
+    }
+
+    RhiMemoryAccounting MemoryTracker::get_accounting() const {
+        std::lock_guard lock{mutex};
+
+        RhiMemoryAccounting accounting;
+        accounting.categories.assign(categories.begin(), categories.end());
+        for(size_t i = 0; i < accounting.categories.size(); i++) {
+            accounting.categories[i].category = static_cast<MemoryCategory>(i);
+        }
+
+        // The map is already sorted by category and then by owner
+        accounting.owners.reserve(owners.size());
+        for(const auto& [key, stats] : owners) {
+            accounting.owners.push_back(stats);
+        }
+
+        return accounting;
+    }
+} // namespace nova::renderer::rhi
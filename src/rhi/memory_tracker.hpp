@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief Counts a device's allocations by what they're for and who they belong to, and remembers the peaks of both
+     *
+     * Safe to use from any thread
+     */
+    class MemoryTracker {
+    public:
+        /*!
+         * \brief Starts counting an allocation
+         *
+         * \param key Identifies the allocation when it's freed, so every live allocation needs its own. Adding a key that's already
+         * counted does nothing, so allocations that several resources share are only counted once
+         */
+        void add(const void* key, MemoryCategory category, const std::string& owner, uint64_t bytes);
+
+        /*!
+         * \brief Stops counting an allocation. Does nothing if the key isn't counted
+         */
+        void remove(const void* key);
+
+        /*!
+         * \brief Gets the totals of every category and every owner. The driver's host memory is left for the device to fill in
+         */
+        [[nodiscard]] RhiMemoryAccounting get_accounting() const;
+
+    private:
+        struct Allocation {
+            MemoryCategory category;
+
+            std::string owner;
+
+            uint64_t bytes;
+        };
+
+        mutable std::mutex mutex;
+
+        std::unordered_map<const void*, Allocation> allocations;
+
+        std::array<RhiMemoryAllocationStats, NUM_MEMORY_CATEGORIES> categories{};
+
+        std::map<std::pair<MemoryCategory, std::string>, RhiMemoryAllocationStats> owners;
+    };
+} // namespace nova::renderer::rhi
@@ -0,0 +1,423 @@
+#include "null_command_list.hpp"
+
+#include "nova_renderer/camera.hpp"
+
+#include "null_structs.hpp"
+
+namespace nova::renderer::rhi {
+    namespace {
+        template <typename NullType, typename RhiType>
+        uint32_t id_of(const RhiType* object) {
+            return object != nullptr ? static_cast<const NullType*>(object)->id : 0;
+        }
+    } // namespace
+
+    void NullRenderCommandList::begin() {
+        stream.bytes.clear();
+        draw_constants = {};
+        stats = {};
+        forget_bound_state();
+    }
+
+    const std::vector<uint8_t>& NullRenderCommandList::get_commands() const { return stream.bytes; }
+
+    void NullRenderCommandList::set_debug_name(const std::string& name) {
+        stream.write(NullCommand::SetDebugName);
+        stream.write_string(name);
+    }
+
+    void NullRenderCommandList::bind_material_resources(const uint32_t frame_idx) {
+        const uint64_t resources = frame_idx + 1;
+        if(resources == bound_resources) {
+            return;
+        }
+
+        stream.write(NullCommand::BindMaterialResources);
+        stream.write(frame_idx);
+        stats.descriptor_set_binds++;
+
+        bound_resources = resources;
+    }
+
+    void NullRenderCommandList::bind_resources(RhiResourceBinder& binder, const uint32_t frame_idx) {
+        const auto binder_id = static_cast<NullResourceBinder&>(binder).id;
+        const uint64_t resources = (1ULL << 63) | (static_cast<uint64_t>(binder_id) << 32) | frame_idx;
+        if(resources == bound_resources) {
+            return;
+        }
+
+        stream.write(NullCommand::BindResources);
+        stream.write(binder_id);
+        stream.write(frame_idx);
+        stats.descriptor_set_binds++;
+
+        bound_resources = resources;
+    }
+
+    void NullRenderCommandList::resource_barriers(const PipelineStage stages_before_barrier,
+                                                  const PipelineStage stages_after_barrier,
+                                                  const std::span<const RhiResourceBarrier> barriers) {
+        stream.write(NullCommand::ResourceBarriers);
+        stream.write(static_cast<uint32_t>(stages_before_barrier));
+        stream.write(static_cast<uint32_t>(stages_after_barrier));
+        stream.write(static_cast<uint32_t>(barriers.size()));
+
+        for(const auto& barrier : barriers) {
+            if(barrier.resource_to_barrier->type == ResourceType::Image) {
+                stream.write(id_of<NullImage>(static_cast<RhiImage*>(barrier.resource_to_barrier)));
+            } else {
+                stream.write(id_of<NullBuffer>(static_cast<RhiBuffer*>(barrier.resource_to_barrier)));
+            }
+            stream.write(static_cast<uint32_t>(barrier.old_state));
+            stream.write(static_cast<uint32_t>(barrier.new_state));
+            stream.write(static_cast<uint8_t>(barrier.source_queue));
+            stream.write(static_cast<uint8_t>(barrier.destination_queue));
+        }
+
+        stats.barriers += barriers.size();
+    }
+
+    void NullRenderCommandList::copy_buffer(RhiBuffer* destination_buffer,
+                                            const mem::Bytes destination_offset,
+                                            RhiBuffer* source_buffer,
+                                            const mem::Bytes source_offset,
+                                            const mem::Bytes num_bytes) {
+        stream.write(NullCommand::CopyBuffer);
+        stream.write(id_of<NullBuffer>(destination_buffer));
+        stream.write(static_cast<uint64_t>(destination_offset.b_count()));
+        stream.write(id_of<NullBuffer>(source_buffer));
+        stream.write(static_cast<uint64_t>(source_offset.b_count()));
+        stream.write(static_cast<uint64_t>(num_bytes.b_count()));
+
+        stats.bytes_uploaded += num_bytes.b_count();
+    }
+
+    void NullRenderCommandList::upload_data_to_image(RhiImage* image,
+                                                     const size_t width,
+                                                     const size_t height,
+                                                     const size_t bytes_per_pixel,
+                                                     RhiBuffer* staging_buffer,
+                                                     const void* data,
+                                                     const uint64_t staging_buffer_offset) {
+        // The staging buffer is still written, so the CPU does as much work as it would with a real device
+        auto* null_staging_buffer = static_cast<NullBuffer*>(staging_buffer);
+        const auto num_bytes = width * height * bytes_per_pixel;
+        if(staging_buffer_offset + num_bytes <= null_staging_buffer->memory.size()) {
+            std::memcpy(null_staging_buffer->memory.data() + staging_buffer_offset, data, num_bytes);
+        }
+
+        stream.write(NullCommand::UploadDataToImage);
+        stream.write(id_of<NullImage>(image));
+        stream.write(static_cast<uint32_t>(width));
+        stream.write(static_cast<uint32_t>(height));
+        stream.write(static_cast<uint32_t>(bytes_per_pixel));
+        stream.write(null_staging_buffer->id);
+        stream.write(staging_buffer_offset);
+
+        stats.bytes_uploaded += num_bytes;
+    }
+
+    void NullRenderCommandList::copy_buffer_to_image(RhiImage* image,
+                                                     const uint32_t mip_level,
+                                                     const uint32_t x,
+                                                     const uint32_t y,
+                                                     const uint32_t width,
+                                                     const uint32_t height,
+                                                     RhiBuffer* source_buffer,
+                                                     const mem::Bytes source_offset) {
+        stream.write(NullCommand::CopyBufferToImage);
+        stream.write(id_of<NullImage>(image));
+        stream.write(mip_level);
+        stream.write(x);
+        stream.write(y);
+        stream.write(width);
+        stream.write(height);
+        stream.write(id_of<NullBuffer>(source_buffer));
+        stream.write(static_cast<uint64_t>(source_offset.b_count()));
+    }
+
+    void NullRenderCommandList::copy_image_to_buffer(RhiBuffer* destination_buffer,
+                                                     const mem::Bytes destination_offset,
+                                                     RhiImage* image,
+                                                     const uint32_t mip_level,
+                                                     const uint32_t x,
+                                                     const uint32_t y,
+                                                     const uint32_t width,
+                                                     const uint32_t height) {
+        stream.write(NullCommand::CopyImageToBuffer);
+        stream.write(id_of<NullBuffer>(destination_buffer));
+        stream.write(static_cast<uint64_t>(destination_offset.b_count()));
+        stream.write(id_of<NullImage>(image));
+        stream.write(mip_level);
+        stream.write(x);
+        stream.write(y);
+        stream.write(width);
+        stream.write(height);
+    }
+
+    void NullRenderCommandList::blit_image(RhiImage* source,
+                                           const uint32_t source_layer,
+                                           const uint32_t source_width,
+                                           const uint32_t source_height,
+                                           RhiImage* destination,
+                                           const uint32_t destination_width,
+                                           const uint32_t destination_height) {
+        stream.write(NullCommand::BlitImage);
+        stream.write(id_of<NullImage>(source));
+        stream.write(source_layer);
+        stream.write(source_width);
+        stream.write(source_height);
+        stream.write(id_of<NullImage>(destination));
+        stream.write(destination_width);
+        stream.write(destination_height);
+    }
+
+    void NullRenderCommandList::generate_mips(RhiImage* image,
+                                              const uint32_t source_mip,
+                                              const uint32_t source_width,
+                                              const uint32_t source_height,
+                                              const uint32_t num_mips) {
+        stream.write(NullCommand::GenerateMips);
+        stream.write(id_of<NullImage>(image));
+        stream.write(source_mip);
+        stream.write(source_width);
+        stream.write(source_height);
+        stream.write(num_mips);
+    }
+
+    void NullRenderCommandList::execute_command_lists(const std::vector<RhiRenderCommandList*>& lists) {
+        stream.write(NullCommand::ExecuteCommandLists);
+        stream.write(static_cast<uint32_t>(lists.size()));
+
+        for(const auto* list : lists) {
+            const auto* null_list = static_cast<const NullRenderCommandList*>(list);
+            stream.write(static_cast<uint32_t>(null_list->stream.bytes.size()));
+            stream.write_bytes(null_list->stream.bytes);
+
+            stats += null_list->stats;
+        }
+
+        forget_bound_state();
+    }
+
+    void NullRenderCommandList::set_camera(const Camera& camera) { set_camera_index(camera.index); }
+
+    void NullRenderCommandList::set_camera_index(const uint32_t index) {
+        auto constants = draw_constants;
+        constants.camera_index = index;
+        set_draw_constants(constants);
+    }
+
+    void NullRenderCommandList::begin_renderpass(RhiRenderpass* renderpass,
+                                                 RhiFramebuffer* framebuffer,
+                                                 const RenderpassContents contents) {
+        stream.write(NullCommand::BeginRenderpass);
+        stream.write(id_of<NullRenderpass>(renderpass));
+        stream.write(id_of<NullFramebuffer>(framebuffer));
+        stream.write(static_cast<uint8_t>(contents));
+
+        // Pipelines are compiled for a specific renderpass, so whatever was bound before can't be used in this one
+        bound_pipeline = 0;
+    }
+
+    void NullRenderCommandList::next_subpass(const RenderpassContents contents) {
+        stream.write(NullCommand::NextSubpass);
+        stream.write(static_cast<uint8_t>(contents));
+
+        // Pipelines are compiled for a specific subpass too
+        bound_pipeline = 0;
+    }
+
+    void NullRenderCommandList::end_renderpass() { stream.write(NullCommand::EndRenderpass); }
+
+    void NullRenderCommandList::set_material_index(const uint32_t index) {
+        auto constants = draw_constants;
+        constants.material_index = index;
+        set_draw_constants(constants);
+    }
+
+    void NullRenderCommandList::set_draw_constants(const RhiDrawConstants& constants) {
+        if(constants != draw_constants) {
+            draw_constants = constants;
+            draw_constants_dirty = true;
+        }
+    }
+
+    void NullRenderCommandList::set_pipeline(const RhiPipeline& pipeline) {
+        const auto pipeline_id = static_cast<const NullPipeline&>(pipeline).id;
+        if(pipeline_id == bound_pipeline) {
+            return;
+        }
+
+        stream.write(NullCommand::SetPipeline);
+        stream.write(pipeline_id);
+        stats.pipeline_binds++;
+
+        bound_pipeline = pipeline_id;
+    }
+
+    void NullRenderCommandList::bind_descriptor_sets(const std::vector<RhiDescriptorSet*>& descriptor_sets,
+                                                     const RhiPipelineInterface* /* pipeline_interface */) {
+        stream.write(NullCommand::BindDescriptorSets);
+        stream.write(static_cast<uint32_t>(descriptor_sets.size()));
+        stats.descriptor_set_binds += descriptor_sets.size();
+
+        bound_resources = 0;
+    }
+
+    void NullRenderCommandList::bind_vertex_buffers(const std::vector<RhiBuffer*>& buffers) {
+        std::vector<uint32_t> buffer_ids;
+        buffer_ids.reserve(buffers.size());
+        for(const auto* buffer : buffers) {
+            buffer_ids.push_back(id_of<NullBuffer>(buffer));
+        }
+
+        if(buffer_ids == bound_vertex_buffers) {
+            return;
+        }
+
+        stream.write(NullCommand::BindVertexBuffers);
+        stream.write(static_cast<uint32_t>(buffer_ids.size()));
+        for(const auto buffer_id : buffer_ids) {
+            stream.write(buffer_id);
+        }
+        stats.buffer_binds += buffer_ids.size();
+
+        bound_vertex_buffers = std::move(buffer_ids);
+    }
+
+    void NullRenderCommandList::bind_index_buffer(const RhiBuffer* buffer, const IndexType index_type) {
+        const auto buffer_id = id_of<NullBuffer>(buffer);
+        if(buffer_id == bound_index_buffer && index_type == bound_index_type) {
+            return;
+        }
+
+        stream.write(NullCommand::BindIndexBuffer);
+        stream.write(buffer_id);
+        stream.write(static_cast<uint8_t>(index_type));
+        stats.buffer_binds++;
+
+        bound_index_buffer = buffer_id;
+        bound_index_type = index_type;
+    }
+
+    void NullRenderCommandList::draw_indexed_mesh(const uint32_t num_indices,
+                                                  const uint32_t offset,
+                                                  const uint32_t num_instances,
+                                                  const int32_t vertex_offset) {
+        flush_draw_constants();
+        stream.write(NullCommand::DrawIndexedMesh);
+        stream.write(num_indices);
+        stream.write(offset);
+        stream.write(num_instances);
+        stream.write(vertex_offset);
+
+        stats.draw_calls++;
+        stats.instances += num_instances;
+        stats.triangles += static_cast<uint64_t>(num_indices / 3) * num_instances;
+    }
+
+    void NullRenderCommandList::draw_indexed_indirect(const RhiBuffer* draw_commands,
+                                                      const uint64_t draw_commands_offset,
+                                                      const uint32_t max_draw_count,
+                                                      const RhiBuffer* draw_count_buffer,
+                                                      const uint64_t draw_count_offset) {
+        flush_draw_constants();
+        stream.write(NullCommand::DrawIndexedIndirect);
+        stream.write(id_of<NullBuffer>(draw_commands));
+        stream.write(draw_commands_offset);
+        stream.write(max_draw_count);
+        stream.write(id_of<NullBuffer>(draw_count_buffer));
+        stream.write(draw_count_offset);
+
+        stats.indirect_draw_calls++;
+    }
+
+    void NullRenderCommandList::set_compute_pipeline(const RhiPipeline& pipeline) {
+        stream.write(NullCommand::SetComputePipeline);
+        stream.write(static_cast<const NullPipeline&>(pipeline).id);
+        stats.pipeline_binds++;
+    }
+
+    void NullRenderCommandList::bind_compute_resources(RhiResourceBinder& binder, const uint32_t frame_idx) {
+        stream.write(NullCommand::BindComputeResources);
+        stream.write(static_cast<NullResourceBinder&>(binder).id);
+        stream.write(frame_idx);
+        stats.descriptor_set_binds++;
+    }
+
+    void NullRenderCommandList::dispatch(const uint32_t num_groups_x, const uint32_t num_groups_y, const uint32_t num_groups_z) {
+        stream.write(NullCommand::Dispatch);
+        stream.write(num_groups_x);
+        stream.write(num_groups_y);
+        stream.write(num_groups_z);
+        stats.dispatches++;
+    }
+
+    void NullRenderCommandList::dispatch_indirect(const RhiBuffer* dispatch_buffer, const uint64_t offset) {
+        stream.write(NullCommand::DispatchIndirect);
+        stream.write(id_of<NullBuffer>(dispatch_buffer));
+        stream.write(offset);
+        stats.dispatches++;
+    }
+
+    void NullRenderCommandList::set_scissor_rect(const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height) {
+        stream.write(NullCommand::SetScissorRect);
+        stream.write(x);
+        stream.write(y);
+        stream.write(width);
+        stream.write(height);
+    }
+
+    void NullRenderCommandList::set_viewport(const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height) {
+        stream.write(NullCommand::SetViewport);
+        stream.write(x);
+        stream.write(y);
+        stream.write(width);
+        stream.write(height);
+    }
+
+    void NullRenderCommandList::write_timestamp(RhiQueryPool* pool, const uint32_t timestamp_idx, const PipelineStage stage) {
+        stream.write(NullCommand::WriteTimestamp);
+        stream.write(id_of<NullQueryPool>(pool));
+        stream.write(timestamp_idx);
+        stream.write(static_cast<uint32_t>(stage));
+    }
+
+    void NullRenderCommandList::begin_query(RhiQueryPool* pool, const uint32_t query_idx) {
+        stream.write(NullCommand::BeginQuery);
+        stream.write(id_of<NullQueryPool>(pool));
+        stream.write(query_idx);
+    }
+
+    void NullRenderCommandList::end_query(RhiQueryPool* pool, const uint32_t query_idx) {
+        stream.write(NullCommand::EndQuery);
+        stream.write(id_of<NullQueryPool>(pool));
+        stream.write(query_idx);
+    }
+
+    const RhiCommandListStats& NullRenderCommandList::get_stats() const { return stats; }
+
+    void NullRenderCommandList::forget_bound_state() {
+        bound_pipeline = 0;
+        bound_resources = 0;
+        bound_vertex_buffers.clear();
+        bound_index_buffer = 0;
+        draw_constants_dirty = true;
+    }
+
+    void NullRenderCommandList::flush_draw_constants() {
+        if(!draw_constants_dirty) {
+            return;
+        }
+
+        stream.write(NullCommand::SetDrawConstants);
+        stream.write(draw_constants.camera_index);
+        stream.write(draw_constants.material_index);
+        stream.write(draw_constants.instance_base);
+        stream.write(draw_constants.transform_index);
+        stats.draw_constant_pushes++;
+
+        draw_constants_dirty = false;
+    }
+} // namespace nova::renderer::rhi
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "nova_renderer/rhi/command_list.hpp"
+
+#include "null_command_stream.hpp"
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief Null implementation of `command_list`
+     *
+     * Records every command into a compact byte stream instead of sending it anywhere, and counts the same stats the Vulkan command list
+     * does. Binding something that's already bound is skipped, the same as in the Vulkan command list, so the counts match
+     */
+    class NullRenderCommandList final : public RhiRenderCommandList {
+    public:
+        /*!
+         * \brief Forgets everything that was recorded, so the command list can be handed out again
+         */
+        void begin();
+
+        /*!
+         * \brief The commands recorded since `begin`
+         */
+        [[nodiscard]] const std::vector<uint8_t>& get_commands() const;
+
+        void set_debug_name(const std::string& name) override;
+
+        void bind_material_resources(uint32_t frame_idx) override;
+
+        void bind_resources(RhiResourceBinder& binder, uint32_t frame_idx) override;
+
+        void resource_barriers(PipelineStage stages_before_barrier,
+                               PipelineStage stages_after_barrier,
+                               std::span<const RhiResourceBarrier> barriers) override;
+
+        void copy_buffer(RhiBuffer* destination_buffer,
+                         mem::Bytes destination_offset,
+                         RhiBuffer* source_buffer,
+                         mem::Bytes source_offset,
+                         mem::Bytes num_bytes) override;
+
+        void upload_data_to_image(RhiImage* image,
+                                  size_t width,
+                                  size_t height,
+                                  size_t bytes_per_pixel,
+                                  RhiBuffer* staging_buffer,
+                                  const void* data,
+                                  uint64_t staging_buffer_offset) override;
+
+        void copy_buffer_to_image(RhiImage* image,
+                                  uint32_t mip_level,
+                                  uint32_t x,
+                                  uint32_t y,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  RhiBuffer* source_buffer,
+                                  mem::Bytes source_offset) override;
+
+        void copy_image_to_buffer(RhiBuffer* destination_buffer,
+                                  mem::Bytes destination_offset,
+                                  RhiImage* image,
+                                  uint32_t mip_level,
+                                  uint32_t x,
+                                  uint32_t y,
+                                  uint32_t width,
+                                  uint32_t height) override;
+
+        void blit_image(RhiImage* source,
+                        uint32_t source_layer,
+                        uint32_t source_width,
+                        uint32_t source_height,
+                        RhiImage* destination,
+                        uint32_t destination_width,
+                        uint32_t destination_height) override;
+
+        void generate_mips(RhiImage* image, uint32_t source_mip, uint32_t source_width, uint32_t source_height, uint32_t num_mips) override;
+
+        void execute_command_lists(const std::vector<RhiRenderCommandList*>& lists) override;
+
+        void set_camera(const Camera& camera) override;
+
+        void set_camera_index(uint32_t index) override;
+
+        void begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer, RenderpassContents contents) override;
+
+        void next_subpass(RenderpassContents contents) override;
+
+        void end_renderpass() override;
+
+        void set_material_index(uint32_t index) override;
+
+        void set_draw_constants(const RhiDrawConstants& constants) override;
+
+        void set_pipeline(const RhiPipeline& pipeline) override;
+
+        void bind_descriptor_sets(const std::vector<RhiDescriptorSet*>& descriptor_sets,
+                                  const RhiPipelineInterface* pipeline_interface) override;
+
+        void bind_vertex_buffers(const std::vector<RhiBuffer*>& buffers) override;
+
+        void bind_index_buffer(const RhiBuffer* buffer, IndexType index_type) override;
+
+        void draw_indexed_mesh(uint32_t num_indices, uint32_t offset, uint32_t num_instances, int32_t vertex_offset) override;
+
+        void draw_indexed_indirect(const RhiBuffer* draw_commands,
+                                   uint64_t draw_commands_offset,
+                                   uint32_t max_draw_count,
+                                   const RhiBuffer* draw_count_buffer,
+                                   uint64_t draw_count_offset) override;
+
+        void set_compute_pipeline(const RhiPipeline& pipeline) override;
+
+        void bind_compute_resources(RhiResourceBinder& binder, uint32_t frame_idx) override;
+
+        void dispatch(uint32_t num_groups_x, uint32_t num_groups_y, uint32_t num_groups_z) override;
+
+        void dispatch_indirect(const RhiBuffer* dispatch_buffer, uint64_t offset) override;
+
+        void set_scissor_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height) override;
+
+        void set_viewport(uint32_t x, uint32_t y, uint32_t width, uint32_t height) override;
+
+        void write_timestamp(RhiQueryPool* pool, uint32_t timestamp_idx, PipelineStage stage) override;
+
+        void begin_query(RhiQueryPool* pool, uint32_t query_idx) override;
+
+        void end_query(RhiQueryPool* pool, uint32_t query_idx) override;
+
+        [[nodiscard]] const RhiCommandListStats& get_stats() const override;
+
+    private:
+        NullCommandStreamWriter stream;
+
+        RhiCommandListStats stats;
+
+#pragma region Bound state
+        /*!
+         * \brief What's bound right now, by id. The standard descriptor set and resource binders all bind starting at set 0, so
+         * `bound_resources` is either the standard set's frame index plus one, or the top bit plus the binder's id and frame index
+         */
+        uint32_t bound_pipeline = 0;
+
+        uint64_t bound_resources = 0;
+
+        std::vector<uint32_t> bound_vertex_buffers;
+
+        uint32_t bound_index_buffer = 0;
+
+        IndexType bound_index_type = IndexType::Uint32;
+
+        RhiDrawConstants draw_constants;
+
+        bool draw_constants_dirty = true;
+#pragma endregion
+
+        void forget_bound_state();
+
+        void flush_draw_constants();
+    };
+} // namespace nova::renderer::rhi
@@ -0,0 +1,441 @@
+#include "null_command_stream.hpp"
+
+#include <fstream>
+
+#include <fmt/format.h>
+
+namespace nova::renderer::rhi {
+    void NullCommandStreamWriter::write_string(const std::string_view str) {
+        write(static_cast<uint32_t>(str.size()));
+        write_bytes({reinterpret_cast<const uint8_t*>(str.data()), str.size()});
+    }
+
+    void NullCommandStreamWriter::write_bytes(const std::span<const uint8_t> data) { bytes.insert(bytes.end(), data.begin(), data.end()); }
+
+    namespace {
+        /*!
+         * \brief Reads values out of a command stream, and remembers if it ever tried to read past the end
+         */
+        struct StreamReader {
+            std::span<const uint8_t> bytes;
+
+            size_t pos = 0;
+
+            bool truncated = false;
+
+            template <typename ValueType>
+            ValueType read() {
+                ValueType value{};
+                if(pos + sizeof(ValueType) > bytes.size()) {
+                    truncated = true;
+                    pos = bytes.size();
+                    return value;
+                }
+
+                std::memcpy(&value, bytes.data() + pos, sizeof(ValueType));
+                pos += sizeof(ValueType);
+                return value;
+            }
+
+            std::span<const uint8_t> read_bytes(const size_t num_bytes) {
+                if(pos + num_bytes > bytes.size()) {
+                    truncated = true;
+                    pos = bytes.size();
+                    return {};
+                }
+
+                const auto data = bytes.subspan(pos, num_bytes);
+                pos += num_bytes;
+                return data;
+            }
+
+            [[nodiscard]] bool at_end() const { return pos >= bytes.size(); }
+        };
+
+        void disassemble(std::span<const uint8_t> commands, uint32_t depth, std::string& out);
+
+        /*!
+         * \brief Appends one command to `out`. Returns false if the command isn't one we know, since we can't tell where it ends
+         */
+        bool disassemble_command(StreamReader& reader, const uint32_t depth, std::string& out) {
+            const auto indent = std::string(depth * 4, ' ');
+            const auto command = static_cast<NullCommand>(reader.read<uint8_t>());
+
+            switch(command) {
+                case NullCommand::SetDebugName: {
+                    const auto length = reader.read<uint32_t>();
+                    const auto name = reader.read_bytes(length);
+                    const auto name_str = std::string_view{reinterpret_cast<const char*>(name.data()), name.size()};
+                    out += fmt::format("{}SetDebugName \"{}\"\n", indent, name_str);
+                } break;
+
+                case NullCommand::BindMaterialResources: {
+                    const auto frame_idx = reader.read<uint32_t>();
+                    out += fmt::format("{}BindMaterialResources frame={}\n", indent, frame_idx);
+                } break;
+
+                case NullCommand::BindResources:
+                    [[fallthrough]];
+                case NullCommand::BindComputeResources: {
+                    const auto binder = reader.read<uint32_t>();
+                    const auto frame_idx = reader.read<uint32_t>();
+                    const auto* name = command == NullCommand::BindResources ? "BindResources" : "BindComputeResources";
+                    out += fmt::format("{}{} binder={} frame={}\n", indent, name, binder, frame_idx);
+                } break;
+
+                case NullCommand::ResourceBarriers: {
+                    const auto stages_before = reader.read<uint32_t>();
+                    const auto stages_after = reader.read<uint32_t>();
+                    const auto num_barriers = reader.read<uint32_t>();
+                    out += fmt::format("{}ResourceBarriers before={:#x} after={:#x} count={}\n",
+                                       indent,
+                                       stages_before,
+                                       stages_after,
+                                       num_barriers);
+
+                    for(uint32_t i = 0; i < num_barriers && !reader.truncated; i++) {
+                        const auto resource = reader.read<uint32_t>();
+                        const auto old_state = reader.read<uint32_t>();
+                        const auto new_state = reader.read<uint32_t>();
+                        const auto source_queue = reader.read<uint8_t>();
+                        const auto destination_queue = reader.read<uint8_t>();
+                        out += fmt::format("{}    resource={} state={}->{} queue={}->{}\n",
+                                           indent,
+                                           resource,
+                                           old_state,
+                                           new_state,
+                                           source_queue,
+                                           destination_queue);
+                    }
+                } break;
+
+                case NullCommand::CopyBuffer: {
+                    const auto destination = reader.read<uint32_t>();
+                    const auto destination_offset = reader.read<uint64_t>();
+                    const auto source = reader.read<uint32_t>();
+                    const auto source_offset = reader.read<uint64_t>();
+                    const auto num_bytes = reader.read<uint64_t>();
+                    out += fmt::format("{}CopyBuffer dst={}+{} src={}+{} bytes={}\n",
+                                       indent,
+                                       destination,
+                                       destination_offset,
+                                       source,
+                                       source_offset,
+                                       num_bytes);
+                } break;
+
+                case NullCommand::UploadDataToImage: {
+                    const auto image = reader.read<uint32_t>();
+                    const auto width = reader.read<uint32_t>();
+                    const auto height = reader.read<uint32_t>();
+                    const auto bytes_per_pixel = reader.read<uint32_t>();
+                    const auto staging_buffer = reader.read<uint32_t>();
+                    const auto staging_offset = reader.read<uint64_t>();
+                    out += fmt::format("{}UploadDataToImage image={} size={}x{}x{} staging={}+{}\n",
+                                       indent,
+                                       image,
+                                       width,
+                                       height,
+                                       bytes_per_pixel,
+                                       staging_buffer,
+                                       staging_offset);
+                } break;
+
+                case NullCommand::CopyBufferToImage: {
+                    const auto image = reader.read<uint32_t>();
+                    const auto mip = reader.read<uint32_t>();
+                    const auto x = reader.read<uint32_t>();
+                    const auto y = reader.read<uint32_t>();
+                    const auto width = reader.read<uint32_t>();
+                    const auto height = reader.read<uint32_t>();
+                    const auto source = reader.read<uint32_t>();
+                    const auto source_offset = reader.read<uint64_t>();
+                    out += fmt::format("{}CopyBufferToImage image={} mip={} offset={},{} size={}x{} src={}+{}\n",
+                                       indent,
+                                       image,
+                                       mip,
+                                       x,
+                                       y,
+                                       width,
+                                       height,
+                                       source,
+                                       source_offset);
+                } break;
+
+                case NullCommand::CopyImageToBuffer: {
+                    const auto destination = reader.read<uint32_t>();
+                    const auto destination_offset = reader.read<uint64_t>();
+                    const auto image = reader.read<uint32_t>();
+                    const auto mip = reader.read<uint32_t>();
+                    const auto x = reader.read<uint32_t>();
+                    const auto y = reader.read<uint32_t>();
+                    const auto width = reader.read<uint32_t>();
+                    const auto height = reader.read<uint32_t>();
+                    out += fmt::format("{}CopyImageToBuffer image={} mip={} offset={},{} size={}x{} dst={}+{}\n",
+                                       indent,
+                                       image,
+                                       mip,
+                                       x,
+                                       y,
+                                       width,
+                                       height,
+                                       destination,
+                                       destination_offset);
+                } break;
+
+                case NullCommand::BlitImage: {
+                    const auto source = reader.read<uint32_t>();
+                    const auto source_layer = reader.read<uint32_t>();
+                    const auto source_width = reader.read<uint32_t>();
+                    const auto source_height = reader.read<uint32_t>();
+                    const auto destination = reader.read<uint32_t>();
+                    const auto destination_width = reader.read<uint32_t>();
+                    const auto destination_height = reader.read<uint32_t>();
+                    out += fmt::format("{}BlitImage src={} layer={} size={}x{} dst={} size={}x{}\n",
+                                       indent,
+                                       source,
+                                       source_layer,
+                                       source_width,
+                                       source_height,
+                                       destination,
+                                       destination_width,
+                                       destination_height);
+                } break;
+
+                case NullCommand::GenerateMips: {
+                    const auto image = reader.read<uint32_t>();
+                    const auto source_mip = reader.read<uint32_t>();
+                    const auto width = reader.read<uint32_t>();
+                    const auto height = reader.read<uint32_t>();
+                    const auto num_mips = reader.read<uint32_t>();
+                    out += fmt::format("{}GenerateMips image={} source={} size={}x{} mips={}\n",
+                                       indent,
+                                       image,
+                                       source_mip,
+                                       width,
+                                       height,
+                                       num_mips);
+                } break;
+
+                case NullCommand::ExecuteCommandLists: {
+                    const auto num_lists = reader.read<uint32_t>();
+                    out += fmt::format("{}ExecuteCommandLists count={}\n", indent, num_lists);
+
+                    for(uint32_t i = 0; i < num_lists && !reader.truncated; i++) {
+                        const auto num_bytes = reader.read<uint32_t>();
+                        disassemble(reader.read_bytes(num_bytes), depth + 1, out);
+                    }
+                } break;
+
+                case NullCommand::BeginRenderpass: {
+                    const auto renderpass = reader.read<uint32_t>();
+                    const auto framebuffer = reader.read<uint32_t>();
+                    const auto contents = reader.read<uint8_t>();
+                    out += fmt::format("{}BeginRenderpass renderpass={} framebuffer={} contents={}\n",
+                                       indent,
+                                       renderpass,
+                                       framebuffer,
+                                       contents == 0 ? "inline" : "secondary");
+                } break;
+
+                case NullCommand::NextSubpass: {
+                    const auto contents = reader.read<uint8_t>();
+                    out += fmt::format("{}NextSubpass contents={}\n", indent, contents == 0 ? "inline" : "secondary");
+                } break;
+
+                case NullCommand::EndRenderpass:
+                    out += fmt::format("{}EndRenderpass\n", indent);
+                    break;
+
+                case NullCommand::SetDrawConstants: {
+                    const auto camera_idx = reader.read<uint32_t>();
+                    const auto material_idx = reader.read<uint32_t>();
+                    const auto instance_base = reader.read<uint32_t>();
+                    const auto transform_idx = reader.read<uint32_t>();
+                    out += fmt::format("{}SetDrawConstants camera={} material={} instance_base={} transform={}\n",
+                                       indent,
+                                       camera_idx,
+                                       material_idx,
+                                       instance_base,
+                                       transform_idx);
+                } break;
+
+                case NullCommand::SetPipeline:
+                    [[fallthrough]];
+                case NullCommand::SetComputePipeline: {
+                    const auto pipeline = reader.read<uint32_t>();
+                    const auto* name = command == NullCommand::SetPipeline ? "SetPipeline" : "SetComputePipeline";
+                    out += fmt::format("{}{} pipeline={}\n", indent, name, pipeline);
+                } break;
+
+                case NullCommand::BindDescriptorSets: {
+                    const auto num_sets = reader.read<uint32_t>();
+                    out += fmt::format("{}BindDescriptorSets count={}\n", indent, num_sets);
+                } break;
+
+                case NullCommand::BindVertexBuffers: {
+                    const auto num_buffers = reader.read<uint32_t>();
+                    out += fmt::format("{}BindVertexBuffers", indent);
+                    for(uint32_t i = 0; i < num_buffers && !reader.truncated; i++) {
+                        out += fmt::format(" {}", reader.read<uint32_t>());
+                    }
+                    out += '\n';
+                } break;
+
+                case NullCommand::BindIndexBuffer: {
+                    const auto buffer = reader.read<uint32_t>();
+                    const auto index_type = reader.read<uint8_t>();
+                    out += fmt::format("{}BindIndexBuffer buffer={} type={}\n", indent, buffer, index_type == 0 ? "u16" : "u32");
+                } break;
+
+                case NullCommand::DrawIndexedMesh: {
+                    const auto num_indices = reader.read<uint32_t>();
+                    const auto first_index = reader.read<uint32_t>();
+                    const auto num_instances = reader.read<uint32_t>();
+                    const auto vertex_offset = reader.read<int32_t>();
+                    out += fmt::format("{}DrawIndexedMesh indices={} first={} instances={} vertex_offset={}\n",
+                                       indent,
+                                       num_indices,
+                                       first_index,
+                                       num_instances,
+                                       vertex_offset);
+                } break;
+
+                case NullCommand::DrawIndexedIndirect: {
+                    const auto draw_commands = reader.read<uint32_t>();
+                    const auto draw_commands_offset = reader.read<uint64_t>();
+                    const auto max_draw_count = reader.read<uint32_t>();
+                    const auto draw_count_buffer = reader.read<uint32_t>();
+                    const auto draw_count_offset = reader.read<uint64_t>();
+                    out += fmt::format("{}DrawIndexedIndirect commands={}+{} max={} count={}+{}\n",
+                                       indent,
+                                       draw_commands,
+                                       draw_commands_offset,
+                                       max_draw_count,
+                                       draw_count_buffer,
+                                       draw_count_offset);
+                } break;
+
+                case NullCommand::Dispatch: {
+                    const auto x = reader.read<uint32_t>();
+                    const auto y = reader.read<uint32_t>();
+                    const auto z = reader.read<uint32_t>();
+                    out += fmt::format("{}Dispatch {}x{}x{}\n", indent, x, y, z);
+                } break;
+
+                case NullCommand::DispatchIndirect: {
+                    const auto buffer = reader.read<uint32_t>();
+                    const auto offset = reader.read<uint64_t>();
+                    out += fmt::format("{}DispatchIndirect buffer={}+{}\n", indent, buffer, offset);
+                } break;
+
+                case NullCommand::SetScissorRect: {
+                    const auto x = reader.read<uint32_t>();
+                    const auto y = reader.read<uint32_t>();
+                    const auto width = reader.read<uint32_t>();
+                    const auto height = reader.read<uint32_t>();
+                    out += fmt::format("{}SetScissorRect {},{} {}x{}\n", indent, x, y, width, height);
+                } break;
+
+                case NullCommand::WriteTimestamp: {
+                    const auto pool = reader.read<uint32_t>();
+                    const auto timestamp_idx = reader.read<uint32_t>();
+                    const auto stage = reader.read<uint32_t>();
+                    out += fmt::format("{}WriteTimestamp pool={} idx={} stage={:#x}\n", indent, pool, timestamp_idx, stage);
+                } break;
+
+                case NullCommand::BeginQuery:
+                    [[fallthrough]];
+                case NullCommand::EndQuery: {
+                    const auto pool = reader.read<uint32_t>();
+                    const auto query_idx = reader.read<uint32_t>();
+                    const auto* name = command == NullCommand::BeginQuery ? "BeginQuery" : "EndQuery";
+                    out += fmt::format("{}{} pool={} idx={}\n", indent, name, pool, query_idx);
+                } break;
+
+                case NullCommand::SetViewport: {
+                    const auto x = reader.read<uint32_t>();
+                    const auto y = reader.read<uint32_t>();
+                    const auto width = reader.read<uint32_t>();
+                    const auto height = reader.read<uint32_t>();
+                    out += fmt::format("{}SetViewport {},{} {}x{}\n", indent, x, y, width, height);
+                } break;
+
+                default:
+                    out += fmt::format("{}<unknown command {}>\n", indent, static_cast<uint32_t>(command));
+                    return false;
+            }
+
+            return true;
+        }
+
+        void disassemble(const std::span<const uint8_t> commands, const uint32_t depth, std::string& out) {
+            StreamReader reader{commands};
+            while(!reader.at_end()) {
+                if(!disassemble_command(reader, depth, out)) {
+                    return;
+                }
+            }
+
+            if(reader.truncated) {
+                out += fmt::format("{}<truncated>\n", std::string(depth * 4, ' '));
+            }
+        }
+    } // namespace
+
+    std::string disassemble_command_stream(const std::span<const uint8_t> commands) {
+        std::string out;
+        disassemble(commands, 0, out);
+        return out;
+    }
+
+    void write_capture_header(std::ostream& file) { file.write(NULL_CAPTURE_MAGIC.data(), NULL_CAPTURE_MAGIC.size()); }
+
+    void write_capture_submission(std::ostream& file,
+                                  const uint64_t frame_idx,
+                                  const QueueType queue,
+                                  const std::span<const uint8_t> commands) {
+        NullCommandStreamWriter header;
+        header.write(frame_idx);
+        header.write(static_cast<uint8_t>(queue));
+        header.write(static_cast<uint32_t>(commands.size()));
+
+        file.write(reinterpret_cast<const char*>(header.bytes.data()), static_cast<std::streamsize>(header.bytes.size()));
+        file.write(reinterpret_cast<const char*>(commands.data()), static_cast<std::streamsize>(commands.size()));
+    }
+
+    ntl::Result<std::vector<NullSubmission>> read_capture(const std::filesystem::path& path) {
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if(!file) {
+            return ntl::Result<std::vector<NullSubmission>>(ntl::NovaError(fmt::format("Could not open capture {}", path.string())));
+        }
+
+        std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+        StreamReader reader{bytes};
+        const auto magic = reader.read_bytes(NULL_CAPTURE_MAGIC.size());
+        if(reader.truncated || std::string_view{reinterpret_cast<const char*>(magic.data()), magic.size()} != NULL_CAPTURE_MAGIC) {
+            return ntl::Result<std::vector<NullSubmission>>(ntl::NovaError(fmt::format("{} isn't a command capture", path.string())));
+        }
+
+        std::vector<NullSubmission> submissions;
+        while(!reader.at_end()) {
+            NullSubmission submission;
+            submission.frame_idx = reader.read<uint64_t>();
+            submission.queue = static_cast<QueueType>(reader.read<uint8_t>());
+
+            const auto num_bytes = reader.read<uint32_t>();
+            const auto commands = reader.read_bytes(num_bytes);
+            if(reader.truncated) {
+                return ntl::Result<std::vector<NullSubmission>>(ntl::NovaError(fmt::format("Capture {} is truncated", path.string())));
+            }
+
+            submission.commands.assign(commands.begin(), commands.end());
+            submissions.push_back(std::move(submission));
+        }
+
+        return ntl::Result{std::move(submissions)};
+    }
+} // namespace nova::renderer::rhi
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "nova_renderer/rhi/rhi_enums.hpp"
+#include "nova_renderer/util/result.hpp"
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief The commands that `NullRenderCommandList` records
+     *
+     * Each command is its opcode followed by its arguments. Arguments are written in the host's byte order with no padding. Objects are
+     * written as the id that `NullRenderDevice` gave them, or 0 for nullptr, so the same scene records the same bytes every run
+     *
+     * Only add new commands at the end, so old captures still read back
+     */
+    enum class NullCommand : uint8_t {
+        /*!
+         * \brief u32 name length, then the name's characters
+         */
+        SetDebugName,
+
+        /*!
+         * \brief u32 frame index
+         */
+        BindMaterialResources,
+
+        /*!
+         * \brief u32 binder, u32 frame index
+         */
+        BindResources,
+
+        /*!
+         * \brief u32 stages before, u32 stages after, u32 barrier count, then for each barrier: u32 resource, u32 old state, u32 new
+         * state, u8 source queue, u8 destination queue
+         */
+        ResourceBarriers,
+
+        /*!
+         * \brief u32 destination, u64 destination offset, u32 source, u64 source offset, u64 byte count
+         */
+        CopyBuffer,
+
+        /*!
+         * \brief u32 image, u32 width, u32 height, u32 bytes per pixel, u32 staging buffer, u64 staging buffer offset
+         */
+        UploadDataToImage,
+
+        /*!
+         * \brief u32 list count, then for each list: u32 byte count, then the list's commands
+         */
+        ExecuteCommandLists,
+
+        /*!
+         * \brief u32 renderpass, u32 framebuffer, u8 contents
+         */
+        BeginRenderpass,
+
+        /*!
+         * \brief u8 contents
+         */
+        NextSubpass,
+
+        EndRenderpass,
+
+        /*!
+         * \brief u32 camera index, u32 material index, u32 instance base, u32 transform index. Only recorded before a draw, and only when
+         * they've changed since the last draw
+         */
+        SetDrawConstants,
+
+        /*!
+         * \brief u32 pipeline
+         */
+        SetPipeline,
+
+        /*!
+         * \brief u32 descriptor set count
+         */
+        BindDescriptorSets,
+
+        /*!
+         * \brief u32 buffer count, then a u32 for each buffer
+         */
+        BindVertexBuffers,
+
+        /*!
+         * \brief u32 buffer, u8 index type
+         */
+        BindIndexBuffer,
+
+        /*!
+         * \brief u32 index count, u32 first index, u32 instance count, i32 vertex offset
+         */
+        DrawIndexedMesh,
+
+        /*!
+         * \brief u32 command buffer, u64 command offset, u32 max draw count, u32 count buffer, u64 count offset
+         */
+        DrawIndexedIndirect,
+
+        /*!
+         * \brief u32 pipeline
+         */
+        SetComputePipeline,
+
+        /*!
+         * \brief u32 binder, u32 frame index
+         */
+        BindComputeResources,
+
+        /*!
+         * \brief u32 groups x, u32 groups y, u32 groups z
+         */
+        Dispatch,
+
+        /*!
+         * \brief u32 buffer, u64 offset
+         */
+        DispatchIndirect,
+
+        /*!
+         * \brief u32 x, u32 y, u32 width, u32 height
+         */
+        SetScissorRect,
+
+        /*!
+         * \brief u32 pool, u32 timestamp index, u32 stage
+         */
+        WriteTimestamp,
+
+        /*!
+         * \brief u32 pool, u32 query index
+         */
+        BeginQuery,
+
+        /*!
+         * \brief u32 pool, u32 query index
+         */
+        EndQuery,
+
+        /*!
+         * \brief u32 x, u32 y, u32 width, u32 height
+         */
+        SetViewport,
+
+        /*!
+         * \brief u32 image, u32 mip, u32 x, u32 y, u32 width, u32 height, u32 source buffer, u64 source offset
+         */
+        CopyBufferToImage,
+
+        /*!
+         * \brief u32 image, u32 source mip, u32 source width, u32 source height, u32 number of mips
+         */
+        GenerateMips,
+
+        /*!
+         * \brief u32 destination buffer, u64 destination offset, u32 image, u32 mip, u32 x, u32 y, u32 width, u32 height
+         */
+        CopyImageToBuffer,
+
+        /*!
+         * \brief u32 source image, u32 source layer, u32 source width, u32 source height, u32 destination image, u32 destination width,
+         * u32 destination height
+         */
+        BlitImage,
+    };
+
+    /*!
+     * \brief Appends commands and their arguments to a byte buffer
+     */
+    class NullCommandStreamWriter {
+    public:
+        std::vector<uint8_t> bytes;
+
+        void write(NullCommand command) { write(static_cast<uint8_t>(command)); }
+
+        template <typename ValueType>
+        void write(const ValueType value) {
+            static_assert(std::is_trivially_copyable_v<ValueType>);
+
+            const auto offset = bytes.size();
+            bytes.resize(offset + sizeof(ValueType));
+            std::memcpy(bytes.data() + offset, &value, sizeof(ValueType));
+        }
+
+        void write_string(std::string_view str);
+
+        void write_bytes(std::span<const uint8_t> data);
+    };
+
+    /*!
+     * \brief One command list that was submitted to a `NullRenderDevice`
+     */
+    struct NullSubmission {
+        uint64_t frame_idx = 0;
+
+        QueueType queue = QueueType::Graphics;
+
+        std::vector<uint8_t> commands;
+    };
+
+    /*!
+     * \brief Turns a command stream into text, one command per line, with the commands of executed secondary lists indented under them
+     *
+     * Two captures of the same scene should disassemble to the same text, so diffing the text shows where they start to differ
+     */
+    [[nodiscard]] std::string disassemble_command_stream(std::span<const uint8_t> commands);
+
+    /*!
+     * \brief Starts a capture file
+     *
+     * A capture file is `NULL_CAPTURE_MAGIC`, then each submission: u64 frame index, u8 queue, u32 byte count, then its commands
+     */
+    void write_capture_header(std::ostream& file);
+
+    void write_capture_submission(std::ostream& file, uint64_t frame_idx, QueueType queue, std::span<const uint8_t> commands);
+
+    /*!
+     * \brief Reads every submission in a capture file that `NullRenderDevice` wrote
+     */
+    [[nodiscard]] ntl::Result<std::vector<NullSubmission>> read_capture(const std::filesystem::path& path);
+
+    constexpr std::string_view NULL_CAPTURE_MAGIC = "NOVACMD1";
+} // namespace nova::renderer::rhi
@@ -0,0 +1,482 @@
+#include "null_render_device.hpp"
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer::rhi {
+    static auto logger = make_logger("NullDevice");
+
+    NullRenderDevice::NullRenderDevice(NovaSettingsAccessManager& settings, NovaWindow& window) : RenderDevice{settings, window} {
+        ZoneScoped;
+        // Everything lives in CPU memory, so it's as unified as memory gets. Timestamps and pipeline statistics would only ever read
+        // zero, so we say we can't do them and the GPU profiler stays out of the way
+        info.architecture = DeviceArchitecture::unknown;
+        info.max_texture_size = 16384;
+        info.is_uma = true;
+        info.has_host_visible_device_memory = false;
+        info.has_async_compute_queue = true;
+        info.min_buffer_offset_alignment = 256;
+        info.timestamp_period = 0;
+        info.supports_pipeline_statistics = false;
+        info.supports_compute_quad_operations = false;
+
+        const uint32_t num_threads = settings->threading.num_worker_threads + 1;
+        command_list_pools.resize(settings->max_in_flight_frames);
+        for(auto& pools_by_thread : command_list_pools) {
+            pools_by_thread.resize(num_threads);
+        }
+
+        if(const auto& capture_path = settings->null_device.capture_path; !capture_path.empty()) {
+            capture_file.open(capture_path, std::ios::binary | std::ios::trunc);
+            if(capture_file) {
+                write_capture_header(capture_file);
+                logger->info("Capturing every command list to {}", capture_path);
+            } else {
+                logger->error("Could not open {} to capture command lists into", capture_path);
+            }
+        }
+
+        swapchain = new NullSwapchain(settings->swapchain.num_images, *this, swapchain_size);
+
+        logger->info("Created the null render device. Nothing will be drawn");
+    }
+
+    NullRenderDevice::~NullRenderDevice() { delete static_cast<NullSwapchain*>(swapchain); }
+
+    void NullRenderDevice::set_num_renderpasses(uint32_t /* num_renderpasses */) {}
+
+    ntl::Result<RhiRenderpass*> NullRenderDevice::create_renderpass(const renderpack::RenderPassCreateInfo& /* data */,
+                                                                    const glm::uvec2& /* framebuffer_size */) {
+        auto* renderpass = new NullRenderpass;
+        renderpass->id = get_next_object_id();
+
+        return ntl::Result<RhiRenderpass*>(renderpass);
+    }
+
+    ntl::Result<RhiRenderpass*> NullRenderDevice::create_merged_renderpass(
+        const std::vector<renderpack::RenderPassCreateInfo>& /* subpasses */,
+        const std::unordered_set<std::string>& /* transient_attachments */,
+        const glm::uvec2& /* framebuffer_size */) {
+        auto* renderpass = new NullRenderpass;
+        renderpass->id = get_next_object_id();
+
+        return ntl::Result<RhiRenderpass*>(renderpass);
+    }
+
+    RhiFramebuffer* NullRenderDevice::create_framebuffer(const RhiRenderpass* /* renderpass */,
+                                                         const std::vector<RhiImage*>& color_attachments,
+                                                         const std::optional<RhiImage*> depth_attachment,
+                                                         const std::optional<RhiImage*> /* shading_rate_attachment */,
+                                                         const glm::uvec2& framebuffer_size) {
+        auto* framebuffer = new NullFramebuffer;
+        framebuffer->id = get_next_object_id();
+        framebuffer->size = framebuffer_size;
+        framebuffer->num_attachments = static_cast<uint32_t>(color_attachments.size()) + (depth_attachment ? 1 : 0);
+
+        return framebuffer;
+    }
+
+    std::unique_ptr<RhiPipeline> NullRenderDevice::create_surface_pipeline(const RhiGraphicsPipelineState& pipeline_state) {
+        auto pipeline = std::make_unique<NullPipeline>();
+        pipeline->name = pipeline_state.name;
+        pipeline->id = get_next_object_id();
+
+        return pipeline;
+    }
+
+    std::unique_ptr<RhiPipeline> NullRenderDevice::create_global_pipeline(const RhiGraphicsPipelineState& pipeline_state) {
+        return create_surface_pipeline(pipeline_state);
+    }
+
+    std::unique_ptr<RhiPipeline> NullRenderDevice::create_compute_pipeline(const RhiComputePipelineState& pipeline_state) {
+        auto pipeline = std::make_unique<NullPipeline>();
+        pipeline->name = pipeline_state.name;
+        pipeline->id = get_next_object_id();
+
+        return pipeline;
+    }
+
+    bool NullRenderDevice::compile_pipeline(RhiPipeline& /* pipeline */,
+                                            const RhiRenderpass& /* renderpass */,
+                                            uint32_t /* subpass */) {
+        return true;
+    }
+
+    std::unique_ptr<RhiResourceBinder> NullRenderDevice::create_resource_binder_for_pipeline(const RhiPipeline& /* pipeline */) {
+        auto binder = std::make_unique<NullResourceBinder>();
+        binder->id = get_next_object_id();
+
+        return binder;
+    }
+
+    RhiBuffer* NullRenderDevice::create_buffer(const RhiBufferCreateInfo& info) {
+        ZoneScoped;
+        auto* buffer = new NullBuffer;
+        buffer->type = ResourceType::Buffer;
+        buffer->id = get_next_object_id();
+        buffer->size = info.size;
+
+        switch(info.buffer_usage) {
+            case BufferUsage::UniformBuffer:
+                [[fallthrough]];
+            case BufferUsage::StagingBuffer:
+                [[fallthrough]];
+            case BufferUsage::StorageBuffer:
+                [[fallthrough]];
+            case BufferUsage::UploadBuffer:
+                [[fallthrough]];
+            case BufferUsage::HostVisibleMeshBuffer:
+                [[fallthrough]];
+            case BufferUsage::ReadbackBuffer:
+                buffer->memory.resize(info.size.b_count());
+                break;
+
+            case BufferUsage::IndexBuffer:
+                [[fallthrough]];
+            case BufferUsage::VertexBuffer:
+                [[fallthrough]];
+            case BufferUsage::DeviceStorageBuffer:
+                [[fallthrough]];
+            case BufferUsage::ComputeVertexBuffer:
+                // Only command lists touch these, and ours don't read or write memory
+                break;
+        }
+
+        buffer_bytes += info.size.b_count();
+
+        return buffer;
+    }
+
+    void NullRenderDevice::write_data_to_buffer(const void* data, const mem::Bytes num_bytes, const RhiBuffer* buffer) {
+        write_data_to_buffer(data, num_bytes, 0, buffer);
+    }
+
+    void NullRenderDevice::write_data_to_buffer(const void* data,
+                                                const mem::Bytes num_bytes,
+                                                const mem::Bytes offset,
+                                                const RhiBuffer* buffer) {
+        ZoneScoped;
+        auto* null_buffer = const_cast<NullBuffer*>(static_cast<const NullBuffer*>(buffer));
+        if(offset.b_count() + num_bytes.b_count() > null_buffer->memory.size()) {
+            logger->error("Tried to write {} bytes at offset {} of buffer {}, which the CPU can't write that much of",
+                          num_bytes.b_count(),
+                          offset.b_count(),
+                          null_buffer->id);
+            return;
+        }
+
+        std::memcpy(null_buffer->memory.data() + offset.b_count(), data, num_bytes.b_count());
+    }
+
+    void* NullRenderDevice::get_mapped_data(const RhiBuffer* buffer) {
+        auto* null_buffer = const_cast<NullBuffer*>(static_cast<const NullBuffer*>(buffer));
+        return null_buffer->memory.empty() ? nullptr : null_buffer->memory.data();
+    }
+
+    void NullRenderDevice::flush_buffer(const RhiBuffer* /* buffer */, mem::Bytes /* offset */, mem::Bytes /* num_bytes */) {}
+
+    void NullRenderDevice::invalidate_buffer(const RhiBuffer* /* buffer */, mem::Bytes /* offset */, mem::Bytes /* num_bytes */) {}
+
+    std::vector<RhiMemoryHeapBudget> NullRenderDevice::get_memory_budgets() {
+        RhiMemoryHeapBudget heap;
+        heap.is_device_local = true;
+        heap.usage = buffer_bytes.load();
+        heap.budget = settings->null_device.memory_budget;
+
+        return {heap};
+    }
+
+    std::vector<RhiMemoryPoolStats> NullRenderDevice::get_memory_pool_stats() { return {}; }
+
+    RhiMemoryAccounting NullRenderDevice::get_memory_accounting() { return {}; }
+
+    bool NullRenderDevice::record_defragmentation(RhiRenderCommandList& /* cmds */,
+                                                  uint32_t /* max_moves */,
+                                                  mem::Bytes /* max_bytes */) {
+        return false;
+    }
+
+    RhiSampler* NullRenderDevice::create_sampler(const RhiSamplerCreateInfo& /* create_info */) {
+        auto* sampler = new NullSampler;
+        sampler->id = get_next_object_id();
+
+        return sampler;
+    }
+
+    bool NullRenderDevice::supports_render_target_format(const PixelFormat /* format */) { return true; }
+
+    RhiImage* NullRenderDevice::create_image(const renderpack::TextureCreateInfo& info) {
+        auto* image = new NullImage;
+        image->type = ResourceType::Image;
+        image->id = get_next_object_id();
+        image->is_depth_tex = info.format.pixel_format == PixelFormat::Depth32 || info.format.pixel_format == PixelFormat::Depth24Stencil8;
+
+        return image;
+    }
+
+    std::vector<RhiImage*> NullRenderDevice::create_aliased_images(const std::vector<renderpack::TextureCreateInfo>& infos) {
+        // None of our images have any memory, so they share it trivially
+        std::vector<RhiImage*> images;
+        images.reserve(infos.size());
+        for(const auto& info : infos) {
+            images.push_back(create_image(info));
+        }
+
+        return images;
+    }
+
+    RhiSemaphore* NullRenderDevice::create_semaphore() { return new NullSemaphore; }
+
+    std::vector<RhiSemaphore*> NullRenderDevice::create_semaphores(const uint32_t num_semaphores) {
+        std::vector<RhiSemaphore*> semaphores;
+        semaphores.reserve(num_semaphores);
+        for(uint32_t i = 0; i < num_semaphores; i++) {
+            semaphores.push_back(create_semaphore());
+        }
+
+        return semaphores;
+    }
+
+    RhiFence* NullRenderDevice::create_fence(bool /* signaled */) { return new NullFence; }
+
+    std::vector<RhiFence*> NullRenderDevice::create_fences(const uint32_t num_fences, const bool signaled) {
+        std::vector<RhiFence*> fences;
+        fences.reserve(num_fences);
+        for(uint32_t i = 0; i < num_fences; i++) {
+            fences.push_back(create_fence(signaled));
+        }
+
+        return fences;
+    }
+
+    void NullRenderDevice::wait_for_fences(std::span<RhiFence* const> /* fences */) {}
+
+    void NullRenderDevice::reset_fences(std::span<RhiFence* const> /* fences */) {}
+
+    RhiQueryPool* NullRenderDevice::create_timestamp_query_pool(const uint32_t num_timestamps) {
+        auto* pool = new NullQueryPool;
+        pool->id = get_next_object_id();
+        pool->num_queries = num_timestamps;
+
+        return pool;
+    }
+
+    RhiQueryPool* NullRenderDevice::create_pipeline_statistics_query_pool(const uint32_t num_queries) {
+        return create_timestamp_query_pool(num_queries);
+    }
+
+    RhiQueryPool* NullRenderDevice::create_occlusion_query_pool(const uint32_t num_queries) {
+        return create_timestamp_query_pool(num_queries);
+    }
+
+    void NullRenderDevice::reset_queries(RhiQueryPool* /* pool */, uint32_t /* first_query */, uint32_t /* num_queries */) {}
+
+    bool NullRenderDevice::get_timestamps(RhiQueryPool* /* pool */,
+                                          uint32_t /* first_timestamp */,
+                                          const uint32_t num_timestamps,
+                                          std::vector<uint64_t>& timestamps) {
+        timestamps.assign(num_timestamps, 0);
+        return true;
+    }
+
+    bool NullRenderDevice::get_pipeline_statistics(RhiQueryPool* /* pool */,
+                                                   uint32_t /* first_query */,
+                                                   const uint32_t num_queries,
+                                                   std::vector<RhiPipelineStatistics>& statistics) {
+        statistics.assign(num_queries, {});
+        return true;
+    }
+
+    bool NullRenderDevice::get_occlusion_query_results(RhiQueryPool* /* pool */,
+                                                       uint32_t /* first_query */,
+                                                       const uint32_t num_queries,
+                                                       std::vector<uint64_t>& samples_passed) {
+        // Nothing ever gets drawn, so nothing is ever hidden behind anything either. Calling everything visible keeps culling from
+        // throwing away geometry that tests want to see commands for
+        samples_passed.assign(num_queries, 1);
+        return true;
+    }
+
+    void NullRenderDevice::destroy_query_pool(RhiQueryPool* pool) { delete static_cast<NullQueryPool*>(pool); }
+
+    void NullRenderDevice::destroy_renderpass(RhiRenderpass* pass) { delete static_cast<NullRenderpass*>(pass); }
+
+    void NullRenderDevice::destroy_framebuffer(RhiFramebuffer* framebuffer) { delete static_cast<NullFramebuffer*>(framebuffer); }
+
+    void NullRenderDevice::destroy_texture(RhiImage* resource) { delete static_cast<NullImage*>(resource); }
+
+    void NullRenderDevice::destroy_buffer(RhiBuffer* buffer) {
+        buffer_bytes -= buffer->size.b_count();
+        delete static_cast<NullBuffer*>(buffer);
+    }
+
+    void NullRenderDevice::destroy_semaphores(std::vector<RhiSemaphore*>& semaphores) {
+        for(auto* semaphore : semaphores) {
+            delete static_cast<NullSemaphore*>(semaphore);
+        }
+    }
+
+    void NullRenderDevice::destroy_fences(const std::vector<RhiFence*>& fences) {
+        for(auto* fence : fences) {
+            delete static_cast<NullFence*>(fence);
+        }
+    }
+
+    RhiRenderCommandList* NullRenderDevice::create_command_list(const uint32_t thread_idx,
+                                                                QueueType /* needed_queue_type */,
+                                                                RhiRenderCommandList::Level /* level */) {
+        return &acquire_command_list(thread_idx);
+    }
+
+    RhiRenderCommandList* NullRenderDevice::create_secondary_command_list(const uint32_t thread_idx,
+                                                                          RhiRenderpass* /* renderpass */,
+                                                                          const RhiFramebuffer* /* framebuffer */,
+                                                                          uint32_t /* subpass */) {
+        return &acquire_command_list(thread_idx);
+    }
+
+    RhiRenderCommandList* NullRenderDevice::create_reusable_command_list(RhiRenderpass* /* renderpass */,
+                                                                         const RhiFramebuffer* /* framebuffer */,
+                                                                         uint32_t /* subpass */) {
+        auto* list = new NullRenderCommandList;
+        list->begin();
+
+        return list;
+    }
+
+    // Nothing is ever in flight
+    void NullRenderDevice::destroy_reusable_command_list(RhiRenderCommandList* cmds) { delete static_cast<NullRenderCommandList*>(cmds); }
+
+    void NullRenderDevice::submit_command_list(RhiRenderCommandList* cmds,
+                                               const QueueType queue,
+                                               RhiFence* /* fence_to_signal */,
+                                               std::span<RhiSemaphore* const> /* wait_semaphores */,
+                                               std::span<RhiSemaphore* const> /* signal_semaphores */,
+                                               std::function<void()> on_completion) {
+        ZoneScoped;
+        const auto& commands = static_cast<NullRenderCommandList*>(cmds)->get_commands();
+
+        std::lock_guard lock{submit_mutex};
+        num_submissions_this_frame++;
+        command_bytes_this_frame += commands.size();
+
+        if(capture_file.is_open()) {
+            write_capture_submission(capture_file, num_frames_ended, queue, commands);
+        }
+
+        if(on_completion) {
+            pending_completions.push_back(std::move(on_completion));
+        }
+    }
+
+    void NullRenderDevice::submit_command_lists(const std::span<const RhiSubmission> submissions, RhiFence* /* fence_to_signal */) {
+        ZoneScoped;
+        std::lock_guard lock{submit_mutex};
+        for(const RhiSubmission& submission : submissions) {
+            const auto& commands = static_cast<NullRenderCommandList*>(submission.cmds)->get_commands();
+
+            num_submissions_this_frame++;
+            command_bytes_this_frame += commands.size();
+
+            if(capture_file.is_open()) {
+                write_capture_submission(capture_file, num_frames_ended, submission.queue, commands);
+            }
+
+            if(submission.on_completion) {
+                pending_completions.push_back(submission.on_completion);
+            }
+        }
+    }
+
+    void NullRenderDevice::update_standard_descriptors(uint32_t /* frame_idx */,
+                                                       RhiBuffer* /* camera_buffer */,
+                                                       RhiBuffer* /* material_buffer */,
+                                                       RhiBuffer* /* model_matrix_buffer */,
+                                                       RhiBuffer* /* vertex_layouts */,
+                                                       RhiSampler* /* point_sampler */,
+                                                       RhiSampler* /* bilinear_sampler */,
+                                                       RhiSampler* /* trilinear_sampler */,
+                                                       RhiBuffer* /* virtual_page_table */,
+                                                       RhiBuffer* /* virtual_texture_feedback */,
+                                                       RhiImage* /* virtual_texture_cache */,
+                                                       RhiBuffer* /* light_cluster_params */,
+                                                       RhiBuffer* /* lights */,
+                                                       RhiBuffer* /* light_clusters */,
+                                                       RhiBuffer* /* light_indices */,
+                                                       RhiBuffer* /* particles */,
+                                                       RhiImage* /* volumetric_fog */,
+                                                       std::span<RhiBuffer* const> /* vertex_buffers */,
+                                                       std::span<RhiImage* const> /* textures */) {}
+
+    void NullRenderDevice::begin_frame(const uint32_t frame_idx) {
+        ZoneScoped;
+        cur_frame_idx = frame_idx;
+
+        for(auto& pool : command_list_pools[frame_idx]) {
+            pool.num_in_use = 0;
+        }
+    }
+
+    void NullRenderDevice::end_frame(FrameContext& /* ctx */) {
+        ZoneScoped;
+        std::vector<std::function<void()>> completions;
+        {
+            std::lock_guard lock{submit_mutex};
+            completions.swap(pending_completions);
+
+            TracyPlot("Null device submissions", static_cast<int64_t>(num_submissions_this_frame));
+            TracyPlot("Null device command bytes", static_cast<int64_t>(command_bytes_this_frame));
+            num_submissions_this_frame = 0;
+            command_bytes_this_frame = 0;
+
+            if(capture_file.is_open()) {
+                capture_file.flush();
+            }
+
+            num_frames_ended++;
+        }
+
+        // Completions may submit more work, so they run without the lock
+        for(auto& completion : completions) {
+            completion();
+        }
+    }
+
+    void NullRenderDevice::save_pipeline_cache() {}
+
+    void NullRenderDevice::recreate_swapchain() {
+        ZoneScoped;
+        swapchain_size = window.get_framebuffer_size();
+        swapchain->recreate(swapchain_size);
+    }
+
+    Swapchain* NullRenderDevice::create_window_swapchain(NovaWindow& output_window) {
+        return new NullSwapchain(settings->swapchain.num_images, *this, output_window.get_framebuffer_size());
+    }
+
+    void NullRenderDevice::recreate_window_swapchain(Swapchain& output_swapchain, const NovaWindow& output_window) {
+        ZoneScoped;
+        output_swapchain.recreate(output_window.get_framebuffer_size());
+    }
+
+    void NullRenderDevice::destroy_window_swapchain(Swapchain* output_swapchain) { delete static_cast<NullSwapchain*>(output_swapchain); }
+
+    uint32_t NullRenderDevice::get_next_object_id() { return next_object_id.fetch_add(1); }
+
+    NullRenderCommandList& NullRenderDevice::acquire_command_list(const uint32_t thread_idx) {
+        auto& pool = command_list_pools[cur_frame_idx][thread_idx];
+        if(pool.num_in_use == pool.lists.size()) {
+            pool.lists.push_back(std::make_unique<NullRenderCommandList>());
+        }
+
+        auto& list = *pool.lists[pool.num_in_use];
+        pool.num_in_use++;
+
+        list.begin();
+
+        return list;
+    }
+} // namespace nova::renderer::rhi
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "nova_renderer/rhi/render_device.hpp"
+
+#include "null_command_list.hpp"
+#include "null_structs.hpp"
+#include "null_swapchain.hpp"
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief A render device that does no GPU work at all
+     *
+     * Resources are plain CPU objects. Buffers that the CPU can write to get real memory, so everything that fills them in still runs.
+     * Command lists record their commands into byte streams, which can be written to a capture file and compared with another run's
+     * capture. The GPU finishes everything the moment it's submitted, so fences are always signaled and completion callbacks run in the
+     * next `end_frame`
+     */
+    class NullRenderDevice final : public RenderDevice {
+    public:
+        NullRenderDevice(NovaSettingsAccessManager& settings, NovaWindow& window);
+
+        NullRenderDevice(NullRenderDevice&& old) noexcept = delete;
+        NullRenderDevice& operator=(NullRenderDevice&& old) noexcept = delete;
+
+        NullRenderDevice(const NullRenderDevice& other) = delete;
+        NullRenderDevice& operator=(const NullRenderDevice& other) = delete;
+
+        ~NullRenderDevice() override;
+
+#pragma region Render engine interface
+        void set_num_renderpasses(uint32_t num_renderpasses) override;
+
+        [[nodiscard]] ntl::Result<RhiRenderpass*> create_renderpass(const renderpack::RenderPassCreateInfo& data,
+                                                                    const glm::uvec2& framebuffer_size) override;
+
+        [[nodiscard]] ntl::Result<RhiRenderpass*> create_merged_renderpass(
+            const std::vector<renderpack::RenderPassCreateInfo>& subpasses,
+            const std::unordered_set<std::string>& transient_attachments,
+            const glm::uvec2& framebuffer_size) override;
+
+        [[nodiscard]] RhiFramebuffer* create_framebuffer(const RhiRenderpass* renderpass,
+                                                         const std::vector<RhiImage*>& color_attachments,
+                                                         const std::optional<RhiImage*> depth_attachment,
+                                                         const std::optional<RhiImage*> shading_rate_attachment,
+                                                         const glm::uvec2& framebuffer_size) override;
+
+        [[nodiscard]] std::unique_ptr<RhiPipeline> create_surface_pipeline(const RhiGraphicsPipelineState& pipeline_state) override;
+
+        [[nodiscard]] std::unique_ptr<RhiPipeline> create_global_pipeline(const RhiGraphicsPipelineState& pipeline_state) override;
+
+        [[nodiscard]] std::unique_ptr<RhiPipeline> create_compute_pipeline(const RhiComputePipelineState& pipeline_state) override;
+
+        [[nodiscard]] bool compile_pipeline(RhiPipeline& pipeline, const RhiRenderpass& renderpass, uint32_t subpass) override;
+
+        [[nodiscard]] std::unique_ptr<RhiResourceBinder> create_resource_binder_for_pipeline(const RhiPipeline& pipeline) override;
+
+        [[nodiscard]] RhiBuffer* create_buffer(const RhiBufferCreateInfo& info) override;
+
+        void write_data_to_buffer(const void* data, mem::Bytes num_bytes, const RhiBuffer* buffer) override;
+
+        void write_data_to_buffer(const void* data, mem::Bytes num_bytes, mem::Bytes offset, const RhiBuffer* buffer) override;
+
+        [[nodiscard]] void* get_mapped_data(const RhiBuffer* buffer) override;
+
+        void flush_buffer(const RhiBuffer* buffer, mem::Bytes offset, mem::Bytes num_bytes) override;
+
+        void invalidate_buffer(const RhiBuffer* buffer, mem::Bytes offset, mem::Bytes num_bytes) override;
+
+        [[nodiscard]] std::vector<RhiMemoryHeapBudget> get_memory_budgets() override;
+
+        [[nodiscard]] std::vector<RhiMemoryPoolStats> get_memory_pool_stats() override;
+
+        [[nodiscard]] RhiMemoryAccounting get_memory_accounting() override;
+
+        bool record_defragmentation(RhiRenderCommandList& cmds, uint32_t max_moves, mem::Bytes max_bytes) override;
+
+        [[nodiscard]] RhiSampler* create_sampler(const RhiSamplerCreateInfo& create_info) override;
+
+        [[nodiscard]] bool supports_render_target_format(PixelFormat format) override;
+
+        [[nodiscard]] RhiImage* create_image(const renderpack::TextureCreateInfo& info) override;
+
+        [[nodiscard]] std::vector<RhiImage*> create_aliased_images(const std::vector<renderpack::TextureCreateInfo>& infos) override;
+
+        [[nodiscard]] RhiSemaphore* create_semaphore() override;
+
+        [[nodiscard]] std::vector<RhiSemaphore*> create_semaphores(uint32_t num_semaphores) override;
+
+        [[nodiscard]] RhiFence* create_fence(bool signaled) override;
+
+        [[nodiscard]] std::vector<RhiFence*> create_fences(uint32_t num_fences, bool signaled) override;
+
+        void wait_for_fences(std::span<RhiFence* const> fences) override;
+
+        void reset_fences(std::span<RhiFence* const> fences) override;
+
+        [[nodiscard]] RhiQueryPool* create_timestamp_query_pool(uint32_t num_timestamps) override;
+
+        [[nodiscard]] RhiQueryPool* create_pipeline_statistics_query_pool(uint32_t num_queries) override;
+
+        [[nodiscard]] RhiQueryPool* create_occlusion_query_pool(uint32_t num_queries) override;
+
+        void reset_queries(RhiQueryPool* pool, uint32_t first_query, uint32_t num_queries) override;
+
+        [[nodiscard]] bool get_timestamps(RhiQueryPool* pool,
+                                          uint32_t first_timestamp,
+                                          uint32_t num_timestamps,
+                                          std::vector<uint64_t>& timestamps) override;
+
+        [[nodiscard]] bool get_pipeline_statistics(RhiQueryPool* pool,
+                                                   uint32_t first_query,
+                                                   uint32_t num_queries,
+                                                   std::vector<RhiPipelineStatistics>& statistics) override;
+
+        [[nodiscard]] bool get_occlusion_query_results(RhiQueryPool* pool,
+                                                       uint32_t first_query,
+                                                       uint32_t num_queries,
+                                                       std::vector<uint64_t>& samples_passed) override;
+
+        void destroy_query_pool(RhiQueryPool* pool) override;
+
+        void destroy_renderpass(RhiRenderpass* pass) override;
+
+        void destroy_framebuffer(RhiFramebuffer* framebuffer) override;
+
+        void destroy_texture(RhiImage* resource) override;
+
+        void destroy_buffer(RhiBuffer* buffer) override;
+
+        void destroy_semaphores(std::vector<RhiSemaphore*>& semaphores) override;
+
+        void destroy_fences(const std::vector<RhiFence*>& fences) override;
+
+        RhiRenderCommandList* create_command_list(uint32_t thread_idx,
+                                                  QueueType needed_queue_type,
+                                                  RhiRenderCommandList::Level level) override;
+
+        RhiRenderCommandList* create_secondary_command_list(uint32_t thread_idx,
+                                                            RhiRenderpass* renderpass,
+                                                            const RhiFramebuffer* framebuffer,
+                                                            uint32_t subpass) override;
+
+        RhiRenderCommandList* create_reusable_command_list(RhiRenderpass* renderpass,
+                                                           const RhiFramebuffer* framebuffer,
+                                                           uint32_t subpass) override;
+
+        void destroy_reusable_command_list(RhiRenderCommandList* cmds) override;
+
+        void submit_command_list(RhiRenderCommandList* cmds,
+                                 QueueType queue,
+                                 RhiFence* fence_to_signal,
+                                 std::span<RhiSemaphore* const> wait_semaphores,
+                                 std::span<RhiSemaphore* const> signal_semaphores,
+                                 std::function<void()> on_completion) override;
+
+        void submit_command_lists(std::span<const RhiSubmission> submissions, RhiFence* fence_to_signal) override;
+
+        void update_standard_descriptors(uint32_t frame_idx,
+                                         RhiBuffer* camera_buffer,
+                                         RhiBuffer* material_buffer,
+                                         RhiBuffer* model_matrix_buffer,
+                                         RhiBuffer* vertex_layouts,
+                                         RhiSampler* point_sampler,
+                                         RhiSampler* bilinear_sampler,
+                                         RhiSampler* trilinear_sampler,
+                                         RhiBuffer* virtual_page_table,
+                                         RhiBuffer* virtual_texture_feedback,
+                                         RhiImage* virtual_texture_cache,
+                                         RhiBuffer* light_cluster_params,
+                                         RhiBuffer* lights,
+                                         RhiBuffer* light_clusters,
+                                         RhiBuffer* light_indices,
+                                         RhiBuffer* particles,
+                                         RhiImage* volumetric_fog,
+                                         std::span<RhiBuffer* const> vertex_buffers,
+                                         std::span<RhiImage* const> textures) override;
+
+        void begin_frame(uint32_t frame_idx) override;
+
+        void end_frame(FrameContext& ctx) override;
+
+        void save_pipeline_cache() override;
+
+        void recreate_swapchain() override;
+
+        [[nodiscard]] Swapchain* create_window_swapchain(NovaWindow& output_window) override;
+
+        void recreate_window_swapchain(Swapchain& output_swapchain, const NovaWindow& output_window) override;
+
+        void destroy_window_swapchain(Swapchain* output_swapchain) override;
+#pragma endregion
+
+        /*!
+         * \brief Gets an id for a new object. Ids start at 1 and are never reused, so a run that creates the same objects in the same
+         * order gives them the same ids
+         */
+        [[nodiscard]] uint32_t get_next_object_id();
+
+    private:
+        /*!
+         * \brief The command lists that one thread allocated in one frame slot. They're handed out again once the frame slot comes back
+         * around
+         */
+        struct CommandListPool {
+            std::vector<std::unique_ptr<NullRenderCommandList>> lists;
+
+            size_t num_in_use = 0;
+        };
+
+        /*!
+         * \brief Command list pools for each frame slot, and each thread within it
+         */
+        std::vector<std::vector<CommandListPool>> command_list_pools;
+
+        uint32_t cur_frame_idx = 0;
+
+        uint64_t num_frames_ended = 0;
+
+        std::atomic<uint32_t> next_object_id{1};
+
+        /*!
+         * \brief Bytes of buffers that are alive right now, reported as the usage of our one memory heap
+         */
+        std::atomic<uint64_t> buffer_bytes{0};
+
+        /*!
+         * \brief Guards everything below it. Submissions may come from any thread
+         */
+        std::mutex submit_mutex;
+
+        std::vector<std::function<void()>> pending_completions;
+
+        uint64_t num_submissions_this_frame = 0;
+
+        uint64_t command_bytes_this_frame = 0;
+
+        std::ofstream capture_file;
+
+        NullRenderCommandList& acquire_command_list(uint32_t thread_idx);
+    };
+} // namespace nova::renderer::rhi
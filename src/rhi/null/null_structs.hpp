@@ -0,0 +1,80 @@
+/*!
+ * \brief Null definition of the structs forward-declared in render_device.hpp
+ *
+ * Every object remembers the id that `NullRenderDevice` gave it, which is what command streams refer to it by
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "nova_renderer/rhi/resource_binder.hpp"
+#include "nova_renderer/rhi/rhi_types.hpp"
+
+namespace nova::renderer::rhi {
+    struct NullSampler : RhiSampler {
+        uint32_t id = 0;
+    };
+
+    struct NullImage : RhiImage {
+        uint32_t id = 0;
+    };
+
+    struct NullBuffer : RhiBuffer {
+        uint32_t id = 0;
+
+        /*!
+         * \brief What the CPU sees when it maps the buffer. Empty for buffers that the CPU can't write to, so they don't cost any memory
+         */
+        std::vector<uint8_t> memory;
+    };
+
+    struct NullRenderpass : RhiRenderpass {
+        uint32_t id = 0;
+    };
+
+    struct NullFramebuffer : RhiFramebuffer {
+        uint32_t id = 0;
+    };
+
+    struct NullPipeline : RhiPipeline {
+        uint32_t id = 0;
+    };
+
+    struct NullSemaphore : RhiSemaphore {};
+
+    struct NullFence : RhiFence {};
+
+    struct NullQueryPool : RhiQueryPool {
+        uint32_t id = 0;
+
+        uint32_t num_queries = 0;
+    };
+
+    /*!
+     * \brief Remembers nothing, since nothing ever reads the resources it would bind
+     */
+    class NullResourceBinder final : public RhiResourceBinder {
+    public:
+        uint32_t id = 0;
+
+        void bind_image(const std::string& /* binding_name */, RhiImage* /* image */) override {}
+
+        void bind_buffer(const std::string& /* binding_name */, RhiBuffer* /* buffer */) override {}
+
+        void bind_buffer_range(const std::string& /* binding_name */,
+                               RhiBuffer* /* buffer */,
+                               uint64_t /* offset */,
+                               uint64_t /* num_bytes */) override {}
+
+        void bind_sampler(const std::string& /* binding_name */, RhiSampler* /* sampler */) override {}
+
+        void bind_image_array(const std::string& /* binding_name */, const std::vector<RhiImage*>& /* images */) override {}
+
+        void bind_buffer_array(const std::string& /* binding_name */, const std::vector<RhiBuffer*>& /* buffers */) override {}
+
+        void bind_sampler_array(const std::string& /* binding_name */, const std::vector<RhiSampler*>& /* samplers */) override {}
+
+        void bind_image_mips(const std::string& /* binding_name */, RhiImage* /* image */, uint32_t /* first_mip */) override {}
+    };
+} // namespace nova::renderer::rhi
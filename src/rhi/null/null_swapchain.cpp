@@ -0,0 +1,67 @@
+#include "null_swapchain.hpp"
+
+#include "null_render_device.hpp"
+
+namespace nova::renderer::rhi {
+    NullSwapchain::NullSwapchain(const uint32_t num_images, NullRenderDevice& device, const glm::uvec2 size)
+        : Swapchain(num_images, size), device(device) {
+        create_images();
+    }
+
+    NullSwapchain::~NullSwapchain() { destroy_images(); }
+
+    std::optional<uint8_t> NullSwapchain::acquire_next_swapchain_image(RhiSemaphore* /* image_available_semaphore */) {
+        const auto image_idx = next_image_idx;
+        next_image_idx = (next_image_idx + 1) % num_images;
+
+        return static_cast<uint8_t>(image_idx);
+    }
+
+    void NullSwapchain::present(uint32_t /* image_idx */, RhiSemaphore* /* render_finished_semaphore */) {}
+
+    bool NullSwapchain::wait_for_last_present(uint64_t /* timeout_ns */) { return false; }
+
+    void NullSwapchain::recreate(const glm::uvec2& new_size) {
+        destroy_images();
+
+        size = new_size;
+        next_image_idx = 0;
+        is_out_of_date = false;
+
+        create_images();
+    }
+
+    void NullSwapchain::create_images() {
+        for(uint32_t i = 0; i < num_images; i++) {
+            auto* image = new NullImage;
+            image->type = ResourceType::Image;
+            image->is_dynamic = false;
+            image->id = device.get_next_object_id();
+            swapchain_images.push_back(image);
+
+            auto* framebuffer = new NullFramebuffer;
+            framebuffer->id = device.get_next_object_id();
+            framebuffer->size = size;
+            framebuffer->num_attachments = 1;
+            framebuffers.push_back(framebuffer);
+
+            fences.push_back(new NullFence);
+        }
+    }
+
+    void NullSwapchain::destroy_images() {
+        for(auto* image : swapchain_images) {
+            device.destroy_texture(image);
+        }
+
+        for(auto* framebuffer : framebuffers) {
+            device.destroy_framebuffer(framebuffer);
+        }
+
+        device.destroy_fences(fences);
+
+        swapchain_images.clear();
+        framebuffers.clear();
+        fences.clear();
+    }
+} // namespace nova::renderer::rhi
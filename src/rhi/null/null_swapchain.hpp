@@ -0,0 +1,45 @@
+#pragma once
+
+#include "nova_renderer/rhi/swapchain.hpp"
+
+namespace nova::renderer::rhi {
+    class NullRenderDevice;
+
+    /*!
+     * \brief A swapchain that hands out its images in order and presents to nowhere
+     */
+    class NullSwapchain final : public Swapchain {
+    public:
+        NullSwapchain(uint32_t num_images, NullRenderDevice& device, glm::uvec2 size);
+
+        NullSwapchain(const NullSwapchain& other) = delete;
+        NullSwapchain& operator=(const NullSwapchain& other) = delete;
+
+        NullSwapchain(NullSwapchain&& old) noexcept = delete;
+        NullSwapchain& operator=(NullSwapchain&& old) noexcept = delete;
+
+        ~NullSwapchain() override;
+
+#pragma region Swapchain implementation
+        [[nodiscard]] std::optional<uint8_t> acquire_next_swapchain_image(RhiSemaphore* image_available_semaphore) override;
+
+        void present(uint32_t image_idx, RhiSemaphore* render_finished_semaphore) override;
+
+        /*!
+         * \brief There's no display, so the null swapchain never knows when an image is shown
+         */
+        [[nodiscard]] bool wait_for_last_present(uint64_t timeout_ns) override;
+
+        void recreate(const glm::uvec2& new_size) override;
+#pragma endregion
+
+    private:
+        NullRenderDevice& device;
+
+        uint32_t next_image_idx = 0;
+
+        void create_images();
+
+        void destroy_images();
+    };
+} // namespace nova::renderer::rhi
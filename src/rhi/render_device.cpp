@@ -1,8 +1,17 @@
 #include "nova_renderer/rhi/render_device.hpp"
 
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+#include "null/null_render_device.hpp"
 #include "vulkan/vulkan_render_device.hpp"
 
 namespace nova::renderer::rhi {
+#ifdef NOVA_STATIC_VULKAN_RHI
+    static auto logger = make_logger("RenderDevice");
+#endif
+
     Swapchain* RenderDevice::get_swapchain() const { return swapchain; }
 
     RenderDevice::RenderDevice(NovaSettingsAccessManager& settings, NovaWindow& window)
@@ -11,6 +20,15 @@ namespace nova::renderer::rhi {
           swapchain_size(settings.settings.window.width, settings.settings.window.height) {}
 
     std::unique_ptr<RenderDevice> create_render_device(NovaSettingsAccessManager& settings, NovaWindow& window) {
+        if(settings->null_device.enabled) {
+#ifdef NOVA_STATIC_VULKAN_RHI
+            // The draw loops call straight into the Vulkan command list, so nothing else can record them
+            logger->warn("Nova was built with NOVA_STATIC_VULKAN_RHI, so it can't use the null device. Using Vulkan instead");
+#else
+            return std::make_unique<NullRenderDevice>(settings, window);
+#endif
+        }
+
         return std::make_unique<VulkanRenderDevice>(settings, window);
     }
 } // namespace nova::renderer::rhi
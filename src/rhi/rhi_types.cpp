@@ -7,6 +7,29 @@ namespace nova::renderer::rhi {
 
     bool RhiResourceBindingDescription::operator!=(const RhiResourceBindingDescription& other) { return !(*this == other); }
 
+    RhiCommandListStats& RhiCommandListStats::operator+=(const RhiCommandListStats& other) {
+        draw_calls += other.draw_calls;
+        instances += other.instances;
+        triangles += other.triangles;
+        indirect_draw_calls += other.indirect_draw_calls;
+        dispatches += other.dispatches;
+        pipeline_binds += other.pipeline_binds;
+        descriptor_set_binds += other.descriptor_set_binds;
+        buffer_binds += other.buffer_binds;
+        draw_constant_pushes += other.draw_constant_pushes;
+        barriers += other.barriers;
+        bytes_uploaded += other.bytes_uploaded;
+
+        return *this;
+    }
+
+    bool RhiDrawConstants::operator==(const RhiDrawConstants& other) const {
+        return camera_index == other.camera_index && material_index == other.material_index && instance_base == other.instance_base &&
+               transform_index == other.transform_index;
+    }
+
+    bool RhiDrawConstants::operator!=(const RhiDrawConstants& other) const { return !(*this == other); }
+
     RhiResourceBarrier::RhiResourceBarrier() : buffer_memory_barrier{0, 0} {};
 
     uint32_t RhiPipelineInterface::get_num_descriptors_of_type(const DescriptorType type) const {
@@ -20,8 +43,13 @@ namespace nova::renderer::rhi {
         return num_descriptors;
     }
 
-    ShaderStage operator|=(const ShaderStage lhs, const ShaderStage rhs) {
-        return static_cast<ShaderStage>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+    ShaderStage& operator|=(ShaderStage& lhs, const ShaderStage rhs) {
+        lhs = static_cast<ShaderStage>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+        return lhs;
+    }
+
+    PipelineStage operator|(const PipelineStage lhs, const PipelineStage rhs) {
+        return static_cast<PipelineStage>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
     }
 
     bool is_depth_format(const PixelFormat format) {
@@ -31,6 +59,18 @@ namespace nova::renderer::rhi {
             case PixelFormat::Rgba16F:
                 [[fallthrough]];
             case PixelFormat::Rgba32F:
+                [[fallthrough]];
+            case PixelFormat::Rg32F:
+                [[fallthrough]];
+            case PixelFormat::R8Uint:
+                [[fallthrough]];
+            case PixelFormat::Rg11B10F:
+                [[fallthrough]];
+            case PixelFormat::Rgb10A2:
+                [[fallthrough]];
+            case PixelFormat::Rg16F:
+                [[fallthrough]];
+            case PixelFormat::Rg16Snorm:
                 return false;
 
             case PixelFormat::Depth32:
@@ -43,6 +83,24 @@ namespace nova::renderer::rhi {
         }
     }
 
+    bool is_block_compressed_format(const PixelFormat format) {
+        switch(format) {
+            case PixelFormat::Bc1:
+                [[fallthrough]];
+            case PixelFormat::Bc3:
+                [[fallthrough]];
+            case PixelFormat::Bc5:
+                [[fallthrough]];
+            case PixelFormat::Bc7:
+                [[fallthrough]];
+            case PixelFormat::Astc4x4:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
     uint32_t get_byte_size(const VertexFieldFormat format) {
         switch(format) {
             case VertexFieldFormat::Uint:
@@ -57,6 +115,20 @@ namespace nova::renderer::rhi {
             case VertexFieldFormat::Float4:
                 return 16;
 
+            case VertexFieldFormat::Unorm16x2:
+                [[fallthrough]];
+            case VertexFieldFormat::Snorm16x2:
+                [[fallthrough]];
+            case VertexFieldFormat::Half2:
+                return 4;
+
+            case VertexFieldFormat::Unorm16x4:
+                [[fallthrough]];
+            case VertexFieldFormat::Snorm16x4:
+                [[fallthrough]];
+            case VertexFieldFormat::Half4:
+                return 8;
+
             default:
                 return 16;
         }
@@ -79,8 +151,62 @@ namespace nova::renderer::rhi {
             case DescriptorType::Sampler:
                 return "Sampler";
 
+            case DescriptorType::StorageImage:
+                return "StorageImage";
+
             default:
                 return "Unknown";
         }
     }
+
+    std::string memory_category_to_string(const MemoryCategory category) {
+        switch(category) {
+            case MemoryCategory::Mesh:
+                return "Mesh";
+
+            case MemoryCategory::Texture:
+                return "Texture";
+
+            case MemoryCategory::RenderTarget:
+                return "RenderTarget";
+
+            case MemoryCategory::Staging:
+                return "Staging";
+
+            case MemoryCategory::Uniform:
+                return "Uniform";
+
+            case MemoryCategory::Compute:
+                return "Compute";
+
+            case MemoryCategory::Descriptor:
+                return "Descriptor";
+
+            default:
+                return "Unknown";
+        }
+    }
+
+    MemoryCategory get_memory_category(const BufferUsage usage) {
+        switch(usage) {
+            case BufferUsage::IndexBuffer:
+            case BufferUsage::VertexBuffer:
+            case BufferUsage::HostVisibleMeshBuffer:
+            case BufferUsage::ComputeVertexBuffer:
+                return MemoryCategory::Mesh;
+
+            case BufferUsage::StagingBuffer:
+            case BufferUsage::ReadbackBuffer:
+                return MemoryCategory::Staging;
+
+            case BufferUsage::DeviceStorageBuffer:
+                return MemoryCategory::Compute;
+
+            case BufferUsage::UniformBuffer:
+            case BufferUsage::StorageBuffer:
+            case BufferUsage::UploadBuffer:
+            default:
+                return MemoryCategory::Uniform;
+        }
+    }
 } // namespace nova::renderer::rhi
@@ -10,4 +10,8 @@ namespace nova::renderer::rhi {
     RhiFence* Swapchain::get_fence(const uint32_t frame_idx) const { return fences[frame_idx]; }
 
     glm::uvec2 Swapchain::get_size() const { return size; }
+
+    bool Swapchain::needs_recreation() const { return is_out_of_date; }
+
+    uint32_t Swapchain::get_num_images() const { return static_cast<uint32_t>(swapchain_images.size()); }
 } // namespace nova::renderer::rhi
\ No newline at end of file
@@ -4,6 +4,10 @@
 
 #pragma once
 
+#include <optional>
+#include <utility>
+#include <vector>
+
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.hpp>
 
@@ -11,6 +15,8 @@
 #include "nova_renderer/rhi/rhi_types.hpp"
 
 namespace nova::renderer::rhi {
+    struct VulkanRenderpass;
+
     struct VulkanDeviceMemory : RhiDeviceMemory {
         vk::DeviceMemory memory;
     };
@@ -19,16 +25,82 @@ namespace nova::renderer::rhi {
         vk::Sampler sampler;
     };
 
+    /*!
+     * \brief Which part of an image a view sees, and how it sees it
+     */
+    struct VulkanImageViewDesc {
+        vk::ImageViewType type = vk::ImageViewType::e2D;
+
+        /*!
+         * \brief The format to view the image as. Undefined means the image's own format
+         */
+        vk::Format format = VK_FORMAT_UNDEFINED;
+
+        vk::ComponentMapping swizzle{};
+
+        vk::ImageSubresourceRange range{};
+
+        bool operator==(const VulkanImageViewDesc& other) const = default;
+    };
+
     struct VulkanImage : RhiImage {
         vk::Image image = VK_NULL_HANDLE;
+
+        /*!
+         * \brief The view of every mip and layer of the image
+         */
         vk::ImageView image_view = VK_NULL_HANDLE;
+
+        /*!
+         * \brief Views of parts of the image, which `VulkanRenderDevice::get_image_view` makes when they're first asked for
+         *
+         * Images usually only have a handful of these, if any, so finding one is a quick walk through them
+         */
+        mutable std::vector<std::pair<VulkanImageViewDesc, vk::ImageView>> extra_views;
+
+        uint32_t num_mips = 1;
+
+        uint32_t num_layers = 1;
+
+        /*!
+         * \brief How many slices deep the image is. Images more than one slice deep are 3D images
+         */
+        uint32_t depth = 1;
+
         VmaAllocation allocation{};
+        vk::Format format = VK_FORMAT_UNDEFINED;
+
+        /*!
+         * \brief How many samples the image's multisampled copy has, or one if it doesn't have one
+         */
+        vk::SampleCountFlagBits num_samples = vk::SampleCountFlagBits::e1;
+
+        /*!
+         * \brief The transient image that renderpasses render to, for images with more than one sample. Renderpasses resolve it into
+         * `image` at the end, and never store it, so drivers that can leave it in tile memory don't have to back it with memory at all
+         */
+        vk::Image multisampled_image = VK_NULL_HANDLE;
+
+        vk::ImageView multisampled_view = VK_NULL_HANDLE;
+
+        VmaAllocation multisampled_allocation{};
+
+        /*!
+         * \brief How the image was created, so that defragmentation can make an identical image somewhere else
+         */
+        vk::ImageCreateInfo create_info{};
+
+        /*!
+         * \brief The `VulkanRenderDevice::num_frames_begun` when the image was created
+         */
+        uint32_t creation_frame = 0;
     };
 
     struct VulkanBuffer : RhiBuffer {
         vk::Buffer buffer = VK_NULL_HANDLE;
         VmaAllocation allocation{};
         VmaAllocationInfo allocation_info{};
+        vk::BufferUsageFlags usage{};
     };
 
     struct VulkanMaterialResources : RhiMaterialResources {
@@ -45,6 +117,13 @@ namespace nova::renderer::rhi {
         std::vector<uint32_t> variable_descriptor_set_counts;
     };
 
+    /*!
+     * \brief The parts of a pipeline that graphics and compute pipelines have in common
+     */
+    struct VulkanPipelineBase : RhiPipeline {
+        VulkanPipelineLayoutInfo layout;
+    };
+
     /*!
      * \brief Represents a Vulkan pipeline
      *
@@ -52,27 +131,117 @@ namespace nova::renderer::rhi {
      * write to. This struct just contains the input layout of the pipeline and the PSO create info, which we combine
      * with a renderpass to compile the pipeline
      */
-    struct VulkanPipeline : RhiPipeline {
+    struct VulkanPipeline : VulkanPipelineBase {
         RhiGraphicsPipelineState state;
 
-        VulkanPipelineLayoutInfo layout;
+        /*!
+         * \brief The PSO from `RenderDevice::compile_pipeline`, if the pipeline was compiled ahead of time
+         */
+        vk::Pipeline compiled_pipeline = VK_NULL_HANDLE;
+
+        /*!
+         * \brief The renderpass that `compiled_pipeline` was compiled for. `compiled_pipeline` may only be used in this renderpass
+         *
+         * This points at our renderpass rather than holding its vk::RenderPass, because passes that use dynamic rendering don't have one
+         */
+        const VulkanRenderpass* compiled_renderpass = nullptr;
+
+        uint32_t compiled_subpass = 0;
+    };
+
+    /*!
+     * \brief A compute pipeline. These don't depend on anything besides their shader, so they're compiled as soon as they're created
+     */
+    struct VulkanComputePipeline : VulkanPipelineBase {
+        vk::Pipeline pipeline = VK_NULL_HANDLE;
     };
 
     struct VulkanRenderpass : RhiRenderpass {
+        /*!
+         * \brief The Vulkan renderpass. Null if this pass uses dynamic rendering
+         */
         vk::RenderPass pass = VK_NULL_HANDLE;
         vk::Rect2D render_area{};
 
         /*!
-         * \brief Cache of pipelines that get used in this renderpass
+         * \brief True if this pass begins with vkCmdBeginRenderingKHR instead of a vk::RenderPass
+         *
+         * Merged renderpasses have more than one subpass, which dynamic rendering can't express, so they always have a vk::RenderPass
+         */
+        bool uses_dynamic_rendering = false;
+
+        /*!
+         * \brief Formats and load and store ops of the color attachments, for dynamic rendering
+         */
+        std::vector<vk::AttachmentDescription> color_attachments;
+
+        std::optional<vk::AttachmentDescription> depth_attachment;
+
+        /*!
+         * \brief How many samples every attachment of this pass has. Pipelines rasterize with this many
+         */
+        vk::SampleCountFlagBits num_samples = vk::SampleCountFlagBits::e1;
+
+        /*!
+         * \brief Whether the pass resolves its multisampled depth attachment. Only dynamic rendering passes can, because a
+         * vk::RenderPass would need vkCreateRenderPass2 for it
+         */
+        bool resolves_depth = false;
+
+        /*!
+         * \brief Which views this pass renders with multiview, one bit per view. Zero if it only renders one view
+         */
+        uint32_t view_mask = 0;
+
+        /*!
+         * \brief The fragment size of every pipeline in this pass, if it doesn't shade every pixel
+         */
+        std::optional<vk::Extent2D> fragment_size;
+
+        /*!
+         * \brief The size of each texel of the shading rate attachment, if this pass has one. Only dynamic rendering passes do. The
+         * attachment's view is `VulkanFramebuffer::shading_rate_view`
+         */
+        std::optional<vk::Extent2D> shading_rate_texel_size;
+
+        /*!
+         * \brief Cache of pipelines that get used in each subpass of this renderpass
          *
          * We keep a cache of PSOs that are used by this renderpass, using the frontend name of the pipeline state as a key. If we've
          * already used a pipeline state with this renderpass we just get the caches PSO, otherwise we have to create it
+         *
+         * Each subpass has its own cache, so that the secondary command lists of different subpasses can be recorded at the same time
          */
-        std::unordered_map<std::string, vk::Pipeline> cached_pipelines;
+        std::vector<std::unordered_map<std::string, vk::Pipeline>> cached_pipelines;
     };
 
     struct VulkanFramebuffer : RhiFramebuffer {
+        /*!
+         * \brief The Vulkan framebuffer. Null if the framebuffer is for a pass that uses dynamic rendering
+         */
         vk::Framebuffer framebuffer = VK_NULL_HANDLE;
+
+        /*!
+         * \brief The views of the color attachments, then the depth attachment if there is one. Dynamic rendering binds these directly
+         */
+        std::vector<vk::ImageView> attachment_views;
+
+        /*!
+         * \brief The view that each of `attachment_views` resolves into, or null if that attachment isn't resolved. Only dynamic
+         * rendering framebuffers have these - a vk::Framebuffer has its resolve attachments after the depth attachment
+         */
+        std::vector<vk::ImageView> resolve_views;
+
+        /*!
+         * \brief Barriers that move the multisampled attachments into their attachment layouts. Their old samples don't matter, so
+         * every dynamic rendering pass starts them from the undefined layout, the same as a vk::RenderPass does
+         */
+        std::vector<vk::ImageMemoryBarrier> multisampled_barriers;
+
+        /*!
+         * \brief The view of the shading rate attachment, for passes that have one
+         */
+        vk::ImageView shading_rate_view = VK_NULL_HANDLE;
     };
 
     struct VulkanPipelineInterface : RhiPipelineInterface {
@@ -99,6 +268,10 @@ namespace nova::renderer::rhi {
         vk::Fence fence;
     };
 
+    struct VulkanQueryPool : RhiQueryPool {
+        vk::QueryPool pool;
+    };
+
     struct VulkanGpuInfo {
         vk::PhysicalDevice phys_device{};
         std::vector<vk::QueueFamilyProperties> queue_family_props;
@@ -1,5 +1,8 @@
 #include "vulkan_command_list.hpp"
 
+#include <algorithm>
+#include <array>
+
 #include <Tracy.hpp>
 #include <rx/core/log.h>
 #include <string.h>
@@ -30,14 +33,32 @@ namespace nova::renderer::rhi {
 
     VulkanRenderCommandList::VulkanRenderCommandList(vk::CommandBuffer cmds,
                                                      VulkanRenderDevice& render_device,
-                                                     rx::memory::allocator& allocator)
-        : cmds(cmds), device(render_device), allocator(allocator), descriptor_sets{&allocator} {
-        ZoneScoped;        // TODO: Put this begin info in the constructor parameters
+                                                     rx::memory::allocator& allocator,
+                                                     VulkanCommandPool& pool)
+        : cmds(cmds), pool(pool), device(render_device), allocator(allocator) {}
+
+    void VulkanRenderCommandList::begin(VulkanRenderpass* renderpass,
+                                        const vk::CommandBufferInheritanceInfo* inheritance_info,
+                                        const bool is_reusable) {
+        ZoneScoped;
+        current_render_pass = renderpass;
+        current_subpass = inheritance_info != nullptr ? inheritance_info->subpass : 0;
+        draw_constants = {};
+        stats = {};
+        forget_bound_state();
+
         vk::CommandBufferBeginInfo begin_info = {};
         begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        begin_info.flags = is_reusable ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if(inheritance_info != nullptr) {
+            // Secondary command lists record the inside of a renderpass that a primary command list begins
+            begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            begin_info.pInheritanceInfo = inheritance_info;
+        }
 
         vkBeginCommandBuffer(cmds, &begin_info);
+        is_recording = true;
     }
 
     void VulkanRenderCommandList::set_debug_name(const std::string& name) {
@@ -50,135 +71,53 @@ namespace nova::renderer::rhi {
         device.vkSetDebugUtilsObjectNameEXT(device.device, &vk_name);
     }
 
-    void VulkanRenderCommandList::bind_material_resources(RhiBuffer* camera_buffer,
-                                                          RhiBuffer* material_buffer,
-                                                          RhiSampler* point_sampler,
-                                                          RhiSampler* bilinear_sampler,
-                                                          RhiSampler* trilinear_sampler,
-                                                          const std::vector<RhiImage*>& textures,
-                                                          rx::memory::allocator& allocator) {
-        const auto set = device.get_next_standard_descriptor_set();
-
-        const auto* vk_camera_buffer = static_cast<VulkanBuffer*>(camera_buffer);
-        const auto camera_buffer_write = vk::DescriptorBufferInfo()
-                                             .setOffset(0)
-                                             .setRange(vk_camera_buffer->size.b_count())
-                                             .setBuffer(vk_camera_buffer->buffer);
-        const auto camera_buffer_descriptor_type = vk_camera_buffer->size < device.gpu.props.limits.maxUniformBufferRange ?
-                                                       vk::DescriptorType::eUniformBuffer :
-                                                       vk::DescriptorType::eStorageBuffer;
-
-        const auto* vk_material_buffer = static_cast<VulkanBuffer*>(material_buffer);
-        const auto material_buffer_write = vk::DescriptorBufferInfo()
-                                               .setOffset(0)
-                                               .setRange(material_buffer->size.b_count())
-                                               .setBuffer(vk_material_buffer->buffer);
-        const auto material_buffer_descriptor_type = material_buffer->size < device.gpu.props.limits.maxUniformBufferRange ?
-                                                         vk::DescriptorType::eUniformBuffer :
-                                                         vk::DescriptorType::eStorageBuffer;
-
-        const auto* vk_point_sampler = static_cast<VulkanSampler*>(point_sampler);
-        const auto point_sampler_write = vk::DescriptorImageInfo().setSampler(vk_point_sampler->sampler);
-
-        const auto* vk_bilinear_sampler = static_cast<VulkanSampler*>(bilinear_sampler);
-        const auto bilinear_sampler_write = vk::DescriptorImageInfo().setSampler(vk_bilinear_sampler->sampler);
-
-        const auto* vk_trilinear_sampler = static_cast<VulkanSampler*>(trilinear_sampler);
-        const auto trilinear_sampler_write = vk::DescriptorImageInfo().setSampler(vk_trilinear_sampler->sampler);
-
-        std::vector<vk::DescriptorImageInfo> vk_textures{&allocator};
-        vk_textures.reserve(textures.size());
-
-        textures.each_fwd([&](const RhiImage* image) {
-            const auto* vk_image = static_cast<const VulkanImage*>(image);
-            vk_textures.emplace_back(
-                vk::DescriptorImageInfo().setImageView(vk_image->image_view).setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal));
-        });
-
-        const auto writes = std::array{
-            vk::WriteDescriptorSet()
-                .setDstSet(set)
-                .setDstBinding(0)
-                .setDstArrayElement(0)
-                .setDescriptorCount(1)
-                .setDescriptorType(camera_buffer_descriptor_type)
-                .setPBufferInfo(&camera_buffer_write),
-            vk::WriteDescriptorSet()
-                .setDstSet(set)
-                .setDstBinding(1)
-                .setDstArrayElement(0)
-                .setDescriptorCount(1)
-                .setDescriptorType(material_buffer_descriptor_type)
-                .setPBufferInfo(&material_buffer_write),
-            vk::WriteDescriptorSet()
-                .setDstSet(set)
-                .setDstBinding(2)
-                .setDstArrayElement(0)
-                .setDescriptorCount(1)
-                .setDescriptorType(vk::DescriptorType::eSampler)
-                .setPImageInfo(&point_sampler_write),
-            vk::WriteDescriptorSet()
-                .setDstSet(set)
-                .setDstBinding(3)
-                .setDstArrayElement(0)
-                .setDescriptorCount(1)
-                .setDescriptorType(vk::DescriptorType::eSampler)
-                .setPImageInfo(&bilinear_sampler_write),
-            vk::WriteDescriptorSet()
-                .setDstSet(set)
-                .setDstBinding(4)
-                .setDstArrayElement(0)
-                .setDescriptorCount(1)
-                .setDescriptorType(vk::DescriptorType::eSampler)
-                .setPImageInfo(&trilinear_sampler_write),
-            vk::WriteDescriptorSet()
-                .setDstSet(set)
-                .setDstBinding(5)
-                .setDstArrayElement(0)
-                .setDescriptorCount(static_cast<uint32_t>(vk_textures.size()))
-                .setDescriptorType(vk::DescriptorType::eSampledImage)
-                .setPImageInfo(vk_textures.data()),
-        };
+    void VulkanRenderCommandList::bind_material_resources(const uint32_t frame_idx) {
+        const auto set = device.get_standard_descriptor_set(frame_idx);
 
-        device.device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        bind_graphics_descriptor_sets(device.standard_pipeline_layout, 0, 1, reinterpret_cast<const vk::DescriptorSet*>(&set));
+    }
 
-        vkCmdBindDescriptorSets(cmds,
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                device.standard_pipeline_layout,
-                                0,
-                                1,
-                                reinterpret_cast<const vk::DescriptorSet*>(&set),
-                                0,
-                                nullptr);
+    void VulkanRenderCommandList::bind_resources(RhiResourceBinder& binder, const uint32_t frame_idx) {
+        auto& vk_binder = static_cast<VulkanResourceBinder&>(binder);
+        const auto& sets = vk_binder.get_sets(frame_idx);
+        const auto& layout = vk_binder.get_layout();
 
-        descriptor_sets.emplace_back(set);
+        bind_graphics_descriptor_sets(layout,
+                                      0,
+                                      static_cast<uint32_t>(sets.size()),
+                                      reinterpret_cast<const vk::DescriptorSet*>(sets.data()));
     }
 
-    void VulkanRenderCommandList::bind_resources(RhiResourceBinder& binder) {
+    void VulkanRenderCommandList::bind_compute_resources(RhiResourceBinder& binder, const uint32_t frame_idx) {
         auto& vk_binder = static_cast<VulkanResourceBinder&>(binder);
-        const auto& sets = vk_binder.get_sets();
+        const auto& sets = vk_binder.get_sets(frame_idx);
         const auto& layout = vk_binder.get_layout();
 
         vkCmdBindDescriptorSets(cmds,
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
                                 layout,
                                 0,
                                 static_cast<uint32_t>(sets.size()),
                                 reinterpret_cast<const vk::DescriptorSet*>(sets.data()),
                                 0,
                                 nullptr);
+
+        stats.descriptor_set_binds += sets.size();
     }
 
     void VulkanRenderCommandList::resource_barriers(const PipelineStage stages_before_barrier,
                                                     const PipelineStage stages_after_barrier,
-                                                    const std::vector<RhiResourceBarrier>& barriers) {
-        ZoneScoped;        std::vector<vk::BufferMemoryBarrier> buffer_barriers{&allocator};
+                                                    const std::span<const RhiResourceBarrier> barriers) {
+        ZoneScoped;
+        VulkanScratchMemory<4096> scratch;
+
+        std::pmr::vector<vk::BufferMemoryBarrier> buffer_barriers{&scratch.resource};
         buffer_barriers.reserve(barriers.size());
 
-        std::vector<vk::ImageMemoryBarrier> image_barriers{&allocator};
+        std::pmr::vector<vk::ImageMemoryBarrier> image_barriers{&scratch.resource};
         image_barriers.reserve(barriers.size());
 
-        barriers.each_fwd([&](const RhiResourceBarrier& barrier) {
+        for(const RhiResourceBarrier& barrier : barriers) {
             switch(barrier.resource_to_barrier->type) {
                 case ResourceType::Image: {
                     const auto* image = static_cast<VulkanImage*>(barrier.resource_to_barrier);
@@ -193,10 +132,12 @@ namespace nova::renderer::rhi {
                     image_barrier.dstQueueFamilyIndex = device.get_queue_family_index(barrier.destination_queue);
                     image_barrier.image = image->image;
                     image_barrier.subresourceRange.aspectMask = static_cast<vk::ImageAspectFlags>(barrier.image_memory_barrier.aspect);
-                    image_barrier.subresourceRange.baseMipLevel = 0; // TODO: Something smarter with mips
-                    image_barrier.subresourceRange.levelCount = 1;
+                    image_barrier.subresourceRange.baseMipLevel = barrier.image_memory_barrier.first_mip;
+                    image_barrier.subresourceRange.levelCount = barrier.image_memory_barrier.num_mips > 0 ?
+                                                                    barrier.image_memory_barrier.num_mips :
+                                                                    VK_REMAINING_MIP_LEVELS;
                     image_barrier.subresourceRange.baseArrayLayer = 0;
-                    image_barrier.subresourceRange.layerCount = 1;
+                    image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
                     image_barriers.push_back(image_barrier);
                 } break;
@@ -217,7 +158,7 @@ namespace nova::renderer::rhi {
                     buffer_barriers.push_back(buffer_barrier);
                 } break;
             }
-        });
+        }
 
         vkCmdPipelineBarrier(cmds,
                              static_cast<vk::PipelineStageFlags>(stages_before_barrier),
@@ -229,6 +170,8 @@ namespace nova::renderer::rhi {
                              buffer_barriers.data(),
                              static_cast<uint32_t>(image_barriers.size()),
                              image_barriers.data());
+
+        stats.barriers += barriers.size();
     }
 
     void VulkanRenderCommandList::copy_buffer(RhiBuffer* destination_buffer,
@@ -245,6 +188,219 @@ namespace nova::renderer::rhi {
 
         // TODO: fix the crash on this line
         vkCmdCopyBuffer(cmds, vk_source_buffer->buffer, vk_destination_buffer->buffer, 1, &copy);
+
+        stats.bytes_uploaded += copy.size;
+    }
+
+    void VulkanRenderCommandList::copy_buffer_to_image(RhiImage* image,
+                                                       const uint32_t mip_level,
+                                                       const uint32_t x,
+                                                       const uint32_t y,
+                                                       const uint32_t width,
+                                                       const uint32_t height,
+                                                       RhiBuffer* source_buffer,
+                                                       const mem::Bytes source_offset) {
+        ZoneScoped;
+        auto* vk_image = static_cast<VulkanImage*>(image);
+        auto* vk_buffer = static_cast<VulkanBuffer*>(source_buffer);
+
+        vk::BufferImageCopy image_copy{};
+        image_copy.bufferOffset = source_offset.b_count();
+        image_copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        image_copy.imageSubresource.mipLevel = mip_level;
+        image_copy.imageSubresource.layerCount = 1;
+        image_copy.imageOffset = {static_cast<int32_t>(x), static_cast<int32_t>(y), 0};
+        image_copy.imageExtent = {width, height, 1};
+
+        vkCmdCopyBufferToImage(cmds, vk_buffer->buffer, vk_image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_copy);
+    }
+
+    void VulkanRenderCommandList::copy_image_to_buffer(RhiBuffer* destination_buffer,
+                                                       const mem::Bytes destination_offset,
+                                                       RhiImage* image,
+                                                       const uint32_t mip_level,
+                                                       const uint32_t x,
+                                                       const uint32_t y,
+                                                       const uint32_t width,
+                                                       const uint32_t height) {
+        ZoneScoped;
+        auto* vk_image = static_cast<VulkanImage*>(image);
+        auto* vk_buffer = static_cast<VulkanBuffer*>(destination_buffer);
+
+        vk::BufferImageCopy image_copy{};
+        image_copy.bufferOffset = destination_offset.b_count();
+        image_copy.imageSubresource.aspectMask = vk_image->is_depth_tex ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        image_copy.imageSubresource.mipLevel = mip_level;
+        image_copy.imageSubresource.layerCount = 1;
+        image_copy.imageOffset = {static_cast<int32_t>(x), static_cast<int32_t>(y), 0};
+        image_copy.imageExtent = {width, height, 1};
+
+        vkCmdCopyImageToBuffer(cmds, vk_image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, vk_buffer->buffer, 1, &image_copy);
+    }
+
+    void VulkanRenderCommandList::blit_image(RhiImage* source,
+                                             const uint32_t source_layer,
+                                             const uint32_t source_width,
+                                             const uint32_t source_height,
+                                             RhiImage* destination,
+                                             const uint32_t destination_width,
+                                             const uint32_t destination_height) {
+        ZoneScoped;
+        const auto* vk_source = static_cast<VulkanImage*>(source);
+        const auto* vk_destination = static_cast<VulkanImage*>(destination);
+
+        vk::ImageBlit blit = {};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.baseArrayLayer = source_layer;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1] = vk::Offset3D{static_cast<int32_t>(source_width), static_cast<int32_t>(source_height), 1};
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.layerCount = 1;
+        blit.dstOffsets[1] = vk::Offset3D{static_cast<int32_t>(destination_width), static_cast<int32_t>(destination_height), 1};
+
+        vkCmdBlitImage(cmds,
+                       vk_source->image,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       vk_destination->image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1,
+                       &blit,
+                       VK_FILTER_LINEAR);
+    }
+
+    void VulkanRenderCommandList::generate_mips(RhiImage* image,
+                                                const uint32_t source_mip,
+                                                const uint32_t source_width,
+                                                const uint32_t source_height,
+                                                const uint32_t num_mips) {
+        ZoneScoped;
+        auto* vk_image = static_cast<VulkanImage*>(image);
+        if(num_mips == 0) {
+            return;
+        }
+
+        vk::FormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(device.gpu.phys_device, vk_image->format, &format_properties);
+        constexpr vk::FormatFeatureFlags needed_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                           VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if((format_properties.optimalTilingFeatures & needed_features) != needed_features) {
+            logger->error("Can't generate mips for an image whose format can't be blitted with linear filtering");
+            return;
+        }
+
+        const auto make_barrier = [&](const uint32_t first_mip,
+                                      const uint32_t mip_count,
+                                      const vk::ImageLayout old_layout,
+                                      const vk::ImageLayout new_layout,
+                                      const vk::AccessFlags src_access,
+                                      const vk::AccessFlags dst_access) {
+            vk::ImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = src_access;
+            barrier.dstAccessMask = dst_access;
+            barrier.oldLayout = old_layout;
+            barrier.newLayout = new_layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = vk_image->image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = first_mip;
+            barrier.subresourceRange.levelCount = mip_count;
+            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+            return barrier;
+        };
+
+        // The generated mips' old contents don't matter, so they start out undefined
+        const std::array start_barriers{make_barrier(source_mip,
+                                                     1,
+                                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                     VK_ACCESS_MEMORY_WRITE_BIT,
+                                                     VK_ACCESS_TRANSFER_READ_BIT),
+                                        make_barrier(source_mip + 1,
+                                                     num_mips,
+                                                     VK_IMAGE_LAYOUT_UNDEFINED,
+                                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                     0,
+                                                     VK_ACCESS_TRANSFER_WRITE_BIT)};
+        vkCmdPipelineBarrier(cmds,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             static_cast<uint32_t>(start_barriers.size()),
+                             start_barriers.data());
+
+        auto width = static_cast<int32_t>(source_width);
+        auto height = static_cast<int32_t>(source_height);
+        for(uint32_t mip = source_mip + 1; mip <= source_mip + num_mips; mip++) {
+            const auto mip_width = std::max(width / 2, 1);
+            const auto mip_height = std::max(height / 2, 1);
+
+            vk::ImageBlit blit = {};
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = mip - 1;
+            blit.srcSubresource.layerCount = 1;
+            blit.srcOffsets[1] = vk::Offset3D{width, height, 1};
+            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.dstSubresource.mipLevel = mip;
+            blit.dstSubresource.layerCount = 1;
+            blit.dstOffsets[1] = vk::Offset3D{mip_width, mip_height, 1};
+
+            vkCmdBlitImage(cmds,
+                           vk_image->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           vk_image->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1,
+                           &blit,
+                           VK_FILTER_LINEAR);
+
+            // The next blit reads from the mip we just wrote
+            const auto next_source_barrier = make_barrier(mip,
+                                                          1,
+                                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                          VK_ACCESS_TRANSFER_READ_BIT);
+            vkCmdPipelineBarrier(cmds,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 1,
+                                 &next_source_barrier);
+
+            width = mip_width;
+            height = mip_height;
+        }
+
+        const auto end_barrier = make_barrier(source_mip,
+                                              num_mips + 1,
+                                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                                              VK_ACCESS_SHADER_READ_BIT);
+        vkCmdPipelineBarrier(cmds,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &end_barrier);
+
+        stats.barriers += num_mips + 2;
     }
 
     void VulkanRenderCommandList::execute_command_lists(const std::vector<RhiRenderCommandList*>& lists) {
@@ -253,23 +409,45 @@ namespace nova::renderer::rhi {
 
         lists.each_fwd([&](RhiRenderCommandList* list) {
             auto* vk_list = dynamic_cast<VulkanRenderCommandList*>(list);
+            if(vk_list->is_recording) {
+                vkEndCommandBuffer(vk_list->cmds);
+                vk_list->is_recording = false;
+            }
             buffers.push_back(vk_list->cmds);
+
+            stats += vk_list->stats;
         });
 
         vkCmdExecuteCommands(cmds, static_cast<uint32_t>(buffers.size()), buffers.data());
+
+        forget_bound_state();
     }
 
     void VulkanRenderCommandList::set_camera(const Camera& camera) {
-        ZoneScoped;        camera_index = camera.index;
+        ZoneScoped;
+        set_camera_index(camera.index);
+    }
 
-        vkCmdPushConstants(cmds, device.standard_pipeline_layout, VK_SHADER_STAGE_ALL, 0, sizeof(uint32_t), &camera_index);
+    void VulkanRenderCommandList::set_camera_index(const uint32_t index) {
+        auto constants = draw_constants;
+        constants.camera_index = index;
+        set_draw_constants(constants);
     }
 
-    void VulkanRenderCommandList::begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer) {
+    void VulkanRenderCommandList::begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer, const RenderpassContents contents) {
         ZoneScoped;        auto* vk_renderpass = static_cast<VulkanRenderpass*>(renderpass);
         auto* vk_framebuffer = static_cast<VulkanFramebuffer*>(framebuffer);
 
         current_render_pass = vk_renderpass;
+        current_subpass = 0;
+
+        // Pipelines are compiled for a specific renderpass, so whatever was bound before can't be used in this one
+        bound_pipeline = VK_NULL_HANDLE;
+
+        if(vk_renderpass->uses_dynamic_rendering) {
+            begin_rendering(*vk_renderpass, *vk_framebuffer, contents);
+            return;
+        }
 
         std::vector<vk::ClearValue> clear_values{&allocator, vk_framebuffer->num_attachments};
 
@@ -281,17 +459,124 @@ namespace nova::renderer::rhi {
         begin_info.clearValueCount = vk_framebuffer->num_attachments;
         begin_info.pClearValues = clear_values.data();
 
-        vkCmdBeginRenderPass(cmds, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        const auto subpass_contents = contents == RenderpassContents::SecondaryCommandLists ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS :
+                                                                                              VK_SUBPASS_CONTENTS_INLINE;
+
+        // Set before the renderpass begins, because a renderpass that runs secondary command lists may only execute them
+        set_viewport_to_framebuffer(framebuffer->size);
+
+        vkCmdBeginRenderPass(cmds, &begin_info, subpass_contents);
+    }
+
+    void VulkanRenderCommandList::begin_rendering(const VulkanRenderpass& renderpass,
+                                                  const VulkanFramebuffer& framebuffer,
+                                                  const RenderpassContents contents) {
+        std::vector<vk::RenderingAttachmentInfoKHR> color_attachments{&allocator};
+        color_attachments.reserve(renderpass.color_attachments.size());
+        for(uint32_t i = 0; i < renderpass.color_attachments.size(); i++) {
+            const auto& attachment = renderpass.color_attachments[i];
+            auto& attachment_info = color_attachments.emplace_back(vk::RenderingAttachmentInfoKHR()
+                                                                       .setImageView(framebuffer.attachment_views[i])
+                                                                       .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                                                                       .setLoadOp(attachment.loadOp)
+                                                                       .setStoreOp(attachment.storeOp));
+            if(framebuffer.resolve_views[i] != VK_NULL_HANDLE) {
+                attachment_info.setResolveMode(vk::ResolveModeFlagBits::eAverage)
+                    .setResolveImageView(framebuffer.resolve_views[i])
+                    .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal);
+            }
+        }
+
+        // The depth view comes after the color views, same as in a vk::Framebuffer
+        auto depth_attachment = vk::RenderingAttachmentInfoKHR();
+        if(renderpass.depth_attachment) {
+            depth_attachment.setImageView(framebuffer.attachment_views.back())
+                .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                .setLoadOp(renderpass.depth_attachment->loadOp)
+                .setStoreOp(renderpass.depth_attachment->storeOp);
+
+            // Averaging depth doesn't mean anything, and every GPU that can resolve depth can take the first sample
+            if(framebuffer.resolve_views.back() != VK_NULL_HANDLE) {
+                depth_attachment.setResolveMode(vk::ResolveModeFlagBits::eSampleZero)
+                    .setResolveImageView(framebuffer.resolve_views.back())
+                    .setResolveImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+            }
+        }
+
+        auto rendering_info = vk::RenderingInfoKHR()
+                                  .setRenderArea({{0, 0}, {framebuffer.size.x, framebuffer.size.y}})
+                                  .setLayerCount(1)
+                                  .setViewMask(renderpass.view_mask)
+                                  .setColorAttachmentCount(static_cast<uint32_t>(color_attachments.size()))
+                                  .setPColorAttachments(color_attachments.data())
+                                  .setPDepthAttachment(renderpass.depth_attachment ? &depth_attachment : nullptr);
+        if(contents == RenderpassContents::SecondaryCommandLists) {
+            rendering_info.setFlags(vk::RenderingFlagBitsKHR::eContentsSecondaryCommandBuffers);
+        }
+
+        // Without a view, the pipelines' combiners just see a rate of 1x1 from the attachment
+        auto shading_rate_attachment = vk::RenderingFragmentShadingRateAttachmentInfoKHR();
+        if(renderpass.shading_rate_texel_size) {
+            shading_rate_attachment.setImageView(framebuffer.shading_rate_view)
+                .setImageLayout(vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR)
+                .setShadingRateAttachmentTexelSize(*renderpass.shading_rate_texel_size);
+            rendering_info.setPNext(&shading_rate_attachment);
+        }
+
+        set_viewport_to_framebuffer(framebuffer.size);
+
+        if(!framebuffer.multisampled_barriers.empty()) {
+            vkCmdPipelineBarrier(cmds,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 static_cast<uint32_t>(framebuffer.multisampled_barriers.size()),
+                                 framebuffer.multisampled_barriers.data());
+        }
+
+        device.vkCmdBeginRenderingKHR(cmds, reinterpret_cast<const VkRenderingInfoKHR*>(&rendering_info));
+    }
+
+    void VulkanRenderCommandList::next_subpass(const RenderpassContents contents) {
+        ZoneScoped;
+        current_subpass++;
+
+        // Pipelines are compiled for a specific subpass too
+        bound_pipeline = VK_NULL_HANDLE;
+
+        const auto subpass_contents = contents == RenderpassContents::SecondaryCommandLists ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS :
+                                                                                              VK_SUBPASS_CONTENTS_INLINE;
+        vkCmdNextSubpass(cmds, subpass_contents);
     }
 
     void VulkanRenderCommandList::end_renderpass() {
-        ZoneScoped;        vkCmdEndRenderPass(cmds);
+        ZoneScoped;
+        if(current_render_pass != nullptr && current_render_pass->uses_dynamic_rendering) {
+            device.vkCmdEndRenderingKHR(cmds);
+
+        } else {
+            vkCmdEndRenderPass(cmds);
+        }
 
         current_render_pass = nullptr;
     }
 
-    void VulkanRenderCommandList::set_material_index(uint32_t index) {
-        vkCmdPushConstants(cmds, device.standard_pipeline_layout, VK_SHADER_STAGE_ALL, sizeof(uint32_t), sizeof(uint32_t), &index);
+    void VulkanRenderCommandList::set_material_index(const uint32_t index) {
+        auto constants = draw_constants;
+        constants.material_index = index;
+        set_draw_constants(constants);
+    }
+
+    void VulkanRenderCommandList::set_draw_constants(const RhiDrawConstants& constants) {
+        if(constants != draw_constants) {
+            draw_constants = constants;
+            draw_constants_dirty = true;
+        }
     }
 
     void VulkanRenderCommandList::set_pipeline(const RhiPipeline& state) {
@@ -299,11 +584,22 @@ namespace nova::renderer::rhi {
         const auto& vk_pipeline = static_cast<const VulkanPipeline&>(state);
 
         if(current_render_pass != nullptr) {
-            auto* pipeline = current_render_pass->cached_pipelines.find(vk_pipeline.state.name);
+            if(vk_pipeline.compiled_pipeline && vk_pipeline.compiled_renderpass == current_render_pass &&
+               vk_pipeline.compiled_subpass == current_subpass) {
+                if(vk_pipeline.compiled_pipeline != bound_pipeline) {
+                    vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline.compiled_pipeline);
+                    bound_pipeline = vk_pipeline.compiled_pipeline;
+                    stats.pipeline_binds++;
+                }
+                return;
+            }
+
+            auto& cached_pipelines = current_render_pass->cached_pipelines[current_subpass];
+            auto* pipeline = cached_pipelines.find(vk_pipeline.state.name);
             if(pipeline == nullptr) {
-                const auto pipeline_result = device.compile_pipeline_state(vk_pipeline, *current_render_pass, allocator);
+                const auto pipeline_result = device.compile_pipeline_state(vk_pipeline, *current_render_pass, current_subpass, allocator);
                 if(pipeline_result) {
-                    pipeline = current_render_pass->cached_pipelines.insert(vk_pipeline.state.name, *pipeline_result);
+                    pipeline = cached_pipelines.insert(vk_pipeline.state.name, *pipeline_result);
 
                 } else {
                     logger->error("Could not compile pipeline %s", vk_pipeline.state.name);
@@ -311,8 +607,10 @@ namespace nova::renderer::rhi {
                 }
             }
 
-            if(pipeline != nullptr) {
-                vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, static_cast<vk::Pipeline>(*pipeline));
+            if(pipeline != nullptr && static_cast<vk::Pipeline>(*pipeline) != bound_pipeline) {
+                bound_pipeline = static_cast<vk::Pipeline>(*pipeline);
+                vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_pipeline);
+                stats.pipeline_binds++;
             }
 
         } else {
@@ -324,18 +622,13 @@ namespace nova::renderer::rhi {
                                                        const RhiPipelineInterface* pipeline_interface) {
         ZoneScoped;        const auto* vk_interface = static_cast<const VulkanPipelineInterface*>(pipeline_interface);
 
-        for(uint32_t i = 0; i < descriptor_sets.size(); i++) {
-            const auto* vk_set = static_cast<const VulkanDescriptorSet*>(descriptor_sets[i]);
-
-            vkCmdBindDescriptorSets(cmds,
-                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    device.standard_pipeline_layout,
-                                    i,
-                                    1,
-                                    &vk_set->descriptor_set,
-                                    0,
-                                    nullptr);
+        std::vector<vk::DescriptorSet> vk_sets;
+        vk_sets.reserve(descriptor_sets.size());
+        for(const RhiDescriptorSet* set : descriptor_sets) {
+            vk_sets.push_back(static_cast<const VulkanDescriptorSet*>(set)->descriptor_set);
         }
+
+        bind_graphics_descriptor_sets(device.standard_pipeline_layout, 0, static_cast<uint32_t>(vk_sets.size()), vk_sets.data());
     }
 
     void VulkanRenderCommandList::bind_vertex_buffers(const std::vector<RhiBuffer*>& buffers) {
@@ -350,17 +643,120 @@ namespace nova::renderer::rhi {
             vk_buffers.push_back(vk_buffer->buffer);
         }
 
+        if(vk_buffers == bound_vertex_buffers) {
+            return;
+        }
+
         vkCmdBindVertexBuffers(cmds, 0, static_cast<uint32_t>(vk_buffers.size()), vk_buffers.data(), offsets.data());
+        stats.buffer_binds += vk_buffers.size();
+
+        bound_vertex_buffers = vk_buffers;
     }
 
     void VulkanRenderCommandList::bind_index_buffer(const RhiBuffer* buffer, const IndexType index_type) {
         ZoneScoped;        const auto* vk_buffer = static_cast<const VulkanBuffer*>(buffer);
+        const auto vk_index_type = to_vk_index_type(index_type);
+
+        if(vk_buffer->buffer == bound_index_buffer && vk_index_type == bound_index_type) {
+            return;
+        }
+
+        vkCmdBindIndexBuffer(cmds, vk_buffer->buffer, 0, vk_index_type);
+        stats.buffer_binds++;
+
+        bound_index_buffer = vk_buffer->buffer;
+        bound_index_type = vk_index_type;
+    }
+
+    void VulkanRenderCommandList::draw_indexed_mesh(const uint32_t num_indices,
+                                                    const uint32_t offset,
+                                                    const uint32_t num_instances,
+                                                    const int32_t vertex_offset) {
+        ZoneScoped;
+        flush_draw_constants();
+        vkCmdDrawIndexed(cmds, num_indices, num_instances, offset, vertex_offset, 0);
+
+        // Every pipeline Nova makes draws triangle lists
+        stats.draw_calls++;
+        stats.instances += num_instances;
+        stats.triangles += static_cast<uint64_t>(num_indices / 3) * num_instances;
+    }
+
+    static_assert(sizeof(RhiDrawIndexedIndirectCommand) == sizeof(VkDrawIndexedIndirectCommand),
+                  "RhiDrawIndexedIndirectCommand must match VkDrawIndexedIndirectCommand");
+
+    void VulkanRenderCommandList::draw_indexed_indirect(const RhiBuffer* draw_commands,
+                                                        const uint64_t draw_commands_offset,
+                                                        const uint32_t max_draw_count,
+                                                        const RhiBuffer* draw_count_buffer,
+                                                        const uint64_t draw_count_offset) {
+        ZoneScoped;
+        flush_draw_constants();
+        const auto* vk_commands = static_cast<const VulkanBuffer*>(draw_commands);
+
+        if(draw_count_buffer != nullptr) {
+            const auto* vk_count_buffer = static_cast<const VulkanBuffer*>(draw_count_buffer);
+            vkCmdDrawIndexedIndirectCount(cmds,
+                                          vk_commands->buffer,
+                                          draw_commands_offset,
+                                          vk_count_buffer->buffer,
+                                          draw_count_offset,
+                                          max_draw_count,
+                                          sizeof(VkDrawIndexedIndirectCommand));
+
+        } else {
+            vkCmdDrawIndexedIndirect(cmds, vk_commands->buffer, draw_commands_offset, max_draw_count, sizeof(VkDrawIndexedIndirectCommand));
+        }
+
+        stats.indirect_draw_calls++;
+    }
+
+    void VulkanRenderCommandList::set_compute_pipeline(const RhiPipeline& pipeline) {
+        ZoneScoped;
+        const auto& vk_pipeline = static_cast<const VulkanComputePipeline&>(pipeline);
+
+        if(current_render_pass != nullptr) {
+            logger->error("Cannot use compute pipeline %s inside a renderpass", vk_pipeline.name);
+            return;
+        }
+
+        vkCmdBindPipeline(cmds, VK_PIPELINE_BIND_POINT_COMPUTE, vk_pipeline.pipeline);
+        stats.pipeline_binds++;
+    }
+
+    void VulkanRenderCommandList::dispatch(const uint32_t num_groups_x, const uint32_t num_groups_y, const uint32_t num_groups_z) {
+        ZoneScoped;
+        vkCmdDispatch(cmds, num_groups_x, num_groups_y, num_groups_z);
+        stats.dispatches++;
+    }
+
+    void VulkanRenderCommandList::dispatch_indirect(const RhiBuffer* dispatch_buffer, const uint64_t offset) {
+        ZoneScoped;
+        const auto* vk_buffer = static_cast<const VulkanBuffer*>(dispatch_buffer);
+        vkCmdDispatchIndirect(cmds, vk_buffer->buffer, offset);
+        stats.dispatches++;
+    }
+
+    void VulkanRenderCommandList::set_viewport_to_framebuffer(const glm::uvec2& framebuffer_size) {
+        const vk::Viewport viewport{0.0F, 0.0F, static_cast<float>(framebuffer_size.x), static_cast<float>(framebuffer_size.y), 0.0F, 1.0F};
+        vkCmdSetViewport(cmds, 0, 1, &viewport);
 
-        vkCmdBindIndexBuffer(cmds, vk_buffer->buffer, 0, to_vk_index_type(index_type));
+        const vk::Rect2D scissor_rect{{0, 0}, {framebuffer_size.x, framebuffer_size.y}};
+        vkCmdSetScissor(cmds, 0, 1, &scissor_rect);
     }
 
-    void VulkanRenderCommandList::draw_indexed_mesh(const uint32_t num_indices, const uint32_t offset, const uint32_t num_instances) {
-        ZoneScoped;        vkCmdDrawIndexed(cmds, num_indices, num_instances, offset, 0, 0);
+    void VulkanRenderCommandList::set_viewport(const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height) {
+        ZoneScoped;
+        const vk::Viewport viewport{static_cast<float>(x),
+                                    static_cast<float>(y),
+                                    static_cast<float>(width),
+                                    static_cast<float>(height),
+                                    0.0F,
+                                    1.0F};
+        vkCmdSetViewport(cmds, 0, 1, &viewport);
+
+        const vk::Rect2D scissor_rect{{static_cast<int32_t>(x), static_cast<int32_t>(y)}, {width, height}};
+        vkCmdSetScissor(cmds, 0, 1, &scissor_rect);
     }
 
     void VulkanRenderCommandList::set_scissor_rect(const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height) {
@@ -368,18 +764,39 @@ namespace nova::renderer::rhi {
         vkCmdSetScissor(cmds, 0, 1, &scissor_rect);
     }
 
+    void VulkanRenderCommandList::write_timestamp(RhiQueryPool* pool, const uint32_t timestamp_idx, const PipelineStage stage) {
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+        vkCmdWriteTimestamp(cmds, static_cast<VkPipelineStageFlagBits>(stage), vk_pool->pool, timestamp_idx);
+    }
+
+    void VulkanRenderCommandList::begin_query(RhiQueryPool* pool, const uint32_t query_idx) {
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+        vkCmdBeginQuery(cmds, vk_pool->pool, query_idx, 0);
+    }
+
+    void VulkanRenderCommandList::end_query(RhiQueryPool* pool, const uint32_t query_idx) {
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+        vkCmdEndQuery(cmds, vk_pool->pool, query_idx);
+    }
+
+    const RhiCommandListStats& VulkanRenderCommandList::get_stats() const { return stats; }
+
     void VulkanRenderCommandList::upload_data_to_image(RhiImage* image,
                                                        const size_t width,
                                                        const size_t height,
                                                        const size_t bytes_per_pixel,
                                                        RhiBuffer* staging_buffer,
-                                                       const void* data) {
+                                                       const void* data,
+                                                       const uint64_t staging_buffer_offset) {
         ZoneScoped;        auto* vk_image = static_cast<VulkanImage*>(image);
         auto* vk_buffer = static_cast<VulkanBuffer*>(staging_buffer);
 
-        memcpy(vk_buffer->allocation_info.pMappedData, data, width * height * bytes_per_pixel);
+        memcpy(static_cast<uint8_t*>(vk_buffer->allocation_info.pMappedData) + staging_buffer_offset,
+               data,
+               width * height * bytes_per_pixel);
 
         vk::BufferImageCopy image_copy{};
+        image_copy.bufferOffset = staging_buffer_offset;
         if(!vk_image->is_depth_tex) {
             image_copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         } else {
@@ -389,12 +806,65 @@ namespace nova::renderer::rhi {
         image_copy.imageExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
 
         vkCmdCopyBufferToImage(cmds, vk_buffer->buffer, vk_image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_copy);
+
+        stats.bytes_uploaded += width * height * bytes_per_pixel;
     }
 
-    void VulkanRenderCommandList::cleanup_resources() {
-        ZoneScoped;
-        device.return_standard_descriptor_sets(descriptor_sets);
+    void VulkanRenderCommandList::forget_bound_state() {
+        bound_pipeline = VK_NULL_HANDLE;
+        bound_descriptor_layout = VK_NULL_HANDLE;
+        bound_descriptor_sets.clear();
+        bound_vertex_buffers.clear();
+        bound_index_buffer = VK_NULL_HANDLE;
+
+        // Executing secondary command lists leaves the push constants undefined
+        draw_constants_dirty = true;
+    }
+
+    void VulkanRenderCommandList::flush_draw_constants() {
+        if(!draw_constants_dirty) {
+            return;
+        }
+
+        vkCmdPushConstants(cmds, device.standard_pipeline_layout, VK_SHADER_STAGE_ALL, 0, sizeof(RhiDrawConstants), &draw_constants);
+        stats.draw_constant_pushes++;
 
-        descriptor_sets.clear();
+        draw_constants_dirty = false;
+    }
+
+    void VulkanRenderCommandList::bind_graphics_descriptor_sets(const vk::PipelineLayout layout,
+                                                                const uint32_t first_set,
+                                                                const uint32_t num_sets,
+                                                                const vk::DescriptorSet* sets) {
+        if(layout != bound_descriptor_layout) {
+            bound_descriptor_sets.clear();
+            bound_descriptor_layout = layout;
+        }
+
+        uint32_t num_already_bound = 0;
+        while(num_already_bound < num_sets && first_set + num_already_bound < bound_descriptor_sets.size() &&
+              bound_descriptor_sets[first_set + num_already_bound] == sets[num_already_bound]) {
+            num_already_bound++;
+        }
+
+        if(num_already_bound == num_sets) {
+            return;
+        }
+
+        const auto first_changed_set = first_set + num_already_bound;
+        vkCmdBindDescriptorSets(cmds,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                layout,
+                                first_changed_set,
+                                num_sets - num_already_bound,
+                                sets + num_already_bound,
+                                0,
+                                nullptr);
+        stats.descriptor_set_binds += num_sets - num_already_bound;
+
+        if(bound_descriptor_sets.size() < first_set + num_sets) {
+            bound_descriptor_sets.resize(first_set + num_sets, VK_NULL_HANDLE);
+        }
+        std::copy(sets + num_already_bound, sets + num_sets, bound_descriptor_sets.begin() + first_changed_set);
     }
 } // namespace nova::renderer::rhi
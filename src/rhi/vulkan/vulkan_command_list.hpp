@@ -10,6 +10,7 @@
 
 namespace nova::renderer::rhi {
     class VulkanRenderDevice;
+    struct VulkanCommandPool;
 
     /*!
      * \brief Vulkan implementation of `command_list`
@@ -18,24 +19,47 @@ namespace nova::renderer::rhi {
     public:
         vk::CommandBuffer cmds;
 
-        VulkanRenderCommandList(vk::CommandBuffer cmds, VulkanRenderDevice& render_device, rx::memory::allocator& allocator);
+        /*!
+         * \brief The pool that `cmds` came from. Command lists are recycled along with their pool, see `VulkanCommandPool`
+         */
+        VulkanCommandPool& pool;
+
+        /*!
+         * \brief Wraps the provided command buffer. Call `begin` before recording anything
+         */
+        VulkanRenderCommandList(vk::CommandBuffer cmds,
+                                VulkanRenderDevice& render_device,
+                                rx::memory::allocator& allocator,
+                                VulkanCommandPool& pool);
         ~VulkanRenderCommandList() override = default;
 
+        /*!
+         * \brief Begins the command buffer, forgetting anything that was recorded into it the last time it was used
+         *
+         * The command buffer's pool must have been reset since it was last submitted
+         *
+         * \param renderpass The renderpass a secondary command list will execute in. Must be nullptr for primary command lists
+         * \param inheritance_info Renderpass inheritance info for secondary command lists. Must be nullptr for primary command lists
+         * \param is_reusable Whether the command list may be submitted or executed more than once
+         */
+        void begin(VulkanRenderpass* renderpass = nullptr,
+                   const vk::CommandBufferInheritanceInfo* inheritance_info = nullptr,
+                   bool is_reusable = false);
+
+        /*!
+         * \brief Sets the viewport and scissor to cover the whole framebuffer. Every pipeline leaves them dynamic, so something has to
+         */
+        void set_viewport_to_framebuffer(const glm::uvec2& framebuffer_size);
+
         void set_debug_name(const std::string& name) override;
 
-        void bind_material_resources(RhiBuffer* camera_buffer,
-                                     RhiBuffer* material_buffer,
-                                     RhiSampler* point_sampler,
-                                     RhiSampler* bilinear_sampler,
-                                     RhiSampler* trilinear_sampler,
-                                     const std::vector<RhiImage*>& textures,
-                                     rx::memory::allocator& allocator) override;
+        void bind_material_resources(uint32_t frame_idx) override;
 
-        void bind_resources(RhiResourceBinder& binder) override;
+        void bind_resources(RhiResourceBinder& binder, uint32_t frame_idx) override;
 
         void resource_barriers(PipelineStage stages_before_barrier,
                                PipelineStage stages_after_barrier,
-                               const std::vector<RhiResourceBarrier>& barriers) override;
+                               std::span<const RhiResourceBarrier> barriers) override;
 
         void copy_buffer(RhiBuffer* destination_buffer,
                          mem::Bytes destination_offset,
@@ -43,16 +67,50 @@ namespace nova::renderer::rhi {
                          mem::Bytes source_offset,
                          mem::Bytes num_bytes) override;
 
+        void copy_buffer_to_image(RhiImage* image,
+                                  uint32_t mip_level,
+                                  uint32_t x,
+                                  uint32_t y,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  RhiBuffer* source_buffer,
+                                  mem::Bytes source_offset) override;
+
+        void copy_image_to_buffer(RhiBuffer* destination_buffer,
+                                  mem::Bytes destination_offset,
+                                  RhiImage* image,
+                                  uint32_t mip_level,
+                                  uint32_t x,
+                                  uint32_t y,
+                                  uint32_t width,
+                                  uint32_t height) override;
+
+        void blit_image(RhiImage* source,
+                        uint32_t source_layer,
+                        uint32_t source_width,
+                        uint32_t source_height,
+                        RhiImage* destination,
+                        uint32_t destination_width,
+                        uint32_t destination_height) override;
+
+        void generate_mips(RhiImage* image, uint32_t source_mip, uint32_t source_width, uint32_t source_height, uint32_t num_mips) override;
+
         void execute_command_lists(const std::vector<RhiRenderCommandList*>& lists) override;
 
         void set_camera(const Camera& camera) override;
 
-        void begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer) override;
+        void set_camera_index(uint32_t index) override;
+
+        void begin_renderpass(RhiRenderpass* renderpass, RhiFramebuffer* framebuffer, RenderpassContents contents) override;
+
+        void next_subpass(RenderpassContents contents) override;
 
         void end_renderpass() override;
 
         void set_material_index(uint32_t index) override;
 
+        void set_draw_constants(const RhiDrawConstants& constants) override;
+
         void set_pipeline(const RhiPipeline& state) override;
 
         void bind_descriptor_sets(const std::vector<RhiDescriptorSet*>& descriptor_sets,
@@ -62,31 +120,108 @@ namespace nova::renderer::rhi {
 
         void bind_index_buffer(const RhiBuffer* buffer, IndexType index_type) override;
 
-        void draw_indexed_mesh(uint32_t num_indices, uint32_t offset, uint32_t num_instances) override;
+        void draw_indexed_mesh(uint32_t num_indices, uint32_t offset, uint32_t num_instances, int32_t vertex_offset) override;
+
+        void draw_indexed_indirect(const RhiBuffer* draw_commands,
+                                   uint64_t draw_commands_offset,
+                                   uint32_t max_draw_count,
+                                   const RhiBuffer* draw_count_buffer,
+                                   uint64_t draw_count_offset) override;
+
+        void set_compute_pipeline(const RhiPipeline& pipeline) override;
+
+        void bind_compute_resources(RhiResourceBinder& binder, uint32_t frame_idx) override;
+
+        void dispatch(uint32_t num_groups_x, uint32_t num_groups_y, uint32_t num_groups_z) override;
+
+        void dispatch_indirect(const RhiBuffer* dispatch_buffer, uint64_t offset) override;
 
         void set_scissor_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height) override;
 
-        void upload_data_to_image(
-            RhiImage* image, size_t width, size_t height, size_t bytes_per_pixel, RhiBuffer* staging_buffer, const void* data) override;
+        void set_viewport(uint32_t x, uint32_t y, uint32_t width, uint32_t height) override;
+
+        void write_timestamp(RhiQueryPool* pool, uint32_t timestamp_idx, PipelineStage stage) override;
+
+        void begin_query(RhiQueryPool* pool, uint32_t query_idx) override;
+
+        void end_query(RhiQueryPool* pool, uint32_t query_idx) override;
+
+        [[nodiscard]] const RhiCommandListStats& get_stats() const override;
+
+        void upload_data_to_image(RhiImage* image,
+                                  size_t width,
+                                  size_t height,
+                                  size_t bytes_per_pixel,
+                                  RhiBuffer* staging_buffer,
+                                  const void* data,
+                                  uint64_t staging_buffer_offset) override;
 
-    public:
-        /*!
-         * \brief Called by VulkanRenderDevice when this command list has finished execution on the GPU
-         *
-         * This method should free any transient resources that the command lists uses
-         */
-        void cleanup_resources();
     private:
         VulkanRenderDevice& device;
 
         rx::memory::allocator& allocator;
 
-        uint32_t camera_index = 0;
-
         VulkanRenderpass* current_render_pass = nullptr;
 
+        uint32_t current_subpass = 0;
+
         vk::PipelineLayout current_layout = VK_NULL_HANDLE;
 
-        std::vector<vk::DescriptorSet> descriptor_sets;
+        RhiCommandListStats stats;
+
+        /*!
+         * \brief Whether `cmds` has been begun but not ended. Reusable secondary command lists are only ended the first time they're
+         * executed
+         */
+        bool is_recording = false;
+
+#pragma region Bound state
+        /*!
+         * \brief What's currently bound to the graphics bind point, so binding the same thing again doesn't record a command
+         *
+         * Vulkan forgets all of this when a secondary command list is executed, so `forget_bound_state` clears it
+         */
+        vk::Pipeline bound_pipeline = VK_NULL_HANDLE;
+
+        /*!
+         * \brief The layout that `bound_descriptor_sets` were bound with. Binding sets with a different layout may disturb the others
+         */
+        vk::PipelineLayout bound_descriptor_layout = VK_NULL_HANDLE;
+
+        std::vector<vk::DescriptorSet> bound_descriptor_sets;
+
+        std::vector<vk::Buffer> bound_vertex_buffers;
+
+        vk::Buffer bound_index_buffer = VK_NULL_HANDLE;
+
+        vk::IndexType bound_index_type = VK_INDEX_TYPE_UINT32;
+
+        /*!
+         * \brief The per-draw constants that the next draw will use
+         */
+        RhiDrawConstants draw_constants;
+
+        /*!
+         * \brief Whether `draw_constants` has changed since it was last pushed, or the GPU's copy is gone
+         */
+        bool draw_constants_dirty = true;
+#pragma endregion
+
+        void forget_bound_state();
+
+        /*!
+         * \brief Pushes the per-draw constants if they changed since the last draw. Every draw calls this first
+         */
+        void flush_draw_constants();
+
+        /*!
+         * \brief Binds some graphics descriptor sets, skipping any prefix of them that's already bound
+         */
+        void bind_graphics_descriptor_sets(vk::PipelineLayout layout, uint32_t first_set, uint32_t num_sets, const vk::DescriptorSet* sets);
+
+        /*!
+         * \brief Begins a pass that uses dynamic rendering, with the framebuffer's views as its attachments
+         */
+        void begin_rendering(const VulkanRenderpass& renderpass, const VulkanFramebuffer& framebuffer, RenderpassContents contents);
     };
 } // namespace nova::renderer::rhi
@@ -0,0 +1,174 @@
+#include "vulkan_descriptor_allocator.hpp"
+
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer::rhi {
+    static auto logger = make_logger("VulkanDescriptorAllocator");
+
+    VulkanDescriptorAllocator::VulkanDescriptorAllocator(const vk::Device device,
+                                                         const vk::AllocationCallbacks* allocation_callbacks,
+                                                         const Lifetime lifetime,
+                                                         std::vector<vk::DescriptorPoolSize> pool_sizes,
+                                                         const uint32_t max_sets_per_pool)
+        : device{device},
+          allocation_callbacks{allocation_callbacks},
+          lifetime{lifetime},
+          pool_sizes{std::move(pool_sizes)},
+          max_sets_per_pool{max_sets_per_pool} {}
+
+    VulkanDescriptorAllocator::~VulkanDescriptorAllocator() {
+        for(const auto pool : pools) {
+            device.destroyDescriptorPool(pool, allocation_callbacks);
+        }
+    }
+
+    std::optional<VulkanDescriptorAllocation> VulkanDescriptorAllocator::allocate(const std::vector<vk::DescriptorSetLayout>& layouts,
+                                                                                  const std::vector<uint32_t>& variable_descriptor_counts) {
+        ZoneScoped;
+        const auto variable_count_info = vk::DescriptorSetVariableDescriptorCountAllocateInfo()
+                                             .setDescriptorSetCount(static_cast<uint32_t>(variable_descriptor_counts.size()))
+                                             .setPDescriptorCounts(variable_descriptor_counts.data());
+
+        auto allocate_info = vk::DescriptorSetAllocateInfo()
+                                 .setDescriptorSetCount(static_cast<uint32_t>(layouts.size()))
+                                 .setPSetLayouts(layouts.data())
+                                 .setPNext(variable_descriptor_counts.empty() ? nullptr : &variable_count_info);
+
+        VulkanDescriptorAllocation allocation;
+        allocation.sets.resize(layouts.size());
+
+        std::lock_guard lock{pools_mutex};
+
+        // The pools before first_open_pool were full last time. If none of the others have room either, make a new one
+        for(size_t pool_idx = first_open_pool; pool_idx <= pools.size(); pool_idx++) {
+            if(pool_idx == pools.size()) {
+                const auto new_pool = create_pool();
+                if(!new_pool) {
+                    return std::nullopt;
+                }
+
+                pools.push_back(*new_pool);
+            }
+
+            allocate_info.setDescriptorPool(pools[pool_idx]);
+            const auto result = device.allocateDescriptorSets(&allocate_info, allocation.sets.data());
+            if(result == vk::Result::eSuccess) {
+                allocation.pool = pools[pool_idx];
+                first_open_pool = pool_idx;
+
+                return allocation;
+            }
+
+            if(result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool) {
+                logger->error("Could not allocate {} descriptor sets: {}", layouts.size(), vk::to_string(result));
+                return std::nullopt;
+            }
+        }
+
+        logger->error("{} descriptor sets don't fit in a brand new descriptor pool", layouts.size());
+        return std::nullopt;
+    }
+
+    void VulkanDescriptorAllocator::free(const VulkanDescriptorAllocation& allocation) {
+        if(lifetime != Lifetime::Persistent) {
+            logger->error("Can't free individual descriptor sets from a transient descriptor allocator");
+            return;
+        }
+
+        if(allocation.sets.empty()) {
+            return;
+        }
+
+        std::lock_guard lock{pools_mutex};
+
+        device.freeDescriptorSets(allocation.pool, static_cast<uint32_t>(allocation.sets.size()), allocation.sets.data());
+
+        // The pool has room again
+        const auto pool_itr = std::find(pools.begin(), pools.end(), allocation.pool);
+        if(pool_itr != pools.end()) {
+            first_open_pool = std::min(first_open_pool, static_cast<size_t>(pool_itr - pools.begin()));
+        }
+    }
+
+    void VulkanDescriptorAllocator::reset() {
+        ZoneScoped;
+        if(lifetime != Lifetime::Transient) {
+            logger->error("Can't reset a persistent descriptor allocator, some of its sets may still be in use");
+            return;
+        }
+
+        std::lock_guard lock{pools_mutex};
+
+        // Only the pools up to first_open_pool have had anything allocated from them
+        for(size_t pool_idx = 0; pool_idx < std::min(first_open_pool + 1, pools.size()); pool_idx++) {
+            device.resetDescriptorPool(pools[pool_idx]);
+        }
+
+        first_open_pool = 0;
+    }
+
+    size_t VulkanDescriptorAllocator::get_num_pools() {
+        std::lock_guard lock{pools_mutex};
+
+        return pools.size();
+    }
+
+    void VulkanDescriptorAllocator::set_debug_name(std::string name, const PFN_vkSetDebugUtilsObjectNameEXT set_name_func) {
+        std::lock_guard lock{pools_mutex};
+
+        debug_name = std::move(name);
+        vkSetDebugUtilsObjectNameEXT = set_name_func;
+
+        for(size_t pool_idx = 0; pool_idx < pools.size(); pool_idx++) {
+            name_pool(pools[pool_idx], pool_idx);
+        }
+    }
+
+    std::optional<vk::DescriptorPool> VulkanDescriptorAllocator::create_pool() {
+        ZoneScoped;
+        vk::DescriptorPoolCreateFlags flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+        if(lifetime == Lifetime::Persistent) {
+            flags |= vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        }
+
+        const auto pool_create_info = vk::DescriptorPoolCreateInfo()
+                                          .setFlags(flags)
+                                          .setMaxSets(max_sets_per_pool)
+                                          .setPoolSizeCount(static_cast<uint32_t>(pool_sizes.size()))
+                                          .setPPoolSizes(pool_sizes.data());
+
+        vk::DescriptorPool pool;
+        const auto result = device.createDescriptorPool(&pool_create_info, allocation_callbacks, &pool);
+        if(result != vk::Result::eSuccess) {
+            logger->error("Could not create a descriptor pool: {}", vk::to_string(result));
+            return std::nullopt;
+        }
+
+        if(!pools.empty()) {
+            logger->debug("Descriptor allocator {} is full, adding pool {}", debug_name, pools.size());
+        }
+
+        name_pool(pool, pools.size());
+
+        return pool;
+    }
+
+    void VulkanDescriptorAllocator::name_pool(const vk::DescriptorPool pool, const size_t pool_idx) const {
+        if(vkSetDebugUtilsObjectNameEXT == nullptr) {
+            return;
+        }
+
+        const auto pool_name = fmt::format("{} pool {}", debug_name, pool_idx);
+        VkDebugUtilsObjectNameInfoEXT object_name = {};
+        object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+        object_name.objectType = VK_OBJECT_TYPE_DESCRIPTOR_POOL;
+        object_name.objectHandle = reinterpret_cast<uint64_t>(static_cast<VkDescriptorPool>(pool));
+        object_name.pObjectName = pool_name.c_str();
+        vkSetDebugUtilsObjectNameEXT(device, &object_name);
+    }
+} // namespace nova::renderer::rhi
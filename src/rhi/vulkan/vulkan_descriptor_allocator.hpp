@@ -0,0 +1,113 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief Some descriptor sets, and the pool they came from
+     */
+    struct VulkanDescriptorAllocation {
+        vk::DescriptorPool pool;
+
+        std::vector<vk::DescriptorSet> sets;
+    };
+
+    /*!
+     * \brief Allocates descriptor sets from a list of descriptor pools, and makes a new pool whenever all the others are full
+     *
+     * A persistent allocator lets you free sets one at a time. A transient allocator doesn't, but `reset` gives back every set that it's
+     * allocated at once and keeps the pools for next time. This is meant for sets that only live for one frame: give each frame slot its
+     * own transient allocator, and reset it when the frame slot comes around again
+     *
+     * Safe to use from multiple threads at once, since descriptor pools need external synchronization anyway
+     */
+    class VulkanDescriptorAllocator {
+    public:
+        enum class Lifetime {
+            Persistent,
+            Transient,
+        };
+
+        /*!
+         * \param pool_sizes How many descriptors of each type each pool holds
+         * \param max_sets_per_pool How many sets each pool holds
+         */
+        VulkanDescriptorAllocator(vk::Device device,
+                                  const vk::AllocationCallbacks* allocation_callbacks,
+                                  Lifetime lifetime,
+                                  std::vector<vk::DescriptorPoolSize> pool_sizes,
+                                  uint32_t max_sets_per_pool);
+
+        VulkanDescriptorAllocator(const VulkanDescriptorAllocator& other) = delete;
+        VulkanDescriptorAllocator& operator=(const VulkanDescriptorAllocator& other) = delete;
+
+        VulkanDescriptorAllocator(VulkanDescriptorAllocator&& old) noexcept = delete;
+        VulkanDescriptorAllocator& operator=(VulkanDescriptorAllocator&& old) noexcept = delete;
+
+        ~VulkanDescriptorAllocator();
+
+        /*!
+         * \brief Allocates one descriptor set for each layout
+         *
+         * \param variable_descriptor_counts The size of the variable-sized array in each set, or an empty vector if none of the sets have
+         * one
+         *
+         * \return The sets, or nothing if they don't fit in even a brand new pool
+         */
+        [[nodiscard]] std::optional<VulkanDescriptorAllocation> allocate(const std::vector<vk::DescriptorSetLayout>& layouts,
+                                                                         const std::vector<uint32_t>& variable_descriptor_counts);
+
+        /*!
+         * \brief Gives some sets back to the pool they came from. Only persistent allocators can do this. The GPU must be done with them
+         */
+        void free(const VulkanDescriptorAllocation& allocation);
+
+        /*!
+         * \brief Frees every set this allocator has allocated. Only allowed for transient allocators. The GPU must be done with them all
+         */
+        void reset();
+
+        /*!
+         * \brief Gets how many descriptor pools the allocator has made, full or not
+         */
+        [[nodiscard]] size_t get_num_pools();
+
+        /*!
+         * \brief Names the allocator's pools in graphics debuggers
+         */
+        void set_debug_name(std::string name, PFN_vkSetDebugUtilsObjectNameEXT set_name_func);
+
+    private:
+        vk::Device device;
+
+        const vk::AllocationCallbacks* allocation_callbacks;
+
+        Lifetime lifetime;
+
+        std::vector<vk::DescriptorPoolSize> pool_sizes;
+
+        uint32_t max_sets_per_pool;
+
+        std::mutex pools_mutex;
+
+        std::vector<vk::DescriptorPool> pools;
+
+        /*!
+         * \brief Index of the first pool that might have room. Pools before it were full the last time we tried them
+         */
+        size_t first_open_pool = 0;
+
+        std::string debug_name;
+
+        PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT = nullptr;
+
+        [[nodiscard]] std::optional<vk::DescriptorPool> create_pool();
+
+        void name_pool(vk::DescriptorPool pool, size_t pool_idx) const;
+    };
+} // namespace nova::renderer::rhi
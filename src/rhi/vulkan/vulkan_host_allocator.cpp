@@ -0,0 +1,376 @@
+#include "vulkan_host_allocator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <optional>
+
+#include <Tracy.hpp>
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief Size of the chunks of memory that the pools carve blocks out of
+     */
+    constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    /*!
+     * \brief How many blocks a thread moves between its cache and the shared pools at once
+     */
+    constexpr size_t CACHE_BATCH_SIZE = 32;
+
+    /*!
+     * \brief A thread's cache can grow this big before it gives a batch of blocks back to the shared pools
+     */
+    constexpr size_t MAX_CACHED_BLOCKS = CACHE_BATCH_SIZE * 2;
+
+    constexpr uint32_t LARGE_ALLOCATION = UINT32_MAX;
+
+    /*!
+     * \brief Sits right before every allocation, so freeing an allocation can tell where it came from
+     */
+    struct AllocationHeader {
+        /*!
+         * \brief Index of the size class the allocation's block is from, or `LARGE_ALLOCATION`
+         */
+        uint32_t size_class;
+
+        /*!
+         * \brief For large allocations, how far the allocation is from the start of the memory we got from the system allocator
+         */
+        uint32_t offset;
+
+        uint64_t size;
+    };
+
+    static_assert(sizeof(AllocationHeader) == 16);
+
+    /*!
+     * \brief Pool allocations are only aligned to this. The few allocations that need more go to the system allocator
+     */
+    constexpr size_t POOL_ALIGNMENT = sizeof(AllocationHeader);
+
+    static AllocationHeader* get_header(void* memory) {
+        return reinterpret_cast<AllocationHeader*>(static_cast<std::byte*>(memory) - sizeof(AllocationHeader));
+    }
+
+    static size_t get_block_size(const size_t size_class) { return VulkanHostAllocator::MIN_BLOCK_SIZE << size_class; }
+
+    /*!
+     * \brief Finds the smallest size class whose blocks fit an allocation and its header, if there is one
+     */
+    static std::optional<size_t> get_size_class(const size_t size, const size_t alignment) {
+        if(alignment > POOL_ALIGNMENT) {
+            return std::nullopt;
+        }
+
+        for(size_t size_class = 0; size_class < VulkanHostAllocator::NUM_SIZE_CLASSES; size_class++) {
+            if(get_block_size(size_class) >= size + sizeof(AllocationHeader)) {
+                return size_class;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    static std::byte*& next_block(std::byte* block) { return *reinterpret_cast<std::byte**>(block); }
+
+    /*!
+     * \brief Free blocks that one thread keeps for itself
+     */
+    struct ThreadCache {
+        struct FreeList {
+            std::byte* first = nullptr;
+
+            size_t count = 0;
+        };
+
+        std::array<FreeList, VulkanHostAllocator::NUM_SIZE_CLASSES> free_lists;
+
+        ThreadCache() = default;
+
+        ThreadCache(const ThreadCache& other) = delete;
+        ThreadCache& operator=(const ThreadCache& other) = delete;
+
+        ThreadCache(ThreadCache&& old) noexcept = delete;
+        ThreadCache& operator=(ThreadCache&& old) noexcept = delete;
+
+        ~ThreadCache() {
+            for(size_t size_class = 0; size_class < free_lists.size(); size_class++) {
+                auto& list = free_lists[size_class];
+                if(list.count > 0) {
+                    give_back(size_class, list.count);
+                }
+            }
+        }
+
+        /*!
+         * \brief Moves the first `count` blocks of a free list to the shared pools
+         */
+        void give_back(const size_t size_class, const size_t count) {
+            auto& list = free_lists[size_class];
+
+            std::byte* first = list.first;
+            std::byte* last = first;
+            for(size_t i = 1; i < count; i++) {
+                last = next_block(last);
+            }
+
+            list.first = next_block(last);
+            list.count -= count;
+
+            VulkanHostAllocator::get_instance().return_blocks(size_class, first, last, count);
+        }
+    };
+
+    static thread_local ThreadCache thread_cache;
+
+    static VKAPI_ATTR void* VKAPI_CALL vulkan_allocate(void* user_data,
+                                                       const size_t size,
+                                                       const size_t alignment,
+                                                       VkSystemAllocationScope /* scope */) {
+        return static_cast<VulkanHostAllocator*>(user_data)->allocate(size, alignment);
+    }
+
+    static VKAPI_ATTR void* VKAPI_CALL vulkan_reallocate(void* user_data,
+                                                         void* original,
+                                                         const size_t size,
+                                                         const size_t alignment,
+                                                         VkSystemAllocationScope /* scope */) {
+        return static_cast<VulkanHostAllocator*>(user_data)->reallocate(original, size, alignment);
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL vulkan_free(void* user_data, void* memory) {
+        static_cast<VulkanHostAllocator*>(user_data)->free(memory);
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL vulkan_internal_allocation(void* user_data,
+                                                                 const size_t size,
+                                                                 VkInternalAllocationType /* type */,
+                                                                 VkSystemAllocationScope /* scope */) {
+        static_cast<VulkanHostAllocator*>(user_data)->on_internal_allocation(size);
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL vulkan_internal_free(void* user_data,
+                                                           const size_t size,
+                                                           VkInternalAllocationType /* type */,
+                                                           VkSystemAllocationScope /* scope */) {
+        static_cast<VulkanHostAllocator*>(user_data)->on_internal_free(size);
+    }
+
+    VulkanHostAllocator& VulkanHostAllocator::get_instance() {
+        static VulkanHostAllocator instance;
+
+        return instance;
+    }
+
+    VulkanHostAllocator::VulkanHostAllocator() {
+        callbacks.pUserData = this;
+        callbacks.pfnAllocation = vulkan_allocate;
+        callbacks.pfnReallocation = vulkan_reallocate;
+        callbacks.pfnFree = vulkan_free;
+        callbacks.pfnInternalAllocation = vulkan_internal_allocation;
+        callbacks.pfnInternalFree = vulkan_internal_free;
+    }
+
+    VulkanHostAllocator::~VulkanHostAllocator() {
+        for(std::byte* chunk : chunks) {
+            ::operator delete(chunk, std::align_val_t{POOL_ALIGNMENT});
+        }
+    }
+
+    const VkAllocationCallbacks& VulkanHostAllocator::get_callbacks() const { return callbacks; }
+
+    VulkanHostAllocatorStats VulkanHostAllocator::get_stats() const {
+        VulkanHostAllocatorStats stats;
+        stats.num_live_allocations = num_live_allocations.load(std::memory_order_relaxed);
+        stats.num_live_bytes = num_live_bytes.load(std::memory_order_relaxed);
+        stats.peak_live_bytes = peak_live_bytes.load(std::memory_order_relaxed);
+        stats.num_allocations = num_allocations.load(std::memory_order_relaxed);
+        stats.num_reallocations = num_reallocations.load(std::memory_order_relaxed);
+        stats.num_large_allocations = num_large_allocations.load(std::memory_order_relaxed);
+        stats.num_pooled_bytes = num_pooled_bytes.load(std::memory_order_relaxed);
+        stats.num_internal_bytes = num_internal_bytes.load(std::memory_order_relaxed);
+
+        return stats;
+    }
+
+    void* VulkanHostAllocator::allocate(const size_t size, const size_t alignment) {
+        if(size == 0) {
+            return nullptr;
+        }
+
+        std::byte* memory = nullptr;
+        AllocationHeader header{LARGE_ALLOCATION, 0, size};
+
+        if(const auto size_class = get_size_class(size, alignment); size_class) {
+            auto& list = thread_cache.free_lists[*size_class];
+            if(list.count == 0) {
+                list.first = take_blocks(*size_class, CACHE_BATCH_SIZE, list.count);
+                if(list.count == 0) {
+                    return nullptr;
+                }
+            }
+
+            std::byte* block = list.first;
+            list.first = next_block(block);
+            list.count--;
+
+            memory = block + sizeof(AllocationHeader);
+            header.size_class = static_cast<uint32_t>(*size_class);
+
+        } else {
+            // Large allocations put their header at the end of the padding that keeps the allocation aligned
+            const auto offset = std::max(alignment, POOL_ALIGNMENT);
+            auto* system_memory = static_cast<std::byte*>(::operator new(size + offset, std::align_val_t{offset}, std::nothrow));
+            if(system_memory == nullptr) {
+                return nullptr;
+            }
+
+            memory = system_memory + offset;
+            header.offset = static_cast<uint32_t>(offset);
+            num_large_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        *get_header(memory) = header;
+
+        num_allocations.fetch_add(1, std::memory_order_relaxed);
+        num_live_allocations.fetch_add(1, std::memory_order_relaxed);
+        add_live_bytes(size);
+
+        return memory;
+    }
+
+    void* VulkanHostAllocator::reallocate(void* original, const size_t size, const size_t alignment) {
+        if(original == nullptr) {
+            return allocate(size, alignment);
+        }
+
+        if(size == 0) {
+            free(original);
+            return nullptr;
+        }
+
+        num_reallocations.fetch_add(1, std::memory_order_relaxed);
+
+        auto* header = get_header(original);
+        const auto old_size = header->size;
+
+        // Blocks are usually bigger than what was asked for, so growing into the rest of the block is free
+        const auto fits_in_block = header->size_class != LARGE_ALLOCATION &&
+                                   get_block_size(header->size_class) >= size + sizeof(AllocationHeader) &&
+                                   alignment <= POOL_ALIGNMENT;
+        if(fits_in_block) {
+            header->size = size;
+            if(size > old_size) {
+                add_live_bytes(size - old_size);
+            } else {
+                num_live_bytes.fetch_sub(old_size - size, std::memory_order_relaxed);
+            }
+
+            return original;
+        }
+
+        void* memory = allocate(size, alignment);
+        if(memory == nullptr) {
+            // Vulkan wants the original allocation left alone if reallocation fails
+            return nullptr;
+        }
+
+        std::memcpy(memory, original, std::min(static_cast<size_t>(old_size), size));
+        free(original);
+
+        return memory;
+    }
+
+    void VulkanHostAllocator::free(void* memory) {
+        if(memory == nullptr) {
+            return;
+        }
+
+        const auto header = *get_header(memory);
+
+        num_live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        num_live_bytes.fetch_sub(header.size, std::memory_order_relaxed);
+
+        if(header.size_class == LARGE_ALLOCATION) {
+            ::operator delete(static_cast<std::byte*>(memory) - header.offset, std::align_val_t{header.offset});
+            return;
+        }
+
+        // Blocks go back to the cache of whichever thread frees them, not the one that allocated them
+        std::byte* block = static_cast<std::byte*>(memory) - sizeof(AllocationHeader);
+        auto& list = thread_cache.free_lists[header.size_class];
+        next_block(block) = list.first;
+        list.first = block;
+        list.count++;
+
+        if(list.count > MAX_CACHED_BLOCKS) {
+            thread_cache.give_back(header.size_class, CACHE_BATCH_SIZE);
+        }
+    }
+
+    std::byte* VulkanHostAllocator::take_blocks(const size_t size_class, const size_t count, size_t& num_taken) {
+        auto& pool = pools[size_class];
+        {
+            std::lock_guard lock{pool.mutex};
+            if(pool.num_free_blocks > 0) {
+                std::byte* first = pool.free_blocks;
+                std::byte* last = first;
+                num_taken = 1;
+                while(num_taken < count && next_block(last) != nullptr) {
+                    last = next_block(last);
+                    num_taken++;
+                }
+
+                pool.free_blocks = next_block(last);
+                pool.num_free_blocks -= num_taken;
+                next_block(last) = nullptr;
+
+                return first;
+            }
+        }
+
+        ZoneScoped;
+        auto* chunk = static_cast<std::byte*>(::operator new(CHUNK_SIZE, std::align_val_t{POOL_ALIGNMENT}, std::nothrow));
+        if(chunk == nullptr) {
+            num_taken = 0;
+            return nullptr;
+        }
+
+        {
+            std::lock_guard lock{chunks_mutex};
+            chunks.push_back(chunk);
+        }
+        num_pooled_bytes.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+
+        // The whole chunk goes to the thread that asked for it
+        const auto block_size = get_block_size(size_class);
+        num_taken = CHUNK_SIZE / block_size;
+        for(size_t i = 0; i < num_taken; i++) {
+            next_block(chunk + i * block_size) = i + 1 < num_taken ? chunk + (i + 1) * block_size : nullptr;
+        }
+
+        return chunk;
+    }
+
+    void VulkanHostAllocator::return_blocks(const size_t size_class, std::byte* first, std::byte* last, const size_t count) {
+        auto& pool = pools[size_class];
+
+        std::lock_guard lock{pool.mutex};
+        next_block(last) = pool.free_blocks;
+        pool.free_blocks = first;
+        pool.num_free_blocks += count;
+    }
+
+    void VulkanHostAllocator::on_internal_allocation(const size_t size) { num_internal_bytes.fetch_add(size, std::memory_order_relaxed); }
+
+    void VulkanHostAllocator::on_internal_free(const size_t size) { num_internal_bytes.fetch_sub(size, std::memory_order_relaxed); }
+
+    void VulkanHostAllocator::add_live_bytes(const uint64_t size) {
+        const auto new_live_bytes = num_live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+
+        auto peak = peak_live_bytes.load(std::memory_order_relaxed);
+        while(new_live_bytes > peak && !peak_live_bytes.compare_exchange_weak(peak, new_live_bytes, std::memory_order_relaxed)) {
+        }
+    }
+} // namespace nova::renderer::rhi
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace nova::renderer::rhi {
+    /*!
+     * \brief How much host memory the Vulkan driver has asked Nova for
+     */
+    struct VulkanHostAllocatorStats {
+        /*!
+         * \brief Number of allocations that the driver hasn't freed yet
+         */
+        uint64_t num_live_allocations = 0;
+
+        /*!
+         * \brief Bytes that the driver asked for and hasn't freed yet
+         */
+        uint64_t num_live_bytes = 0;
+
+        /*!
+         * \brief The highest that `num_live_bytes` has been
+         */
+        uint64_t peak_live_bytes = 0;
+
+        /*!
+         * \brief Total number of allocations, including ones that have been freed
+         */
+        uint64_t num_allocations = 0;
+
+        /*!
+         * \brief Total number of reallocations
+         */
+        uint64_t num_reallocations = 0;
+
+        /*!
+         * \brief How many allocations were too big or too aligned for the pools, and went straight to the system allocator
+         */
+        uint64_t num_large_allocations = 0;
+
+        /*!
+         * \brief Bytes of memory that the pools have taken from the system. Pools never give memory back
+         */
+        uint64_t num_pooled_bytes = 0;
+
+        /*!
+         * \brief Bytes that the driver allocated itself and told us about through the internal allocation callbacks
+         */
+        uint64_t num_internal_bytes = 0;
+    };
+
+    /*!
+     * \brief Thread-safe host allocator for the allocation callbacks that Nova gives the Vulkan driver
+     *
+     * Small allocations come from pools of fixed-size blocks. Each thread keeps a few free blocks of every size for itself, so drivers that
+     * allocate a lot while compiling pipelines on several threads at once only touch the shared pools every few dozen allocations.
+     * Anything too big for the pools goes to the system allocator
+     *
+     * There's one of these for the whole process, since the per-thread caches outlive any one render device
+     */
+    class VulkanHostAllocator {
+    public:
+        /*!
+         * \brief Size of the smallest block in the pools
+         */
+        static constexpr size_t MIN_BLOCK_SIZE = 32;
+
+        /*!
+         * \brief Size of the largest block in the pools. Each size class is twice as big as the last one
+         */
+        static constexpr size_t MAX_BLOCK_SIZE = 8192;
+
+        static constexpr size_t NUM_SIZE_CLASSES = 9;
+
+        static_assert(MIN_BLOCK_SIZE << (NUM_SIZE_CLASSES - 1) == MAX_BLOCK_SIZE);
+
+        static VulkanHostAllocator& get_instance();
+
+        VulkanHostAllocator(const VulkanHostAllocator& other) = delete;
+        VulkanHostAllocator& operator=(const VulkanHostAllocator& other) = delete;
+
+        VulkanHostAllocator(VulkanHostAllocator&& old) noexcept = delete;
+        VulkanHostAllocator& operator=(VulkanHostAllocator&& old) noexcept = delete;
+
+        ~VulkanHostAllocator();
+
+        [[nodiscard]] const VkAllocationCallbacks& get_callbacks() const;
+
+        [[nodiscard]] VulkanHostAllocatorStats get_stats() const;
+
+        [[nodiscard]] void* allocate(size_t size, size_t alignment);
+
+        [[nodiscard]] void* reallocate(void* original, size_t size, size_t alignment);
+
+        void free(void* memory);
+
+        /*!
+         * \brief Takes up to `count` free blocks of a size class from the shared pools, carving out a new chunk of blocks if they're empty
+         *
+         * \return The first block in a list of blocks, linked through their first bytes
+         */
+        [[nodiscard]] std::byte* take_blocks(size_t size_class, size_t count, size_t& num_taken);
+
+        /*!
+         * \brief Gives a list of free blocks of a size class back to the shared pools
+         */
+        void return_blocks(size_t size_class, std::byte* first, std::byte* last, size_t count);
+
+        void on_internal_allocation(size_t size);
+
+        void on_internal_free(size_t size);
+
+    private:
+        struct SharedPool {
+            std::mutex mutex;
+
+            std::byte* free_blocks = nullptr;
+
+            size_t num_free_blocks = 0;
+        };
+
+        VkAllocationCallbacks callbacks;
+
+        std::array<SharedPool, NUM_SIZE_CLASSES> pools;
+
+        std::mutex chunks_mutex;
+
+        std::vector<std::byte*> chunks;
+
+        std::atomic<uint64_t> num_live_allocations = 0;
+        std::atomic<uint64_t> num_live_bytes = 0;
+        std::atomic<uint64_t> peak_live_bytes = 0;
+        std::atomic<uint64_t> num_allocations = 0;
+        std::atomic<uint64_t> num_reallocations = 0;
+        std::atomic<uint64_t> num_large_allocations = 0;
+        std::atomic<uint64_t> num_pooled_bytes = 0;
+        std::atomic<uint64_t> num_internal_bytes = 0;
+
+        VulkanHostAllocator();
+
+        void add_live_bytes(uint64_t size);
+    };
+} // namespace nova::renderer::rhi
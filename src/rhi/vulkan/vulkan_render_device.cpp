@@ -2,12 +2,21 @@
 #define VMA_IMPLEMENTATION
 #include "vulkan_render_device.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <csignal>
+#include <cstddef>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <sstream>
+#include <utility>
 
 #include <Tracy.hpp>
-#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
 #include "nova_renderer/camera.hpp"
@@ -15,6 +24,7 @@
 #include "nova_renderer/frame_context.hpp"
 #include "nova_renderer/renderables.hpp"
 #include "nova_renderer/rhi/pipeline_create_info.hpp"
+#include "nova_renderer/util/logging.hpp"
 #include "nova_renderer/window.hpp"
 
 #include "../../renderer/pipeline_reflection.hpp"
@@ -48,32 +58,70 @@ using namespace nova::mem;
 #endif
 
 namespace nova::renderer::rhi {
-    static auto logger = spdlog::stdout_color_mt("VulkanRenderDevice");
+    static auto logger = make_logger("VulkanRenderDevice");
 
-    void FencedTask::operator()() const { work_to_perform(); }
+    /*!
+     * \brief What our pipeline statistics queries count. Vulkan writes the results in bit order, which is the order of the members of
+     * `RhiPipelineStatistics`
+     */
+    static constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                                                                         VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                                         VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    static_assert(sizeof(RhiPipelineStatistics) == 3 * sizeof(uint64_t), "RhiPipelineStatistics must match PIPELINE_STATISTICS");
+
+    /*!
+     * \brief Names of the memory pools, in `MemoryPoolClass` order
+     */
+    static constexpr std::array<const char*, 4> MEMORY_POOL_NAMES{"MeshGeometry", "StreamedTextures", "Upload", "Staging"};
+
+    /*!
+     * \brief Frames to wait after every pool is compact before looking at them again, so compact pools don't cost anything most frames
+     */
+    static constexpr uint32_t DEFRAGMENTATION_IDLE_FRAMES = 600;
 
     VulkanRenderDevice::VulkanRenderDevice(NovaSettingsAccessManager& settings, NovaWindow& window) : RenderDevice{settings, window} {
         ZoneScoped;
+        if(settings.settings.vulkan.use_host_allocator) {
+            allocation_callbacks = &VulkanHostAllocator::get_instance().get_callbacks();
+            vk_allocation_callbacks = reinterpret_cast<const vk::AllocationCallbacks*>(allocation_callbacks);
+        }
+
         create_instance();
 
         if(settings.settings.debug.enabled) {
             enable_debug_output();
         }
 
-        create_surface();
+        surface = create_surface(window);
 
         create_device_and_queues();
 
+        create_queue_timelines();
+
         save_device_info();
 
         initialize_vma();
 
+        create_memory_pools();
+
+        create_pipeline_cache();
+
         if(settings.settings.debug.enabled) {
             // Late init, can only be used when the device has already been created
             vkSetDebugUtilsObjectNameEXT = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(
                 vkGetDeviceProcAddr(device, "vkSetDebugUtilsObjectNameEXT"));
         }
 
+        if(vk_info.supports_present_wait) {
+            vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+        }
+
+        if(vk_info.supports_dynamic_rendering) {
+            vkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+            vkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+        }
+
         create_swapchain();
 
         create_per_thread_command_pools();
@@ -81,6 +129,54 @@ namespace nova::renderer::rhi {
         create_standard_pipeline_layout();
     }
 
+    VulkanRenderDevice::~VulkanRenderDevice() {
+        device.waitIdle();
+
+        // Whatever still owns the deferred work is being torn down too, so there's nothing left for the work to do
+        for(const auto& timeline : queue_timelines) {
+            auto* task = timeline->new_tasks.exchange(nullptr);
+            while(task != nullptr) {
+                delete std::exchange(task, task->next);
+            }
+
+            for(const DeferredTask* pending_task : timeline->pending_tasks) {
+                delete pending_task;
+            }
+
+            device.destroySemaphore(timeline->semaphore, vk_allocation_callbacks);
+        }
+
+        // Destroying a pool frees all of its command buffers
+        for(auto& pools_by_thread : command_pools) {
+            for(auto& pools_by_family : pools_by_thread) {
+                for(auto& [queue_family_index, pool] : pools_by_family) {
+                    vkDestroyCommandPool(device, pool.pool, allocation_callbacks);
+                }
+            }
+        }
+
+        for(const auto& [cmds, pool] : reusable_command_pools) {
+            vkDestroyCommandPool(device, pool->pool, allocation_callbacks);
+        }
+
+        save_pipeline_cache();
+
+        device.destroyPipelineCache(pipeline_cache, vk_allocation_callbacks);
+
+        for(const auto& [key, layout] : pipeline_layouts) {
+            device.destroyPipelineLayout(layout, vk_allocation_callbacks);
+        }
+
+        for(const auto& [key, layout] : descriptor_set_layouts) {
+            device.destroyDescriptorSetLayout(layout, vk_allocation_callbacks);
+        }
+
+        for(const auto& [create_info, sampler] : samplers) {
+            vkDestroySampler(device, sampler->sampler, allocation_callbacks);
+            internal_allocator.deallocate(reinterpret_cast<uint8_t*>(sampler));
+        }
+    }
+
     void VulkanRenderDevice::set_num_renderpasses(uint32_t /* num_renderpasses */) {
         // Pretty sure Vulkan doesn't need to do anything here
     }
@@ -92,6 +188,7 @@ namespace nova::renderer::rhi {
         vk::Extent2D swapchain_extent = {swapchain_size.x, swapchain_size.y};
 
         auto renderpass = VulkanRenderpass{};
+        renderpass.cached_pipelines.resize(1);
 
         vk::SubpassDescription subpass_description = {};
         subpass_description.flags = 0;
@@ -127,6 +224,34 @@ namespace nova::renderer::rhi {
         uint32_t framebuffer_width = framebuffer_size.x;
         uint32_t framebuffer_height = framebuffer_size.y;
 
+        // Every attachment of a subpass has to have the same number of samples. The backbuffer only ever has one
+        std::optional<uint32_t> pass_num_samples;
+        bool has_mixed_num_samples = false;
+        const auto add_num_samples = [&](const renderpack::TextureAttachmentInfo& attachment) {
+            const auto num_samples = attachment.name == BACKBUFFER_NAME ? 1U : attachment.num_samples;
+            has_mixed_num_samples |= pass_num_samples && *pass_num_samples != num_samples;
+            pass_num_samples = num_samples;
+        };
+        for(const renderpack::TextureAttachmentInfo& output : data.texture_outputs) {
+            add_num_samples(output);
+        }
+        if(data.depth_texture) {
+            add_num_samples(*data.depth_texture);
+        }
+
+        if(has_mixed_num_samples) {
+            return ntl::Result<RhiRenderpass*>(
+                MAKE_ERROR("Pass {:s} renders to textures with different numbers of samples. All of a pass's outputs and its depth texture "
+                           "must have the same number of samples",
+                           data.name.data()));
+        }
+
+        renderpass.num_samples = get_sample_count(pass_num_samples.value_or(1));
+        const auto is_multisampled = renderpass.num_samples != vk::SampleCountFlagBits::e1;
+
+        // Multisampled attachments are resolved into the textures, which go after the depth attachment
+        std::vector<vk::AttachmentDescription> resolve_attachments{};
+
         bool writes_to_backbuffer = false;
         // Collect framebuffer size information from color output attachments
         for(const renderpack::TextureAttachmentInfo& attachment : data.texture_outputs) {
@@ -165,12 +290,25 @@ namespace nova::renderer::rhi {
                 desc.format = to_vk_format(attachment.pixel_format);
                 desc.samples = VK_SAMPLE_COUNT_1_BIT;
                 desc.loadOp = attachment.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-                desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                desc.storeOp = attachment.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
                 desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
                 desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
                 desc.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
                 desc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+                if(is_multisampled) {
+                    // The resolve writes every pixel of the texture, so there's nothing to load into it
+                    auto resolve_desc = desc;
+                    resolve_desc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    resolve_attachments.push_back(resolve_desc);
+
+                    // The samples never leave the renderpass
+                    desc.samples = renderpass.num_samples;
+                    desc.loadOp = attachment.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    desc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                    desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                }
+
                 attachments.push_back(desc);
 
                 vk::AttachmentReference ref;
@@ -189,12 +327,26 @@ namespace nova::renderer::rhi {
             desc.format = to_vk_format(data.depth_texture->pixel_format);
             desc.samples = VK_SAMPLE_COUNT_1_BIT;
             desc.loadOp = data.depth_texture->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-            desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            desc.storeOp = data.depth_texture->store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
             desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             desc.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
             desc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
+            if(is_multisampled) {
+                desc.samples = renderpass.num_samples;
+                desc.loadOp = data.depth_texture->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                desc.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                renderpass.resolves_depth = vk_info.supports_dynamic_rendering && vk_info.supports_depth_resolve;
+                if(!renderpass.resolves_depth) {
+                    logger->warn(
+                        "Pass %s has a multisampled depth texture, which can only be resolved with dynamic rendering and depth resolves. Nothing after the pass will see its depth",
+                        data.name);
+                }
+            }
+
             attachments.push_back(desc);
 
             depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -223,13 +375,47 @@ namespace nova::renderer::rhi {
                 gpu.props.limits.maxColorAttachments));
         }
 
+        if(data.views.size() > MAX_NUM_VIEWS) {
+            return ntl::Result<RhiRenderpass*>(
+                MAKE_ERROR("Pass {:s} has {:d} views, but passes may only have {:d}", data.name.data(), data.views.size(), MAX_NUM_VIEWS));
+        }
+
         subpass_description.colorAttachmentCount = static_cast<uint32_t>(attachment_references.size());
         subpass_description.pColorAttachments = attachment_references.data();
 
+        // One resolve attachment for each color attachment, in the same order
+        std::vector<vk::AttachmentReference> resolve_references{};
+        const auto num_rendered_attachments = attachments.size();
+        if(!resolve_attachments.empty()) {
+            for(const vk::AttachmentDescription& resolve_desc : resolve_attachments) {
+                attachments.push_back(resolve_desc);
+
+                vk::AttachmentReference ref;
+                ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                ref.attachment = static_cast<uint32_t>(attachments.size()) - 1;
+
+                resolve_references.push_back(ref);
+            }
+
+            subpass_description.pResolveAttachments = resolve_references.data();
+        }
+
         render_pass_create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
         render_pass_create_info.pAttachments = attachments.data();
 
-        NOVA_CHECK_RESULT(vkCreateRenderPass(device, &render_pass_create_info, nullptr, &renderpass.pass));
+        // Every view renders to its own layer of the attachments. The views are close to each other, so the driver may as well treat
+        // them all as one
+        if(data.views.size() > 1) {
+            renderpass.view_mask = (1U << data.views.size()) - 1;
+        }
+        const auto multiview_create_info = vk::RenderPassMultiviewCreateInfo()
+                                               .setSubpassCount(1)
+                                               .setPViewMasks(&renderpass.view_mask)
+                                               .setCorrelationMaskCount(1)
+                                               .setPCorrelationMasks(&renderpass.view_mask);
+        if(renderpass.view_mask != 0) {
+            render_pass_create_info.pNext = &multiview_create_info;
+        }
 
         if(writes_to_backbuffer) {
             if(data.texture_outputs.size() > 1) {
@@ -241,6 +427,27 @@ namespace nova::renderer::rhi {
 
         renderpass.render_area = {.offset = {0, 0}, .extent = {framebuffer_width, framebuffer_height}};
 
+        if(vk_info.supports_fragment_shading_rate && data.shading_rate) {
+            renderpass.fragment_size = to_vk_fragment_size(*data.shading_rate);
+        }
+
+        if(vk_info.supports_dynamic_rendering) {
+            // The attachment descriptions are all that vkCmdBeginRenderingKHR and the pipelines need
+            renderpass.uses_dynamic_rendering = true;
+            renderpass.color_attachments.assign(attachments.begin(), attachments.begin() + attachment_references.size());
+            if(data.depth_texture) {
+                renderpass.depth_attachment = attachments[num_rendered_attachments - 1];
+            }
+
+            if(vk_info.supports_shading_rate_attachment && data.uses_adaptive_shading_rate) {
+                renderpass.shading_rate_texel_size = vk::Extent2D{info.shading_rate_image_texel_size, info.shading_rate_image_texel_size};
+            }
+
+            return ntl::Result(static_cast<RhiRenderpass*>(renderpass));
+        }
+
+        NOVA_CHECK_RESULT(vkCreateRenderPass(device, &render_pass_create_info, allocation_callbacks, &renderpass.pass));
+
         if(settings.settings.debug.enabled) {
             vk::DebugUtilsObjectNameInfoEXT object_name = {};
             object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
@@ -253,9 +460,237 @@ namespace nova::renderer::rhi {
         return ntl::Result(static_cast<RhiRenderpass*>(renderpass));
     }
 
+    ntl::Result<RhiRenderpass*> VulkanRenderDevice::create_merged_renderpass(
+        const std::vector<renderpack::RenderPassCreateInfo>& subpasses,
+        const std::unordered_set<std::string>& transient_attachments,
+        const glm::uvec2& framebuffer_size) {
+        ZoneScoped;
+        std::vector<vk::AttachmentDescription> attachments;
+        std::vector<std::string> attachment_names;
+
+        // The last subpass to write an attachment decides whether it's stored
+        std::unordered_map<std::string, bool> stores;
+        for(const renderpack::RenderPassCreateInfo& subpass : subpasses) {
+            for(const renderpack::TextureAttachmentInfo& output : subpass.texture_outputs) {
+                stores[output.name] = output.store;
+            }
+            if(subpass.depth_texture) {
+                stores[subpass.depth_texture->name] = subpass.depth_texture->store;
+            }
+        }
+
+        // The first subpass to use an attachment decides whether it's loaded or cleared
+        const auto add_attachment = [&](const renderpack::TextureAttachmentInfo& info, const bool is_depth) {
+            if(std::find(attachment_names.begin(), attachment_names.end(), info.name) != attachment_names.end()) {
+                return;
+            }
+
+            const auto is_transient = transient_attachments.find(info.name) != transient_attachments.end();
+            const auto layout = is_depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+            vk::AttachmentDescription desc = {};
+            desc.format = to_vk_format(info.pixel_format);
+            desc.samples = VK_SAMPLE_COUNT_1_BIT;
+            desc.loadOp = info.clear     ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+                          is_transient ? VK_ATTACHMENT_LOAD_OP_DONT_CARE :
+                                         VK_ATTACHMENT_LOAD_OP_LOAD;
+            desc.storeOp = is_transient || !stores.at(info.name) ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+            desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            desc.initialLayout = layout;
+            desc.finalLayout = layout;
+
+            attachments.push_back(desc);
+            attachment_names.push_back(info.name);
+        };
+
+        for(const renderpack::RenderPassCreateInfo& subpass : subpasses) {
+            for(const renderpack::TextureAttachmentInfo& output : subpass.texture_outputs) {
+                add_attachment(output, false);
+            }
+        }
+
+        // Depth is ALWAYS the last attachment, same as in `create_renderpass`
+        const auto num_color_attachments = static_cast<uint32_t>(attachments.size());
+        for(const renderpack::RenderPassCreateInfo& subpass : subpasses) {
+            if(subpass.depth_texture) {
+                add_attachment(*subpass.depth_texture, true);
+                break;
+            }
+        }
+
+        const auto get_attachment_idx = [&](const std::string& name) {
+            return static_cast<uint32_t>(
+                std::distance(attachment_names.begin(), std::find(attachment_names.begin(), attachment_names.end(), name)));
+        };
+
+        struct SubpassReferences {
+            std::vector<vk::AttachmentReference> color;
+            std::vector<vk::AttachmentReference> inputs;
+            std::vector<uint32_t> preserved;
+            vk::AttachmentReference depth{};
+        };
+
+        std::vector<SubpassReferences> references(subpasses.size());
+        std::vector<std::vector<bool>> uses_attachment(subpasses.size(), std::vector<bool>(attachments.size(), false));
+
+        for(uint32_t subpass_idx = 0; subpass_idx < subpasses.size(); subpass_idx++) {
+            const auto& subpass = subpasses[subpass_idx];
+            auto& refs = references[subpass_idx];
+
+            if(subpass.texture_outputs.size() > gpu.props.limits.maxColorAttachments) {
+                return ntl::Result<RhiRenderpass*>(MAKE_ERROR("Pass {} has {} color attachments, but your GPU only supports {}",
+                                                              subpass.name,
+                                                              subpass.texture_outputs.size(),
+                                                              gpu.props.limits.maxColorAttachments));
+            }
+
+            for(const renderpack::TextureAttachmentInfo& output : subpass.texture_outputs) {
+                const auto attachment_idx = get_attachment_idx(output.name);
+                refs.color.push_back({attachment_idx, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+                uses_attachment[subpass_idx][attachment_idx] = true;
+            }
+
+            if(subpass.depth_texture) {
+                const auto attachment_idx = get_attachment_idx(subpass.depth_texture->name);
+                if(attachment_idx != num_color_attachments) {
+                    return ntl::Result<RhiRenderpass*>(
+                        MAKE_ERROR("Pass {} uses a different depth texture than the passes it's merged with", subpass.name));
+                }
+
+                refs.depth = {attachment_idx, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+                uses_attachment[subpass_idx][attachment_idx] = true;
+            }
+
+            for(const std::string& input : subpass.input_attachments) {
+                const auto attachment_idx = get_attachment_idx(input);
+                const auto is_written_before = attachment_idx < num_color_attachments &&
+                                               std::any_of(uses_attachment.begin(),
+                                                           uses_attachment.begin() + subpass_idx,
+                                                           [&](const std::vector<bool>& uses) { return uses[attachment_idx]; });
+                if(!is_written_before) {
+                    return ntl::Result<RhiRenderpass*>(
+                        MAKE_ERROR("Pass {} reads {} as an input attachment, but no earlier subpass writes it", subpass.name, input));
+                }
+
+                refs.inputs.push_back({attachment_idx, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+                uses_attachment[subpass_idx][attachment_idx] = true;
+            }
+        }
+
+        // Attachments that a subpass doesn't use keep their contents for the later subpasses that do
+        for(uint32_t subpass_idx = 1; subpass_idx + 1 < subpasses.size(); subpass_idx++) {
+            for(uint32_t attachment_idx = 0; attachment_idx < attachments.size(); attachment_idx++) {
+                const auto used_before = std::any_of(uses_attachment.begin(),
+                                                     uses_attachment.begin() + subpass_idx,
+                                                     [&](const std::vector<bool>& uses) { return uses[attachment_idx]; });
+                const auto used_after = std::any_of(uses_attachment.begin() + subpass_idx + 1,
+                                                    uses_attachment.end(),
+                                                    [&](const std::vector<bool>& uses) { return uses[attachment_idx]; });
+                if(used_before && used_after && !uses_attachment[subpass_idx][attachment_idx]) {
+                    references[subpass_idx].preserved.push_back(attachment_idx);
+                }
+            }
+        }
+
+        std::vector<vk::SubpassDescription> subpass_descriptions;
+        subpass_descriptions.reserve(subpasses.size());
+        for(uint32_t subpass_idx = 0; subpass_idx < subpasses.size(); subpass_idx++) {
+            const auto& refs = references[subpass_idx];
+
+            vk::SubpassDescription description = {};
+            description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            description.inputAttachmentCount = static_cast<uint32_t>(refs.inputs.size());
+            description.pInputAttachments = refs.inputs.data();
+            description.colorAttachmentCount = static_cast<uint32_t>(refs.color.size());
+            description.pColorAttachments = refs.color.data();
+            description.pDepthStencilAttachment = subpasses[subpass_idx].depth_texture ? &refs.depth : nullptr;
+            description.preserveAttachmentCount = static_cast<uint32_t>(refs.preserved.size());
+            description.pPreserveAttachments = refs.preserved.data();
+
+            subpass_descriptions.push_back(description);
+        }
+
+        std::vector<vk::SubpassDependency> dependencies;
+
+        vk::SubpassDependency image_available_dependency = {};
+        image_available_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        image_available_dependency.dstSubpass = 0;
+        image_available_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        image_available_dependency.srcAccessMask = 0;
+        image_available_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        image_available_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies.push_back(image_available_dependency);
+
+        // Every subpass only reads the pixel it's shading, so each subpass waits for the region it covers instead of the whole framebuffer
+        constexpr auto attachment_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        for(uint32_t dst_subpass = 1; dst_subpass < subpasses.size(); dst_subpass++) {
+            for(uint32_t src_subpass = 0; src_subpass < dst_subpass; src_subpass++) {
+                bool shares_attachments = false;
+                for(uint32_t attachment_idx = 0; attachment_idx < attachments.size(); attachment_idx++) {
+                    shares_attachments |= uses_attachment[src_subpass][attachment_idx] && uses_attachment[dst_subpass][attachment_idx];
+                }
+
+                if(!shares_attachments) {
+                    continue;
+                }
+
+                vk::SubpassDependency dependency = {};
+                dependency.srcSubpass = src_subpass;
+                dependency.dstSubpass = dst_subpass;
+                dependency.srcStageMask = attachment_stages;
+                dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dstStageMask = attachment_stages | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+                dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                           VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+                dependencies.push_back(dependency);
+            }
+        }
+
+        vk::RenderPassCreateInfo render_pass_create_info = {};
+        render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        render_pass_create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+        render_pass_create_info.pAttachments = attachments.data();
+        render_pass_create_info.subpassCount = static_cast<uint32_t>(subpass_descriptions.size());
+        render_pass_create_info.pSubpasses = subpass_descriptions.data();
+        render_pass_create_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        render_pass_create_info.pDependencies = dependencies.data();
+
+        auto* renderpass = internal_allocator.create<VulkanRenderpass>();
+        if(const auto result = vkCreateRenderPass(device, &render_pass_create_info, allocation_callbacks, &renderpass->pass);
+           result != VK_SUCCESS) {
+            internal_allocator.deallocate(reinterpret_cast<uint8_t*>(renderpass));
+            return ntl::Result<RhiRenderpass*>(
+                MAKE_ERROR("Could not create the renderpass that starts with pass {}: {}", subpasses.front().name, to_string(result)));
+        }
+
+        renderpass->render_area = {.offset = {0, 0}, .extent = {framebuffer_size.x, framebuffer_size.y}};
+        renderpass->cached_pipelines.resize(subpasses.size());
+
+        if(settings->debug.enabled) {
+            std::string name;
+            for(const renderpack::RenderPassCreateInfo& subpass : subpasses) {
+                name += name.empty() ? subpass.name : "+" + subpass.name;
+            }
+
+            vk::DebugUtilsObjectNameInfoEXT object_name = {};
+            object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+            object_name.objectType = VK_OBJECT_TYPE_RENDER_PASS;
+            object_name.objectHandle = reinterpret_cast<uint64_t>(static_cast<VkRenderPass>(renderpass->pass));
+            object_name.pObjectName = name.data();
+            NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &object_name));
+        }
+
+        return ntl::Result(static_cast<RhiRenderpass*>(renderpass));
+    }
+
     RhiFramebuffer* VulkanRenderDevice::create_framebuffer(const RhiRenderpass* renderpass,
                                                            const std::vector<RhiImage*>& color_attachments,
                                                            const std::optional<RhiImage*> depth_attachment,
+                                                           const std::optional<RhiImage*> shading_rate_attachment,
                                                            const glm::uvec2& framebuffer_size,
                                                            rx::memory::allocator& allocator) {
         const auto* vk_renderpass = static_cast<const VulkanRenderpass*>(renderpass);
@@ -263,15 +698,87 @@ namespace nova::renderer::rhi {
         std::vector<vk::ImageView> attachment_views(&allocator);
         attachment_views.reserve(color_attachments.size() + 1);
 
-        color_attachments.each_fwd([&](const RhiImage* attachment) {
+        // Multisampled passes render to the images' multisampled copies, and resolve them into the images themselves
+        const auto is_multisampled = vk_renderpass->num_samples != vk::SampleCountFlagBits::e1;
+        std::vector<vk::ImageView> resolve_views;
+        std::vector<vk::ImageMemoryBarrier> multisampled_barriers;
+
+        const auto add_attachment = [&](const RhiImage* attachment, const bool is_resolved) {
             const auto* vk_image = static_cast<const VulkanImage*>(attachment);
-            attachment_views.push_back(vk_image->image_view);
-        });
+            if(!is_multisampled) {
+                attachment_views.push_back(vk_image->image_view);
+                resolve_views.push_back(VK_NULL_HANDLE);
+                return true;
+            }
+
+            if(vk_image->num_samples != vk_renderpass->num_samples) {
+                return false;
+            }
+
+            attachment_views.push_back(vk_image->multisampled_view);
+            resolve_views.push_back(is_resolved ? vk_image->image_view : VK_NULL_HANDLE);
+
+            vk::ImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = vk_image->multisampled_image;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            if(vk_image->is_depth_tex) {
+                barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 
-        // Depth attachment is ALWAYS the last attachment
+            } else {
+                barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            }
+            multisampled_barriers.push_back(barrier);
+
+            return true;
+        };
+
+        bool has_every_copy = true;
+        for(const RhiImage* attachment : color_attachments) {
+            has_every_copy &= add_attachment(attachment, true);
+        }
+
+        // Depth attachment is ALWAYS the last attachment, but a vk::Framebuffer has its resolve attachments after it
         if(depth_attachment) {
-            const auto* vk_depth_image = static_cast<const VulkanImage*>(*depth_attachment);
-            attachment_views.push_back(vk_depth_image->image_view);
+            has_every_copy &= add_attachment(*depth_attachment, vk_renderpass->resolves_depth);
+        }
+
+        if(!has_every_copy) {
+            logger->error("Could not create a framebuffer: its renderpass is multisampled, but not all of its attachments have a "
+                          "multisampled copy with the same number of samples");
+            return nullptr;
+        }
+
+        if(is_multisampled && !vk_renderpass->uses_dynamic_rendering) {
+            for(uint32_t i = 0; i < color_attachments.size(); i++) {
+                attachment_views.push_back(resolve_views[i]);
+            }
+        }
+
+        auto* framebuffer = allocator.create<VulkanFramebuffer>();
+        framebuffer->size = framebuffer_size;
+        framebuffer->num_attachments = static_cast<uint32_t>(attachment_views.size());
+
+        // Dynamic rendering binds the views themselves, so there isn't a Vulkan object to create
+        if(vk_renderpass->uses_dynamic_rendering) {
+            framebuffer->attachment_views = std::move(attachment_views);
+            framebuffer->resolve_views = std::move(resolve_views);
+            framebuffer->multisampled_barriers = std::move(multisampled_barriers);
+            if(shading_rate_attachment && vk_renderpass->shading_rate_texel_size) {
+                framebuffer->shading_rate_view = static_cast<const VulkanImage*>(*shading_rate_attachment)->image_view;
+            }
+
+            return framebuffer;
         }
 
         vk::FramebufferCreateInfo framebuffer_create_info = {};
@@ -283,12 +790,7 @@ namespace nova::renderer::rhi {
         framebuffer_create_info.height = framebuffer_size.y;
         framebuffer_create_info.layers = 1;
 
-        auto* framebuffer = allocator.create<VulkanFramebuffer>();
-        framebuffer->size = framebuffer_size;
-        framebuffer->num_attachments = static_cast<uint32_t>(attachment_views.size());
-
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(allocator);
-        NOVA_CHECK_RESULT(vkCreateFramebuffer(device, &framebuffer_create_info, &vk_alloc, &framebuffer->framebuffer));
+        NOVA_CHECK_RESULT(vkCreateFramebuffer(device, &framebuffer_create_info, allocation_callbacks, &framebuffer->framebuffer));
 
         return framebuffer;
     }
@@ -322,127 +824,433 @@ namespace nova::renderer::rhi {
         return pipeline;
     }
 
+    /*!
+     * \brief Describes the shader's specialization constants to Vulkan. The info points at the shader's constants and at `entries`
+     */
+    static vk::SpecializationInfo get_specialization_info(const ShaderSource& shader, std::vector<vk::SpecializationMapEntry>& entries) {
+        const auto& constants = shader.specialization_constants;
+
+        entries.clear();
+        entries.reserve(constants.size());
+        for(uint32_t i = 0; i < constants.size(); i++) {
+            entries.emplace_back(constants[i].constant_id,
+                                 static_cast<uint32_t>(i * sizeof(SpecializationConstant) + offsetof(SpecializationConstant, value)),
+                                 sizeof(uint32_t));
+        }
+
+        return vk::SpecializationInfo()
+            .setMapEntryCount(static_cast<uint32_t>(entries.size()))
+            .setPMapEntries(entries.data())
+            .setDataSize(constants.size() * sizeof(SpecializationConstant))
+            .setPData(constants.data());
+    }
+
+    std::unique_ptr<RhiPipeline> VulkanRenderDevice::create_compute_pipeline(const RhiComputePipelineState& pipeline_state) {
+        ZoneScoped;
+        const auto shader_module = create_shader_module(pipeline_state.compute_shader.source);
+        if(!shader_module) {
+            logger->error("Could not create the compute shader module for pipeline {}", pipeline_state.name);
+            return nullptr;
+        }
+
+        auto pipeline = std::make_unique<VulkanComputePipeline>();
+        pipeline->name = pipeline_state.name;
+        pipeline->layout = create_pipeline_layout(get_all_descriptors(pipeline_state));
+
+        std::vector<vk::SpecializationMapEntry> specialization_entries;
+        const auto specialization_info = get_specialization_info(pipeline_state.compute_shader, specialization_entries);
+
+        auto shader_stage = vk::PipelineShaderStageCreateInfo()
+                                .setStage(vk::ShaderStageFlagBits::eCompute)
+                                .setModule(*shader_module)
+                                .setPName("main");
+        if(!specialization_entries.empty()) {
+            shader_stage.setPSpecializationInfo(&specialization_info);
+        }
+
+        const auto pipeline_create_info = vk::ComputePipelineCreateInfo().setStage(shader_stage).setLayout(pipeline->layout.layout);
+
+        const auto result = device.createComputePipelines(pipeline_cache,
+                                                          1,
+                                                          &pipeline_create_info,
+                                                          vk_allocation_callbacks,
+                                                          &pipeline->pipeline);
+
+        // The pipeline has its own copy of the shader code, so we don't need the module anymore
+        device.destroyShaderModule(*shader_module, vk_allocation_callbacks);
+
+        if(result != vk::Result::eSuccess) {
+            logger->error("Could not compile compute pipeline {}: {}", pipeline_state.name, vk::to_string(result));
+            return nullptr;
+        }
+
+        if(settings->debug.enabled) {
+            vk::DebugUtilsObjectNameInfoEXT object_name = {};
+            object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+            object_name.objectType = VK_OBJECT_TYPE_PIPELINE;
+            object_name.objectHandle = reinterpret_cast<uint64_t>(static_cast<VkPipeline>(pipeline->pipeline));
+            object_name.pObjectName = pipeline_state.name.data();
+            NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &object_name));
+        }
+
+        return pipeline;
+    }
+
+    bool VulkanRenderDevice::compile_pipeline(RhiPipeline& pipeline, const RhiRenderpass& renderpass, const uint32_t subpass) {
+        ZoneScoped;
+        auto& vk_pipeline = static_cast<VulkanPipeline&>(pipeline);
+        const auto& vk_renderpass = static_cast<const VulkanRenderpass&>(renderpass);
+
+        const auto pipeline_result = compile_pipeline_state(vk_pipeline, vk_renderpass, subpass, internal_allocator);
+        if(!pipeline_result) {
+            logger->error("Could not compile pipeline {}", vk_pipeline.state.name);
+            return false;
+        }
+
+        vk_pipeline.compiled_pipeline = *pipeline_result;
+        vk_pipeline.compiled_renderpass = &vk_renderpass;
+        vk_pipeline.compiled_subpass = subpass;
+
+        return true;
+    }
+
     std::unique_ptr<RhiResourceBinder> VulkanRenderDevice::create_resource_binder_for_pipeline(const RhiPipeline& pipeline,
                                                                                                rx::memory::allocator& allocator) {
-        const auto& vk_pipeline = static_cast<const VulkanPipeline&>(pipeline);
-
-        auto descriptors = create_descriptors(vk_pipeline.layout.descriptor_set_layouts,
-                                              vk_pipeline.layout.variable_descriptor_set_counts,
-                                              allocator);
+        // Graphics and compute pipelines both keep their layout in the base struct
+        const auto& vk_pipeline = static_cast<const VulkanPipelineBase&>(pipeline);
 
+        // The binder allocates its descriptor sets the first time each frame slot uses it
         return std::make_unique<VulkanResourceBinder>(&allocator,
                                                       *this,
                                                       vk_pipeline.layout.bindings,
-                                                      descriptors,
+                                                      vk_pipeline.layout.descriptor_set_layouts,
+                                                      vk_pipeline.layout.variable_descriptor_set_counts,
                                                       vk_pipeline.layout.layout,
                                                       allocator);
     }
 
-    std::optional<vk::DescriptorPool> VulkanRenderDevice::create_descriptor_pool(
-        const std::unordered_map<DescriptorType, uint32_t>& descriptor_capacity, rx::memory::allocator& allocator) {
+    vk::DescriptorSet VulkanRenderDevice::get_standard_descriptor_set(const uint32_t frame_idx) const {
+        return standard_descriptor_sets[frame_idx].set;
+    }
+
+    void VulkanRenderDevice::update_standard_descriptors(const uint32_t frame_idx,
+                                                         RhiBuffer* camera_buffer,
+                                                         RhiBuffer* material_buffer,
+                                                         RhiBuffer* model_matrix_buffer,
+                                                         RhiBuffer* vertex_layouts,
+                                                         RhiSampler* point_sampler,
+                                                         RhiSampler* bilinear_sampler,
+                                                         RhiSampler* trilinear_sampler,
+                                                         RhiBuffer* virtual_page_table,
+                                                         RhiBuffer* virtual_texture_feedback,
+                                                         RhiImage* virtual_texture_cache,
+                                                         RhiBuffer* light_cluster_params,
+                                                         RhiBuffer* lights,
+                                                         RhiBuffer* light_clusters,
+                                                         RhiBuffer* light_indices,
+                                                         RhiBuffer* particles,
+                                                         RhiImage* volumetric_fog,
+                                                         const std::span<RhiBuffer* const> vertex_buffers,
+                                                         const std::span<RhiImage* const> textures) {
         ZoneScoped;
-        std::vector<vk::DescriptorPoolSize> pool_sizes{&internal_allocator};
+        if(standard_descriptor_sets.size() <= frame_idx) {
+            std::lock_guard lock{standard_descriptor_set_mutex};
+
+            while(standard_descriptor_sets.size() <= frame_idx) {
+                auto allocation = persistent_descriptors->allocate({standard_set_layout}, {MAX_NUM_TEXTURES});
+                if(!allocation) {
+                    logger->error("Could not allocate the standard descriptor set for frame slot {}", frame_idx);
+                    return;
+                }
 
-        uint32_t max_sets = 0;
-        descriptor_capacity.each_pair([&](const DescriptorType& type, const uint32_t count) {
-            pool_sizes.emplace_back(vk::DescriptorPoolSize{to_vk_descriptor_type(type), count});
-            max_sets += count;
-        });
+                StandardDescriptorSet standard_set;
+                standard_set.set = allocation->sets[0];
 
-        const auto pool_create_info = vk::DescriptorPoolCreateInfo()
-                                          .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind)
-                                          .setMaxSets(max_sets)
-                                          .setPoolSizeCount(static_cast<uint32_t>(pool_sizes.size()))
-                                          .setPPoolSizes(pool_sizes.data());
+                if(settings->debug.enabled) {
+                    const auto set_name = fmt::format("Standard descriptor set {}", standard_descriptor_sets.size());
+                    vk::DebugUtilsObjectNameInfoEXT object_name = {};
+                    object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+                    object_name.objectType = VK_OBJECT_TYPE_DESCRIPTOR_SET;
+                    object_name.objectHandle = reinterpret_cast<uint64_t>(static_cast<vk::DescriptorSet>(standard_set.set));
+                    object_name.pObjectName = set_name.c_str();
 
-        vk::DescriptorPool pool;
-        const auto& vk_alloc = wrap_allocator(allocator);
-        device.createDescriptorPool(&pool_create_info, &vk_alloc, &pool);
+                    NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &object_name));
+                }
 
-        return pool;
-    }
+                standard_descriptor_sets.push_back(std::move(standard_set));
+            }
+        }
 
-    vk::DescriptorSet VulkanRenderDevice::get_next_standard_descriptor_set() {
-        if(standard_descriptor_sets.is_empty()) {
-            const auto variable_set_counts = std::array{MAX_NUM_TEXTURES};
-            const auto count_allocate_info = vk::DescriptorSetVariableDescriptorCountAllocateInfo()
-                                                 .setPDescriptorCounts(variable_set_counts.data())
-                                                 .setDescriptorSetCount(static_cast<uint32_t>(variable_set_counts.size()));
+        auto& standard_set = standard_descriptor_sets[frame_idx];
+        const auto set = standard_set.set;
+
+        // The buffers, samplers, page cache, and fog volume are only a few dozen descriptors, and a recreated buffer may get the same
+        // handle as the buffer it replaced, so they're always rewritten. The textures array is the big one, so we only write the elements
+        // that point somewhere new
+        const auto* vk_camera_buffer = static_cast<VulkanBuffer*>(camera_buffer);
+        const auto camera_buffer_write = vk::DescriptorBufferInfo()
+                                             .setOffset(0)
+                                             .setRange(vk_camera_buffer->size.b_count())
+                                             .setBuffer(vk_camera_buffer->buffer);
+        const auto camera_buffer_descriptor_type = vk_camera_buffer->size < gpu.props.limits.maxUniformBufferRange ?
+                                                       vk::DescriptorType::eUniformBuffer :
+                                                       vk::DescriptorType::eStorageBuffer;
 
-            const auto allocate_info = vk::DescriptorSetAllocateInfo()
-                                           .setDescriptorPool(standard_descriptor_set_pool)
-                                           .setDescriptorSetCount(1)
-                                           .setPSetLayouts(&standard_set_layout)
-                                           .setPNext(&count_allocate_info);
+        const auto* vk_material_buffer = static_cast<VulkanBuffer*>(material_buffer);
+        const auto material_buffer_write = vk::DescriptorBufferInfo()
+                                               .setOffset(0)
+                                               .setRange(vk_material_buffer->size.b_count())
+                                               .setBuffer(vk_material_buffer->buffer);
+
+        const auto* vk_model_matrix_buffer = static_cast<VulkanBuffer*>(model_matrix_buffer);
+        const auto model_matrix_buffer_write = vk::DescriptorBufferInfo()
+                                                   .setOffset(0)
+                                                   .setRange(vk_model_matrix_buffer->size.b_count())
+                                                   .setBuffer(vk_model_matrix_buffer->buffer);
+
+        const auto point_sampler_write = vk::DescriptorImageInfo().setSampler(static_cast<VulkanSampler*>(point_sampler)->sampler);
+        const auto bilinear_sampler_write = vk::DescriptorImageInfo().setSampler(static_cast<VulkanSampler*>(bilinear_sampler)->sampler);
+        const auto trilinear_sampler_write = vk::DescriptorImageInfo().setSampler(static_cast<VulkanSampler*>(trilinear_sampler)->sampler);
+
+        const auto* vk_page_table = static_cast<VulkanBuffer*>(virtual_page_table);
+        const auto page_table_write = vk::DescriptorBufferInfo()
+                                          .setOffset(0)
+                                          .setRange(vk_page_table->size.b_count())
+                                          .setBuffer(vk_page_table->buffer);
+
+        const auto* vk_feedback_buffer = static_cast<VulkanBuffer*>(virtual_texture_feedback);
+        const auto feedback_buffer_write = vk::DescriptorBufferInfo()
+                                               .setOffset(0)
+                                               .setRange(vk_feedback_buffer->size.b_count())
+                                               .setBuffer(vk_feedback_buffer->buffer);
+
+        const auto page_cache_write = vk::DescriptorImageInfo()
+                                          .setImageView(static_cast<const VulkanImage*>(virtual_texture_cache)->image_view)
+                                          .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        const auto whole_buffer_write = [](const RhiBuffer* buffer) {
+            const auto* vk_buffer = static_cast<const VulkanBuffer*>(buffer);
+            return vk::DescriptorBufferInfo().setOffset(0).setRange(vk_buffer->size.b_count()).setBuffer(vk_buffer->buffer);
+        };
+        const auto light_cluster_params_write = whole_buffer_write(light_cluster_params);
+        const auto lights_write = whole_buffer_write(lights);
+        const auto clusters_write = whole_buffer_write(light_clusters);
+        const auto light_indices_write = whole_buffer_write(light_indices);
+        const auto particles_write = whole_buffer_write(particles);
+        const auto vertex_layouts_write = whole_buffer_write(vertex_layouts);
+
+        // Vertex arena buffers may be bigger than a storage buffer binding can see, in which case shaders can only pull the vertices near
+        // the start of them
+        const auto num_vertex_buffers = std::min(static_cast<uint32_t>(vertex_buffers.size()), MAX_NUM_VERTEX_BUFFERS);
+        std::array<vk::DescriptorBufferInfo, MAX_NUM_VERTEX_BUFFERS> vertex_buffer_writes;
+        for(uint32_t i = 0; i < num_vertex_buffers; i++) {
+            const auto* vk_buffer = static_cast<const VulkanBuffer*>(vertex_buffers[i]);
+            vertex_buffer_writes[i] = vk::DescriptorBufferInfo()
+                                          .setOffset(0)
+                                          .setRange(std::min<vk::DeviceSize>(vk_buffer->size.b_count(),
+                                                                             gpu.props.limits.maxStorageBufferRange))
+                                          .setBuffer(vk_buffer->buffer);
+        }
 
-            vk::DescriptorSet set;
-            device.allocateDescriptorSets(&allocate_info, &set);
+        // The volumetric fog only leaves the ShaderReadOnlyOptimal layout while it's being integrated
+        const auto volumetric_fog_write = vk::DescriptorImageInfo()
+                                              .setImageView(static_cast<const VulkanImage*>(volumetric_fog)->image_view)
+                                              .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        VulkanScratchMemory<4096> scratch;
+
+        std::pmr::vector<vk::WriteDescriptorSet> writes{&scratch.resource};
+        writes.reserve(20);
+        writes.insert(writes.end(), {
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(0)
+                .setDescriptorCount(1)
+                .setDescriptorType(camera_buffer_descriptor_type)
+                .setPBufferInfo(&camera_buffer_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(1)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&material_buffer_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(2)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eSampler)
+                .setPImageInfo(&point_sampler_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(3)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eSampler)
+                .setPImageInfo(&bilinear_sampler_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(4)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eSampler)
+                .setPImageInfo(&trilinear_sampler_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(5)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&model_matrix_buffer_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(6)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&page_table_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(7)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&feedback_buffer_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(8)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eSampledImage)
+                .setPImageInfo(&page_cache_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(9)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&light_cluster_params_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(10)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&lights_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(11)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&clusters_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(12)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&light_indices_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(13)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&particles_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(14)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eSampledImage)
+                .setPImageInfo(&volumetric_fog_write),
+            vk::WriteDescriptorSet()
+                .setDstSet(set)
+                .setDstBinding(15)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setPBufferInfo(&vertex_layouts_write),
+        });
 
-            if(settings->debug.enabled) {
-                vk::DebugUtilsObjectNameInfoEXT object_name = {};
-                object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
-                object_name.objectType = VK_OBJECT_TYPE_DESCRIPTOR_SET;
-                object_name.objectHandle = reinterpret_cast<uint64_t>(static_cast<vk::DescriptorSet>(set));
-                object_name.pObjectName = "Standard descriptor set";
+        // The vertex buffer array is partially bound, so the elements past the arena's last buffer can stay empty
+        if(num_vertex_buffers > 0) {
+            writes.push_back(vk::WriteDescriptorSet()
+                                 .setDstSet(set)
+                                 .setDstBinding(16)
+                                 .setDescriptorCount(num_vertex_buffers)
+                                 .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                 .setPBufferInfo(vertex_buffer_writes.data()));
+        }
 
-                NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &object_name));
+        auto num_textures = static_cast<uint32_t>(textures.size());
+        if(num_textures > MAX_NUM_TEXTURES) {
+            logger->error("There are {} textures, but only {} fit in the textures array. The extras won't be bound",
+                          num_textures,
+                          MAX_NUM_TEXTURES);
+            num_textures = MAX_NUM_TEXTURES;
+        }
+
+        // Reserved before the first changed texture is added, so the writes can point into it. Most frames don't change any textures, and
+        // don't reserve anything
+        std::pmr::vector<vk::DescriptorImageInfo> texture_infos{&scratch.resource};
+
+        // Elements past the end of `textures` keep pointing at whatever they did before. The array is partially bound, so that's fine as
+        // long as no shader reads them
+        standard_set.textures.resize(std::max<size_t>(standard_set.textures.size(), num_textures));
+        for(uint32_t i = 0; i < num_textures; i++) {
+            const auto image_view = static_cast<const VulkanImage*>(textures[i])->image_view;
+            if(standard_set.textures[i] == image_view) {
+                continue;
             }
+            standard_set.textures[i] = image_view;
 
-            return set;
+            if(texture_infos.empty()) {
+                texture_infos.reserve(num_textures - i);
+            }
 
-        } else {
-            const auto set = standard_descriptor_sets.last();
-            standard_descriptor_sets.pop_back();
+            // Adjacent changed elements share one write
+            const auto continues_last_write = !texture_infos.empty() && writes.back().dstBinding == 17 &&
+                                              writes.back().dstArrayElement + writes.back().descriptorCount == i;
+
+            texture_infos.push_back(
+                vk::DescriptorImageInfo().setImageView(image_view).setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal));
+
+            if(continues_last_write) {
+                writes.back().descriptorCount++;
 
-            return set;
+            } else {
+                writes.push_back(vk::WriteDescriptorSet()
+                                     .setDstSet(set)
+                                     .setDstBinding(17)
+                                     .setDstArrayElement(i)
+                                     .setDescriptorCount(1)
+                                     .setDescriptorType(vk::DescriptorType::eSampledImage)
+                                     .setPImageInfo(&texture_infos.back()));
+            }
         }
-    }
 
-    void VulkanRenderDevice::return_standard_descriptor_sets(const std::vector<vk::DescriptorSet>& sets) {
-        standard_descriptor_sets += sets;
+        device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
     }
 
-    std::vector<vk::DescriptorSet> VulkanRenderDevice::create_descriptors(
-        const std::vector<vk::DescriptorSetLayout>& descriptor_set_layouts,
-        const std::vector<uint32_t>& variable_descriptor_max_counts,
-        rx::memory::allocator& allocator) const {
+    std::optional<VulkanDescriptorAllocation> VulkanRenderDevice::create_descriptors(
+        const std::vector<vk::DescriptorSetLayout>& descriptor_set_layouts, const std::vector<uint32_t>& variable_descriptor_max_counts) {
         RX_ASSERT(descriptor_set_layouts.size() == variable_descriptor_max_counts.size(),
                   "Descriptor set layous and varaible descriptor counts must be the same size");
 
-        const auto variable_descriptor_counts = vk::DescriptorSetVariableDescriptorCountAllocateInfo()
-                                                    .setDescriptorSetCount(static_cast<uint32_t>(variable_descriptor_max_counts.size()))
-                                                    .setPDescriptorCounts(variable_descriptor_max_counts.data());
+        return persistent_descriptors->allocate(descriptor_set_layouts, variable_descriptor_max_counts);
+    }
 
-        const auto allocate_info = vk::DescriptorSetAllocateInfo()
-                                       .setDescriptorSetCount(static_cast<uint32_t>(descriptor_set_layouts.size()))
-                                       .setPSetLayouts(descriptor_set_layouts.data())
-                                       .setDescriptorPool(standard_descriptor_set_pool)
-                                       .setPNext(&variable_descriptor_counts);
+    void VulkanRenderDevice::destroy_descriptors(VulkanDescriptorAllocation allocation) {
+        // Every frame's graphics submission waits on the rest of the frame's work, so once it's done nothing else can be using the sets
+        defer_until_submissions_finish(QueueType::Graphics, [this, allocation = std::move(allocation)] {
+            persistent_descriptors->free(allocation);
+        });
+    }
 
-        std::vector<vk::DescriptorSet> sets{&allocator, descriptor_set_layouts.size()};
-        device.allocateDescriptorSets(&allocate_info, sets.data());
+    std::optional<VulkanDescriptorAllocation> VulkanRenderDevice::create_transient_descriptors(
+        const std::vector<vk::DescriptorSetLayout>& descriptor_set_layouts, const std::vector<uint32_t>& variable_descriptor_max_counts) {
+        RX_ASSERT(descriptor_set_layouts.size() == variable_descriptor_max_counts.size(),
+                  "Descriptor set layous and varaible descriptor counts must be the same size");
 
-        return sets;
+        return transient_descriptors[cur_frame_idx]->allocate(descriptor_set_layouts, variable_descriptor_max_counts);
     }
 
-    vk::Fence VulkanRenderDevice::get_next_submission_fence() {
-        if(submission_fences.is_empty()) {
-            const auto fence_create_info = vk::FenceCreateInfo();
-            vk::Fence fence;
-            device.createFence(&fence_create_info, &vk_internal_allocator, &fence);
-
-            return fence;
-
-        } else {
-            const auto fence = submission_fences.last();
-            submission_fences.pop_back();
-
-            return fence;
-        }
+    void VulkanRenderDevice::defer_until_submissions_finish(const QueueType queue, std::function<void()> work) {
+        auto& timeline = *timelines_by_queue_type[static_cast<size_t>(queue)];
+        push_deferred_task(timeline, timeline.last_submitted_value.load(), std::move(work));
     }
 
     ntl::Result<vk::Pipeline> VulkanRenderDevice::compile_pipeline_state(const VulkanPipeline& pipeline_state,
                                                                          const VulkanRenderpass& renderpass,
+                                                                         const uint32_t subpass,
                                                                          rx::memory::allocator& allocator) {
         ZoneScoped;
         const auto& state = pipeline_state.state;
@@ -481,6 +1289,11 @@ namespace nova::renderer::rhi {
 
         } // namespace nova::renderer::rhi
 
+        // The stages point at these, so they can't move until the pipeline is created
+        std::array<std::vector<vk::SpecializationMapEntry>, 3> specialization_entries;
+        std::array<vk::SpecializationInfo, 3> specialization_infos;
+        uint32_t num_specialized_stages = 0;
+
         shader_modules.each_pair([&](const vk::ShaderStageFlags stage, const vk::ShaderModule shader_module) {
             vk::PipelineShaderStageCreateInfo shader_stage_create_info;
             shader_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -491,6 +1304,20 @@ namespace nova::renderer::rhi {
             shader_stage_create_info.pName = "main";
             shader_stage_create_info.pSpecializationInfo = nullptr;
 
+            const ShaderSource* shader = &state.vertex_shader;
+            if(stage == VK_SHADER_STAGE_GEOMETRY_BIT) {
+                shader = &*state.geometry_shader;
+            } else if(stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+                shader = &*state.pixel_shader;
+            }
+
+            if(!shader->specialization_constants.empty()) {
+                auto& info = specialization_infos[num_specialized_stages];
+                info = get_specialization_info(*shader, specialization_entries[num_specialized_stages]);
+                shader_stage_create_info.pSpecializationInfo = &info;
+                num_specialized_stages++;
+            }
+
             shader_stages.push_back(shader_stage_create_info);
         });
 
@@ -524,26 +1351,16 @@ namespace nova::renderer::rhi {
                 break;
         }
 
-        vk::Viewport viewport;
-        viewport.x = 0;
-        viewport.y = 0;
-        viewport.width = static_cast<float>(renderpass.render_area.extent.width);
-        viewport.height = static_cast<float>(renderpass.render_area.extent.height);
-        viewport.minDepth = 0.0F;
-        viewport.maxDepth = 1.0F;
-
-        vk::Rect2D scissor;
-        scissor.offset = {0, 0};
-        scissor.extent = {static_cast<uint32_t>(state.viewport_size.x), static_cast<uint32_t>(state.viewport_size.y)};
-
+        // The viewport and scissor are dynamic, so resizing the window doesn't mean recompiling every pipeline. Command lists set them to
+        // cover the whole framebuffer when they begin a renderpass
         vk::PipelineViewportStateCreateInfo viewport_state_create_info;
         viewport_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewport_state_create_info.pNext = nullptr;
         viewport_state_create_info.flags = 0;
         viewport_state_create_info.viewportCount = 1;
-        viewport_state_create_info.pViewports = &viewport;
+        viewport_state_create_info.pViewports = nullptr;
         viewport_state_create_info.scissorCount = 1;
-        viewport_state_create_info.pScissors = &scissor;
+        viewport_state_create_info.pScissors = nullptr;
 
         vk::PipelineRasterizationStateCreateInfo rasterizer_create_info;
         rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -572,7 +1389,7 @@ namespace nova::renderer::rhi {
         multisample_create_info.pNext = nullptr;
         multisample_create_info.flags = 0;
         multisample_create_info.sampleShadingEnable = VK_FALSE;
-        multisample_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        multisample_create_info.rasterizationSamples = renderpass.num_samples;
         multisample_create_info.minSampleShading = 1.0F;
         multisample_create_info.pSampleMask = nullptr;
         multisample_create_info.alphaToCoverageEnable = VK_FALSE;
@@ -624,6 +1441,14 @@ namespace nova::renderer::rhi {
         color_blend_create_info.logicOpEnable = VK_FALSE;
         color_blend_create_info.logicOp = VK_LOGIC_OP_COPY;
 
+        VkColorComponentFlags color_write_mask = 0;
+        if(state.enable_color_write) {
+            color_write_mask |= VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT;
+        }
+        if(state.enable_alpha_write) {
+            color_write_mask |= VK_COLOR_COMPONENT_A_BIT;
+        }
+
         std::vector<vk::PipelineColorBlendAttachmentState> attachment_states{&allocator};
         if(state.blend_state) {
             const auto& blend_state = *state.blend_state;
@@ -632,8 +1457,7 @@ namespace nova::renderer::rhi {
 
             blend_state.render_target_states.each_fwd([&](const RenderTargetBlendState& render_target_blend) {
                 vk::PipelineColorBlendAttachmentState color_blend_attachment;
-                color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
-                                                        VK_COLOR_COMPONENT_A_BIT;
+                color_blend_attachment.colorWriteMask = color_write_mask;
                 color_blend_attachment.blendEnable = render_target_blend.enable ? VK_TRUE : VK_FALSE;
                 color_blend_attachment.srcColorBlendFactor = to_blend_factor(render_target_blend.src_color_factor);
                 color_blend_attachment.dstColorBlendFactor = to_blend_factor(render_target_blend.dst_color_factor);
@@ -657,8 +1481,7 @@ namespace nova::renderer::rhi {
 
             state.color_attachments.each_fwd([&](const renderpack::TextureAttachmentInfo& /* attachment_info */) {
                 vk::PipelineColorBlendAttachmentState color_blend_attachment{};
-                color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
-                                                        VK_COLOR_COMPONENT_A_BIT;
+                color_blend_attachment.colorWriteMask = color_write_mask;
                 color_blend_attachment.blendEnable = VK_FALSE;
 
                 attachment_states.emplace_back(color_blend_attachment);
@@ -668,16 +1491,12 @@ namespace nova::renderer::rhi {
             color_blend_create_info.pAttachments = attachment_states.data();
         }
 
-        std::vector<vk::DynamicState> dynamic_states;
-
-        if(state.enable_scissor_test) {
-            dynamic_states.emplace_back(VK_DYNAMIC_STATE_SCISSOR);
-        }
+        static constexpr std::array DYNAMIC_STATES{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
 
         vk::PipelineDynamicStateCreateInfo dynamic_state_create_info = {};
         dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamic_state_create_info.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
-        dynamic_state_create_info.pDynamicStates = dynamic_states.data();
+        dynamic_state_create_info.dynamicStateCount = static_cast<uint32_t>(DYNAMIC_STATES.size());
+        dynamic_state_create_info.pDynamicStates = DYNAMIC_STATES.data();
 
         vk::GraphicsPipelineCreateInfo pipeline_create_info = {};
         pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -696,16 +1515,50 @@ namespace nova::renderer::rhi {
         pipeline_create_info.layout = pipeline_state.layout.layout;
 
         pipeline_create_info.renderPass = renderpass.pass;
-        pipeline_create_info.subpass = 0;
+        pipeline_create_info.subpass = subpass;
         pipeline_create_info.basePipelineIndex = -1;
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(allocator);
+        // Without a vk::RenderPass, the pipeline needs the attachment formats some other way
+        std::vector<vk::Format> color_formats{&allocator};
+        auto rendering_create_info = vk::PipelineRenderingCreateInfoKHR();
+        if(renderpass.uses_dynamic_rendering) {
+            color_formats.reserve(renderpass.color_attachments.size());
+            renderpass.color_attachments.each_fwd(
+                [&](const vk::AttachmentDescription& attachment) { color_formats.push_back(attachment.format); });
+
+            rendering_create_info.setViewMask(renderpass.view_mask)
+                .setColorAttachmentCount(static_cast<uint32_t>(color_formats.size()))
+                .setPColorAttachmentFormats(color_formats.data());
+            if(renderpass.depth_attachment) {
+                rendering_create_info.setDepthAttachmentFormat(renderpass.depth_attachment->format);
+            }
+
+            pipeline_create_info.pNext = &rendering_create_info;
+        }
+
+        // The attachment's rate is combined with the pass's fixed rate. Taking the coarser of the two needs non-trivial combiner ops, so
+        // devices without them just use the attachment's rate
+        auto shading_rate_create_info = vk::PipelineFragmentShadingRateStateCreateInfoKHR();
+        if(renderpass.fragment_size || renderpass.shading_rate_texel_size) {
+            auto attachment_combiner_op = vk::FragmentShadingRateCombinerOpKHR::eKeep;
+            if(renderpass.shading_rate_texel_size) {
+                attachment_combiner_op = vk_info.supports_shading_rate_combiner_ops ? vk::FragmentShadingRateCombinerOpKHR::eMax :
+                                                                                      vk::FragmentShadingRateCombinerOpKHR::eReplace;
+                pipeline_create_info.flags |= vk::PipelineCreateFlagBits::eRenderingFragmentShadingRateAttachmentKHR;
+            }
+
+            shading_rate_create_info.setFragmentSize(renderpass.fragment_size.value_or(vk::Extent2D{1, 1}))
+                .setCombinerOps({vk::FragmentShadingRateCombinerOpKHR::eKeep, attachment_combiner_op})
+                .setPNext(pipeline_create_info.pNext);
+            pipeline_create_info.pNext = &shading_rate_create_info;
+        }
+
         vk::Pipeline pipeline;
         const auto result = vkCreateGraphicsPipelines(device,
-                                                      nullptr,
+                                                      pipeline_cache,
                                                       1,
                                                       &pipeline_create_info,
-                                                      &vk_alloc,
+                                                      allocation_callbacks,
                                                       reinterpret_cast<vk::Pipeline*>(&pipeline));
         if(result != VK_SUCCESS) {
             return ntl::Result<vk::Pipeline>{MAKE_ERROR("Could not compile pipeline %s", state.name)};
@@ -733,6 +1586,10 @@ namespace nova::renderer::rhi {
         vk_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
         VmaAllocationCreateInfo vma_alloc{};
+        vma_alloc.priority = info.residency_priority;
+
+        // Whether to try to put the buffer somewhere the CPU can write to it directly, so uploads to it don't need a staging copy
+        bool prefer_host_visible_device_memory = false;
 
         switch(info.buffer_usage) {
             case BufferUsage::UniformBuffer: {
@@ -746,14 +1603,20 @@ namespace nova::renderer::rhi {
                 vma_alloc.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
             } break;
 
+            // Mesh buffers can be copied from so that defragmentation can move them
             case BufferUsage::IndexBuffer: {
-                vk_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+                vk_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
                 vma_alloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+                prefer_host_visible_device_memory = this->info.has_host_visible_device_memory;
             } break;
 
+            // Vertex shaders that pull their own vertices read vertex buffers as storage buffers
             case BufferUsage::VertexBuffer: {
-                vk_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+                vk_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
                 vma_alloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+                prefer_host_visible_device_memory = this->info.has_host_visible_device_memory;
             } break;
 
             case BufferUsage::StagingBuffer: {
@@ -761,16 +1624,87 @@ namespace nova::renderer::rhi {
                 vma_alloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
                 vma_alloc.usage = VMA_MEMORY_USAGE_CPU_ONLY;
             } break;
+
+            case BufferUsage::StorageBuffer: {
+                vk_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+                vma_alloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+                vma_alloc.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+            } break;
+
+            case BufferUsage::DeviceStorageBuffer: {
+                vk_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+                vma_alloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+            } break;
+
+            case BufferUsage::UploadBuffer: {
+                vk_create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+                vma_alloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+                vma_alloc.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+            } break;
+
+            case BufferUsage::HostVisibleMeshBuffer: {
+                vk_create_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+                vma_alloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+                vma_alloc.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+                vma_alloc.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            } break;
+
+            case BufferUsage::ReadbackBuffer: {
+                vk_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+                vma_alloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+                vma_alloc.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+            } break;
+
+            case BufferUsage::ComputeVertexBuffer: {
+                vk_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+                vma_alloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+            } break;
+        }
+
+        // Defragmentation finds the buffer that it's moving through the allocation's user data
+        auto pooled_alloc = vma_alloc;
+        pooled_alloc.pool = get_buffer_memory_pool(info.buffer_usage);
+        pooled_alloc.pUserData = static_cast<RhiResource*>(buffer);
+
+        auto result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        if(prefer_host_visible_device_memory) {
+            VmaAllocationCreateInfo host_visible_alloc{};
+            host_visible_alloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            host_visible_alloc.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            host_visible_alloc.preferredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            host_visible_alloc.priority = info.residency_priority;
+
+            result = vmaCreateBuffer(vma,
+                                     &vk_create_info,
+                                     &host_visible_alloc,
+                                     &buffer->buffer,
+                                     &buffer->allocation,
+                                     &buffer->allocation_info);
+            if(result != VK_SUCCESS) {
+                // The host-visible heap is full. The buffer still works in plain device memory, it just gets uploaded through staging
+                logger->debug("Could not put buffer %s in host-visible device memory, falling back to device-only memory", info.name);
+            }
+        }
+
+        if(result != VK_SUCCESS && pooled_alloc.pool != VK_NULL_HANDLE) {
+            result = vmaCreateBuffer(vma, &vk_create_info, &pooled_alloc, &buffer->buffer, &buffer->allocation, &buffer->allocation_info);
+            if(result != VK_SUCCESS) {
+                // Either the pool is full or the buffer is bigger than one of its blocks. The default pools can still take it
+                logger->warn("Could not allocate buffer {} from its memory pool, falling back to the default pools", info.name);
+            }
+        }
+
+        if(result != VK_SUCCESS) {
+            result = vmaCreateBuffer(vma, &vk_create_info, &vma_alloc, &buffer->buffer, &buffer->allocation, &buffer->allocation_info);
         }
 
-        const auto result = vmaCreateBuffer(vma,
-                                            &vk_create_info,
-                                            &vma_alloc,
-                                            &buffer->buffer,
-                                            &buffer->allocation,
-                                            &buffer->allocation_info);
         if(result == VK_SUCCESS) {
             buffer->size = info.size;
+            buffer->usage = vk_create_info.usage;
+
+            track_allocation(buffer->allocation, get_memory_category(info.buffer_usage), info.owner, info.name);
 
             if(settings->debug.enabled) {
                 vk::DebugUtilsObjectNameInfoEXT object_name = {};
@@ -798,9 +1732,101 @@ namespace nova::renderer::rhi {
         memcpy(vulkan_buffer->allocation_info.pMappedData, data, num_bytes.b_count());
     }
 
-    RhiSampler* VulkanRenderDevice::create_sampler(const RhiSamplerCreateInfo& create_info, rx::memory::allocator& allocator) {
+    void VulkanRenderDevice::write_data_to_buffer(const void* data,
+                                                  const Bytes num_bytes,
+                                                  const Bytes offset,
+                                                  const RhiBuffer* buffer) {
+        ZoneScoped;
+        const auto* vulkan_buffer = static_cast<const VulkanBuffer*>(buffer);
+
+        memcpy(static_cast<uint8_t*>(vulkan_buffer->allocation_info.pMappedData) + offset.b_count(), data, num_bytes.b_count());
+    }
+
+    void* VulkanRenderDevice::get_mapped_data(const RhiBuffer* buffer) {
+        return static_cast<const VulkanBuffer*>(buffer)->allocation_info.pMappedData;
+    }
+
+    void VulkanRenderDevice::flush_buffer(const RhiBuffer* buffer, const Bytes offset, const Bytes num_bytes) {
+        ZoneScoped;
+        const auto* vulkan_buffer = static_cast<const VulkanBuffer*>(buffer);
+
+        // VMA skips the flush for host-coherent memory, and rounds the range out to the non-coherent atom size for everything else
+        vmaFlushAllocation(vma, vulkan_buffer->allocation, offset.b_count(), num_bytes.b_count());
+    }
+
+    void VulkanRenderDevice::invalidate_buffer(const RhiBuffer* buffer, const Bytes offset, const Bytes num_bytes) {
+        ZoneScoped;
+        const auto* vulkan_buffer = static_cast<const VulkanBuffer*>(buffer);
+
+        vmaInvalidateAllocation(vma, vulkan_buffer->allocation, offset.b_count(), num_bytes.b_count());
+    }
+
+    std::vector<RhiMemoryHeapBudget> VulkanRenderDevice::get_memory_budgets() {
+        ZoneScoped;
+        std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> vma_budgets{};
+        vmaGetHeapBudgets(vma, vma_budgets.data());
+
+        std::vector<RhiMemoryHeapBudget> budgets(gpu.memory_properties.memoryHeapCount);
+        for(uint32_t i = 0; i < gpu.memory_properties.memoryHeapCount; i++) {
+            budgets[i].is_device_local = (gpu.memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+            budgets[i].usage = vma_budgets[i].usage;
+            budgets[i].budget = vma_budgets[i].budget;
+        }
+
+        return budgets;
+    }
+
+    std::vector<RhiMemoryPoolStats> VulkanRenderDevice::get_memory_pool_stats() {
+        ZoneScoped;
+        std::vector<RhiMemoryPoolStats> pool_stats;
+        pool_stats.reserve(memory_pools.size());
+        for(uint32_t i = 0; i < memory_pools.size(); i++) {
+            if(memory_pools[i] == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            VmaStatistics vma_stats{};
+            vmaGetPoolStatistics(vma, memory_pools[i], &vma_stats);
+
+            auto& stats = pool_stats.emplace_back();
+            stats.name = MEMORY_POOL_NAMES[i];
+            stats.num_blocks = vma_stats.blockCount;
+            stats.num_allocations = vma_stats.allocationCount;
+            stats.reserved_bytes = vma_stats.blockBytes;
+            stats.used_bytes = vma_stats.allocationBytes;
+        }
+
+        return pool_stats;
+    }
+
+    RhiMemoryAccounting VulkanRenderDevice::get_memory_accounting() {
+        ZoneScoped;
+        auto accounting = memory_tracker.get_accounting();
+
+        // Descriptor pools aren't VMA allocations, and Vulkan doesn't say how much memory they take, so all we can do is count them
+        auto& descriptors = accounting.categories[static_cast<size_t>(MemoryCategory::Descriptor)];
+        if(persistent_descriptors) {
+            descriptors.num_allocations += static_cast<uint32_t>(persistent_descriptors->get_num_pools());
+        }
+        for(const auto& frame_descriptors : transient_descriptors) {
+            descriptors.num_allocations += static_cast<uint32_t>(frame_descriptors->get_num_pools());
+        }
+
+        const auto host_stats = get_host_allocator_stats();
+        accounting.driver_host_bytes = host_stats.num_live_bytes;
+        accounting.peak_driver_host_bytes = host_stats.peak_live_bytes;
+
+        return accounting;
+    }
+
+    RhiSampler* VulkanRenderDevice::create_sampler(const RhiSamplerCreateInfo& create_info) {
         ZoneScoped;
-        auto* sampler = allocator.create<VulkanSampler>();
+        std::lock_guard lock{sampler_cache_mutex};
+        if(const auto itr = samplers.find(create_info); itr != samplers.end()) {
+            return itr->second;
+        }
+
+        auto* sampler = internal_allocator.create<VulkanSampler>();
 
         vk::SamplerCreateInfo vk_create_info = {};
         vk_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -815,92 +1841,86 @@ namespace nova::renderer::rhi {
         vk_create_info.minLod = create_info.min_lod;
         vk_create_info.maxLod = create_info.max_lod;
 
-        const vk::AllocationCallbacks& alloc_calls = wrap_allocator(allocator);
-        vkCreateSampler(device, &vk_create_info, &alloc_calls, &sampler->sampler);
+        vkCreateSampler(device, &vk_create_info, allocation_callbacks, &sampler->sampler);
+        samplers.emplace(create_info, sampler);
 
         return sampler;
     }
 
+    bool VulkanRenderDevice::supports_render_target_format(const PixelFormat format) {
+        constexpr auto required_features = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+                                           VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+        vk::FormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(gpu.phys_device, to_vk_format(format), &format_properties);
+        return (format_properties.optimalTilingFeatures & required_features) == required_features;
+    }
+
     RhiImage* VulkanRenderDevice::create_image(const renderpack::TextureCreateInfo& info, rx::memory::allocator& allocator) {
         ZoneScoped;
-        auto* image = allocator.create<VulkanImage>();
+        if(is_block_compressed_format(info.format.pixel_format)) {
+            // GPUs usually only have one family of compressed formats, so the renderpack or the loader has to have picked the right one
+            vk::FormatProperties format_properties;
+            vkGetPhysicalDeviceFormatProperties(gpu.phys_device, to_vk_format(info.format.pixel_format), &format_properties);
+            if((format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0U) {
+                logger->error("Could not create image %s: this GPU can't sample its compressed format", info.name);
+                return nullptr;
+            }
+        }
 
-        image->is_dynamic = true;
-        image->type = ResourceType::Image;
-        const vk::Format format = to_vk_format(info.format.pixel_format);
+        auto* image = allocator.create<VulkanImage>();
 
-        // In Nova, images all have a dedicated allocation
+        // In Nova, images all have a dedicated allocation, unless the rendergraph asks for them to alias each other
         // This may or may not change depending on performance data, but given Nova's atlas-centric design I don't think it'll change much
-        const auto image_pixel_size = info.format.get_size_in_pixels(swapchain_size);
+        const auto image_create_info = get_image_create_info(info, *image);
 
         VmaAllocationCreateInfo vma_info = {};
         vma_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        vma_info.priority = info.residency_priority;
 
-        vk::ImageCreateInfo image_create_info = {};
-        image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        image_create_info.imageType = VK_IMAGE_TYPE_2D;
-        image_create_info.format = format;
-        image_create_info.extent.width = image_pixel_size.x;
-        image_create_info.extent.height = image_pixel_size.y;
-        image_create_info.extent.depth = 1;
-        image_create_info.mipLevels = 1;
-        image_create_info.arrayLayers = 1;
-        image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-        image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-
-        if(format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT) {
-            image->is_depth_tex = true;
+        if(info.usage != renderpack::ImageUsage::SampledImage) {
+            // Render targets get dedicated allocations
+            vma_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
         }
 
-        if(info.usage == renderpack::ImageUsage::SampledImage) {
-            image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-
-        } else {
-            // If the image isn't a sampled image, it's a render target
-            // Render targets get dedicated allocations
+        auto result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        if(info.usage == renderpack::ImageUsage::TransientRenderTarget) {
+            // Tilers can keep transient attachments in tile memory and never back them at all. Everyone else gets regular memory
+            auto lazy_vma_info = vma_info;
+            lazy_vma_info.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+            result = vmaCreateImage(vma, &image_create_info, &lazy_vma_info, &image->image, &image->allocation, nullptr);
+        }
 
-            if(format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT) {
-                image_create_info.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-            } else {
-                image_create_info.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if(result != VK_SUCCESS && info.usage == renderpack::ImageUsage::SampledImage) {
+            auto pooled_vma_info = vma_info;
+            pooled_vma_info.pool = get_memory_pool(MemoryPoolClass::StreamedTextures);
+            pooled_vma_info.pUserData = static_cast<RhiResource*>(image);
+            if(pooled_vma_info.pool != VK_NULL_HANDLE) {
+                result = vmaCreateImage(vma, &image_create_info, &pooled_vma_info, &image->image, &image->allocation, nullptr);
+                if(result != VK_SUCCESS) {
+                    logger->warn("Could not allocate image {} from the texture memory pool, falling back to the default pools", info.name);
+                }
             }
-
-            vma_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
         }
 
-        image_create_info.queueFamilyIndexCount = 1;
-        image_create_info.pQueueFamilyIndices = &graphics_family_index;
-        image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-        const auto result = vmaCreateImage(vma, &image_create_info, &vma_info, &image->image, &image->allocation, nullptr);
+        if(result != VK_SUCCESS) {
+            result = vmaCreateImage(vma, &image_create_info, &vma_info, &image->image, &image->allocation, nullptr);
+        }
         if(result == VK_SUCCESS) {
-            if(settings->debug.enabled) {
-                vk::DebugUtilsObjectNameInfoEXT object_name = {};
-                object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
-                object_name.objectType = VK_OBJECT_TYPE_IMAGE;
-                object_name.objectHandle = reinterpret_cast<uint64_t>(image->image);
-                object_name.pObjectName = info.name.data();
+            finish_image_creation(*image, info, image_create_info.format);
+            image->create_info = image_create_info;
+            image->creation_frame = num_frames_begun;
 
-                NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &object_name));
-            }
+            if(!create_multisampled_image(*image, image_create_info, info)) {
+                vkDestroyImageView(device, image->image_view, allocation_callbacks);
+                vmaDestroyImage(vma, image->image, image->allocation);
+                allocator.deallocate(reinterpret_cast<uint8_t*>(image));
 
-            vk::ImageViewCreateInfo image_view_create_info = {};
-            image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            image_view_create_info.image = image->image;
-            image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            image_view_create_info.format = image_create_info.format;
-            if(format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT) {
-                image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-            } else {
-                image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                return nullptr;
             }
-            image_view_create_info.subresourceRange.baseArrayLayer = 0;
-            image_view_create_info.subresourceRange.layerCount = 1;
-            image_view_create_info.subresourceRange.baseMipLevel = 0;
-            image_view_create_info.subresourceRange.levelCount = 1;
 
-            const vk::AllocationCallbacks& vk_alloc = wrap_allocator(allocator);
-            vkCreateImageView(device, &image_view_create_info, &vk_alloc, &image->image_view);
+            const auto is_texture = info.usage == renderpack::ImageUsage::SampledImage;
+            track_allocation(image->allocation, is_texture ? MemoryCategory::Texture : MemoryCategory::RenderTarget, info.owner, info.name);
 
             return image;
 
@@ -911,6 +1931,88 @@ namespace nova::renderer::rhi {
         }
     }
 
+    std::vector<RhiImage*> VulkanRenderDevice::create_aliased_images(const std::vector<renderpack::TextureCreateInfo>& infos) {
+        ZoneScoped;
+        std::vector<VulkanImage*> images;
+        images.reserve(infos.size());
+
+        const auto destroy_images = [&] {
+            for(VulkanImage* image : images) {
+                vkDestroyImage(device, image->image, allocation_callbacks);
+                internal_allocator.deallocate(reinterpret_cast<uint8_t*>(image));
+            }
+        };
+
+        // The shared memory has to be large enough and aligned enough for every image, and of a type that every image can live in
+        vk::MemoryRequirements shared_requirements = {};
+        shared_requirements.memoryTypeBits = ~0U;
+
+        std::vector<vk::ImageCreateInfo> image_create_infos;
+        image_create_infos.reserve(infos.size());
+
+        for(const renderpack::TextureCreateInfo& info : infos) {
+            auto* image = internal_allocator.create<VulkanImage>();
+            const auto image_create_info = get_image_create_info(info, *image);
+            image_create_infos.push_back(image_create_info);
+
+            if(const auto result = vkCreateImage(device, &image_create_info, allocation_callbacks, &image->image); result != VK_SUCCESS) {
+                logger->error("Could not create image {}: {}", info.name, to_string(result));
+                internal_allocator.deallocate(reinterpret_cast<uint8_t*>(image));
+                destroy_images();
+                return {};
+            }
+
+            images.push_back(image);
+
+            vk::MemoryRequirements image_requirements;
+            vkGetImageMemoryRequirements(device, image->image, &image_requirements);
+
+            shared_requirements.size = std::max(shared_requirements.size, image_requirements.size);
+            shared_requirements.alignment = std::max(shared_requirements.alignment, image_requirements.alignment);
+            shared_requirements.memoryTypeBits &= image_requirements.memoryTypeBits;
+        }
+
+        if(images.empty() || shared_requirements.memoryTypeBits == 0) {
+            logger->warn("Images {} have no memory type in common, so they can't alias each other", infos.front().name);
+            destroy_images();
+            return {};
+        }
+
+        VmaAllocationCreateInfo vma_info = {};
+        vma_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        vma_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+        VmaAllocation allocation;
+        if(const auto result = vmaAllocateMemory(vma, &shared_requirements, &vma_info, &allocation, nullptr); result != VK_SUCCESS) {
+            logger->error("Could not allocate {} bytes of memory for images to alias: {}", shared_requirements.size, to_string(result));
+            destroy_images();
+            return {};
+        }
+
+        std::vector<RhiImage*> aliased_images;
+        aliased_images.reserve(images.size());
+
+        for(uint32_t i = 0; i < images.size(); i++) {
+            auto* image = images[i];
+            NOVA_CHECK_RESULT(vmaBindImageMemory(vma, allocation, image->image));
+            image->allocation = allocation;
+
+            finish_image_creation(*image, infos[i], to_vk_format(infos[i].format.pixel_format));
+
+            // Only the resolved images alias each other. An image without its multisampled copy still works, but framebuffers that
+            // need the copy can't be made with it
+            create_multisampled_image(*image, image_create_infos[i], infos[i]);
+
+            aliased_images.push_back(image);
+        }
+
+        num_images_per_aliased_allocation.emplace(allocation, static_cast<uint32_t>(images.size()));
+
+        track_allocation(allocation, MemoryCategory::RenderTarget, infos.front().owner, infos.front().name);
+
+        return aliased_images;
+    }
+
     RhiSemaphore* VulkanRenderDevice::create_semaphore(rx::memory::allocator& allocator) {
         ZoneScoped;
         auto* semaphore = allocator.create<VulkanSemaphore>();
@@ -918,8 +2020,7 @@ namespace nova::renderer::rhi {
         vk::SemaphoreCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(allocator);
-        vkCreateSemaphore(device, &create_info, &vk_alloc, &semaphore->semaphore);
+        vkCreateSemaphore(device, &create_info, allocation_callbacks, &semaphore->semaphore);
 
         return semaphore;
     }
@@ -946,8 +2047,7 @@ namespace nova::renderer::rhi {
             fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
         }
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(allocator);
-        vkCreateFence(device, &fence_create_info, &vk_alloc, &fence->fence);
+        vkCreateFence(device, &fence_create_info, allocation_callbacks, &fence->fence);
 
         return fence;
     }
@@ -967,8 +2067,7 @@ namespace nova::renderer::rhi {
 
         for(uint32_t i = 0; i < num_fences; i++) {
             auto* fence = allocator.create<VulkanFence>();
-            const vk::AllocationCallbacks& vk_alloc = wrap_allocator(allocator);
-            vkCreateFence(device, &fence_create_info, &vk_alloc, &fence->fence);
+            vkCreateFence(device, &fence_create_info, allocation_callbacks, &fence->fence);
 
             fences.push_back(fence);
         }
@@ -976,14 +2075,15 @@ namespace nova::renderer::rhi {
         return fences;
     }
 
-    void VulkanRenderDevice::wait_for_fences(const std::vector<RhiFence*> fences) {
+    void VulkanRenderDevice::wait_for_fences(const std::span<RhiFence* const> fences) {
         ZoneScoped;
-        std::vector<vk::Fence> vk_fences{&internal_allocator};
+        VulkanScratchMemory scratch;
+
+        std::pmr::vector<vk::Fence> vk_fences{&scratch.resource};
         vk_fences.reserve(fences.size());
-        fences.each_fwd([&](const RhiFence* fence) {
-            const auto* vk_fence = static_cast<const VulkanFence*>(fence);
-            vk_fences.push_back(vk_fence->fence);
-        });
+        for(const RhiFence* fence : fences) {
+            vk_fences.push_back(static_cast<const VulkanFence*>(fence)->fence);
+        }
 
         const auto result = vkWaitForFences(device,
                                             static_cast<uint32_t>(vk_fences.size()),
@@ -999,14 +2099,15 @@ namespace nova::renderer::rhi {
         }
     }
 
-    void VulkanRenderDevice::reset_fences(const std::vector<RhiFence*>& fences) {
+    void VulkanRenderDevice::reset_fences(const std::span<RhiFence* const> fences) {
         ZoneScoped;
-        std::vector<vk::Fence> vk_fences{&internal_allocator};
+        VulkanScratchMemory scratch;
+
+        std::pmr::vector<vk::Fence> vk_fences{&scratch.resource};
         vk_fences.reserve(fences.size());
-        fences.each_fwd([&](const RhiFence* fence) {
-            const auto* vk_fence = static_cast<const VulkanFence*>(fence);
-            vk_fences.push_back(vk_fence->fence);
-        });
+        for(const RhiFence* fence : fences) {
+            vk_fences.push_back(static_cast<const VulkanFence*>(fence)->fence);
+        }
 
         vkResetFences(device, static_cast<uint32_t>(fences.size()), vk_fences.data());
     }
@@ -1014,159 +2115,751 @@ namespace nova::renderer::rhi {
     void VulkanRenderDevice::destroy_renderpass(RhiRenderpass* pass, rx::memory::allocator& allocator) {
         ZoneScoped;
         auto* vk_renderpass = static_cast<VulkanRenderpass*>(pass);
-        vkDestroyRenderPass(device, vk_renderpass->pass, nullptr);
+        vkDestroyRenderPass(device, vk_renderpass->pass, allocation_callbacks);
         allocator.deallocate(reinterpret_cast<uint8_t*>(pass));
     }
 
     void VulkanRenderDevice::destroy_framebuffer(RhiFramebuffer* framebuffer, rx::memory::allocator& allocator) {
         ZoneScoped;
-        const auto* vk_framebuffer = static_cast<const VulkanFramebuffer*>(framebuffer);
-        vkDestroyFramebuffer(device, vk_framebuffer->framebuffer, nullptr);
+        auto* vk_framebuffer = static_cast<VulkanFramebuffer*>(framebuffer);
+        vkDestroyFramebuffer(device, vk_framebuffer->framebuffer, allocation_callbacks);
 
+        // Frees the views vector that dynamic rendering framebuffers have
+        vk_framebuffer->~VulkanFramebuffer();
         allocator.deallocate(reinterpret_cast<uint8_t*>(framebuffer));
     }
 
     void VulkanRenderDevice::destroy_texture(RhiImage* resource, rx::memory::allocator& allocator) {
         ZoneScoped;
         auto* vk_image = static_cast<VulkanImage*>(resource);
-        vmaDestroyImage(vma, vk_image->image, vk_image->allocation);
+        vkDestroyImageView(device, vk_image->image_view, allocation_callbacks);
+        {
+            std::lock_guard lock{image_view_mutex};
+            for(const auto& [desc, view] : vk_image->extra_views) {
+                vkDestroyImageView(device, view, allocation_callbacks);
+            }
+            vk_image->extra_views.clear();
+        }
+
+        if(vk_image->multisampled_image != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, vk_image->multisampled_view, allocation_callbacks);
+            memory_tracker.remove(vk_image->multisampled_allocation);
+            vmaDestroyImage(vma, vk_image->multisampled_image, vk_image->multisampled_allocation);
+        }
+
+        if(cancel_defragmentation_move(resource)) {
+            memory_tracker.remove(vk_image->allocation);
+
+            // The image's memory is the defragmentation pass's to free now
+            vkDestroyImage(device, vk_image->image, allocation_callbacks);
+
+        } else if(const auto itr = num_images_per_aliased_allocation.find(vk_image->allocation);
+                  itr != num_images_per_aliased_allocation.end()) {
+            // Other images may still live in this memory
+            vkDestroyImage(device, vk_image->image, allocation_callbacks);
+
+            itr->second--;
+            if(itr->second == 0) {
+                memory_tracker.remove(vk_image->allocation);
+                vmaFreeMemory(vma, vk_image->allocation);
+                num_images_per_aliased_allocation.erase(itr);
+            }
+
+        } else {
+            memory_tracker.remove(vk_image->allocation);
+            vmaDestroyImage(vma, vk_image->image, vk_image->allocation);
+        }
 
         allocator.deallocate(reinterpret_cast<uint8_t*>(resource));
     }
 
+    void VulkanRenderDevice::destroy_buffer(RhiBuffer* buffer, rx::memory::allocator& allocator) {
+        ZoneScoped;
+        auto* vk_buffer = static_cast<VulkanBuffer*>(buffer);
+        memory_tracker.remove(vk_buffer->allocation);
+        if(cancel_defragmentation_move(buffer)) {
+            vkDestroyBuffer(device, vk_buffer->buffer, allocation_callbacks);
+
+        } else {
+            vmaDestroyBuffer(vma, vk_buffer->buffer, vk_buffer->allocation);
+        }
+
+        allocator.deallocate(reinterpret_cast<uint8_t*>(buffer));
+    }
+
     void VulkanRenderDevice::destroy_semaphores(std::vector<RhiSemaphore*>& semaphores, rx::memory::allocator& allocator) {
         ZoneScoped;
         semaphores.each_fwd([&](RhiSemaphore* semaphore) {
             auto* vk_semaphore = static_cast<VulkanSemaphore*>(semaphore);
-            vkDestroySemaphore(device, vk_semaphore->semaphore, nullptr);
+            vkDestroySemaphore(device, vk_semaphore->semaphore, allocation_callbacks);
             allocator.deallocate(reinterpret_cast<uint8_t*>(semaphore));
         });
     }
 
-    void VulkanRenderDevice::destroy_fences(const std::vector<RhiFence*>& fences, rx::memory::allocator& allocator) {
+    RhiQueryPool* VulkanRenderDevice::create_timestamp_query_pool(const uint32_t num_timestamps) {
         ZoneScoped;
-        fences.each_fwd([&](RhiFence* fence) {
-            auto* vk_fence = static_cast<VulkanFence*>(fence);
-            const vk::AllocationCallbacks& vk_alloc = wrap_allocator(allocator);
-            vkDestroyFence(device, vk_fence->fence, &vk_alloc);
+        auto* pool = internal_allocator.create<VulkanQueryPool>();
 
-            allocator.deallocate(reinterpret_cast<uint8_t*>(fence));
-        });
+        vk::QueryPoolCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        create_info.queryCount = num_timestamps;
+
+        device.createQueryPool(&create_info, vk_allocation_callbacks, &pool->pool);
+
+        // Queries have to be reset before their first use
+        vkResetQueryPool(device, pool->pool, 0, num_timestamps);
+
+        return pool;
     }
 
-    RhiRenderCommandList* VulkanRenderDevice::create_command_list(const uint32_t thread_idx,
-                                                                  const QueueType needed_queue_type,
-                                                                  const RhiRenderCommandList::Level level,
-                                                                  rx::memory::allocator& allocator) {
+    RhiQueryPool* VulkanRenderDevice::create_pipeline_statistics_query_pool(const uint32_t num_queries) {
         ZoneScoped;
-        const uint32_t queue_family_index = get_queue_family_index(needed_queue_type);
-        const vk::CommandPool pool = *command_pools_by_thread_idx[thread_idx].find(queue_family_index);
+        auto* pool = internal_allocator.create<VulkanQueryPool>();
 
-        vk::CommandBufferAllocateInfo create_info = {};
-        create_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        create_info.commandPool = pool;
-        create_info.level = to_vk_command_buffer_level(level);
-        create_info.commandBufferCount = 1;
+        vk::QueryPoolCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        create_info.queryCount = num_queries;
+        create_info.pipelineStatistics = PIPELINE_STATISTICS;
 
-        vk::CommandBuffer new_buffer;
-        vkAllocateCommandBuffers(device, &create_info, &new_buffer);
+        device.createQueryPool(&create_info, vk_allocation_callbacks, &pool->pool);
 
-        auto* list = allocator.create<VulkanRenderCommandList>(new_buffer, *this, allocator);
+        vkResetQueryPool(device, pool->pool, 0, num_queries);
 
-        return list;
+        return pool;
     }
 
-    void VulkanRenderDevice::submit_command_list(RhiRenderCommandList* cmds,
-                                                 const QueueType queue,
-                                                 RhiFence* fence_to_signal,
-                                                 const std::vector<RhiSemaphore*>& wait_semaphores,
-                                                 const std::vector<RhiSemaphore*>& signal_semaphores) {
+    RhiQueryPool* VulkanRenderDevice::create_occlusion_query_pool(const uint32_t num_queries) {
         ZoneScoped;
-        auto* vk_list = static_cast<VulkanRenderCommandList*>(cmds);
-        vkEndCommandBuffer(vk_list->cmds);
+        auto* pool = internal_allocator.create<VulkanQueryPool>();
 
-        vk::Queue queue_to_submit_to;
+        vk::QueryPoolCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.queryType = VK_QUERY_TYPE_OCCLUSION;
+        create_info.queryCount = num_queries;
 
-        switch(queue) {
-            case QueueType::Graphics:
-                queue_to_submit_to = graphics_queue;
-                break;
+        device.createQueryPool(&create_info, vk_allocation_callbacks, &pool->pool);
 
-            case QueueType::Transfer:
-                queue_to_submit_to = copy_queue;
-                break;
+        vkResetQueryPool(device, pool->pool, 0, num_queries);
 
-            case QueueType::AsyncCompute:
-                queue_to_submit_to = compute_queue;
-                break;
+        return pool;
+    }
 
-            default:
-                queue_to_submit_to = graphics_queue;
+    void VulkanRenderDevice::reset_queries(RhiQueryPool* pool, const uint32_t first_query, const uint32_t num_queries) {
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+        vkResetQueryPool(device, vk_pool->pool, first_query, num_queries);
+    }
+
+    bool VulkanRenderDevice::get_timestamps(RhiQueryPool* pool,
+                                            const uint32_t first_timestamp,
+                                            const uint32_t num_timestamps,
+                                            std::vector<uint64_t>& timestamps) {
+        ZoneScoped;
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+
+        const auto old_size = timestamps.size();
+        timestamps.resize(old_size + num_timestamps);
+
+        const auto result = vkGetQueryPoolResults(device,
+                                                  vk_pool->pool,
+                                                  first_timestamp,
+                                                  num_timestamps,
+                                                  num_timestamps * sizeof(uint64_t),
+                                                  timestamps.data() + old_size,
+                                                  sizeof(uint64_t),
+                                                  VK_QUERY_RESULT_64_BIT);
+        if(result != VK_SUCCESS) {
+            timestamps.resize(old_size);
+            return false;
         }
 
-        std::vector<vk::Semaphore> vk_wait_semaphores{&internal_allocator};
-        vk_wait_semaphores.reserve(wait_semaphores.size());
-        wait_semaphores.each_fwd([&](const RhiSemaphore* semaphore) {
-            const auto* vk_semaphore = static_cast<const VulkanSemaphore*>(semaphore);
-            vk_wait_semaphores.push_back(vk_semaphore->semaphore);
-        });
+        return true;
+    }
 
-        std::vector<vk::Semaphore> vk_signal_semaphores{&internal_allocator};
-        vk_signal_semaphores.reserve(signal_semaphores.size());
-        signal_semaphores.each_fwd([&](const RhiSemaphore* semaphore) {
-            const auto* vk_semaphore = static_cast<const VulkanSemaphore*>(semaphore);
-            vk_signal_semaphores.push_back(vk_semaphore->semaphore);
-        });
+    bool VulkanRenderDevice::get_pipeline_statistics(RhiQueryPool* pool,
+                                                     const uint32_t first_query,
+                                                     const uint32_t num_queries,
+                                                     std::vector<RhiPipelineStatistics>& statistics) {
+        ZoneScoped;
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+
+        const auto old_size = statistics.size();
+        statistics.resize(old_size + num_queries);
+
+        const auto result = vkGetQueryPoolResults(device,
+                                                  vk_pool->pool,
+                                                  first_query,
+                                                  num_queries,
+                                                  num_queries * sizeof(RhiPipelineStatistics),
+                                                  statistics.data() + old_size,
+                                                  sizeof(RhiPipelineStatistics),
+                                                  VK_QUERY_RESULT_64_BIT);
+        if(result != VK_SUCCESS) {
+            statistics.resize(old_size);
+            return false;
+        }
 
-        vk::SubmitInfo submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.waitSemaphoreCount = static_cast<uint32_t>(vk_wait_semaphores.size());
-        submit_info.pWaitSemaphores = vk_wait_semaphores.data();
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &vk_list->cmds;
-        submit_info.signalSemaphoreCount = static_cast<uint32_t>(vk_signal_semaphores.size());
-        submit_info.pSignalSemaphores = vk_signal_semaphores.data();
+        return true;
+    }
 
-        const auto vk_signal_fence = [&]() -> vk::Fence {
-            if(fence_to_signal) {
-                return static_cast<const VulkanFence*>(fence_to_signal)->fence;
+    bool VulkanRenderDevice::get_occlusion_query_results(RhiQueryPool* pool,
+                                                         const uint32_t first_query,
+                                                         const uint32_t num_queries,
+                                                         std::vector<uint64_t>& samples_passed) {
+        ZoneScoped;
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+
+        const auto old_size = samples_passed.size();
+        samples_passed.resize(old_size + num_queries);
+
+        const auto result = vkGetQueryPoolResults(device,
+                                                  vk_pool->pool,
+                                                  first_query,
+                                                  num_queries,
+                                                  num_queries * sizeof(uint64_t),
+                                                  samples_passed.data() + old_size,
+                                                  sizeof(uint64_t),
+                                                  VK_QUERY_RESULT_64_BIT);
+        if(result != VK_SUCCESS) {
+            samples_passed.resize(old_size);
+            return false;
+        }
 
-            } else {
-                return get_next_submission_fence();
-            }
-        }();
+        return true;
+    }
 
-        const auto result = vkQueueSubmit(queue_to_submit_to, 1, &submit_info, vk_signal_fence);
+    void VulkanRenderDevice::destroy_query_pool(RhiQueryPool* pool) {
+        auto* vk_pool = static_cast<VulkanQueryPool*>(pool);
+        device.destroyQueryPool(vk_pool->pool, vk_allocation_callbacks);
 
-        fenced_tasks.emplace_back(vk_signal_fence, [&] {
-            vk_list->cleanup_resources();
-            submission_fences.emplace_back(vk_signal_fence);
-        });
+        internal_allocator.deallocate(reinterpret_cast<uint8_t*>(vk_pool));
+    }
 
-        if(settings->debug.enabled) {
-            if(result != VK_SUCCESS) {
-                logger->error("Could not submit command list: %s", to_string(result));
+    void VulkanRenderDevice::destroy_fences(const std::vector<RhiFence*>& fences, rx::memory::allocator& allocator) {
+        ZoneScoped;
+        fences.each_fwd([&](RhiFence* fence) {
+            auto* vk_fence = static_cast<VulkanFence*>(fence);
+            vkDestroyFence(device, vk_fence->fence, allocation_callbacks);
+
+            allocator.deallocate(reinterpret_cast<uint8_t*>(fence));
+        });
+    }
+
+    RhiRenderCommandList* VulkanRenderDevice::create_command_list(const uint32_t thread_idx,
+                                                                  const QueueType needed_queue_type,
+                                                                  const RhiRenderCommandList::Level level) {
+        ZoneScoped;
+        const uint32_t queue_family_index = get_queue_family_index(needed_queue_type);
+        auto& pool = command_pools[cur_frame_idx][thread_idx].at(queue_family_index);
+
+        auto& list = acquire_command_list(pool, level);
+        list.begin();
+
+        return &list;
+    }
+
+    RhiRenderCommandList* VulkanRenderDevice::create_secondary_command_list(const uint32_t thread_idx,
+                                                                            RhiRenderpass* renderpass,
+                                                                            const RhiFramebuffer* framebuffer,
+                                                                            const uint32_t subpass) {
+        ZoneScoped;
+        auto& pool = command_pools[cur_frame_idx][thread_idx].at(graphics_family_index);
+        auto& list = acquire_command_list(pool, RhiRenderCommandList::Level::Secondary);
+        begin_secondary_command_list(list, renderpass, framebuffer, subpass, false);
+
+        return &list;
+    }
+
+    RhiRenderCommandList* VulkanRenderDevice::create_reusable_command_list(RhiRenderpass* renderpass,
+                                                                           const RhiFramebuffer* framebuffer,
+                                                                           const uint32_t subpass) {
+        ZoneScoped;
+        auto pool = std::make_unique<VulkanCommandPool>();
+
+        // The pool only ever has one command buffer, which is destroyed along with it
+        vk::CommandPoolCreateInfo command_pool_create_info;
+        command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        command_pool_create_info.queueFamilyIndex = graphics_family_index;
+        NOVA_CHECK_RESULT(vkCreateCommandPool(device, &command_pool_create_info, allocation_callbacks, &pool->pool));
+
+        auto& list = acquire_command_list(*pool, RhiRenderCommandList::Level::Secondary);
+        begin_secondary_command_list(list, renderpass, framebuffer, subpass, true);
+
+        std::lock_guard lock{reusable_command_pools_mutex};
+        reusable_command_pools.emplace(&list, std::move(pool));
+
+        return &list;
+    }
+
+    void VulkanRenderDevice::destroy_reusable_command_list(RhiRenderCommandList* cmds) {
+        std::unique_ptr<VulkanCommandPool> pool;
+        {
+            std::lock_guard lock{reusable_command_pools_mutex};
+            auto node = reusable_command_pools.extract(cmds);
+            if(node.empty()) {
+                return;
+            }
+
+            pool = std::move(node.mapped());
+        }
+
+        defer_until_submissions_finish(QueueType::Graphics, [this, pool = std::shared_ptr<VulkanCommandPool>{std::move(pool)}] {
+            vkDestroyCommandPool(device, pool->pool, allocation_callbacks);
+        });
+    }
+
+    void VulkanRenderDevice::begin_secondary_command_list(VulkanRenderCommandList& list,
+                                                          RhiRenderpass* renderpass,
+                                                          const RhiFramebuffer* framebuffer,
+                                                          const uint32_t subpass,
+                                                          const bool is_reusable) {
+        auto* vk_renderpass = static_cast<VulkanRenderpass*>(renderpass);
+        const auto* vk_framebuffer = static_cast<const VulkanFramebuffer*>(framebuffer);
+
+        vk::CommandBufferInheritanceInfo inheritance_info = {};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = vk_renderpass->pass;
+        inheritance_info.subpass = subpass;
+        inheritance_info.framebuffer = vk_framebuffer != nullptr ? vk_framebuffer->framebuffer : VK_NULL_HANDLE;
+
+        // Secondary command lists that run inside vkCmdBeginRenderingKHR inherit the attachment formats instead of a renderpass
+        std::vector<vk::Format> color_formats{&internal_allocator};
+        auto rendering_inheritance_info = vk::CommandBufferInheritanceRenderingInfoKHR().setRasterizationSamples(
+            vk::SampleCountFlagBits::e1);
+        if(vk_renderpass->uses_dynamic_rendering) {
+            color_formats.reserve(vk_renderpass->color_attachments.size());
+            vk_renderpass->color_attachments.each_fwd(
+                [&](const vk::AttachmentDescription& attachment) { color_formats.push_back(attachment.format); });
+
+            rendering_inheritance_info.setFlags(vk::RenderingFlagBitsKHR::eContentsSecondaryCommandBuffers)
+                .setViewMask(vk_renderpass->view_mask)
+                .setColorAttachmentCount(static_cast<uint32_t>(color_formats.size()))
+                .setPColorAttachmentFormats(color_formats.data());
+            if(vk_renderpass->depth_attachment) {
+                rendering_inheritance_info.setDepthAttachmentFormat(vk_renderpass->depth_attachment->format);
+            }
+
+            inheritance_info.pNext = &rendering_inheritance_info;
+        }
+
+        // The primary command list may be counting pipeline statistics when it executes this
+        if(info.supports_pipeline_statistics) {
+            inheritance_info.pipelineStatistics = PIPELINE_STATISTICS;
+        }
+
+        list.begin(vk_renderpass, &inheritance_info, is_reusable);
+
+        // Secondary command lists don't inherit dynamic state from their primary
+        if(framebuffer != nullptr) {
+            list.set_viewport_to_framebuffer(framebuffer->size);
+        }
+    }
+
+    void VulkanRenderDevice::submit_command_list(RhiRenderCommandList* cmds,
+                                                 const QueueType queue,
+                                                 RhiFence* fence_to_signal,
+                                                 const std::span<RhiSemaphore* const> wait_semaphores,
+                                                 const std::span<RhiSemaphore* const> signal_semaphores,
+                                                 std::function<void()> on_completion) {
+        ZoneScoped;
+        auto* vk_list = static_cast<VulkanRenderCommandList*>(cmds);
+        vkEndCommandBuffer(vk_list->cmds);
+
+        auto& timeline = *timelines_by_queue_type[static_cast<size_t>(queue)];
+
+        VulkanScratchMemory scratch;
+
+        std::pmr::vector<vk::Semaphore> vk_wait_semaphores{&scratch.resource};
+        vk_wait_semaphores.reserve(wait_semaphores.size());
+        for(const RhiSemaphore* semaphore : wait_semaphores) {
+            vk_wait_semaphores.push_back(static_cast<const VulkanSemaphore*>(semaphore)->semaphore);
+        }
+
+        // The queue's timeline semaphore goes last. Binary semaphores ignore their signal value
+        std::pmr::vector<vk::Semaphore> vk_signal_semaphores{&scratch.resource};
+        vk_signal_semaphores.reserve(signal_semaphores.size() + 1);
+        for(const RhiSemaphore* semaphore : signal_semaphores) {
+            vk_signal_semaphores.push_back(static_cast<const VulkanSemaphore*>(semaphore)->semaphore);
+        }
+        vk_signal_semaphores.push_back(timeline.semaphore);
+
+        std::pmr::vector<uint64_t> signal_values(vk_signal_semaphores.size(), 0, &scratch.resource);
+
+        // We don't know what the semaphores guard, so each wait blocks every stage. The only semaphores we wait on right now are the
+        // swapchain's image available semaphores
+        const std::pmr::vector<vk::PipelineStageFlags> wait_stages(vk_wait_semaphores.size(),
+                                                                   vk::PipelineStageFlagBits::eAllCommands,
+                                                                   &scratch.resource);
+
+        vk::SubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.waitSemaphoreCount = static_cast<uint32_t>(vk_wait_semaphores.size());
+        submit_info.pWaitSemaphores = vk_wait_semaphores.data();
+        submit_info.pWaitDstStageMask = wait_stages.data();
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &vk_list->cmds;
+        submit_info.signalSemaphoreCount = static_cast<uint32_t>(vk_signal_semaphores.size());
+        submit_info.pSignalSemaphores = vk_signal_semaphores.data();
+
+        VkTimelineSemaphoreSubmitInfo timeline_info = {};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = static_cast<uint32_t>(signal_values.size());
+        timeline_info.pSignalSemaphoreValues = signal_values.data();
+        submit_info.pNext = &timeline_info;
+
+        const vk::Fence vk_signal_fence = fence_to_signal != nullptr ? static_cast<const VulkanFence*>(fence_to_signal)->fence :
+                                                                       VK_NULL_HANDLE;
+
+        uint64_t submission_value;
+        VkResult result;
+        {
+            std::lock_guard lock{timeline.submit_mutex};
+            submission_value = timeline.last_submitted_value.load() + 1;
+            signal_values.back() = submission_value;
+
+            result = vkQueueSubmit(timeline.queue, 1, &submit_info, vk_signal_fence);
+            if(result == VK_SUCCESS) {
+                timeline.last_submitted_value.store(submission_value);
+                vk_list->pool.submission_values[static_cast<size_t>(queue)] = submission_value;
+            }
+        }
+
+        // The command list goes back to its pool on its own, when the pool's frame slot comes around again
+        if(on_completion) {
+            push_deferred_task(timeline, submission_value, std::move(on_completion));
+        }
+
+        if(settings->debug.enabled) {
+            if(result != VK_SUCCESS) {
+                logger->error("Could not submit command list: %s", to_string(result));
+                BREAK_ON_DEVICE_LOST(result);
+            }
+        }
+    }
+
+    void VulkanRenderDevice::submit_command_lists(const std::span<const RhiSubmission> submissions, RhiFence* fence_to_signal) {
+        ZoneScoped;
+        if(submissions.empty()) {
+            return;
+        }
+
+        VulkanScratchMemory scratch;
+
+        // Queues in the order their first submission shows up. Some queue types may share a queue, and so a timeline
+        std::pmr::vector<QueueTimeline*> timelines{&scratch.resource};
+        for(const RhiSubmission& submission : submissions) {
+            auto* timeline = timelines_by_queue_type[static_cast<size_t>(submission.queue)];
+            if(std::find(timelines.begin(), timelines.end(), timeline) == timelines.end()) {
+                timelines.push_back(timeline);
+            }
+        }
+
+        // The signal values are handed out before anything is submitted, so nothing else may submit to these queues until we're done.
+        // Locking in address order keeps two batches from deadlocking each other
+        std::pmr::vector<QueueTimeline*> lock_order{timelines, &scratch.resource};
+        std::sort(lock_order.begin(), lock_order.end());
+        std::pmr::vector<std::unique_lock<std::mutex>> locks{&scratch.resource};
+        locks.reserve(lock_order.size());
+        for(QueueTimeline* timeline : lock_order) {
+            locks.emplace_back(timeline->submit_mutex);
+        }
+
+        std::pmr::vector<uint64_t> next_values{&scratch.resource};
+        next_values.reserve(timelines.size());
+        for(const QueueTimeline* timeline : timelines) {
+            next_values.push_back(timeline->last_submitted_value.load());
+        }
+
+        // Each submission's semaphores. The queue's timeline semaphore goes last in the signals
+        struct SubmissionSemaphores {
+            std::pmr::vector<vk::Semaphore> waits;
+            std::pmr::vector<uint64_t> wait_values;
+            std::pmr::vector<vk::PipelineStageFlags> wait_stages;
+            std::pmr::vector<vk::Semaphore> signals;
+            std::pmr::vector<uint64_t> signal_values;
+        };
+
+        std::pmr::vector<SubmissionSemaphores> semaphores{&scratch.resource};
+        semaphores.reserve(submissions.size());
+        std::pmr::vector<size_t> timeline_indices{&scratch.resource};
+        timeline_indices.reserve(submissions.size());
+
+        for(const RhiSubmission& submission : submissions) {
+            auto* vk_list = static_cast<VulkanRenderCommandList*>(submission.cmds);
+            vkEndCommandBuffer(vk_list->cmds);
+
+            auto* timeline = timelines_by_queue_type[static_cast<size_t>(submission.queue)];
+            const auto timeline_idx = static_cast<size_t>(std::find(timelines.begin(), timelines.end(), timeline) - timelines.begin());
+            timeline_indices.push_back(timeline_idx);
+
+            next_values[timeline_idx]++;
+            const auto submission_value = next_values[timeline_idx];
+
+            auto& submission_semaphores = semaphores.emplace_back(SubmissionSemaphores{
+                std::pmr::vector<vk::Semaphore>{&scratch.resource},
+                std::pmr::vector<uint64_t>{&scratch.resource},
+                std::pmr::vector<vk::PipelineStageFlags>{&scratch.resource},
+                std::pmr::vector<vk::Semaphore>{&scratch.resource},
+                std::pmr::vector<uint64_t>{&scratch.resource},
+            });
+
+            // Binary semaphores ignore their values
+            for(const RhiSemaphore* semaphore : submission.wait_semaphores) {
+                submission_semaphores.waits.push_back(static_cast<const VulkanSemaphore*>(semaphore)->semaphore);
+                submission_semaphores.wait_values.push_back(0);
+            }
+
+            // Timeline semaphores may be waited on before their signal is submitted, so the queues can be submitted to in any order
+            for(const uint32_t waited_submission_idx : submission.submissions_to_wait_for) {
+                const auto& waited_signal_values = semaphores[waited_submission_idx].signal_values;
+                submission_semaphores.waits.push_back(timelines[timeline_indices[waited_submission_idx]]->semaphore);
+                submission_semaphores.wait_values.push_back(waited_signal_values.back());
+            }
+
+            // Like `submit_command_list`, we don't know what the waits guard, so they block every stage
+            submission_semaphores.wait_stages.resize(submission_semaphores.waits.size(), vk::PipelineStageFlagBits::eAllCommands);
+
+            for(const RhiSemaphore* semaphore : submission.signal_semaphores) {
+                submission_semaphores.signals.push_back(static_cast<const VulkanSemaphore*>(semaphore)->semaphore);
+                submission_semaphores.signal_values.push_back(0);
+            }
+            submission_semaphores.signals.push_back(timeline->semaphore);
+            submission_semaphores.signal_values.push_back(submission_value);
+
+            vk_list->pool.submission_values[static_cast<size_t>(submission.queue)] = submission_value;
+        }
+
+        std::pmr::vector<VkTimelineSemaphoreSubmitInfo> timeline_infos{submissions.size(), &scratch.resource};
+        std::pmr::vector<vk::SubmitInfo> submit_infos{submissions.size(), &scratch.resource};
+        for(size_t i = 0; i < submissions.size(); i++) {
+            const auto& submission_semaphores = semaphores[i];
+
+            auto& timeline_info = timeline_infos[i];
+            timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline_info.waitSemaphoreValueCount = static_cast<uint32_t>(submission_semaphores.wait_values.size());
+            timeline_info.pWaitSemaphoreValues = submission_semaphores.wait_values.data();
+            timeline_info.signalSemaphoreValueCount = static_cast<uint32_t>(submission_semaphores.signal_values.size());
+            timeline_info.pSignalSemaphoreValues = submission_semaphores.signal_values.data();
+
+            auto& submit_info = submit_infos[i];
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = &timeline_info;
+            submit_info.waitSemaphoreCount = static_cast<uint32_t>(submission_semaphores.waits.size());
+            submit_info.pWaitSemaphores = submission_semaphores.waits.data();
+            submit_info.pWaitDstStageMask = submission_semaphores.wait_stages.data();
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &static_cast<VulkanRenderCommandList*>(submissions[i].cmds)->cmds;
+            submit_info.signalSemaphoreCount = static_cast<uint32_t>(submission_semaphores.signals.size());
+            submit_info.pSignalSemaphores = submission_semaphores.signals.data();
+        }
+
+        const vk::Fence vk_signal_fence = fence_to_signal != nullptr ? static_cast<const VulkanFence*>(fence_to_signal)->fence :
+                                                                       VK_NULL_HANDLE;
+        const auto fence_timeline_idx = timeline_indices.back();
+
+        std::pmr::vector<vk::SubmitInfo> queue_submit_infos{&scratch.resource};
+        queue_submit_infos.reserve(submissions.size());
+        for(size_t timeline_idx = 0; timeline_idx < timelines.size(); timeline_idx++) {
+            queue_submit_infos.clear();
+            for(size_t i = 0; i < submissions.size(); i++) {
+                if(timeline_indices[i] == timeline_idx) {
+                    queue_submit_infos.push_back(submit_infos[i]);
+                }
+            }
+
+            auto* timeline = timelines[timeline_idx];
+            const auto result = vkQueueSubmit(timeline->queue,
+                                              static_cast<uint32_t>(queue_submit_infos.size()),
+                                              reinterpret_cast<const VkSubmitInfo*>(queue_submit_infos.data()),
+                                              timeline_idx == fence_timeline_idx ? vk_signal_fence : VK_NULL_HANDLE);
+            if(result == VK_SUCCESS) {
+                timeline->last_submitted_value.store(next_values[timeline_idx]);
+
+                for(size_t i = 0; i < submissions.size(); i++) {
+                    if(timeline_indices[i] == timeline_idx && submissions[i].on_completion) {
+                        push_deferred_task(*timeline, semaphores[i].signal_values.back(), submissions[i].on_completion);
+                    }
+                }
+
+            } else if(settings->debug.enabled) {
+                logger->error("Could not submit command lists: %s", to_string(result));
                 BREAK_ON_DEVICE_LOST(result);
             }
         }
     }
 
+    void VulkanRenderDevice::begin_frame(const uint32_t frame_idx) {
+        ZoneScoped;
+        cur_frame_idx = frame_idx;
+
+        // VMA refreshes its memory budget when the frame index changes
+        num_frames_begun++;
+        vmaSetCurrentFrameIndex(vma, num_frames_begun);
+
+        // This frame slot's fence has signaled, so every frame up to the one that copied the pass's resources has finished
+        {
+            std::lock_guard lock{defragmentation_mutex};
+            if(defragmentation.pass_frame && num_frames_begun >= *defragmentation.pass_frame + settings->max_in_flight_frames) {
+                finish_defragmentation_pass();
+            }
+        }
+
+        for(auto& pools_by_family : command_pools[frame_idx]) {
+            for(auto& [queue_family_index, pool] : pools_by_family) {
+                reset_command_pool(pool);
+            }
+        }
+
+        transient_descriptors[frame_idx]->reset();
+    }
+
     void VulkanRenderDevice::end_frame(FrameContext& /* ctx */) {
-        ZoneScoped; // Intentionally copying the vector
-        auto cur_tasks = fenced_tasks;
+        ZoneScoped;
+        if(allocation_callbacks != nullptr) {
+            TracyPlot("Vulkan host memory", static_cast<int64_t>(get_host_allocator_stats().num_live_bytes));
+        }
 
-        // Clear out the list of tasks. We've copied the tasks to the new vector so it's fine, and we'll add back in the tasks that aren't
-        // ready to run
-        fenced_tasks.clear();
+        for(const auto& timeline : queue_timelines) {
+            const auto by_submission_value = [](const DeferredTask* a, const DeferredTask* b) {
+                return a->submission_value < b->submission_value;
+            };
 
-        cur_tasks.each_fwd([&](const FencedTask& task) {
-            if(device.getFenceStatus(task.fence) == vk::Result::eSuccess) {
-                task();
+            // The new tasks come out newest first. Threads can race to defer work, so they're only mostly in submission order
+            const auto num_old_tasks = static_cast<std::ptrdiff_t>(timeline->pending_tasks.size());
+            auto* new_task = timeline->new_tasks.exchange(nullptr, std::memory_order_acquire);
+            while(new_task != nullptr) {
+                timeline->pending_tasks.push_back(std::exchange(new_task, new_task->next));
+            }
 
-            } else {
-                fenced_tasks.push_back(task);
+            const auto first_new_task = timeline->pending_tasks.begin() + num_old_tasks;
+            std::reverse(first_new_task, timeline->pending_tasks.end());
+            if(!std::is_sorted(first_new_task, timeline->pending_tasks.end(), by_submission_value)) {
+                std::stable_sort(first_new_task, timeline->pending_tasks.end(), by_submission_value);
             }
-        });
+
+            // Usually everything new is for a later submission than everything that was already waiting
+            if(num_old_tasks > 0 && first_new_task != timeline->pending_tasks.end() &&
+               by_submission_value(*first_new_task, *(first_new_task - 1))) {
+                std::inplace_merge(timeline->pending_tasks.begin(), first_new_task, timeline->pending_tasks.end(), by_submission_value);
+            }
+
+            if(timeline->pending_tasks.empty()) {
+                continue;
+            }
+
+            uint64_t completed_value = 0;
+            device.getSemaphoreCounterValue(timeline->semaphore, &completed_value);
+
+            while(!timeline->pending_tasks.empty() && timeline->pending_tasks.front()->submission_value <= completed_value) {
+                const auto* task = timeline->pending_tasks.front();
+                timeline->pending_tasks.pop_front();
+
+                task->work_to_perform();
+                delete task;
+            }
+        }
+    }
+
+    VulkanRenderCommandList& VulkanRenderDevice::acquire_command_list(VulkanCommandPool& pool, const RhiRenderCommandList::Level level) {
+        const bool is_primary = level == RhiRenderCommandList::Level::Primary;
+        auto& lists = is_primary ? pool.primary_lists : pool.secondary_lists;
+        auto& num_used_lists = is_primary ? pool.num_used_primary_lists : pool.num_used_secondary_lists;
+
+        if(num_used_lists == lists.size()) {
+            vk::CommandBufferAllocateInfo create_info = {};
+            create_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            create_info.commandPool = pool.pool;
+            create_info.level = to_vk_command_buffer_level(level);
+            create_info.commandBufferCount = 1;
+
+            vk::CommandBuffer new_buffer;
+            vkAllocateCommandBuffers(device, &create_info, &new_buffer);
+
+            lists.push_back(std::make_unique<VulkanRenderCommandList>(new_buffer, *this, internal_allocator, pool));
+        }
+
+        return *lists[num_used_lists++];
+    }
+
+    void VulkanRenderDevice::reset_command_pool(VulkanCommandPool& pool) {
+        if(pool.num_used_primary_lists == 0 && pool.num_used_secondary_lists == 0) {
+            return;
+        }
+
+        // The frame slot's fence covers its graphics work, but uploads from the same pool may still be in flight
+        std::vector<vk::Semaphore> semaphores;
+        std::vector<uint64_t> values;
+        for(size_t queue_type = 0; queue_type < pool.submission_values.size(); queue_type++) {
+            if(pool.submission_values[queue_type] != 0) {
+                semaphores.push_back(timelines_by_queue_type[queue_type]->semaphore);
+                values.push_back(pool.submission_values[queue_type]);
+            }
+        }
+
+        if(!semaphores.empty()) {
+            VkSemaphoreWaitInfo wait_info = {};
+            wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            wait_info.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+            wait_info.pSemaphores = semaphores.data();
+            wait_info.pValues = values.data();
+            vkWaitSemaphores(device, &wait_info, std::numeric_limits<uint64_t>::max());
+        }
+
+        vkResetCommandPool(device, pool.pool, 0);
+
+        pool.num_used_primary_lists = 0;
+        pool.num_used_secondary_lists = 0;
+        pool.submission_values = {};
+    }
+
+    void VulkanRenderDevice::push_deferred_task(QueueTimeline& timeline, const uint64_t submission_value, std::function<void()> work) {
+        auto* task = new DeferredTask{submission_value, std::move(work)};
+
+        task->next = timeline.new_tasks.load(std::memory_order_relaxed);
+        while(!timeline.new_tasks.compare_exchange_weak(task->next, task, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    void VulkanRenderDevice::save_pipeline_cache() {
+        ZoneScoped;
+        size_t cache_size = 0;
+        if(device.getPipelineCacheData(pipeline_cache, &cache_size, nullptr) != vk::Result::eSuccess || cache_size == 0) {
+            return;
+        }
+
+        std::vector<uint8_t> cache_data(cache_size);
+        if(device.getPipelineCacheData(pipeline_cache, &cache_size, cache_data.data()) != vk::Result::eSuccess) {
+            logger->warn("Could not read back the pipeline cache, it won't be saved");
+            return;
+        }
+
+        const auto cache_path = get_pipeline_cache_path();
+
+        std::error_code err;
+        std::filesystem::create_directories(cache_path.parent_path(), err);
+
+        // Write to a temporary file and swap it in, so a crash halfway through writing doesn't leave a truncated cache behind
+        auto temp_path = cache_path;
+        temp_path += ".tmp";
+
+        {
+            std::ofstream cache_file{temp_path, std::ios::binary | std::ios::trunc};
+            if(!cache_file) {
+                logger->warn("Could not open {} to save the pipeline cache", temp_path.string());
+                return;
+            }
+
+            cache_file.write(reinterpret_cast<const char*>(cache_data.data()), static_cast<std::streamsize>(cache_size));
+        }
+
+        std::filesystem::rename(temp_path, cache_path, err);
+        if(err) {
+            logger->warn("Could not save the pipeline cache to {}: {}", cache_path.string(), err.message());
+
+        } else {
+            logger->debug("Saved {} bytes of pipeline cache to {}", cache_size, cache_path.string());
+        }
     }
 
     uint32_t VulkanRenderDevice::get_queue_family_index(const QueueType type) const {
@@ -1186,31 +2879,108 @@ namespace nova::renderer::rhi {
         }
     }
 
+    VulkanHostAllocatorStats VulkanRenderDevice::get_host_allocator_stats() const {
+        if(allocation_callbacks == nullptr) {
+            return {};
+        }
+
+        return VulkanHostAllocator::get_instance().get_stats();
+    }
+
     VulkanPipelineLayoutInfo VulkanRenderDevice::create_pipeline_layout(const RhiGraphicsPipelineState& state) {
-        const auto bindings = get_all_descriptors(state);
-        const auto ds_layouts = create_descriptor_set_layouts(bindings, *this, internal_allocator);
+        return create_pipeline_layout(get_all_descriptors(state));
+    }
 
-        const auto pipeline_layout_create = vk::PipelineLayoutCreateInfo()
-                                                .setSetLayoutCount(static_cast<uint32_t>(ds_layouts.size()))
-                                                .setPSetLayouts(ds_layouts.data())
-                                                .setPushConstantRangeCount(static_cast<uint32_t>(standard_push_constants.size()))
-                                                .setPPushConstantRanges(standard_push_constants.data()); // TODO: Get this from reflection
+    VulkanPipelineLayoutInfo VulkanRenderDevice::create_pipeline_layout(
+        const std::unordered_map<std::string, RhiResourceBindingDescription>& bindings) {
+        ZoneScoped;
+        const auto ds_layouts = create_descriptor_set_layouts(bindings, *this);
+
+        const std::string key{reinterpret_cast<const char*>(ds_layouts.data()), ds_layouts.size() * sizeof(vk::DescriptorSetLayout)};
 
         vk::PipelineLayout layout;
-        device.createPipelineLayout(&pipeline_layout_create, &vk_internal_allocator, &layout);
+        {
+            std::lock_guard lock{layout_cache_mutex};
+            if(const auto itr = pipeline_layouts.find(key); itr != pipeline_layouts.end()) {
+                layout = itr->second;
+
+            } else {
+                // TODO: Get the push constants from reflection
+                const auto pipeline_layout_create = vk::PipelineLayoutCreateInfo()
+                                                        .setSetLayoutCount(static_cast<uint32_t>(ds_layouts.size()))
+                                                        .setPSetLayouts(ds_layouts.data())
+                                                        .setPushConstantRangeCount(static_cast<uint32_t>(standard_push_constants.size()))
+                                                        .setPPushConstantRanges(standard_push_constants.data());
+
+                device.createPipelineLayout(&pipeline_layout_create, vk_allocation_callbacks, &layout);
+                pipeline_layouts.emplace(key, layout);
+            }
+        }
 
-        std::vector<uint32_t> variable_descriptor_counts{&internal_allocator, ds_layouts.size()};
-        bindings.each_value([&](const RhiResourceBindingDescription& binding_desc) {
-            if(binding_desc.is_unbounded && binding_desc.count > variable_descriptor_counts[binding_desc.set]) {
+        std::vector<uint32_t> variable_descriptor_counts(ds_layouts.size(), 0);
+        for(const auto& [name, binding_desc] : bindings) {
+            if(binding_desc.is_unbounded && binding_desc.set < variable_descriptor_counts.size() &&
+               binding_desc.count > variable_descriptor_counts[binding_desc.set]) {
                 variable_descriptor_counts[binding_desc.set] = binding_desc.count;
             }
-        });
+        }
 
         return {bindings, ds_layouts, layout, variable_descriptor_counts};
     }
 
-    void VulkanRenderDevice::create_surface() {
+    vk::DescriptorSetLayout VulkanRenderDevice::get_descriptor_set_layout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings,
+                                                                          const std::vector<vk::DescriptorBindingFlags>& flags) {
+        std::vector<uint32_t> order(bindings.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](const uint32_t lhs, const uint32_t rhs) {
+            return bindings[lhs].binding < bindings[rhs].binding;
+        });
+
+        std::vector<vk::DescriptorSetLayoutBinding> sorted_bindings;
+        std::vector<vk::DescriptorBindingFlags> sorted_flags;
+        sorted_bindings.reserve(bindings.size());
+        sorted_flags.reserve(bindings.size());
+
+        // Immutable samplers are the only pointers in a binding, and Nova doesn't use them, so the key can just be the bindings' bytes
+        std::string key;
+        key.reserve(bindings.size() * 5 * sizeof(uint32_t));
+        const auto add_to_key = [&](const uint32_t value) { key.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        for(const uint32_t idx : order) {
+            const auto& binding = sorted_bindings.emplace_back(bindings[idx]);
+            const auto binding_flags = sorted_flags.emplace_back(flags[idx]);
+
+            add_to_key(binding.binding);
+            add_to_key(static_cast<uint32_t>(binding.descriptorType));
+            add_to_key(binding.descriptorCount);
+            add_to_key(static_cast<uint32_t>(binding.stageFlags));
+            add_to_key(static_cast<uint32_t>(binding_flags));
+        }
+
+        std::lock_guard lock{layout_cache_mutex};
+        if(const auto itr = descriptor_set_layouts.find(key); itr != descriptor_set_layouts.end()) {
+            return itr->second;
+        }
+
+        const auto flags_create = vk::DescriptorSetLayoutBindingFlagsCreateInfo()
+                                      .setBindingCount(static_cast<uint32_t>(sorted_flags.size()))
+                                      .setPBindingFlags(sorted_flags.data());
+
+        const auto layout_create = vk::DescriptorSetLayoutCreateInfo()
+                                       .setBindingCount(static_cast<uint32_t>(sorted_bindings.size()))
+                                       .setPBindings(sorted_bindings.data())
+                                       .setPNext(&flags_create);
+
+        vk::DescriptorSetLayout layout;
+        device.createDescriptorSetLayout(&layout_create, vk_allocation_callbacks, &layout);
+        descriptor_set_layouts.emplace(std::move(key), layout);
+
+        return layout;
+    }
+
+    vk::SurfaceKHR VulkanRenderDevice::create_surface(const NovaWindow& window) const {
         ZoneScoped;
+        vk::SurfaceKHR surface{};
+
 #ifdef NOVA_LINUX vk::XlibSurfaceCreateInfoKHR x_surface_create_info;
         x_surface_create_info.sType = VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR;
         x_surface_create_info.pNext = nullptr;
@@ -1219,20 +2989,20 @@ namespace nova::renderer::rhi {
         x_surface_create_info.dpy = window.get_display();
         x_surface_create_info.window = window.get_window_handle();
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(internal_allocator);
-        NOVA_CHECK_RESULT(vkCreateXlibSurfaceKHR(instance, &x_surface_create_info, &vk_alloc, &surface));
+        NOVA_CHECK_RESULT(vkCreateXlibSurfaceKHR(instance, &x_surface_create_info, allocation_callbacks, &surface));
 
 #elif defined(NOVA_WINDOWS)
         vk::Win32SurfaceCreateInfoKHR win32_surface_create = {};
         win32_surface_create.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
         win32_surface_create.hwnd = window.get_window_handle();
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(internal_allocator);
-        NOVA_CHECK_RESULT(vkCreateWin32SurfaceKHR(instance, &win32_surface_create, &vk_alloc, &surface));
+        NOVA_CHECK_RESULT(vkCreateWin32SurfaceKHR(instance, &win32_surface_create, allocation_callbacks, &surface));
 
 #else
 #error Unsuported window system
 #endif
+
+        return surface;
     }
 
     void VulkanRenderDevice::create_instance() {
@@ -1294,10 +3064,9 @@ namespace nova::renderer::rhi {
 
         create_info.pNext = &validation_features;
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(internal_allocator);
         {
             ZoneScoped;
-            NOVA_CHECK_RESULT(vkCreateInstance(&create_info, &vk_alloc, &instance));
+            NOVA_CHECK_RESULT(vkCreateInstance(&create_info, allocation_callbacks, &instance));
         }
     }
 
@@ -1318,8 +3087,7 @@ namespace nova::renderer::rhi {
         debug_create_info.pfnUserCallback = reinterpret_cast<PFN_vkDebugUtilsMessengerCallbackEXT>(&debug_report_callback);
         debug_create_info.pUserData = this;
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(internal_allocator);
-        NOVA_CHECK_RESULT(vkCreateDebugUtilsMessengerEXT(instance, &debug_create_info, &vk_alloc, &debug_callback));
+        NOVA_CHECK_RESULT(vkCreateDebugUtilsMessengerEXT(instance, &debug_create_info, allocation_callbacks, &debug_callback));
     }
 
     void VulkanRenderDevice::save_device_info() {
@@ -1342,11 +3110,38 @@ namespace nova::renderer::rhi {
         }
 
         vk_info.max_uniform_buffer_size = gpu.props.limits.maxUniformBufferRange;
+        if(gpu.props.limits.timestampComputeAndGraphics == VK_TRUE) {
+            info.timestamp_period = gpu.props.limits.timestampPeriod;
+        }
+        info.supports_pipeline_statistics = gpu.supported_features.pipelineStatisticsQuery == VK_TRUE &&
+                                            gpu.supported_features.inheritedQueries == VK_TRUE;
         info.max_texture_size = gpu.props.limits.maxImageDimension2D;
-
-        // TODO: Something smarter when Intel releases discreet GPUS
-        // TODO: Handle integrated AMD GPUs
-        info.is_uma = info.architecture == DeviceArchitecture::intel;
+        info.min_buffer_offset_alignment = std::max(gpu.props.limits.minUniformBufferOffsetAlignment,
+                                                    gpu.props.limits.minStorageBufferOffsetAlignment);
+
+        // Subgroups are core in Vulkan 1.1, but which of their operations work in which stages is up to the device
+        auto subgroup_properties = vk::PhysicalDeviceSubgroupProperties();
+        auto properties = vk::PhysicalDeviceProperties2().setPNext(&subgroup_properties);
+        vkGetPhysicalDeviceProperties2(gpu.phys_device, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+        info.supports_compute_quad_operations = (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0U &&
+                                                (subgroup_properties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT) != 0U;
+
+        // Integrated GPUs share the system's memory, no matter who made them
+        info.is_uma = gpu.props.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+                      gpu.props.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+
+        // Without resizable BAR, the host-visible part of device memory is a 256 MB window that the driver uses for itself
+        constexpr VkDeviceSize MIN_HOST_VISIBLE_HEAP_SIZE = 256 * 1024 * 1024;
+        info.has_host_visible_device_memory = info.is_uma;
+        for(uint32_t i = 0; i < gpu.memory_properties.memoryTypeCount; i++) {
+            const auto& memory_type = gpu.memory_properties.memoryTypes[i];
+            const auto host_visible_device_local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            if((memory_type.propertyFlags & host_visible_device_local) == host_visible_device_local &&
+               gpu.memory_properties.memoryHeaps[memory_type.heapIndex].size > MIN_HOST_VISIBLE_HEAP_SIZE) {
+                info.has_host_visible_device_memory = true;
+                break;
+            }
+        }
 
         uint32_t extension_count;
         vkEnumerateDeviceExtensionProperties(gpu.phys_device, nullptr, &extension_count, nullptr);
@@ -1367,13 +3162,14 @@ namespace nova::renderer::rhi {
 
     void VulkanRenderDevice::initialize_vma() {
         ZoneScoped;
-        vk::AllocationCallbacks callbacks = vk_internal_allocator;
-
         VmaAllocatorCreateInfo create_info{};
         create_info.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        if(vk_info.supports_memory_priority) {
+            create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_PRIORITY_BIT;
+        }
         create_info.physicalDevice = gpu.phys_device;
         create_info.device = device;
-        create_info.pAllocationCallbacks = &callbacks;
+        create_info.pAllocationCallbacks = allocation_callbacks;
         create_info.instance = instance;
 
         const auto result = vmaCreateAllocator(&create_info, &vma);
@@ -1383,6 +3179,451 @@ namespace nova::renderer::rhi {
         }
     }
 
+    static VmaPoolCreateInfo make_pool_create_info(const uint32_t memory_type_idx,
+                                                   const NovaSettings::BlockAllocatorSettings& block_settings,
+                                                   const VmaPoolCreateFlags flags = 0) {
+        VmaPoolCreateInfo create_info{};
+        create_info.memoryTypeIndex = memory_type_idx;
+        create_info.flags = flags;
+        create_info.blockSize = block_settings.new_buffer_size;
+        create_info.maxBlockCount = std::max<size_t>(block_settings.max_total_allocation / block_settings.new_buffer_size, 1);
+
+        return create_info;
+    }
+
+    void VulkanRenderDevice::create_memory_pools() {
+        ZoneScoped;
+        const auto create_pool = [&](const MemoryPoolClass pool_class, const VmaPoolCreateInfo& create_info) {
+            const auto pool_idx = static_cast<size_t>(pool_class);
+            if(const auto result = vmaCreatePool(vma, &create_info, &memory_pools[pool_idx]); result != VK_SUCCESS) {
+                logger->error("Could not create the {} memory pool: {}", MEMORY_POOL_NAMES[pool_idx], to_string(result));
+                memory_pools[pool_idx] = VK_NULL_HANDLE;
+                return;
+            }
+
+            vmaSetPoolName(vma, memory_pools[pool_idx], MEMORY_POOL_NAMES[pool_idx]);
+        };
+
+        // Finds the memory type that VMA would pick for a typical buffer of the pool's class
+        const auto find_buffer_memory_type = [&](const VkBufferUsageFlags usage, const VmaMemoryUsage memory_usage) {
+            VkBufferCreateInfo buffer_info{};
+            buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            buffer_info.size = 64 * 1024;
+            buffer_info.usage = usage;
+            buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VmaAllocationCreateInfo alloc_info{};
+            alloc_info.usage = memory_usage;
+
+            uint32_t memory_type_idx = 0;
+            const auto result = vmaFindMemoryTypeIndexForBufferInfo(vma, &buffer_info, &alloc_info, &memory_type_idx);
+            return result == VK_SUCCESS ? std::optional{memory_type_idx} : std::nullopt;
+        };
+
+        // Vertices and indices share one pool, so it gets the memory of both of their mesh arenas
+        const auto& vertex_settings = settings->vertex_memory_settings;
+        const auto& index_settings = settings->index_memory_settings;
+        NovaSettings::BlockAllocatorSettings mesh_settings;
+        mesh_settings.max_total_allocation = vertex_settings.max_total_allocation + index_settings.max_total_allocation;
+        mesh_settings.new_buffer_size = std::max(vertex_settings.new_buffer_size, index_settings.new_buffer_size);
+        if(const auto memory_type_idx = find_buffer_memory_type(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                                                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                                 VMA_MEMORY_USAGE_GPU_ONLY)) {
+            create_pool(MemoryPoolClass::MeshGeometry, make_pool_create_info(*memory_type_idx, mesh_settings));
+        }
+
+        {
+            VkImageCreateInfo image_info{};
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+            image_info.extent = {1024, 1024, 1};
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VmaAllocationCreateInfo alloc_info{};
+            alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+            uint32_t memory_type_idx = 0;
+            if(vmaFindMemoryTypeIndexForImageInfo(vma, &image_info, &alloc_info, &memory_type_idx) == VK_SUCCESS) {
+                create_pool(MemoryPoolClass::StreamedTextures, make_pool_create_info(memory_type_idx, settings->texture_memory_settings));
+            }
+        }
+
+        // Upload buffers are made once at startup and live until shutdown, so the linear algorithm packs them without any bookkeeping
+        // overhead. Staging buffers come and go in any order, so they get VMA's general-purpose algorithm
+        if(const auto memory_type_idx = find_buffer_memory_type(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                                 VMA_MEMORY_USAGE_CPU_TO_GPU)) {
+            create_pool(MemoryPoolClass::Upload,
+                        make_pool_create_info(*memory_type_idx, settings->upload_memory_settings, VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT));
+        }
+
+        if(const auto memory_type_idx = find_buffer_memory_type(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY)) {
+            create_pool(MemoryPoolClass::Staging, make_pool_create_info(*memory_type_idx, settings->upload_memory_settings));
+        }
+    }
+
+    VmaPool VulkanRenderDevice::get_memory_pool(const MemoryPoolClass pool_class) const {
+        return memory_pools[static_cast<size_t>(pool_class)];
+    }
+
+    VmaPool VulkanRenderDevice::get_buffer_memory_pool(const BufferUsage usage) const {
+        switch(usage) {
+            case BufferUsage::VertexBuffer:
+            case BufferUsage::IndexBuffer:
+                return get_memory_pool(MemoryPoolClass::MeshGeometry);
+
+            case BufferUsage::UploadBuffer:
+                return get_memory_pool(MemoryPoolClass::Upload);
+
+            case BufferUsage::StagingBuffer:
+                return get_memory_pool(MemoryPoolClass::Staging);
+
+            default:
+                return VK_NULL_HANDLE;
+        }
+    }
+
+    void VulkanRenderDevice::track_allocation(const VmaAllocation allocation,
+                                              const MemoryCategory category,
+                                              const std::string& owner,
+                                              const std::string& name) {
+        // The allocation may be bigger than the resource asked for, and what it actually takes is what counts against the budget
+        VmaAllocationInfo allocation_info;
+        vmaGetAllocationInfo(vma, allocation, &allocation_info);
+
+        memory_tracker.add(allocation, category, owner.empty() ? name : owner, allocation_info.size);
+    }
+
+    bool VulkanRenderDevice::record_defragmentation(RhiRenderCommandList& cmds, const uint32_t max_moves, const mem::Bytes max_bytes) {
+        ZoneScoped;
+        std::lock_guard lock{defragmentation_mutex};
+        auto& state = defragmentation;
+        if(state.pass_frame || num_frames_begun < state.idle_until_frame) {
+            return false;
+        }
+
+        // Upload buffers live forever and staging buffers are recycled by size, so only these pools fragment
+        constexpr std::array DEFRAGMENTED_POOLS{MemoryPoolClass::MeshGeometry, MemoryPoolClass::StreamedTextures};
+
+        while(state.context == VK_NULL_HANDLE) {
+            if(state.pool_idx >= DEFRAGMENTED_POOLS.size()) {
+                state.pool_idx = 0;
+                state.idle_until_frame = num_frames_begun + DEFRAGMENTATION_IDLE_FRAMES;
+                return false;
+            }
+
+            const auto pool = get_memory_pool(DEFRAGMENTED_POOLS[state.pool_idx]);
+            if(pool == VK_NULL_HANDLE) {
+                state.pool_idx++;
+                continue;
+            }
+
+            VmaDefragmentationInfo defragmentation_info{};
+            defragmentation_info.pool = pool;
+            defragmentation_info.maxBytesPerPass = max_bytes.b_count();
+            defragmentation_info.maxAllocationsPerPass = max_moves;
+            if(vmaBeginDefragmentation(vma, &defragmentation_info, &state.context) != VK_SUCCESS) {
+                state.context = VK_NULL_HANDLE;
+                state.pool_idx++;
+            }
+        }
+
+        if(vmaBeginDefragmentationPass(vma, state.context, &state.pass) == VK_SUCCESS) {
+            // There's nothing left to move in this pool
+            VmaDefragmentationStats stats{};
+            vmaEndDefragmentation(vma, state.context, &stats);
+            if(stats.allocationsMoved > 0) {
+                logger->debug("Defragmented the {} memory pool: moved {} allocations and {} bytes, and freed {} bytes",
+                              MEMORY_POOL_NAMES[static_cast<size_t>(DEFRAGMENTED_POOLS[state.pool_idx])],
+                              stats.allocationsMoved,
+                              stats.bytesMoved,
+                              stats.bytesFreed);
+            }
+
+            state.context = VK_NULL_HANDLE;
+            state.pool_idx++;
+            return false;
+        }
+
+        const auto vk_cmds = static_cast<VulkanRenderCommandList&>(cmds).cmds;
+        std::vector<vk::BufferCopy> buffer_copies;
+        std::vector<std::pair<vk::Buffer, vk::Buffer>> buffers_to_copy;
+        std::vector<vk::ImageMemoryBarrier> image_barriers_before;
+        std::vector<vk::ImageMemoryBarrier> image_barriers_after;
+        std::vector<std::pair<vk::Image, VulkanImage*>> images_to_copy;
+
+        state.moves.clear();
+        for(uint32_t move_idx = 0; move_idx < state.pass.moveCount; move_idx++) {
+            auto& move = state.pass.pMoves[move_idx];
+
+            VmaAllocationInfo allocation_info{};
+            vmaGetAllocationInfo(vma, move.srcAllocation, &allocation_info);
+            auto* resource = static_cast<RhiResource*>(allocation_info.pUserData);
+            if(resource == nullptr) {
+                move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                continue;
+            }
+
+            if(resource->type == ResourceType::Buffer) {
+                auto* buffer = static_cast<VulkanBuffer*>(resource);
+
+                vk::BufferCreateInfo buffer_create_info = {};
+                buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                buffer_create_info.size = buffer->size.b_count();
+                buffer_create_info.usage = buffer->usage;
+                buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+                vk::Buffer new_buffer = VK_NULL_HANDLE;
+                if(vkCreateBuffer(device, &buffer_create_info, allocation_callbacks, &new_buffer) != VK_SUCCESS) {
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+
+                if(vmaBindBufferMemory(vma, move.dstTmpAllocation, new_buffer) != VK_SUCCESS) {
+                    vkDestroyBuffer(device, new_buffer, allocation_callbacks);
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+
+                buffers_to_copy.emplace_back(buffer->buffer, new_buffer);
+                buffer_copies.push_back(vk::BufferCopy{0, 0, buffer->size.b_count()});
+                state.moves.push_back({resource, move_idx, buffer->buffer});
+                buffer->buffer = new_buffer;
+
+            } else {
+                auto* image = static_cast<VulkanImage*>(resource);
+
+                // Nothing has necessarily uploaded to a brand new image yet, so its layout isn't known
+                if(image->creation_frame + settings->max_in_flight_frames >= num_frames_begun) {
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+
+                vk::Image new_image = VK_NULL_HANDLE;
+                if(vkCreateImage(device, &image->create_info, allocation_callbacks, &new_image) != VK_SUCCESS) {
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+
+                if(vmaBindImageMemory(vma, move.dstTmpAllocation, new_image) != VK_SUCCESS) {
+                    vkDestroyImage(device, new_image, allocation_callbacks);
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+
+                const auto make_barrier = [&](const vk::Image barrier_image,
+                                              const vk::ImageLayout old_layout,
+                                              const vk::ImageLayout new_layout,
+                                              const vk::AccessFlags src_access,
+                                              const vk::AccessFlags dst_access) {
+                    vk::ImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = src_access;
+                    barrier.dstAccessMask = dst_access;
+                    barrier.oldLayout = old_layout;
+                    barrier.newLayout = new_layout;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.image = barrier_image;
+                    barrier.subresourceRange.aspectMask = image->is_depth_tex ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+                    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+                    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+                    return barrier;
+                };
+
+                // Sampled images are in ShaderReadOnlyOptimal whenever nothing's uploading to them, and this frame's uploads were
+                // recorded before this
+                image_barriers_before.push_back(make_barrier(image->image,
+                                                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                             VK_ACCESS_MEMORY_WRITE_BIT,
+                                                             VK_ACCESS_TRANSFER_READ_BIT));
+                image_barriers_before.push_back(make_barrier(new_image,
+                                                             VK_IMAGE_LAYOUT_UNDEFINED,
+                                                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                             0,
+                                                             VK_ACCESS_TRANSFER_WRITE_BIT));
+                image_barriers_after.push_back(make_barrier(new_image,
+                                                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                            VK_ACCESS_TRANSFER_WRITE_BIT,
+                                                            VK_ACCESS_SHADER_READ_BIT));
+
+                // This frame's standard descriptor set was written before the move, so it still samples the old image
+                image_barriers_after.push_back(make_barrier(image->image,
+                                                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                            0,
+                                                            VK_ACCESS_SHADER_READ_BIT));
+
+                DefragmentationMove moved_image{resource, move_idx, VK_NULL_HANDLE, image->image};
+                moved_image.old_image_views.push_back(image->image_view);
+                {
+                    // Views of parts of the image are remade for the new image when they're next asked for
+                    std::lock_guard view_lock{image_view_mutex};
+                    for(const auto& [desc, view] : image->extra_views) {
+                        moved_image.old_image_views.push_back(view);
+                    }
+                    image->extra_views.clear();
+                }
+
+                images_to_copy.emplace_back(image->image, image);
+                state.moves.push_back(std::move(moved_image));
+
+                // The standard descriptor set sees the new view and rewrites the image's descriptor
+                image->image = new_image;
+                image->image_view = create_full_image_view(*image, new_image);
+            }
+        }
+
+        if(state.moves.empty()) {
+            // Nothing could be moved this time, so the pass is over already
+            state.pass_frame = num_frames_begun;
+            finish_defragmentation_pass();
+            return false;
+        }
+
+        // Anything before this may have written to the resources, including uploads that were acquired from the transfer queue
+        vk::MemoryBarrier memory_barrier_before = {};
+        memory_barrier_before.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memory_barrier_before.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        memory_barrier_before.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(vk_cmds,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             1,
+                             &memory_barrier_before,
+                             0,
+                             nullptr,
+                             static_cast<uint32_t>(image_barriers_before.size()),
+                             image_barriers_before.data());
+
+        for(uint32_t i = 0; i < buffers_to_copy.size(); i++) {
+            vkCmdCopyBuffer(vk_cmds, buffers_to_copy[i].first, buffers_to_copy[i].second, 1, &buffer_copies[i]);
+        }
+
+        std::vector<vk::ImageCopy> mip_copies;
+        for(const auto& [old_image, image] : images_to_copy) {
+            mip_copies.clear();
+            const auto& extent = image->create_info.extent;
+            for(uint32_t mip = 0; mip < image->num_mips; mip++) {
+                vk::ImageCopy copy = {};
+                copy.srcSubresource.aspectMask = image->is_depth_tex ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+                copy.srcSubresource.mipLevel = mip;
+                copy.srcSubresource.layerCount = image->num_layers;
+                copy.dstSubresource = copy.srcSubresource;
+                copy.extent = vk::Extent3D{std::max(extent.width >> mip, 1U),
+                                           std::max(extent.height >> mip, 1U),
+                                           std::max(extent.depth >> mip, 1U)};
+                mip_copies.push_back(copy);
+            }
+
+            vkCmdCopyImage(vk_cmds,
+                           old_image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           image->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(mip_copies.size()),
+                           mip_copies.data());
+        }
+
+        vk::MemoryBarrier memory_barrier_after = {};
+        memory_barrier_after.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memory_barrier_after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memory_barrier_after.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(vk_cmds,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             1,
+                             &memory_barrier_after,
+                             0,
+                             nullptr,
+                             static_cast<uint32_t>(image_barriers_after.size()),
+                             image_barriers_after.data());
+
+        state.pass_frame = num_frames_begun;
+
+        return true;
+    }
+
+    void VulkanRenderDevice::finish_defragmentation_pass() {
+        ZoneScoped;
+        auto& state = defragmentation;
+        for(const DefragmentationMove& move : state.moves) {
+            if(move.old_buffer != VK_NULL_HANDLE) {
+                vkDestroyBuffer(device, move.old_buffer, allocation_callbacks);
+            }
+
+            for(const auto view : move.old_image_views) {
+                vkDestroyImageView(device, view, allocation_callbacks);
+            }
+
+            if(move.old_image != VK_NULL_HANDLE) {
+                vkDestroyImage(device, move.old_image, allocation_callbacks);
+            }
+        }
+
+        // VMA swaps the moved resources' allocations over to their new memory, which mapped buffers need to know about
+        const auto result = vmaEndDefragmentationPass(vma, state.context, &state.pass);
+        for(const DefragmentationMove& move : state.moves) {
+            if(move.resource != nullptr && move.resource->type == ResourceType::Buffer) {
+                auto* buffer = static_cast<VulkanBuffer*>(move.resource);
+                vmaGetAllocationInfo(vma, buffer->allocation, &buffer->allocation_info);
+            }
+        }
+
+        state.moves.clear();
+        state.pass_frame = std::nullopt;
+
+        if(result == VK_SUCCESS) {
+            // That was the pool's last pass
+            vmaEndDefragmentation(vma, state.context, nullptr);
+            state.context = VK_NULL_HANDLE;
+            state.pool_idx++;
+        }
+    }
+
+    bool VulkanRenderDevice::cancel_defragmentation_move(const RhiResource* resource) {
+        std::lock_guard lock{defragmentation_mutex};
+        auto& state = defragmentation;
+        if(!state.pass_frame) {
+            return false;
+        }
+
+        const auto move_itr = std::find_if(state.moves.begin(), state.moves.end(), [&](const DefragmentationMove& move) {
+            return move.resource == resource;
+        });
+        if(move_itr == state.moves.end()) {
+            return false;
+        }
+
+        // Whoever destroys a resource has waited for the GPU to finish with it, so its old handles can go too
+        if(move_itr->old_buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, move_itr->old_buffer, allocation_callbacks);
+        }
+        for(const auto view : move_itr->old_image_views) {
+            vkDestroyImageView(device, view, allocation_callbacks);
+        }
+        if(move_itr->old_image != VK_NULL_HANDLE) {
+            vkDestroyImage(device, move_itr->old_image, allocation_callbacks);
+        }
+
+        state.pass.pMoves[move_itr->move_idx].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+        *move_itr = {};
+
+        return true;
+    }
+
     void VulkanRenderDevice::create_device_and_queues() {
         ZoneScoped;
         std::vector<char*> device_extensions{&internal_allocator};
@@ -1396,11 +3637,15 @@ namespace nova::renderer::rhi {
 
         uint32_t graphics_family_idx = 0xFFFFFFFF;
         uint32_t compute_family_idx = 0xFFFFFFFF;
+        uint32_t dedicated_compute_family_idx = 0xFFFFFFFF;
         uint32_t copy_family_idx = 0xFFFFFFFF;
         {
             ZoneScoped;
             for(uint32_t device_idx = 0; device_idx < device_count; device_idx++) {
                 graphics_family_idx = 0xFFFFFFFF;
+                compute_family_idx = 0xFFFFFFFF;
+                dedicated_compute_family_idx = 0xFFFFFFFF;
+                copy_family_idx = 0xFFFFFFFF;
                 vk::PhysicalDevice current_device = physical_devices[device_idx];
                 vkGetPhysicalDeviceProperties(current_device, &gpu.props);
 
@@ -1438,8 +3683,14 @@ namespace nova::renderer::rhi {
                     }
 
                     const vk::QueueFlags supports_compute = current_properties.queueFlags & VK_QUEUE_COMPUTE_BIT;
-                    if((supports_compute != 0U) && compute_family_idx == 0xFFFFFFFF) {
-                        compute_family_idx = queue_idx;
+                    if(supports_compute != 0U) {
+                        if(compute_family_idx == 0xFFFFFFFF) {
+                            compute_family_idx = queue_idx;
+                        }
+
+                        if(supports_graphics == 0U && dedicated_compute_family_idx == 0xFFFFFFFF) {
+                            dedicated_compute_family_idx = queue_idx;
+                        }
                     }
 
                     const vk::QueueFlags supports_copy = current_properties.queueFlags & VK_QUEUE_TRANSFER_BIT;
@@ -1449,6 +3700,12 @@ namespace nova::renderer::rhi {
                 }
 
                 if(graphics_family_idx != 0xFFFFFFFF) {
+                    // Queues from a compute-only family run alongside the graphics queue instead of sharing its hardware, which is the
+                    // whole point of async compute
+                    if(dedicated_compute_family_idx != 0xFFFFFFFF) {
+                        compute_family_idx = dedicated_compute_family_idx;
+                    }
+
                     logger->info("Selected GPU %s", gpu.props.deviceName);
                     gpu.phys_device = current_device;
                     break;
@@ -1472,18 +3729,118 @@ namespace nova::renderer::rhi {
                           VulkanRenderDevice,
                           vkGetPhysicalDeviceMemoryProperties);
 
-        const float priority = 1.0;
+        // Memory priorities are only a hint, so we're happy to go without them
+        uint32_t extension_count;
+        vkEnumerateDeviceExtensionProperties(gpu.phys_device, nullptr, &extension_count, nullptr);
+        std::vector<vk::ExtensionProperties> available_extensions(extension_count);
+        vkEnumerateDeviceExtensionProperties(gpu.phys_device, nullptr, &extension_count, available_extensions.data());
+        const auto is_memory_priority = [](const vk::ExtensionProperties& extension) {
+            return strcmp(extension.extensionName, VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME) == 0;
+        };
+        vk_info.supports_memory_priority = std::any_of(available_extensions.begin(), available_extensions.end(), is_memory_priority);
+        if(vk_info.supports_memory_priority) {
+            device_extensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+        }
+
+        // Frame pacing can tell when frames reach the display with these. Without them it has to go by fences
+        const auto has_extension = [&](const char* extension_name) {
+            return std::any_of(available_extensions.begin(), available_extensions.end(), [&](const vk::ExtensionProperties& extension) {
+                return strcmp(extension.extensionName, extension_name) == 0;
+            });
+        };
+        if(has_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+            auto supported_present_wait = vk::PhysicalDevicePresentWaitFeaturesKHR();
+            auto supported_present_id = vk::PhysicalDevicePresentIdFeaturesKHR().setPNext(&supported_present_wait);
+            auto supported_features = vk::PhysicalDeviceFeatures2().setPNext(&supported_present_id);
+            vkGetPhysicalDeviceFeatures2(gpu.phys_device, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&supported_features));
+
+            vk_info.supports_present_wait = supported_present_id.presentId == VK_TRUE && supported_present_wait.presentWait == VK_TRUE;
+        }
+        if(vk_info.supports_present_wait) {
+            device_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            device_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+
+        // Without dynamic rendering, every pass gets a VkRenderPass and a VkFramebuffer like it always did
+        if(settings->vulkan.use_dynamic_rendering && has_extension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+            auto supported_dynamic_rendering = vk::PhysicalDeviceDynamicRenderingFeaturesKHR();
+            auto supported_features = vk::PhysicalDeviceFeatures2().setPNext(&supported_dynamic_rendering);
+            vkGetPhysicalDeviceFeatures2(gpu.phys_device, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&supported_features));
 
-        vk::DeviceQueueCreateInfo graphics_queue_create_info{};
-        graphics_queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        graphics_queue_create_info.pNext = nullptr;
-        graphics_queue_create_info.flags = 0;
-        graphics_queue_create_info.queueCount = 1;
-        graphics_queue_create_info.queueFamilyIndex = graphics_family_idx;
-        graphics_queue_create_info.pQueuePriorities = &priority;
+            vk_info.supports_dynamic_rendering = supported_dynamic_rendering.dynamicRendering == VK_TRUE;
+        }
+        if(vk_info.supports_dynamic_rendering) {
+            // Its other dependencies are core in Vulkan 1.2
+            device_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        }
+
+        // Passes with a shading rate shade at full rate without this. Shading rate attachments only fit into dynamic rendering, because
+        // a vk::RenderPass would need vkCreateRenderPass2 for them
+        auto supported_shading_rate = vk::PhysicalDeviceFragmentShadingRateFeaturesKHR();
+        if(settings->variable_rate_shading.enabled && has_extension(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME)) {
+            auto supported_features = vk::PhysicalDeviceFeatures2().setPNext(&supported_shading_rate);
+            vkGetPhysicalDeviceFeatures2(gpu.phys_device, reinterpret_cast<VkPhysicalDeviceFeatures2*>(&supported_features));
+
+            auto shading_rate_properties = vk::PhysicalDeviceFragmentShadingRatePropertiesKHR();
+            auto properties = vk::PhysicalDeviceProperties2().setPNext(&shading_rate_properties);
+            vkGetPhysicalDeviceProperties2(gpu.phys_device, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+
+            vk_info.supports_fragment_shading_rate = supported_shading_rate.pipelineFragmentShadingRate == VK_TRUE;
+            vk_info.supports_shading_rate_attachment = vk_info.supports_fragment_shading_rate && vk_info.supports_dynamic_rendering &&
+                                                       supported_shading_rate.attachmentFragmentShadingRate == VK_TRUE;
+            vk_info.supports_shading_rate_combiner_ops = shading_rate_properties.fragmentShadingRateNonTrivialCombinerOps == VK_TRUE;
+
+            // Big tiles are cheaper to fill in, but 16 pixels is about as coarse as the rate can change before it's noticeable
+            const auto& min_texel_size = shading_rate_properties.minFragmentShadingRateAttachmentTexelSize;
+            const auto& max_texel_size = shading_rate_properties.maxFragmentShadingRateAttachmentTexelSize;
+            if(vk_info.supports_shading_rate_attachment && min_texel_size.width == min_texel_size.height) {
+                const auto max_square_texel_size = std::min(max_texel_size.width, max_texel_size.height);
+                info.shading_rate_image_texel_size = std::clamp(16U, min_texel_size.width, max_square_texel_size);
+
+            } else {
+                vk_info.supports_shading_rate_attachment = false;
+            }
+        }
+        if(vk_info.supports_fragment_shading_rate) {
+            device_extensions.push_back(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME);
+            info.supports_variable_rate_shading = true;
+        }
 
+        // VK_KHR_depth_stencil_resolve is core in Vulkan 1.2, but a vk::RenderPass would need vkCreateRenderPass2 to resolve depth, so
+        // only dynamic rendering passes do. Without it, multisampled depth textures never get anything resolved into them
+        if(vk_info.supports_dynamic_rendering) {
+            auto depth_resolve_properties = vk::PhysicalDeviceDepthStencilResolveProperties();
+            auto properties = vk::PhysicalDeviceProperties2().setPNext(&depth_resolve_properties);
+            vkGetPhysicalDeviceProperties2(gpu.phys_device, reinterpret_cast<VkPhysicalDeviceProperties2*>(&properties));
+
+            vk_info.supports_depth_resolve = static_cast<bool>(depth_resolve_properties.supportedDepthResolveModes &
+                                                               vk::ResolveModeFlagBits::eSampleZero);
+        }
+
+        const float priority = 1.0;
+
+        // Each family gets one queue, and the families we picked may well be the same one
         std::vector<vk::DeviceQueueCreateInfo> queue_create_infos{&internal_allocator};
-        queue_create_infos.push_back(graphics_queue_create_info);
+        for(const uint32_t family_idx : {graphics_family_idx, compute_family_idx, copy_family_idx}) {
+            const auto already_created = std::any_of(queue_create_infos.begin(),
+                                                     queue_create_infos.end(),
+                                                     [&](const vk::DeviceQueueCreateInfo& info) {
+                                                         return info.queueFamilyIndex == family_idx;
+                                                     });
+            if(already_created) {
+                continue;
+            }
+
+            vk::DeviceQueueCreateInfo queue_create_info{};
+            queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queue_create_info.pNext = nullptr;
+            queue_create_info.flags = 0;
+            queue_create_info.queueCount = 1;
+            queue_create_info.queueFamilyIndex = family_idx;
+            queue_create_info.pQueuePriorities = &priority;
+
+            queue_create_infos.push_back(queue_create_info);
+        }
 
         vk::PhysicalDeviceFeatures physical_device_features{};
         physical_device_features.geometryShader = VK_TRUE;
@@ -1491,6 +3848,20 @@ namespace nova::renderer::rhi {
         physical_device_features.samplerAnisotropy = VK_TRUE;
         physical_device_features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 
+        // Block-compressed textures need one of these. Desktop GPUs have BC, mobile ones have ASTC
+        physical_device_features.textureCompressionBC = gpu.supported_features.textureCompressionBC;
+        physical_device_features.textureCompressionASTC_LDR = gpu.supported_features.textureCompressionASTC_LDR;
+
+        // GPU culling writes one indirect draw per mesh batch, and uses firstInstance to find each batch's model matrices
+        physical_device_features.multiDrawIndirect = VK_TRUE;
+        physical_device_features.drawIndirectFirstInstance = VK_TRUE;
+
+        // Renderpass statistics count in the secondary command lists that renderpasses are recorded into
+        if(gpu.supported_features.pipelineStatisticsQuery == VK_TRUE && gpu.supported_features.inheritedQueries == VK_TRUE) {
+            physical_device_features.pipelineStatisticsQuery = VK_TRUE;
+            physical_device_features.inheritedQueries = VK_TRUE;
+        }
+
         if(settings->debug.enable_gpu_based_validation) {
             physical_device_features.fragmentStoresAndAtomics = VK_TRUE;
             physical_device_features.vertexPipelineStoresAndAtomics = VK_TRUE;
@@ -1522,19 +3893,54 @@ namespace nova::renderer::rhi {
         descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
         device_create_info.pNext = &descriptor_indexing_features;
 
+        // Optional features only go in the chain if we enabled their extensions
+        void* optional_features = nullptr;
+
+        auto present_wait_features = vk::PhysicalDevicePresentWaitFeaturesKHR().setPresentWait(true);
+        auto present_id_features = vk::PhysicalDevicePresentIdFeaturesKHR().setPNext(&present_wait_features).setPresentId(true);
+        if(vk_info.supports_present_wait) {
+            optional_features = &present_id_features;
+        }
+
+        auto memory_priority_features = vk::PhysicalDeviceMemoryPriorityFeaturesEXT().setMemoryPriority(true);
+        if(vk_info.supports_memory_priority) {
+            memory_priority_features.setPNext(optional_features);
+            optional_features = &memory_priority_features;
+        }
+
+        auto dynamic_rendering_features = vk::PhysicalDeviceDynamicRenderingFeaturesKHR().setDynamicRendering(true);
+        if(vk_info.supports_dynamic_rendering) {
+            dynamic_rendering_features.setPNext(optional_features);
+            optional_features = &dynamic_rendering_features;
+        }
+
+        auto shading_rate_features = vk::PhysicalDeviceFragmentShadingRateFeaturesKHR()
+                                         .setPipelineFragmentShadingRate(true)
+                                         .setAttachmentFragmentShadingRate(vk_info.supports_shading_rate_attachment);
+        if(vk_info.supports_fragment_shading_rate) {
+            shading_rate_features.setPNext(optional_features);
+            optional_features = &shading_rate_features;
+        }
+
+        // Multiview is required in Vulkan 1.1, so we don't have to check for it
+        auto dev_11_features = vk::PhysicalDeviceVulkan11Features().setPNext(optional_features).setMultiview(true);
+
         const auto dev_12_features = vk::PhysicalDeviceVulkan12Features()
+                                         .setPNext(&dev_11_features)
                                          .setDescriptorIndexing(true)
                                          .setShaderSampledImageArrayNonUniformIndexing(true)
                                          .setRuntimeDescriptorArray(true)
                                          .setDescriptorBindingVariableDescriptorCount(true)
                                          .setDescriptorBindingPartiallyBound(true)
-                                         .setDescriptorBindingSampledImageUpdateAfterBind(true);
+                                         .setDescriptorBindingSampledImageUpdateAfterBind(true)
+                                         .setDrawIndirectCount(true)
+                                         .setTimelineSemaphore(true)
+                                         .setHostQueryReset(true);
 
         device_create_info.pNext = &dev_12_features;
 
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(internal_allocator);
         vk::Device vk_device;
-        const auto res = PROFILE_RET_EXPR(vkCreateDevice(gpu.phys_device, &device_create_info, &vk_alloc, &vk_device),
+        const auto res = PROFILE_RET_EXPR(vkCreateDevice(gpu.phys_device, &device_create_info, allocation_callbacks, &vk_device),
                                           VulkanRenderEngine,
                                           vkCreateDevice);
         if(res != VK_SUCCESS) {
@@ -1548,6 +3954,8 @@ namespace nova::renderer::rhi {
         vkGetDeviceQueue(device, compute_family_idx, 0, &compute_queue);
         transfer_family_index = copy_family_idx;
         vkGetDeviceQueue(device, copy_family_idx, 0, &copy_queue);
+
+        info.has_async_compute_queue = compute_family_idx != graphics_family_idx;
     }
 
     bool VulkanRenderDevice::does_device_support_extensions(vk::PhysicalDevice device, const std::vector<char*>& required_device_extensions) {
@@ -1583,39 +3991,219 @@ namespace nova::renderer::rhi {
         gpu.surface_formats.resize(num_surface_formats);
         vkGetPhysicalDeviceSurfaceFormatsKHR(gpu.phys_device, surface, &num_surface_formats, gpu.surface_formats.data());
 
+        swapchain = internal_allocator.create<VulkanSwapchain>(settings->swapchain.num_images,
+                                                               this,
+                                                               surface,
+                                                               window.get_framebuffer_size(),
+                                                               get_present_modes(surface));
+
+        swapchain_size = swapchain->get_size();
+    }
+
+    std::vector<vk::PresentModeKHR> VulkanRenderDevice::get_present_modes(const vk::SurfaceKHR surface) {
         uint32_t num_surface_present_modes;
         vkGetPhysicalDeviceSurfacePresentModesKHR(gpu.phys_device, surface, &num_surface_present_modes, nullptr);
         std::vector<vk::PresentModeKHR> present_modes{&internal_allocator, num_surface_present_modes};
         vkGetPhysicalDeviceSurfacePresentModesKHR(gpu.phys_device, surface, &num_surface_present_modes, present_modes.data());
 
-        swapchain = internal_allocator.create<VulkanSwapchain>(settings->max_in_flight_frames,
-                                                               this,
-                                                               window.get_framebuffer_size(),
-                                                               present_modes);
+        return present_modes;
+    }
+
+    const VulkanDeviceInfo& VulkanRenderDevice::get_vk_info() const { return vk_info; }
+
+    void VulkanRenderDevice::recreate_swapchain() {
+        ZoneScoped;
+        // Any queue may still be reading from or presenting the old images
+        device.waitIdle();
+
+        swapchain->recreate(window.get_framebuffer_size());
+        swapchain_size = swapchain->get_size();
+    }
+
+    Swapchain* VulkanRenderDevice::create_window_swapchain(NovaWindow& output_window) {
+        ZoneScoped;
+        const auto output_surface = create_surface(output_window);
+
+        // Frames are presented from the graphics queue, which was only checked against the first window's surface
+        vk::Bool32 supports_present = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(gpu.phys_device, graphics_family_index, output_surface, &supports_present);
+        if(supports_present != VK_TRUE) {
+            logger->error("The graphics queue can't present to the window, so nothing can be rendered to it");
+            vkDestroySurfaceKHR(instance, output_surface, allocation_callbacks);
+            return nullptr;
+        }
+
+        return internal_allocator.create<VulkanSwapchain>(settings->swapchain.num_images,
+                                                          this,
+                                                          output_surface,
+                                                          output_window.get_framebuffer_size(),
+                                                          get_present_modes(output_surface));
+    }
+
+    void VulkanRenderDevice::recreate_window_swapchain(Swapchain& output_swapchain, const NovaWindow& output_window) {
+        ZoneScoped;
+        device.waitIdle();
+
+        output_swapchain.recreate(output_window.get_framebuffer_size());
+    }
+
+    void VulkanRenderDevice::destroy_window_swapchain(Swapchain* output_swapchain) {
+        ZoneScoped;
+        auto* vk_swapchain = static_cast<VulkanSwapchain*>(output_swapchain);
+        const auto output_surface = vk_swapchain->get_surface();
+
+        vk_swapchain->deinit();
+        vk_swapchain->~VulkanSwapchain();
+        internal_allocator.deallocate(reinterpret_cast<uint8_t*>(vk_swapchain));
+
+        vkDestroySurfaceKHR(instance, output_surface, allocation_callbacks);
+    }
+
+    void VulkanRenderDevice::create_pipeline_cache() {
+        ZoneScoped;
+        std::vector<uint8_t> cache_data;
+
+        const auto cache_path = get_pipeline_cache_path();
+        if(std::ifstream cache_file{cache_path, std::ios::binary | std::ios::ate}; cache_file) {
+            const auto file_size = static_cast<size_t>(cache_file.tellg());
+            cache_data.resize(file_size);
+
+            cache_file.seekg(0);
+            cache_file.read(reinterpret_cast<char*>(cache_data.data()), static_cast<std::streamsize>(file_size));
+
+            if(!is_pipeline_cache_compatible(cache_data)) {
+                logger->info("Pipeline cache {} was made by a different device or driver, ignoring it", cache_path.string());
+                cache_data.clear();
+            }
+        }
+
+        vk::PipelineCacheCreateInfo create_info = {};
+        create_info.initialDataSize = cache_data.size();
+        create_info.pInitialData = cache_data.data();
+
+        auto result = device.createPipelineCache(&create_info, vk_allocation_callbacks, &pipeline_cache);
+        if(result != vk::Result::eSuccess && !cache_data.empty()) {
+            // The driver didn't like our data. Start from an empty cache rather than failing
+            logger->warn("Could not load pipeline cache {}: {}", cache_path.string(), vk::to_string(result));
+
+            create_info.initialDataSize = 0;
+            create_info.pInitialData = nullptr;
+            result = device.createPipelineCache(&create_info, vk_allocation_callbacks, &pipeline_cache);
+        }
+
+        if(result != vk::Result::eSuccess) {
+            logger->error("Could not create pipeline cache: {}", vk::to_string(result));
+
+        } else if(!cache_data.empty()) {
+            logger->info("Loaded {} bytes of pipeline cache from {}", cache_data.size(), cache_path.string());
+        }
+    }
+
+    std::filesystem::path VulkanRenderDevice::get_pipeline_cache_path() const {
+        // Pipeline caches are only valid for the exact device and driver that wrote them, so all of that goes in the file name. A new
+        // driver gets a new file instead of fighting over the old one
+        std::string uuid;
+        uuid.reserve(VK_UUID_SIZE * 2);
+        for(const uint8_t byte : gpu.props.pipelineCacheUUID) {
+            uuid += fmt::format("{:02x}", byte);
+        }
+
+        const auto file_name = fmt::format("pipelines_{:04x}_{:04x}_{:08x}_{}.bin",
+                                           gpu.props.vendorID,
+                                           gpu.props.deviceID,
+                                           gpu.props.driverVersion,
+                                           uuid);
+
+        return std::filesystem::path{settings->cache.pipeline_cache_directory} / file_name;
+    }
 
-        swapchain_size = window.get_framebuffer_size();
+    bool VulkanRenderDevice::is_pipeline_cache_compatible(const std::vector<uint8_t>& cache_data) const {
+        // Some drivers don't validate the cache data very well, so we check the header ourselves before handing it to them
+        struct PipelineCacheHeader {
+            uint32_t header_size;
+            uint32_t header_version;
+            uint32_t vendor_id;
+            uint32_t device_id;
+            uint8_t uuid[VK_UUID_SIZE];
+        };
+
+        if(cache_data.size() < sizeof(PipelineCacheHeader)) {
+            return false;
+        }
+
+        PipelineCacheHeader header;
+        std::memcpy(&header, cache_data.data(), sizeof(PipelineCacheHeader));
+
+        return header.header_size >= sizeof(PipelineCacheHeader) && header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendor_id == gpu.props.vendorID && header.device_id == gpu.props.deviceID &&
+               std::memcmp(header.uuid, gpu.props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
     }
 
     void VulkanRenderDevice::create_per_thread_command_pools() {
         ZoneScoped;
-        const uint32_t num_threads = 1; // TODO: Make this real
-        command_pools_by_thread_idx.reserve(num_threads);
+        // One set of pools for the thread that owns the renderer, plus one for each of its worker threads. Command pools must be
+        // externally synchronized, so giving each thread its own lets them all allocate command lists without locking
+        const uint32_t num_threads = settings->threading.num_worker_threads + 1;
+        command_pools.resize(settings->max_in_flight_frames);
+
+        for(auto& pools_by_thread : command_pools) {
+            pools_by_thread.reserve(num_threads);
+            for(uint32_t i = 0; i < num_threads; i++) {
+                pools_by_thread.push_back(make_new_command_pools());
+            }
+        }
+    }
+
+    void VulkanRenderDevice::create_queue_timelines() {
+        ZoneScoped;
+        const auto queues = std::array{graphics_queue, copy_queue, compute_queue};
+        const auto queue_types = std::array{QueueType::Graphics, QueueType::Transfer, QueueType::AsyncCompute};
+
+        for(size_t i = 0; i < queues.size(); i++) {
+            const auto existing_timeline = std::find_if(queue_timelines.begin(),
+                                                        queue_timelines.end(),
+                                                        [&](const std::unique_ptr<QueueTimeline>& timeline) {
+                                                            return timeline->queue == queues[i];
+                                                        });
+            if(existing_timeline != queue_timelines.end()) {
+                timelines_by_queue_type[static_cast<size_t>(queue_types[i])] = existing_timeline->get();
+                continue;
+            }
+
+            auto timeline = std::make_unique<QueueTimeline>();
+            timeline->queue = queues[i];
 
-        for(uint32_t i = 0; i < num_threads; i++) {
-            command_pools_by_thread_idx.push_back(make_new_command_pools());
+            const auto type_create_info = vk::SemaphoreTypeCreateInfo().setSemaphoreType(vk::SemaphoreType::eTimeline).setInitialValue(0);
+            const auto create_info = vk::SemaphoreCreateInfo().setPNext(&type_create_info);
+            device.createSemaphore(&create_info, vk_allocation_callbacks, &timeline->semaphore);
+
+            timelines_by_queue_type[static_cast<size_t>(queue_types[i])] = timeline.get();
+            queue_timelines.push_back(std::move(timeline));
         }
     }
 
     void VulkanRenderDevice::create_standard_pipeline_layout() {
         standard_push_constants = std::array{
-            // Camera and Material index
-            vk::PushConstantRange().setStageFlags(vk::ShaderStageFlagBits::eAll).setOffset(0).setSize(sizeof(uint32_t) * 2)};
+            // The per-draw constants, all in one range so that one push updates them all
+            vk::PushConstantRange().setStageFlags(vk::ShaderStageFlagBits::eAll).setOffset(0).setSize(sizeof(RhiDrawConstants))};
 
         const auto flags_per_binding = std::array{vk::DescriptorBindingFlags{},
                                                   vk::DescriptorBindingFlags{},
                                                   vk::DescriptorBindingFlags{},
                                                   vk::DescriptorBindingFlags{},
                                                   vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{},
+                                                  vk::DescriptorBindingFlags{vk::DescriptorBindingFlagBits::ePartiallyBound},
                                                   vk::DescriptorBindingFlagBits::eUpdateAfterBind |
                                                       vk::DescriptorBindingFlagBits::eVariableDescriptorCount |
                                                       vk::DescriptorBindingFlagBits::ePartiallyBound};
@@ -1628,9 +4216,8 @@ namespace nova::renderer::rhi {
                                                        vk::DescriptorType::eUniformBuffer :
                                                        vk::DescriptorType::eStorageBuffer;
 
-        const auto material_buffer_descriptor_type = MATERIAL_BUFFER_SIZE.b_count() < gpu.props.limits.maxUniformBufferRange ?
-                                                         vk::DescriptorType::eUniformBuffer :
-                                                         vk::DescriptorType::eStorageBuffer;
+        // Shaders declare the material buffer as a structured buffer, and it can grow past the uniform buffer size limit
+        constexpr auto material_buffer_descriptor_type = vk::DescriptorType::eStorageBuffer;
 
         // Binding for the array of material parameter buffers. Nova uses a variable-length, partially-bound
         const std::vector<vk::DescriptorSetLayoutBinding> bindings = std::array{// Camera data buffer
@@ -1663,9 +4250,85 @@ namespace nova::renderer::rhi {
                                                                                     .setDescriptorType(vk::DescriptorType::eSampler)
                                                                                     .setDescriptorCount(1)
                                                                                     .setStageFlags(vk::ShaderStageFlagBits::eAll),
-                                                                                // Textures array
+                                                                                // Model matrices. Always a storage buffer, since
+                                                                                // there's one matrix per renderable
                                                                                 vk::DescriptorSetLayoutBinding()
                                                                                     .setBinding(5)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Virtual texture page table
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(6)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Virtual texture feedback
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(7)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Virtual texture page cache
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(8)
+                                                                                    .setDescriptorType(vk::DescriptorType::eSampledImage)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Light cluster parameters
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(9)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Lights
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(10)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Light clusters
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(11)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Light index lists of the light clusters
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(12)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Particles
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(13)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Integrated volumetric fog
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(14)
+                                                                                    .setDescriptorType(vk::DescriptorType::eSampledImage)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Pulled vertex layout of every instance
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(15)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(1)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Vertex arena buffers, for shaders that pull their
+                                                                                // own vertices. Partially bound, since the arena
+                                                                                // starts with one buffer
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(16)
+                                                                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                                                                    .setDescriptorCount(MAX_NUM_VERTEX_BUFFERS)
+                                                                                    .setStageFlags(vk::ShaderStageFlagBits::eAll),
+                                                                                // Textures array. Must be the last binding, since
+                                                                                // it has a variable descriptor count
+                                                                                vk::DescriptorSetLayoutBinding()
+                                                                                    .setBinding(17)
                                                                                     .setDescriptorType(vk::DescriptorType::eSampledImage)
                                                                                     .setDescriptorCount(MAX_NUM_TEXTURES)
                                                                                     .setStageFlags(vk::ShaderStageFlagBits::eAll)};
@@ -1676,7 +4339,7 @@ namespace nova::renderer::rhi {
                                            .setPBindings(bindings.data())
                                            .setPNext(&set_flags);
 
-        device.createDescriptorSetLayout(&dsl_layout_create, &vk_internal_allocator, &standard_set_layout);
+        device.createDescriptorSetLayout(&dsl_layout_create, vk_allocation_callbacks, &standard_set_layout);
 
         const auto pipeline_layout_create = vk::PipelineLayoutCreateInfo()
                                                 .setSetLayoutCount(1)
@@ -1684,15 +4347,36 @@ namespace nova::renderer::rhi {
                                                 .setPushConstantRangeCount(static_cast<uint32_t>(standard_push_constants.size()))
                                                 .setPPushConstantRanges(standard_push_constants.data());
 
-        device.createPipelineLayout(&pipeline_layout_create, &vk_internal_allocator, &standard_pipeline_layout);
-
-        const auto& pool = create_descriptor_pool(std::array{std::pair{DescriptorType::StorageBuffer, 5_u32 * 1024},
-                                                             std::pair{DescriptorType::UniformBuffer, 5_u32 * 1024},
-                                                             std::pair{DescriptorType::Texture, MAX_NUM_TEXTURES * 1024},
-                                                             std::pair{DescriptorType::Sampler, 3_u32 * 1024}},
-                                                  internal_allocator);
+        device.createPipelineLayout(&pipeline_layout_create, vk_allocation_callbacks, &standard_pipeline_layout);
+
+        // Every pool, persistent or transient, holds this much. When one fills up the allocator makes another one just like it
+        const auto pool_capacity = std::array{std::pair{DescriptorType::StorageBuffer, 10_u32 * 1024},
+                                              std::pair{DescriptorType::UniformBuffer, 5_u32 * 1024},
+                                              std::pair{DescriptorType::Texture, MAX_NUM_TEXTURES * 1024},
+                                              std::pair{DescriptorType::Sampler, 3_u32 * 1024},
+                                              std::pair{DescriptorType::StorageImage, 1_u32 * 1024},
+                                              std::pair{DescriptorType::InputAttachment, 1_u32 * 1024}};
+        std::vector<vk::DescriptorPoolSize> pool_sizes;
+        uint32_t max_sets_per_pool = 0;
+        for(const auto& [type, count] : pool_capacity) {
+            pool_sizes.emplace_back(vk::DescriptorPoolSize{to_vk_descriptor_type(type), count});
+            max_sets_per_pool += count;
+        }
 
-        standard_descriptor_set_pool = *pool;
+        persistent_descriptors = std::make_unique<VulkanDescriptorAllocator>(device,
+                                                                             vk_allocation_callbacks,
+                                                                             VulkanDescriptorAllocator::Lifetime::Persistent,
+                                                                             pool_sizes,
+                                                                             max_sets_per_pool);
+
+        transient_descriptors.reserve(settings->max_in_flight_frames);
+        for(uint32_t frame_idx = 0; frame_idx < settings->max_in_flight_frames; frame_idx++) {
+            transient_descriptors.push_back(std::make_unique<VulkanDescriptorAllocator>(device,
+                                                                                        vk_allocation_callbacks,
+                                                                                        VulkanDescriptorAllocator::Lifetime::Transient,
+                                                                                        pool_sizes,
+                                                                                        max_sets_per_pool));
+        }
 
         if(settings->debug.enabled) {
             vk::DebugUtilsObjectNameInfoEXT pipeline_layout_name = {};
@@ -1702,12 +4386,11 @@ namespace nova::renderer::rhi {
             pipeline_layout_name.pObjectName = "Standard Pipeline Layout";
             NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &pipeline_layout_name));
 
-            vk::DebugUtilsObjectNameInfoEXT descriptor_pool_name = {};
-            descriptor_pool_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
-            descriptor_pool_name.objectType = VK_OBJECT_TYPE_DESCRIPTOR_POOL;
-            descriptor_pool_name.objectHandle = reinterpret_cast<uint64_t>(static_cast<vk::DescriptorPool>(standard_descriptor_set_pool));
-            descriptor_pool_name.pObjectName = "Standard Descriptor Set Pool";
-            NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &descriptor_pool_name));
+            persistent_descriptors->set_debug_name("Persistent descriptors", vkSetDebugUtilsObjectNameEXT);
+            for(uint32_t frame_idx = 0; frame_idx < transient_descriptors.size(); frame_idx++) {
+                transient_descriptors[frame_idx]->set_debug_name(fmt::format("Frame {} transient descriptors", frame_idx),
+                                                                 vkSetDebugUtilsObjectNameEXT);
+            }
 
             vk::DebugUtilsObjectNameInfoEXT descriptor_set_layout_name = {};
             descriptor_set_layout_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
@@ -1718,26 +4401,31 @@ namespace nova::renderer::rhi {
         }
     }
 
-    std::unordered_map<uint32_t, vk::CommandPool> VulkanRenderDevice::make_new_command_pools() const {
+    std::unordered_map<uint32_t, VulkanCommandPool> VulkanRenderDevice::make_new_command_pools() const {
         ZoneScoped;
         std::vector<uint32_t> queue_indices{&internal_allocator};
         queue_indices.push_back(graphics_family_index);
         queue_indices.push_back(transfer_family_index);
         queue_indices.push_back(compute_family_index);
 
-        std::unordered_map<uint32_t, vk::CommandPool> pools_by_queue{&internal_allocator};
+        std::unordered_map<uint32_t, VulkanCommandPool> pools_by_queue{&internal_allocator};
 
         queue_indices.each_fwd([&](const uint32_t queue_index) {
+            // Queue types may share a family
+            if(pools_by_queue.contains(queue_index)) {
+                return;
+            }
+
+            // The pool is only ever reset as a whole, and its command buffers live for one frame
             vk::CommandPoolCreateInfo command_pool_create_info;
             command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
             command_pool_create_info.pNext = nullptr;
-            command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
             command_pool_create_info.queueFamilyIndex = queue_index;
 
-            const vk::AllocationCallbacks& vk_alloc = wrap_allocator(internal_allocator);
             vk::CommandPool command_pool;
-            NOVA_CHECK_RESULT(vkCreateCommandPool(device, &command_pool_create_info, &vk_alloc, &command_pool));
-            pools_by_queue.insert(queue_index, command_pool);
+            NOVA_CHECK_RESULT(vkCreateCommandPool(device, &command_pool_create_info, allocation_callbacks, &command_pool));
+            pools_by_queue[queue_index].pool = command_pool;
         });
 
         return pools_by_queue;
@@ -1765,14 +4453,71 @@ namespace nova::renderer::rhi {
     }
 
     vk::ImageView VulkanRenderDevice::image_view_for_image(const RhiImage* image) {
-        // TODO: This method is terrible. We shouldn't tie image views to images, we should let everything that wants
-        // to use the image create its own image view
-
         const auto* vk_image = static_cast<const VulkanImage*>(image);
 
         return vk_image->image_view;
     }
 
+    vk::ImageView VulkanRenderDevice::get_image_view(const VulkanImage& image, const VulkanImageViewDesc& desc) {
+        std::lock_guard lock{image_view_mutex};
+        for(const auto& [existing_desc, view] : image.extra_views) {
+            if(existing_desc == desc) {
+                return view;
+            }
+        }
+
+        ZoneScoped;
+        const auto create_info = vk::ImageViewCreateInfo()
+                                     .setImage(image.image)
+                                     .setViewType(desc.type)
+                                     .setFormat(desc.format != vk::Format::eUndefined ? desc.format : image.format)
+                                     .setComponents(desc.swizzle)
+                                     .setSubresourceRange(desc.range);
+
+        vk::ImageView view;
+        vkCreateImageView(device, &create_info, allocation_callbacks, &view);
+        image.extra_views.emplace_back(desc, view);
+
+        return view;
+    }
+
+    vk::ImageView VulkanRenderDevice::get_mip_view(const VulkanImage& image, const uint32_t mip) {
+        VulkanImageViewDesc desc;
+        if(image.depth > 1) {
+            desc.type = vk::ImageViewType::e3D;
+        } else {
+            desc.type = image.num_layers > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+        }
+        desc.range = vk::ImageSubresourceRange()
+                         .setAspectMask(image.is_depth_tex ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor)
+                         .setBaseMipLevel(mip)
+                         .setLevelCount(1)
+                         .setBaseArrayLayer(0)
+                         .setLayerCount(image.num_layers);
+
+        return get_image_view(image, desc);
+    }
+
+    size_t VulkanRenderDevice::SamplerCreateInfoHasher::operator()(const RhiSamplerCreateInfo& info) const {
+        size_t hash = 0;
+        const auto combine = [&](const auto value) {
+            hash ^= std::hash<std::decay_t<decltype(value)>>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        };
+
+        combine(static_cast<uint32_t>(info.min_filter));
+        combine(static_cast<uint32_t>(info.mag_filter));
+        combine(static_cast<uint32_t>(info.x_wrap_mode));
+        combine(static_cast<uint32_t>(info.y_wrap_mode));
+        combine(static_cast<uint32_t>(info.z_wrap_mode));
+        combine(info.mip_bias);
+        combine(info.enable_anisotropy);
+        combine(info.max_anisotropy);
+        combine(info.min_lod);
+        combine(info.max_lod);
+
+        return hash;
+    }
+
     vk::CommandBufferLevel VulkanRenderDevice::to_vk_command_buffer_level(const RhiRenderCommandList::Level level) {
         switch(level) {
             case RhiRenderCommandList::Level::Primary:
@@ -1790,27 +4535,207 @@ namespace nova::renderer::rhi {
         std::vector<vk::VertexInputBindingDescription> bindings;
 
         attributes.reserve(vertex_fields.size());
-        bindings.reserve(vertex_fields.size());
 
         uint32_t vertex_size = 0;
         vertex_fields.each_fwd([&](const RhiVertexField& field) { vertex_size += get_byte_size(field.format); });
 
-        uint32_t cur_binding = 0;
+        // All the fields are interleaved in one vertex buffer, so they all read from binding 0 and their locations are their indices.
+        // The compact formats are all a multiple of four bytes, so every field stays aligned
+        uint32_t location = 0;
         uint32_t byte_offset = 0;
         vertex_fields.each_fwd([&](const RhiVertexField& field) {
             const auto field_size = get_byte_size(field.format);
             const auto attr_format = to_vk_vertex_format(field.format);
-            attributes.emplace_back(vk::VertexInputAttributeDescription{cur_binding, 0, attr_format, byte_offset});
-
-            bindings.emplace_back(vk::VertexInputBindingDescription{cur_binding, vertex_size, VK_VERTEX_INPUT_RATE_VERTEX});
+            attributes.emplace_back(vk::VertexInputAttributeDescription{location, 0, attr_format, byte_offset});
 
-            cur_binding++;
+            location++;
             byte_offset += field_size;
         });
 
+        if(vertex_size > 0) {
+            bindings.emplace_back(vk::VertexInputBindingDescription{0, vertex_size, VK_VERTEX_INPUT_RATE_VERTEX});
+        }
+
         return {attributes, bindings};
     }
 
+    vk::ImageCreateInfo VulkanRenderDevice::get_image_create_info(const renderpack::TextureCreateInfo& info, VulkanImage& image) const {
+        image.is_dynamic = true;
+        image.type = ResourceType::Image;
+        const vk::Format format = to_vk_format(info.format.pixel_format);
+
+        const auto image_pixel_size = info.format.get_size_in_pixels(swapchain_size);
+
+        vk::ImageCreateInfo image_create_info = {};
+        image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_create_info.imageType = info.format.depth > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+        image_create_info.format = format;
+        image_create_info.extent.width = image_pixel_size.x;
+        image_create_info.extent.height = image_pixel_size.y;
+        image_create_info.extent.depth = std::max(info.format.depth, 1U);
+        image_create_info.mipLevels = std::max(info.num_mips, 1U);
+        image_create_info.arrayLayers = std::max(info.format.num_layers, 1U);
+        image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+        if(format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT) {
+            image.is_depth_tex = true;
+        }
+
+        if(info.usage == renderpack::ImageUsage::SampledImage) {
+            // Generating mips blits from one mip of the image to the next
+            image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+        } else if(info.usage == renderpack::ImageUsage::TransientRenderTarget) {
+            // Transient attachments may only have attachment usages, so they can't be sampled at all
+            const auto attachment_usage = image.is_depth_tex ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT :
+                                                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            image_create_info.usage = attachment_usage | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+        } else if(image.is_depth_tex) {
+            // If the image isn't a sampled image, it's a render target. Render targets can be read back to the CPU
+            image_create_info.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                       VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+        } else {
+            // Offscreen render outputs have the frame blitted into them
+            image_create_info.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                       VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+            // Compute passes write to render targets as storage images, but not every format can be one
+            vk::FormatProperties format_properties;
+            vkGetPhysicalDeviceFormatProperties(gpu.phys_device, format, &format_properties);
+            if((format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0U) {
+                image_create_info.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+            }
+
+            // Shading rate images are the only R8_UINT render targets Nova knows of
+            if(format == VK_FORMAT_R8_UINT && vk_info.supports_shading_rate_attachment) {
+                image_create_info.usage |= VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+            }
+        }
+
+        image_create_info.queueFamilyIndexCount = 1;
+        image_create_info.pQueueFamilyIndices = &graphics_family_index;
+        image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        return image_create_info;
+    }
+
+    void VulkanRenderDevice::finish_image_creation(VulkanImage& image,
+                                                   const renderpack::TextureCreateInfo& info,
+                                                   const vk::Format format) const {
+        image.format = format;
+
+        if(settings->debug.enabled) {
+            vk::DebugUtilsObjectNameInfoEXT object_name = {};
+            object_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+            object_name.objectType = VK_OBJECT_TYPE_IMAGE;
+            object_name.objectHandle = reinterpret_cast<uint64_t>(image.image);
+            object_name.pObjectName = info.name.data();
+
+            NOVA_CHECK_RESULT(vkSetDebugUtilsObjectNameEXT(device, &object_name));
+        }
+
+        image.num_mips = std::max(info.num_mips, 1U);
+        image.num_layers = std::max(info.format.num_layers, 1U);
+        image.depth = std::max(info.format.depth, 1U);
+
+        image.image_view = create_full_image_view(image, image.image);
+    }
+
+    vk::SampleCountFlagBits VulkanRenderDevice::get_sample_count(const uint32_t num_samples) const {
+        const auto supported_counts = gpu.props.limits.framebufferColorSampleCounts & gpu.props.limits.framebufferDepthSampleCounts;
+        for(auto count = std::bit_floor(std::clamp(num_samples, 1U, 64U)); count > 1; count /= 2) {
+            const auto sample_count = static_cast<vk::SampleCountFlagBits>(count);
+            if(supported_counts & sample_count) {
+                return sample_count;
+            }
+        }
+
+        return vk::SampleCountFlagBits::e1;
+    }
+
+    bool VulkanRenderDevice::create_multisampled_image(VulkanImage& image,
+                                                       const vk::ImageCreateInfo& resolve_create_info,
+                                                       const renderpack::TextureCreateInfo& info) {
+        if(info.format.num_samples <= 1) {
+            return true;
+        }
+
+        const auto num_samples = get_sample_count(info.format.num_samples);
+        if(num_samples == vk::SampleCountFlagBits::e1) {
+            logger->warn("This GPU can't render image {} with {} samples, so it's rendered without MSAA",
+                         info.name,
+                         info.format.num_samples);
+            return true;
+        }
+
+        if(resolve_create_info.imageType != VK_IMAGE_TYPE_2D) {
+            logger->error("Image {} has {} samples, but only 2D images can be multisampled", info.name, info.format.num_samples);
+            return false;
+        }
+
+        // Renderpasses only ever render to the multisampled image, resolve it, and throw it away, so it never needs more than that
+        auto create_info = resolve_create_info;
+        create_info.samples = num_samples;
+        create_info.mipLevels = 1;
+        create_info.usage = (image.is_depth_tex ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) |
+                            VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+        VmaAllocationCreateInfo vma_info = {};
+        vma_info.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        vma_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        vma_info.priority = info.residency_priority;
+
+        // Same as transient render targets, tilers may never back the samples with memory. Everyone else gets regular memory
+        auto result = vmaCreateImage(vma, &create_info, &vma_info, &image.multisampled_image, &image.multisampled_allocation, nullptr);
+        if(result != VK_SUCCESS) {
+            vma_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+            result = vmaCreateImage(vma, &create_info, &vma_info, &image.multisampled_image, &image.multisampled_allocation, nullptr);
+        }
+
+        if(result != VK_SUCCESS) {
+            logger->error("Could not create the multisampled copy of image {}: {}", info.name, to_string(result));
+            image.multisampled_image = VK_NULL_HANDLE;
+            return false;
+        }
+
+        image.num_samples = num_samples;
+        image.multisampled_view = create_full_image_view(image, image.multisampled_image);
+
+        track_allocation(image.multisampled_allocation, MemoryCategory::RenderTarget, info.owner, info.name);
+
+        return true;
+    }
+
+    vk::ImageView VulkanRenderDevice::create_full_image_view(const VulkanImage& image, const vk::Image image_handle) const {
+        vk::ImageViewCreateInfo image_view_create_info = {};
+        image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        image_view_create_info.image = image_handle;
+        // Multiview passes render to every layer at once, so they need a view of all of them
+        if(image.depth > 1) {
+            image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_3D;
+        } else {
+            image_view_create_info.viewType = image.num_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        }
+        image_view_create_info.format = image.format;
+        if(image.is_depth_tex) {
+            image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        } else {
+            image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+        image_view_create_info.subresourceRange.baseArrayLayer = 0;
+        image_view_create_info.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        image_view_create_info.subresourceRange.baseMipLevel = 0;
+        image_view_create_info.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+
+        vk::ImageView image_view = VK_NULL_HANDLE;
+        vkCreateImageView(device, &image_view_create_info, allocation_callbacks, &image_view);
+
+        return image_view;
+    }
+
     std::optional<vk::ShaderModule> VulkanRenderDevice::create_shader_module(const std::vector<uint32_t>& spirv) const {
         ZoneScoped;
         vk::ShaderModuleCreateInfo shader_module_create_info = {};
@@ -1819,8 +4744,7 @@ namespace nova::renderer::rhi {
         shader_module_create_info.codeSize = spirv.size() * 4;
 
         vk::ShaderModule module;
-        const vk::AllocationCallbacks& vk_alloc = wrap_allocator(internal_allocator);
-        const auto result = vkCreateShaderModule(device, &shader_module_create_info, &vk_alloc, &module);
+        const auto result = vkCreateShaderModule(device, &shader_module_create_info, allocation_callbacks, &module);
         if(result == VK_SUCCESS) {
             return std::optional<vk::ShaderModule>(module);
 
@@ -1908,7 +4832,7 @@ namespace nova::renderer::rhi {
         } else if((message_severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT) != 0) {
             // Diagnostic info from the Vulkan loader and layers
             // Usually not helpful in terms of API usage, but may help to debug layer and loader problems
-            logger->debug("%s", msg);
+            SPDLOG_LOGGER_DEBUG(logger, "{}", msg);
 
         } else if((message_types & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) == 0U) { // No validation info!
             // Catch-all to be super sure
@@ -1,9 +1,22 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.hpp>
 
+#include "../memory_tracker.hpp"
 #include "vk_structs.hpp"
+#include "vulkan_descriptor_allocator.hpp"
+#include "vulkan_host_allocator.hpp"
+#include "vulkan_command_list.hpp"
 #include "vulkan_swapchain.hpp"
 
 namespace nova {
@@ -16,6 +29,42 @@ namespace nova {
 namespace nova::renderer::rhi {
     struct VulkanDeviceInfo {
         uint64_t max_uniform_buffer_size = 0;
+
+        /*!
+         * \brief Whether VK_EXT_memory_priority is enabled, so allocations can tell the driver how much they want to stay resident
+         */
+        bool supports_memory_priority = false;
+
+        /*!
+         * \brief Whether VK_KHR_present_id and VK_KHR_present_wait are enabled, so we can wait for a present to reach the display
+         */
+        bool supports_present_wait = false;
+
+        /*!
+         * \brief Whether VK_KHR_dynamic_rendering is enabled, so passes with one subpass don't need a VkRenderPass or VkFramebuffer
+         */
+        bool supports_dynamic_rendering = false;
+
+        /*!
+         * \brief Whether VK_KHR_fragment_shading_rate is enabled, so pipelines can have a fragment size
+         */
+        bool supports_fragment_shading_rate = false;
+
+        /*!
+         * \brief Whether a dynamic rendering pass can read its fragment sizes from a shading rate attachment
+         */
+        bool supports_shading_rate_attachment = false;
+
+        /*!
+         * \brief Whether a pipeline's fragment size can be combined with the attachment's by taking the larger of the two, instead of
+         * the attachment's replacing it
+         */
+        bool supports_shading_rate_combiner_ops = false;
+
+        /*!
+         * \brief Whether dynamic rendering passes can resolve multisampled depth attachments by taking the first sample
+         */
+        bool supports_depth_resolve = false;
     };
 
     struct VulkanInputAssemblerLayout {
@@ -24,14 +73,74 @@ namespace nova::renderer::rhi {
     };
 
     /*!
-     * \brief Task that should be executed when a fence has been signaled
+     * \brief Work that should run once a queue's timeline semaphore reaches some value
      */
-    struct FencedTask {
-        vk::Fence fence;
+    struct DeferredTask {
+        uint64_t submission_value;
 
         std::function<void()> work_to_perform;
 
-        void operator()() const;
+        /*!
+         * \brief The next task in `QueueTimeline::new_tasks`
+         */
+        DeferredTask* next = nullptr;
+    };
+
+    /*!
+     * \brief A queue, the timeline semaphore that every submission to it signals, and the work that's waiting on those submissions
+     *
+     * Each submission signals the semaphore with the next value, so finding out how many submissions finished takes one query no matter
+     * how many are in flight. Any thread may defer work: it's pushed onto the lock-free `new_tasks` list, and `end_frame` moves it into
+     * `pending_tasks`, ordered by submission value, so it only ever looks at the tasks that are ready plus one that isn't
+     */
+    struct QueueTimeline {
+        vk::Queue queue;
+
+        vk::Semaphore semaphore;
+
+        /*!
+         * \brief Guards submissions to `queue`. Vulkan needs external synchronization for that anyway, and it keeps the signal values
+         * increasing in the same order that the submissions reach the queue
+         */
+        std::mutex submit_mutex;
+
+        /*!
+         * \brief The value that the most recent submission signals. Only written while holding `submit_mutex`
+         */
+        std::atomic<uint64_t> last_submitted_value = 0;
+
+        /*!
+         * \brief Tasks that were deferred since the last `end_frame`, newest first
+         */
+        std::atomic<DeferredTask*> new_tasks = nullptr;
+
+        /*!
+         * \brief Tasks waiting for their submission to finish, in the order they'll be ready. Only touched by `end_frame`
+         */
+        std::deque<DeferredTask*> pending_tasks;
+    };
+
+    /*!
+     * \brief A command pool for one frame slot, thread, and queue family, along with every command list that's been allocated from it
+     *
+     * When the frame slot comes around again, the whole pool is reset at once and its command lists are handed out again, so a steady
+     * stream of frames doesn't allocate any command buffers or command list objects
+     */
+    struct VulkanCommandPool {
+        vk::CommandPool pool;
+
+        std::vector<std::unique_ptr<VulkanRenderCommandList>> primary_lists;
+        std::vector<std::unique_ptr<VulkanRenderCommandList>> secondary_lists;
+
+        size_t num_used_primary_lists = 0;
+        size_t num_used_secondary_lists = 0;
+
+        /*!
+         * \brief The timeline value of the most recent submission of one of this pool's command lists, indexed by `QueueType`
+         *
+         * Written while holding the queue timeline's submit mutex. The pool can't be reset until every timeline has reached its value
+         */
+        std::array<uint64_t, 3> submission_values{};
     };
 
     /*!
@@ -39,7 +148,16 @@ namespace nova::renderer::rhi {
      */
     class VulkanRenderDevice final {
     public:
-        vk::AllocationCallbacks vk_internal_allocator;
+        /*!
+         * \brief The callbacks that every Vulkan object is created and destroyed with, or nullptr to let the driver allocate host memory
+         * however it likes
+         */
+        const VkAllocationCallbacks* allocation_callbacks = nullptr;
+
+        /*!
+         * \brief `allocation_callbacks`, for Vulkan-Hpp's functions
+         */
+        const vk::AllocationCallbacks* vk_allocation_callbacks = nullptr;
 
         // Global Vulkan objects
         vk::Instance instance;
@@ -61,6 +179,11 @@ namespace nova::renderer::rhi {
 
         uint32_t cur_frame_idx;
 
+        /*!
+         * \brief How many times `begin_frame` has been called. VMA wants a frame index that never repeats
+         */
+        uint32_t num_frames_begun = 0;
+
         /*!
          * \brief All the push constants in the standard pipeline layout
          */
@@ -78,18 +201,61 @@ namespace nova::renderer::rhi {
          */
         vk::PipelineLayout standard_pipeline_layout;
 
-        vk::DescriptorPool standard_descriptor_set_pool;
+        /*!
+         * \brief Every descriptor set layout that `get_descriptor_set_layout` has made, keyed by the bytes of their sorted bindings
+         */
+        std::unordered_map<std::string, vk::DescriptorSetLayout> descriptor_set_layouts;
+
+        /*!
+         * \brief Every pipeline layout that `create_pipeline_layout` has made, keyed by the bytes of their descriptor set layouts. They
+         * all have the standard push constants
+         */
+        std::unordered_map<std::string, vk::PipelineLayout> pipeline_layouts;
+
+        std::mutex layout_cache_mutex;
+
+        struct SamplerCreateInfoHasher {
+            [[nodiscard]] size_t operator()(const RhiSamplerCreateInfo& info) const;
+        };
+
+        /*!
+         * \brief Every sampler that `create_sampler` made. Drivers only allow so many samplers, and renderpacks ask for the same few
+         * over and over
+         */
+        std::unordered_map<RhiSamplerCreateInfo, VulkanSampler*, SamplerCreateInfoHasher> samplers;
+
+        std::mutex sampler_cache_mutex;
+
+        /*!
+         * \brief Guards the `extra_views` of every image
+         */
+        std::mutex image_view_mutex;
+
+        /*!
+         * \brief Descriptor sets that live until whatever owns them is destroyed, like the standard sets and resource binders' sets
+         */
+        std::unique_ptr<VulkanDescriptorAllocator> persistent_descriptors;
 
         /*!
-         * \brief The descriptor set that binds to the standard pipeline layout
+         * \brief Descriptor sets that only live for one frame, one allocator per frame slot. Each one is reset when its frame slot begins
          */
-        std::vector<vk::DescriptorSet> standard_descriptor_sets;
+        std::vector<std::unique_ptr<VulkanDescriptorAllocator>> transient_descriptors;
+
+        /*!
+         * \brief Guards standard_descriptor_sets, since any thread may be the first to update a frame slot's standard set
+         */
+        std::mutex standard_descriptor_set_mutex;
 
         // Debugging things
         PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT = nullptr;
         PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT = nullptr;
         PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT = nullptr;
 
+        PFN_vkWaitForPresentKHR vkWaitForPresentKHR = nullptr;
+
+        PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR = nullptr;
+        PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR = nullptr;
+
         VulkanRenderDevice(NovaSettingsAccessManager& settings, NovaWindow& window);
 
         VulkanRenderDevice(VulkanRenderDevice&& old) noexcept = delete;
@@ -98,7 +264,10 @@ namespace nova::renderer::rhi {
         VulkanRenderDevice(const VulkanRenderDevice& other) = delete;
         VulkanRenderDevice& operator=(const VulkanRenderDevice& other) = delete;
 
-        ~VulkanRenderDevice() = default;
+        /*!
+         * \brief Saves the pipeline cache to disk and destroys it
+         */
+        ~VulkanRenderDevice();
 
 #pragma region Render engine interface
         void set_num_renderpasses(uint32_t num_renderpasses) override;
@@ -106,25 +275,54 @@ namespace nova::renderer::rhi {
         ntl::Result<RhiRenderpass*> create_renderpass(const renderpack::RenderPassCreateInfo& data,
                                                       const glm::uvec2& framebuffer_size) override;
 
+        ntl::Result<RhiRenderpass*> create_merged_renderpass(const std::vector<renderpack::RenderPassCreateInfo>& subpasses,
+                                                             const std::unordered_set<std::string>& transient_attachments,
+                                                             const glm::uvec2& framebuffer_size) override;
+
         RhiFramebuffer* create_framebuffer(const RhiRenderpass* renderpass,
                                            const std::vector<RhiImage*>& color_attachments,
                                            const std::optional<RhiImage*> depth_attachment,
+                                           const std::optional<RhiImage*> shading_rate_attachment,
                                            const glm::uvec2& framebuffer_size) override;
 
         std::unique_ptr<RhiPipeline> create_surface_pipeline(const RhiGraphicsPipelineState& pipeline_state) override;
 
         std::unique_ptr<RhiPipeline> create_global_pipeline(const RhiGraphicsPipelineState& pipeline_state) override;
 
+        std::unique_ptr<RhiPipeline> create_compute_pipeline(const RhiComputePipelineState& pipeline_state) override;
+
+        [[nodiscard]] bool compile_pipeline(RhiPipeline& pipeline, const RhiRenderpass& renderpass, uint32_t subpass) override;
+
         std::unique_ptr<RhiResourceBinder> create_resource_binder_for_pipeline(const RhiPipeline& pipeline) override;
 
         RhiBuffer* create_buffer(const RhiBufferCreateInfo& info) override;
 
         void write_data_to_buffer(const void* data, mem::Bytes num_bytes, const RhiBuffer* buffer) override;
 
+        void write_data_to_buffer(const void* data, mem::Bytes num_bytes, mem::Bytes offset, const RhiBuffer* buffer) override;
+
+        void* get_mapped_data(const RhiBuffer* buffer) override;
+
+        void flush_buffer(const RhiBuffer* buffer, mem::Bytes offset, mem::Bytes num_bytes) override;
+
+        void invalidate_buffer(const RhiBuffer* buffer, mem::Bytes offset, mem::Bytes num_bytes) override;
+
+        std::vector<RhiMemoryHeapBudget> get_memory_budgets() override;
+
+        std::vector<RhiMemoryPoolStats> get_memory_pool_stats() override;
+
+        RhiMemoryAccounting get_memory_accounting() override;
+
+        bool record_defragmentation(RhiRenderCommandList& cmds, uint32_t max_moves, mem::Bytes max_bytes) override;
+
         RhiSampler* create_sampler(const RhiSamplerCreateInfo& create_info) override;
 
+        bool supports_render_target_format(PixelFormat format) override;
+
         RhiImage* create_image(const renderpack::TextureCreateInfo& info) override;
 
+        std::vector<RhiImage*> create_aliased_images(const std::vector<renderpack::TextureCreateInfo>& infos) override;
+
         RhiSemaphore* create_semaphore() override;
 
         std::vector<RhiSemaphore*> create_semaphores(uint32_t num_semaphores) override;
@@ -133,9 +331,34 @@ namespace nova::renderer::rhi {
 
         std::vector<RhiFence*> create_fences(uint32_t num_fences, bool signaled) override;
 
-        void wait_for_fences(std::vector<RhiFence*> fences) override;
+        void wait_for_fences(std::span<RhiFence* const> fences) override;
+
+        void reset_fences(std::span<RhiFence* const> fences) override;
+
+        RhiQueryPool* create_timestamp_query_pool(uint32_t num_timestamps) override;
+
+        RhiQueryPool* create_pipeline_statistics_query_pool(uint32_t num_queries) override;
+
+        RhiQueryPool* create_occlusion_query_pool(uint32_t num_queries) override;
 
-        void reset_fences(const std::vector<RhiFence*>& fences) override;
+        void reset_queries(RhiQueryPool* pool, uint32_t first_query, uint32_t num_queries) override;
+
+        bool get_timestamps(RhiQueryPool* pool,
+                            uint32_t first_timestamp,
+                            uint32_t num_timestamps,
+                            std::vector<uint64_t>& timestamps) override;
+
+        bool get_pipeline_statistics(RhiQueryPool* pool,
+                                     uint32_t first_query,
+                                     uint32_t num_queries,
+                                     std::vector<RhiPipelineStatistics>& statistics) override;
+
+        bool get_occlusion_query_results(RhiQueryPool* pool,
+                                         uint32_t first_query,
+                                         uint32_t num_queries,
+                                         std::vector<uint64_t>& samples_passed) override;
+
+        void destroy_query_pool(RhiQueryPool* pool) override;
 
         void destroy_renderpass(RhiRenderpass* pass) override;
 
@@ -143,6 +366,8 @@ namespace nova::renderer::rhi {
 
         void destroy_texture(RhiImage* resource) override;
 
+        void destroy_buffer(RhiBuffer* buffer) override;
+
         void destroy_semaphores(std::vector<RhiSemaphore*>& semaphores) override;
 
         void destroy_fences(const std::vector<RhiFence*>& fences) override;
@@ -151,54 +376,155 @@ namespace nova::renderer::rhi {
                                                   QueueType needed_queue_type,
                                                   RhiRenderCommandList::Level level) override;
 
+        RhiRenderCommandList* create_secondary_command_list(uint32_t thread_idx,
+                                                            RhiRenderpass* renderpass,
+                                                            const RhiFramebuffer* framebuffer,
+                                                            uint32_t subpass) override;
+
+        RhiRenderCommandList* create_reusable_command_list(RhiRenderpass* renderpass,
+                                                           const RhiFramebuffer* framebuffer,
+                                                           uint32_t subpass) override;
+
+        void destroy_reusable_command_list(RhiRenderCommandList* cmds) override;
+
         void submit_command_list(RhiRenderCommandList* cmds,
                                  QueueType queue,
                                  RhiFence* fence_to_signal = nullptr,
-                                 const std::vector<RhiSemaphore*>& wait_semaphores = {},
-                                 const std::vector<RhiSemaphore*>& signal_semaphores = {}) override;
+                                 std::span<RhiSemaphore* const> wait_semaphores = {},
+                                 std::span<RhiSemaphore* const> signal_semaphores = {},
+                                 std::function<void()> on_completion = {}) override;
+
+        void submit_command_lists(std::span<const RhiSubmission> submissions, RhiFence* fence_to_signal) override;
+
+        void update_standard_descriptors(uint32_t frame_idx,
+                                         RhiBuffer* camera_buffer,
+                                         RhiBuffer* material_buffer,
+                                         RhiBuffer* model_matrix_buffer,
+                                         RhiBuffer* vertex_layouts,
+                                         RhiSampler* point_sampler,
+                                         RhiSampler* bilinear_sampler,
+                                         RhiSampler* trilinear_sampler,
+                                         RhiBuffer* virtual_page_table,
+                                         RhiBuffer* virtual_texture_feedback,
+                                         RhiImage* virtual_texture_cache,
+                                         RhiBuffer* light_cluster_params,
+                                         RhiBuffer* lights,
+                                         RhiBuffer* light_clusters,
+                                         RhiBuffer* light_indices,
+                                         RhiBuffer* particles,
+                                         RhiImage* volumetric_fog,
+                                         std::span<RhiBuffer* const> vertex_buffers,
+                                         std::span<RhiImage* const> textures) override;
+
+        void begin_frame(uint32_t frame_idx) override;
 
         void end_frame(FrameContext& ctx) override;
+
+        void save_pipeline_cache() override;
+
+        void recreate_swapchain() override;
+
+        [[nodiscard]] Swapchain* create_window_swapchain(NovaWindow& output_window) override;
+
+        void recreate_window_swapchain(Swapchain& output_swapchain, const NovaWindow& output_window) override;
+
+        void destroy_window_swapchain(Swapchain* output_swapchain) override;
 #pragma endregion
 
     public:
         [[nodiscard]] uint32_t get_queue_family_index(QueueType type) const;
 
+        /*!
+         * \brief How much host memory the driver has asked for through our allocation callbacks. All zeroes if we aren't using them
+         */
+        [[nodiscard]] VulkanHostAllocatorStats get_host_allocator_stats() const;
+
         VulkanPipelineLayoutInfo create_pipeline_layout(const RhiGraphicsPipelineState& state);
 
+        /*!
+         * \brief Gets the pipeline layout for some bindings. Bindings that another pipeline already has a layout for get that same layout
+         *
+         * Pipelines that share a layout can share descriptor sets too, and switching between them doesn't disturb the bound sets. Safe to
+         * call from multiple threads at once
+         */
+        VulkanPipelineLayoutInfo create_pipeline_layout(const std::unordered_map<std::string, RhiResourceBindingDescription>& bindings);
+
+        /*!
+         * \brief Gets the descriptor set layout with the provided bindings, creating it if no one has asked for it before
+         *
+         * The order of the bindings doesn't matter. The layout lives as long as the device does. Safe to call from multiple threads at once
+         *
+         * \param flags The flags of each binding, in the same order as the bindings
+         */
+        /*!
+         * \brief Gets a view of part of an image, creating it the first time anyone asks for one like it
+         *
+         * Views live as long as their image does. Safe to call from multiple threads at once
+         */
+        [[nodiscard]] vk::ImageView get_image_view(const VulkanImage& image, const VulkanImageViewDesc& desc);
+
+        /*!
+         * \brief Gets a view of one mip of an image, with the same aspect as the image's main view. Storage image descriptors can only
+         * see one mip, so shaders that write a whole mip chain need one of these for each mip
+         */
+        [[nodiscard]] vk::ImageView get_mip_view(const VulkanImage& image, uint32_t mip);
+
+        [[nodiscard]] vk::DescriptorSetLayout get_descriptor_set_layout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings,
+                                                                        const std::vector<vk::DescriptorBindingFlags>& flags);
+
         /*!
          * \brief Creates a new PSO
          *
          * \param state Pipeline state to bake into the PSO
          * \param renderpass The render pas that this pipeline will be used with
+         * \param subpass The subpass of `renderpass` that this pipeline will be used in
          * \param allocator Allocator to use for any needed memory
          *
          * \return The new PSO
          */
-        [[nodiscard]] ntl::Result<vk::Pipeline> compile_pipeline_state(const VulkanPipeline& state, const VulkanRenderpass& renderpass);
+        [[nodiscard]] ntl::Result<vk::Pipeline> compile_pipeline_state(const VulkanPipeline& state,
+                                                                      const VulkanRenderpass& renderpass,
+                                                                      uint32_t subpass);
 
-        [[nodiscard]] std::optional<vk::DescriptorPool> create_descriptor_pool(
-            const std::unordered_map<DescriptorType, uint32_t>& descriptor_capacity);
+        /*!
+         * \brief Gets the persistent standard descriptor set of a frame slot
+         */
+        [[nodiscard]] vk::DescriptorSet get_standard_descriptor_set(uint32_t frame_idx) const;
 
         /*!
-         * \brief Gets the next available descriptor set for the standard pipeline layout
+         * \brief Allocates descriptor sets that live until they're given to `destroy_descriptors`. Safe to call from multiple threads at
+         * once
          *
-         * If there are no free descriptor sets for the standard pipeline layout, this method creates a new one
+         * \return The sets, or nothing if they couldn't be allocated. Check the logs to find out why
          */
-        [[nodiscard]] vk::DescriptorSet get_next_standard_descriptor_set();
+        [[nodiscard]] std::optional<VulkanDescriptorAllocation> create_descriptors(
+            const std::vector<vk::DescriptorSetLayout>& descriptor_set_layouts,
+            const std::vector<uint32_t>& variable_descriptor_max_counts);
 
         /*!
-         * \brief Lets the render device know that all the provided descriptor sets are no longer in use by the GPU and can be used for
-         * whatever
+         * \brief Frees some sets from `create_descriptors` once the GPU has finished everything that's been submitted so far
          */
-        void return_standard_descriptor_sets(const std::vector<vk::DescriptorSet>& sets);
+        void destroy_descriptors(VulkanDescriptorAllocation allocation);
 
-        std::vector<vk::DescriptorSet> create_descriptors(const std::vector<vk::DescriptorSetLayout>& descriptor_set_layouts,
-                                                          const std::vector<uint32_t>& variable_descriptor_max_counts) const;
+        /*!
+         * \brief Allocates descriptor sets that are only valid for the rest of the current frame. They're all freed at once when this frame
+         * slot comes around again. Safe to call from multiple threads at once
+         */
+        [[nodiscard]] std::optional<VulkanDescriptorAllocation> create_transient_descriptors(
+            const std::vector<vk::DescriptorSetLayout>& descriptor_set_layouts,
+            const std::vector<uint32_t>& variable_descriptor_max_counts);
 
-        [[nodiscard]] vk::Fence get_next_submission_fence();
+        /*!
+         * \brief Runs some work during the first `end_frame` after everything that's been submitted to a queue so far has finished
+         *
+         * Use this to destroy or recycle anything that the GPU may still be using. Safe to call from multiple threads at once
+         */
+        void defer_until_submissions_finish(QueueType queue, std::function<void()> work);
+
+        [[nodiscard]] const VulkanDeviceInfo& get_vk_info() const;
 
     protected:
-        void create_surface();
+        [[nodiscard]] vk::SurfaceKHR create_surface(const NovaWindow& window) const;
 
     private:
         VulkanDeviceInfo vk_info;
@@ -206,13 +532,129 @@ namespace nova::renderer::rhi {
         VmaAllocator vma;
 
         /*!
-         * The index in the vector is the thread index, the key in the map is the queue family index
+         * \brief The classes of resources that get a VMA pool of their own
+         */
+        enum class MemoryPoolClass : uint8_t {
+            MeshGeometry,
+            StreamedTextures,
+            Upload,
+            Staging,
+            Count,
+        };
+
+        /*!
+         * \brief One pool for each `MemoryPoolClass`. A pool that couldn't be created is null, and its resources use VMA's default pools
          */
-        std::vector<std::unordered_map<uint32_t, vk::CommandPool>> command_pools_by_thread_idx;
+        std::array<VmaPool, static_cast<size_t>(MemoryPoolClass::Count)> memory_pools{};
 
-        std::vector<FencedTask> fenced_tasks;
+        /*!
+         * \brief The memory of every buffer and image, keyed by their VmaAllocation. Defragmentation moves allocations without changing
+         * their handles, so the keys stay good
+         */
+        MemoryTracker memory_tracker;
 
-        std::vector<vk::Fence> submission_fences;
+        /*!
+         * \brief A resource that the current defragmentation pass moved, and the handles it had before. In-flight frames may still use
+         * them
+         */
+        struct DefragmentationMove {
+            /*!
+             * \brief The moved resource, or null if it was destroyed before the pass finished
+             */
+            RhiResource* resource = nullptr;
+
+            /*!
+             * \brief Index of the move in the VMA pass
+             */
+            uint32_t move_idx = 0;
+
+            vk::Buffer old_buffer = VK_NULL_HANDLE;
+
+            vk::Image old_image = VK_NULL_HANDLE;
+
+            std::vector<vk::ImageView> old_image_views;
+        };
+
+        /*!
+         * \brief The incremental defragmentation of one pool. VMA only lets one pass be in progress at a time
+         */
+        struct DefragmentationState {
+            VmaDefragmentationContext context = VK_NULL_HANDLE;
+
+            /*!
+             * \brief Which of `DEFRAGMENTED_POOLS` is being defragmented, or is next
+             */
+            uint32_t pool_idx = 0;
+
+            VmaDefragmentationPassMoveInfo pass{};
+
+            std::vector<DefragmentationMove> moves;
+
+            /*!
+             * \brief The frame whose command list copies the current pass's resources. The pass ends once that frame has finished
+             */
+            std::optional<uint32_t> pass_frame;
+
+            /*!
+             * \brief The pools aren't looked at again until this frame, once every pool has had no moves left
+             */
+            uint32_t idle_until_frame = 0;
+        };
+
+        DefragmentationState defragmentation;
+
+        /*!
+         * \brief Guards `defragmentation`, since resources may be destroyed on any thread
+         */
+        std::mutex defragmentation_mutex;
+
+        /*!
+         * \brief Command pools indexed by frame slot, then by thread index, then by queue family index
+         */
+        std::vector<std::vector<std::unordered_map<uint32_t, VulkanCommandPool>>> command_pools;
+
+        /*!
+         * \brief The pool of each command list from `create_reusable_command_list`. Every reusable list gets a pool of its own, so
+         * different threads can record them at once
+         */
+        std::unordered_map<const RhiRenderCommandList*, std::unique_ptr<VulkanCommandPool>> reusable_command_pools;
+
+        std::mutex reusable_command_pools_mutex;
+
+        /*!
+         * \brief One timeline for each distinct queue. If two queue types share a queue, they share its timeline too
+         */
+        std::vector<std::unique_ptr<QueueTimeline>> queue_timelines;
+
+        /*!
+         * \brief The timeline of each queue type, indexed by `QueueType`
+         */
+        std::array<QueueTimeline*, 3> timelines_by_queue_type{};
+
+        /*!
+         * \brief How many images are still bound to each memory allocation that `create_aliased_images` made
+         *
+         * The allocation is freed when the last of its images is destroyed
+         */
+        std::unordered_map<VmaAllocation, uint32_t> num_images_per_aliased_allocation;
+
+        /*!
+         * \brief A frame slot's standard descriptor set, along with the image view that each element of its textures array points to
+         */
+        struct StandardDescriptorSet {
+            vk::DescriptorSet set;
+
+            std::vector<vk::ImageView> textures;
+        };
+
+        std::vector<StandardDescriptorSet> standard_descriptor_sets;
+
+        /*!
+         * \brief Cache that every PSO compile goes through, so that we don't recompile the same pipelines every time Nova starts up
+         *
+         * Vulkan pipeline caches are internally synchronized, so this is safe to use from any thread
+         */
+        vk::PipelineCache pipeline_cache;
 
 #pragma region Initialization
         std::vector<const char*> enabled_layer_names;
@@ -230,17 +672,66 @@ namespace nova::renderer::rhi {
 
         void initialize_vma();
 
+        void create_memory_pools();
+
+        [[nodiscard]] VmaPool get_memory_pool(MemoryPoolClass pool_class) const;
+
+        /*!
+         * \brief The pool for buffers with the provided usage, or null if they come from VMA's default pools
+         */
+        [[nodiscard]] VmaPool get_buffer_memory_pool(BufferUsage usage) const;
+
+        /*!
+         * \brief Starts counting the memory of a new allocation in `memory_tracker`
+         *
+         * \param owner Who the allocation belongs to. If it's empty, the resource named `name` is its own owner
+         */
+        void track_allocation(VmaAllocation allocation, MemoryCategory category, const std::string& owner, const std::string& name);
+
+        /*!
+         * \brief Makes the view of every mip and layer of an image, for the image or for a copy of it
+         */
+        [[nodiscard]] vk::ImageView create_full_image_view(const VulkanImage& image, vk::Image image_handle) const;
+
+        /*!
+         * \brief Destroys the old handles of the current defragmentation pass's resources, and lets VMA free their old memory
+         */
+        void finish_defragmentation_pass();
+
+        /*!
+         * \brief Makes sure that the current defragmentation pass doesn't move a resource that's being destroyed
+         *
+         * \return Whether the resource's memory now belongs to the pass, which frees it when the pass finishes
+         */
+        bool cancel_defragmentation_move(const RhiResource* resource);
+
         void create_device_and_queues();
 
         bool does_device_support_extensions(vk::PhysicalDevice device, const std::vector<char*>& required_device_extensions);
 
         void create_swapchain();
 
+        /*!
+         * \brief Gets the present modes that a surface supports
+         */
+        [[nodiscard]] std::vector<vk::PresentModeKHR> get_present_modes(vk::SurfaceKHR surface);
+
+        /*!
+         * \brief Creates the pipeline cache, seeding it with the cache file that matches this device and driver if there is one
+         */
+        void create_pipeline_cache();
+
+        [[nodiscard]] std::filesystem::path get_pipeline_cache_path() const;
+
+        [[nodiscard]] bool is_pipeline_cache_compatible(const std::vector<uint8_t>& cache_data) const;
+
         void create_per_thread_command_pools();
 
+        void create_queue_timelines();
+
         void create_standard_pipeline_layout();
 
-        [[nodiscard]] std::unordered_map<uint32_t, vk::CommandPool> make_new_command_pools() const;
+        [[nodiscard]] std::unordered_map<uint32_t, VulkanCommandPool> make_new_command_pools() const;
 #pragma endregion
 
 #pragma region Helpers
@@ -259,17 +750,65 @@ namespace nova::renderer::rhi {
         [[nodiscard]] uint32_t find_memory_type_with_flags(uint32_t search_flags,
                                                            MemorySearchMode search_mode = MemorySearchMode::Fuzzy) const;
 
+        /*!
+         * \brief Fills out the create info for an image described by `info`, and records whether the image is a depth texture
+         */
+        [[nodiscard]] vk::ImageCreateInfo get_image_create_info(const renderpack::TextureCreateInfo& info, VulkanImage& image) const;
+
+        /*!
+         * \brief Names an image that's already bound to memory, and creates its image view
+         */
+        void finish_image_creation(VulkanImage& image, const renderpack::TextureCreateInfo& info, vk::Format format) const;
+
+        /*!
+         * \brief The most samples, up to `num_samples`, that this GPU can render both color and depth attachments with
+         *
+         * Images and renderpasses both pick their sample counts with this, so they always agree
+         */
+        [[nodiscard]] vk::SampleCountFlagBits get_sample_count(uint32_t num_samples) const;
+
+        /*!
+         * \brief Creates the transient image that renderpasses render to and resolve into `image`, if `info` asks for more than one
+         * sample. `image` must already be finished, and `resolve_create_info` is how it was created
+         *
+         * \return False if the image needs a multisampled copy, but it couldn't be created
+         */
+        bool create_multisampled_image(VulkanImage& image,
+                                       const vk::ImageCreateInfo& resolve_create_info,
+                                       const renderpack::TextureCreateInfo& info);
+
         [[nodiscard]] std::optional<vk::ShaderModule> create_shader_module(const std::vector<uint32_t>& spirv) const;
 
         /*!
-         * \brief Gets the image view associated with the given image
+         * \brief Hands out the next unused command list of a pool, allocating a new one if the pool has handed them all out already
          *
-         * Nova simplifies things a lot and only has one image view for each image. This is maintained within the
-         * Vulkan backend, since neither DX12 nor OpenGL have a direct equivalent. I may or may not emulate image views
-         * for those APIs if the demand is there, but idk
+         * The command list still has to be begun
+         */
+        VulkanRenderCommandList& acquire_command_list(VulkanCommandPool& pool, RhiRenderCommandList::Level level);
+
+        /*!
+         * \brief Begins a secondary command list inside the provided subpass, and gives it the dynamic state that it doesn't inherit
          *
-         * The method checks an internal hash map. If there's already an image view for the given image then great,
-         * otherwise one is created on-demand
+         * \param is_reusable Whether the command list may be executed more than once
+         */
+        void begin_secondary_command_list(VulkanRenderCommandList& list,
+                                          RhiRenderpass* renderpass,
+                                          const RhiFramebuffer* framebuffer,
+                                          uint32_t subpass,
+                                          bool is_reusable);
+
+        /*!
+         * \brief Waits for the GPU to finish all of a pool's command lists, then resets it
+         */
+        void reset_command_pool(VulkanCommandPool& pool);
+
+        /*!
+         * \brief Adds work to a timeline's lock-free list of new tasks
+         */
+        static void push_deferred_task(QueueTimeline& timeline, uint64_t submission_value, std::function<void()> work);
+
+        /*!
+         * \brief Gets the view of all of an image. `get_image_view` has views of parts of it
          */
         [[nodiscard]] static vk::ImageView image_view_for_image(const RhiImage* image);
 
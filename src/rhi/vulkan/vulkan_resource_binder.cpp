@@ -1,5 +1,8 @@
 #include "vulkan_resource_binder.hpp"
 
+#include <algorithm>
+
+#include <Tracy.hpp>
 #include <rx/core/algorithm/max.h>
 #include <rx/core/log.h>
 
@@ -19,17 +22,34 @@ namespace nova::renderer::rhi {
 
     VulkanResourceBinder::VulkanResourceBinder(VulkanRenderDevice& device,
                                                std::unordered_map<std::string, RhiResourceBindingDescription> bindings,
-                                               std::vector<vk::DescriptorSet> sets,
+                                               std::vector<vk::DescriptorSetLayout> set_layouts,
+                                               std::vector<uint32_t> variable_descriptor_counts,
                                                vk::PipelineLayout layout,
                                                rx::memory::allocator& allocator)
         : render_device{&device},
           allocator{&allocator},
           layout{layout},
-          sets{std::move(sets)},
+          set_layouts{std::move(set_layouts)},
+          variable_descriptor_counts{std::move(variable_descriptor_counts)},
+          frame_sets{&allocator},
           bindings{std::move(bindings)},
           bound_images{&allocator},
           bound_buffers{&allocator},
-          bound_samplers{&allocator} {}
+          bound_samplers{&allocator},
+          bound_buffer_ranges{&allocator},
+          bound_image_mips{&allocator} {
+        // Sized up front so that references from `get_sets` stay valid while other threads use other frame slots
+        frame_sets.resize(device.settings->max_in_flight_frames);
+    }
+
+    VulkanResourceBinder::~VulkanResourceBinder() {
+        // A moved-from binder has no frame slots left, so only the binder that ended up with the sets frees them
+        for(auto& frame : frame_sets) {
+            if(!frame.descriptors.sets.is_empty()) {
+                render_device->destroy_descriptors(std::move(frame.descriptors));
+            }
+        }
+    }
 
     void VulkanResourceBinder::bind_image(const std::string& binding_name, RhiImage* image) {
         bind_image_array(binding_name, {allocator, std::array{image}});
@@ -39,134 +59,243 @@ namespace nova::renderer::rhi {
         bind_buffer_array(binding_name, {allocator, std::array{buffer}});
     }
 
+    void VulkanResourceBinder::bind_buffer_range(const std::string& binding_name,
+                                                 RhiBuffer* buffer,
+                                                 const uint64_t offset,
+                                                 const uint64_t num_bytes) {
+        bind_resource_array(binding_name, {allocator, std::array{buffer}}, bound_buffers);
+
+        if(auto* range = bound_buffer_ranges.find(binding_name)) {
+            *range = {offset, num_bytes};
+
+        } else {
+            bound_buffer_ranges.insert(binding_name, BufferRange{offset, num_bytes});
+        }
+
+        mark_dirty(binding_name);
+    }
+
     void VulkanResourceBinder::bind_sampler(const std::string& binding_name, RhiSampler* sampler) {
         bind_sampler_array(binding_name, {allocator, std::array{sampler}});
     }
 
     void VulkanResourceBinder::bind_image_array(const std::string& binding_name, const std::vector<RhiImage*>& images) {
         bind_resource_array(binding_name, images, bound_images);
+        bound_image_mips.erase(binding_name);
 
-        dirty = true;
+        mark_dirty(binding_name);
     }
 
     void VulkanResourceBinder::bind_buffer_array(const std::string& binding_name, const std::vector<RhiBuffer*>& buffers) {
 #if NOVA_DEBUG
-        buffers.each_fwd([&](const RhiBuffer* buffer) {
-            if(buffer->size > render_device->gpu.props.limits.maxUniformBufferRange) {
-                logger->error("Cannot bind a buffer with a size greater than %u", render_device->gpu.props.limits.maxUniformBufferRange);
-            }
-        });
+        // Only uniform buffers are limited in size. Storage buffers may be as large as they want to be
+        if(const auto* binding = bindings.find(binding_name); binding != nullptr && binding->type == DescriptorType::UniformBuffer) {
+            buffers.each_fwd([&](const RhiBuffer* buffer) {
+                if(buffer->size > render_device->gpu.props.limits.maxUniformBufferRange) {
+                    logger->error("Cannot bind a uniform buffer with a size greater than %u",
+                                  render_device->gpu.props.limits.maxUniformBufferRange);
+                }
+            });
+        }
 #endif
 
         bind_resource_array(binding_name, buffers, bound_buffers);
+        bound_buffer_ranges.erase(binding_name);
 
-        dirty = true;
+        mark_dirty(binding_name);
     }
 
     void VulkanResourceBinder::bind_sampler_array(const std::string& binding_name, const std::vector<RhiSampler*>& samplers) {
         bind_resource_array(binding_name, samplers, bound_samplers);
 
-        dirty = true;
+        mark_dirty(binding_name);
     }
 
-    vk::PipelineLayout VulkanResourceBinder::get_layout() const { return layout; }
+    void VulkanResourceBinder::bind_image_mips(const std::string& binding_name, RhiImage* image, const uint32_t first_mip) {
+        if(auto* mips = bound_image_mips.find(binding_name)) {
+            *mips = {image, first_mip};
 
-    const std::vector<vk::DescriptorSet>& VulkanResourceBinder::get_sets() {
-        if(dirty) {
-            update_all_descriptors();
+        } else {
+            bound_image_mips.insert(binding_name, ImageMips{image, first_mip});
         }
+        bound_images.erase(binding_name);
 
-        return sets;
+        mark_dirty(binding_name);
     }
 
-    void VulkanResourceBinder::update_all_descriptors() {
-        std::vector<vk::WriteDescriptorSet> writes{allocator};
-        writes.reserve(bound_images.size() + bound_samplers.size() + bound_buffers.size());
-
-        std::vector<std::vector<vk::DescriptorImageInfo>> all_image_infos{allocator};
-        all_image_infos.reserve(bound_images.size() + bound_samplers.size());
+    vk::PipelineLayout VulkanResourceBinder::get_layout() const { return layout; }
 
-        std::vector < std::vector<vk::DescriptorBufferInfo>> all_buffer_infos{allocator};
-        all_buffer_infos.reserve(bound_buffers.size());
+    const std::vector<vk::DescriptorSet>& VulkanResourceBinder::get_sets(const uint32_t frame_idx) {
+        std::lock_guard lock{*frame_sets_mutex};
 
-        bound_images.each_pair([&](const std::string& name, const std::vector<RhiImage*>& images) {
-            const auto& binding = *bindings.find(name);
-            const auto set = sets[binding.set];
+        auto& frame = frame_sets[frame_idx];
+        if(frame.descriptors.sets.is_empty()) {
+            auto descriptors = render_device->create_descriptors(set_layouts, variable_descriptor_counts);
+            if(!descriptors) {
+                // Nothing to bind. The device already said why
+                return frame.descriptors.sets;
+            }
+            frame.descriptors = std::move(*descriptors);
+
+            // Brand new sets have nothing in them, so everything that's bound needs to be written
+            const auto mark_dirty_in_frame = [&](const std::string& name, const auto& /* resources */) {
+                frame.dirty_bindings.insert(name);
+            };
+            bound_images.each_pair(mark_dirty_in_frame);
+            bound_buffers.each_pair(mark_dirty_in_frame);
+            bound_samplers.each_pair(mark_dirty_in_frame);
+            bound_image_mips.each_pair(mark_dirty_in_frame);
+        }
 
-            std::vector<vk::DescriptorImageInfo> image_infos{allocator};
-            image_infos.reserve(images.size());
+        if(!frame.dirty_bindings.empty()) {
+            update_descriptors(frame);
+        }
 
-            images.each_fwd([&](const RhiImage* image) {
-                const auto* vk_image = static_cast<const VulkanImage*>(image);
-                auto image_info = vk::DescriptorImageInfo()
-                                      .setImageView(vk_image->image_view)
-                                      .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-                image_infos.push_back(std::move(image_info));
-            });
+        return frame.descriptors.sets;
+    }
 
-            all_image_infos.push_back(std::move(image_infos));
+    void VulkanResourceBinder::mark_dirty(const std::string& binding_name) {
+        std::lock_guard lock{*frame_sets_mutex};
 
-            auto write = vk::WriteDescriptorSet()
-                             .setDstSet(set)
-                             .setDstBinding(binding.binding)
-                             .setDstArrayElement(0)
-                             .setDescriptorCount(static_cast<uint32_t>(images.size()))
-                             .setDescriptorType(vk::DescriptorType::eSampledImage)
-                             .setPImageInfo(all_image_infos.last().data());
-            writes.push_back(std::move(write));
+        // Slots without sets will write everything when they allocate them
+        frame_sets.each_fwd([&](FrameSets& frame) {
+            if(!frame.descriptors.sets.is_empty()) {
+                frame.dirty_bindings.insert(binding_name);
+            }
         });
+    }
 
-        bound_samplers.each_pair([&](const std::string& name, const std::vector<RhiSampler*>& samplers) {
-            const auto& binding = *bindings.find(name);
-            const auto set = sets[binding.set];
-
-            std::vector<vk::DescriptorImageInfo> sampler_infos{allocator};
-            sampler_infos.reserve(samplers.size());
-
-            samplers.each_fwd([&](const RhiSampler* sampler) {
-                const auto* vk_sampler = static_cast<const VulkanSampler*>(sampler);
-                auto sampler_info = vk::DescriptorImageInfo().setSampler(vk_sampler->sampler);
-                sampler_infos.push_back(std::move(sampler_info));
-            });
-
-            all_image_infos.push_back(std::move(sampler_infos));
-
-            auto write = vk::WriteDescriptorSet()
-                             .setDstSet(set)
-                             .setDstBinding(binding.binding)
-                             .setDstArrayElement(0)
-                             .setDescriptorCount(static_cast<uint32_t>(samplers.size()))
-                             .setDescriptorType(vk::DescriptorType::eSampler)
-                             .setPImageInfo(all_image_infos.last().data());
-            writes.push_back(std::move(write));
-        });
+    void VulkanResourceBinder::update_descriptors(FrameSets& frame) {
+        ZoneScoped;
+        std::vector<vk::WriteDescriptorSet> writes{allocator};
+        writes.reserve(frame.dirty_bindings.size());
 
-        bound_buffers.each_pair([&](const std::string& name, const std::vector<RhiBuffer*>& buffers) {
-            const auto& binding = *bindings.find(name);
-            const auto set = sets[binding.set];
+        // Every write points into these, so they must not reallocate while we build the writes
+        std::vector<std::vector<vk::DescriptorImageInfo>> all_image_infos{allocator};
+        all_image_infos.reserve(frame.dirty_bindings.size());
 
-            std::vector<vk::DescriptorBufferInfo> buffer_infos{allocator};
-            buffer_infos.reserve(buffers.size());
+        std::vector<std::vector<vk::DescriptorBufferInfo>> all_buffer_infos{allocator};
+        all_buffer_infos.reserve(frame.dirty_bindings.size());
 
-            buffers.each_fwd([&](const RhiBuffer* buffer) {
-                const auto* vk_buffer = static_cast<const VulkanBuffer*>(buffer);
-                auto buffer_info = vk::DescriptorBufferInfo().setBuffer(vk_buffer->buffer).setOffset(0).setRange(vk_buffer->size.b_count());
-                buffer_infos.push_back(std::move(buffer_info));
-            });
+        for(const auto& name : frame.dirty_bindings) {
+            const auto* binding = bindings.find(name);
+            if(binding == nullptr) {
+                logger->error("No binding named %s exists", name.data());
+                continue;
+            }
 
-            all_buffer_infos.push_back(std::move(buffer_infos));
+            const auto set = frame.descriptors.sets[binding->set];
+
+            if(const auto* mips = bound_image_mips.find(name)) {
+                const auto* vk_image = static_cast<const VulkanImage*>(mips->image);
+
+                const auto is_storage_image = binding->type == DescriptorType::StorageImage;
+                const auto layout = is_storage_image ? vk::ImageLayout::eGeneral : vk::ImageLayout::eShaderReadOnlyOptimal;
+                const auto last_mip = vk_image->num_mips - 1;
+
+                std::vector<vk::DescriptorImageInfo> image_infos{allocator};
+                image_infos.reserve(binding->count);
+                for(uint32_t i = 0; i < binding->count; i++) {
+                    const auto mip = std::min(mips->first_mip + i, last_mip);
+                    const auto view = render_device->get_mip_view(*vk_image, mip);
+                    image_infos.push_back(vk::DescriptorImageInfo().setImageView(view).setImageLayout(layout));
+                }
+
+                all_image_infos.push_back(std::move(image_infos));
+
+                auto write = vk::WriteDescriptorSet()
+                                 .setDstSet(set)
+                                 .setDstBinding(binding->binding)
+                                 .setDstArrayElement(0)
+                                 .setDescriptorCount(binding->count)
+                                 .setDescriptorType(to_vk_descriptor_type(binding->type))
+                                 .setPImageInfo(all_image_infos.last().data());
+                writes.push_back(std::move(write));
+
+            } else if(const auto* images = bound_images.find(name)) {
+                // Shaders write to storage images, and the rendergraph keeps them in the General layout while they do. Input attachments
+                // are in ShaderReadOnlyOptimal for the subpasses that read them
+                const auto is_storage_image = binding->type == DescriptorType::StorageImage;
+                const auto layout = is_storage_image ? vk::ImageLayout::eGeneral : vk::ImageLayout::eShaderReadOnlyOptimal;
+                const auto descriptor_type = to_vk_descriptor_type(binding->type);
+
+                std::vector<vk::DescriptorImageInfo> image_infos{allocator};
+                image_infos.reserve(images->size());
+
+                images->each_fwd([&](const RhiImage* image) {
+                    const auto* vk_image = static_cast<const VulkanImage*>(image);
+                    auto image_info = vk::DescriptorImageInfo().setImageView(vk_image->image_view).setImageLayout(layout);
+                    image_infos.push_back(std::move(image_info));
+                });
+
+                all_image_infos.push_back(std::move(image_infos));
+
+                auto write = vk::WriteDescriptorSet()
+                                 .setDstSet(set)
+                                 .setDstBinding(binding->binding)
+                                 .setDstArrayElement(0)
+                                 .setDescriptorCount(static_cast<uint32_t>(images->size()))
+                                 .setDescriptorType(descriptor_type)
+                                 .setPImageInfo(all_image_infos.last().data());
+                writes.push_back(std::move(write));
+
+            } else if(const auto* samplers = bound_samplers.find(name)) {
+                std::vector<vk::DescriptorImageInfo> sampler_infos{allocator};
+                sampler_infos.reserve(samplers->size());
+
+                samplers->each_fwd([&](const RhiSampler* sampler) {
+                    const auto* vk_sampler = static_cast<const VulkanSampler*>(sampler);
+                    auto sampler_info = vk::DescriptorImageInfo().setSampler(vk_sampler->sampler);
+                    sampler_infos.push_back(std::move(sampler_info));
+                });
+
+                all_image_infos.push_back(std::move(sampler_infos));
+
+                auto write = vk::WriteDescriptorSet()
+                                 .setDstSet(set)
+                                 .setDstBinding(binding->binding)
+                                 .setDstArrayElement(0)
+                                 .setDescriptorCount(static_cast<uint32_t>(samplers->size()))
+                                 .setDescriptorType(vk::DescriptorType::eSampler)
+                                 .setPImageInfo(all_image_infos.last().data());
+                writes.push_back(std::move(write));
+
+            } else if(const auto* buffers = bound_buffers.find(name)) {
+                const auto* range = bound_buffer_ranges.find(name);
+
+                std::vector<vk::DescriptorBufferInfo> buffer_infos{allocator};
+                buffer_infos.reserve(buffers->size());
+
+                buffers->each_fwd([&](const RhiBuffer* buffer) {
+                    const auto* vk_buffer = static_cast<const VulkanBuffer*>(buffer);
+                    auto buffer_info = vk::DescriptorBufferInfo().setBuffer(vk_buffer->buffer);
+                    if(range != nullptr) {
+                        buffer_info.setOffset(range->offset).setRange(range->num_bytes);
+
+                    } else {
+                        buffer_info.setOffset(0).setRange(vk_buffer->size.b_count());
+                    }
+                    buffer_infos.push_back(std::move(buffer_info));
+                });
+
+                all_buffer_infos.push_back(std::move(buffer_infos));
+
+                auto write = vk::WriteDescriptorSet()
+                                 .setDstSet(set)
+                                 .setDstBinding(binding->binding)
+                                 .setDstArrayElement(0)
+                                 .setDescriptorCount(static_cast<uint32_t>(buffers->size()))
+                                 .setDescriptorType(to_vk_descriptor_type(binding->type))
+                                 .setPBufferInfo(all_buffer_infos.last().data());
+                writes.push_back(std::move(write));
+            }
+        }
 
-            auto write = vk::WriteDescriptorSet()
-                             .setDstSet(set)
-                             .setDstBinding(binding.binding)
-                             .setDstArrayElement(0)
-                             .setDescriptorCount(static_cast<uint32_t>(buffers.size()))
-                             .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-                             .setPBufferInfo(all_buffer_infos.last().data());
-            writes.push_back(std::move(write));
-        });
+        frame.dirty_bindings.clear();
 
-        render_device->device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        if(!writes.is_empty()) {
+            render_device->device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
     }
 
     template <typename ResourceType>
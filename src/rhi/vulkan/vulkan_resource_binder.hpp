@@ -1,11 +1,17 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
 #include <rx/core/deferred_function.h>
 #include <vulkan/vulkan.hpp>
 
 #include "nova_renderer/rhi/resource_binder.hpp"
 #include "nova_renderer/rhi/rhi_types.hpp"
 
+#include "vulkan_descriptor_allocator.hpp"
+
 namespace nova {
     namespace renderer {
         struct RhiGraphicsPipelineState;
@@ -18,14 +24,24 @@ namespace nova::renderer::rhi {
     /*!
      * \brief Binding resources in Vulkan!
      *
-     * This is basically a thing wrapper around descriptor sets. The constructor creates the descriptor sets, the destructor destroys them
+     * This is basically a thin wrapper around descriptor sets. Every frame slot gets its own copy of the descriptor sets, allocated the
+     * first time that slot binds them, so we never write to a set that an in-flight frame might still be reading
+     *
+     * Each copy remembers which bindings changed since it was last written. Binding a resource marks it as changed in every copy, and
+     * `get_sets` writes only the changed bindings of the requested copy, all in one `vkUpdateDescriptorSets` call. A binder whose resources
+     * stay the same does no descriptor work at all after each copy has been written once
      */
     class VulkanResourceBinder final : public RhiResourceBinder {
     public:
 #pragma region Lifecycle
+        /*!
+         * \param set_layouts The layouts of the descriptor sets to allocate for each frame slot
+         * \param variable_descriptor_counts The maximum size of the variable-sized array in each set, or 0 for sets without one
+         */
         VulkanResourceBinder(VulkanRenderDevice& device,
                              std::unordered_map<std::string, RhiResourceBindingDescription> bindings,
-                             std::vector<vk::DescriptorSet> sets,
+                             std::vector<vk::DescriptorSetLayout> set_layouts,
+                             std::vector<uint32_t> variable_descriptor_counts,
                              vk::PipelineLayout layout,
                              rx::memory::allocator& allocator);
 
@@ -35,7 +51,10 @@ namespace nova::renderer::rhi {
         VulkanResourceBinder(VulkanResourceBinder&& old) noexcept = default;
         VulkanResourceBinder& operator=(VulkanResourceBinder&& old) noexcept = default;
 
-        ~VulkanResourceBinder() override = default;
+        /*!
+         * \brief Frees every frame slot's sets, once the GPU is done with them
+         */
+        ~VulkanResourceBinder() override;
 #pragma endregion
 
 #pragma region RhiResourceBinder
@@ -43,6 +62,8 @@ namespace nova::renderer::rhi {
 
         void bind_buffer(const std::string& binding_name, RhiBuffer* buffer) override;
 
+        void bind_buffer_range(const std::string& binding_name, RhiBuffer* buffer, uint64_t offset, uint64_t num_bytes) override;
+
         void bind_sampler(const std::string& binding_name, RhiSampler* sampler) override;
 
         void bind_image_array(const std::string& binding_name, const std::vector<RhiImage*>& images) override;
@@ -50,14 +71,29 @@ namespace nova::renderer::rhi {
         void bind_buffer_array(const std::string& binding_name, const std::vector<RhiBuffer*>& buffers) override;
 
         void bind_sampler_array(const std::string& binding_name, const std::vector<RhiSampler*>& samplers) override;
+
+        void bind_image_mips(const std::string& binding_name, RhiImage* image, uint32_t first_mip) override;
 #pragma endregion
 
         [[nodiscard]] vk::PipelineLayout get_layout() const;
 
-        [[nodiscard]] const std::vector<vk::DescriptorSet>& get_sets();
+        /*!
+         * \brief Gets the provided frame slot's copy of the descriptor sets, writing any bindings that changed since that copy was last
+         * used
+         *
+         * Command lists may be recorded on any thread, so this is safe to call from multiple threads at once
+         */
+        [[nodiscard]] const std::vector<vk::DescriptorSet>& get_sets(uint32_t frame_idx);
 
     private:
-        bool dirty = false;
+        struct FrameSets {
+            VulkanDescriptorAllocation descriptors;
+
+            /*!
+             * \brief Names of the bindings that changed since these sets were last written
+             */
+            std::unordered_set<std::string> dirty_bindings;
+        };
 
         VulkanRenderDevice* render_device;
 
@@ -68,10 +104,19 @@ namespace nova::renderer::rhi {
          */
         vk::PipelineLayout layout;
 
+        std::vector<vk::DescriptorSetLayout> set_layouts;
+
+        std::vector<uint32_t> variable_descriptor_counts;
+
+        /*!
+         * \brief One copy of the descriptor sets for each frame slot that has used this binder
+         */
+        std::vector<FrameSets> frame_sets;
+
         /*!
-         * \brief Descriptor sets for this binder
+         * \brief Guards `frame_sets`, since the renderpasses that use this binder may be recorded on different threads
          */
-        std::vector<vk::DescriptorSet> sets;
+        std::unique_ptr<std::mutex> frame_sets_mutex = std::make_unique<std::mutex>();
 
         std::unordered_map<std::string, RhiResourceBindingDescription> bindings;
 
@@ -79,6 +124,35 @@ namespace nova::renderer::rhi {
         std::unordered_map<std::string, std::vector<RhiBuffer*>> bound_buffers;
         std::unordered_map<std::string, std::vector<RhiSampler*>> bound_samplers;
 
-        void update_all_descriptors();
+        struct BufferRange {
+            uint64_t offset;
+            uint64_t num_bytes;
+        };
+
+        /*!
+         * \brief The part of the buffer to bind, for buffers that were bound with `bind_buffer_range`. Everything else in `bound_buffers`
+         * is bound whole
+         */
+        std::unordered_map<std::string, BufferRange> bound_buffer_ranges;
+
+        struct ImageMips {
+            RhiImage* image;
+            uint32_t first_mip;
+        };
+
+        /*!
+         * \brief Images that were bound with `bind_image_mips`. These bind one view per mip instead of the image's view of every mip
+         */
+        std::unordered_map<std::string, ImageMips> bound_image_mips;
+
+        /*!
+         * \brief Marks a binding as changed in every frame slot's copy of the sets
+         */
+        void mark_dirty(const std::string& binding_name);
+
+        /*!
+         * \brief Writes every dirty binding of one frame slot's sets
+         */
+        void update_descriptors(FrameSets& frame);
     };
 } // namespace nova::renderer::rhi
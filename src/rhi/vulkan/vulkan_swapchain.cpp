@@ -1,5 +1,9 @@
 #include "vulkan_swapchain.hpp"
 
+#include <algorithm>
+#include <array>
+#include <span>
+
 #include <rx/core/log.h>
 
 #include "Tracy.hpp"
@@ -14,24 +18,51 @@ namespace nova::renderer::rhi {
 
     VulkanSwapchain::VulkanSwapchain(const uint32_t num_swapchain_images,
                                      VulkanRenderDevice* render_device,
+                                     const vk::SurfaceKHR surface,
                                      const glm::uvec2 window_dimensions,
                                      const std::vector<vk::PresentModeKHR>& present_modes)
-        : Swapchain(num_swapchain_images, window_dimensions), render_device(render_device), num_swapchain_images(num_swapchain_images) {
+        : Swapchain(num_swapchain_images, window_dimensions),
+          render_device(render_device),
+          surface(surface),
+          supported_present_modes(present_modes),
+          num_swapchain_images(num_swapchain_images),
+          requested_num_images(num_swapchain_images) {
         ZoneScoped;
         create_swapchain(num_swapchain_images, present_modes, window_dimensions);
 
+        create_resources_for_swapchain_images();
+    }
+
+    void VulkanSwapchain::recreate(const glm::uvec2& new_size) {
+        ZoneScoped;
+        // The caller waited for the device to go idle, so nothing still uses the old images
+        destroy_resources_for_swapchain_images();
+
+        create_swapchain(requested_num_images, supported_present_modes, new_size);
+
+        create_resources_for_swapchain_images();
+
+        is_out_of_date = false;
+    }
+
+    void VulkanSwapchain::create_resources_for_swapchain_images() {
+        ZoneScoped;
         std::vector<vk::Image> vk_images = get_swapchain_images();
 
         if(vk_images.is_empty()) {
             logger->error("The swapchain returned zero images");
         }
 
+        num_images = num_swapchain_images;
+
         swapchain_image_layouts.resize(num_swapchain_images);
         swapchain_image_layouts.each_fwd(
             [&](vk::ImageLayout& swapchain_image_layout) { swapchain_image_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; });
 
-        // Create a dummy renderpass that writes to a single color attachment - the swapchain
-        const vk::RenderPass renderpass = create_dummy_renderpass();
+        // Create a dummy renderpass that writes to a single color attachment - the swapchain. Dynamic rendering doesn't need
+        // framebuffers, so it doesn't need the renderpass either
+        const auto uses_dynamic_rendering = render_device->get_vk_info().supports_dynamic_rendering;
+        const vk::RenderPass renderpass = uses_dynamic_rendering ? VK_NULL_HANDLE : create_dummy_renderpass();
 
         const glm::uvec2 swapchain_size = {swapchain_extent.width, swapchain_extent.height};
 
@@ -39,56 +70,107 @@ namespace nova::renderer::rhi {
             create_resources_for_frame(vk_images[i], renderpass, swapchain_size);
         }
 
-        vkDestroyRenderPass(render_device->device, renderpass, nullptr);
+        if(renderpass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(render_device->device, renderpass, render_device->allocation_callbacks);
+        }
 
         // move the swapchain images into the correct layout cause I guess they aren't for some reason?
         transition_swapchain_images_into_color_attachment_layout(vk_images);
     }
 
-    uint8_t VulkanSwapchain::acquire_next_swapchain_image(rx::memory::allocator& allocator) {
-        ZoneScoped;        auto* fence = render_device->create_fence(false, allocator);
-        auto* vk_fence = static_cast<VulkanFence*>(fence);
+    void VulkanSwapchain::destroy_resources_for_swapchain_images() {
+        // The swapchain owns its images, so we only delete our wrappers around them. The swapchain frees the images themselves when it's
+        // destroyed
+        for(const RhiImage* image : swapchain_images) {
+            delete image;
+        }
+        swapchain_images.clear();
 
+        for(const vk::ImageView& image_view : swapchain_image_views) {
+            vkDestroyImageView(render_device->device, image_view, render_device->allocation_callbacks);
+        }
+        swapchain_image_views.clear();
+
+        for(const RhiFramebuffer* framebuffer : framebuffers) {
+            const auto* vk_framebuffer = static_cast<const VulkanFramebuffer*>(framebuffer);
+            vkDestroyFramebuffer(render_device->device, vk_framebuffer->framebuffer, render_device->allocation_callbacks);
+            delete framebuffer;
+        }
+        framebuffers.clear();
+
+        for(const RhiFence* fence : fences) {
+            const auto* vk_fence = static_cast<const VulkanFence*>(fence);
+            vkDestroyFence(render_device->device, vk_fence->fence, render_device->allocation_callbacks);
+            delete fence;
+        }
+        fences.clear();
+
+        swapchain_image_layouts.clear();
+    }
+
+    std::optional<uint8_t> VulkanSwapchain::acquire_next_swapchain_image(RhiSemaphore* image_available_semaphore) {
+        ZoneScoped;
+        const auto* vk_semaphore = static_cast<VulkanSemaphore*>(image_available_semaphore);
+
+        // No fence here. The GPU waits on the semaphore before it writes to the image, so the CPU can go on recording the frame while
+        // the presentation engine finishes with the image
         uint32_t acquired_image_idx;
         const auto acquire_result = vkAcquireNextImageKHR(render_device->device,
                                                           swapchain,
                                                           std::numeric_limits<uint64_t>::max(),
+                                                          vk_semaphore->semaphore,
                                                           VK_NULL_HANDLE,
-                                                          vk_fence->fence,
                                                           &acquired_image_idx);
-        if(acquire_result == VK_ERROR_OUT_OF_DATE_KHR || acquire_result == VK_SUBOPTIMAL_KHR) {
-            // TODO: Recreate the swapchain and all screen-relative textures
-            logger->error("Swapchain out of date! One day you'll write the code to recreate it");
-            return 0;
+        if(acquire_result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // We didn't get an image, and the semaphore won't be signaled. The renderer has to recreate the swapchain before it can
+            // render anything
+            is_out_of_date = true;
+            return std::nullopt;
         }
-        if(acquire_result != VK_SUCCESS) {
+        if(acquire_result == VK_SUBOPTIMAL_KHR) {
+            // We did get an image and the semaphore will be signaled, so render this frame and recreate the swapchain before the next one
+            is_out_of_date = true;
+
+        } else if(acquire_result != VK_SUCCESS) {
             logger->error("%s:%u=>%s", __FILE__, __LINE__, to_string(acquire_result));
         }
 
-        // Block until we have the swapchain image in order to mimic D3D12. TODO: Reevaluate this decision
-        std::vector<RhiFence*> fences;
-        fences.push_back(vk_fence);
-        render_device->wait_for_fences(fences);
-
-        render_device->destroy_fences(fences, allocator);
-
         return static_cast<uint8_t>(acquired_image_idx);
     }
 
-    void VulkanSwapchain::present(const uint32_t image_idx) {
-        ZoneScoped;        vk::Result swapchain_result = {};
+    void VulkanSwapchain::present(const uint32_t image_idx, RhiSemaphore* render_finished_semaphore) {
+        ZoneScoped;
+        vk::Result swapchain_result = {};
 
         vk::PresentInfoKHR present_info = {};
         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-        present_info.waitSemaphoreCount = 0;
-        present_info.pWaitSemaphores = nullptr;
+        if(render_finished_semaphore != nullptr) {
+            const auto* vk_semaphore = static_cast<VulkanSemaphore*>(render_finished_semaphore);
+            present_info.waitSemaphoreCount = 1;
+            present_info.pWaitSemaphores = &vk_semaphore->semaphore;
+        }
         present_info.swapchainCount = 1;
         present_info.pSwapchains = &swapchain;
         present_info.pImageIndices = &image_idx;
         present_info.pResults = &swapchain_result;
 
+        // Numbering the presents lets wait_for_last_present find out when this one reaches the display
+        vk::PresentIdKHR present_id_info = {};
+        if(render_device->get_vk_info().supports_present_wait) {
+            last_present_id++;
+            present_id_info.swapchainCount = 1;
+            present_id_info.pPresentIds = &last_present_id;
+            present_info.pNext = &present_id_info;
+        }
+
         const auto result = vkQueuePresentKHR(render_device->graphics_queue, &present_info);
 
+        if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            // Usually means the window was resized. The renderer will notice and recreate the swapchain before the next frame
+            is_out_of_date = true;
+            return;
+        }
+
         if(result != VK_SUCCESS) {
             logger->error("Could not present swapchain images: vkQueuePresentKHR failed: %s", to_string(result));
         }
@@ -98,6 +180,15 @@ namespace nova::renderer::rhi {
         }
     }
 
+    bool VulkanSwapchain::wait_for_last_present(const uint64_t timeout_ns) {
+        ZoneScoped;
+        if(!render_device->get_vk_info().supports_present_wait || last_present_id == 0) {
+            return false;
+        }
+
+        return render_device->vkWaitForPresentKHR(render_device->device, swapchain, last_present_id, timeout_ns) == VK_SUCCESS;
+    }
+
     void VulkanSwapchain::transition_swapchain_images_into_color_attachment_layout(const std::vector<vk::Image>& images) const {
         ZoneScoped;        std::vector<vk::ImageMemoryBarrier> barriers;
         barriers.reserve(images.size());
@@ -127,7 +218,7 @@ namespace nova::renderer::rhi {
         vk::CommandPoolCreateInfo command_pool_create_info = {};
         command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         command_pool_create_info.queueFamilyIndex = render_device->graphics_family_index;
-        vkCreateCommandPool(render_device->device, &command_pool_create_info, nullptr, &command_pool);
+        vkCreateCommandPool(render_device->device, &command_pool_create_info, render_device->allocation_callbacks, &command_pool);
 
         vk::CommandBufferAllocateInfo alloc_info = {};
         alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -161,7 +252,7 @@ namespace nova::renderer::rhi {
         vk::FenceCreateInfo fence_create_info = {};
         fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 
-        vkCreateFence(render_device->device, &fence_create_info, nullptr, &transition_done_fence);
+        vkCreateFence(render_device->device, &fence_create_info, render_device->allocation_callbacks, &transition_done_fence);
 
         vk::SubmitInfo submit_info = {};
         submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -175,22 +266,10 @@ namespace nova::renderer::rhi {
     }
 
     void VulkanSwapchain::deinit() {
-        swapchain_images.each_fwd([&](const RhiImage* i) {
-            const VulkanImage* vk_image = static_cast<const VulkanImage*>(i);
-            vkDestroyImage(render_device->device, vk_image->image, nullptr);
-            delete i;
-        });
-        swapchain_images.clear();
-
-        swapchain_image_views.each_fwd([&](const vk::ImageView& iv) { vkDestroyImageView(render_device->device, iv, nullptr); });
-        swapchain_image_views.clear();
+        destroy_resources_for_swapchain_images();
 
-        fences.each_fwd([&](const RhiFence* f) {
-            const VulkanFence* vk_fence = static_cast<const VulkanFence*>(f);
-            vkDestroyFence(render_device->device, vk_fence->fence, nullptr);
-            delete f;
-        });
-        fences.clear();
+        vkDestroySwapchainKHR(render_device->device, swapchain, render_device->allocation_callbacks);
+        swapchain = vk::SwapchainKHR{};
     }
 
     uint32_t VulkanSwapchain::get_num_images() const { return num_swapchain_images; }
@@ -201,6 +280,8 @@ namespace nova::renderer::rhi {
 
     vk::Format VulkanSwapchain::get_swapchain_format() const { return swapchain_format; }
 
+    vk::SurfaceKHR VulkanSwapchain::get_surface() const { return surface; }
+
     vk::SurfaceFormatKHR VulkanSwapchain::choose_surface_format(const std::vector<vk::SurfaceFormatKHR>& formats) {
         vk::SurfaceFormatKHR result;
 
@@ -221,16 +302,38 @@ namespace nova::renderer::rhi {
         return formats[0];
     }
 
-    vk::PresentModeKHR VulkanSwapchain::choose_present_mode(const std::vector<vk::PresentModeKHR>& modes) {
-        const vk::PresentModeKHR desired_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    vk::PresentModeKHR VulkanSwapchain::choose_present_mode(const std::vector<vk::PresentModeKHR>& modes,
+                                                            const PresentMode preferred_mode) {
+        // If we can't have the mode we want, we fall back to the mode that latency-wise is most like it
+        std::span<const vk::PresentModeKHR> candidates;
+        switch(preferred_mode) {
+            case PresentMode::Mailbox: {
+                static constexpr std::array MAILBOX_MODES{vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate};
+                candidates = MAILBOX_MODES;
+            } break;
+
+            case PresentMode::Immediate: {
+                static constexpr std::array IMMEDIATE_MODES{vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox};
+                candidates = IMMEDIATE_MODES;
+            } break;
+
+            case PresentMode::FifoRelaxed: {
+                static constexpr std::array FIFO_RELAXED_MODES{vk::PresentModeKHR::eFifoRelaxed};
+                candidates = FIFO_RELAXED_MODES;
+            } break;
+
+            case PresentMode::Fifo:
+                break;
+        }
 
-        // Mailbox mode is best mode (also not sure why)
-        if(modes.find(desired_mode) != std::vector<vk::PresentModeKHR>::k_npos) {
-            return desired_mode;
+        for(const auto mode : candidates) {
+            if(std::find(modes.begin(), modes.end(), mode) != modes.end()) {
+                return mode;
+            }
         }
 
-        // FIFO, like FIFA, is forever
-        return VK_PRESENT_MODE_FIFO_KHR;
+        // FIFO, like FIFA, is forever. Every implementation has to support it
+        return vk::PresentModeKHR::eFifo;
     }
 
     vk::Extent2D VulkanSwapchain::choose_surface_extent(const vk::SurfaceCapabilitiesKHR& caps, const glm::ivec2& window_dimensions) {
@@ -250,22 +353,37 @@ namespace nova::renderer::rhi {
                                            const std::vector<vk::PresentModeKHR>& present_modes,
                                            const glm::uvec2& window_dimensions) {
         ZoneScoped;
-        const auto surface_format = choose_surface_format(render_device->gpu.surface_formats);
-        const auto present_mode = choose_present_mode(present_modes);
-        const auto extent = choose_surface_extent(render_device->gpu.surface_capabilities, window_dimensions);
+        // The surface's extent follows its window, so the capabilities have to be asked for every time
+        vk::SurfaceCapabilitiesKHR caps;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(render_device->gpu.phys_device, surface, &caps);
+
+        uint32_t num_surface_formats;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(render_device->gpu.phys_device, surface, &num_surface_formats, nullptr);
+        std::vector<vk::SurfaceFormatKHR> surface_formats;
+        surface_formats.resize(num_surface_formats);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(render_device->gpu.phys_device, surface, &num_surface_formats, surface_formats.data());
+
+        const auto surface_format = choose_surface_format(surface_formats);
+        const auto present_mode = choose_present_mode(present_modes, render_device->settings->swapchain.present_mode);
+        const auto extent = choose_surface_extent(caps, window_dimensions);
 
         vk::SwapchainCreateInfoKHR info = {};
         info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-        info.surface = render_device->surface;
+        info.surface = surface;
 
-        info.minImageCount = requested_num_swapchain_images;
+        // A maxImageCount of 0 means there's no limit
+        info.minImageCount = std::max(requested_num_swapchain_images, caps.minImageCount);
+        if(caps.maxImageCount > 0) {
+            info.minImageCount = std::min(info.minImageCount, caps.maxImageCount);
+        }
 
         info.imageFormat = surface_format.format;
         info.imageColorSpace = surface_format.colorSpace;
         info.imageExtent = extent;
         info.imageArrayLayers = 1;
 
-        info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        // Extra render outputs blit the frame into their swapchain images instead of rendering to them
+        info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
         info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         info.queueFamilyIndexCount = 1;
@@ -277,13 +395,29 @@ namespace nova::renderer::rhi {
 
         info.clipped = VK_TRUE;
 
-        auto res = vkCreateSwapchainKHR(render_device->device, &info, nullptr, &swapchain);
+        // Handing over the old swapchain lets the presentation engine reuse its resources, and lets any images it's still showing finish
+        // presenting
+        const auto old_swapchain = swapchain;
+        info.oldSwapchain = old_swapchain;
+
+        const auto res = vkCreateSwapchainKHR(render_device->device, &info, render_device->allocation_callbacks, &swapchain);
+        if(res != VK_SUCCESS) {
+            logger->error("Could not create the swapchain: %s", to_string(res));
+        }
 
-        logger->error("%u", res);
+        if(old_swapchain != vk::SwapchainKHR{}) {
+            vkDestroySwapchainKHR(render_device->device, old_swapchain, render_device->allocation_callbacks);
+        }
+
+        // Present IDs belong to a specific vk::Swapchain, so the new one starts counting over
+        last_present_id = 0;
+
+        logger->debug("Created a %ux%u swapchain with present mode %s", extent.width, extent.height, vk::to_string(present_mode));
 
         swapchain_format = surface_format.format;
         this->present_mode = present_mode;
         swapchain_extent = extent;
+        size = {extent.width, extent.height};
     }
 
     void VulkanSwapchain::create_resources_for_frame(const vk::Image image, const vk::RenderPass renderpass, const glm::uvec2& swapchain_size) {
@@ -310,24 +444,34 @@ namespace nova::renderer::rhi {
         image_view_create_info.subresourceRange.baseArrayLayer = 0;
         image_view_create_info.subresourceRange.layerCount = 1;
 
-        vkCreateImageView(render_device->device, &image_view_create_info, nullptr, &vk_image->image_view);
+        vkCreateImageView(render_device->device, &image_view_create_info, render_device->allocation_callbacks, &vk_image->image_view);
         swapchain_image_views.push_back(vk_image->image_view);
 
         swapchain_images.push_back(vk_image);
 
-        vk::FramebufferCreateInfo framebuffer_create_info = {};
-        framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebuffer_create_info.attachmentCount = 1;
-        framebuffer_create_info.pAttachments = &vk_image->image_view;
-        framebuffer_create_info.renderPass = renderpass;
-        framebuffer_create_info.width = swapchain_extent.width;
-        framebuffer_create_info.height = swapchain_extent.height;
-        framebuffer_create_info.layers = 1;
-
         auto* vk_framebuffer = new VulkanFramebuffer;
         vk_framebuffer->size = swapchain_size;
         vk_framebuffer->num_attachments = 1;
-        vkCreateFramebuffer(render_device->device, &framebuffer_create_info, nullptr, &vk_framebuffer->framebuffer);
+
+        if(renderpass != VK_NULL_HANDLE) {
+            vk::FramebufferCreateInfo framebuffer_create_info = {};
+            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebuffer_create_info.attachmentCount = 1;
+            framebuffer_create_info.pAttachments = &vk_image->image_view;
+            framebuffer_create_info.renderPass = renderpass;
+            framebuffer_create_info.width = swapchain_extent.width;
+            framebuffer_create_info.height = swapchain_extent.height;
+            framebuffer_create_info.layers = 1;
+
+            vkCreateFramebuffer(render_device->device,
+                                &framebuffer_create_info,
+                                render_device->allocation_callbacks,
+                                &vk_framebuffer->framebuffer);
+
+        } else {
+            vk_framebuffer->attachment_views.push_back(vk_image->image_view);
+            vk_framebuffer->resolve_views.push_back(VK_NULL_HANDLE);
+        }
 
         framebuffers.push_back(vk_framebuffer);
 
@@ -335,7 +479,7 @@ namespace nova::renderer::rhi {
         fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
         vk::Fence fence;
-        vkCreateFence(render_device->device, &fence_create_info, nullptr, &fence);
+        vkCreateFence(render_device->device, &fence_create_info, render_device->allocation_callbacks, &fence);
         fences.push_back(new VulkanFence{{}, fence});
     }
 
@@ -389,7 +533,7 @@ namespace nova::renderer::rhi {
         render_pass_create_info.dependencyCount = 0;
 
         vk::RenderPass renderpass;
-        vkCreateRenderPass(render_device->device, &render_pass_create_info, nullptr, &renderpass);
+        vkCreateRenderPass(render_device->device, &render_pass_create_info, render_device->allocation_callbacks, &renderpass);
 
         return renderpass;
     }
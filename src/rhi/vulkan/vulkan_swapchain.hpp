@@ -2,14 +2,17 @@
 
 #include <glm/glm.hpp>
 #include <cstdint>
+#include <optional>
 #include <vulkan/vulkan.h>
 
+#include "nova_renderer/nova_settings.hpp"
 #include "nova_renderer/rhi/swapchain.hpp"
 
 namespace nova::renderer::rhi {
     struct RhiFence;
     struct RhiFramebuffer;
     struct RhiImage;
+    struct RhiSemaphore;
 
     class VulkanRenderDevice;
 
@@ -22,21 +25,40 @@ namespace nova::renderer::rhi {
      */
     class VulkanSwapchain final : public Swapchain {
     public:
+        /*!
+         * \param surface The surface of the window to present to. The swapchain doesn't own it, so destroy it after the swapchain
+         */
         VulkanSwapchain(uint32_t num_swapchain_images,
                         VulkanRenderDevice* render_device,
+                        vk::SurfaceKHR surface,
                         glm::uvec2 window_dimensions,
                         const std::vector<vk::PresentModeKHR>& present_modes);
 
 #pragma region Swapchain implementation
-        uint8_t acquire_next_swapchain_image(rx::memory::allocator& allocator) override;
+        std::optional<uint8_t> acquire_next_swapchain_image(RhiSemaphore* image_available_semaphore) override;
+
+        void present(uint32_t image_idx, RhiSemaphore* render_finished_semaphore) override;
+
+        /*!
+         * \brief Waits on the last present's ID with VK_KHR_present_wait, if the device supports it
+         */
+        [[nodiscard]] bool wait_for_last_present(uint64_t timeout_ns) override;
 
-        void present(uint32_t image_idx) override;
+        /*!
+         * \brief Replaces the vk::Swapchain with a new one that's the provided size, along with the views, framebuffers, and fences for its
+         * images
+         *
+         * \pre The device is idle
+         */
+        void recreate(const glm::uvec2& new_size) override;
 #pragma endregion
 
         [[nodiscard]] vk::ImageLayout get_layout(uint32_t frame_idx);
         [[nodiscard]] vk::Extent2D get_swapchain_extent() const;
         [[nodiscard]] vk::Format get_swapchain_format() const;
 
+        [[nodiscard]] vk::SurfaceKHR get_surface() const;
+
         // I've had a lot of bugs with RAII so here's an explicit cleanup method
         void deinit();
 
@@ -45,6 +67,8 @@ namespace nova::renderer::rhi {
     private:
         VulkanRenderDevice* render_device;
 
+        vk::SurfaceKHR surface;
+
         vk::SwapchainKHR swapchain{};
         vk::Extent2D swapchain_extent;
         vk::PresentModeKHR present_mode;
@@ -53,12 +77,32 @@ namespace nova::renderer::rhi {
         std::vector<vk::ImageView> swapchain_image_views;
         std::vector<vk::ImageLayout> swapchain_image_layouts;
 
+        /*!
+         * \brief The present modes the surface supports, saved so we can pick one again when we recreate the swapchain
+         */
+        std::vector<vk::PresentModeKHR> supported_present_modes;
+
         uint32_t num_swapchain_images;
 
+        /*!
+         * \brief The ID we gave the most recent present, or 0 if nothing was presented to this vk::Swapchain yet. Only used with
+         * VK_KHR_present_id
+         */
+        uint64_t last_present_id = 0;
+
+        /*!
+         * \brief How many images the user asked for. num_swapchain_images is however many Vulkan actually gave us
+         */
+        uint32_t requested_num_images;
+
 #pragma region Initialization
         static vk::SurfaceFormatKHR choose_surface_format(const std::vector<vk::SurfaceFormatKHR>& formats);
 
-        static vk::PresentModeKHR choose_present_mode(const std::vector<vk::PresentModeKHR>& modes);
+        /*!
+         * \brief Picks the present mode closest to the preferred one out of the supported modes. Falls back to FIFO, which every
+         * implementation supports
+         */
+        static vk::PresentModeKHR choose_present_mode(const std::vector<vk::PresentModeKHR>& modes, PresentMode preferred_mode);
 
         static vk::Extent2D choose_surface_extent(const vk::SurfaceCapabilitiesKHR& caps, const glm::ivec2& window_dimensions);
 
@@ -73,12 +117,26 @@ namespace nova::renderer::rhi {
          * \post The swapchain is created
          * \post swapchain_format is set to the swapchain's actual format
          * \post present_mode is set to the swapchain's actual present mode
-         * \post swapchain_extent is set to the swapchain's actual extent
+         * \post swapchain_extent and size are set to the swapchain's actual extent
+         * \post If there was already a swapchain, it's been retired and destroyed
          */
         void create_swapchain(uint32_t requested_num_swapchain_images,
                               const std::vector<vk::PresentModeKHR>& present_modes,
                               const glm::uvec2& window_dimensions);
 
+        /*!
+         * \brief Gets the swapchain images and creates everything we need to render to them
+         *
+         * \pre The swapchain exists
+         */
+        void create_resources_for_swapchain_images();
+
+        /*!
+         * \brief Destroys the views, framebuffers, and fences for the swapchain images, and our wrappers around the images. Doesn't touch
+         * the vk::Swapchain
+         */
+        void destroy_resources_for_swapchain_images();
+
         /*!
          * \brief Gets the images from the swapchain, so we can create framebuffers and whatnot from them
          *
@@ -90,11 +148,11 @@ namespace nova::renderer::rhi {
          * \brief Creates an image view, framebuffer, and fence for a specific swapchain image
          *
          * \param image The swapchain image to create resources for
-         * \param renderpass The renderpass returned by create_dummy_renderpass
+         * \param renderpass The renderpass returned by create_dummy_renderpass, or null if passes use dynamic rendering
          * \param swapchain_size The size of the swapchain
          *
          * \note This method will add to swapchain_image_views, swapchain_images, framebuffers, and fences. Its intended use is to be called
-         * in a loop over all swapchain images, and never called again. It mostly exists to make the constructor cleaner
+         * in a loop over all swapchain images, after destroy_resources_for_swapchain_images has emptied those vectors
          */
         void create_resources_for_frame(vk::Image image, vk::RenderPass renderpass, const glm::uvec2& swapchain_size);
 
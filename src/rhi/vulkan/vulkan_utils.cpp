@@ -1,6 +1,7 @@
 #include "vulkan_utils.hpp"
 
-#include <rx/core/algorithm/max.h>
+#include <algorithm>
+
 #include <rx/core/log.h>
 
 #include "nova_renderer/renderables.hpp"
@@ -38,6 +39,9 @@ namespace nova::renderer::rhi {
             case ResourceState::DepthRead:
                 return VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_STENCIL_READ_ONLY_OPTIMAL;
 
+            case ResourceState::ShadingRateSource:
+                return VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
+
             case ResourceState::PresentSource:
                 return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
@@ -251,12 +255,45 @@ namespace nova::renderer::rhi {
             case PixelFormat::Rgba32F:
                 return VK_FORMAT_R32G32B32A32_SFLOAT;
 
+            case PixelFormat::Rg32F:
+                return VK_FORMAT_R32G32_SFLOAT;
+
+            case PixelFormat::R8Uint:
+                return VK_FORMAT_R8_UINT;
+
+            case PixelFormat::Rg11B10F:
+                return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+
+            case PixelFormat::Rgb10A2:
+                return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+
+            case PixelFormat::Rg16F:
+                return VK_FORMAT_R16G16_SFLOAT;
+
+            case PixelFormat::Rg16Snorm:
+                return VK_FORMAT_R16G16_SNORM;
+
             case PixelFormat::Depth32:
                 return VK_FORMAT_D32_SFLOAT;
 
             case PixelFormat::Depth24Stencil8:
                 return VK_FORMAT_D24_UNORM_S8_UINT;
 
+            case PixelFormat::Bc1:
+                return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+
+            case PixelFormat::Bc3:
+                return VK_FORMAT_BC3_UNORM_BLOCK;
+
+            case PixelFormat::Bc5:
+                return VK_FORMAT_BC5_UNORM_BLOCK;
+
+            case PixelFormat::Bc7:
+                return VK_FORMAT_BC7_UNORM_BLOCK;
+
+            case PixelFormat::Astc4x4:
+                return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+
             default:
                 logger->error("Unknown pixel format, returning RGBA8");
                 return VK_FORMAT_R8G8B8A8_UNORM;
@@ -318,6 +355,12 @@ namespace nova::renderer::rhi {
             case DescriptorType::Sampler:
                 return vk::DescriptorType::eSampler;
 
+            case DescriptorType::StorageImage:
+                return vk::DescriptorType::eStorageImage;
+
+            case DescriptorType::InputAttachment:
+                return vk::DescriptorType::eInputAttachment;
+
             default:
                 return vk::DescriptorType::eUniformBuffer;
         }
@@ -519,6 +562,33 @@ namespace nova::renderer::rhi {
         }
     }
 
+    vk::Extent2D to_vk_fragment_size(const ShadingRate rate) {
+        switch(rate) {
+            case ShadingRate::Rate1x1:
+                return {1, 1};
+
+            case ShadingRate::Rate1x2:
+                return {1, 2};
+
+            case ShadingRate::Rate2x1:
+                return {2, 1};
+
+            case ShadingRate::Rate2x2:
+                return {2, 2};
+
+            case ShadingRate::Rate2x4:
+                return {2, 4};
+
+            case ShadingRate::Rate4x2:
+                return {4, 2};
+
+            case ShadingRate::Rate4x4:
+                return {4, 4};
+        }
+
+        return {1, 1};
+    }
+
     vk::Format to_vk_vertex_format(const VertexFieldFormat field) {
         switch(field) {
             case VertexFieldFormat::Uint:
@@ -531,7 +601,25 @@ namespace nova::renderer::rhi {
                 return VK_FORMAT_R32G32B32_SFLOAT;
 
             case VertexFieldFormat::Float4:
-                return VK_FORMAT_R32G32_SFLOAT;
+                return VK_FORMAT_R32G32B32A32_SFLOAT;
+
+            case VertexFieldFormat::Unorm16x2:
+                return VK_FORMAT_R16G16_UNORM;
+
+            case VertexFieldFormat::Unorm16x4:
+                return VK_FORMAT_R16G16B16A16_UNORM;
+
+            case VertexFieldFormat::Snorm16x2:
+                return VK_FORMAT_R16G16_SNORM;
+
+            case VertexFieldFormat::Snorm16x4:
+                return VK_FORMAT_R16G16B16A16_SNORM;
+
+            case VertexFieldFormat::Half2:
+                return VK_FORMAT_R16G16_SFLOAT;
+
+            case VertexFieldFormat::Half4:
+                return VK_FORMAT_R16G16B16A16_SFLOAT;
 
             default:
                 return VK_FORMAT_R32G32B32_SFLOAT;
@@ -539,54 +627,43 @@ namespace nova::renderer::rhi {
     }
 
     std::vector<vk::DescriptorSetLayout> create_descriptor_set_layouts(
-        const std::unordered_map<std::string, RhiResourceBindingDescription>& all_bindings,
-        VulkanRenderDevice& render_device,
-        rx::memory::allocator& allocator) {
+        const std::unordered_map<std::string, RhiResourceBindingDescription>& all_bindings, VulkanRenderDevice& render_device) {
         const auto max_sets = render_device.gpu.props.limits.maxBoundDescriptorSets;
 
         uint32_t num_sets = 0;
-        all_bindings.each_value([&](const RhiResourceBindingDescription& desc) {
+        for(const auto& [name, desc] : all_bindings) {
             if(desc.set >= max_sets) {
                 logger->error("Descriptor set %u is out of range - your GPU only supports %u sets!", desc.set, max_sets);
             } else {
-                num_sets = rx::algorithm::max(num_sets, desc.set + 1);
+                num_sets = std::max(num_sets, desc.set + 1);
             }
-        });
-
-        std::vector<uint32_t> variable_descriptor_counts{&allocator};
-        variable_descriptor_counts.resize(num_sets, 0);
-
-        // Some precalculations so we know how much room we actually need
-        std::vector<uint32_t> num_bindings_per_set{&allocator};
-        num_bindings_per_set.resize(num_sets);
-
-        all_bindings.each_value([&](const RhiResourceBindingDescription& desc) {
-            num_bindings_per_set[desc.set] = rx::algorithm::max(num_bindings_per_set[desc.set], desc.binding + 1);
-        });
+        }
 
-        std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindings_by_set{&allocator, num_sets};
-        std::vector<std::vector<vk::DescriptorBindingFlags>> binding_flags_by_set{&allocator, num_sets};
+        std::vector<std::vector<vk::DescriptorSetLayoutBinding>> bindings_by_set(num_sets);
+        std::vector<std::vector<vk::DescriptorBindingFlags>> binding_flags_by_set(num_sets);
 
-        all_bindings.each_value([&](const RhiResourceBindingDescription& binding) {
-            if(binding.set >= bindings_by_set.size()) {
-                logger->error("You've skipped one or more descriptor sets! Don't do that, Nova can't handle it");
-                return true;
+        for(const auto& [name, binding] : all_bindings) {
+            if(binding.set >= num_sets) {
+                continue;
             }
 
+            // Layouts only match if their stages do, so a binding is visible to every stage of its kind. That way pipelines which use the
+            // same bindings from different stages still share their layouts, and the descriptor sets made with them
+            const auto stages = binding.stages == ShaderStage::Compute ? vk::ShaderStageFlags{vk::ShaderStageFlagBits::eCompute} :
+                                                                         to_vk_shader_stage_flags(binding.stages) |
+                                                                             vk::ShaderStageFlagBits::eAllGraphics;
+
             const auto descriptor_binding = vk::DescriptorSetLayoutBinding()
                                                 .setBinding(binding.binding)
                                                 .setDescriptorType(to_vk_descriptor_type(binding.type))
                                                 .setDescriptorCount(binding.count)
-                                                .setStageFlags(to_vk_shader_stage_flags(binding.stages));
+                                                .setStageFlags(stages);
 
-            logger->debug("Descriptor %u.%u is type %s", binding.set, binding.binding, descriptor_type_to_string(binding.type));
+            logger->debug("Descriptor %u.%u is type %s", binding.set, binding.binding, descriptor_type_to_string(binding.type).c_str());
 
             if(binding.is_unbounded) {
                 binding_flags_by_set[binding.set].push_back(vk::DescriptorBindingFlagBits::eVariableDescriptorCount |
-                                                                     vk::DescriptorBindingFlagBits::ePartiallyBound);
-
-                // Record the maximum number of descriptors in the variable size array in this set
-                variable_descriptor_counts[binding.set] = binding.count;
+                                                            vk::DescriptorBindingFlagBits::ePartiallyBound);
 
                 logger->debug("Descriptor %u.%u is unbounded", binding.set, binding.binding);
 
@@ -595,39 +672,12 @@ namespace nova::renderer::rhi {
             }
 
             bindings_by_set[binding.set].push_back(descriptor_binding);
+        }
 
-            return true;
-        });
-
-        std::vector<vk::DescriptorSetLayoutCreateInfo> dsl_create_infos{&allocator};
-        dsl_create_infos.reserve(bindings_by_set.size());
-
-        std::vector<vk::DescriptorSetLayoutBindingFlagsCreateInfo> flag_infos{&allocator};
-        flag_infos.reserve(bindings_by_set.size());
-
-        // We may make bindings_by_set much larger than it needs to be is there's multiple descriptor bindings per set. Thus, only iterate
-        // through the sets we actually care about
-        bindings_by_set.each_fwd([&](const std::vector<vk::DescriptorSetLayoutBinding>& bindings) {
-            vk::DescriptorSetLayoutCreateInfo create_info = {};
-            create_info.bindingCount = static_cast<uint32_t>(bindings.size());
-            create_info.pBindings = bindings.data();
-
-            const auto& flags = binding_flags_by_set[dsl_create_infos.size()];
-            vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags = {};
-            binding_flags.bindingCount = static_cast<uint32_t>(flags.size());
-            binding_flags.pBindingFlags = flags.data();
-            flag_infos.emplace_back(binding_flags);
-
-            create_info.pNext = &flag_infos[flag_infos.size() - 1];
-
-            dsl_create_infos.push_back(create_info);
-        });
-
-        std::vector<vk::DescriptorSetLayout> ds_layouts{&allocator};
-        ds_layouts.resize(dsl_create_infos.size());
-        auto vk_allocator = wrap_allocator(allocator);
-        for(size_t i = 0; i < dsl_create_infos.size(); i++) {
-            render_device.device.createDescriptorSetLayout(&dsl_create_infos[i], &vk_allocator, &ds_layouts[i]);
+        std::vector<vk::DescriptorSetLayout> ds_layouts;
+        ds_layouts.reserve(num_sets);
+        for(uint32_t set = 0; set < num_sets; set++) {
+            ds_layouts.push_back(render_device.get_descriptor_set_layout(bindings_by_set[set], binding_flags_by_set[set]));
         }
 
         return ds_layouts;
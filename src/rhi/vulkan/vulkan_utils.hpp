@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
 #include "nova_renderer/renderpack_data.hpp"
 #include "nova_renderer/rhi/command_list.hpp"
 
@@ -18,6 +22,19 @@ namespace nova {
 
 namespace nova::renderer::rhi {
     class VulkanRenderDevice;
+
+    /*!
+     * \brief Stack memory for the temporary arrays that we translate RHI arguments into before calling Vulkan
+     *
+     * These calls happen many times a frame, and on any thread, so the arrays can't come from the frame arena. Arrays that outgrow the
+     * stack memory spill over to the heap
+     */
+    template <size_t Size = 1024>
+    struct VulkanScratchMemory {
+        std::array<std::byte, Size> memory;
+
+        std::pmr::monotonic_buffer_resource resource{memory.data(), memory.size()};
+    };
     vk::ImageLayout to_vk_image_layout(ResourceState layout);
 
     vk::AccessFlags to_vk_access_flags(ResourceAccess access);
@@ -48,6 +65,8 @@ namespace nova::renderer::rhi {
 
     [[nodiscard]] vk::Format to_vk_vertex_format(VertexFieldFormat field);
 
+    [[nodiscard]] vk::Extent2D to_vk_fragment_size(ShadingRate rate);
+
     [[nodiscard]] std::vector<vk::DescriptorSetLayout> create_descriptor_set_layouts(
         const std::unordered_map<std::string, RhiResourceBindingDescription>& all_bindings, VulkanRenderDevice& render_device);
 
@@ -0,0 +1,99 @@
+// Each group rates one tile, sampling it on an 8x8 grid
+//
+// Tiles are 8 to 32 pixels wide, so 64 samples is enough to tell a flat tile from a busy one without reading every pixel
+
+struct ShadingRateParams {
+    uint2 render_size;
+    uint texel_size;
+    uint has_motion_vectors;
+    float contrast_threshold;
+    float motion_threshold;
+    uint2 padding;
+};
+
+[[vk::binding(0, 0)]]
+Texture2D<float4> scene_output : register(t0);
+
+[[vk::binding(1, 0)]]
+Texture2D<float2> motion_vectors : register(t1);
+
+[[vk::binding(2, 0)]]
+StructuredBuffer<ShadingRateParams> params : register(t2);
+
+[[vk::binding(3, 0)]]
+RWTexture2D<uint> shading_rate : register(u0);
+
+groupshared float luminance_sums[64];
+groupshared float luminance_square_sums[64];
+groupshared float sample_counts[64];
+groupshared float motion_maxes[64];
+
+// log2(width) << 2 | log2(height)
+static const uint RATE_1X1 = 0;
+static const uint RATE_2X2 = 5;
+static const uint RATE_4X4 = 10;
+
+[numthreads(8, 8, 1)]
+void main(uint3 group_id : SV_GroupID, uint3 thread_id : SV_GroupThreadID, uint thread_index : SV_GroupIndex) {
+    const ShadingRateParams rate_params = params[0];
+
+    const uint sample_spacing = max(rate_params.texel_size / 8, 1);
+    const uint2 pixel = group_id.xy * rate_params.texel_size + thread_id.xy * sample_spacing + sample_spacing / 2;
+
+    // Pixels that the scene didn't render to don't count
+    float luminance = 0;
+    float motion = 0;
+    float sample_count = 0;
+    if(all(pixel < rate_params.render_size)) {
+        luminance = dot(scene_output.Load(int3(pixel, 0)).rgb, float3(0.2126, 0.7152, 0.0722));
+        sample_count = 1;
+
+        if(rate_params.has_motion_vectors != 0) {
+            motion = length(motion_vectors.Load(int3(pixel, 0)) * float2(rate_params.render_size));
+        }
+    }
+
+    luminance_sums[thread_index] = luminance;
+    luminance_square_sums[thread_index] = luminance * luminance;
+    sample_counts[thread_index] = sample_count;
+    motion_maxes[thread_index] = motion;
+    GroupMemoryBarrierWithGroupSync();
+
+    for(uint stride = 32; stride > 0; stride >>= 1) {
+        if(thread_index < stride) {
+            luminance_sums[thread_index] += luminance_sums[thread_index + stride];
+            luminance_square_sums[thread_index] += luminance_square_sums[thread_index + stride];
+            sample_counts[thread_index] += sample_counts[thread_index + stride];
+            motion_maxes[thread_index] = max(motion_maxes[thread_index], motion_maxes[thread_index + stride]);
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if(thread_index != 0) {
+        return;
+    }
+
+    if(sample_counts[0] == 0) {
+        shading_rate[group_id.xy] = RATE_4X4;
+        return;
+    }
+
+    const float mean = luminance_sums[0] / sample_counts[0];
+    const float variance = max(luminance_square_sums[0] / sample_counts[0] - mean * mean, 0);
+    const float contrast = sqrt(variance) / max(mean, 0.0001);
+
+    uint rate = RATE_1X1;
+    if(contrast < rate_params.contrast_threshold * 0.25) {
+        rate = RATE_4X4;
+    } else if(contrast < rate_params.contrast_threshold) {
+        rate = RATE_2X2;
+    }
+
+    if(motion_maxes[0] >= rate_params.motion_threshold * 3) {
+        rate = RATE_4X4;
+    } else if(motion_maxes[0] >= rate_params.motion_threshold) {
+        rate = max(rate, RATE_2X2);
+    }
+
+    shading_rate[group_id.xy] = rate;
+}
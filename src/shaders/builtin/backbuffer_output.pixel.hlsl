@@ -0,0 +1,35 @@
+[[vk::binding(0, 0)]]
+Texture2D ui_output : register(t0);
+
+[[vk::binding(1, 0)]]
+Texture2D scene_output : register(t1);
+
+[[vk::binding(2, 0)]]
+SamplerState tex_sampler : register(s0);
+
+struct BackbufferOutputParams {
+    float2 scene_uv_scale;
+    float2 max_scene_uv;
+};
+
+[[vk::binding(3, 0)]]
+StructuredBuffer<BackbufferOutputParams> params : register(t2);
+
+struct VsOutput {
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+float3 main(VsOutput input) : SV_Target {
+    float4 ui_color = ui_output.Sample(tex_sampler, input.uv);
+
+    // With dynamic resolution, the scene only fills part of its render target. Stopping half a texel short of the edge of
+    // that part keeps the filter from blending in whatever's past it
+    const BackbufferOutputParams output_params = params[0];
+    float2 scene_uv = min(input.uv * output_params.scene_uv_scale, output_params.max_scene_uv);
+    float4 scene_color = scene_output.Sample(tex_sampler, scene_uv);
+
+    float3 combined_color = lerp(scene_color.rgb, ui_color.rgb, ui_color.a);
+
+    return combined_color;
+}
@@ -0,0 +1,61 @@
+// Blends the four nearest source texels with bilinear weights, each divided by how different its depth is
+//
+// The source doesn't have its own depth, so the full-resolution depth at the middle of each source texel stands in for the depth
+// that texel was rendered at
+
+// How much one unit of depth difference weighs a texel down. Depth is nonlinear and close to one for most of the scene, so small
+// differences have to count for a lot
+#define DEPTH_SHARPNESS 1000.0
+
+[[vk::binding(0, 0)]]
+Texture2D<float4> source : register(t0);
+
+[[vk::binding(1, 0)]]
+Texture2D<float> depth : register(t1);
+
+[[vk::binding(2, 0)]]
+RWTexture2D<float4> destination : register(u0);
+
+float load_depth(float2 uv, uint2 depth_size) {
+    return depth.Load(int3(min(uint2(uv * float2(depth_size)), depth_size - 1), 0));
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    uint2 destination_size;
+    destination.GetDimensions(destination_size.x, destination_size.y);
+    if(any(thread_id.xy >= destination_size)) {
+        return;
+    }
+
+    uint2 source_size;
+    source.GetDimensions(source_size.x, source_size.y);
+
+    uint2 depth_size;
+    depth.GetDimensions(depth_size.x, depth_size.y);
+
+    const float2 uv = (float2(thread_id.xy) + 0.5) / float2(destination_size);
+    const float pixel_depth = load_depth(uv, depth_size);
+
+    const float2 source_pos = uv * float2(source_size) - 0.5;
+    const int2 base_texel = int2(floor(source_pos));
+    const float2 blend = source_pos - float2(base_texel);
+
+    float4 sum = 0;
+    float total_weight = 0;
+
+    [unroll]
+    for(uint i = 0; i < 4; i++) {
+        const int2 offset = int2(i & 1, i >> 1);
+        const int2 texel = clamp(base_texel + offset, 0, int2(source_size) - 1);
+
+        const float texel_depth = load_depth((float2(texel) + 0.5) / float2(source_size), depth_size);
+        const float bilinear = (offset.x == 1 ? blend.x : 1 - blend.x) * (offset.y == 1 ? blend.y : 1 - blend.y);
+        const float weight = bilinear / (1.0 + DEPTH_SHARPNESS * abs(pixel_depth - texel_depth));
+
+        sum += source.Load(int3(texel, 0)) * weight;
+        total_weight += weight;
+    }
+
+    destination[thread_id.xy] = sum / max(total_weight, 1e-6);
+}
@@ -0,0 +1,97 @@
+// Unprojects each pixel with this frame's camera and projects it again with last frame's
+//
+// HLSL doesn't have a matrix inverse, so this has glm's. Both frames' jitter comes back out, so that a camera that's standing still
+// has no motion at all
+
+struct Camera {
+    float4x4 view;
+    float4x4 projection;
+    float4x4 previous_view;
+    float4x4 previous_projection;
+};
+
+struct MotionVectorParams {
+    uint2 render_size;
+    float2 jitter;
+    float2 previous_jitter;
+    uint2 padding;
+};
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<Camera> cameras : register(t0);
+
+[[vk::binding(1, 0)]]
+Texture2D<float> depth : register(t1);
+
+[[vk::binding(2, 0)]]
+StructuredBuffer<MotionVectorParams> params : register(t2);
+
+[[vk::binding(3, 0)]]
+RWTexture2D<float2> motion_vectors : register(u0);
+
+float4x4 inverse(float4x4 m) {
+    const float coef00 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+    const float coef02 = m[1][2] * m[3][3] - m[3][2] * m[1][3];
+    const float coef03 = m[1][2] * m[2][3] - m[2][2] * m[1][3];
+    const float coef04 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+    const float coef06 = m[1][1] * m[3][3] - m[3][1] * m[1][3];
+    const float coef07 = m[1][1] * m[2][3] - m[2][1] * m[1][3];
+    const float coef08 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+    const float coef10 = m[1][1] * m[3][2] - m[3][1] * m[1][2];
+    const float coef11 = m[1][1] * m[2][2] - m[2][1] * m[1][2];
+    const float coef12 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+    const float coef14 = m[1][0] * m[3][3] - m[3][0] * m[1][3];
+    const float coef15 = m[1][0] * m[2][3] - m[2][0] * m[1][3];
+    const float coef16 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+    const float coef18 = m[1][0] * m[3][2] - m[3][0] * m[1][2];
+    const float coef19 = m[1][0] * m[2][2] - m[2][0] * m[1][2];
+    const float coef20 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+    const float coef22 = m[1][0] * m[3][1] - m[3][0] * m[1][1];
+    const float coef23 = m[1][0] * m[2][1] - m[2][0] * m[1][1];
+
+    const float4 fac0 = float4(coef00, coef00, coef02, coef03);
+    const float4 fac1 = float4(coef04, coef04, coef06, coef07);
+    const float4 fac2 = float4(coef08, coef08, coef10, coef11);
+    const float4 fac3 = float4(coef12, coef12, coef14, coef15);
+    const float4 fac4 = float4(coef16, coef16, coef18, coef19);
+    const float4 fac5 = float4(coef20, coef20, coef22, coef23);
+
+    const float4 vec0 = float4(m[1][0], m[0][0], m[0][0], m[0][0]);
+    const float4 vec1 = float4(m[1][1], m[0][1], m[0][1], m[0][1]);
+    const float4 vec2 = float4(m[1][2], m[0][2], m[0][2], m[0][2]);
+    const float4 vec3 = float4(m[1][3], m[0][3], m[0][3], m[0][3]);
+
+    const float4 sign_a = float4(1, -1, 1, -1);
+    const float4 sign_b = float4(-1, 1, -1, 1);
+    const float4x4 result = float4x4((vec1 * fac0 - vec2 * fac1 + vec3 * fac2) * sign_a,
+                                     (vec0 * fac0 - vec2 * fac3 + vec3 * fac4) * sign_b,
+                                     (vec0 * fac1 - vec1 * fac3 + vec3 * fac5) * sign_a,
+                                     (vec0 * fac2 - vec1 * fac4 + vec2 * fac5) * sign_b);
+
+    const float4 first_column = float4(result[0][0], result[1][0], result[2][0], result[3][0]);
+    const float4 products = m[0] * first_column;
+    return result / ((products.x + products.y) + (products.z + products.w));
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    const MotionVectorParams motion_params = params[0];
+    if(any(thread_id.xy >= motion_params.render_size)) {
+        return;
+    }
+
+    // Passes without views render with camera 0
+    const Camera camera = cameras[0];
+
+    const float2 uv = (float2(thread_id.xy) + 0.5) / float2(motion_params.render_size);
+    const float4 ndc = float4(uv * 2 - 1, depth.Load(int3(thread_id.xy, 0)), 1);
+
+    float4 world_position = mul(inverse(mul(camera.projection, camera.view)), ndc);
+    world_position /= world_position.w;
+
+    const float4 previous_clip = mul(camera.previous_projection, mul(camera.previous_view, world_position));
+    const float2 previous_ndc = previous_clip.xy / previous_clip.w;
+
+    const float2 motion = (previous_ndc - motion_params.previous_jitter) - (ndc.xy - motion_params.jitter);
+    motion_vectors[thread_id.xy] = motion * 0.5;
+}
@@ -0,0 +1,176 @@
+// Reduces depth to every mip of the pyramid
+//
+// A tile is 32x32 texels of the first mip that a group writes, which it reduces to 1x1 five mips later. The first pass over the
+// tiles reads depth and writes mips 0 through 5. The last group then reads mip 5 and writes mips 6 through 11, one tile at a time
+//
+// Every thread's first-mip texels are laid out so that lanes `4n` through `4n + 3` hold a 2x2 block, which lets quad operations do
+// the next mip without going through group shared memory
+
+#define MAX_NUM_MIPS 12
+#define SHARED_MIP 5
+
+[[vk::binding(0, 0)]]
+Texture2D<float> depth : register(t0);
+
+[[vk::binding(1, 0)]]
+RWTexture2D<float2> pyramid[MAX_NUM_MIPS] : register(u0);
+
+// Mip 5 again. The last group reads what every other group wrote to it, so it can't sit in a cache that only one group sees
+[[vk::binding(2, 0)]]
+globallycoherent RWTexture2D<float2> shared_mip : register(u12);
+
+[[vk::binding(3, 0)]]
+globallycoherent RWStructuredBuffer<uint> num_finished_groups : register(u13);
+
+groupshared float2 tile[32][32];
+
+groupshared uint is_last_group;
+
+float2 reduce(float2 a, float2 b) {
+    return float2(min(a.x, b.x), max(a.y, b.y));
+}
+
+float2 load_source(bool from_depth, uint2 texel, uint2 source_size) {
+    // Edge texels count twice, which doesn't change their min or max
+    const uint2 clamped = min(texel, source_size - 1);
+    if(from_depth) {
+        return depth.Load(int3(clamped, 0)).rr;
+    }
+
+    return shared_mip[clamped];
+}
+
+void store_mip(uint mip, uint num_mips, uint2 texel, float2 value) {
+    if(mip >= num_mips) {
+        return;
+    }
+
+    uint2 size;
+    if(mip == SHARED_MIP) {
+        shared_mip.GetDimensions(size.x, size.y);
+        if(all(texel < size)) {
+            shared_mip[texel] = value;
+        }
+
+    } else {
+        pyramid[mip].GetDimensions(size.x, size.y);
+        if(all(texel < size)) {
+            pyramid[mip][texel] = value;
+        }
+    }
+}
+
+void reduce_tile(bool from_depth, uint2 tile_id, uint thread_idx, uint num_mips) {
+    const uint first_mip = from_depth ? 0 : SHARED_MIP + 1;
+
+    uint2 source_size;
+    if(from_depth) {
+        depth.GetDimensions(source_size.x, source_size.y);
+    } else {
+        shared_mip.GetDimensions(source_size.x, source_size.y);
+    }
+
+    [unroll]
+    for(uint i = 0; i < 4; i++) {
+        const uint idx = i * 256 + thread_idx;
+        const uint quad = idx / 4;
+        const uint2 quad_pos = uint2(quad % 16, quad / 16);
+        const uint2 local = quad_pos * 2 + uint2(idx & 1, (idx >> 1) & 1);
+        const uint2 texel = tile_id * 32 + local;
+
+        const uint2 source_texel = texel * 2;
+        const float2 value = reduce(reduce(load_source(from_depth, source_texel, source_size),
+                                           load_source(from_depth, source_texel + uint2(1, 0), source_size)),
+                                    reduce(load_source(from_depth, source_texel + uint2(0, 1), source_size),
+                                           load_source(from_depth, source_texel + uint2(1, 1), source_size)));
+        store_mip(first_mip, num_mips, texel, value);
+
+#ifdef USE_QUAD_OPERATIONS
+        float2 quad_value = reduce(value, QuadReadAcrossX(value));
+        quad_value = reduce(quad_value, QuadReadAcrossY(quad_value));
+        if((idx & 3) == 0) {
+            store_mip(first_mip + 1, num_mips, tile_id * 16 + quad_pos, quad_value);
+            tile[quad_pos.y][quad_pos.x] = quad_value;
+        }
+#else
+        tile[local.y][local.x] = value;
+#endif
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+#ifdef USE_QUAD_OPERATIONS
+    uint mip = first_mip + 2;
+    uint size = 8;
+#else
+    uint mip = first_mip + 1;
+    uint size = 16;
+#endif
+
+    [unroll]
+    for(; size > 0; size /= 2, mip++) {
+        const uint2 local = uint2(thread_idx % size, thread_idx / size);
+        const bool is_active = thread_idx < size * size;
+
+        float2 value = 0;
+        if(is_active) {
+            value = reduce(reduce(tile[local.y * 2][local.x * 2], tile[local.y * 2][local.x * 2 + 1]),
+                           reduce(tile[local.y * 2 + 1][local.x * 2], tile[local.y * 2 + 1][local.x * 2 + 1]));
+        }
+
+        // Everyone has to read the tile before anyone can write to it
+        GroupMemoryBarrierWithGroupSync();
+
+        if(is_active) {
+            tile[local.y][local.x] = value;
+            store_mip(mip, num_mips, tile_id * size + local, value);
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+[numthreads(256, 1, 1)]
+void main(uint3 group_id : SV_GroupID, uint thread_idx : SV_GroupIndex) {
+    uint2 mip_0_size;
+    pyramid[0].GetDimensions(mip_0_size.x, mip_0_size.y);
+    const uint num_mips = min(firstbithigh(max(mip_0_size.x, mip_0_size.y)) + 1, MAX_NUM_MIPS);
+
+    reduce_tile(true, group_id.xy, thread_idx, num_mips);
+    if(num_mips <= SHARED_MIP + 1) {
+        return;
+    }
+
+    // This group's part of mip 5 has to be visible to every group before the counter says it's there
+    DeviceMemoryBarrierWithGroupSync();
+
+    if(thread_idx == 0) {
+        const uint2 num_groups = (mip_0_size + 31) / 32;
+
+        uint num_finished;
+        InterlockedAdd(num_finished_groups[0], 1, num_finished);
+        is_last_group = num_finished == num_groups.x * num_groups.y - 1 ? 1 : 0;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if(is_last_group == 0) {
+        return;
+    }
+
+    uint2 shared_mip_size;
+    shared_mip.GetDimensions(shared_mip_size.x, shared_mip_size.y);
+
+    // Mip 5 is no more than 64x64 for screens up to 4096 pixels across, which is one tile. Bigger screens take a few
+    const uint2 num_tiles = (max(shared_mip_size / 2, 1) + 31) / 32;
+    for(uint tile_y = 0; tile_y < num_tiles.y; tile_y++) {
+        for(uint tile_x = 0; tile_x < num_tiles.x; tile_x++) {
+            reduce_tile(false, uint2(tile_x, tile_y), thread_idx, num_mips);
+        }
+    }
+
+    // Ready for next frame
+    if(thread_idx == 0) {
+        num_finished_groups[0] = 0;
+    }
+}
@@ -0,0 +1,68 @@
+// Packs the draws in each draw range that have any instances at the start of the range, in the same order
+//
+// Each range gets one workgroup, which walks the range 64 draws at a time. The draws only ever move towards the start of their range,
+// and every thread reads its draw before any thread writes, so this works in place
+
+struct DrawRange {
+    uint first_draw;
+    uint num_draws;
+};
+
+struct DrawIndexedIndirectCommand {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<DrawRange> draw_ranges : register(t0);
+
+[[vk::binding(1, 0)]]
+RWStructuredBuffer<DrawIndexedIndirectCommand> draw_commands : register(u0);
+
+[[vk::binding(2, 0)]]
+RWStructuredBuffer<uint> draw_counts : register(u1);
+
+groupshared uint visible_prefix[64];
+
+[numthreads(64, 1, 1)]
+void main(uint3 group_id : SV_GroupID, uint3 thread_id : SV_GroupThreadID) {
+    const DrawRange range = draw_ranges[group_id.x];
+    const uint lane = thread_id.x;
+
+    uint num_visible = 0;
+    for(uint chunk_start = 0; chunk_start < range.num_draws; chunk_start += 64) {
+        const uint draw_idx = chunk_start + lane;
+
+        DrawIndexedIndirectCommand draw = (DrawIndexedIndirectCommand)0;
+        if(draw_idx < range.num_draws) {
+            draw = draw_commands[range.first_draw + draw_idx];
+        }
+        const uint is_visible = draw.instance_count > 0 ? 1 : 0;
+
+        // Inclusive prefix sum of which draws are visible, so each visible draw knows where it goes
+        visible_prefix[lane] = is_visible;
+        GroupMemoryBarrierWithGroupSync();
+
+        for(uint offset = 1; offset < 64; offset *= 2) {
+            const uint addend = lane >= offset ? visible_prefix[lane - offset] : 0;
+            GroupMemoryBarrierWithGroupSync();
+
+            visible_prefix[lane] += addend;
+            GroupMemoryBarrierWithGroupSync();
+        }
+
+        if(is_visible != 0) {
+            draw_commands[range.first_draw + num_visible + visible_prefix[lane] - 1] = draw;
+        }
+
+        num_visible += visible_prefix[63];
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if(lane == 0) {
+        draw_counts[group_id.x] = num_visible;
+    }
+}
@@ -0,0 +1,93 @@
+struct CullingInput {
+    float4 model_rows[3];
+    float4 bounding_sphere;
+    float4 normal_cone;
+    uint draw_command_idx;
+    uint3 padding;
+};
+
+struct CullingParams {
+    float4 frustum_planes[6];
+    float4 camera_position;
+    uint num_renderables;
+    uint frustum_culling_enabled;
+    uint cone_culling_enabled;
+    uint padding;
+};
+
+struct DrawIndexedIndirectCommand {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<CullingParams> params : register(t0);
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<CullingInput> renderables : register(t1);
+
+[[vk::binding(2, 0)]]
+RWStructuredBuffer<DrawIndexedIndirectCommand> draw_commands : register(u0);
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<float4x4> visible_model_matrices : register(u1);
+
+bool is_sphere_in_frustum(CullingParams culling_params, float3 center, float radius) {
+    for(uint i = 0; i < 6; i++) {
+        const float4 plane = culling_params.frustum_planes[i];
+        if(dot(plane.xyz, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// True if every triangle whose normal is in the cone faces away from the camera, even if it's anywhere in the bounding sphere
+bool is_cone_backfacing(CullingParams culling_params, float3 center, float radius, float3 cone_axis, float cone_cutoff) {
+    const float3 to_center = center - culling_params.camera_position.xyz;
+    return dot(to_center, cone_axis) >= cone_cutoff * length(to_center) + radius;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    const CullingParams culling_params = params[0];
+    if(thread_id.x >= culling_params.num_renderables) {
+        return;
+    }
+
+    const CullingInput renderable = renderables[thread_id.x];
+    const float4x4 model = float4x4(renderable.model_rows[0], renderable.model_rows[1], renderable.model_rows[2], float4(0, 0, 0, 1));
+
+    // A negative radius means the mesh has no bounds, so we can't cull it
+    if(culling_params.frustum_culling_enabled != 0 && renderable.bounding_sphere.w >= 0) {
+        const float3 center = mul(model, float4(renderable.bounding_sphere.xyz, 1)).xyz;
+
+        // Scale the radius by the largest axis scale, so non-uniformly scaled meshes stay inside their sphere
+        const float max_scale = sqrt(max(max(dot(model._m00_m10_m20, model._m00_m10_m20),
+                                             dot(model._m01_m11_m21, model._m01_m11_m21)),
+                                         dot(model._m02_m12_m22, model._m02_m12_m22)));
+
+        const float radius = renderable.bounding_sphere.w * max_scale;
+
+        if(!is_sphere_in_frustum(culling_params, center, radius)) {
+            return;
+        }
+
+        // A cutoff of 1 means the normals are too spread out for the whole cone to ever face away
+        if(culling_params.cone_culling_enabled != 0 && renderable.normal_cone.w < 1) {
+            const float3 cone_axis = normalize(mul((float3x3)model, renderable.normal_cone.xyz));
+            if(is_cone_backfacing(culling_params, center, radius, cone_axis, renderable.normal_cone.w)) {
+                return;
+            }
+        }
+    }
+
+    uint instance_idx;
+    InterlockedAdd(draw_commands[renderable.draw_command_idx].instance_count, 1, instance_idx);
+
+    visible_model_matrices[draw_commands[renderable.draw_command_idx].first_instance + instance_idx] = model;
+}
@@ -0,0 +1,118 @@
+struct Light {
+    float4 position_and_radius;
+    float4 color_and_intensity;
+};
+
+struct LightClusterParams {
+    float4x4 view;
+    float4x4 inverse_projection;
+    uint4 grid_size;
+    float near_plane;
+    float far_plane;
+    float slices_per_log_depth;
+    uint max_light_indices;
+};
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<LightClusterParams> params : register(t0);
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<Light> lights : register(t1);
+
+[[vk::binding(2, 0)]]
+RWStructuredBuffer<uint2> light_clusters : register(u0);
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<uint> light_indices : register(u1);
+
+// View-space position in xyz, radius in w
+groupshared float4 group_lights[64];
+
+// Every thread of the group has to call this, since it waits for the whole group
+uint load_lights(LightClusterParams cluster_params, uint first_light, uint local_idx) {
+    GroupMemoryBarrierWithGroupSync();
+
+    const uint light_idx = first_light + local_idx;
+    if(light_idx < cluster_params.grid_size.w) {
+        const float4 light = lights[light_idx].position_and_radius;
+        group_lights[local_idx] = float4(mul(cluster_params.view, float4(light.xyz, 1)).xyz, light.w);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    return min(64, cluster_params.grid_size.w - first_light);
+}
+
+bool touches_cluster(float4 light, float3 cluster_min, float3 cluster_max) {
+    const float3 offset = light.xyz - clamp(light.xyz, cluster_min, cluster_max);
+    return dot(offset, offset) <= light.w * light.w;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID, uint local_idx : SV_GroupIndex) {
+    const LightClusterParams cluster_params = params[0];
+    const uint3 grid_size = cluster_params.grid_size.xyz;
+    const uint num_lights = cluster_params.grid_size.w;
+
+    // Threads past the last cluster still have to help load the lights
+    const uint cluster_idx = thread_id.x;
+    const bool is_cluster = cluster_idx < grid_size.x * grid_size.y * grid_size.z;
+    const uint3 cluster = uint3(cluster_idx % grid_size.x,
+                                (cluster_idx / grid_size.x) % grid_size.y,
+                                cluster_idx / (grid_size.x * grid_size.y));
+
+    // Tiles are spaced evenly on the screen, and slices are spaced evenly in log depth, so far away slices are thicker
+    const float2 ndc_min = float2(cluster.xy) / float2(grid_size.xy) * 2 - 1;
+    const float2 ndc_max = float2(cluster.xy + 1) / float2(grid_size.xy) * 2 - 1;
+    const float slice_depths[2] = {cluster_params.near_plane * exp(cluster.z / cluster_params.slices_per_log_depth),
+                                   cluster_params.near_plane * exp((cluster.z + 1) / cluster_params.slices_per_log_depth)};
+
+    float3 cluster_min = float3(1e30, 1e30, 1e30);
+    float3 cluster_max = float3(-1e30, -1e30, -1e30);
+    for(uint corner = 0; corner < 4; corner++) {
+        const float2 ndc = float2((corner & 1) != 0 ? ndc_max.x : ndc_min.x, (corner & 2) != 0 ? ndc_max.y : ndc_min.y);
+        const float4 unprojected = mul(cluster_params.inverse_projection, float4(ndc, 0, 1));
+        const float3 ray = unprojected.xyz / unprojected.w;
+
+        for(uint i = 0; i < 2; i++) {
+            const float3 corner_position = ray * (slice_depths[i] / -ray.z);
+            cluster_min = min(cluster_min, corner_position);
+            cluster_max = max(cluster_max, corner_position);
+        }
+    }
+
+    // Count the cluster's lights first, so all of its indices fit in one tightly packed run
+    uint cluster_num_lights = 0;
+    for(uint first_light = 0; first_light < num_lights; first_light += 64) {
+        const uint num_loaded = load_lights(cluster_params, first_light, local_idx);
+        for(uint i = 0; i < num_loaded; i++) {
+            if(touches_cluster(group_lights[i], cluster_min, cluster_max)) {
+                cluster_num_lights++;
+            }
+        }
+    }
+
+    uint first_index = 0;
+    if(is_cluster && cluster_num_lights > 0) {
+        InterlockedAdd(light_indices[0], cluster_num_lights, first_index);
+
+        const uint space_left = first_index < cluster_params.max_light_indices ? cluster_params.max_light_indices - first_index : 0;
+        cluster_num_lights = min(cluster_num_lights, space_left);
+    }
+
+    // Element 0 is the count, so the indices start at 1
+    uint num_written = 0;
+    for(uint first_light = 0; first_light < num_lights; first_light += 64) {
+        const uint num_loaded = load_lights(cluster_params, first_light, local_idx);
+        for(uint i = 0; i < num_loaded; i++) {
+            if(num_written < cluster_num_lights && touches_cluster(group_lights[i], cluster_min, cluster_max)) {
+                light_indices[1 + first_index + num_written] = first_light + i;
+                num_written++;
+            }
+        }
+    }
+
+    if(is_cluster) {
+        light_clusters[cluster_idx] = uint2(1 + first_index, cluster_num_lights);
+    }
+}
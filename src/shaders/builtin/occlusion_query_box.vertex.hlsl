@@ -0,0 +1,26 @@
+struct Camera {
+    float4x4 view;
+    float4x4 projection;
+    float4x4 previous_view;
+    float4x4 previous_projection;
+};
+
+[[vk::push_constant]]
+struct StandardPushConstants {
+    uint camera_index;
+    uint material_index;
+    uint instance_base;
+    uint transform_index;
+} constants;
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<Camera> cameras : register(t0);
+
+struct VsInput {
+    float3 position : POSITION;
+};
+
+float4 main(VsInput input) : SV_POSITION {
+    const Camera camera = cameras[constants.camera_index];
+    return mul(camera.projection, mul(camera.view, float4(input.position, 1)));
+}
@@ -0,0 +1,38 @@
+// Averages the weighted colors and blends them over the destination
+//
+// Render targets always clear to zero, so the coverage texture holds how much of the background is covered instead of how much is
+// left
+
+[[vk::binding(0, 0)]]
+Texture2D<float4> accumulation : register(t0);
+
+[[vk::binding(1, 0)]]
+Texture2D<float4> coverage : register(t1);
+
+[[vk::binding(2, 0)]]
+RWTexture2D<float4> destination : register(u0);
+
+[numthreads(8, 8, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    uint2 destination_size;
+    destination.GetDimensions(destination_size.x, destination_size.y);
+    if(any(thread_id.xy >= destination_size)) {
+        return;
+    }
+
+    const float covered = coverage.Load(int3(thread_id.xy, 0)).r;
+    if(covered <= 0) {
+        return;
+    }
+
+    const float4 sum = accumulation.Load(int3(thread_id.xy, 0));
+
+    // Half floats overflow when a lot of bright surfaces pile up
+    float3 average = sum.rgb / max(sum.a, 1e-5);
+    if(any(isinf(sum.rgb))) {
+        average = sum.aaa;
+    }
+
+    const float4 background = destination[thread_id.xy];
+    destination[thread_id.xy] = float4(lerp(background.rgb, average, saturate(covered)), background.a);
+}
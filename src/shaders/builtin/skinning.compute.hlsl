@@ -0,0 +1,79 @@
+// Skins one vertex of one renderable per thread. Each row of groups is one renderable
+//
+// The vertices are read and written as raw dwords, so their layout is exactly `FullVertex` no matter how the shader compiler would
+// pad a struct with float3s in it. Normals and tangents are moved by the bones without their translation, which is only right for
+// bones without non-uniform scale
+
+struct SkinningJob {
+    uint first_source_vertex;
+    uint first_output_vertex;
+    uint num_vertices;
+    uint first_bone;
+};
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<SkinningJob> jobs : register(t0);
+
+// Three rows per bone
+[[vk::binding(1, 0)]]
+StructuredBuffer<float4> bones : register(t1);
+
+[[vk::binding(2, 0)]]
+ByteAddressBuffer source_vertices : register(t2);
+
+// Four bone indices, then four weights, eight bits each
+[[vk::binding(3, 0)]]
+StructuredBuffer<uint2> skin_weights : register(t3);
+
+[[vk::binding(4, 0)]]
+RWByteAddressBuffer output_vertices : register(u0);
+
+#define VERTEX_SIZE 64
+
+float3x4 get_bone(uint bone_idx) {
+    return float3x4(bones[bone_idx * 3], bones[bone_idx * 3 + 1], bones[bone_idx * 3 + 2]);
+}
+
+float3 safe_normalize(float3 v) {
+    const float length_squared = dot(v, v);
+    return length_squared > 0 ? v * rsqrt(length_squared) : v;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    const SkinningJob job = jobs[thread_id.y];
+    if(thread_id.x >= job.num_vertices) {
+        return;
+    }
+
+    const uint source_vertex = job.first_source_vertex + thread_id.x;
+    const uint2 packed_weights = skin_weights[source_vertex];
+    const uint4 bone_indices = (packed_weights.xxxx >> uint4(0, 8, 16, 24)) & 0xFF;
+    const float4 weights = float4((packed_weights.yyyy >> uint4(0, 8, 16, 24)) & 0xFF) / 255.0;
+
+    const float3x4 skin = get_bone(job.first_bone + bone_indices.x) * weights.x +
+                          get_bone(job.first_bone + bone_indices.y) * weights.y +
+                          get_bone(job.first_bone + bone_indices.z) * weights.z +
+                          get_bone(job.first_bone + bone_indices.w) * weights.w;
+
+    // Position, then normal, then tangent, then everything that skinning doesn't touch
+    const uint source_address = source_vertex * VERTEX_SIZE;
+    const uint4 words0 = source_vertices.Load4(source_address);
+    const uint4 words1 = source_vertices.Load4(source_address + 16);
+    const uint4 words2 = source_vertices.Load4(source_address + 32);
+    const uint4 words3 = source_vertices.Load4(source_address + 48);
+
+    const float3 position = asfloat(words0.xyz);
+    const float3 normal = asfloat(uint3(words0.w, words1.xy));
+    const float3 tangent = asfloat(uint3(words1.zw, words2.x));
+
+    const float3 skinned_position = mul(skin, float4(position, 1));
+    const float3 skinned_normal = safe_normalize(mul(skin, float4(normal, 0)));
+    const float3 skinned_tangent = safe_normalize(mul(skin, float4(tangent, 0)));
+
+    const uint output_address = (job.first_output_vertex + thread_id.x) * VERTEX_SIZE;
+    output_vertices.Store4(output_address, uint4(asuint(skinned_position), asuint(skinned_normal.x)));
+    output_vertices.Store4(output_address + 16, uint4(asuint(skinned_normal.yz), asuint(skinned_tangent.xy)));
+    output_vertices.Store4(output_address + 32, uint4(asuint(skinned_tangent.z), words2.yzw));
+    output_vertices.Store4(output_address + 48, words3);
+}
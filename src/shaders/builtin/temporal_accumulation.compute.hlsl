@@ -0,0 +1,79 @@
+struct UpscaleParams {
+    uint2 render_size;
+    uint2 output_size;
+    float2 jitter;
+    uint reset_history;
+    uint padding;
+};
+
+[[vk::binding(0, 0)]]
+Texture2D<float4> color : register(t0);
+
+[[vk::binding(1, 0)]]
+Texture2D<float2> motion_vectors : register(t1);
+
+[[vk::binding(2, 0)]]
+Texture2D<float4> history : register(t2);
+
+[[vk::binding(3, 0)]]
+SamplerState history_sampler : register(s0);
+
+[[vk::binding(4, 0)]]
+StructuredBuffer<UpscaleParams> params : register(t3);
+
+[[vk::binding(5, 0)]]
+RWTexture2D<float4> output : register(u0);
+
+[[vk::binding(6, 0)]]
+RWTexture2D<float4> history_output : register(u1);
+
+// How much of the new sample goes into a pixel that it landed right in the middle of, and into one that it barely touched
+#define MAX_BLEND 0.2
+#define MIN_BLEND 0.04
+
+[numthreads(8, 8, 1)]
+void main(uint3 thread_id : SV_DispatchThreadID) {
+    const UpscaleParams upscale_params = params[0];
+    if(any(thread_id.xy >= upscale_params.output_size)) {
+        return;
+    }
+
+    const float2 uv = (float2(thread_id.xy) + 0.5) / float2(upscale_params.output_size);
+
+    // With the projection jittered, render pixel i saw the scene at i + 0.5 - jitter. Find the one that saw closest to this pixel
+    const float2 render_pos = uv * float2(upscale_params.render_size);
+    const int2 max_texel = int2(upscale_params.render_size) - 1;
+    const int2 nearest_texel = clamp(int2(floor(render_pos + upscale_params.jitter)), 0, max_texel);
+    const float2 sample_offset = float2(nearest_texel) + 0.5 - upscale_params.jitter - render_pos;
+
+    const float4 current = color.Load(int3(nearest_texel, 0));
+
+    // The colors around the new sample bound what the history can be, so anything that's stopped being visible gets thrown out
+    float4 neighborhood_min = current;
+    float4 neighborhood_max = current;
+
+    [unroll]
+    for(int y = -1; y <= 1; y++) {
+        [unroll]
+        for(int x = -1; x <= 1; x++) {
+            const float4 neighbor = color.Load(int3(clamp(nearest_texel + int2(x, y), 0, max_texel), 0));
+            neighborhood_min = min(neighborhood_min, neighbor);
+            neighborhood_max = max(neighborhood_max, neighbor);
+        }
+    }
+
+    const float2 history_uv = uv + motion_vectors.Load(int3(nearest_texel, 0));
+    const bool has_history = upscale_params.reset_history == 0 && all(history_uv >= 0) && all(history_uv <= 1);
+
+    float4 result = current;
+    if(has_history) {
+        const float4 previous = clamp(history.SampleLevel(history_sampler, history_uv, 0), neighborhood_min, neighborhood_max);
+
+        // A sample covers about one render pixel, so it's worth less the further it landed from this pixel
+        const float sample_weight = saturate(1 - length(sample_offset) * 1.4);
+        result = lerp(previous, current, lerp(MIN_BLEND, MAX_BLEND, sample_weight));
+    }
+
+    output[thread_id.xy] = result;
+    history_output[thread_id.xy] = result;
+}
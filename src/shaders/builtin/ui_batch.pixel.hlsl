@@ -0,0 +1,37 @@
+[[vk::binding(0, 0)]]
+Texture2D textures[16] : register(t0);
+
+[[vk::binding(1, 0)]]
+SamplerState tex_sampler : register(s0);
+
+struct VsOutput {
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+    float4 shape : TEXCOORD1;
+    float2 corner : TEXCOORD2;
+    float4 color : COLOR;
+    nointerpolation uint texture_id : TEXTURE_ID;
+};
+
+float4 main(VsOutput input) : SV_Target {
+    float4 color = textures[NonUniformResourceIndex(input.texture_id)].Sample(tex_sampler, input.uv) * input.color;
+
+    // Rounded rects cut their corners off with a signed distance to the rect, which antialiases the edge over about a pixel
+    const float radius = input.corner.x;
+    if(radius >= 0) {
+        const float2 half_size = input.shape.zw;
+        const float2 corner_distance = abs(input.shape.xy) - half_size + radius;
+        const float distance = length(max(corner_distance, 0)) + min(max(corner_distance.x, corner_distance.y), 0) - radius;
+
+        float coverage = saturate(0.5 - distance);
+
+        const float border_width = input.corner.y;
+        if(border_width > 0) {
+            coverage *= saturate(0.5 + distance + border_width);
+        }
+
+        color.a *= coverage;
+    }
+
+    return color;
+}
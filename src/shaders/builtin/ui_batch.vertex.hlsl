@@ -0,0 +1,38 @@
+struct UiParams {
+    float2 inverse_screen_size;
+};
+
+[[vk::binding(2, 0)]]
+StructuredBuffer<UiParams> params : register(t16);
+
+struct VsInput {
+    float2 position : POSITION;
+    float2 uv : TEXCOORD0;
+    float4 shape : TEXCOORD1;
+    float2 corner : TEXCOORD2;
+    uint color : COLOR;
+    uint texture_id : TEXTURE_ID;
+};
+
+struct VsOutput {
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+    float4 shape : TEXCOORD1;
+    float2 corner : TEXCOORD2;
+    float4 color : COLOR;
+    nointerpolation uint texture_id : TEXTURE_ID;
+};
+
+VsOutput main(VsInput input) {
+    VsOutput output;
+
+    // Pixels from the top-left corner, and Vulkan's clip space has Y going down too
+    output.position = float4(input.position * params[0].inverse_screen_size * 2.0 - 1.0, 0, 1);
+    output.uv = input.uv;
+    output.shape = input.shape;
+    output.corner = input.corner;
+    output.color = float4(input.color & 0xFF, (input.color >> 8) & 0xFF, (input.color >> 16) & 0xFF, input.color >> 24) / 255.0;
+    output.texture_id = input.texture_id;
+
+    return output;
+}
@@ -0,0 +1,84 @@
+#include "offset_allocator.hpp"
+
+#include <iterator>
+
+namespace nova::mem {
+    OffsetAllocator::OffsetAllocator(const uint64_t size) : size{size}, num_free_bytes{size} {
+        if(size > 0) {
+            free_blocks.emplace(0, size);
+        }
+    }
+
+    std::optional<uint64_t> OffsetAllocator::allocate(const uint64_t size, const uint64_t alignment) {
+        if(size == 0 || size > num_free_bytes) {
+            return std::nullopt;
+        }
+
+        for(auto block_itr = free_blocks.begin(); block_itr != free_blocks.end(); ++block_itr) {
+            const auto [block_offset, block_size] = *block_itr;
+            const auto block_end = block_offset + block_size;
+
+            const auto remainder = alignment > 1 ? block_offset % alignment : 0;
+            const auto aligned_offset = remainder == 0 ? block_offset : block_offset + alignment - remainder;
+            if(aligned_offset + size > block_end) {
+                continue;
+            }
+
+            free_blocks.erase(block_itr);
+
+            // Whatever the alignment skipped over stays free, as does anything after the allocation
+            if(aligned_offset > block_offset) {
+                free_blocks.emplace(block_offset, aligned_offset - block_offset);
+            }
+
+            if(aligned_offset + size < block_end) {
+                free_blocks.emplace(aligned_offset + size, block_end - (aligned_offset + size));
+            }
+
+            num_free_bytes -= size;
+
+            return aligned_offset;
+        }
+
+        return std::nullopt;
+    }
+
+    void OffsetAllocator::free(uint64_t offset, uint64_t size) {
+        num_free_bytes += size;
+
+        auto next_itr = free_blocks.lower_bound(offset);
+
+        // Merge with the block right after this one...
+        if(next_itr != free_blocks.end() && next_itr->first == offset + size) {
+            size += next_itr->second;
+            next_itr = free_blocks.erase(next_itr);
+        }
+
+        // ...and the block right before it
+        if(next_itr != free_blocks.begin()) {
+            const auto prev_itr = std::prev(next_itr);
+            if(prev_itr->first + prev_itr->second == offset) {
+                prev_itr->second += size;
+                return;
+            }
+        }
+
+        free_blocks.emplace_hint(next_itr, offset, size);
+    }
+
+    void OffsetAllocator::grow(const uint64_t new_size) {
+        if(new_size <= size) {
+            return;
+        }
+
+        const auto old_size = size;
+        size = new_size;
+
+        // Freeing the new space merges it with any free block at the old end
+        free(old_size, new_size - old_size);
+    }
+
+    uint64_t OffsetAllocator::get_size() const { return size; }
+
+    uint64_t OffsetAllocator::get_num_free_bytes() const { return num_free_bytes; }
+} // namespace nova::mem
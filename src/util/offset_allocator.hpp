@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+
+namespace nova::mem {
+    /*!
+     * \brief Hands out ranges of some fixed-size space, such as a big GPU buffer. It never touches the space itself, it only keeps track
+     * of which parts of it are free
+     *
+     * Free space is kept in a list of blocks sorted by offset. Allocations take the first block that they fit in, and freed ranges are
+     * merged with their neighbors so the space doesn't fragment into unusably small pieces
+     *
+     * This class is not thread-safe
+     */
+    class OffsetAllocator {
+    public:
+        explicit OffsetAllocator(uint64_t size);
+
+        /*!
+         * \brief Finds space for `size` bytes
+         *
+         * \param size The number of bytes to allocate
+         * \param alignment The returned offset will be a multiple of this. It doesn't have to be a power of two
+         *
+         * \return The offset of the new allocation, or nullopt if there's no free block large enough
+         */
+        [[nodiscard]] std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment = 1);
+
+        /*!
+         * \brief Returns a range to the allocator
+         *
+         * `offset` and `size` must be exactly what was allocated
+         */
+        void free(uint64_t offset, uint64_t size);
+
+        /*!
+         * \brief Adds space to the end of the range that this allocator manages. Existing allocations keep their offsets
+         *
+         * Does nothing if `new_size` isn't larger than the current size
+         */
+        void grow(uint64_t new_size);
+
+        [[nodiscard]] uint64_t get_size() const;
+
+        [[nodiscard]] uint64_t get_num_free_bytes() const;
+
+    private:
+        uint64_t size;
+
+        uint64_t num_free_bytes;
+
+        /*!
+         * \brief Map from the offset of each free block to its size
+         */
+        std::map<uint64_t, uint64_t> free_blocks;
+    };
+} // namespace nova::mem
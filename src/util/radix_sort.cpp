@@ -0,0 +1,55 @@
+#include "radix_sort.hpp"
+
+#include <array>
+#include <utility>
+
+namespace nova {
+    static constexpr uint32_t NUM_DIGITS = sizeof(uint64_t);
+    static constexpr uint32_t NUM_BUCKETS = 256;
+
+    void radix_sort(std::vector<SortKey>& keys, std::vector<SortKey>& scratch) {
+        if(keys.size() < 2) {
+            return;
+        }
+
+        // One walk over the keys counts every digit, so each sorting pass only has to scatter
+        std::array<std::array<uint32_t, NUM_BUCKETS>, NUM_DIGITS> histograms{};
+        for(const SortKey& key : keys) {
+            for(uint32_t digit = 0; digit < NUM_DIGITS; digit++) {
+                histograms[digit][(key.key >> (digit * 8)) & 0xFF]++;
+            }
+        }
+
+        scratch.resize(keys.size());
+        auto* source = &keys;
+        auto* destination = &scratch;
+
+        for(uint32_t digit = 0; digit < NUM_DIGITS; digit++) {
+            auto& histogram = histograms[digit];
+
+            // If every key has the same digit here, this pass wouldn't move anything
+            const auto first_key_bucket = ((*source)[0].key >> (digit * 8)) & 0xFF;
+            if(histogram[first_key_bucket] == keys.size()) {
+                continue;
+            }
+
+            uint32_t offset = 0;
+            for(uint32_t& bucket : histogram) {
+                const auto count = bucket;
+                bucket = offset;
+                offset += count;
+            }
+
+            for(const SortKey& key : *source) {
+                (*destination)[histogram[(key.key >> (digit * 8)) & 0xFF]++] = key;
+            }
+
+            std::swap(source, destination);
+        }
+
+        // An odd number of passes leaves the sorted keys in the scratch space
+        if(source != &keys) {
+            keys.swap(scratch);
+        }
+    }
+} // namespace nova
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace nova {
+    /*!
+     * \brief A 64-bit sort key and the thing it sorts, usually an index into some other array
+     */
+    struct SortKey {
+        uint64_t key;
+        uint32_t value;
+    };
+
+    /*!
+     * \brief Sorts keys in ascending order. Keys that compare equal keep their relative order
+     *
+     * This is an LSD radix sort over eight 8-bit digits, so it takes linear time no matter how the keys are arranged. Digits that are the
+     * same in every key are skipped, which makes keys that only use a few of their bits cheap to sort
+     *
+     * \param keys The keys to sort
+     * \param scratch Space to sort in. It's resized to match `keys`, so reusing it between calls saves an allocation
+     */
+    void radix_sort(std::vector<SortKey>& keys, std::vector<SortKey>& scratch);
+} // namespace nova
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOVA_SIMD_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define NOVA_SIMD_NEON
+#endif
+
+#if defined(NOVA_SIMD_SSE2) || defined(NOVA_SIMD_NEON)
+#define NOVA_SIMD
+#endif
+
+/*!
+ * \brief A tiny wrapper over four-wide float vectors, so code that works on four things at once can be written once for SSE2 and NEON
+ *
+ * Only defines anything when `NOVA_SIMD` is defined. Code that uses it needs a scalar fallback for when it isn't
+ */
+namespace nova::simd {
+#ifdef NOVA_SIMD
+    struct Float4 {
+#ifdef NOVA_SIMD_SSE2
+        __m128 v;
+#else
+        float32x4_t v;
+#endif
+    };
+
+#ifdef NOVA_SIMD_SSE2
+    inline Float4 splat(const float f) { return {_mm_set1_ps(f)}; }
+    inline Float4 set(const float a, const float b, const float c, const float d) { return {_mm_setr_ps(a, b, c, d)}; }
+    inline Float4 load(const float* src) { return {_mm_loadu_ps(src)}; }
+    inline void store(const Float4 a, float* dst) { _mm_storeu_ps(dst, a.v); }
+
+    inline Float4 operator+(const Float4 a, const Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+    inline Float4 operator-(const Float4 a, const Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+    inline Float4 operator*(const Float4 a, const Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+    inline Float4 operator/(const Float4 a, const Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+    inline Float4 min(const Float4 a, const Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+    inline Float4 max(const Float4 a, const Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+    inline Float4 round(const Float4 a) { return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))}; }
+
+    /*!
+     * \brief All bits set in the lanes where `a < b`, no bits set everywhere else
+     */
+    inline Float4 less_than(const Float4 a, const Float4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    inline Float4 operator|(const Float4 a, const Float4 b) { return {_mm_or_ps(a.v, b.v)}; }
+
+    /*!
+     * \brief Packs a mask from `less_than` into the low four bits of an integer, lane 0 in bit 0
+     */
+    inline uint32_t to_bits(const Float4 mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask.v)); }
+
+    inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); }
+#else
+    inline Float4 splat(const float f) { return {vdupq_n_f32(f)}; }
+    inline Float4 set(const float a, const float b, const float c, const float d) {
+        const float lanes[4] = {a, b, c, d};
+        return {vld1q_f32(lanes)};
+    }
+    inline Float4 load(const float* src) { return {vld1q_f32(src)}; }
+    inline void store(const Float4 a, float* dst) { vst1q_f32(dst, a.v); }
+
+    inline Float4 operator+(const Float4 a, const Float4 b) { return {vaddq_f32(a.v, b.v)}; }
+    inline Float4 operator-(const Float4 a, const Float4 b) { return {vsubq_f32(a.v, b.v)}; }
+    inline Float4 operator*(const Float4 a, const Float4 b) { return {vmulq_f32(a.v, b.v)}; }
+    inline Float4 operator/(const Float4 a, const Float4 b) { return {vdivq_f32(a.v, b.v)}; }
+    inline Float4 min(const Float4 a, const Float4 b) { return {vminq_f32(a.v, b.v)}; }
+    inline Float4 max(const Float4 a, const Float4 b) { return {vmaxq_f32(a.v, b.v)}; }
+    inline Float4 round(const Float4 a) { return {vcvtq_f32_s32(vcvtnq_s32_f32(a.v))}; }
+
+    inline Float4 less_than(const Float4 a, const Float4 b) { return {vreinterpretq_f32_u32(vcltq_f32(a.v, b.v))}; }
+    inline Float4 operator|(const Float4 a, const Float4 b) {
+        return {vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)))};
+    }
+
+    inline uint32_t to_bits(const Float4 mask) {
+        // Keep one bit of each lane, shift it to the lane's position, then add the lanes together
+        const int32_t shifts[4] = {0, 1, 2, 3};
+        const auto bits = vshlq_u32(vshrq_n_u32(vreinterpretq_u32_f32(mask.v), 31), vld1q_s32(shifts));
+        return vaddvq_u32(bits);
+    }
+
+    inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d) {
+        const auto ab = vtrnq_f32(a.v, b.v);
+        const auto cd = vtrnq_f32(c.v, d.v);
+        a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+        b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+        c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+        d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+    }
+#endif
+
+    /*!
+     * \brief Sine of four angles at once
+     *
+     * The angles are wrapped to [-pi, pi], then folded to [-pi/2, pi/2] where sin is symmetric, then run through the Taylor series up to
+     * x^11. That's accurate to about 1e-7, which is as good as a float gets
+     */
+    inline Float4 sin(const Float4 angle) {
+        constexpr float PI = 3.14159265358979f;
+
+        const auto wrapped = angle - round(angle * splat(1.0f / (2.0f * PI))) * splat(2.0f * PI);
+        const auto folded = max(min(wrapped, splat(PI) - wrapped), splat(-PI) - wrapped);
+
+        const auto x2 = folded * folded;
+        auto result = splat(-1.0f / 39916800.0f);
+        result = result * x2 + splat(1.0f / 362880.0f);
+        result = result * x2 + splat(-1.0f / 5040.0f);
+        result = result * x2 + splat(1.0f / 120.0f);
+        result = result * x2 + splat(-1.0f / 6.0f);
+        result = result * x2 + splat(1.0f);
+
+        return result * folded;
+    }
+
+    inline Float4 cos(const Float4 angle) { return sin(angle + splat(3.14159265358979f / 2.0f)); }
+#endif
+} // namespace nova::simd
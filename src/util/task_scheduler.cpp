@@ -0,0 +1,296 @@
+#include "nova_renderer/util/task_scheduler.hpp"
+
+#include <algorithm>
+
+#include <Tracy.hpp>
+#include <spdlog/spdlog.h>
+
+#include "nova_renderer/util/logging.hpp"
+
+namespace nova::renderer {
+    static auto logger = make_logger("TaskScheduler");
+
+    namespace {
+        /*!
+         * \brief The scheduler that the current thread is a worker of, and its index in that scheduler
+         */
+        thread_local const WorkStealingTaskScheduler* current_scheduler = nullptr;
+        thread_local uint32_t current_thread_idx = 0;
+    } // namespace
+
+    uint32_t TaskScheduler::get_num_threads() const { return get_num_worker_threads() + 1; }
+
+    void TaskScheduler::parallel_for(const uint32_t begin,
+                                     const uint32_t end,
+                                     const uint32_t grain_size,
+                                     const std::function<void(uint32_t, uint32_t, uint32_t)>& func) {
+        ZoneScoped;
+        if(begin >= end) {
+            return;
+        }
+
+        const auto grain = std::max(grain_size, 1u);
+        const auto num_ranges = (end - begin + grain - 1) / grain;
+        const auto num_helpers = std::min(num_ranges - 1, get_num_worker_threads());
+        if(num_helpers == 0) {
+            func(get_current_thread_idx(), begin, end);
+            return;
+        }
+
+        // Rather than one task per range, a few helper tasks and this thread all grab ranges until there aren't any left. That way a
+        // range that takes a long time doesn't hold up the ranges after it
+        std::atomic<uint32_t> next_range = 0;
+        std::atomic<uint32_t> num_finished_helpers = 0;
+
+        const auto run_ranges = [&](const uint32_t thread_idx) {
+            for(auto range_idx = next_range.fetch_add(1); range_idx < num_ranges; range_idx = next_range.fetch_add(1)) {
+                const auto range_begin = begin + range_idx * grain;
+                func(thread_idx, range_begin, std::min(range_begin + grain, end));
+            }
+        };
+
+        for(uint32_t i = 0; i < num_helpers; i++) {
+            submit([&](const uint32_t thread_idx) {
+                run_ranges(thread_idx);
+
+                num_finished_helpers.fetch_add(1);
+                num_finished_helpers.notify_one();
+            });
+        }
+
+        run_ranges(get_current_thread_idx());
+
+        // The helpers point at this stack frame, so they all have to finish, even the ones that found no ranges left. Any that haven't
+        // started yet are still in a queue, where this thread can pick them up itself
+        for(auto num_finished = num_finished_helpers.load(); num_finished < num_helpers; num_finished = num_finished_helpers.load()) {
+            if(!run_pending_task()) {
+                num_finished_helpers.wait(num_finished);
+            }
+        }
+    }
+
+    WorkStealingTaskScheduler::WorkStealingTaskScheduler(const uint32_t num_worker_threads) : owner_thread{std::this_thread::get_id()} {
+        queues.reserve(num_worker_threads + 1);
+        for(uint32_t i = 0; i <= num_worker_threads; i++) {
+            queues.emplace_back(std::make_unique<TaskQueue>());
+        }
+
+        workers.reserve(num_worker_threads);
+
+        // Thread index 0 belongs to whoever owns the scheduler, so the workers start at 1
+        for(uint32_t i = 1; i <= num_worker_threads; i++) {
+            workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    WorkStealingTaskScheduler::~WorkStealingTaskScheduler() {
+        {
+            std::lock_guard lock{sleep_mutex};
+            should_stop = true;
+        }
+
+        sleep_cv.notify_all();
+
+        for(std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void WorkStealingTaskScheduler::submit(Task task) {
+        const auto thread_idx = get_current_thread_idx();
+        if(workers.empty()) {
+            task(thread_idx);
+            return;
+        }
+
+        {
+            auto& queue = *queues[thread_idx];
+            std::lock_guard lock{queue.mutex};
+            queue.tasks.push_back(std::move(task));
+        }
+
+        num_queued_tasks.fetch_add(1);
+
+        // Taking the lock makes sure that a worker which just found nothing to do is either asleep or about to see the new task
+        { std::lock_guard lock{sleep_mutex}; }
+        sleep_cv.notify_one();
+    }
+
+    bool WorkStealingTaskScheduler::run_pending_task() {
+        // Other threads would run tasks with thread index 0 while the owner might be using it
+        if(current_scheduler != this && std::this_thread::get_id() != owner_thread) {
+            return false;
+        }
+
+        const auto thread_idx = get_current_thread_idx();
+
+        Task task;
+        if(!pop_task(thread_idx, task)) {
+            return false;
+        }
+
+        ZoneScoped;
+        task(thread_idx);
+
+        return true;
+    }
+
+    uint32_t WorkStealingTaskScheduler::get_num_worker_threads() const { return static_cast<uint32_t>(workers.size()); }
+
+    uint32_t WorkStealingTaskScheduler::get_current_thread_idx() const { return current_scheduler == this ? current_thread_idx : 0; }
+
+    bool WorkStealingTaskScheduler::pop_task(const uint32_t thread_idx, Task& task) {
+        if(num_queued_tasks.load() == 0) {
+            return false;
+        }
+
+        {
+            auto& own_queue = *queues[thread_idx];
+            std::lock_guard lock{own_queue.mutex};
+            if(!own_queue.tasks.empty()) {
+                task = std::move(own_queue.tasks.back());
+                own_queue.tasks.pop_back();
+                num_queued_tasks.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // Start with the next thread over, so thieves don't all pile onto the same queue
+        const auto num_queues = static_cast<uint32_t>(queues.size());
+        for(uint32_t offset = 1; offset < num_queues; offset++) {
+            auto& victim = *queues[(thread_idx + offset) % num_queues];
+            std::lock_guard lock{victim.mutex};
+            if(!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                num_queued_tasks.fetch_sub(1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void WorkStealingTaskScheduler::worker_loop(const uint32_t thread_idx) {
+        current_scheduler = this;
+        current_thread_idx = thread_idx;
+
+        while(true) {
+            Task task;
+            if(pop_task(thread_idx, task)) {
+                ZoneScoped;
+                task(thread_idx);
+                continue;
+            }
+
+            std::unique_lock lock{sleep_mutex};
+            sleep_cv.wait(lock, [&] { return should_stop || num_queued_tasks.load() > 0; });
+
+            // Drain the queues before stopping so nobody is left waiting on a future that will never be fulfilled
+            if(should_stop && num_queued_tasks.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    TaskGraph::NodeId TaskGraph::add_task(TaskScheduler::Task task) {
+        const auto node_id = static_cast<NodeId>(nodes.size());
+        nodes.push_back({std::move(task), {}, 0});
+
+        return node_id;
+    }
+
+    void TaskGraph::add_dependency(const NodeId before, const NodeId after) {
+        nodes[before].successors.push_back(after);
+        nodes[after].num_dependencies++;
+    }
+
+    std::future<void> TaskGraph::run(TaskScheduler& scheduler) const {
+        ZoneScoped;
+        struct RunState {
+            std::vector<Node> nodes;
+
+            std::unique_ptr<std::atomic<uint32_t>[]> num_unfinished_dependencies;
+
+            std::atomic<uint32_t> num_unfinished_nodes;
+
+            std::promise<void> done;
+        };
+
+        auto state = std::make_shared<RunState>();
+        auto future = state->done.get_future();
+
+        if(nodes.empty()) {
+            state->done.set_value();
+            return future;
+        }
+
+        if(has_cycle()) {
+            logger->error("Task graph of {} tasks has a cycle in it, so none of them can start", nodes.size());
+            state->done.set_value();
+            return future;
+        }
+
+        state->nodes = nodes;
+        state->num_unfinished_dependencies = std::make_unique<std::atomic<uint32_t>[]>(nodes.size());
+        state->num_unfinished_nodes = static_cast<uint32_t>(nodes.size());
+        for(size_t i = 0; i < nodes.size(); i++) {
+            state->num_unfinished_dependencies[i] = nodes[i].num_dependencies;
+        }
+
+        // Each node submits the successors that it was the last dependency of. The state lives until the last node finishes
+        const auto submit_node = [&scheduler](const std::shared_ptr<RunState>& run_state, const NodeId node_id, const auto& submit_self)
+            -> void {
+            scheduler.submit([run_state, node_id, submit_self](const uint32_t thread_idx) {
+                const auto& node = run_state->nodes[node_id];
+                node.task(thread_idx);
+
+                for(const NodeId successor : node.successors) {
+                    if(run_state->num_unfinished_dependencies[successor].fetch_sub(1) == 1) {
+                        submit_self(run_state, successor, submit_self);
+                    }
+                }
+
+                if(run_state->num_unfinished_nodes.fetch_sub(1) == 1) {
+                    run_state->done.set_value();
+                }
+            });
+        };
+
+        for(NodeId node_id = 0; node_id < nodes.size(); node_id++) {
+            if(nodes[node_id].num_dependencies == 0) {
+                submit_node(state, node_id, submit_node);
+            }
+        }
+
+        return future;
+    }
+
+    bool TaskGraph::has_cycle() const {
+        // Kahn's algorithm: if peeling off nodes without dependencies doesn't reach every node, the rest depend on each other
+        std::vector<uint32_t> num_dependencies;
+        std::vector<NodeId> ready;
+        num_dependencies.reserve(nodes.size());
+        for(NodeId node_id = 0; node_id < nodes.size(); node_id++) {
+            num_dependencies.push_back(nodes[node_id].num_dependencies);
+            if(nodes[node_id].num_dependencies == 0) {
+                ready.push_back(node_id);
+            }
+        }
+
+        size_t num_visited = 0;
+        while(!ready.empty()) {
+            const auto node_id = ready.back();
+            ready.pop_back();
+            num_visited++;
+
+            for(const NodeId successor : nodes[node_id].successors) {
+                if(--num_dependencies[successor] == 0) {
+                    ready.push_back(successor);
+                }
+            }
+        }
+
+        return num_visited != nodes.size();
+    }
+} // namespace nova::renderer
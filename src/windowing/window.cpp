@@ -19,6 +19,11 @@ RX_LOG("Window", logger);
 void glfw_error_callback(const int error, const char* desc) { logger->error("GLFW error(%u)%s", error, desc); }
 
 namespace nova::renderer {
+    /*!
+     * \brief How many windows initialized GLFW. Terminating GLFW closes every window, so only the last window to close may do it
+     */
+    static uint32_t num_glfw_windows = 0;
+
     void NovaWindow::glfw_key_callback(GLFWwindow* window, const int key, int /* scancode */, const int action, int /* mods */) {
         void* user_data = glfwGetWindowUserPointer(window);
         auto* my_window = static_cast<NovaWindow*>(user_data);
@@ -46,15 +51,24 @@ namespace nova::renderer {
         my_window->broadcast_mouse_button(button, action == GLFW_PRESS);
     }
 
-    NovaWindow::NovaWindow(const NovaSettings& options) {
+    NovaWindow::NovaWindow(const NovaSettings& options) : headless_size{options.window.width, options.window.height} {
+        if(options.null_device.enabled) {
+            // The null device never presents anything, so there's no reason to need a display
+            logger->info("Running headless for the null render device");
+            return;
+        }
+
         if(!glfwInit()) {
             logger->error("Failed to init GLFW");
             return;
         }
+        glfw_initialized = true;
+        num_glfw_windows++;
 
         glfwSetErrorCallback(glfw_error_callback);
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_VISIBLE, options.window.visible ? GLFW_TRUE : GLFW_FALSE);
 
         window = glfwCreateWindow(static_cast<int>(options.window.width),
                                   static_cast<int>(options.window.height),
@@ -73,8 +87,12 @@ namespace nova::renderer {
     }
 
     NovaWindow::~NovaWindow() {
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if(window != nullptr) {
+            glfwDestroyWindow(window);
+        }
+        if(glfw_initialized && --num_glfw_windows == 0) {
+            glfwTerminate();
+        }
     }
 
     void NovaWindow::register_key_callback(std::function<void(uint32_t, bool, bool, bool)> key_callback) {
@@ -105,11 +123,19 @@ namespace nova::renderer {
 
     // This _can_ be static, but I don't want it to be
     // ReSharper disable once CppMemberFunctionMayBeStatic
-    void NovaWindow::poll_input() const { glfwPollEvents(); }
+    void NovaWindow::poll_input() const {
+        if(glfw_initialized) {
+            glfwPollEvents();
+        }
+    }
 
-    bool NovaWindow::should_close() const { return glfwWindowShouldClose(window); }
+    bool NovaWindow::should_close() const { return window != nullptr && glfwWindowShouldClose(window); }
 
     glm::uvec2 NovaWindow::get_framebuffer_size() const {
+        if(window == nullptr) {
+            return headless_size;
+        }
+
         int width;
         int height;
         glfwGetFramebufferSize(window, &width, &height);
@@ -118,6 +144,10 @@ namespace nova::renderer {
     }
 
     glm::uvec2 NovaWindow::get_window_size() const {
+        if(window == nullptr) {
+            return headless_size;
+        }
+
         int width;
         int height;
         glfwGetWindowSize(window, &width, &height);
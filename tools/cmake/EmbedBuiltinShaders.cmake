@@ -0,0 +1,114 @@
+# Embeds Nova's builtin shaders into the library
+#
+# Every listed shader in src/shaders/builtin has its source embedded. When NOVA_PRECOMPILE_BUILTIN_SHADERS is on and DXC is around, each
+# variant is also compiled to SPIR-V during the build, so the renderer never has to start DXC for its own shaders. A variant is a file
+# name, optionally followed by a colon and comma-separated defines, like `depth_pyramid.compute.hlsl:USE_QUAD_OPERATIONS`
+
+set(NOVA_EMBED_SHADERS_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/GenerateBuiltinShaderData.cmake")
+
+if(NOVA_PRECOMPILE_BUILTIN_SHADERS)
+    find_program(NOVA_DXC_PROGRAM NAMES dxc HINTS "$ENV{VULKAN_SDK}/Bin" "$ENV{VULKAN_SDK}/bin")
+    if(NOVA_DXC_PROGRAM)
+        message(STATUS "Found DXC at ${NOVA_DXC_PROGRAM}, builtin shaders will be compiled at build time")
+    else()
+        message(STATUS "DXC not found, builtin shaders will be compiled the first time they're used")
+    endif()
+endif()
+
+# The arguments have to match the ones in `compile_shader`, and the profiles the ones in `to_hlsl_profile`
+function(nova_get_hlsl_profile SHADER_NAME OUTPUT_VARIABLE)
+    string(REGEX MATCH "\\.([a-z_]+)\\.hlsl$" STAGE_MATCH "${SHADER_NAME}")
+    set(STAGE "${CMAKE_MATCH_1}")
+    if(STAGE STREQUAL "vertex")
+        set(PROFILE "vs_6_4")
+    elseif(STAGE STREQUAL "tessellation_control")
+        set(PROFILE "hs_6_4")
+    elseif(STAGE STREQUAL "tessellation_evaluation")
+        set(PROFILE "ds_6_4")
+    elseif(STAGE STREQUAL "geometry")
+        set(PROFILE "gs_6_4")
+    elseif(STAGE STREQUAL "pixel")
+        set(PROFILE "ps_6_4")
+    elseif(STAGE STREQUAL "compute")
+        set(PROFILE "cs_6_4")
+    elseif(STAGE STREQUAL "task")
+        set(PROFILE "as_6_4")
+    elseif(STAGE STREQUAL "mesh")
+        set(PROFILE "ms_6_4")
+    else()
+        message(FATAL_ERROR "Builtin shader ${SHADER_NAME} should be named <name>.<stage>.hlsl")
+    endif()
+
+    set(${OUTPUT_VARIABLE} "${PROFILE}" PARENT_SCOPE)
+endfunction()
+
+# Sets OUTPUT_VARIABLE to the generated source file that defines `EMBEDDED_SHADERS`. Add it to the library's sources
+function(nova_embed_builtin_shaders OUTPUT_VARIABLE SHADER_DIR HEADER_FILE)
+    set(OUTPUT_DIR "${CMAKE_CURRENT_BINARY_DIR}/builtin_shaders")
+    set(GENERATED_SOURCE "${OUTPUT_DIR}/builtin_shader_data.cpp")
+    set(MANIFEST_FILE "${OUTPUT_DIR}/builtin_shader_manifest.cmake")
+    file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+
+    set(MANIFEST "")
+    set(DEPENDENCIES "${MANIFEST_FILE}" "${NOVA_EMBED_SHADERS_SCRIPT}" "${HEADER_FILE}")
+    foreach(VARIANT IN LISTS ARGN)
+        string(FIND "${VARIANT}" ":" COLON_POS)
+        if(COLON_POS EQUAL -1)
+            set(SHADER_NAME "${VARIANT}")
+            set(DEFINES "")
+        else()
+            string(SUBSTRING "${VARIANT}" 0 ${COLON_POS} SHADER_NAME)
+            math(EXPR DEFINES_POS "${COLON_POS} + 1")
+            string(SUBSTRING "${VARIANT}" ${DEFINES_POS} -1 DEFINES)
+        endif()
+
+        set(SHADER_SOURCE "${SHADER_DIR}/${SHADER_NAME}")
+        if(NOT EXISTS "${SHADER_SOURCE}")
+            message(FATAL_ERROR "Builtin shader ${SHADER_SOURCE} doesn't exist")
+        endif()
+        list(APPEND DEPENDENCIES "${SHADER_SOURCE}")
+
+        set(SPIRV_FILE "")
+        if(NOVA_PRECOMPILE_BUILTIN_SHADERS AND NOVA_DXC_PROGRAM)
+            nova_get_hlsl_profile("${SHADER_NAME}" PROFILE)
+
+            string(REPLACE "," ";" DEFINE_LIST "${DEFINES}")
+            set(DEFINE_ARGS "")
+            foreach(DEFINE IN LISTS DEFINE_LIST)
+                list(APPEND DEFINE_ARGS -D "${DEFINE}")
+            endforeach()
+
+            string(MAKE_C_IDENTIFIER "${VARIANT}" VARIANT_ID)
+            set(SPIRV_FILE "${OUTPUT_DIR}/${VARIANT_ID}.spv")
+            add_custom_command(
+                OUTPUT "${SPIRV_FILE}"
+                COMMAND "${NOVA_DXC_PROGRAM}" -spirv -fspv-target-env=vulkan1.1 -fspv-reflect -E main -T ${PROFILE} ${DEFINE_ARGS}
+                        -Fo "${SPIRV_FILE}" "${SHADER_SOURCE}"
+                DEPENDS "${SHADER_SOURCE}"
+                COMMENT "Compiling builtin shader ${VARIANT}"
+                VERBATIM
+            )
+            list(APPEND DEPENDENCIES "${SPIRV_FILE}")
+        endif()
+
+        string(APPEND MANIFEST "list(APPEND SHADER_VARIANTS \"${SHADER_NAME}|${DEFINES}|${SPIRV_FILE}\")\n")
+    endforeach()
+
+    # Only rewritten when the list of variants changes, so reconfiguring doesn't rebuild the generated source
+    file(GENERATE OUTPUT "${MANIFEST_FILE}" CONTENT "${MANIFEST}")
+
+    add_custom_command(
+        OUTPUT "${GENERATED_SOURCE}"
+        COMMAND "${CMAKE_COMMAND}"
+                -DMANIFEST_FILE=${MANIFEST_FILE}
+                -DSHADER_DIR=${SHADER_DIR}
+                -DHEADER_FILE=${HEADER_FILE}
+                -DOUTPUT_FILE=${GENERATED_SOURCE}
+                -P "${NOVA_EMBED_SHADERS_SCRIPT}"
+        DEPENDS ${DEPENDENCIES}
+        COMMENT "Embedding builtin shaders"
+        VERBATIM
+    )
+
+    set(${OUTPUT_VARIABLE} "${GENERATED_SOURCE}" PARENT_SCOPE)
+endfunction()
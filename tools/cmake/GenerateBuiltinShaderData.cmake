@@ -0,0 +1,51 @@
+# Writes the source file that defines `EMBEDDED_SHADERS`. EmbedBuiltinShaders.cmake runs this during the build, with MANIFEST_FILE,
+# SHADER_DIR, HEADER_FILE, and OUTPUT_FILE set
+#
+# Sources are written as hex escapes and SPIR-V as words, so that nothing in a shader can break the generated code
+
+include("${MANIFEST_FILE}")
+
+set(DATA "")
+set(SHADERS "")
+set(NUM_SHADERS 0)
+foreach(VARIANT IN LISTS SHADER_VARIANTS)
+    string(REGEX MATCH "^([^|]*)\\|([^|]*)\\|([^|]*)$" VARIANT_MATCH "${VARIANT}")
+    set(SHADER_NAME "${CMAKE_MATCH_1}")
+    set(DEFINES "${CMAKE_MATCH_2}")
+    set(SPIRV_FILE "${CMAKE_MATCH_3}")
+
+    # Variants of the same shader share its source
+    string(MAKE_C_IDENTIFIER "${SHADER_NAME}" SOURCE_ID)
+    if(NOT DEFINED EMITTED_${SOURCE_ID})
+        set(EMITTED_${SOURCE_ID} TRUE)
+
+        file(READ "${SHADER_DIR}/${SHADER_NAME}" SOURCE_HEX HEX)
+        string(REGEX REPLACE "([0-9a-f][0-9a-f])" "\\\\x\\1" SOURCE_ESCAPED "${SOURCE_HEX}")
+        string(REGEX REPLACE "((\\\\x..)(\\\\x..)(\\\\x..)(\\\\x..)(\\\\x..)(\\\\x..)(\\\\x..)(\\\\x..))" "\\1\"\n            \""
+               SOURCE_ESCAPED "${SOURCE_ESCAPED}")
+        string(APPEND DATA "        constexpr std::string_view SOURCE_${SOURCE_ID}{\n            \"${SOURCE_ESCAPED}\"};\n\n")
+    endif()
+
+    set(SPIRV_SPAN "{}")
+    if(SPIRV_FILE)
+        file(READ "${SPIRV_FILE}" SPIRV_HEX HEX)
+        # SPIR-V from DXC is little-endian
+        string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " SPIRV_WORDS "${SPIRV_HEX}")
+        set(WORD "(0x........, )")
+        string(REGEX REPLACE "(${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD}${WORD})" "\\1\n            " SPIRV_WORDS "${SPIRV_WORDS}")
+        string(APPEND DATA "        constexpr uint32_t SPIRV_${NUM_SHADERS}[] = {\n            ${SPIRV_WORDS}};\n\n")
+        set(SPIRV_SPAN "SPIRV_${NUM_SHADERS}")
+    endif()
+
+    string(APPEND SHADERS "            EmbeddedShader{\"${SHADER_NAME}\", \"${DEFINES}\", SOURCE_${SOURCE_ID}, ${SPIRV_SPAN}},\n")
+    math(EXPR NUM_SHADERS "${NUM_SHADERS} + 1")
+endforeach()
+
+set(GENERATED "// Generated by tools/cmake/GenerateBuiltinShaderData.cmake. Edit the shaders in src/shaders/builtin instead\n\n")
+string(APPEND GENERATED "#include <array>\n\n#include \"${HEADER_FILE}\"\n\n")
+string(APPEND GENERATED "namespace nova::renderer {\n    namespace {\n${DATA}")
+string(APPEND GENERATED "        constexpr std::array<EmbeddedShader, ${NUM_SHADERS}> SHADERS{{\n${SHADERS}        }};\n")
+string(APPEND GENERATED "    } // namespace\n\n")
+string(APPEND GENERATED "    const std::span<const EmbeddedShader> EMBEDDED_SHADERS{SHADERS};\n} // namespace nova::renderer\n")
+
+file(WRITE "${OUTPUT_FILE}" "${GENERATED}")